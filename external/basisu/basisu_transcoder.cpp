@@ -29,9 +29,9 @@
 #define BASISD_SUPPORT_FXT1 0
 
 /*
- * KTX2 support disabled.
+ * KTX2 support, Zstd is provided by the system library.
  */
-#define BASISD_SUPPORT_KTX2 0
+#define BASISD_SUPPORT_KTX2 1
 
 /**** start inlining basisu_transcoder.cpp ****/
 // basisu_transcoder.cpp
@@ -5721,7 +5721,7 @@ namespace basisu
 	#if BASISD_SUPPORT_KTX2_ZSTD
 		// We only use two Zstd API's: ZSTD_decompress() and ZSTD_isError()
 /**** start inlining zstd ****/
-#error Unable to find "zstd"
+#include <zstd.h>
 /**** ended inlining zstd ****/
 	#endif
 #endif
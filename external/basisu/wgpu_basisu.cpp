@@ -131,16 +131,11 @@ static basist::transcoder_texture_format SelectBasisTextureformat(const std::uno
 }
 // clang-format on
 
-basisu_transcode_result_t
-basisu_transcode(basisu_data_t basisu_data,
-                 WGPUTextureFormat (*supported_formats)[12],
-                 uint32_t supported_format_count, bool mipmaps)
+// The transcoder formats this device supports
+static std::unordered_map<basist::transcoder_texture_format, bool>
+GetSupportedBasisFormats(const WGPUTextureFormat* supported_formats,
+                         uint32_t supported_format_count)
 {
-
-  basisu_transcode_result_t transcodeResult = {};
-  transcodeResult.result_code = BASIS_TRANSCODE_RESULT_TRANSCODE_FAILURE;
-
-  // The formats this device supports
   std::unordered_map<basist::transcoder_texture_format, bool>
     supportedBasisFormats;
   for (const auto& item : WTT_FORMAT_MAP) {
@@ -148,12 +143,27 @@ basisu_transcode(basisu_data_t basisu_data,
     const auto wttFormat                = item.second.format;
     supportedBasisFormats[targetFormat] = false;
     for (uint32_t i = 0; i < supported_format_count; ++i) {
-      if ((*supported_formats)[i] == wttFormat) {
+      if (supported_formats[i] == wttFormat) {
         supportedBasisFormats[targetFormat] = true;
         break;
       }
     }
   }
+  return supportedBasisFormats;
+}
+
+basisu_transcode_result_t
+basisu_transcode(basisu_data_t basisu_data,
+                 const WGPUTextureFormat* supported_formats,
+                 uint32_t supported_format_count, bool mipmaps)
+{
+
+  basisu_transcode_result_t transcodeResult = {};
+  transcodeResult.result_code = BASIS_TRANSCODE_RESULT_TRANSCODE_FAILURE;
+
+  // The formats this device supports
+  const auto supportedBasisFormats
+    = GetSupportedBasisFormats(supported_formats, supported_format_count);
 
   const auto basisuDataSize = static_cast<uint32_t>(basisu_data.size);
 
@@ -199,6 +209,8 @@ basisu_transcode(basisu_data_t basisu_data,
   transcodeResult.image_desc.width       = imageInfo.m_width;
   transcodeResult.image_desc.height      = imageInfo.m_height;
   transcodeResult.image_desc.level_count = levels;
+  transcodeResult.image_desc.layer_count = 1;
+  transcodeResult.image_desc.face_count  = 1;
 
   // Transcode each mip level
   uint32_t descW, descH, blocks;
@@ -248,3 +260,134 @@ void basisu_free(const basisu_image_desc_t* desc)
     }
   }
 }
+
+struct basisu_transcoder_t {
+  explicit basisu_transcoder_t(basisu_data_t basisuData)
+      : data(basisuData), basis(g_pGlobal_codebook), ktx2(g_pGlobal_codebook)
+  {
+  }
+
+  basisu_data_t data;
+  basist::basisu_transcoder basis;
+  basist::ktx2_transcoder ktx2;
+  bool isKtx2    = false;
+  uint32_t faces = 1;
+  basist::transcoder_texture_format format
+    = basist::transcoder_texture_format::cTFRGBA32;
+  // Blocks or pixels of a single image per level
+  uint32_t imageUnits[BASISU_MAX_MIPMAPS] = {};
+};
+
+basisu_transcoder_t*
+basisu_transcoder_create(basisu_data_t basisu_data,
+                         const WGPUTextureFormat* supported_formats,
+                         uint32_t supported_format_count, bool mipmaps,
+                         basisu_image_desc_t* desc)
+{
+  assert(g_pGlobal_codebook);
+  auto* transcoder          = new basisu_transcoder_t(basisu_data);
+  const auto basisuDataSize = static_cast<uint32_t>(basisu_data.size);
+
+  bool hasAlpha = false;
+  uint32_t width = 0, height = 0, levels = 0, layers = 1;
+  if (transcoder->basis.validate_header(basisu_data.ptr, basisuDataSize)) {
+    basist::basisu_image_info imageInfo;
+    if (transcoder->basis.start_transcoding(basisu_data.ptr, basisuDataSize)
+        && transcoder->basis.get_image_info(basisu_data.ptr, basisuDataSize,
+                                            imageInfo, 0)) {
+      hasAlpha = imageInfo.m_alpha_flag;
+      width    = imageInfo.m_width;
+      height   = imageInfo.m_height;
+      levels   = imageInfo.m_total_levels;
+    }
+  }
+  else if (transcoder->ktx2.init(basisu_data.ptr, basisuDataSize)
+           && transcoder->ktx2.start_transcoding()) {
+    transcoder->isKtx2 = true;
+    transcoder->faces  = transcoder->ktx2.get_faces();
+    hasAlpha           = transcoder->ktx2.get_has_alpha();
+    width              = transcoder->ktx2.get_width();
+    height             = transcoder->ktx2.get_height();
+    levels             = std::max(1u, transcoder->ktx2.get_levels());
+    layers             = std::max(1u, transcoder->ktx2.get_layers());
+  }
+
+  const auto supportedBasisFormats
+    = GetSupportedBasisFormats(supported_formats, supported_format_count);
+  transcoder->format
+    = SelectBasisTextureformat(supportedBasisFormats, hasAlpha);
+  if (levels == 0 || levels > BASISU_MAX_MIPMAPS
+      || WTT_FORMAT_MAP.find(transcoder->format) == WTT_FORMAT_MAP.end()) {
+    delete transcoder;
+    return nullptr;
+  }
+  const auto& wttFormat = WTT_FORMAT_MAP.at(transcoder->format);
+
+  // Same as basisu_transcode(), uncompressed images only get a single level
+  if (wttFormat.uncompressed || !mipmaps) {
+    levels = 1;
+  }
+
+  *desc             = {};
+  desc->format      = wttFormat.format;
+  desc->width       = width;
+  desc->height      = height;
+  desc->level_count = levels;
+  desc->layer_count = layers;
+  desc->face_count  = transcoder->faces;
+
+  const bool uncompressed
+    = basis_transcoder_format_is_uncompressed(transcoder->format);
+  const uint32_t bytesPerBlock
+    = basis_get_bytes_per_block_or_pixel(transcoder->format);
+  for (uint32_t level = 0; level < levels; ++level) {
+    uint32_t levelWidth = 0, levelHeight = 0, blocks = 0;
+    bool success = false;
+    if (transcoder->isKtx2) {
+      basist::ktx2_image_level_info levelInfo;
+      success = transcoder->ktx2.get_image_level_info(levelInfo, level, 0, 0);
+      levelWidth  = levelInfo.m_orig_width;
+      levelHeight = levelInfo.m_orig_height;
+      blocks      = levelInfo.m_total_blocks;
+    }
+    else {
+      success = transcoder->basis.get_image_level_desc(
+        basisu_data.ptr, basisuDataSize, 0, level, levelWidth, levelHeight,
+        blocks);
+    }
+    if (!success) {
+      delete transcoder;
+      return nullptr;
+    }
+    const uint32_t units = uncompressed ? levelWidth * levelHeight : blocks;
+    transcoder->imageUnits[level] = units;
+    desc->levels[level].size
+      = static_cast<size_t>(units) * bytesPerBlock * layers * desc->face_count;
+  }
+
+  return transcoder;
+}
+
+void basisu_transcoder_destroy(basisu_transcoder_t* transcoder)
+{
+  delete transcoder;
+}
+
+bool basisu_transcoder_transcode_image(basisu_transcoder_t* transcoder,
+                                       uint32_t level, uint32_t image,
+                                       void* output)
+{
+  // A state per call keeps concurrent transcodes of the same file apart
+  if (transcoder->isKtx2) {
+    basist::ktx2_transcoder_state state;
+    return transcoder->ktx2.transcode_image_level(
+      level, image / transcoder->faces, image % transcoder->faces, output,
+      transcoder->imageUnits[level], transcoder->format, 0, 0, 0, -1, -1,
+      &state);
+  }
+  basist::basisu_transcoder_state state;
+  return transcoder->basis.transcode_image_level(
+    transcoder->data.ptr, static_cast<uint32_t>(transcoder->data.size), image,
+    level, output, transcoder->imageUnits[level], transcoder->format, 0, 0,
+    &state);
+}
@@ -36,6 +36,9 @@ typedef struct basisu_image_desc_t {
   uint32_t width;
   uint32_t height;
   uint32_t level_count; // Number of mipmaps
+  uint32_t layer_count; // Number of array layers
+  uint32_t face_count;  // 6 for cubemaps, 1 otherwise
+  // All layers and faces of a level, the faces of a layer follow each other
   basisu_data_t levels[BASISU_MAX_MIPMAPS];
 } basisu_image_desc_t;
 
@@ -52,10 +55,33 @@ bool basisu_is_initialized(void);
 /* Basis Universal transcoding */
 basisu_transcode_result_t
 basisu_transcode(basisu_data_t basisu_data,
-                 WGPUTextureFormat (*supported_formats)[12],
+                 const WGPUTextureFormat* supported_formats,
                  uint32_t supported_format_count, bool mipmaps);
 void basisu_free(const basisu_image_desc_t* desc);
 
+/*
+ * Transcoder of a .basis file or of a BasisLZ/ETC1S or UASTC KTX2 file,
+ * including Zstd supercompressed ones. Once created, the images of the file
+ * can be transcoded from several threads at once.
+ */
+typedef struct basisu_transcoder_t basisu_transcoder_t;
+
+// Selects the transcode format from the supported formats and describes the
+// transcoded levels in desc, the level pointers are left NULL. Returns NULL
+// if the file can't be transcoded.
+basisu_transcoder_t*
+basisu_transcoder_create(basisu_data_t basisu_data,
+                         const WGPUTextureFormat* supported_formats,
+                         uint32_t supported_format_count, bool mipmaps,
+                         basisu_image_desc_t* desc);
+void basisu_transcoder_destroy(basisu_transcoder_t* transcoder);
+
+// Transcodes one image of a level, image is layer * face_count + face. The
+// output holds levels[level].size / (layer_count * face_count) bytes.
+bool basisu_transcoder_transcode_image(basisu_transcoder_t* transcoder,
+                                       uint32_t level, uint32_t image,
+                                       void* output);
+
 #if defined(__cplusplus)
 } // extern "C"
 #endif
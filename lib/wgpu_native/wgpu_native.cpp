@@ -2,11 +2,18 @@
 
 #include <dawn/dawn_proc.h>
 #include <dawn/native/DawnNative.h>
+#include <dawn/platform/DawnPlatform.h>
 #include <dawn/webgpu_cpp.h>
 
+#include <ctype.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <vector>
 
 //****************************** Implementation *******************************/
 
@@ -28,11 +35,111 @@ namespace WGPUImpl {
 static const char* BackendTypeName(wgpu::BackendType);
 static const char* AdapterTypeName(wgpu::AdapterType);
 
+// Persists Dawn's blob cache (compiled shaders / pipelines) to disk, one file
+// per key named after its hash. The file starts with the key itself to guard
+// against hash collisions.
+class FileCachingInterface : public dawn_platform::CachingInterface {
+public:
+  explicit FileCachingInterface(const char* directory) : directory(directory)
+  {
+    mkdir(directory, 0755);
+  }
+
+  size_t LoadData(const WGPUDevice device, const void* key, size_t keySize,
+                  void* value, size_t valueSize) override
+  {
+    FILE* file = fopen(GetPath(key, keySize).c_str(), "rb");
+    if (file == nullptr) {
+      return 0;
+    }
+    size_t dataSize = 0;
+    std::vector<uint8_t> storedKey(keySize);
+    uint64_t storedKeySize = 0;
+    if (fread(&storedKeySize, sizeof(storedKeySize), 1, file) == 1
+        && storedKeySize == keySize
+        && fread(storedKey.data(), 1, keySize, file) == keySize
+        && memcmp(storedKey.data(), key, keySize) == 0) {
+      const long dataOffset = ftell(file);
+      fseek(file, 0, SEEK_END);
+      dataSize = (size_t)(ftell(file) - dataOffset);
+      if (value != nullptr) {
+        fseek(file, dataOffset, SEEK_SET);
+        dataSize = (valueSize >= dataSize
+                    && fread(value, 1, dataSize, file) == dataSize) ?
+                     dataSize :
+                     0;
+      }
+    }
+    fclose(file);
+    return dataSize;
+  }
+
+  void StoreData(const WGPUDevice device, const void* key, size_t keySize,
+                 const void* value, size_t valueSize) override
+  {
+    // Write to a temporary file first so readers never see partial entries
+    const std::string path     = GetPath(key, keySize);
+    const std::string tempPath = path + ".tmp";
+    FILE* file                 = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr) {
+      return;
+    }
+    const uint64_t storedKeySize = keySize;
+    const bool written
+      = fwrite(&storedKeySize, sizeof(storedKeySize), 1, file) == 1
+        && fwrite(key, 1, keySize, file) == keySize
+        && fwrite(value, 1, valueSize, file) == valueSize;
+    fclose(file);
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+      remove(tempPath.c_str());
+    }
+  }
+
+private:
+  std::string GetPath(const void* key, size_t keySize) const
+  {
+    // 64-bit FNV-1a
+    uint64_t hash        = 0xcbf29ce484222325ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(key);
+    for (size_t i = 0; i < keySize; ++i) {
+      hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/%016llx.bin",
+             (unsigned long long)hash);
+    return directory + filename;
+  }
+
+  std::string directory;
+};
+
+class CachingPlatform : public dawn_platform::Platform {
+public:
+  explicit CachingPlatform(const char* directory) : cachingInterface(directory)
+  {
+  }
+
+  dawn_platform::CachingInterface*
+  GetCachingInterface(const void* fingerprint, size_t fingerprintSize) override
+  {
+    return &cachingInterface;
+  }
+
+private:
+  FileCachingInterface cachingInterface;
+};
+
 static struct {
   struct {
+    // Native procs, the proc table wraps the resource procs
+    DawnProcTable nativeProcs;
     DawnProcTable procTable;
     std::unique_ptr<dawn_native::Instance> instance = nullptr;
+    std::unique_ptr<CachingPlatform> platform       = nullptr;
   } dawn_native;
+  std::string pipelineCacheDirectory;
+  wgpu_resource_hooks_t resourceHooks;
+  wgpu_trace_hooks_t traceHooks;
   struct {
     dawn_native::Adapter handle;
     wgpu::BackendType backendType;
@@ -45,16 +152,254 @@ static struct {
   bool initialized = false;
 } gpuContext = {};
 
+// Resource procs calling the resource hooks
+static WGPUBuffer DeviceCreateBuffer(WGPUDevice device,
+                                     WGPUBufferDescriptor const* descriptor)
+{
+  WGPUBuffer buffer
+    = gpuContext.dawn_native.nativeProcs.deviceCreateBuffer(device, descriptor);
+  if (buffer != nullptr && gpuContext.resourceHooks.buffer_created) {
+    gpuContext.resourceHooks.buffer_created(buffer, descriptor);
+  }
+  if (buffer != nullptr && gpuContext.traceHooks.buffer_created) {
+    gpuContext.traceHooks.buffer_created(buffer, descriptor);
+  }
+  return buffer;
+}
+
+static WGPUTexture DeviceCreateTexture(WGPUDevice device,
+                                       WGPUTextureDescriptor const* descriptor)
+{
+  WGPUTexture texture
+    = gpuContext.dawn_native.nativeProcs.deviceCreateTexture(device,
+                                                             descriptor);
+  if (texture != nullptr && gpuContext.resourceHooks.texture_created) {
+    gpuContext.resourceHooks.texture_created(texture, descriptor);
+  }
+  if (texture != nullptr && gpuContext.traceHooks.texture_created) {
+    gpuContext.traceHooks.texture_created(texture, descriptor);
+  }
+  return texture;
+}
+
+// Queue procs calling the trace hooks
+static void QueueWriteBuffer(WGPUQueue queue, WGPUBuffer buffer,
+                             uint64_t bufferOffset, void const* data,
+                             size_t size)
+{
+  if (gpuContext.traceHooks.queue_write_buffer) {
+    gpuContext.traceHooks.queue_write_buffer(buffer, bufferOffset, data, size);
+  }
+  gpuContext.dawn_native.nativeProcs.queueWriteBuffer(queue, buffer,
+                                                      bufferOffset, data, size);
+}
+
+static void QueueWriteTexture(WGPUQueue queue,
+                              WGPUImageCopyTexture const* destination,
+                              void const* data, size_t dataSize,
+                              WGPUTextureDataLayout const* dataLayout,
+                              WGPUExtent3D const* writeSize)
+{
+  if (gpuContext.traceHooks.queue_write_texture) {
+    gpuContext.traceHooks.queue_write_texture(destination, data, dataSize,
+                                              dataLayout, writeSize);
+  }
+  gpuContext.dawn_native.nativeProcs.queueWriteTexture(
+    queue, destination, data, dataSize, dataLayout, writeSize);
+}
+
+static void QueueSubmit(WGPUQueue queue, uint32_t commandCount,
+                        WGPUCommandBuffer const* commands)
+{
+  if (gpuContext.traceHooks.queue_submit) {
+    gpuContext.traceHooks.queue_submit(commandCount, commands);
+  }
+  gpuContext.dawn_native.nativeProcs.queueSubmit(queue, commandCount,
+                                                 commands);
+}
+
+// Command encoder and pass procs calling the trace hooks
+static WGPURenderPassEncoder
+CommandEncoderBeginRenderPass(WGPUCommandEncoder encoder,
+                              WGPURenderPassDescriptor const* descriptor)
+{
+  WGPURenderPassEncoder pass
+    = gpuContext.dawn_native.nativeProcs.commandEncoderBeginRenderPass(
+      encoder, descriptor);
+  if (pass != nullptr && gpuContext.traceHooks.pass_begun) {
+    gpuContext.traceHooks.pass_begun(encoder, pass,
+                                     WGPU_TRACE_PASS_COMMAND_BEGIN_RENDER_PASS);
+  }
+  return pass;
+}
+
+static WGPUComputePassEncoder
+CommandEncoderBeginComputePass(WGPUCommandEncoder encoder,
+                               WGPUComputePassDescriptor const* descriptor)
+{
+  WGPUComputePassEncoder pass
+    = gpuContext.dawn_native.nativeProcs.commandEncoderBeginComputePass(
+      encoder, descriptor);
+  if (pass != nullptr && gpuContext.traceHooks.pass_begun) {
+    gpuContext.traceHooks.pass_begun(
+      encoder, pass, WGPU_TRACE_PASS_COMMAND_BEGIN_COMPUTE_PASS);
+  }
+  return pass;
+}
+
+static WGPUCommandBuffer
+CommandEncoderFinish(WGPUCommandEncoder encoder,
+                     WGPUCommandBufferDescriptor const* descriptor)
+{
+  WGPUCommandBuffer command_buffer
+    = gpuContext.dawn_native.nativeProcs.commandEncoderFinish(encoder,
+                                                              descriptor);
+  if (command_buffer != nullptr
+      && gpuContext.traceHooks.command_encoder_finished) {
+    gpuContext.traceHooks.command_encoder_finished(encoder, command_buffer);
+  }
+  return command_buffer;
+}
+
+static void TracePassCommand(void const* pass,
+                             wgpu_trace_pass_command_type_t type,
+                             uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                             WGPUBuffer indirectBuffer, uint64_t indirectOffset)
+{
+  if (gpuContext.traceHooks.pass_command) {
+    const wgpu_trace_pass_command_t command = {
+      type, {a0, a1, a2, a3}, indirectBuffer, indirectOffset};
+    gpuContext.traceHooks.pass_command(pass, &command);
+  }
+}
+
+static void RenderPassEncoderDraw(WGPURenderPassEncoder pass,
+                                  uint32_t vertexCount, uint32_t instanceCount,
+                                  uint32_t firstVertex, uint32_t firstInstance)
+{
+  TracePassCommand(pass, WGPU_TRACE_PASS_COMMAND_DRAW, vertexCount,
+                   instanceCount, firstVertex, firstInstance, nullptr, 0);
+  gpuContext.dawn_native.nativeProcs.renderPassEncoderDraw(
+    pass, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+static void RenderPassEncoderDrawIndexed(WGPURenderPassEncoder pass,
+                                         uint32_t indexCount,
+                                         uint32_t instanceCount,
+                                         uint32_t firstIndex,
+                                         int32_t baseVertex,
+                                         uint32_t firstInstance)
+{
+  TracePassCommand(pass, WGPU_TRACE_PASS_COMMAND_DRAW_INDEXED, indexCount,
+                   instanceCount, firstIndex, firstInstance, nullptr, 0);
+  gpuContext.dawn_native.nativeProcs.renderPassEncoderDrawIndexed(
+    pass, indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
+
+static void RenderPassEncoderDrawIndirect(WGPURenderPassEncoder pass,
+                                          WGPUBuffer indirectBuffer,
+                                          uint64_t indirectOffset)
+{
+  TracePassCommand(pass, WGPU_TRACE_PASS_COMMAND_DRAW_INDIRECT, 0, 0, 0, 0,
+                   indirectBuffer, indirectOffset);
+  gpuContext.dawn_native.nativeProcs.renderPassEncoderDrawIndirect(
+    pass, indirectBuffer, indirectOffset);
+}
+
+static void RenderPassEncoderDrawIndexedIndirect(WGPURenderPassEncoder pass,
+                                                 WGPUBuffer indirectBuffer,
+                                                 uint64_t indirectOffset)
+{
+  TracePassCommand(pass, WGPU_TRACE_PASS_COMMAND_DRAW_INDEXED_INDIRECT, 0, 0,
+                   0, 0, indirectBuffer, indirectOffset);
+  gpuContext.dawn_native.nativeProcs.renderPassEncoderDrawIndexedIndirect(
+    pass, indirectBuffer, indirectOffset);
+}
+
+static void ComputePassEncoderDispatchWorkgroups(WGPUComputePassEncoder pass,
+                                                 uint32_t workgroupCountX,
+                                                 uint32_t workgroupCountY,
+                                                 uint32_t workgroupCountZ)
+{
+  TracePassCommand(pass, WGPU_TRACE_PASS_COMMAND_DISPATCH, workgroupCountX,
+                   workgroupCountY, workgroupCountZ, 0, nullptr, 0);
+  gpuContext.dawn_native.nativeProcs.computePassEncoderDispatchWorkgroups(
+    pass, workgroupCountX, workgroupCountY, workgroupCountZ);
+}
+
+static void
+ComputePassEncoderDispatchWorkgroupsIndirect(WGPUComputePassEncoder pass,
+                                             WGPUBuffer indirectBuffer,
+                                             uint64_t indirectOffset)
+{
+  TracePassCommand(pass, WGPU_TRACE_PASS_COMMAND_DISPATCH_INDIRECT, 0, 0, 0,
+                   0, indirectBuffer, indirectOffset);
+  gpuContext.dawn_native.nativeProcs
+    .computePassEncoderDispatchWorkgroupsIndirect(pass, indirectBuffer,
+                                                  indirectOffset);
+}
+
+#define RESOURCE_HOOK_PROC(Type, Name, proc, hook)                             \
+  static void Type##Name(WGPU##Type handle)                                    \
+  {                                                                            \
+    if (gpuContext.resourceHooks.hook) {                                       \
+      gpuContext.resourceHooks.hook(handle);                                   \
+    }                                                                          \
+    if (gpuContext.traceHooks.hook) {                                          \
+      gpuContext.traceHooks.hook(handle);                                      \
+    }                                                                          \
+    gpuContext.dawn_native.nativeProcs.proc(handle);                           \
+  }
+RESOURCE_HOOK_PROC(Buffer, Reference, bufferReference, referenced)
+RESOURCE_HOOK_PROC(Buffer, Release, bufferRelease, released)
+RESOURCE_HOOK_PROC(Buffer, Destroy, bufferDestroy, destroyed)
+RESOURCE_HOOK_PROC(Texture, Reference, textureReference, referenced)
+RESOURCE_HOOK_PROC(Texture, Release, textureRelease, released)
+RESOURCE_HOOK_PROC(Texture, Destroy, textureDestroy, destroyed)
+#undef RESOURCE_HOOK_PROC
+
 static void Initialize()
 {
   if (gpuContext.initialized) {
     return;
   }
 
-  // Set up the native procs for the global proctable
-  gpuContext.dawn_native.procTable = dawn_native::GetProcs();
+  // Set up the native procs for the global proctable, with the resource, the
+  // queue and the pass procs wrapped for the resource and the trace hooks
+  gpuContext.dawn_native.nativeProcs = dawn_native::GetProcs();
+  gpuContext.dawn_native.procTable   = gpuContext.dawn_native.nativeProcs;
+  DawnProcTable& procs               = gpuContext.dawn_native.procTable;
+  procs.deviceCreateBuffer           = DeviceCreateBuffer;
+  procs.deviceCreateTexture          = DeviceCreateTexture;
+  procs.bufferReference              = BufferReference;
+  procs.bufferRelease                = BufferRelease;
+  procs.bufferDestroy                = BufferDestroy;
+  procs.textureReference             = TextureReference;
+  procs.textureRelease               = TextureRelease;
+  procs.textureDestroy               = TextureDestroy;
+  procs.queueWriteBuffer             = QueueWriteBuffer;
+  procs.queueWriteTexture            = QueueWriteTexture;
+  procs.queueSubmit                  = QueueSubmit;
+  procs.commandEncoderBeginRenderPass  = CommandEncoderBeginRenderPass;
+  procs.commandEncoderBeginComputePass = CommandEncoderBeginComputePass;
+  procs.commandEncoderFinish           = CommandEncoderFinish;
+  procs.renderPassEncoderDraw          = RenderPassEncoderDraw;
+  procs.renderPassEncoderDrawIndexed   = RenderPassEncoderDrawIndexed;
+  procs.renderPassEncoderDrawIndirect  = RenderPassEncoderDrawIndirect;
+  procs.renderPassEncoderDrawIndexedIndirect
+    = RenderPassEncoderDrawIndexedIndirect;
+  procs.computePassEncoderDispatchWorkgroups
+    = ComputePassEncoderDispatchWorkgroups;
+  procs.computePassEncoderDispatchWorkgroupsIndirect
+    = ComputePassEncoderDispatchWorkgroupsIndirect;
   dawnProcSetProcs(&gpuContext.dawn_native.procTable);
   gpuContext.dawn_native.instance = std::make_unique<dawn_native::Instance>();
+  if (!gpuContext.pipelineCacheDirectory.empty()) {
+    gpuContext.dawn_native.platform = std::make_unique<CachingPlatform>(
+      gpuContext.pipelineCacheDirectory.c_str());
+    gpuContext.dawn_native.instance->SetPlatform(
+      gpuContext.dawn_native.platform.get());
+  }
   gpuContext.dawn_native.instance->DiscoverDefaultAdapters();
   gpuContext.dawn_native.instance->EnableBackendValidation(true);
   gpuContext.dawn_native.instance->SetBackendValidationLevel(
@@ -87,77 +432,181 @@ static void SetAdapterInfo(const wgpu::AdapterProperties& ap)
   gpuContext.adapter.info.backendName = BackendTypeName(ap.backendType);
 }
 
-static WGPUAdapter RequestAdapter(WGPURequestAdapterOptions* options)
+static WGPUPowerPreference
+GetPowerPreference(const WGPURequestAdapterOptions* options)
 {
-  Initialize();
-
-  WGPUPowerPreference powerPreference
-    = options ?
-        (options->powerPreference == WGPUPowerPreference_HighPerformance ?
+  return (options
+          && options->powerPreference == WGPUPowerPreference_HighPerformance) ?
            WGPUPowerPreference_HighPerformance :
-           WGPUPowerPreference_LowPower) :
-        WGPUPowerPreference_LowPower;
-
-  // Search available adapters for a good match, in the following priority
-  // order
-  std::vector<wgpu::AdapterType> typePriority;
-  if (powerPreference == WGPUPowerPreference_LowPower) {
-    // low power
-    typePriority = std::vector<wgpu::AdapterType>{
-      wgpu::AdapterType::IntegratedGPU,
-      wgpu::AdapterType::DiscreteGPU,
-      wgpu::AdapterType::CPU,
-    };
-  }
-  else if (powerPreference == WGPUPowerPreference_HighPerformance) {
-    // high performance
-    typePriority = std::vector<wgpu::AdapterType>{
-      wgpu::AdapterType::DiscreteGPU,
-      wgpu::AdapterType::IntegratedGPU,
-      wgpu::AdapterType::CPU,
-    };
+           WGPUPowerPreference_LowPower;
+}
+
+static int AdapterTypeRank(wgpu::AdapterType type,
+                           WGPUPowerPreference powerPreference)
+{
+  switch (type) {
+    case wgpu::AdapterType::DiscreteGPU:
+      return powerPreference == WGPUPowerPreference_HighPerformance ? 3 : 2;
+    case wgpu::AdapterType::IntegratedGPU:
+      return powerPreference == WGPUPowerPreference_HighPerformance ? 2 : 3;
+    case wgpu::AdapterType::CPU:
+      return 1;
+    default:
+      return 0;
   }
+}
+
+static int BackendTypeRank(wgpu::BackendType type)
+{
+  if (type == wgpu::BackendType::Vulkan) {
+    return 3;
+  }
+  if (type == gpuContext.adapter.backendType) {
+    return 2;
+  }
+  return type == wgpu::BackendType::Null ? 0 : 1;
+}
 
+// Available adapters in rank order, the discovery order breaks ties
+static std::vector<dawn_native::Adapter>
+GetRankedAdapters(const WGPURequestAdapterOptions* options)
+{
+  Initialize();
+
+  const WGPUPowerPreference powerPreference = GetPowerPreference(options);
   std::vector<dawn_native::Adapter> adapters
     = gpuContext.dawn_native.instance->GetAdapters();
-  for (auto reqType : typePriority) {
-    for (const dawn_native::Adapter& adapter : adapters) {
-      wgpu::AdapterProperties ap;
-      adapter.GetProperties(&ap);
-      if (ap.adapterType == reqType
-          && (reqType == wgpu::AdapterType::CPU
-              || ap.backendType == gpuContext.adapter.backendType)) {
-        gpuContext.adapter.handle = adapter;
-        SetAdapterInfo(ap);
-        dlog("Selected adapter %s (device=0x%x vendor=0x%x type=%s/%s)",
-             ap.name, ap.deviceID, ap.vendorID,
-             gpuContext.adapter.info.typeName,
-             gpuContext.adapter.info.backendName);
-        return gpuContext.adapter.handle.Get();
-      }
+  std::stable_sort(adapters.begin(), adapters.end(),
+                   [powerPreference](const dawn_native::Adapter& a,
+                                     const dawn_native::Adapter& b) {
+                     wgpu::AdapterProperties pa, pb;
+                     a.GetProperties(&pa);
+                     b.GetProperties(&pb);
+                     const int ta = AdapterTypeRank(pa.adapterType,
+                                                    powerPreference);
+                     const int tb = AdapterTypeRank(pb.adapterType,
+                                                    powerPreference);
+                     if (ta != tb) {
+                       return ta > tb;
+                     }
+                     return BackendTypeRank(pa.backendType)
+                            > BackendTypeRank(pb.backendType);
+                   });
+  return adapters;
+}
+
+// Case-insensitive substring search
+static bool ContainsIgnoreCase(const char* haystack, const char* needle)
+{
+  const size_t needleLength = strlen(needle);
+  for (; *haystack != '\0'; ++haystack) {
+    size_t i = 0;
+    while (i < needleLength && haystack[i] != '\0'
+           && tolower((unsigned char)haystack[i])
+                == tolower((unsigned char)needle[i])) {
+      ++i;
+    }
+    if (i == needleLength) {
+      return true;
+    }
+  }
+  return needleLength == 0;
+}
+
+static bool EqualsIgnoreCase(const char* a, const char* b)
+{
+  for (; *a != '\0' && *b != '\0'; ++a, ++b) {
+    if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) {
+      return false;
+    }
+  }
+  return *a == *b;
+}
+
+static bool MatchesSelection(const wgpu::AdapterProperties& ap, int32_t index,
+                             const wgpu_adapter_selection_t* selection)
+{
+  if (selection == nullptr) {
+    return true;
+  }
+  if (selection->index >= 0 && selection->index != index) {
+    return false;
+  }
+  if (selection->name != nullptr
+      && !ContainsIgnoreCase(ap.name, selection->name)) {
+    return false;
+  }
+  if (selection->vendor_id != 0 && selection->vendor_id != ap.vendorID) {
+    return false;
+  }
+  if (selection->backend != nullptr
+      && !EqualsIgnoreCase(BackendTypeName(ap.backendType),
+                           selection->backend)) {
+    return false;
+  }
+  return true;
+}
+
+static WGPUAdapter
+RequestAdapter(WGPURequestAdapterOptions* options,
+               const wgpu_adapter_selection_t* selection)
+{
+  std::vector<dawn_native::Adapter> adapters = GetRankedAdapters(options);
+  for (size_t i = 0; i < adapters.size(); ++i) {
+    wgpu::AdapterProperties ap;
+    adapters[i].GetProperties(&ap);
+    if (MatchesSelection(ap, (int32_t)i, selection)) {
+      gpuContext.adapter.handle = adapters[i];
+      SetAdapterInfo(ap);
+      dlog("Selected adapter %s (device=0x%x vendor=0x%x type=%s/%s)",
+           ap.name, ap.deviceID, ap.vendorID, gpuContext.adapter.info.typeName,
+           gpuContext.adapter.info.backendName);
+      return gpuContext.adapter.handle.Get();
     }
   }
 
   return nullptr;
 }
 
+static bool GetAdapterProperties(WGPURequestAdapterOptions* options,
+                                 uint32_t index,
+                                 wgpu::AdapterProperties* properties)
+{
+  std::vector<dawn_native::Adapter> adapters = GetRankedAdapters(options);
+  if (index >= adapters.size()) {
+    return false;
+  }
+  adapters[index].GetProperties(properties);
+  return true;
+}
+
 static void LogAvailableAdapters()
 {
   Initialize();
 
   fprintf(stderr, "Available adapters:\n");
-  for (auto&& a : gpuContext.dawn_native.instance->GetAdapters()) {
+  uint32_t index = 0;
+  for (auto&& a : GetRankedAdapters(nullptr)) {
     wgpu::AdapterProperties p;
     a.GetProperties(&p);
     fprintf(
       stderr,
-      "  %s (%s)\n"
+      "  [%u] %s (%s)\n"
       "    deviceID=%u, vendorID=0x%x, BackendType::%s, AdapterType::%s\n",
-      p.name, p.driverDescription, p.deviceID, p.vendorID,
+      index++, p.name, p.driverDescription, p.deviceID, p.vendorID,
       BackendTypeName(p.backendType), AdapterTypeName(p.adapterType));
   }
 }
 
+static void EnablePipelineCache(const char* directory)
+{
+  if (gpuContext.initialized) {
+    dlog("Pipeline cache must be enabled before the instance is created");
+    return;
+  }
+  gpuContext.pipelineCacheDirectory = directory;
+}
+
 static void GetAdapterInfo(char (*adapter_info)[256])
 {
   strncpy(adapter_info[0], gpuContext.adapter.info.name, 256);
@@ -246,6 +695,11 @@ void wgpu_log_available_adapters()
   WGPUImpl::LogAvailableAdapters();
 }
 
+void wgpu_enable_pipeline_cache(const char* directory)
+{
+  WGPUImpl::EnablePipelineCache(directory);
+}
+
 void wgpu_get_adapter_info(char (*adapter_info)[256])
 {
   WGPUImpl::GetAdapterInfo(adapter_info);
@@ -253,10 +707,42 @@ void wgpu_get_adapter_info(char (*adapter_info)[256])
 
 WGPUAdapter wgpu_request_adapter(WGPURequestAdapterOptions* options)
 {
-  return WGPUImpl::RequestAdapter(options);
+  return WGPUImpl::RequestAdapter(options, nullptr);
+}
+
+WGPUAdapter
+wgpu_request_adapter_with_selection(WGPURequestAdapterOptions* options,
+                                    const wgpu_adapter_selection_t* selection)
+{
+  return WGPUImpl::RequestAdapter(options, selection);
+}
+
+uint32_t wgpu_get_adapter_count(WGPURequestAdapterOptions* options)
+{
+  return (uint32_t)WGPUImpl::GetRankedAdapters(options).size();
+}
+
+bool wgpu_get_adapter_properties(WGPURequestAdapterOptions* options,
+                                 uint32_t index,
+                                 WGPUAdapterProperties* properties)
+{
+  return WGPUImpl::GetAdapterProperties(
+    options, index, reinterpret_cast<wgpu::AdapterProperties*>(properties));
 }
 
 WGPUSurface wgpu_create_surface(void* display, void* window_handle)
 {
   return WGPUImpl::CreateSurface(display, window_handle);
 }
+
+void wgpu_set_resource_hooks(const wgpu_resource_hooks_t* hooks)
+{
+  WGPUImpl::gpuContext.resourceHooks
+    = hooks != nullptr ? *hooks : wgpu_resource_hooks_t{};
+}
+
+void wgpu_set_trace_hooks(const wgpu_trace_hooks_t* hooks)
+{
+  WGPUImpl::gpuContext.traceHooks
+    = hooks != nullptr ? *hooks : wgpu_trace_hooks_t{};
+}
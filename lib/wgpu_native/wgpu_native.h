@@ -7,10 +7,98 @@
 extern "C" {
 #endif
 
+// Adapter selection, the fields left unset match any adapter
+typedef struct wgpu_adapter_selection_t {
+  const char* name;    // case-insensitive substring of the adapter name
+  uint32_t vendor_id;  // PCI vendor id, 0 matches any
+  const char* backend; // e.g. "Vulkan" or "D3D12", case-insensitive
+  int32_t index;       // position in the ranked adapter list, -1 matches any
+} wgpu_adapter_selection_t;
+
+// Called from the proc table when buffers and textures are created,
+// referenced, released and destroyed, e.g. to account their memory. The hooks
+// may be called from any thread.
+typedef struct wgpu_resource_hooks_t {
+  void (*buffer_created)(WGPUBuffer buffer,
+                         WGPUBufferDescriptor const* descriptor);
+  void (*texture_created)(WGPUTexture texture,
+                          WGPUTextureDescriptor const* descriptor);
+  void (*referenced)(void const* handle);
+  void (*released)(void const* handle);
+  void (*destroyed)(void const* handle);
+} wgpu_resource_hooks_t;
+
+// Draw and dispatch calls of the passes, as seen by the trace hooks
+typedef enum wgpu_trace_pass_command_type_t {
+  WGPU_TRACE_PASS_COMMAND_BEGIN_RENDER_PASS     = 1,
+  WGPU_TRACE_PASS_COMMAND_BEGIN_COMPUTE_PASS    = 2,
+  WGPU_TRACE_PASS_COMMAND_DRAW                  = 3,
+  WGPU_TRACE_PASS_COMMAND_DRAW_INDEXED          = 4,
+  WGPU_TRACE_PASS_COMMAND_DRAW_INDIRECT         = 5,
+  WGPU_TRACE_PASS_COMMAND_DRAW_INDEXED_INDIRECT = 6,
+  WGPU_TRACE_PASS_COMMAND_DISPATCH              = 7,
+  WGPU_TRACE_PASS_COMMAND_DISPATCH_INDIRECT     = 8,
+} wgpu_trace_pass_command_type_t;
+
+typedef struct wgpu_trace_pass_command_t {
+  wgpu_trace_pass_command_type_t type;
+  // Vertex or index count, instance count, first vertex or index and first
+  // instance of the draws, workgroup counts of the dispatches
+  uint32_t args[4];
+  // Arguments of the indirect commands
+  WGPUBuffer indirect_buffer;
+  uint64_t indirect_offset;
+} wgpu_trace_pass_command_t;
+
+// Called from the proc table like the resource hooks, and for the queue
+// operations and the pass commands, e.g. to capture them into a trace. Both
+// hook sets can be set at the same time. The hooks may be called from any
+// thread.
+typedef struct wgpu_trace_hooks_t {
+  void (*buffer_created)(WGPUBuffer buffer,
+                         WGPUBufferDescriptor const* descriptor);
+  void (*texture_created)(WGPUTexture texture,
+                          WGPUTextureDescriptor const* descriptor);
+  void (*referenced)(void const* handle);
+  void (*released)(void const* handle);
+  void (*destroyed)(void const* handle);
+  void (*queue_write_buffer)(WGPUBuffer buffer, uint64_t buffer_offset,
+                             void const* data, size_t size);
+  void (*queue_write_texture)(WGPUImageCopyTexture const* destination,
+                              void const* data, size_t data_size,
+                              WGPUTextureDataLayout const* data_layout,
+                              WGPUExtent3D const* write_size);
+  void (*queue_submit)(uint32_t command_count,
+                       WGPUCommandBuffer const* commands);
+  // pass is the render or compute pass encoder
+  void (*pass_begun)(WGPUCommandEncoder encoder, void const* pass,
+                     wgpu_trace_pass_command_type_t type);
+  void (*pass_command)(void const* pass,
+                       wgpu_trace_pass_command_t const* command);
+  void (*command_encoder_finished)(WGPUCommandEncoder encoder,
+                                   WGPUCommandBuffer command_buffer);
+} wgpu_trace_hooks_t;
+
 void wgpu_log_available_adapters();
+void wgpu_enable_pipeline_cache(const char* directory);
 void wgpu_get_adapter_info(char (*adapter_info)[256]);
 WGPUAdapter wgpu_request_adapter(WGPURequestAdapterOptions* options);
+// Adapters are ranked by type, discrete before integrated GPUs before CPU
+// adapters (integrated first for the low power preference), then by backend,
+// Vulkan before the other backends. The best ranked adapter matching the
+// selection is returned, NULL if none matches.
+WGPUAdapter
+wgpu_request_adapter_with_selection(WGPURequestAdapterOptions* options,
+                                    const wgpu_adapter_selection_t* selection);
+// Ranked adapter list, for running on every adapter in turn
+uint32_t wgpu_get_adapter_count(WGPURequestAdapterOptions* options);
+bool wgpu_get_adapter_properties(WGPURequestAdapterOptions* options,
+                                 uint32_t index,
+                                 WGPUAdapterProperties* properties);
 WGPUSurface wgpu_create_surface(void* display, void* window_handle);
+// NULL removes the hooks
+void wgpu_set_resource_hooks(const wgpu_resource_hooks_t* hooks);
+void wgpu_set_trace_hooks(const wgpu_trace_hooks_t* hooks);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,124 @@
+#include "microbenchmarks.h"
+
+/* -------------------------------------------------------------------------- *
+ * Buffer micro-benchmarks
+ *
+ * - buffer_create: creates and destroys a batch of uniform buffers
+ * - record_copy_<size>: wgpu_record_copy_data_to_buffer, through the staging
+ *   ring of the context or its temporary staging buffers for large copies
+ * - queue_write_<size>: wgpu_queue_write_buffer of the same data
+ * -------------------------------------------------------------------------- */
+
+#define CREATE_BUFFER_COUNT 64u
+#define CREATE_BUFFER_SIZE 256u
+
+static struct {
+  wgpu_buffer_t buffer;
+  void* data;
+} state = {0};
+
+static int buffer_create_initialize(compute_example_context_t* context)
+{
+  context->work_per_iteration = CREATE_BUFFER_COUNT;
+  context->work_unit          = "buffers";
+  return 0;
+}
+
+static void buffer_create_record(compute_example_context_t* context,
+                                 WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  wgpu_buffer_t buffers[CREATE_BUFFER_COUNT];
+  for (uint32_t i = 0; i < CREATE_BUFFER_COUNT; ++i) {
+    buffers[i] = wgpu_create_buffer(
+      context->wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size  = CREATE_BUFFER_SIZE,
+      });
+  }
+  for (uint32_t i = 0; i < CREATE_BUFFER_COUNT; ++i) {
+    wgpu_destroy_buffer(&buffers[i]);
+  }
+}
+
+static void buffer_create_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+}
+
+// Destination buffer and source data of the copy benchmarks
+static int copy_initialize(compute_example_context_t* context)
+{
+  const uint32_t size = microbenchmark_get_current()->param;
+  state.buffer        = wgpu_create_buffer(
+    context->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = size,
+    });
+  state.data = malloc(size);
+  microbenchmark_fill_data(state.data, size);
+  context->work_per_iteration = size;
+  context->work_unit          = "bytes";
+  return 0;
+}
+
+static void record_copy_record(compute_example_context_t* context,
+                               WGPUCommandEncoder cmd_enc)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  // The copy is recorded into the command encoder of the context
+  WGPUCommandEncoder context_cmd_enc = wgpu_context->cmd_enc;
+  wgpu_context->cmd_enc              = cmd_enc;
+  wgpu_record_copy_data_to_buffer(wgpu_context, &state.buffer, 0,
+                                  state.buffer.size, state.data,
+                                  state.buffer.size);
+  wgpu_context->cmd_enc = context_cmd_enc;
+}
+
+static void queue_write_record(compute_example_context_t* context,
+                               WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  wgpu_queue_write_buffer(context->wgpu_context, state.buffer.buffer, 0,
+                          state.data, state.buffer.size);
+}
+
+static void copy_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  WGPU_RELEASE_RESOURCE(Buffer, state.buffer.buffer)
+  free(state.data);
+  state.data = NULL;
+}
+
+#define COPY_BENCHMARK(name, record, size)                                     \
+  {                                                                            \
+    name, size, 0, 0, &copy_initialize, &record, &copy_destroy                 \
+  }
+
+static const microbenchmark_t benchmarks[] = {
+  {"buffer_create", 0, 0, 0, &buffer_create_initialize, &buffer_create_record,
+   &buffer_create_destroy},
+  COPY_BENCHMARK("record_copy_256b", record_copy_record, 256u),
+  COPY_BENCHMARK("record_copy_4kb", record_copy_record, 4096u),
+  COPY_BENCHMARK("record_copy_64kb", record_copy_record, 65536u),
+  COPY_BENCHMARK("record_copy_1mb", record_copy_record, 1048576u),
+  COPY_BENCHMARK("record_copy_16mb", record_copy_record, 16777216u),
+  COPY_BENCHMARK("record_copy_64mb", record_copy_record, 67108864u),
+  COPY_BENCHMARK("queue_write_256b", queue_write_record, 256u),
+  COPY_BENCHMARK("queue_write_4kb", queue_write_record, 4096u),
+  COPY_BENCHMARK("queue_write_64kb", queue_write_record, 65536u),
+  COPY_BENCHMARK("queue_write_1mb", queue_write_record, 1048576u),
+  COPY_BENCHMARK("queue_write_16mb", queue_write_record, 16777216u),
+  COPY_BENCHMARK("queue_write_64mb", queue_write_record, 67108864u),
+};
+
+microbenchmark_list_t buffer_microbenchmarks(void)
+{
+  return (microbenchmark_list_t){
+    .benchmarks = benchmarks,
+    .count      = (uint32_t)ARRAY_SIZE(benchmarks),
+  };
+}
@@ -0,0 +1,194 @@
+#include "microbenchmarks.h"
+
+#include "../webgpu/depth_prepass.h"
+#include "../webgpu/gltf_model.h"
+
+/* -------------------------------------------------------------------------- *
+ * glTF micro-benchmarks
+ *
+ * - gltf_load: wgpu_gltf_model_load_from_file and wgpu_gltf_model_destroy of
+ *   the animated CesiumMan model
+ * - gltf_animation_update: gltf_model_update_animation of its first animation
+ *   at a fixed time step
+ * - gltf_draw_encode: wgpu_depth_prepass_draw_gltf_model of the Sponza model
+ *   into a render pass of a depth texture
+ * -------------------------------------------------------------------------- */
+
+#define ANIMATED_MODEL_FILENAME "models/CesiumMan/glTF/CesiumMan.gltf"
+#define SCENE_MODEL_FILENAME "models/Sponza/glTF/Sponza.gltf"
+#define DEPTH_FORMAT WGPUTextureFormat_Depth24PlusStencil8
+#define DEPTH_SIZE 1024u
+#define ANIMATION_TIME_STEP (1.0f / 60.0f)
+
+static struct {
+  struct gltf_model_t* model;
+  WGPUBindGroupLayout nodes_bind_group_layout;
+  wgpu_depth_prepass_t* depth_prepass;
+  WGPUTexture depth_texture;
+  WGPUTextureView depth_view;
+} state = {0};
+
+static struct gltf_model_t* load_model(wgpu_context_t* wgpu_context,
+                                       const char* filename,
+                                       uint32_t file_loading_flags)
+{
+  return wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
+    .wgpu_context       = wgpu_context,
+    .filename           = filename,
+    .file_loading_flags = file_loading_flags,
+    .scale              = 1.0f,
+  });
+}
+
+static int load_initialize(compute_example_context_t* context)
+{
+  context->work_per_iteration = 1.0;
+  context->work_unit          = "models";
+  return 0;
+}
+
+static void load_record(compute_example_context_t* context,
+                        WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  struct gltf_model_t* model
+    = load_model(context->wgpu_context, ANIMATED_MODEL_FILENAME, 0);
+  ASSERT(model != NULL);
+  wgpu_gltf_model_destroy(model);
+}
+
+static int animation_initialize(compute_example_context_t* context)
+{
+  state.model = load_model(context->wgpu_context, ANIMATED_MODEL_FILENAME, 0);
+  if (state.model == NULL) {
+    return 1;
+  }
+  context->work_per_iteration = 1.0;
+  context->work_unit          = "updates";
+  return 0;
+}
+
+static void animation_record(compute_example_context_t* context,
+                             WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  gltf_model_update_animation(state.model, 0,
+                              context->iteration * ANIMATION_TIME_STEP);
+}
+
+// Depth-only pipeline and depth target of the draw benchmark, the view of the
+// camera is fixed
+static int draw_encode_initialize(compute_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  state.model = load_model(wgpu_context, SCENE_MODEL_FILENAME,
+                           WGPU_GLTF_FileLoadingFlags_PositionStream);
+  if (state.model == NULL) {
+    return 1;
+  }
+
+  // Binding 0: Uniform buffer (Vertex shader) => Node matrix
+  state.nodes_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device,
+    &(WGPUBindGroupLayoutDescriptor){
+      .entryCount = 1,
+      .entries    = &(WGPUBindGroupLayoutEntry){
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Vertex,
+        .buffer     = (WGPUBufferBindingLayout){
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(mat4),
+        },
+      },
+    });
+  ASSERT(state.nodes_bind_group_layout != NULL);
+  wgpu_gltf_model_prepare_nodes_bind_group(state.model,
+                                           state.nodes_bind_group_layout);
+
+  state.depth_prepass = wgpu_depth_prepass_create(
+    wgpu_context, &(wgpu_depth_prepass_desc_t){
+                    .depth_format            = DEPTH_FORMAT,
+                    .model_bind_group_layout = state.nodes_bind_group_layout,
+                  });
+  mat4 projection = GLM_MAT4_IDENTITY_INIT;
+  mat4 view       = GLM_MAT4_IDENTITY_INIT;
+  glm_perspective(glm_rad(60.0f), 1.0f, 0.1f, 256.0f, projection);
+  glm_lookat((vec3){8.0f, 2.0f, 0.0f}, (vec3){0.0f, 2.0f, 0.0f},
+             (vec3){0.0f, 1.0f, 0.0f}, view);
+  wgpu_depth_prepass_update(state.depth_prepass, projection, view);
+
+  state.depth_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device, &(WGPUTextureDescriptor){
+                            .usage     = WGPUTextureUsage_RenderAttachment,
+                            .dimension = WGPUTextureDimension_2D,
+                            .size      = (WGPUExtent3D){
+                              .width              = DEPTH_SIZE,
+                              .height             = DEPTH_SIZE,
+                              .depthOrArrayLayers = 1,
+                            },
+                            .format        = DEPTH_FORMAT,
+                            .mipLevelCount = 1,
+                            .sampleCount   = 1,
+                          });
+  ASSERT(state.depth_texture != NULL);
+  state.depth_view = wgpuTextureCreateView(state.depth_texture, NULL);
+  ASSERT(state.depth_view != NULL);
+
+  context->work_per_iteration = 1.0;
+  context->work_unit          = "passes";
+  return 0;
+}
+
+static void draw_encode_record(compute_example_context_t* context,
+                               WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(context);
+  WGPURenderPassDepthStencilAttachment depth_stencil_attachment = {
+    .view            = state.depth_view,
+    .depthLoadOp     = WGPULoadOp_Clear,
+    .depthStoreOp    = WGPUStoreOp_Store,
+    .depthClearValue = 1.0f,
+    .stencilLoadOp   = WGPULoadOp_Clear,
+    .stencilStoreOp  = WGPUStoreOp_Store,
+  };
+  WGPURenderPassEncoder pass_encoder = wgpuCommandEncoderBeginRenderPass(
+    cmd_enc, &(WGPURenderPassDescriptor){
+               .colorAttachmentCount   = 0,
+               .depthStencilAttachment = &depth_stencil_attachment,
+             });
+  wgpu_depth_prepass_draw_gltf_model(state.depth_prepass, pass_encoder,
+                                     state.model, NULL);
+  wgpuRenderPassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, pass_encoder)
+}
+
+static void gltf_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  wgpu_depth_prepass_release(state.depth_prepass);
+  state.depth_prepass = NULL;
+  WGPU_RELEASE_RESOURCE(TextureView, state.depth_view)
+  WGPU_RELEASE_RESOURCE(Texture, state.depth_texture)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, state.nodes_bind_group_layout)
+  if (state.model != NULL) {
+    wgpu_gltf_model_destroy(state.model);
+    state.model = NULL;
+  }
+}
+
+// Loading reads and uploads the whole model, fewer iterations are measured
+static const microbenchmark_t benchmarks[] = {
+  {"gltf_load", 0, 2, 20, &load_initialize, &load_record, &gltf_destroy},
+  {"gltf_animation_update", 0, 0, 0, &animation_initialize, &animation_record,
+   &gltf_destroy},
+  {"gltf_draw_encode", 0, 0, 0, &draw_encode_initialize, &draw_encode_record,
+   &gltf_destroy},
+};
+
+microbenchmark_list_t gltf_microbenchmarks(void)
+{
+  return (microbenchmark_list_t){
+    .benchmarks = benchmarks,
+    .count      = (uint32_t)ARRAY_SIZE(benchmarks),
+  };
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/api.h"
+#include "../core/argparse.h"
+#include "microbenchmarks.h"
+
+#define DEFAULT_BENCHMARK_OUTPUT "wgpu_benchmarks.json"
+#define MAX_ADDED_ARGUMENT_COUNT 3u
+
+static const microbenchmark_t* current_benchmark = NULL;
+static const char* replay_trace                  = NULL;
+
+const microbenchmark_t* microbenchmark_get_current(void)
+{
+  return current_benchmark;
+}
+
+const char* microbenchmark_get_replay_trace(void)
+{
+  return replay_trace;
+}
+
+// xorshift32 with a fixed seed, the same bytes on every run
+void microbenchmark_fill_data(void* data, uint32_t size)
+{
+  uint8_t* bytes = (uint8_t*)data;
+  uint32_t state = 0x9e3779b9u;
+  for (uint32_t i = 0; i < size; ++i) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    bytes[i] = (uint8_t)state;
+  }
+}
+
+/*
+ * Runs a benchmark as compute-only example, with the output file and the
+ * iteration counts of the benchmark unless they are given on the command line.
+ */
+static int run_benchmark(int argc, char* argv[],
+                         const microbenchmark_t* benchmark,
+                         const benchmark_settings_t* given)
+{
+  char warmup_frames[32] = {0}, frames[32] = {0};
+  char** benchmark_argv
+    = (char**)malloc((argc + MAX_ADDED_ARGUMENT_COUNT) * sizeof(char*));
+  memcpy(benchmark_argv, argv, argc * sizeof(char*));
+  int benchmark_argc = argc;
+  if (given->output_file == NULL) {
+    benchmark_argv[benchmark_argc++]
+      = "--benchmark-output=" DEFAULT_BENCHMARK_OUTPUT;
+  }
+  if (benchmark->warmup_frame_count > 0 && given->warmup_frame_count == 0) {
+    snprintf(warmup_frames, sizeof(warmup_frames), "--warmup-frames=%u",
+             benchmark->warmup_frame_count);
+    benchmark_argv[benchmark_argc++] = warmup_frames;
+  }
+  if (benchmark->frame_count > 0 && given->frame_count == 0) {
+    snprintf(frames, sizeof(frames), "--frames=%u", benchmark->frame_count);
+    benchmark_argv[benchmark_argc++] = frames;
+  }
+
+  current_benchmark = benchmark;
+  const int status  = compute_example_run(
+    benchmark_argc, benchmark_argv,
+    &(compute_refexport_t){
+      .title           = benchmark->name,
+      .initialize_func = benchmark->initialize_func,
+      .record_func     = benchmark->record_func,
+      .destroy_func    = benchmark->destroy_func,
+    });
+  current_benchmark = NULL;
+  free(benchmark_argv);
+  return status;
+}
+
+int main(int argc, char* argv[])
+{
+  initialize_default_path();
+
+  const char* filter = NULL;
+  int list = 0, warmup_frame_count = 0, frame_count = 0;
+  const char* benchmark_output = NULL;
+  struct argparse_option options[] = {
+    OPT_BOOLEAN('?', "help", NULL, "show this help message and exit",
+                argparse_help_cb, 0, OPT_NONEG),
+    OPT_GROUP("Options"),
+    OPT_STRING('f', "filter", &filter,
+               "runs the benchmarks whose name contains the filter", NULL, 0,
+               0),
+    OPT_BOOLEAN('l', "list", &list, "lists the benchmarks and exits", NULL, 0,
+                0),
+    OPT_GROUP("Benchmark options"),
+    OPT_INTEGER(0, "warmup-frames", &warmup_frame_count,
+                "number of warm-up iterations (default: 60)", NULL, 0, 0),
+    OPT_INTEGER(0, "frames", &frame_count,
+                "number of measured iterations (default: 600)", NULL, 0, 0),
+    OPT_STRING('o', "benchmark-output", &benchmark_output,
+               "benchmark output file, .json (one object per line) or .csv "
+               "(default: " DEFAULT_BENCHMARK_OUTPUT ")",
+               NULL, 0, 0),
+    OPT_STRING(0, "replay-trace", &replay_trace,
+               "API trace captured with --api-trace, replayed by the "
+               "api_trace_replay benchmark",
+               NULL, 0, 0),
+    OPT_END(),
+  };
+
+  struct argparse argparse;
+  const char* const usages[] = {
+    "wgpu_benchmarks [options]",
+    NULL,
+  };
+  argparse_init(&argparse, options, usages, ARGPARSE_IGNORE_UNKNOWN_ARGS);
+  argparse_describe(
+    &argparse, "\nWebGPU helper layer micro-benchmarks.",
+    "\nRuns the micro-benchmarks on a device without window and appends "
+    "their results to the benchmark output file. The adapter options of the "
+    "examples apply as well.");
+  char** argv_cpy = argv_copy(argc, argv);
+  argparse_parse(&argparse, argc, (const char**)argv_cpy);
+  free(argv_cpy);
+  // Options given on the command line, passed on to the benchmarks as is
+  const benchmark_settings_t given = {
+    .warmup_frame_count = (uint32_t)MAX(warmup_frame_count, 0),
+    .frame_count        = (uint32_t)MAX(frame_count, 0),
+    .output_file        = benchmark_output,
+  };
+
+  const microbenchmark_list_t lists[5] = {
+    buffer_microbenchmarks(),
+    texture_microbenchmarks(),
+    shader_microbenchmarks(),
+    gltf_microbenchmarks(),
+    trace_microbenchmarks(),
+  };
+  int status         = EXIT_SUCCESS;
+  uint32_t run_count = 0;
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(lists); ++i) {
+    for (uint32_t j = 0; j < lists[i].count; ++j) {
+      const microbenchmark_t* benchmark = &lists[i].benchmarks[j];
+      if (filter != NULL && strstr(benchmark->name, filter) == NULL) {
+        continue;
+      }
+      ++run_count;
+      if (list) {
+        printf("%s\n", benchmark->name);
+      }
+      else if (run_benchmark(argc, argv, benchmark, &given) != 0) {
+        status = EXIT_FAILURE;
+      }
+    }
+  }
+
+  if (run_count == 0) {
+    fprintf(stderr, "No benchmark matches the filter: %s\n", filter);
+    return EXIT_FAILURE;
+  }
+  return status;
+}
@@ -0,0 +1,51 @@
+#ifndef MICROBENCHMARKS_H
+#define MICROBENCHMARKS_H
+
+#include "../examples/example_base.h"
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU helper layer micro-benchmarks
+ *
+ * Every micro-benchmark is a compute-only example, see compute_example_run:
+ * the helper is called a number of warm-up and measured iterations on a device
+ * without a window, every iteration is timed up to the completion of its GPU
+ * work. The data is deterministic, so that runs compare across commits. The
+ * results are appended, one JSON object per benchmark, to the file of
+ * --benchmark-output, wgpu_benchmarks.json by default.
+ * -------------------------------------------------------------------------- */
+
+typedef struct microbenchmark_t {
+  const char* name;
+  /* Variant of the benchmark, e.g. the size in bytes of the copied data */
+  uint32_t param;
+  /* Iteration counts unless set with --warmup-frames / --frames, 0 selects
+   * the defaults of the benchmark mode */
+  uint32_t warmup_frame_count;
+  uint32_t frame_count;
+  compute_initializefunc_t* initialize_func;
+  compute_recordfunc_t* record_func;
+  compute_destroyfunc_t* destroy_func;
+} microbenchmark_t;
+
+typedef struct microbenchmark_list_t {
+  const microbenchmark_t* benchmarks;
+  uint32_t count;
+} microbenchmark_list_t;
+
+/* Benchmark being run, e.g. for its parameter */
+const microbenchmark_t* microbenchmark_get_current(void);
+
+/* API trace replayed by the trace benchmarks, set with --replay-trace */
+const char* microbenchmark_get_replay_trace(void);
+
+/* Fills data with a deterministic pattern */
+void microbenchmark_fill_data(void* data, uint32_t size);
+
+/* Benchmarks of the helper areas */
+microbenchmark_list_t buffer_microbenchmarks(void);
+microbenchmark_list_t texture_microbenchmarks(void);
+microbenchmark_list_t shader_microbenchmarks(void);
+microbenchmark_list_t gltf_microbenchmarks(void);
+microbenchmark_list_t trace_microbenchmarks(void);
+
+#endif
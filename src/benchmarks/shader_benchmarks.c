@@ -0,0 +1,102 @@
+#include "microbenchmarks.h"
+
+#include <stdio.h>
+
+/* -------------------------------------------------------------------------- *
+ * Shader micro-benchmarks
+ *
+ * - shader_module_cached: wgpu_create_shader_module of the same WGSL source,
+ *   served by the shader module cache of the context after the first call
+ * - shader_module_uncached: wgpu_create_shader_module_from_wgsl, the source
+ *   changes every iteration so that no layer below caches the module either
+ * -------------------------------------------------------------------------- */
+
+#define SHADER_MODULE_COUNT 16u
+
+// clang-format off
+static const char* shader_wgsl = CODE(
+  struct Particle {
+    position : vec4<f32>,
+    velocity : vec4<f32>,
+  };
+
+  @group(0) @binding(0) var<storage, read_write> particles : array<Particle>;
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= arrayLength(&particles)) {
+      return;
+    }
+    var particle = particles[index];
+    let gravity = vec4<f32>(0.0, -0.01, 0.0, 0.0);
+    particle.velocity = particle.velocity * 0.99 + gravity;
+    particle.position = particle.position + particle.velocity;
+    particles[index] = particle;
+  }
+);
+// clang-format on
+
+static char shader_source[2048];
+
+// The leading comment makes the source unique
+static void format_shader_source(uint32_t iteration, uint32_t module)
+{
+  snprintf(shader_source, sizeof(shader_source),
+           "// Iteration %u, module %u\n%s", iteration, module, shader_wgsl);
+}
+
+static int shader_initialize(compute_example_context_t* context)
+{
+  format_shader_source(0, 0);
+  context->work_per_iteration = SHADER_MODULE_COUNT;
+  context->work_unit          = "modules";
+  return 0;
+}
+
+static void cached_record(compute_example_context_t* context,
+                          WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  for (uint32_t i = 0; i < SHADER_MODULE_COUNT; ++i) {
+    WGPUShaderModule module = wgpu_create_shader_module(
+      context->wgpu_context, &(wgpu_shader_desc_t){
+                               .wgsl_code.source = shader_source,
+                             });
+    ASSERT(module != NULL);
+    WGPU_RELEASE_RESOURCE(ShaderModule, module)
+  }
+}
+
+static void uncached_record(compute_example_context_t* context,
+                            WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  for (uint32_t i = 0; i < SHADER_MODULE_COUNT; ++i) {
+    format_shader_source(context->iteration, i);
+    WGPUShaderModule module = wgpu_create_shader_module_from_wgsl(
+      context->wgpu_context->device, shader_source);
+    ASSERT(module != NULL);
+    WGPU_RELEASE_RESOURCE(ShaderModule, module)
+  }
+}
+
+static void shader_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+}
+
+static const microbenchmark_t benchmarks[] = {
+  {"shader_module_cached", 0, 0, 0, &shader_initialize, &cached_record,
+   &shader_destroy},
+  {"shader_module_uncached", 0, 0, 0, &shader_initialize, &uncached_record,
+   &shader_destroy},
+};
+
+microbenchmark_list_t shader_microbenchmarks(void)
+{
+  return (microbenchmark_list_t){
+    .benchmarks = benchmarks,
+    .count      = (uint32_t)ARRAY_SIZE(benchmarks),
+  };
+}
@@ -0,0 +1,137 @@
+#include "microbenchmarks.h"
+
+/* -------------------------------------------------------------------------- *
+ * Texture micro-benchmarks
+ *
+ * - upload_<format>: wgpu_image_to_texure of a 1024x1024 image with 1, 2 and
+ *   4 channels per texel
+ * - mipmap_compute: wgpu_mipmap_generator_generate_mipmap of a rgba8unorm
+ *   texture, written in place by the compute path
+ * - mipmap_render: the same for a bgra8unorm texture, for which the generator
+ *   falls back to its render path
+ * -------------------------------------------------------------------------- */
+
+#define TEXTURE_SIZE 1024u
+#define TEXTURE_MIP_LEVEL_COUNT 11u /* down to 1x1 */
+
+static struct {
+  WGPUTexture texture;
+  WGPUTextureDescriptor texture_desc;
+  wgpu_mipmap_generator_t* mipmap_generator;
+  uint32_t channels;
+  void* pixels;
+} state = {0};
+
+// Texture of the format of the benchmark, param is the format
+static void create_texture(wgpu_context_t* wgpu_context,
+                           WGPUTextureUsage usage, uint32_t mip_level_count)
+{
+  state.texture_desc = (WGPUTextureDescriptor){
+    .usage         = WGPUTextureUsage_CopyDst | usage,
+    .dimension     = WGPUTextureDimension_2D,
+    .size          = (WGPUExtent3D){
+      .width              = TEXTURE_SIZE,
+      .height             = TEXTURE_SIZE,
+      .depthOrArrayLayers = 1,
+    },
+    .format        = (WGPUTextureFormat)microbenchmark_get_current()->param,
+    .mipLevelCount = mip_level_count,
+    .sampleCount   = 1,
+  };
+  state.texture
+    = wgpuDeviceCreateTexture(wgpu_context->device, &state.texture_desc);
+  ASSERT(state.texture != NULL);
+
+  switch (state.texture_desc.format) {
+    case WGPUTextureFormat_R8Unorm:
+      state.channels = 1;
+      break;
+    case WGPUTextureFormat_RG8Unorm:
+      state.channels = 2;
+      break;
+    default:
+      state.channels = 4;
+      break;
+  }
+  const uint32_t size = TEXTURE_SIZE * TEXTURE_SIZE * state.channels;
+  state.pixels        = malloc(size);
+  microbenchmark_fill_data(state.pixels, size);
+}
+
+static int upload_initialize(compute_example_context_t* context)
+{
+  create_texture(context->wgpu_context, WGPUTextureUsage_TextureBinding, 1);
+  context->work_per_iteration
+    = (double)TEXTURE_SIZE * TEXTURE_SIZE * state.channels;
+  context->work_unit = "bytes";
+  return 0;
+}
+
+static void upload_record(compute_example_context_t* context,
+                          WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  wgpu_image_to_texure(context->wgpu_context, state.texture, state.pixels,
+                       state.texture_desc.size, state.channels);
+}
+
+// The storage and render attachment usages let the generator write the levels
+// in place, without temporary textures
+static int mipmap_initialize(compute_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  const WGPUTextureUsage usage
+    = WGPUTextureUsage_TextureBinding
+      | (microbenchmark_get_current()->param == WGPUTextureFormat_RGBA8Unorm ?
+           WGPUTextureUsage_StorageBinding :
+           WGPUTextureUsage_RenderAttachment);
+  create_texture(wgpu_context, usage, TEXTURE_MIP_LEVEL_COUNT);
+  wgpu_image_to_texure(wgpu_context, state.texture, state.pixels,
+                       state.texture_desc.size, state.channels);
+  state.mipmap_generator      = wgpu_mipmap_generator_create(wgpu_context);
+  context->work_per_iteration = (double)TEXTURE_SIZE * TEXTURE_SIZE;
+  context->work_unit          = "texels";
+  return 0;
+}
+
+static void mipmap_record(compute_example_context_t* context,
+                          WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(context);
+  UNUSED_VAR(cmd_enc);
+  wgpu_mipmap_generator_generate_mipmap(state.mipmap_generator, state.texture,
+                                        &state.texture_desc);
+}
+
+static void texture_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  if (state.mipmap_generator != NULL) {
+    wgpu_mipmap_generator_destroy(state.mipmap_generator);
+    state.mipmap_generator = NULL;
+  }
+  WGPU_RELEASE_RESOURCE(Texture, state.texture)
+  free(state.pixels);
+  state.pixels = NULL;
+}
+
+static const microbenchmark_t benchmarks[] = {
+  {"upload_r8unorm", WGPUTextureFormat_R8Unorm, 0, 0, &upload_initialize,
+   &upload_record, &texture_destroy},
+  {"upload_rg8unorm", WGPUTextureFormat_RG8Unorm, 0, 0, &upload_initialize,
+   &upload_record, &texture_destroy},
+  {"upload_rgba8unorm", WGPUTextureFormat_RGBA8Unorm, 0, 0, &upload_initialize,
+   &upload_record, &texture_destroy},
+  {"mipmap_compute", WGPUTextureFormat_RGBA8Unorm, 0, 0, &mipmap_initialize,
+   &mipmap_record, &texture_destroy},
+  {"mipmap_render", WGPUTextureFormat_BGRA8Unorm, 0, 0, &mipmap_initialize,
+   &mipmap_record, &texture_destroy},
+};
+
+microbenchmark_list_t texture_microbenchmarks(void)
+{
+  return (microbenchmark_list_t){
+    .benchmarks = benchmarks,
+    .count      = (uint32_t)ARRAY_SIZE(benchmarks),
+  };
+}
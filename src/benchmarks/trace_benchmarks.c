@@ -0,0 +1,61 @@
+#include "microbenchmarks.h"
+
+/* -------------------------------------------------------------------------- *
+ * API trace micro-benchmarks, with --replay-trace
+ *
+ * - api_trace_replay: wgpu_api_trace_replay_frame of the captured frames in
+ *   turn, the buffer and texture creation, the queue writes and the passes,
+ *   draws and dispatches of the submits of a frame, with stand-in pipelines
+ *   and without the logic of the example which captured it
+ * -------------------------------------------------------------------------- */
+
+static struct {
+  wgpu_api_trace_replay_t* replay;
+} state = {0};
+
+static int replay_initialize(compute_example_context_t* context)
+{
+  state.replay = wgpu_api_trace_replay_create(
+    context->wgpu_context, microbenchmark_get_replay_trace());
+  if (state.replay == NULL) {
+    return 1;
+  }
+  context->work_per_iteration = 1.0;
+  context->work_unit          = "frames";
+  return 0;
+}
+
+static void replay_record(compute_example_context_t* context,
+                          WGPUCommandEncoder cmd_enc)
+{
+  UNUSED_VAR(cmd_enc);
+  const uint32_t frame_count
+    = wgpu_api_trace_replay_get_frame_count(state.replay);
+  if (frame_count > 0) {
+    wgpu_api_trace_replay_frame(state.replay,
+                                context->iteration % frame_count);
+  }
+}
+
+static void replay_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  wgpu_api_trace_replay_release(state.replay);
+  state.replay = NULL;
+}
+
+static const microbenchmark_t benchmarks[] = {
+  {"api_trace_replay", 0, 0, 0, &replay_initialize, &replay_record,
+   &replay_destroy},
+};
+
+microbenchmark_list_t trace_microbenchmarks(void)
+{
+  // Only run on a given trace
+  return (microbenchmark_list_t){
+    .benchmarks = benchmarks,
+    .count      = microbenchmark_get_replay_trace() != NULL ?
+                    (uint32_t)ARRAY_SIZE(benchmarks) :
+                    0,
+  };
+}
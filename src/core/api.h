@@ -1,14 +1,24 @@
 #ifndef CORE_API_H
 #define CORE_API_H
 
+#include "arena.h"
+#include "benchmark.h"
+#include "block_compression.h"
 #include "camera.h"
 #include "file.h"
 #include "frustum.h"
 #include "input.h"
+#include "job_system.h"
 #include "log.h"
 #include "macro.h"
 #include "math.h"
+#include "mesh_cache.h"
+#include "mesh_decoder.h"
+#include "mesh_optimizer.h"
 #include "platform.h"
+#include "profiler.h"
+#include "random.h"
+#include "transform_batch.h"
 #include "utils.h"
 #include "window.h"
 
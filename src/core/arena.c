@@ -0,0 +1,80 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+#include "macro.h"
+
+#define LINEAR_ARENA_ALIGNMENT 16u
+
+/* Allocation that did not fit into the block, freed by the next reset */
+struct linear_arena_overflow_t {
+  linear_arena_overflow_t* next;
+};
+
+static size_t linear_arena_align(size_t size)
+{
+  const size_t mask = LINEAR_ARENA_ALIGNMENT - 1;
+  return (size + mask) & ~mask;
+}
+
+void linear_arena_init(linear_arena_t* arena, size_t capacity)
+{
+  arena->capacity              = linear_arena_align(capacity);
+  arena->data                  = malloc(MAX(arena->capacity, (size_t)1));
+  arena->offset                = 0;
+  arena->used                  = 0;
+  arena->overflow              = NULL;
+  arena->heap_allocation_count = 1;
+  ASSERT(arena->data != NULL);
+}
+
+void linear_arena_release(linear_arena_t* arena)
+{
+  if (arena == NULL) {
+    return;
+  }
+  linear_arena_reset(arena);
+  free(arena->data);
+  arena->data     = NULL;
+  arena->capacity = 0;
+}
+
+void* linear_arena_alloc(linear_arena_t* arena, size_t size)
+{
+  size = linear_arena_align(MAX(size, (size_t)1));
+  arena->used += size;
+  if (size <= arena->capacity - arena->offset) {
+    void* memory = arena->data + arena->offset;
+    arena->offset += size;
+    return memory;
+  }
+
+  /* The header keeps the alignment of the allocation */
+  const size_t header_size
+    = linear_arena_align(sizeof(linear_arena_overflow_t));
+  linear_arena_overflow_t* overflow = malloc(header_size + size);
+  ASSERT(overflow != NULL);
+  overflow->next  = arena->overflow;
+  arena->overflow = overflow;
+  ++arena->heap_allocation_count;
+  return (uint8_t*)overflow + header_size;
+}
+
+void linear_arena_reset(linear_arena_t* arena)
+{
+  if (arena->overflow != NULL) {
+    while (arena->overflow != NULL) {
+      linear_arena_overflow_t* next = arena->overflow->next;
+      free(arena->overflow);
+      arena->overflow = next;
+    }
+    /* Room for all allocations of the last frame, plus half of it */
+    free(arena->data);
+    arena->capacity = linear_arena_align(arena->used + arena->used / 2);
+    arena->data     = malloc(arena->capacity);
+    ASSERT(arena->data != NULL);
+    ++arena->heap_allocation_count;
+  }
+  arena->offset = 0;
+  arena->used   = 0;
+}
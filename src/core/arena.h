@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Linear allocator for the scratch memory of a frame.
+ *
+ * Allocations bump an offset into a single block and are all freed at once by
+ * linear_arena_reset, there is no per-allocation free. Allocations that do
+ * not fit into the block get a heap block of their own until the next reset,
+ * which then grows the block to the peak usage so that later frames of the
+ * same size no longer touch the heap. Not thread safe.
+ */
+typedef struct linear_arena_overflow_t linear_arena_overflow_t;
+
+typedef struct linear_arena_t {
+  uint8_t* data;
+  size_t capacity;
+  size_t offset; /* first free byte */
+  /* Bytes allocated since the last reset, the block and the overflow ones */
+  size_t used;
+  linear_arena_overflow_t* overflow;
+  /* Number of heap allocations of the arena, for the steady-state checks */
+  uint64_t heap_allocation_count;
+} linear_arena_t;
+
+/* Linear arena initialization/releasing */
+void linear_arena_init(linear_arena_t* arena, size_t capacity);
+void linear_arena_release(linear_arena_t* arena);
+
+/* Returns size bytes aligned to 16 bytes, valid until the next reset */
+void* linear_arena_alloc(linear_arena_t* arena, size_t size);
+/* Frees all allocations, grows the block when the last ones overflowed it */
+void linear_arena_reset(linear_arena_t* arena);
+
+#endif /* ARENA_H */
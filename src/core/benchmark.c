@@ -0,0 +1,257 @@
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file.h"
+#include "log.h"
+#include "macro.h"
+
+typedef enum benchmark_metric_enum {
+  Benchmark_Metric_CPU_Time     = 0,
+  Benchmark_Metric_GPU_Time     = 1,
+  Benchmark_Metric_Present_Time = 2,
+  Benchmark_Metric_Latency      = 3,
+  Benchmark_Metric_Count        = 4,
+} benchmark_metric_enum;
+
+static const char* const benchmark_metric_names[Benchmark_Metric_Count] = {
+  "cpu_ms",     /* Benchmark_Metric_CPU_Time */
+  "gpu_ms",     /* Benchmark_Metric_GPU_Time */
+  "present_ms", /* Benchmark_Metric_Present_Time */
+  "latency_ms", /* Benchmark_Metric_Latency */
+};
+
+typedef struct benchmark_statistics_t {
+  float min;
+  float avg;
+  float p50;
+  float p95;
+  float p99;
+} benchmark_statistics_t;
+
+typedef struct benchmark_counter_t {
+  char name[STRMAX];
+  double sum;
+  uint32_t sample_count;
+} benchmark_counter_t;
+
+struct benchmark {
+  char name[STRMAX];
+  benchmark_settings_t settings;
+  uint32_t recorded_frame_count; /* including warm-up frames */
+  float* samples[Benchmark_Metric_Count];
+  /* Latencies are only recorded for the frames consuming input */
+  uint32_t latency_count;
+  benchmark_counter_t counters[BENCHMARK_MAX_COUNTER_COUNT];
+  uint32_t counter_count;
+};
+
+benchmark_t* benchmark_create(const benchmark_settings_t* settings,
+                              const char* name)
+{
+  benchmark_t* benchmark = (benchmark_t*)malloc(sizeof(benchmark_t));
+  memset(benchmark, 0, sizeof(benchmark_t));
+
+  snprintf(benchmark->name, sizeof(benchmark->name), "%s", name);
+  benchmark->settings = *settings;
+  if (benchmark->settings.frame_count == 0) {
+    benchmark->settings.frame_count = BENCHMARK_DEFAULT_FRAME_COUNT;
+  }
+
+  for (uint32_t i = 0; i < Benchmark_Metric_Count; ++i) {
+    benchmark->samples[i]
+      = (float*)calloc(benchmark->settings.frame_count, sizeof(float));
+  }
+
+  return benchmark;
+}
+
+void benchmark_release(benchmark_t* benchmark)
+{
+  for (uint32_t i = 0; i < Benchmark_Metric_Count; ++i) {
+    free(benchmark->samples[i]);
+  }
+  free(benchmark);
+}
+
+void benchmark_record_frame(benchmark_t* benchmark, float cpu_time_ms,
+                            float gpu_time_ms, float present_time_ms)
+{
+  if (benchmark_is_done(benchmark)) {
+    return;
+  }
+
+  const uint32_t frame_index = benchmark->recorded_frame_count++;
+  if (frame_index < benchmark->settings.warmup_frame_count) {
+    return;
+  }
+
+  const uint32_t sample_index
+    = frame_index - benchmark->settings.warmup_frame_count;
+  benchmark->samples[Benchmark_Metric_CPU_Time][sample_index] = cpu_time_ms;
+  benchmark->samples[Benchmark_Metric_GPU_Time][sample_index] = gpu_time_ms;
+  benchmark->samples[Benchmark_Metric_Present_Time][sample_index]
+    = present_time_ms;
+}
+
+void benchmark_record_counter(benchmark_t* benchmark, const char* name,
+                              double value)
+{
+  /* The last recorded frame is a warm-up frame */
+  if (benchmark->recorded_frame_count
+      <= benchmark->settings.warmup_frame_count) {
+    return;
+  }
+
+  benchmark_counter_t* counter = NULL;
+  for (uint32_t i = 0; i < benchmark->counter_count; ++i) {
+    if (strcmp(benchmark->counters[i].name, name) == 0) {
+      counter = &benchmark->counters[i];
+      break;
+    }
+  }
+  if (counter == NULL) {
+    if (benchmark->counter_count == BENCHMARK_MAX_COUNTER_COUNT) {
+      return;
+    }
+    counter = &benchmark->counters[benchmark->counter_count++];
+    snprintf(counter->name, sizeof(counter->name), "%s", name);
+  }
+  counter->sum += value;
+  ++counter->sample_count;
+}
+
+static double benchmark_counter_average(const benchmark_counter_t* counter)
+{
+  return counter->sample_count > 0 ? counter->sum / counter->sample_count :
+                                     0.0;
+}
+
+void benchmark_record_latency(benchmark_t* benchmark, float latency_ms)
+{
+  if (benchmark->recorded_frame_count <= benchmark->settings.warmup_frame_count
+      || benchmark->latency_count == benchmark->settings.frame_count) {
+    return;
+  }
+
+  benchmark->samples[Benchmark_Metric_Latency][benchmark->latency_count++]
+    = latency_ms;
+}
+
+bool benchmark_is_done(benchmark_t* benchmark)
+{
+  return benchmark->recorded_frame_count
+         >= benchmark->settings.warmup_frame_count
+              + benchmark->settings.frame_count;
+}
+
+static int compare_float(const void* a, const void* b)
+{
+  const float fa = *(const float*)a, fb = *(const float*)b;
+  return (fa > fb) - (fa < fb);
+}
+
+/* Uses nearest-rank percentiles, sorts the samples in place */
+static benchmark_statistics_t compute_statistics(float* samples,
+                                                 uint32_t sample_count)
+{
+  benchmark_statistics_t statistics = {0};
+  if (sample_count == 0) {
+    return statistics;
+  }
+
+  qsort(samples, sample_count, sizeof(float), compare_float);
+  double sum = 0.0;
+  for (uint32_t i = 0; i < sample_count; ++i) {
+    sum += samples[i];
+  }
+#define PERCENTILE(p) samples[MIN(sample_count - 1, (sample_count * p) / 100)]
+  statistics.min = samples[0];
+  statistics.avg = (float)(sum / sample_count);
+  statistics.p50 = PERCENTILE(50);
+  statistics.p95 = PERCENTILE(95);
+  statistics.p99 = PERCENTILE(99);
+#undef PERCENTILE
+
+  return statistics;
+}
+
+void benchmark_write_results(benchmark_t* benchmark)
+{
+  const uint32_t sample_count = MIN(
+    benchmark->settings.frame_count,
+    benchmark->recorded_frame_count > benchmark->settings.warmup_frame_count ?
+      benchmark->recorded_frame_count - benchmark->settings.warmup_frame_count :
+      0);
+  benchmark_statistics_t statistics[Benchmark_Metric_Count];
+  for (uint32_t i = 0; i < Benchmark_Metric_Count; ++i) {
+    statistics[i] = compute_statistics(
+      benchmark->samples[i],
+      i == Benchmark_Metric_Latency ? benchmark->latency_count : sample_count);
+  }
+
+  const char* output_file = benchmark->settings.output_file;
+  const bool json
+    = output_file && filename_has_extension(output_file, "json");
+  /* Write the CSV header when the file is created */
+  const bool write_header = !json && output_file && !file_exists(output_file);
+  FILE* file = output_file ? fopen(output_file, "a") : stdout;
+  if (file == NULL) {
+    log_error("Could not open benchmark output file: %s", output_file);
+    return;
+  }
+
+  if (json) {
+    fprintf(file, "{\"example\": \"%s\", \"frames\": %u", benchmark->name,
+            sample_count);
+    for (uint32_t i = 0; i < Benchmark_Metric_Count; ++i) {
+      const benchmark_statistics_t* s = &statistics[i];
+      fprintf(file,
+              ", \"%s\": {\"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, "
+              "\"p95\": %.4f, \"p99\": %.4f}",
+              benchmark_metric_names[i], s->min, s->avg, s->p50, s->p95,
+              s->p99);
+    }
+    if (benchmark->counter_count > 0) {
+      fprintf(file, ", \"counters\": {");
+      for (uint32_t i = 0; i < benchmark->counter_count; ++i) {
+        const benchmark_counter_t* counter = &benchmark->counters[i];
+        fprintf(file, "%s\"%s\": %.1f", i > 0 ? ", " : "", counter->name,
+                benchmark_counter_average(counter));
+      }
+      fprintf(file, "}");
+    }
+    fprintf(file, "}\n");
+  }
+  else {
+    if (write_header || file == stdout) {
+      fprintf(file, "example,frames");
+      for (uint32_t i = 0; i < Benchmark_Metric_Count; ++i) {
+        const char* metric = benchmark_metric_names[i];
+        fprintf(file, ",%s_min,%s_avg,%s_p50,%s_p95,%s_p99", metric, metric,
+                metric, metric, metric);
+      }
+      fprintf(file, ",counters\n");
+    }
+    fprintf(file, "%s,%u", benchmark->name, sample_count);
+    for (uint32_t i = 0; i < Benchmark_Metric_Count; ++i) {
+      const benchmark_statistics_t* s = &statistics[i];
+      fprintf(file, ",%.4f,%.4f,%.4f,%.4f,%.4f", s->min, s->avg, s->p50,
+              s->p95, s->p99);
+    }
+    /* The counter averages as name=value pairs in a single column */
+    fprintf(file, ",\"");
+    for (uint32_t i = 0; i < benchmark->counter_count; ++i) {
+      const benchmark_counter_t* counter = &benchmark->counters[i];
+      fprintf(file, "%s%s=%.1f", i > 0 ? ";" : "", counter->name,
+              benchmark_counter_average(counter));
+    }
+    fprintf(file, "\"\n");
+  }
+
+  if (file != stdout) {
+    fclose(file);
+  }
+}
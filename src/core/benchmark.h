@@ -0,0 +1,60 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BENCHMARK_DEFAULT_WARMUP_FRAME_COUNT 60u
+#define BENCHMARK_DEFAULT_FRAME_COUNT 600u
+#define BENCHMARK_MAX_COUNTER_COUNT 64u
+
+/* Benchmark settings */
+typedef struct benchmark_settings_t {
+  bool enabled;
+  uint32_t warmup_frame_count;
+  uint32_t frame_count; /* number of measured frames */
+  const char* output_file; /* .json: one JSON object per line, CSV otherwise */
+} benchmark_settings_t;
+
+typedef struct benchmark benchmark_t;
+
+/* Benchmark creating/releasing */
+benchmark_t* benchmark_create(const benchmark_settings_t* settings,
+                              const char* name);
+void benchmark_release(benchmark_t* benchmark);
+
+/**
+ * @brief Records the timings of a single frame, timings recorded during the
+ * warm-up phase are discarded.
+ */
+void benchmark_record_frame(benchmark_t* benchmark, float cpu_time_ms,
+                            float gpu_time_ms, float present_time_ms);
+
+/**
+ * @brief Records the value of a named counter, e.g. a pipeline statistic, for
+ * the last recorded frame. Values recorded during the warm-up phase are
+ * discarded, the averages of the counters are written with the results.
+ */
+void benchmark_record_counter(benchmark_t* benchmark, const char* name,
+                              double value);
+
+/**
+ * @brief Records the latency from an input event to the completion of the
+ * frame which consumed it. Latencies of warm-up frames are discarded, at most
+ * frame_count latencies are kept.
+ */
+void benchmark_record_latency(benchmark_t* benchmark, float latency_ms);
+
+/**
+ * @brief Returns true once all the measured frames have been recorded.
+ */
+bool benchmark_is_done(benchmark_t* benchmark);
+
+/**
+ * @brief Appends min/avg/p50/p95/p99 statistics of the measured frames and of
+ * the recorded input latencies to the output file (or stdout when no output
+ * file is set), followed by the counter averages.
+ */
+void benchmark_write_results(benchmark_t* benchmark);
+
+#endif
@@ -0,0 +1,340 @@
+#include "block_compression.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macro.h"
+
+#define BLOCK_TEXEL_COUNT 16u
+
+/* BC7 interpolation weights of 4-bit indices */
+static const uint32_t bc7_weights4[16] = {
+  0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64,
+};
+
+uint32_t
+block_compression_get_block_bytes(block_compression_format_enum format)
+{
+  return format == BlockCompressionFormat_BC4 ? 8u : 16u;
+}
+
+size_t block_compression_get_image_size(block_compression_format_enum format,
+                                        uint32_t width, uint32_t height)
+{
+  const size_t blocks_x = (MAX(1u, width) + 3) / 4;
+  const size_t blocks_y = (MAX(1u, height) + 3) / 4;
+  return blocks_x * blocks_y * block_compression_get_block_bytes(format);
+}
+
+/* Gathers the 4x4 block at (x, y), repeating the edge texels */
+static void load_block(const uint8_t* pixels, uint32_t width, uint32_t height,
+                       uint32_t x, uint32_t y,
+                       uint8_t texels[BLOCK_TEXEL_COUNT][4])
+{
+  for (uint32_t j = 0; j < 4; ++j) {
+    const uint32_t py = MIN(y + j, height - 1);
+    for (uint32_t i = 0; i < 4; ++i) {
+      const uint32_t px = MIN(x + i, width - 1);
+      memcpy(texels[j * 4 + i], pixels + ((size_t)py * width + px) * 4, 4);
+    }
+  }
+}
+
+/* Bit writer of 128-bit blocks, least significant bit first */
+typedef struct block_bits_t {
+  uint8_t* data;
+  uint32_t position;
+} block_bits_t;
+
+static void block_bits_write(block_bits_t* bits, uint32_t value,
+                             uint32_t bit_count)
+{
+  for (uint32_t i = 0; i < bit_count; ++i, ++bits->position) {
+    if ((value >> i) & 1u) {
+      bits->data[bits->position / 8] |= (uint8_t)(1u << (bits->position % 8));
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- *
+ * BC4 / BC5
+ * -------------------------------------------------------------------------- */
+
+static void compress_bc4_block(const uint8_t texels[BLOCK_TEXEL_COUNT][4],
+                               uint32_t channel, uint8_t* block)
+{
+  uint8_t min_value = 255, max_value = 0;
+  for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i) {
+    min_value = MIN(min_value, texels[i][channel]);
+    max_value = MAX(max_value, texels[i][channel]);
+  }
+
+  memset(block, 0, 8);
+  block[0] = max_value;
+  block[1] = min_value;
+  if (max_value == min_value) {
+    return;
+  }
+
+  // Palette of the 8 value mode, entry 0 and 1 are the endpoints
+  int32_t palette[8] = {max_value, min_value};
+  for (int32_t i = 1; i < 7; ++i) {
+    palette[i + 1] = ((7 - i) * max_value + i * min_value + 3) / 7;
+  }
+  uint64_t indices = 0;
+  for (uint32_t i = 0; i < BLOCK_TEXEL_COUNT; ++i) {
+    const int32_t value = texels[i][channel];
+    uint32_t best_index = 0;
+    int32_t best_error  = 256;
+    for (uint32_t p = 0; p < 8; ++p) {
+      const int32_t error = abs(palette[p] - value);
+      if (error < best_error) {
+        best_error = error;
+        best_index = p;
+      }
+    }
+    indices |= (uint64_t)best_index << (3 * i);
+  }
+  for (uint32_t i = 0; i < 6; ++i) {
+    block[2 + i] = (uint8_t)(indices >> (8 * i));
+  }
+}
+
+/* -------------------------------------------------------------------------- *
+ * BC7 mode 6
+ * -------------------------------------------------------------------------- */
+
+typedef struct bc7_endpoints_t {
+  uint32_t color[2][4]; /* 7-bit per channel */
+  uint32_t pbit[2];
+} bc7_endpoints_t;
+
+static uint32_t bc7_endpoint_value(const bc7_endpoints_t* endpoints,
+                                   uint32_t e, uint32_t c)
+{
+  return (endpoints->color[e][c] << 1) | endpoints->pbit[e];
+}
+
+/* Quantizes an endpoint to 7 bits per channel and the p-bit of lower error */
+static void bc7_quantize_endpoint(const float value[4],
+                                  bc7_endpoints_t* endpoints, uint32_t e)
+{
+  float best_error = INFINITY;
+  for (uint32_t p = 0; p < 2; ++p) {
+    uint32_t color[4];
+    float error = 0.0f;
+    for (uint32_t c = 0; c < 4; ++c) {
+      const float q = roundf((value[c] - (float)p) * 0.5f);
+      color[c]      = (uint32_t)CLAMP(q, 0.0f, 127.0f);
+      const float d = (float)((color[c] << 1) | p) - value[c];
+      error += d * d;
+    }
+    if (error < best_error) {
+      best_error = error;
+      memcpy(endpoints->color[e], color, sizeof(color));
+      endpoints->pbit[e] = p;
+    }
+  }
+}
+
+/* Selects the closest palette entry per texel, returns the squared error */
+static uint32_t bc7_select_indices(const uint8_t texels[BLOCK_TEXEL_COUNT][4],
+                                   const bc7_endpoints_t* endpoints,
+                                   uint32_t indices[BLOCK_TEXEL_COUNT])
+{
+  uint32_t palette[16][4];
+  for (uint32_t i = 0; i < 16; ++i) {
+    const uint32_t w = bc7_weights4[i];
+    for (uint32_t c = 0; c < 4; ++c) {
+      palette[i][c] = ((64 - w) * bc7_endpoint_value(endpoints, 0, c)
+                       + w * bc7_endpoint_value(endpoints, 1, c) + 32)
+                      >> 6;
+    }
+  }
+  uint32_t total_error = 0;
+  for (uint32_t t = 0; t < BLOCK_TEXEL_COUNT; ++t) {
+    uint32_t best_error = UINT32_MAX;
+    for (uint32_t i = 0; i < 16; ++i) {
+      uint32_t error = 0;
+      for (uint32_t c = 0; c < 4; ++c) {
+        const int32_t d = (int32_t)palette[i][c] - (int32_t)texels[t][c];
+        error += (uint32_t)(d * d);
+      }
+      if (error < best_error) {
+        best_error = error;
+        indices[t] = i;
+      }
+    }
+    total_error += best_error;
+  }
+  return total_error;
+}
+
+/* Endpoints at the extent of the texels along their principal axis */
+static void bc7_fit_principal_axis(const uint8_t texels[BLOCK_TEXEL_COUNT][4],
+                                   float endpoints[2][4])
+{
+  float mean[4] = {0};
+  for (uint32_t t = 0; t < BLOCK_TEXEL_COUNT; ++t) {
+    for (uint32_t c = 0; c < 4; ++c) {
+      mean[c] += (float)texels[t][c] / (float)BLOCK_TEXEL_COUNT;
+    }
+  }
+  float covariance[4][4] = {0};
+  for (uint32_t t = 0; t < BLOCK_TEXEL_COUNT; ++t) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      for (uint32_t j = 0; j < 4; ++j) {
+        covariance[i][j] += ((float)texels[t][i] - mean[i])
+                            * ((float)texels[t][j] - mean[j]);
+      }
+    }
+  }
+
+  // Power iteration, starting from the diagonal
+  float axis[4] = {covariance[0][0], covariance[1][1], covariance[2][2],
+                   covariance[3][3]};
+  for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+    float next[4] = {0};
+    float length  = 0.0f;
+    for (uint32_t i = 0; i < 4; ++i) {
+      for (uint32_t j = 0; j < 4; ++j) {
+        next[i] += covariance[i][j] * axis[j];
+      }
+      length += next[i] * next[i];
+    }
+    if (length < 1e-6f) {
+      break;
+    }
+    length = 1.0f / sqrtf(length);
+    for (uint32_t i = 0; i < 4; ++i) {
+      axis[i] = next[i] * length;
+    }
+  }
+
+  float t_min = INFINITY, t_max = -INFINITY;
+  for (uint32_t t = 0; t < BLOCK_TEXEL_COUNT; ++t) {
+    float d = 0.0f;
+    for (uint32_t c = 0; c < 4; ++c) {
+      d += ((float)texels[t][c] - mean[c]) * axis[c];
+    }
+    t_min = MIN(t_min, d);
+    t_max = MAX(t_max, d);
+  }
+  for (uint32_t c = 0; c < 4; ++c) {
+    endpoints[0][c] = CLAMP(mean[c] + t_min * axis[c], 0.0f, 255.0f);
+    endpoints[1][c] = CLAMP(mean[c] + t_max * axis[c], 0.0f, 255.0f);
+  }
+}
+
+/* Least squares endpoints of the texels for the given indices, false when the
+ * indices don't determine them */
+static bool bc7_refine_endpoints(const uint8_t texels[BLOCK_TEXEL_COUNT][4],
+                                 const uint32_t indices[BLOCK_TEXEL_COUNT],
+                                 float endpoints[2][4])
+{
+  float a = 0.0f, b = 0.0f, c = 0.0f;
+  float x0[4] = {0}, x1[4] = {0};
+  for (uint32_t t = 0; t < BLOCK_TEXEL_COUNT; ++t) {
+    const float w1 = (float)bc7_weights4[indices[t]] / 64.0f;
+    const float w0 = 1.0f - w1;
+    a += w0 * w0;
+    b += w0 * w1;
+    c += w1 * w1;
+    for (uint32_t i = 0; i < 4; ++i) {
+      x0[i] += w0 * (float)texels[t][i];
+      x1[i] += w1 * (float)texels[t][i];
+    }
+  }
+  const float det = a * c - b * b;
+  if (fabsf(det) < 1e-6f) {
+    return false;
+  }
+  for (uint32_t i = 0; i < 4; ++i) {
+    endpoints[0][i] = CLAMP((c * x0[i] - b * x1[i]) / det, 0.0f, 255.0f);
+    endpoints[1][i] = CLAMP((a * x1[i] - b * x0[i]) / det, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+static void compress_bc7_block(const uint8_t texels[BLOCK_TEXEL_COUNT][4],
+                               uint8_t* block)
+{
+  float fitted[2][4];
+  bc7_fit_principal_axis(texels, fitted);
+  bc7_endpoints_t endpoints = {0};
+  bc7_quantize_endpoint(fitted[0], &endpoints, 0);
+  bc7_quantize_endpoint(fitted[1], &endpoints, 1);
+  uint32_t indices[BLOCK_TEXEL_COUNT];
+  uint32_t error = bc7_select_indices(texels, &endpoints, indices);
+
+  // One least squares pass, kept when it lowers the error
+  if (error > 0 && bc7_refine_endpoints(texels, indices, fitted)) {
+    bc7_endpoints_t refined = {0};
+    bc7_quantize_endpoint(fitted[0], &refined, 0);
+    bc7_quantize_endpoint(fitted[1], &refined, 1);
+    uint32_t refined_indices[BLOCK_TEXEL_COUNT];
+    const uint32_t refined_error
+      = bc7_select_indices(texels, &refined, refined_indices);
+    if (refined_error < error) {
+      endpoints = refined;
+      memcpy(indices, refined_indices, sizeof(indices));
+    }
+  }
+
+  // The most significant bit of the anchor index is implied 0, the endpoints
+  // are swapped otherwise
+  if (indices[0] >= 8) {
+    for (uint32_t c = 0; c < 4; ++c) {
+      const uint32_t color  = endpoints.color[0][c];
+      endpoints.color[0][c] = endpoints.color[1][c];
+      endpoints.color[1][c] = color;
+    }
+    const uint32_t pbit = endpoints.pbit[0];
+    endpoints.pbit[0]   = endpoints.pbit[1];
+    endpoints.pbit[1]   = pbit;
+    for (uint32_t t = 0; t < BLOCK_TEXEL_COUNT; ++t) {
+      indices[t] = 15 - indices[t];
+    }
+  }
+
+  memset(block, 0, 16);
+  block_bits_t bits = {.data = block};
+  block_bits_write(&bits, 1u << 6, 7); // mode 6
+  for (uint32_t c = 0; c < 4; ++c) {
+    block_bits_write(&bits, endpoints.color[0][c], 7);
+    block_bits_write(&bits, endpoints.color[1][c], 7);
+  }
+  block_bits_write(&bits, endpoints.pbit[0], 1);
+  block_bits_write(&bits, endpoints.pbit[1], 1);
+  block_bits_write(&bits, indices[0], 3);
+  for (uint32_t t = 1; t < BLOCK_TEXEL_COUNT; ++t) {
+    block_bits_write(&bits, indices[t], 4);
+  }
+}
+
+void block_compress_image(block_compression_format_enum format,
+                          const uint8_t* pixels, uint32_t width,
+                          uint32_t height, uint8_t* blocks)
+{
+  const uint32_t block_bytes = block_compression_get_block_bytes(format);
+  uint8_t texels[BLOCK_TEXEL_COUNT][4];
+  for (uint32_t y = 0; y < height; y += 4) {
+    for (uint32_t x = 0; x < width; x += 4) {
+      load_block(pixels, width, height, x, y, texels);
+      switch (format) {
+        case BlockCompressionFormat_BC4:
+          compress_bc4_block(texels, 0, blocks);
+          break;
+        case BlockCompressionFormat_BC5:
+          compress_bc4_block(texels, 0, blocks);
+          compress_bc4_block(texels, 1, blocks + 8);
+          break;
+        case BlockCompressionFormat_BC7:
+          compress_bc7_block(texels, blocks);
+          break;
+      }
+      blocks += block_bytes;
+    }
+  }
+}
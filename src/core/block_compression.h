@@ -0,0 +1,41 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Block compressed formats of 4x4 texel blocks */
+typedef enum block_compression_format_enum {
+  BlockCompressionFormat_BC4 = 0, /* red channel, 8 bytes per block */
+  BlockCompressionFormat_BC5 = 1, /* red and green channels, 16 bytes */
+  BlockCompressionFormat_BC7 = 2, /* RGBA, 16 bytes */
+} block_compression_format_enum;
+
+/**
+ * @brief Returns the number of bytes of a 4x4 block of the format.
+ */
+uint32_t
+block_compression_get_block_bytes(block_compression_format_enum format);
+
+/**
+ * @brief Returns the size of an image of the format, partial blocks at the
+ * right and bottom edges count as whole blocks.
+ */
+size_t block_compression_get_image_size(block_compression_format_enum format,
+                                        uint32_t width, uint32_t height);
+
+/**
+ * @brief Compresses an RGBA8 image into rows of blocks. Texels of partial
+ * blocks outside the image repeat the edge texels.
+ * BC4 and BC5 blocks use the 8 value mode of the larger endpoint first, BC7
+ * blocks are encoded in mode 6 (one subset, RGBA endpoints with a p-bit each,
+ * 16 weights) with the endpoints fitted along the principal axis of the block
+ * and refined once by least squares.
+ * @param pixels tightly packed RGBA8 texels
+ * @param blocks block_compression_get_image_size bytes
+ */
+void block_compress_image(block_compression_format_enum format,
+                          const uint8_t* pixels, uint32_t width,
+                          uint32_t height, uint8_t* blocks);
+
+#endif /* BLOCK_COMPRESSION_H */
@@ -144,6 +144,61 @@ bool camera_update_pad(camera_t* camera, vec2 axis_left, vec2 axis_right,
   return ret_val;
 }
 
+/* Recomputes the matrices derived from the view and projection matrices */
+static void camera_update_derived_matrices(camera_t* camera)
+{
+  glm_mat4_mul(camera->matrices.perspective, camera->matrices.view,
+               camera->matrices.view_projection);
+  glm_mat4_mul(camera->matrices.jittered_perspective, camera->matrices.view,
+               camera->matrices.jittered_view_projection);
+  glm_mat4_inv(camera->matrices.perspective,
+               camera->matrices.inverse_perspective);
+  glm_mat4_inv(camera->matrices.view, camera->matrices.inverse_view);
+  glm_mat4_inv(camera->matrices.view_projection,
+               camera->matrices.inverse_view_projection);
+  ++camera->version;
+}
+
+/* Rebuilds the projection matrices from the stored parameters, returns false
+ * if they did not change */
+static bool camera_update_projection_matrix(camera_t* camera)
+{
+  mat4 perspective = GLM_MAT4_ZERO_INIT;
+  const float fovy = glm_rad(camera->fov);
+  switch (camera->projection) {
+    case CameraProjection_ReversedZ:
+      perspective_matrix_reversed_z(fovy, camera->aspect, camera->znear,
+                                    camera->zfar, perspective);
+      break;
+    case CameraProjection_ReversedZInfinite:
+      perspective_matrix_reversed_z_infinite_far(fovy, camera->aspect,
+                                                 camera->znear, perspective);
+      break;
+    case CameraProjection_Standard:
+    default:
+      glm_perspective(fovy, camera->aspect, camera->znear, camera->zfar,
+                      perspective);
+      break;
+  }
+  if (camera->flip_y) {
+    perspective[1][1] *= -1.0f;
+  }
+
+  mat4 jittered_perspective;
+  glm_mat4_copy(perspective, jittered_perspective);
+  projection_matrix_apply_jitter(jittered_perspective, camera->jitter);
+
+  if (memcmp(perspective, camera->matrices.perspective, sizeof(mat4)) == 0
+      && memcmp(jittered_perspective, camera->matrices.jittered_perspective,
+                sizeof(mat4))
+           == 0) {
+    return false;
+  }
+  glm_mat4_copy(perspective, camera->matrices.perspective);
+  glm_mat4_copy(jittered_perspective, camera->matrices.jittered_perspective);
+  return true;
+}
+
 void camera_update_view_matrix(camera_t* camera)
 {
   mat4 rot_mat   = GLM_MAT4_IDENTITY_INIT;
@@ -162,17 +217,25 @@ void camera_update_view_matrix(camera_t* camera)
   }
   glm_translate(trans_mat, translation);
 
+  mat4 view = GLM_MAT4_IDENTITY_INIT;
   if (camera->type == CameraType_FirstPerson) {
-    glm_mat4_mul(rot_mat, trans_mat, camera->matrices.view);
+    glm_mat4_mul(rot_mat, trans_mat, view);
   }
   else {
-    glm_mat4_mul(trans_mat, rot_mat, camera->matrices.view);
+    glm_mat4_mul(trans_mat, rot_mat, view);
   }
 
   glm_vec4_mul(
     (vec4){camera->position[0], camera->position[1], camera->position[2], 0.f},
     (vec4){-1.0f, 1.0f, -1.0f, 1.0f}, camera->view_pos);
 
+  // Setting the same position or rotation again is not a change
+  if (memcmp(view, camera->matrices.view, sizeof(mat4)) == 0) {
+    return;
+  }
+  glm_mat4_copy(view, camera->matrices.view);
+  camera_update_derived_matrices(camera);
+
   camera->updated = true;
 }
 
@@ -223,23 +286,45 @@ void camera_set_movement_speed(camera_t* camera, float movement_speed)
 void camera_set_perspective(camera_t* camera, float fov, float aspect,
                             float znear, float zfar)
 {
-  camera->fov   = fov;
-  camera->znear = znear;
-  camera->zfar  = zfar;
-  glm_perspective(glm_rad(fov), aspect, znear, zfar,
-                  camera->matrices.perspective);
-  if (camera->flip_y) {
-    camera->matrices.perspective[1][1] *= -1.0f;
+  camera->fov    = fov;
+  camera->aspect = aspect;
+  camera->znear  = znear;
+  camera->zfar   = zfar;
+  if (camera_update_projection_matrix(camera)) {
+    camera_update_derived_matrices(camera);
   }
 }
 
 void camera_update_aspect_ratio(camera_t* camera, float aspect)
 {
-  glm_perspective(glm_rad(camera->fov), aspect, camera->znear, camera->zfar,
-                  camera->matrices.perspective);
-  if (camera->flip_y) {
-    camera->matrices.perspective[1][1] *= -1.0f;
+  camera->aspect = aspect;
+  if (camera_update_projection_matrix(camera)) {
+    camera_update_derived_matrices(camera);
+  }
+}
+
+void camera_set_projection(camera_t* camera,
+                           camera_projection_enum projection)
+{
+  camera->projection = projection;
+  if (camera_update_projection_matrix(camera)) {
+    camera_update_derived_matrices(camera);
+  }
+}
+
+void camera_set_jitter(camera_t* camera, vec2 jitter)
+{
+  if (glm_vec2_eqv(jitter, camera->jitter)) {
+    return;
   }
+  glm_vec2_copy(jitter, camera->jitter);
+  glm_mat4_copy(camera->matrices.perspective,
+                camera->matrices.jittered_perspective);
+  projection_matrix_apply_jitter(camera->matrices.jittered_perspective,
+                                 camera->jitter);
+  glm_mat4_mul(camera->matrices.jittered_perspective, camera->matrices.view,
+               camera->matrices.jittered_view_projection);
+  ++camera->version;
 }
 
 /* property retrieving */
@@ -260,6 +345,15 @@ float camera_get_far_clip(camera_t* camera)
   return camera->zfar;
 }
 
+bool camera_changed_since(camera_t* camera, uint64_t* version)
+{
+  if (*version == camera->version) {
+    return false;
+  }
+  *version = camera->version;
+  return true;
+}
+
 /* projection helpers */
 
 /**
@@ -372,3 +466,33 @@ mat4* perspective_zo(mat4* out, float fovy, float aspect, float near,
   }
   return out;
 }
+
+void projection_matrix_apply_jitter(mat4 proj_mtx, vec2 jitter)
+{
+  // x_ndc = x_clip / w_clip: adding jitter * w_clip to the clip coordinates
+  // shifts the image by jitter, the w row is added to the x and y rows
+  for (uint32_t c = 0; c < 4; ++c) {
+    proj_mtx[c][0] += jitter[0] * proj_mtx[c][3];
+    proj_mtx[c][1] += jitter[1] * proj_mtx[c][3];
+  }
+}
+
+void projection_matrix_apply_oblique_clip_plane(mat4 proj_mtx,
+                                                vec4 clip_plane)
+{
+  // View space corner of the far plane in the direction of the clip plane
+  mat4 inv_proj_mtx = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv(proj_mtx, inv_proj_mtx);
+  vec4 corner = GLM_VEC4_ZERO_INIT;
+  glm_mat4_mulv(inv_proj_mtx,
+                (vec4){glm_signf(clip_plane[0]), glm_signf(clip_plane[1]),
+                       1.0f, 1.0f},
+                corner);
+
+  // z_clip = 0 on the plane becomes the near plane, the scale puts the corner
+  // on the far plane z_clip = w_clip
+  const float scale = 1.0f / glm_vec4_dot(clip_plane, corner);
+  for (uint32_t c = 0; c < 4; ++c) {
+    proj_mtx[c][2] = clip_plane[c] * scale;
+  }
+}
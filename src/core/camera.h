@@ -8,6 +8,15 @@ typedef enum camera_type_enum {
   CameraType_FirstPerson = 1
 } camera_type_enum;
 
+typedef enum camera_projection_enum {
+  /* Depth 0 at the near and 1 at the far plane */
+  CameraProjection_Standard          = 0,
+  /* Depth 1 at the near and 0 at the far plane */
+  CameraProjection_ReversedZ         = 1,
+  /* Depth 1 at the near plane and 0 at infinity, zfar is ignored */
+  CameraProjection_ReversedZInfinite = 2
+} camera_projection_enum;
+
 /**
  * @brief Basic camera class
  */
@@ -16,16 +25,31 @@ typedef struct {
   vec3 position;
   vec4 view_pos;
   enum camera_type_enum type;
+  enum camera_projection_enum projection;
   float fov;
+  float aspect;
   float znear;
   float zfar;
   float rotation_speed;
   float movement_speed;
   bool updated;
+  /* Incremented whenever one of the matrices changes, see
+   * camera_changed_since */
+  uint64_t version;
   bool flip_y;
+  /* Sub-pixel offset of the projection in normalized device coordinates */
+  vec2 jitter;
   struct {
     mat4 perspective;
+    /* perspective shifted by the jitter, equal to it without jitter */
+    mat4 jittered_perspective;
     mat4 view;
+    /* Derived matrices, recomputed with the ones above */
+    mat4 view_projection;
+    mat4 jittered_view_projection;
+    mat4 inverse_perspective;
+    mat4 inverse_view;
+    mat4 inverse_view_projection;
   } matrices;
   struct {
     bool left;
@@ -54,12 +78,24 @@ void camera_set_movement_speed(camera_t* camera, float movement_speed);
 void camera_set_perspective(camera_t* camera, float fov, float aspect,
                             float znear, float zfar);
 void camera_update_aspect_ratio(camera_t* camera, float aspect);
+void camera_set_projection(camera_t* camera,
+                           camera_projection_enum projection);
+/* Offsets the jittered perspective matrix, the jitter being in normalized
+ * device coordinates (2 / width for a pixel) */
+void camera_set_jitter(camera_t* camera, vec2 jitter);
 
 /* property retrieving */
 bool camera_moving(camera_t* camera);
 float camera_get_near_clip(camera_t* camera);
 float camera_get_far_clip(camera_t* camera);
 
+/**
+ * @brief Returns true if the matrices of the camera changed since
+ * {@param version} was last passed in, and updates it. A version of 0 reports
+ * the first change, each user of the matrices keeps its own version.
+ */
+bool camera_changed_since(camera_t* camera, uint64_t* version);
+
 /* projection helpers */
 
 typedef enum {
@@ -132,4 +168,23 @@ void perspective_matrix_reversed_z_infinite_far(float fovy, float aspect,
 mat4* perspective_zo(mat4* out, float fovy, float aspect, float near,
                      const float* far);
 
+/**
+ * @brief Shifts the image of a projection matrix by {@param jitter} in
+ * normalized device coordinates, used for the sub-pixel offsets of temporal
+ * anti-aliasing.
+ */
+void projection_matrix_apply_jitter(mat4 proj_mtx, vec2 jitter);
+
+/**
+ * @brief Replaces the near plane of a projection matrix by
+ * {@param clip_plane}, a view space plane (a, b, c, d) whose positive side is
+ * kept, e.g. to clip the mirrored scene of a reflection at the mirror without
+ * clip distances. The far plane goes through the far corner of the frustum on
+ * the kept side. The camera has to be on the negative side of the plane, the
+ * clip space depth range is the [0, 1] one of WebGPU.
+ * @ref Lengyel: Oblique View Frustum Depth Projection and Clipping, 2005
+ */
+void projection_matrix_apply_oblique_clip_plane(mat4 proj_mtx,
+                                                vec4 clip_plane);
+
 #endif
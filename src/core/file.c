@@ -1,8 +1,14 @@
 #include "file.h"
 
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "job_system.h"
 #include "log.h"
 #include "macro.h"
 
@@ -32,6 +38,40 @@ int filename_has_extension(const char* filename, const char* extension)
   return strcmp(filename_extension, extension) == 0 ? 1 : 0;
 }
 
+int file_get_info(const char* filename, file_info_t* info)
+{
+  ASSERT(filename && info);
+  struct stat file_stat;
+  if (stat(filename, &file_stat) != 0) {
+    return 0;
+  }
+  info->size              = (uint64_t)file_stat.st_size;
+  info->modification_time = (int64_t)file_stat.st_mtim.tv_sec * 1000000000
+                            + (int64_t)file_stat.st_mtim.tv_nsec;
+  return 1;
+}
+
+void file_get_cache_filename(const char* directory, const char* filename,
+                             const char* suffix, char* cache_filename,
+                             size_t size)
+{
+  ASSERT(directory && filename && suffix && cache_filename && size > 0);
+  mkdir(directory, 0755);
+  const int length
+    = snprintf(cache_filename, size, "%s/%s%s", directory, filename, suffix);
+  if (length < 0) {
+    cache_filename[0] = '\0';
+    return;
+  }
+  /* Flatten the source path below the cache directory */
+  const size_t end = MIN((size_t)length, size - 1);
+  for (size_t i = strlen(directory) + 1; i < end; ++i) {
+    if (cache_filename[i] == '/' || cache_filename[i] == '\\') {
+      cache_filename[i] = '_';
+    }
+  }
+}
+
 void read_file(const char* filename, file_read_result_t* result,
                int is_text_file)
 {
@@ -52,3 +92,133 @@ void read_file(const char* filename, file_read_result_t* result,
     result->data[result->size] = 0;
   }
 }
+
+int file_map(const char* filename, file_mapping_t* mapping)
+{
+  ASSERT(filename && mapping);
+  mapping->size = 0;
+  mapping->data = NULL;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    log_error("Unable to open file '%s'\n", filename);
+    return 0;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    log_error("Unable to stat file '%s'\n", filename);
+    close(fd);
+    return 0;
+  }
+
+  if (file_stat.st_size > 0) {
+    void* data
+      = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      log_error("Unable to map file '%s'\n", filename);
+      close(fd);
+      return 0;
+    }
+    /* Loaders read the files front to back */
+    posix_madvise(data, (size_t)file_stat.st_size, POSIX_MADV_SEQUENTIAL);
+    mapping->size = (uint64_t)file_stat.st_size;
+    mapping->data = (const uint8_t*)data;
+  }
+
+  /* The mapping stays valid after closing the file descriptor */
+  close(fd);
+  return 1;
+}
+
+void file_unmap(file_mapping_t* mapping)
+{
+  if (mapping->data != NULL) {
+    munmap((void*)mapping->data, (size_t)mapping->size);
+  }
+  mapping->size = 0;
+  mapping->data = NULL;
+}
+
+typedef struct file_read_job_t {
+  file_read_request_t request;
+  file_mapping_t mapping;
+  file_read_response_t response;
+} file_read_job_t;
+
+static volatile uint32_t file_read_pending_count = 0;
+
+static void file_read_job_main(void* user_data)
+{
+  file_read_job_t* job           = (file_read_job_t*)user_data;
+  file_read_request_t* request   = &job->request;
+  file_read_response_t* response = &job->response;
+
+  if (file_map(request->filename, &job->mapping)) {
+    const uint64_t file_size = job->mapping.size;
+    const uint64_t offset    = MIN(request->offset, file_size);
+    const uint64_t size      = request->size > 0 ?
+                                 MIN(request->size, file_size - offset) :
+                                 file_size - offset;
+    response->success = request->size == 0 || size == request->size;
+    response->data    = job->mapping.data ? job->mapping.data + offset : NULL;
+    response->size    = size;
+
+    /* Fault the pages in on this thread so that the callbacks don't block on
+     * the disk */
+    volatile uint8_t sum = 0;
+    for (uint64_t i = 0; i < size; i += 4096) {
+      sum += response->data[i];
+    }
+  }
+
+  if (request->on_read != NULL) {
+    request->on_read(response);
+  }
+}
+
+static void file_read_job_complete(void* user_data)
+{
+  file_read_job_t* job = (file_read_job_t*)user_data;
+  job->request.on_complete(&job->response);
+  file_unmap(&job->mapping);
+  free((void*)job->request.filename);
+  free(job);
+  __atomic_sub_fetch(&file_read_pending_count, 1, __ATOMIC_ACQ_REL);
+}
+
+void file_read_async(const file_read_request_t* request)
+{
+  ASSERT(request && request->filename && request->on_complete);
+
+  file_read_job_t* job = (file_read_job_t*)malloc(sizeof(file_read_job_t));
+  memset(job, 0, sizeof(file_read_job_t));
+  job->request = *request;
+
+  /* Keep a copy of the filename for the lifetime of the request */
+  const size_t filename_length = strlen(request->filename);
+  char* filename               = (char*)malloc(filename_length + 1);
+  memcpy(filename, request->filename, filename_length + 1);
+  job->request.filename = filename;
+
+  job->response = (file_read_response_t){
+    .filename  = filename,
+    .success   = 0,
+    .user_data = request->user_data,
+  };
+
+  __atomic_add_fetch(&file_read_pending_count, 1, __ATOMIC_ACQ_REL);
+  job_system_submit(job_system_get_shared(),
+                    &(job_desc_t){
+                      .func            = file_read_job_main,
+                      .user_data       = job,
+                      .completion      = file_read_job_complete,
+                      .completion_data = job,
+                    },
+                    NULL);
+}
+
+uint32_t file_read_async_pending_count(void)
+{
+  return __atomic_load_n(&file_read_pending_count, __ATOMIC_ACQUIRE);
+}
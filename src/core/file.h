@@ -1,6 +1,7 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct file_read_result_t {
@@ -8,6 +9,16 @@ typedef struct file_read_result_t {
   uint8_t* data;
 } file_read_result_t;
 
+typedef struct file_info_t {
+  uint64_t size;
+  int64_t modification_time; /* nanoseconds since the epoch */
+} file_info_t;
+
+typedef struct file_mapping_t {
+  uint64_t size;
+  const uint8_t* data;
+} file_mapping_t;
+
 /**
  * @brief Check if a file exist using fopen() function.
  * @param filename the name of the file
@@ -30,6 +41,29 @@ const char* get_filename_extension(const char* filename);
  */
 int filename_has_extension(const char* filename, const char* extension);
 
+/**
+ * @brief Returns the size and the last modification time of a file.
+ * @param filename the name of the file
+ * @param info the file information
+ * @return 1 if the file exist otherwise return 0
+ */
+int file_get_info(const char* filename, file_info_t* info);
+
+/**
+ * @brief Names the cache file of a source file in a cache directory, which is
+ * created when missing. The path separators of the source filename are
+ * replaced, the caches of files with the same name in different directories
+ * don't collide.
+ * @param directory the cache directory
+ * @param filename the name of the source file
+ * @param suffix appended to the name, e.g. the extension of the cache file
+ * @param cache_filename the name of the cache file
+ * @param size the size of cache_filename in bytes
+ */
+void file_get_cache_filename(const char* directory, const char* filename,
+                             const char* suffix, char* cache_filename,
+                             size_t size);
+
 /**
  * @brief Reads the file with the specified filename and writes data and size to
  * 'result'.
@@ -39,4 +73,55 @@ int filename_has_extension(const char* filename, const char* extension);
 void read_file(const char* filename, file_read_result_t* result,
                int is_text_file);
 
+/**
+ * @brief Maps the file with the specified filename read-only into memory, the
+ * data is served from the page cache without a heap copy.
+ * @param filename the name of the file
+ * @param mapping the file mapping, data is NULL for empty files
+ * @return 1 if the file was mapped otherwise return 0
+ */
+int file_map(const char* filename, file_mapping_t* mapping);
+
+/**
+ * @brief Unmaps a file mapped with file_map().
+ * @param mapping the file mapping
+ */
+void file_unmap(file_mapping_t* mapping);
+
+/* Asynchronous file reading */
+typedef struct file_read_response_t {
+  const char* filename;
+  int success;
+  const uint8_t* data; /* only valid during the callback */
+  uint64_t size;
+  void* user_data;
+} file_read_response_t;
+
+typedef void (*file_read_callback_t)(const file_read_response_t* response);
+
+typedef struct file_read_request_t {
+  const char* filename;
+  uint64_t offset;
+  uint64_t size; /* 0 reads up to the end of the file */
+  /* Optional, called on the I/O thread once the data has been read */
+  file_read_callback_t on_read;
+  /* Called on the main thread while the render loop runs */
+  file_read_callback_t on_complete;
+  void* user_data;
+} file_read_request_t;
+
+/**
+ * @brief Queues a read of a file or of a byte range of a file on the shared
+ * job system. The completion callback is invoked on the main thread from
+ * job_system_process_completions().
+ * @param request the read request, copied by the function
+ */
+void file_read_async(const file_read_request_t* request);
+
+/**
+ * @brief Returns the number of asynchronous reads whose completion callback
+ * has not run yet.
+ */
+uint32_t file_read_async_pending_count(void);
+
 #endif
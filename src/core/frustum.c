@@ -4,6 +4,23 @@
 
 #include "macro.h"
 
+/* SIMD instruction set of the batch tests, picked at compile time */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_SIMD_AVX2
+#define FRUSTUM_SIMD_WIDTH 8u
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_SIMD_SSE2
+#define FRUSTUM_SIMD_WIDTH 4u
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FRUSTUM_SIMD_NEON
+#define FRUSTUM_SIMD_WIDTH 4u
+#else
+#define FRUSTUM_SIMD_WIDTH 1u
+#endif
+
 /* frustum creating/releasing */
 
 frustum_t* frustum_create()
@@ -62,6 +79,16 @@ void frustum_update(frustum_t* frustum, mat4 matrix)
   }
 }
 
+bool frustum_update_from_camera(frustum_t* frustum, camera_t* camera,
+                                uint64_t* version)
+{
+  if (!camera_changed_since(camera, version)) {
+    return false;
+  }
+  frustum_update(frustum, camera->matrices.view_projection);
+  return true;
+}
+
 /* frustum checking */
 
 bool frustum_check_sphere(frustum_t* frustum, vec3 pos, float radius)
@@ -75,3 +102,371 @@ bool frustum_check_sphere(frustum_t* frustum, vec3 pos, float radius)
   }
   return true;
 }
+
+bool frustum_check_box(frustum_t* frustum, vec3 min, vec3 max)
+{
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(frustum->planes); ++i) {
+    /* Corner of the box furthest along the plane normal */
+    const float* plane = frustum->planes[i];
+    const float x      = plane[0] >= 0.0f ? max[0] : min[0];
+    const float y      = plane[1] >= 0.0f ? max[1] : min[1];
+    const float z      = plane[2] >= 0.0f ? max[2] : min[2];
+    if ((plane[0] * x) + (plane[1] * y) + (plane[2] * z) + plane[3] < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t frustum_check_boxes(frustum_t* frustum, const vec3* mins,
+                             const vec3* maxs, uint32_t count, bool* visible)
+{
+  for (uint32_t i = 0; i < count; ++i) {
+    visible[i] = true;
+  }
+
+  /* Center/extent form, the branchless inner loop runs over all boxes for
+   * each plane */
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const float nx = plane[0], ny = plane[1], nz = plane[2], d = plane[3];
+    const float ax = fabsf(nx), ay = fabsf(ny), az = fabsf(nz);
+    for (uint32_t i = 0; i < count; ++i) {
+      const float cx = mins[i][0] + maxs[i][0];
+      const float cy = mins[i][1] + maxs[i][1];
+      const float cz = mins[i][2] + maxs[i][2];
+      const float ex = maxs[i][0] - mins[i][0];
+      const float ey = maxs[i][1] - mins[i][1];
+      const float ez = maxs[i][2] - mins[i][2];
+      /* Twice the signed distance of the furthest corner */
+      const float dist = (nx * cx + ny * cy + nz * cz)
+                         + (ax * ex + ay * ey + az * ez) + 2.0f * d;
+      visible[i] = visible[i] && dist >= 0.0f;
+    }
+  }
+
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    visible_count += visible[i] ? 1 : 0;
+  }
+  return visible_count;
+}
+
+/* batch frustum checking */
+
+/* Plane distances in the same operation order as the SIMD versions, so that
+ * both give the same results */
+static bool frustum_sphere_is_visible(frustum_t* frustum,
+                                      const frustum_spheres_t* spheres,
+                                      uint32_t i)
+{
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const float dist   = plane[0] * spheres->center_x[i]
+                       + plane[1] * spheres->center_y[i]
+                       + plane[2] * spheres->center_z[i] + plane[3];
+    if (!(dist > -spheres->radius[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool frustum_aabb_is_visible(frustum_t* frustum,
+                                    const frustum_aabbs_t* aabbs, uint32_t i)
+{
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const float center = plane[0] * aabbs->center_x[i]
+                         + plane[1] * aabbs->center_y[i]
+                         + plane[2] * aabbs->center_z[i];
+    const float extent = fabsf(plane[0]) * aabbs->extent_x[i]
+                         + fabsf(plane[1]) * aabbs->extent_y[i]
+                         + fabsf(plane[2]) * aabbs->extent_z[i];
+    if (!(center + extent + plane[3] >= 0.0f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void frustum_clear_result(frustum_cull_result_t* result, uint32_t count)
+{
+  if (result != NULL && result->visibility_mask != NULL) {
+    memset(result->visibility_mask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+  }
+}
+
+/* Stores the visibility bits of the objects from first on, a group never
+ * straddles two mask words. Returns the number of visible ones. */
+static uint32_t frustum_store_result(frustum_cull_result_t* result,
+                                     uint32_t first, uint32_t bits,
+                                     uint32_t visible_count)
+{
+  if (result != NULL && result->visibility_mask != NULL) {
+    result->visibility_mask[first / 32] |= bits << (first % 32);
+  }
+  if (result != NULL && result->visible_indices != NULL) {
+    uint32_t* indices = result->visible_indices + visible_count;
+    for (uint32_t b = bits; b != 0; b &= b - 1) {
+      *indices++ = first + (uint32_t)__builtin_ctz(b);
+    }
+  }
+  return (uint32_t)__builtin_popcount(bits);
+}
+
+#if defined(FRUSTUM_SIMD_AVX2)
+
+static uint32_t frustum_spheres_visible_bits(frustum_t* frustum,
+                                             const frustum_spheres_t* spheres,
+                                             uint32_t i)
+{
+  const __m256 cx = _mm256_loadu_ps(spheres->center_x + i);
+  const __m256 cy = _mm256_loadu_ps(spheres->center_y + i);
+  const __m256 cz = _mm256_loadu_ps(spheres->center_z + i);
+  const __m256 nr
+    = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres->radius + i));
+  __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const __m256 nx    = _mm256_set1_ps(plane[0]);
+    const __m256 ny    = _mm256_set1_ps(plane[1]);
+    const __m256 nz    = _mm256_set1_ps(plane[2]);
+    __m256 dist        = _mm256_mul_ps(nx, cx);
+    dist               = _mm256_add_ps(dist, _mm256_mul_ps(ny, cy));
+    dist               = _mm256_add_ps(dist, _mm256_mul_ps(nz, cz));
+    dist               = _mm256_add_ps(dist, _mm256_set1_ps(plane[3]));
+    visible = _mm256_and_ps(visible, _mm256_cmp_ps(dist, nr, _CMP_GT_OQ));
+  }
+  return (uint32_t)_mm256_movemask_ps(visible);
+}
+
+static uint32_t frustum_aabbs_visible_bits(frustum_t* frustum,
+                                           const frustum_aabbs_t* aabbs,
+                                           uint32_t i)
+{
+  const __m256 cx = _mm256_loadu_ps(aabbs->center_x + i);
+  const __m256 cy = _mm256_loadu_ps(aabbs->center_y + i);
+  const __m256 cz = _mm256_loadu_ps(aabbs->center_z + i);
+  const __m256 ex = _mm256_loadu_ps(aabbs->extent_x + i);
+  const __m256 ey = _mm256_loadu_ps(aabbs->extent_y + i);
+  const __m256 ez = _mm256_loadu_ps(aabbs->extent_z + i);
+  __m256 visible  = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const __m256 nx    = _mm256_set1_ps(plane[0]);
+    const __m256 ny    = _mm256_set1_ps(plane[1]);
+    const __m256 nz    = _mm256_set1_ps(plane[2]);
+    const __m256 ax    = _mm256_set1_ps(fabsf(plane[0]));
+    const __m256 ay    = _mm256_set1_ps(fabsf(plane[1]));
+    const __m256 az    = _mm256_set1_ps(fabsf(plane[2]));
+    __m256 center      = _mm256_mul_ps(nx, cx);
+    center             = _mm256_add_ps(center, _mm256_mul_ps(ny, cy));
+    center             = _mm256_add_ps(center, _mm256_mul_ps(nz, cz));
+    __m256 extent      = _mm256_mul_ps(ax, ex);
+    extent             = _mm256_add_ps(extent, _mm256_mul_ps(ay, ey));
+    extent             = _mm256_add_ps(extent, _mm256_mul_ps(az, ez));
+    const __m256 dist  = _mm256_add_ps(_mm256_add_ps(center, extent),
+                                       _mm256_set1_ps(plane[3]));
+    visible            = _mm256_and_ps(
+      visible, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+  }
+  return (uint32_t)_mm256_movemask_ps(visible);
+}
+
+#elif defined(FRUSTUM_SIMD_SSE2)
+
+static uint32_t frustum_spheres_visible_bits(frustum_t* frustum,
+                                             const frustum_spheres_t* spheres,
+                                             uint32_t i)
+{
+  const __m128 cx = _mm_loadu_ps(spheres->center_x + i);
+  const __m128 cy = _mm_loadu_ps(spheres->center_y + i);
+  const __m128 cz = _mm_loadu_ps(spheres->center_z + i);
+  const __m128 nr
+    = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres->radius + i));
+  __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const __m128 nx    = _mm_set1_ps(plane[0]);
+    const __m128 ny    = _mm_set1_ps(plane[1]);
+    const __m128 nz    = _mm_set1_ps(plane[2]);
+    __m128 dist        = _mm_mul_ps(nx, cx);
+    dist               = _mm_add_ps(dist, _mm_mul_ps(ny, cy));
+    dist               = _mm_add_ps(dist, _mm_mul_ps(nz, cz));
+    dist               = _mm_add_ps(dist, _mm_set1_ps(plane[3]));
+    visible            = _mm_and_ps(visible, _mm_cmpgt_ps(dist, nr));
+  }
+  return (uint32_t)_mm_movemask_ps(visible);
+}
+
+static uint32_t frustum_aabbs_visible_bits(frustum_t* frustum,
+                                           const frustum_aabbs_t* aabbs,
+                                           uint32_t i)
+{
+  const __m128 cx = _mm_loadu_ps(aabbs->center_x + i);
+  const __m128 cy = _mm_loadu_ps(aabbs->center_y + i);
+  const __m128 cz = _mm_loadu_ps(aabbs->center_z + i);
+  const __m128 ex = _mm_loadu_ps(aabbs->extent_x + i);
+  const __m128 ey = _mm_loadu_ps(aabbs->extent_y + i);
+  const __m128 ez = _mm_loadu_ps(aabbs->extent_z + i);
+  __m128 visible  = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    const __m128 nx    = _mm_set1_ps(plane[0]);
+    const __m128 ny    = _mm_set1_ps(plane[1]);
+    const __m128 nz    = _mm_set1_ps(plane[2]);
+    const __m128 ax    = _mm_set1_ps(fabsf(plane[0]));
+    const __m128 ay    = _mm_set1_ps(fabsf(plane[1]));
+    const __m128 az    = _mm_set1_ps(fabsf(plane[2]));
+    __m128 center      = _mm_mul_ps(nx, cx);
+    center             = _mm_add_ps(center, _mm_mul_ps(ny, cy));
+    center             = _mm_add_ps(center, _mm_mul_ps(nz, cz));
+    __m128 extent      = _mm_mul_ps(ax, ex);
+    extent             = _mm_add_ps(extent, _mm_mul_ps(ay, ey));
+    extent             = _mm_add_ps(extent, _mm_mul_ps(az, ez));
+    const __m128 dist
+      = _mm_add_ps(_mm_add_ps(center, extent), _mm_set1_ps(plane[3]));
+    visible = _mm_and_ps(visible, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+  }
+  return (uint32_t)_mm_movemask_ps(visible);
+}
+
+#elif defined(FRUSTUM_SIMD_NEON)
+
+/* Bit i set for the lanes i that are all ones */
+static uint32_t frustum_neon_movemask(uint32x4_t mask)
+{
+  const uint32x4_t weights = {1, 2, 4, 8};
+  return vaddvq_u32(vandq_u32(mask, weights));
+}
+
+static uint32_t frustum_spheres_visible_bits(frustum_t* frustum,
+                                             const frustum_spheres_t* spheres,
+                                             uint32_t i)
+{
+  const float32x4_t cx = vld1q_f32(spheres->center_x + i);
+  const float32x4_t cy = vld1q_f32(spheres->center_y + i);
+  const float32x4_t cz = vld1q_f32(spheres->center_z + i);
+  const float32x4_t nr = vnegq_f32(vld1q_f32(spheres->radius + i));
+  uint32x4_t visible   = vdupq_n_u32(0xffffffffu);
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    float32x4_t dist   = vmulq_n_f32(cx, plane[0]);
+    dist               = vaddq_f32(dist, vmulq_n_f32(cy, plane[1]));
+    dist               = vaddq_f32(dist, vmulq_n_f32(cz, plane[2]));
+    dist               = vaddq_f32(dist, vdupq_n_f32(plane[3]));
+    visible            = vandq_u32(visible, vcgtq_f32(dist, nr));
+  }
+  return frustum_neon_movemask(visible);
+}
+
+static uint32_t frustum_aabbs_visible_bits(frustum_t* frustum,
+                                           const frustum_aabbs_t* aabbs,
+                                           uint32_t i)
+{
+  const float32x4_t cx = vld1q_f32(aabbs->center_x + i);
+  const float32x4_t cy = vld1q_f32(aabbs->center_y + i);
+  const float32x4_t cz = vld1q_f32(aabbs->center_z + i);
+  const float32x4_t ex = vld1q_f32(aabbs->extent_x + i);
+  const float32x4_t ey = vld1q_f32(aabbs->extent_y + i);
+  const float32x4_t ez = vld1q_f32(aabbs->extent_z + i);
+  uint32x4_t visible   = vdupq_n_u32(0xffffffffu);
+  for (uint32_t p = 0; p < (uint32_t)ARRAY_SIZE(frustum->planes); ++p) {
+    const float* plane = frustum->planes[p];
+    float32x4_t center = vmulq_n_f32(cx, plane[0]);
+    center             = vaddq_f32(center, vmulq_n_f32(cy, plane[1]));
+    center             = vaddq_f32(center, vmulq_n_f32(cz, plane[2]));
+    float32x4_t extent = vmulq_n_f32(ex, fabsf(plane[0]));
+    extent             = vaddq_f32(extent, vmulq_n_f32(ey, fabsf(plane[1])));
+    extent             = vaddq_f32(extent, vmulq_n_f32(ez, fabsf(plane[2])));
+    const float32x4_t dist
+      = vaddq_f32(vaddq_f32(center, extent), vdupq_n_f32(plane[3]));
+    visible = vandq_u32(visible, vcgeq_f32(dist, vdupq_n_f32(0.0f)));
+  }
+  return frustum_neon_movemask(visible);
+}
+
+#endif
+
+uint32_t frustum_cull_spheres(frustum_t* frustum,
+                              const frustum_spheres_t* spheres, uint32_t count,
+                              frustum_cull_result_t* result)
+{
+  frustum_clear_result(result, count);
+  uint32_t visible_count = 0, i = 0;
+#if FRUSTUM_SIMD_WIDTH > 1
+  for (; i + FRUSTUM_SIMD_WIDTH <= count; i += FRUSTUM_SIMD_WIDTH) {
+    visible_count += frustum_store_result(
+      result, i, frustum_spheres_visible_bits(frustum, spheres, i),
+      visible_count);
+  }
+#endif
+  for (; i < count; ++i) {
+    visible_count += frustum_store_result(
+      result, i, frustum_sphere_is_visible(frustum, spheres, i) ? 1 : 0,
+      visible_count);
+  }
+  return visible_count;
+}
+
+uint32_t frustum_cull_aabbs(frustum_t* frustum, const frustum_aabbs_t* aabbs,
+                            uint32_t count, frustum_cull_result_t* result)
+{
+  frustum_clear_result(result, count);
+  uint32_t visible_count = 0, i = 0;
+#if FRUSTUM_SIMD_WIDTH > 1
+  for (; i + FRUSTUM_SIMD_WIDTH <= count; i += FRUSTUM_SIMD_WIDTH) {
+    visible_count += frustum_store_result(
+      result, i, frustum_aabbs_visible_bits(frustum, aabbs, i), visible_count);
+  }
+#endif
+  for (; i < count; ++i) {
+    visible_count += frustum_store_result(
+      result, i, frustum_aabb_is_visible(frustum, aabbs, i) ? 1 : 0,
+      visible_count);
+  }
+  return visible_count;
+}
+
+uint32_t frustum_cull_spheres_scalar(frustum_t* frustum,
+                                     const frustum_spheres_t* spheres,
+                                     uint32_t count,
+                                     frustum_cull_result_t* result)
+{
+  frustum_clear_result(result, count);
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    visible_count += frustum_store_result(
+      result, i, frustum_sphere_is_visible(frustum, spheres, i) ? 1 : 0,
+      visible_count);
+  }
+  return visible_count;
+}
+
+uint32_t frustum_cull_aabbs_scalar(frustum_t* frustum,
+                                   const frustum_aabbs_t* aabbs, uint32_t count,
+                                   frustum_cull_result_t* result)
+{
+  frustum_clear_result(result, count);
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    visible_count += frustum_store_result(
+      result, i, frustum_aabb_is_visible(frustum, aabbs, i) ? 1 : 0,
+      visible_count);
+  }
+  return visible_count;
+}
+
+const char* frustum_get_simd_name(void)
+{
+#if defined(FRUSTUM_SIMD_AVX2)
+  return "AVX2";
+#elif defined(FRUSTUM_SIMD_SSE2)
+  return "SSE2";
+#elif defined(FRUSTUM_SIMD_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
@@ -3,6 +3,8 @@
 
 #include <cglm/cglm.h>
 
+#include "camera.h"
+
 typedef enum {
   Frustum_Side_Left   = 0,
   Frustum_Side_Right  = 1,
@@ -26,7 +28,86 @@ void frustum_release(frustum_t* frustum);
 /* frustum updating */
 void frustum_update(frustum_t* frustum, mat4 matrix);
 
+/**
+ * @brief Updates the planes from the view projection matrix of the camera if
+ * it changed since {@param version}, see camera_changed_since. The far plane
+ * of an infinite projection does not cull. Returns true if the planes changed.
+ */
+bool frustum_update_from_camera(frustum_t* frustum, camera_t* camera,
+                                uint64_t* version);
+
 /* frustum checking */
 bool frustum_check_sphere(frustum_t* frustum, vec3 pos, float radius);
+bool frustum_check_box(frustum_t* frustum, vec3 min, vec3 max);
+
+/**
+ * @brief Tests count axis aligned boxes at once, one plane at a time, and
+ * writes the result of each box to visible. Returns the number of boxes
+ * intersecting or inside the frustum.
+ */
+uint32_t frustum_check_boxes(frustum_t* frustum, const vec3* mins,
+                             const vec3* maxs, uint32_t count, bool* visible);
+
+/**
+ * @brief Bounding spheres as structure of arrays, for the batch tests
+ */
+typedef struct frustum_spheres_t {
+  const float* center_x;
+  const float* center_y;
+  const float* center_z;
+  const float* radius;
+} frustum_spheres_t;
+
+/**
+ * @brief Axis aligned boxes in center / half extent form as structure of
+ * arrays, for the batch tests
+ */
+typedef struct frustum_aabbs_t {
+  const float* center_x;
+  const float* center_y;
+  const float* center_z;
+  const float* extent_x;
+  const float* extent_y;
+  const float* extent_z;
+} frustum_aabbs_t;
+
+/**
+ * @brief Output of the batch tests, both arrays are optional.
+ */
+typedef struct frustum_cull_result_t {
+  /* Bit i % 32 of word i / 32 is set for a visible object i, (count + 31) / 32
+   * words */
+  uint32_t* visibility_mask;
+  /* Indices of the visible objects in ascending order, up to count */
+  uint32_t* visible_indices;
+} frustum_cull_result_t;
+
+/*
+ * Batch frustum culling.
+ *
+ * The objects are tested against all planes in groups of the SIMD width
+ * (AVX2, SSE2 or NEON, as enabled for the build), the remaining ones with
+ * scalar code. A sphere is visible unless it is behind a plane by more than
+ * its radius, like frustum_check_sphere, a box unless its furthest corner
+ * along the normal of a plane is behind it, like frustum_check_box. Both
+ * return the number of visible objects.
+ */
+uint32_t frustum_cull_spheres(frustum_t* frustum,
+                              const frustum_spheres_t* spheres, uint32_t count,
+                              frustum_cull_result_t* result);
+uint32_t frustum_cull_aabbs(frustum_t* frustum, const frustum_aabbs_t* aabbs,
+                            uint32_t count, frustum_cull_result_t* result);
+
+/* Scalar versions of the batch tests, the reference of the SIMD ones */
+uint32_t frustum_cull_spheres_scalar(frustum_t* frustum,
+                                     const frustum_spheres_t* spheres,
+                                     uint32_t count,
+                                     frustum_cull_result_t* result);
+uint32_t frustum_cull_aabbs_scalar(frustum_t* frustum,
+                                   const frustum_aabbs_t* aabbs, uint32_t count,
+                                   frustum_cull_result_t* result);
+
+/* Instruction set of the batch tests: "AVX2", "SSE2", "NEON" or "scalar" */
+const char* frustum_get_simd_name(void);
 
 #endif
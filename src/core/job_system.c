@@ -0,0 +1,445 @@
+#include "job_system.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "macro.h"
+#include "profiler.h"
+
+typedef struct job_t {
+  job_desc_t desc;
+  job_counter_t* counter;
+} job_t;
+
+/* Ring buffer deque, the owning worker pops from the tail, other threads steal
+ * from the head */
+typedef struct job_queue_t {
+  pthread_mutex_t mutex;
+  job_t jobs[JOB_SYSTEM_QUEUE_CAPACITY];
+  uint32_t head;
+  uint32_t tail;
+} job_queue_t;
+
+typedef struct job_worker_t {
+  struct job_system* job_system;
+  uint32_t index;
+  pthread_t thread;
+  job_queue_t queue;
+} job_worker_t;
+
+typedef struct job_completion_t {
+  job_func_t func;
+  void* user_data;
+} job_completion_t;
+
+struct job_system {
+  uint32_t worker_count;
+  job_worker_t* workers;
+  pthread_key_t worker_key;
+  volatile uint32_t next_queue;
+  /* Wake-up of idle workers */
+  pthread_mutex_t wake_mutex;
+  pthread_cond_t wake_cond;
+  volatile int32_t pending_count;
+  bool shutdown;
+  /* Completion callbacks waiting for the main thread */
+  struct {
+    pthread_mutex_t mutex;
+    job_completion_t* items;
+    uint32_t count;
+    uint32_t capacity;
+  } completions;
+};
+
+static job_system_t* shared_job_system = NULL;
+
+static bool job_queue_push(job_queue_t* queue, const job_t* job)
+{
+  bool pushed = false;
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->tail - queue->head < JOB_SYSTEM_QUEUE_CAPACITY) {
+    queue->jobs[queue->tail % JOB_SYSTEM_QUEUE_CAPACITY] = *job;
+    ++queue->tail;
+    pushed = true;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return pushed;
+}
+
+/* Puts a job at the head, where the owning worker pops it last */
+static bool job_queue_push_front(job_queue_t* queue, const job_t* job)
+{
+  bool pushed = false;
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->tail - queue->head < JOB_SYSTEM_QUEUE_CAPACITY) {
+    --queue->head;
+    queue->jobs[queue->head % JOB_SYSTEM_QUEUE_CAPACITY] = *job;
+    pushed = true;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return pushed;
+}
+
+static bool job_queue_pop(job_queue_t* queue, job_t* job)
+{
+  bool popped = false;
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->tail != queue->head) {
+    --queue->tail;
+    *job   = queue->jobs[queue->tail % JOB_SYSTEM_QUEUE_CAPACITY];
+    popped = true;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return popped;
+}
+
+static bool job_queue_steal(job_queue_t* queue, job_t* job)
+{
+  bool stolen = false;
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->tail != queue->head) {
+    *job = queue->jobs[queue->head % JOB_SYSTEM_QUEUE_CAPACITY];
+    ++queue->head;
+    stolen = true;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return stolen;
+}
+
+static job_worker_t* job_system_current_worker(job_system_t* job_system)
+{
+  return (job_worker_t*)pthread_getspecific(job_system->worker_key);
+}
+
+static void job_system_wake_workers(job_system_t* job_system)
+{
+  pthread_mutex_lock(&job_system->wake_mutex);
+  pthread_cond_broadcast(&job_system->wake_cond);
+  pthread_mutex_unlock(&job_system->wake_mutex);
+}
+
+static void job_system_execute(job_system_t* job_system, job_t* job)
+{
+  PROFILE_BEGIN("job");
+  job->desc.func(job->desc.user_data);
+  PROFILE_END();
+
+  if (job->desc.completion != NULL) {
+    pthread_mutex_lock(&job_system->completions.mutex);
+    if (job_system->completions.count == job_system->completions.capacity) {
+      uint32_t capacity = MAX(job_system->completions.capacity * 2, 64u);
+      job_completion_t* items = (job_completion_t*)realloc(
+        job_system->completions.items, capacity * sizeof(job_completion_t));
+      ASSERT(items != NULL);
+      job_system->completions.items    = items;
+      job_system->completions.capacity = capacity;
+    }
+    job_system->completions.items[job_system->completions.count++]
+      = (job_completion_t){
+        .func      = job->desc.completion,
+        .user_data = job->desc.completion_data,
+      };
+    pthread_mutex_unlock(&job_system->completions.mutex);
+  }
+
+  if (job->counter != NULL) {
+    __atomic_sub_fetch(&job->counter->value, 1, __ATOMIC_ACQ_REL);
+  }
+}
+
+/* Queues a job on the given worker, at the tail or at the head of its queue,
+ * runs it inline if the queue is full */
+static void job_system_enqueue(job_system_t* job_system, job_worker_t* worker,
+                               const job_t* job, bool front)
+{
+  __atomic_add_fetch(&job_system->pending_count, 1, __ATOMIC_ACQ_REL);
+  const bool pushed = front ? job_queue_push_front(&worker->queue, job) :
+                              job_queue_push(&worker->queue, job);
+  if (!pushed) {
+    __atomic_sub_fetch(&job_system->pending_count, 1, __ATOMIC_ACQ_REL);
+    job_t inline_job = *job;
+    if (inline_job.desc.dependency != NULL) {
+      job_system_wait(job_system, inline_job.desc.dependency);
+    }
+    job_system_execute(job_system, &inline_job);
+    return;
+  }
+  job_system_wake_workers(job_system);
+}
+
+/* Takes a job from the own queue first, then steals from the other workers.
+ * Jobs with an unfinished dependency are put back at the head of the queue,
+ * so that the worker runs the other queued jobs, their dependency possibly
+ * among them, before it pops them again. */
+static bool job_system_try_run_job(job_system_t* job_system,
+                                   job_worker_t* worker)
+{
+  job_t job;
+  bool found = worker != NULL && job_queue_pop(&worker->queue, &job);
+  const uint32_t start = worker != NULL ? worker->index + 1 : 0;
+  for (uint32_t i = 0; !found && i < job_system->worker_count; ++i) {
+    job_worker_t* victim
+      = &job_system->workers[(start + i) % job_system->worker_count];
+    if (victim != worker) {
+      found = job_queue_steal(&victim->queue, &job);
+    }
+  }
+  if (!found) {
+    return false;
+  }
+  __atomic_sub_fetch(&job_system->pending_count, 1, __ATOMIC_ACQ_REL);
+
+  if (job.desc.dependency != NULL
+      && !job_counter_is_done(job.desc.dependency)) {
+    job_worker_t* target = worker != NULL ? worker : &job_system->workers[0];
+    job_system_enqueue(job_system, target, &job, true);
+    sched_yield();
+    return false;
+  }
+
+  job_system_execute(job_system, &job);
+  return true;
+}
+
+static void* job_system_worker_main(void* arg)
+{
+  job_worker_t* worker     = (job_worker_t*)arg;
+  job_system_t* job_system = worker->job_system;
+  pthread_setspecific(job_system->worker_key, worker);
+
+  char thread_name[32];
+  snprintf(thread_name, sizeof(thread_name), "Job worker %u", worker->index);
+  PROFILE_THREAD_NAME(thread_name);
+  UNUSED_VAR(thread_name);
+
+  for (;;) {
+    if (job_system_try_run_job(job_system, worker)) {
+      continue;
+    }
+    pthread_mutex_lock(&job_system->wake_mutex);
+    while (!job_system->shutdown
+           && __atomic_load_n(&job_system->pending_count, __ATOMIC_ACQUIRE)
+                == 0) {
+      pthread_cond_wait(&job_system->wake_cond, &job_system->wake_mutex);
+    }
+    const bool exit
+      = job_system->shutdown
+        && __atomic_load_n(&job_system->pending_count, __ATOMIC_ACQUIRE) == 0;
+    pthread_mutex_unlock(&job_system->wake_mutex);
+    if (exit) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+job_system_t* job_system_create(uint32_t worker_count)
+{
+  if (worker_count == 0) {
+    const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    worker_count         = cpu_count > 1 ? (uint32_t)cpu_count - 1 : 1u;
+  }
+  worker_count = MIN(worker_count, JOB_SYSTEM_MAX_WORKER_COUNT);
+
+  job_system_t* job_system = (job_system_t*)malloc(sizeof(job_system_t));
+  memset(job_system, 0, sizeof(job_system_t));
+  job_system->worker_count = worker_count;
+  job_system->workers
+    = (job_worker_t*)calloc(worker_count, sizeof(job_worker_t));
+  pthread_key_create(&job_system->worker_key, NULL);
+  pthread_mutex_init(&job_system->wake_mutex, NULL);
+  pthread_cond_init(&job_system->wake_cond, NULL);
+  pthread_mutex_init(&job_system->completions.mutex, NULL);
+
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    job_worker_t* worker = &job_system->workers[i];
+    worker->job_system   = job_system;
+    worker->index        = i;
+    pthread_mutex_init(&worker->queue.mutex, NULL);
+  }
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    job_worker_t* worker = &job_system->workers[i];
+    pthread_create(&worker->thread, NULL, job_system_worker_main, worker);
+  }
+
+  log_debug("Job system started with %u workers", worker_count);
+
+  return job_system;
+}
+
+void job_system_release(job_system_t* job_system)
+{
+  if (job_system == NULL) {
+    return;
+  }
+
+  /* Workers drain their queues before exiting */
+  pthread_mutex_lock(&job_system->wake_mutex);
+  job_system->shutdown = true;
+  pthread_cond_broadcast(&job_system->wake_cond);
+  pthread_mutex_unlock(&job_system->wake_mutex);
+  for (uint32_t i = 0; i < job_system->worker_count; ++i) {
+    pthread_join(job_system->workers[i].thread, NULL);
+  }
+
+  job_system_process_completions(job_system);
+
+  for (uint32_t i = 0; i < job_system->worker_count; ++i) {
+    pthread_mutex_destroy(&job_system->workers[i].queue.mutex);
+  }
+  free(job_system->workers);
+  pthread_mutex_destroy(&job_system->completions.mutex);
+  free(job_system->completions.items);
+  pthread_cond_destroy(&job_system->wake_cond);
+  pthread_mutex_destroy(&job_system->wake_mutex);
+  pthread_key_delete(job_system->worker_key);
+  free(job_system);
+}
+
+job_system_t* job_system_get_shared(void)
+{
+  if (shared_job_system == NULL) {
+    shared_job_system = job_system_create(0);
+  }
+  return shared_job_system;
+}
+
+void job_system_release_shared(void)
+{
+  job_system_release(shared_job_system);
+  shared_job_system = NULL;
+}
+
+uint32_t job_system_get_worker_count(job_system_t* job_system)
+{
+  return job_system->worker_count;
+}
+
+void job_system_submit(job_system_t* job_system, const job_desc_t* desc,
+                       job_counter_t* counter)
+{
+  ASSERT(desc && desc->func);
+
+  if (counter != NULL) {
+    __atomic_add_fetch(&counter->value, 1, __ATOMIC_ACQ_REL);
+  }
+
+  const job_t job = {
+    .desc    = *desc,
+    .counter = counter,
+  };
+
+  /* Workers push to their own queue, other threads spread the jobs */
+  job_worker_t* worker = job_system_current_worker(job_system);
+  if (worker == NULL) {
+    const uint32_t queue_index
+      = __atomic_fetch_add(&job_system->next_queue, 1, __ATOMIC_RELAXED);
+    worker = &job_system->workers[queue_index % job_system->worker_count];
+  }
+  job_system_enqueue(job_system, worker, &job, false);
+}
+
+bool job_counter_is_done(job_counter_t* counter)
+{
+  return __atomic_load_n(&counter->value, __ATOMIC_ACQUIRE) == 0;
+}
+
+void job_system_wait(job_system_t* job_system, job_counter_t* counter)
+{
+  job_worker_t* worker = job_system_current_worker(job_system);
+  while (!job_counter_is_done(counter)) {
+    if (!job_system_try_run_job(job_system, worker)) {
+      sched_yield();
+    }
+  }
+}
+
+typedef struct job_range_t {
+  job_range_func_t func;
+  void* user_data;
+  uint32_t begin;
+  uint32_t end;
+} job_range_t;
+
+static void job_range_main(void* user_data)
+{
+  job_range_t* range = (job_range_t*)user_data;
+  range->func(range->user_data, range->begin, range->end);
+}
+
+void job_system_parallel_for(job_system_t* job_system, uint32_t count,
+                             uint32_t batch_size, job_range_func_t func,
+                             void* user_data)
+{
+  if (count == 0) {
+    return;
+  }
+
+  /* Default to about four batches per thread */
+  if (batch_size == 0) {
+    const uint32_t batch_count = (job_system->worker_count + 1) * 4;
+    batch_size                 = MAX(1u, count / batch_count);
+  }
+  const uint32_t range_count = (count + batch_size - 1) / batch_size;
+  if (range_count == 1) {
+    func(user_data, 0, count);
+    return;
+  }
+
+  job_range_t* ranges = (job_range_t*)malloc(range_count * sizeof(job_range_t));
+  job_counter_t counter = {0};
+  for (uint32_t i = 0; i < range_count; ++i) {
+    ranges[i] = (job_range_t){
+      .func      = func,
+      .user_data = user_data,
+      .begin     = i * batch_size,
+      .end       = MIN((i + 1) * batch_size, count),
+    };
+    job_system_submit(job_system,
+                      &(job_desc_t){
+                        .func      = job_range_main,
+                        .user_data = &ranges[i],
+                      },
+                      &counter);
+  }
+  job_system_wait(job_system, &counter);
+  free(ranges);
+}
+
+uint32_t job_system_process_completions(job_system_t* job_system)
+{
+  uint32_t processed_count = 0;
+  for (;;) {
+    /* Completions may queue new jobs, take one callback at a time */
+    job_completion_t completion = {0};
+    pthread_mutex_lock(&job_system->completions.mutex);
+    if (processed_count < job_system->completions.count) {
+      completion = job_system->completions.items[processed_count];
+    }
+    pthread_mutex_unlock(&job_system->completions.mutex);
+    if (completion.func == NULL) {
+      break;
+    }
+    completion.func(completion.user_data);
+    ++processed_count;
+  }
+
+  /* Remove the processed callbacks, keep the ones added in the meantime */
+  if (processed_count > 0) {
+    pthread_mutex_lock(&job_system->completions.mutex);
+    const uint32_t remaining = job_system->completions.count - processed_count;
+    memmove(job_system->completions.items,
+            job_system->completions.items + processed_count,
+            remaining * sizeof(job_completion_t));
+    job_system->completions.count = remaining;
+    pthread_mutex_unlock(&job_system->completions.mutex);
+  }
+
+  return processed_count;
+}
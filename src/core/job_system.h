@@ -0,0 +1,75 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JOB_SYSTEM_MAX_WORKER_COUNT 32u
+#define JOB_SYSTEM_QUEUE_CAPACITY 1024u
+
+/* Work-stealing job system with a fixed number of worker threads */
+typedef struct job_system job_system_t;
+
+/* Number of unfinished jobs of a group, zero once all jobs have run */
+typedef struct job_counter_t {
+  volatile int32_t value;
+} job_counter_t;
+
+typedef void (*job_func_t)(void* user_data);
+typedef void (*job_range_func_t)(void* user_data, uint32_t begin,
+                                 uint32_t end);
+
+typedef struct job_desc_t {
+  job_func_t func;
+  void* user_data;
+  /* Optional, the job only starts once this counter has reached zero */
+  job_counter_t* dependency;
+  /* Optional, called on the main thread by job_system_process_completions */
+  job_func_t completion;
+  void* completion_data;
+} job_desc_t;
+
+/* Job system creating/releasing, a worker count of 0 creates one worker per
+ * CPU core besides the main thread */
+job_system_t* job_system_create(uint32_t worker_count);
+void job_system_release(job_system_t* job_system);
+
+/**
+ * @brief Returns the job system shared by all loaders, created on first use.
+ * Must be first called and released from the main thread.
+ */
+job_system_t* job_system_get_shared(void);
+void job_system_release_shared(void);
+
+uint32_t job_system_get_worker_count(job_system_t* job_system);
+
+/**
+ * @brief Queues a job and, when a counter is given, increments it. The counter
+ * is decremented once the job function has returned.
+ */
+void job_system_submit(job_system_t* job_system, const job_desc_t* desc,
+                       job_counter_t* counter);
+
+bool job_counter_is_done(job_counter_t* counter);
+
+/**
+ * @brief Blocks until the counter reaches zero, the calling thread executes
+ * queued jobs in the meantime.
+ */
+void job_system_wait(job_system_t* job_system, job_counter_t* counter);
+
+/**
+ * @brief Calls func for the range [0, count) split into batches of batch_size
+ * elements (0 picks a batch size) and returns once all batches are done.
+ */
+void job_system_parallel_for(job_system_t* job_system, uint32_t count,
+                             uint32_t batch_size, job_range_func_t func,
+                             void* user_data);
+
+/**
+ * @brief Runs the completion callbacks of finished jobs, to be called from the
+ * main thread. Returns the number of callbacks run.
+ */
+uint32_t job_system_process_completions(job_system_t* job_system);
+
+#endif
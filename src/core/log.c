@@ -22,6 +22,11 @@
 
 #include "log.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
 #define MAX_CALLBACKS 32
 
 typedef struct {
@@ -38,6 +43,32 @@ static struct {
   Callback callbacks[MAX_CALLBACKS];
 } L;
 
+/* Slot of the asynchronous ring, its sequence number tells whether it is free
+ * for the producer of position pos (sequence == pos) or holds the record of
+ * position pos for the writer thread (sequence == pos + 1) */
+typedef struct {
+  uint32_t sequence;
+  int level;
+  int line;
+  const char *file;
+  time_t time;
+  char message[LOG_ASYNC_MESSAGE_SIZE];
+} AsyncRecord;
+
+static struct {
+  AsyncRecord records[LOG_ASYNC_CAPACITY];
+  uint32_t head; /* next position claimed by a producer */
+  uint32_t tail; /* next position written by the writer thread */
+  uint32_t dropped;
+  bool running;
+  bool started;
+  /* The writer sleeps while the ring is empty */
+  bool sleeping;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} A;
+
 
 static const char *level_strings[] = {
   "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
@@ -137,11 +168,22 @@ static void init_event(log_Event *ev, void *udata) {
 }
 
 
-void log_log(int level, const char *file, int line, const char *fmt, ...) {
+static bool wants_level(int level) {
+  if (!L.quiet && level >= L.level) { return true; }
+  for (int i = 0; i < MAX_CALLBACKS && L.callbacks[i].fn; i++) {
+    if (level >= L.callbacks[i].level) { return true; }
+  }
+  return false;
+}
+
+
+static void dispatch_v(int level, const char *file, int line,
+                       struct tm *time, const char *fmt, va_list ap) {
   log_Event ev = {
     .fmt   = fmt,
     .file  = file,
     .line  = line,
+    .time  = time,
     .level = level,
   };
 
@@ -149,7 +191,7 @@ void log_log(int level, const char *file, int line, const char *fmt, ...) {
 
   if (!L.quiet && level >= L.level) {
     init_event(&ev, stderr);
-    va_start(ev.ap, fmt);
+    va_copy(ev.ap, ap);
     stdout_callback(&ev);
     va_end(ev.ap);
   }
@@ -158,7 +200,7 @@ void log_log(int level, const char *file, int line, const char *fmt, ...) {
     Callback *cb = &L.callbacks[i];
     if (level >= cb->level) {
       init_event(&ev, cb->udata);
-      va_start(ev.ap, fmt);
+      va_copy(ev.ap, ap);
       cb->fn(&ev);
       va_end(ev.ap);
     }
@@ -166,3 +208,175 @@ void log_log(int level, const char *file, int line, const char *fmt, ...) {
 
   unlock();
 }
+
+
+static void dispatch(int level, const char *file, int line, struct tm *time,
+                     const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  dispatch_v(level, file, line, time, fmt, ap);
+  va_end(ap);
+}
+
+
+static bool async_push(int level, const char *file, int line,
+                       const char *fmt, va_list ap) {
+  /* Claim the next free slot, fails when the ring is full */
+  AsyncRecord *r;
+  uint32_t pos = __atomic_load_n(&A.head, __ATOMIC_RELAXED);
+  for (;;) {
+    r = &A.records[pos % LOG_ASYNC_CAPACITY];
+    const uint32_t seq = __atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE);
+    const int32_t diff = (int32_t)(seq - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&A.head, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      __atomic_add_fetch(&A.dropped, 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      pos = __atomic_load_n(&A.head, __ATOMIC_RELAXED);
+    }
+  }
+
+  r->level = level;
+  r->file  = file;
+  r->line  = line;
+  r->time  = time(NULL);
+  vsnprintf(r->message, sizeof(r->message), fmt, ap);
+  __atomic_store_n(&r->sequence, pos + 1, __ATOMIC_RELEASE);
+
+  if (__atomic_load_n(&A.sleeping, __ATOMIC_ACQUIRE)) {
+    pthread_cond_signal(&A.cond);
+  }
+  return true;
+}
+
+
+static bool async_write_next(void) {
+  AsyncRecord *r = &A.records[A.tail % LOG_ASYNC_CAPACITY];
+  if (__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != A.tail + 1) {
+    return false;
+  }
+
+  dispatch(r->level, r->file, r->line, localtime(&r->time), "%s", r->message);
+
+  /* Hand the slot to the producer of the next round */
+  __atomic_store_n(&r->sequence, A.tail + LOG_ASYNC_CAPACITY,
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&A.tail, A.tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+
+static void *async_main(void *arg) {
+  (void)arg;
+  for (;;) {
+    while (async_write_next()) {}
+
+    const uint32_t dropped = __atomic_exchange_n(&A.dropped, 0,
+                                                 __ATOMIC_RELAXED);
+    if (dropped > 0) {
+      time_t t = time(NULL);
+      dispatch(LOG_WARN, __FILE__, __LINE__, localtime(&t),
+               "%u log messages dropped\n", dropped);
+    }
+
+    if (!__atomic_load_n(&A.running, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+
+    /* Producers only signal a sleeping writer, the timeout bounds the delay
+     * of a wake-up missed between the check and the wait */
+    pthread_mutex_lock(&A.mutex);
+    __atomic_store_n(&A.sleeping, true, __ATOMIC_RELEASE);
+    AsyncRecord *r = &A.records[A.tail % LOG_ASYNC_CAPACITY];
+    if (__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != A.tail + 1
+        && __atomic_load_n(&A.running, __ATOMIC_ACQUIRE)) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += 10 * 1000 * 1000;
+      if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000 * 1000 * 1000;
+      }
+      pthread_cond_timedwait(&A.cond, &A.mutex, &deadline);
+    }
+    __atomic_store_n(&A.sleeping, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&A.mutex);
+  }
+  return NULL;
+}
+
+
+static void async_stop(void) {
+  if (!A.running) { return; }
+  pthread_mutex_lock(&A.mutex);
+  __atomic_store_n(&A.running, false, __ATOMIC_RELEASE);
+  pthread_cond_signal(&A.cond);
+  pthread_mutex_unlock(&A.mutex);
+  pthread_join(A.thread, NULL);
+}
+
+
+int log_set_async(bool enable) {
+  if (!enable) {
+    async_stop();
+    return 0;
+  }
+  if (A.running) { return 0; }
+
+  if (!A.started) {
+    pthread_mutex_init(&A.mutex, NULL);
+    pthread_cond_init(&A.cond, NULL);
+    /* Write the queued messages on exit */
+    atexit(async_stop);
+    A.started = true;
+  }
+  for (uint32_t pos = A.head; pos != A.head + LOG_ASYNC_CAPACITY; pos++) {
+    A.records[pos % LOG_ASYNC_CAPACITY].sequence = pos;
+  }
+  A.tail = A.head;
+
+  A.running = true;
+  if (pthread_create(&A.thread, NULL, async_main, NULL) != 0) {
+    A.running = false;
+    return -1;
+  }
+  return 0;
+}
+
+
+void log_flush(void) {
+  while (__atomic_load_n(&A.running, __ATOMIC_ACQUIRE)
+         && __atomic_load_n(&A.tail, __ATOMIC_ACQUIRE)
+              != __atomic_load_n(&A.head, __ATOMIC_ACQUIRE)) {
+    pthread_cond_signal(&A.cond);
+    sched_yield();
+  }
+}
+
+
+void log_log(int level, const char *file, int line, const char *fmt, ...) {
+  if (__atomic_load_n(&A.running, __ATOMIC_ACQUIRE) && level < LOG_ERROR) {
+    if (!wants_level(level)) { return; }
+    va_list ap;
+    va_start(ap, fmt);
+    async_push(level, file, line, fmt, ap);
+    va_end(ap);
+    return;
+  }
+
+  /* Error and fatal messages are typically followed by an exit or an abort,
+   * they are written before returning */
+  if (__atomic_load_n(&A.running, __ATOMIC_ACQUIRE)) {
+    log_flush();
+  }
+
+  va_list ap;
+  va_start(ap, fmt);
+  dispatch_v(level, file, line, NULL, fmt, ap);
+  va_end(ap);
+}
@@ -16,6 +16,10 @@
 #define LOG_VERSION "0.1.0"
 #define LOG_SRC = "https://github.com/rxi/log.c"
 
+/* Records queued in asynchronous mode, and their largest formatted size */
+#define LOG_ASYNC_CAPACITY 1024
+#define LOG_ASYNC_MESSAGE_SIZE 512
+
 typedef struct {
   va_list ap;
   const char *fmt;
@@ -45,6 +49,17 @@ void log_set_quiet(bool enable);
 int log_add_callback(log_LogFn fn, void *udata, int level);
 int log_add_fp(FILE *fp, int level);
 
+/*
+ * Asynchronous mode: messages are formatted on the calling thread into a
+ * lock-free ring and written by a background thread, messages that do not fit
+ * into the full ring are dropped and counted. Error and fatal messages are
+ * written synchronously after the queued ones, the queued messages are written
+ * at exit. Enabling and disabling must not race with other threads logging.
+ */
+int log_set_async(bool enable);
+/* Waits until the queued messages have been written */
+void log_flush(void);
+
 void log_log(int level, const char *file, int line, const char *fmt, ...);
 
 #endif
@@ -2,6 +2,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "macro.h"
 
@@ -16,6 +17,21 @@ float random_float()
   return random_float_min_max(0.0f, 1.0f); /* [0, 1.0] */
 }
 
+/* PCG hash, see "Hash Functions for GPU Rendering" (Jarzynski & Olano) */
+static uint32_t pcg_hash(uint32_t value)
+{
+  const uint32_t state = value * 747796405u + 2891336453u;
+  const uint32_t word
+    = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+float random_float_hashed(uint32_t seed, uint32_t index)
+{
+  /* The upper 24 bits are exactly representable, [0, 1.0) */
+  return (float)(pcg_hash(index ^ pcg_hash(seed)) >> 8) / 16777216.0f;
+}
+
 int approx_eq_fabs_eps(float v0, float v1, float epsilon)
 {
   return fabs(v1 - v0) < epsilon;
@@ -31,3 +47,42 @@ float clamp_float(float d, float min, float max)
   const float t = d < min ? min : d;
   return t > max ? max : t;
 }
+
+uint16_t float_to_half(float value)
+{
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t abs  = bits & 0x7fffffffu;
+
+  // Infinity and NaN
+  if (abs >= 0x7f800000u) {
+    return (uint16_t)(sign | 0x7c00u | (abs > 0x7f800000u ? 0x0200u : 0u));
+  }
+  // Too large, rounds to infinity
+  if (abs >= 0x477ff000u) {
+    return (uint16_t)(sign | 0x7c00u);
+  }
+  // Subnormal half or zero
+  if (abs < 0x38800000u) {
+    if (abs < 0x33000000u) {
+      return (uint16_t)sign;
+    }
+    const uint32_t mantissa = (abs & 0x007fffffu) | 0x00800000u;
+    const uint32_t shift    = 126u - (abs >> 23);
+    const uint32_t rem      = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway  = 1u << (shift - 1u);
+    uint32_t half           = mantissa >> shift;
+    if (rem > halfway || (rem == halfway && (half & 1u))) {
+      ++half;
+    }
+    return (uint16_t)(sign | half);
+  }
+  // Normal half, rebias the exponent from 127 to 15
+  uint32_t half      = (abs - 0x38000000u) >> 13;
+  const uint32_t rem = abs & 0x1fffu;
+  if (rem > 0x1000u || (rem == 0x1000u && (half & 1u))) {
+    ++half;
+  }
+  return (uint16_t)(sign | half);
+}
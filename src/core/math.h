@@ -1,6 +1,8 @@
 #ifndef MATH_H
 #define MATH_H
 
+#include <stdint.h>
+
 /**
  * @brief Generates a random float number in range [min, max].
  * @param min minimum number
@@ -15,6 +17,16 @@ float random_float_min_max(float min, float max);
  */
 float random_float();
 
+/**
+ * @brief Generates a random float number in range [0.0f, 1.0f) from a hash of
+ * the seed and the index, without state so that it can be called from several
+ * threads, e.g. to fill the elements of a buffer in parallel.
+ * @param seed the seed of the sequence
+ * @param index the index of the number in the sequence
+ * @return random float number in range [0.0f, 1.0f)
+ */
+float random_float_hashed(uint32_t seed, uint32_t index);
+
 /**
  * @brief Returns if value v0 and v1 are approximately equal using epsilon as
  * allowed error.
@@ -32,4 +44,12 @@ int approx_eq_fabs(float v0, float v1);
  */
 float clamp_float(float d, float min, float max);
 
+/**
+ * @brief Converts a float number to an IEEE 754 binary16 (half float) number,
+ * rounding to nearest even.
+ * @param value the number to convert
+ * @return the bits of the half float number
+ */
+uint16_t float_to_half(float value);
+
 #endif /* MATH_H */
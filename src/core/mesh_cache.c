@@ -0,0 +1,136 @@
+#include "mesh_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "macro.h"
+
+#define MESH_CACHE_MAGIC 0x4853454du /* "MESH" */
+#define MESH_CACHE_VERSION 1u
+
+typedef struct mesh_cache_section_t {
+  uint64_t offset;
+  uint64_t size;
+} mesh_cache_section_t;
+
+typedef struct mesh_cache_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_modification_time;
+  uint32_t stream_count;
+  uint32_t padding;
+  mesh_cache_section_t sections[MESH_CACHE_MAX_STREAMS];
+} mesh_cache_header_t;
+
+static uint64_t mesh_cache_align(uint64_t offset)
+{
+  return (offset + MESH_CACHE_STREAM_ALIGNMENT - 1)
+         & ~(uint64_t)(MESH_CACHE_STREAM_ALIGNMENT - 1);
+}
+
+bool mesh_cache_write(const char* cache_filename, const char* source_filename,
+                      const mesh_cache_stream_t* streams,
+                      uint32_t stream_count)
+{
+  ASSERT(stream_count <= MESH_CACHE_MAX_STREAMS);
+
+  file_info_t source_info = {0};
+  if (!file_get_info(source_filename, &source_info)) {
+    return false;
+  }
+
+  mesh_cache_header_t header = {
+    .magic                    = MESH_CACHE_MAGIC,
+    .version                  = MESH_CACHE_VERSION,
+    .source_size              = source_info.size,
+    .source_modification_time = source_info.modification_time,
+    .stream_count             = stream_count,
+  };
+  uint64_t offset = sizeof(header);
+  for (uint32_t i = 0; i < stream_count; ++i) {
+    offset                    = mesh_cache_align(offset);
+    header.sections[i].offset = offset;
+    header.sections[i].size   = streams[i].size;
+    offset += streams[i].size;
+  }
+
+  char tmp_filename[STRMAX];
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", cache_filename);
+  FILE* file = fopen(tmp_filename, "wb");
+  bool ok    = file != NULL;
+  if (ok) {
+    static const uint8_t padding[MESH_CACHE_STREAM_ALIGNMENT] = {0};
+    uint64_t position = sizeof(header);
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (uint32_t i = 0; ok && i < stream_count; ++i) {
+      const uint64_t padding_size = header.sections[i].offset - position;
+      ok = fwrite(padding, 1, padding_size, file) == padding_size;
+      if (ok && streams[i].size > 0) {
+        ok = fwrite(streams[i].data, 1, streams[i].size, file)
+             == streams[i].size;
+      }
+      position = header.sections[i].offset + streams[i].size;
+    }
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && (rename(tmp_filename, cache_filename) == 0);
+    if (!ok) {
+      remove(tmp_filename);
+    }
+  }
+  if (!ok) {
+    log_warn("Could not write mesh cache file: %s\n", cache_filename);
+  }
+  return ok;
+}
+
+static bool mesh_cache_is_valid(const file_mapping_t* mapping,
+                                const file_info_t* source_info,
+                                uint32_t stream_count)
+{
+  if (mapping->data == NULL || mapping->size < sizeof(mesh_cache_header_t)) {
+    return false;
+  }
+  const mesh_cache_header_t* header = (const mesh_cache_header_t*)mapping->data;
+  if (header->magic != MESH_CACHE_MAGIC
+      || header->version != MESH_CACHE_VERSION
+      || header->source_size != source_info->size
+      || header->source_modification_time != source_info->modification_time
+      || header->stream_count != stream_count) {
+    return false;
+  }
+  for (uint32_t i = 0; i < stream_count; ++i) {
+    const mesh_cache_section_t* section = &header->sections[i];
+    if (section->offset % MESH_CACHE_STREAM_ALIGNMENT != 0
+        || section->offset > mapping->size
+        || section->size > mapping->size - section->offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool mesh_cache_map(const char* cache_filename, const char* source_filename,
+                    file_mapping_t* mapping, mesh_cache_stream_t* streams,
+                    uint32_t stream_count)
+{
+  ASSERT(stream_count <= MESH_CACHE_MAX_STREAMS);
+
+  file_info_t source_info = {0};
+  if (!file_get_info(source_filename, &source_info)
+      || !file_exists(cache_filename) || !file_map(cache_filename, mapping)) {
+    return false;
+  }
+  if (!mesh_cache_is_valid(mapping, &source_info, stream_count)) {
+    file_unmap(mapping);
+    return false;
+  }
+
+  const mesh_cache_header_t* header = (const mesh_cache_header_t*)mapping->data;
+  for (uint32_t i = 0; i < stream_count; ++i) {
+    streams[i].data = mapping->data + header->sections[i].offset;
+    streams[i].size = header->sections[i].size;
+  }
+  return true;
+}
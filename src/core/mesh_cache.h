@@ -0,0 +1,56 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "file.h"
+
+/*
+ * Binary cache of the vertex and index streams of a mesh loaded from a source
+ * file (PLY, OBJ, ...). The streams are stored back-to-back with a 16 byte
+ * alignment, so that they can be mapped and uploaded to GPU buffers without
+ * parsing. The cache is tied to the size and the modification time of the
+ * source file and is rejected once the source changes. The cache files are
+ * kept in MESH_CACHE_DIRECTORY, see file_get_cache_filename().
+ */
+
+#define MESH_CACHE_DIRECTORY "mesh_cache"
+#define MESH_CACHE_FILE_EXTENSION ".cache"
+#define MESH_CACHE_STREAM_ALIGNMENT 16u
+#define MESH_CACHE_MAX_STREAMS 8u
+
+typedef struct mesh_cache_stream_t {
+  const void* data;
+  uint64_t size;
+} mesh_cache_stream_t;
+
+/**
+ * @brief Writes the streams of a mesh to a cache file, through a temporary
+ * file so that an interrupted write never leaves a truncated cache behind.
+ * @param cache_filename the name of the cache file
+ * @param source_filename the name of the file the mesh was loaded from
+ * @param streams the streams to write, at most MESH_CACHE_MAX_STREAMS
+ * @param stream_count the number of streams
+ * @return true if the cache file was written
+ */
+bool mesh_cache_write(const char* cache_filename, const char* source_filename,
+                      const mesh_cache_stream_t* streams,
+                      uint32_t stream_count);
+
+/**
+ * @brief Maps a cache file written by mesh_cache_write() and returns pointers
+ * to its streams, which stay valid until the mapping is released with
+ * file_unmap().
+ * @param cache_filename the name of the cache file
+ * @param source_filename the name of the file the mesh was loaded from
+ * @param mapping the file mapping
+ * @param streams the streams read, stream_count entries
+ * @param stream_count the expected number of streams
+ * @return true if a valid cache for the source file was mapped
+ */
+bool mesh_cache_map(const char* cache_filename, const char* source_filename,
+                    file_mapping_t* mapping, mesh_cache_stream_t* streams,
+                    uint32_t stream_count);
+
+#endif /* MESH_CACHE_H */
@@ -0,0 +1,458 @@
+#include "mesh_decoder.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Vertex codec */
+#define MESH_VERTEX_HEADER 0xa0
+#define MESH_VERTEX_BLOCK_SIZE_BYTES 8192u
+#define MESH_VERTEX_BLOCK_MAX_SIZE 256u
+#define MESH_BYTE_GROUP_SIZE 16u
+#define MESH_TAIL_MIN_SIZE 32u
+
+/* Index codecs */
+#define MESH_INDEX_HEADER 0xe0
+#define MESH_INDEX_SEQUENCE_HEADER 0xd0
+#define MESH_INDEX_FIFO_SIZE 16u
+
+static uint32_t mesh_get_vertex_block_size(uint32_t vertex_size)
+{
+  uint32_t result = MESH_VERTEX_BLOCK_SIZE_BYTES / vertex_size;
+  result &= ~(MESH_BYTE_GROUP_SIZE - 1);
+  return result < MESH_VERTEX_BLOCK_MAX_SIZE ? result :
+                                               MESH_VERTEX_BLOCK_MAX_SIZE;
+}
+
+/*
+ * Decodes a group of 16 bytes stored with 0, 2, 4 or 8 bits each, the values
+ * not fitting into 2 or 4 bits follow the group. Returns NULL when the data
+ * ends early.
+ */
+static const uint8_t* mesh_decode_bytes_group(const uint8_t* data,
+                                              const uint8_t* data_end,
+                                              uint8_t* dest, uint32_t bitslog2)
+{
+  if (bitslog2 == 0) {
+    memset(dest, 0, MESH_BYTE_GROUP_SIZE);
+    return data;
+  }
+  if (bitslog2 == 3) {
+    if ((size_t)(data_end - data) < MESH_BYTE_GROUP_SIZE) {
+      return NULL;
+    }
+    memcpy(dest, data, MESH_BYTE_GROUP_SIZE);
+    return data + MESH_BYTE_GROUP_SIZE;
+  }
+
+  const uint32_t bits       = 1u << bitslog2;
+  const uint32_t sentinel   = (1u << bits) - 1;
+  const uint32_t fixed_size = MESH_BYTE_GROUP_SIZE * bits / 8;
+  if ((size_t)(data_end - data) < fixed_size) {
+    return NULL;
+  }
+  const uint8_t* data_var = data + fixed_size;
+  for (uint32_t i = 0; i < MESH_BYTE_GROUP_SIZE; ++i) {
+    // Most significant bits first
+    const uint32_t bit_offset = i * bits;
+    const uint32_t value
+      = (data[bit_offset / 8] >> (8 - bits - bit_offset % 8)) & sentinel;
+    if (value == sentinel) {
+      if (data_var == data_end) {
+        return NULL;
+      }
+      dest[i] = *data_var++;
+    }
+    else {
+      dest[i] = (uint8_t)value;
+    }
+  }
+  return data_var;
+}
+
+/* Decodes count bytes, a multiple of the group size, preceded by the 2 bit
+ * modes of the groups */
+static const uint8_t* mesh_decode_bytes(const uint8_t* data,
+                                        const uint8_t* data_end, uint8_t* dest,
+                                        uint32_t count)
+{
+  const uint32_t group_count = count / MESH_BYTE_GROUP_SIZE;
+  const uint32_t header_size = (group_count + 3) / 4;
+  if ((size_t)(data_end - data) < header_size) {
+    return NULL;
+  }
+  const uint8_t* header = data;
+  data += header_size;
+  for (uint32_t i = 0; i < group_count && data != NULL; ++i) {
+    const uint32_t bitslog2 = (header[i / 4] >> ((i % 4) * 2)) & 3;
+    data = mesh_decode_bytes_group(data, data_end,
+                                   dest + i * MESH_BYTE_GROUP_SIZE, bitslog2);
+  }
+  return data;
+}
+
+/* Decodes a block of vertices, byte k of every vertex is delta coded against
+ * byte k of the previous vertex */
+static const uint8_t* mesh_decode_vertex_block(const uint8_t* data,
+                                               const uint8_t* data_end,
+                                               uint8_t* dest,
+                                               uint32_t vertex_count,
+                                               uint32_t vertex_size,
+                                               uint8_t* last_vertex)
+{
+  uint8_t buffer[MESH_VERTEX_BLOCK_MAX_SIZE];
+  const uint32_t vertex_count_aligned
+    = (vertex_count + MESH_BYTE_GROUP_SIZE - 1) & ~(MESH_BYTE_GROUP_SIZE - 1);
+  for (uint32_t k = 0; k < vertex_size; ++k) {
+    data = mesh_decode_bytes(data, data_end, buffer, vertex_count_aligned);
+    if (data == NULL) {
+      return NULL;
+    }
+    uint8_t p = last_vertex[k];
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      // Zigzag decoding
+      const uint8_t v = (uint8_t)((buffer[i] >> 1) ^ -(buffer[i] & 1)) + p;
+      dest[i * vertex_size + k] = v;
+      p                         = v;
+    }
+  }
+  memcpy(last_vertex, &dest[(vertex_count - 1) * vertex_size], vertex_size);
+  return data;
+}
+
+bool mesh_decode_vertex_buffer(void* dest, uint32_t vertex_count,
+                               uint32_t vertex_size, const uint8_t* buffer,
+                               size_t buffer_size)
+{
+  if (vertex_size == 0 || vertex_size > 256 || vertex_size % 4 != 0) {
+    return false;
+  }
+  // The first vertex is delta coded against the last bytes of the buffer
+  const uint32_t tail_size
+    = vertex_size < MESH_TAIL_MIN_SIZE ? MESH_TAIL_MIN_SIZE : vertex_size;
+  if (buffer_size < 1 + tail_size || buffer[0] != MESH_VERTEX_HEADER) {
+    return false;
+  }
+  uint8_t last_vertex[256];
+  memcpy(last_vertex, buffer + buffer_size - vertex_size, vertex_size);
+
+  const uint8_t* data       = buffer + 1;
+  const uint8_t* data_end   = buffer + buffer_size - tail_size;
+  uint8_t* vertex_data      = (uint8_t*)dest;
+  const uint32_t block_size = mesh_get_vertex_block_size(vertex_size);
+  for (uint32_t first = 0; first < vertex_count; first += block_size) {
+    const uint32_t count
+      = vertex_count - first < block_size ? vertex_count - first : block_size;
+    data = mesh_decode_vertex_block(data, data_end,
+                                    vertex_data + (size_t)first * vertex_size,
+                                    count, vertex_size, last_vertex);
+    if (data == NULL) {
+      return false;
+    }
+  }
+  return data == data_end;
+}
+
+/* Variable length unsigned integer, 7 bits per byte */
+static uint32_t mesh_decode_vbyte(const uint8_t** data)
+{
+  const uint8_t lead = *(*data)++;
+  if (lead < 128) {
+    return lead;
+  }
+  uint32_t result = lead & 127;
+  uint32_t shift  = 7;
+  for (uint32_t i = 0; i < 4; ++i) {
+    const uint8_t group = *(*data)++;
+    result |= (uint32_t)(group & 127) << shift;
+    shift += 7;
+    if (group < 128) {
+      break;
+    }
+  }
+  return result;
+}
+
+/* Index zigzag delta coded against the last free index */
+static uint32_t mesh_decode_index(const uint8_t** data, uint32_t last)
+{
+  const uint32_t v = mesh_decode_vbyte(data);
+  const uint32_t d = (v >> 1) ^ -(v & 1);
+  return last + d;
+}
+
+static void mesh_write_index(void* dest, uint32_t index_size, uint32_t offset,
+                             uint32_t value)
+{
+  if (index_size == 2) {
+    ((uint16_t*)dest)[offset] = (uint16_t)value;
+  }
+  else {
+    ((uint32_t*)dest)[offset] = value;
+  }
+}
+
+static void mesh_write_triangle(void* dest, uint32_t index_size,
+                                uint32_t triangle, uint32_t a, uint32_t b,
+                                uint32_t c)
+{
+  mesh_write_index(dest, index_size, triangle * 3 + 0, a);
+  mesh_write_index(dest, index_size, triangle * 3 + 1, b);
+  mesh_write_index(dest, index_size, triangle * 3 + 2, c);
+}
+
+typedef struct mesh_index_fifos_t {
+  uint32_t edges[MESH_INDEX_FIFO_SIZE][2];
+  uint32_t edge_offset;
+  uint32_t vertices[MESH_INDEX_FIFO_SIZE];
+  uint32_t vertex_offset;
+} mesh_index_fifos_t;
+
+static void mesh_push_edge(mesh_index_fifos_t* fifos, uint32_t a, uint32_t b)
+{
+  fifos->edges[fifos->edge_offset][0] = a;
+  fifos->edges[fifos->edge_offset][1] = b;
+  fifos->edge_offset = (fifos->edge_offset + 1) & (MESH_INDEX_FIFO_SIZE - 1);
+}
+
+static void mesh_push_vertex(mesh_index_fifos_t* fifos, uint32_t v, bool cond)
+{
+  fifos->vertices[fifos->vertex_offset] = v;
+  fifos->vertex_offset
+    = (fifos->vertex_offset + (cond ? 1 : 0)) & (MESH_INDEX_FIFO_SIZE - 1);
+}
+
+/* Vertex pushed offset entries ago */
+static uint32_t mesh_get_vertex(const mesh_index_fifos_t* fifos,
+                                uint32_t offset)
+{
+  return fifos->vertices[(fifos->vertex_offset - offset)
+                         & (MESH_INDEX_FIFO_SIZE - 1)];
+}
+
+bool mesh_decode_index_buffer(void* dest, uint32_t index_count,
+                              uint32_t index_size, const uint8_t* buffer,
+                              size_t buffer_size)
+{
+  if (index_count % 3 != 0 || (index_size != 2 && index_size != 4)) {
+    return false;
+  }
+  // Header, one code per triangle, the index data and a 16 byte table of the
+  // frequent vertex codes
+  const uint32_t triangle_count = index_count / 3;
+  if (buffer_size < 1 + triangle_count + 16
+      || (buffer[0] & 0xf0) != MESH_INDEX_HEADER) {
+    return false;
+  }
+  const uint32_t version = buffer[0] & 0x0f;
+  if (version > 1) {
+    return false;
+  }
+
+  mesh_index_fifos_t fifos = {0};
+  uint32_t next = 0, last = 0;
+  // Version 1 codes the free indices -1 and +1 relative to the last one
+  const uint32_t fecmax = version >= 1 ? 13 : 15;
+
+  const uint8_t* code          = buffer + 1;
+  const uint8_t* data          = code + triangle_count;
+  const uint8_t* data_safe_end = buffer + buffer_size - 16;
+  const uint8_t* codeaux_table = data_safe_end;
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    // A triangle reads at most 16 bytes of index data
+    if (data > data_safe_end) {
+      return false;
+    }
+    const uint32_t codetri = code[i];
+    if (codetri < 0xf0) {
+      // Triangle sharing an edge with a recent one
+      const uint32_t fe = codetri >> 4;
+      const uint32_t* edge
+        = fifos.edges[(fifos.edge_offset - 1 - fe) & (MESH_INDEX_FIFO_SIZE - 1)];
+      const uint32_t a   = edge[0];
+      const uint32_t b   = edge[1];
+      const uint32_t fec = codetri & 15;
+      uint32_t c         = 0;
+      bool is_new        = true;
+      if (fec < fecmax) {
+        c      = fec == 0 ? next : mesh_get_vertex(&fifos, 1 + fec);
+        is_new = fec == 0;
+        next += is_new ? 1 : 0;
+      }
+      else {
+        // fec - (fec ^ 3) decodes 13 and 14 into -1 and 1
+        last = c = fec != 15 ? last + (fec - (fec ^ 3)) :
+                               mesh_decode_index(&data, last);
+      }
+      mesh_write_triangle(dest, index_size, i, a, b, c);
+      mesh_push_vertex(&fifos, c, is_new);
+      mesh_push_edge(&fifos, c, b);
+      mesh_push_edge(&fifos, a, c);
+    }
+    else if (codetri < 0xfe) {
+      // New triangle with codes of the other two vertices from the table
+      const uint32_t codeaux = codeaux_table[codetri & 15];
+      const uint32_t feb     = codeaux >> 4;
+      const uint32_t fec     = codeaux & 15;
+      const uint32_t a       = next++;
+      const uint32_t b       = feb == 0 ? next : mesh_get_vertex(&fifos, feb);
+      next += feb == 0 ? 1 : 0;
+      const uint32_t c = fec == 0 ? next : mesh_get_vertex(&fifos, fec);
+      next += fec == 0 ? 1 : 0;
+      mesh_write_triangle(dest, index_size, i, a, b, c);
+      mesh_push_vertex(&fifos, a, true);
+      mesh_push_vertex(&fifos, b, feb == 0);
+      mesh_push_vertex(&fifos, c, fec == 0);
+      mesh_push_edge(&fifos, b, a);
+      mesh_push_edge(&fifos, c, b);
+      mesh_push_edge(&fifos, a, c);
+    }
+    else {
+      // New triangle with explicit codes, free indices are delta coded
+      const uint32_t codeaux = *data++;
+      const uint32_t fea     = codetri == 0xfe ? 0 : 15;
+      const uint32_t feb     = codeaux >> 4;
+      const uint32_t fec     = codeaux & 15;
+      if (codeaux == 0) {
+        next = 0;
+      }
+      uint32_t a = fea == 0 ? next++ : 0;
+      uint32_t b = feb == 0 ? next++ : mesh_get_vertex(&fifos, feb);
+      uint32_t c = fec == 0 ? next++ : mesh_get_vertex(&fifos, fec);
+      if (fea == 15) {
+        last = a = mesh_decode_index(&data, last);
+      }
+      if (feb == 15) {
+        last = b = mesh_decode_index(&data, last);
+      }
+      if (fec == 15) {
+        last = c = mesh_decode_index(&data, last);
+      }
+      mesh_write_triangle(dest, index_size, i, a, b, c);
+      mesh_push_vertex(&fifos, a, true);
+      mesh_push_vertex(&fifos, b, feb == 0 || feb == 15);
+      mesh_push_vertex(&fifos, c, fec == 0 || fec == 15);
+      mesh_push_edge(&fifos, b, a);
+      mesh_push_edge(&fifos, c, b);
+      mesh_push_edge(&fifos, a, c);
+    }
+  }
+  return data == data_safe_end;
+}
+
+bool mesh_decode_index_sequence(void* dest, uint32_t index_count,
+                                uint32_t index_size, const uint8_t* buffer,
+                                size_t buffer_size)
+{
+  if (index_size != 2 && index_size != 4) {
+    return false;
+  }
+  // Header, at least one byte per index and 4 bytes of padding
+  if (buffer_size < 1 + (size_t)index_count + 4
+      || (buffer[0] & 0xf0) != MESH_INDEX_SEQUENCE_HEADER
+      || (buffer[0] & 0x0f) > 1) {
+    return false;
+  }
+
+  const uint8_t* data          = buffer + 1;
+  const uint8_t* data_safe_end = buffer + buffer_size - 4;
+  // The lowest bit selects one of two baselines the index is delta coded to
+  uint32_t last[2] = {0, 0};
+  for (uint32_t i = 0; i < index_count; ++i) {
+    if (data >= data_safe_end) {
+      return false;
+    }
+    uint32_t v             = mesh_decode_vbyte(&data);
+    const uint32_t current = v & 1;
+    v >>= 1;
+    const uint32_t index = last[current] + ((v >> 1) ^ -(v & 1));
+    last[current]        = index;
+    mesh_write_index(dest, index_size, i, index);
+  }
+  return data == data_safe_end;
+}
+
+/* Rounded signed float to integer conversion */
+static int32_t mesh_round(float v)
+{
+  return (int32_t)(v + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+void mesh_decode_filter_octahedral(void* data, uint32_t count,
+                                   uint32_t stride)
+{
+  // z holds the value encoding 1 at the bit count of the components
+  if (stride == 4) {
+    int8_t* values = (int8_t*)data;
+    for (uint32_t i = 0; i < count; ++i, values += 4) {
+      float x = (float)values[0];
+      float y = (float)values[1];
+      float z = (float)values[2] - fabsf(x) - fabsf(y);
+      // Fold the octahedron for z < 0
+      const float t = z >= 0.0f ? 0.0f : z;
+      x += x >= 0.0f ? t : -t;
+      y += y >= 0.0f ? t : -t;
+      const float s = 127.0f / sqrtf(x * x + y * y + z * z);
+      values[0]     = (int8_t)mesh_round(x * s);
+      values[1]     = (int8_t)mesh_round(y * s);
+      values[2]     = (int8_t)mesh_round(z * s);
+    }
+  }
+  else if (stride == 8) {
+    int16_t* values = (int16_t*)data;
+    for (uint32_t i = 0; i < count; ++i, values += 4) {
+      float x = (float)values[0];
+      float y = (float)values[1];
+      float z = (float)values[2] - fabsf(x) - fabsf(y);
+      const float t = z >= 0.0f ? 0.0f : z;
+      x += x >= 0.0f ? t : -t;
+      y += y >= 0.0f ? t : -t;
+      const float s = 32767.0f / sqrtf(x * x + y * y + z * z);
+      values[0]     = (int16_t)mesh_round(x * s);
+      values[1]     = (int16_t)mesh_round(y * s);
+      values[2]     = (int16_t)mesh_round(z * s);
+    }
+  }
+}
+
+void mesh_decode_filter_quaternion(void* data, uint32_t count,
+                                   uint32_t stride)
+{
+  if (stride != 8) {
+    return;
+  }
+  const float scale = 1.0f / sqrtf(2.0f);
+  int16_t* values   = (int16_t*)data;
+  for (uint32_t i = 0; i < count; ++i, values += 4) {
+    // The component scale is in the high bits of the last value, the index of
+    // the left out component in its two lowest bits
+    const int32_t sf = values[3] | 3;
+    const float ss   = scale / (float)sf;
+    const float x    = (float)values[0] * ss;
+    const float y    = (float)values[1] * ss;
+    const float z    = (float)values[2] * ss;
+
+    // Clamped to avoid NaN due to precision errors
+    const float ww    = 1.0f - x * x - y * y - z * z;
+    const float w     = sqrtf(ww >= 0.0f ? ww : 0.0f);
+    const uint32_t qc = (uint32_t)values[3] & 3;
+    values[(qc + 1) & 3] = (int16_t)mesh_round(x * 32767.0f);
+    values[(qc + 2) & 3] = (int16_t)mesh_round(y * 32767.0f);
+    values[(qc + 3) & 3] = (int16_t)mesh_round(z * 32767.0f);
+    values[(qc + 0) & 3] = (int16_t)mesh_round(w * 32767.0f);
+  }
+}
+
+void mesh_decode_filter_exponential(void* data, uint32_t count,
+                                    uint32_t stride)
+{
+  uint32_t* values           = (uint32_t*)data;
+  const uint32_t value_count = count * (stride / 4);
+  for (uint32_t i = 0; i < value_count; ++i) {
+    const uint32_t v = values[i];
+    // Signed 24 bit mantissa and 8 bit exponent
+    const int32_t m = (int32_t)(v << 8) >> 8;
+    const int32_t e = (int32_t)v >> 24;
+    const float f   = ldexpf((float)m, e);
+    memcpy(&values[i], &f, sizeof(f));
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef MESH_DECODER_H
+#define MESH_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Decoders of the vertex and index codecs of meshoptimizer, the bitstreams of
+ * the glTF EXT_meshopt_compression extension.
+ * @ref Kapoulkine: EXT_meshopt_compression, glTF vendor extension, 2020
+ *
+ * The decoders validate the encoded data and return false on malformed input,
+ * the destination contents are undefined in that case.
+ */
+
+/**
+ * @brief Decodes a vertex buffer encoded in "ATTRIBUTES" mode.
+ * @param dest vertex_count * vertex_size bytes
+ * @param vertex_size bytes per vertex, a multiple of 4 up to 256
+ */
+bool mesh_decode_vertex_buffer(void* dest, uint32_t vertex_count,
+                               uint32_t vertex_size, const uint8_t* buffer,
+                               size_t buffer_size);
+
+/**
+ * @brief Decodes a triangle list encoded in "TRIANGLES" mode.
+ * @param dest index_count * index_size bytes
+ * @param index_count a multiple of 3
+ * @param index_size 2 or 4
+ */
+bool mesh_decode_index_buffer(void* dest, uint32_t index_count,
+                              uint32_t index_size, const uint8_t* buffer,
+                              size_t buffer_size);
+
+/* Decodes an index sequence encoded in "INDICES" mode */
+bool mesh_decode_index_sequence(void* dest, uint32_t index_count,
+                                uint32_t index_size, const uint8_t* buffer,
+                                size_t buffer_size);
+
+/* Filters applied in place to decoded vertex buffers */
+/* Octahedral unit vectors, stride 4 (8 bit) or 8 (16 bit components) */
+void mesh_decode_filter_octahedral(void* data, uint32_t count,
+                                   uint32_t stride);
+/* Quaternions with the largest component left out, stride 8 */
+void mesh_decode_filter_quaternion(void* data, uint32_t count,
+                                   uint32_t stride);
+/* Floats with a shared exponent and 24 bit mantissas, stride a multiple of 4 */
+void mesh_decode_filter_exponential(void* data, uint32_t count,
+                                    uint32_t stride);
+
+#endif /* MESH_DECODER_H */
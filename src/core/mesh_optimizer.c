@@ -0,0 +1,468 @@
+#include "mesh_optimizer.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESH_NO_VERTEX UINT32_MAX
+
+/* Triangles emitted between two dead ends, reordered as a whole for overdraw */
+typedef struct mesh_cluster_t {
+  uint32_t first_index;
+  uint32_t index_count;
+  float occlusion_potential;
+} mesh_cluster_t;
+
+static const float* mesh_get_position(const float* positions, size_t stride,
+                                      uint32_t index)
+{
+  return (const float*)((const uint8_t*)positions + stride * index);
+}
+
+/* Clusters facing away from the mesh center occlude the others, draw first */
+static int mesh_cluster_compare(const void* a, const void* b)
+{
+  const float potential_a = ((const mesh_cluster_t*)a)->occlusion_potential;
+  const float potential_b = ((const mesh_cluster_t*)b)->occlusion_potential;
+  return (potential_a < potential_b) - (potential_a > potential_b);
+}
+
+static void mesh_compute_occlusion_potential(mesh_cluster_t* cluster,
+                                             const uint32_t* indices,
+                                             const float* positions,
+                                             size_t stride, const float* center)
+{
+  float centroid[3] = {0.0f, 0.0f, 0.0f}, normal[3] = {0.0f, 0.0f, 0.0f};
+  const uint32_t end = cluster->first_index + cluster->index_count;
+  for (uint32_t i = cluster->first_index; i < end; i += 3) {
+    const float* p0 = mesh_get_position(positions, stride, indices[i + 0]);
+    const float* p1 = mesh_get_position(positions, stride, indices[i + 1]);
+    const float* p2 = mesh_get_position(positions, stride, indices[i + 2]);
+    const float e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const float e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    /* Area weighted face normal */
+    normal[0] += e0[1] * e1[2] - e0[2] * e1[1];
+    normal[1] += e0[2] * e1[0] - e0[0] * e1[2];
+    normal[2] += e0[0] * e1[1] - e0[1] * e1[0];
+    for (uint32_t k = 0; k < 3; ++k) {
+      centroid[k] += p0[k] + p1[k] + p2[k];
+    }
+  }
+  const float normal_length = sqrtf(normal[0] * normal[0]
+                                    + normal[1] * normal[1]
+                                    + normal[2] * normal[2]);
+  float potential = 0.0f;
+  if (normal_length > 0.0f) {
+    for (uint32_t k = 0; k < 3; ++k) {
+      centroid[k] /= (float)cluster->index_count;
+      potential += (centroid[k] - center[k]) * normal[k];
+    }
+    potential /= normal_length;
+  }
+  cluster->occlusion_potential = potential;
+}
+
+void mesh_optimize_triangle_order(uint32_t* indices, uint32_t index_count,
+                                  uint32_t vertex_count, const float* positions,
+                                  size_t position_stride)
+{
+  const uint32_t triangle_count = index_count / 3;
+  const uint32_t cache_size     = MESH_OPTIMIZER_CACHE_SIZE;
+  if (triangle_count < 2 || vertex_count == 0) {
+    return;
+  }
+
+  /* Vertex-triangle adjacency and live triangle count of each vertex */
+  uint32_t* live_count     = calloc(vertex_count, sizeof(uint32_t));
+  uint32_t* cache_time     = calloc(vertex_count, sizeof(uint32_t));
+  uint32_t* adjacency_offs = calloc(vertex_count + 1, sizeof(uint32_t));
+  uint32_t* adjacency      = malloc(index_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < index_count; ++i) {
+    ++live_count[indices[i]];
+  }
+  uint32_t max_valence = 0;
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    adjacency_offs[v + 1] = adjacency_offs[v] + live_count[v];
+    max_valence = live_count[v] > max_valence ? live_count[v] : max_valence;
+  }
+  /* cache_time is the fill cursor of each adjacency list until emitting */
+  for (uint32_t t = 0; t < triangle_count; ++t) {
+    for (uint32_t k = 0; k < 3; ++k) {
+      const uint32_t v = indices[t * 3 + k];
+      adjacency[adjacency_offs[v] + cache_time[v]++] = t;
+    }
+  }
+  memset(cache_time, 0, vertex_count * sizeof(uint32_t));
+
+  bool* emitted            = calloc(triangle_count, sizeof(bool));
+  uint32_t* dead_end       = malloc(index_count * sizeof(uint32_t));
+  uint32_t* candidates     = malloc(max_valence * 3 * sizeof(uint32_t));
+  uint32_t* output         = malloc(index_count * sizeof(uint32_t));
+  mesh_cluster_t* clusters = malloc(triangle_count * sizeof(mesh_cluster_t));
+  uint32_t dead_end_count = 0, output_count = 0, cluster_count = 0;
+  uint32_t cluster_begin = 0, time = cache_size + 1, cursor = 1;
+
+  uint32_t fanning = 0;
+  while (fanning != MESH_NO_VERTEX) {
+    /* Emit all live triangles around the fanning vertex */
+    uint32_t candidate_count = 0;
+    for (uint32_t a = adjacency_offs[fanning]; a < adjacency_offs[fanning + 1];
+         ++a) {
+      const uint32_t t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (uint32_t k = 0; k < 3; ++k) {
+        const uint32_t v              = indices[t * 3 + k];
+        output[output_count++]        = v;
+        dead_end[dead_end_count++]    = v;
+        candidates[candidate_count++] = v;
+        --live_count[v];
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    /* Next fanning vertex: the candidate staying longest in the cache that
+     * still has live triangles once they are all emitted */
+    uint32_t next = MESH_NO_VERTEX, best_priority = 0;
+    for (uint32_t c = 0; c < candidate_count; ++c) {
+      const uint32_t v = candidates[c];
+      if (live_count[v] == 0) {
+        continue;
+      }
+      uint32_t priority = 0;
+      if (time - cache_time[v] + 2 * live_count[v] <= cache_size) {
+        priority = time - cache_time[v];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        next          = v;
+      }
+    }
+
+    /* Dead end, continue with a recently emitted vertex or the next one in
+     * input order, the triangles emitted so far form a cluster */
+    if (next == MESH_NO_VERTEX) {
+      while (dead_end_count > 0 && next == MESH_NO_VERTEX) {
+        const uint32_t v = dead_end[--dead_end_count];
+        next             = live_count[v] > 0 ? v : MESH_NO_VERTEX;
+      }
+      while (cursor < vertex_count && next == MESH_NO_VERTEX) {
+        next = live_count[cursor] > 0 ? cursor : MESH_NO_VERTEX;
+        ++cursor;
+      }
+      if (output_count > cluster_begin) {
+        clusters[cluster_count++] = (mesh_cluster_t){
+          .first_index = cluster_begin,
+          .index_count = output_count - cluster_begin,
+        };
+        cluster_begin = output_count;
+      }
+    }
+    fanning = next;
+  }
+
+  /* Sort the clusters by occlusion potential relative to the mesh center */
+  if (positions != NULL && cluster_count > 1) {
+    float center[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < output_count; ++i) {
+      const float* p = mesh_get_position(positions, position_stride, output[i]);
+      for (uint32_t k = 0; k < 3; ++k) {
+        center[k] += p[k] / (float)output_count;
+      }
+    }
+    for (uint32_t c = 0; c < cluster_count; ++c) {
+      mesh_compute_occlusion_potential(&clusters[c], output, positions,
+                                       position_stride, center);
+    }
+    qsort(clusters, cluster_count, sizeof(mesh_cluster_t),
+          mesh_cluster_compare);
+    uint32_t index = 0;
+    for (uint32_t c = 0; c < cluster_count; ++c) {
+      memcpy(&indices[index], &output[clusters[c].first_index],
+             clusters[c].index_count * sizeof(uint32_t));
+      index += clusters[c].index_count;
+    }
+  }
+  else {
+    memcpy(indices, output, output_count * sizeof(uint32_t));
+  }
+
+  free(live_count);
+  free(cache_time);
+  free(adjacency_offs);
+  free(adjacency);
+  free(emitted);
+  free(dead_end);
+  free(candidates);
+  free(output);
+  free(clusters);
+}
+
+/* Hash of the integer coordinates of a grid cell */
+static uint32_t mesh_hash_cell(const int32_t cell[3])
+{
+  uint32_t hash = (uint32_t)cell[0] * 73856093u;
+  hash ^= (uint32_t)cell[1] * 19349663u;
+  hash ^= (uint32_t)cell[2] * 83492791u;
+  return hash;
+}
+
+uint32_t mesh_simplify(const uint32_t* indices, uint32_t index_count,
+                       uint32_t vertex_count, const float* positions,
+                       size_t position_stride, float cell_size,
+                       uint32_t* dest)
+{
+  if (index_count < 3 || vertex_count == 0 || cell_size <= 0.0f) {
+    memcpy(dest, indices, index_count * sizeof(uint32_t));
+    return index_count;
+  }
+
+  /* Grid origin */
+  float origin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    const float* p = mesh_get_position(positions, position_stride, v);
+    for (uint32_t k = 0; k < 3; ++k) {
+      origin[k] = p[k] < origin[k] ? p[k] : origin[k];
+    }
+  }
+
+  /* Open addressing table of the occupied cells, with the vertex closest to
+   * the cell center as representative */
+  uint32_t capacity = 1;
+  while (capacity < vertex_count * 2) {
+    capacity <<= 1;
+  }
+  int32_t(*cells)[3]    = malloc(capacity * sizeof(*cells));
+  uint32_t* cell_vertex = malloc(capacity * sizeof(uint32_t));
+  float* cell_distance  = malloc(capacity * sizeof(float));
+  uint32_t* vertex_cell = malloc(vertex_count * sizeof(uint32_t));
+  for (uint32_t c = 0; c < capacity; ++c) {
+    cell_vertex[c] = MESH_NO_VERTEX;
+  }
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    const float* p  = mesh_get_position(positions, position_stride, v);
+    int32_t cell[3] = {0, 0, 0};
+    float distance  = 0.0f;
+    for (uint32_t k = 0; k < 3; ++k) {
+      const float coord = (p[k] - origin[k]) / cell_size;
+      cell[k]           = (int32_t)coord;
+      const float d     = coord - (float)cell[k] - 0.5f;
+      distance += d * d;
+    }
+    uint32_t slot = mesh_hash_cell(cell) & (capacity - 1);
+    while (cell_vertex[slot] != MESH_NO_VERTEX
+           && memcmp(cells[slot], cell, sizeof(cell)) != 0) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if (cell_vertex[slot] == MESH_NO_VERTEX || distance < cell_distance[slot]) {
+      memcpy(cells[slot], cell, sizeof(cell));
+      cell_vertex[slot]   = v;
+      cell_distance[slot] = distance;
+    }
+    vertex_cell[v] = slot;
+  }
+
+  /* Remap the triangles, dropping the collapsed ones */
+  uint32_t dest_count = 0;
+  for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+    const uint32_t v0 = cell_vertex[vertex_cell[indices[i + 0]]];
+    const uint32_t v1 = cell_vertex[vertex_cell[indices[i + 1]]];
+    const uint32_t v2 = cell_vertex[vertex_cell[indices[i + 2]]];
+    if (v0 != v1 && v1 != v2 && v0 != v2) {
+      dest[dest_count++] = v0;
+      dest[dest_count++] = v1;
+      dest[dest_count++] = v2;
+    }
+  }
+
+  free(cells);
+  free(cell_vertex);
+  free(cell_distance);
+  free(vertex_cell);
+
+  return dest_count;
+}
+
+static void mesh_meshlet_defaults(uint32_t* max_triangles,
+                                  uint32_t* max_vertices)
+{
+  if (*max_triangles == 0) {
+    *max_triangles = MESH_MESHLET_MAX_TRIANGLES;
+  }
+  /* A single triangle always fits */
+  if (*max_vertices < 3) {
+    *max_vertices = MESH_MESHLET_MAX_VERTICES;
+  }
+}
+
+uint32_t mesh_meshlet_bound(uint32_t index_count, uint32_t max_triangles,
+                            uint32_t max_vertices)
+{
+  mesh_meshlet_defaults(&max_triangles, &max_vertices);
+  /* Every meshlet but the last one is full, either in triangles or with at
+   * least max_vertices - 2 vertices, which takes max_vertices / 3 triangles */
+  const uint32_t triangle_count = index_count / 3;
+  const uint32_t min_triangles  = max_triangles < max_vertices / 3 ?
+                                    max_triangles :
+                                    max_vertices / 3;
+  return (triangle_count + min_triangles - 1) / min_triangles;
+}
+
+static void mesh_vec3_normalize(float* v)
+{
+  const float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (length > 0.0f) {
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+  }
+}
+
+static float mesh_vec3_dot(const float* a, const float* b)
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/* Bounding sphere around the center of the box of the vertices, and the cone
+ * of the unit triangle normals with its apex behind all triangles */
+static void mesh_compute_meshlet_bounds(mesh_meshlet_t* meshlet,
+                                        const uint32_t* indices,
+                                        const float* positions, size_t stride)
+{
+  const uint32_t end = meshlet->first_index + meshlet->index_count;
+  float bb_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float bb_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  float axis[3]   = {0.0f, 0.0f, 0.0f};
+  for (uint32_t i = meshlet->first_index; i < end; i += 3) {
+    const float* p[3] = {
+      mesh_get_position(positions, stride, indices[i + 0]),
+      mesh_get_position(positions, stride, indices[i + 1]),
+      mesh_get_position(positions, stride, indices[i + 2]),
+    };
+    for (uint32_t v = 0; v < 3; ++v) {
+      for (uint32_t k = 0; k < 3; ++k) {
+        bb_min[k] = fminf(bb_min[k], p[v][k]);
+        bb_max[k] = fmaxf(bb_max[k], p[v][k]);
+      }
+    }
+    const float e0[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1],
+                         p[1][2] - p[0][2]};
+    const float e1[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1],
+                         p[2][2] - p[0][2]};
+    float normal[3] = {
+      e0[1] * e1[2] - e0[2] * e1[1],
+      e0[2] * e1[0] - e0[0] * e1[2],
+      e0[0] * e1[1] - e0[1] * e1[0],
+    };
+    mesh_vec3_normalize(normal);
+    for (uint32_t k = 0; k < 3; ++k) {
+      axis[k] += normal[k];
+    }
+  }
+
+  float radius = 0.0f;
+  for (uint32_t k = 0; k < 3; ++k) {
+    meshlet->center[k] = (bb_min[k] + bb_max[k]) * 0.5f;
+  }
+  for (uint32_t i = meshlet->first_index; i < end; ++i) {
+    const float* p = mesh_get_position(positions, stride, indices[i]);
+    const float d[3]
+      = {p[0] - meshlet->center[0], p[1] - meshlet->center[1],
+         p[2] - meshlet->center[2]};
+    radius = fmaxf(radius, mesh_vec3_dot(d, d));
+  }
+  meshlet->radius = sqrtf(radius);
+
+  /* The cone spans the normal deviating most from the mean axis */
+  mesh_vec3_normalize(axis);
+  float min_dot = 1.0f, max_t = 0.0f;
+  for (uint32_t i = meshlet->first_index; i < end; i += 3) {
+    const float* p0 = mesh_get_position(positions, stride, indices[i + 0]);
+    const float* p1 = mesh_get_position(positions, stride, indices[i + 1]);
+    const float* p2 = mesh_get_position(positions, stride, indices[i + 2]);
+    const float e0[3]  = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const float e1[3]  = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    float normal[3] = {
+      e0[1] * e1[2] - e0[2] * e1[1],
+      e0[2] * e1[0] - e0[0] * e1[2],
+      e0[0] * e1[1] - e0[1] * e1[0],
+    };
+    if (mesh_vec3_dot(normal, normal) == 0.0f) {
+      continue;
+    }
+    mesh_vec3_normalize(normal);
+    const float dot = mesh_vec3_dot(normal, axis);
+    min_dot         = fminf(min_dot, dot);
+    /* Distance along the axis from the center to the plane of the triangle,
+     * the apex lies behind the farthest plane */
+    if (dot > 0.0f) {
+      const float c[3] = {meshlet->center[0] - p0[0],
+                          meshlet->center[1] - p0[1],
+                          meshlet->center[2] - p0[2]};
+      max_t = fmaxf(max_t, mesh_vec3_dot(c, normal) / dot);
+    }
+  }
+  memcpy(meshlet->cone_axis, axis, sizeof(axis));
+  for (uint32_t k = 0; k < 3; ++k) {
+    meshlet->cone_apex[k] = meshlet->center[k] - axis[k] * max_t;
+  }
+  /* Normals spanning more than a hemisphere (with some margin) never face
+   * away together */
+  meshlet->cone_cutoff
+    = min_dot <= 0.1f ? 1.0f : sqrtf(1.0f - min_dot * min_dot);
+}
+
+uint32_t mesh_build_meshlets(const uint32_t* indices, uint32_t index_count,
+                             uint32_t vertex_count, const float* positions,
+                             size_t position_stride, uint32_t max_triangles,
+                             uint32_t max_vertices, mesh_meshlet_t* meshlets)
+{
+  mesh_meshlet_defaults(&max_triangles, &max_vertices);
+  /* Meshlet + 1 a vertex was last added to */
+  uint32_t* vertex_meshlet = calloc(vertex_count > 0 ? vertex_count : 1,
+                                    sizeof(uint32_t));
+  if (vertex_meshlet == NULL) {
+    return 0;
+  }
+
+  uint32_t meshlet_count = 0, meshlet_vertex_count = 0;
+  mesh_meshlet_t* meshlet = NULL;
+  for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+    uint32_t new_vertex_count = 0;
+    for (uint32_t k = 0; k < 3; ++k) {
+      new_vertex_count += meshlet == NULL
+                          || vertex_meshlet[indices[i + k]] != meshlet_count;
+    }
+    if (meshlet == NULL || meshlet->index_count == max_triangles * 3
+        || meshlet_vertex_count + new_vertex_count > max_vertices) {
+      if (meshlet != NULL) {
+        mesh_compute_meshlet_bounds(meshlet, indices, positions,
+                                    position_stride);
+      }
+      meshlet              = &meshlets[meshlet_count++];
+      meshlet->first_index = i;
+      meshlet->index_count = 0;
+      meshlet_vertex_count = 0;
+    }
+    for (uint32_t k = 0; k < 3; ++k) {
+      if (vertex_meshlet[indices[i + k]] != meshlet_count) {
+        vertex_meshlet[indices[i + k]] = meshlet_count;
+        ++meshlet_vertex_count;
+      }
+    }
+    meshlet->index_count += 3;
+  }
+  if (meshlet != NULL) {
+    mesh_compute_meshlet_bounds(meshlet, indices, positions, position_stride);
+  }
+
+  free(vertex_meshlet);
+
+  return meshlet_count;
+}
@@ -0,0 +1,86 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Post-transform vertex cache size the triangle order is optimized for */
+#define MESH_OPTIMIZER_CACHE_SIZE 16u
+
+/**
+ * @brief Reorders the triangles of an indexed triangle list in place for a
+ * better post-transform vertex cache hit rate and, when positions are given,
+ * less overdraw.
+ * @ref Sander, Nehab, Barczak: Fast Triangle Reordering for Vertex Locality
+ * and Reduced Overdraw (Tipsify), 2007
+ * @param indices triangle list indices in the range [0, vertex_count)
+ * @param index_count number of indices, a multiple of three
+ * @param vertex_count number of vertices referenced by the indices
+ * @param positions optional float3 vertex positions, NULL skips the overdraw
+ * pass
+ * @param position_stride number of bytes between two positions
+ */
+void mesh_optimize_triangle_order(uint32_t* indices, uint32_t index_count,
+                                  uint32_t vertex_count, const float* positions,
+                                  size_t position_stride);
+
+/**
+ * @brief Simplifies an indexed triangle list by vertex clustering. Vertices
+ * are snapped to the vertex closest to the center of their cell in a uniform
+ * grid, triangles collapsing to lines or points are removed. The simplified
+ * list only references existing vertices.
+ * @ref Rossignac, Borrel: Multi-resolution 3D approximations for rendering
+ * complex scenes, 1993
+ * @param dest simplified triangle list, holds up to index_count indices
+ * @param cell_size edge length of the grid cells, the maximum error
+ * @return the number of indices written to dest
+ */
+uint32_t mesh_simplify(const uint32_t* indices, uint32_t index_count,
+                       uint32_t vertex_count, const float* positions,
+                       size_t position_stride, float cell_size,
+                       uint32_t* dest);
+
+/* Default meshlet size limits of mesh_build_meshlets */
+#define MESH_MESHLET_MAX_TRIANGLES 124u
+#define MESH_MESHLET_MAX_VERTICES 64u
+
+/*
+ * Cluster of consecutive triangles of a triangle list with the bounds used to
+ * cull it: the bounding sphere and the cone containing the normals of its
+ * triangles. The cluster faces away from a viewer at position v when
+ * dot(normalize(cone_apex - v), cone_axis) >= cone_cutoff, a cutoff of 1 or
+ * more never culls.
+ */
+typedef struct mesh_meshlet_t {
+  uint32_t first_index;
+  uint32_t index_count;
+  float center[3];
+  float radius;
+  float cone_apex[3];
+  float cone_axis[3];
+  float cone_cutoff;
+} mesh_meshlet_t;
+
+/* Upper bound of the number of meshlets built from index_count indices */
+uint32_t mesh_meshlet_bound(uint32_t index_count, uint32_t max_triangles,
+                            uint32_t max_vertices);
+
+/**
+ * @brief Splits an indexed triangle list into meshlets of consecutive
+ * triangles, a new meshlet is started when the current one reaches
+ * max_triangles triangles or max_vertices unique vertices. The indices are
+ * expected in an order with good locality, see mesh_optimize_triangle_order.
+ * @ref Kapoulkine: meshoptimizer, cluster bounds and cone culling
+ * @param meshlets receives up to mesh_meshlet_bound() meshlets
+ * @param max_triangles triangles per meshlet, 0 selects
+ * MESH_MESHLET_MAX_TRIANGLES
+ * @param max_vertices unique vertices per meshlet, 0 selects
+ * MESH_MESHLET_MAX_VERTICES
+ * @return the number of meshlets written
+ */
+uint32_t mesh_build_meshlets(const uint32_t* indices, uint32_t index_count,
+                             uint32_t vertex_count, const float* positions,
+                             size_t position_stride, uint32_t max_triangles,
+                             uint32_t max_vertices, mesh_meshlet_t* meshlets);
+
+#endif /* MESH_OPTIMIZER_H */
@@ -1,6 +1,8 @@
 #ifndef PLATFORM_H
 #define PLATFORM_H
 
+#include <stdint.h>
+
 /* date class */
 typedef struct date_t {
   int msec;
@@ -19,5 +21,10 @@ void initialize_default_path(void);
 /* misc platform functions */
 void get_local_time(date_t* current_date);
 float platform_get_time(void);
+/* Monotonic clock in nanoseconds. Unlike the float seconds since the first
+ * call of platform_get_time, it keeps its resolution in long runs, measure
+ * frame times and other durations with it */
+uint64_t platform_get_time_ns(void);
+void platform_sleep(float seconds);
 
 #endif
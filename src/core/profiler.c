@@ -0,0 +1,295 @@
+#include "profiler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "macro.h"
+#include "platform.h"
+
+#define PROFILER_MAX_TRACK_COUNT 8u
+
+typedef struct profiler_event_t {
+  const char* name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+} profiler_event_t;
+
+typedef struct profiler_thread_t {
+  char name[PROFILER_MAX_NAME_LENGTH];
+  profiler_event_t events[PROFILER_MAX_EVENT_COUNT];
+  /* Number of events ever recorded, the ring holds the last ones */
+  uint64_t event_count;
+  /* Open scopes */
+  struct {
+    const char* name;
+    uint64_t begin_ns;
+  } stack[PROFILER_MAX_SCOPE_DEPTH];
+  uint32_t depth;
+} profiler_thread_t;
+
+typedef struct profiler_track_event_t {
+  uint32_t track;
+  char name[PROFILER_MAX_NAME_LENGTH];
+  uint64_t begin_ns;
+  uint64_t end_ns;
+} profiler_track_event_t;
+
+static struct {
+  profiler_thread_t* threads[PROFILER_MAX_THREAD_COUNT];
+  uint32_t thread_count;
+  /* Tracks of other sources, guarded by the mutex */
+  pthread_mutex_t track_mutex;
+  char track_names[PROFILER_MAX_TRACK_COUNT][PROFILER_MAX_NAME_LENGTH];
+  uint32_t track_count;
+  profiler_track_event_t* track_events;
+  uint64_t track_event_count;
+} profiler = {
+  .track_mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Buffer of the calling thread, NULL before its first event */
+static __thread profiler_thread_t* profiler_thread = NULL;
+/* Set when the calling thread could not get a buffer */
+static __thread bool profiler_thread_full = false;
+
+static profiler_thread_t* profiler_get_thread(void)
+{
+  if (profiler_thread != NULL || profiler_thread_full) {
+    return profiler_thread;
+  }
+
+  const uint32_t index
+    = __atomic_fetch_add(&profiler.thread_count, 1, __ATOMIC_ACQ_REL);
+  if (index >= PROFILER_MAX_THREAD_COUNT) {
+    log_warn("Profiler thread limit reached, events are dropped");
+    profiler_thread_full = true;
+    return NULL;
+  }
+
+  profiler_thread_t* thread
+    = (profiler_thread_t*)calloc(1, sizeof(profiler_thread_t));
+  ASSERT(thread != NULL);
+  snprintf(thread->name, sizeof(thread->name), "Thread %u", index);
+  __atomic_store_n(&profiler.threads[index], thread, __ATOMIC_RELEASE);
+  profiler_thread = thread;
+  return thread;
+}
+
+void profiler_begin(const char* name)
+{
+  profiler_thread_t* thread = profiler_get_thread();
+  if (thread == NULL) {
+    return;
+  }
+
+  // Deeper scopes are not recorded, but still balanced by profiler_end
+  if (thread->depth < PROFILER_MAX_SCOPE_DEPTH) {
+    thread->stack[thread->depth].name     = name;
+    thread->stack[thread->depth].begin_ns = platform_get_time_ns();
+  }
+  ++thread->depth;
+}
+
+void profiler_end(void)
+{
+  profiler_thread_t* thread = profiler_thread;
+  if (thread == NULL || thread->depth == 0) {
+    return;
+  }
+
+  --thread->depth;
+  if (thread->depth < PROFILER_MAX_SCOPE_DEPTH) {
+    const uint64_t count    = thread->event_count;
+    profiler_event_t* event = &thread->events[count % PROFILER_MAX_EVENT_COUNT];
+    event->name             = thread->stack[thread->depth].name;
+    event->begin_ns         = thread->stack[thread->depth].begin_ns;
+    event->end_ns           = platform_get_time_ns();
+    __atomic_store_n(&thread->event_count, count + 1, __ATOMIC_RELEASE);
+  }
+}
+
+void profiler_set_thread_name(const char* name)
+{
+  profiler_thread_t* thread = profiler_get_thread();
+  if (thread != NULL) {
+    snprintf(thread->name, sizeof(thread->name), "%s", name);
+  }
+}
+
+void profiler_add_track_event(const char* track, const char* name,
+                              uint64_t begin_ns, uint64_t end_ns)
+{
+  pthread_mutex_lock(&profiler.track_mutex);
+
+  uint32_t track_index = 0;
+  while (track_index < profiler.track_count
+         && strcmp(profiler.track_names[track_index], track) != 0) {
+    ++track_index;
+  }
+  if (track_index == profiler.track_count) {
+    if (profiler.track_count == PROFILER_MAX_TRACK_COUNT) {
+      pthread_mutex_unlock(&profiler.track_mutex);
+      return;
+    }
+    snprintf(profiler.track_names[track_index],
+             sizeof(profiler.track_names[track_index]), "%s", track);
+    ++profiler.track_count;
+  }
+
+  if (profiler.track_events == NULL) {
+    profiler.track_events = (profiler_track_event_t*)calloc(
+      PROFILER_MAX_TRACK_EVENT_COUNT, sizeof(profiler_track_event_t));
+    ASSERT(profiler.track_events != NULL);
+  }
+  profiler_track_event_t* event
+    = &profiler.track_events[profiler.track_event_count
+                             % PROFILER_MAX_TRACK_EVENT_COUNT];
+  event->track    = track_index;
+  event->begin_ns = begin_ns;
+  event->end_ns   = end_ns;
+  snprintf(event->name, sizeof(event->name), "%s", name);
+  ++profiler.track_event_count;
+
+  pthread_mutex_unlock(&profiler.track_mutex);
+}
+
+/* Writes a JSON string, names are short and rarely need escaping */
+static void profiler_write_json_string(FILE* file, const char* str)
+{
+  fputc('"', file);
+  for (; *str != '\0'; ++str) {
+    if (*str == '"' || *str == '\\') {
+      fputc('\\', file);
+      fputc(*str, file);
+    }
+    else if ((unsigned char)*str < 0x20) {
+      fprintf(file, "\\u%04x", (unsigned char)*str);
+    }
+    else {
+      fputc(*str, file);
+    }
+  }
+  fputc('"', file);
+}
+
+static void profiler_write_event(FILE* file, bool* first, uint32_t tid,
+                                 const char* name, uint64_t begin_ns,
+                                 uint64_t end_ns, uint64_t origin_ns)
+{
+  // Timestamps are in microseconds
+  fprintf(file, "%s\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":",
+          *first ? "" : ",", tid);
+  profiler_write_json_string(file, name);
+  fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}",
+          (double)(int64_t)(begin_ns - origin_ns) / 1000.0,
+          (double)(end_ns > begin_ns ? end_ns - begin_ns : 0) / 1000.0);
+  *first = false;
+}
+
+static void profiler_write_thread_name(FILE* file, bool* first, uint32_t tid,
+                                       const char* name)
+{
+  fprintf(file,
+          "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+          "\"args\":{\"name\":",
+          *first ? "" : ",", tid);
+  profiler_write_json_string(file, name);
+  fprintf(file, "}}");
+  *first = false;
+}
+
+bool profiler_write_chrome_trace(const char* filename)
+{
+  FILE* file = fopen(filename, "w");
+  if (file == NULL) {
+    log_error("Could not open trace file %s\n", filename);
+    return false;
+  }
+
+  const uint32_t thread_count = MIN(
+    __atomic_load_n(&profiler.thread_count, __ATOMIC_ACQUIRE),
+    PROFILER_MAX_THREAD_COUNT);
+
+  // The earliest event is at time 0
+  uint64_t origin_ns = UINT64_MAX;
+  for (uint32_t t = 0; t < thread_count; ++t) {
+    profiler_thread_t* thread
+      = __atomic_load_n(&profiler.threads[t], __ATOMIC_ACQUIRE);
+    if (thread == NULL) {
+      continue;
+    }
+    const uint64_t count
+      = __atomic_load_n(&thread->event_count, __ATOMIC_ACQUIRE);
+    const uint64_t first = count > PROFILER_MAX_EVENT_COUNT ?
+                             count - PROFILER_MAX_EVENT_COUNT :
+                             0;
+    for (uint64_t i = first; i < count; ++i) {
+      origin_ns = MIN(origin_ns,
+                      thread->events[i % PROFILER_MAX_EVENT_COUNT].begin_ns);
+    }
+  }
+  pthread_mutex_lock(&profiler.track_mutex);
+  const uint64_t track_first
+    = profiler.track_event_count > PROFILER_MAX_TRACK_EVENT_COUNT ?
+        profiler.track_event_count - PROFILER_MAX_TRACK_EVENT_COUNT :
+        0;
+  for (uint64_t i = track_first; i < profiler.track_event_count; ++i) {
+    origin_ns = MIN(
+      origin_ns,
+      profiler.track_events[i % PROFILER_MAX_TRACK_EVENT_COUNT].begin_ns);
+  }
+  if (origin_ns == UINT64_MAX) {
+    origin_ns = 0;
+  }
+
+  bool first_event = true;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  // Threads, tid 1 and up
+  for (uint32_t t = 0; t < thread_count; ++t) {
+    profiler_thread_t* thread
+      = __atomic_load_n(&profiler.threads[t], __ATOMIC_ACQUIRE);
+    if (thread == NULL) {
+      continue;
+    }
+    profiler_write_thread_name(file, &first_event, t + 1, thread->name);
+    const uint64_t count
+      = __atomic_load_n(&thread->event_count, __ATOMIC_ACQUIRE);
+    const uint64_t first = count > PROFILER_MAX_EVENT_COUNT ?
+                             count - PROFILER_MAX_EVENT_COUNT :
+                             0;
+    for (uint64_t i = first; i < count; ++i) {
+      const profiler_event_t* event
+        = &thread->events[i % PROFILER_MAX_EVENT_COUNT];
+      profiler_write_event(file, &first_event, t + 1, event->name,
+                           event->begin_ns, event->end_ns, origin_ns);
+    }
+  }
+
+  // Other tracks, after the threads
+  const uint32_t track_tid = PROFILER_MAX_THREAD_COUNT + 1;
+  for (uint32_t t = 0; t < profiler.track_count; ++t) {
+    profiler_write_thread_name(file, &first_event, track_tid + t,
+                               profiler.track_names[t]);
+  }
+  for (uint64_t i = track_first; i < profiler.track_event_count; ++i) {
+    const profiler_track_event_t* event
+      = &profiler.track_events[i % PROFILER_MAX_TRACK_EVENT_COUNT];
+    profiler_write_event(file, &first_event, track_tid + event->track,
+                         event->name, event->begin_ns, event->end_ns,
+                         origin_ns);
+  }
+  pthread_mutex_unlock(&profiler.track_mutex);
+
+  fprintf(file, "\n]}\n");
+  const bool success = ferror(file) == 0;
+  fclose(file);
+
+  if (!success) {
+    log_error("Could not write trace file %s\n", filename);
+  }
+  return success;
+}
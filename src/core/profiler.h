@@ -0,0 +1,58 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Events kept per thread, the oldest ones are overwritten */
+#define PROFILER_MAX_EVENT_COUNT 65536u
+#define PROFILER_MAX_THREAD_COUNT 64u
+#define PROFILER_MAX_SCOPE_DEPTH 64u
+#define PROFILER_MAX_NAME_LENGTH 64u
+/* Events of other tracks than threads, e.g. GPU scopes */
+#define PROFILER_MAX_TRACK_EVENT_COUNT 16384u
+
+/*
+ * CPU scope profiler.
+ *
+ * Scopes are timed with platform_get_time_ns and written into a ring
+ * buffer of the calling thread, so that recording takes no lock. Events of
+ * other sources, e.g. the GPU timestamp scopes, are added to named tracks. The
+ * events are exported in the Chrome trace event format, which chrome://tracing
+ * and Perfetto open.
+ *
+ * The PROFILE_* macros only record when the build defines ENABLE_PROFILER and
+ * compile to nothing otherwise.
+ */
+#ifdef ENABLE_PROFILER
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#define PROFILE_THREAD_NAME(name) profiler_set_thread_name(name)
+#define PROFILE_TRACK_EVENT(track, name, begin_ns, end_ns)                    \
+  profiler_add_track_event(track, name, begin_ns, end_ns)
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_TRACK_EVENT(track, name, begin_ns, end_ns) ((void)0)
+#endif
+
+/* Starts a scope of the calling thread, name must stay valid (a literal) */
+void profiler_begin(const char* name);
+/* Ends the innermost scope of the calling thread */
+void profiler_end(void);
+void profiler_set_thread_name(const char* name);
+
+/* Adds a complete event to the named track, both names are copied */
+void profiler_add_track_event(const char* track, const char* name,
+                              uint64_t begin_ns, uint64_t end_ns);
+
+/**
+ * @brief Writes the recorded events as Chrome trace JSON. Events the other
+ * threads record while the trace is written may be missing or torn, export
+ * while they are idle, e.g. before exiting.
+ * @return true on success
+ */
+bool profiler_write_chrome_trace(const char* filename);
+
+#endif
@@ -0,0 +1,226 @@
+#include "random.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "macro.h"
+
+/* SIMD instruction set of the generator steps, picked at compile time */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RANDOM_SIMD_AVX2
+#define RANDOM_SIMD_WIDTH 8u
+typedef __m256i random_vec_t;
+#define RANDOM_VEC_LOAD(ptr) _mm256_loadu_si256((const __m256i*)(ptr))
+#define RANDOM_VEC_STORE(ptr, a) _mm256_storeu_si256((__m256i*)(ptr), a)
+#define RANDOM_VEC_ADD(a, b) _mm256_add_epi32(a, b)
+#define RANDOM_VEC_XOR(a, b) _mm256_xor_si256(a, b)
+#define RANDOM_VEC_OR(a, b) _mm256_or_si256(a, b)
+#define RANDOM_VEC_SHL(a, n) _mm256_slli_epi32(a, n)
+#define RANDOM_VEC_SHR(a, n) _mm256_srli_epi32(a, n)
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RANDOM_SIMD_SSE2
+#define RANDOM_SIMD_WIDTH 4u
+typedef __m128i random_vec_t;
+#define RANDOM_VEC_LOAD(ptr) _mm_loadu_si128((const __m128i*)(ptr))
+#define RANDOM_VEC_STORE(ptr, a) _mm_storeu_si128((__m128i*)(ptr), a)
+#define RANDOM_VEC_ADD(a, b) _mm_add_epi32(a, b)
+#define RANDOM_VEC_XOR(a, b) _mm_xor_si128(a, b)
+#define RANDOM_VEC_OR(a, b) _mm_or_si128(a, b)
+#define RANDOM_VEC_SHL(a, n) _mm_slli_epi32(a, n)
+#define RANDOM_VEC_SHR(a, n) _mm_srli_epi32(a, n)
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RANDOM_SIMD_NEON
+#define RANDOM_SIMD_WIDTH 4u
+typedef uint32x4_t random_vec_t;
+#define RANDOM_VEC_LOAD(ptr) vld1q_u32(ptr)
+#define RANDOM_VEC_STORE(ptr, a) vst1q_u32(ptr, a)
+#define RANDOM_VEC_ADD(a, b) vaddq_u32(a, b)
+#define RANDOM_VEC_XOR(a, b) veorq_u32(a, b)
+#define RANDOM_VEC_OR(a, b) vorrq_u32(a, b)
+#define RANDOM_VEC_SHL(a, n) vshlq_n_u32(a, n)
+#define RANDOM_VEC_SHR(a, n) vshrq_n_u32(a, n)
+#else
+#define RANDOM_SIMD_WIDTH 1u
+#endif
+
+#if RANDOM_SIMD_WIDTH > 1
+#define RANDOM_VEC_ROTL(a, k)                                                  \
+  RANDOM_VEC_OR(RANDOM_VEC_SHL(a, k), RANDOM_VEC_SHR(a, 32 - (k)))
+#endif
+
+#define RANDOM_MAX_ELEMENT_SIZE 64u
+/* Numbers converted to floats at a time, a multiple of the lane count */
+#define RANDOM_FILL_CHUNK_SIZE 256u
+
+/* Seeding of the thread generators */
+static uint64_t random_thread_count = 0;
+static __thread random_generator_t random_thread_generator;
+static __thread bool random_thread_generator_initialized = false;
+
+static uint64_t random_splitmix64(uint64_t* state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+#if RANDOM_SIMD_WIDTH == 1
+static uint32_t random_rotl(uint32_t value, uint32_t k)
+{
+  return (value << k) | (value >> (32 - k));
+}
+#endif
+
+/* Steps all lanes once and writes their RANDOM_LANE_COUNT numbers */
+static void random_generator_step(random_generator_t* generator,
+                                  uint32_t* result)
+{
+  uint32_t(*s)[RANDOM_LANE_COUNT] = generator->state;
+
+#if RANDOM_SIMD_WIDTH > 1
+  for (uint32_t l = 0; l < RANDOM_LANE_COUNT; l += RANDOM_SIMD_WIDTH) {
+    random_vec_t s0 = RANDOM_VEC_LOAD(&s[0][l]);
+    random_vec_t s1 = RANDOM_VEC_LOAD(&s[1][l]);
+    random_vec_t s2 = RANDOM_VEC_LOAD(&s[2][l]);
+    random_vec_t s3 = RANDOM_VEC_LOAD(&s[3][l]);
+    RANDOM_VEC_STORE(
+      &result[l],
+      RANDOM_VEC_ADD(RANDOM_VEC_ROTL(RANDOM_VEC_ADD(s0, s3), 7), s0));
+    const random_vec_t t = RANDOM_VEC_SHL(s1, 9);
+    s2                   = RANDOM_VEC_XOR(s2, s0);
+    s3                   = RANDOM_VEC_XOR(s3, s1);
+    s1                   = RANDOM_VEC_XOR(s1, s2);
+    s0                   = RANDOM_VEC_XOR(s0, s3);
+    s2                   = RANDOM_VEC_XOR(s2, t);
+    s3                   = RANDOM_VEC_ROTL(s3, 11);
+    RANDOM_VEC_STORE(&s[0][l], s0);
+    RANDOM_VEC_STORE(&s[1][l], s1);
+    RANDOM_VEC_STORE(&s[2][l], s2);
+    RANDOM_VEC_STORE(&s[3][l], s3);
+  }
+#else
+  for (uint32_t l = 0; l < RANDOM_LANE_COUNT; ++l) {
+    result[l]        = random_rotl(s[0][l] + s[3][l], 7) + s[0][l];
+    const uint32_t t = s[1][l] << 9;
+    s[2][l] ^= s[0][l];
+    s[3][l] ^= s[1][l];
+    s[1][l] ^= s[2][l];
+    s[0][l] ^= s[3][l];
+    s[2][l] ^= t;
+    s[3][l] = random_rotl(s[3][l], 11);
+  }
+#endif
+}
+
+/* The upper 24 bits are exactly representable, [0, 1.0) */
+static float random_to_unit_float(uint32_t value)
+{
+  return (float)(value >> 8) * (1.0f / 16777216.0f);
+}
+
+void random_generator_init(random_generator_t* generator, uint64_t seed)
+{
+  uint64_t splitmix_state = seed;
+  for (uint32_t l = 0; l < RANDOM_LANE_COUNT; ++l) {
+    for (uint32_t i = 0; i < 4; i += 2) {
+      const uint64_t value       = random_splitmix64(&splitmix_state);
+      generator->state[i][l]     = (uint32_t)value;
+      generator->state[i + 1][l] = (uint32_t)(value >> 32);
+    }
+  }
+  generator->buffer_index = RANDOM_LANE_COUNT;
+}
+
+random_generator_t* random_get_thread_generator(void)
+{
+  if (!random_thread_generator_initialized) {
+    const uint64_t index
+      = __atomic_fetch_add(&random_thread_count, 1, __ATOMIC_RELAXED);
+    random_generator_init(&random_thread_generator,
+                          (uint64_t)time(NULL) ^ (index << 32));
+    random_thread_generator_initialized = true;
+  }
+  return &random_thread_generator;
+}
+
+uint32_t random_next_u32(random_generator_t* generator)
+{
+  if (generator->buffer_index >= RANDOM_LANE_COUNT) {
+    random_generator_step(generator, generator->buffer);
+    generator->buffer_index = 0;
+  }
+  return generator->buffer[generator->buffer_index++];
+}
+
+uint32_t random_next_bounded(random_generator_t* generator, uint32_t bound)
+{
+  return (uint32_t)(((uint64_t)random_next_u32(generator) * bound) >> 32);
+}
+
+float random_next_float(random_generator_t* generator)
+{
+  return random_to_unit_float(random_next_u32(generator));
+}
+
+void random_fill_u32(random_generator_t* generator, uint32_t* values,
+                     uint32_t count)
+{
+  // Whole steps straight into the values, the tail through the buffer
+  uint32_t i = 0;
+  for (; i + RANDOM_LANE_COUNT <= count; i += RANDOM_LANE_COUNT) {
+    random_generator_step(generator, &values[i]);
+  }
+  for (; i < count; ++i) {
+    values[i] = random_next_u32(generator);
+  }
+}
+
+void random_fill_float(random_generator_t* generator, float* values,
+                       uint32_t count, float min, float max)
+{
+  const float range = max - min;
+  uint32_t bits[RANDOM_FILL_CHUNK_SIZE];
+  for (uint32_t i = 0; i < count; i += RANDOM_FILL_CHUNK_SIZE) {
+    const uint32_t chunk_size = MIN(count - i, RANDOM_FILL_CHUNK_SIZE);
+    random_fill_u32(generator, bits, chunk_size);
+    for (uint32_t j = 0; j < chunk_size; ++j) {
+      values[i + j] = min + range * random_to_unit_float(bits[j]);
+    }
+  }
+}
+
+void random_shuffle(random_generator_t* generator, void* values,
+                    uint32_t count, uint32_t element_size)
+{
+  ASSERT(element_size > 0 && element_size <= RANDOM_MAX_ELEMENT_SIZE);
+
+  uint8_t* elements = (uint8_t*)values;
+  uint8_t tmp[RANDOM_MAX_ELEMENT_SIZE];
+  for (uint32_t i = count; i > 1; --i) {
+    const uint32_t j = random_next_bounded(generator, i);
+    if (j != i - 1) {
+      memcpy(tmp, &elements[j * element_size], element_size);
+      memcpy(&elements[j * element_size], &elements[(i - 1) * element_size],
+             element_size);
+      memcpy(&elements[(i - 1) * element_size], tmp, element_size);
+    }
+  }
+}
+
+const char* random_get_simd_name(void)
+{
+#if defined(RANDOM_SIMD_AVX2)
+  return "AVX2";
+#elif defined(RANDOM_SIMD_SSE2)
+  return "SSE2";
+#elif defined(RANDOM_SIMD_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,58 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+/* Number of interleaved generators of a random generator */
+#define RANDOM_LANE_COUNT 8u
+
+/**
+ * @brief Batched pseudorandom number generator for the CPU paths.
+ *
+ * RANDOM_LANE_COUNT xoshiro128++ generators with interleaved states are
+ * stepped together with SIMD (AVX2, SSE2 or NEON, as enabled for the build),
+ * every step yields RANDOM_LANE_COUNT numbers. The lane count does not depend
+ * on the instruction set, a seed gives the same sequence on every build.
+ *
+ * Unlike rand() a generator holds no lock, every thread uses its own one, see
+ * random_get_thread_generator(). A generator is not thread safe.
+ */
+typedef struct random_generator_t {
+  uint32_t state[4][RANDOM_LANE_COUNT];
+  /* Numbers of the last step not returned by random_next_u32() yet */
+  uint32_t buffer[RANDOM_LANE_COUNT];
+  uint32_t buffer_index;
+} random_generator_t;
+
+/* Seeds the lanes of a generator with splitmix64 of the seed */
+void random_generator_init(random_generator_t* generator, uint64_t seed);
+
+/**
+ * @brief Returns the generator of the calling thread, seeded on first use
+ * from the time and an index of the thread. Generators seeded explicitly
+ * with random_generator_init() give reproducible sequences.
+ */
+random_generator_t* random_get_thread_generator(void);
+
+uint32_t random_next_u32(random_generator_t* generator);
+/* Random number in range [0, bound), by multiply-shift without rejection */
+uint32_t random_next_bounded(random_generator_t* generator, uint32_t bound);
+/* Random float number in range [0.0f, 1.0f) */
+float random_next_float(random_generator_t* generator);
+
+/* Bulk fills, count numbers at a time */
+void random_fill_u32(random_generator_t* generator, uint32_t* values,
+                     uint32_t count);
+/* Random float numbers in range [min, max) */
+void random_fill_float(random_generator_t* generator, float* values,
+                       uint32_t count, float min, float max);
+
+/* Fisher–Yates shuffle of count elements of element_size bytes at most 64 */
+void random_shuffle(random_generator_t* generator, void* values,
+                    uint32_t count, uint32_t element_size);
+
+/* Instruction set of the generator steps: "AVX2", "SSE2", "NEON" or
+ * "scalar" */
+const char* random_get_simd_name(void);
+
+#endif
@@ -0,0 +1,345 @@
+#include "transform_batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "macro.h"
+
+/* SIMD instruction set of the local matrix composition, picked at compile
+ * time */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRANSFORM_SIMD_AVX2
+#define TRANSFORM_SIMD_WIDTH 8u
+typedef __m256 transform_vec_t;
+#define TRANSFORM_VEC_LOAD(ptr) _mm256_loadu_ps(ptr)
+#define TRANSFORM_VEC_SET1(value) _mm256_set1_ps(value)
+#define TRANSFORM_VEC_ADD(a, b) _mm256_add_ps(a, b)
+#define TRANSFORM_VEC_SUB(a, b) _mm256_sub_ps(a, b)
+#define TRANSFORM_VEC_MUL(a, b) _mm256_mul_ps(a, b)
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSFORM_SIMD_SSE2
+#define TRANSFORM_SIMD_WIDTH 4u
+typedef __m128 transform_vec_t;
+#define TRANSFORM_VEC_LOAD(ptr) _mm_loadu_ps(ptr)
+#define TRANSFORM_VEC_SET1(value) _mm_set1_ps(value)
+#define TRANSFORM_VEC_ADD(a, b) _mm_add_ps(a, b)
+#define TRANSFORM_VEC_SUB(a, b) _mm_sub_ps(a, b)
+#define TRANSFORM_VEC_MUL(a, b) _mm_mul_ps(a, b)
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TRANSFORM_SIMD_NEON
+#define TRANSFORM_SIMD_WIDTH 4u
+typedef float32x4_t transform_vec_t;
+#define TRANSFORM_VEC_LOAD(ptr) vld1q_f32(ptr)
+#define TRANSFORM_VEC_SET1(value) vdupq_n_f32(value)
+#define TRANSFORM_VEC_ADD(a, b) vaddq_f32(a, b)
+#define TRANSFORM_VEC_SUB(a, b) vsubq_f32(a, b)
+#define TRANSFORM_VEC_MUL(a, b) vmulq_f32(a, b)
+#else
+#define TRANSFORM_SIMD_WIDTH 1u
+#endif
+
+static void transform_batch_reserve(transform_batch_t* batch,
+                                    uint32_t capacity)
+{
+  if (capacity <= batch->capacity) {
+    return;
+  }
+
+  float** components[10] = {
+    &batch->translation_x, &batch->translation_y, &batch->translation_z,
+    &batch->rotation_x,    &batch->rotation_y,    &batch->rotation_z,
+    &batch->rotation_w,    &batch->scale_x,       &batch->scale_y,
+    &batch->scale_z,
+  };
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(components); ++i) {
+    *components[i] = (float*)realloc(*components[i], capacity * sizeof(float));
+    ASSERT(*components[i] != NULL);
+  }
+  batch->parents
+    = (int32_t*)realloc(batch->parents, capacity * sizeof(int32_t));
+  batch->local_matrices
+    = (mat4*)realloc(batch->local_matrices, capacity * sizeof(mat4));
+  batch->world_matrices
+    = (mat4*)realloc(batch->world_matrices, capacity * sizeof(mat4));
+  ASSERT(batch->parents != NULL && batch->local_matrices != NULL
+         && batch->world_matrices != NULL);
+  batch->capacity = capacity;
+}
+
+/* transform batch initialization/releasing */
+
+void transform_batch_init(transform_batch_t* batch, uint32_t capacity)
+{
+  memset(batch, 0, sizeof(transform_batch_t));
+  transform_batch_reserve(batch, capacity);
+}
+
+void transform_batch_release(transform_batch_t* batch)
+{
+  free(batch->translation_x);
+  free(batch->translation_y);
+  free(batch->translation_z);
+  free(batch->rotation_x);
+  free(batch->rotation_y);
+  free(batch->rotation_z);
+  free(batch->rotation_w);
+  free(batch->scale_x);
+  free(batch->scale_y);
+  free(batch->scale_z);
+  free(batch->parents);
+  free(batch->local_matrices);
+  free(batch->world_matrices);
+  memset(batch, 0, sizeof(transform_batch_t));
+}
+
+/* transform batch editing */
+
+uint32_t transform_batch_add(transform_batch_t* batch, int32_t parent)
+{
+  ASSERT(parent < (int32_t)batch->count);
+  if (batch->count == batch->capacity) {
+    transform_batch_reserve(batch, MAX(batch->capacity * 2, 64u));
+  }
+
+  const uint32_t index = batch->count++;
+  transform_batch_set(batch, index, GLM_VEC3_ZERO, GLM_QUAT_IDENTITY,
+                      GLM_VEC3_ONE);
+  batch->parents[index] = parent;
+  glm_mat4_identity(batch->local_matrices[index]);
+  glm_mat4_identity(batch->world_matrices[index]);
+  return index;
+}
+
+void transform_batch_set(transform_batch_t* batch, uint32_t index,
+                         vec3 translation, versor rotation, vec3 scale)
+{
+  batch->translation_x[index] = translation[0];
+  batch->translation_y[index] = translation[1];
+  batch->translation_z[index] = translation[2];
+  batch->rotation_x[index]    = rotation[0];
+  batch->rotation_y[index]    = rotation[1];
+  batch->rotation_z[index]    = rotation[2];
+  batch->rotation_w[index]    = rotation[3];
+  batch->scale_x[index]       = scale[0];
+  batch->scale_y[index]       = scale[1];
+  batch->scale_z[index]       = scale[2];
+}
+
+/* local matrix composition */
+
+/*
+ * translation * rotation * scale of one transform, with the operations in the
+ * order of the SIMD version so that both give identical matrices
+ */
+static void transform_batch_compose_matrix(transform_batch_t* batch,
+                                           uint32_t i)
+{
+  const float x = batch->rotation_x[i], y = batch->rotation_y[i],
+              z = batch->rotation_z[i], w = batch->rotation_w[i];
+  const float x2 = x + x, y2 = y + y, z2 = z + z;
+  const float xx = x * x2, yy = y * y2, zz = z * z2;
+  const float xy = x * y2, xz = x * z2, yz = y * z2;
+  const float wx = w * x2, wy = w * y2, wz = w * z2;
+  const float sx = batch->scale_x[i], sy = batch->scale_y[i],
+              sz = batch->scale_z[i];
+
+  mat4* m     = &batch->local_matrices[i];
+  (*m)[0][0] = (1.0f - (yy + zz)) * sx;
+  (*m)[0][1] = (xy + wz) * sx;
+  (*m)[0][2] = (xz - wy) * sx;
+  (*m)[0][3] = 0.0f;
+  (*m)[1][0] = (xy - wz) * sy;
+  (*m)[1][1] = (1.0f - (xx + zz)) * sy;
+  (*m)[1][2] = (yz + wx) * sy;
+  (*m)[1][3] = 0.0f;
+  (*m)[2][0] = (xz + wy) * sz;
+  (*m)[2][1] = (yz - wx) * sz;
+  (*m)[2][2] = (1.0f - (xx + yy)) * sz;
+  (*m)[2][3] = 0.0f;
+  (*m)[3][0] = batch->translation_x[i];
+  (*m)[3][1] = batch->translation_y[i];
+  (*m)[3][2] = batch->translation_z[i];
+  (*m)[3][3] = 1.0f;
+}
+
+#if TRANSFORM_SIMD_WIDTH > 1
+
+#if defined(TRANSFORM_SIMD_AVX2)
+
+/* Transposes the columns of 8 matrices, rows[r] holds element r of all */
+static void transform_batch_store_columns(const __m256 rows[4], uint32_t column,
+                                          mat4* dest)
+{
+  for (uint32_t half = 0; half < 2; ++half) {
+    __m128 r0 = half == 0 ? _mm256_castps256_ps128(rows[0]) :
+                            _mm256_extractf128_ps(rows[0], 1);
+    __m128 r1 = half == 0 ? _mm256_castps256_ps128(rows[1]) :
+                            _mm256_extractf128_ps(rows[1], 1);
+    __m128 r2 = half == 0 ? _mm256_castps256_ps128(rows[2]) :
+                            _mm256_extractf128_ps(rows[2], 1);
+    __m128 r3 = half == 0 ? _mm256_castps256_ps128(rows[3]) :
+                            _mm256_extractf128_ps(rows[3], 1);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dest[half * 4 + 0][column], r0);
+    _mm_storeu_ps(dest[half * 4 + 1][column], r1);
+    _mm_storeu_ps(dest[half * 4 + 2][column], r2);
+    _mm_storeu_ps(dest[half * 4 + 3][column], r3);
+  }
+}
+
+#elif defined(TRANSFORM_SIMD_SSE2)
+
+static void transform_batch_store_columns(const __m128 rows[4], uint32_t column,
+                                          mat4* dest)
+{
+  __m128 r0 = rows[0], r1 = rows[1], r2 = rows[2], r3 = rows[3];
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(dest[0][column], r0);
+  _mm_storeu_ps(dest[1][column], r1);
+  _mm_storeu_ps(dest[2][column], r2);
+  _mm_storeu_ps(dest[3][column], r3);
+}
+
+#elif defined(TRANSFORM_SIMD_NEON)
+
+static void transform_batch_store_columns(const float32x4_t rows[4],
+                                          uint32_t column, mat4* dest)
+{
+  const float32x4x2_t t0 = vtrnq_f32(rows[0], rows[1]);
+  const float32x4x2_t t1 = vtrnq_f32(rows[2], rows[3]);
+  vst1q_f32(dest[0][column], vcombine_f32(vget_low_f32(t0.val[0]),
+                                          vget_low_f32(t1.val[0])));
+  vst1q_f32(dest[1][column], vcombine_f32(vget_low_f32(t0.val[1]),
+                                          vget_low_f32(t1.val[1])));
+  vst1q_f32(dest[2][column], vcombine_f32(vget_high_f32(t0.val[0]),
+                                          vget_high_f32(t1.val[0])));
+  vst1q_f32(dest[3][column], vcombine_f32(vget_high_f32(t0.val[1]),
+                                          vget_high_f32(t1.val[1])));
+}
+
+#endif
+
+/* Composes the local matrices of TRANSFORM_SIMD_WIDTH transforms from i on */
+static void transform_batch_compose_matrices(transform_batch_t* batch,
+                                             uint32_t i)
+{
+  const transform_vec_t x  = TRANSFORM_VEC_LOAD(batch->rotation_x + i);
+  const transform_vec_t y  = TRANSFORM_VEC_LOAD(batch->rotation_y + i);
+  const transform_vec_t z  = TRANSFORM_VEC_LOAD(batch->rotation_z + i);
+  const transform_vec_t w  = TRANSFORM_VEC_LOAD(batch->rotation_w + i);
+  const transform_vec_t x2 = TRANSFORM_VEC_ADD(x, x);
+  const transform_vec_t y2 = TRANSFORM_VEC_ADD(y, y);
+  const transform_vec_t z2 = TRANSFORM_VEC_ADD(z, z);
+  const transform_vec_t xx = TRANSFORM_VEC_MUL(x, x2);
+  const transform_vec_t yy = TRANSFORM_VEC_MUL(y, y2);
+  const transform_vec_t zz = TRANSFORM_VEC_MUL(z, z2);
+  const transform_vec_t xy = TRANSFORM_VEC_MUL(x, y2);
+  const transform_vec_t xz = TRANSFORM_VEC_MUL(x, z2);
+  const transform_vec_t yz = TRANSFORM_VEC_MUL(y, z2);
+  const transform_vec_t wx = TRANSFORM_VEC_MUL(w, x2);
+  const transform_vec_t wy = TRANSFORM_VEC_MUL(w, y2);
+  const transform_vec_t wz = TRANSFORM_VEC_MUL(w, z2);
+  const transform_vec_t sx = TRANSFORM_VEC_LOAD(batch->scale_x + i);
+  const transform_vec_t sy = TRANSFORM_VEC_LOAD(batch->scale_y + i);
+  const transform_vec_t sz = TRANSFORM_VEC_LOAD(batch->scale_z + i);
+  const transform_vec_t zero = TRANSFORM_VEC_SET1(0.0f);
+  const transform_vec_t one  = TRANSFORM_VEC_SET1(1.0f);
+
+  mat4* dest = &batch->local_matrices[i];
+  const transform_vec_t column0[4] = {
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_SUB(one, TRANSFORM_VEC_ADD(yy, zz)), sx),
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_ADD(xy, wz), sx),
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_SUB(xz, wy), sx),
+    zero,
+  };
+  transform_batch_store_columns(column0, 0, dest);
+  const transform_vec_t column1[4] = {
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_SUB(xy, wz), sy),
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_SUB(one, TRANSFORM_VEC_ADD(xx, zz)), sy),
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_ADD(yz, wx), sy),
+    zero,
+  };
+  transform_batch_store_columns(column1, 1, dest);
+  const transform_vec_t column2[4] = {
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_ADD(xz, wy), sz),
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_SUB(yz, wx), sz),
+    TRANSFORM_VEC_MUL(TRANSFORM_VEC_SUB(one, TRANSFORM_VEC_ADD(xx, yy)), sz),
+    zero,
+  };
+  transform_batch_store_columns(column2, 2, dest);
+  const transform_vec_t column3[4] = {
+    TRANSFORM_VEC_LOAD(batch->translation_x + i),
+    TRANSFORM_VEC_LOAD(batch->translation_y + i),
+    TRANSFORM_VEC_LOAD(batch->translation_z + i),
+    one,
+  };
+  transform_batch_store_columns(column3, 3, dest);
+}
+
+#endif
+
+void transform_batch_compose_local(transform_batch_t* batch, uint32_t first,
+                                   uint32_t count)
+{
+  ASSERT(first + count <= batch->count);
+  const uint32_t end = first + count;
+  uint32_t i         = first;
+#if TRANSFORM_SIMD_WIDTH > 1
+  for (; i + TRANSFORM_SIMD_WIDTH <= end; i += TRANSFORM_SIMD_WIDTH) {
+    transform_batch_compose_matrices(batch, i);
+  }
+#endif
+  for (; i < end; ++i) {
+    transform_batch_compose_matrix(batch, i);
+  }
+}
+
+void transform_batch_compose_local_scalar(transform_batch_t* batch,
+                                          uint32_t first, uint32_t count)
+{
+  ASSERT(first + count <= batch->count);
+  for (uint32_t i = first; i < first + count; ++i) {
+    transform_batch_compose_matrix(batch, i);
+  }
+}
+
+/* world matrix updating */
+
+void transform_batch_update_world(transform_batch_t* batch, uint32_t first,
+                                  uint32_t count)
+{
+  ASSERT(first + count <= batch->count);
+  for (uint32_t i = first; i < first + count; ++i) {
+    const int32_t parent = batch->parents[i];
+    if (parent < 0) {
+      glm_mat4_copy(batch->local_matrices[i], batch->world_matrices[i]);
+    }
+    else {
+      // Both matrices are affine, which saves the products of the last rows
+      glm_mul(batch->world_matrices[parent], batch->local_matrices[i],
+              batch->world_matrices[i]);
+    }
+  }
+}
+
+void transform_batch_update(transform_batch_t* batch)
+{
+  transform_batch_compose_local(batch, 0, batch->count);
+  transform_batch_update_world(batch, 0, batch->count);
+}
+
+const char* transform_batch_get_simd_name(void)
+{
+#if defined(TRANSFORM_SIMD_AVX2)
+  return "AVX2";
+#elif defined(TRANSFORM_SIMD_SSE2)
+  return "SSE2";
+#elif defined(TRANSFORM_SIMD_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
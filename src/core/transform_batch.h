@@ -0,0 +1,69 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <cglm/cglm.h>
+
+/**
+ * @brief Transforms of many nodes in structure of arrays layout.
+ *
+ * The translation, rotation (quaternion) and scale components of all nodes
+ * are stored in separate arrays, so that the local matrices are composed for
+ * several nodes at once with SIMD (AVX2, SSE2 or NEON, as enabled for the
+ * build). The local and world matrices are contiguous, the world matrices can
+ * be uploaded to a storage buffer with a single write.
+ *
+ * Parents are referenced by index and must precede their children, the world
+ * matrices are then updated in a single pass in index order.
+ */
+typedef struct transform_batch_t {
+  uint32_t count;
+  uint32_t capacity;
+  float* translation_x;
+  float* translation_y;
+  float* translation_z;
+  float* rotation_x;
+  float* rotation_y;
+  float* rotation_z;
+  float* rotation_w;
+  float* scale_x;
+  float* scale_y;
+  float* scale_z;
+  /* Index of the parent, lower than the own index, -1 for roots */
+  int32_t* parents;
+  /* translation * rotation * scale */
+  mat4* local_matrices;
+  /* Local matrices concatenated with the parent ones */
+  mat4* world_matrices;
+} transform_batch_t;
+
+/* transform batch initialization/releasing */
+void transform_batch_init(transform_batch_t* batch, uint32_t capacity);
+void transform_batch_release(transform_batch_t* batch);
+
+/* Appends an identity transform, the arrays grow as needed, returns its
+ * index */
+uint32_t transform_batch_add(transform_batch_t* batch, int32_t parent);
+void transform_batch_set(transform_batch_t* batch, uint32_t index,
+                         vec3 translation, versor rotation, vec3 scale);
+
+/* Composes the local matrices of the transforms first to first + count - 1 */
+void transform_batch_compose_local(transform_batch_t* batch, uint32_t first,
+                                   uint32_t count);
+/* Scalar version of transform_batch_compose_local, the reference of the SIMD
+ * one */
+void transform_batch_compose_local_scalar(transform_batch_t* batch,
+                                          uint32_t first, uint32_t count);
+
+/* Updates the world matrices of the transforms first to first + count - 1,
+ * the world matrices of their parents must be up to date */
+void transform_batch_update_world(transform_batch_t* batch, uint32_t first,
+                                  uint32_t count);
+
+/* Composes the local and updates the world matrices of all transforms */
+void transform_batch_update(transform_batch_t* batch);
+
+/* Instruction set of the local matrix composition: "AVX2", "SSE2", "NEON" or
+ * "scalar" */
+const char* transform_batch_get_simd_name(void);
+
+#endif
@@ -1,9 +1,15 @@
+#include "video_decode.h"
+
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/time.h>
 #include <libswscale/swscale.h>
 #include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 /*
  * control play speed.
@@ -11,10 +17,27 @@
  *   1.0: play on normal speed.
  *   2.0: two times faster
  */
-#define PLAY_SPEED (1.0);
+#define PLAY_SPEED (1.0)
+
+/* Number of decoded frames the decoder can run ahead of the renderer */
+#define VIDEO_FRAME_RING_SIZE 4
+
+/* Longest sleep of a decode thread before it checks for a stop request */
+#define VIDEO_DECODE_MAX_SLEEP_US 10000
+
+/* No seek requested */
+#define VIDEO_DECODE_NO_SEEK -1
 
-static struct video_decode_state_t {
+typedef struct video_ring_frame_t {
+  unsigned char* data;
+  int64_t pts_us;
+} video_ring_frame_t;
+
+struct video_decoder {
   pthread_t decode_thread;
+  int thread_started;
+  int stop; /* set by video_decoder_release, read by the decode thread */
+  uint32_t reserved_threads; /* taken from the process-wide thread budget */
   AVFormatContext* fmt_ctx;
   AVCodecContext* dec_ctx;
   AVStream* video_st;
@@ -22,22 +45,240 @@ static struct video_decode_state_t {
   int video_w, video_h;
   int crop_w, crop_h;
   unsigned int video_fmt;
+  /* Hardware decoding, frames are downloaded from the decoder surfaces */
+  enum AVHWDeviceType hw_device_type;
+  enum AVPixelFormat hw_pix_fmt;
+  AVBufferRef* hw_device_ctx;
   int64_t duration_base;
-  void* decode_buf;
-} s_state = {
-  .fmt_ctx            = NULL,
-  .dec_ctx            = NULL,
-  .video_st           = NULL,
-  .video_stream_index = -1,
-  .decode_buf         = NULL,
+  /* Presentation time of the first frame of the current loop and of the last
+   * decoded frame, on the playback clock */
+  int64_t loop_offset_us;
+  int64_t last_pts_us;
+  /* Time in the video of the last output frame, AV_NOPTS_VALUE after a seek.
+   * A frame earlier in the video starts the next loop. */
+  int64_t last_media_us;
+  /* Keyframe timestamps of the video stream in its time base, ascending */
+  int64_t* keyframes;
+  uint32_t keyframe_count;
+  /* Position requested by video_decoder_seek, VIDEO_DECODE_NO_SEEK when none,
+   * and the position up to which the frames are decoded but not output */
+  int64_t seek_request_us;
+  int64_t discard_until_us;
+  /* Single-producer/single-consumer ring of decoded frames: the decode thread
+   * only advances write_index, the render thread only read_index. The frame
+   * at read_index is the one shown, once has_current is set. */
+  struct {
+    video_ring_frame_t frames[VIDEO_FRAME_RING_SIZE];
+    uint32_t write_index;
+    uint32_t read_index;
+    int has_current;
+  } ring;
+  pthread_mutex_t sink_mutex;
+  video_frame_sink_t sink;
+};
+
+/* Threads used by the decode threads and codec threads of all decoders */
+static struct video_thread_budget_t {
+  pthread_mutex_t mutex;
+  uint32_t max_threads;
+  uint32_t used_threads;
+} s_thread_budget = {
+  .mutex        = PTHREAD_MUTEX_INITIALIZER,
+  .max_threads  = 0,
+  .used_threads = 0,
 };
 
-int init_video_decode()
+void video_decode_set_max_threads(uint32_t thread_count)
+{
+  pthread_mutex_lock(&s_thread_budget.mutex);
+  s_thread_budget.max_threads = thread_count;
+  pthread_mutex_unlock(&s_thread_budget.mutex);
+}
+
+/*
+ * Reserves the decode thread and up to the requested number of codec threads.
+ * Returns the number of codec threads for the codec context, 1 lets the codec
+ * decode on the decode thread, and 0 when the budget is used up.
+ */
+static int reserve_threads(video_decoder_t* decoder, uint32_t codec_threads)
+{
+  pthread_mutex_lock(&s_thread_budget.mutex);
+  uint32_t max_threads = s_thread_budget.max_threads;
+  if (max_threads == 0) {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads    = cpu_count > 0 ? (uint32_t)cpu_count : 1;
+  }
+  const uint32_t available = max_threads > s_thread_budget.used_threads ?
+                               max_threads - s_thread_budget.used_threads :
+                               0;
+  int thread_count = 0;
+  if (available > 0) {
+    if (codec_threads > available - 1) {
+      codec_threads = available - 1;
+    }
+    thread_count               = codec_threads > 1 ? (int)codec_threads : 1;
+    decoder->reserved_threads  = 1 + (codec_threads > 1 ? codec_threads : 0);
+    s_thread_budget.used_threads += decoder->reserved_threads;
+  }
+  pthread_mutex_unlock(&s_thread_budget.mutex);
+  return thread_count;
+}
+
+static void release_threads(video_decoder_t* decoder)
+{
+  pthread_mutex_lock(&s_thread_budget.mutex);
+  s_thread_budget.used_threads -= decoder->reserved_threads;
+  decoder->reserved_threads = 0;
+  pthread_mutex_unlock(&s_thread_budget.mutex);
+}
+
+static int is_stopping(video_decoder_t* decoder)
+{
+  return __atomic_load_n(&decoder->stop, __ATOMIC_ACQUIRE);
+}
+
+static enum AVPixelFormat get_hw_format(AVCodecContext* ctx,
+                                        const enum AVPixelFormat* pix_fmts)
+{
+  video_decoder_t* decoder = (video_decoder_t*)ctx->opaque;
+  for (const enum AVPixelFormat* p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+    if (*p == decoder->hw_pix_fmt) {
+      return *p;
+    }
+  }
+
+  fprintf(stderr, "hardware surface format not offered, decoding in "
+                  "software\n");
+  return avcodec_default_get_format(ctx, pix_fmts);
+}
+
+/*
+ * Lets the decoder decode into hardware surfaces of the selected device type.
+ * Returns a negative value when the codec or the machine does not support it,
+ * the decoder stays a software decoder then.
+ */
+static int setup_hw_decode(video_decoder_t* decoder, AVCodecContext* dec_ctx,
+                           const AVCodec* dec)
 {
+  const enum AVHWDeviceType type = decoder->hw_device_type;
+  if (type == AV_HWDEVICE_TYPE_NONE) {
+    return -1;
+  }
+
+  for (int i = 0;; i++) {
+    const AVCodecHWConfig* config = avcodec_get_hw_config(dec, i);
+    if (config == NULL) {
+      fprintf(stderr, "decoder %s does not support %s, decoding in software\n",
+              dec->name, av_hwdevice_get_type_name(type));
+      return -1;
+    }
+    if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)
+        && config->device_type == type) {
+      decoder->hw_pix_fmt = config->pix_fmt;
+      break;
+    }
+  }
+
+  int ret
+    = av_hwdevice_ctx_create(&decoder->hw_device_ctx, type, NULL, NULL, 0);
+  if (ret < 0) {
+    fprintf(stderr, "no %s device found, decoding in software\n",
+            av_hwdevice_get_type_name(type));
+    decoder->hw_pix_fmt = AV_PIX_FMT_NONE;
+    return ret;
+  }
+  dec_ctx->hw_device_ctx = av_buffer_ref(decoder->hw_device_ctx);
+  dec_ctx->opaque        = decoder;
+  dec_ctx->get_format    = get_hw_format;
+
   return 0;
 }
 
-int open_video_file(const char* fname)
+static void add_keyframe(video_decoder_t* decoder, int64_t timestamp,
+                         uint32_t* capacity)
+{
+  if (timestamp == AV_NOPTS_VALUE) {
+    return;
+  }
+  if (decoder->keyframe_count > 0
+      && timestamp <= decoder->keyframes[decoder->keyframe_count - 1]) {
+    return;
+  }
+  if (decoder->keyframe_count == *capacity) {
+    *capacity          = *capacity > 0 ? *capacity * 2 : 64;
+    decoder->keyframes = (int64_t*)realloc(decoder->keyframes,
+                                           *capacity * sizeof(int64_t));
+  }
+  decoder->keyframes[decoder->keyframe_count++] = timestamp;
+}
+
+/*
+ * Indexes the keyframes of the video stream. The demuxer index is used when
+ * the container has one, e.g. the sample tables of MP4, otherwise the packets
+ * are read once up front, without decoding them, and the file is rewound.
+ */
+static void build_keyframe_index(video_decoder_t* decoder)
+{
+  AVFormatContext* fmt_ctx = decoder->fmt_ctx;
+  AVStream* st             = decoder->video_st;
+  uint32_t capacity        = 0;
+
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+  const int entry_count = avformat_index_get_entries_count(st);
+  for (int i = 0; i < entry_count; i++) {
+    const AVIndexEntry* entry = avformat_index_get_entry(st, i);
+    if (entry->flags & AVINDEX_KEYFRAME) {
+      add_keyframe(decoder, entry->timestamp, &capacity);
+    }
+  }
+#endif
+
+  if (decoder->keyframe_count == 0) {
+    AVPacket packet;
+    while (av_read_frame(fmt_ctx, &packet) >= 0) {
+      if (packet.stream_index == decoder->video_stream_index
+          && (packet.flags & AV_PKT_FLAG_KEY)) {
+        add_keyframe(decoder,
+                     packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts,
+                     &capacity);
+      }
+      av_packet_unref(&packet);
+    }
+    av_seek_frame(fmt_ctx, decoder->video_stream_index,
+                  decoder->keyframe_count > 0 ? decoder->keyframes[0] : 0,
+                  AVSEEK_FLAG_BACKWARD);
+  }
+}
+
+/* Index of the last keyframe at or before the timestamp, 0 when none is */
+static uint32_t find_keyframe(video_decoder_t* decoder, int64_t timestamp)
+{
+  uint32_t first = 0, count = decoder->keyframe_count;
+  while (count > 1) {
+    const uint32_t half = count / 2;
+    if (decoder->keyframes[first + half] <= timestamp) {
+      first += half;
+      count -= half;
+    }
+    else {
+      count = half;
+    }
+  }
+  return first;
+}
+
+/* Frame and slice threading flags of the codec context */
+static int get_codec_thread_type(uint32_t thread_type)
+{
+  if (thread_type == 0) {
+    return FF_THREAD_FRAME | FF_THREAD_SLICE;
+  }
+  return ((thread_type & VideoDecodeThreadType_Frame) ? FF_THREAD_FRAME : 0)
+         | ((thread_type & VideoDecodeThreadType_Slice) ? FF_THREAD_SLICE : 0);
+}
+
+static int open_video_file(video_decoder_t* decoder, const char* fname,
+                           int thread_count, uint32_t thread_type)
 {
   AVFormatContext* fmt_ctx = NULL;
   AVCodec* dec;
@@ -50,6 +291,7 @@ int open_video_file(const char* fname)
     fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
     return -1;
   }
+  decoder->fmt_ctx = fmt_ctx;
 
   ret = avformat_find_stream_info(fmt_ctx, NULL);
   if (ret < 0) {
@@ -73,8 +315,14 @@ int open_video_file(const char* fname)
     fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
     return AVERROR(ENOMEM);
   }
+  decoder->dec_ctx = dec_ctx;
   avcodec_parameters_to_context(dec_ctx,
                                 fmt_ctx->streams[video_stream_index]->codecpar);
+  dec_ctx->thread_count = thread_count;
+  dec_ctx->thread_type  = get_codec_thread_type(thread_type);
+
+  /* decode on the GPU when possible */
+  setup_hw_decode(decoder, dec_ctx, dec);
 
   /* init the video decoder */
   ret = avcodec_open2(dec_ctx, dec, NULL);
@@ -83,54 +331,173 @@ int open_video_file(const char* fname)
     return ret;
   }
 
-  s_state.fmt_ctx            = fmt_ctx;
-  s_state.dec_ctx            = dec_ctx;
-  s_state.video_st           = fmt_ctx->streams[video_stream_index];
-  s_state.video_stream_index = video_stream_index;
+  decoder->video_st           = fmt_ctx->streams[video_stream_index];
+  decoder->video_stream_index = video_stream_index;
 
-  s_state.video_w   = dec_ctx->width;
-  s_state.video_h   = dec_ctx->height;
-  s_state.video_fmt = s_state.dec_ctx->pix_fmt;
+  decoder->video_w   = dec_ctx->width;
+  decoder->video_h   = dec_ctx->height;
+  decoder->video_fmt = dec_ctx->pix_fmt;
 
-#if 0
-  if (s_video_w > s_video_h) {
-    s_crop_w = s_crop_h = s_video_h;
-  }
-  else {
-    s_crop_w = s_crop_h = s_video_w;
-  }
-#else
-  s_state.crop_w = s_state.video_w;
-  s_state.crop_h = s_state.video_h;
-#endif
+  decoder->crop_w = decoder->video_w;
+  decoder->crop_h = decoder->video_h;
+
+  build_keyframe_index(decoder);
 
   fprintf(stdout, "-------------------------------------------\n");
-  fprintf(stdout, " file  : %s\n", fname);
-  fprintf(stdout, " format: %s\n", av_get_pix_fmt_name(s_state.video_fmt));
-  fprintf(stdout, " size  : (%d, %d)\n", s_state.video_w, s_state.video_h);
-  fprintf(stdout, " crop  : (%d, %d)\n", s_state.crop_w, s_state.crop_h);
+  fprintf(stdout, " file   : %s\n", fname);
+  fprintf(stdout, " format : %s\n", av_get_pix_fmt_name(decoder->video_fmt));
+  fprintf(stdout, " decode : %s\n",
+          decoder->hw_device_ctx != NULL ?
+            av_hwdevice_get_type_name(decoder->hw_device_type) :
+            "software");
+  fprintf(stdout, " threads: %d (%s%s)\n", thread_count,
+          (dec_ctx->thread_type & FF_THREAD_FRAME) ? "frame " : "",
+          (dec_ctx->thread_type & FF_THREAD_SLICE) ? "slice" : "");
+  fprintf(stdout, " keys   : %u\n", decoder->keyframe_count);
+  fprintf(stdout, " size   : (%d, %d)\n", decoder->video_w, decoder->video_h);
+  fprintf(stdout, " crop   : (%d, %d)\n", decoder->crop_w, decoder->crop_h);
   fprintf(stdout, "-------------------------------------------\n");
 
   return 0;
 }
 
-int get_video_dimension(int* width, int* height)
+video_decoder_t* video_decoder_create(const video_decoder_desc_t* desc)
+{
+  video_decoder_t* decoder = (video_decoder_t*)malloc(sizeof(video_decoder_t));
+  memset(decoder, 0, sizeof(video_decoder_t));
+  decoder->video_stream_index = -1;
+  decoder->hw_pix_fmt         = AV_PIX_FMT_NONE;
+  decoder->last_media_us      = AV_NOPTS_VALUE;
+  decoder->seek_request_us    = VIDEO_DECODE_NO_SEEK;
+  decoder->discard_until_us   = AV_NOPTS_VALUE;
+  pthread_mutex_init(&decoder->sink_mutex, NULL);
+
+  decoder->hw_device_type = AV_HWDEVICE_TYPE_NONE;
+  if (!desc->software_decode) {
+    const char* type_name
+      = desc->hw_device_type != NULL ? desc->hw_device_type : "vaapi";
+    decoder->hw_device_type = av_hwdevice_find_type_by_name(type_name);
+    if (decoder->hw_device_type == AV_HWDEVICE_TYPE_NONE) {
+      fprintf(stderr, "unknown hardware device type: %s\n", type_name);
+    }
+  }
+
+  const int thread_count = reserve_threads(
+    decoder, desc->thread_count > 0 ? desc->thread_count : 2);
+  if (thread_count == 0) {
+    fprintf(stderr, "decoder thread limit reached, cannot open %s\n",
+            desc->filename);
+    video_decoder_release(decoder);
+    return NULL;
+  }
+
+  if (open_video_file(decoder, desc->filename, thread_count,
+                      desc->thread_type)
+      < 0) {
+    video_decoder_release(decoder);
+    return NULL;
+  }
+
+  return decoder;
+}
+
+void video_decoder_release(video_decoder_t* decoder)
 {
-  *width  = s_state.crop_w;
-  *height = s_state.crop_h;
+  if (decoder->thread_started) {
+    __atomic_store_n(&decoder->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(decoder->decode_thread, NULL);
+  }
+  for (uint32_t i = 0; i < VIDEO_FRAME_RING_SIZE; i++) {
+    free(decoder->ring.frames[i].data);
+  }
+  avcodec_free_context(&decoder->dec_ctx);
+  avformat_close_input(&decoder->fmt_ctx);
+  av_buffer_unref(&decoder->hw_device_ctx);
+  release_threads(decoder);
+  pthread_mutex_destroy(&decoder->sink_mutex);
+  free(decoder->keyframes);
+  free(decoder);
+}
+
+int video_decoder_get_dimension(video_decoder_t* decoder, int* width,
+                                int* height)
+{
+  *width  = decoder->crop_w;
+  *height = decoder->crop_h;
 
   return 0;
 }
 
-int get_video_pixformat(int* pixformat)
+int video_decoder_get_pixformat(video_decoder_t* decoder, uint32_t* pixformat)
 {
-  *pixformat = s_state.video_fmt;
+  *pixformat = decoder->video_fmt;
   return 0;
 }
 
-int get_video_buffer(void** buf)
+int64_t video_decoder_get_length_us(video_decoder_t* decoder)
+{
+  return decoder->fmt_ctx->duration != AV_NOPTS_VALUE ?
+           decoder->fmt_ctx->duration :
+           0;
+}
+
+uint32_t video_decoder_get_keyframe_count(video_decoder_t* decoder)
+{
+  return decoder->keyframe_count;
+}
+
+int video_decoder_seek(video_decoder_t* decoder, int64_t position_us)
+{
+  const int64_t length_us = video_decoder_get_length_us(decoder);
+  if (length_us > 0 && position_us >= length_us) {
+    position_us = length_us - 1;
+  }
+  __atomic_store_n(&decoder->seek_request_us,
+                   position_us > 0 ? position_us : 0, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static int64_t get_duration_us(video_decoder_t* decoder);
+
+int video_decoder_acquire_frame(video_decoder_t* decoder, video_frame_t* frame)
+{
+  const int64_t now_us = get_duration_us(decoder);
+  const uint32_t write_index
+    = __atomic_load_n(&decoder->ring.write_index, __ATOMIC_ACQUIRE);
+  uint32_t index
+    = decoder->ring.read_index + (decoder->ring.has_current ? 1 : 0);
+  uint32_t due = UINT32_MAX;
+
+  /* Take the latest frame that is due, the earlier ones are late and skipped */
+  for (; index != write_index; index++) {
+    if (decoder->ring.frames[index % VIDEO_FRAME_RING_SIZE].pts_us > now_us) {
+      break;
+    }
+    due = index;
+  }
+  if (due == UINT32_MAX) {
+    return 0;
+  }
+
+  /* Hands the previous frames back to the decoder */
+  __atomic_store_n(&decoder->ring.read_index, due, __ATOMIC_RELEASE);
+  decoder->ring.has_current = 1;
+  frame->data   = decoder->ring.frames[due % VIDEO_FRAME_RING_SIZE].data;
+  frame->pts_us = decoder->ring.frames[due % VIDEO_FRAME_RING_SIZE].pts_us;
+  return 1;
+}
+
+int video_decoder_set_frame_sink(video_decoder_t* decoder,
+                                 const video_frame_sink_t* sink)
 {
-  *buf = s_state.decode_buf;
+  pthread_mutex_lock(&decoder->sink_mutex);
+  if (sink != NULL) {
+    decoder->sink = *sink;
+  }
+  else {
+    memset(&decoder->sink, 0, sizeof(decoder->sink));
+  }
+  pthread_mutex_unlock(&decoder->sink_mutex);
   return 0;
 }
 
@@ -165,19 +532,56 @@ static int save_to_ppm(AVFrame* frame, int width, int height, int icnt)
   return 0;
 }
 
-static int convert_to_rgba8888(AVFrame* frame, int ofstx, int ofsty, int width,
-                               int height)
+static int has_frame_sink(video_decoder_t* decoder)
 {
-  if (s_state.decode_buf == NULL) {
-    s_state.decode_buf = (unsigned char*)malloc(width * height * 4);
+  pthread_mutex_lock(&decoder->sink_mutex);
+  const int has_sink = decoder->sink.acquire != NULL;
+  pthread_mutex_unlock(&decoder->sink_mutex);
+  return has_sink;
+}
+
+/* Returns the next ring frame to write, blocks while the ring is full. Returns
+ * NULL when a frame sink has been set meanwhile, which replaces the ring, or
+ * when the decoder is stopped. */
+static video_ring_frame_t* begin_ring_write(video_decoder_t* decoder,
+                                            int width, int height)
+{
+  const uint32_t write_index = decoder->ring.write_index;
+  while (write_index
+           - __atomic_load_n(&decoder->ring.read_index, __ATOMIC_ACQUIRE)
+         >= VIDEO_FRAME_RING_SIZE) {
+    if (has_frame_sink(decoder) || is_stopping(decoder)) {
+      return NULL;
+    }
+    av_usleep(1000);
   }
 
+  video_ring_frame_t* ring_frame
+    = &decoder->ring.frames[write_index % VIDEO_FRAME_RING_SIZE];
+  if (ring_frame->data == NULL) {
+    ring_frame->data = (unsigned char*)malloc(width * height * 4);
+  }
+  return ring_frame;
+}
+
+/* Publishes the frame written since begin_ring_write to the renderer */
+static void end_ring_write(video_decoder_t* decoder,
+                           video_ring_frame_t* ring_frame, int64_t pts_us)
+{
+  ring_frame->pts_us = pts_us;
+  __atomic_store_n(&decoder->ring.write_index, decoder->ring.write_index + 1,
+                   __ATOMIC_RELEASE);
+}
+
+static int convert_to_rgba8888(AVFrame* frame, unsigned char* dst, int ofstx,
+                               int ofsty, int width, int height)
+{
   if (ofstx == 0 && ofsty == 0) {
-    memcpy(s_state.decode_buf, frame->data[0], width * height * 4);
+    memcpy(dst, frame->data[0], width * height * 4);
   }
   else {
     for (int y = 0; y < height; y++) {
-      unsigned char* dst8 = (unsigned char*)s_state.decode_buf + y * width * 4;
+      unsigned char* dst8 = dst + y * width * 4;
       unsigned char* src8 = frame->data[0] + (y + ofsty) * frame->linesize[0];
       src8 += ofstx * 4;
 
@@ -192,136 +596,354 @@ static int convert_to_rgba8888(AVFrame* frame, int ofstx, int ofsty, int width,
   return 0;
 }
 
-static int on_frame_decoded(AVFrame* frame, int write_debug_frames)
+static int on_frame_decoded(video_decoder_t* decoder, AVFrame* frame,
+                            int64_t pts_us, int write_debug_frames)
 {
-  int dec_w = s_state.video_w;
-  int dec_h = s_state.video_h;
-  int ofstx = (s_state.video_w - s_state.crop_w) * 0.5f;
-  int ofsty = (s_state.video_h - s_state.crop_h) * 0.5f;
+  int dec_w = decoder->video_w;
+  int dec_h = decoder->video_h;
+  int ofstx = (decoder->video_w - decoder->crop_w) * 0.5f;
+  int ofsty = (decoder->video_h - decoder->crop_h) * 0.5f;
 
   if (write_debug_frames) {
     static int i = 0;
     save_to_ppm(frame, dec_w, dec_h, i++);
   }
 
-  convert_to_rgba8888(frame, ofstx, ofsty, s_state.crop_w, s_state.crop_h);
+  video_ring_frame_t* ring_frame
+    = begin_ring_write(decoder, decoder->crop_w, decoder->crop_h);
+  if (ring_frame == NULL) {
+    return 0;
+  }
+  convert_to_rgba8888(frame, ring_frame->data, ofstx, ofsty, decoder->crop_w,
+                      decoder->crop_h);
+  end_ring_write(decoder, ring_frame, pts_us);
 
   return 0;
 }
 
-static void init_duration()
+/* Scalers of the decode thread, created for the format of the decoded
+ * frames, which is only known once the first frame has been decoded */
+typedef struct video_scalers_t {
+  struct SwsContext* rgba;
+  struct SwsContext* nv12;
+  int rgba_src_fmt;
+  int nv12_src_fmt;
+  /* Frame downloaded from the hardware decoder */
+  AVFrame* sw_frame;
+} video_scalers_t;
+
+static struct SwsContext* get_scaler(struct SwsContext** sws_ctx, int* src_fmt,
+                                     AVFrame* frame, enum AVPixelFormat dst_fmt)
+{
+  if (*sws_ctx == NULL || *src_fmt != frame->format) {
+    sws_freeContext(*sws_ctx);
+    *sws_ctx = sws_getContext(frame->width, frame->height, frame->format,
+                              frame->width, frame->height, dst_fmt,
+                              SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    *src_fmt = frame->format;
+  }
+  return *sws_ctx;
+}
+
+/*
+ * Copies the planes of an NV12 or YUV420P frame into the NV12 destination,
+ * other formats are converted with a scaler.
+ */
+static void write_nv12_planes(video_scalers_t* scalers, AVFrame* frame,
+                              const video_frame_planes_t* planes)
+{
+  const int w  = frame->width;
+  const int h  = frame->height;
+  const int cw = (w + 1) / 2;
+  const int ch = (h + 1) / 2;
+  if (frame->format == AV_PIX_FMT_NV12) {
+    for (int y = 0; y < h; y++) {
+      memcpy(planes->data[0] + y * planes->bytes_per_row[0],
+             frame->data[0] + y * frame->linesize[0], w);
+    }
+    for (int y = 0; y < ch; y++) {
+      memcpy(planes->data[1] + y * planes->bytes_per_row[1],
+             frame->data[1] + y * frame->linesize[1], cw * 2);
+    }
+  }
+  else if (frame->format == AV_PIX_FMT_YUV420P
+           || frame->format == AV_PIX_FMT_YUVJ420P) {
+    for (int y = 0; y < h; y++) {
+      memcpy(planes->data[0] + y * planes->bytes_per_row[0],
+             frame->data[0] + y * frame->linesize[0], w);
+    }
+    for (int y = 0; y < ch; y++) {
+      unsigned char* dst8 = planes->data[1] + y * planes->bytes_per_row[1];
+      unsigned char* u8   = frame->data[1] + y * frame->linesize[1];
+      unsigned char* v8   = frame->data[2] + y * frame->linesize[2];
+      for (int x = 0; x < cw; x++) {
+        *dst8++ = *u8++;
+        *dst8++ = *v8++;
+      }
+    }
+  }
+  else {
+    struct SwsContext* sws_ctx = get_scaler(
+      &scalers->nv12, &scalers->nv12_src_fmt, frame, AV_PIX_FMT_NV12);
+    uint8_t* dst_data[4] = {planes->data[0], planes->data[1], NULL, NULL};
+    int dst_linesize[4]  = {(int)planes->bytes_per_row[0],
+                            (int)planes->bytes_per_row[1], 0, 0};
+    sws_scale(sws_ctx, (const uint8_t* const*)frame->data, frame->linesize, 0,
+              h, dst_data, dst_linesize);
+  }
+}
+
+/*
+ * Writes the frame into the sink, which skips both the intermediate RGBA frame
+ * and the copy into the frame ring. Returns 0 when no sink is set.
+ */
+static int write_to_sink(video_decoder_t* decoder, video_scalers_t* scalers,
+                         AVFrame* frame)
 {
-  s_state.duration_base = av_gettime();
+  int ret = 0;
+  pthread_mutex_lock(&decoder->sink_mutex);
+  const video_frame_sink_t* sink = &decoder->sink;
+  if (sink->acquire != NULL) {
+    ret                         = 1;
+    video_frame_planes_t planes = {0};
+    if (sink->acquire(sink->user_data, &planes)) {
+      if (sink->format == VideoFrameFormat_NV12) {
+        write_nv12_planes(scalers, frame, &planes);
+      }
+      else {
+        struct SwsContext* sws_ctx = get_scaler(
+          &scalers->rgba, &scalers->rgba_src_fmt, frame, AV_PIX_FMT_RGBA);
+        uint8_t* dst_data[4] = {planes.data[0], NULL, NULL, NULL};
+        int dst_linesize[4]  = {(int)planes.bytes_per_row[0], 0, 0, 0};
+        sws_scale(sws_ctx, (const uint8_t* const*)frame->data,
+                  frame->linesize, 0, frame->height, dst_data, dst_linesize);
+      }
+      sink->submit(sink->user_data, &planes);
+    }
+  }
+  pthread_mutex_unlock(&decoder->sink_mutex);
+  return ret;
 }
 
-static int64_t get_duration_us()
+static void init_duration(video_decoder_t* decoder)
 {
-  int64_t duration = av_gettime() - s_state.duration_base;
+  decoder->duration_base = av_gettime();
+}
+
+static int64_t get_duration_us(video_decoder_t* decoder)
+{
+  int64_t duration = av_gettime() - decoder->duration_base;
   return duration;
 }
 
-static void sleep_to_pts(AVPacket* packet)
+/* Time of the frame in the video. The frame pts is preferred: the best effort
+ * timestamp is guessed from the previous frames, which the rewind at the end
+ * of the video breaks. */
+static int64_t get_frame_media_us(video_decoder_t* decoder, AVFrame* frame,
+                                  AVPacket* packet)
+{
+  int64_t timestamp = 0;
+  if (frame->pts != AV_NOPTS_VALUE) {
+    timestamp = frame->pts;
+  }
+  else if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+    timestamp = frame->best_effort_timestamp;
+  }
+  else if (packet->dts != AV_NOPTS_VALUE) {
+    timestamp = packet->dts;
+  }
+  return (int64_t)(timestamp * av_q2d(decoder->video_st->time_base) * 1000
+                   * 1000);
+}
+
+static int64_t get_frame_interval_us(video_decoder_t* decoder)
+{
+  const AVRational frame_rate = decoder->video_st->avg_frame_rate;
+  return frame_rate.num > 0 ?
+           (int64_t)(av_q2d(av_inv_q(frame_rate)) * 1000 * 1000) :
+           0;
+}
+
+/* Presentation time of the frame on the playback clock, which keeps running
+ * across loops of the video: the next loop starts one frame after the last
+ * frame of the previous one */
+static int64_t get_frame_pts_us(video_decoder_t* decoder, int64_t media_us)
+{
+  if (decoder->last_media_us != AV_NOPTS_VALUE
+      && media_us < decoder->last_media_us) {
+    decoder->loop_offset_us = decoder->last_pts_us
+                              + get_frame_interval_us(decoder)
+                              - (int64_t)(media_us / PLAY_SPEED);
+  }
+  decoder->last_media_us = media_us;
+  decoder->last_pts_us   = (int64_t)(media_us / PLAY_SPEED)
+                         + decoder->loop_offset_us;
+  return decoder->last_pts_us;
+}
+
+/* Sleeps in short steps, so that a stop request is not delayed by a frame */
+static void sleep_to_pts(video_decoder_t* decoder, int64_t pts_us)
 {
-  int64_t pts_us = 0;
-  if (packet->dts != AV_NOPTS_VALUE) {
-    pts_us = packet->dts;
+  int64_t delay_us = pts_us - get_duration_us(decoder);
+  while (delay_us > 0 && !is_stopping(decoder)) {
+    av_usleep(delay_us < VIDEO_DECODE_MAX_SLEEP_US ? delay_us :
+                                                     VIDEO_DECODE_MAX_SLEEP_US);
+    delay_us = pts_us - get_duration_us(decoder);
   }
+}
 
-  pts_us *= (av_q2d(s_state.video_st->time_base) * 1000 * 1000);
-  pts_us /= PLAY_SPEED;
+/* Decodes the frame into the sink, paced by sleeping until its presentation
+ * time, or into the frame ring, which lets the decoder run ahead */
+static void output_frame(video_decoder_t* decoder, video_scalers_t* scalers,
+                         AVFrame* frame, AVFrame* framergb, AVPacket* packet)
+{
+  /* frames from the keyframe up to a seek position are only decoded */
+  const int64_t media_us = get_frame_media_us(decoder, frame, packet);
+  if (decoder->discard_until_us != AV_NOPTS_VALUE) {
+    if (media_us < decoder->discard_until_us) {
+      return;
+    }
+    decoder->discard_until_us = AV_NOPTS_VALUE;
+  }
+  const int64_t pts_us = get_frame_pts_us(decoder, media_us);
 
-  int64_t delay_us = pts_us - get_duration_us();
-  if (delay_us > 0) {
-    av_usleep(delay_us);
+  /* download hardware frames, as NV12 for 8 bit videos */
+  if (frame->format == decoder->hw_pix_fmt) {
+    av_frame_unref(scalers->sw_frame);
+    if (av_hwframe_transfer_data(scalers->sw_frame, frame, 0) < 0) {
+      fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+      return;
+    }
+    frame = scalers->sw_frame;
+  }
+
+  if (has_frame_sink(decoder)) {
+    sleep_to_pts(decoder, pts_us);
+  }
+  if (!write_to_sink(decoder, scalers, frame)) {
+    struct SwsContext* sws_ctx = get_scaler(
+      &scalers->rgba, &scalers->rgba_src_fmt, frame, AV_PIX_FMT_RGBA);
+    sws_scale(sws_ctx, (const uint8_t* const*)frame->data, frame->linesize, 0,
+              frame->height, framergb->data, framergb->linesize);
+    on_frame_decoded(decoder, framergb, pts_us, 0);
   }
 }
-static void* decode_thread_main()
+
+/* Restarts the demuxer at the indexed keyframe, the codec is not flushed */
+static void rewind_to_keyframe(video_decoder_t* decoder, uint32_t keyframe)
 {
-  AVFrame* frame    = av_frame_alloc();
-  AVFrame* framergb = av_frame_alloc();
+  const int64_t timestamp
+    = decoder->keyframe_count > 0 ? decoder->keyframes[keyframe] : 0;
+  if (av_seek_frame(decoder->fmt_ctx, decoder->video_stream_index, timestamp,
+                    AVSEEK_FLAG_BACKWARD)
+      < 0) {
+    av_seek_frame(decoder->fmt_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
+  }
+}
 
-  if (frame == NULL || framergb == NULL) {
+/* Continues decoding at the position, shown at once on the playback clock */
+static void seek_to_position(video_decoder_t* decoder, int64_t position_us)
+{
+  const int64_t timestamp = (int64_t)(
+    position_us / (av_q2d(decoder->video_st->time_base) * 1000 * 1000));
+  rewind_to_keyframe(decoder, find_keyframe(decoder, timestamp));
+  avcodec_flush_buffers(decoder->dec_ctx);
+
+  decoder->discard_until_us = position_us;
+  decoder->last_media_us    = AV_NOPTS_VALUE;
+  decoder->loop_offset_us
+    = get_duration_us(decoder) - (int64_t)(position_us / PLAY_SPEED);
+}
+
+static void* decode_thread_main(void* arg)
+{
+  video_decoder_t* decoder = (video_decoder_t*)arg;
+  AVFrame* frame           = av_frame_alloc();
+  AVFrame* framergb        = av_frame_alloc();
+  video_scalers_t scalers  = {
+    .sw_frame = av_frame_alloc(),
+  };
+  uint8_t* buffer = NULL;
+
+  if (frame == NULL || framergb == NULL || scalers.sw_frame == NULL) {
     fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-    return 0;
+    goto cleanup;
   }
 
-  int dec_w    = s_state.dec_ctx->width;
-  int dec_h    = s_state.dec_ctx->height;
+  int dec_w    = decoder->dec_ctx->width;
+  int dec_h    = decoder->dec_ctx->height;
   int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGBA, dec_w, dec_h, 1);
 
-  uint8_t* buffer = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
+  buffer = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
 
   av_image_fill_arrays(framergb->data, framergb->linesize, buffer,
                        AV_PIX_FMT_RGBA, dec_w, dec_h, 1);
 
-  struct SwsContext* sws_ctx
-    = sws_getContext(dec_w, dec_h, s_state.dec_ctx->pix_fmt, dec_w, dec_h,
-                     AV_PIX_FMT_RGBA, SWS_FAST_BILINEAR, NULL, NULL, NULL);
-  if (sws_ctx == NULL) {
-    fprintf(stderr, "Cannot initialize the sws context\n");
-    return 0;
-  }
-
-  while (1) {
+  /* packets read since the last rewind, none means the file has no frames */
+  uint32_t packet_count = 0;
+  while (!is_stopping(decoder)) {
     AVPacket packet;
     int ret;
 
-    init_duration();
-
-    while (av_read_frame(s_state.fmt_ctx, &packet) >= 0) {
-      if (packet.stream_index == s_state.video_stream_index) {
-        ret = avcodec_send_packet(s_state.dec_ctx, &packet);
-        if (ret < 0) {
-          fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-          break;
-        }
+    const int64_t seek_us = __atomic_exchange_n(
+      &decoder->seek_request_us, VIDEO_DECODE_NO_SEEK, __ATOMIC_ACQ_REL);
+    if (seek_us != VIDEO_DECODE_NO_SEEK) {
+      seek_to_position(decoder, seek_us);
+      packet_count = 0;
+    }
 
-        while (ret >= 0) {
-          ret = avcodec_receive_frame(s_state.dec_ctx, frame);
-          if (ret == AVERROR(EAGAIN)) {
-            // fprintf (stderr, "retry.\n");
-            break;
-          }
-          else if (ret == AVERROR_EOF) {
-            fprintf(stderr, "EOF.\n");
-            break;
-          }
-          else if (ret < 0) {
-            fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-            return 0;
-          }
-
-          sws_scale(sws_ctx, (const uint8_t* const*)frame->data,
-                    frame->linesize, 0, dec_h, framergb->data,
-                    framergb->linesize);
-
-          sleep_to_pts(&packet);
-          on_frame_decoded(framergb, 0);
-        }
+    if (av_read_frame(decoder->fmt_ctx, &packet) < 0) {
+      if (packet_count == 0) {
+        fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        break;
       }
-
-      av_packet_unref(&packet);
+      /* rewind to restart, without draining the codec: the first GOP of the
+       * next loop is decoded while the last frames are still in the codec.
+       * A seek past the last frame restarts at the first one. */
+      if (decoder->discard_until_us != AV_NOPTS_VALUE) {
+        seek_to_position(decoder, 0);
+      }
+      else {
+        rewind_to_keyframe(decoder, 0);
+      }
+      packet_count = 0;
+      continue;
     }
+    packet_count++;
 
-    /* flush decoder */
-    ret = avcodec_send_packet(s_state.dec_ctx, &packet);
-    if (ret < 0) {
-      fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-    }
+    if (packet.stream_index == decoder->video_stream_index) {
+      ret = avcodec_send_packet(decoder->dec_ctx, &packet);
+      if (ret < 0) {
+        fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+      }
 
-    while (avcodec_receive_frame(s_state.dec_ctx, frame) == 0) {
-      sws_scale(sws_ctx, (const uint8_t* const*)frame->data, frame->linesize, 0,
-                dec_h, framergb->data, framergb->linesize);
+      while (ret >= 0) {
+        ret = avcodec_receive_frame(decoder->dec_ctx, frame);
+        if (ret == AVERROR(EAGAIN)) {
+          // fprintf (stderr, "retry.\n");
+          break;
+        }
+        else if (ret == AVERROR_EOF) {
+          fprintf(stderr, "EOF.\n");
+          break;
+        }
+        else if (ret < 0) {
+          fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+          av_packet_unref(&packet);
+          goto cleanup;
+        }
 
-      sleep_to_pts(&packet);
-      on_frame_decoded(framergb, 0);
+        output_frame(decoder, &scalers, frame, framergb, &packet);
+      }
     }
 
-    /* rewind to restart */
-    av_seek_frame(s_state.fmt_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
-    avcodec_flush_buffers(s_state.dec_ctx);
+    av_packet_unref(&packet);
   }
 
+cleanup:
+  sws_freeContext(scalers.rgba);
+  sws_freeContext(scalers.nv12);
+  av_frame_free(&scalers.sw_frame);
   av_free(buffer);
   av_frame_free(&framergb);
   av_frame_free(&frame);
@@ -329,8 +951,25 @@ static void* decode_thread_main()
   return 0;
 }
 
-int start_video_decode()
+int video_decoder_start(video_decoder_t* decoder)
 {
-  pthread_create(&s_state.decode_thread, NULL, decode_thread_main, NULL);
+  init_duration(decoder);
+  /* Without frame sink the decoded frames go to the ring, its frames are
+   * allocated up front instead of by the decode thread on first use */
+  if (!has_frame_sink(decoder)) {
+    for (uint32_t i = 0; i < VIDEO_FRAME_RING_SIZE; i++) {
+      if (decoder->ring.frames[i].data == NULL) {
+        decoder->ring.frames[i].data = (unsigned char*)malloc(
+          decoder->crop_w * decoder->crop_h * 4);
+      }
+    }
+  }
+  if (pthread_create(&decoder->decode_thread, NULL, decode_thread_main,
+                     decoder)
+      != 0) {
+    fprintf(stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+    return -1;
+  }
+  decoder->thread_started = 1;
   return 0;
 }
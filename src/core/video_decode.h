@@ -3,12 +3,113 @@
 
 #include <stdint.h>
 
-int init_video_decode();
-int open_video_file(const char* fname);
-int get_video_dimension(int* width, int* height);
-int get_video_pixformat(uint32_t* pixformat);
-int get_video_buffer(void** buf);
+/*
+ * Video decoder: every decoder owns an FFmpeg decoding context, a decode
+ * thread and a ring of decoded frames, so that several videos can be decoded
+ * at once. The decode threads and the codec threads of all decoders share a
+ * process-wide thread budget.
+ */
+typedef struct video_decoder video_decoder_t;
 
-int start_video_decode();
+/* Codec threading, the flags can be combined */
+typedef enum video_decode_thread_type_enum {
+  /* Frames decoded in parallel, adds one frame of latency per thread */
+  VideoDecodeThreadType_Frame = 1,
+  /* Slices of a frame decoded in parallel, when the video has several */
+  VideoDecodeThreadType_Slice = 2,
+} video_decode_thread_type_enum;
+
+typedef struct video_decoder_desc_t {
+  const char* filename;
+  /* Hardware device type to decode with, NULL selects "vaapi". When the
+   * device is missing or does not support the codec, the video is decoded in
+   * software. */
+  const char* hw_device_type;
+  int software_decode; /* skips hardware decoding */
+  /* Codec threads, 0 selects 2, limited by the remaining thread budget */
+  uint32_t thread_count;
+  /* Combination of video_decode_thread_type_enum flags, 0 selects frame and
+   * slice threading */
+  uint32_t thread_type;
+} video_decoder_desc_t;
+
+/* Sets the number of threads all decoders may use together, 0 selects the
+ * number of CPU cores. Applies to decoders created afterwards. */
+void video_decode_set_max_threads(uint32_t thread_count);
+
+/* Opens the video file and indexes its keyframes, returns NULL on failure or
+ * when the thread budget is used up. The video loops: at the end, the demuxer
+ * rewinds to the first keyframe while the codec keeps decoding, so that the
+ * first frames of the next loop follow the last ones without stall. */
+video_decoder_t* video_decoder_create(const video_decoder_desc_t* desc);
+/* Stops the decode thread and releases the decoder */
+void video_decoder_release(video_decoder_t* decoder);
+
+int video_decoder_start(video_decoder_t* decoder);
+
+int video_decoder_get_dimension(video_decoder_t* decoder, int* width,
+                                int* height);
+int video_decoder_get_pixformat(video_decoder_t* decoder, uint32_t* pixformat);
+
+/* Length of the video in microseconds, 0 when unknown */
+int64_t video_decoder_get_length_us(video_decoder_t* decoder);
+/* Number of keyframes indexed when the file was opened */
+uint32_t video_decoder_get_keyframe_count(video_decoder_t* decoder);
+
+/*
+ * Requests the decode thread to continue at the position, in microseconds of
+ * the video. Decoding restarts from the indexed keyframe at or before the
+ * position, the frames up to the position are decoded but not output, and
+ * the position is shown at once on the playback clock.
+ */
+int video_decoder_seek(video_decoder_t* decoder, int64_t position_us);
+
+/* Decoded RGBA8 frame and its presentation time on the playback clock */
+typedef struct video_frame_t {
+  void* data;
+  int64_t pts_us;
+} video_frame_t;
+
+/*
+ * Takes the latest frame whose presentation time has been reached from the
+ * decoded frame ring, frames that are late are dropped. The frame stays valid
+ * and is not overwritten by the decoder until the next call, which returns 0
+ * and keeps the current frame when no newer frame is due. Must be called from
+ * one thread only.
+ */
+int video_decoder_acquire_frame(video_decoder_t* decoder, video_frame_t* frame);
+
+/* Pixel layout of the frames written into a frame sink */
+typedef enum video_frame_format_enum {
+  VideoFrameFormat_RGBA8 = 0,
+  /* Full resolution Y plane and half resolution interleaved UV plane, written
+   * without color conversion when the video is NV12 or YUV420P */
+  VideoFrameFormat_NV12 = 1,
+} video_frame_format_enum;
+
+/* Destination planes of a frame, only the first one is used for RGBA8 */
+typedef struct video_frame_planes_t {
+  uint8_t* data[2];
+  uint32_t bytes_per_row[2];
+} video_frame_planes_t;
+
+/*
+ * Destination of the decoded frames. When a sink is set, the decode thread
+ * writes every frame straight into the memory returned by acquire, e.g. a
+ * mapped upload buffer, instead of into the decoded frame ring.
+ */
+typedef struct video_frame_sink_t {
+  video_frame_format_enum format;
+  /* Fills in the destination of the next frame, returns 0 to drop the frame */
+  int (*acquire)(void* user_data, video_frame_planes_t* planes);
+  /* Hands the filled destination back */
+  void (*submit)(void* user_data, const video_frame_planes_t* planes);
+  void* user_data;
+} video_frame_sink_t;
+
+/* Sets the frame sink, NULL restores the decoded frame ring. Returns once the
+ * decode thread no longer writes into the previous sink. */
+int video_decoder_set_frame_sink(video_decoder_t* decoder,
+                                 const video_frame_sink_t* sink);
 
 #endif
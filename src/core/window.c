@@ -48,6 +48,9 @@ static void glfw_window_scroll_callback(GLFWwindow* src_window, double xoffset,
                                         double yoffset);
 static void glfw_window_size_callback(GLFWwindow* src_window, int width,
                                       int height);
+static void glfw_window_iconify_callback(GLFWwindow* src_window,
+                                         int iconified);
+static void glfw_window_focus_callback(GLFWwindow* src_window, int focused);
 
 window_t* window_create(window_config_t* config)
 {
@@ -102,6 +105,10 @@ window_t* window_create(window_config_t* config)
   glfwSetScrollCallback(window->handle, glfw_window_scroll_callback);
   /* Window resize events */
   glfwSetWindowSizeCallback(window->handle, glfw_window_size_callback);
+  /* Window minimize and restore events */
+  glfwSetWindowIconifyCallback(window->handle, glfw_window_iconify_callback);
+  /* Window focus events */
+  glfwSetWindowFocusCallback(window->handle, glfw_window_focus_callback);
   /* clang-format on */
 
   /* Change the state of the window to intialized */
@@ -180,6 +187,11 @@ void input_poll_events(void)
   glfwPollEvents();
 }
 
+void input_wait_events(float timeout)
+{
+  glfwWaitEventsTimeout((double)timeout);
+}
+
 void input_query_cursor(window_t* window, float* xpos, float* ypos)
 {
   double cursor_xpos, cursor_ypos;
@@ -340,8 +352,30 @@ static void glfw_window_size_callback(GLFWwindow* src_window, int width,
   UNUSED_VAR(width);
   UNUSED_VAR(height);
 
-  surface_update_framebuffer_size(
-    (window_t*)glfwGetWindowUserPointer(src_window));
+  window_t* window = (window_t*)glfwGetWindowUserPointer(src_window);
+  surface_update_framebuffer_size(window);
+  /* Raise event with the framebuffer size, the window size is in screen
+   * coordinates */
+  if (window && window->handle && window->callbacks.resize_callback) {
+    window->callbacks.resize_callback(window, (int)window->surface.width,
+                                      (int)window->surface.height);
+  }
+}
+
+static void glfw_window_iconify_callback(GLFWwindow* src_window, int iconified)
+{
+  window_t* window = (window_t*)glfwGetWindowUserPointer(src_window);
+  if (window && window->handle && window->callbacks.iconify_callback) {
+    window->callbacks.iconify_callback(window, iconified == GLFW_TRUE);
+  }
+}
+
+static void glfw_window_focus_callback(GLFWwindow* src_window, int focused)
+{
+  window_t* window = (window_t*)glfwGetWindowUserPointer(src_window);
+  if (window && window->handle && window->callbacks.focus_callback) {
+    window->callbacks.focus_callback(window, focused == GLFW_TRUE);
+  }
 }
 
 static keycode_t remap_glfw_key_code(int key)
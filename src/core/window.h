@@ -25,6 +25,8 @@ typedef struct {
   void (*scroll_callback)(window_t* window, int ctrl_key, int shift_key,
                           float mouse_x, float mouse_y, float wheel_delta_y);
   void (*resize_callback)(window_t* window, int width, int height);
+  void (*iconify_callback)(window_t* window, int iconified);
+  void (*focus_callback)(window_t* window, int focused);
 } callbacks_t;
 
 /* window related functions */
@@ -40,6 +42,8 @@ void window_get_aspect_ratio(window_t* window, float* aspect_ratio);
 
 /* input related functions */
 void input_poll_events(void);
+/* Waits for events up to timeout seconds and handles them */
+void input_wait_events(float timeout);
 void input_query_cursor(window_t* window, float* xpos, float* ypos);
 void input_set_callbacks(window_t* window, callbacks_t callbacks);
 
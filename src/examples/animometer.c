@@ -3,6 +3,8 @@
 
 #include <string.h>
 
+#include "../core/platform.h"
+#include "../core/profiler.h"
 #include "../webgpu/imgui_overlay.h"
 
 /* -------------------------------------------------------------------------- *
@@ -10,6 +12,17 @@
  *
  * A WebGPU of port of the Animometer MotionMark benchmark.
  *
+ * The example doubles as a draw-call throughput benchmark, the triangles are
+ * submitted with one of several strategies:
+ * - one draw per triangle, binding its uniforms with a dynamic offset,
+ * - the same draws recorded once into a render bundle,
+ * - a single instanced draw reading the uniforms from a storage buffer,
+ * - one indirect draw per triangle from a single indirect buffer; the
+ *   triangle index is derived from the vertex index, so the draws do not
+ *   require the indirect-first-instance feature.
+ * The CPU encoding time, the GPU time of the render pass and the draw rate of
+ * the active strategy are shown in the overlay.
+ *
  * Ref:
  * https://github.com/austinEng/webgpu-samples/blob/main/src/pages/samples/animometer.ts
  * -------------------------------------------------------------------------- */
@@ -31,30 +44,38 @@ static const char* vertex_shader_wgsl = CODE(
 
   @binding(0) @group(0) var<uniform> time : Time;
   @binding(0) @group(1) var<uniform> uniforms : Uniforms;
+  @binding(1) @group(1) var<storage, read> objects : array<Uniforms>;
 
   struct VertexOutput {
     @builtin(position) Position : vec4<f32>,
     @location(0) v_color : vec4<f32>,
   }
 
-  @vertex
-  fn vert_main(
-    @location(0) position : vec4<f32>,
-    @location(1) color : vec4<f32>
-  ) -> VertexOutput {
-    var fade : f32 = (uniforms.scalarOffset + time.value * uniforms.scalar / 10.0) % 1.0;
+  // Triangle of the draws without vertex buffer
+  var<private> triangle_positions : array<vec4<f32>, 3> = array<vec4<f32>, 3>(
+    vec4<f32>(0.0, 0.1, 0.0, 1.0),
+    vec4<f32>(-0.1, -0.1, 0.0, 1.0),
+    vec4<f32>(0.1, -0.1, 0.0, 1.0));
+  var<private> triangle_colors : array<vec4<f32>, 3> = array<vec4<f32>, 3>(
+    vec4<f32>(1.0, 0.0, 0.0, 1.0),
+    vec4<f32>(0.0, 1.0, 0.0, 1.0),
+    vec4<f32>(0.0, 0.0, 1.0, 1.0));
+
+  fn transform(position : vec4<f32>, color : vec4<f32>,
+               u : Uniforms) -> VertexOutput {
+    var fade : f32 = (u.scalarOffset + time.value * u.scalar / 10.0) % 1.0;
     if (fade < 0.5) {
       fade = fade * 2.0;
     } else {
       fade = (1.0 - fade) * 2.0;
     }
-    var xpos : f32 = position.x * uniforms.scale;
-    var ypos : f32 = position.y * uniforms.scale;
+    var xpos : f32 = position.x * u.scale;
+    var ypos : f32 = position.y * u.scale;
     var angle : f32 = 3.14159 * 2.0 * fade;
     var xrot : f32 = xpos * cos(angle) - ypos * sin(angle);
     var yrot : f32 = xpos * sin(angle) + ypos * cos(angle);
-    xpos = xrot + uniforms.offsetX;
-    ypos = yrot + uniforms.offsetY;
+    xpos = xrot + u.offsetX;
+    ypos = yrot + u.offsetY;
 
     var output : VertexOutput;
     output.v_color = vec4<f32>(fade, 1.0 - fade, 0.0, 1.0) + color;
@@ -62,9 +83,30 @@ static const char* vertex_shader_wgsl = CODE(
     return output;
   }
 
-  @fragment
-  fn frag_main(@location(0) v_color : vec4<f32>) -> @location(0) vec4<f32> {
-    return v_color;
+  @vertex
+  fn vert_main(
+    @location(0) position : vec4<f32>,
+    @location(1) color : vec4<f32>
+  ) -> VertexOutput {
+    return transform(position, color, uniforms);
+  }
+
+  @vertex
+  fn vert_main_instanced(
+    @builtin(instance_index) instance : u32,
+    @location(0) position : vec4<f32>,
+    @location(1) color : vec4<f32>
+  ) -> VertexOutput {
+    return transform(position, color, objects[instance]);
+  }
+
+  @vertex
+  fn vert_main_indirect(
+    @builtin(vertex_index) vertex : u32
+  ) -> VertexOutput {
+    let corner = vertex % 3u;
+    return transform(triangle_positions[corner], triangle_colors[corner],
+                     objects[vertex / 3u]);
   }
 );
 
@@ -76,19 +118,46 @@ static const char* fragment_shader_wgsl = CODE(
 );
 // clang-format on
 
+// Submission strategies
+typedef enum draw_strategy_enum {
+  DrawStrategy_DYNAMIC_OFFSETS     = 0,
+  DrawStrategy_RENDER_BUNDLE       = 1,
+  DrawStrategy_INSTANCED_STORAGE   = 2,
+  DrawStrategy_MULTI_DRAW_INDIRECT = 3,
+  DrawStrategy_COUNT               = 4,
+} draw_strategy_enum;
+
+static const char* draw_strategy_names[DrawStrategy_COUNT] = {
+  "Dynamic offsets",     // DrawStrategy_DYNAMIC_OFFSETS
+  "Render bundle",       // DrawStrategy_RENDER_BUNDLE
+  "Instanced storage",   // DrawStrategy_INSTANCED_STORAGE
+  "Multi-draw indirect", // DrawStrategy_MULTI_DRAW_INDIRECT
+};
+
+static const uint32_t triangle_counts[7]
+  = {1000, 10000, 20000, 100000, 250000, 500000, 1000000};
+static const char* triangle_count_names[7]
+  = {"1k", "10k", "20k", "100k", "250k", "500k", "1M"};
+
 // Settings
 static struct settings_t {
   uint64_t num_triangles;
-  bool render_bundles;
-  bool dynamic_offsets;
+  int32_t num_triangles_index;
+  int32_t strategy;
 } settings = {
-  .num_triangles   = 20000,
-  .render_bundles  = true,
-  .dynamic_offsets = false,
+  .num_triangles       = 20000,
+  .num_triangles_index = 2,
+  .strategy            = DrawStrategy_RENDER_BUNDLE,
 };
-static uint64_t uniform_bytes          = 0;
-static uint64_t aligned_uniform_bytes  = 0;
-static uint64_t aligned_uniform_floats = 0;
+static const uint64_t uniform_bytes         = 5 * sizeof(float);
+static const uint64_t aligned_uniform_bytes = 256;
+
+// Benchmark results of the active strategy, smoothed over the frames
+static struct {
+  float cpu_encode_ms;
+  float frame_time_ms;
+  uint32_t draw_calls;
+} stats = {0};
 
 // Vertex buffer
 static struct {
@@ -96,18 +165,31 @@ static struct {
   uint32_t count;
 } vertices = {0};
 
-//  Uniform buffer
-static WGPUBuffer uniform_buffer;
-static uint64_t time_offset  = 0;
+// Uniform buffers
+static WGPUBuffer time_buffer;
 static float uniform_time[1] = {0};
 
+// Per-triangle data, depending on the triangle count
+static struct {
+  // Uniforms with a 256 byte stride for the dynamic offsets
+  WGPUBuffer uniform_buffer;
+  // Tightly packed uniforms read by the storage buffer strategies
+  WGPUBuffer storage_buffer;
+  // One draw per triangle for the indirect strategy
+  WGPUBuffer indirect_buffer;
+  WGPUBindGroup dynamic_bind_group;
+  WGPUBindGroup storage_bind_group;
+  WGPURenderBundle render_bundle;
+} objects = {0};
+
 // The pipeline layouts
-static WGPUPipelineLayout pipeline_layout;
 static WGPUPipelineLayout dynamic_pipeline_layout;
+static WGPUPipelineLayout storage_pipeline_layout;
 
 // Pipelines
-static WGPURenderPipeline pipeline;
 static WGPURenderPipeline dynamic_pipeline;
+static WGPURenderPipeline instanced_pipeline;
+static WGPURenderPipeline indirect_pipeline;
 
 // Render pass descriptor for frame buffer writes
 static struct {
@@ -115,17 +197,11 @@ static struct {
   WGPURenderPassDescriptor descriptor;
 } render_pass;
 
-// Render bundles execute the commands previously recorded into the given
-// GPURenderBundles as part of this render pass.
-static WGPURenderBundle render_bundle;
-
 // Bind groups stores the resources bound to the binding points in a shader
 static WGPUBindGroupLayout time_bind_group_layout;
-static WGPUBindGroupLayout bind_group_layout;
 static WGPUBindGroupLayout dynamic_bind_group_layout;
+static WGPUBindGroupLayout storage_bind_group_layout;
 
-static WGPUBindGroup* bind_groups;
-static WGPUBindGroup dynamic_bind_group;
 static WGPUBindGroup time_bind_group;
 
 // Other variables
@@ -174,26 +250,6 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &time_bgl_desc);
   ASSERT(time_bind_group_layout != NULL)
 
-  // Bind group layout
-  WGPUBindGroupLayoutEntry bgl_entries[1] = {
-    [0] = (WGPUBindGroupLayoutEntry) {
-      .binding = 0,
-      .visibility = WGPUShaderStage_Vertex,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type = WGPUBufferBindingType_Uniform,
-        .minBindingSize = 20,
-      },
-      .sampler = {0},
-    },
-  };
-  WGPUBindGroupLayoutDescriptor bgl_desc = {
-    .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-    .entries    = bgl_entries,
-  };
-  bind_group_layout
-    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
-  ASSERT(bind_group_layout != NULL)
-
   // Dynamic bind group layout
   WGPUBindGroupLayoutEntry dynamic_bgl_entries[1] = {
     [0] = (WGPUBindGroupLayoutEntry) {
@@ -202,7 +258,7 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
       .buffer = (WGPUBufferBindingLayout) {
         .type = WGPUBufferBindingType_Uniform,
         .hasDynamicOffset = true,
-        .minBindingSize   = 20,
+        .minBindingSize   = uniform_bytes,
       },
       .sampler = {0},
     },
@@ -215,27 +271,47 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &dynamic_bgl_desc);
   ASSERT(dynamic_bind_group_layout != NULL)
 
-  // Create the pipeline layouts that are used to generate the rendering
-  // pipelines that are based on this bind group layouts
-  WGPUBindGroupLayout bgl_pipeline[2]
-    = {time_bind_group_layout, bind_group_layout};
-  WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
-    .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bgl_pipeline),
-    .bindGroupLayouts     = bgl_pipeline,
+  // Storage bind group layout
+  WGPUBindGroupLayoutEntry storage_bgl_entries[1] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      .binding = 1,
+      .visibility = WGPUShaderStage_Vertex,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = uniform_bytes,
+      },
+      .sampler = {0},
+    },
+  };
+  WGPUBindGroupLayoutDescriptor storage_bgl_desc = {
+    .entryCount = (uint32_t)ARRAY_SIZE(storage_bgl_entries),
+    .entries    = storage_bgl_entries,
   };
-  pipeline_layout = wgpuDeviceCreatePipelineLayout(wgpu_context->device,
-                                                   &pipeline_layout_desc);
-  ASSERT(pipeline_layout != NULL)
+  storage_bind_group_layout
+    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &storage_bgl_desc);
+  ASSERT(storage_bind_group_layout != NULL)
 
+  // Create the pipeline layouts that are used to generate the rendering
+  // pipelines that are based on this bind group layouts
   WGPUBindGroupLayout bgl_dynamic_pipeline[2]
     = {time_bind_group_layout, dynamic_bind_group_layout};
-  WGPUPipelineLayoutDescriptor _dynamic_pipeline_layout_desc = {
+  WGPUPipelineLayoutDescriptor dynamic_pipeline_layout_desc = {
     .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bgl_dynamic_pipeline),
     .bindGroupLayouts     = bgl_dynamic_pipeline,
   };
   dynamic_pipeline_layout = wgpuDeviceCreatePipelineLayout(
-    wgpu_context->device, &_dynamic_pipeline_layout_desc);
+    wgpu_context->device, &dynamic_pipeline_layout_desc);
   ASSERT(dynamic_pipeline_layout != NULL)
+
+  WGPUBindGroupLayout bgl_storage_pipeline[2]
+    = {time_bind_group_layout, storage_bind_group_layout};
+  WGPUPipelineLayoutDescriptor storage_pipeline_layout_desc = {
+    .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bgl_storage_pipeline),
+    .bindGroupLayouts     = bgl_storage_pipeline,
+  };
+  storage_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &storage_pipeline_layout_desc);
+  ASSERT(storage_pipeline_layout != NULL)
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -277,74 +353,24 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
     start_time = frame_timestamp_millis;
   }
   uniform_time[0] = (frame_timestamp_millis - start_time) / 1000.0f;
-  wgpu_queue_write_buffer(context->wgpu_context, uniform_buffer, time_offset,
-                          &uniform_time, sizeof(uniform_time));
+  wgpu_queue_write_buffer(context->wgpu_context, time_buffer, 0, &uniform_time,
+                          sizeof(uniform_time));
 }
 
-static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
+static void prepare_time_buffer(wgpu_context_t* wgpu_context)
 {
-  uniform_bytes          = 5 * sizeof(float);
-  aligned_uniform_bytes  = ceil(uniform_bytes / 256.0f) * 256;
-  aligned_uniform_floats = aligned_uniform_bytes / sizeof(float);
-  uniform_buffer         = wgpuDeviceCreateBuffer(
-            wgpu_context->device,
-            &(WGPUBufferDescriptor){
-              .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-              .size  = settings.num_triangles * aligned_uniform_bytes + sizeof(float),
-    });
-  float uniform_buffer_data[settings.num_triangles * aligned_uniform_floats];
-  bind_groups = malloc(settings.num_triangles * sizeof(WGPUBindGroup));
-  for (uint64_t i = 0; i < settings.num_triangles; ++i) {
-    uniform_buffer_data[aligned_uniform_floats * i + 0]
-      = float_random(0.0f, 1.0f) * 0.2f + 0.2f; // scale
-    uniform_buffer_data[aligned_uniform_floats * i + 1]
-      = 0.9f * 2.0f * (float_random(0.0f, 1.0f) - 0.5f); // offsetX
-    uniform_buffer_data[aligned_uniform_floats * i + 2]
-      = 0.9f * 2.0f * (float_random(0.0f, 1.0f) - 0.5f); // offsetY
-    uniform_buffer_data[aligned_uniform_floats * i + 3]
-      = float_random(0.0f, 1.0f) * 1.5f + 0.5f; // scalar
-    uniform_buffer_data[aligned_uniform_floats * i + 4]
-      = float_random(0.0f, 1.0f) * 10.0f; // scalarOffset
-
-    WGPUBindGroupEntry bg_entries[1] = {
-          [0] = (WGPUBindGroupEntry) {
-            .binding = 0,
-            .buffer = uniform_buffer,
-            .offset = i * aligned_uniform_bytes,
-            .size = 6 * sizeof(float),
-          },
-        };
-
-    bind_groups[i] = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, (&(WGPUBindGroupDescriptor){
-                              .layout     = bind_group_layout,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            }));
-  }
-
-  WGPUBindGroupEntry dynamic_bg_entries[1] = {
-        [0] = (WGPUBindGroupEntry) {
-          .binding = 0,
-          .buffer = uniform_buffer,
-          .offset = 0,
-          .size = 6 * sizeof(float),
-        },
-      };
-  dynamic_bind_group = wgpuDeviceCreateBindGroup(
+  time_buffer = wgpuDeviceCreateBuffer(
     wgpu_context->device,
-    (&(WGPUBindGroupDescriptor){
-      .layout     = dynamic_bind_group_layout,
-      .entryCount = (uint32_t)ARRAY_SIZE(dynamic_bg_entries),
-      .entries    = dynamic_bg_entries,
-    }));
+    &(WGPUBufferDescriptor){
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = sizeof(uniform_time),
+    });
 
-  time_offset = settings.num_triangles * aligned_uniform_bytes;
   WGPUBindGroupEntry time_bg_entries[1] = {
         [0] = (WGPUBindGroupEntry) {
           .binding = 0,
-          .buffer = uniform_buffer,
-          .offset = time_offset,
+          .buffer = time_buffer,
+          .offset = 0,
           .size = sizeof(float),
         },
       };
@@ -354,44 +380,172 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
                             .entryCount = (uint32_t)ARRAY_SIZE(time_bg_entries),
                             .entries    = time_bg_entries,
                           }));
+}
 
-  const uint64_t max_mapping_length = (14 * 1024 * 1024) / sizeof(float);
-  for (uint64_t offset = 0; offset < ARRAY_SIZE(uniform_buffer_data);
-       offset += max_mapping_length) {
-    const uint64_t upload_count
-      = MIN(ARRAY_SIZE(uniform_buffer_data) - offset, max_mapping_length);
-
-    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffer,
-                         offset * sizeof(float), &uniform_buffer_data[offset],
-                         upload_count * sizeof(float));
+// Uploads the data in chunks to bound the size of the staging copies
+static void write_buffer_chunked(wgpu_context_t* wgpu_context,
+                                 WGPUBuffer buffer, const uint8_t* data,
+                                 uint64_t size)
+{
+  const uint64_t max_mapping_length = 14 * 1024 * 1024;
+  for (uint64_t offset = 0; offset < size; offset += max_mapping_length) {
+    const uint64_t upload_size = MIN(size - offset, max_mapping_length);
+    wgpuQueueWriteBuffer(wgpu_context->queue, buffer, offset, &data[offset],
+                         upload_size);
   }
 }
 
-#define RECORD_RENDER_PASS(Type, rpass_enc)                                    \
+#define RECORD_DYNAMIC_OFFSET_DRAWS(Type, rpass_enc)                           \
   if (rpass_enc) {                                                             \
-    if (settings.dynamic_offsets) {                                            \
-      wgpu##Type##SetPipeline(rpass_enc, dynamic_pipeline);                    \
-    }                                                                          \
-    else {                                                                     \
-      wgpu##Type##SetPipeline(rpass_enc, pipeline);                            \
-    }                                                                          \
+    wgpu##Type##SetPipeline(rpass_enc, dynamic_pipeline);                      \
     wgpu##Type##SetVertexBuffer(rpass_enc, 0, vertices.buffer, 0,              \
                                 WGPU_WHOLE_SIZE);                              \
     wgpu##Type##SetBindGroup(rpass_enc, 0, time_bind_group, 0, 0);             \
     uint32_t dynamic_offsets[1] = {0};                                         \
     for (uint64_t i = 0; i < settings.num_triangles; ++i) {                    \
-      if (settings.dynamic_offsets) {                                          \
-        dynamic_offsets[0] = i * aligned_uniform_bytes;                        \
-        wgpu##Type##SetBindGroup(rpass_enc, 1, dynamic_bind_group, 1,          \
-                                 dynamic_offsets);                             \
-      }                                                                        \
-      else {                                                                   \
-        wgpu##Type##SetBindGroup(rpass_enc, 1, bind_groups[i], 0, 0);          \
-      }                                                                        \
+      dynamic_offsets[0] = (uint32_t)(i * aligned_uniform_bytes);              \
+      wgpu##Type##SetBindGroup(rpass_enc, 1, objects.dynamic_bind_group, 1,    \
+                               dynamic_offsets);                               \
       wgpu##Type##Draw(rpass_enc, 3, 1, 0, 0);                                 \
     }                                                                          \
   }
 
+static void prepare_render_bundle_encoder(wgpu_context_t* wgpu_context)
+{
+  WGPUTextureFormat color_formats[1] = {wgpu_context->swap_chain.format};
+  WGPURenderBundleEncoder render_bundle_encoder
+    = wgpuDeviceCreateRenderBundleEncoder(wgpu_context->device,
+                                          &(WGPURenderBundleEncoderDescriptor){
+                                            .colorFormatsCount = 1,
+                                            .colorFormats      = color_formats,
+                                            .sampleCount       = 1,
+                                          });
+  RECORD_DYNAMIC_OFFSET_DRAWS(RenderBundleEncoder, render_bundle_encoder)
+  objects.render_bundle
+    = wgpuRenderBundleEncoderFinish(render_bundle_encoder, NULL);
+
+  WGPU_RELEASE_RESOURCE(RenderBundleEncoder, render_bundle_encoder)
+}
+
+// Creates the per-triangle buffers and bind groups and records the render
+// bundle for the current triangle count
+static void prepare_objects(wgpu_context_t* wgpu_context)
+{
+  const uint64_t count = settings.num_triangles;
+
+  float* object_data = malloc(count * uniform_bytes);
+  for (uint64_t i = 0; i < count; ++i) {
+    // scale, offsetX, offsetY, scalar, scalarOffset
+    float* uniforms = &object_data[i * 5];
+    uniforms[0]     = float_random(0.0f, 1.0f) * 0.2f + 0.2f;
+    uniforms[1]     = 0.9f * 2.0f * (float_random(0.0f, 1.0f) - 0.5f);
+    uniforms[2]     = 0.9f * 2.0f * (float_random(0.0f, 1.0f) - 0.5f);
+    uniforms[3]     = float_random(0.0f, 1.0f) * 1.5f + 0.5f;
+    uniforms[4]     = float_random(0.0f, 1.0f) * 10.0f;
+  }
+
+  // Storage buffer, the uniforms are packed with a 20 byte stride
+  objects.storage_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = count * uniform_bytes,
+    });
+  write_buffer_chunked(wgpu_context, objects.storage_buffer,
+                       (const uint8_t*)object_data, count * uniform_bytes);
+
+  // Uniform buffer with the dynamic offset alignment, it is filled in chunks
+  // to bound the size of the padded copy
+  objects.uniform_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = count * aligned_uniform_bytes,
+    });
+  {
+    const uint64_t chunk_count = 16384;
+    uint8_t* chunk             = calloc(chunk_count, aligned_uniform_bytes);
+    for (uint64_t first = 0; first < count; first += chunk_count) {
+      const uint64_t chunk_size = MIN(count - first, chunk_count);
+      for (uint64_t i = 0; i < chunk_size; ++i) {
+        memcpy(&chunk[i * aligned_uniform_bytes],
+               &object_data[(first + i) * 5], uniform_bytes);
+      }
+      wgpuQueueWriteBuffer(wgpu_context->queue, objects.uniform_buffer,
+                           first * aligned_uniform_bytes, chunk,
+                           chunk_size * aligned_uniform_bytes);
+    }
+    free(chunk);
+  }
+  free(object_data);
+
+  // Indirect buffer, draw i renders the vertices 3i to 3i + 2
+  {
+    uint32_t* draws = malloc(count * 4 * sizeof(uint32_t));
+    for (uint64_t i = 0; i < count; ++i) {
+      draws[i * 4 + 0] = 3;               // vertexCount
+      draws[i * 4 + 1] = 1;               // instanceCount
+      draws[i * 4 + 2] = (uint32_t)i * 3; // firstVertex
+      draws[i * 4 + 3] = 0;               // firstInstance
+    }
+    objects.indirect_buffer = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Indirect,
+        .size  = count * 4 * sizeof(uint32_t),
+      });
+    write_buffer_chunked(wgpu_context, objects.indirect_buffer,
+                         (const uint8_t*)draws, count * 4 * sizeof(uint32_t));
+    free(draws);
+  }
+
+  WGPUBindGroupEntry dynamic_bg_entries[1] = {
+        [0] = (WGPUBindGroupEntry) {
+          .binding = 0,
+          .buffer = objects.uniform_buffer,
+          .offset = 0,
+          .size = uniform_bytes,
+        },
+      };
+  objects.dynamic_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    (&(WGPUBindGroupDescriptor){
+      .layout     = dynamic_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(dynamic_bg_entries),
+      .entries    = dynamic_bg_entries,
+    }));
+  ASSERT(objects.dynamic_bind_group != NULL)
+
+  WGPUBindGroupEntry storage_bg_entries[1] = {
+        [0] = (WGPUBindGroupEntry) {
+          .binding = 1,
+          .buffer = objects.storage_buffer,
+          .offset = 0,
+          .size = count * uniform_bytes,
+        },
+      };
+  objects.storage_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    (&(WGPUBindGroupDescriptor){
+      .layout     = storage_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(storage_bg_entries),
+      .entries    = storage_bg_entries,
+    }));
+  ASSERT(objects.storage_bind_group != NULL)
+
+  prepare_render_bundle_encoder(wgpu_context);
+}
+
+static void release_objects(void)
+{
+  WGPU_RELEASE_RESOURCE(RenderBundle, objects.render_bundle)
+  WGPU_RELEASE_RESOURCE(BindGroup, objects.dynamic_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, objects.storage_bind_group)
+  WGPU_RELEASE_RESOURCE(Buffer, objects.uniform_buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, objects.storage_buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, objects.indirect_buffer)
+}
+
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
 {
   // Primitive state
@@ -418,17 +572,25 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     // Attribute location 1: Vertex colors
     WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x4, vec4_size))
 
-  // Vertex state
-  WGPUVertexState vertex_state_desc = wgpu_create_vertex_state(
+  // Vertex states
+  static const char* vertex_entries[3]
+    = {"vert_main", "vert_main_instanced", "vert_main_indirect"};
+  WGPUVertexState vertex_state_descs[3] = {0};
+  for (uint32_t i = 0; i < ARRAY_SIZE(vertex_entries); ++i) {
+    // The indirect draws fetch the vertices in the shader
+    const bool indirect = (i == 2);
+    vertex_state_descs[i] = wgpu_create_vertex_state(
                 wgpu_context, &(wgpu_vertex_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
                   // Vertex shader WGSL
                   .wgsl_code.source = vertex_shader_wgsl,
-                  .entry            = "vert_main",
+                  .entry            = vertex_entries[i],
                 },
-                .buffer_count = 1,
-                .buffers      = &animometer_vertex_buffer_layout,
+                .buffer_count = indirect ? 0 : 1,
+                .buffers      = indirect ? NULL :
+                                           &animometer_vertex_buffer_layout,
               });
+  }
 
   // Fragment state
   WGPUFragmentState fragment_state_desc = wgpu_create_fragment_state(
@@ -453,39 +615,33 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPURenderPipelineDescriptor pipeline_desc = {
     .label       = "animometer_render_pipeline",
     .primitive   = primitive_state_desc,
-    .vertex      = vertex_state_desc,
     .fragment    = &fragment_state_desc,
     .multisample = multisample_state_desc,
   };
 
   // Create render pipelines
-  pipeline_desc.layout = pipeline_layout;
-  pipeline
-    = wgpuDeviceCreateRenderPipeline(wgpu_context->device, &pipeline_desc);
-
   pipeline_desc.layout = dynamic_pipeline_layout;
+  pipeline_desc.vertex = vertex_state_descs[0];
   dynamic_pipeline
     = wgpuDeviceCreateRenderPipeline(wgpu_context->device, &pipeline_desc);
+  ASSERT(dynamic_pipeline != NULL)
 
-  // Partial cleanup
-  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state_desc.module);
-  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state_desc.module);
-}
+  pipeline_desc.layout = storage_pipeline_layout;
+  pipeline_desc.vertex = vertex_state_descs[1];
+  instanced_pipeline
+    = wgpuDeviceCreateRenderPipeline(wgpu_context->device, &pipeline_desc);
+  ASSERT(instanced_pipeline != NULL)
 
-static void prepare_render_bundle_encoder(wgpu_context_t* wgpu_context)
-{
-  WGPUTextureFormat color_formats[1] = {wgpu_context->swap_chain.format};
-  WGPURenderBundleEncoder render_bundle_encoder
-    = wgpuDeviceCreateRenderBundleEncoder(wgpu_context->device,
-                                          &(WGPURenderBundleEncoderDescriptor){
-                                            .colorFormatsCount = 1,
-                                            .colorFormats      = color_formats,
-                                            .sampleCount       = 1,
-                                          });
-  RECORD_RENDER_PASS(RenderBundleEncoder, render_bundle_encoder)
-  render_bundle = wgpuRenderBundleEncoderFinish(render_bundle_encoder, NULL);
+  pipeline_desc.vertex = vertex_state_descs[2];
+  indirect_pipeline
+    = wgpuDeviceCreateRenderPipeline(wgpu_context->device, &pipeline_desc);
+  ASSERT(indirect_pipeline != NULL)
 
-  WGPU_RELEASE_RESOURCE(RenderBundleEncoder, render_bundle_encoder)
+  // Partial cleanup
+  for (uint32_t i = 0; i < ARRAY_SIZE(vertex_state_descs); ++i) {
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state_descs[i].module);
+  }
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state_desc.module);
 }
 
 static int example_initialize(wgpu_example_context_t* context)
@@ -493,10 +649,10 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     prepare_vertex_buffer(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
-    prepare_uniform_buffers(context->wgpu_context);
+    prepare_time_buffer(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
-    prepare_render_bundle_encoder(context->wgpu_context);
+    prepare_objects(context->wgpu_context);
     prepared = true;
     return 0;
   }
@@ -504,14 +660,100 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+// GPU time of the render pass of the active strategy, negative when unknown
+static float get_strategy_gpu_time_ms(wgpu_context_t* wgpu_context)
+{
+  const wgpu_gpu_profiler_result_t* results = NULL;
+  const uint32_t result_count
+    = wgpu_gpu_profiler_get_results(wgpu_context->gpu_profiler, &results);
+  for (uint32_t i = 0; i < result_count; ++i) {
+    if (strcmp(results[i].name, draw_strategy_names[settings.strategy])
+        == 0) {
+      return results[i].gpu_time_ms;
+    }
+  }
+  return -1.0f;
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
-    imgui_overlay_checkBox(context->imgui_overlay, "Render bundles",
-                           &settings.render_bundles);
-    imgui_overlay_checkBox(context->imgui_overlay, "Dynamic offsets",
-                           &settings.dynamic_offsets);
+    imgui_overlay_combo_box(context->imgui_overlay, "Strategy",
+                            &settings.strategy, draw_strategy_names,
+                            DrawStrategy_COUNT);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Triangles",
+                                &settings.num_triangles_index,
+                                triangle_count_names,
+                                (uint32_t)ARRAY_SIZE(triangle_count_names))) {
+      // The bind groups and the bundle referencing the buffers are released
+      // with them, the queue keeps the buffers alive until the GPU is done
+      settings.num_triangles = triangle_counts[settings.num_triangles_index];
+      release_objects();
+      prepare_objects(context->wgpu_context);
+    }
+  }
+  if (imgui_overlay_header("Benchmark")) {
+    const float frame_time_s = stats.frame_time_ms / 1000.0f;
+    const float gpu_time_ms = get_strategy_gpu_time_ms(context->wgpu_context);
+    imgui_overlay_text("CPU encode: %.3f ms", stats.cpu_encode_ms);
+    if (gpu_time_ms >= 0.0f) {
+      imgui_overlay_text("GPU: %.3f ms", gpu_time_ms);
+    }
+    else {
+      imgui_overlay_text("GPU: n/a");
+    }
+    imgui_overlay_text("Draws/s: %.2f M",
+                       frame_time_s > 0.0f ?
+                         (float)settings.num_triangles / frame_time_s * 1e-6f :
+                         0.0f);
+    imgui_overlay_text("API draw calls/frame: %u", stats.draw_calls);
+  }
+}
+
+static void record_draws(wgpu_context_t* wgpu_context)
+{
+  WGPURenderPassEncoder rpass_enc = wgpu_context->rpass_enc;
+  switch (settings.strategy) {
+    case DrawStrategy_DYNAMIC_OFFSETS: {
+      RECORD_DYNAMIC_OFFSET_DRAWS(RenderPassEncoder, rpass_enc)
+      stats.draw_calls = (uint32_t)settings.num_triangles;
+      break;
+    }
+    case DrawStrategy_RENDER_BUNDLE: {
+      wgpuRenderPassEncoderExecuteBundles(rpass_enc, 1,
+                                          &objects.render_bundle);
+      stats.draw_calls = (uint32_t)settings.num_triangles;
+      break;
+    }
+    case DrawStrategy_INSTANCED_STORAGE: {
+      wgpuRenderPassEncoderSetPipeline(rpass_enc, instanced_pipeline);
+      wgpuRenderPassEncoderSetVertexBuffer(rpass_enc, 0, vertices.buffer, 0,
+                                           WGPU_WHOLE_SIZE);
+      wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, time_bind_group, 0, 0);
+      wgpuRenderPassEncoderSetBindGroup(rpass_enc, 1,
+                                        objects.storage_bind_group, 0, 0);
+      wgpuRenderPassEncoderDraw(rpass_enc, vertices.count,
+                                (uint32_t)settings.num_triangles, 0, 0);
+      stats.draw_calls = 1;
+      break;
+    }
+    case DrawStrategy_MULTI_DRAW_INDIRECT: {
+      // The draws are consecutive in a single indirect buffer, the portable
+      // form of a multi-draw indirect call
+      wgpuRenderPassEncoderSetPipeline(rpass_enc, indirect_pipeline);
+      wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, time_bind_group, 0, 0);
+      wgpuRenderPassEncoderSetBindGroup(rpass_enc, 1,
+                                        objects.storage_bind_group, 0, 0);
+      for (uint64_t i = 0; i < settings.num_triangles; ++i) {
+        wgpuRenderPassEncoderDrawIndirect(rpass_enc, objects.indirect_buffer,
+                                          i * 4 * sizeof(uint32_t));
+      }
+      stats.draw_calls = (uint32_t)settings.num_triangles;
+      break;
+    }
+    default:
+      break;
   }
 }
 
@@ -524,21 +766,25 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
   {
-    // Render pass
+    // Render pass, timed on the CPU and on the GPU
+    const uint32_t scope = wgpu_gpu_profiler_begin_scope(
+      wgpu_context->gpu_profiler, wgpu_context->cmd_enc,
+      draw_strategy_names[settings.strategy]);
+    PROFILE_BEGIN("encode_draws");
+    const uint64_t encode_begin_ns = platform_get_time_ns();
+
     wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
       wgpu_context->cmd_enc, &render_pass.descriptor);
-
-    if (settings.render_bundles) {
-      const WGPURenderBundle render_bundles[1] = {render_bundle};
-      wgpuRenderPassEncoderExecuteBundles(wgpu_context->rpass_enc, 1,
-                                          render_bundles);
-    }
-    else {
-      RECORD_RENDER_PASS(RenderPassEncoder, wgpu_context->rpass_enc)
-    }
-
+    record_draws(wgpu_context);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+
+    const float encode_ms
+      = (float)(platform_get_time_ns() - encode_begin_ns) * 1e-6f;
+    stats.cpu_encode_ms += (encode_ms - stats.cpu_encode_ms) * 0.05f;
+    PROFILE_END();
+    wgpu_gpu_profiler_end_scope(wgpu_context->gpu_profiler,
+                                wgpu_context->cmd_enc, scope);
   }
 
   // Draw ui overlay
@@ -578,6 +824,8 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  const float frame_time_ms = context->frame_timer * 1000.0f;
+  stats.frame_time_ms += (frame_time_ms - stats.frame_time_ms) * 0.05f;
   const int draw_result = example_draw(context);
   if (!context->paused) {
     update_uniform_buffers(context);
@@ -589,21 +837,17 @@ static int example_render(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
+  release_objects();
   WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
+  WGPU_RELEASE_RESOURCE(Buffer, time_buffer)
   WGPU_RELEASE_RESOURCE(PipelineLayout, dynamic_pipeline_layout)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, storage_pipeline_layout)
   WGPU_RELEASE_RESOURCE(RenderPipeline, dynamic_pipeline)
-  WGPU_RELEASE_RESOURCE(RenderBundle, render_bundle)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, instanced_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, indirect_pipeline)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, time_bind_group_layout)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, dynamic_bind_group_layout);
-  for (uint64_t i = 0; i < settings.num_triangles; ++i) {
-    WGPU_RELEASE_RESOURCE(BindGroup, bind_groups[i])
-  }
-  free(bind_groups);
-  WGPU_RELEASE_RESOURCE(BindGroup, dynamic_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, dynamic_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, storage_bind_group_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, time_bind_group)
 }
 
@@ -64,10 +64,14 @@ static void setup_camera(wgpu_example_context_t* context)
 
 static void load_assets(wgpu_context_t* wgpu_context)
 {
+  // Quantized vertices, the normalized formats of the compact layout are read
+  // as floats by the shaders of the default layout
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
       | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_CompactVertices
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   model = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/cube.gltf",
@@ -272,16 +276,16 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     });
 
   // Vertex buffer layout
-  WGPU_GLTF_VERTEX_BUFFER_LAYOUT(
+  WGPU_GLTF_COMPACT_VERTEX_BUFFER_LAYOUT(
     cube,
     // Location 0: Position
-    WGPU_GLTF_VERTATTR_DESC(0, WGPU_GLTF_VertexComponent_Position),
+    WGPU_GLTF_COMPACT_VERTATTR_DESC(0, WGPU_GLTF_VertexComponent_Position),
     // Location 1: Vertex normal
-    WGPU_GLTF_VERTATTR_DESC(1, WGPU_GLTF_VertexComponent_Normal),
+    WGPU_GLTF_COMPACT_VERTATTR_DESC(1, WGPU_GLTF_VertexComponent_Normal),
     // Location 2: Texture coordinates
-    WGPU_GLTF_VERTATTR_DESC(2, WGPU_GLTF_VertexComponent_UV),
+    WGPU_GLTF_COMPACT_VERTATTR_DESC(2, WGPU_GLTF_VertexComponent_UV),
     // Location 3: Vertex color
-    WGPU_GLTF_VERTATTR_DESC(3, WGPU_GLTF_VertexComponent_Color));
+    WGPU_GLTF_COMPACT_VERTATTR_DESC(3, WGPU_GLTF_VertexComponent_Color));
 
   // Vertex state
   WGPUVertexState vertex_state_desc = wgpu_create_vertex_state(
@@ -3,6 +3,8 @@
 
 #include <string.h>
 
+#include "../webgpu/dynamic_resolution.h"
+#include "../webgpu/frame_graph.h"
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
 
@@ -10,15 +12,25 @@
  * WebGPU Example - Bloom (Offscreen Rendering)
  *
  * Advanced fullscreen effect example adding a bloom effect to a scene. Glowing
- * scene parts are rendered to a low res offscreen framebuffer that is applied
- * atop the scene using a two pass separated gaussian blur.
+ * scene parts are rendered to a half resolution offscreen framebuffer, which
+ * is progressively downsampled into a chain of smaller targets with a 13-tap
+ * filter. The chain is then upsampled again with a tent filter, every level
+ * being added on top of the next larger one, and the result is applied atop
+ * the scene. The targets of the chain are transient frame graph textures.
+ *
+ * With dynamic resolution (--dynamic-resolution) the chain is rendered into
+ * scaled viewports of its textures, which keep the size of the full resolution
+ * so that a change of the scale doesn't reallocate them, and the composition
+ * upscales the first level onto the scene.
  *
  * Ref:
+ * http://www.iryoku.com/next-generation-post-processing-in-call-of-duty-advanced-warfare
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/bloom
  * -------------------------------------------------------------------------- */
 
-// Offscreen frame buffer properties
-#define FB_DIM 256
+// Offscreen frame buffer properties, the glow parts are rendered at half the
+// surface resolution and downsampled BLOOM_MIP_COUNT - 1 times
+#define BLOOM_MIP_COUNT 6u
 #define FB_COLOR_FORMAT WGPUTextureFormat_RGBA8Unorm
 #define FB_DEPTH_FORMAT WGPUTextureFormat_Depth24PlusStencil8
 
@@ -47,6 +59,9 @@ typedef struct {
 typedef struct {
   float blur_scale;
   float blur_strength;
+  // Share of the levels covered by the viewports, the dynamic resolution scale
+  float uv_scale;
+  float padding;
 } ubo_blur_params_t;
 
 static struct {
@@ -56,12 +71,14 @@ static struct {
   .blur_params = (ubo_blur_params_t){
     .blur_scale    = 1.0f,
     .blur_strength = 1.5f,
+    .uv_scale      = 1.0f,
   },
 };
 
 static struct {
-  WGPURenderPipeline blur_vert;
-  WGPURenderPipeline blur_horz;
+  WGPURenderPipeline bloom_downsample;
+  WGPURenderPipeline bloom_upsample;
+  WGPURenderPipeline bloom_composite;
   WGPURenderPipeline glow_pass;
   WGPURenderPipeline phong_pass;
   WGPURenderPipeline skybox;
@@ -74,8 +91,6 @@ static struct {
 } pipeline_layouts;
 
 static struct {
-  WGPUBindGroup blur_vert;
-  WGPUBindGroup blur_horz;
   WGPUBindGroup scene;
   WGPUBindGroup skybox;
 } bind_groups;
@@ -86,31 +101,110 @@ static struct {
   WGPUBindGroupLayout skybox;
 } bind_group_layouts;
 
-// Framebuffer for offscreen rendering
-typedef struct {
-  WGPUTexture texture;
-  WGPUTextureView texture_view;
-} frame_buffer_attachment_t;
-
-typedef struct {
-  frame_buffer_attachment_t color;
-  frame_buffer_attachment_t depth;
-  struct {
-    WGPURenderPassColorAttachment color_attachment[1];
-    WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
-    WGPURenderPassDescriptor render_pass_descriptor;
-  } render_pass_desc;
-} frame_buffer_t;
-
+// Bloom mip chain, level 0 holds the glow parts of the scene. The bind groups
+// sample the levels and are recreated when the frame graph reallocates them.
+// The levels are rendered at the scale of the dynamic resolution, if any.
 static struct {
-  uint32_t width, height;
+  wgpu_frame_graph_t* graph;
+  wgpu_dynamic_resolution_t* dynamic_resolution;
+  wgpu_frame_graph_resource_t depth;
+  wgpu_frame_graph_resource_t levels[BLOOM_MIP_COUNT];
+  uint32_t level_indices[BLOOM_MIP_COUNT];
   WGPUSampler sampler;
-  frame_buffer_t frame_buffers[2];
-} offscreen_pass;
+  WGPUBindGroup bind_groups[BLOOM_MIP_COUNT];
+} bloom_chain;
 
 static WGPURenderPassColorAttachment rp_color_att_descriptors[1];
 static WGPURenderPassDescriptor render_pass_desc;
 
+// clang-format off
+static const char* bloom_shader_wgsl = CODE(
+  struct BlurParams {
+    blurScale : f32,
+    blurStrength : f32,
+    uvScale : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : BlurParams;
+  @group(0) @binding(1) var srcTexture : texture_2d<f32>;
+  @group(0) @binding(2) var srcSampler : sampler;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) uv : vec2<f32>,
+  };
+
+  // Fullscreen triangle
+  @vertex
+  fn vs_main(@builtin(vertex_index) vertexIndex : u32) -> VertexOutput {
+    var output : VertexOutput;
+    let uv = vec2<f32>(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+    output.position = vec4<f32>(uv * 2.0 - 1.0, 0.0, 1.0);
+    output.uv = vec2<f32>(uv.x, 1.0 - uv.y);
+    return output;
+  }
+
+  // The filters accumulate in hfloat, f16 where the device supports it, the
+  // texture coordinates keep full precision. They are clamped to the rendered
+  // part of the level, the texels outside of it are stale.
+  fn sampleOffset(uv : vec2<f32>, texel : vec2<f32>, x : f32,
+                  y : f32) -> vec4<hfloat> {
+    let halfTexel = 0.5 / vec2<f32>(textureDimensions(srcTexture));
+    let coord = clamp(uv + texel * vec2<f32>(x, y), halfTexel,
+                      vec2<f32>(params.uvScale) - halfTexel);
+    return vec4<hfloat>(textureSample(srcTexture, srcSampler, coord));
+  }
+
+  // 13 bilinear taps forming five overlapping 2x2 box filters around the
+  // pixel, weighted so that the inner box gets half of the total weight
+  @fragment
+  fn fs_downsample(input : VertexOutput) -> @location(0) vec4<f32> {
+    let texel = 1.0 / vec2<f32>(textureDimensions(srcTexture));
+    let uv = input.uv * params.uvScale;
+    var color = sampleOffset(uv, texel, 0.0, 0.0) * hfloat(0.125);
+    color = color + (sampleOffset(uv, texel, -2.0, -2.0)
+                     + sampleOffset(uv, texel, 2.0, -2.0)
+                     + sampleOffset(uv, texel, -2.0, 2.0)
+                     + sampleOffset(uv, texel, 2.0, 2.0)) * hfloat(0.03125);
+    color = color + (sampleOffset(uv, texel, 0.0, -2.0)
+                     + sampleOffset(uv, texel, -2.0, 0.0)
+                     + sampleOffset(uv, texel, 2.0, 0.0)
+                     + sampleOffset(uv, texel, 0.0, 2.0)) * hfloat(0.0625);
+    color = color + (sampleOffset(uv, texel, -1.0, -1.0)
+                     + sampleOffset(uv, texel, 1.0, -1.0)
+                     + sampleOffset(uv, texel, -1.0, 1.0)
+                     + sampleOffset(uv, texel, 1.0, 1.0)) * hfloat(0.125);
+    return vec4<f32>(color);
+  }
+
+  // 3x3 tent filter, its radius in source texels is the blur scale
+  fn tentFilter(uv : vec2<f32>) -> vec4<hfloat> {
+    let texel = params.blurScale / vec2<f32>(textureDimensions(srcTexture));
+    var color = sampleOffset(uv, texel, 0.0, 0.0) * hfloat(4.0);
+    color = color + (sampleOffset(uv, texel, 0.0, -1.0)
+                     + sampleOffset(uv, texel, -1.0, 0.0)
+                     + sampleOffset(uv, texel, 1.0, 0.0)
+                     + sampleOffset(uv, texel, 0.0, 1.0)) * hfloat(2.0);
+    color = color + sampleOffset(uv, texel, -1.0, -1.0)
+            + sampleOffset(uv, texel, 1.0, -1.0)
+            + sampleOffset(uv, texel, -1.0, 1.0)
+            + sampleOffset(uv, texel, 1.0, 1.0);
+    return color * hfloat(0.0625);
+  }
+
+  @fragment
+  fn fs_upsample(input : VertexOutput) -> @location(0) vec4<f32> {
+    return vec4<f32>(tentFilter(input.uv * params.uvScale));
+  }
+
+  @fragment
+  fn fs_composite(input : VertexOutput) -> @location(0) vec4<f32> {
+    return vec4<f32>(tentFilter(input.uv * params.uvScale))
+           * params.blurStrength;
+  }
+);
+// clang-format on
+
 static const char* example_title = "Bloom (Offscreen Rendering)";
 static bool prepared             = false;
 
@@ -129,7 +223,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors;
+      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   models.ufo = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/retroufo.gltf",
@@ -151,122 +246,135 @@ static void load_assets(wgpu_context_t* wgpu_context)
                                           "textures/cubemap_space.ktx", NULL);
 }
 
-// Setup the offscreen framebuffer for rendering the mirrored scene
-// The color attachment of this framebuffer will then be sampled from
-static void prepare_offscreen_frame_buffer(wgpu_context_t* wgpu_context,
-                                           frame_buffer_t* frame_buf,
-                                           WGPUTextureFormat color_format,
-                                           WGPUTextureFormat depth_format)
+// Renders the glow parts of the model (separate mesh) into level 0
+static void bloom_glow_pass_execute(wgpu_frame_graph_t* graph,
+                                    WGPUCommandEncoder cmd_enc,
+                                    void* user_data)
 {
-  // Create the texture extent
-  WGPUExtent3D texture_extent = {
-    .width              = FB_DIM,
-    .height             = FB_DIM,
-    .depthOrArrayLayers = 1,
+  UNUSED_VAR(user_data);
+
+  uint32_t width = 0, height = 0;
+  wgpu_frame_graph_get_size(graph, bloom_chain.levels[0], &width, &height);
+  float viewport_width = 0.0f, viewport_height = 0.0f;
+  wgpu_dynamic_resolution_get_viewport(bloom_chain.dynamic_resolution, width,
+                                       height, &viewport_width,
+                                       &viewport_height);
+
+  WGPURenderPassColorAttachment color_attachment = {
+    .view       = wgpu_frame_graph_get_view(graph, bloom_chain.levels[0]),
+    .loadOp     = WGPULoadOp_Clear,
+    .storeOp    = WGPUStoreOp_Store,
+    .clearColor = (WGPUColor) {
+      .r = 0.0f,
+      .g = 0.0f,
+      .b = 0.0f,
+      .a = 0.0f,
+    },
+  };
+  WGPURenderPassDepthStencilAttachment depth_stencil_attachment = {
+    .view           = wgpu_frame_graph_get_view(graph, bloom_chain.depth),
+    .depthLoadOp    = WGPULoadOp_Clear,
+    .depthStoreOp   = WGPUStoreOp_Discard,
+    .clearDepth     = 1.0f,
+    .stencilLoadOp  = WGPULoadOp_Clear,
+    .stencilStoreOp = WGPUStoreOp_Discard,
+    .clearStencil   = 0,
   };
+  WGPURenderPassEncoder rpass_enc = wgpuCommandEncoderBeginRenderPass(
+    cmd_enc, &(WGPURenderPassDescriptor){
+               .colorAttachmentCount   = 1,
+               .colorAttachments       = &color_attachment,
+               .depthStencilAttachment = &depth_stencil_attachment,
+             });
+  wgpuRenderPassEncoderSetViewport(rpass_enc, 0.0f, 0.0f, viewport_width,
+                                   viewport_height, 0.0f, 1.0f);
+  wgpuRenderPassEncoderSetScissorRect(rpass_enc, 0u, 0u, width, height);
+
+  wgpuRenderPassEncoderSetPipeline(rpass_enc, pipelines.glow_pass);
+  wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, bind_groups.scene, 0, 0);
+  wgpu_gltf_model_draw_to_pass(models.ufo_glow, rpass_enc,
+                               (wgpu_gltf_model_render_options_t){0});
+
+  wgpuRenderPassEncoderEnd(rpass_enc);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+}
 
-  // Color attachment
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .label         = "offscreen_frame_buffer_color_texture",
-      .size          = texture_extent,
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = color_format,
-      .usage
-      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
-    };
-    frame_buf->color.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-
-    // Create the texture view
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .label           = "offscreen_frame_buffer_color_texture_view",
-      .dimension       = WGPUTextureViewDimension_2D,
-      .format          = texture_desc.format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = 1,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = 1,
-    };
-    frame_buf->color.texture_view
-      = wgpuTextureCreateView(frame_buf->color.texture, &texture_view_dec);
-  }
+// Draws a fullscreen triangle sampling a level of the chain into another one
+static void bloom_filter_pass(wgpu_frame_graph_t* graph,
+                              WGPUCommandEncoder cmd_enc,
+                              WGPURenderPipeline pipeline, uint32_t src_level,
+                              uint32_t dst_level, WGPULoadOp load_op)
+{
+  uint32_t width = 0, height = 0;
+  wgpu_frame_graph_get_size(graph, bloom_chain.levels[dst_level], &width,
+                            &height);
+  float viewport_width = 0.0f, viewport_height = 0.0f;
+  wgpu_dynamic_resolution_get_viewport(bloom_chain.dynamic_resolution, width,
+                                       height, &viewport_width,
+                                       &viewport_height);
+
+  WGPURenderPassColorAttachment color_attachment = {
+    .view = wgpu_frame_graph_get_view(graph, bloom_chain.levels[dst_level]),
+    .loadOp     = load_op,
+    .storeOp    = WGPUStoreOp_Store,
+    .clearColor = (WGPUColor) {
+      .r = 0.0f,
+      .g = 0.0f,
+      .b = 0.0f,
+      .a = 0.0f,
+    },
+  };
+  WGPURenderPassEncoder rpass_enc = wgpuCommandEncoderBeginRenderPass(
+    cmd_enc, &(WGPURenderPassDescriptor){
+               .colorAttachmentCount = 1,
+               .colorAttachments     = &color_attachment,
+             });
+  wgpuRenderPassEncoderSetViewport(rpass_enc, 0.0f, 0.0f, viewport_width,
+                                   viewport_height, 0.0f, 1.0f);
+  wgpuRenderPassEncoderSetPipeline(rpass_enc, pipeline);
+  wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0,
+                                    bloom_chain.bind_groups[src_level], 0, 0);
+  wgpuRenderPassEncoderDraw(rpass_enc, 3, 1, 0, 0);
+  wgpuRenderPassEncoderEnd(rpass_enc);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+}
 
-  // Depth stencil attachment
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .label         = "offscreen_frame_buffer_depth_stencil_texture",
-      .size          = texture_extent,
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = depth_format,
-      .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
-    };
-    frame_buf->depth.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-
-    // Create the texture view
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .label           = "offscreen_frame_buffer_depth_stencil_texture_view",
-      .dimension       = WGPUTextureViewDimension_2D,
-      .format          = texture_desc.format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = 1,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = 1,
-      .aspect          = WGPUTextureAspect_All,
-    };
-    frame_buf->depth.texture_view
-      = wgpuTextureCreateView(frame_buf->depth.texture, &texture_view_dec);
-  }
+// Filters level - 1 down into level
+static void bloom_downsample_pass_execute(wgpu_frame_graph_t* graph,
+                                          WGPUCommandEncoder cmd_enc,
+                                          void* user_data)
+{
+  const uint32_t level = *(uint32_t*)user_data;
+  bloom_filter_pass(graph, cmd_enc, pipelines.bloom_downsample, level - 1,
+                    level, WGPULoadOp_Clear);
+}
 
-  // Create a separate render pass for the offscreen rendering as it may differ
-  // from the one used for scene rendering
-  // Color attachment
-  frame_buf->render_pass_desc.color_attachment[0]
-    = (WGPURenderPassColorAttachment) {
-      .view       = frame_buf->color.texture_view,
-      .loadOp     = WGPULoadOp_Clear,
-      .storeOp    = WGPUStoreOp_Store,
-      .clearColor = (WGPUColor) {
-        .r = 0.0f,
-        .g = 0.0f,
-        .b = 0.0f,
-        .a = 0.0f,
-      },
-  };
-  // Depth stencil attachment
-  frame_buf->render_pass_desc.depth_stencil_attachment
-    = (WGPURenderPassDepthStencilAttachment){
-      .view           = frame_buf->depth.texture_view,
-      .depthLoadOp    = WGPULoadOp_Clear,
-      .depthStoreOp   = WGPUStoreOp_Store,
-      .clearDepth     = 1.0f,
-      .stencilLoadOp  = WGPULoadOp_Clear,
-      .stencilStoreOp = WGPUStoreOp_Store,
-      .clearStencil   = 0,
-    };
-  // Render pass descriptor
-  frame_buf->render_pass_desc.render_pass_descriptor
-    = (WGPURenderPassDescriptor){
-      .colorAttachmentCount = 1,
-      .colorAttachments     = frame_buf->render_pass_desc.color_attachment,
-      .depthStencilAttachment
-      = &frame_buf->render_pass_desc.depth_stencil_attachment,
-    };
+// Filters level + 1 up and adds it to level
+static void bloom_upsample_pass_execute(wgpu_frame_graph_t* graph,
+                                        WGPUCommandEncoder cmd_enc,
+                                        void* user_data)
+{
+  const uint32_t level = *(uint32_t*)user_data;
+  bloom_filter_pass(graph, cmd_enc, pipelines.bloom_upsample, level + 1, level,
+                    WGPULoadOp_Load);
 }
 
-// Prepare the offscreen framebuffers used for the vertical- and horizontal blur
-static void prepare_offscreen(wgpu_context_t* wgpu_context)
+// Declares the glow pass and the mip chain, the levels are allocated by the
+// frame graph for the surface size
+static void prepare_bloom_chain(wgpu_context_t* wgpu_context)
 {
-  offscreen_pass.width  = (uint32_t)FB_DIM;
-  offscreen_pass.height = (uint32_t)FB_DIM;
+  // The levels of a previous initialization are not reused
+  for (uint32_t i = 0; i < BLOOM_MIP_COUNT; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, bloom_chain.bind_groups[i])
+  }
+  if (bloom_chain.graph != NULL) {
+    wgpu_frame_graph_release(bloom_chain.graph);
+    bloom_chain.graph = NULL;
+  }
+  WGPU_RELEASE_RESOURCE(Sampler, bloom_chain.sampler)
 
-  // Create sampler to sample from the color attachments
-  offscreen_pass.sampler = wgpuDeviceCreateSampler(
+  // Create sampler to sample from the levels
+  bloom_chain.sampler = wgpuDeviceCreateSampler(
     wgpu_context->device, &(WGPUSamplerDescriptor){
                             .addressModeU  = WGPUAddressMode_ClampToEdge,
                             .addressModeV  = WGPUAddressMode_ClampToEdge,
@@ -279,11 +387,62 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
                             .maxAnisotropy = 1,
                           });
 
-  // Create two frame buffers
-  prepare_offscreen_frame_buffer(wgpu_context, &offscreen_pass.frame_buffers[0],
-                                 FB_COLOR_FORMAT, FB_DEPTH_FORMAT);
-  prepare_offscreen_frame_buffer(wgpu_context, &offscreen_pass.frame_buffers[1],
-                                 FB_COLOR_FORMAT, FB_DEPTH_FORMAT);
+  wgpu_frame_graph_t* graph      = wgpu_frame_graph_create(wgpu_context);
+  bloom_chain.graph              = graph;
+  bloom_chain.dynamic_resolution = wgpu_context->dynamic_resolution;
+  bloom_chain.depth              = wgpu_frame_graph_create_texture(
+    graph, &(wgpu_frame_graph_texture_desc_t){
+             .label  = "bloom_glow_depth",
+             .format = FB_DEPTH_FORMAT,
+             .scale  = 0.5f,
+             .usage  = WGPUTextureUsage_RenderAttachment,
+           });
+  float scale = 0.5f;
+  for (uint32_t i = 0; i < BLOOM_MIP_COUNT; ++i, scale *= 0.5f) {
+    bloom_chain.levels[i] = wgpu_frame_graph_create_texture(
+      graph, &(wgpu_frame_graph_texture_desc_t){
+               .label  = "bloom_level",
+               .format = FB_COLOR_FORMAT,
+               .scale  = scale,
+             });
+    bloom_chain.level_indices[i] = i;
+  }
+
+  wgpu_frame_graph_add_pass(graph, &(wgpu_frame_graph_pass_desc_t){
+                                     .label        = "bloom_glow_pass",
+                                     .output_count = 2,
+                                     .outputs      = {
+                                       bloom_chain.levels[0],
+                                       bloom_chain.depth,
+                                     },
+                                     .func = bloom_glow_pass_execute,
+                                   });
+  for (uint32_t i = 1; i < BLOOM_MIP_COUNT; ++i) {
+    wgpu_frame_graph_add_pass(
+      graph, &(wgpu_frame_graph_pass_desc_t){
+               .label        = "bloom_downsample_pass",
+               .input_count  = 1,
+               .inputs       = {bloom_chain.levels[i - 1]},
+               .output_count = 1,
+               .outputs      = {bloom_chain.levels[i]},
+               .func         = bloom_downsample_pass_execute,
+               .user_data    = &bloom_chain.level_indices[i],
+             });
+  }
+  for (uint32_t i = BLOOM_MIP_COUNT - 1; i > 0; --i) {
+    wgpu_frame_graph_add_pass(
+      graph, &(wgpu_frame_graph_pass_desc_t){
+               .label        = "bloom_upsample_pass",
+               .input_count  = 1,
+               .inputs       = {bloom_chain.levels[i]},
+               .output_count = 1,
+               .outputs      = {bloom_chain.levels[i - 1]},
+               .func         = bloom_upsample_pass_execute,
+               .user_data    = &bloom_chain.level_indices[i - 1],
+             });
+  }
+  wgpu_frame_graph_compile(graph, wgpu_context->surface.width,
+                           wgpu_context->surface.height);
 }
 
 static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
@@ -428,11 +587,11 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
   }
 }
 
-static void setup_bind_groups(wgpu_context_t* wgpu_context)
+// Bind groups sampling the levels of the bloom chain, recreated whenever the
+// frame graph allocates other textures for them
+static void setup_bloom_bind_groups(wgpu_context_t* wgpu_context)
 {
-  // Bind group for full screen blur
-  // Vertical blur
-  {
+  for (uint32_t i = 0; i < BLOOM_MIP_COUNT; ++i) {
     WGPUBindGroupEntry bg_entries[3] = {
         [0] = (WGPUBindGroupEntry) {
           // Binding 0: Fragment shader uniform buffer
@@ -442,55 +601,32 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
           .size    = uniform_buffers.blur_params.size,
         },
         [1] = (WGPUBindGroupEntry) {
-         // Binding 1: Fragment shader image sampler
+         // Binding 1: Fragment shader image view
           .binding     = 1,
-          .textureView = offscreen_pass.frame_buffers[0].color.texture_view,
+          .textureView = wgpu_frame_graph_get_view(bloom_chain.graph,
+                                                   bloom_chain.levels[i]),
         },
         [2] = (WGPUBindGroupEntry) {
           // Binding 2: Fragment shader image sampler
           .binding = 2,
-          .sampler = offscreen_pass.sampler,
+          .sampler = bloom_chain.sampler,
         },
       };
 
-    bind_groups.blur_vert = wgpuDeviceCreateBindGroup(
+    WGPU_RELEASE_RESOURCE(BindGroup, bloom_chain.bind_groups[i])
+    bloom_chain.bind_groups[i] = wgpuDeviceCreateBindGroup(
       wgpu_context->device, &(WGPUBindGroupDescriptor){
                               .layout     = bind_group_layouts.blur,
                               .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
                               .entries    = bg_entries,
                             });
-    ASSERT(bind_groups.blur_vert != NULL)
+    ASSERT(bloom_chain.bind_groups[i] != NULL)
   }
-  // Horizontal blur
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-        [0] = (WGPUBindGroupEntry) {
-          // Binding 0: Fragment shader uniform buffer
-          .binding = 0,
-          .buffer  = uniform_buffers.blur_params.buffer,
-          .offset  = 0,
-          .size    = uniform_buffers.blur_params.size,
-        },
-        [1] = (WGPUBindGroupEntry) {
-         // Binding 1: Fragment shader image sampler
-          .binding     = 1,
-          .textureView = offscreen_pass.frame_buffers[1].color.texture_view,
-        },
-        [2] = (WGPUBindGroupEntry) {
-          // Binding 2: Fragment shader image sampler
-          .binding = 2,
-          .sampler = offscreen_pass.sampler,
-        },
-      };
+}
 
-    bind_groups.blur_horz = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, &(WGPUBindGroupDescriptor){
-                              .layout     = bind_group_layouts.blur,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            });
-    ASSERT(bind_groups.blur_horz != NULL)
-  }
+static void setup_bind_groups(wgpu_context_t* wgpu_context)
+{
+  setup_bloom_bind_groups(wgpu_context);
 
   // Bind group for scene rendering
   {
@@ -594,80 +730,58 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
         .sample_count = 1,
       });
 
-  // Blur pipelines
+  // Bloom pipelines, the levels are filtered without depth attachment
   {
-    // Additive blending
-    WGPUBlendState blend_state_radial_blur = {
+    // Additive blending of the upsampled levels
+    WGPUBlendState blend_state_additive = {
       .color.operation = WGPUBlendOperation_Add,
       .color.srcFactor = WGPUBlendFactor_One,
       .color.dstFactor = WGPUBlendFactor_One,
       .alpha.operation = WGPUBlendOperation_Add,
-      .alpha.srcFactor = WGPUBlendFactor_SrcAlpha,
-      .alpha.dstFactor = WGPUBlendFactor_DstAlpha,
+      .alpha.srcFactor = WGPUBlendFactor_One,
+      .alpha.dstFactor = WGPUBlendFactor_One,
     };
     WGPUColorTargetState color_target_state = (WGPUColorTargetState){
       .format    = FB_COLOR_FORMAT,
-      .blend     = &blend_state_radial_blur,
+      .blend     = NULL,
       .writeMask = WGPUColorWriteMask_All,
     };
 
-    // Vertical blur pipeline
-    {
-      // Vertex state
-      WGPUVertexState vertex_state = wgpu_create_vertex_state(
-                wgpu_context, &(wgpu_vertex_state_t){
-                .shader_desc = (wgpu_shader_desc_t){
-                  // Vertex shader SPIR-V
-                  .label = "gaussblur_vert.vertex_shader",
-                  .file  = "shaders/bloom/gaussblur.vert.spv",
-                },
-                // Empty vertex input state
-                .buffer_count = 0,
-                .buffers      = NULL,
-              });
-
-      // Fragment state
-      WGPUFragmentState fragment_state = wgpu_create_fragment_state(
-                wgpu_context, &(wgpu_fragment_state_t){
-                .shader_desc = (wgpu_shader_desc_t){
-                  // Fragment shader SPIR-V
-                  .label = "gaussblur_vert.fragment_shader",
-                  .file  = "shaders/bloom/gaussblur_vert.frag.spv",
-                },
-                .target_count = 1,
-                .targets      = &color_target_state,
-              });
-
-      // Create rendering pipeline using the specified states
-      pipelines.blur_vert = wgpuDeviceCreateRenderPipeline(
-        wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                                .label        = "vertical_blur_render_pipeline",
-                                .layout       = pipeline_layouts.blur,
-                                .primitive    = primitive_state,
-                                .vertex       = vertex_state,
-                                .fragment     = &fragment_state,
-                                .depthStencil = &depth_stencil_state,
-                                .multisample  = multisample_state,
-                              });
-      ASSERT(pipelines.blur_vert);
-
-      // Partial cleanup
-      WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
-      WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
-    }
+    // The composition is drawn in the scene pass and ignores its depth
+    WGPUDepthStencilState composite_depth_stencil_state = depth_stencil_state;
+    composite_depth_stencil_state.depthWriteEnabled = false;
+    composite_depth_stencil_state.depthCompare = WGPUCompareFunction_Always;
+
+    struct {
+      WGPURenderPipeline* pipeline;
+      const char* label;
+      const char* entry;
+      WGPUTextureFormat format;
+      WGPUBlendState* blend;
+      WGPUDepthStencilState* depth_stencil;
+    } bloom_pipelines[3] = {
+      {&pipelines.bloom_downsample, "bloom_downsample_render_pipeline",
+       "fs_downsample", FB_COLOR_FORMAT, NULL, NULL},
+      {&pipelines.bloom_upsample, "bloom_upsample_render_pipeline",
+       "fs_upsample", FB_COLOR_FORMAT, &blend_state_additive, NULL},
+      {&pipelines.bloom_composite, "bloom_composite_render_pipeline",
+       "fs_composite", wgpu_context->swap_chain.format, &blend_state_additive,
+       &composite_depth_stencil_state},
+    };
 
-    // Horizontal blur pipeline
-    {
-      // Using swapchain format in this pipeline
-      color_target_state.format = wgpu_context->swap_chain.format;
+    for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(bloom_pipelines); ++i) {
+      color_target_state.format = bloom_pipelines[i].format;
+      color_target_state.blend  = bloom_pipelines[i].blend;
 
       // Vertex state
       WGPUVertexState vertex_state = wgpu_create_vertex_state(
                 wgpu_context, &(wgpu_vertex_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
-                  // Vertex shader SPIR-V
-                  .label = "gaussblur_horz_vertex_shader",
-                  .file  = "shaders/bloom/gaussblur.vert.spv",
+                  // Vertex shader WGSL
+                  .label            = "bloom_vertex_shader",
+                  .wgsl_code.source = bloom_shader_wgsl,
+                  .half_precision   = true,
+                  .entry            = "vs_main",
                 },
                 // Empty vertex input state
                 .buffer_count = 0,
@@ -678,26 +792,29 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
       WGPUFragmentState fragment_state = wgpu_create_fragment_state(
                 wgpu_context, &(wgpu_fragment_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
-                  // Fragment shader SPIR-V
-                  .label = "gaussblur_horz_fragment_shader",
-                  .file  = "shaders/bloom/gaussblur_horz.frag.spv",
+                  // Fragment shader WGSL
+                  .label            = "bloom_fragment_shader",
+                  .wgsl_code.source = bloom_shader_wgsl,
+                  .half_precision   = true,
+                  .entry            = bloom_pipelines[i].entry,
                 },
                 .target_count = 1,
                 .targets      = &color_target_state,
               });
 
       // Create rendering pipeline using the specified states
-      pipelines.blur_horz = wgpuDeviceCreateRenderPipeline(
-        wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                                .label     = "horizontal_blur_render_pipeline",
-                                .layout    = pipeline_layouts.blur,
-                                .primitive = primitive_state,
-                                .vertex    = vertex_state,
-                                .fragment  = &fragment_state,
-                                .depthStencil = &depth_stencil_state,
-                                .multisample  = multisample_state,
-                              });
-      ASSERT(pipelines.blur_horz);
+      *bloom_pipelines[i].pipeline = wgpu_pipeline_cache_get_render_pipeline(
+        wgpu_context,
+        &(WGPURenderPipelineDescriptor){
+          .label        = bloom_pipelines[i].label,
+          .layout       = pipeline_layouts.blur,
+          .primitive    = primitive_state,
+          .vertex       = vertex_state,
+          .fragment     = &fragment_state,
+          .depthStencil = bloom_pipelines[i].depth_stencil,
+          .multisample  = multisample_state,
+        });
+      ASSERT(*bloom_pipelines[i].pipeline);
 
       // Partial cleanup
       WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
@@ -960,7 +1077,7 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
-    prepare_offscreen(context->wgpu_context);
+    prepare_bloom_chain(context->wgpu_context);
     prepare_uniform_buffers(context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
@@ -992,86 +1109,20 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
   /*
-   * The blur method used in this example is multi pass and renders the vertical
-   * blur first and then the horizontal one.
-   * While it's possible to blur in one pass, this method is widely used as it
-   * requires far less samples to generate the blur.
+   * The bloom is built from a chain of progressively smaller targets instead
+   * of one wide blur: every level is a 13-tap downsample of the previous one,
+   * then the levels are upsampled again with a tent filter and added to the
+   * next larger one, so each pass only reads a few texels around its pixel.
    */
 
   if (bloom) {
-    /*
-     * First render pass: Render glow parts of the model (separate mesh) to an
-     * offscreen frame buffer.
-     */
-
-    // Create render pass encoder for encoding drawing commands
-    wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-      wgpu_context->cmd_enc,
-      &offscreen_pass.frame_buffers[0].render_pass_desc.render_pass_descriptor);
-
-    // Set viewport
-    wgpuRenderPassEncoderSetViewport(wgpu_context->rpass_enc, 0.0f, 0.0f,
-                                     (float)offscreen_pass.width,
-                                     (float)offscreen_pass.height, 0.0f, 1.0f);
-
-    // Set scissor rectangle
-    wgpuRenderPassEncoderSetScissorRect(wgpu_context->rpass_enc, 0u, 0u,
-                                        offscreen_pass.width,
-                                        offscreen_pass.height);
-
-    // 3D Scene
-    wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
-                                     pipelines.glow_pass);
-    wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                      bind_groups.scene, 0, 0);
-    wgpu_gltf_model_draw(models.ufo_glow,
-                         (wgpu_gltf_model_render_options_t){0});
-
-    // End render pass
-    wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
-    WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
-
-    /*
-     * Second render pass: Vertical blur.
-     *
-     * Render contents of the first pass into a second framebuffer and apply a
-     * vertical blur.
-     * This is the first blur pass, the horizontal blur is applied
-     * when rendering on top of the scene.
-     */
-
-    // Create render pass encoder for encoding drawing commands
-    wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-      wgpu_context->cmd_enc,
-      &offscreen_pass.frame_buffers[1].render_pass_desc.render_pass_descriptor);
-
-    // Set viewport
-    wgpuRenderPassEncoderSetViewport(wgpu_context->rpass_enc, 0.0f, 0.0f,
-                                     (float)offscreen_pass.width,
-                                     (float)offscreen_pass.height, 0.0f, 1.0f);
-
-    // Set scissor rectangle
-    wgpuRenderPassEncoderSetScissorRect(wgpu_context->rpass_enc, 0u, 0u,
-                                        offscreen_pass.width,
-                                        offscreen_pass.height);
-
-    // Render
-    wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
-                                     pipelines.blur_vert);
-    wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                      bind_groups.blur_vert, 0, 0);
-    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
-
-    // End render pass
-    wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
-    WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+    wgpu_frame_graph_execute(bloom_chain.graph, wgpu_context->cmd_enc);
   }
 
   /*
-   * Third render pass: Scene rendering with applied vertical blur
+   * Scene rendering with the bloom applied atop
    *
-   * Renders the scene and the (vertically blurred) contents of the second
-   * framebuffer and apply a horizontal blur.
+   * Renders the scene and adds the upsampled first level of the bloom chain.
    */
   {
     // Set target frame buffer
@@ -1104,12 +1155,12 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                       bind_groups.scene, 0, 0);
     wgpu_gltf_model_draw(models.ufo, (wgpu_gltf_model_render_options_t){0});
 
-    // Fullscreen triangle (clipped to a quad) with horizontal blur
+    // Fullscreen triangle (clipped to a quad) with the bloom
     if (bloom) {
       wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
-                                       pipelines.blur_horz);
+                                       pipelines.bloom_composite);
       wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                        bind_groups.blur_horz, 0, 0);
+                                        bloom_chain.bind_groups[0], 0, 0);
       wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
     }
 
@@ -1154,6 +1205,13 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  // The chain follows the scale the dynamic resolution chose for this frame
+  const float uv_scale
+    = wgpu_dynamic_resolution_get_scale(bloom_chain.dynamic_resolution);
+  if (uv_scale != ubos.blur_params.uv_scale) {
+    ubos.blur_params.uv_scale = uv_scale;
+    update_uniform_buffers_blur(context);
+  }
   int result = example_draw(context);
   if (!context->paused || context->camera->updated) {
     update_uniform_buffers_scene(context);
@@ -1161,6 +1219,19 @@ static int example_render(wgpu_example_context_t* context)
   return result;
 }
 
+// The levels of the bloom chain follow the surface size
+static void example_on_view_changed(wgpu_example_context_t* context)
+{
+  if (!context->window_resized) {
+    return;
+  }
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  if (wgpu_frame_graph_compile(bloom_chain.graph, wgpu_context->surface.width,
+                               wgpu_context->surface.height)) {
+    setup_bloom_bind_groups(wgpu_context);
+  }
+}
+
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
@@ -1171,26 +1242,20 @@ static void example_destroy(wgpu_example_context_t* context)
   wgpu_gltf_model_destroy(models.ufo_glow);
   wgpu_gltf_model_destroy(models.skybox);
 
-  for (uint32_t i = 0; i < 2; ++i) {
-    WGPU_RELEASE_RESOURCE(Texture,
-                          offscreen_pass.frame_buffers[i].color.texture)
-    WGPU_RELEASE_RESOURCE(Texture,
-                          offscreen_pass.frame_buffers[i].depth.texture)
-
-    WGPU_RELEASE_RESOURCE(TextureView,
-                          offscreen_pass.frame_buffers[i].color.texture_view)
-    WGPU_RELEASE_RESOURCE(TextureView,
-                          offscreen_pass.frame_buffers[i].depth.texture_view)
+  for (uint32_t i = 0; i < BLOOM_MIP_COUNT; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, bloom_chain.bind_groups[i])
   }
-
-  WGPU_RELEASE_RESOURCE(Sampler, offscreen_pass.sampler)
+  wgpu_frame_graph_release(bloom_chain.graph);
+  bloom_chain.graph = NULL;
+  WGPU_RELEASE_RESOURCE(Sampler, bloom_chain.sampler)
 
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.scene.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.skybox.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.blur_params.buffer)
 
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.blur_vert)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.blur_horz)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom_downsample)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom_upsample)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom_composite)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.glow_pass)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.phong_pass)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.skybox)
@@ -1199,8 +1264,6 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.scene)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.skybox)
 
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.blur_vert)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.blur_horz)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.scene)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.skybox)
 
@@ -1217,9 +1280,10 @@ void example_bloom(int argc, char* argv[])
       .title   = example_title,
       .overlay = true,
     },
-    .example_initialize_func = &example_initialize,
-    .example_render_func     = &example_render,
-    .example_destroy_func    = &example_destroy,
+    .example_initialize_func      = &example_initialize,
+    .example_render_func          = &example_render,
+    .example_destroy_func         = &example_destroy,
+    .example_on_view_changed_func = &example_on_view_changed,
   });
   // clang-format on
 }
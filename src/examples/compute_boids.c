@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/spatial_hash.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Compute Boids
@@ -16,17 +17,46 @@
  * A compute shader updates two ping-pong buffers which store particle data. The
  * data is used to draw instanced particles.
  *
+ * The neighbours of a boid are looked up in a spatial hash grid rebuilt every
+ * step, with a cell size of the largest rule distance a boid only visits the
+ * particles of the 3x3 cells around it. The particle count is picked in the
+ * settings or with --particles=<n>.
+ *
+ * The steps the frame scheduler assigns to a frame (see --sim-rate=<Hz>) are
+ * recorded into one compute pass, a render-only frame draws the last state.
+ *
+ * With --packed a particle takes 8 bytes instead of 16, the position within
+ * the [-1, 1] bounds as 16-bit snorm and the velocity as half floats. The
+ * update kernel unpacks and packs them, the vertex fetch converts them, which
+ * halves the bandwidth of a step.
+ *
  * Ref:
  * https://github.com/austinEng/webgpu-samples/tree/main/src/sample/computeBoids
  * https://github.com/gfx-rs/wgpu-rs/tree/master/examples/boids
  * -------------------------------------------------------------------------- */
 
 // Number of boid particles to simulate
-static const uint32_t NUM_PARTICLES = 1500;
+#define DEFAULT_NUM_PARTICLES 1500u
+#define MAX_NUM_PARTICLES 1048576u
 
 // Number of single-particle calculations (invocations) in each gpu work group
 static const uint32_t PARTICLES_PER_GROUP = 64;
 
+// Simulation resources are recreated when the particle count is changed
+static struct {
+  uint32_t num_particles;
+  bool changed;
+  bool packed; // Quantized particle layout
+} simulation = {
+  .num_particles = DEFAULT_NUM_PARTICLES,
+  .changed       = false,
+  .packed        = false,
+};
+
+static const char* num_particles_names[6] = {
+  "1500", "4096", "16384", "65536", "262144", "1048576",
+};
+
 // Sim parameters
 static struct sim_params_t {
   float delta_t;        // deltaT
@@ -75,6 +105,9 @@ static WGPUBuffer sim_param_buffer; /* Simulation Parameter Buffer */
 static WGPUBuffer particle_buffers[2];
 static WGPUBuffer sprite_vertex_buffer;
 
+// Neighbour search
+static wgpu_spatial_hash_t* spatial_hash;
+
 // The pipeline layouts
 static WGPUPipelineLayout compute_pipeline_layout;
 static WGPUPipelineLayout render_pipeline_layout;
@@ -98,6 +131,165 @@ static const char* example_title = "Compute Boids";
 static bool prepared             = false;
 static uint32_t work_group_count;
 
+// clang-format off
+static const char* particle_layout_wgsl = CODE(
+  struct Particle {
+    pos : vec2<f32>,
+    vel : vec2<f32>,
+  };
+
+  @group(0) @binding(1) var<storage, read> particlesA : array<Particle>;
+  @group(0) @binding(2) var<storage, read_write> particlesB : array<Particle>;
+
+  fn loadParticle(index : u32) -> Particle {
+    return particlesA[index];
+  }
+
+  fn storeParticle(index : u32, particle : Particle) {
+    particlesB[index] = particle;
+  }
+);
+
+// Position within the [-1, 1] bounds as 16-bit snorm, velocity as half floats
+static const char* packed_particle_layout_wgsl = CODE(
+  struct Particle {
+    pos : vec2<f32>,
+    vel : vec2<f32>,
+  };
+
+  struct PackedParticle {
+    pos : u32,
+    vel : u32,
+  };
+
+  @group(0) @binding(1) var<storage, read> particlesA : array<PackedParticle>;
+  @group(0) @binding(2)
+  var<storage, read_write> particlesB : array<PackedParticle>;
+
+  fn loadParticle(index : u32) -> Particle {
+    let particle = particlesA[index];
+    return Particle(unpack2x16snorm(particle.pos),
+                    unpack2x16float(particle.vel));
+  }
+
+  fn storeParticle(index : u32, particle : Particle) {
+    particlesB[index] = PackedParticle(pack2x16snorm(particle.pos),
+                                       pack2x16float(particle.vel));
+  }
+);
+
+static const char* update_sprites_shader_wgsl = CODE(
+  struct SimParams {
+    deltaT : f32,
+    rule1Distance : f32,
+    rule2Distance : f32,
+    rule3Distance : f32,
+    rule1Scale : f32,
+    rule2Scale : f32,
+    rule3Scale : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : SimParams;
+
+  @group(1) @binding(0)
+  var<uniform> spatialHashParams : SpatialHashParams;
+  @group(1) @binding(1)
+  var<storage, read> spatialHashCellOffsets : array<u32>;
+  @group(1) @binding(2)
+  var<storage, read> spatialHashCellCounts : array<u32>;
+  @group(1) @binding(3) var<storage, read> spatialHashIndices : array<u32>;
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) GlobalInvocationID : vec3<u32>) {
+    let index = GlobalInvocationID.x;
+    if (index >= arrayLength(&particlesA)) {
+      return;
+    }
+
+    let particle = loadParticle(index);
+    var vPos = particle.pos;
+    var vVel = particle.vel;
+    var cMass = vec2<f32>(0.0);
+    var cVel = vec2<f32>(0.0);
+    var colVel = vec2<f32>(0.0);
+    var cMassCount = 0u;
+    var cVelCount = 0u;
+
+    // Cells of different coordinates can share a bucket, every bucket of the
+    // 3x3 neighbourhood is visited once
+    let cell = spatialHashGetCell(vec3<f32>(vPos, 0.0));
+    var keys : array<u32, 9>;
+    var keyCount = 0u;
+    for (var y = -1; y <= 1; y = y + 1) {
+      for (var x = -1; x <= 1; x = x + 1) {
+        let key = spatialHashGetKey(cell + vec3<i32>(x, y, 0));
+        var visited = false;
+        for (var k = 0u; k < keyCount; k = k + 1u) {
+          visited = visited || keys[k] == key;
+        }
+        if (visited) {
+          continue;
+        }
+        keys[keyCount] = key;
+        keyCount = keyCount + 1u;
+
+        let first = spatialHashCellOffsets[key];
+        let last = first + spatialHashCellCounts[key];
+        for (var j = first; j < last; j = j + 1u) {
+          let i = spatialHashIndices[j];
+          if (i == index) {
+            continue;
+          }
+          let neighbour = loadParticle(i);
+          let pos = neighbour.pos;
+          let vel = neighbour.vel;
+          let d = distance(pos, vPos);
+          if (d < params.rule1Distance) {
+            cMass = cMass + pos;
+            cMassCount = cMassCount + 1u;
+          }
+          if (d < params.rule2Distance) {
+            colVel = colVel - (pos - vPos);
+          }
+          if (d < params.rule3Distance) {
+            cVel = cVel + vel;
+            cVelCount = cVelCount + 1u;
+          }
+        }
+      }
+    }
+    if (cMassCount > 0u) {
+      cMass = (cMass / vec2<f32>(f32(cMassCount))) - vPos;
+    }
+    if (cVelCount > 0u) {
+      cVel = cVel / vec2<f32>(f32(cVelCount));
+    }
+    vVel = vVel + (cMass * params.rule1Scale) + (colVel * params.rule2Scale)
+           + (cVel * params.rule3Scale);
+
+    // clamp velocity for a more pleasing simulation
+    vVel = normalize(vVel) * clamp(length(vVel), 0.0, 0.1);
+    // kinematic update
+    vPos = vPos + (vVel * params.deltaT);
+    // Wrap around boundary
+    if (vPos.x < -1.0) {
+      vPos.x = 1.0;
+    }
+    if (vPos.x > 1.0) {
+      vPos.x = -1.0;
+    }
+    if (vPos.y < -1.0) {
+      vPos.y = 1.0;
+    }
+    if (vPos.y > 1.0) {
+      vPos.y = -1.0;
+    }
+    // Write back
+    storeParticle(index, Particle(vPos, vVel));
+  }
+);
+// clang-format on
+
 // Prepare vertex buffers
 static void prepare_vertices(wgpu_context_t* wgpu_context)
 {
@@ -113,54 +305,50 @@ static void prepare_vertices(wgpu_context_t* wgpu_context)
                                    vertex_buffer_size, WGPUBufferUsage_Vertex);
 }
 
-static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
+// Size in bytes of a particle in the storage buffers
+static uint32_t get_particle_size(void)
 {
-  /* Compute pipeline layout */
-  WGPUBindGroupLayoutEntry bgl_entries[3] = {
-    [0] = (WGPUBindGroupLayoutEntry) {
-      .binding    = 0,
-      .visibility = WGPUShaderStage_Compute,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_Uniform,
-        .minBindingSize = sizeof(sim_param_data),
-      },
-      .sampler = {0},
-    },
-    [1] = (WGPUBindGroupLayoutEntry) {
-      .binding    = 1,
-      .visibility = WGPUShaderStage_Compute,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_ReadOnlyStorage,
-        .minBindingSize = NUM_PARTICLES * 16,
-      },
-      .sampler = {0},
-    },
-    [2] = (WGPUBindGroupLayoutEntry) {
-      .binding    = 2,
-      .visibility = WGPUShaderStage_Compute,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_Storage,
-        .minBindingSize = NUM_PARTICLES * 16,
-      },
-      .sampler = {0},
-    },
-  };
-  WGPUBindGroupLayoutDescriptor bgl_desc = {
-    .entryCount = 3,
-    .entries    = bgl_entries,
-  };
-  compute_bind_group_layout
-    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
+  return simulation.packed ? 2 * sizeof(uint32_t) : 4 * sizeof(float);
+}
+
+// The neighbour queries of the compute shader use the hash functions, the
+// particles are accessed through the functions of their layout
+static char* get_compute_shader_wgsl(void)
+{
+  const char* hash_functions = wgpu_spatial_hash_get_wgsl_functions();
+  const char* particle_layout
+    = simulation.packed ? packed_particle_layout_wgsl : particle_layout_wgsl;
+  const size_t wgsl_size = strlen(hash_functions) + strlen(particle_layout)
+                           + strlen(update_sprites_shader_wgsl) + 3;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s\n%s", hash_functions, particle_layout,
+           update_sprites_shader_wgsl);
+  return wgsl;
+}
+
+static void setup_compute_pipeline_layout(wgpu_context_t* wgpu_context)
+{
+  // The particle bindings and their sizes are reflected from the shader
+  char* wgsl = get_compute_shader_wgsl();
+  wgpu_shader_reflection_t reflection;
+  wgpu_shader_reflect_wgsl(wgsl, &reflection);
+  free(wgsl);
+  compute_bind_group_layout = wgpu_shader_reflection_get_bind_group_layout(
+    wgpu_context, &reflection, 0);
   ASSERT(compute_bind_group_layout != NULL)
 
-  WGPUPipelineLayoutDescriptor compute_pipeline_layout_desc = {
-    .bindGroupLayoutCount = 1,
-    .bindGroupLayouts     = &compute_bind_group_layout,
+  // Group 1 is the neighbour query bind group of the spatial hash
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    compute_bind_group_layout,                             /* Group 0 */
+    wgpu_spatial_hash_get_bind_group_layout(spatial_hash), /* Group 1 */
   };
-  compute_pipeline_layout = wgpuDeviceCreatePipelineLayout(
-    wgpu_context->device, &compute_pipeline_layout_desc);
+  compute_pipeline_layout = wgpu_get_pipeline_layout(
+    wgpu_context, bind_group_layouts, (uint32_t)ARRAY_SIZE(bind_group_layouts));
   ASSERT(compute_pipeline_layout != NULL)
+}
 
+static void setup_render_pipeline_layout(wgpu_context_t* wgpu_context)
+{
   /* Render pipeline layout (with empty bind group layout) */
   WGPUPipelineLayoutDescriptor render_pipeline_layout_desc = {0};
   render_pipeline_layout = wgpuDeviceCreatePipelineLayout(
@@ -192,31 +380,85 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
   };
 }
 
+static float get_spatial_hash_cell_size(void)
+{
+  return MAX(sim_param_data.rule1_distance,
+             MAX(sim_param_data.rule2_distance, sim_param_data.rule3_distance));
+}
+
+static void prepare_spatial_hash(wgpu_context_t* wgpu_context)
+{
+  spatial_hash = wgpu_spatial_hash_create(
+    wgpu_context, &(wgpu_spatial_hash_desc_t){
+                    .max_point_count  = simulation.num_particles,
+                    .point_stride     = get_particle_size(),
+                    .dimensions       = 2,
+                    .cell_size        = get_spatial_hash_cell_size(),
+                    .packed_positions = simulation.packed,
+                  });
+}
+
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
 {
   // Buffer for simulation parameters uniform
   sim_param_buffer = wgpu_create_buffer_from_data(
     context->wgpu_context, &sim_param_data, sizeof(sim_param_data),
     WGPUBufferUsage_Uniform);
+}
 
-  // Buffer for all particles data of type [(posx,posy,velx,vely),...]
-  float particle_data[NUM_PARTICLES * 4];
-  memset(particle_data, 0.f, sizeof(particle_data));
-  srand((unsigned int)time(NULL)); // randomize seed
-  for (uint32_t i = 0; i < NUM_PARTICLES; i += 4) {
-    const size_t chunk       = i * 4;
-    particle_data[chunk + 0] = 2 * (random_float() - 0.5f);        // posx
-    particle_data[chunk + 1] = 2 * (random_float() - 0.5f);        // posy
-    particle_data[chunk + 2] = 2 * (random_float() - 0.5f) * 0.1f; // velx
-    particle_data[chunk + 3] = 2 * (random_float() - 0.5f) * 0.1f; // vely
+// Writes the particles [begin, end), from a hashed sequence so that both
+// buffers get the same particles
+static void fill_particles(void* user_data, void* mapping, uint32_t begin,
+                           uint32_t end)
+{
+  const uint32_t seed = (uint32_t)(uintptr_t)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    const uint32_t chunk = i * 4;
+    float particle[4]    = {0};
+    for (uint32_t j = 0; j < 4; ++j) {
+      // (posx, posy) in [-1, 1), (velx, vely) in [-0.1, 0.1)
+      particle[j] = 2 * (random_float_hashed(seed, chunk + j) - 0.5f)
+                    * (j < 2 ? 1.0f : 0.1f);
+    }
+    if (simulation.packed) {
+      // Same layout as pack2x16snorm and pack2x16float
+      uint16_t* packed_data = (uint16_t*)mapping;
+      for (uint32_t j = 0; j < 2; ++j) {
+        packed_data[chunk + j]
+          = (uint16_t)(int16_t)roundf(clamp_float(particle[j], -1.0f, 1.0f)
+                                      * 32767.0f);
+        packed_data[chunk + 2 + j] = float_to_half(particle[2 + j]);
+      }
+    }
+    else {
+      memcpy((float*)mapping + chunk, particle, sizeof(particle));
+    }
   }
+}
 
-  // Creates two buffers of particle data each of size NUM_PARTICLES the two
-  // buffers alternate as dst and src for each frame
+static void prepare_particle_buffers(wgpu_context_t* wgpu_context)
+{
+  // Creates two buffers of particle data of type [(posx,posy,velx,vely),...],
+  // the two buffers alternate as dst and src for each frame. The particles are
+  // written straight into the mappings, in parallel.
+  const uint32_t particle_data_size
+    = simulation.num_particles * get_particle_size();
+  const uint32_t seed = (uint32_t)time(NULL); // randomize seed
   for (uint32_t i = 0; i < 2; ++i) {
-    particle_buffers[i] = wgpu_create_buffer_from_data(
-      context->wgpu_context, &particle_data, sizeof(particle_data),
-      WGPUBufferUsage_Vertex | WGPUBufferUsage_Storage);
+    wgpu_buffer_t particle_buffer = wgpu_create_buffer_with_fill(
+      wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .label = "boids_particle_buffer",
+        .usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_Storage,
+        .size  = particle_data_size,
+        .count = simulation.num_particles,
+      },
+      &(wgpu_buffer_fill_desc_t){
+        .func      = fill_particles,
+        .user_data = (void*)(uintptr_t)seed,
+        .parallel  = true,
+      });
+    particle_buffers[i] = particle_buffer.buffer;
   }
 
   // Create two bind groups, one for each buffer as the src where the alternate
@@ -233,13 +475,13 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
         .binding = 1,
         .buffer  = particle_buffers[i],
         .offset  = 0,
-        .size    = sizeof(particle_data),
+        .size    = particle_data_size,
       },
       [2] = (WGPUBindGroupEntry) {
         .binding = 2,
         .buffer  = particle_buffers[(i + 1) % 2],
         .offset  = 0,
-        .size    = sizeof(particle_data), // bind to opposite buffer
+        .size    = particle_data_size, // bind to opposite buffer
       },
     };
     WGPUBindGroupDescriptor bg_desc = {
@@ -248,21 +490,73 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
       .entries    = bg_entries,
     };
     particle_bind_groups[i]
-      = wgpuDeviceCreateBindGroup(context->wgpu_context->device, &bg_desc);
+      = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
   }
 
   // Calculates number of work groups from PARTICLES_PER_GROUP constant
-  work_group_count
-    = (uint32_t)ceilf((float)NUM_PARTICLES / (float)PARTICLES_PER_GROUP);
+  work_group_count = (simulation.num_particles + PARTICLES_PER_GROUP - 1)
+                     / PARTICLES_PER_GROUP;
 }
 
 static void update_sim_params(wgpu_context_t* wgpu_context)
 {
   wgpu_queue_write_buffer(wgpu_context, sim_param_buffer, 0, &sim_param_data,
                           sizeof(sim_param_data));
+  wgpu_spatial_hash_set_cell_size(spatial_hash, get_spatial_hash_cell_size());
 }
 
-// Create the compute & graphics pipelines
+// Create the compute pipeline
+static void prepare_compute_pipeline(wgpu_context_t* wgpu_context)
+{
+  char* wgsl = get_compute_shader_wgsl();
+
+  // Compute shader
+  wgpu_shader_t boids_comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "boids_update_sprites_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+
+  // Compute pipeline
+  compute_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "boids_compute_pipeline",
+      .layout  = compute_pipeline_layout,
+      .compute = boids_comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(compute_pipeline != NULL);
+
+  // Partial cleanup
+  wgpu_shader_release(&boids_comp_shader);
+  free(wgsl);
+}
+
+// Simulation resources depending on the particle count
+static void prepare_simulation(wgpu_context_t* wgpu_context)
+{
+  prepare_spatial_hash(wgpu_context);
+  setup_compute_pipeline_layout(wgpu_context);
+  prepare_particle_buffers(wgpu_context);
+  prepare_compute_pipeline(wgpu_context);
+}
+
+static void release_simulation(void)
+{
+  WGPU_RELEASE_RESOURCE(ComputePipeline, compute_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, particle_bind_groups[0])
+  WGPU_RELEASE_RESOURCE(BindGroup, particle_bind_groups[1])
+  WGPU_RELEASE_RESOURCE(Buffer, particle_buffers[0])
+  WGPU_RELEASE_RESOURCE(Buffer, particle_buffers[1])
+  WGPU_RELEASE_RESOURCE(PipelineLayout, compute_pipeline_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, compute_bind_group_layout)
+  wgpu_spatial_hash_release(spatial_hash);
+  spatial_hash = NULL;
+}
+
+// Create the graphics pipeline
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
 {
   // Primitive state
@@ -280,19 +574,21 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     .writeMask = WGPUColorWriteMask_All,
   };
 
-  // Vertex state
+  // Vertex state, the vertex fetch unpacks the packed particles
   WGPUVertexAttribute vert_buff_attrs_0[2] = {
     [0] = (WGPUVertexAttribute) {
       // Attribute location 0: instance position
       .shaderLocation = 0,
       .offset         = 0,
-      .format         = WGPUVertexFormat_Float32x2,
+      .format         = simulation.packed ? WGPUVertexFormat_Snorm16x2 :
+                                            WGPUVertexFormat_Float32x2,
     },
     [1] = (WGPUVertexAttribute) {
       // Attribute location 1: instance velocity
       .shaderLocation = 1,
-      .offset         = 2 * 4,
-      .format         = WGPUVertexFormat_Float32x2,
+      .offset         = get_particle_size() / 2,
+      .format         = simulation.packed ? WGPUVertexFormat_Float16x2 :
+                                            WGPUVertexFormat_Float32x2,
     },
   };
   WGPUVertexAttribute vert_buff_attrs_1 = {
@@ -304,7 +600,7 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUVertexBufferLayout vert_buf[2] = {
     [0] = (WGPUVertexBufferLayout) {
       // instanced particles buffer
-      .arrayStride    = 4 * 4,
+      .arrayStride    = get_particle_size(),
       .stepMode       = WGPUVertexStepMode_Instance,
       .attributeCount = (uint32_t)ARRAY_SIZE(vert_buff_attrs_0),
       .attributes     = vert_buff_attrs_0,
@@ -318,14 +614,6 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     },
   };
 
-  // Compute shader
-  wgpu_shader_t boids_comp_shader = wgpu_shader_create(
-    wgpu_context, &(wgpu_shader_desc_t){
-                    // Compute shader WGSL
-                    .file  = "shaders/compute_boids/updateSprites.wgsl",
-                    .entry = "main",
-                  });
-
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
             wgpu_context, &(wgpu_vertex_state_t){
@@ -357,14 +645,6 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
         .sample_count = 1,
       });
 
-  // Compute pipeline
-  compute_pipeline = wgpuDeviceCreateComputePipeline(
-    wgpu_context->device,
-    &(WGPUComputePipelineDescriptor){
-      .layout  = compute_pipeline_layout,
-      .compute = boids_comp_shader.programmable_stage_descriptor,
-    });
-
   // Create rendering pipeline using the specified states
   render_pipeline = wgpuDeviceCreateRenderPipeline(
     wgpu_context->device, &(WGPURenderPipelineDescriptor){
@@ -379,15 +659,15 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   // Partial cleanup
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
-  wgpu_shader_release(&boids_comp_shader);
 }
 
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
     prepare_vertices(context->wgpu_context);
-    setup_pipeline_layout(context->wgpu_context);
     prepare_uniform_buffers(context);
+    prepare_simulation(context->wgpu_context);
+    setup_render_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
@@ -397,9 +677,28 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static int32_t get_num_particles_index(uint32_t num_particles)
+{
+  for (uint32_t i = 0; i < ARRAY_SIZE(num_particles_names); ++i) {
+    if ((uint32_t)atoi(num_particles_names[i]) == num_particles) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
+    int32_t num_particles_index
+      = get_num_particles_index(simulation.num_particles);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Particles",
+                                &num_particles_index, num_particles_names,
+                                ARRAY_SIZE(num_particles_names))) {
+      simulation.num_particles
+        = atoi(num_particles_names[num_particles_index]);
+      simulation.changed = true;
+    }
     for (uint8_t i = 0; i < sim_params_count; ++i) {
       if (imgui_overlay_input_float(
             context->imgui_overlay, sim_params_mappings[i].label,
@@ -419,17 +718,27 @@ static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  // Compute pass
-  {
+  // Compute pass, the state after n steps is in particle_buffers[n % 2]
+  const uint64_t step_index = context->simulation.step_index;
+  const uint32_t step_count = context->simulation.step_count;
+  if (step_count > 0) {
     wgpu_context->cpass_enc
       = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
-                                      compute_pipeline);
-    wgpuComputePassEncoderSetBindGroup(
-      wgpu_context->cpass_enc, 0,
-      particle_bind_groups[context->frame.index % 2], 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(wgpu_context->cpass_enc,
-                                             work_group_count, 1, 1);
+    for (uint32_t step = 0; step < step_count; ++step) {
+      const uint32_t src = (uint32_t)((step_index + step) % 2);
+      // Sort the src particles into the hash grid
+      wgpu_spatial_hash_build(spatial_hash, wgpu_context->cpass_enc,
+                              particle_buffers[src], simulation.num_particles);
+      wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
+                                        compute_pipeline);
+      wgpuComputePassEncoderSetBindGroup(
+        wgpu_context->cpass_enc, 0, particle_bind_groups[src], 0, NULL);
+      wgpuComputePassEncoderSetBindGroup(
+        wgpu_context->cpass_enc, 1,
+        wgpu_spatial_hash_get_bind_group(spatial_hash), 0, NULL);
+      wgpuComputePassEncoderDispatchWorkgroups(wgpu_context->cpass_enc,
+                                               work_group_count, 1, 1);
+    }
     wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
     WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
   }
@@ -439,14 +748,15 @@ static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
     wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
       wgpu_context->cmd_enc, &render_pass.descriptor);
     wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, render_pipeline);
-    // render dst particles
+    // render dst particles of the last step
     wgpuRenderPassEncoderSetVertexBuffer(
       wgpu_context->rpass_enc, 0,
-      particle_buffers[(context->frame.index + 1) % 2], 0, WGPU_WHOLE_SIZE);
+      particle_buffers[(step_index + step_count) % 2], 0, WGPU_WHOLE_SIZE);
     // the three instance-local vertices
     wgpuRenderPassEncoderSetVertexBuffer(
       wgpu_context->rpass_enc, 1, sprite_vertex_buffer, 0, WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, NUM_PARTICLES, 0, 0);
+    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3,
+                              simulation.num_particles, 0, 0);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
   }
@@ -487,6 +797,11 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  if (simulation.changed) {
+    release_simulation();
+    prepare_simulation(context->wgpu_context);
+    simulation.changed = false;
+  }
   return example_draw(context);
 }
 
@@ -494,21 +809,34 @@ static int example_render(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, compute_bind_group_layout)
+  release_simulation();
   WGPU_RELEASE_RESOURCE(PipelineLayout, render_pipeline_layout)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, compute_pipeline_layout)
-  WGPU_RELEASE_RESOURCE(BindGroup, particle_bind_groups[0])
-  WGPU_RELEASE_RESOURCE(BindGroup, particle_bind_groups[1])
   WGPU_RELEASE_RESOURCE(Buffer, sim_param_buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, particle_buffers[0])
-  WGPU_RELEASE_RESOURCE(Buffer, particle_buffers[1])
   WGPU_RELEASE_RESOURCE(Buffer, sprite_vertex_buffer)
   WGPU_RELEASE_RESOURCE(RenderPipeline, render_pipeline)
-  WGPU_RELEASE_RESOURCE(ComputePipeline, compute_pipeline)
+}
+
+static void parse_simulation_arguments(int argc, char* argv[])
+{
+  static const char particles_option[] = "--particles=";
+  static const char packed_option[]    = "--packed";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], particles_option, strlen(particles_option)) == 0) {
+      const uint32_t num_particles
+        = (uint32_t)strtoul(argv[i] + strlen(particles_option), NULL, 10);
+      simulation.num_particles
+        = CLAMP(num_particles, 1u, MAX_NUM_PARTICLES);
+    }
+    else if (strcmp(argv[i], packed_option) == 0) {
+      simulation.packed = true;
+    }
+  }
 }
 
 void example_compute_boids(int argc, char* argv[])
 {
+  parse_simulation_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
@@ -3,6 +3,7 @@
 
 #include <string.h>
 
+#include "../webgpu/gpu_sort.h"
 #include "../webgpu/texture.h"
 
 /* -------------------------------------------------------------------------- *
@@ -98,6 +99,7 @@ typedef struct {
   uint32_t point_lights_count;
   float output_scale;
   bool update_metaballs;
+  uint32_t volume_resolution_scale;
 } quality_option_t;
 
 /* -------------------------------------------------------------------------- *
@@ -109,25 +111,28 @@ typedef struct {
 
 static const quality_option_t QUALITIES[3] = {
   [QualitySettings_Low] = (quality_option_t) {
-    .bloom_toggle       = false,
-    .shadow_res         = 512,
-    .point_lights_count = 32,
-    .output_scale       = 1.0f,
-    .update_metaballs   = false,
+    .bloom_toggle            = false,
+    .shadow_res              = 512,
+    .point_lights_count      = 32,
+    .output_scale            = 1.0f,
+    .update_metaballs        = false,
+    .volume_resolution_scale = 1,
   },
   [QualitySettings_Medium] = (quality_option_t) {
-    .bloom_toggle       = true,
-    .shadow_res         = 512,
-    .point_lights_count = 32,
-    .output_scale       = 0.8f,
-    .update_metaballs   = true,
+    .bloom_toggle            = true,
+    .shadow_res              = 512,
+    .point_lights_count      = 32,
+    .output_scale            = 0.8f,
+    .update_metaballs        = true,
+    .volume_resolution_scale = 1,
    },
   [QualitySettings_High] = (quality_option_t) {
-    .bloom_toggle       = true,
-    .shadow_res         = 512,
-    .point_lights_count = 128,
-    .output_scale       = 1.0f,
-    .update_metaballs   = true,
+    .bloom_toggle            = true,
+    .shadow_res              = 512,
+    .point_lights_count      = 128,
+    .output_scale            = 1.0f,
+    .update_metaballs        = true,
+    .volume_resolution_scale = 2,
   },
 };
 
@@ -1104,10 +1109,456 @@ static const int8_t MARCHING_CUBES_TRI_TABLE[] = {
 /* -------------------------------------------------------------------------- *
  * Metaballs Compute
  *
+ * The volume is split into bricks of 4x4x4 voxels and a broad phase flags the
+ * bricks some ball influences, the field is evaluated and the cells are
+ * classified only in the compacted list of those bricks, through indirect
+ * dispatches. The cells the surface crosses are compacted into a list. The
+ * triangle counts of the active cells are prefix-scanned into their output
+ * offsets and the active cells emit their triangles, compacted, along with the
+ * vertex count of an indirect draw. The geometry buffers are sized from the
+ * counts read back a frame later and grow when the surface outgrows them.
+ *
  * Ref:
  * https://github.com/gnikoloff/webgpu-compute-metaballs/blob/master/src/compute/metaballs.ts
  * -------------------------------------------------------------------------- */
 
+/* Bindings of the marching cubes shader, all in group 0 */
+typedef enum {
+  MarchingCubesBinding_Tables          = 0,
+  MarchingCubesBinding_Volume          = 1,
+  MarchingCubesBinding_Metaballs       = 2,
+  MarchingCubesBinding_Params          = 3,
+  MarchingCubesBinding_CellCases       = 4,
+  MarchingCubesBinding_CellFlags       = 5,
+  MarchingCubesBinding_ActiveCells     = 6,
+  MarchingCubesBinding_Counters        = 7,
+  MarchingCubesBinding_TriangleCounts  = 8,
+  MarchingCubesBinding_TriangleOffsets = 9,
+  MarchingCubesBinding_Positions       = 10,
+  MarchingCubesBinding_Normals         = 11,
+  MarchingCubesBinding_DispatchArgs    = 12,
+  MarchingCubesBinding_DrawArgs        = 13,
+  MarchingCubesBinding_BrickStates     = 14,
+  MarchingCubesBinding_BrickFlags      = 15,
+  MarchingCubesBinding_ActiveBricks    = 16,
+  MarchingCubesBinding_BrickCounter    = 17,
+  MarchingCubesBinding_BrickDispatch   = 18,
+  MarchingCubesBinding_Count           = 19,
+} marching_cubes_binding_enum;
+
+typedef enum {
+  MarchingCubesKernel_Bricks          = 0,
+  MarchingCubesKernel_PrepareBricks   = 1,
+  MarchingCubesKernel_Field           = 2,
+  MarchingCubesKernel_Classify        = 3,
+  MarchingCubesKernel_PrepareDispatch = 4,
+  MarchingCubesKernel_TriangleCount   = 5,
+  MarchingCubesKernel_Finalize        = 6,
+  MarchingCubesKernel_Emit            = 7,
+  MarchingCubesKernel_Count           = 8,
+} marching_cubes_kernel_enum;
+
+/* Voxels per side of a brick of the broad phase, one workgroup each */
+#define METABALLS_BRICK_SIZE 4u
+
+/* Every kernel has its own layout with only the bindings it uses, to stay
+ * within the storage buffer limit of a stage. This also keeps the indirect
+ * arguments out of the dispatches they drive. */
+static const struct {
+  const char* entry;
+  uint32_t binding_count;
+  uint32_t bindings[9];
+} MARCHING_CUBES_KERNELS[MarchingCubesKernel_Count] = {
+  [MarchingCubesKernel_Bricks] = {
+    .entry         = "cs_bricks",
+    .binding_count = 4,
+    .bindings      = {
+      MarchingCubesBinding_Volume, MarchingCubesBinding_Metaballs,
+      MarchingCubesBinding_BrickStates, MarchingCubesBinding_BrickFlags,
+    },
+  },
+  [MarchingCubesKernel_PrepareBricks] = {
+    .entry         = "cs_prepare_bricks",
+    .binding_count = 2,
+    .bindings      = {
+      MarchingCubesBinding_BrickCounter, MarchingCubesBinding_BrickDispatch,
+    },
+  },
+  [MarchingCubesKernel_Field] = {
+    .entry         = "cs_field",
+    .binding_count = 3,
+    .bindings      = {
+      MarchingCubesBinding_Volume, MarchingCubesBinding_Metaballs,
+      MarchingCubesBinding_ActiveBricks,
+    },
+  },
+  [MarchingCubesKernel_Classify] = {
+    .entry         = "cs_classify",
+    .binding_count = 5,
+    .bindings      = {
+      MarchingCubesBinding_Tables, MarchingCubesBinding_Volume,
+      MarchingCubesBinding_CellCases, MarchingCubesBinding_CellFlags,
+      MarchingCubesBinding_ActiveBricks,
+    },
+  },
+  [MarchingCubesKernel_PrepareDispatch] = {
+    .entry         = "cs_prepare_dispatch",
+    .binding_count = 3,
+    .bindings      = {
+      MarchingCubesBinding_Params, MarchingCubesBinding_Counters,
+      MarchingCubesBinding_DispatchArgs,
+    },
+  },
+  [MarchingCubesKernel_TriangleCount] = {
+    .entry         = "cs_count",
+    .binding_count = 6,
+    .bindings      = {
+      MarchingCubesBinding_Tables, MarchingCubesBinding_Params,
+      MarchingCubesBinding_CellCases, MarchingCubesBinding_ActiveCells,
+      MarchingCubesBinding_Counters, MarchingCubesBinding_TriangleCounts,
+    },
+  },
+  [MarchingCubesKernel_Finalize] = {
+    .entry         = "cs_finalize",
+    .binding_count = 5,
+    .bindings      = {
+      MarchingCubesBinding_Params, MarchingCubesBinding_Counters,
+      MarchingCubesBinding_TriangleCounts,
+      MarchingCubesBinding_TriangleOffsets, MarchingCubesBinding_DrawArgs,
+    },
+  },
+  [MarchingCubesKernel_Emit] = {
+    .entry         = "cs_emit",
+    .binding_count = 9,
+    .bindings      = {
+      MarchingCubesBinding_Tables, MarchingCubesBinding_Volume,
+      MarchingCubesBinding_Params, MarchingCubesBinding_CellCases,
+      MarchingCubesBinding_ActiveCells, MarchingCubesBinding_Counters,
+      MarchingCubesBinding_TriangleOffsets, MarchingCubesBinding_Positions,
+      MarchingCubesBinding_Normals,
+    },
+  },
+};
+
+// clang-format off
+static const char* marching_cubes_shader_wgsl = CODE(
+  struct Tables {
+    edges : array<u32, 256>,
+    tris : array<i32, 4096>,
+  };
+
+  struct Volume {
+    min : vec3<f32>,
+    padding0 : f32,
+    padding1 : vec4<f32>,
+    step : vec3<f32>,
+    padding2 : f32,
+    size : vec3<u32>,
+    threshold : f32,
+    values : array<f32>,
+  };
+
+  struct Metaball {
+    position : vec3<f32>,
+    radius : f32,
+    strength : f32,
+    subtract : f32,
+    padding : vec2<f32>,
+  };
+
+  struct Metaballs {
+    ballCount : u32,
+    balls : array<Metaball>,
+  };
+
+  struct Params {
+    activeCellCapacity : u32,
+    triangleCapacity : u32,
+  };
+
+  // The compaction writes activeCellCount, the finalization triangleCount
+  // before it is clamped to the capacity
+  struct Counters {
+    activeCellCount : u32,
+    triangleCount : u32,
+  };
+
+  struct DispatchArgs {
+    x : u32,
+    y : u32,
+    z : u32,
+  };
+
+  struct BrickCounter {
+    activeBrickCount : u32,
+  };
+
+  struct DrawArgs {
+    vertexCount : u32,
+    instanceCount : u32,
+    firstVertex : u32,
+    firstInstance : u32,
+  };
+
+  @group(0) @binding(0) var<storage, read> tables : Tables;
+  @group(0) @binding(1) var<storage, read_write> volume : Volume;
+  @group(0) @binding(2) var<storage, read> metaballs : Metaballs;
+  @group(0) @binding(3) var<uniform> params : Params;
+  @group(0) @binding(4) var<storage, read_write> cellCases : array<u32>;
+  @group(0) @binding(5) var<storage, read_write> cellFlags : array<u32>;
+  @group(0) @binding(6) var<storage, read> activeCells : array<u32>;
+  @group(0) @binding(7) var<storage, read_write> counters : Counters;
+  @group(0) @binding(8) var<storage, read_write> triangleCounts : array<u32>;
+  @group(0) @binding(9) var<storage, read> triangleOffsets : array<u32>;
+  @group(0) @binding(10) var<storage, read_write> positionsOut : array<f32>;
+  @group(0) @binding(11) var<storage, read_write> normalsOut : array<f32>;
+
+  @group(0) @binding(12) var<storage, read_write> dispatchArgs : DispatchArgs;
+  @group(0) @binding(13) var<storage, read_write> drawArgs : DrawArgs;
+  @group(0) @binding(14) var<storage, read_write> brickStates : array<u32>;
+  @group(0) @binding(15) var<storage, read_write> brickFlags : array<u32>;
+  @group(0) @binding(16) var<storage, read> activeBricks : array<u32>;
+  @group(0) @binding(17) var<storage, read_write> brickCounter : BrickCounter;
+  @group(0) @binding(18) var<storage, read_write> brickDispatchArgs
+    : DispatchArgs;
+
+  var<workgroup> brickBalls : array<u32, 256>;
+  var<workgroup> brickBallCount : atomic<u32>;
+
+  fn voxelIndex(p : vec3<u32>) -> u32 {
+    return p.x + p.y * volume.size.x + p.z * volume.size.x * volume.size.y;
+  }
+
+  fn cellSize() -> vec3<u32> {
+    return volume.size - vec3<u32>(1u);
+  }
+
+  fn cellCoord(cell : u32) -> vec3<u32> {
+    let size = cellSize();
+    return vec3<u32>(cell % size.x, (cell / size.x) % size.y,
+                     cell / (size.x * size.y));
+  }
+
+  fn activeCellCount() -> u32 {
+    return min(counters.activeCellCount, params.activeCellCapacity);
+  }
+
+  fn cornerOffset(corner : u32) -> vec3<u32> {
+    var offsets = array<vec3<u32>, 8>(
+      vec3<u32>(0u, 0u, 0u), vec3<u32>(1u, 0u, 0u),
+      vec3<u32>(1u, 1u, 0u), vec3<u32>(0u, 1u, 0u),
+      vec3<u32>(0u, 0u, 1u), vec3<u32>(1u, 0u, 1u),
+      vec3<u32>(1u, 1u, 1u), vec3<u32>(0u, 1u, 1u)
+    );
+    return offsets[corner];
+  }
+
+  fn edgeCorners(edge : u32) -> vec2<u32> {
+    var corners = array<vec2<u32>, 12>(
+      vec2<u32>(0u, 1u), vec2<u32>(1u, 2u), vec2<u32>(2u, 3u),
+      vec2<u32>(3u, 0u), vec2<u32>(4u, 5u), vec2<u32>(5u, 6u),
+      vec2<u32>(6u, 7u), vec2<u32>(7u, 4u), vec2<u32>(0u, 4u),
+      vec2<u32>(1u, 5u), vec2<u32>(2u, 6u), vec2<u32>(3u, 7u)
+    );
+    return corners[edge];
+  }
+
+  fn fieldValue(p : vec3<i32>) -> f32 {
+    let q = clamp(p, vec3<i32>(0), vec3<i32>(volume.size) - vec3<i32>(1));
+    return volume.values[voxelIndex(vec3<u32>(q))];
+  }
+
+  // The field falls off outwards
+  fn fieldNormal(p : vec3<u32>) -> vec3<f32> {
+    let q = vec3<i32>(p);
+    return vec3<f32>(
+      fieldValue(q - vec3<i32>(1, 0, 0)) - fieldValue(q + vec3<i32>(1, 0, 0)),
+      fieldValue(q - vec3<i32>(0, 1, 0)) - fieldValue(q + vec3<i32>(0, 1, 0)),
+      fieldValue(q - vec3<i32>(0, 0, 1)) - fieldValue(q + vec3<i32>(0, 0, 1)));
+  }
+
+  fn brickGridSize() -> vec3<u32> {
+    return (volume.size + vec3<u32>(3u)) / 4u;
+  }
+
+  fn brickCoord(brick : u32) -> vec3<u32> {
+    let size = brickGridSize();
+    return vec3<u32>(brick % size.x, (brick / size.x) % size.y,
+                     brick / (size.x * size.y));
+  }
+
+  // A ball adds to the field within its radius. The box of a brick includes
+  // the next voxel layer, the cells of the brick reach into it.
+  fn brickOverlapsBall(coord : vec3<u32>, ball : Metaball) -> bool {
+    let first = coord * 4u;
+    let last = min(first + vec3<u32>(4u), volume.size - vec3<u32>(1u));
+    let boxMin = volume.min + volume.step * vec3<f32>(first);
+    let boxMax = volume.min + volume.step * vec3<f32>(last);
+    let d = ball.position - clamp(ball.position, boxMin, boxMax);
+    return dot(d, d) < ball.radius * ball.radius;
+  }
+
+  fn surfaceFunc(position : vec3<f32>) -> f32 {
+    var result = 0.0;
+    let count = atomicLoad(&brickBallCount);
+    for (var i = 0u; i < count; i = i + 1u) {
+      let ball = metaballs.balls[brickBalls[i]];
+      let dist = distance(position, ball.position);
+      let value = ball.strength / (0.000001 + dist * dist) - ball.subtract;
+      if (value > 0.0) {
+        result = result + value;
+      }
+    }
+    return result;
+  }
+
+  // Bricks to evaluate: influenced now, or last frame so that their field is
+  // cleared
+  @compute @workgroup_size(4, 4, 4)
+  fn cs_bricks(@builtin(global_invocation_id) global_id : vec3<u32>) {
+    let size = brickGridSize();
+    if (any(global_id >= size)) {
+      return;
+    }
+    var overlap = false;
+    for (var i = 0u; i < metaballs.ballCount && !overlap; i = i + 1u) {
+      overlap = brickOverlapsBall(global_id, metaballs.balls[i]);
+    }
+    let brick = global_id.x + global_id.y * size.x
+                + global_id.z * size.x * size.y;
+    let state = select(0u, 1u, overlap);
+    brickFlags[brick] = state | brickStates[brick];
+    brickStates[brick] = state;
+  }
+
+  @compute @workgroup_size(1)
+  fn cs_prepare_bricks() {
+    brickDispatchArgs.x = brickCounter.activeBrickCount;
+    brickDispatchArgs.y = 1u;
+    brickDispatchArgs.z = 1u;
+  }
+
+  // One workgroup per active brick, the balls influencing the brick are
+  // gathered first
+  @compute @workgroup_size(4, 4, 4)
+  fn cs_field(@builtin(workgroup_id) workgroup_id : vec3<u32>,
+              @builtin(local_invocation_id) local_id : vec3<u32>,
+              @builtin(local_invocation_index) local_index : u32) {
+    let coord = brickCoord(activeBricks[workgroup_id.x]);
+    for (var i = local_index; i < metaballs.ballCount; i = i + 64u) {
+      if (brickOverlapsBall(coord, metaballs.balls[i])) {
+        brickBalls[atomicAdd(&brickBallCount, 1u)] = i;
+      }
+    }
+    workgroupBarrier();
+
+    let voxel = coord * 4u + local_id;
+    if (all(voxel < volume.size)) {
+      let position = volume.min + volume.step * vec3<f32>(voxel);
+      volume.values[voxelIndex(voxel)] = surfaceFunc(position);
+    }
+  }
+
+  // Case of a cell of an active brick, flagged when the surface crosses it.
+  // The cells of the other bricks were cleared with their field.
+  @compute @workgroup_size(4, 4, 4)
+  fn cs_classify(@builtin(workgroup_id) workgroup_id : vec3<u32>,
+                 @builtin(local_invocation_id) local_id : vec3<u32>) {
+    let global_id = brickCoord(activeBricks[workgroup_id.x]) * 4u + local_id;
+    let size = cellSize();
+    if (any(global_id >= size)) {
+      return;
+    }
+    var cubeIndex = 0u;
+    for (var i = 0u; i < 8u; i = i + 1u) {
+      if (volume.values[voxelIndex(global_id + cornerOffset(i))]
+          < volume.threshold) {
+        cubeIndex = cubeIndex | (1u << i);
+      }
+    }
+    let cell = global_id.x + global_id.y * size.x
+               + global_id.z * size.x * size.y;
+    cellCases[cell] = cubeIndex;
+    cellFlags[cell] = select(0u, 1u, tables.edges[cubeIndex] != 0u);
+  }
+
+  @compute @workgroup_size(1)
+  fn cs_prepare_dispatch() {
+    dispatchArgs.x = (activeCellCount() + 63u) / 64u;
+    dispatchArgs.y = 1u;
+    dispatchArgs.z = 1u;
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_count(@builtin(global_invocation_id) global_id : vec3<u32>) {
+    let i = global_id.x;
+    if (i >= activeCellCount()) {
+      return;
+    }
+    let cubeIndex = cellCases[activeCells[i]];
+    triangleCounts[i] = u32(tables.tris[cubeIndex * 16u]) / 3u;
+  }
+
+  @compute @workgroup_size(1)
+  fn cs_finalize() {
+    let count = activeCellCount();
+    var triangleCount = 0u;
+    if (count > 0u) {
+      triangleCount = triangleOffsets[count - 1u] + triangleCounts[count - 1u];
+    }
+    counters.triangleCount = triangleCount;
+    drawArgs.vertexCount = min(triangleCount, params.triangleCapacity) * 3u;
+    drawArgs.instanceCount = 1u;
+    drawArgs.firstVertex = 0u;
+    drawArgs.firstInstance = 0u;
+  }
+
+  fn emitVertex(vertex : u32, cell : vec3<u32>, edge : u32) {
+    let corners = edgeCorners(edge);
+    let p0 = cell + cornerOffset(corners.x);
+    let p1 = cell + cornerOffset(corners.y);
+    let v0 = volume.values[voxelIndex(p0)];
+    let v1 = volume.values[voxelIndex(p1)];
+    var t = 0.5;
+    if (abs(v1 - v0) > 0.00001) {
+      t = clamp((volume.threshold - v0) / (v1 - v0), 0.0, 1.0);
+    }
+    let position = volume.min
+                   + volume.step * mix(vec3<f32>(p0), vec3<f32>(p1), t);
+    let normal = normalize(mix(fieldNormal(p0), fieldNormal(p1), t));
+    positionsOut[vertex * 3u] = position.x;
+    positionsOut[vertex * 3u + 1u] = position.y;
+    positionsOut[vertex * 3u + 2u] = position.z;
+    normalsOut[vertex * 3u] = normal.x;
+    normalsOut[vertex * 3u + 1u] = normal.y;
+    normalsOut[vertex * 3u + 2u] = normal.z;
+  }
+
+  // Triangles of an active cell at its scanned offset
+  @compute @workgroup_size(64)
+  fn cs_emit(@builtin(global_invocation_id) global_id : vec3<u32>) {
+    let i = global_id.x;
+    if (i >= activeCellCount()) {
+      return;
+    }
+    let cell = activeCells[i];
+    let cubeIndex = cellCases[cell];
+    let coord = cellCoord(cell);
+    let triangleCount = u32(tables.tris[cubeIndex * 16u]) / 3u;
+    for (var t = 0u; t < triangleCount; t = t + 1u) {
+      let triangle = triangleOffsets[i] + t;
+      if (triangle >= params.triangleCapacity) {
+        return;
+      }
+      for (var j = 0u; j < 3u; j = j + 1u) {
+        let edge = u32(tables.tris[cubeIndex * 16u + 1u + t * 3u + j]);
+        emitVertex(triangle * 3u + j, coord, edge);
+      }
+    }
+  }
+);
+// clang-format on
+
 typedef struct {
   webgpu_renderer_t* renderer;
 
@@ -1119,22 +1570,51 @@ typedef struct {
   wgpu_buffer_t volume_buffer;
   wgpu_buffer_t indirect_render_buffer;
 
-  WGPUComputePipeline compute_metaballs_pipeline;
-  WGPUComputePipeline compute_marching_cubes_pipeline;
+  // Classification and compaction of the cells
+  uint32_t cell_count;
+  uint32_t active_cell_capacity;
+  uint32_t triangle_capacity;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t cell_indices_buffer;
+  wgpu_buffer_t cell_cases_buffer;
+  wgpu_buffer_t cell_flags_buffer;
+  wgpu_buffer_t active_cells_buffer;
+  wgpu_buffer_t counters_buffer;
+  wgpu_buffer_t triangle_counts_buffer;
+  wgpu_buffer_t triangle_offsets_buffer;
+  wgpu_buffer_t dispatch_buffer;
+  wgpu_gpu_sort_t* gpu_sort;
+
+  // Broad phase over the bricks of the volume
+  uint32_t brick_grid_size[3];
+  uint32_t brick_count;
+  wgpu_buffer_t brick_indices_buffer;
+  wgpu_buffer_t brick_states_buffer;
+  wgpu_buffer_t brick_flags_buffer;
+  wgpu_buffer_t active_bricks_buffer;
+  wgpu_buffer_t brick_counter_buffer;
+  wgpu_buffer_t brick_dispatch_buffer;
+
+  // Counters of the previous frame, for sizing the geometry buffers
+  struct {
+    wgpu_buffer_t buffer;
+    bool pending;
+    bool valid;
+    uint32_t active_cell_count;
+    uint32_t triangle_count;
+  } readback;
 
-  WGPUBindGroup compute_metaballs_bind_group;
-  WGPUBindGroup compute_marching_cubes_bind_group;
+  struct {
+    WGPUComputePipeline pipeline;
+    WGPUBindGroup bind_group;
+  } kernels[MarchingCubesKernel_Count];
 
-  uint32_t indirect_render_array[9];
   uint8_t* metaball_array;
   uint32_t* metaball_array_header;
   float* metaball_array_balls;
 
   wgpu_buffer_t vertex_buffer;
   wgpu_buffer_t normal_buffer;
-  wgpu_buffer_t index_buffer;
-
-  uint32_t index_count;
 
   float strength;
   float strength_target;
@@ -1146,119 +1626,138 @@ typedef struct {
 
 static bool metaballs_compute_is_ready(metaballs_compute_t* this)
 {
-  return (this->compute_metaballs_pipeline != NULL)
-         && (this->compute_marching_cubes_pipeline != NULL);
+  for (uint32_t i = 0; i < (uint32_t)MarchingCubesKernel_Count; ++i) {
+    if (this->kernels[i].pipeline == NULL) {
+      return false;
+    }
+  }
+  return true;
 }
 
-static void metaballs_compute_init(metaballs_compute_t* this)
+static wgpu_buffer_t*
+metaballs_compute_get_binding_buffer(metaballs_compute_t* this,
+                                     marching_cubes_binding_enum binding)
 {
-  {
-    /* Compute shader */
-    wgpu_shader_t comp_shader = wgpu_shader_create(
-      this->renderer->wgpu_context,
-      &(wgpu_shader_desc_t){
-        // Compute shader WGSL
-        .label = "metaballs isosurface compute shader",
-        .file  = "shaders/compute_metaballs/metaball_field_compute_source.wgsl",
-        .entry = "main",
-      });
+  wgpu_buffer_t* buffers[MarchingCubesBinding_Count] = {
+    [MarchingCubesBinding_Tables]          = &this->tables_buffer,
+    [MarchingCubesBinding_Volume]          = &this->volume_buffer,
+    [MarchingCubesBinding_Metaballs]       = &this->metaball_buffer,
+    [MarchingCubesBinding_Params]          = &this->params_buffer,
+    [MarchingCubesBinding_CellCases]       = &this->cell_cases_buffer,
+    [MarchingCubesBinding_CellFlags]       = &this->cell_flags_buffer,
+    [MarchingCubesBinding_ActiveCells]     = &this->active_cells_buffer,
+    [MarchingCubesBinding_Counters]        = &this->counters_buffer,
+    [MarchingCubesBinding_TriangleCounts]  = &this->triangle_counts_buffer,
+    [MarchingCubesBinding_TriangleOffsets] = &this->triangle_offsets_buffer,
+    [MarchingCubesBinding_Positions]       = &this->vertex_buffer,
+    [MarchingCubesBinding_Normals]         = &this->normal_buffer,
+    [MarchingCubesBinding_DispatchArgs]    = &this->dispatch_buffer,
+    [MarchingCubesBinding_DrawArgs]        = &this->indirect_render_buffer,
+    [MarchingCubesBinding_BrickStates]     = &this->brick_states_buffer,
+    [MarchingCubesBinding_BrickFlags]      = &this->brick_flags_buffer,
+    [MarchingCubesBinding_ActiveBricks]    = &this->active_bricks_buffer,
+    [MarchingCubesBinding_BrickCounter]    = &this->brick_counter_buffer,
+    [MarchingCubesBinding_BrickDispatch]   = &this->brick_dispatch_buffer,
+  };
+  return buffers[binding];
+}
 
-    /* Create pipeline */
-    this->compute_metaballs_pipeline = wgpuDeviceCreateComputePipeline(
+static void metaballs_compute_init(metaballs_compute_t* this)
+{
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    this->renderer->wgpu_context,
+    &(wgpu_shader_desc_t){
+      // Compute shader WGSL
+      .label            = "marching cubes compute shader",
+      .wgsl_code.source = marching_cubes_shader_wgsl,
+      .entry            = "cs_field",
+    });
+
+  // The layouts are derived from the bindings each entry point uses
+  for (uint32_t i = 0; i < (uint32_t)MarchingCubesKernel_Count; ++i) {
+    WGPUProgrammableStageDescriptor stage
+      = comp_shader.programmable_stage_descriptor;
+    stage.entryPoint = MARCHING_CUBES_KERNELS[i].entry;
+
+    this->kernels[i].pipeline = wgpuDeviceCreateComputePipeline(
       this->renderer->wgpu_context->device,
       &(WGPUComputePipelineDescriptor){
-        .compute = comp_shader.programmable_stage_descriptor,
+        .label   = MARCHING_CUBES_KERNELS[i].entry,
+        .compute = stage,
       });
-
-    /* Partial clean-up */
-    wgpu_shader_release(&comp_shader);
+    ASSERT(this->kernels[i].pipeline != NULL);
   }
 
-  {
-    WGPUBindGroupEntry bg_entries[2] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding = 0,
-        .buffer  = this->metaball_buffer.buffer,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding = 1,
-        .buffer  = this->volume_buffer.buffer,
-      },
-    };
-
-    WGPUBindGroupDescriptor bg_desc = {
-      .layout = wgpuComputePipelineGetBindGroupLayout(
-        this->compute_marching_cubes_pipeline, 0),
-      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-      .entries    = bg_entries,
-    };
-
-    this->compute_metaballs_bind_group = wgpuDeviceCreateBindGroup(
-      this->renderer->wgpu_context->device, &bg_desc);
-    ASSERT(this->compute_metaballs_bind_group != NULL);
-  }
+  /* Partial clean-up */
+  wgpu_shader_release(&comp_shader);
+}
 
-  {
-    /* Compute shader */
-    wgpu_shader_t comp_shader = wgpu_shader_create(
-      this->renderer->wgpu_context,
-      &(wgpu_shader_desc_t){
-        // Compute shader WGSL
-        .label = "marching cubes computer shader",
-        .file  = "shaders/compute_metaballs/marching_cubes_compute_source.wgsl",
-        .entry = "main",
-      });
+// Bind groups of the kernels, recreated when the geometry buffers grow
+static void metaballs_compute_setup_bind_groups(metaballs_compute_t* this)
+{
+  for (uint32_t i = 0; i < (uint32_t)MarchingCubesKernel_Count; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, this->kernels[i].bind_group)
+
+    WGPUBindGroupEntry bg_entries[ARRAY_SIZE(
+      MARCHING_CUBES_KERNELS[0].bindings)]
+      = {0};
+    const uint32_t entry_count = MARCHING_CUBES_KERNELS[i].binding_count;
+    for (uint32_t j = 0; j < entry_count; ++j) {
+      const uint32_t binding = MARCHING_CUBES_KERNELS[i].bindings[j];
+      wgpu_buffer_t* buffer  = metaballs_compute_get_binding_buffer(
+        this, (marching_cubes_binding_enum)binding);
+      bg_entries[j] = (WGPUBindGroupEntry){
+        .binding = binding,
+        .buffer  = buffer->buffer,
+        .offset  = 0,
+        .size    = buffer->size,
+      };
+    }
 
-    /* Create pipeline */
-    this->compute_marching_cubes_pipeline = wgpuDeviceCreateComputePipeline(
+    WGPUBindGroupLayout bind_group_layout
+      = wgpuComputePipelineGetBindGroupLayout(this->kernels[i].pipeline, 0);
+    this->kernels[i].bind_group = wgpuDeviceCreateBindGroup(
       this->renderer->wgpu_context->device,
-      &(WGPUComputePipelineDescriptor){
-        .compute = comp_shader.programmable_stage_descriptor,
+      &(WGPUBindGroupDescriptor){
+        .label      = MARCHING_CUBES_KERNELS[i].entry,
+        .layout     = bind_group_layout,
+        .entryCount = entry_count,
+        .entries    = bg_entries,
       });
-
-    /* Partial clean-up */
-    wgpu_shader_release(&comp_shader);
+    ASSERT(this->kernels[i].bind_group != NULL);
+    WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
   }
+}
 
-  {
-    WGPUBindGroupEntry bg_entries[6] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding = 0,
-        .buffer  = this->tables_buffer.buffer,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding = 1,
-        .buffer  = this->volume_buffer.buffer,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        .binding = 2,
-        .buffer  = this->vertex_buffer.buffer,
-      },
-      [3] = (WGPUBindGroupEntry) {
-        .binding = 3,
-        .buffer  = this->normal_buffer.buffer,
-      },
-      [4] = (WGPUBindGroupEntry) {
-        .binding = 4,
-        .buffer  = this->index_buffer.buffer,
-      },
-      [5] = (WGPUBindGroupEntry) {
-        .binding = 5,
-        .buffer  = this->indirect_render_buffer.buffer,
-      },
-    };
+// Geometry buffers sized by the triangle capacity, the active cell capacity
+// only bounds the scanned range
+static void metaballs_compute_create_capacity_buffers(metaballs_compute_t* this)
+{
+  wgpu_context_t* wgpu_context = this->renderer->wgpu_context;
 
-    WGPUBindGroupDescriptor bg_desc = {
-      .layout = wgpuComputePipelineGetBindGroupLayout(
-        this->compute_marching_cubes_pipeline, 0),
-      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-      .entries    = bg_entries,
-    };
+  wgpu_destroy_buffer(&this->vertex_buffer);
+  wgpu_destroy_buffer(&this->normal_buffer);
 
-    this->compute_marching_cubes_bind_group = wgpuDeviceCreateBindGroup(
-      this->renderer->wgpu_context->device, &bg_desc);
-    ASSERT(this->compute_marching_cubes_bind_group != NULL);
-  }
+  // Three vertices per triangle
+  const uint64_t vertex_buffer_size
+    = sizeof(float) * 3 * 3 * this->triangle_capacity;
+  this->vertex_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "metaballs vertex buffer",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex,
+                    .size  = vertex_buffer_size,
+                  });
+  this->normal_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "metaballs normal buffer",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex,
+                    .size  = vertex_buffer_size,
+                  });
+
+  const uint32_t params[4]
+    = {this->active_cell_capacity, this->triangle_capacity, 0, 0};
+  wgpu_queue_write_buffer(wgpu_context, this->params_buffer.buffer, 0, params,
+                          sizeof(params));
 }
 
 static void metaballs_compute_init_defaults(metaballs_compute_t* this)
@@ -1278,9 +1777,9 @@ static void metaballs_compute_create(metaballs_compute_t* this,
   wgpu_context_t* wgpu_context = renderer->wgpu_context;
 
   {
-    size_t table_size
-      = ARRAY_SIZE(MARCHING_CUBES_EDGE_TABLE)
-        + ARRAY_SIZE(MARCHING_CUBES_TRI_TABLE) * sizeof(int32_t);
+    size_t table_size = (ARRAY_SIZE(MARCHING_CUBES_EDGE_TABLE)
+                         + ARRAY_SIZE(MARCHING_CUBES_TRI_TABLE))
+                        * sizeof(int32_t);
     int32_t* tables_array = (int32_t*)malloc(table_size);
 
     size_t j = 0;
@@ -1302,6 +1801,25 @@ static void metaballs_compute_create(metaballs_compute_t* this,
     free(tables_array);
   }
 
+  {
+    // Ball count, padded to 16 bytes, followed by 8 floats per ball
+    const size_t metaball_array_size
+      = sizeof(uint32_t) * 4 + sizeof(float) * 8 * MAX_METABALLS;
+    this->metaball_array = (uint8_t*)calloc(1, metaball_array_size);
+    ASSERT(this->metaball_array != NULL);
+    this->metaball_array_header = (uint32_t*)this->metaball_array;
+    this->metaball_array_balls
+      = (float*)(this->metaball_array + sizeof(uint32_t) * 4);
+
+    this->metaball_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs buffer",
+                      .usage = WGPUBufferUsage_Storage
+                             | WGPUBufferUsage_CopyDst,
+                      .size  = metaball_array_size,
+                    });
+  }
+
   {
     const uint32_t volume_elements
       = volume.width * volume.height * volume.depth;
@@ -1342,41 +1860,171 @@ static void metaballs_compute_create(metaballs_compute_t* this,
     wgpuBufferUnmap(this->volume_buffer.buffer);
   }
 
-  const uint32_t marching_cube_cells
-    = (volume.width - 1) * (volume.height - 1) * (volume.depth - 1);
-  const size_t vertex_buffer_size
-    = sizeof(float) * 3 * 12 * marching_cube_cells;
-  const size_t index_buffer_size = sizeof(uint32_t) * 15 * marching_cube_cells;
+  /* Cell classification and compaction */
+  {
+    this->cell_count
+      = (volume.width - 1) * (volume.height - 1) * (volume.depth - 1);
+    const uint64_t cells_size = sizeof(uint32_t) * this->cell_count;
 
-  this->vertex_buffer = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .label = "metaballs vertex buffer",
-                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex,
-                    .size  = vertex_buffer_size,
-                  });
+    uint32_t* cell_indices = (uint32_t*)malloc(cells_size);
+    for (uint32_t i = 0; i < this->cell_count; ++i) {
+      cell_indices[i] = i;
+    }
+    this->cell_indices_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label        = "metaballs cell indices buffer",
+                      .usage        = WGPUBufferUsage_Storage,
+                      .size         = cells_size,
+                      .initial.data = cell_indices,
+                    });
+    free(cell_indices);
 
-  this->normal_buffer = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .label = "metaballs normal buffer",
-                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex,
-                    .size  = vertex_buffer_size,
-                  });
+    this->cell_cases_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs cell cases buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = cells_size,
+                    });
+    this->cell_flags_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs cell flags buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = cells_size,
+                    });
+    // The compaction may keep every cell
+    this->active_cells_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs active cells buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = cells_size,
+                    });
+    this->triangle_counts_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs triangle counts buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = cells_size,
+                    });
+    this->triangle_offsets_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs triangle offsets buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = cells_size,
+                    });
+    this->counters_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs counters buffer",
+                      .usage = WGPUBufferUsage_Storage
+                             | WGPUBufferUsage_CopySrc,
+                      .size  = sizeof(uint32_t) * 4,
+                    });
+    this->readback.buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs counters readback buffer",
+                      .usage = WGPUBufferUsage_MapRead
+                             | WGPUBufferUsage_CopyDst,
+                      .size  = sizeof(uint32_t) * 4,
+                    });
+    this->params_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs marching cubes params buffer",
+                      .usage = WGPUBufferUsage_CopyDst
+                             | WGPUBufferUsage_Uniform,
+                      .size  = sizeof(uint32_t) * 4,
+                    });
 
-  this->index_buffer = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .label = "metaballs index buffer",
-                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Index,
-                    .size  = index_buffer_size,
-                  });
-  this->index_count = index_buffer_size / sizeof(uint32_t);
+    const uint32_t dispatch_args[3] = {0, 1, 1};
+    this->dispatch_buffer           = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs emit dispatch buffer",
+                      .usage = WGPUBufferUsage_Storage
+                             | WGPUBufferUsage_Indirect,
+                      .size  = sizeof(dispatch_args),
+                      .initial.data = dispatch_args,
+                    });
 
-  this->indirect_render_array[0] = 500;
-  this->indirect_render_buffer   = wgpu_create_buffer(
+    this->gpu_sort = wgpu_gpu_sort_create(
+      wgpu_context, &(wgpu_gpu_sort_desc_t){
+                      .max_element_count = this->cell_count,
+                    });
+  }
+
+  /* Bricks of the broad phase */
+  {
+    this->brick_grid_size[0]
+      = (volume.width + METABALLS_BRICK_SIZE - 1) / METABALLS_BRICK_SIZE;
+    this->brick_grid_size[1]
+      = (volume.height + METABALLS_BRICK_SIZE - 1) / METABALLS_BRICK_SIZE;
+    this->brick_grid_size[2]
+      = (volume.depth + METABALLS_BRICK_SIZE - 1) / METABALLS_BRICK_SIZE;
+    this->brick_count = this->brick_grid_size[0] * this->brick_grid_size[1]
+                        * this->brick_grid_size[2];
+    const uint64_t bricks_size = sizeof(uint32_t) * this->brick_count;
+
+    uint32_t* brick_indices = (uint32_t*)malloc(bricks_size);
+    for (uint32_t i = 0; i < this->brick_count; ++i) {
+      brick_indices[i] = i;
+    }
+    this->brick_indices_buffer = wgpu_create_buffer(
       wgpu_context, &(wgpu_buffer_desc_t){
-                      .label = "metaballs indirect draw buffer",
-                      .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect
-                             | WGPUBufferUsage_CopyDst,
-                      .size = sizeof(this->indirect_render_array),
+                      .label        = "metaballs brick indices buffer",
+                      .usage        = WGPUBufferUsage_Storage,
+                      .size         = bricks_size,
+                      .initial.data = brick_indices,
+                    });
+    free(brick_indices);
+
+    this->brick_states_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs brick states buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = bricks_size,
+                    });
+    this->brick_flags_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs brick flags buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = bricks_size,
+                    });
+    this->active_bricks_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs active bricks buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = bricks_size,
+                    });
+    this->brick_counter_buffer = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs brick counter buffer",
+                      .usage = WGPUBufferUsage_Storage,
+                      .size  = sizeof(uint32_t) * 4,
+                    });
+
+    const uint32_t dispatch_args[3] = {0, 1, 1};
+    this->brick_dispatch_buffer     = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "metaballs brick dispatch buffer",
+                      .usage = WGPUBufferUsage_Storage
+                             | WGPUBufferUsage_Indirect,
+                      .size  = sizeof(dispatch_args),
+                      .initial.data = dispatch_args,
+                    });
+  }
+
+  {
+
+    // Initial guess, grown from the read back counters
+    this->active_cell_capacity = MAX(this->cell_count / 16, 1024u);
+    this->triangle_capacity    = this->active_cell_capacity * 2;
+    metaballs_compute_create_capacity_buffers(this);
+  }
+
+  // Vertex count, instance count, first vertex and first instance
+  const uint32_t draw_args[4] = {0, 1, 0, 0};
+  this->indirect_render_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "metaballs indirect draw buffer",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect,
+                    .size  = sizeof(draw_args),
+                    .initial.data = draw_args,
                   });
 
   for (uint32_t i = 0; i < MAX_METABALLS; ++i) {
@@ -1390,6 +2038,113 @@ static void metaballs_compute_create(metaballs_compute_t* this,
   }
 
   metaballs_compute_init(this);
+  metaballs_compute_setup_bind_groups(this);
+}
+
+static void metaballs_compute_destroy(metaballs_compute_t* this)
+{
+  wgpu_gpu_sort_release(this->gpu_sort);
+  wgpu_destroy_buffer(&this->tables_buffer);
+  wgpu_destroy_buffer(&this->metaball_buffer);
+  wgpu_destroy_buffer(&this->volume_buffer);
+  wgpu_destroy_buffer(&this->indirect_render_buffer);
+  wgpu_destroy_buffer(&this->params_buffer);
+  wgpu_destroy_buffer(&this->cell_indices_buffer);
+  wgpu_destroy_buffer(&this->cell_cases_buffer);
+  wgpu_destroy_buffer(&this->cell_flags_buffer);
+  wgpu_destroy_buffer(&this->active_cells_buffer);
+  wgpu_destroy_buffer(&this->counters_buffer);
+  wgpu_destroy_buffer(&this->triangle_counts_buffer);
+  wgpu_destroy_buffer(&this->triangle_offsets_buffer);
+  wgpu_destroy_buffer(&this->dispatch_buffer);
+  wgpu_destroy_buffer(&this->brick_indices_buffer);
+  wgpu_destroy_buffer(&this->brick_states_buffer);
+  wgpu_destroy_buffer(&this->brick_flags_buffer);
+  wgpu_destroy_buffer(&this->active_bricks_buffer);
+  wgpu_destroy_buffer(&this->brick_counter_buffer);
+  wgpu_destroy_buffer(&this->brick_dispatch_buffer);
+  wgpu_destroy_buffer(&this->readback.buffer);
+  wgpu_destroy_buffer(&this->vertex_buffer);
+  wgpu_destroy_buffer(&this->normal_buffer);
+  for (uint32_t i = 0; i < (uint32_t)MarchingCubesKernel_Count; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, this->kernels[i].bind_group)
+    WGPU_RELEASE_RESOURCE(ComputePipeline, this->kernels[i].pipeline)
+  }
+  free(this->metaball_array);
+}
+
+static void metaballs_compute_readback_map_cb(WGPUBufferMapAsyncStatus status,
+                                              void* user_data)
+{
+  metaballs_compute_t* this = (metaballs_compute_t*)user_data;
+  if (status == WGPUBufferMapAsyncStatus_DestroyedBeforeCallback
+      || status == WGPUBufferMapAsyncStatus_UnmappedBeforeCallback) {
+    return;
+  }
+
+  if (status == WGPUBufferMapAsyncStatus_Success) {
+    const uint32_t* counters = (const uint32_t*)wgpuBufferGetConstMappedRange(
+      this->readback.buffer.buffer, 0, this->readback.buffer.size);
+    ASSERT(counters != NULL);
+    this->readback.active_cell_count = counters[0];
+    this->readback.triangle_count    = counters[1];
+    this->readback.valid             = true;
+    wgpuBufferUnmap(this->readback.buffer.buffer);
+  }
+
+  this->readback.pending = false;
+}
+
+// Copies the counters of the previous frame, ahead of the commands of this one
+static void metaballs_compute_read_back_counters(metaballs_compute_t* this)
+{
+  if (this->readback.pending) {
+    return;
+  }
+
+  wgpu_context_t* wgpu_context = this->renderer->wgpu_context;
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  wgpuCommandEncoderCopyBufferToBuffer(cmd_enc, this->counters_buffer.buffer,
+                                       0, this->readback.buffer.buffer, 0,
+                                       this->readback.buffer.size);
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  this->readback.pending = true;
+  wgpuBufferMapAsync(this->readback.buffer.buffer, WGPUMapMode_Read, 0,
+                     this->readback.buffer.size,
+                     metaballs_compute_readback_map_cb, this);
+}
+
+// Grows the capacities with some headroom when the last counters did not fit,
+// returns whether they fit
+static bool metaballs_compute_fit_capacity(metaballs_compute_t* this)
+{
+  if (!this->readback.valid) {
+    return false;
+  }
+
+  const uint32_t active_cell_count = this->readback.active_cell_count;
+  const uint32_t triangle_count    = this->readback.triangle_count;
+  if (active_cell_count <= this->active_cell_capacity
+      && triangle_count <= this->triangle_capacity) {
+    return true;
+  }
+
+  this->active_cell_capacity
+    = MIN(MAX(this->active_cell_capacity,
+              active_cell_count + active_cell_count / 2),
+          this->cell_count);
+  this->triangle_capacity
+    = MIN(MAX(this->triangle_capacity, triangle_count + triangle_count / 2),
+          this->cell_count * 5);
+  metaballs_compute_create_capacity_buffers(this);
+  metaballs_compute_setup_bind_groups(this);
+  this->readback.valid = false;
+  return false;
 }
 
 static void metaballs_compute_rearrange(metaballs_compute_t* this)
@@ -1398,6 +2153,76 @@ static void metaballs_compute_rearrange(metaballs_compute_t* this)
   this->strength_target = 3.0f + random_float() * 3.0f;
 }
 
+static void metaballs_compute_set_kernel(metaballs_compute_t* this,
+                                         WGPUComputePassEncoder compute_pass,
+                                         marching_cubes_kernel_enum kernel)
+{
+  wgpuComputePassEncoderSetPipeline(compute_pass,
+                                    this->kernels[kernel].pipeline);
+  wgpuComputePassEncoderSetBindGroup(compute_pass, 0,
+                                     this->kernels[kernel].bind_group, 0, NULL);
+}
+
+static void metaballs_compute_dispatch(metaballs_compute_t* this,
+                                       WGPUComputePassEncoder compute_pass)
+{
+  const uint32_t* wg_size = METABALLS_COMPUTE_WORKGROUP_SIZE;
+
+  /* Broad phase, compaction of the bricks to evaluate */
+  metaballs_compute_set_kernel(this, compute_pass, MarchingCubesKernel_Bricks);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    compute_pass, (this->brick_grid_size[0] + wg_size[0] - 1) / wg_size[0],
+    (this->brick_grid_size[1] + wg_size[1] - 1) / wg_size[1],
+    (this->brick_grid_size[2] + wg_size[2] - 1) / wg_size[2]);
+  wgpu_gpu_sort_compact(this->gpu_sort, compute_pass,
+                        this->brick_indices_buffer.buffer,
+                        this->brick_flags_buffer.buffer,
+                        this->active_bricks_buffer.buffer,
+                        this->brick_counter_buffer.buffer, this->brick_count);
+  metaballs_compute_set_kernel(this, compute_pass,
+                               MarchingCubesKernel_PrepareBricks);
+  wgpuComputePassEncoderDispatchWorkgroups(compute_pass, 1, 1, 1);
+
+  /* Field and classification of the cells of the active bricks */
+  metaballs_compute_set_kernel(this, compute_pass, MarchingCubesKernel_Field);
+  wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+    compute_pass, this->brick_dispatch_buffer.buffer, 0);
+  metaballs_compute_set_kernel(this, compute_pass,
+                               MarchingCubesKernel_Classify);
+  wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+    compute_pass, this->brick_dispatch_buffer.buffer, 0);
+
+  /* Compaction of the active cells */
+  wgpu_gpu_sort_compact(this->gpu_sort, compute_pass,
+                        this->cell_indices_buffer.buffer,
+                        this->cell_flags_buffer.buffer,
+                        this->active_cells_buffer.buffer,
+                        this->counters_buffer.buffer, this->cell_count);
+
+  /* Triangle counts of the active cells */
+  metaballs_compute_set_kernel(this, compute_pass,
+                               MarchingCubesKernel_PrepareDispatch);
+  wgpuComputePassEncoderDispatchWorkgroups(compute_pass, 1, 1, 1);
+  metaballs_compute_set_kernel(this, compute_pass,
+                               MarchingCubesKernel_TriangleCount);
+  wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+    compute_pass, this->dispatch_buffer.buffer, 0);
+
+  /* Output offsets */
+  wgpu_gpu_sort_scan(this->gpu_sort, compute_pass,
+                     this->triangle_counts_buffer.buffer,
+                     this->triangle_offsets_buffer.buffer,
+                     this->active_cell_capacity);
+
+  /* Draw arguments and triangles */
+  metaballs_compute_set_kernel(this, compute_pass,
+                               MarchingCubesKernel_Finalize);
+  wgpuComputePassEncoderDispatchWorkgroups(compute_pass, 1, 1, 1);
+  metaballs_compute_set_kernel(this, compute_pass, MarchingCubesKernel_Emit);
+  wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+    compute_pass, this->dispatch_buffer.buffer, 0);
+}
+
 static metaballs_compute_t*
 metaballs_compute_update_sim(metaballs_compute_t* this,
                              WGPUComputePassEncoder compute_pass, float time,
@@ -1474,39 +2299,16 @@ metaballs_compute_update_sim(metaballs_compute_t* this,
 
   wgpu_queue_write_buffer(this->renderer->wgpu_context,
                           this->metaball_buffer.buffer, 0,
-                          &this->metaball_array, sizeof(this->metaball_array));
-  wgpu_queue_write_buffer(
-    this->renderer->wgpu_context, this->indirect_render_buffer.buffer, 0,
-    &this->indirect_render_array, sizeof(this->indirect_render_array));
-
-  const uint32_t dispatch_size[3] = {
-    this->volume.width / METABALLS_COMPUTE_WORKGROUP_SIZE[0],  //
-    this->volume.height / METABALLS_COMPUTE_WORKGROUP_SIZE[1], //
-    this->volume.depth / METABALLS_COMPUTE_WORKGROUP_SIZE[2],  //
-  };
+                          this->metaball_array, this->metaball_buffer.size);
 
-  /* Update metaballs */
-  if (this->compute_metaballs_pipeline) {
-    wgpuComputePassEncoderSetPipeline(compute_pass,
-                                      this->compute_metaballs_pipeline);
-    wgpuComputePassEncoderSetBindGroup(
-      compute_pass, 0, this->compute_metaballs_bind_group, 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      compute_pass, dispatch_size[0], dispatch_size[1], dispatch_size[2]);
-  }
+  metaballs_compute_dispatch(this, compute_pass);
 
-  /* Update marching cubes */
-  if (this->compute_marching_cubes_pipeline) {
-    wgpuComputePassEncoderSetPipeline(compute_pass,
-                                      this->compute_marching_cubes_pipeline);
-    wgpuComputePassEncoderSetBindGroup(
-      compute_pass, 0, this->compute_marching_cubes_bind_group, 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      compute_pass, dispatch_size[0], dispatch_size[1], dispatch_size[2]);
+  // The surface is complete once its counts are known to fit
+  metaballs_compute_read_back_counters(this);
+  if (metaballs_compute_fit_capacity(this)) {
+    this->has_calced_once = true;
   }
 
-  this->has_calced_once = true;
-
   return this;
 }
 
@@ -3624,6 +4426,7 @@ static void metaballs_destroy(metaballs_t* this)
   WGPU_RELEASE_RESOURCE(Buffer, this->ubo.buffer)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, this->bind_group_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, this->bind_group)
+  metaballs_compute_destroy(&this->metaballs_compute);
 }
 
 static void metaballs_rearrange(metaballs_t* this)
@@ -3683,11 +4486,8 @@ static metaballs_t* metaballs_render_shadow(metaballs_t* this,
   wgpuRenderPassEncoderSetVertexBuffer(
     render_pass, 0, this->metaballs_compute.vertex_buffer.buffer, 0,
     WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderSetIndexBuffer(
-    render_pass, this->metaballs_compute.index_buffer.buffer,
-    WGPUIndexFormat_Uint32, 0, WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderDrawIndexed(
-    render_pass, this->metaballs_compute.index_count, 0, 0, 0, 0);
+  wgpuRenderPassEncoderDrawIndirect(
+    render_pass, this->metaballs_compute.indirect_render_buffer.buffer, 0);
   return this;
 }
 
@@ -3709,11 +4509,8 @@ static metaballs_t* metaballs_render(metaballs_t* this,
   wgpuRenderPassEncoderSetVertexBuffer(
     render_pass, 1, this->metaballs_compute.normal_buffer.buffer, 0,
     WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderSetIndexBuffer(
-    render_pass, this->metaballs_compute.index_buffer.buffer,
-    WGPUIndexFormat_Uint32, 0, WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderDrawIndexed(
-    render_pass, this->metaballs_compute.index_count, 0, 0, 0, 0);
+  wgpuRenderPassEncoderDrawIndirect(
+    render_pass, this->metaballs_compute.indirect_render_buffer.buffer, 0);
   return this;
 }
 
@@ -5475,6 +6272,17 @@ static void init_example_state(wgpu_context_t* wgpu_context)
     .iso_level = 20.0f,
   };
 
+  // Finer grid over the same extent, the broad phase keeps the cost with the
+  // surface rather than the volume
+  const uint32_t resolution_scale
+    = settings_get_quality_level().volume_resolution_scale;
+  example_state.volume.width *= resolution_scale;
+  example_state.volume.height *= resolution_scale;
+  example_state.volume.depth *= resolution_scale;
+  example_state.volume.x_step /= (float)resolution_scale;
+  example_state.volume.y_step /= (float)resolution_scale;
+  example_state.volume.z_step /= (float)resolution_scale;
+
   /* Deferred pass, copy pass, bloom pass & result pass */
   deferred_pass_t* deferred_pass = &example_state.deferred_pass;
   deferred_pass_create(deferred_pass, renderer);
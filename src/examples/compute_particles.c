@@ -4,12 +4,40 @@
 #include <string.h>
 
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/particles.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Compute Shader Particle System
  *
- * Attraction based 2D GPU particle system using compute shaders. Particle data
- * is stored in a shader storage buffer.
+ * Attraction based 2D GPU particle system using compute shaders. The particles
+ * are simulated by the GPU particle system, with the position, velocity and
+ * gradient position of the particles in storage buffers of their own, the
+ * example only provides the emission and the update of a particle in WGSL.
+ *
+ * Particles have a limited lifetime. Every frame the compute pass emits new
+ * particles into the slots of the free list, simulates the live ones and
+ * compacts the indices of the live and of the dead particles with the GPU
+ * stream compaction. The live indices are drawn as index buffer with the live
+ * count written into an indirect draw buffer, so that the draw follows the
+ * live particles instead of the capacity. The live particles can also be
+ * sorted back to front, from the oldest to the most recently emitted one, with
+ * the GPU radix sort.
+ *
+ * With a simulation rate (--sim-rate=<Hz>) the pass runs the steps the frame
+ * scheduler assigns to the frame, each of the simulated step time, and a
+ * render-only frame draws the lists of the last step.
+ *
+ * With async compute (--async-compute) the steps are submitted in their own
+ * command buffer ahead of the render, and end with copying the particles and
+ * the live list into the one of two render states that is not drawn. The
+ * render draws the other state, written by the steps of the previous frame,
+ * so that the steps do not have to wait for the draw.
+ *
+ * With --packed a particle takes 12 bytes instead of 32: the position as
+ * 16-bit snorm, the velocity as half floats and the gradient position as
+ * 16-bit unorm next to the lifetime as half float. The update functions go
+ * through accessors of the layout and the vertex fetch unpacks the drawn
+ * streams, which cuts the bandwidth of a step.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/computeparticles/computeparticles.cpp
@@ -17,10 +45,16 @@
  * -------------------------------------------------------------------------- */
 
 #define PARTICLE_COUNT 256 * 1024
+#define PARTICLE_LIFETIME 10.0f
 
 static float timer           = 0.0f;
 static float animStart       = 20.0f;
 static bool attach_to_cursor = false;
+static bool sort_particles   = false;
+// Emission rate relative to the rate that keeps every particle alive
+static float emission_rate = 1.0f;
+// Quantized particle layout
+static bool packed_particles = false;
 
 static struct {
   texture_t particle;
@@ -38,35 +72,179 @@ static struct {
 
 // Resources for the compute part of the example
 static struct {
-  wgpu_buffer_t storage_buffer; // (Shader) storage buffer object containing the
-                                // particles
-  wgpu_buffer_t uniform_buffer; // Uniform buffer object containing particle
-                                // system parameters
-  WGPUBindGroupLayout bind_group_layout; // Compute shader binding layout
-  WGPUBindGroup bind_group;              // Compute shader bindings
-  WGPUPipelineLayout pipeline_layout;    // Layout of the compute pipeline
-  WGPUComputePipeline pipeline; // Compute pipeline for updating particle
-                                // positions
-  struct compute_ubo_t {        // Compute shader uniform block object
-    float delta_t;              // Frame delta time
-    float dest_x;               // x position of the attractor
-    float dest_y;               // y position of the attractor
-    int32_t particle_count;
-  } ubo;
+  wgpu_particles_t* particles; // Particle streams, live and free lists
+  struct compute_params_t {    // Uniform block of the particle behavior
+    float dest_x;              // x position of the attractor
+    float dest_y;              // y position of the attractor
+    float lifetime;            // Largest particle lifetime
+    uint32_t padding;
+  } params;
 } compute;
 
+// Streams of the particle system, the drawn ones first
+enum {
+  PARTICLE_STREAM_POSITIONS,
+  PARTICLE_STREAM_GRADIENTS,
+  PARTICLE_STREAM_VELOCITIES,
+  PARTICLE_STREAM_COUNT,
+};
+
+// Drawn copies of the particles and of the live list with async compute
+static struct {
+  bool enabled;
+  struct {
+    wgpu_buffer_t positions;
+    wgpu_buffer_t gradients;
+    wgpu_buffer_t live_indices;
+    wgpu_buffer_t draw_indirect;
+  } states[2];
+} render_states = {0};
+
 // Render pass descriptor for frame buffer writes
 static struct {
   WGPURenderPassColorAttachment color_attachments[1];
   WGPURenderPassDescriptor descriptor;
 } render_pass;
 
-// SSBO particle declaration
-typedef struct particle_t {
-  vec2 pos;          // Particle position
-  vec2 vel;          // Particle velocity
-  vec4 gradient_pos; // Texture coordinates for the gradient ramp map
-} particle_t;
+// Accessors of the particle streams, the gradient positions hold the texture
+// coordinates for the gradient ramp map in x and the remaining lifetime in y
+// clang-format off
+static const char* particle_layout_wgsl = CODE(
+  fn loadPosition(index : u32) -> vec2<f32> {
+    return positions[index];
+  }
+
+  fn storePosition(index : u32, value : vec2<f32>) {
+    positions[index] = value;
+  }
+
+  fn loadVelocity(index : u32) -> vec2<f32> {
+    return velocities[index];
+  }
+
+  fn storeVelocity(index : u32, value : vec2<f32>) {
+    velocities[index] = value;
+  }
+
+  fn loadGradient(index : u32) -> vec2<f32> {
+    return gradients[index].xy;
+  }
+
+  fn storeGradient(index : u32, value : vec2<f32>) {
+    gradients[index] = vec4<f32>(value, 0.0, 0.0);
+  }
+
+  // Positive lifetimes sort like their bits
+  fn gradientSortKey(index : u32) -> u32 {
+    return bitcast<u32>(gradients[index].y);
+  }
+);
+
+// The gradient texture coordinate in the low half as unorm, the lifetime in
+// the high half as half float
+static const char* packed_particle_layout_wgsl = CODE(
+  fn loadPosition(index : u32) -> vec2<f32> {
+    return unpack2x16snorm(positions[index]);
+  }
+
+  fn storePosition(index : u32, value : vec2<f32>) {
+    positions[index] = pack2x16snorm(value);
+  }
+
+  fn loadVelocity(index : u32) -> vec2<f32> {
+    return unpack2x16float(velocities[index]);
+  }
+
+  fn storeVelocity(index : u32, value : vec2<f32>) {
+    velocities[index] = pack2x16float(value);
+  }
+
+  fn loadGradient(index : u32) -> vec2<f32> {
+    let packed = gradients[index];
+    return vec2<f32>(unpack2x16unorm(packed).x, unpack2x16float(packed).y);
+  }
+
+  fn storeGradient(index : u32, value : vec2<f32>) {
+    gradients[index] = (pack2x16unorm(vec2<f32>(value.x, 0.0)) & 0xffffu)
+                       | (pack2x16float(vec2<f32>(0.0, value.y)) & 0xffff0000u);
+  }
+
+  // Positive half float lifetimes sort like their bits
+  fn gradientSortKey(index : u32) -> u32 {
+    return gradients[index] >> 16u;
+  }
+);
+
+// Particle behavior
+static const char* particle_update_wgsl = CODE(
+  struct Params {
+    destX : f32,
+    destY : f32,
+    lifetime : f32,
+    padding : u32,
+  };
+
+  fn attraction(pos : vec2<f32>, attractPos : vec2<f32>) -> vec2<f32> {
+    let delta = attractPos - pos;
+    let damp = 0.5;
+    let dDampedDot = dot(delta, delta) + damp;
+    let invDist = 1.0 / sqrt(dDampedDot);
+    let invDistCubed = invDist * invDist * invDist;
+    return delta * invDistCubed * 0.0035;
+  }
+
+  fn repulsion(pos : vec2<f32>, attractPos : vec2<f32>) -> vec2<f32> {
+    let delta = attractPos - pos;
+    let targetDistance = sqrt(dot(delta, delta));
+    return delta * (1.0 / (targetDistance * targetDistance * targetDistance))
+           * -0.000035;
+  }
+
+  // Revives the dead particles of the previous frame at the attractor
+  fn particleEmit(index : u32, emitIndex : u32) {
+    let r = particleHash(particleSystem.seed ^ index);
+    let angle = particleRandom(r) * 6.2831853;
+    let speed = particleRandom(r + 1u) * 0.25;
+    storePosition(index, vec2<f32>(params.destX, params.destY));
+    storeVelocity(index, vec2<f32>(cos(angle), sin(angle)) * speed);
+    storeGradient(index, vec2<f32>(
+      particleRandom(r + 2u),
+      (0.5 + 0.5 * particleRandom(r + 3u)) * params.lifetime));
+  }
+
+  fn particleUpdate(index : u32) -> bool {
+    var gradientPos = loadGradient(index);
+    if (gradientPos.y <= 0.0) {
+      return false;
+    }
+    let deltaT = particleSystem.deltaTime;
+    var vVel = loadVelocity(index);
+    var vPos = loadPosition(index);
+    let destPos = vec2<f32>(params.destX, params.destY);
+    vVel = vVel + repulsion(vPos, destPos) * 0.05;
+    vPos = vPos + vVel * deltaT;
+    // Collide with the frame
+    if (vPos.x < -1.0 || vPos.x > 1.0 || vPos.y < -1.0 || vPos.y > 1.0) {
+      vVel = (-vVel * 0.1) + attraction(vPos, destPos) * 12.0;
+    }
+    else {
+      storePosition(index, vPos);
+    }
+    storeVelocity(index, vVel);
+    gradientPos.x = gradientPos.x + 0.02 * deltaT;
+    if (gradientPos.x > 1.0) {
+      gradientPos.x = gradientPos.x - 1.0;
+    }
+    gradientPos.y = gradientPos.y - deltaT;
+    storeGradient(index, gradientPos);
+    return gradientPos.y > 0.0;
+  }
+
+  fn particleSortKey(index : u32) -> u32 {
+    return gradientSortKey(index);
+  }
+);
+// clang-format on
 
 // Other variables
 static const char* example_title = "Compute Shader Particle System";
@@ -80,43 +258,176 @@ static void load_assets(wgpu_context_t* wgpu_context)
     wgpu_context, "textures/particle_gradient_rgba.ktx", NULL);
 }
 
-// Setup and fill the compute shader storage buffers containing the particles
+// Seed of the initial particles, the streams are filled independently and
+// in parallel, from the same hashed sequence
+#define PARTICLE_SEED 0x5eedu
+
+// Same rounding as pack2x16snorm and pack2x16unorm
+static uint16_t pack_snorm16(float value)
+{
+  return (uint16_t)(int16_t)roundf(clamp_float(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static uint16_t pack_unorm16(float value)
+{
+  return (uint16_t)roundf(clamp_float(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+// Initial particle positions
+static void fill_positions(void* user_data, void* mapping, uint32_t begin,
+                           uint32_t end)
+{
+  vec2* positions       = (vec2*)mapping;
+  uint16_t* packed_data = (uint16_t*)mapping;
+  for (uint32_t i = begin; i < end; ++i) {
+    const float x = 2.0f * random_float_hashed(PARTICLE_SEED, i * 3) - 1.0f;
+    const float y
+      = 2.0f * random_float_hashed(PARTICLE_SEED, i * 3 + 1) - 1.0f;
+    if (packed_particles) {
+      packed_data[i * 2]     = pack_snorm16(x);
+      packed_data[i * 2 + 1] = pack_snorm16(y);
+    }
+    else {
+      positions[i][0] = x;
+      positions[i][1] = y;
+    }
+  }
+}
+
+static void fill_gradients(void* user_data, void* mapping, uint32_t begin,
+                           uint32_t end)
+{
+  vec4* gradients       = (vec4*)mapping;
+  uint16_t* packed_data = (uint16_t*)mapping;
+  for (uint32_t i = begin; i < end; ++i) {
+    const float x
+      = (2.0f * random_float_hashed(PARTICLE_SEED, i * 3) - 1.0f) / 2.0f;
+    // The initial particles die over the first lifetime
+    const float lifetime
+      = random_float_hashed(PARTICLE_SEED, i * 3 + 2) * PARTICLE_LIFETIME;
+    if (packed_particles) {
+      // The gradient ramp map repeats, the unorm keeps the fraction
+      packed_data[i * 2]     = pack_unorm16(x < 0.0f ? x + 1.0f : x);
+      packed_data[i * 2 + 1] = float_to_half(lifetime);
+    }
+    else {
+      gradients[i][0] = x;
+      gradients[i][1] = lifetime;
+    }
+  }
+}
+
+// Element sizes of the particle streams, the velocities are laid out like the
+// positions
+static uint32_t get_position_size(void)
+{
+  return packed_particles ? sizeof(uint32_t) : sizeof(vec2);
+}
+
+static uint32_t get_gradient_size(void)
+{
+  return packed_particles ? sizeof(uint32_t) : sizeof(vec4);
+}
+
+static char* get_particle_update_wgsl(void)
+{
+  const char* particle_layout
+    = packed_particles ? packed_particle_layout_wgsl : particle_layout_wgsl;
+  const size_t wgsl_size
+    = strlen(particle_layout) + strlen(particle_update_wgsl) + 2;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", particle_layout, particle_update_wgsl);
+  return wgsl;
+}
+
+// Setup and fill the particle streams, live and free lists
 static void prepare_storage_buffers(wgpu_context_t* wgpu_context)
 {
-  // Initial particle positions
-  static particle_t particle_buffer[PARTICLE_COUNT] = {0};
-  for (uint32_t i = 0; i < (uint32_t)PARTICLE_COUNT; ++i) {
-    particle_buffer[i] = (particle_t){
-      .pos = {
-        random_float_min_max(-1.0f, 1.0f), // x
-        random_float_min_max(-1.0f, 1.0f)  // y
-       },
-      .vel = GLM_VEC2_ZERO_INIT,
-      .gradient_pos = GLM_VEC4_ZERO_INIT,
-    };
-    particle_buffer[i].gradient_pos[0] = particle_buffer[i].pos[0] / 2.0f;
-  }
-
-  // Staging
-  // SSBO won't be changed on the host after upload
-  compute.storage_buffer = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex
-                             | WGPUBufferUsage_Storage,
-                    .size         = PARTICLE_COUNT * sizeof(particle_t),
-                    .initial.data = particle_buffer,
-                  });
+  const char* wgsl_type = packed_particles ? "u32" : "vec2<f32>";
+  char* update_wgsl     = get_particle_update_wgsl();
+  compute.particles     = wgpu_particles_create(
+    wgpu_context,
+    &(wgpu_particles_desc_t){
+      .capacity     = PARTICLE_COUNT,
+      .stream_count = PARTICLE_STREAM_COUNT,
+      .streams = {
+        [PARTICLE_STREAM_POSITIONS] = {
+          .name         = "positions",
+          .wgsl_type    = wgsl_type,
+          .element_size = get_position_size(),
+          .fill = {
+            .func     = fill_positions,
+            .parallel = true,
+          },
+        },
+        [PARTICLE_STREAM_GRADIENTS] = {
+          .name         = "gradients",
+          .wgsl_type    = packed_particles ? "u32" : "vec4<f32>",
+          .element_size = get_gradient_size(),
+          .fill = {
+            .func     = fill_gradients,
+            .parallel = true,
+          },
+        },
+        [PARTICLE_STREAM_VELOCITIES] = {
+          .name         = "velocities",
+          .wgsl_type    = wgsl_type,
+          .element_size = get_position_size(),
+        },
+      },
+      .params_size = sizeof(compute.params),
+      .update_wgsl = update_wgsl,
+      .sort        = true,
+    });
+  free(update_wgsl);
+
+  // Render states, nothing is drawn until the first steps completed
+  const uint32_t draw_indirect[5] = {0, 1, 0, 0, 0};
+  for (uint32_t i = 0; render_states.enabled && i < 2; ++i) {
+    render_states.states[i].positions = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "particle_render_state_positions_buffer",
+                      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+                      .size  = PARTICLE_COUNT * get_position_size(),
+                    });
+    render_states.states[i].gradients = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "particle_render_state_gradients_buffer",
+                      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+                      .size  = PARTICLE_COUNT * get_gradient_size(),
+                    });
+    render_states.states[i].live_indices = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = "particle_render_state_live_indices_buffer",
+                      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
+                      .size  = PARTICLE_COUNT * sizeof(uint32_t),
+                    });
+    render_states.states[i].draw_indirect = wgpu_create_buffer(
+      wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .label        = "particle_render_state_draw_indirect_buffer",
+        .usage        = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Indirect,
+        .size         = sizeof(draw_indirect),
+        .initial.data = draw_indirect,
+      });
+  }
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   wgpu_context_t* wgpu_context = context->wgpu_context;
 
-  // Update uniform buffer data
-  compute.ubo.delta_t = context->frame_timer * 2.5f;
+  // Step parameters, shared by the steps of the frame. With the mean lifetime
+  // of 3/4 of the largest one, emitting the capacity every mean lifetime keeps
+  // the particle count steady
+  wgpu_particles_update(compute.particles,
+                        context->simulation.step_time * 2.5f,
+                        emission_rate * (float)PARTICLE_COUNT
+                          / (0.75f * PARTICLE_LIFETIME));
+
   if (!attach_to_cursor) {
-    compute.ubo.dest_x = sin(glm_rad(timer * 360.0f)) * 0.75f;
-    compute.ubo.dest_y = 0.0f;
+    compute.params.dest_x = sin(glm_rad(timer * 360.0f)) * 0.75f;
+    compute.params.dest_y = 0.0f;
   }
   else {
     float width  = (float)wgpu_context->surface.width;
@@ -126,28 +437,18 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
       = (context->mouse_position[0] - (width / 2.0f)) / (width / 2.0f);
     float normalized_my
       = ((height / 2.0f) - context->mouse_position[1]) / (height / 2.0f);
-    compute.ubo.dest_x = normalized_mx;
-    compute.ubo.dest_y = normalized_my;
+    compute.params.dest_x = normalized_mx;
+    compute.params.dest_y = normalized_my;
   }
 
-  // Map uniform buffer and update it
-  wgpu_queue_write_buffer(wgpu_context, compute.uniform_buffer.buffer, 0,
-                          &compute.ubo, compute.uniform_buffer.size);
+  wgpu_particles_set_params(compute.particles, &compute.params);
 }
 
 // Prepare and initialize uniform buffer containing shader uniforms
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
 {
   // Initialize the uniform buffer block
-  compute.ubo.particle_count = PARTICLE_COUNT;
-
-  // Compute shader uniform buffer block
-  compute.uniform_buffer = wgpu_create_buffer(
-    context->wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-      .size  = sizeof(compute.ubo),
-    });
+  compute.params.lifetime = PARTICLE_LIFETIME;
 
   update_uniform_buffers(context);
 }
@@ -268,17 +569,25 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
       .depth_write_enabled = false,
     });
 
-  // Vertex buffer layout
-  WGPU_VERTEX_BUFFER_LAYOUT(
-    particle, sizeof(particle_t),
-    // Attribute descriptions
-    // Describes memory layout and shader positions
-    // Attribute location 0: Position
-    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x2,
-                       offsetof(particle_t, pos)),
-    // Attribute location 1: Gradient position
-    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x4,
-                       offsetof(particle_t, gradient_pos)))
+  // Vertex buffer layouts, one per drawn particle stream. The vertex fetch
+  // unpacks the packed streams, the vertex shader only reads the gradient
+  // texture coordinate
+  const WGPUVertexFormat position_format = packed_particles ?
+                                             WGPUVertexFormat_Snorm16x2 :
+                                             WGPUVertexFormat_Float32x2;
+  const WGPUVertexFormat gradient_format = packed_particles ?
+                                             WGPUVertexFormat_Unorm16x2 :
+                                             WGPUVertexFormat_Float32x4;
+  // Attribute location 0: Position
+  WGPU_VERTEX_BUFFER_LAYOUT(position, get_position_size(),
+                            WGPU_VERTATTR_DESC(0, position_format, 0))
+  // Attribute location 1: Gradient position
+  WGPU_VERTEX_BUFFER_LAYOUT(gradient, get_gradient_size(),
+                            WGPU_VERTATTR_DESC(1, gradient_format, 0))
+  WGPUVertexBufferLayout buffers[2] = {
+    [PARTICLE_STREAM_POSITIONS] = position_vertex_buffer_layout,
+    [PARTICLE_STREAM_GRADIENTS] = gradient_vertex_buffer_layout,
+  };
 
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
@@ -287,8 +596,8 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
                   // Vertex shader SPIR-V
                   .file = "shaders/compute_particles/particle.vert.spv",
                 },
-                .buffer_count = 1,
-                .buffers      = &particle_vertex_buffer_layout,
+                .buffer_count = (uint32_t)ARRAY_SIZE(buffers),
+                .buffers      = buffers,
               });
 
   // Fragment state
@@ -374,96 +683,12 @@ static void prepare_graphics(wgpu_example_context_t* context)
   setup_render_pass(wgpu_context);
 }
 
-static void prepare_compute(wgpu_context_t* wgpu_context)
-{
-  /* Compute pipeline layout */
-  WGPUBindGroupLayoutEntry bgl_entries[2] = {
-    [0] = (WGPUBindGroupLayoutEntry) {
-      // Binding 0 : Particle position storage buffer
-      .binding    = 0,
-      .visibility = WGPUShaderStage_Compute,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_Storage,
-        .minBindingSize = PARTICLE_COUNT * sizeof(particle_t),
-      },
-      .sampler = {0},
-    },
-    [1] = (WGPUBindGroupLayoutEntry) {
-      // Binding 1 : Uniform buffer
-      .binding    = 1,
-      .visibility = WGPUShaderStage_Compute,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_Uniform,
-        .minBindingSize = sizeof(compute.ubo),
-      },
-      .sampler = {0},
-    }
-  };
-  WGPUBindGroupLayoutDescriptor bgl_desc = {
-    .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-    .entries    = bgl_entries,
-  };
-  compute.bind_group_layout
-    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
-  ASSERT(compute.bind_group_layout != NULL)
-
-  WGPUPipelineLayoutDescriptor compute_pipeline_layout_desc = {
-    .bindGroupLayoutCount = 1,
-    .bindGroupLayouts     = &compute.bind_group_layout,
-  };
-  compute.pipeline_layout = wgpuDeviceCreatePipelineLayout(
-    wgpu_context->device, &compute_pipeline_layout_desc);
-  ASSERT(compute.pipeline_layout != NULL)
-
-  /* Compute pipeline bind group */
-  WGPUBindGroupEntry bg_entries[2] = {
-    [0] = (WGPUBindGroupEntry) {
-      // Binding 0 : Particle position storage buffer
-      .binding = 0,
-      .buffer  = compute.storage_buffer.buffer,
-      .size    = compute.storage_buffer.size,
-    },
-    [1] = (WGPUBindGroupEntry) {
-     // Binding 1 : Uniform buffer
-      .binding = 1,
-      .buffer  = compute.uniform_buffer.buffer,
-      .offset  = 0,
-      .size    = compute.uniform_buffer.size,
-    },
-  };
-  WGPUBindGroupDescriptor bg_desc = {
-    .layout     = compute.bind_group_layout,
-    .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-    .entries    = bg_entries,
-  };
-  compute.bind_group
-    = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-
-  /* Compute shader */
-  wgpu_shader_t particle_comp_shader = wgpu_shader_create(
-    wgpu_context, &(wgpu_shader_desc_t){
-                    // Compute shader SPIR-V
-                    .file = "shaders/compute_particles/particle.comp.spv",
-                  });
-
-  /* Create pipeline */
-  compute.pipeline = wgpuDeviceCreateComputePipeline(
-    wgpu_context->device,
-    &(WGPUComputePipelineDescriptor){
-      .layout  = compute.pipeline_layout,
-      .compute = particle_comp_shader.programmable_stage_descriptor,
-    });
-
-  /* Partial clean-up */
-  wgpu_shader_release(&particle_comp_shader);
-}
-
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
+    render_states.enabled = context->simulation.settings.async_compute;
     load_assets(context->wgpu_context);
     prepare_graphics(context);
-    prepare_compute(context->wgpu_context);
     prepared = true;
     return 0;
   }
@@ -476,30 +701,98 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Attach attractor to cursor",
                            &attach_to_cursor);
+    imgui_overlay_slider_float(context->imgui_overlay, "Emission rate",
+                               &emission_rate, 0.0f, 2.0f);
+    imgui_overlay_checkBox(context->imgui_overlay, "Sort back to front",
+                           &sort_particles);
   }
 }
 
-static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
+// Compute pass: Emit, compute particle movement and compact the lists, once
+// per step of the frame
+static void record_steps(wgpu_example_context_t* context,
+                         WGPUCommandEncoder cmd_enc)
 {
+  wgpu_context_t* wgpu_context     = context->wgpu_context;
+  WGPUComputePassEncoder cpass_enc = wgpu_context->cpass_enc
+    = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  for (uint32_t step = 0; step < context->simulation.step_count; ++step) {
+    wgpu_particles_record_step(compute.particles, cpass_enc);
+  }
+  if (sort_particles) {
+    wgpu_particles_record_sort(compute.particles, cpass_enc);
+  }
+  wgpuComputePassEncoderEnd(cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+}
+
+// Async compute: the steps and the copy of the drawn buffers into the render
+// state that is not drawn, in a command buffer of their own
+static WGPUCommandBuffer
+build_simulation_command_buffer(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  record_steps(context, cmd_enc);
+  const uint32_t write = context->simulation.write_index;
+  const wgpu_buffer_t* sources[4] = {
+    wgpu_particles_get_stream(compute.particles, PARTICLE_STREAM_POSITIONS),
+    wgpu_particles_get_stream(compute.particles, PARTICLE_STREAM_GRADIENTS),
+    wgpu_particles_get_live_indices(compute.particles),
+    wgpu_particles_get_draw_indirect(compute.particles),
+  };
+  const wgpu_buffer_t* destinations[4] = {
+    &render_states.states[write].positions,
+    &render_states.states[write].gradients,
+    &render_states.states[write].live_indices,
+    &render_states.states[write].draw_indirect,
+  };
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(sources); ++i) {
+    wgpuCommandEncoderCopyBufferToBuffer(cmd_enc, sources[i]->buffer, 0,
+                                         destinations[i]->buffer, 0,
+                                         sources[i]->size);
+  }
+
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  ASSERT(command_buffer != NULL)
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+
+  return command_buffer;
+}
+
+static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context          = context->wgpu_context;
   render_pass.color_attachments[0].view = wgpu_context->swap_chain.frame_buffer;
 
   // Create command encoder
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  // Compute pass: Compute particle movement
-  {
-    wgpu_context->cpass_enc
-      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    // Dispatch the compute job
-    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
-                                      compute.pipeline);
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
-                                       compute.bind_group, 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(wgpu_context->cpass_enc,
-                                             PARTICLE_COUNT / 256, 1, 1);
-    wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
-    WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  // The steps were submitted ahead with async compute
+  if (context->simulation.step_count > 0 && !render_states.enabled) {
+    record_steps(context, wgpu_context->cmd_enc);
+  }
+
+  // Buffers the render pass draws
+  WGPUBuffer positions
+    = wgpu_particles_get_stream(compute.particles, PARTICLE_STREAM_POSITIONS)
+        ->buffer;
+  WGPUBuffer gradients
+    = wgpu_particles_get_stream(compute.particles, PARTICLE_STREAM_GRADIENTS)
+        ->buffer;
+  WGPUBuffer live_indices
+    = wgpu_particles_get_live_indices(compute.particles)->buffer;
+  WGPUBuffer draw_indirect
+    = wgpu_particles_get_draw_indirect(compute.particles)->buffer;
+  if (render_states.enabled) {
+    const uint32_t read = context->simulation.read_index;
+    positions           = render_states.states[read].positions.buffer;
+    gradients           = render_states.states[read].gradients.buffer;
+    live_indices        = render_states.states[read].live_indices.buffer;
+    draw_indirect       = render_states.states[read].draw_indirect.buffer;
   }
 
   // Render pass: Draw the particle system using the update vertex buffer
@@ -510,10 +803,18 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                      graphics.pipeline);
     wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
                                       graphics.bind_group, 0, 0);
-    wgpuRenderPassEncoderSetVertexBuffer(wgpu_context->rpass_enc, 0,
-                                         compute.storage_buffer.buffer, 0,
-                                         WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, PARTICLE_COUNT, 1, 0, 0);
+    wgpuRenderPassEncoderSetVertexBuffer(wgpu_context->rpass_enc,
+                                         PARTICLE_STREAM_POSITIONS, positions,
+                                         0, WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderSetVertexBuffer(wgpu_context->rpass_enc,
+                                         PARTICLE_STREAM_GRADIENTS, gradients,
+                                         0, WGPU_WHOLE_SIZE);
+    // Only the live particles are drawn
+    wgpuRenderPassEncoderSetIndexBuffer(wgpu_context->rpass_enc, live_indices,
+                                        WGPUIndexFormat_Uint32, 0,
+                                        WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderDrawIndexedIndirect(wgpu_context->rpass_enc,
+                                             draw_indirect, 0);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
   }
@@ -535,11 +836,16 @@ static int example_draw(wgpu_example_context_t* context)
   // Prepare frame
   prepare_frame(context);
 
+  // With async compute the steps are submitted first
+  if (render_states.enabled && context->simulation.step_count > 0) {
+    submit_simulation_command_buffer(context,
+                                     build_simulation_command_buffer(context));
+  }
+
   // Command buffer to be submitted to the queue
   wgpu_context_t* wgpu_context                   = context->wgpu_context;
   wgpu_context->submit_info.command_buffer_count = 1;
-  wgpu_context->submit_info.command_buffers[0]
-    = build_command_buffer(context->wgpu_context);
+  wgpu_context->submit_info.command_buffers[0] = build_command_buffer(context);
 
   // Submit to queue
   submit_command_buffers(context);
@@ -555,23 +861,27 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
-  int result = example_draw(context);
 
+  // The attractor moves with the simulated time
+  const float simulated_time
+    = context->simulation.step_time * (float)context->simulation.step_count;
   if (!attach_to_cursor) {
     if (animStart > 0.0f) {
-      animStart -= context->frame_timer * 5.0f;
+      animStart -= simulated_time * 5.0f;
     }
     else if (animStart <= 0.0f) {
-      timer += context->frame_timer * 0.04f;
+      timer += simulated_time * 0.04f;
       if (timer > 1.f) {
         timer = 0.f;
       }
     }
   }
 
-  update_uniform_buffers(context);
+  if (context->simulation.step_count > 0) {
+    update_uniform_buffers(context);
+  }
 
-  return result;
+  return example_draw(context);
 }
 
 static void example_destroy(wgpu_example_context_t* context)
@@ -588,17 +898,24 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(PipelineLayout, graphics.pipeline_layout)
   WGPU_RELEASE_RESOURCE(RenderPipeline, graphics.pipeline)
 
-  // Compute pipeline
-  WGPU_RELEASE_RESOURCE(Buffer, compute.storage_buffer.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, compute.uniform_buffer.buffer)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, compute.bind_group_layout)
-  WGPU_RELEASE_RESOURCE(BindGroup, compute.bind_group)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, compute.pipeline_layout)
-  WGPU_RELEASE_RESOURCE(ComputePipeline, compute.pipeline)
+  // Particle system
+  wgpu_particles_release(compute.particles);
+  for (uint32_t i = 0; render_states.enabled && i < 2; ++i) {
+    wgpu_destroy_buffer(&render_states.states[i].positions);
+    wgpu_destroy_buffer(&render_states.states[i].gradients);
+    wgpu_destroy_buffer(&render_states.states[i].live_indices);
+    wgpu_destroy_buffer(&render_states.states[i].draw_indirect);
+  }
 }
 
 void example_compute_particles(int argc, char* argv[])
 {
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--packed") == 0) {
+      packed_particles = true;
+    }
+  }
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
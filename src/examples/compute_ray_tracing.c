@@ -3,6 +3,9 @@
 
 #include <string.h>
 
+#include "../webgpu/bvh.h"
+#include "../webgpu/gltf_model.h"
+#include "../webgpu/gpu_sort.h"
 #include "../webgpu/imgui_overlay.h"
 
 /* -------------------------------------------------------------------------- *
@@ -11,6 +14,18 @@
  * Simple GPU ray tracer with shadows and reflections using a compute shader. No
  * scene geometry is rendered in the graphics pass.
  *
+ * Besides the analytic spheres and planes the scene contains a triangle mesh
+ * loaded from a glTF file, which the compute shader intersects through a
+ * bounding volume hierarchy with a stackless traversal. Another model can be
+ * traced with --model=<file.gltf>.
+ *
+ * While the camera and the scene are still, the samples of the following
+ * frames are jittered over the pixel and the light volume and accumulated,
+ * which converges to an antialiased image with soft shadows. After every
+ * frame the noise of each 16x16 tile is estimated from the variance of its
+ * samples, only the tiles that have not converged are traced in the next
+ * frame with an indirect dispatch.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/computeraytracing
  * -------------------------------------------------------------------------- */
@@ -23,10 +38,45 @@
 #define TEX_DIM 2048
 #endif
 
+// Largest extent of the mesh in the scene
+#define MESH_SIZE 2.0f
+
+// Adaptive sampling
+#define TILE_SIZE 16u
+
 static texture_t texture_compute_target = {0};
 static uint32_t current_id
   = 0; // Id used to identify objects by the ray tracing shader
 
+// Triangle mesh of the scene
+static struct {
+  const char* filename;
+  wgpu_bvh_t* bvh;
+  wgpu_bvh_stats_t stats;
+} mesh = {
+  .filename = "models/chinesedragon.gltf",
+};
+
+// Progressive accumulation and adaptive sampling
+static struct {
+  wgpu_buffer_t colors;            // Sum of the samples and their count
+  wgpu_buffer_t moments;           // Sum of the squared sample luminances
+  wgpu_buffer_t tile_flags;        // 1 for the tiles that are still noisy
+  wgpu_buffer_t tile_indices;      // 0 to tile_count - 1
+  wgpu_buffer_t active_tiles;      // Compacted noisy tiles
+  wgpu_buffer_t dispatch_indirect; // Workgroup count of the noisy tiles
+  wgpu_gpu_sort_t* gpu_sort;
+  uint32_t tiles_x;
+  uint32_t tile_count;
+  uint32_t frame_count; // Frames accumulated since the last reset
+  bool progressive;
+  bool adaptive;
+  bool changed; // Settings changed, restart the accumulation
+} accumulation = {
+  .progressive = true,
+  .adaptive    = true,
+};
+
 // Resources for the graphics part of the example
 static struct {
   WGPUBindGroupLayout
@@ -54,15 +104,33 @@ static struct {
   WGPUBindGroup bind_group;              // Compute shader bindings
   WGPUPipelineLayout pipeline_layout;    // Layout of the compute pipeline
   WGPUComputePipeline pipeline;          // Compute raytracing pipeline
+  WGPUComputePipeline tiles_pipeline;    // Raytracing of the noisy tiles
+  WGPUComputePipeline variance_pipeline; // Noise estimation of the tiles
   struct compute_ubo_t {                 // Compute shader uniform block object
     vec3 lightPos;
     float aspectRatio; // Aspect ratio of the viewport
     vec4 fogColor;
     struct {
       vec3 pos;
+      float padding;
       vec3 lookat;
       float fov;
     } camera;
+    struct {
+      vec3 diffuse;
+      float specular;
+      uint32_t id; // Id used to identify the mesh for raytracing
+      uint32_t padding[3];
+    } mesh;
+    struct {
+      uint32_t frame_index; // Sample index since the last reset
+      uint32_t reset;       // First sample, traced for all tiles
+      float light_radius;   // Extent of the sampled light volume
+      float error_threshold; // Relative error of converged tiles
+      uint32_t max_sample_count;
+      uint32_t tiles_x;
+      uint32_t padding[2];
+    } sampling;
   } ubo;
 } compute;
 
@@ -92,6 +160,304 @@ typedef struct plane_t {
   int32_t _pad[3];
 } plane_t;
 
+// clang-format off
+static const char* ray_tracing_shader_wgsl = CODE(
+  struct Camera {
+    pos : vec3<f32>,
+    lookat : vec3<f32>,
+    fov : f32,
+  };
+
+  struct Mesh {
+    diffuse : vec3<f32>,
+    specular : f32,
+    id : u32,
+  };
+
+  struct Sampling {
+    frameIndex : u32,
+    reset : u32,
+    lightRadius : f32,
+    errorThreshold : f32,
+    maxSampleCount : u32,
+    tilesX : u32,
+  };
+
+  struct UBO {
+    lightPos : vec3<f32>,
+    aspectRatio : f32,
+    fogColor : vec4<f32>,
+    camera : Camera,
+    mesh : Mesh,
+    sampling : Sampling,
+  };
+
+  struct Sphere {
+    pos : vec3<f32>,
+    radius : f32,
+    diffuse : vec3<f32>,
+    specular : f32,
+    id : u32,
+  };
+
+  struct Plane {
+    normal : vec3<f32>,
+    distance : f32,
+    diffuse : vec3<f32>,
+    specular : f32,
+    id : u32,
+  };
+
+  struct Hit {
+    id : i32,
+    t : f32,
+    normal : vec3<f32>,
+    diffuse : vec3<f32>,
+    specular : f32,
+  };
+
+  @group(0) @binding(0) var resultImage : texture_storage_2d<rgba8unorm, write>;
+  @group(0) @binding(1) var<uniform> ubo : UBO;
+  @group(0) @binding(2) var<storage, read> spheres : array<Sphere>;
+  @group(0) @binding(3) var<storage, read> planes : array<Plane>;
+  @group(0) @binding(4) var<storage, read> bvhNodes : array<BvhNode>;
+  @group(0) @binding(5) var<storage, read> bvhTriangles : array<BvhTriangle>;
+  @group(0) @binding(6) var<storage, read_write> colors : array<vec4<f32>>;
+  @group(0) @binding(7) var<storage, read_write> moments : array<f32>;
+  @group(0) @binding(8) var<storage, read_write> tileFlags : array<u32>;
+  @group(0) @binding(9) var<storage, read> activeTiles : array<u32>;
+
+  // Light position of the current sample
+  var<private> lightPos : vec3<f32>;
+  var<private> rngState : u32;
+
+  var<workgroup> tileErrors : array<f32, 256>;
+
+  fn random() -> f32 {
+    var x = rngState * 747796405u + 2891336453u;
+    x = ((x >> ((x >> 28u) + 4u)) ^ x) * 277803737u;
+    rngState = (x >> 22u) ^ x;
+    return f32(rngState) / 4294967295.0;
+  }
+
+  fn luminance(color : vec3<f32>) -> f32 {
+    return dot(color, vec3<f32>(0.2126, 0.7152, 0.0722));
+  }
+
+  fn reflectRay(rayD : vec3<f32>, normal : vec3<f32>) -> vec3<f32> {
+    return rayD + 2.0 * -dot(normal, rayD) * normal;
+  }
+
+  fn lightDiffuse(normal : vec3<f32>, lightDir : vec3<f32>) -> f32 {
+    return clamp(dot(normal, lightDir), 0.1, 1.0);
+  }
+
+  fn lightSpecular(normal : vec3<f32>, lightDir : vec3<f32>,
+                   specularFactor : f32) -> f32 {
+    let viewVec = normalize(ubo.camera.pos);
+    let halfVec = normalize(lightDir + viewVec);
+    return pow(clamp(dot(normal, halfVec), 0.0, 1.0), specularFactor);
+  }
+
+  fn sphereIntersect(rayO : vec3<f32>, rayD : vec3<f32>,
+                     sphere : Sphere) -> f32 {
+    let oc = rayO - sphere.pos;
+    let b = 2.0 * dot(oc, rayD);
+    let c = dot(oc, oc) - sphere.radius * sphere.radius;
+    let h = b * b - 4.0 * c;
+    if (h < 0.0) {
+      return -1.0;
+    }
+    return (-b - sqrt(h)) / 2.0;
+  }
+
+  fn planeIntersect(rayO : vec3<f32>, rayD : vec3<f32>, plane : Plane) -> f32 {
+    let d = dot(rayD, plane.normal);
+    if (d == 0.0) {
+      return 0.0;
+    }
+    let t = -(plane.distance + dot(rayO, plane.normal)) / d;
+    return max(t, 0.0);
+  }
+
+  fn intersect(rayO : vec3<f32>, rayD : vec3<f32>) -> Hit {
+    var hit : Hit;
+    hit.id = -1;
+    hit.t = 1000.0;
+    for (var i = 0u; i < arrayLength(&spheres); i = i + 1u) {
+      let tSphere = sphereIntersect(rayO, rayD, spheres[i]);
+      if (tSphere > 0.0001 && tSphere < hit.t) {
+        hit.id = i32(spheres[i].id);
+        hit.t = tSphere;
+        hit.normal = (rayO + tSphere * rayD - spheres[i].pos)
+                     / spheres[i].radius;
+        hit.diffuse = spheres[i].diffuse;
+        hit.specular = spheres[i].specular;
+      }
+    }
+    for (var i = 0u; i < arrayLength(&planes); i = i + 1u) {
+      let tPlane = planeIntersect(rayO, rayD, planes[i]);
+      if (tPlane > 0.0001 && tPlane < hit.t) {
+        hit.id = i32(planes[i].id);
+        hit.t = tPlane;
+        hit.normal = planes[i].normal;
+        hit.diffuse = planes[i].diffuse;
+        hit.specular = planes[i].specular;
+      }
+    }
+    // Only hits closer than the analytic primitives are searched for
+    let meshHit = bvhIntersect(rayO, rayD, 0.0001, hit.t);
+    if (meshHit.triangle != 0xffffffffu) {
+      let normal = bvhTriangleNormal(meshHit.triangle);
+      hit.id = i32(ubo.mesh.id);
+      hit.t = meshHit.t;
+      hit.normal = select(normal, -normal, dot(normal, rayD) > 0.0);
+      hit.diffuse = ubo.mesh.diffuse;
+      hit.specular = ubo.mesh.specular;
+    }
+    return hit;
+  }
+
+  fn calcShadow(rayO : vec3<f32>, rayD : vec3<f32>, objectId : i32,
+                t : ptr<function, f32>) -> f32 {
+    for (var i = 0u; i < arrayLength(&spheres); i = i + 1u) {
+      if (i32(spheres[i].id) == objectId) {
+        continue;
+      }
+      let tSphere = sphereIntersect(rayO, rayD, spheres[i]);
+      if (tSphere > 0.0001 && tSphere < *t) {
+        *t = tSphere;
+        return 0.5;
+      }
+    }
+    if (bvhOccluded(rayO, rayD, 0.001, *t)) {
+      return 0.5;
+    }
+    return 1.0;
+  }
+
+  fn fog(t : f32, color : vec3<f32>) -> vec3<f32> {
+    return mix(color, ubo.fogColor.rgb, vec3<f32>(clamp(abs(t) / 20.0, 0.0,
+                                                        1.0)));
+  }
+
+  fn renderScene(rayO : ptr<function, vec3<f32>>,
+                 rayD : ptr<function, vec3<f32>>,
+                 id : ptr<function, i32>) -> vec3<f32> {
+    let hit = intersect(*rayO, *rayD);
+    if (hit.id == -1) {
+      return vec3<f32>(0.0);
+    }
+    let pos = *rayO + hit.t * (*rayD);
+    let lightVec = normalize(lightPos - pos);
+    let diffuse = lightDiffuse(hit.normal, lightVec);
+    let specular = lightSpecular(hit.normal, lightVec, hit.specular);
+    var color = diffuse * hit.diffuse + specular;
+    if (*id == -1) {
+      return color;
+    }
+    *id = hit.id;
+    // Shadows
+    var t = length(lightPos - pos);
+    color = color * calcShadow(pos, lightVec, *id, &t);
+    // Fog
+    color = fog(t, color);
+    // Reflect ray for next render pass
+    *rayD = reflectRay(*rayD, hit.normal);
+    *rayO = pos;
+    return color;
+  }
+
+  // Traces one sample of the pixel and adds it to the accumulated ones
+  fn tracePixel(pixel : vec2<u32>) {
+    let dim = vec2<f32>(textureDimensions(resultImage));
+    let index = pixel.y * u32(dim.x) + pixel.x;
+    // The first sample goes through the pixel corner and the light center,
+    // the following ones are jittered
+    rngState = index * 1973u + ubo.sampling.frameIndex * 9277u;
+    var jitter = vec2<f32>(0.0);
+    lightPos = ubo.lightPos;
+    if (ubo.sampling.frameIndex > 0u) {
+      jitter = vec2<f32>(random(), random());
+      lightPos = lightPos + (vec3<f32>(random(), random(), random()) * 2.0
+                             - 1.0) * ubo.sampling.lightRadius;
+    }
+    let uv = (vec2<f32>(pixel) + jitter) / dim;
+    var rayO = ubo.camera.pos;
+    var rayD = normalize(vec3<f32>((-1.0 + 2.0 * uv)
+                                     * vec2<f32>(ubo.aspectRatio, 1.0),
+                                   -1.0));
+    // Basic color path
+    var id = 0;
+    var finalColor = renderScene(&rayO, &rayD, &id);
+    // Reflection
+    var reflectionStrength = 0.4;
+    for (var i = 0; i < 2; i = i + 1) {
+      let reflectionColor = renderScene(&rayO, &rayD, &id);
+      finalColor = (1.0 - reflectionStrength) * finalColor
+                   + reflectionStrength
+                       * mix(reflectionColor, finalColor,
+                             vec3<f32>(1.0 - reflectionStrength));
+      reflectionStrength = reflectionStrength * 0.5;
+    }
+    var color = vec4<f32>(finalColor, 1.0);
+    var moment = luminance(finalColor) * luminance(finalColor);
+    if (ubo.sampling.reset == 0u) {
+      color = color + colors[index];
+      moment = moment + moments[index];
+    }
+    colors[index] = color;
+    moments[index] = moment;
+    textureStore(resultImage, vec2<i32>(pixel),
+                 vec4<f32>(color.rgb / color.w, 0.0));
+  }
+
+  @compute @workgroup_size(16, 16)
+  fn main(@builtin(global_invocation_id) globalId : vec3<u32>) {
+    tracePixel(globalId.xy);
+  }
+
+  // One workgroup per noisy tile
+  @compute @workgroup_size(16, 16)
+  fn cs_trace_tiles(@builtin(workgroup_id) workgroupId : vec3<u32>,
+                    @builtin(local_invocation_id) localId : vec3<u32>) {
+    let tile = activeTiles[workgroupId.x];
+    let tileOrigin = vec2<u32>(tile % ubo.sampling.tilesX,
+                               tile / ubo.sampling.tilesX) * 16u;
+    tracePixel(tileOrigin + localId.xy);
+  }
+
+  // A tile stays noisy while the largest relative standard error of the pixel
+  // means is above the threshold
+  @compute @workgroup_size(16, 16)
+  fn cs_tile_variance(@builtin(global_invocation_id) globalId : vec3<u32>,
+                      @builtin(workgroup_id) workgroupId : vec3<u32>,
+                      @builtin(local_invocation_index) localIndex : u32) {
+    let index = globalId.y * ubo.sampling.tilesX * 16u + globalId.x;
+    let color = colors[index];
+    let mean = luminance(color.rgb / color.w);
+    let variance = max(moments[index] / color.w - mean * mean, 0.0) / color.w;
+    tileErrors[localIndex] = sqrt(variance) / (mean + 0.01);
+    workgroupBarrier();
+    for (var stride = 128u; stride > 0u; stride = stride >> 1u) {
+      if (localIndex < stride) {
+        tileErrors[localIndex] = max(tileErrors[localIndex],
+                                     tileErrors[localIndex + stride]);
+      }
+      workgroupBarrier();
+    }
+    if (localIndex == 0u) {
+      let sampleCount = u32(color.w);
+      let noisy = sampleCount < 4u
+                  || (tileErrors[0] > ubo.sampling.errorThreshold
+                      && sampleCount < ubo.sampling.maxSampleCount);
+      tileFlags[workgroupId.y * ubo.sampling.tilesX + workgroupId.x]
+        = select(0u, 1u, noisy);
+    }
+  }
+);
+// clang-format on
+
 // Other variables
 static const char* example_title = "Compute Shader Ray Tracing";
 static bool prepared             = false;
@@ -223,6 +589,11 @@ static void prepare_storage_buffers(wgpu_context_t* wgpu_context)
              (vec3){1.0f, 0.0f, 0.0f}, 32.0f);
   init_plane(&planes[5], (vec3){1.0f, 0.0f, 0.0f}, room_dim,
              (vec3){0.0f, 1.0f, 0.0f}, 32.0f);
+
+  // Mesh
+  compute.ubo.mesh.id = current_id++;
+  glm_vec3_copy((vec3){0.85f, 0.55f, 0.25f}, compute.ubo.mesh.diffuse);
+  compute.ubo.mesh.specular = 32.0f;
   storage_buffer_size = ARRAY_SIZE(planes) * sizeof(plane_t);
 
   // Stage
@@ -237,6 +608,125 @@ static void prepare_storage_buffers(wgpu_context_t* wgpu_context)
                   });
 }
 
+// Load the triangles of the mesh, fit them into the scene and build their BVH
+static void prepare_mesh(wgpu_context_t* wgpu_context)
+{
+  struct gltf_model_t* model
+    = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
+      .wgpu_context       = wgpu_context,
+      .filename           = mesh.filename,
+      .file_loading_flags = WGPU_GLTF_FileLoadingFlags_DontLoadImages
+                            | WGPU_GLTF_FileLoadingFlags_KeepTriangles
+                            | WGPU_GLTF_FileLoadingFlags_UseCache,
+    });
+  wgpu_gltf_triangles_t triangles = {0};
+  if (model == NULL || !wgpu_gltf_model_get_triangles(model, &triangles)) {
+    log_warn("Could not load the mesh %s\n", mesh.filename);
+  }
+
+  // Center the mesh above the floor in front of the spheres, flipped
+  // like them
+  float* positions = malloc(MAX(triangles.vertex_count, 1u) * sizeof(vec3));
+  vec3 min = {FLT_MAX, FLT_MAX, FLT_MAX}, max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (uint32_t i = 0; i < triangles.vertex_count; ++i) {
+    glm_vec3_minv(min, (float*)&triangles.positions[i * 3], min);
+    glm_vec3_maxv(max, (float*)&triangles.positions[i * 3], max);
+  }
+  vec3 center = GLM_VEC3_ZERO_INIT, extent = GLM_VEC3_ZERO_INIT;
+  glm_vec3_center(min, max, center);
+  glm_vec3_sub(max, min, extent);
+  const float scale = MESH_SIZE / MAX(glm_vec3_max(extent), FLT_EPSILON);
+  const vec3 target = {0.0f, -1.25f, 1.0f};
+  for (uint32_t i = 0; i < triangles.vertex_count; ++i) {
+    for (uint32_t c = 0; c < 3; ++c) {
+      positions[i * 3 + c]
+        = (triangles.positions[i * 3 + c] - center[c]) * scale + target[c];
+    }
+    positions[i * 3 + 1] *= -1.0f; // flip y
+  }
+
+  mesh.bvh = wgpu_bvh_create(
+    wgpu_context, &(wgpu_bvh_desc_t){
+                    .positions    = positions,
+                    .vertex_count = triangles.vertex_count,
+                    .indices      = triangles.indices,
+                    .index_count  = triangles.index_count,
+                  });
+  wgpu_bvh_get_stats(mesh.bvh, &mesh.stats);
+
+  free(positions);
+  wgpu_gltf_model_destroy(model);
+}
+
+// Buffers of the accumulated samples and of the noisy tiles
+static void prepare_accumulation(wgpu_context_t* wgpu_context)
+{
+  const uint32_t pixel_count
+    = texture_compute_target.size.width * texture_compute_target.size.height;
+  accumulation.tiles_x    = texture_compute_target.size.width / TILE_SIZE;
+  accumulation.tile_count = accumulation.tiles_x
+                            * (texture_compute_target.size.height / TILE_SIZE);
+
+  accumulation.colors = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "accumulation_colors_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = pixel_count * sizeof(vec4),
+                  });
+  accumulation.moments = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "accumulation_moments_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = pixel_count * sizeof(float),
+                  });
+  accumulation.tile_flags = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "accumulation_tile_flags_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = accumulation.tile_count * sizeof(uint32_t),
+                  });
+  accumulation.active_tiles = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "accumulation_active_tiles_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = accumulation.tile_count * sizeof(uint32_t),
+                  });
+
+  uint32_t* tile_indices = malloc(accumulation.tile_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < accumulation.tile_count; ++i) {
+    tile_indices[i] = i;
+  }
+  accumulation.tile_indices = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label        = "accumulation_tile_indices_buffer",
+                    .usage        = WGPUBufferUsage_Storage,
+                    .size         = accumulation.tile_count * sizeof(uint32_t),
+                    .initial.data = tile_indices,
+                  });
+  free(tile_indices);
+
+  // Workgroup count x, y and z, the compaction writes x
+  const uint32_t dispatch_indirect[3] = {0, 1, 1};
+  accumulation.dispatch_indirect      = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                         .label = "accumulation_dispatch_indirect_buffer",
+                         .usage = WGPUBufferUsage_Storage
+                                  | WGPUBufferUsage_Indirect,
+                         .size         = sizeof(dispatch_indirect),
+                         .initial.data = dispatch_indirect,
+                       });
+
+  accumulation.gpu_sort = wgpu_gpu_sort_create(
+    wgpu_context, &(wgpu_gpu_sort_desc_t){
+                    .max_element_count = accumulation.tile_count,
+                  });
+
+  compute.ubo.sampling.tiles_x          = accumulation.tiles_x;
+  compute.ubo.sampling.light_radius     = 0.25f;
+  compute.ubo.sampling.error_threshold  = 0.02f;
+  compute.ubo.sampling.max_sample_count = 1024;
+}
+
 static void setup_render_pass(wgpu_context_t* wgpu_context)
 {
   UNUSED_VAR(wgpu_context);
@@ -406,7 +896,7 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
 static void prepare_compute(wgpu_context_t* wgpu_context)
 {
   /* Compute pipeline layout */
-  WGPUBindGroupLayoutEntry bgl_entries[4] = {
+  WGPUBindGroupLayoutEntry bgl_entries[10] = {
     [0] = (WGPUBindGroupLayoutEntry) {
       // Binding 0 : Storage image (raytraced output)
       .binding    = 0,
@@ -433,7 +923,7 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
       .binding    = 2,
       .visibility = WGPUShaderStage_Compute,
       .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_Storage,
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
         .minBindingSize = compute.storage_buffers.spheres.size,
       },
       .sampler = {0},
@@ -443,11 +933,71 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
       .binding    = 3,
       .visibility = WGPUShaderStage_Compute,
       .buffer = (WGPUBufferBindingLayout) {
-        .type           = WGPUBufferBindingType_Storage,
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
         .minBindingSize = compute.storage_buffers.planes.size,
       },
       .sampler = {0},
     },
+    [4] = (WGPUBindGroupLayoutEntry) {
+      // Binding 4: Shader storage buffer for the mesh BVH nodes
+      .binding    = 4,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = 0,
+      },
+      .sampler = {0},
+    },
+    [5] = (WGPUBindGroupLayoutEntry) {
+      // Binding 5: Shader storage buffer for the mesh triangles
+      .binding    = 5,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = 0,
+      },
+      .sampler = {0},
+    },
+    [6] = (WGPUBindGroupLayoutEntry) {
+      // Binding 6: Shader storage buffer for the accumulated samples
+      .binding    = 6,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = accumulation.colors.size,
+      },
+      .sampler = {0},
+    },
+    [7] = (WGPUBindGroupLayoutEntry) {
+      // Binding 7: Shader storage buffer for the accumulated moments
+      .binding    = 7,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = accumulation.moments.size,
+      },
+      .sampler = {0},
+    },
+    [8] = (WGPUBindGroupLayoutEntry) {
+      // Binding 8: Shader storage buffer for the noisy tile flags
+      .binding    = 8,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = accumulation.tile_flags.size,
+      },
+      .sampler = {0},
+    },
+    [9] = (WGPUBindGroupLayoutEntry) {
+      // Binding 9: Shader storage buffer for the noisy tiles
+      .binding    = 9,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = accumulation.active_tiles.size,
+      },
+      .sampler = {0},
+    },
   };
   WGPUBindGroupLayoutDescriptor bgl_desc = {
     .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
@@ -466,7 +1016,7 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
   ASSERT(compute.pipeline_layout != NULL)
 
   /* Compute pipeline bind group */
-  WGPUBindGroupEntry bg_entries[4] = {
+  WGPUBindGroupEntry bg_entries[10] = {
     [0] = (WGPUBindGroupEntry) {
       // Binding 0: Output storage image
       .binding     = 0,
@@ -493,6 +1043,48 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
       .offset  = 0,
       .size    = compute.storage_buffers.planes.size,
     },
+    [4] = (WGPUBindGroupEntry) {
+     // Binding 4: Shader storage buffer for the mesh BVH nodes
+      .binding = 4,
+      .buffer  = wgpu_bvh_get_node_buffer(mesh.bvh),
+      .offset  = 0,
+      .size    = WGPU_WHOLE_SIZE,
+    },
+    [5] = (WGPUBindGroupEntry) {
+     // Binding 5: Shader storage buffer for the mesh triangles
+      .binding = 5,
+      .buffer  = wgpu_bvh_get_triangle_buffer(mesh.bvh),
+      .offset  = 0,
+      .size    = WGPU_WHOLE_SIZE,
+    },
+    [6] = (WGPUBindGroupEntry) {
+     // Binding 6: Shader storage buffer for the accumulated samples
+      .binding = 6,
+      .buffer  = accumulation.colors.buffer,
+      .offset  = 0,
+      .size    = accumulation.colors.size,
+    },
+    [7] = (WGPUBindGroupEntry) {
+     // Binding 7: Shader storage buffer for the accumulated moments
+      .binding = 7,
+      .buffer  = accumulation.moments.buffer,
+      .offset  = 0,
+      .size    = accumulation.moments.size,
+    },
+    [8] = (WGPUBindGroupEntry) {
+     // Binding 8: Shader storage buffer for the noisy tile flags
+      .binding = 8,
+      .buffer  = accumulation.tile_flags.buffer,
+      .offset  = 0,
+      .size    = accumulation.tile_flags.size,
+    },
+    [9] = (WGPUBindGroupEntry) {
+     // Binding 9: Shader storage buffer for the noisy tiles
+      .binding = 9,
+      .buffer  = accumulation.active_tiles.buffer,
+      .offset  = 0,
+      .size    = accumulation.active_tiles.size,
+    },
   };
   WGPUBindGroupDescriptor bg_desc = {
     .layout     = compute.bind_group_layout,
@@ -502,12 +1094,21 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
   compute.bind_group
     = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
 
-  /* Compute shader */
+  /* Compute shader, prepended with the BVH traversal */
+  const char* bvh_wgsl = wgpu_bvh_get_wgsl_functions();
+  const size_t shader_size
+    = strlen(bvh_wgsl) + strlen(ray_tracing_shader_wgsl) + 2;
+  char* shader_wgsl = malloc(shader_size);
+  snprintf(shader_wgsl, shader_size, "%s\n%s", bvh_wgsl,
+           ray_tracing_shader_wgsl);
   wgpu_shader_t particle_comp_shader = wgpu_shader_create(
     wgpu_context, &(wgpu_shader_desc_t){
-                    // Compute shader SPIR-V
-                    .file = "shaders/compute_ray_tracing/raytracing.comp.spv",
+                    // Compute shader WGSL
+                    .label            = "ray_tracing_compute_shader",
+                    .wgsl_code.source = shader_wgsl,
+                    .entry            = "main",
                   });
+  free(shader_wgsl);
 
   /* Create pipeline */
   compute.pipeline = wgpuDeviceCreateComputePipeline(
@@ -516,6 +1117,27 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
       .layout  = compute.pipeline_layout,
       .compute = particle_comp_shader.programmable_stage_descriptor,
     });
+  ASSERT(compute.pipeline != NULL);
+
+  WGPUProgrammableStageDescriptor stage
+    = particle_comp_shader.programmable_stage_descriptor;
+  stage.entryPoint       = "cs_trace_tiles";
+  compute.tiles_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = "ray_tracing_tiles_pipeline",
+                            .layout  = compute.pipeline_layout,
+                            .compute = stage,
+                          });
+  ASSERT(compute.tiles_pipeline != NULL);
+
+  stage.entryPoint          = "cs_tile_variance";
+  compute.variance_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = "ray_tracing_tile_variance_pipeline",
+                            .layout  = compute.pipeline_layout,
+                            .compute = stage,
+                          });
+  ASSERT(compute.variance_pipeline != NULL);
 
   /* Partial clean-up */
   wgpu_shader_release(&particle_comp_shader);
@@ -525,17 +1147,33 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   const float timer = context->timer;
 
+  // Map uniform buffer and update it
   compute.ubo.lightPos[0]
     = 0.0f + sin(glm_rad(timer * 360.0f)) * cos(glm_rad(timer * 360.0f)) * 2.0f;
   compute.ubo.lightPos[1] = 0.0f + sin(glm_rad(timer * 360.0f)) * 2.0f;
   compute.ubo.lightPos[2] = 0.0f + cos(glm_rad(timer * 360.0f)) * 2.0f;
   glm_vec3_scale(context->camera->position, -1.0f, compute.ubo.camera.pos);
 
-  // Map uniform buffer and update it
   wgpu_queue_write_buffer(context->wgpu_context, compute.uniform_buffer.buffer,
                           0, &compute.ubo, compute.uniform_buffer.size);
 }
 
+// Restart the accumulation when the camera, the scene or the settings change,
+// otherwise add one more sample per pixel
+static void update_sampling(wgpu_example_context_t* context)
+{
+  const bool reset = !context->paused || context->camera->updated
+                     || accumulation.changed || !accumulation.progressive
+                     || accumulation.frame_count == 0;
+  if (reset) {
+    accumulation.frame_count = 0;
+    accumulation.changed     = false;
+  }
+  compute.ubo.sampling.frame_index = accumulation.frame_count++;
+  compute.ubo.sampling.reset       = reset;
+  update_uniform_buffers(context);
+}
+
 // Prepare and initialize uniform buffer containing shader uniforms
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
 {
@@ -564,9 +1202,11 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     prepare_storage_buffers(context->wgpu_context);
+    prepare_mesh(context->wgpu_context);
     prepare_uniform_buffers(context);
     prepare_texture_target(context->wgpu_context, &texture_compute_target,
                            TEX_DIM, TEX_DIM, WGPUTextureFormat_RGBA8Unorm);
+    prepare_accumulation(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
@@ -584,6 +1224,34 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
   }
+  if (imgui_overlay_header("Sampling")) {
+    accumulation.changed
+      |= imgui_overlay_checkBox(context->imgui_overlay,
+                                "Accumulate while still",
+                                &accumulation.progressive);
+    accumulation.changed
+      |= imgui_overlay_checkBox(context->imgui_overlay, "Adaptive sampling",
+                                &accumulation.adaptive);
+    accumulation.changed |= imgui_overlay_slider_float(
+      context->imgui_overlay, "Light radius",
+      &compute.ubo.sampling.light_radius, 0.0f, 1.0f);
+    imgui_overlay_slider_float(context->imgui_overlay, "Error threshold",
+                               &compute.ubo.sampling.error_threshold, 0.001f,
+                               0.1f);
+    int32_t max_sample_count = (int32_t)compute.ubo.sampling.max_sample_count;
+    if (imgui_overlay_slider_int(context->imgui_overlay, "Max samples",
+                                 &max_sample_count, 16, 4096)) {
+      compute.ubo.sampling.max_sample_count = (uint32_t)max_sample_count;
+    }
+    imgui_overlay_text("Frames accumulated: %u", accumulation.frame_count);
+  }
+  if (imgui_overlay_header("Mesh")) {
+    imgui_overlay_text("Triangles: %u", mesh.stats.triangle_count);
+    imgui_overlay_text("BVH nodes: %u, depth %u", mesh.stats.node_count,
+                       mesh.stats.max_depth);
+    imgui_overlay_text("SAH cost: %.2f", mesh.stats.sah_cost);
+    imgui_overlay_text("Build time: %.1f ms", mesh.stats.build_time_ms);
+  }
 }
 
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
@@ -596,17 +1264,35 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 
   // Compute pass: generated ray traced image
   {
-    wgpu_context->cpass_enc
+    WGPUComputePassEncoder cpass_enc = wgpu_context->cpass_enc
       = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    // Dispatch the compute job
-    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
-                                      compute.pipeline);
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
-                                       compute.bind_group, 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      wgpu_context->cpass_enc, texture_compute_target.size.width / 16,
-      texture_compute_target.size.height / 16, 1);
-    wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+    const uint32_t tiles_y = accumulation.tile_count / accumulation.tiles_x;
+    wgpuComputePassEncoderSetBindGroup(cpass_enc, 0, compute.bind_group, 0,
+                                       NULL);
+    if (compute.ubo.sampling.reset || !accumulation.adaptive) {
+      // Dispatch the compute job
+      wgpuComputePassEncoderSetPipeline(cpass_enc, compute.pipeline);
+      wgpuComputePassEncoderDispatchWorkgroups(
+        cpass_enc, accumulation.tiles_x, tiles_y, 1);
+    }
+    else {
+      // Only the tiles that were still noisy after the previous frame
+      wgpuComputePassEncoderSetPipeline(cpass_enc, compute.tiles_pipeline);
+      wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+        cpass_enc, accumulation.dispatch_indirect.buffer, 0);
+    }
+    if (accumulation.adaptive) {
+      wgpuComputePassEncoderSetPipeline(cpass_enc, compute.variance_pipeline);
+      wgpuComputePassEncoderDispatchWorkgroups(
+        cpass_enc, accumulation.tiles_x, tiles_y, 1);
+      wgpu_gpu_sort_compact(accumulation.gpu_sort, cpass_enc,
+                            accumulation.tile_indices.buffer,
+                            accumulation.tile_flags.buffer,
+                            accumulation.active_tiles.buffer,
+                            accumulation.dispatch_indirect.buffer,
+                            accumulation.tile_count);
+    }
+    wgpuComputePassEncoderEnd(cpass_enc);
     WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
   }
 
@@ -661,11 +1347,8 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
-  const int draw_result = example_draw(context);
-  if (!context->paused) {
-    update_uniform_buffers(context);
-  }
-  return draw_result;
+  update_sampling(context);
+  return example_draw(context);
 }
 
 static void example_destroy(wgpu_example_context_t* context)
@@ -685,14 +1368,38 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(Buffer, compute.storage_buffers.spheres.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, compute.storage_buffers.planes.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, compute.uniform_buffer.buffer)
+  wgpu_bvh_release(mesh.bvh);
   WGPU_RELEASE_RESOURCE(BindGroupLayout, compute.bind_group_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, compute.bind_group)
   WGPU_RELEASE_RESOURCE(PipelineLayout, compute.pipeline_layout)
   WGPU_RELEASE_RESOURCE(ComputePipeline, compute.pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, compute.tiles_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, compute.variance_pipeline)
+
+  // Accumulation
+  wgpu_gpu_sort_release(accumulation.gpu_sort);
+  wgpu_destroy_buffer(&accumulation.colors);
+  wgpu_destroy_buffer(&accumulation.moments);
+  wgpu_destroy_buffer(&accumulation.tile_flags);
+  wgpu_destroy_buffer(&accumulation.tile_indices);
+  wgpu_destroy_buffer(&accumulation.active_tiles);
+  wgpu_destroy_buffer(&accumulation.dispatch_indirect);
+}
+
+static void parse_mesh_arguments(int argc, char* argv[])
+{
+  static const char model_option[] = "--model=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], model_option, strlen(model_option)) == 0) {
+      mesh.filename = argv[i] + strlen(model_option);
+    }
+  }
 }
 
 void example_compute_ray_tracing(int argc, char* argv[])
 {
+  parse_mesh_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
@@ -1,8 +1,10 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <math.h>
 #include <string.h>
 
+#include "../webgpu/convolution.h"
 #include "../webgpu/imgui_overlay.h"
 
 /* -------------------------------------------------------------------------- *
@@ -11,6 +13,11 @@
  * Uses a compute shader to apply different convolution kernels (and effects) on
  * an input image in realtime.
  *
+ * The last filters run through the convolution library with kernels of a
+ * selectable size: the separable gaussian blur as two 1D passes, the bokeh
+ * blur and the unsharp mask directly or, for larger kernels, in the frequency
+ * domain.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/computeshader
  * -------------------------------------------------------------------------- */
@@ -74,7 +81,26 @@ static struct {
     .location = "shaders/compute_shader/sharpen.comp.spv",
   },
 };
-static const char* shader_names[3] = {"emboss", "edgedetect", "sharpen"};
+static const char* shader_names[6] = {
+  "emboss",        "edgedetect", "sharpen",
+  "gaussian blur", "bokeh blur", "unsharp mask",
+};
+
+// Filters of the convolution library, after the compute shaders
+#define CONVOLUTION_FILTER_GAUSSIAN 3
+#define CONVOLUTION_FILTER_BOKEH 4
+#define CONVOLUTION_FILTER_UNSHARP 5
+
+static const char* convolution_method_names[4] = {"auto", "direct",
+                                                  "separable", "FFT"};
+
+static struct {
+  wgpu_convolution_t* convolution;
+  int32_t kernel_size;
+  wgpu_convolution_method_t method;
+} convolution_filter = {
+  .kernel_size = 31,
+};
 
 static struct {
   mat4 projection;
@@ -514,6 +540,54 @@ static void prepare_compute(wgpu_context_t* wgpu_context)
   }
 }
 
+// Kernel of the selected library filter, normalized to a sum of one
+static void update_convolution_kernel(void)
+{
+  const uint32_t size = (uint32_t)convolution_filter.kernel_size;
+  const float radius  = (float)(size / 2);
+  const float sigma   = MAX(radius / 3.0f, 0.5f);
+  float* weights      = malloc(size * size * sizeof(float));
+  float sum           = 0.0f;
+  for (uint32_t j = 0; j < size; ++j) {
+    for (uint32_t i = 0; i < size; ++i) {
+      const float x = (float)i - radius, y = (float)j - radius;
+      float weight  = expf(-0.5f * (x * x + y * y) / (sigma * sigma));
+      if (compute.pipeline_index == CONVOLUTION_FILTER_BOKEH) {
+        weight = x * x + y * y <= (radius + 0.5f) * (radius + 0.5f) ? 1.0f :
+                                                                     0.0f;
+      }
+      weights[j * size + i] = weight;
+      sum += weight;
+    }
+  }
+  for (uint32_t i = 0; i < size * size; ++i) {
+    weights[i] /= sum;
+  }
+  // Twice the image minus its blur
+  if (compute.pipeline_index == CONVOLUTION_FILTER_UNSHARP) {
+    for (uint32_t i = 0; i < size * size; ++i) {
+      weights[i] = -weights[i];
+    }
+    weights[(size / 2) * size + size / 2] += 2.0f;
+  }
+  convolution_filter.method = wgpu_convolution_set_kernel(
+    convolution_filter.convolution, weights, size);
+  free(weights);
+}
+
+static void prepare_convolution(wgpu_context_t* wgpu_context)
+{
+  convolution_filter.convolution = wgpu_convolution_create(
+    wgpu_context, &(wgpu_convolution_desc_t){
+                    .width  = textures.compute_target.size.width,
+                    .height = textures.compute_target.size.height,
+                    .format = WGPUTextureFormat_RGBA8Unorm,
+                  });
+  wgpu_convolution_set_textures(convolution_filter.convolution,
+                                textures.color_map.view,
+                                textures.compute_target.view);
+}
+
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   // Updated view matrices
@@ -554,6 +628,7 @@ static int example_initialize(wgpu_example_context_t* context)
     setup_bind_groups(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     prepare_compute(context->wgpu_context);
+    prepare_convolution(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
     return 0;
@@ -565,8 +640,24 @@ static int example_initialize(wgpu_example_context_t* context)
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
-    imgui_overlay_combo_box(context->imgui_overlay, "Shader",
-                            &compute.pipeline_index, shader_names, 3);
+    bool kernel_changed = imgui_overlay_combo_box(
+      context->imgui_overlay, "Shader", &compute.pipeline_index, shader_names,
+      (uint32_t)ARRAY_SIZE(shader_names));
+    if (compute.pipeline_index >= CONVOLUTION_FILTER_GAUSSIAN) {
+      if (imgui_overlay_slider_int(
+            context->imgui_overlay, "Kernel size",
+            &convolution_filter.kernel_size, 3,
+            (int32_t)WGPU_CONVOLUTION_MAX_KERNEL_SIZE)) {
+        // Kernels have an odd size
+        convolution_filter.kernel_size |= 1;
+        kernel_changed = true;
+      }
+      if (kernel_changed) {
+        update_convolution_kernel();
+      }
+      imgui_overlay_text("Method: %s",
+                         convolution_method_names[convolution_filter.method]);
+    }
   }
 }
 
@@ -581,13 +672,19 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   {
     wgpu_context->cpass_enc
       = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    wgpuComputePassEncoderSetPipeline(
-      wgpu_context->cpass_enc, compute.pipelines[compute.pipeline_index]);
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
-                                       compute.bind_group, 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      wgpu_context->cpass_enc, textures.compute_target.size.width / 16,
-      textures.compute_target.size.height / 16, 1);
+    if (compute.pipeline_index >= CONVOLUTION_FILTER_GAUSSIAN) {
+      wgpu_convolution_record(convolution_filter.convolution,
+                              wgpu_context->cpass_enc);
+    }
+    else {
+      wgpuComputePassEncoderSetPipeline(
+        wgpu_context->cpass_enc, compute.pipelines[compute.pipeline_index]);
+      wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
+                                         compute.bind_group, 0, NULL);
+      wgpuComputePassEncoderDispatchWorkgroups(
+        wgpu_context->cpass_enc, textures.compute_target.size.width / 16,
+        textures.compute_target.size.height / 16, 1);
+    }
     wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
     WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
   }
@@ -706,6 +803,7 @@ static void example_destroy(wgpu_example_context_t* context)
   for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(compute.pipelines); ++i) {
     WGPU_RELEASE_RESOURCE(ComputePipeline, compute.pipelines[i])
   }
+  wgpu_convolution_release(convolution_filter.convolution);
 
   WGPU_RELEASE_RESOURCE(Buffer, vertex_buffer.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, index_buffer.buffer)
@@ -3,16 +3,33 @@
 
 #include <string.h>
 
+#include "../webgpu/imgui_overlay.h"
+
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - A Conway Game Of Life
  *
  * A binary Conway game of life.
  *
+ * The board is either stored with one cell per texel of a texture, or packed
+ * with 32 cells per word of a storage buffer. The packed board is updated with
+ * a bit-sliced adder that counts the neighbors of the 32 cells of a word at
+ * once, and optionally runs several generations per dispatch on a tile kept in
+ * workgroup memory, together with a halo of one word and one row per
+ * generation around it. The fragment shader unpacks the cells.
+ *
+ * A simulation step runs the set number of dispatches, a frame runs the steps
+ * the frame scheduler assigns to it (see --sim-rate=<Hz>) and a render-only
+ * frame draws the last board.
+ *
  * Ref:
  * https://github.com/Palats/webgpu/blob/main/src/demos/conway.ts
  * https://en.wikipedia.org/wiki/Conway%27s_Game_of_Life
  * -------------------------------------------------------------------------- */
 
+// Largest number of generations per dispatch of the tiled kernel, the tile
+// and its halo fill the 18x32 words of the workgroup memory then
+#define MAX_GENERATIONS_PER_DISPATCH 8
+
 // Shaders
 // clang-format off
 static const char* compute_shader_wgsl = CODE(
@@ -64,6 +81,147 @@ static const char* compute_shader_wgsl = CODE(
   }
 );
 
+static const char* packed_compute_shader_wgsl = CODE(
+  struct UniformsDesc {
+    computeWidth : u32,
+    computeHeight : u32,
+    wordsPerRow : u32,
+    generationCount : u32,
+  }
+
+  @group(0) @binding(0) var<uniform> uniforms : UniformsDesc;
+  @group(0) @binding(1) var<storage, read> srcCells : array<u32>;
+  @group(0) @binding(2) var<storage, read_write> dstCells : array<u32>;
+
+  // Two buffers of a 16x16 words tile with its halo, 18 words per row
+  var<workgroup> tiles : array<array<u32, 576>, 2>;
+
+  // Bit i of word x holds the cell of column x * 32 + i, the cells past the
+  // right border of the board are always dead
+  fn columnMask(x : i32) -> u32 {
+    let width = i32(uniforms.computeWidth) - x * 32;
+    if (width >= 32) {
+      return 0xffffffffu;
+    }
+    return (1u << u32(max(width, 0))) - 1u;
+  }
+
+  fn onBoard(x : i32, y : i32) -> bool {
+    return x >= 0 && y >= 0 && x < i32(uniforms.wordsPerRow)
+           && y < i32(uniforms.computeHeight);
+  }
+
+  fn loadWord(x : i32, y : i32) -> u32 {
+    if (!onBoard(x, y)) {
+      return 0u;
+    }
+    return srcCells[u32(y) * uniforms.wordsPerRow + u32(x)];
+  }
+
+  // Adds one neighbor of each of the 32 cells to their bit-sliced counts,
+  // counts of four and more saturate in z
+  fn addNeighbors(counts : ptr<function, vec3<u32>>, neighbors : u32) {
+    let carry0 = (*counts).x & neighbors;
+    (*counts).x = (*counts).x ^ neighbors;
+    let carry1 = (*counts).y & carry0;
+    (*counts).y = (*counts).y ^ carry0;
+    (*counts).z = (*counts).z | carry1;
+  }
+
+  // Words holds the word to the left, the word and the word to the right
+  fn addRow(counts : ptr<function, vec3<u32>>, words : vec3<u32>,
+            withCenter : bool) {
+    addNeighbors(counts, (words.y << 1u) | (words.x >> 31u));
+    addNeighbors(counts, (words.y >> 1u) | (words.z << 31u));
+    if (withCenter) {
+      addNeighbors(counts, words.y);
+    }
+  }
+
+  // Next generation of the 32 cells of row.y: alive with three neighbors, or
+  // with two when alive before
+  fn lifeStep(above : vec3<u32>, row : vec3<u32>, below : vec3<u32>) -> u32 {
+    var counts = vec3<u32>(0u);
+    addRow(&counts, above, true);
+    addRow(&counts, row, false);
+    addRow(&counts, below, true);
+    return ~counts.z & counts.y & (counts.x | row.y);
+  }
+
+  fn loadRow(x : i32, y : i32) -> vec3<u32> {
+    return vec3<u32>(loadWord(x - 1, y), loadWord(x, y), loadWord(x + 1, y));
+  }
+
+  // One generation, one word per invocation
+  @compute @workgroup_size(8, 8)
+  fn cs_step(@builtin(global_invocation_id) global_id : vec3<u32>) {
+    let x = i32(global_id.x);
+    let y = i32(global_id.y);
+    if (!onBoard(x, y)) {
+      return;
+    }
+    let next = lifeStep(loadRow(x, y - 1), loadRow(x, y), loadRow(x, y + 1));
+    dstCells[global_id.y * uniforms.wordsPerRow + global_id.x]
+      = next & columnMask(x);
+  }
+
+  fn tileWord(tile : i32, x : i32, y : i32, height : i32) -> u32 {
+    if (x < 0 || y < 0 || x >= 18 || y >= height) {
+      return 0u;
+    }
+    return tiles[tile][y * 18 + x];
+  }
+
+  fn tileRow(tile : i32, x : i32, y : i32, height : i32) -> vec3<u32> {
+    return vec3<u32>(tileWord(tile, x - 1, y, height),
+                     tileWord(tile, x, y, height),
+                     tileWord(tile, x + 1, y, height));
+  }
+
+  // Several generations of a 16x16 words tile. Every generation computed
+  // without the words around the halo corrupts one more row of it at the top
+  // and at the bottom and one more bit of the outer halo words, so the tile
+  // stays exact for up to eight generations.
+  @compute @workgroup_size(16, 16)
+  fn cs_step_tiled(@builtin(workgroup_id) workgroup_id : vec3<u32>,
+                   @builtin(local_invocation_index) local_index : u32) {
+    let generations = i32(uniforms.generationCount);
+    let height = 16 + 2 * generations;
+    let wordCount = 18 * height;
+    let origin = vec2<i32>(workgroup_id.xy) * 16 - vec2<i32>(1, generations);
+
+    for (var i = i32(local_index); i < wordCount; i = i + 256) {
+      tiles[0][i] = loadWord(origin.x + i % 18, origin.y + i / 18);
+    }
+    workgroupBarrier();
+
+    for (var g = 0; g < generations; g = g + 1) {
+      let src = g % 2;
+      for (var i = i32(local_index); i < wordCount; i = i + 256) {
+        let x = i % 18;
+        let y = i / 18;
+        var next = 0u;
+        if (onBoard(origin.x + x, origin.y + y)) {
+          next = lifeStep(tileRow(src, x, y - 1, height),
+                          tileRow(src, x, y, height),
+                          tileRow(src, x, y + 1, height))
+                 & columnMask(origin.x + x);
+        }
+        tiles[1 - src][i] = next;
+      }
+      workgroupBarrier();
+    }
+
+    let x = i32(local_index % 16u) + 1;
+    let y = i32(local_index / 16u) + generations;
+    let boardPos = origin + vec2<i32>(x, y);
+    if (onBoard(boardPos.x, boardPos.y)) {
+      dstCells[u32(boardPos.y) * uniforms.wordsPerRow + u32(boardPos.x)]
+        = tiles[generations % 2][y * 18 + x];
+    }
+  }
+);
+
 static const char* graphics_vertex_shader_wgsl = CODE(
   struct VSOut {
     @builtin(position) pos: vec4<f32>,
@@ -107,6 +265,32 @@ static const char* graphics_fragment_shader_wgsl = CODE(
     return textureSample(computeTexture, dstSampler, inp.coord);
   }
 );
+
+static const char* packed_fragment_shader_wgsl = CODE(
+  struct VSOut {
+    @builtin(position) pos: vec4<f32>,
+    @location(0) coord: vec2<f32>
+  }
+
+  struct UniformsDesc {
+    computeWidth : u32,
+    computeHeight : u32,
+    wordsPerRow : u32,
+    generationCount : u32,
+  }
+
+  @group(0) @binding(0) var<uniform> uniforms : UniformsDesc;
+  @group(0) @binding(1) var<storage, read> cells : array<u32>;
+
+  @fragment
+  fn main(inp: VSOut) -> @location(0) vec4<f32> {
+    let size = vec2<u32>(uniforms.computeWidth, uniforms.computeHeight);
+    let cell = min(vec2<u32>(inp.coord * vec2<f32>(size)), size - 1u);
+    let word = cells[cell.y * uniforms.wordsPerRow + cell.x / 32u];
+    let s = f32((word >> (cell.x % 32u)) & 1u);
+    return vec4<f32>(s, s, s, 1.0);
+  }
+);
 // clang-format on
 
 static struct {
@@ -114,6 +298,8 @@ static struct {
   struct {
     uint32_t compute_width;
     uint32_t compute_height;
+    uint32_t words_per_row;    // Packed board, 32 cells per word
+    uint32_t generation_count; // Generations per dispatch of the tiled kernel
   } desc;
 } uniforms = {
   .desc.compute_width  = 0u,
@@ -140,6 +326,35 @@ static struct {
   WGPUComputePipeline pipeline;
 } compute;
 
+// Bit-packed board, the two buffers are swapped after every dispatch
+static struct {
+  wgpu_buffer_t cells[2];
+  uint32_t current; // Buffer holding the current generation
+  struct {
+    WGPUBindGroupLayout bind_group_layout;
+    WGPUBindGroup bind_groups[2];
+    WGPUPipelineLayout pipeline_layout;
+    WGPUComputePipeline pipeline;       // One generation per dispatch
+    WGPUComputePipeline tiled_pipeline; // Several generations per dispatch
+  } compute;
+  struct {
+    WGPUBindGroupLayout bind_group_layout;
+    WGPUBindGroup bind_groups[2];
+    WGPUPipelineLayout pipeline_layout;
+    WGPURenderPipeline pipeline;
+  } graphics;
+} packed;
+
+static struct {
+  bool bit_packed;
+  int32_t generations_per_dispatch;
+  int32_t dispatches_per_step;
+} settings = {
+  .bit_packed               = false,
+  .generations_per_dispatch = 1,
+  .dispatches_per_step      = 1,
+};
+
 // Render pass descriptor for frame buffer writes
 static struct {
   WGPURenderPassColorAttachment color_attachments[1];
@@ -155,8 +370,10 @@ static bool prepared             = false;
 static void update_uniform_buffers(wgpu_context_t* wgpu_context)
 {
   // Update unfirms data
-  uniforms.desc.compute_width  = wgpu_context->surface.width;
-  uniforms.desc.compute_height = wgpu_context->surface.height;
+  uniforms.desc.compute_width    = wgpu_context->surface.width;
+  uniforms.desc.compute_height   = wgpu_context->surface.height;
+  uniforms.desc.words_per_row    = (uniforms.desc.compute_width + 31) / 32;
+  uniforms.desc.generation_count = (uint32_t)settings.generations_per_dispatch;
 
   // Uplaad buffer to the GPU
   wgpu_queue_write_buffer(wgpu_context, uniforms.buffer.buffer, 0,
@@ -176,8 +393,20 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
   update_uniform_buffers(wgpu_context);
 }
 
+// Random initial board, one byte per cell
+static uint8_t* create_initial_board(uint32_t width, uint32_t height)
+{
+  uint8_t* board = malloc(width * height * sizeof(uint8_t));
+  ASSERT(board)
+  for (uint32_t i = 0; i < width * height; ++i) {
+    board[i] = random_float() > 0.8f;
+  }
+  return board;
+}
+
 // Textures, used for compute part
-static void prepare_textures(wgpu_context_t* wgpu_context)
+static void prepare_textures(wgpu_context_t* wgpu_context,
+                             const uint8_t* board)
 {
   const uint32_t compute_width  = wgpu_context->surface.width;
   const uint32_t compute_height = wgpu_context->surface.height;
@@ -238,12 +467,10 @@ static void prepare_textures(wgpu_context_t* wgpu_context)
   // Setup the initial texture1, with some initial data.
   uint8_t* b = malloc(compute_width * compute_height * 4 * sizeof(uint8_t));
   ASSERT(b)
-  bool has_life = false;
-  uint8_t v     = 0;
   for (uint32_t y = 0; y < compute_height; ++y) {
     for (uint32_t x = 0; x < compute_width; ++x) {
-      has_life                           = random_float() > 0.8f;
-      v                                  = has_life ? 255 : 0;
+      const uint8_t v = board[x + y * compute_width] ? 255 : 0;
+
       b[4 * (x + y * compute_width) + 0] = v;
       b[4 * (x + y * compute_width) + 1] = v;
       b[4 * (x + y * compute_width) + 2] = v;
@@ -254,6 +481,36 @@ static void prepare_textures(wgpu_context_t* wgpu_context)
   free(b);
 }
 
+// Storage buffers of the bit-packed board
+static void prepare_packed_buffers(wgpu_context_t* wgpu_context,
+                                   const uint8_t* board)
+{
+  const uint32_t width         = uniforms.desc.compute_width;
+  const uint32_t height        = uniforms.desc.compute_height;
+  const uint32_t words_per_row = uniforms.desc.words_per_row;
+
+  uint32_t* words = calloc(words_per_row * height, sizeof(uint32_t));
+  ASSERT(words)
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      if (board[x + y * width]) {
+        words[x / 32 + y * words_per_row] |= 1u << (x % 32);
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    packed.cells[i] = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label        = "Packed cells buffer",
+                      .usage        = WGPUBufferUsage_Storage,
+                      .size         = words_per_row * height * sizeof(uint32_t),
+                      .initial.data = (i == 0) ? words : NULL,
+                    });
+  }
+  free(words);
+}
+
 static void setup_pipeline_layouts(wgpu_context_t* wgpu_context)
 {
   /* Compute pipeline layout */
@@ -355,6 +612,102 @@ static void setup_pipeline_layouts(wgpu_context_t* wgpu_context)
       wgpu_context->device, &compute_pipeline_layout_desc);
     ASSERT(graphics.pipeline_layout != NULL)
   }
+
+  /* Bit-packed compute pipeline layout */
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Uniforms
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(uniforms.desc),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Input packed cells
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = packed.cells[0].size,
+        },
+        .sampler = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Output packed cells
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Storage,
+          .minBindingSize = packed.cells[1].size,
+        },
+        .sampler = {0},
+      },
+    };
+    WGPUBindGroupLayoutDescriptor bgl_desc = {
+      .label      = "Packed compute pipeline main layout",
+      .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+      .entries    = bgl_entries,
+    };
+    packed.compute.bind_group_layout
+      = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
+    ASSERT(packed.compute.bind_group_layout != NULL)
+
+    WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
+      .label                = "Packed compute pipeline layouts",
+      .bindGroupLayoutCount = 1,
+      .bindGroupLayouts     = &packed.compute.bind_group_layout,
+    };
+    packed.compute.pipeline_layout = wgpuDeviceCreatePipelineLayout(
+      wgpu_context->device, &pipeline_layout_desc);
+    ASSERT(packed.compute.pipeline_layout != NULL)
+  }
+
+  /* Bit-packed graphics pipeline layout */
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[2] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Uniforms
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(uniforms.desc),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Current packed cells updated by the compute shader
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = packed.cells[0].size,
+        },
+        .sampler = {0},
+      },
+    };
+    WGPUBindGroupLayoutDescriptor bgl_desc = {
+      .label      = "Packed rendering pipeline main layout",
+      .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+      .entries    = bgl_entries,
+    };
+    packed.graphics.bind_group_layout
+      = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
+    ASSERT(packed.graphics.bind_group_layout != NULL)
+
+    WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
+      .label                = "Packed rendering pipeline layouts",
+      .bindGroupLayoutCount = 1,
+      .bindGroupLayouts     = &packed.graphics.bind_group_layout,
+    };
+    packed.graphics.pipeline_layout = wgpuDeviceCreatePipelineLayout(
+      wgpu_context->device, &pipeline_layout_desc);
+    ASSERT(packed.graphics.pipeline_layout != NULL)
+  }
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -438,6 +791,61 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
       });
     ASSERT(graphics.bind_groups[i] != NULL)
   }
+
+  // Bind group i of the packed board reads buffer i
+  for (uint32_t i = 0; i < 2; ++i) {
+    WGPUBindGroupEntry compute_bg_entries[3] = {
+        [0] = (WGPUBindGroupEntry) {
+          .binding = 0,
+          .buffer  = uniforms.buffer.buffer,
+          .offset  = 0,
+          .size    = uniforms.buffer.size,
+        },
+        [1] = (WGPUBindGroupEntry) {
+          .binding = 1,
+          .buffer  = packed.cells[i].buffer,
+          .offset  = 0,
+          .size    = packed.cells[i].size,
+        },
+        [2] = (WGPUBindGroupEntry) {
+          .binding = 2,
+          .buffer  = packed.cells[1 - i].buffer,
+          .offset  = 0,
+          .size    = packed.cells[1 - i].size,
+        },
+      };
+    packed.compute.bind_groups[i] = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .layout = packed.compute.bind_group_layout,
+                              .entryCount
+                              = (uint32_t)ARRAY_SIZE(compute_bg_entries),
+                              .entries = compute_bg_entries,
+                            });
+    ASSERT(packed.compute.bind_groups[i] != NULL)
+
+    WGPUBindGroupEntry graphics_bg_entries[2] = {
+        [0] = (WGPUBindGroupEntry) {
+          .binding = 0,
+          .buffer  = uniforms.buffer.buffer,
+          .offset  = 0,
+          .size    = uniforms.buffer.size,
+        },
+        [1] = (WGPUBindGroupEntry) {
+          .binding = 1,
+          .buffer  = packed.cells[i].buffer,
+          .offset  = 0,
+          .size    = packed.cells[i].size,
+        },
+      };
+    packed.graphics.bind_groups[i] = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .layout = packed.graphics.bind_group_layout,
+                              .entryCount
+                              = (uint32_t)ARRAY_SIZE(graphics_bg_entries),
+                              .entries = graphics_bg_entries,
+                            });
+    ASSERT(packed.graphics.bind_groups[i] != NULL)
+  }
 }
 
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
@@ -465,6 +873,39 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     wgpu_shader_release(&conway_comp_shader);
   }
 
+  /* Bit-packed compute pipelines */
+  {
+    wgpu_shader_t packed_comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .wgsl_code.source = packed_compute_shader_wgsl,
+                      .entry            = "cs_step",
+                    });
+
+    packed.compute.pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device,
+      &(WGPUComputePipelineDescriptor){
+        .label   = "Packed step pipeline",
+        .layout  = packed.compute.pipeline_layout,
+        .compute = packed_comp_shader.programmable_stage_descriptor,
+      });
+    ASSERT(packed.compute.pipeline != NULL)
+
+    WGPUProgrammableStageDescriptor stage
+      = packed_comp_shader.programmable_stage_descriptor;
+    stage.entryPoint              = "cs_step_tiled";
+    packed.compute.tiled_pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                              .label   = "Packed tiled step pipeline",
+                              .layout  = packed.compute.pipeline_layout,
+                              .compute = stage,
+                            });
+    ASSERT(packed.compute.tiled_pipeline != NULL)
+
+    // Partial cleanup
+    wgpu_shader_release(&packed_comp_shader);
+  }
+
   /* Graphics pipeline */
   {
     // Primitive state
@@ -525,8 +966,33 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
                             });
 
     // Partial cleanup
-    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
     WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+
+    // Bit-packed graphics pipeline, sharing the vertex shader
+    WGPUFragmentState packed_fragment_state = wgpu_create_fragment_state(
+          wgpu_context, &(wgpu_fragment_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Fragment shader WGSL
+              .wgsl_code.source = packed_fragment_shader_wgsl,
+              .entry            = "main",
+            },
+            .target_count = 1,
+            .targets      = &color_target_state,
+          });
+
+    packed.graphics.pipeline = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                              .label = "Conway packed graphics pipeline",
+                              .layout      = packed.graphics.pipeline_layout,
+                              .primitive   = primitive_state,
+                              .vertex      = vertex_state,
+                              .fragment    = &packed_fragment_state,
+                              .multisample = multisample_state,
+                            });
+
+    // Partial cleanup
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, packed_fragment_state.module);
   }
 }
 
@@ -534,7 +1000,11 @@ static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
     prepare_uniform_buffers(context->wgpu_context);
-    prepare_textures(context->wgpu_context);
+    uint8_t* board = create_initial_board(uniforms.desc.compute_width,
+                                          uniforms.desc.compute_height);
+    prepare_textures(context->wgpu_context, board);
+    prepare_packed_buffers(context->wgpu_context, board);
+    free(board);
     setup_pipeline_layouts(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
@@ -546,6 +1016,40 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_checkBox(context->imgui_overlay, "Bit-packed",
+                           &settings.bit_packed);
+    if (settings.bit_packed
+        && imgui_overlay_slider_int(context->imgui_overlay,
+                                    "Generations per dispatch",
+                                    &settings.generations_per_dispatch, 1,
+                                    MAX_GENERATIONS_PER_DISPATCH)) {
+      update_uniform_buffers(context->wgpu_context);
+    }
+    imgui_overlay_slider_int(context->imgui_overlay, "Dispatches per step",
+                             &settings.dispatches_per_step, 1, 64);
+  }
+  if (imgui_overlay_header("Statistics")) {
+    const uint32_t generations
+      = settings.dispatches_per_step
+        * (settings.bit_packed ? settings.generations_per_dispatch : 1);
+    const float board_size
+      = settings.bit_packed ?
+          (float)packed.cells[0].size :
+          (float)(uniforms.desc.compute_width * uniforms.desc.compute_height
+                  * 4);
+    imgui_overlay_text("Generations per step: %u", generations);
+    imgui_overlay_text("Board size: %.1f KiB", board_size / 1024.0f);
+    imgui_overlay_text("Cell updates: %.2f G/s",
+                       (float)uniforms.desc.compute_width
+                         * uniforms.desc.compute_height * generations
+                         * context->simulation.step_count
+                         / (context->frame_timer * 1e9f));
+  }
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
 {
   wgpu_context_t* wgpu_context          = context->wgpu_context;
@@ -556,18 +1060,47 @@ static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
   // -- Do compute pass, where the actual effect is -- //
-  {
+  const int32_t dispatch_count
+    = settings.dispatches_per_step * (int32_t)context->simulation.step_count;
+  if (dispatch_count > 0) {
     wgpu_context->cpass_enc
       = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
-                                      compute.pipeline);
-    wgpuComputePassEncoderSetBindGroup(
-      wgpu_context->cpass_enc, 0,
-      is_forward ? compute.bind_groups[0] : compute.bind_groups[1], 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      wgpu_context->cpass_enc,
-      (uint32_t)ceil(uniforms.desc.compute_width / 8.0f),
-      (uint32_t)ceil(uniforms.desc.compute_height / 8.0f), 1);
+    const bool tiled
+      = settings.bit_packed && settings.generations_per_dispatch > 1;
+    if (!settings.bit_packed) {
+      wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
+                                        compute.pipeline);
+    }
+    else {
+      wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
+                                        tiled ? packed.compute.tiled_pipeline :
+                                                packed.compute.pipeline);
+    }
+    for (int32_t i = 0; i < dispatch_count; ++i) {
+      if (!settings.bit_packed) {
+        wgpuComputePassEncoderSetBindGroup(
+          wgpu_context->cpass_enc, 0,
+          is_forward ? compute.bind_groups[0] : compute.bind_groups[1], 0,
+          NULL);
+        wgpuComputePassEncoderDispatchWorkgroups(
+          wgpu_context->cpass_enc,
+          (uint32_t)ceil(uniforms.desc.compute_width / 8.0f),
+          (uint32_t)ceil(uniforms.desc.compute_height / 8.0f), 1);
+        is_forward = !is_forward;
+      }
+      else {
+        // One word per invocation, 16x16 words per tile
+        const float words_per_group = tiled ? 16.0f : 8.0f;
+        wgpuComputePassEncoderSetBindGroup(
+          wgpu_context->cpass_enc, 0,
+          packed.compute.bind_groups[packed.current], 0, NULL);
+        wgpuComputePassEncoderDispatchWorkgroups(
+          wgpu_context->cpass_enc,
+          (uint32_t)ceil(uniforms.desc.words_per_row / words_per_group),
+          (uint32_t)ceil(uniforms.desc.compute_height / words_per_group), 1);
+        packed.current = 1 - packed.current;
+      }
+    }
     wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
     WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
   }
@@ -576,17 +1109,31 @@ static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
   {
     wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
       wgpu_context->cmd_enc, &render_pass.descriptor);
-    wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
-                                     graphics.pipeline);
-    wgpuRenderPassEncoderSetBindGroup(
-      wgpu_context->rpass_enc, 0,
-      is_forward ? graphics.bind_groups[0] : graphics.bind_groups[1], 0, NULL);
+    if (!settings.bit_packed) {
+      // The last dispatch wrote to the texture it did not read
+      wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
+                                       graphics.pipeline);
+      wgpuRenderPassEncoderSetBindGroup(
+        wgpu_context->rpass_enc, 0,
+        is_forward ? graphics.bind_groups[1] : graphics.bind_groups[0], 0,
+        NULL);
+    }
+    else {
+      wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
+                                       packed.graphics.pipeline);
+      wgpuRenderPassEncoderSetBindGroup(
+        wgpu_context->rpass_enc, 0,
+        packed.graphics.bind_groups[packed.current], 0, NULL);
+    }
     // Double-triangle for fullscreen has 6 vertices
     wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 6, 1, 0, 0);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
   }
 
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
+
   // Get command buffer
   WGPUCommandBuffer command_buffer
     = wgpu_get_command_buffer(wgpu_context->cmd_enc);
@@ -612,9 +1159,6 @@ static int example_draw(wgpu_example_context_t* context)
   // Submit frame
   submit_frame(context);
 
-  // Switch for next frame
-  is_forward = !is_forward;
-
   return 0;
 }
 
@@ -649,15 +1193,51 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(BindGroup, compute.bind_groups[1])
   WGPU_RELEASE_RESOURCE(PipelineLayout, compute.pipeline_layout)
   WGPU_RELEASE_RESOURCE(ComputePipeline, compute.pipeline)
+
+  // Bit-packed board
+  wgpu_destroy_buffer(&packed.cells[0]);
+  wgpu_destroy_buffer(&packed.cells[1]);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, packed.compute.bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, packed.compute.bind_groups[0])
+  WGPU_RELEASE_RESOURCE(BindGroup, packed.compute.bind_groups[1])
+  WGPU_RELEASE_RESOURCE(PipelineLayout, packed.compute.pipeline_layout)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, packed.compute.pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, packed.compute.tiled_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, packed.graphics.bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, packed.graphics.bind_groups[0])
+  WGPU_RELEASE_RESOURCE(BindGroup, packed.graphics.bind_groups[1])
+  WGPU_RELEASE_RESOURCE(PipelineLayout, packed.graphics.pipeline_layout)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, packed.graphics.pipeline)
+}
+
+// --bit-packed starts with the packed board, --generations-per-dispatch=<n>
+// selects the tiled kernel
+static void parse_conway_arguments(int argc, char* argv[])
+{
+  static const char generations_option[] = "--generations-per-dispatch=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--bit-packed") == 0) {
+      settings.bit_packed = true;
+    }
+    else if (strncmp(argv[i], generations_option, strlen(generations_option))
+             == 0) {
+      settings.generations_per_dispatch
+        = CLAMP(atoi(argv[i] + strlen(generations_option)), 1,
+                MAX_GENERATIONS_PER_DISPATCH);
+    }
+  }
 }
 
 void example_conway(int argc, char* argv[])
 {
+  parse_conway_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
-     .title = example_title,
-     .vsync = true,
+     .title   = example_title,
+     .overlay = true,
+     .vsync   = true,
     },
     .example_initialize_func = &example_initialize,
     .example_render_func     = &example_render,
@@ -11,11 +11,23 @@
  *
  * This example shows how to do deferred rendering with webgpu.
  * Render geometry info to multiple targets in the gBuffers in the first pass.
- * In this sample we have 3 gBuffers for positions, normals, and albedo.
+ * In this sample the gBuffers are compact: octahedral encoded normals in a
+ * rg16float target and albedo in a rgba8unorm target, the world position is
+ * reconstructed from the depth buffer with the inverse view projection
+ * matrix. That's 8 bytes per pixel instead of 36 bytes for rgba32float
+ * positions and normals plus albedo.
  * And then do the lighting in a second pass with per fragment data read from
  * gBuffers so it's independent of scene complexity. We also update light
- * position in a compute shader, where further operations like tile/cluster
- * culling could happen.
+ * position in a compute shader and bin the lights into clusters, so that every
+ * pixel only shades the lights of its cluster.
+ * Alternatively every pixel shades all lights, or the lights are drawn as
+ * instanced sphere volumes: the volumes first count, in the stencil buffer,
+ * the volumes containing the surface of every pixel, then only pixels inside
+ * a volume are shaded by the back faces of the volumes. With few large lights
+ * that is cheaper than building the clusters.
+ * With temporal upscaling the GBuffer and lighting passes render at the
+ * (dynamic) render resolution with a sub-pixel jitter, the temporal resolve
+ * accumulates the lit frames at the surface resolution.
  *
  * Ref:
  * https://github.com/austinEng/webgpu-samples/tree/main/src/sample/deferredRendering
@@ -27,11 +39,14 @@ static const uint32_t max_num_lights   = (uint32_t)MAX_NUM_LIGHTS;
 static const uint8_t light_data_stride = 8;
 static vec3 light_extent_min           = {-50.f, -30.f, -50.f};
 static vec3 light_extent_max           = {50.f, 30.f, 50.f};
+static const float z_near              = 1.0f;
+static const float z_far               = 2000.0f;
 
 static struct {
   vec3 up_vector;
   vec3 origin;
   mat4 projection_matrix;
+  mat4 view_matrix;
   mat4 view_proj_matrix;
 } view_matrices = {0};
 
@@ -44,18 +59,30 @@ static uint32_t index_count;
 
 // GBuffer
 static struct {
-  WGPUTexture texture_2d_float;
+  WGPUTexture texture_normal;
   WGPUTexture texture_albedo;
-  WGPUTextureView texture_views[3];
+  WGPUTextureView texture_views[2];
 } gbuffer = {0};
 
-// Depth texture
+// Depth texture, sampled as well to reconstruct the positions, its stencil
+// masks the pixels inside light volumes
 static WGPUTexture depth_texture;
-static WGPUTextureView depth_texture_view;
+static WGPUTextureView depth_texture_view; // depth aspect, sampled
+static WGPUTextureView depth_attachment_view;
+
+// Light volume sphere, inscribed polygons are scaled to enclose the sphere
+#define LIGHT_VOLUME_SLICES 16u
+#define LIGHT_VOLUME_STACKS 8u
+static struct {
+  WGPUBuffer vertex_buffer;
+  WGPUBuffer index_buffer;
+  uint32_t index_count;
+} light_volume = {0};
 
 // Uniform buffers
 static WGPUBuffer model_uniform_buffer;
 static WGPUBuffer camera_uniform_buffer;
+static WGPUBuffer camera_inverse_uniform_buffer;
 static WGPUBuffer surface_size_uniform_buffer;
 
 // Lights
@@ -70,6 +97,7 @@ static struct {
   WGPUBindGroupLayout buffer_bind_group_layout;
   WGPUBindGroup buffer_compute_bind_group;
   WGPUBindGroupLayout buffer_compute_bind_group_layout;
+  wgpu_light_clusters_t* clusters;
 } lights = {0};
 
 // Bind groups
@@ -86,17 +114,30 @@ static WGPUBindGroupLayout gbuffer_textures_bind_group_layout;
 static WGPURenderPipeline write_gbuffers_pipeline;
 static WGPURenderPipeline gbuffers_debug_view_pipeline;
 static WGPURenderPipeline deferred_render_pipeline;
+static WGPURenderPipeline deferred_render_hdr_pipeline;
+static WGPURenderPipeline full_screen_render_pipeline;
+static WGPURenderPipeline full_screen_render_hdr_pipeline;
 static WGPUComputePipeline light_update_compute_pipeline;
 
+// Light volume pipelines, for the swap chain and for the lit texture formats
+typedef struct light_volume_pipelines_t {
+  WGPURenderPipeline ambient;
+  WGPURenderPipeline stencil;
+  WGPURenderPipeline lighting;
+} light_volume_pipelines_t;
+static light_volume_pipelines_t light_volume_pipelines     = {0};
+static light_volume_pipelines_t light_volume_hdr_pipelines = {0};
+
 // Pipeline layouts
 static WGPUPipelineLayout write_gbuffers_pipeline_layout;
 static WGPUPipelineLayout gbuffers_debug_view_pipeline_layout;
 static WGPUPipelineLayout deferred_render_pipeline_layout;
+static WGPUPipelineLayout light_volume_pipeline_layout;
 static WGPUPipelineLayout light_update_compute_pipeline_layout;
 
 // Render pass descriptor
 static struct {
-  WGPURenderPassColorAttachment color_attachments[3];
+  WGPURenderPassColorAttachment color_attachments[2];
   WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
   WGPURenderPassDescriptor descriptor;
 } write_gbuffer_pass = {0};
@@ -106,23 +147,299 @@ static struct {
   WGPURenderPassDescriptor descriptor;
 } texture_quad_pass = {0};
 
+static struct {
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDescriptor descriptor;
+} lit_pass = {0};
+
+// Light volume pass, the depth is tested and sampled, the stencil written
+static struct {
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
+  WGPURenderPassDescriptor descriptor;
+} light_volume_pass = {0};
+
+// Temporal upscaling, the lighting pass renders into the lit texture, which
+// has the surface size, the frame covers its top left render size texels
+static struct {
+  wgpu_temporal_upscale_t* upscale;
+  WGPUTexture lit_texture;
+  WGPUTextureView lit_texture_view;
+  uint32_t render_width;
+  uint32_t render_height;
+  bool active; // jittered at the render resolution this frame
+} temporal = {0};
+
 typedef enum render_mode_enum {
   RenderMode_Rendering    = 0,
   RenderMode_GBuffer_View = 1,
 } render_mode_enum;
 
+typedef enum lighting_mode_enum {
+  LightingMode_Clustered    = 0,
+  LightingMode_FullScreen   = 1,
+  LightingMode_LightVolumes = 2,
+} lighting_mode_enum;
+
+static const char* lighting_modes[3] = {
+  "clustered",     //
+  "full-screen",   //
+  "light-volumes", //
+};
+
 static struct {
   render_mode_enum current_render_mode;
+  lighting_mode_enum lighting_mode;
   int32_t num_lights;
+  bool temporal_upscaling;
 } settings = {
   .current_render_mode = RenderMode_Rendering,
+  .lighting_mode       = LightingMode_Clustered,
   .num_lights          = 128,
+  .temporal_upscaling  = true,
 };
 
 // Other variables
 static const char* example_title = "Deferred Rendering";
 static bool prepared             = false;
 
+// Shaders
+// clang-format off
+static const char* write_gbuffers_fragment_shader_wgsl = CODE(
+  // Octahedral normal encoding, folds the lower hemisphere over the upper
+  fn octahedralWrap(v : vec2<f32>) -> vec2<f32> {
+    return (vec2<f32>(1.0) - abs(v.yx))
+           * select(vec2<f32>(-1.0), vec2<f32>(1.0), v >= vec2<f32>(0.0));
+  }
+
+  fn encodeOctahedral(n : vec3<f32>) -> vec2<f32> {
+    let p = n / (abs(n.x) + abs(n.y) + abs(n.z));
+    return select(octahedralWrap(p.xy), p.xy, p.z >= 0.0);
+  }
+
+  struct GBufferOutput {
+    @location(0) normal : vec2<f32>,
+    @location(1) albedo : vec4<f32>,
+  };
+
+  @fragment
+  fn main(@location(1) fragNormal : vec3<f32>,
+          @location(2) fragUV : vec2<f32>) -> GBufferOutput {
+    // faking some kind of checkerboard texture
+    let uv = floor(30.0 * fragUV);
+    let c = 0.2 + 0.5 * ((uv.x + uv.y) - 2.0 * floor((uv.x + uv.y) / 2.0));
+
+    var output : GBufferOutput;
+    output.normal = encodeOctahedral(normalize(fragNormal));
+    output.albedo = vec4<f32>(c, c, c, 1.0);
+    return output;
+  }
+);
+
+// GBuffer bindings and decoding, shared by the lighting and debug view passes
+static const char* gbuffer_decode_wgsl = CODE(
+  struct CameraInverse {
+    invViewProjectionMatrix : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var gBufferDepth : texture_depth_2d;
+  @group(0) @binding(1) var gBufferNormal : texture_2d<f32>;
+  @group(0) @binding(2) var gBufferAlbedo : texture_2d<f32>;
+  @group(0) @binding(3) var<uniform> cameraInverse : CameraInverse;
+
+  fn decodeOctahedral(e : vec2<f32>) -> vec3<f32> {
+    var n = vec3<f32>(e, 1.0 - abs(e.x) - abs(e.y));
+    let t = max(-n.z, 0.0);
+    n.x = n.x + select(t, -t, n.x >= 0.0);
+    n.y = n.y + select(t, -t, n.y >= 0.0);
+    return normalize(n);
+  }
+
+  // World position of the pixel from its depth and the surface size
+  fn reconstructPosition(coord : vec2<f32>, depth : f32,
+                         surfaceSize : vec2<f32>) -> vec3<f32> {
+    let uv = coord / surfaceSize;
+    let ndc = vec4<f32>(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, depth, 1.0);
+    let world = cameraInverse.invViewProjectionMatrix * ndc;
+    return world.xyz / world.w;
+  }
+);
+
+static const char* gbuffers_debug_view_shader_wgsl = CODE(
+  struct SurfaceConstants {
+    size : vec2<f32>,
+  };
+  @group(1) @binding(0) var<uniform> surface : SurfaceConstants;
+
+  @fragment
+  fn main(@builtin(position) coord : vec4<f32>) -> @location(0) vec4<f32> {
+    var result : vec4<f32>;
+    let pixel = vec2<i32>(floor(coord.xy));
+    let depth = textureLoad(gBufferDepth, pixel, 0);
+    let c = coord.xy / surface.size;
+    if (c.x < 0.33333) {
+      // Reconstructed world position, scaled to be visible
+      if (depth >= 1.0) {
+        result = vec4<f32>(1.0);
+      } else {
+        let position = reconstructPosition(coord.xy, depth, surface.size);
+        result = vec4<f32>(position * 0.01 + vec3<f32>(0.5), 1.0);
+      }
+    } else if (c.x < 0.66667) {
+      let normal = decodeOctahedral(textureLoad(gBufferNormal, pixel, 0).xy);
+      result = vec4<f32>((normal + vec3<f32>(1.0)) * 0.5, 1.0);
+    } else {
+      result = textureLoad(gBufferAlbedo, pixel, 0);
+    }
+    return result;
+  }
+);
+
+static const char* deferred_lights_wgsl = CODE(
+  struct LightData {
+    position : vec4<f32>,
+    color : vec3<f32>,
+    radius : f32,
+  };
+  struct LightsBuffer {
+    lights : array<LightData>,
+  };
+  @group(1) @binding(0) var<storage, read> lightsBuffer : LightsBuffer;
+
+  struct Config {
+    numLights : u32,
+  };
+  @group(1) @binding(1) var<uniform> config : Config;
+
+  struct SurfaceConstants {
+    size : vec2<f32>,
+  };
+  @group(2) @binding(0) var<uniform> surface : SurfaceConstants;
+
+  fn shadeLight(light : LightData, position : vec3<f32>, normal : vec3<f32>,
+                albedo : vec3<f32>) -> vec3<f32> {
+    let L = light.position.xyz - position;
+    let distance = length(L);
+    if (distance > light.radius) {
+      return vec3<f32>(0.0);
+    }
+    let lambert = max(dot(normal, normalize(L)), 0.0);
+    return vec3<f32>(lambert * pow(1.0 - distance / light.radius, 2.0)
+                     * light.color * albedo);
+  }
+);
+
+static const char* deferred_rendering_shader_wgsl = CODE(
+  @group(3) @binding(0) var<uniform> clusterParams : LightClusterParams;
+  @group(3) @binding(1) var<storage, read> clusterLights : array<u32>;
+
+  @fragment
+  fn main(@builtin(position) coord : vec4<f32>) -> @location(0) vec4<f32> {
+    var result = vec3<f32>(0.0);
+
+    let pixel = vec2<i32>(floor(coord.xy));
+    let depth = textureLoad(gBufferDepth, pixel, 0);
+    // Nothing was drawn where the depth is still the clear value
+    if (depth >= 1.0) {
+      discard;
+    }
+    let position = reconstructPosition(coord.xy, depth, surface.size);
+    let normal = decodeOctahedral(textureLoad(gBufferNormal, pixel, 0).xy);
+    let albedo = textureLoad(gBufferAlbedo, pixel, 0).rgb;
+
+    // Only the lights binned into the cluster of the pixel can reach it
+    let cluster = lightClusterGetIndex(coord.xy, position);
+    let lightCount = lightClusterGetLightCount(cluster);
+    for (var c = 0u; c < lightCount; c = c + 1u) {
+      let light = lightsBuffer.lights[lightClusterGetLightIndex(cluster, c)];
+      result = result + shadeLight(light, position, normal, albedo);
+    }
+
+    // some manual ambient
+    result = result + vec3<f32>(0.2);
+
+    return vec4<f32>(result, 1.0);
+  }
+
+  // Every pixel shades all lights
+  @fragment
+  fn main_full_screen(@builtin(position) coord : vec4<f32>)
+    -> @location(0) vec4<f32> {
+    var result = vec3<f32>(0.0);
+
+    let pixel = vec2<i32>(floor(coord.xy));
+    let depth = textureLoad(gBufferDepth, pixel, 0);
+    if (depth >= 1.0) {
+      discard;
+    }
+    let position = reconstructPosition(coord.xy, depth, surface.size);
+    let normal = decodeOctahedral(textureLoad(gBufferNormal, pixel, 0).xy);
+    let albedo = textureLoad(gBufferAlbedo, pixel, 0).rgb;
+    for (var i = 0u; i < config.numLights; i = i + 1u) {
+      result = result + shadeLight(lightsBuffer.lights[i], position, normal,
+                                   albedo);
+    }
+
+    result = result + vec3<f32>(0.2);
+
+    return vec4<f32>(result, 1.0);
+  }
+);
+
+static const char* light_volume_shader_wgsl = CODE(
+  struct Camera {
+    viewProjectionMatrix : mat4x4<f32>,
+  };
+  @group(3) @binding(1) var<uniform> camera : Camera;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) @interpolate(flat) lightIndex : u32,
+  };
+
+  @vertex
+  fn vs_main(@builtin(instance_index) instance : u32,
+             @location(0) position : vec3<f32>) -> VertexOutput {
+    let light = lightsBuffer.lights[instance];
+    var output : VertexOutput;
+    output.position = camera.viewProjectionMatrix
+                      * vec4<f32>(light.position.xyz
+                                  + position * light.radius, 1.0);
+    output.lightIndex = instance;
+    return output;
+  }
+
+  // The stencil pass only counts the volumes
+  @fragment
+  fn fs_stencil() -> @location(0) vec4<f32> {
+    return vec4<f32>(0.0);
+  }
+
+  // Additive contribution of the light of the volume
+  @fragment
+  fn fs_lighting(input : VertexOutput) -> @location(0) vec4<f32> {
+    let pixel = vec2<i32>(floor(input.position.xy));
+    let depth = textureLoad(gBufferDepth, pixel, 0);
+    let position = reconstructPosition(input.position.xy, depth, surface.size);
+    let normal = decodeOctahedral(textureLoad(gBufferNormal, pixel, 0).xy);
+    let albedo = textureLoad(gBufferAlbedo, pixel, 0).rgb;
+    let light = lightsBuffer.lights[input.lightIndex];
+    return vec4<f32>(shadeLight(light, position, normal, albedo), 0.0);
+  }
+
+  // Ambient term of all drawn pixels, before the volumes are added
+  @fragment
+  fn fs_ambient(@builtin(position) coord : vec4<f32>)
+    -> @location(0) vec4<f32> {
+    let depth = textureLoad(gBufferDepth, vec2<i32>(floor(coord.xy)), 0);
+    if (depth >= 1.0) {
+      discard;
+    }
+    return vec4<f32>(vec3<f32>(0.2), 1.0);
+  }
+);
+// clang-format on
+
 // Prepare vertex and index buffers for the Stanford dragon mesh
 static void
 prepare_vertex_and_index_buffers(wgpu_context_t* wgpu_context,
@@ -223,24 +540,12 @@ prepare_vertex_and_index_buffers(wgpu_context_t* wgpu_context,
 // GBuffer texture render targets
 static void prepare_gbuffer_texture_render_targets(wgpu_context_t* wgpu_context)
 {
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .size          = (WGPUExtent3D) {
-        .width               = wgpu_context->surface.width,
-        .height              = wgpu_context->surface.height,
-        .depthOrArrayLayers  = 2,
-      },
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = WGPUTextureFormat_RGBA32Float,
-      .usage         = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
-    };
-    gbuffer.texture_2d_float
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-  }
-
-  {
+  static const WGPUTextureFormat formats[2] = {
+    WGPUTextureFormat_RG16Float,  // octahedral encoded normal
+    WGPUTextureFormat_RGBA8Unorm, // albedo
+  };
+  WGPUTexture* textures[2] = {&gbuffer.texture_normal, &gbuffer.texture_albedo};
+  for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(formats); ++i) {
     WGPUTextureDescriptor texture_desc = {
       .size          = (WGPUExtent3D) {
         .width               = wgpu_context->surface.width,
@@ -250,35 +555,22 @@ static void prepare_gbuffer_texture_render_targets(wgpu_context_t* wgpu_context)
       .mipLevelCount = 1,
       .sampleCount   = 1,
       .dimension     = WGPUTextureDimension_2D,
-      .format        = WGPUTextureFormat_BGRA8Unorm,
+      .format        = formats[i],
       .usage         = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
     };
-    gbuffer.texture_albedo
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-  }
+    *textures[i] = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
 
-  {
     WGPUTextureViewDescriptor texture_view_dec = {
       .dimension       = WGPUTextureViewDimension_2D,
-      .format          = WGPUTextureFormat_RGBA32Float,
+      .format          = formats[i],
       .baseMipLevel    = 0,
       .mipLevelCount   = 1,
       .baseArrayLayer  = 0,
       .arrayLayerCount = 1,
       .aspect          = WGPUTextureAspect_All,
     };
-
-    gbuffer.texture_views[0]
-      = wgpuTextureCreateView(gbuffer.texture_2d_float, &texture_view_dec);
-
-    texture_view_dec.baseArrayLayer = 1;
-    gbuffer.texture_views[1]
-      = wgpuTextureCreateView(gbuffer.texture_2d_float, &texture_view_dec);
-
-    texture_view_dec.format         = WGPUTextureFormat_BGRA8Unorm;
-    texture_view_dec.baseArrayLayer = 0;
-    gbuffer.texture_views[2]
-      = wgpuTextureCreateView(gbuffer.texture_albedo, &texture_view_dec);
+    gbuffer.texture_views[i]
+      = wgpuTextureCreateView(*textures[i], &texture_view_dec);
   }
 }
 
@@ -286,13 +578,13 @@ static void prepare_bind_group_layouts(wgpu_context_t* wgpu_context)
 {
   // GBuffer textures bind group layout
   {
-    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+    WGPUBindGroupLayoutEntry bgl_entries[4] = {
       [0] = (WGPUBindGroupLayoutEntry) {
-        // Binding 0: Position texture view
+        // Binding 0: Depth texture view
         .binding    = 0,
         .visibility = WGPUShaderStage_Fragment,
         .texture = (WGPUTextureBindingLayout) {
-          .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+          .sampleType    = WGPUTextureSampleType_Depth,
           .viewDimension = WGPUTextureViewDimension_2D,
         },
         .storageTexture = {0},
@@ -316,6 +608,16 @@ static void prepare_bind_group_layouts(wgpu_context_t* wgpu_context)
           .viewDimension = WGPUTextureViewDimension_2D,
         },
         .storageTexture = {0},
+      },
+      [3] = (WGPUBindGroupLayoutEntry) {
+        // Binding 3: Uniform buffer (Fragment shader) - CameraInverse
+        .binding    = 3,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(mat4),
+        },
+        .sampler = {0},
       }
     };
     gbuffer_textures_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
@@ -331,9 +633,10 @@ static void prepare_bind_group_layouts(wgpu_context_t* wgpu_context)
   {
     WGPUBindGroupLayoutEntry bgl_entries[2] = {
       [0] = (WGPUBindGroupLayoutEntry) {
-        // Binding 0: Storage buffer (Fragment shader) - LightsBuffer
+        // Binding 0: Storage buffer (Vertex/Fragment shader) - LightsBuffer
         .binding    = 0,
-        .visibility = WGPUShaderStage_Fragment | WGPUShaderStage_Compute,
+        .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment
+                      | WGPUShaderStage_Compute,
         .buffer = (WGPUBufferBindingLayout) {
           .type           = WGPUBufferBindingType_ReadOnlyStorage,
           .minBindingSize = sizeof(float) * light_data_stride * max_num_lights,
@@ -487,10 +790,11 @@ static void prepare_render_pipeline_layouts(wgpu_context_t* wgpu_context)
 
   // Deferred render pipeline layout
   {
-    WGPUBindGroupLayout bind_group_layouts[3] = {
+    WGPUBindGroupLayout bind_group_layouts[4] = {
       gbuffer_textures_bind_group_layout,     // set 0
       lights.buffer_bind_group_layout,        // set 1
       surface_size_uniform_bind_group_layout, // set 2
+      wgpu_light_clusters_get_bind_group_layout(lights.clusters), // set 3
     };
     deferred_render_pipeline_layout = wgpuDeviceCreatePipelineLayout(
       wgpu_context->device,
@@ -500,6 +804,23 @@ static void prepare_render_pipeline_layouts(wgpu_context_t* wgpu_context)
       });
     ASSERT(deferred_render_pipeline_layout != NULL);
   }
+
+  // Light volume pipeline layout
+  {
+    WGPUBindGroupLayout bind_group_layouts[4] = {
+      gbuffer_textures_bind_group_layout,     // set 0
+      lights.buffer_bind_group_layout,        // set 1
+      surface_size_uniform_bind_group_layout, // set 2
+      scene_uniform_bind_group_layout,        // set 3
+    };
+    light_volume_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+      wgpu_context->device,
+      &(WGPUPipelineLayoutDescriptor){
+        .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+        .bindGroupLayouts     = bind_group_layouts,
+      });
+    ASSERT(light_volume_pipeline_layout != NULL);
+  }
 }
 
 static void prepare_write_gbuffers_pipeline(wgpu_context_t* wgpu_context)
@@ -512,20 +833,15 @@ static void prepare_write_gbuffers_pipeline(wgpu_context_t* wgpu_context)
   };
 
   // Color target state
-  WGPUColorTargetState color_target_states[3] = {
-    // position
+  WGPUColorTargetState color_target_states[2] = {
+    // octahedral encoded normal
     [0] = (WGPUColorTargetState){
-      .format    = WGPUTextureFormat_RGBA32Float,
-      .writeMask = WGPUColorWriteMask_All,
-    },
-    // normal
-    [1] = (WGPUColorTargetState){
-      .format    = WGPUTextureFormat_RGBA32Float,
+      .format    = WGPUTextureFormat_RG16Float,
       .writeMask = WGPUColorWriteMask_All,
     },
     // albedo
-    [2] = (WGPUColorTargetState){
-      .format    = WGPUTextureFormat_BGRA8Unorm,
+    [1] = (WGPUColorTargetState){
+      .format    = WGPUTextureFormat_RGBA8Unorm,
       .writeMask = WGPUColorWriteMask_All,
     },
   };
@@ -533,7 +849,7 @@ static void prepare_write_gbuffers_pipeline(wgpu_context_t* wgpu_context)
   // Depth stencil state
   WGPUDepthStencilState depth_stencil_state
     = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
-      .format              = WGPUTextureFormat_Depth24Plus,
+      .format              = WGPUTextureFormat_Depth24PlusStencil8,
       .depth_write_enabled = true,
     });
   depth_stencil_state.depthCompare = WGPUCompareFunction_Less;
@@ -566,9 +882,9 @@ static void prepare_write_gbuffers_pipeline(wgpu_context_t* wgpu_context)
             wgpu_context, &(wgpu_fragment_state_t){
             .shader_desc = (wgpu_shader_desc_t){
               // Fragment shader WGSL
-              .label = "fragmentWriteGBuffers WGSL",
-              .file  = "shaders/deferred_rendering/fragmentWriteGBuffers.wgsl",
-              .entry = "main",
+              .label            = "fragmentWriteGBuffers WGSL",
+              .wgsl_code.source = write_gbuffers_fragment_shader_wgsl,
+              .entry            = "main",
              },
             .target_count = (uint32_t)ARRAY_SIZE(color_target_states),
             .targets = color_target_states,
@@ -627,17 +943,24 @@ static void prepare_gbuffers_debug_view_pipeline(wgpu_context_t* wgpu_context)
         .buffers = NULL,
       });
 
-  // Fragment state
+  // Fragment state, with the GBuffer decoding functions
+  const size_t wgsl_size = strlen(gbuffer_decode_wgsl)
+                           + strlen(gbuffers_debug_view_shader_wgsl) + 2;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", gbuffer_decode_wgsl,
+           gbuffers_debug_view_shader_wgsl);
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
         wgpu_context, &(wgpu_fragment_state_t){
         .shader_desc = (wgpu_shader_desc_t){
           // Fragment shader WGSL
-          .file  = "shaders/deferred_rendering/fragmentGBuffersDebugView.wgsl",
-          .entry = "main",
+          .label            = "fragmentGBuffersDebugView WGSL",
+          .wgsl_code.source = wgsl,
+          .entry            = "main",
         },
         .target_count = 1,
         .targets      = &color_target_state,
       });
+  free(wgsl);
 
   // Multisample state
   WGPUMultisampleState multisample_state
@@ -662,7 +985,10 @@ static void prepare_gbuffers_debug_view_pipeline(wgpu_context_t* wgpu_context)
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
 }
 
-static void prepare_deferred_render_pipeline(wgpu_context_t* wgpu_context)
+static void prepare_deferred_render_pipeline(wgpu_context_t* wgpu_context,
+                                             WGPUTextureFormat format,
+                                             const char* entry,
+                                             WGPURenderPipeline* pipeline)
 {
   // Primitive state
   WGPUPrimitiveState primitive_state = {
@@ -674,7 +1000,7 @@ static void prepare_deferred_render_pipeline(wgpu_context_t* wgpu_context)
   // Color target state
   WGPUBlendState blend_state              = wgpu_create_blend_state(false);
   WGPUColorTargetState color_target_state = (WGPUColorTargetState){
-    .format    = WGPUTextureFormat_BGRA8Unorm,
+    .format    = format,
     .blend     = &blend_state,
     .writeMask = WGPUColorWriteMask_All,
   };
@@ -691,17 +1017,26 @@ static void prepare_deferred_render_pipeline(wgpu_context_t* wgpu_context)
         .buffers = NULL,
       });
 
-  // Fragment state
+  // Fragment state, with the cluster lookup and GBuffer decoding functions
+  const char* cluster_wgsl = wgpu_light_clusters_get_wgsl_functions();
+  const size_t wgsl_size   = strlen(cluster_wgsl) + strlen(gbuffer_decode_wgsl)
+                           + strlen(deferred_lights_wgsl)
+                           + strlen(deferred_rendering_shader_wgsl) + 4;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s\n%s\n%s", cluster_wgsl,
+           gbuffer_decode_wgsl, deferred_lights_wgsl,
+           deferred_rendering_shader_wgsl);
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
         wgpu_context, &(wgpu_fragment_state_t){
         .shader_desc = (wgpu_shader_desc_t){
           // Fragment shader WGSL
-          .file  = "shaders/deferred_rendering/fragmentDeferredRendering.wgsl",
-          .entry = "main",
+          .wgsl_code.source = wgsl,
+          .entry            = entry,
         },
         .target_count = 1,
         .targets      = &color_target_state,
       });
+  free(wgsl);
 
   // Multisample state
   WGPUMultisampleState multisample_state
@@ -711,7 +1046,7 @@ static void prepare_deferred_render_pipeline(wgpu_context_t* wgpu_context)
       });
 
   // Create rendering pipeline using the specified states
-  deferred_render_pipeline = wgpuDeviceCreateRenderPipeline(
+  *pipeline = wgpuDeviceCreateRenderPipeline(
     wgpu_context->device, &(WGPURenderPipelineDescriptor){
                             .label       = "deferred_render_pipeline",
                             .layout      = deferred_render_pipeline_layout,
@@ -726,6 +1061,284 @@ static void prepare_deferred_render_pipeline(wgpu_context_t* wgpu_context)
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
 }
 
+// UV sphere of unit radius for the light volumes
+static void prepare_light_volume_buffers(wgpu_context_t* wgpu_context)
+{
+  // The faces lie inside the sphere, scaled by the inverse cosine of half the
+  // angle between two stacks they enclose it
+  const float scale       = 1.0f / cosf(PI / (float)LIGHT_VOLUME_STACKS);
+  const uint32_t row_size = LIGHT_VOLUME_SLICES + 1;
+  float vertices[(LIGHT_VOLUME_STACKS + 1) * (LIGHT_VOLUME_SLICES + 1) * 3];
+  uint16_t indices[LIGHT_VOLUME_STACKS * LIGHT_VOLUME_SLICES * 6];
+  for (uint32_t i = 0; i <= LIGHT_VOLUME_STACKS; ++i) {
+    const float phi = PI * (float)i / (float)LIGHT_VOLUME_STACKS;
+    for (uint32_t j = 0; j <= LIGHT_VOLUME_SLICES; ++j) {
+      const float theta = 2.0f * PI * (float)j / (float)LIGHT_VOLUME_SLICES;
+      float* vertex     = &vertices[(i * row_size + j) * 3];
+      vertex[0]         = scale * sinf(phi) * cosf(theta);
+      vertex[1]         = scale * cosf(phi);
+      vertex[2]         = scale * sinf(phi) * sinf(theta);
+    }
+  }
+  // Counter-clockwise seen from outside
+  uint32_t index_count = 0;
+  for (uint32_t i = 0; i < LIGHT_VOLUME_STACKS; ++i) {
+    for (uint32_t j = 0; j < LIGHT_VOLUME_SLICES; ++j) {
+      const uint16_t a       = (uint16_t)(i * row_size + j);
+      const uint16_t b       = (uint16_t)(a + row_size);
+      indices[index_count++] = a;
+      indices[index_count++] = (uint16_t)(a + 1);
+      indices[index_count++] = b;
+      indices[index_count++] = (uint16_t)(a + 1);
+      indices[index_count++] = (uint16_t)(b + 1);
+      indices[index_count++] = b;
+    }
+  }
+  light_volume.index_count = index_count;
+
+  light_volume.vertex_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "Light volume vertex buffer",
+      .usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
+      .size  = sizeof(vertices),
+    });
+  ASSERT(light_volume.vertex_buffer != NULL);
+  wgpu_queue_write_buffer(wgpu_context, light_volume.vertex_buffer, 0,
+                          vertices, sizeof(vertices));
+  light_volume.index_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "Light volume index buffer",
+      .usage = WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst,
+      .size  = sizeof(indices),
+    });
+  ASSERT(light_volume.index_buffer != NULL);
+  wgpu_queue_write_buffer(wgpu_context, light_volume.index_buffer, 0, indices,
+                          sizeof(indices));
+}
+
+/*
+ * Light volume pipelines:
+ * - ambient: full screen ambient term of the drawn pixels
+ * - stencil: both faces of all volumes without culling, z-fail counting
+ *   increments for the back faces behind the surface and decrements for the
+ *   front faces behind it, which leaves the number of volumes containing the
+ *   surface. It works with the camera inside a volume as well.
+ * - lighting: back faces in front of the surface where the count is not 0,
+ *   blended additively
+ */
+static void prepare_light_volume_pipelines(wgpu_context_t* wgpu_context,
+                                           WGPUTextureFormat format,
+                                           light_volume_pipelines_t* pipelines)
+{
+  const size_t wgsl_size = strlen(gbuffer_decode_wgsl)
+                           + strlen(deferred_lights_wgsl)
+                           + strlen(light_volume_shader_wgsl) + 3;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s\n%s", gbuffer_decode_wgsl,
+           deferred_lights_wgsl, light_volume_shader_wgsl);
+
+  // Vertex buffer layout
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    light_volume, sizeof(float) * 3,
+    // Attribute location 0: Position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0))
+
+  // Multisample state
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  // Ambient pipeline
+  {
+    WGPUBlendState blend_state              = wgpu_create_blend_state(false);
+    WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+      .format    = format,
+      .blend     = &blend_state,
+      .writeMask = WGPUColorWriteMask_All,
+    };
+    WGPUDepthStencilState depth_stencil_state
+      = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+        .format              = WGPUTextureFormat_Depth24PlusStencil8,
+        .depth_write_enabled = false,
+      });
+    depth_stencil_state.depthCompare = WGPUCompareFunction_Always;
+
+    WGPUVertexState vertex_state = wgpu_create_vertex_state(
+          wgpu_context, &(wgpu_vertex_state_t){
+          .shader_desc = (wgpu_shader_desc_t){
+            // Vertex shader WGSL
+            .file  = "shaders/deferred_rendering/vertexTextureQuad.wgsl",
+            .entry = "main",
+          },
+          .buffer_count = 0,
+          .buffers      = NULL,
+        });
+    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+          wgpu_context, &(wgpu_fragment_state_t){
+          .shader_desc = (wgpu_shader_desc_t){
+            // Fragment shader WGSL
+            .wgsl_code.source = wgsl,
+            .entry            = "fs_ambient",
+          },
+          .target_count = 1,
+          .targets      = &color_target_state,
+        });
+    pipelines->ambient = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device,
+      &(WGPURenderPipelineDescriptor){
+        .label     = "light_volume_ambient_render_pipeline",
+        .layout    = light_volume_pipeline_layout,
+        .primitive = (WGPUPrimitiveState){
+          .topology  = WGPUPrimitiveTopology_TriangleList,
+          .frontFace = WGPUFrontFace_CCW,
+          .cullMode  = WGPUCullMode_Back,
+        },
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      });
+    ASSERT(pipelines->ambient != NULL);
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+  }
+
+  // Stencil pipeline
+  {
+    WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+      .format    = format,
+      .writeMask = WGPUColorWriteMask_None,
+    };
+    WGPUDepthStencilState depth_stencil_state
+      = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+        .format              = WGPUTextureFormat_Depth24PlusStencil8,
+        .depth_write_enabled = false,
+      });
+    depth_stencil_state.depthCompare = WGPUCompareFunction_Less;
+    depth_stencil_state.stencilBack.depthFailOp
+      = WGPUStencilOperation_IncrementWrap;
+    depth_stencil_state.stencilFront.depthFailOp
+      = WGPUStencilOperation_DecrementWrap;
+
+    WGPUVertexState vertex_state = wgpu_create_vertex_state(
+          wgpu_context, &(wgpu_vertex_state_t){
+          .shader_desc = (wgpu_shader_desc_t){
+            // Vertex shader WGSL
+            .wgsl_code.source = wgsl,
+            .entry            = "vs_main",
+          },
+          .buffer_count = 1,
+          .buffers      = &light_volume_vertex_buffer_layout,
+        });
+    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+          wgpu_context, &(wgpu_fragment_state_t){
+          .shader_desc = (wgpu_shader_desc_t){
+            // Fragment shader WGSL
+            .wgsl_code.source = wgsl,
+            .entry            = "fs_stencil",
+          },
+          .target_count = 1,
+          .targets      = &color_target_state,
+        });
+    pipelines->stencil = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device,
+      &(WGPURenderPipelineDescriptor){
+        .label     = "light_volume_stencil_render_pipeline",
+        .layout    = light_volume_pipeline_layout,
+        .primitive = (WGPUPrimitiveState){
+          .topology  = WGPUPrimitiveTopology_TriangleList,
+          .frontFace = WGPUFrontFace_CCW,
+          .cullMode  = WGPUCullMode_None,
+        },
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      });
+    ASSERT(pipelines->stencil != NULL);
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+  }
+
+  // Lighting pipeline
+  {
+    WGPUBlendComponent additive = {
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_One,
+      .dstFactor = WGPUBlendFactor_One,
+    };
+    WGPUBlendState blend_state = {
+      .color = additive,
+      .alpha = additive,
+    };
+    WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+      .format    = format,
+      .blend     = &blend_state,
+      .writeMask = WGPUColorWriteMask_All,
+    };
+    WGPUDepthStencilState depth_stencil_state
+      = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+        .format              = WGPUTextureFormat_Depth24PlusStencil8,
+        .depth_write_enabled = false,
+      });
+    depth_stencil_state.depthCompare         = WGPUCompareFunction_GreaterEqual;
+    depth_stencil_state.stencilBack.compare  = WGPUCompareFunction_NotEqual;
+    depth_stencil_state.stencilFront.compare = WGPUCompareFunction_NotEqual;
+
+    WGPUVertexState vertex_state = wgpu_create_vertex_state(
+          wgpu_context, &(wgpu_vertex_state_t){
+          .shader_desc = (wgpu_shader_desc_t){
+            // Vertex shader WGSL
+            .wgsl_code.source = wgsl,
+            .entry            = "vs_main",
+          },
+          .buffer_count = 1,
+          .buffers      = &light_volume_vertex_buffer_layout,
+        });
+    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+          wgpu_context, &(wgpu_fragment_state_t){
+          .shader_desc = (wgpu_shader_desc_t){
+            // Fragment shader WGSL
+            .wgsl_code.source = wgsl,
+            .entry            = "fs_lighting",
+          },
+          .target_count = 1,
+          .targets      = &color_target_state,
+        });
+    pipelines->lighting = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device,
+      &(WGPURenderPipelineDescriptor){
+        .label     = "light_volume_lighting_render_pipeline",
+        .layout    = light_volume_pipeline_layout,
+        .primitive = (WGPUPrimitiveState){
+          .topology  = WGPUPrimitiveTopology_TriangleList,
+          .frontFace = WGPUFrontFace_CCW,
+          .cullMode  = WGPUCullMode_Front,
+        },
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      });
+    ASSERT(pipelines->lighting != NULL);
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+  }
+
+  free(wgsl);
+}
+
+static void release_light_volume_pipelines(light_volume_pipelines_t* pipelines)
+{
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines->ambient)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines->stencil)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines->lighting)
+}
+
 static void prepare_depth_texture(wgpu_context_t* wgpu_context)
 {
   WGPUExtent3D texture_extent = {
@@ -738,12 +1351,13 @@ static void prepare_depth_texture(wgpu_context_t* wgpu_context)
     .mipLevelCount = 1,
     .sampleCount   = 1,
     .dimension     = WGPUTextureDimension_2D,
-    .format        = WGPUTextureFormat_Depth24Plus,
-    .usage         = WGPUTextureUsage_RenderAttachment,
+    .format        = WGPUTextureFormat_Depth24PlusStencil8,
+    .usage
+    = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
   };
   depth_texture = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
 
-  // Create the texture view
+  // Create the texture views, only the depth aspect can be sampled
   WGPUTextureViewDescriptor texture_view_dec = {
     .dimension       = WGPUTextureViewDimension_2D,
     .format          = texture_desc.format,
@@ -753,9 +1367,33 @@ static void prepare_depth_texture(wgpu_context_t* wgpu_context)
     .arrayLayerCount = 1,
     .aspect          = WGPUTextureAspect_All,
   };
+  depth_attachment_view
+    = wgpuTextureCreateView(depth_texture, &texture_view_dec);
+  texture_view_dec.aspect = WGPUTextureAspect_DepthOnly;
   depth_texture_view = wgpuTextureCreateView(depth_texture, &texture_view_dec);
 }
 
+// HDR target of the lighting pass with temporal upscaling
+static void prepare_lit_texture(wgpu_context_t* wgpu_context)
+{
+  WGPUTextureDescriptor texture_desc = {
+    .size          = (WGPUExtent3D) {
+      .width              = wgpu_context->surface.width,
+      .height             = wgpu_context->surface.height,
+      .depthOrArrayLayers = 1,
+    },
+    .mipLevelCount = 1,
+    .sampleCount   = 1,
+    .dimension     = WGPUTextureDimension_2D,
+    .format        = WGPUTextureFormat_RGBA16Float,
+    .usage
+    = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
+  };
+  temporal.lit_texture
+    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+  temporal.lit_texture_view = wgpuTextureCreateView(temporal.lit_texture, NULL);
+}
+
 static void setup_render_passes()
 {
   /* Write GBuffer pass */
@@ -766,30 +1404,17 @@ static void setup_render_passes()
         .view       = gbuffer.texture_views[0],
         .loadOp     = WGPULoadOp_Clear,
         .storeOp    = WGPUStoreOp_Store,
-        .clearValue = (WGPUColor) {
-          .r = 1.0f,
-          .g = 1.0f,
-          .b = 1.0f,
-          .a = 1.0f,
-        },
-      };
-
-    write_gbuffer_pass.color_attachments[1] =
-      (WGPURenderPassColorAttachment) {
-        .view       = gbuffer.texture_views[1],
-        .loadOp     = WGPULoadOp_Clear,
-        .storeOp    = WGPUStoreOp_Store,
         .clearValue = (WGPUColor) {
           .r = 0.0f,
           .g = 0.0f,
-          .b = 1.0f,
-          .a = 1.0f,
+          .b = 0.0f,
+          .a = 0.0f,
         },
       };
 
-    write_gbuffer_pass.color_attachments[2] =
+    write_gbuffer_pass.color_attachments[1] =
       (WGPURenderPassColorAttachment) {
-        .view       = gbuffer.texture_views[2],
+        .view       = gbuffer.texture_views[1],
         .loadOp     = WGPULoadOp_Clear,
         .storeOp    = WGPUStoreOp_Store,
         .clearValue = (WGPUColor) {
@@ -803,12 +1428,15 @@ static void setup_render_passes()
     // Render pass depth stencil attachment descriptor
     write_gbuffer_pass.depth_stencil_attachment
       = (WGPURenderPassDepthStencilAttachment){
-        .view            = depth_texture_view,
-        .depthLoadOp     = WGPULoadOp_Clear,
-        .depthStoreOp    = WGPUStoreOp_Store,
-        .depthClearValue = 1.0f,
-        .clearDepth      = 1.0f,
-        .clearStencil    = 0,
+        .view              = depth_attachment_view,
+        .depthLoadOp       = WGPULoadOp_Clear,
+        .depthStoreOp      = WGPUStoreOp_Store,
+        .depthClearValue   = 1.0f,
+        .clearDepth        = 1.0f,
+        .stencilLoadOp     = WGPULoadOp_Clear,
+        .stencilStoreOp    = WGPUStoreOp_Discard,
+        .stencilClearValue = 0,
+        .clearStencil      = 0,
       };
 
     // Render pass descriptor
@@ -842,6 +1470,100 @@ static void setup_render_passes()
       .colorAttachments     = texture_quad_pass.color_attachments,
     };
   }
+
+  /* Lighting pass into the lit texture */
+  {
+    // Color attachment
+    lit_pass.color_attachments[0] =
+      (WGPURenderPassColorAttachment) {
+        .view       = temporal.lit_texture_view,
+        .loadOp     = WGPULoadOp_Clear,
+        .storeOp    = WGPUStoreOp_Store,
+        .clearValue = (WGPUColor) {
+          .r = 0.0f,
+          .g = 0.0f,
+          .b = 0.0f,
+          .a = 1.0f,
+        },
+      };
+
+    // Render pass descriptor
+    lit_pass.descriptor = (WGPURenderPassDescriptor){
+      .colorAttachmentCount = 1,
+      .colorAttachments     = lit_pass.color_attachments,
+    };
+  }
+
+  /* Light volume pass */
+  {
+    // Color attachment
+    light_volume_pass.color_attachments[0] =
+      (WGPURenderPassColorAttachment) {
+        .view       = NULL, // lit texture or frame buffer, set in render loop
+        .loadOp     = WGPULoadOp_Clear,
+        .storeOp    = WGPUStoreOp_Store,
+        .clearValue = (WGPUColor) {
+          .r = 0.0f,
+          .g = 0.0f,
+          .b = 0.0f,
+          .a = 1.0f,
+        },
+      };
+
+    // Render pass depth stencil attachment descriptor, the depth is read only
+    // so that it can be sampled in the same pass
+    light_volume_pass.depth_stencil_attachment
+      = (WGPURenderPassDepthStencilAttachment){
+        .view              = depth_attachment_view,
+        .depthLoadOp       = WGPULoadOp_Load,
+        .depthStoreOp      = WGPUStoreOp_Store,
+        .depthReadOnly     = true,
+        .stencilLoadOp     = WGPULoadOp_Clear,
+        .stencilStoreOp    = WGPUStoreOp_Discard,
+        .stencilClearValue = 0,
+        .clearStencil      = 0,
+      };
+
+    // Render pass descriptor
+    light_volume_pass.descriptor = (WGPURenderPassDescriptor){
+      .colorAttachmentCount   = 1,
+      .colorAttachments       = light_volume_pass.color_attachments,
+      .depthStencilAttachment = &light_volume_pass.depth_stencil_attachment,
+    };
+  }
+}
+
+// GBuffer textures bind group, recreated with the render targets
+static void prepare_gbuffer_textures_bind_group(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding     = 0,
+      .textureView = depth_texture_view,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = gbuffer.texture_views[0],
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = gbuffer.texture_views[1],
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = camera_inverse_uniform_buffer,
+      .size    = sizeof(mat4),
+    },
+  };
+  gbuffer_textures_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label  = "GBuffer textures bind group",
+                            .layout = wgpuRenderPipelineGetBindGroupLayout(
+                              gbuffers_debug_view_pipeline, 0),
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(gbuffer_textures_bind_group != NULL);
 }
 
 static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
@@ -886,6 +1608,17 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
     ASSERT(camera_uniform_buffer);
   }
 
+  // Camera inverse uniform buffer, to reconstruct positions from depth
+  {
+    const WGPUBufferDescriptor buffer_desc = {
+      .size  = 4 * 16, // 4x4 matrix
+      .usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst,
+    };
+    camera_inverse_uniform_buffer
+      = wgpuDeviceCreateBuffer(wgpu_context->device, &buffer_desc);
+    ASSERT(camera_inverse_uniform_buffer);
+  }
+
   // Scene uniform bind group
   {
     WGPUBindGroupEntry bg_entries[2] = {
@@ -941,32 +1674,7 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
     ASSERT(surface_size_uniform_bind_group != NULL);
   }
 
-  // GBuffer textures bind group
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding     = 0,
-        .textureView = gbuffer.texture_views[0],
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding     = 1,
-        .textureView = gbuffer.texture_views[1],
-      },
-      [2] = (WGPUBindGroupEntry) {
-        .binding     = 2,
-        .textureView = gbuffer.texture_views[2],
-      },
-    };
-    gbuffer_textures_bind_group = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, &(WGPUBindGroupDescriptor){
-                              .label  = "GBuffer textures bind group",
-                              .layout = wgpuRenderPipelineGetBindGroupLayout(
-                                gbuffers_debug_view_pipeline, 0),
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            });
-    ASSERT(gbuffer_textures_bind_group != NULL);
-  }
+  prepare_gbuffer_textures_bind_group(wgpu_context);
 }
 
 static void prepare_compute_pipeline_layout(wgpu_context_t* wgpu_context)
@@ -1120,6 +1828,30 @@ static void prepare_lights(wgpu_context_t* wgpu_context)
   }
 }
 
+// The light layout of the clusters matches LightData
+static void prepare_light_clusters(wgpu_context_t* wgpu_context)
+{
+  lights.clusters = wgpu_light_clusters_create(
+    wgpu_context, &(wgpu_light_clusters_desc_t){
+                    .light_stride  = sizeof(float) * light_data_stride,
+                    .radius_offset = sizeof(float) * 7,
+                  });
+}
+
+static void update_light_clusters(wgpu_context_t* wgpu_context)
+{
+  wgpu_light_clusters_view_t view = {
+    .z_near = z_near,
+    .z_far  = z_far,
+    .width  = temporal.render_width,
+    .height = temporal.render_height,
+  };
+  glm_mat4_copy(view_matrices.view_matrix, view.view_matrix);
+  glm_mat4_copy(view_matrices.projection_matrix, view.projection_matrix);
+  wgpu_light_clusters_update(lights.clusters, &view,
+                             (uint32_t)settings.num_lights);
+}
+
 static void prepare_view_matrices(wgpu_context_t* wgpu_context)
 {
   float aspect_ratio
@@ -1131,18 +1863,18 @@ static void prepare_view_matrices(wgpu_context_t* wgpu_context)
   glm_vec3_copy((vec3){0.0f, 0.0f, 0.0f}, view_matrices.origin);
 
   glm_mat4_identity(view_matrices.projection_matrix);
-  glm_perspective((2.0f * PI) / 5.0f, aspect_ratio, 1.f, 2000.f,
+  glm_perspective((2.0f * PI) / 5.0f, aspect_ratio, z_near, z_far,
                   view_matrices.projection_matrix);
 
-  mat4 view_matrix = GLM_MAT4_IDENTITY_INIT;
   glm_lookat(eye_position,            //
              view_matrices.origin,    //
              view_matrices.up_vector, //
-             view_matrix);
+             view_matrices.view_matrix);
 
   mat4 view_proj_matrix = GLM_MAT4_IDENTITY_INIT;
-  glm_mat4_mulN((mat4*[]){&view_matrices.projection_matrix, &view_matrix}, 2,
-                view_proj_matrix);
+  glm_mat4_mulN(
+    (mat4*[]){&view_matrices.projection_matrix, &view_matrices.view_matrix}, 2,
+    view_proj_matrix);
 
   // Move the model so it's centered.
   mat4 model_matrix = GLM_MAT4_IDENTITY_INIT;
@@ -1152,6 +1884,10 @@ static void prepare_view_matrices(wgpu_context_t* wgpu_context)
   // Write data to buffers
   wgpuQueueWriteBuffer(wgpu_context->queue, camera_uniform_buffer, 0,
                        view_proj_matrix, sizeof(mat4));
+  mat4 inv_view_proj_matrix = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv(view_proj_matrix, inv_view_proj_matrix);
+  wgpuQueueWriteBuffer(wgpu_context->queue, camera_inverse_uniform_buffer, 0,
+                       inv_view_proj_matrix, sizeof(mat4));
   wgpuQueueWriteBuffer(wgpu_context->queue, model_uniform_buffer, 0,
                        model_matrix, sizeof(mat4));
 
@@ -1164,10 +1900,14 @@ static void prepare_view_matrices(wgpu_context_t* wgpu_context)
 
   // Pass the surface size to shader to help sample from gBuffer textures using
   // coord
+  temporal.render_width  = wgpu_context->surface.width;
+  temporal.render_height = wgpu_context->surface.height;
   const vec2 surface_size_data
     = {(float)wgpu_context->surface.width, (float)wgpu_context->surface.height};
   wgpuQueueWriteBuffer(wgpu_context->queue, surface_size_uniform_buffer, 0,
                        surface_size_data, sizeof(vec2));
+
+  update_light_clusters(wgpu_context);
 }
 
 /**
@@ -1200,29 +1940,80 @@ static void glm_vec3_rotate_y(vec3 a, vec3 b, float rad, vec3* out)
 }
 
 // Rotates the camera around the origin based on time.
-static mat4* get_camera_view_proj_matrix(wgpu_example_context_t* context)
+static void update_camera_view_matrix(wgpu_example_context_t* context)
 {
   vec3 eye_position = {0.0f, 50.0f, -100.0f};
 
   const float rad = PI * (context->frame.timestamp_millis / 5000.0f);
   glm_vec3_rotate_y(eye_position, view_matrices.origin, rad, &eye_position);
 
-  mat4 view_matrix = GLM_MAT4_IDENTITY_INIT;
   glm_lookat(eye_position,            //
              view_matrices.origin,    //
              view_matrices.up_vector, //
-             view_matrix);
+             view_matrices.view_matrix);
+}
 
-  glm_mat4_mulN((mat4*[]){&view_matrices.projection_matrix, &view_matrix}, 2,
-                view_matrices.view_proj_matrix);
-  return &view_matrices.view_proj_matrix;
+// Render resolution and projection jitter of the next frame, the surface size
+// without jitter when the lit frame isn't upscaled
+static void update_render_size(wgpu_context_t* wgpu_context, vec2 jitter)
+{
+  const bool active = settings.temporal_upscaling
+                      && settings.current_render_mode == RenderMode_Rendering;
+  if (active && !temporal.active) {
+    // The history is outdated after frames without the upscaling
+    wgpu_temporal_upscale_reset(temporal.upscale);
+  }
+  temporal.active        = active;
+  temporal.render_width  = wgpu_context->surface.width;
+  temporal.render_height = wgpu_context->surface.height;
+  glm_vec2_zero(jitter);
+  if (!active) {
+    return;
+  }
+
+  float viewport_width = 0.0f, viewport_height = 0.0f;
+  wgpu_dynamic_resolution_get_viewport(
+    wgpu_context->dynamic_resolution, wgpu_context->surface.width,
+    wgpu_context->surface.height, &viewport_width, &viewport_height);
+  temporal.render_width  = (uint32_t)viewport_width;
+  temporal.render_height = (uint32_t)viewport_height;
+  wgpu_temporal_upscale_next_jitter(temporal.upscale, temporal.render_width,
+                                    temporal.render_height, jitter);
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
-  mat4* camera_view_proj = get_camera_view_proj_matrix(context);
-  wgpuQueueWriteBuffer(context->wgpu_context->queue, camera_uniform_buffer, 0,
-                       *camera_view_proj, sizeof(mat4));
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  if (!context->paused) {
+    update_camera_view_matrix(context);
+  }
+  vec2 jitter = GLM_VEC2_ZERO_INIT;
+  update_render_size(wgpu_context, jitter);
+
+  // The temporal reprojection uses the matrix without jitter
+  glm_mat4_mul(view_matrices.projection_matrix, view_matrices.view_matrix,
+               view_matrices.view_proj_matrix);
+  mat4 jittered_projection_matrix = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_copy(view_matrices.projection_matrix, jittered_projection_matrix);
+  projection_matrix_apply_jitter(jittered_projection_matrix, jitter);
+  mat4 camera_view_proj = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_mul(jittered_projection_matrix, view_matrices.view_matrix,
+               camera_view_proj);
+
+  wgpuQueueWriteBuffer(wgpu_context->queue, camera_uniform_buffer, 0,
+                       camera_view_proj, sizeof(mat4));
+  mat4 inv_view_proj_matrix = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv(camera_view_proj, inv_view_proj_matrix);
+  wgpuQueueWriteBuffer(wgpu_context->queue, camera_inverse_uniform_buffer, 0,
+                       inv_view_proj_matrix, sizeof(mat4));
+
+  // The GBuffers are sampled with the coordinates of the render resolution
+  const vec2 surface_size_data
+    = {(float)temporal.render_width, (float)temporal.render_height};
+  wgpuQueueWriteBuffer(wgpu_context->queue, surface_size_uniform_buffer, 0,
+                       surface_size_data, sizeof(vec2));
+
+  update_light_clusters(wgpu_context);
 }
 
 static int example_initialize(wgpu_example_context_t* context)
@@ -1233,17 +2024,43 @@ static int example_initialize(wgpu_example_context_t* context)
                                      &stanford_dragon_mesh);
     prepare_gbuffer_texture_render_targets(context->wgpu_context);
     prepare_depth_texture(context->wgpu_context);
+    prepare_lit_texture(context->wgpu_context);
     prepare_bind_group_layouts(context->wgpu_context);
+    prepare_light_clusters(context->wgpu_context);
     prepare_render_pipeline_layouts(context->wgpu_context);
     prepare_write_gbuffers_pipeline(context->wgpu_context);
     prepare_gbuffers_debug_view_pipeline(context->wgpu_context);
-    prepare_deferred_render_pipeline(context->wgpu_context);
+    prepare_deferred_render_pipeline(
+      context->wgpu_context, context->wgpu_context->swap_chain.format, "main",
+      &deferred_render_pipeline);
+    prepare_deferred_render_pipeline(context->wgpu_context,
+                                     WGPUTextureFormat_RGBA16Float, "main",
+                                     &deferred_render_hdr_pipeline);
+    prepare_deferred_render_pipeline(
+      context->wgpu_context, context->wgpu_context->swap_chain.format,
+      "main_full_screen", &full_screen_render_pipeline);
+    prepare_deferred_render_pipeline(
+      context->wgpu_context, WGPUTextureFormat_RGBA16Float, "main_full_screen",
+      &full_screen_render_hdr_pipeline);
+    prepare_light_volume_buffers(context->wgpu_context);
+    prepare_light_volume_pipelines(context->wgpu_context,
+                                   context->wgpu_context->swap_chain.format,
+                                   &light_volume_pipelines);
+    prepare_light_volume_pipelines(context->wgpu_context,
+                                   WGPUTextureFormat_RGBA16Float,
+                                   &light_volume_hdr_pipelines);
     setup_render_passes();
     prepare_uniform_buffers(context->wgpu_context);
     prepare_compute_pipeline_layout(context->wgpu_context);
     prepare_light_update_compute_pipeline(context->wgpu_context);
     prepare_lights(context->wgpu_context);
     prepare_view_matrices(context->wgpu_context);
+    wgpu_context_t* wgpu_context = context->wgpu_context;
+    temporal.upscale             = wgpu_temporal_upscale_create(
+      wgpu_context, &(wgpu_temporal_upscale_desc_t){
+                                  .output_width  = wgpu_context->surface.width,
+                                  .output_height = wgpu_context->surface.height,
+                                });
     prepared = true;
     return 0;
   }
@@ -1251,6 +2068,42 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void release_render_targets(void)
+{
+  WGPU_RELEASE_RESOURCE(Texture, gbuffer.texture_normal)
+  WGPU_RELEASE_RESOURCE(Texture, gbuffer.texture_albedo)
+  for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(gbuffer.texture_views); ++i) {
+    WGPU_RELEASE_RESOURCE(TextureView, gbuffer.texture_views[i])
+  }
+  WGPU_RELEASE_RESOURCE(Texture, depth_texture)
+  WGPU_RELEASE_RESOURCE(TextureView, depth_texture_view)
+  WGPU_RELEASE_RESOURCE(TextureView, depth_attachment_view)
+  WGPU_RELEASE_RESOURCE(Texture, temporal.lit_texture)
+  WGPU_RELEASE_RESOURCE(TextureView, temporal.lit_texture_view)
+  WGPU_RELEASE_RESOURCE(BindGroup, gbuffer_textures_bind_group)
+}
+
+// The GBuffer, depth and lit textures have the size of the surface, only they,
+// the bind group sampling them and the upscaling history are recreated on
+// resize
+static void example_on_view_changed(wgpu_example_context_t* context)
+{
+  if (!context->window_resized) {
+    return;
+  }
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  release_render_targets();
+  prepare_gbuffer_texture_render_targets(wgpu_context);
+  prepare_depth_texture(wgpu_context);
+  prepare_lit_texture(wgpu_context);
+  prepare_gbuffer_textures_bind_group(wgpu_context);
+  setup_render_passes();
+  wgpu_temporal_upscale_resize(temporal.upscale, wgpu_context->surface.width,
+                               wgpu_context->surface.height);
+  prepare_view_matrices(wgpu_context);
+  update_uniform_buffers(context);
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
@@ -1261,6 +2114,12 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
                                 mode, 2)) {
       settings.current_render_mode = (render_mode_enum)item_index;
     }
+    int32_t lighting_mode = (int32_t)settings.lighting_mode;
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Lighting",
+                                &lighting_mode, lighting_modes,
+                                (uint32_t)ARRAY_SIZE(lighting_modes))) {
+      settings.lighting_mode = (lighting_mode_enum)lighting_mode;
+    }
     if (imgui_overlay_slider_int(context->imgui_overlay, "Number of Lights",
                                  &settings.num_lights, 1, max_num_lights)) {
       uint32_t num_lights[1] = {(uint32_t)settings.num_lights};
@@ -1268,18 +2127,108 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
                            lights.config_uniform_buffer, 0, num_lights,
                            sizeof(uint32_t));
     }
+    imgui_overlay_checkBox(context->imgui_overlay, "Temporal upscaling",
+                           &settings.temporal_upscaling);
   }
 }
 
+// Ambient term, stencil marking of the pixels inside the light volumes and
+// lighting of the marked pixels
+static void draw_light_volumes(WGPURenderPassEncoder pass,
+                               const light_volume_pipelines_t* pipelines,
+                               wgpu_pipeline_statistics_t* pipeline_statistics)
+{
+  wgpuRenderPassEncoderSetBindGroup(pass, 0, gbuffer_textures_bind_group, 0,
+                                    0);
+  wgpuRenderPassEncoderSetBindGroup(pass, 1, lights.buffer_bind_group, 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(pass, 2, surface_size_uniform_bind_group,
+                                    0, 0);
+  wgpuRenderPassEncoderSetBindGroup(pass, 3, scene_uniform_bind_group, 0, 0);
+  const uint32_t statistics_scope = wgpu_pipeline_statistics_begin_render_scope(
+    pipeline_statistics, pass, "Lighting pass", false);
+  wgpuRenderPassEncoderSetPipeline(pass, pipelines->ambient);
+  wgpuRenderPassEncoderDraw(pass, 6, 1, 0, 0);
+
+  wgpuRenderPassEncoderSetVertexBuffer(pass, 0, light_volume.vertex_buffer, 0,
+                                       WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderSetIndexBuffer(pass, light_volume.index_buffer,
+                                      WGPUIndexFormat_Uint16, 0,
+                                      WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderSetStencilReference(pass, 0);
+  wgpuRenderPassEncoderSetPipeline(pass, pipelines->stencil);
+  wgpuRenderPassEncoderDrawIndexed(pass, light_volume.index_count,
+                                   (uint32_t)settings.num_lights, 0, 0, 0);
+  wgpuRenderPassEncoderSetPipeline(pass, pipelines->lighting);
+  wgpuRenderPassEncoderDrawIndexed(pass, light_volume.index_count,
+                                   (uint32_t)settings.num_lights, 0, 0, 0);
+  wgpu_pipeline_statistics_end_render_scope(pipeline_statistics, pass,
+                                            statistics_scope);
+}
+
+// Lighting of the GBuffers in the selected lighting mode, into the lit texture
+// or the frame buffer
+static void draw_lighting(WGPURenderPassEncoder pass, bool hdr,
+                          wgpu_pipeline_statistics_t* pipeline_statistics)
+{
+  if (settings.lighting_mode == LightingMode_LightVolumes) {
+    draw_light_volumes(
+      pass, hdr ? &light_volume_hdr_pipelines : &light_volume_pipelines,
+      pipeline_statistics);
+    return;
+  }
+  WGPURenderPipeline pipeline = NULL;
+  if (settings.lighting_mode == LightingMode_FullScreen) {
+    pipeline
+      = hdr ? full_screen_render_hdr_pipeline : full_screen_render_pipeline;
+  }
+  else {
+    pipeline = hdr ? deferred_render_hdr_pipeline : deferred_render_pipeline;
+  }
+  wgpuRenderPassEncoderSetPipeline(pass, pipeline);
+  wgpuRenderPassEncoderSetBindGroup(pass, 0, gbuffer_textures_bind_group, 0,
+                                    0);
+  wgpuRenderPassEncoderSetBindGroup(pass, 1, lights.buffer_bind_group, 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(pass, 2, surface_size_uniform_bind_group,
+                                    0, 0);
+  wgpuRenderPassEncoderSetBindGroup(
+    pass, 3, wgpu_light_clusters_get_bind_group(lights.clusters), 0, 0);
+  const uint32_t statistics_scope = wgpu_pipeline_statistics_begin_render_scope(
+    pipeline_statistics, pass, "Lighting pass", false);
+  wgpuRenderPassEncoderDraw(pass, 6, 1, 0, 0);
+  wgpu_pipeline_statistics_end_render_scope(pipeline_statistics, pass,
+                                            statistics_scope);
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  wgpu_gpu_profiler_t* gpu_profiler = wgpu_context->gpu_profiler;
+  uint32_t scope                    = WGPU_GPU_PROFILER_INVALID_SCOPE;
+  // Pass statistics, the samples of the GBuffer pass give its overdraw
+  wgpu_pipeline_statistics_t* pipeline_statistics
+    = wgpu_context->pipeline_statistics;
+  uint32_t statistics_scope = WGPU_PIPELINE_STATISTICS_INVALID_SCOPE;
+
   {
-    // Write position, normal, albedo etc. data to gBuffers
+    // Write normal, albedo etc. data to gBuffers, positions come from depth
+    scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, wgpu_context->cmd_enc,
+                                          "GBuffer pass");
+    write_gbuffer_pass.descriptor.occlusionQuerySet
+      = wgpu_pipeline_statistics_get_occlusion_query_set(pipeline_statistics);
     WGPURenderPassEncoder gbuffer_pass = wgpuCommandEncoderBeginRenderPass(
       wgpu_context->cmd_enc, &write_gbuffer_pass.descriptor);
+    statistics_scope = wgpu_pipeline_statistics_begin_render_scope(
+      pipeline_statistics, gbuffer_pass, "GBuffer pass", true);
+    // Only the render resolution region is drawn, the rest keeps the clear
+    // depth
+    wgpuRenderPassEncoderSetViewport(gbuffer_pass, 0.0f, 0.0f,
+                                     (float)temporal.render_width,
+                                     (float)temporal.render_height, 0.0f, 1.0f);
+    wgpuRenderPassEncoderSetScissorRect(gbuffer_pass, 0, 0,
+                                        temporal.render_width,
+                                        temporal.render_height);
     wgpuRenderPassEncoderSetPipeline(gbuffer_pass, write_gbuffers_pipeline);
     wgpuRenderPassEncoderSetBindGroup(gbuffer_pass, 0, scene_uniform_bind_group,
                                       0, 0);
@@ -1288,29 +2237,57 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     wgpuRenderPassEncoderSetIndexBuffer(
       gbuffer_pass, index_buffer, WGPUIndexFormat_Uint16, 0, WGPU_WHOLE_SIZE);
     wgpuRenderPassEncoderDrawIndexed(gbuffer_pass, index_count, 1, 0, 0, 0);
+    wgpu_pipeline_statistics_end_render_scope(pipeline_statistics,
+                                              gbuffer_pass, statistics_scope);
     wgpuRenderPassEncoderEnd(gbuffer_pass);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, gbuffer_pass)
+    wgpu_gpu_profiler_end_scope(gpu_profiler, wgpu_context->cmd_enc, scope);
   }
 
   {
     // Update lights position
+    scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, wgpu_context->cmd_enc,
+                                          "Light update pass");
     WGPUComputePassEncoder light_pass
       = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    statistics_scope = wgpu_pipeline_statistics_begin_compute_scope(
+      pipeline_statistics, light_pass, "Light update pass");
     wgpuComputePassEncoderSetPipeline(light_pass,
                                       light_update_compute_pipeline);
     wgpuComputePassEncoderSetBindGroup(
       light_pass, 0, lights.buffer_compute_bind_group, 0, NULL);
     wgpuComputePassEncoderDispatchWorkgroups(
       light_pass, (uint32_t)ceil(max_num_lights / 64.f), 1, 1);
+    wgpu_pipeline_statistics_end_compute_scope(pipeline_statistics,
+                                               light_pass, statistics_scope);
     wgpuComputePassEncoderEnd(light_pass);
     WGPU_RELEASE_RESOURCE(ComputePassEncoder, light_pass)
+    wgpu_gpu_profiler_end_scope(gpu_profiler, wgpu_context->cmd_enc, scope);
+  }
+
+  if (settings.lighting_mode == LightingMode_Clustered) {
+    // Bin the lights into the clusters
+    scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, wgpu_context->cmd_enc,
+                                          "Light culling pass");
+    WGPUComputePassEncoder culling_pass
+      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    statistics_scope = wgpu_pipeline_statistics_begin_compute_scope(
+      pipeline_statistics, culling_pass, "Light culling pass");
+    wgpu_light_clusters_build(lights.clusters, culling_pass, lights.buffer);
+    wgpu_pipeline_statistics_end_compute_scope(pipeline_statistics,
+                                               culling_pass, statistics_scope);
+    wgpuComputePassEncoderEnd(culling_pass);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, culling_pass)
+    wgpu_gpu_profiler_end_scope(gpu_profiler, wgpu_context->cmd_enc, scope);
   }
 
   {
+    scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, wgpu_context->cmd_enc,
+                                          "Lighting pass");
     if (settings.current_render_mode == RenderMode_GBuffer_View) {
       // GBuffers debug view
-      // Left: position
-      // Middle: normal
+      // Left: position (reconstructed from depth)
+      // Middle: normal (decoded)
       // Right: albedo (use uv to mimic a checkerboard texture)
       texture_quad_pass.color_attachments[0].view
         = wgpu_context->swap_chain.frame_buffer;
@@ -1326,25 +2303,69 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
       wgpuRenderPassEncoderEnd(debug_view_pass);
       WGPU_RELEASE_RESOURCE(RenderPassEncoder, debug_view_pass)
     }
+    else if (temporal.active) {
+      // Deferred rendering at the render resolution into the lit texture
+      const WGPURenderPassDescriptor* descriptor = &lit_pass.descriptor;
+      if (settings.lighting_mode == LightingMode_LightVolumes) {
+        light_volume_pass.color_attachments[0].view
+          = temporal.lit_texture_view;
+        descriptor = &light_volume_pass.descriptor;
+      }
+      WGPURenderPassEncoder deferred_rendering_pass
+        = wgpuCommandEncoderBeginRenderPass(wgpu_context->cmd_enc, descriptor);
+      wgpuRenderPassEncoderSetViewport(
+        deferred_rendering_pass, 0.0f, 0.0f, (float)temporal.render_width,
+        (float)temporal.render_height, 0.0f, 1.0f);
+      draw_lighting(deferred_rendering_pass, true, pipeline_statistics);
+      wgpuRenderPassEncoderEnd(deferred_rendering_pass);
+      WGPU_RELEASE_RESOURCE(RenderPassEncoder, deferred_rendering_pass)
+    }
     else {
       // Deferred rendering
+      const WGPURenderPassDescriptor* descriptor
+        = &texture_quad_pass.descriptor;
       texture_quad_pass.color_attachments[0].view
         = wgpu_context->swap_chain.frame_buffer;
+      if (settings.lighting_mode == LightingMode_LightVolumes) {
+        light_volume_pass.color_attachments[0].view
+          = wgpu_context->swap_chain.frame_buffer;
+        descriptor = &light_volume_pass.descriptor;
+      }
       WGPURenderPassEncoder deferred_rendering_pass
-        = wgpuCommandEncoderBeginRenderPass(wgpu_context->cmd_enc,
-                                            &texture_quad_pass.descriptor);
-      wgpuRenderPassEncoderSetPipeline(deferred_rendering_pass,
-                                       deferred_render_pipeline);
-      wgpuRenderPassEncoderSetBindGroup(deferred_rendering_pass, 0,
-                                        gbuffer_textures_bind_group, 0, 0);
-      wgpuRenderPassEncoderSetBindGroup(deferred_rendering_pass, 1,
-                                        lights.buffer_bind_group, 0, 0);
-      wgpuRenderPassEncoderSetBindGroup(deferred_rendering_pass, 2,
-                                        surface_size_uniform_bind_group, 0, 0);
-      wgpuRenderPassEncoderDraw(deferred_rendering_pass, 6, 1, 0, 0);
+        = wgpuCommandEncoderBeginRenderPass(wgpu_context->cmd_enc, descriptor);
+      draw_lighting(deferred_rendering_pass, false, pipeline_statistics);
       wgpuRenderPassEncoderEnd(deferred_rendering_pass);
       WGPU_RELEASE_RESOURCE(RenderPassEncoder, deferred_rendering_pass)
     }
+    wgpu_gpu_profiler_end_scope(gpu_profiler, wgpu_context->cmd_enc, scope);
+  }
+
+  if (temporal.active) {
+    // Accumulate the jittered frames at the surface resolution
+    scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, wgpu_context->cmd_enc,
+                                          "Temporal upscale pass");
+    WGPUComputePassEncoder resolve_pass
+      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    wgpu_temporal_upscale_frame_t frame = {
+      .color_view    = temporal.lit_texture_view,
+      .depth_view    = depth_texture_view,
+      .motion_view   = NULL, // static scene, reprojected from the depth
+      .render_width  = temporal.render_width,
+      .render_height = temporal.render_height,
+    };
+    glm_mat4_copy(view_matrices.view_proj_matrix, frame.view_projection);
+    wgpu_temporal_upscale_resolve(temporal.upscale, resolve_pass, &frame);
+    wgpuComputePassEncoderEnd(resolve_pass);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, resolve_pass)
+
+    texture_quad_pass.color_attachments[0].view
+      = wgpu_context->swap_chain.frame_buffer;
+    WGPURenderPassEncoder present_pass = wgpuCommandEncoderBeginRenderPass(
+      wgpu_context->cmd_enc, &texture_quad_pass.descriptor);
+    wgpu_temporal_upscale_present(temporal.upscale, present_pass);
+    wgpuRenderPassEncoderEnd(present_pass);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, present_pass)
+    wgpu_gpu_profiler_end_scope(gpu_profiler, wgpu_context->cmd_enc, scope);
   }
 
   // Draw ui overlay
@@ -1385,9 +2406,8 @@ static int example_render(wgpu_example_context_t* context)
     return 1;
   }
   const int draw_result = example_draw(context);
-  if (!context->paused) {
-    update_uniform_buffers(context);
-  }
+  // The jitter changes with every frame, the camera only when not paused
+  update_uniform_buffers(context);
   return draw_result;
 }
 
@@ -1397,24 +2417,22 @@ static void example_destroy(wgpu_example_context_t* context)
   UNUSED_VAR(context);
   WGPU_RELEASE_RESOURCE(Buffer, vertex_buffer)
   WGPU_RELEASE_RESOURCE(Buffer, index_buffer)
-  WGPU_RELEASE_RESOURCE(Texture, gbuffer.texture_2d_float)
-  WGPU_RELEASE_RESOURCE(Texture, gbuffer.texture_albedo)
-  for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(gbuffer.texture_views); ++i) {
-    WGPU_RELEASE_RESOURCE(TextureView, gbuffer.texture_views[i])
-  }
-  WGPU_RELEASE_RESOURCE(Texture, depth_texture)
-  WGPU_RELEASE_RESOURCE(TextureView, depth_texture_view)
+  WGPU_RELEASE_RESOURCE(Buffer, light_volume.vertex_buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, light_volume.index_buffer)
+  release_render_targets();
   WGPU_RELEASE_RESOURCE(Buffer, model_uniform_buffer)
   WGPU_RELEASE_RESOURCE(Buffer, camera_uniform_buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, camera_inverse_uniform_buffer)
   WGPU_RELEASE_RESOURCE(Buffer, surface_size_uniform_buffer)
   WGPU_RELEASE_RESOURCE(Buffer, lights.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, lights.extent_buffer)
   WGPU_RELEASE_RESOURCE(Buffer, lights.config_uniform_buffer)
   WGPU_RELEASE_RESOURCE(BindGroup, lights.buffer_bind_group)
   WGPU_RELEASE_RESOURCE(BindGroup, lights.buffer_compute_bind_group)
+  wgpu_light_clusters_release(lights.clusters);
+  wgpu_temporal_upscale_release(temporal.upscale);
   WGPU_RELEASE_RESOURCE(BindGroup, scene_uniform_bind_group)
   WGPU_RELEASE_RESOURCE(BindGroup, surface_size_uniform_bind_group)
-  WGPU_RELEASE_RESOURCE(BindGroup, gbuffer_textures_bind_group)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, lights.buffer_bind_group_layout)
   WGPU_RELEASE_RESOURCE(BindGroupLayout,
                         lights.buffer_compute_bind_group_layout)
@@ -1424,15 +2442,40 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(RenderPipeline, write_gbuffers_pipeline)
   WGPU_RELEASE_RESOURCE(RenderPipeline, gbuffers_debug_view_pipeline)
   WGPU_RELEASE_RESOURCE(RenderPipeline, deferred_render_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, deferred_render_hdr_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, full_screen_render_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, full_screen_render_hdr_pipeline)
+  release_light_volume_pipelines(&light_volume_pipelines);
+  release_light_volume_pipelines(&light_volume_hdr_pipelines);
   WGPU_RELEASE_RESOURCE(ComputePipeline, light_update_compute_pipeline)
   WGPU_RELEASE_RESOURCE(PipelineLayout, write_gbuffers_pipeline_layout)
   WGPU_RELEASE_RESOURCE(PipelineLayout, gbuffers_debug_view_pipeline_layout)
   WGPU_RELEASE_RESOURCE(PipelineLayout, deferred_render_pipeline_layout)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, light_volume_pipeline_layout)
   WGPU_RELEASE_RESOURCE(PipelineLayout, light_update_compute_pipeline_layout)
 }
 
+// --lighting=<clustered|full-screen|light-volumes> selects the lighting mode,
+// e.g. to compare them with --benchmark
+static void parse_lighting_argument(int argc, char* argv[])
+{
+  static const char* option = "--lighting=";
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], option, strlen(option)) != 0) {
+      continue;
+    }
+    for (uint32_t m = 0; m < (uint32_t)ARRAY_SIZE(lighting_modes); ++m) {
+      if (strcmp(argv[i] + strlen(option), lighting_modes[m]) == 0) {
+        settings.lighting_mode = (lighting_mode_enum)m;
+      }
+    }
+  }
+}
+
 void example_deferred_rendering(int argc, char* argv[])
 {
+  parse_lighting_argument(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
@@ -1440,9 +2483,13 @@ void example_deferred_rendering(int argc, char* argv[])
       .overlay = true,
       .vsync   = true,
     },
-    .example_initialize_func = &example_initialize,
-    .example_render_func     = &example_render,
-    .example_destroy_func    = &example_destroy
+    .example_window_config = (window_config_t){
+      .resizable = true,
+    },
+    .example_initialize_func      = &example_initialize,
+    .example_render_func          = &example_render,
+    .example_destroy_func         = &example_destroy,
+    .example_on_view_changed_func = &example_on_view_changed,
   });
   // clang-format on
 }
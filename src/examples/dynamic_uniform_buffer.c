@@ -12,6 +12,11 @@
  * Comparing to creating many binding goups and set every group for each object,
  * only one binding group will be created and buffer offset is dynamically set.
  *
+ * The GPU transforms mode moves the per-object work to the GPU: a compute pass
+ * integrates the rotations and writes the model matrices into a storage
+ * buffer, which is indexed by the instance index of a single instanced draw
+ * call. It scales to GPU_OBJECT_INSTANCES objects.
+ *
  * Ref:
  * https://github.com/gpuweb/gpuweb/issues/116
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/dynamicuniformbuffer
@@ -19,6 +24,8 @@
 
 #define OBJECT_INSTANCES 125
 #define ALIGNMENT 256 // 256-byte alignment
+#define GPU_OBJECT_INSTANCES 100000
+#define GPU_TRANSFORMS_WORKGROUP_SIZE 64
 
 // Vertex layout for this example
 typedef struct {
@@ -73,14 +80,131 @@ static struct {
 // Render bundle
 static WGPURenderBundle render_bundle;
 
+// GPU computed transforms, rendered with a single instanced draw call
+static struct {
+  struct {
+    uint32_t count;
+    uint32_t dim;
+    float delta_time;
+    float spacing;
+  } params;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t states;   // per-object rotations and rotation speeds
+  wgpu_buffer_t matrices; // per-object model matrices
+  WGPUBindGroupLayout compute_bind_group_layout;
+  WGPUBindGroup compute_bind_group;
+  WGPUPipelineLayout compute_pipeline_layout;
+  WGPUComputePipeline compute_pipeline;
+  WGPUBindGroupLayout render_bind_group_layout;
+  WGPUBindGroup render_bind_group;
+  WGPUBindGroup frame_bind_group; // frame uniforms, owned by the context
+  WGPUPipelineLayout render_pipeline_layout;
+  WGPURenderPipeline render_pipeline;
+  WGPURenderBundle render_bundle;
+} gpu_transforms = {0};
+
+typedef enum transform_mode_enum {
+  TransformMode_DYNAMIC_OFFSETS = 0,
+  TransformMode_GPU_INSTANCED   = 1,
+} transform_mode_enum;
+
+static const char* transform_mode_names[2] = {
+  "CPU + dynamic offsets", // TransformMode_DYNAMIC_OFFSETS
+  "GPU + instancing",      // TransformMode_GPU_INSTANCED
+};
+
 // Render bundle setting & animation timer
-static bool render_bundles   = true;
-static float animation_timer = 0.0f;
+static bool render_bundles        = true;
+static int32_t transform_mode     = TransformMode_DYNAMIC_OFFSETS;
+static float animation_timer      = 0.0f;
+static float gpu_transforms_timer = 0.0f;
 
 // Other variables
 static const char* example_title = "Dynamic Uniform Buffers";
 static bool prepared             = false;
 
+// clang-format off
+static const char* gpu_transforms_compute_shader_wgsl = CODE(
+  struct Params {
+    count : u32,
+    dim : u32,
+    deltaTime : f32,
+    spacing : f32,
+  };
+
+  struct ObjectState {
+    rotation : vec4<f32>,
+    speed : vec4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1) var<storage, read_write> states : array<ObjectState>;
+  @group(0) @binding(2) var<storage, read_write> models : array<mat4x4<f32>>;
+
+  // Rotation of angle radians around axis, as glm_rotate()
+  fn rotation(axis : vec3<f32>, angle : f32) -> mat3x3<f32> {
+    let a = normalize(axis);
+    let c = cos(angle);
+    let s = sin(angle);
+    let t = a * (1.0 - c);
+    return mat3x3<f32>(
+      vec3<f32>(t.x * a.x + c, t.x * a.y + s * a.z, t.x * a.z - s * a.y),
+      vec3<f32>(t.y * a.x - s * a.z, t.y * a.y + c, t.y * a.z + s * a.x),
+      vec3<f32>(t.z * a.x + s * a.y, t.z * a.y - s * a.x, t.z * a.z + c));
+  }
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= params.count) {
+      return;
+    }
+
+    var state = states[index];
+    state.rotation = state.rotation + state.speed * params.deltaTime;
+    states[index] = state;
+
+    // Objects are laid out in a dim x dim x dim grid centered on the origin
+    let cell = vec3<f32>(vec3<u32>(index / (params.dim * params.dim),
+                                   (index / params.dim) % params.dim,
+                                   index % params.dim));
+    let pos = (cell + 0.5 - f32(params.dim) * 0.5) * params.spacing;
+
+    let r = rotation(vec3<f32>(1.0, 1.0, 0.0), state.rotation.x)
+            * rotation(vec3<f32>(0.0, 1.0, 0.0), state.rotation.y)
+            * rotation(vec3<f32>(0.0, 0.0, 1.0), state.rotation.z);
+    models[index] = mat4x4<f32>(vec4<f32>(r[0], 0.0), vec4<f32>(r[1], 0.0),
+                                vec4<f32>(r[2], 0.0), vec4<f32>(pos, 1.0));
+  }
+);
+
+// The camera comes from the frame uniforms at group 0
+static const char* gpu_transforms_render_shader_wgsl = CODE(
+  @group(1) @binding(0) var<storage, read> models : array<mat4x4<f32>>;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) color : vec3<f32>,
+  };
+
+  @vertex
+  fn vs_main(@builtin(instance_index) instance : u32,
+             @location(0) pos : vec3<f32>,
+             @location(1) color : vec3<f32>) -> VertexOutput {
+    var output : VertexOutput;
+    output.position = frame.viewProjection * models[instance]
+                      * vec4<f32>(pos, 1.0);
+    output.color = color;
+    return output;
+  }
+
+  @fragment
+  fn fs_main(@location(0) color : vec3<f32>) -> @location(0) vec4<f32> {
+    return vec4<f32>(color, 1.0);
+  }
+);
+// clang-format on
+
 static void setup_camera(wgpu_example_context_t* context)
 {
   context->camera       = camera_create();
@@ -357,6 +481,329 @@ static void prepare_render_bundle_encoder(wgpu_context_t* wgpu_context)
   WGPU_RELEASE_RESOURCE(RenderBundleEncoder, render_bundle_encoder)
 }
 
+// Storage buffers of the GPU transforms, the matrices are written by the
+// compute pass every frame
+static void prepare_gpu_transforms_buffers(wgpu_context_t* wgpu_context)
+{
+  gpu_transforms.params.count = GPU_OBJECT_INSTANCES;
+  gpu_transforms.params.dim
+    = (uint32_t)ceil(cbrt((double)GPU_OBJECT_INSTANCES));
+  gpu_transforms.params.delta_time = 0.0f;
+  gpu_transforms.params.spacing    = 5.0f;
+
+  gpu_transforms.params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "gpu_transforms_params_buffer",
+                    .usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst,
+                    .size  = sizeof(gpu_transforms.params),
+                    .initial.data = &gpu_transforms.params,
+                  });
+
+  // Random initial rotations and rotation speeds, as for the CPU path
+  const uint64_t states_size = GPU_OBJECT_INSTANCES * 2 * sizeof(vec4);
+  float* states              = malloc(states_size);
+  for (uint32_t i = 0; i < GPU_OBJECT_INSTANCES; ++i) {
+    float* state = &states[i * 8];
+    for (uint32_t j = 0; j < 3; ++j) {
+      state[j]     = random_float_min_max(-1.0f, 1.0f) * PI2;
+      state[j + 4] = random_float_min_max(-1.0f, 1.0f);
+    }
+    state[3] = state[7] = 0.0f;
+  }
+  gpu_transforms.states = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "gpu_transforms_states_buffer",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+                    .size  = states_size,
+                    .initial.data = states,
+                  });
+  free(states);
+
+  gpu_transforms.matrices = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "gpu_transforms_matrices_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = GPU_OBJECT_INSTANCES * sizeof(mat4),
+                  });
+}
+
+static void prepare_gpu_transforms_compute_pipeline(
+  wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupLayoutEntry bgl_entries[3] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0 : Parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = gpu_transforms.params_buffer.size,
+      },
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1 : Object states
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = gpu_transforms.states.size,
+      },
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2 : Model matrices
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = gpu_transforms.matrices.size,
+      },
+    },
+  };
+  gpu_transforms.compute_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "gpu_transforms_compute_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(gpu_transforms.compute_bind_group_layout != NULL);
+
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = gpu_transforms.params_buffer.buffer,
+      .size    = gpu_transforms.params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = gpu_transforms.states.buffer,
+      .size    = gpu_transforms.states.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = gpu_transforms.matrices.buffer,
+      .size    = gpu_transforms.matrices.size,
+    },
+  };
+  gpu_transforms.compute_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label  = "gpu_transforms_compute_bind_group",
+                            .layout = gpu_transforms.compute_bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(gpu_transforms.compute_bind_group != NULL);
+
+  gpu_transforms.compute_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "gpu_transforms_compute_pipeline_layout",
+      .bindGroupLayoutCount = 1,
+      .bindGroupLayouts     = &gpu_transforms.compute_bind_group_layout,
+    });
+  ASSERT(gpu_transforms.compute_pipeline_layout != NULL);
+
+  wgpu_shader_t compute_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "gpu_transforms_compute_shader",
+                    .wgsl_code.source = gpu_transforms_compute_shader_wgsl,
+                    .entry            = "main",
+                  });
+  gpu_transforms.compute_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "gpu_transforms_compute_pipeline",
+      .layout  = gpu_transforms.compute_pipeline_layout,
+      .compute = compute_shader.programmable_stage_descriptor,
+    });
+  ASSERT(gpu_transforms.compute_pipeline != NULL);
+
+  // Partial cleanup
+  wgpu_shader_release(&compute_shader);
+}
+
+static void prepare_gpu_transforms_render_pipeline(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupLayoutEntry bgl_entries[1] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0 : Model matrices indexed by the instance index
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Vertex,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = gpu_transforms.matrices.size,
+      },
+    },
+  };
+  gpu_transforms.render_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "gpu_transforms_render_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(gpu_transforms.render_bind_group_layout != NULL);
+
+  WGPUBindGroupEntry bg_entries[1] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = gpu_transforms.matrices.buffer,
+      .size    = gpu_transforms.matrices.size,
+    },
+  };
+  gpu_transforms.render_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label  = "gpu_transforms_render_bind_group",
+                            .layout = gpu_transforms.render_bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(gpu_transforms.render_bind_group != NULL);
+
+  gpu_transforms.frame_bind_group
+    = wgpu_frame_uniforms_get_bind_group(wgpu_context);
+
+  // Group 0: frame uniforms, group 1: model matrices
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    wgpu_frame_uniforms_get_bind_group_layout(wgpu_context),
+    gpu_transforms.render_bind_group_layout,
+  };
+  gpu_transforms.render_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "gpu_transforms_render_pipeline_layout",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(gpu_transforms.render_pipeline_layout != NULL);
+
+  // Same states as the dynamic offsets pipeline
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_None,
+  };
+  WGPUBlendState blend_state              = wgpu_create_blend_state(true);
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = wgpu_context->swap_chain.format,
+    .blend     = &blend_state,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = WGPUTextureFormat_Depth24PlusStencil8,
+      .depth_write_enabled = true,
+    });
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    instanced, sizeof(vertex_t),
+    // Attribute location 0 : Position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, offsetof(vertex_t, pos)),
+    // Attribute location 1: Color
+    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x3,
+                       offsetof(vertex_t, color)))
+
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "gpu_transforms_vertex_shader",
+                  .wgsl_code.source = gpu_transforms_render_shader_wgsl,
+                  .entry            = "vs_main",
+                  .frame_uniforms   = true,
+                },
+                .buffer_count = 1,
+                .buffers      = &instanced_vertex_buffer_layout,
+              });
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+                wgpu_context, &(wgpu_fragment_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Fragment shader WGSL
+                  .label            = "gpu_transforms_fragment_shader",
+                  .wgsl_code.source = gpu_transforms_render_shader_wgsl,
+                  .entry            = "fs_main",
+                  .frame_uniforms   = true,
+                },
+                .target_count = 1,
+                .targets      = &color_target_state,
+              });
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  gpu_transforms.render_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label  = "gpu_transforms_render_pipeline",
+                            .layout = gpu_transforms.render_pipeline_layout,
+                            .primitive    = primitive_state,
+                            .vertex       = vertex_state,
+                            .fragment     = &fragment_state,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(gpu_transforms.render_pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+// All objects are drawn with one instanced draw call
+#define RECORD_INSTANCED_RENDER_PASS(Type, rpass_enc)                          \
+  if (rpass_enc) {                                                             \
+    wgpu##Type##SetPipeline(rpass_enc, gpu_transforms.render_pipeline);        \
+    wgpu##Type##SetVertexBuffer(rpass_enc, 0, vertices.buffer, 0,              \
+                                WGPU_WHOLE_SIZE);                              \
+    wgpu##Type##SetIndexBuffer(rpass_enc, indices.buffer,                      \
+                               WGPUIndexFormat_Uint32, 0, WGPU_WHOLE_SIZE);    \
+    wgpu##Type##SetBindGroup(rpass_enc, 0, gpu_transforms.frame_bind_group,    \
+                             0, NULL);                                         \
+    wgpu##Type##SetBindGroup(rpass_enc, 1, gpu_transforms.render_bind_group,   \
+                             0, NULL);                                         \
+    wgpu##Type##DrawIndexed(rpass_enc, indices.count,                          \
+                            gpu_transforms.params.count, 0, 0, 0);             \
+  }
+
+static void prepare_gpu_transforms_render_bundle(wgpu_context_t* wgpu_context)
+{
+  WGPUTextureFormat color_formats[1] = {wgpu_context->swap_chain.format};
+  WGPURenderBundleEncoder render_bundle_encoder
+    = wgpuDeviceCreateRenderBundleEncoder(
+      wgpu_context->device,
+      &(WGPURenderBundleEncoderDescriptor){
+        .label              = "gpu_transforms_render_bundle_encoder",
+        .colorFormatsCount  = (uint32_t)ARRAY_SIZE(color_formats),
+        .colorFormats       = color_formats,
+        .depthStencilFormat = WGPUTextureFormat_Depth24PlusStencil8,
+        .sampleCount        = 1,
+      });
+  RECORD_INSTANCED_RENDER_PASS(RenderBundleEncoder, render_bundle_encoder)
+  gpu_transforms.render_bundle
+    = wgpuRenderBundleEncoderFinish(render_bundle_encoder, NULL);
+
+  WGPU_RELEASE_RESOURCE(RenderBundleEncoder, render_bundle_encoder)
+}
+
+static void prepare_gpu_transforms(wgpu_context_t* wgpu_context)
+{
+  prepare_gpu_transforms_buffers(wgpu_context);
+  prepare_gpu_transforms_compute_pipeline(wgpu_context);
+  prepare_gpu_transforms_render_pipeline(wgpu_context);
+  prepare_gpu_transforms_render_bundle(wgpu_context);
+}
+
+// The rotations are integrated on the GPU with the time elapsed since the
+// previous dispatch
+static void update_gpu_transforms(wgpu_example_context_t* context)
+{
+  gpu_transforms.params.delta_time = gpu_transforms_timer;
+  gpu_transforms_timer             = 0.0f;
+  wgpu_queue_write_buffer(context->wgpu_context,
+                          gpu_transforms.params_buffer.buffer, 0,
+                          &gpu_transforms.params,
+                          sizeof(gpu_transforms.params));
+}
+
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   // Fixed ubo with projection and view matrices
@@ -472,6 +919,7 @@ static int example_initialize(wgpu_example_context_t* context)
     setup_bind_groups(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepare_render_bundle_encoder(context->wgpu_context);
+    prepare_gpu_transforms(context->wgpu_context);
     prepared = true;
     return 0;
   }
@@ -485,6 +933,13 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
     imgui_overlay_checkBox(context->imgui_overlay, "Render bundles",
                            &render_bundles);
+    imgui_overlay_combo_box(context->imgui_overlay, "Transforms",
+                            &transform_mode, transform_mode_names,
+                            (uint32_t)ARRAY_SIZE(transform_mode_names));
+    imgui_overlay_text("Objects: %u",
+                       transform_mode == TransformMode_GPU_INSTANCED ?
+                         gpu_transforms.params.count :
+                         (uint32_t)OBJECT_INSTANCES);
   }
 }
 
@@ -496,12 +951,35 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  const bool gpu_instanced = transform_mode == TransformMode_GPU_INSTANCED;
+
+  // Compute the model matrices of all objects
+  if (gpu_instanced) {
+    wgpu_context->cpass_enc
+      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
+                                      gpu_transforms.compute_pipeline);
+    wgpuComputePassEncoderSetBindGroup(
+      wgpu_context->cpass_enc, 0, gpu_transforms.compute_bind_group, 0, NULL);
+    wgpuComputePassEncoderDispatchWorkgroups(
+      wgpu_context->cpass_enc,
+      (gpu_transforms.params.count + GPU_TRANSFORMS_WORKGROUP_SIZE - 1)
+        / GPU_TRANSFORMS_WORKGROUP_SIZE,
+      1, 1);
+    wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  }
+
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass.descriptor);
 
   if (render_bundles) {
-    wgpuRenderPassEncoderExecuteBundles(wgpu_context->rpass_enc, 1,
-                                        &render_bundle);
+    wgpuRenderPassEncoderExecuteBundles(
+      wgpu_context->rpass_enc, 1,
+      gpu_instanced ? &gpu_transforms.render_bundle : &render_bundle);
+  }
+  else if (gpu_instanced) {
+    RECORD_INSTANCED_RENDER_PASS(RenderPassEncoder, wgpu_context->rpass_enc)
   }
   else {
     RECORD_RENDER_PASS(RenderPassEncoder, wgpu_context->rpass_enc)
@@ -547,8 +1025,14 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  if (transform_mode == TransformMode_GPU_INSTANCED) {
+    if (!context->paused) {
+      gpu_transforms_timer += context->frame_timer;
+    }
+    update_gpu_transforms(context);
+  }
   const int draw_result = example_draw(context);
-  if (!context->paused) {
+  if (!context->paused && transform_mode == TransformMode_DYNAMIC_OFFSETS) {
     update_dynamic_uniform_buffer(context, false);
   }
   return draw_result;
@@ -571,6 +1055,20 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
   WGPU_RELEASE_RESOURCE(RenderBundle, render_bundle)
+  WGPU_RELEASE_RESOURCE(Buffer, gpu_transforms.params_buffer.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, gpu_transforms.states.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, gpu_transforms.matrices.buffer)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        gpu_transforms.compute_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, gpu_transforms.compute_bind_group)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, gpu_transforms.compute_pipeline_layout)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_transforms.compute_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        gpu_transforms.render_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, gpu_transforms.render_bind_group)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, gpu_transforms.render_pipeline_layout)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, gpu_transforms.render_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderBundle, gpu_transforms.render_bundle)
 }
 
 void example_dynamic_uniform_buffer(int argc, char* argv[])
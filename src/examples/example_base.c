@@ -1,9 +1,12 @@
 #include "example_base.h"
 
+#include <pthread.h>
 #include <string.h>
 
 #include "../core/argparse.h"
+#include "../core/job_system.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/upload_scheduler.h"
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -20,9 +23,73 @@
 static const char* const WINDOW_TITLE = "WebGPU Example";
 static const uint32_t WINDOW_WIDTH    = 1280;
 static const uint32_t WINDOW_HEIGHT   = 720;
+/* Time without resize events after which the swap chain follows the window,
+ * in seconds */
+static const float RESIZE_DEBOUNCE_TIME = 0.1f;
+/* Time after an input event during which the idle overlay keeps being rebuilt,
+ * so that the hover and activation effects of the widgets settle, in seconds */
+static const float OVERLAY_IDLE_INPUT_TIME = 0.5f;
+/* Frame time of the throttled frames of a minimized window, and interval the
+ * events are polled at while its frames are skipped, in seconds */
+static const float HIDDEN_WINDOW_FRAME_TIME    = 0.25f;
+static const float HIDDEN_WINDOW_POLL_INTERVAL = 0.1f;
+/* Longest wait for events of the event thread, which then checks whether the
+ * render thread exited, in seconds */
+static const float RENDER_THREAD_EVENT_TIMEOUT = 0.05f;
+/* Frame time over the median frame time counted as a hitch */
+static const float HITCH_FRAME_TIME_FACTOR = 2.0f;
+
+/* Most simulation steps per frame, unless set with --max-sim-steps */
+#define SIMULATION_DEFAULT_MAX_STEP_COUNT 8
+
+/* Input events passed from the event thread to the render thread, a power of
+ * two */
+#define INPUT_EVENT_QUEUE_SIZE 256u
+
+typedef enum input_event_type_enum {
+  InputEventType_MouseButton    = 0,
+  InputEventType_Key            = 1,
+  InputEventType_Scroll         = 2,
+  InputEventType_CursorPosition = 3,
+  InputEventType_Resize         = 4,
+  InputEventType_Iconify        = 5,
+  InputEventType_Focus          = 6,
+} input_event_type_enum;
+
+typedef struct {
+  input_event_type_enum type;
+  /* button, key code, iconified or focused */
+  int32_t value;
+  button_action_t action;
+  float x, y;
+  float wheel_delta;
+  // Framebuffer size of the resize events
+  uint32_t width, height;
+  // Time of the key and mouse button events, for the latency measurement
+  uint64_t timestamp_ns;
+} input_event_t;
+
+/* Single-producer single-consumer ring: the event thread only writes head,
+ * the render thread only writes tail */
+typedef struct {
+  bool enabled;
+  input_event_t events[INPUT_EVENT_QUEUE_SIZE];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t dropped_count;
+} input_event_queue_t;
 
 typedef struct {
   bool window_resized;
+  uint64_t resize_timestamp_ns;
+  /* framebuffer size of the last resize event, the window is not queried from
+   * the render thread */
+  uint32_t window_width;
+  uint32_t window_height;
+  /* window state */
+  bool iconified;
+  bool focused;
+  uint64_t next_hidden_frame_time_ns;
   bool view_updated;
   /* zoom */
   bool mouse_scrolled;
@@ -30,27 +97,154 @@ typedef struct {
   /* click */
   bool buttons[BUTTON_NUM];
   vec2 cursor_pos;
+  /* last cursor position event, the cursor is not queried from the render
+   * thread */
+  vec2 pointer_pos;
+  /* time of the earliest key or mouse button event since the last frame, 0
+   * without */
+  uint64_t input_time_ns;
   /* key press */
   bool keys[KEY_NUM];
   bool keys_changed;
   int32_t last_key_pressed;
+  /* idle overlay */
+  bool input_received;
+  vec2 overlay_cursor_pos;
   /* timings */
   uint32_t frame_counter;
-  float last_timestamp;
+  uint64_t next_frame_time_ns;
+  uint64_t last_timestamp_ns;
   float frame_timer;
   float last_fps;
+  /* events of the render thread */
+  input_event_queue_t event_queue;
 } record_t;
 
+/* State shared by the event and the render thread */
+typedef struct {
+  wgpu_example_context_t* context;
+  record_t* record;
+  renderfunc_t* render_func;
+  onviewchangedfunc_t* view_changed_func;
+  onkeypressedfunc_t* key_pressed_func;
+  bool done;
+} render_loop_t;
+
 static void get_pos_delta(vec2 old_pos, vec2 new_pos, vec2* result)
 {
   glm_vec2_sub(new_pos, old_pos, *result);
 }
 
-static void get_cursor_pos(window_t* window, vec2* result)
+static void get_cursor_pos(window_t* window, record_t* record, vec2* result)
 {
+  // No pointer in headless mode
+  if (window == NULL) {
+    glm_vec2_zero(*result);
+    return;
+  }
+  // GLFW is only queried from the event thread
+  if (record->event_queue.enabled) {
+    glm_vec2_copy(record->pointer_pos, *result);
+    return;
+  }
   input_query_cursor(window, &(*result)[0], &(*result)[1]);
 }
 
+static void apply_input_event(record_t* record, const input_event_t* event)
+{
+  const bool pressed = event->action == BUTTON_ACTION_PRESS;
+  switch (event->type) {
+    case InputEventType_MouseButton:
+      record->cursor_pos[0]          = event->x;
+      record->cursor_pos[1]          = event->y;
+      record->buttons[BUTTON_LEFT]   = pressed && event->value == BUTTON_LEFT;
+      record->buttons[BUTTON_MIDDLE] = pressed && event->value == BUTTON_MIDDLE;
+      record->buttons[BUTTON_RIGHT]  = pressed && event->value == BUTTON_RIGHT;
+      if (record->input_time_ns == 0) {
+        record->input_time_ns = event->timestamp_ns;
+      }
+      break;
+    case InputEventType_Key:
+      record->keys[event->value] = pressed ? true : false;
+      record->keys_changed       = true;
+      if (!pressed) {
+        record->last_key_pressed = event->value;
+      }
+      if (record->input_time_ns == 0) {
+        record->input_time_ns = event->timestamp_ns;
+      }
+      break;
+    case InputEventType_Scroll:
+      record->cursor_pos[0]  = event->x;
+      record->cursor_pos[1]  = event->y;
+      record->mouse_scrolled = true;
+      record->wheel_delta += event->wheel_delta;
+      break;
+    case InputEventType_CursorPosition:
+      record->pointer_pos[0] = event->x;
+      record->pointer_pos[1] = event->y;
+      // Not an input for the idle overlay, which compares the positions
+      return;
+    case InputEventType_Resize:
+      record->window_width        = event->width;
+      record->window_height       = event->height;
+      record->window_resized      = true;
+      record->resize_timestamp_ns = platform_get_time_ns();
+      break;
+    case InputEventType_Iconify:
+      record->iconified = event->value != 0;
+      break;
+    case InputEventType_Focus:
+      record->focused = event->value != 0;
+      break;
+  }
+  record->input_received = true;
+}
+
+// Applies an event of the window callbacks, or passes it to the render thread
+static void record_input_event(window_t* window, const input_event_t* event)
+{
+  record_t* record = (record_t*)window_get_userdata(window);
+  if (record == NULL) {
+    // Events raised before the render loop started, e.g. while the window is
+    // created, the loop reads the current size when it starts
+    return;
+  }
+  input_event_queue_t* queue = &record->event_queue;
+  if (!queue->enabled) {
+    apply_input_event(record, event);
+    return;
+  }
+
+  const uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  const uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= INPUT_EVENT_QUEUE_SIZE) {
+    // The render thread stalls, the oldest events stay
+    ++queue->dropped_count;
+    return;
+  }
+  queue->events[head & (INPUT_EVENT_QUEUE_SIZE - 1)] = *event;
+  __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Polls the events, or takes the events of the event thread from the queue
+static void poll_input_events(record_t* record)
+{
+  input_event_queue_t* queue = &record->event_queue;
+  if (!queue->enabled) {
+    input_poll_events();
+    return;
+  }
+
+  const uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+  uint32_t tail       = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+  for (; tail != head; ++tail) {
+    apply_input_event(record,
+                      &queue->events[tail & (INPUT_EVENT_QUEUE_SIZE - 1)]);
+  }
+  __atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+}
+
 static void mouse_button_callback(window_t* window, int ctrl_key, int shift_key,
                                   float mouse_x, float mouse_y, button_t button,
                                   button_action_t button_action)
@@ -58,15 +252,14 @@ static void mouse_button_callback(window_t* window, int ctrl_key, int shift_key,
   UNUSED_VAR(ctrl_key);
   UNUSED_VAR(shift_key);
 
-  record_t* record = (record_t*)window_get_userdata(window);
-
-  record->cursor_pos[0] = mouse_x;
-  record->cursor_pos[1] = mouse_y;
-  const bool pressed    = button_action == BUTTON_ACTION_PRESS;
-
-  record->buttons[BUTTON_LEFT]   = (button == BUTTON_LEFT) && pressed;
-  record->buttons[BUTTON_MIDDLE] = (button == BUTTON_MIDDLE) && pressed;
-  record->buttons[BUTTON_RIGHT]  = (button == BUTTON_RIGHT) && pressed;
+  record_input_event(window, &(input_event_t){
+                               .type         = InputEventType_MouseButton,
+                               .value        = (int32_t)button,
+                               .action       = button_action,
+                               .x            = mouse_x,
+                               .y            = mouse_y,
+                               .timestamp_ns = platform_get_time_ns(),
+                             });
 }
 
 static void key_callback(window_t* window, int ctrl_key, int shift_key,
@@ -75,14 +268,12 @@ static void key_callback(window_t* window, int ctrl_key, int shift_key,
   UNUSED_VAR(ctrl_key);
   UNUSED_VAR(shift_key);
 
-  record_t* record   = (record_t*)window_get_userdata(window);
-  const bool pressed = button_action == BUTTON_ACTION_PRESS;
-
-  record->keys[key_code] = pressed ? true : false;
-  record->keys_changed   = true;
-  if (!pressed) {
-    record->last_key_pressed = key_code;
-  }
+  record_input_event(window, &(input_event_t){
+                               .type         = InputEventType_Key,
+                               .value        = (int32_t)key_code,
+                               .action       = button_action,
+                               .timestamp_ns = platform_get_time_ns(),
+                             });
 }
 
 static void scroll_callback(window_t* window, int ctrl_key, int shift_key,
@@ -91,43 +282,82 @@ static void scroll_callback(window_t* window, int ctrl_key, int shift_key,
   UNUSED_VAR(ctrl_key);
   UNUSED_VAR(shift_key);
 
-  record_t* record = (record_t*)window_get_userdata(window);
+  record_input_event(window, &(input_event_t){
+                               .type        = InputEventType_Scroll,
+                               .x           = mouse_x,
+                               .y           = mouse_y,
+                               .wheel_delta = wheel_delta_y,
+                             });
+}
+
+static void cursor_position_callback(window_t* window, int ctrl_key,
+                                     int shift_key, float cursor_x,
+                                     float cursor_y)
+{
+  UNUSED_VAR(ctrl_key);
+  UNUSED_VAR(shift_key);
 
-  record->cursor_pos[0]  = mouse_x;
-  record->cursor_pos[1]  = mouse_y;
-  record->mouse_scrolled = true;
-  record->wheel_delta += wheel_delta_y;
+  record_input_event(window, &(input_event_t){
+                               .type = InputEventType_CursorPosition,
+                               .x    = cursor_x,
+                               .y    = cursor_y,
+                             });
 }
 
 static void resize_callback(window_t* window, int width, int height)
 {
-  UNUSED_VAR(width);
-  UNUSED_VAR(height);
+  record_input_event(window, &(input_event_t){
+                               .type   = InputEventType_Resize,
+                               .width  = (uint32_t)MAX(width, 0),
+                               .height = (uint32_t)MAX(height, 0),
+                             });
+}
+
+static void iconify_callback(window_t* window, int iconified)
+{
+  record_input_event(window, &(input_event_t){
+                               .type  = InputEventType_Iconify,
+                               .value = iconified,
+                             });
+}
 
-  record_t* record       = (record_t*)window_get_userdata(window);
-  record->window_resized = true;
+static void focus_callback(window_t* window, int focused)
+{
+  record_input_event(window, &(input_event_t){
+                               .type  = InputEventType_Focus,
+                               .value = focused,
+                             });
 }
 
-#if 0
-static void update_window_size(wgpu_example_context_t* context,
+// Returns true when the swap chain and the size-dependent attachments have
+// been recreated, once the window has not been resized for a while
+static bool update_window_size(wgpu_example_context_t* context,
                                record_t* record)
 {
-  if (record->window_resized) {
-    wgpu_context_t* wgpu_context = context->wgpu_context;
-    // Update window size and aspect ratio
-    window_get_size(context->window, &context->window_size.width,
-                    &context->window_size.height);
-    window_get_aspect_ratio(context->window,
-                            &context->window_size.aspect_ratio);
-    // Update surface size
-    window_get_size(context->window, &wgpu_context->surface.width,
-                    &wgpu_context->surface.height);
-    // Recreate swap chain
-    wgpu_setup_swap_chain(context->wgpu_context);
-    record->window_resized = false;
+  if (!record->window_resized
+      || (float)(platform_get_time_ns() - record->resize_timestamp_ns) * 1e-9f
+           < RESIZE_DEBOUNCE_TIME) {
+    return false;
+  }
+  record->window_resized = false;
+
+  // Minimized windows keep the previous swap chain
+  const uint32_t width = record->window_width, height = record->window_height;
+  if (width == 0 || height == 0
+      || !wgpu_resize_surface(context->wgpu_context, width, height)) {
+    return false;
+  }
+
+  // Update window size and aspect ratio
+  context->window_size.width        = width;
+  context->window_size.height       = height;
+  context->window_size.aspect_ratio = (float)width / (float)height;
+  if (context->camera != NULL) {
+    camera_update_aspect_ratio(context->camera,
+                               context->window_size.aspect_ratio);
   }
+  return true;
 }
-#endif
 
 static void update_camera(wgpu_example_context_t* context, record_t* record)
 {
@@ -141,7 +371,7 @@ static void update_camera(wgpu_example_context_t* context, record_t* record)
   camera->updated = false;
 
   vec2 cursor_pos;
-  get_cursor_pos(window, &cursor_pos);
+  get_cursor_pos(window, record, &cursor_pos);
 
   vec2 pos_delta;
   get_pos_delta(record->cursor_pos, cursor_pos, &pos_delta);
@@ -201,7 +431,7 @@ static void update_input_state(wgpu_example_context_t* context,
                                record_t* record)
 {
   // Mouse position
-  get_cursor_pos(context->window, &context->mouse_position);
+  get_cursor_pos(context->window, record, &context->mouse_position);
 
   // Mouse buttons press state
   context->mouse_buttons.left   = record->buttons[BUTTON_LEFT];
@@ -217,6 +447,20 @@ static void update_input_state(wgpu_example_context_t* context,
   }
 }
 
+// Records the time of the last input for the idle overlay, pointer movements
+// have no event of their own
+static void update_overlay_input_time(wgpu_example_context_t* context,
+                                      record_t* record)
+{
+  if (record->input_received
+      || record->overlay_cursor_pos[0] != context->mouse_position[0]
+      || record->overlay_cursor_pos[1] != context->mouse_position[1]) {
+    context->overlay.input_time = context->run_time;
+    record->input_received      = false;
+    glm_vec2_copy(context->mouse_position, record->overlay_cursor_pos);
+  }
+}
+
 static void
 notify_key_input_state(record_t* record,
                        onkeypressedfunc_t* example_on_key_pressed_func)
@@ -227,17 +471,101 @@ notify_key_input_state(record_t* record,
   }
 }
 
+static wgpu_present_mode_enum parse_present_mode(const char* name)
+{
+  if (name == NULL) {
+    return PresentMode_Default;
+  }
+  if (strcmp(name, "fifo") == 0) {
+    return PresentMode_Fifo;
+  }
+  if (strcmp(name, "mailbox") == 0) {
+    return PresentMode_Mailbox;
+  }
+  if (strcmp(name, "immediate") == 0) {
+    return PresentMode_Immediate;
+  }
+  log_warn("Unknown present mode %s, expected fifo, mailbox or immediate",
+           name);
+  return PresentMode_Default;
+}
+
+static hidden_window_policy_enum parse_hidden_policy(const char* name)
+{
+  if (name == NULL || strcmp(name, "throttle") == 0) {
+    return HiddenWindowPolicy_Throttle;
+  }
+  if (strcmp(name, "pause") == 0) {
+    return HiddenWindowPolicy_Pause;
+  }
+  if (strcmp(name, "simulate") == 0) {
+    return HiddenWindowPolicy_SimulationOnly;
+  }
+  if (strcmp(name, "continue") == 0) {
+    return HiddenWindowPolicy_Continue;
+  }
+  log_warn("Unknown hidden window policy %s, expected throttle, pause, "
+           "simulate or continue",
+           name);
+  return HiddenWindowPolicy_Throttle;
+}
+
 static void parse_example_arguments(int argc, char* argv[],
-                                    refexport_t* ref_export)
+                                    refexport_t* ref_export,
+                                    benchmark_settings_t* benchmark_settings,
+                                    frame_pacing_settings_t* frame_pacing,
+                                    headless_settings_t* headless,
+                                    simulation_settings_t* simulation,
+                                    wgpu_adapter_selection_t* adapter,
+                                    memory_settings_t* memory,
+                                    float* run_time_limit,
+                                    const char** trace_output,
+                                    const char** api_trace_output)
 {
-  char* filters_short[2]           = {"-w", "-h"};
-  char* filters_eq[2]              = {"--width=", "--height="};
-  char* filtered_argv[1 + (2 * 2)] = {0};
-  char** argvc                     = (char**)argv;
-  int fargc                        = 1;
+  char* filters_flag[11]  = {"-b",
+                             "--benchmark",
+                             "--low-latency",
+                             "--headless",
+                             "--idle-overlay",
+                             "--async-compute",
+                             "--track-lifetimes",
+                             "--dynamic-resolution",
+                             "--assert-steady-state",
+                             "--render-thread",
+                             "--gpu-queries"};
+  char* filters_short[13] = {"-w",
+                             "-h",
+                             "-o",
+                             "--warmup-frames",
+                             "--frames",
+                             "--present-mode",
+                             "--target-fps",
+                             "--frame-output",
+                             "--trace-output",
+                             "--sim-rate",
+                             "--max-sim-steps",
+                             "--hidden-policy",
+                             "--api-trace"};
+  char* filters_eq[19]    = {"--width=", "--height=", "--benchmark-output=",
+                             "--warmup-frames=", "--frames=", "--present-mode=",
+                             "--target-fps=", "--frame-output=",
+                             "--trace-output=", "--sim-rate=",
+                             "--max-sim-steps=", "--adapter=",
+                             "--adapter-vendor=", "--adapter-backend=",
+                             "--memory-budget=", "--run-time=",
+                             "--min-resolution-scale=", "--hidden-policy=",
+                             "--api-trace="};
+  char* filtered_argv[1 + 11 + (13 * 2) + 19] = {0};
+  char** argvc                             = (char**)argv;
+  int fargc                                = 1;
   for (int32_t i = 0; i < argc; ++i) {
+    for (uint32_t j = 0; j < (uint32_t)ARRAY_SIZE(filters_flag); ++j) {
+      if (strcmp(argvc[i], filters_flag[j]) == 0) {
+        filtered_argv[fargc++] = filters_flag[j];
+      }
+    }
     for (uint32_t j = 0; j < (uint32_t)ARRAY_SIZE(filters_short); ++j) {
-      if (strcmp(argvc[i], filters_short[j]) == 0) {
+      if (strcmp(argvc[i], filters_short[j]) == 0 && i + 1 < argc) {
         filtered_argv[fargc++] = filters_short[j];
         filtered_argv[fargc++] = argvc[++i];
       }
@@ -249,10 +577,83 @@ static void parse_example_arguments(int argc, char* argv[],
     }
   }
 
-  int window_width = 0, window_height = 0;
+  int window_width = 0, window_height = 0, benchmark = 0;
+  int warmup_frame_count = BENCHMARK_DEFAULT_WARMUP_FRAME_COUNT,
+      frame_count        = BENCHMARK_DEFAULT_FRAME_COUNT;
+  const char* benchmark_output = NULL;
+  const char* present_mode     = NULL;
+  const char* hidden_policy    = NULL;
+  int target_fps = 0, low_latency = 0, headless_mode = 0, idle_overlay = 0;
+  const char* frame_output = NULL;
+  int sim_rate = 0, max_sim_steps = SIMULATION_DEFAULT_MAX_STEP_COUNT,
+      async_compute = 0;
+  const char* adapter_name    = NULL;
+  const char* adapter_vendor  = NULL;
+  const char* adapter_backend = NULL;
+  int memory_budget_mib = 0, track_lifetimes = 0, run_time = 0;
+  int dynamic_resolution = 0, min_resolution_scale = 50;
+  int assert_steady_state = 0, render_thread = 0, gpu_queries = 0;
   struct argparse_option options[] = {
     OPT_INTEGER('w', "width", &window_width, "window width", NULL, 0, 0),
     OPT_INTEGER('h', "height", &window_height, "window height", NULL, 0, 0),
+    OPT_BOOLEAN('b', "benchmark", &benchmark, "benchmark mode", NULL, 0, 0),
+    OPT_INTEGER(0, "warmup-frames", &warmup_frame_count,
+                "number of warm-up frames", NULL, 0, 0),
+    OPT_INTEGER(0, "frames", &frame_count, "number of measured frames", NULL,
+                0, 0),
+    OPT_STRING('o', "benchmark-output", &benchmark_output,
+               "benchmark output file", NULL, 0, 0),
+    OPT_STRING(0, "present-mode", &present_mode,
+               "present mode: fifo, mailbox or immediate", NULL, 0, 0),
+    OPT_INTEGER(0, "target-fps", &target_fps, "paced frame rate", NULL, 0, 0),
+    OPT_STRING(0, "hidden-policy", &hidden_policy,
+               "frames of a minimized window: throttle, pause, simulate or "
+               "continue",
+               NULL, 0, 0),
+    OPT_BOOLEAN(0, "low-latency", &low_latency,
+                "wait for the GPU before sampling input", NULL, 0, 0),
+    OPT_BOOLEAN(0, "render-thread", &render_thread,
+                "render on a thread of its own, apart from the events", NULL, 0,
+                0),
+    OPT_BOOLEAN(0, "idle-overlay", &idle_overlay,
+                "rebuild the UI overlay only when it may change", NULL, 0, 0),
+    OPT_BOOLEAN(0, "headless", &headless_mode, "render without a window",
+                NULL, 0, 0),
+    OPT_STRING(0, "frame-output", &frame_output,
+               "directory headless frames are written to", NULL, 0, 0),
+    OPT_STRING(0, "trace-output", trace_output,
+               "Chrome trace file the profiler scopes are written to", NULL, 0,
+               0),
+    OPT_STRING(0, "api-trace", api_trace_output,
+               "file the WebGPU calls are captured to for replay", NULL, 0, 0),
+    OPT_INTEGER(0, "sim-rate", &sim_rate, "simulation steps per second", NULL,
+                0, 0),
+    OPT_INTEGER(0, "max-sim-steps", &max_sim_steps,
+                "most simulation steps per frame", NULL, 0, 0),
+    OPT_BOOLEAN(0, "async-compute", &async_compute,
+                "submit the simulation ahead of the render", NULL, 0, 0),
+    OPT_STRING(0, "adapter", &adapter_name,
+               "adapter index in the ranked list or part of its name", NULL, 0,
+               0),
+    OPT_STRING(0, "adapter-vendor", &adapter_vendor, "adapter PCI vendor id",
+               NULL, 0, 0),
+    OPT_STRING(0, "adapter-backend", &adapter_backend,
+               "adapter backend, e.g. vulkan", NULL, 0, 0),
+    OPT_INTEGER(0, "memory-budget", &memory_budget_mib,
+                "GPU memory budget in MiB", NULL, 0, 0),
+    OPT_BOOLEAN(0, "track-lifetimes", &track_lifetimes,
+                "report the resources still alive at exit", NULL, 0, 0),
+    OPT_BOOLEAN(0, "assert-steady-state", &assert_steady_state,
+                "assert no allocations after the warm-up frames", NULL, 0, 0),
+    OPT_INTEGER(0, "run-time", &run_time, "seconds to run the example for",
+                NULL, 0, 0),
+    OPT_BOOLEAN(0, "dynamic-resolution", &dynamic_resolution,
+                "scale the render resolution to the GPU frame time", NULL, 0,
+                0),
+    OPT_INTEGER(0, "min-resolution-scale", &min_resolution_scale,
+                "lowest dynamic resolution scale in percent", NULL, 0, 0),
+    OPT_BOOLEAN(0, "gpu-queries", &gpu_queries,
+                "measure the GPU times with timestamp queries", NULL, 0, 0),
     OPT_END(),
   };
   struct argparse argparse;
@@ -267,6 +668,57 @@ static void parse_example_arguments(int argc, char* argv[],
   if (window_height > 100) {
     ref_export->example_window_config.height = window_height;
   }
+
+  // Benchmark settings
+  benchmark_settings->enabled            = (benchmark != 0);
+  benchmark_settings->warmup_frame_count = (uint32_t)MAX(warmup_frame_count, 0);
+  benchmark_settings->frame_count        = (uint32_t)MAX(frame_count, 1);
+  benchmark_settings->output_file        = benchmark_output;
+
+  // Frame pacing settings
+  frame_pacing->present_mode = parse_present_mode(present_mode);
+  frame_pacing->target_frame_time
+    = target_fps > 0 ? 1.0f / (float)target_fps : 0.0f;
+  frame_pacing->low_latency  = (low_latency != 0);
+  frame_pacing->idle_overlay = (idle_overlay != 0);
+  frame_pacing->dynamic_resolution = (dynamic_resolution != 0);
+  frame_pacing->min_resolution_scale
+    = (float)CLAMP(min_resolution_scale, 10, 100) / 100.0f;
+  frame_pacing->hidden_policy = parse_hidden_policy(hidden_policy);
+  frame_pacing->render_thread = (render_thread != 0);
+  frame_pacing->gpu_queries   = (gpu_queries != 0) || (benchmark != 0)
+                              || (dynamic_resolution != 0);
+
+  // Headless settings, the frame count is shared with the benchmark mode
+  headless->enabled          = (headless_mode != 0);
+  headless->frame_count      = (uint32_t)MAX(frame_count, 1);
+  headless->output_directory = frame_output;
+
+  // Simulation settings
+  simulation->step_rate      = sim_rate > 0 ? (float)sim_rate : 0.0f;
+  simulation->max_step_count = (uint32_t)MAX(max_sim_steps, 1);
+  simulation->async_compute  = (async_compute != 0);
+
+  // Adapter selection, a number selects the adapter by its index
+  adapter->index = -1;
+  if (adapter_name != NULL) {
+    char* end            = NULL;
+    const long index     = strtol(adapter_name, &end, 10);
+    const bool is_number = end != adapter_name && *end == '\0';
+    adapter->index       = is_number ? (int32_t)index : -1;
+    adapter->name        = is_number ? NULL : adapter_name;
+  }
+  adapter->vendor_id
+    = adapter_vendor ? (uint32_t)strtoul(adapter_vendor, NULL, 0) : 0;
+  adapter->backend = adapter_backend;
+
+  // Memory settings
+  memory->budget = (uint64_t)MAX(memory_budget_mib, 0) * 1024u * 1024u;
+  memory->track_lifetimes     = (track_lifetimes != 0);
+  memory->assert_steady_state = (assert_steady_state != 0);
+  memory->warmup_frame_count  = (uint32_t)MAX(warmup_frame_count, 0);
+
+  *run_time_limit = (float)MAX(run_time, 0);
 }
 
 static void
@@ -301,11 +753,37 @@ intialize_wgpu_example_context(wgpu_example_context_t* context,
   context->mouse_dragging.left   = false;
   context->mouse_dragging.right  = false;
   context->mouse_dragging.middle = false;
+
+  // Idle overlay, built in the first frame
+  context->overlay.invalidated = true;
+  context->overlay.input_time  = 0.0f;
+
+  // Simulation, one step per frame until the settings are parsed
+  context->simulation.settings.step_rate      = 0.0f;
+  context->simulation.settings.max_step_count = 1;
+  context->simulation.step_count              = 1;
+  context->simulation.step_index              = 0;
+  context->simulation.alpha                   = 1.0f;
+  context->simulation.accumulator             = 0.0;
+  context->simulation.write_index             = 0;
+  context->simulation.read_index              = 0;
 }
 
 static void setup_window(wgpu_example_context_t* context,
                          window_config_t* windows_config)
 {
+  // Headless examples only need the size of the offscreen images
+  if (context->headless.enabled) {
+    context->window = NULL;
+    context->window_size.width
+      = windows_config->width > 0 ? windows_config->width : WINDOW_WIDTH;
+    context->window_size.height
+      = windows_config->height > 0 ? windows_config->height : WINDOW_HEIGHT;
+    context->window_size.aspect_ratio = (float)context->window_size.width
+                                        / (float)context->window_size.height;
+    return;
+  }
+
   char window_title[STRMAX];
   snprintf(window_title,
            strlen("WebGPU Example - ") + strlen(context->example_title) + 1,
@@ -322,25 +800,73 @@ static void setup_window(wgpu_example_context_t* context,
   window_get_aspect_ratio(context->window, &context->window_size.aspect_ratio);
 
   memset(&context->callbacks, 0, sizeof(callbacks_t));
-  context->callbacks.mouse_button_callback = mouse_button_callback;
-  context->callbacks.key_callback          = key_callback;
-  context->callbacks.scroll_callback       = scroll_callback;
-  context->callbacks.resize_callback       = resize_callback;
+  context->callbacks.mouse_button_callback    = mouse_button_callback;
+  context->callbacks.key_callback             = key_callback;
+  context->callbacks.scroll_callback          = scroll_callback;
+  context->callbacks.resize_callback          = resize_callback;
+  context->callbacks.cursor_position_callback = cursor_position_callback;
+  context->callbacks.iconify_callback         = iconify_callback;
+  context->callbacks.focus_callback           = focus_callback;
 
   input_set_callbacks(context->window, context->callbacks);
 }
 
-static void intialize_webgpu(wgpu_example_context_t* context)
+static void intialize_webgpu(wgpu_example_context_t* context,
+                             wgpu_example_settings_t* example_settings)
 {
+  // GPU time budget of the dynamic resolution, the paced frame time or 60 Hz
+  const frame_pacing_settings_t* frame_pacing = &context->frame_pacing;
+  float target_gpu_frame_time_ms              = 0.0f;
+  if (frame_pacing->dynamic_resolution) {
+    target_gpu_frame_time_ms = frame_pacing->target_frame_time > 0.0f ?
+                                 1000.0f * frame_pacing->target_frame_time :
+                                 1000.0f / 60.0f;
+  }
+
   context->wgpu_context = wgpu_context_create(&(wgpu_context_create_options_t){
-    .vsync = context->vsync,
+    .vsync                    = context->vsync,
+    .present_mode             = frame_pacing->present_mode,
+    .adapter_selection        = &context->adapter_selection,
+    .frames_in_flight         = example_settings->frames_in_flight,
+    .required_feature_count   = example_settings->required_feature_count,
+    .required_features        = example_settings->required_features,
+    .required_limits          = example_settings->required_limits,
+    .memory_budget            = context->memory.budget,
+    .track_lifetimes          = context->memory.track_lifetimes,
+    .target_gpu_frame_time_ms = target_gpu_frame_time_ms,
+    .min_resolution_scale     = frame_pacing->min_resolution_scale,
+    .reversed_z               = example_settings->reversed_z,
+    .gpu_queries              = frame_pacing->gpu_queries,
   });
   context->wgpu_context->context = context;
 
   wgpu_create_device_and_queue(context->wgpu_context);
-  wgpu_setup_window_surface(context->wgpu_context, context->window);
-  wgpu_setup_swap_chain(context->wgpu_context);
+  if (context->headless.enabled) {
+    wgpu_setup_offscreen_swap_chain(
+      context->wgpu_context, &(wgpu_offscreen_swap_chain_desc_t){
+                               .width  = context->window_size.width,
+                               .height = context->window_size.height,
+                               .output_directory
+                               = context->headless.output_directory,
+                             });
+  }
+  else {
+    wgpu_setup_window_surface(context->wgpu_context, context->window);
+    wgpu_setup_swap_chain(context->wgpu_context);
+  }
   wgpu_get_context_info(context->adapter_info);
+
+  // GPU timestamp profiler (NULL when timestamp queries are not supported)
+  context->wgpu_context->gpu_profiler
+    = wgpu_gpu_profiler_create(context->wgpu_context);
+  if (context->wgpu_context->dynamic_resolution != NULL
+      && context->wgpu_context->gpu_profiler == NULL) {
+    log_warn("Dynamic resolution needs timestamp queries, the resolution "
+             "stays fixed");
+  }
+  // Statistics of the pass scopes of the examples
+  context->wgpu_context->pipeline_statistics
+    = wgpu_pipeline_statistics_create(context->wgpu_context);
 }
 
 static void intialize_imgui(wgpu_example_context_t* context,
@@ -373,6 +899,14 @@ update_overlay(wgpu_example_context_t* context,
     return;
   }
 
+  // In idle mode the last overlay is drawn again until it may have changed
+  if (context->frame_pacing.idle_overlay && !context->overlay.invalidated
+      && context->run_time - context->overlay.input_time
+           >= OVERLAY_IDLE_INPUT_TIME) {
+    return;
+  }
+  context->overlay.invalidated = false;
+
   imgui_overlay_new_frame(context->imgui_overlay, context);
 
   igSetNextWindowPos((ImVec2){10, 10}, ImGuiCond_None, (ImVec2){0, 0});
@@ -384,8 +918,111 @@ update_overlay(wgpu_example_context_t* context,
   igTextUnformatted(context->example_title, NULL);
   igTextUnformatted(context->adapter_info[0], NULL);
   igText("%s backend - %s", context->adapter_info[2], context->adapter_info[1]);
+  igText("Present mode: %s%s",
+         wgpu_get_present_mode_name(
+           context->wgpu_context->swap_chain.present_mode),
+         context->frame_pacing.low_latency ? " (low latency)" : "");
   igText("%.2f ms/frame (%.1d fps)", (1000.0f / context->last_fps),
          context->last_fps);
+  if (context->wgpu_context->gpu_profiler != NULL) {
+    igText("%.2f ms/frame (GPU)", wgpu_gpu_profiler_get_frame_time_ms(
+                                    context->wgpu_context->gpu_profiler));
+  }
+  if (context->frame_history.count > 0) {
+    igText("1%% low: %.2f ms, 0.1%% low: %.2f ms, %u hitches",
+           context->frame_history.low_1_ms, context->frame_history.low_0_1_ms,
+           context->frame_history.hitch_count);
+    // Oldest frame first once the ring is full, all graphs share the scale of
+    // the CPU frame times
+    const int count  = (int)context->frame_history.count;
+    const int offset = context->frame_history.count < FRAME_TIME_HISTORY_SIZE ?
+                         0 :
+                         (int)context->frame_history.index;
+    const float scale_max = MAX(1.0f, 1.5f * context->frame_history.low_0_1_ms);
+    const ImVec2 graph_size
+      = {0.0f, 40.0f * imgui_overlay_get_scale(context->imgui_overlay)};
+    igPlotLines_FloatPtr("CPU", context->frame_history.cpu_ms, count, offset,
+                         NULL, 0.0f, scale_max, graph_size, sizeof(float));
+    if (context->wgpu_context->gpu_profiler != NULL) {
+      igPlotLines_FloatPtr("GPU", context->frame_history.gpu_ms, count, offset,
+                           NULL, 0.0f, scale_max, graph_size, sizeof(float));
+    }
+  }
+  if (context->input_latency.history_count > 0) {
+    igText("Input latency: %.2f ms (p50 %.2f ms, p95 %.2f ms)",
+           context->input_latency.completion_ms, context->input_latency.p50_ms,
+           context->input_latency.p95_ms);
+    igText("Input to present: %.2f ms", context->input_latency.present_ms);
+  }
+  if (context->wgpu_context->dynamic_resolution != NULL) {
+    wgpu_dynamic_resolution_t* dynamic_resolution
+      = context->wgpu_context->dynamic_resolution;
+    igText("Resolution scale: %.0f%% (%.1f ms target)",
+           wgpu_dynamic_resolution_get_scale(dynamic_resolution) * 100.0f,
+           wgpu_dynamic_resolution_get_target_frame_time_ms(
+             dynamic_resolution));
+  }
+  const wgpu_gpu_profiler_result_t* gpu_timings = NULL;
+  const uint32_t gpu_timing_count = wgpu_gpu_profiler_get_results(
+    context->wgpu_context->gpu_profiler, &gpu_timings);
+  for (uint32_t i = 0; i < gpu_timing_count; ++i) {
+    igText("%s: %.3f ms (GPU)", gpu_timings[i].name,
+           gpu_timings[i].gpu_time_ms);
+  }
+  const wgpu_pipeline_statistics_result_t* pass_statistics = NULL;
+  const uint32_t pass_statistics_count = wgpu_pipeline_statistics_get_results(
+    context->wgpu_context->pipeline_statistics, &pass_statistics);
+  for (uint32_t i = 0; i < pass_statistics_count; ++i) {
+    const wgpu_pipeline_statistics_result_t* statistics = &pass_statistics[i];
+    if (statistics->compute_invocations > 0) {
+      igText("%s: %llu invocations", statistics->name,
+             (unsigned long long)statistics->compute_invocations);
+    }
+    else {
+      igText("%s: %llu vert, %llu prim, %llu frag", statistics->name,
+             (unsigned long long)statistics->vertex_invocations,
+             (unsigned long long)statistics->clipper_primitives,
+             (unsigned long long)statistics->fragment_invocations);
+    }
+    // Fragments per visible sample, the overdraw of the scope
+    if (statistics->has_samples_passed) {
+      igText("%s: %llu samples passed (%.2f frag/sample)", statistics->name,
+             (unsigned long long)statistics->samples_passed,
+             statistics->samples_passed > 0 ?
+               (double)statistics->fragment_invocations
+                 / (double)statistics->samples_passed :
+               0.0);
+    }
+  }
+  if (wgpu_memory_tracker_is_enabled()) {
+    wgpu_memory_stats_t memory_stats = {0};
+    wgpu_memory_tracker_get_stats(&memory_stats);
+    igText("GPU memory: %.2f MiB (peak %.2f MiB)",
+           (double)memory_stats.total_bytes / (1024.0 * 1024.0),
+           (double)memory_stats.peak_bytes / (1024.0 * 1024.0));
+    for (uint32_t i = 0; i < WGPU_MEMORY_CATEGORY_COUNT; ++i) {
+      if (memory_stats.counts[i] > 0) {
+        igText("  %s: %.2f MiB (%u)",
+               wgpu_memory_category_name((wgpu_memory_category_t)i),
+               (double)memory_stats.bytes[i] / (1024.0 * 1024.0),
+               memory_stats.counts[i]);
+      }
+    }
+    if (memory_stats.budget_bytes > 0
+        && memory_stats.total_bytes > memory_stats.budget_bytes) {
+      igText("Over the budget of %.2f MiB",
+             (double)memory_stats.budget_bytes / (1024.0 * 1024.0));
+    }
+  }
+  if (context->wgpu_context->upload_scheduler != NULL) {
+    wgpu_upload_scheduler_stats_t upload_stats = {0};
+    wgpu_upload_scheduler_get_stats(context->wgpu_context->upload_scheduler,
+                                    &upload_stats);
+    igText("Uploads: %u queued (%.2f MiB), %.2f MiB/s",
+           upload_stats.queued_count,
+           (float)upload_stats.queued_bytes / (1024.0f * 1024.0f),
+           upload_stats.bytes_per_second / (1024.0f * 1024.0f));
+  }
   if (example_on_update_ui_overlay_func) {
     igPushItemWidth(110.0f * imgui_overlay_get_scale(context->imgui_overlay));
     example_on_update_ui_overlay_func(context);
@@ -396,73 +1033,484 @@ update_overlay(wgpu_example_context_t* context,
   imgui_overlay_render(context->imgui_overlay);
 }
 
-static void render_loop(wgpu_example_context_t* context,
-                        renderfunc_t* render_func,
-                        onviewchangedfunc_t* view_changed_func,
-                        onkeypressedfunc_t* example_on_key_pressed_func)
+// Records the last read back pass statistics as benchmark counters
+static void record_pipeline_statistics(wgpu_example_context_t* context)
 {
-  record_t record;
-  memset(&record, 0, sizeof(record_t));
-  window_set_userdata(context->window, &record);
-
-  float time_start, time_end, time_diff, fps_timer;
-  record.last_timestamp = platform_get_time();
-  while (!window_should_close(context->window)) {
-    time_start                      = platform_get_time();
-    context->frame.timestamp_millis = time_start * 1000.0f;
-    if (record.view_updated) {
-      record.mouse_scrolled = 0;
-      record.wheel_delta    = 0;
-      record.view_updated   = false;
+  const wgpu_pipeline_statistics_result_t* results = NULL;
+  const uint32_t result_count = wgpu_pipeline_statistics_get_results(
+    context->wgpu_context->pipeline_statistics, &results);
+  char name[STRMAX];
+  for (uint32_t i = 0; i < result_count; ++i) {
+    const wgpu_pipeline_statistics_result_t* result = &results[i];
+    const struct {
+      const char* suffix;
+      uint64_t value;
+    } counters[5] = {
+      {"vertex_invocations", result->vertex_invocations},
+      {"clipper_primitives", result->clipper_primitives},
+      {"fragment_invocations", result->fragment_invocations},
+      {"compute_invocations", result->compute_invocations},
+      {"samples_passed", result->samples_passed},
+    };
+    const uint32_t counter_count = result->has_samples_passed ? 5 : 4;
+    for (uint32_t j = 0; j < counter_count; ++j) {
+      snprintf(name, sizeof(name), "%s.%s", result->name, counters[j].suffix);
+      benchmark_record_counter(context->benchmark.instance, name,
+                               (double)counters[j].value);
     }
-    input_poll_events();
-    // update_window_size(context, &record);
+  }
+}
+
+// Records the tracked GPU memory, in total and per category, as benchmark
+// counters
+static void record_memory_statistics(benchmark_t* benchmark)
+{
+  if (!wgpu_memory_tracker_is_enabled()) {
+    return;
+  }
+  wgpu_memory_stats_t stats = {0};
+  wgpu_memory_tracker_get_stats(&stats);
+  benchmark_record_counter(benchmark, "gpu_memory.total_bytes",
+                           (double)stats.total_bytes);
+  benchmark_record_counter(benchmark, "gpu_memory.peak_bytes",
+                           (double)stats.peak_bytes);
+  static const char* category_keys[WGPU_MEMORY_CATEGORY_COUNT] = {
+    [WGPU_MEMORY_CATEGORY_VERTEX_INDEX_BUFFER] = "vertex_index_buffers",
+    [WGPU_MEMORY_CATEGORY_UNIFORM_BUFFER]      = "uniform_buffers",
+    [WGPU_MEMORY_CATEGORY_STORAGE_BUFFER]      = "storage_buffers",
+    [WGPU_MEMORY_CATEGORY_STAGING_BUFFER]      = "staging_buffers",
+    [WGPU_MEMORY_CATEGORY_OTHER_BUFFER]        = "other_buffers",
+    [WGPU_MEMORY_CATEGORY_TEXTURE]             = "textures",
+    [WGPU_MEMORY_CATEGORY_RENDER_TARGET]       = "render_targets",
+    [WGPU_MEMORY_CATEGORY_DEPTH_STENCIL]       = "depth_stencil",
+  };
+  char name[STRMAX];
+  for (uint32_t i = 0; i < WGPU_MEMORY_CATEGORY_COUNT; ++i) {
+    snprintf(name, sizeof(name), "gpu_memory.%s_bytes", category_keys[i]);
+    benchmark_record_counter(benchmark, name, (double)stats.bytes[i]);
+  }
+}
+
+// Starts the frames at a fixed rate and samples the input as late as possible
+static void pace_frame(wgpu_example_context_t* context, record_t* record)
+{
+  const frame_pacing_settings_t* frame_pacing = &context->frame_pacing;
+  if (frame_pacing->target_frame_time > 0.0f) {
+    const uint64_t now_ns = platform_get_time_ns();
+    if (record->next_frame_time_ns > now_ns) {
+      platform_sleep((float)(record->next_frame_time_ns - now_ns) * 1e-9f);
+    }
+    // Catch up with the schedule instead of rendering a burst of frames after
+    // a stall
+    record->next_frame_time_ns
+      = MAX(record->next_frame_time_ns, now_ns)
+        + (uint64_t)((double)frame_pacing->target_frame_time * 1e9);
+  }
+  // The frame's input is then always shown by the next presented image
+  if (frame_pacing->low_latency && context->frame.index > 0) {
+    wgpu_wait_for_submitted_work(context->wgpu_context);
+  }
+}
+
+// Waits while the window is minimized, as the hidden window policy asks.
+// Returns true when the frame is skipped.
+static bool skip_hidden_frame(wgpu_example_context_t* context, record_t* record)
+{
+  context->window_focused = record->focused;
+  context->window_hidden
+    = context->window != NULL
+      && (record->iconified || record->window_width == 0
+          || record->window_height == 0);
+
+  const hidden_window_policy_enum policy = context->frame_pacing.hidden_policy;
+  if (!context->window_hidden || policy == HiddenWindowPolicy_Continue
+      || context->benchmark.instance != NULL) {
+    record->next_hidden_frame_time_ns = 0;
+    return false;
+  }
+
+  const uint64_t start_ns = platform_get_time_ns();
+  if (policy == HiddenWindowPolicy_Throttle) {
+    if (record->next_hidden_frame_time_ns > start_ns) {
+      platform_sleep((float)(record->next_hidden_frame_time_ns - start_ns)
+                     * 1e-9f);
+    }
+    record->next_hidden_frame_time_ns
+      = MAX(record->next_hidden_frame_time_ns, start_ns)
+        + (uint64_t)((double)HIDDEN_WINDOW_FRAME_TIME * 1e9);
+    return false;
+  }
+
+  platform_sleep(HIDDEN_WINDOW_POLL_INTERVAL);
+  if (policy == HiddenWindowPolicy_SimulationOnly) {
+    const float elapsed
+      = (float)((double)(platform_get_time_ns() - start_ns) * 1e-9);
+    context->run_time += elapsed;
+    if (!context->paused) {
+      context->timer += context->timer_speed * elapsed;
+      context->timer -= floorf(context->timer);
+    }
+  }
+  return true;
+}
+
+// Swaps the double-buffered simulation states once steps wrote the state the
+// render did not read
+static void swap_simulation_states(wgpu_example_context_t* context)
+{
+  uint64_t* fence_values = context->simulation.state_fence_values;
+  const uint32_t write   = context->simulation.write_index;
+  const uint32_t read    = context->simulation.read_index;
+  if (context->simulation.settings.async_compute
+      && fence_values[write] > fence_values[read]) {
+    context->simulation.read_index  = write;
+    context->simulation.write_index = read;
+  }
+}
+
+// Schedules the simulation steps of the next frame from the last frame time,
+// so that the simulation advances at its step rate whatever the frame rate
+static void update_simulation(wgpu_example_context_t* context)
+{
+  const simulation_settings_t* settings = &context->simulation.settings;
+  if (settings->step_rate <= 0.0f) {
+    context->simulation.step_count = 1;
+    context->simulation.step_time  = context->frame_timer;
+    context->simulation.alpha      = 1.0f;
+    return;
+  }
+
+  const double step_time = 1.0 / (double)settings->step_rate;
+  // The time beyond the most steps of a frame is dropped, the simulation then
+  // runs slower than real time
+  const double max_time = step_time * (double)settings->max_step_count;
+  const double accumulator
+    = MIN(context->simulation.accumulator + context->frame_timer, max_time);
+  const uint32_t step_count = (uint32_t)(accumulator / step_time);
+  const double remainder    = accumulator - (double)step_count * step_time;
+
+  context->simulation.step_count  = step_count;
+  context->simulation.step_time   = (float)step_time;
+  context->simulation.alpha       = (float)(remainder / step_time);
+  context->simulation.accumulator = remainder;
+}
+
+// Runs the frames of the example until it exits, on the render thread when
+// there is one
+static void record_frame_time(wgpu_example_context_t* context, float cpu_ms,
+                              float gpu_ms)
+{
+  context->frame_history.cpu_ms[context->frame_history.index] = cpu_ms;
+  context->frame_history.gpu_ms[context->frame_history.index] = gpu_ms;
+  context->frame_history.index
+    = (context->frame_history.index + 1) % FRAME_TIME_HISTORY_SIZE;
+  context->frame_history.count
+    = MIN(context->frame_history.count + 1, FRAME_TIME_HISTORY_SIZE);
+  if (context->frame_history.median_ms > 0.0f
+      && cpu_ms > HITCH_FRAME_TIME_FACTOR * context->frame_history.median_ms) {
+    ++context->frame_history.hitch_count;
+  }
+}
+
+static int compare_frame_time(const void* a, const void* b)
+{
+  const float fa = *(const float*)a, fb = *(const float*)b;
+  return (fa > fb) - (fa < fb);
+}
+
+// Nearest-rank percentiles of the frame time history, as in the benchmark
+// results
+static void update_frame_time_statistics(wgpu_example_context_t* context)
+{
+  const uint32_t count = context->frame_history.count;
+  if (count == 0) {
+    return;
+  }
+
+  // Kept off the stack, the statistics are only updated by the frame loop
+  static float sorted[FRAME_TIME_HISTORY_SIZE];
+  memcpy(sorted, context->frame_history.cpu_ms, count * sizeof(float));
+  qsort(sorted, count, sizeof(float), compare_frame_time);
+#define PERCENTILE(p) sorted[MIN(count - 1, (count * p) / 1000)]
+  context->frame_history.median_ms  = PERCENTILE(500);
+  context->frame_history.low_1_ms   = PERCENTILE(990);
+  context->frame_history.low_0_1_ms = PERCENTILE(999);
+#undef PERCENTILE
+}
+
+static void run_frames(render_loop_t* loop)
+{
+  wgpu_example_context_t* context                 = loop->context;
+  record_t* record                                = loop->record;
+  renderfunc_t* render_func                       = loop->render_func;
+  onviewchangedfunc_t* view_changed_func          = loop->view_changed_func;
+  onkeypressedfunc_t* example_on_key_pressed_func = loop->key_pressed_func;
+  window_t* window                                = context->window;
+
+  // Frame times are differences of the nanosecond clock, so that they stay
+  // accurate however long the example runs
+  uint64_t time_start_ns, time_end_ns;
+  float time_diff, fps_timer;
+  const uint64_t loop_start_ns = platform_get_time_ns();
+  record->last_timestamp_ns     = loop_start_ns;
+  while (window != NULL ?
+           !window_should_close(window) :
+           (context->benchmark.instance != NULL
+            || context->frame.index < context->headless.frame_count)) {
+    time_start_ns                   = platform_get_time_ns();
+    context->frame.timestamp_millis
+      = (double)(time_start_ns - loop_start_ns) / 1e6;
+    PROFILE_BEGIN("frame");
+    if (record->view_updated) {
+      record->mouse_scrolled = 0;
+      record->wheel_delta    = 0;
+      record->view_updated   = false;
+    }
+    PROFILE_BEGIN("pace_frame");
+    pace_frame(context, record);
+    PROFILE_END();
+    PROFILE_BEGIN("poll_events");
+    if (window != NULL) {
+      poll_input_events(record);
+    }
+    job_system_process_completions(job_system_get_shared());
+    PROFILE_END();
+    if (skip_hidden_frame(context, record)) {
+      PROFILE_END();
+      if (context->run_time_limit > 0.0f
+          && context->run_time >= context->run_time_limit) {
+        break;
+      }
+      continue;
+    }
+    // The input handled so far is consumed by this frame
+    context->input_latency.frame_input_time_ns = record->input_time_ns;
+    record->input_time_ns                      = 0;
+    // Let the example re-create the bind groups referencing the attachments
+    // before the first frame of the new size is rendered
+    if (update_window_size(context, record) && view_changed_func) {
+      context->window_resized = true;
+      view_changed_func(context);
+      context->window_resized = false;
+    }
+    update_simulation(context);
+    PROFILE_BEGIN("example_render");
     render_func(context);
-    ++record.frame_counter;
+    PROFILE_END();
+    PROFILE_END();
+    context->simulation.step_index += context->simulation.step_count;
+    swap_simulation_states(context);
+    ++record->frame_counter;
     ++context->frame.index;
-    time_end             = platform_get_time();
-    time_diff            = (time_end - time_start) * 1000.0f;
-    record.frame_timer   = time_diff / 1000.0f;
-    context->frame_timer = record.frame_timer;
+    time_end_ns = platform_get_time_ns();
+    time_diff   = (float)((double)(time_end_ns - time_start_ns) / 1e6);
+    record_frame_time(context, time_diff,
+                      wgpu_gpu_profiler_get_frame_time_ms(
+                        context->wgpu_context->gpu_profiler));
+    if (context->benchmark.instance != NULL) {
+      benchmark_t* benchmark = context->benchmark.instance;
+      benchmark_record_frame(
+        benchmark, time_diff - context->benchmark.present_time_ms,
+        wgpu_gpu_profiler_get_frame_time_ms(
+          context->wgpu_context->gpu_profiler),
+        context->benchmark.present_time_ms);
+      record_pipeline_statistics(context);
+      record_memory_statistics(benchmark);
+      if (benchmark_is_done(benchmark)) {
+        break;
+      }
+    }
+    record->frame_timer   = time_diff / 1000.0f;
+    context->frame_timer = record->frame_timer;
     context->run_time += context->frame_timer;
-    update_camera(context, &record);
-    update_input_state(context, &record);
+    if (context->run_time_limit > 0.0f
+        && context->run_time >= context->run_time_limit) {
+      break;
+    }
+    PROFILE_BEGIN("update");
+    update_camera(context, record);
+    update_input_state(context, record);
+    update_overlay_input_time(context, record);
     if (example_on_key_pressed_func) {
-      notify_key_input_state(&record, example_on_key_pressed_func);
+      notify_key_input_state(record, example_on_key_pressed_func);
     }
     // Convert to clamped timer value
     if (!context->paused) {
-      context->timer += context->timer_speed * record.frame_timer;
+      context->timer += context->timer_speed * record->frame_timer;
       if (context->timer >= 1.0) {
         context->timer -= 1.0f;
       }
     }
-    if (record.view_updated && view_changed_func) {
+    if (record->view_updated && view_changed_func) {
       view_changed_func(context);
     }
-    fps_timer = (time_end - record.last_timestamp) * 1000.0f;
+    PROFILE_END();
+    fps_timer
+      = (float)((double)(time_end_ns - record->last_timestamp_ns) / 1e6);
     if (fps_timer > 1000.0f) {
-      record.last_fps   = (float)record.frame_counter * (1000.0f / fps_timer);
-      context->last_fps = (int)(record.last_fps + 0.5f);
-      record.frame_counter  = 0;
-      record.last_timestamp = time_end;
+      record->last_fps   = (float)record->frame_counter * (1000.0f / fps_timer);
+      context->last_fps = (int)(record->last_fps + 0.5f);
+      record->frame_counter     = 0;
+      record->last_timestamp_ns = time_end_ns;
+      update_frame_time_statistics(context);
+      // The statistics shown by the overlay changed
+      context->overlay.invalidated = true;
     }
-    context->frame_counter = record.frame_counter;
+    context->frame_counter = record->frame_counter;
+  }
+}
+
+static void* render_thread_main(void* arg)
+{
+  render_loop_t* loop = (render_loop_t*)arg;
+  PROFILE_THREAD_NAME("Render");
+  run_frames(loop);
+  __atomic_store_n(&loop->done, true, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void render_loop(wgpu_example_context_t* context,
+                        renderfunc_t* render_func,
+                        onviewchangedfunc_t* view_changed_func,
+                        onkeypressedfunc_t* example_on_key_pressed_func)
+{
+  record_t record;
+  memset(&record, 0, sizeof(record_t));
+  record.focused   = true;
+  window_t* window = context->window;
+  if (window != NULL) {
+    // Later sizes arrive with the resize events
+    window_get_size(window, &record.window_width, &record.window_height);
+    window_set_userdata(window, &record);
+  }
+
+  render_loop_t loop = {
+    .context           = context,
+    .record            = &record,
+    .render_func       = render_func,
+    .view_changed_func = view_changed_func,
+    .key_pressed_func  = example_on_key_pressed_func,
+  };
+  if (window == NULL || !context->frame_pacing.render_thread) {
+    run_frames(&loop);
+    return;
+  }
+
+  // The events are handled on this thread, which GLFW requires, and passed to
+  // the render thread through the event queue of the record
+  record.event_queue.enabled = true;
+  pthread_t render_thread;
+  if (pthread_create(&render_thread, NULL, render_thread_main, &loop) != 0) {
+    log_warn("Failed to create the render thread, rendering on the main "
+             "thread");
+    record.event_queue.enabled = false;
+    run_frames(&loop);
+    return;
   }
+  while (!__atomic_load_n(&loop.done, __ATOMIC_ACQUIRE)) {
+    input_wait_events(RENDER_THREAD_EVENT_TIMEOUT);
+  }
+  pthread_join(render_thread, NULL);
+  record.event_queue.enabled = false;
 }
 
 void draw_ui(wgpu_example_context_t* context,
              onupdateuioverlayfunc_t* example_on_update_ui_overlay_func)
 {
   if (context->show_imgui_overlay) {
+    PROFILE_BEGIN("update_overlay");
     update_overlay(context, example_on_update_ui_overlay_func);
+    PROFILE_END();
+    wgpu_context_t* wgpu_context = context->wgpu_context;
+    const uint32_t scope         = wgpu_gpu_profiler_begin_scope(
+      wgpu_context->gpu_profiler, wgpu_context->cmd_enc, "UI overlay");
     imgui_overlay_draw_frame(context->imgui_overlay,
-                             context->wgpu_context->swap_chain.frame_buffer);
+                             wgpu_context->swap_chain.frame_buffer);
+    wgpu_gpu_profiler_end_scope(wgpu_context->gpu_profiler,
+                                wgpu_context->cmd_enc, scope);
+  }
+}
+
+void invalidate_overlay(wgpu_example_context_t* context)
+{
+  context->overlay.invalidated = true;
+}
+
+// Checks that the last frame did not allocate, once the warm-up frames are
+// done. The heap allocations of the helpers go through the frame arena, the
+// GPU resources through the memory tracker.
+static void check_steady_state(wgpu_example_context_t* context)
+{
+  if (!context->memory.assert_steady_state) {
+    return;
   }
+
+  const uint64_t heap_allocation_count
+    = context->wgpu_context->frame_arena.heap_allocation_count;
+  const uint64_t creation_count = wgpu_memory_tracker_get_creation_count();
+  if (context->frame.index > context->memory.warmup_frame_count) {
+    const uint64_t heap_allocations
+      = heap_allocation_count - context->steady_state.heap_allocation_count;
+    const uint64_t creations
+      = creation_count - context->steady_state.creation_count;
+    if (heap_allocations > 0 || creations > 0) {
+      log_error("Frame %zu: %llu frame arena heap allocation(s), %llu GPU "
+                "resource creation(s) in steady state",
+                context->frame.index, (unsigned long long)heap_allocations,
+                (unsigned long long)creations);
+    }
+    ASSERT(heap_allocations == 0 && creations == 0);
+  }
+  context->steady_state.heap_allocation_count = heap_allocation_count;
+  context->steady_state.creation_count        = creation_count;
+}
+
+// Writes the camera, time and resolution of the frame into the frame uniforms
+static void update_frame_uniforms(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context    = context->wgpu_context;
+  wgpu_frame_uniforms_data_t data = *wgpu_frame_uniforms_get_data(wgpu_context);
+
+  camera_t* camera = context->camera;
+  if (camera != NULL) {
+    glm_mat4_copy(camera->matrices.view, data.view);
+    glm_mat4_copy(camera->matrices.perspective, data.projection);
+    glm_mat4_copy(camera->matrices.view_projection, data.view_projection);
+    glm_mat4_copy(camera->matrices.jittered_view_projection,
+                  data.jittered_view_projection);
+    glm_mat4_copy(camera->matrices.inverse_view, data.inverse_view);
+    glm_mat4_copy(camera->matrices.inverse_perspective,
+                  data.inverse_projection);
+    glm_mat4_copy(camera->matrices.inverse_view_projection,
+                  data.inverse_view_projection);
+    glm_vec4_copy(camera->matrices.inverse_view[3], data.camera_position);
+    glm_vec2_copy(camera->jitter, data.jitter);
+    data.znear = camera->znear;
+    data.zfar  = camera->zfar;
+  }
+
+  const float width  = (float)MAX(wgpu_context->surface.width, 1u);
+  const float height = (float)MAX(wgpu_context->surface.height, 1u);
+  glm_vec4_copy((vec4){width, height, 1.0f / width, 1.0f / height},
+                data.resolution);
+  data.time        = context->run_time;
+  data.delta_time  = context->frame_timer;
+  data.timer       = context->timer;
+  data.frame_index = (uint32_t)context->frame.index;
+
+  wgpu_frame_uniforms_update(wgpu_context, &data);
 }
 
 void prepare_frame(wgpu_example_context_t* context)
 {
+  // Wait for the frame slot to be released by the GPU
+  wgpu_begin_frame(context->wgpu_context);
+
+  check_steady_state(context);
+
+  // Once per frame, before the passes using them are recorded
+  update_frame_uniforms(context);
+
   // Acquire the current image from the swap chain
   wgpu_swap_chain_get_current_image(context->wgpu_context);
 
@@ -479,34 +1527,532 @@ void submit_command_buffers(wgpu_example_context_t* context)
                              wgpu_context->submit_info.command_buffer_count);
 }
 
+void submit_simulation_command_buffer(wgpu_example_context_t* context,
+                                      WGPUCommandBuffer command_buffer)
+{
+  ASSERT(context->simulation.settings.async_compute)
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+
+  // Submitted on its own, so that the GPU can run the steps while the render
+  // of the other state is still recorded and submitted
+  wgpu_flush_command_buffers(wgpu_context, &command_buffer, 1);
+  context->simulation.state_fence_values[context->simulation.write_index]
+    = wgpu_queue_fence_signal(wgpu_context, &context->simulation.fence);
+}
+
+static int compare_latency(const void* a, const void* b)
+{
+  const float fa = *(const float*)a, fb = *(const float*)b;
+  return (fa > fb) - (fa < fb);
+}
+
+static void input_latency_work_done_cb(WGPUQueueWorkDoneStatus status,
+                                       void* userdata)
+{
+  input_latency_slot_t* slot      = (input_latency_slot_t*)userdata;
+  wgpu_example_context_t* context = (wgpu_example_context_t*)slot->context;
+  const float completion_ms
+    = (float)((double)(platform_get_time_ns() - slot->input_time_ns) / 1e6);
+  slot->input_time_ns = 0;
+  if (status != WGPUQueueWorkDoneStatus_Success) {
+    return;
+  }
+
+  // The displayed frame is no earlier than both its present and its work
+  const float latency_ms = MAX(completion_ms, slot->present_latency_ms);
+  context->input_latency.present_ms    = slot->present_latency_ms;
+  context->input_latency.completion_ms = latency_ms;
+  context->input_latency.history[context->input_latency.history_index]
+    = latency_ms;
+  context->input_latency.history_index
+    = (context->input_latency.history_index + 1) % INPUT_LATENCY_HISTORY_SIZE;
+  context->input_latency.history_count
+    = MIN(context->input_latency.history_count + 1, INPUT_LATENCY_HISTORY_SIZE);
+
+  // Nearest-rank percentiles of the history, as in the benchmark results
+  float sorted[INPUT_LATENCY_HISTORY_SIZE];
+  const uint32_t count = context->input_latency.history_count;
+  memcpy(sorted, context->input_latency.history, count * sizeof(float));
+  qsort(sorted, count, sizeof(float), compare_latency);
+  context->input_latency.p50_ms = sorted[MIN(count - 1, count * 50 / 100)];
+  context->input_latency.p95_ms = sorted[MIN(count - 1, count * 95 / 100)];
+  context->overlay.invalidated  = true;
+
+  if (context->benchmark.instance != NULL) {
+    benchmark_record_latency(context->benchmark.instance, latency_ms);
+  }
+}
+
+// Tracks the frame consuming an input event until its submitted work, which
+// includes all the work submitted before, has completed
+static void track_input_latency(wgpu_example_context_t* context,
+                                uint64_t present_end_ns)
+{
+  const uint64_t input_time_ns = context->input_latency.frame_input_time_ns;
+  if (input_time_ns == 0) {
+    return;
+  }
+  context->input_latency.frame_input_time_ns = 0;
+
+  input_latency_slot_t* slot
+    = &context->input_latency.slots[context->input_latency.slot_index];
+  // Skipped while all slots are in flight
+  if (slot->input_time_ns != 0) {
+    return;
+  }
+  context->input_latency.slot_index
+    = (context->input_latency.slot_index + 1) % INPUT_LATENCY_SLOT_COUNT;
+  slot->context       = context;
+  slot->input_time_ns = input_time_ns;
+  slot->present_latency_ms
+    = (float)((double)(present_end_ns - input_time_ns) / 1e6);
+  wgpuQueueOnSubmittedWorkDone(context->wgpu_context->queue, 0,
+                               input_latency_work_done_cb, slot);
+}
+
 void submit_frame(wgpu_example_context_t* context)
 {
   // Present the current buffer to the swap chain
+  PROFILE_BEGIN("present");
+  const uint64_t present_start_ns = platform_get_time_ns();
   wgpu_swap_chain_present(context->wgpu_context);
+  const uint64_t present_end_ns = platform_get_time_ns();
+  context->benchmark.present_time_ms
+    = (float)((double)(present_end_ns - present_start_ns) / 1e6);
+  PROFILE_END();
+
+  // Latency of the input consumed by this frame
+  track_input_latency(context, present_end_ns);
+
+  // Advance to the next frame slot
+  wgpu_end_frame(context->wgpu_context);
+}
+
+/* -------------------------------------------------------------------------- *
+ * Example host
+ * -------------------------------------------------------------------------- */
+
+struct example_host_t {
+  // Window, WebGPU context and overlay shared by the examples, the other
+  // fields are reset for each of them
+  wgpu_example_context_t context;
+  const char* trace_output;
+};
+
+// Host the examples run on instead of their own window and device
+static example_host_t* active_example_host = NULL;
+
+example_host_t* example_host_create(int argc, char* argv[])
+{
+  log_set_async(true);
+  PROFILE_THREAD_NAME("Main");
+  example_host_t* host = (example_host_t*)calloc(1, sizeof(example_host_t));
+  ASSERT(host != NULL);
+
+  // The example arguments apply to all hosted examples, the benchmark mode
+  // does not
+  refexport_t window_ref_export              = {0};
+  benchmark_settings_t benchmark_settings    = {0};
+  frame_pacing_settings_t frame_pacing       = {0};
+  headless_settings_t headless               = {0};
+  simulation_settings_t simulation           = {0};
+  wgpu_adapter_selection_t adapter_selection = {0};
+  memory_settings_t memory                   = {0};
+  float run_time_limit                       = 0.0f;
+  const char* api_trace_output               = NULL;
+  parse_example_arguments(argc, argv, &window_ref_export, &benchmark_settings,
+                          &frame_pacing, &headless, &simulation,
+                          &adapter_selection, &memory, &run_time_limit,
+                          &host->trace_output, &api_trace_output);
+  wgpu_example_context_t* context = &host->context;
+  intialize_wgpu_example_context(context, &(wgpu_example_settings_t){
+                                            .title = "Examples",
+                                          });
+  context->frame_pacing        = frame_pacing;
+  context->headless            = headless;
+  context->simulation.settings = simulation;
+  context->adapter_selection   = adapter_selection;
+  context->memory              = memory;
+  context->run_time_limit      = run_time_limit;
+
+  // The device has all features the examples may request and the highest
+  // limits of the adapter, the features it lacks are skipped
+  static const WGPUFeatureName optional_features[]
+    = {WGPUFeatureName_Depth32FloatStencil8,
+       WGPUFeatureName_TextureCompressionETC2,
+       WGPUFeatureName_TextureCompressionASTC,
+       WGPUFeatureName_IndirectFirstInstance,
+       WGPUFeatureName_DepthClamping,
+       WGPUFeatureName_DawnMultiPlanarFormats};
+  wgpu_example_settings_t host_settings = {
+    .required_feature_count = (uint32_t)ARRAY_SIZE(optional_features),
+    .required_features      = optional_features,
+    .required_limits        = {
+      .max_storage_buffer_binding_size       = UINT64_MAX,
+      .max_compute_workgroup_storage_size    = UINT32_MAX,
+      .max_compute_invocations_per_workgroup = UINT32_MAX,
+      .max_compute_workgroup_size_x          = UINT32_MAX,
+    },
+  };
+  window_ref_export.example_window_config.resizable = true;
+  setup_window(context, &window_ref_export.example_window_config);
+  // Captured from the creation of the device on
+  if (api_trace_output != NULL) {
+    wgpu_api_trace_begin_capture(api_trace_output);
+  }
+  intialize_webgpu(context, &host_settings);
+  context->imgui_overlay = imgui_overlay_create(context->wgpu_context);
+  return host;
+}
+
+void example_host_release(example_host_t* host)
+{
+  if (active_example_host == host) {
+    active_example_host = NULL;
+  }
+  job_system_release_shared();
+  if (host->trace_output != NULL) {
+    profiler_write_chrome_trace(host->trace_output);
+  }
+  release_imgui(&host->context);
+  release_webgpu(&host->context);
+  wgpu_api_trace_end_capture();
+  if (host->context.window != NULL) {
+    window_destroy(host->context.window);
+  }
+  free(host);
+}
+
+void example_host_set_active(example_host_t* host)
+{
+  active_example_host = host;
+}
+
+bool example_host_is_closed(example_host_t* host)
+{
+  return host->context.window != NULL
+         && window_should_close(host->context.window);
+}
+
+// Returns false when the device of the host lacks a feature of the example
+static bool example_host_has_features(example_host_t* host, const char* title,
+                                      uint32_t feature_count,
+                                      WGPUFeatureName const* features)
+{
+  for (uint32_t i = 0; i < feature_count; ++i) {
+    if (!wgpu_has_feature(host->context.wgpu_context, features[i])) {
+      log_warn("Skipping %s, feature %d is not supported", title,
+               features[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Starts the example on the context of the host, runs it and stops it again
+static void example_host_run(example_host_t* host, refexport_t* ref_export)
+{
+  wgpu_example_settings_t* example_settings = &ref_export->example_settings;
+  if (example_host_is_closed(host)
+      || !example_host_has_features(host, example_settings->title,
+                                    example_settings->required_feature_count,
+                                    example_settings->required_features)) {
+    return;
+  }
+  // The pipelines of the overlay are created for the depth convention of the
+  // context
+  if (example_settings->reversed_z
+      != host->context.wgpu_context->depth_stencil.reversed_z) {
+    log_warn("Skipping %s, the host does not use its depth convention",
+             example_settings->title);
+    return;
+  }
+
+  // Reset the example state, the shared objects and settings are kept
+  wgpu_example_context_t* context = &host->context;
+  const wgpu_example_context_t shared = *context;
+  intialize_wgpu_example_context(context, example_settings);
+  context->window              = shared.window;
+  context->window_size         = shared.window_size;
+  context->wgpu_context        = shared.wgpu_context;
+  context->frame_pacing        = shared.frame_pacing;
+  context->headless            = shared.headless;
+  context->adapter_selection   = shared.adapter_selection;
+  context->memory              = shared.memory;
+  context->run_time_limit      = shared.run_time_limit;
+  context->simulation.settings = shared.simulation.settings;
+  context->imgui_overlay       = shared.imgui_overlay;
+  context->show_imgui_overlay  = example_settings->overlay;
+  memcpy(context->adapter_info, shared.adapter_info,
+         sizeof(context->adapter_info));
+  context->simulation.write_index
+    = context->simulation.settings.async_compute ? 1 : 0;
+  if (context->window != NULL) {
+    char window_title[STRMAX];
+    snprintf(window_title, sizeof(window_title), "WebGPU Example - %s",
+             context->example_title);
+    window_set_title(context->window, window_title);
+  }
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  wgpu_context->frames.count   = MIN(example_settings->frames_in_flight > 0 ?
+                                       example_settings->frames_in_flight :
+                                       WGPU_DEFAULT_FRAMES_IN_FLIGHT,
+                                     WGPU_MAX_FRAMES_IN_FLIGHT);
+
+  PROFILE_BEGIN("example_initialize");
+  ref_export->example_initialize_func(context);
+  PROFILE_END();
+  render_loop(context, ref_export->example_render_func,
+              ref_export->example_on_view_changed_func,
+              ref_export->example_on_key_pressed_func);
+  if (wgpu_context->offscreen_swap_chain != NULL) {
+    wgpu_offscreen_swap_chain_flush(wgpu_context->offscreen_swap_chain);
+  }
+  ref_export->example_destroy_func(context);
+  wgpu_context_reset(wgpu_context);
 }
 
 void example_run(int argc, char* argv[], refexport_t* ref_export)
 {
+  if (active_example_host != NULL) {
+    example_host_run(active_example_host, ref_export);
+    return;
+  }
+
+  // Log messages are written by a background thread, so that logging never
+  // stalls a frame on terminal output. Errors are written synchronously.
+  log_set_async(true);
+  PROFILE_THREAD_NAME("Main");
   // Parse the example arguments
-  parse_example_arguments(argc, argv, ref_export);
+  benchmark_settings_t benchmark_settings    = {0};
+  frame_pacing_settings_t frame_pacing       = {0};
+  headless_settings_t headless               = {0};
+  simulation_settings_t simulation           = {0};
+  wgpu_adapter_selection_t adapter_selection = {0};
+  memory_settings_t memory                   = {0};
+  float run_time_limit                       = 0.0f;
+  const char* trace_output                   = NULL;
+  const char* api_trace_output               = NULL;
+  parse_example_arguments(argc, argv, ref_export, &benchmark_settings,
+                          &frame_pacing, &headless, &simulation,
+                          &adapter_selection, &memory, &run_time_limit,
+                          &trace_output, &api_trace_output);
   // Initialize WebGPU example context
   wgpu_example_context_t context;
   intialize_wgpu_example_context(&context, &ref_export->example_settings);
+  context.frame_pacing        = frame_pacing;
+  context.headless            = headless;
+  context.simulation.settings = simulation;
+  context.adapter_selection   = adapter_selection;
+  context.memory              = memory;
+  context.run_time_limit      = run_time_limit;
+  // The render reads the initial state 0 while the first steps write state 1
+  context.simulation.write_index = simulation.async_compute ? 1 : 0;
+  // Benchmark mode, measured with v-sync forced off and unpaced frames
+  if (benchmark_settings.enabled) {
+    context.benchmark.settings = benchmark_settings;
+    context.benchmark.instance
+      = benchmark_create(&benchmark_settings, context.example_title);
+    context.vsync                          = false;
+    context.frame_pacing.target_frame_time  = 0.0f;
+    context.frame_pacing.low_latency        = false;
+    context.frame_pacing.dynamic_resolution = false;
+  }
   // Setup Window
+  PROFILE_BEGIN("setup_window");
   setup_window(&context, &ref_export->example_window_config);
-  // Intialize WebGPU
-  intialize_webgpu(&context);
+  PROFILE_END();
+  // Intialize WebGPU, captured from the creation of the device on
+  if (api_trace_output != NULL) {
+    wgpu_api_trace_begin_capture(api_trace_output);
+  }
+  PROFILE_BEGIN("intialize_webgpu");
+  intialize_webgpu(&context, &ref_export->example_settings);
+  PROFILE_END();
   // Intialize ImGui
+  PROFILE_BEGIN("intialize_imgui");
   intialize_imgui(&context, &ref_export->example_settings);
+  PROFILE_END();
   // Intialize example
+  PROFILE_BEGIN("example_initialize");
   ref_export->example_initialize_func(&context);
+  PROFILE_END();
   // Render loop
   render_loop(&context, ref_export->example_render_func,
               ref_export->example_on_view_changed_func,
               ref_export->example_on_key_pressed_func);
+  // Benchmark results
+  if (context.benchmark.instance != NULL) {
+    benchmark_write_results(context.benchmark.instance);
+    benchmark_release(context.benchmark.instance);
+    // Latencies of the frames still in flight are not recorded anymore
+    context.benchmark.instance = NULL;
+  }
+  // Write the pending headless frames and finish pending background loads
+  // while the device is still alive
+  if (context.wgpu_context->offscreen_swap_chain != NULL) {
+    wgpu_offscreen_swap_chain_flush(context.wgpu_context->offscreen_swap_chain);
+  }
+  job_system_release_shared();
+  // Profiler trace, written once the job workers have exited
+  if (trace_output != NULL) {
+    profiler_write_chrome_trace(trace_output);
+  }
   // Cleanup
   ref_export->example_destroy_func(&context);
   release_imgui(&context);
   release_webgpu(&context);
-  window_destroy(context.window);
+  wgpu_api_trace_end_capture();
+  if (context.window != NULL) {
+    window_destroy(context.window);
+  }
+}
+
+/* -------------------------------------------------------------------------- *
+ * Compute-only examples
+ * -------------------------------------------------------------------------- */
+
+// Records, submits and waits for one iteration, returns its duration in ms
+static float run_compute_iteration(compute_example_context_t* context,
+                                   compute_refexport_t* ref_export)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  const uint64_t start_ns      = platform_get_time_ns();
+
+  wgpu_begin_frame(wgpu_context);
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  ref_export->record_func(context, cmd_enc);
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  ASSERT(command_buffer != NULL)
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpu_flush_command_buffers(wgpu_context, &command_buffer, 1);
+  wgpu_end_frame(wgpu_context);
+
+  // Every iteration is timed up to the completion of its GPU work
+  wgpu_wait_for_submitted_work(wgpu_context);
+  return (float)((double)(platform_get_time_ns() - start_ns) / 1e6);
+}
+
+int compute_example_run(int argc, char* argv[],
+                        compute_refexport_t* ref_export)
+{
+  log_set_async(true);
+  PROFILE_THREAD_NAME("Main");
+  // Parse the example arguments, the window, frame pacing and headless
+  // settings do not apply without a swap chain
+  refexport_t window_ref_export              = {0};
+  benchmark_settings_t benchmark_settings    = {0};
+  frame_pacing_settings_t frame_pacing       = {0};
+  headless_settings_t headless               = {0};
+  simulation_settings_t simulation           = {0};
+  wgpu_adapter_selection_t adapter_selection = {0};
+  memory_settings_t memory                   = {0};
+  float run_time_limit                       = 0.0f;
+  const char* trace_output                   = NULL;
+  const char* api_trace_output               = NULL;
+  parse_example_arguments(argc, argv, &window_ref_export, &benchmark_settings,
+                          &frame_pacing, &headless, &simulation,
+                          &adapter_selection, &memory, &run_time_limit,
+                          &trace_output, &api_trace_output);
+  // Intialize WebGPU, without surface and swap chain, or run on the device of
+  // the example host
+  example_host_t* host = active_example_host;
+  if (host != NULL
+      && !example_host_has_features(host, ref_export->title,
+                                    ref_export->required_feature_count,
+                                    ref_export->required_features)) {
+    return 0;
+  }
+  PROFILE_BEGIN("intialize_webgpu");
+  wgpu_context_t* wgpu_context = NULL;
+  if (host != NULL) {
+    wgpu_context = host->context.wgpu_context;
+  }
+  else {
+    if (api_trace_output != NULL) {
+      wgpu_api_trace_begin_capture(api_trace_output);
+    }
+    wgpu_context = wgpu_context_create(&(wgpu_context_create_options_t){
+      .frames_in_flight       = 1,
+      .adapter_selection      = &adapter_selection,
+      .required_feature_count = ref_export->required_feature_count,
+      .required_features      = ref_export->required_features,
+      .required_limits        = ref_export->required_limits,
+      .memory_budget          = memory.budget,
+      .track_lifetimes        = memory.track_lifetimes,
+      .gpu_queries            = frame_pacing.gpu_queries,
+    });
+    wgpu_create_device_and_queue(wgpu_context);
+    // GPU timestamp profiler (NULL when timestamp queries are not supported)
+    wgpu_context->gpu_profiler = wgpu_gpu_profiler_create(wgpu_context);
+  }
+  compute_example_context_t context = {
+    .wgpu_context = wgpu_context,
+    .work_unit    = "items",
+  };
+  char adapter_info[3][256] = {0};
+  wgpu_get_context_info(adapter_info);
+  log_info("%s on %s (%s, %s)", ref_export->title, adapter_info[0],
+           adapter_info[1], adapter_info[2]);
+  PROFILE_END();
+  // Intialize example
+  PROFILE_BEGIN("example_initialize");
+  int status = ref_export->initialize_func(&context);
+  PROFILE_END();
+  if (status == 0) {
+    // Warm-up and measured iterations
+    benchmark_t* benchmark
+      = benchmark_create(&benchmark_settings, ref_export->title);
+    const uint32_t iteration_count
+      = benchmark_settings.warmup_frame_count + benchmark_settings.frame_count;
+    double measured_time_ms = 0.0;
+    for (context.iteration = 0; context.iteration < iteration_count;
+         ++context.iteration) {
+      const float time_ms = run_compute_iteration(&context, ref_export);
+      if (context.iteration >= benchmark_settings.warmup_frame_count) {
+        measured_time_ms += time_ms;
+      }
+      benchmark_record_frame(
+        benchmark, time_ms,
+        wgpu_gpu_profiler_get_frame_time_ms(wgpu_context->gpu_profiler), 0.0f);
+      record_memory_statistics(benchmark);
+      // Throughput of the iteration, e.g. "M keys/s"
+      if (context.work_per_iteration > 0.0 && time_ms > 0.0f) {
+        char counter_name[64];
+        snprintf(counter_name, sizeof(counter_name), "M %s/s",
+                 context.work_unit);
+        benchmark_record_counter(benchmark, counter_name,
+                                 context.work_per_iteration / (time_ms * 1e3));
+      }
+    }
+    benchmark_write_results(benchmark);
+    benchmark_release(benchmark);
+    if (context.work_per_iteration > 0.0 && measured_time_ms > 0.0) {
+      log_info("%s: %.2f M %s/s", ref_export->title,
+               context.work_per_iteration * benchmark_settings.frame_count
+                 / (measured_time_ms * 1e3),
+               context.work_unit);
+    }
+    // Verify the results
+    if (ref_export->verify_func != NULL && !ref_export->verify_func(&context)) {
+      log_error("%s: verification failed", ref_export->title);
+      status = 1;
+    }
+  }
+  // Cleanup, the host keeps its device and writes the trace when released
+  if (host != NULL) {
+    ref_export->destroy_func(&context);
+    wgpu_context_reset(wgpu_context);
+    return status;
+  }
+  job_system_release_shared();
+  // Profiler trace, written once the job workers have exited
+  if (trace_output != NULL) {
+    profiler_write_chrome_trace(trace_output);
+  }
+  ref_export->destroy_func(&context);
+  wgpu_context_release(wgpu_context);
+  wgpu_api_trace_end_capture();
+  return status;
 }
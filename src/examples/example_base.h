@@ -4,6 +4,94 @@
 #include "../core/api.h"
 #include "../webgpu/api.h"
 
+// Frames of a minimized window, set with --hidden-policy
+typedef enum hidden_window_policy_enum {
+  // Rendered at a low rate
+  HiddenWindowPolicy_Throttle = 0,
+  // Not rendered, the timers stop
+  HiddenWindowPolicy_Pause = 1,
+  // Not rendered, the timers keep running so that the animations resume where
+  // they would be
+  HiddenWindowPolicy_SimulationOnly = 2,
+  // Rendered as when the window is visible
+  HiddenWindowPolicy_Continue = 3,
+} hidden_window_policy_enum;
+
+typedef struct {
+  wgpu_present_mode_enum present_mode;
+  // Time between the starts of two frames in seconds, 0 leaves the frame rate
+  // to the present mode
+  float target_frame_time;
+  // Wait for the GPU to finish the previous frame before sampling the input
+  // of the next one, so that no frame is queued behind the input
+  bool low_latency;
+  // Rebuild the UI overlay only after input, once a second for the statistics
+  // and when the example invalidates it, and replay the last one otherwise
+  bool idle_overlay;
+  // Scale the render resolution of the examples supporting it to hold the
+  // target frame time (60 Hz when not paced) on the GPU, within
+  // min_resolution_scale and 1
+  bool dynamic_resolution;
+  float min_resolution_scale;
+  // Frames while the window is minimized, always rendered when benchmarking
+  hidden_window_policy_enum hidden_policy;
+  // Render and submit on a thread of its own, while the main thread handles
+  // the window events, so that neither stalls the other
+  bool render_thread;
+  // Measure the GPU times with timestamp and pipeline statistics queries,
+  // always done for the dynamic resolution and when benchmarking
+  bool gpu_queries;
+} frame_pacing_settings_t;
+
+typedef struct {
+  // Render into offscreen images instead of a window
+  bool enabled;
+  // Number of frames rendered before the example exits, unless benchmarking
+  uint32_t frame_count;
+  // Optional, directory the rendered frames are written to as PNG files
+  const char* output_directory;
+} headless_settings_t;
+
+typedef struct {
+  // Simulation steps per second, independent of the frame rate. 0 runs one
+  // step of the last frame time per rendered frame
+  float step_rate;
+  // Most steps run in one frame, the simulation slows down instead of
+  // spiralling when the steps take longer than their simulated time
+  uint32_t max_step_count;
+  // Submit the steps in their own command buffer ahead of the render, which
+  // then draws the double-buffered state of the previous steps
+  bool async_compute;
+} simulation_settings_t;
+
+typedef struct {
+  // GPU memory budget in bytes, 0 without budget
+  uint64_t budget;
+  // Record the creation stacks of the resources and report the ones still
+  // alive when the example exits
+  bool track_lifetimes;
+  // Assert that the frames after the warm-up frames neither allocate heap
+  // memory for the frame arena nor create GPU resources
+  bool assert_steady_state;
+  uint32_t warmup_frame_count;
+} memory_settings_t;
+
+// Frames shown by the frame time graph of the overlay
+#define FRAME_TIME_HISTORY_SIZE 4096u
+// Frames with input whose submitted work may be in flight at the same time
+#define INPUT_LATENCY_SLOT_COUNT 8u
+// Latencies the overlay percentiles are computed from
+#define INPUT_LATENCY_HISTORY_SIZE 128u
+
+// Frame consuming an input event, until its submitted work completed
+typedef struct {
+  void* context; /* wgpu_example_context_t */
+  // Time of the input event, 0 while the slot is free
+  uint64_t input_time_ns;
+  // Input to the return of the present call of the frame
+  float present_latency_ms;
+} input_latency_slot_t;
+
 typedef struct {
   window_t* window;
   struct {
@@ -11,12 +99,64 @@ typedef struct {
     uint32_t height;
     float aspect_ratio;
   } window_size;
+  // Set while example_on_view_changed is called for a resize of the window,
+  // the swap chain and the depth stencil texture have been recreated then
+  bool window_resized;
+  // Set while the window is minimized, and while it has the input focus
+  bool window_hidden;
+  bool window_focused;
   callbacks_t callbacks;
   wgpu_context_t* wgpu_context;
   bool vsync;
+  frame_pacing_settings_t frame_pacing;
+  // Headless mode, window is NULL then
+  headless_settings_t headless;
+  // Adapter selected with --adapter, --adapter-vendor and --adapter-backend
+  wgpu_adapter_selection_t adapter_selection;
+  // Set with --memory-budget, --track-lifetimes and --assert-steady-state
+  memory_settings_t memory;
+  // Allocation counts at the start of the last frame, see
+  // memory.assert_steady_state
+  struct {
+    uint64_t heap_allocation_count;
+    uint64_t creation_count;
+  } steady_state;
+  // Seconds the example runs for, set with --run-time. 0 runs until the
+  // window is closed
+  float run_time_limit;
+  // Fixed-timestep scheduling of the compute simulations, updated before the
+  // example renders a frame
+  struct {
+    simulation_settings_t settings;
+    // Steps to run in this frame, recorded into its command buffer. 0 in a
+    // render-only frame, several when the rendering falls behind
+    uint32_t step_count;
+    // Simulated time of a step in seconds
+    float step_time;
+    // Steps run before this frame, the state after step_index + step_count
+    // steps is rendered
+    uint64_t step_index;
+    // Time the rendered frame is past the last step, as a fraction of a step,
+    // for interpolating between the last two states. 1 without a step rate
+    float alpha;
+    // Time not simulated yet in seconds
+    double accumulator;
+    // Double-buffered state with async compute: the steps of the frame write
+    // state write_index while the render reads state read_index, the result
+    // of the steps of an earlier frame. The states swap after a frame that
+    // submitted steps, both are 0 without async compute
+    uint32_t write_index;
+    uint32_t read_index;
+    // Signaled by each submission of steps, with the fence value of the last
+    // submission that wrote each state
+    wgpu_queue_fence_t fence;
+    uint64_t state_fence_values[2];
+  } simulation;
   struct {
     size_t index;
-    float timestamp_millis;
+    /* Frame start since the first frame, in double precision to keep the
+     * sub-millisecond resolution in long runs */
+    double timestamp_millis;
   } frame;
   // Title of the example
   char example_title[STRMAX];
@@ -29,9 +169,30 @@ typedef struct {
   uint32_t frame_counter;
   // Used to display fps
   uint32_t last_fps;
+  // Ring of the last CPU and GPU frame times in ms, the GPU times are 0
+  // without GPU profiler
+  struct {
+    float cpu_ms[FRAME_TIME_HISTORY_SIZE];
+    float gpu_ms[FRAME_TIME_HISTORY_SIZE];
+    uint32_t count;
+    uint32_t index;
+    // Median and 99th/99.9th percentile (1% and 0.1% low) CPU frame times of
+    // the history, updated once a second
+    float median_ms;
+    float low_1_ms;
+    float low_0_1_ms;
+    // Frames taking more than twice the median since the start
+    uint32_t hitch_count;
+  } frame_history;
   // ImGui overlay
   bool show_imgui_overlay;
   void* imgui_overlay;
+  struct {
+    // Rebuild the overlay in the next frame, in idle mode
+    bool invalidated;
+    // Run time of the last input event
+    float input_time;
+  } overlay;
   // Time the example has been running (in seconds)
   float run_time;
   // Last frame time measured using a high performance timer (if available)
@@ -50,6 +211,31 @@ typedef struct {
     bool right;
     bool middle;
   } mouse_buttons, mouse_dragging;
+  // Latencies from the key and mouse button events to the present and to the
+  // completion of the submitted work of the frames consuming them
+  struct {
+    // Time of the earliest input event consumed by the current frame, 0 when
+    // the frame consumes none
+    uint64_t frame_input_time_ns;
+    input_latency_slot_t slots[INPUT_LATENCY_SLOT_COUNT];
+    uint32_t slot_index;
+    // Input to completion latencies of the last frames with input
+    float history[INPUT_LATENCY_HISTORY_SIZE];
+    uint32_t history_count;
+    uint32_t history_index;
+    // Last latencies, and the percentiles of the history
+    float present_ms;
+    float completion_ms;
+    float p50_ms;
+    float p95_ms;
+  } input_latency;
+  // Benchmark mode
+  struct {
+    benchmark_settings_t settings;
+    benchmark_t* instance;
+    // Time spent presenting the last frame
+    float present_time_ms;
+  } benchmark;
 } wgpu_example_context_t;
 
 typedef struct {
@@ -61,6 +247,17 @@ typedef struct {
   bool overlay;
   /** @brief Create texture client */
   bool create_texture_client;
+  /** @brief Number of frames the CPU may record ahead of the GPU (optional) */
+  uint32_t frames_in_flight;
+  /** @brief Device features requested in addition to the default ones
+   * (optional) */
+  uint32_t required_feature_count;
+  WGPUFeatureName const* required_features;
+  /** @brief Device limits requested above the defaults (optional) */
+  wgpu_required_limits_t required_limits;
+  /** @brief Reversed-Z depth convention of the context, see
+   * wgpu_get_depth_format (optional) */
+  bool reversed_z;
 } wgpu_example_settings_t;
 
 typedef void* surface_t;
@@ -94,8 +291,75 @@ void draw_ui(wgpu_example_context_t* context,
              onupdateuioverlayfunc_t* example_on_update_ui_overlay_func);
 void prepare_frame(wgpu_example_context_t* context);
 void submit_command_buffers(wgpu_example_context_t* context);
+/* Submits the steps of the frame ahead of the render command buffers, with
+ * async compute */
+void submit_simulation_command_buffer(wgpu_example_context_t* context,
+                                      WGPUCommandBuffer command_buffer);
 void submit_frame(wgpu_example_context_t* context);
+// Requests a rebuild of the idle overlay, e.g. when a value it shows changed
+void invalidate_overlay(wgpu_example_context_t* context);
 
 void example_run(int argc, char* argv[], refexport_t* ref_export);
 
+/*
+ * Example host: one window, device, swap chain, overlay and the shader and
+ * pipeline caches kept alive across examples. While a host is active,
+ * example_run and compute_example_run start the example on the pre-initialized
+ * context of the host and stop it again, instead of creating and tearing down
+ * their own. Examples needing a feature the device of the host lacks are
+ * skipped.
+ */
+typedef struct example_host_t example_host_t;
+example_host_t* example_host_create(int argc, char* argv[]);
+void example_host_release(example_host_t* host);
+/* NULL lets the examples run on their own again */
+void example_host_set_active(example_host_t* host);
+/* Whether the window of the host was closed, the hosted examples then exit */
+bool example_host_is_closed(example_host_t* host);
+
+/* -------------------------------------------------------------------------- *
+ * Compute-only examples
+ *
+ * Create the adapter and the device without a window, surface or swap chain,
+ * record a number of warm-up and measured iterations of compute passes and
+ * report their timings and throughput. The iteration counts are set with
+ * --warmup-frames and --frames, the results are written to the file of
+ * --benchmark-output (stdout otherwise) like those of the benchmark mode.
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+  wgpu_context_t* wgpu_context;
+  // Index of the iteration being recorded, warm-up iterations included
+  uint32_t iteration;
+  // Work of one iteration in the unit of the throughput, e.g. keys sorted,
+  // set by the example during its initialization
+  double work_per_iteration;
+  const char* work_unit;
+} compute_example_context_t;
+
+typedef int compute_initializefunc_t(compute_example_context_t* context);
+// Records the compute passes of one iteration into the command encoder
+typedef void compute_recordfunc_t(compute_example_context_t* context,
+                                  WGPUCommandEncoder cmd_enc);
+// Checks the results once the iterations have completed, e.g. read back with
+// wgpu_read_buffer, returns false when they are wrong
+typedef bool compute_verifyfunc_t(compute_example_context_t* context);
+typedef void compute_destroyfunc_t(compute_example_context_t* context);
+
+typedef struct {
+  const char* title;
+  /** @brief Device features and limits, as for the windowed examples */
+  uint32_t required_feature_count;
+  WGPUFeatureName const* required_features;
+  wgpu_required_limits_t required_limits;
+  compute_initializefunc_t* initialize_func;
+  compute_recordfunc_t* record_func;
+  compute_verifyfunc_t* verify_func; /* optional */
+  compute_destroyfunc_t* destroy_func;
+} compute_refexport_t;
+
+/* Returns the exit status, non-zero when the verification failed */
+int compute_example_run(int argc, char* argv[],
+                        compute_refexport_t* ref_export);
+
 #endif
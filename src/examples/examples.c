@@ -28,10 +28,12 @@ void example_cubemap(int argc, char* argv[]);
 void example_deferred_rendering(int argc, char* argv[]);
 void example_dynamic_uniform_buffer(int argc, char* argv[]);
 void example_equirectangular_image(int argc, char* argv[]);
+void example_frustum_culling_benchmark(int argc, char* argv[]);
 void example_gears(int argc, char* argv[]);
 void example_gerstner_waves(int argc, char* argv[]);
 void example_gltf_loading(int argc, char* argv[]);
 void example_gltf_scene_rendering(int argc, char* argv[]);
+void example_gpu_sort_benchmark(int argc, char* argv[]);
 void example_hdr(int argc, char* argv[]);
 void example_image_blur(int argc, char* argv[]);
 void example_imgui_overlay(int argc, char* argv[]);
@@ -40,6 +42,7 @@ void example_instanced_cube(int argc, char* argv[]);
 void example_minimal(int argc, char* argv[]);
 void example_msaa_line(int argc, char* argv[]);
 void example_multi_sampling(int argc, char* argv[]);
+void example_multi_window(int argc, char* argv[]);
 void example_n_body_simulation(int argc, char* argv[]);
 void example_occlusion_query(int argc, char* argv[]);
 void example_offscreen_rendering(int argc, char* argv[]);
@@ -91,10 +94,12 @@ static examplecase_t g_example_cases[] = {
   {"deferred_rendering", example_deferred_rendering},
   {"dynamic_uniform_buffer", example_dynamic_uniform_buffer},
   {"equirectangular_image", example_equirectangular_image},
+  {"frustum_culling_benchmark", example_frustum_culling_benchmark},
   {"gears", example_gears},
   {"gerstner_waves", example_gerstner_waves},
   {"gltf_loading", example_gltf_loading},
   {"gltf_scene_rendering", example_gltf_scene_rendering},
+  {"gpu_sort_benchmark", example_gpu_sort_benchmark},
   {"hdr", example_hdr},
   {"image_blur", example_image_blur},
   {"imgui_overlay", example_imgui_overlay},
@@ -103,6 +108,7 @@ static examplecase_t g_example_cases[] = {
   {"minimal", example_minimal},
   {"msaa_line", example_msaa_line},
   {"multi_sampling", example_multi_sampling},
+  {"multi_window", example_multi_window},
   {"n_body_simulation", example_n_body_simulation},
   {"occlusion_query", example_occlusion_query},
   {"offscreen_rendering", example_offscreen_rendering},
@@ -0,0 +1,393 @@
+#include "example_base.h"
+#include "examples.h"
+
+#include <string.h>
+
+#include "../webgpu/imgui_overlay.h"
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU Example - Frustum Culling Benchmark
+ *
+ * Measures the CPU batch frustum tests of frustum.h: random bounding spheres
+ * and axis aligned boxes, stored as structure of arrays, are culled every
+ * frame against the frustum of a camera circling the scene. The SIMD and the
+ * scalar versions of the tests are timed with the nanosecond clock and
+ * reported as time per object, and their visibility masks are compared, any
+ * mismatching object is counted.
+ *
+ * The object count is picked in the settings or with --objects=<n>.
+ * -------------------------------------------------------------------------- */
+
+#define DEFAULT_NUM_OBJECTS 65536u
+#define MAX_NUM_OBJECTS 4194304u
+
+// Objects are spread over the cube [-SCENE_EXTENT, SCENE_EXTENT]^3
+#define SCENE_EXTENT 50.0f
+
+// Benchmark resources are recreated when the object count is changed
+static struct {
+  uint32_t num_objects;
+  bool changed;
+} benchmark = {
+  .num_objects = DEFAULT_NUM_OBJECTS,
+  .changed     = false,
+};
+
+static const char* num_objects_names[5] = {
+  "1024", "16384", "65536", "262144", "1048576",
+};
+
+// Bounding volumes, the spheres and the boxes share their centers
+static struct {
+  float* center_x;
+  float* center_y;
+  float* center_z;
+  float* radius;
+  float* extent_x;
+  float* extent_y;
+  float* extent_z;
+} objects = {0};
+
+// Visibility of the tested version and of the scalar reference
+static struct {
+  uint32_t* mask;
+  uint32_t* reference_mask;
+  uint32_t* indices;
+} visibility = {0};
+
+// Smoothed timings in nanoseconds per object
+typedef enum culling_test_t {
+  CULLING_TEST_SPHERES_SIMD   = 0,
+  CULLING_TEST_SPHERES_SCALAR = 1,
+  CULLING_TEST_AABBS_SIMD     = 2,
+  CULLING_TEST_AABBS_SCALAR   = 3,
+  CULLING_TEST_COUNT          = 4,
+} culling_test_t;
+
+static const char* culling_test_names[CULLING_TEST_COUNT] = {
+  "Spheres", "Spheres (scalar)", "Boxes", "Boxes (scalar)"};
+
+static struct {
+  float ns_per_object[CULLING_TEST_COUNT];
+  uint32_t visible_count[2];
+  uint32_t mismatch_count[2];
+} stats = {0};
+
+static frustum_t frustum;
+static float camera_angle = 0.0f;
+
+// Render pass descriptor for frame buffer writes
+static struct {
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDescriptor descriptor;
+} render_pass;
+
+// Other variables
+static const char* example_title = "Frustum Culling Benchmark";
+static bool prepared             = false;
+
+static void prepare_benchmark(void)
+{
+  const uint32_t count = benchmark.num_objects;
+  float** arrays[7]    = {
+    &objects.center_x, &objects.center_y, &objects.center_z, &objects.radius,
+    &objects.extent_x, &objects.extent_y, &objects.extent_z,
+  };
+  for (uint32_t i = 0; i < ARRAY_SIZE(arrays); ++i) {
+    *arrays[i] = (float*)malloc(count * sizeof(float));
+    ASSERT(*arrays[i] != NULL);
+  }
+  srand((unsigned int)time(NULL)); // randomize seed
+  for (uint32_t i = 0; i < count; ++i) {
+    objects.center_x[i] = random_float_min_max(-SCENE_EXTENT, SCENE_EXTENT);
+    objects.center_y[i] = random_float_min_max(-SCENE_EXTENT, SCENE_EXTENT);
+    objects.center_z[i] = random_float_min_max(-SCENE_EXTENT, SCENE_EXTENT);
+    objects.radius[i]   = random_float_min_max(0.1f, 2.0f);
+    objects.extent_x[i] = random_float_min_max(0.1f, 2.0f);
+    objects.extent_y[i] = random_float_min_max(0.1f, 2.0f);
+    objects.extent_z[i] = random_float_min_max(0.1f, 2.0f);
+  }
+
+  const size_t mask_size    = ((count + 31) / 32) * sizeof(uint32_t);
+  visibility.mask           = (uint32_t*)malloc(mask_size);
+  visibility.reference_mask = (uint32_t*)malloc(mask_size);
+  visibility.indices        = (uint32_t*)malloc(count * sizeof(uint32_t));
+  ASSERT(visibility.mask != NULL && visibility.reference_mask != NULL
+         && visibility.indices != NULL);
+
+  memset(&stats, 0, sizeof(stats));
+}
+
+static void release_benchmark(void)
+{
+  free(objects.center_x);
+  free(objects.center_y);
+  free(objects.center_z);
+  free(objects.radius);
+  free(objects.extent_x);
+  free(objects.extent_y);
+  free(objects.extent_z);
+  memset(&objects, 0, sizeof(objects));
+  free(visibility.mask);
+  free(visibility.reference_mask);
+  free(visibility.indices);
+  memset(&visibility, 0, sizeof(visibility));
+}
+
+// Camera circling the scene, the visible fraction changes with its direction
+static void update_frustum(wgpu_example_context_t* context)
+{
+  camera_angle += context->frame_timer * 0.25f;
+  vec3 eye = {cosf(camera_angle) * SCENE_EXTENT * 0.5f, 5.0f,
+              sinf(camera_angle) * SCENE_EXTENT * 0.5f};
+  mat4 view, projection, view_projection;
+  glm_lookat(eye, (vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 1.0f, 0.0f}, view);
+  glm_perspective(glm_rad(60.0f), context->window_size.aspect_ratio, 0.1f,
+                  2.0f * SCENE_EXTENT, projection);
+  glm_mat4_mul(projection, view, view_projection);
+  frustum_update(&frustum, view_projection);
+}
+
+static uint32_t count_mask_mismatches(uint32_t count)
+{
+  uint32_t mismatch_count = 0;
+  for (uint32_t i = 0; i < (count + 31) / 32; ++i) {
+    mismatch_count += (uint32_t)__builtin_popcount(
+      visibility.mask[i] ^ visibility.reference_mask[i]);
+  }
+  return mismatch_count;
+}
+
+static void record_timing(culling_test_t test, uint64_t start_ns)
+{
+  const float ns_per_object = (float)(platform_get_time_ns() - start_ns)
+                              / (float)benchmark.num_objects;
+  // Exponential moving average, so that the shown values settle
+  float* average = &stats.ns_per_object[test];
+  *average       = *average == 0.0f ? ns_per_object :
+                                      *average * 0.95f + ns_per_object * 0.05f;
+}
+
+static void run_benchmark(void)
+{
+  const uint32_t count            = benchmark.num_objects;
+  const frustum_spheres_t spheres = {
+    .center_x = objects.center_x,
+    .center_y = objects.center_y,
+    .center_z = objects.center_z,
+    .radius   = objects.radius,
+  };
+  const frustum_aabbs_t aabbs = {
+    .center_x = objects.center_x,
+    .center_y = objects.center_y,
+    .center_z = objects.center_z,
+    .extent_x = objects.extent_x,
+    .extent_y = objects.extent_y,
+    .extent_z = objects.extent_z,
+  };
+  frustum_cull_result_t result = {
+    .visibility_mask = visibility.mask,
+    .visible_indices = visibility.indices,
+  };
+  frustum_cull_result_t reference = {
+    .visibility_mask = visibility.reference_mask,
+  };
+
+  // Spheres
+  uint64_t start_ns = platform_get_time_ns();
+  stats.visible_count[0]
+    = frustum_cull_spheres(&frustum, &spheres, count, &result);
+  record_timing(CULLING_TEST_SPHERES_SIMD, start_ns);
+  start_ns = platform_get_time_ns();
+  frustum_cull_spheres_scalar(&frustum, &spheres, count, &reference);
+  record_timing(CULLING_TEST_SPHERES_SCALAR, start_ns);
+  stats.mismatch_count[0] = count_mask_mismatches(count);
+
+  // Boxes
+  start_ns               = platform_get_time_ns();
+  stats.visible_count[1] = frustum_cull_aabbs(&frustum, &aabbs, count, &result);
+  record_timing(CULLING_TEST_AABBS_SIMD, start_ns);
+  start_ns = platform_get_time_ns();
+  frustum_cull_aabbs_scalar(&frustum, &aabbs, count, &reference);
+  record_timing(CULLING_TEST_AABBS_SCALAR, start_ns);
+  stats.mismatch_count[1] = count_mask_mismatches(count);
+}
+
+static void setup_render_pass(wgpu_context_t* wgpu_context)
+{
+  UNUSED_VAR(wgpu_context);
+
+  // Color attachment
+  render_pass.color_attachments[0] = (WGPURenderPassColorAttachment) {
+      .view       = NULL, // Assigned later
+      .loadOp     = WGPULoadOp_Clear,
+      .storeOp    = WGPUStoreOp_Store,
+      .clearValue = (WGPUColor) {
+        .r = 0.0f,
+        .g = 0.0f,
+        .b = 0.0f,
+        .a = 1.0f,
+      },
+  };
+
+  // Render pass descriptor
+  render_pass.descriptor = (WGPURenderPassDescriptor){
+    .colorAttachmentCount = 1,
+    .colorAttachments     = render_pass.color_attachments,
+  };
+}
+
+static int example_initialize(wgpu_example_context_t* context)
+{
+  if (context) {
+    prepare_benchmark();
+    setup_render_pass(context->wgpu_context);
+    prepared = true;
+    return 0;
+  }
+
+  return 1;
+}
+
+static int32_t get_num_objects_index(uint32_t num_objects)
+{
+  for (uint32_t i = 0; i < ARRAY_SIZE(num_objects_names); ++i) {
+    if ((uint32_t)atoi(num_objects_names[i]) == num_objects) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    int32_t num_objects_index = get_num_objects_index(benchmark.num_objects);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Objects",
+                                &num_objects_index, num_objects_names,
+                                ARRAY_SIZE(num_objects_names))) {
+      benchmark.num_objects = atoi(num_objects_names[num_objects_index]);
+      benchmark.changed     = true;
+    }
+  }
+  if (imgui_overlay_header("Statistics")) {
+    imgui_overlay_text("Instruction set: %s", frustum_get_simd_name());
+    for (uint32_t i = 0; i < CULLING_TEST_COUNT; ++i) {
+      const float ns = stats.ns_per_object[i];
+      imgui_overlay_text("%s: %.2f ns/object, %.1f M objects/s",
+                         culling_test_names[i], ns,
+                         ns > 0.0f ? 1e3f / ns : 0.0f);
+    }
+    for (uint32_t i = 0; i < 2; ++i) {
+      const float simd_ns   = stats.ns_per_object[2 * i];
+      const float scalar_ns = stats.ns_per_object[2 * i + 1];
+      imgui_overlay_text("%s: %u visible, %.1fx speedup, %u mismatches",
+                         culling_test_names[2 * i], stats.visible_count[i],
+                         simd_ns > 0.0f ? scalar_ns / simd_ns : 0.0f,
+                         stats.mismatch_count[i]);
+    }
+  }
+}
+
+static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context          = context->wgpu_context;
+  render_pass.color_attachments[0].view = wgpu_context->swap_chain.frame_buffer;
+
+  // Create command encoder
+  wgpu_context->cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+
+  // Render pass
+  {
+    wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
+      wgpu_context->cmd_enc, &render_pass.descriptor);
+    wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+  }
+
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
+
+  // Get command buffer
+  WGPUCommandBuffer command_buffer
+    = wgpu_get_command_buffer(wgpu_context->cmd_enc);
+  ASSERT(command_buffer != NULL)
+  WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
+
+  return command_buffer;
+}
+
+static int example_draw(wgpu_example_context_t* context)
+{
+  // Prepare frame
+  prepare_frame(context);
+
+  // Command buffer to be submitted to the queue
+  wgpu_context_t* wgpu_context                   = context->wgpu_context;
+  wgpu_context->submit_info.command_buffer_count = 1;
+  wgpu_context->submit_info.command_buffers[0] = build_command_buffer(context);
+
+  // Submit to queue
+  submit_command_buffers(context);
+
+  // Submit frame
+  submit_frame(context);
+
+  return 0;
+}
+
+static int example_render(wgpu_example_context_t* context)
+{
+  if (!prepared) {
+    return 1;
+  }
+  if (benchmark.changed) {
+    release_benchmark();
+    prepare_benchmark();
+    benchmark.changed = false;
+  }
+  if (!context->paused) {
+    update_frustum(context);
+    run_benchmark();
+  }
+  return example_draw(context);
+}
+
+// Clean up used resources
+static void example_destroy(wgpu_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  release_benchmark();
+}
+
+static void parse_benchmark_arguments(int argc, char* argv[])
+{
+  static const char objects_option[] = "--objects=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], objects_option, strlen(objects_option)) == 0) {
+      const uint32_t num_objects
+        = (uint32_t)strtoul(argv[i] + strlen(objects_option), NULL, 10);
+      benchmark.num_objects = CLAMP(num_objects, 1u, MAX_NUM_OBJECTS);
+    }
+  }
+}
+
+void example_frustum_culling_benchmark(int argc, char* argv[])
+{
+  parse_benchmark_arguments(argc, argv);
+
+  // clang-format off
+  example_run(argc, argv, &(refexport_t){
+    .example_settings = (wgpu_example_settings_t){
+     .title   = example_title,
+     .overlay = true,
+     .vsync   = false,
+    },
+    .example_initialize_func = &example_initialize,
+    .example_render_func     = &example_render,
+    .example_destroy_func    = &example_destroy,
+  });
+  // clang-format on
+}
@@ -8,6 +8,7 @@
 
 #include "../core/macro.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/procedural_mesh.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Gears
@@ -15,6 +16,14 @@
  * WebGPU interpretation of glxgears. Procedurally generates and animates
  * multiple gears.
  *
+ * The gears are generated from their parameters by a compute pass into one
+ * vertex and one index buffer, the procedural mesh, and drawn instanced, one
+ * draw per gear. The tooth depth picked in the settings regenerates them. The
+ * model view matrices of the instances are computed in a compute pass into a
+ * storage buffer indexed with the instance index, the instances of the set of
+ * gears are laid out in a grid. The number of gear sets is picked in the
+ * settings or with --instances=<n>.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/gears
  *
@@ -25,440 +34,6 @@
  * The coordinate system used by Vulkan is a right-handed system.
  * -------------------------------------------------------------------------- */
 
-/* -------------------------------------------------------------------------- *
- * WebGPU Gear class definition
- * -------------------------------------------------------------------------- */
-
-typedef struct vertex_t {
-  vec3 pos;
-  vec3 normal;
-  vec3 color;
-} vertex_t;
-
-static void initialize_vertex(vertex_t* v, vec3 p, vec3 n, vec3 c)
-{
-  v->pos[0]    = p[0];
-  v->pos[1]    = p[1];
-  v->pos[2]    = p[2];
-  v->color[0]  = c[0];
-  v->color[1]  = c[1];
-  v->color[2]  = c[2];
-  v->normal[0] = n[0];
-  v->normal[1] = n[1];
-  v->normal[2] = n[2];
-}
-
-typedef struct gear_info_t {
-  float inner_radius;
-  float outer_radius;
-  float width;
-  int num_teeth;
-  float tooth_depth;
-  vec3 color;
-  vec3 pos;
-  float rot_speed;
-  float rot_offset;
-} gear_info_t;
-
-typedef struct gear_ubo_t {
-  mat4 projection;
-  mat4 model;
-  mat4 normal;
-  mat4 view;
-  vec3 light_pos;
-} gear_ubo_t;
-
-typedef struct webgpu_gear_t {
-  // Reference to the WebGPU context
-  wgpu_context_t* wgpu_context;
-  // WGPU bind group
-  WGPUBindGroup bind_group;
-  // Vertex buffer
-  struct {
-    wgpu_buffer_t buffer;
-    vertex_t* data;
-  } vbo;
-  // Index buffer
-  struct {
-    wgpu_buffer_t buffer;
-    uint32_t* data;
-  } ibo;
-  // Uniform buffer
-  struct {
-    wgpu_buffer_t buffer;
-    gear_ubo_t data;
-  } ubo;
-  vec3 color;
-  vec3 pos;
-  float rot_speed;
-  float rot_offset;
-} webgpu_gear_t;
-
-static void webgpu_gear_prepare_uniform_buffer(webgpu_gear_t* gear);
-
-int32_t webgpu_gear_new_vertex(vertex_t* vertex_buffer, int32_t* vertex_counter,
-                               float x, float y, float z, vec3 normal,
-                               vec3 color)
-{
-  vertex_buffer[*vertex_counter] = (vertex_t){0};
-  initialize_vertex(&vertex_buffer[*vertex_counter], (vec3){x, y, z}, normal,
-                    color);
-  ++(*vertex_counter);
-  return (*vertex_counter) - 1;
-}
-
-void webgpu_gear_new_face(uint32_t* index_buffer, int32_t* index_counter, int a,
-                          int b, int c)
-{
-  index_buffer[(*index_counter)++] = a;
-  index_buffer[(*index_counter)++] = b;
-  index_buffer[(*index_counter)++] = c;
-}
-
-static webgpu_gear_t* webgpu_gear_create(wgpu_context_t* wgpu_context)
-{
-  webgpu_gear_t* gear = (webgpu_gear_t*)malloc(sizeof(webgpu_gear_t));
-  gear->wgpu_context  = wgpu_context;
-  gear->vbo.data      = NULL;
-  gear->ibo.data      = NULL;
-
-  return gear;
-}
-
-static void webgpu_gear_destroy(webgpu_gear_t* gear)
-{
-  // Clean up WebGPU resources
-  WGPU_RELEASE_RESOURCE(Buffer, gear->ubo.buffer.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, gear->vbo.buffer.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, gear->ibo.buffer.buffer)
-  WGPU_RELEASE_RESOURCE(BindGroup, gear->bind_group)
-  if (gear->vbo.data) {
-    free(gear->vbo.data);
-  }
-  if (gear->ibo.data) {
-    free(gear->ibo.data);
-  }
-  free(gear);
-}
-
-static void webgpu_gear_generate(webgpu_gear_t* gear, gear_info_t* gearinfo)
-{
-  glm_vec3_copy(gearinfo->color, gear->color);
-  glm_vec3_copy(gearinfo->pos, gear->pos);
-  gear->rot_offset = gearinfo->rot_offset;
-  gear->rot_speed  = gearinfo->rot_speed;
-
-  /* Vertex buffer */
-  gear->vbo.buffer.count = (6         // /* front face */
-                            + 4       // /* front sides of teeth */
-                            + 6       // /* back face */
-                            + 4       // /* back sides of teeth */
-                            + (4 * 5) // /* draw outward faces of teeth */
-                            )
-                           * gearinfo->num_teeth;
-  gear->vbo.buffer.size  = gear->vbo.buffer.count * sizeof(vertex_t);
-  gear->vbo.data         = (vertex_t*)malloc(gear->vbo.buffer.size);
-  vertex_t* vbd          = gear->vbo.data; // alias
-  int32_t vertex_counter = 0;
-
-  /* Index buffer */
-  gear->ibo.buffer.count = (4         // /* front face */
-                            + 2       // /* front sides of teeth */
-                            + 4       // /* back face */
-                            + 2       // /* back sides of teeth */
-                            + (2 * 5) // /* draw outward faces of teeth */
-                            )
-                           * 3 * gearinfo->num_teeth;
-  gear->ibo.buffer.size = gear->ibo.buffer.count * sizeof(uint32_t);
-  gear->ibo.data        = (uint32_t*)malloc(gear->ibo.buffer.size);
-  uint32_t* ibd         = gear->ibo.data; // alias
-  int32_t index_counter = 0;
-
-  int i;
-  float r0, r1, r2;
-  float ta, da;
-  float u1, v1, u2, v2, len;
-  float cos_ta, cos_ta_1da, cos_ta_2da, cos_ta_3da, cos_ta_4da;
-  float sin_ta, sin_ta_1da, sin_ta_2da, sin_ta_3da, sin_ta_4da;
-  int32_t ix0, ix1, ix2, ix3, ix4, ix5;
-
-  r0 = gearinfo->inner_radius;
-  r1 = gearinfo->outer_radius - gearinfo->tooth_depth / 2.0f;
-  r2 = gearinfo->outer_radius + gearinfo->tooth_depth / 2.0f;
-  da = 2.0f * PI / gearinfo->num_teeth / 4.0f;
-
-  vec3 normal = GLM_VEC3_ZERO_INIT;
-
-  for (i = 0; i < gearinfo->num_teeth; ++i) {
-    ta = i * 2.0f * PI / gearinfo->num_teeth;
-
-    cos_ta     = cos(ta);
-    cos_ta_1da = cos(ta + da);
-    cos_ta_2da = cos(ta + 2.0f * da);
-    cos_ta_3da = cos(ta + 3.0f * da);
-    cos_ta_4da = cos(ta + 4.0f * da);
-    sin_ta     = sin(ta);
-    sin_ta_1da = sin(ta + da);
-    sin_ta_2da = sin(ta + 2.0f * da);
-    sin_ta_3da = sin(ta + 3.0f * da);
-    sin_ta_4da = sin(ta + 4.0f * da);
-
-    u1  = r2 * cos_ta_1da - r1 * cos_ta;
-    v1  = r2 * sin_ta_1da - r1 * sin_ta;
-    len = sqrt(u1 * u1 + v1 * v1);
-    u1 /= len;
-    v1 /= len;
-    u2 = r1 * cos_ta_3da - r2 * cos_ta_2da;
-    v2 = r1 * sin_ta_3da - r2 * sin_ta_2da;
-
-    // front face
-    glm_vec3_copy((vec3){0.0f, 0.0f, 1.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r0 * cos_ta, r0 * sin_ta,
-                                 gearinfo->width * 0.5f, normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta, r1 * sin_ta,
-                                 gearinfo->width * 0.5f, normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r0 * cos_ta, r0 * sin_ta,
-                                 gearinfo->width * 0.5f, normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix4 = webgpu_gear_new_vertex(vbd, &vertex_counter, r0 * cos_ta_4da,
-                                 r0 * sin_ta_4da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix5 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_4da,
-                                 r1 * sin_ta_4da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix2, ix3, ix4);
-    webgpu_gear_new_face(ibd, &index_counter, ix3, ix5, ix4);
-
-    // front sides of teeth
-    glm_vec3_copy((vec3){0.0f, 0.0f, 1.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta, r1 * sin_ta,
-                                 gearinfo->width * 0.5f, normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_1da,
-                                 r2 * sin_ta_1da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_2da,
-                                 r2 * sin_ta_2da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-
-    // back face
-    glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta, r1 * sin_ta,
-                                 -gearinfo->width * 0.5f, normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r0 * cos_ta, r0 * sin_ta,
-                                 -gearinfo->width * 0.5f, normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r0 * cos_ta, r0 * sin_ta,
-                                 -gearinfo->width * 0.5f, normal, gear->color);
-    ix4 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_4da,
-                                 r1 * sin_ta_4da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix5 = webgpu_gear_new_vertex(vbd, &vertex_counter, r0 * cos_ta_4da,
-                                 r0 * sin_ta_4da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix2, ix3, ix4);
-    webgpu_gear_new_face(ibd, &index_counter, ix3, ix5, ix4);
-
-    // back sides of teeth
-    glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_2da,
-                                 r2 * sin_ta_2da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta, r1 * sin_ta,
-                                 -gearinfo->width * 0.5f, normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_1da,
-                                 r2 * sin_ta_1da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-
-    // draw outward faces of teeth
-    glm_vec3_copy((vec3){v1, -u1, 0.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta, r1 * sin_ta,
-                                 gearinfo->width * 0.5f, normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta, r1 * sin_ta,
-                                 -gearinfo->width * 0.5f, normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_1da,
-                                 r2 * sin_ta_1da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_1da,
-                                 r2 * sin_ta_1da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-
-    glm_vec3_copy((vec3){cos_ta, sin_ta, 0.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_1da,
-                                 r2 * sin_ta_1da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_1da,
-                                 r2 * sin_ta_1da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_2da,
-                                 r2 * sin_ta_2da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_2da,
-                                 r2 * sin_ta_2da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-
-    glm_vec3_copy((vec3){v2, -u2, 0.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_2da,
-                                 r2 * sin_ta_2da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r2 * cos_ta_2da,
-                                 r2 * sin_ta_2da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-
-    glm_vec3_copy((vec3){cos_ta, sin_ta, 0.0f}, normal);
-    ix0 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix1 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_3da,
-                                 r1 * sin_ta_3da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix2 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_4da,
-                                 r1 * sin_ta_4da, gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    ix3 = webgpu_gear_new_vertex(vbd, &vertex_counter, r1 * cos_ta_4da,
-                                 r1 * sin_ta_4da, -gearinfo->width * 0.5f,
-                                 normal, gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-
-    // draw inside radius cylinder
-    ix0 = webgpu_gear_new_vertex(gear->vbo.data, &vertex_counter, r0 * cos_ta,
-                                 r0 * sin_ta, -gearinfo->width * 0.5f,
-                                 (vec3){-cos_ta, -sin_ta, 0.0f}, gear->color);
-    ix1 = webgpu_gear_new_vertex(gear->vbo.data, &vertex_counter, r0 * cos_ta,
-                                 r0 * sin_ta, gearinfo->width * 0.5f,
-                                 (vec3){-cos_ta, -sin_ta, 0.0f}, gear->color);
-    ix2 = webgpu_gear_new_vertex(
-      gear->vbo.data, &vertex_counter, r0 * cos_ta_4da, r0 * sin_ta_4da,
-      -gearinfo->width * 0.5f, (vec3){-cos_ta_4da, -sin_ta_4da, 0.0f},
-      gear->color);
-    ix3 = webgpu_gear_new_vertex(
-      gear->vbo.data, &vertex_counter, r0 * cos_ta_4da, r0 * sin_ta_4da,
-      gearinfo->width * 0.5f, (vec3){-cos_ta_4da, -sin_ta_4da, 0.0f},
-      gear->color);
-    webgpu_gear_new_face(ibd, &index_counter, ix0, ix1, ix2);
-    webgpu_gear_new_face(ibd, &index_counter, ix1, ix3, ix2);
-  }
-
-  // Vertex buffer
-  gear->vbo.buffer = wgpu_create_buffer(
-    gear->wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage        = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
-      .size         = gear->vbo.buffer.size,
-      .count        = gear->vbo.buffer.count,
-      .initial.data = gear->vbo.data,
-    });
-
-  // Index buffer
-  gear->ibo.buffer
-    = wgpu_create_buffer(gear->wgpu_context, &(wgpu_buffer_desc_t){
-                                               .usage = WGPUBufferUsage_CopyDst
-                                                        | WGPUBufferUsage_Index,
-                                               .size  = gear->ibo.buffer.size,
-                                               .count = gear->ibo.buffer.count,
-                                               .initial.data = gear->ibo.data,
-                                             });
-
-  // Uniform buffer
-  webgpu_gear_prepare_uniform_buffer(gear);
-}
-
-static void webgpu_gear_draw(webgpu_gear_t* gear)
-{
-  WGPURenderPassEncoder rpass = gear->wgpu_context->rpass_enc;
-
-  wgpuRenderPassEncoderSetBindGroup(rpass, 0, gear->bind_group, 0, 0);
-  wgpuRenderPassEncoderSetVertexBuffer(rpass, 0, gear->vbo.buffer.buffer, 0,
-                                       WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderSetIndexBuffer(
-    rpass, gear->ibo.buffer.buffer, WGPUIndexFormat_Uint32, 0, WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderDrawIndexed(rpass, gear->ibo.buffer.count, 1, 0, 0, 1);
-}
-
-static void webgpu_gear_update_uniform_buffer(webgpu_gear_t* gear,
-                                              mat4 perspective, mat4 view,
-                                              float timer)
-{
-  gear_ubo_t* ubo = &gear->ubo.data;
-  glm_mat4_copy(perspective, ubo->projection);
-  glm_mat4_copy(view, ubo->view);
-  glm_mat4_copy(GLM_MAT4_IDENTITY, ubo->model);
-  glm_translate(ubo->model, gear->pos);
-  glm_rotate(ubo->model, glm_rad((gear->rot_speed * timer) + gear->rot_offset),
-             (vec3){0.0f, 0.0f, 1.0f});
-  mat4 mul_mat = GLM_MAT4_ZERO_INIT;
-  glm_mat4_mul(ubo->view, ubo->model, mul_mat);
-  glm_mat4_inv(mul_mat, mul_mat);
-  glm_mat4_transpose_to(mul_mat, ubo->normal);
-  glm_vec3_copy((vec3){0.0f, 0.0f, 2.5f}, ubo->light_pos);
-  ubo->light_pos[0] = sin(glm_rad(timer)) * 8.0f;
-  ubo->light_pos[2] = cos(glm_rad(timer)) * 8.0f;
-
-  wgpu_queue_write_buffer(gear->wgpu_context, gear->ubo.buffer.buffer, 0, ubo,
-                          gear->ubo.buffer.size);
-}
-
-static void webgpu_gear_setup_bind_group(webgpu_gear_t* gear,
-                                         WGPUBindGroupLayout bind_group_layout)
-{
-  WGPUBindGroupDescriptor bg_desc = {
-    .layout     = bind_group_layout,
-    .entryCount = 1,
-    .entries    = &(WGPUBindGroupEntry) {
-      // Binding 0 : Vertex shader uniform buffer
-      .binding = 0,
-      .buffer  = gear->ubo.buffer.buffer,
-      .offset  = 0,
-      .size    = gear->ubo.buffer.size,
-    },
-  };
-
-  gear->bind_group
-    = wgpuDeviceCreateBindGroup(gear->wgpu_context->device, &bg_desc);
-  ASSERT(gear->bind_group != NULL);
-}
-
-static void webgpu_gear_prepare_uniform_buffer(webgpu_gear_t* gear)
-{
-  memset(&gear->ubo.data, 0, sizeof(gear_ubo_t));
-  gear->ubo.buffer = wgpu_create_buffer(
-    gear->wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-      .size  = sizeof(gear_ubo_t),
-    });
-}
-
 /* -------------------------------------------------------------------------- *
  * WebGPU Gears properties definition
  * -------------------------------------------------------------------------- */
@@ -468,7 +43,6 @@ typedef struct webgpu_gear_definition_t {
   float outer_radius;
   float width;
   int32_t tooth_count;
-  float tooth_depth;
   vec3 color;
   vec3 position;
   float rotation_speed;
@@ -482,7 +56,6 @@ static webgpu_gear_definition_t gear_defs[3] = {
     .outer_radius    = 4.0f,
     .width           = 1.0f,
     .tooth_count     = 20,
-    .tooth_depth     = 0.7f,
     .color           = {1.0f, 0.0f, 0.0f},
     .position        = {-3.0f, 0.0f, 0.0f},
     .rotation_speed  = 1.0f,
@@ -493,7 +66,6 @@ static webgpu_gear_definition_t gear_defs[3] = {
     .outer_radius    = 2.0f,
     .width           = 2.0f,
     .tooth_count     = 10,
-    .tooth_depth     = 0.7f,
     .color           = {0.0f, 1.0f, 0.2f},
     .position        = {3.1f, 0.0f, 0.0f},
     .rotation_speed  = -2.0f,
@@ -504,58 +76,235 @@ static webgpu_gear_definition_t gear_defs[3] = {
     .outer_radius    = 2.0f,
     .width           = 0.5f,
     .tooth_count     = 10,
-    .tooth_depth     = 0.7f,
     .color           = {0.0f, 0.0f, 1.0f},
     .position        = {-3.1f, -6.2f, 0.0f},
     .rotation_speed  = -2.0f,
     .rotation_offset = -30.0f,
   },
 };
-static webgpu_gear_t* wgpu_gears[3];
-static const uint32_t wgpu_gears_count = (uint32_t)ARRAY_SIZE(wgpu_gears);
-
-static void prepare_vertices(wgpu_context_t* wgpu_context)
-{
-  for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
-    const float* gear_color    = gear_defs[i].color;
-    const float* gear_position = gear_defs[i].position;
-    gear_info_t gear_info      = {
-           .inner_radius = gear_defs[i].inner_radius,
-           .outer_radius = gear_defs[i].outer_radius,
-           .width        = gear_defs[i].width,
-           .num_teeth    = gear_defs[i].tooth_count,
-           .tooth_depth  = gear_defs[i].tooth_depth,
-           .color        = {gear_color[0], gear_color[1], gear_color[2]},
-           .pos          = {gear_position[0], gear_position[1], gear_position[2]},
-           .rot_speed    = gear_defs[i].rotation_speed,
-           .rot_offset   = gear_defs[i].rotation_offset,
-    };
-    wgpu_gears[i] = webgpu_gear_create(wgpu_context);
-    webgpu_gear_generate(wgpu_gears[i], &gear_info);
-  }
-}
+static const uint32_t wgpu_gears_count = (uint32_t)ARRAY_SIZE(gear_defs);
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Gears example
  * -------------------------------------------------------------------------- */
 
-// The pipeline layout
-static WGPUPipelineLayout pipeline_layout;
+#define DEFAULT_NUM_INSTANCES 1u
+// 128MB storage buffer binding of 64 bytes matrices, shared by the 3 gears
+#define MAX_NUM_INSTANCES 699050u
+
+#define INSTANCES_WORKGROUP_SIZE 64u
+
+// Distance between the gear sets in the grid
+#define INSTANCE_SPACING 16.0f
+
+// Shaders
+// clang-format off
+static const char* gears_compute_shader_wgsl = CODE(
+  struct GearDefinition {
+    position : vec3<f32>,
+    rotationSpeed : f32,
+    rotationOffset : f32,
+  }
+
+  struct Params {
+    view : mat4x4<f32>,
+    gears : array<GearDefinition, 3>,
+    timer : f32,
+    instanceCount : u32,
+    side : u32,
+    spacing : f32,
+  }
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1) var<storage, read_write> modelViews :
+    array<mat4x4<f32>>;
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= 3u * params.instanceCount) {
+      return;
+    }
+    // The instances of a gear are consecutive, each instance is a gear set
+    // placed in a grid centered on the origin
+    let gear = params.gears[index / params.instanceCount];
+    let instance = index % params.instanceCount;
+    let side = params.side;
+    let cell = vec3<f32>(f32(instance % side), f32((instance / side) % side),
+                         f32(instance / (side * side)));
+    let center = vec3<f32>(f32(side) * 0.5 - 0.5);
+    let position = gear.position + params.spacing * (cell - center);
+    let angle = radians(gear.rotationSpeed * params.timer
+                        + gear.rotationOffset);
+    let c = cos(angle);
+    let s = sin(angle);
+    let model = mat4x4<f32>(
+      vec4<f32>(c, s, 0.0, 0.0),
+      vec4<f32>(-s, c, 0.0, 0.0),
+      vec4<f32>(0.0, 0.0, 1.0, 0.0),
+      vec4<f32>(position, 1.0)
+    );
+    modelViews[index] = params.view * model;
+  }
+);
+
+static const char* gears_shader_wgsl = CODE(
+  struct Uniforms {
+    projection : mat4x4<f32>,
+    lightPosition : vec4<f32>,
+  }
+
+  @group(0) @binding(0) var<uniform> uniforms : Uniforms;
+  @group(0) @binding(1) var<storage, read> modelViews : array<mat4x4<f32>>;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) normal : vec3<f32>,
+    @location(1) color : vec3<f32>,
+    @location(2) eyePosition : vec3<f32>,
+    @location(3) lightVector : vec3<f32>,
+  }
+
+  @vertex
+  fn vs_main(
+    @builtin(instance_index) instanceIndex : u32,
+    @location(0) position : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) color : vec3<f32>
+  ) -> VertexOutput {
+    // The model view matrices are rigid, they transform the normals as well
+    let modelView = modelViews[instanceIndex];
+    let eyePosition = modelView * vec4<f32>(position, 1.0);
+    var output : VertexOutput;
+    output.position = uniforms.projection * eyePosition;
+    output.normal = (modelView * vec4<f32>(normal, 0.0)).xyz;
+    output.color = color;
+    output.eyePosition = eyePosition.xyz;
+    output.lightVector = uniforms.lightPosition.xyz - eyePosition.xyz;
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let normal = normalize(input.normal);
+    let lightVector = normalize(input.lightVector);
+    let eye = normalize(-input.eyePosition);
+    let reflected = reflect(-lightVector, normal);
+    let ambient = vec3<f32>(0.2);
+    let diffuse = vec3<f32>(0.5) * max(dot(normal, lightVector), 0.0);
+    let specular = vec3<f32>(0.5) * pow(max(dot(reflected, eye), 0.0), 0.8)
+                   * 0.25;
+    return vec4<f32>((ambient + diffuse) * input.color + specular, 1.0);
+  }
+);
+// clang-format on
+
+// Instance resources are recreated when the instance count is changed
+static struct {
+  uint32_t num_instances;
+  bool changed;
+} instancing = {
+  .num_instances = DEFAULT_NUM_INSTANCES,
+  .changed       = false,
+};
+
+static const char* num_instances_names[5] = {
+  "1", "64", "4096", "65536", "524288",
+};
+
+// Parameters of the compute pass
+typedef struct gear_params_t {
+  vec3 position;
+  float rotation_speed;
+  float rotation_offset;
+  float padding[3];
+} gear_params_t;
+
+static struct {
+  mat4 view;
+  gear_params_t gears[3];
+  float timer;
+  uint32_t instance_count;
+  uint32_t side;
+  float spacing;
+} compute_params = {0};
+
+// Uniforms of the render pipeline, the light position is in view space
+static struct {
+  mat4 projection;
+  vec4 light_position;
+} render_uniforms = {0};
 
-// Pipeline
+// Gears generated into one vertex and one index buffer, shape i is gear i
+static struct {
+  wgpu_procedural_mesh_t* mesh;
+  float tooth_depth;
+  bool changed;
+} geometry = {
+  .tooth_depth = 0.7f,
+  .changed     = false,
+};
+
+// Uniform buffers and storage buffer of the model view matrices
+static wgpu_buffer_t compute_params_buffer  = {0};
+static wgpu_buffer_t render_uniforms_buffer = {0};
+static wgpu_buffer_t instances_buffer       = {0};
+
+// Bind groups
+static struct {
+  WGPUBindGroup compute;
+  WGPUBindGroup render;
+} bind_groups = {0};
+
+// Pipelines
+static WGPUComputePipeline compute_pipeline;
 static WGPURenderPipeline pipeline;
 
 // Render pass descriptor for frame buffer writes
 static WGPURenderPassColorAttachment rp_color_att_descriptors[1];
 static WGPURenderPassDescriptor render_pass_desc;
 
-// The bind group layout
-static WGPUBindGroupLayout bind_group_layout;
-
 // Other variables
 static const char* example_title = "Gears";
 static bool prepared             = false;
 
+// Generates the gears on the GPU with the current tooth depth
+static void generate_gears(void)
+{
+  wgpu_procedural_mesh_clear(geometry.mesh);
+  for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
+    const webgpu_gear_definition_t* gear_def = &gear_defs[i];
+    wgpu_procedural_mesh_add_shape(
+      geometry.mesh, &(wgpu_procedural_shape_desc_t){
+                       .shape = WGPU_ProceduralShape_Gear,
+                       .gear  = {
+                         .inner_radius = gear_def->inner_radius,
+                         .outer_radius = gear_def->outer_radius,
+                         .width        = gear_def->width,
+                         .tooth_depth  = geometry.tooth_depth,
+                         .tooth_count  = (uint32_t)gear_def->tooth_count,
+                       },
+                       .color = {gear_def->color[0], gear_def->color[1],
+                                 gear_def->color[2], 1.0f},
+                     });
+  }
+  wgpu_procedural_mesh_generate(geometry.mesh);
+}
+
+static void prepare_vertices(wgpu_context_t* wgpu_context)
+{
+  geometry.mesh = wgpu_procedural_mesh_create(wgpu_context);
+  generate_gears();
+
+  // Per gear parameters of the compute pass
+  for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
+    gear_params_t* gear_params = &compute_params.gears[i];
+    glm_vec3_copy(gear_defs[i].position, gear_params->position);
+    gear_params->rotation_speed  = gear_defs[i].rotation_speed;
+    gear_params->rotation_offset = gear_defs[i].rotation_offset;
+  }
+}
+
 static void setup_camera(wgpu_example_context_t* context)
 {
   context->camera         = camera_create();
@@ -568,48 +317,132 @@ static void setup_camera(wgpu_example_context_t* context)
   context->timer_speed *= 0.25f;
 }
 
-static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
+static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
 {
-  // Bind group layout
-  WGPUBindGroupLayoutDescriptor bgl_desc = {
-    .entryCount = 1,
-    .entries = &(WGPUBindGroupLayoutEntry) {
-      // Binding 0: Vertex shader uniform buffer
-      .binding   = 0,
-      .visibility = WGPUShaderStage_Vertex,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type = WGPUBufferBindingType_Uniform,
-        .hasDynamicOffset = false,
-        .minBindingSize   = sizeof(gear_ubo_t),
-      },
-      .sampler = {0},
-    },
-  };
-  bind_group_layout
-    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
-  ASSERT(bind_group_layout != NULL)
-
-  // Create the pipeline layout that is used to generate the rendering pipelines
-  // that are based on this descriptor set layout
-  WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
-    .bindGroupLayoutCount = 1,
-    .bindGroupLayouts     = &bind_group_layout,
-  };
-  pipeline_layout = wgpuDeviceCreatePipelineLayout(wgpu_context->device,
-                                                   &pipeline_layout_desc);
-  ASSERT(pipeline_layout != NULL)
+  compute_params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Gears compute params buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(compute_params),
+                  });
+
+  render_uniforms_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Gears uniform buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(render_uniforms),
+                  });
 }
 
-static void setup_bind_groups()
+// Creates the model view matrices of the instances and the bind groups
+// referencing them
+static void prepare_instances(wgpu_context_t* wgpu_context)
 {
-  for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
-    webgpu_gear_setup_bind_group(wgpu_gears[i], bind_group_layout);
+  const uint32_t count          = instancing.num_instances;
+  compute_params.instance_count = count;
+  compute_params.side           = (uint32_t)ceilf(cbrtf((float)count));
+  compute_params.spacing        = INSTANCE_SPACING;
+
+  instances_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Gears model view matrices buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = wgpu_gears_count * count * sizeof(mat4),
+                  });
+
+  // Compute bind group
+  {
+    WGPUBindGroupEntry bg_entries[2] = {
+      [0] = (WGPUBindGroupEntry) {
+        // Binding 0: Compute shader parameters
+        .binding = 0,
+        .buffer  = compute_params_buffer.buffer,
+        .offset  = 0,
+        .size    = compute_params_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        // Binding 1: Model view matrices
+        .binding = 1,
+        .buffer  = instances_buffer.buffer,
+        .offset  = 0,
+        .size    = instances_buffer.size,
+      },
+    };
+    bind_groups.compute = wgpuDeviceCreateBindGroup(
+      wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label  = "Gears compute bind group",
+        .layout = wgpuComputePipelineGetBindGroupLayout(compute_pipeline, 0),
+        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+        .entries    = bg_entries,
+      });
+    ASSERT(bind_groups.compute != NULL);
+  }
+
+  // Render bind group
+  {
+    WGPUBindGroupEntry bg_entries[2] = {
+      [0] = (WGPUBindGroupEntry) {
+        // Binding 0: Vertex shader uniform buffer
+        .binding = 0,
+        .buffer  = render_uniforms_buffer.buffer,
+        .offset  = 0,
+        .size    = render_uniforms_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        // Binding 1: Model view matrices
+        .binding = 1,
+        .buffer  = instances_buffer.buffer,
+        .offset  = 0,
+        .size    = instances_buffer.size,
+      },
+    };
+    bind_groups.render = wgpuDeviceCreateBindGroup(
+      wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "Gears render bind group",
+        .layout     = wgpuRenderPipelineGetBindGroupLayout(pipeline, 0),
+        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+        .entries    = bg_entries,
+      });
+    ASSERT(bind_groups.render != NULL);
   }
 }
 
-// Create the graphics pipeline
+static void release_instances(void)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.compute)
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.render)
+  WGPU_RELEASE_RESOURCE(Buffer, instances_buffer.buffer)
+}
+
+// Create the compute and the graphics pipelines
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
 {
+  /* Compute pipeline */
+  {
+    // Compute shader
+    wgpu_shader_t gears_comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "gears_compute_shader",
+                      .wgsl_code.source = gears_compute_shader_wgsl,
+                      .entry            = "main",
+                    });
+
+    // Create compute pipeline
+    compute_pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device,
+      &(WGPUComputePipelineDescriptor){
+        .label   = "gears_compute_pipeline",
+        .compute = gears_comp_shader.programmable_stage_descriptor,
+      });
+    ASSERT(compute_pipeline != NULL);
+
+    // Partial cleanup
+    wgpu_shader_release(&gears_comp_shader);
+  }
+
   // Primitive state
   WGPUPrimitiveState primitive_state = {
     .topology  = WGPUPrimitiveTopology_TriangleList,
@@ -634,23 +467,25 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
 
   // Vertex buffer layout
   WGPU_VERTEX_BUFFER_LAYOUT(
-    gear, sizeof(vertex_t),
+    gear, sizeof(wgpu_procedural_vertex_t),
     // Attribute location 0: Position
-    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, offsetof(vertex_t, pos)),
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3,
+                       offsetof(wgpu_procedural_vertex_t, position)),
     // Attribute location 1: Normal
     WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x3,
-                       offsetof(vertex_t, normal)),
+                       offsetof(wgpu_procedural_vertex_t, normal)),
     // Attribute location 2: Color
     WGPU_VERTATTR_DESC(2, WGPUVertexFormat_Float32x3,
-                       offsetof(vertex_t, color)))
+                       offsetof(wgpu_procedural_vertex_t, color)))
 
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
                 wgpu_context, &(wgpu_vertex_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
-                  // Vertex shader SPIR-V
-                  .label = "gears_vertex_shader",
-                  .file  = "shaders/gears/gears.vert.spv",
+                  // Vertex shader WGSL
+                  .label            = "gears_vertex_shader",
+                  .wgsl_code.source = gears_shader_wgsl,
+                  .entry            = "vs_main",
                 },
                 .buffer_count = 1,
                 .buffers      = &gear_vertex_buffer_layout,
@@ -660,9 +495,10 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
                 wgpu_context, &(wgpu_fragment_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
-                  // Fragment shader SPIR-V
-                  .label = "gears_fragment_shader",
-                  .file  = "shaders/gears/gears.frag.spv",
+                  // Fragment shader WGSL
+                  .label            = "gears_fragment_shader",
+                  .wgsl_code.source = gears_shader_wgsl,
+                  .entry            = "fs_main",
                 },
                 .target_count = 1,
                 .targets      = &color_target_state,
@@ -679,13 +515,13 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   pipeline = wgpuDeviceCreateRenderPipeline(
     wgpu_context->device, &(WGPURenderPipelineDescriptor){
                             .label        = "solid_render_pipeline",
-                            .layout       = pipeline_layout,
                             .primitive    = primitive_state,
                             .vertex       = vertex_state,
                             .fragment     = &fragment_state,
                             .depthStencil = &depth_stencil_state,
                             .multisample  = multisample_state,
                           });
+  ASSERT(pipeline != NULL);
 
   // Partial cleanup
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
@@ -720,11 +556,23 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
-  for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
-    webgpu_gear_update_uniform_buffer(
-      wgpu_gears[i], context->camera->matrices.perspective,
-      context->camera->matrices.view, context->timer * 360.0f);
-  }
+  camera_t* camera  = context->camera;
+  const float timer = context->timer * 360.0f;
+
+  // Compute pass parameters
+  glm_mat4_copy(camera->matrices.view, compute_params.view);
+  compute_params.timer = timer;
+  wgpu_queue_write_buffer(context->wgpu_context, compute_params_buffer.buffer,
+                          0, &compute_params, compute_params_buffer.size);
+
+  // Render uniforms
+  glm_mat4_copy(camera->matrices.perspective, render_uniforms.projection);
+  vec4 light_position = {sin(glm_rad(timer)) * 8.0f, 0.0f,
+                         cos(glm_rad(timer)) * 8.0f, 1.0f};
+  glm_mat4_mulv(camera->matrices.view, light_position,
+                render_uniforms.light_position);
+  wgpu_queue_write_buffer(context->wgpu_context, render_uniforms_buffer.buffer,
+                          0, &render_uniforms, render_uniforms_buffer.size);
 }
 
 static int example_initialize(wgpu_example_context_t* context)
@@ -732,9 +580,9 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     prepare_vertices(context->wgpu_context);
-    setup_pipeline_layout(context->wgpu_context);
+    prepare_uniform_buffers(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
-    setup_bind_groups();
+    prepare_instances(context->wgpu_context);
     update_uniform_buffers(context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
@@ -744,10 +592,32 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static int32_t get_num_instances_index(uint32_t num_instances)
+{
+  for (uint32_t i = 0; i < ARRAY_SIZE(num_instances_names); ++i) {
+    if ((uint32_t)atoi(num_instances_names[i]) == num_instances) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    int32_t num_instances_index
+      = get_num_instances_index(instancing.num_instances);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Gear sets",
+                                &num_instances_index, num_instances_names,
+                                ARRAY_SIZE(num_instances_names))) {
+      instancing.num_instances = atoi(num_instances_names[num_instances_index]);
+      instancing.changed       = true;
+    }
+    if (imgui_overlay_slider_float(context->imgui_overlay, "Tooth depth",
+                                   &geometry.tooth_depth, 0.2f, 1.5f)) {
+      geometry.changed = true;
+    }
   }
 }
 
@@ -759,16 +629,35 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Compute the model view matrices of the instances
+  const uint32_t num_instances = instancing.num_instances;
+  wgpu_context->cpass_enc
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc, compute_pipeline);
+  wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
+                                     bind_groups.compute, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    wgpu_context->cpass_enc,
+    (wgpu_gears_count * num_instances + INSTANCES_WORKGROUP_SIZE - 1)
+      / INSTANCES_WORKGROUP_SIZE,
+    1, 1);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+
   // Create render pass encoder for encoding drawing commands
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass_desc);
 
-  // Bind the rendering pipeline
+  // Bind the rendering pipeline and the merged buffers
   wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
+  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
+                                    bind_groups.render, 0, 0);
+  wgpu_procedural_mesh_bind(geometry.mesh, wgpu_context->rpass_enc, 0);
 
-  // Draw gears
+  // Draw the instances of each gear
   for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
-    webgpu_gear_draw(wgpu_gears[i]);
+    wgpu_procedural_mesh_draw(geometry.mesh, wgpu_context->rpass_enc, i,
+                              num_instances, i * num_instances);
   }
 
   // End render pass
@@ -811,10 +700,25 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  if (instancing.changed) {
+    release_instances();
+    prepare_instances(context->wgpu_context);
+    update_uniform_buffers(context);
+    instancing.changed = false;
+  }
+  if (geometry.changed) {
+    generate_gears();
+    geometry.changed = false;
+  }
   const int draw_result = example_draw(context);
   if (!context->paused) {
     update_uniform_buffers(context);
   }
+  if (context->benchmark.instance != NULL) {
+    benchmark_record_counter(context->benchmark.instance, "instances",
+                             (double)(wgpu_gears_count
+                                      * instancing.num_instances));
+  }
   return draw_result;
 }
 
@@ -827,17 +731,30 @@ static void example_on_view_changed(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
+  release_instances();
+  WGPU_RELEASE_RESOURCE(Buffer, compute_params_buffer.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, render_uniforms_buffer.buffer)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, compute_pipeline);
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline);
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout);
+  wgpu_procedural_mesh_release(geometry.mesh);
+}
 
-  for (uint32_t i = 0; i < wgpu_gears_count; ++i) {
-    webgpu_gear_destroy(wgpu_gears[i]);
+static void parse_instancing_arguments(int argc, char* argv[])
+{
+  static const char instances_option[] = "--instances=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], instances_option, strlen(instances_option)) == 0) {
+      const uint32_t num_instances
+        = (uint32_t)strtoul(argv[i] + strlen(instances_option), NULL, 10);
+      instancing.num_instances = CLAMP(num_instances, 1u, MAX_NUM_INSTANCES);
+    }
   }
 }
 
 void example_gears(int argc, char* argv[])
 {
+  parse_instancing_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
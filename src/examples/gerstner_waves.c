@@ -2,17 +2,26 @@
 #include "examples.h"
 #include "meshes.h"
 
+#include <math.h>
 #include <string.h>
 
+#include "../webgpu/imgui_overlay.h"
+
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Gerstner Waves
  *
  * This example is a WebGPU implementation of the Gerstner Waves algorithm.
  *
+ * The spectral mode replaces the sum of Gerstner waves with an FFT ocean: a
+ * Phillips spectrum is advanced in time and transformed with a GPU Stockham
+ * FFT into displacement and slope textures once per frame, the vertex shader
+ * does a single texture fetch however many waves the spectrum holds.
+ *
  * Ref:
  * https://github.com/artemhlezin/webgpu-gerstner-waves
  * https://en.wikipedia.org/wiki/Trochoidal_wave
  * https://www.reddit.com/r/webgpu/comments/s2elkb/webgpu_gerstner_waves_implementation
+ * https://people.computing.clemson.edu/~jtessen/reports/papers_files/coursenotes2004.pdf
  * -------------------------------------------------------------------------- */
 
 /* -------------------------------------------------------------------------- *
@@ -234,6 +243,293 @@ static struct {
 static const char* example_title = "Gerstner Waves";
 static bool prepared             = false;
 
+/* -------------------------------------------------------------------------- *
+ * Spectral ocean
+ *
+ * Instead of a handful of waves summed per vertex, the spectral mode draws the
+ * amplitudes of all the waves of a grid of wave vectors from a Phillips
+ * spectrum, advances their phases with the deep water dispersion relation and
+ * transforms them to heights, horizontal displacements and slopes with an
+ * inverse FFT once per frame. The vertex shader fetches the displacement from
+ * a texture, so that the cost does not depend on the number of waves.
+ * -------------------------------------------------------------------------- */
+
+// FFT grid size and number of waves along each side of the ocean patch
+#define OCEAN_FFT_SIZE 256u
+#define OCEAN_GRAVITY 9.81f
+
+typedef enum wave_mode_enum {
+  WaveMode_Gerstner = 0,
+  WaveMode_Spectral = 1,
+} wave_mode_enum;
+
+static int32_t wave_mode        = WaveMode_Gerstner;
+static const char* wave_modes[] = {"Gerstner", "Spectral (FFT)"};
+
+// Ocean parameters uniform, shared by the compute and the render shaders
+static struct {
+  uint32_t size;
+  uint32_t seed;
+  float patch_length;
+  float time;
+  float wind[2];
+  float amplitude;
+  float choppiness;
+} ocean_params = {
+  .size = OCEAN_FFT_SIZE,
+  .seed = 1337u,
+};
+
+typedef enum ocean_kernel_enum {
+  OceanKernel_InitialSpectrum = 0,
+  OceanKernel_TimeSpectrum    = 1,
+  OceanKernel_Resolve         = 2,
+  OceanKernel_Count           = 3,
+} ocean_kernel_enum;
+
+static const char* ocean_kernel_entries[OceanKernel_Count] = {
+  "cs_initial_spectrum", // OceanKernel_InitialSpectrum
+  "cs_time_spectrum",    // OceanKernel_TimeSpectrum
+  "cs_resolve",          // OceanKernel_Resolve
+};
+
+static struct {
+  // Sea state
+  float wave_height;    // Significant wave height, in meters
+  float wind_speed;     // Meters per second
+  float wind_direction; // Degrees
+  float choppiness;
+  bool spectrum_dirty;
+  // Height + i * x displacement, z displacement + i * x slope and z slope
+  wgpu_fft_t* fft;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t initial_spectrum;
+  struct {
+    WGPUTexture texture;
+    WGPUTextureView view;
+  } displacement, slopes;
+  WGPUSampler sampler;
+  struct {
+    WGPUComputePipeline pipeline;
+    WGPUBindGroup bind_group;
+  } kernels[OceanKernel_Count];
+  WGPURenderPipeline render_pipeline;
+  WGPUBindGroup render_bind_groups[2];
+} ocean = {
+  .wave_height    = 0.5f,
+  .wind_speed     = 3.0f,
+  .wind_direction = 30.0f,
+  .choppiness     = 0.8f,
+  .spectrum_dirty = true,
+};
+
+// clang-format off
+static const char* ocean_compute_shader_wgsl = CODE(
+  struct OceanParams {
+    size : u32,
+    seed : u32,
+    patchLength : f32,
+    time : f32,
+    wind : vec2<f32>,
+    amplitude : f32,
+    choppiness : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : OceanParams;
+  @group(0) @binding(1) var<storage, read_write> initialSpectrum :
+    array<vec2<f32>>;
+  @group(0) @binding(2) var<storage, read_write> spectrum : array<vec2<f32>>;
+  @group(0) @binding(3) var displacementTexture :
+    texture_storage_2d<rgba16float, write>;
+  @group(0) @binding(4) var slopeTexture :
+    texture_storage_2d<rgba16float, write>;
+
+  fn pcgHash(v : u32) -> u32 {
+    let state = v * 747796405u + 2891336453u;
+    let word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+  }
+
+  // Uniform in (0, 1)
+  fn uniformRandom(v : u32) -> f32 {
+    return (f32(pcgHash(v) >> 8u) + 0.5) / 16777216.0;
+  }
+
+  // Two independent standard normal numbers, Box-Muller
+  fn gaussianRandom(v : u32) -> vec2<f32> {
+    let r = sqrt(-2.0 * log(uniformRandom(v)));
+    let theta = 6.28318530718 * uniformRandom(pcgHash(v));
+    return r * vec2<f32>(cos(theta), sin(theta));
+  }
+
+  fn complexMul(a : vec2<f32>, b : vec2<f32>) -> vec2<f32> {
+    return vec2<f32>(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+  }
+
+  fn conjugate(a : vec2<f32>) -> vec2<f32> {
+    return vec2<f32>(a.x, -a.y);
+  }
+
+  // Multiplication by i
+  fn rotate90(a : vec2<f32>) -> vec2<f32> {
+    return vec2<f32>(-a.y, a.x);
+  }
+
+  // Wave vector of a grid element, the upper half of the indices holds the
+  // negative frequencies
+  fn waveVector(id : vec2<u32>) -> vec2<f32> {
+    let n = i32(params.size);
+    let m = vec2<i32>(id);
+    let frequency = select(m, m - vec2<i32>(n), m >= vec2<i32>(n / 2));
+    return 6.28318530718 * vec2<f32>(frequency) / params.patchLength;
+  }
+
+  fn phillips(k : vec2<f32>) -> f32 {
+    let k2 = dot(k, k);
+    if (k2 < 0.000001) {
+      return 0.0;
+    }
+    // Largest wave of the wind speed, waves much smaller than it are damped
+    let l = dot(params.wind, params.wind) / 9.81;
+    let damping = l * 0.001;
+    let alignment = dot(k / sqrt(k2), normalize(params.wind));
+    return params.amplitude * exp(-1.0 / (k2 * l * l)) / (k2 * k2)
+           * alignment * alignment * exp(-k2 * damping * damping);
+  }
+
+  @compute @workgroup_size(16, 16)
+  fn cs_initial_spectrum(@builtin(global_invocation_id) id : vec3<u32>) {
+    let n = params.size;
+    if (any(id.xy >= vec2<u32>(n))) {
+      return;
+    }
+    let index = id.y * n + id.x;
+    // The Nyquist frequencies have no negative counterpart
+    var h0 = vec2<f32>(0.0);
+    if (all(id.xy != vec2<u32>(n / 2u))) {
+      h0 = gaussianRandom(pcgHash(index) ^ params.seed)
+           * sqrt(phillips(waveVector(id.xy)) * 0.5);
+    }
+    initialSpectrum[index] = h0;
+  }
+
+  @compute @workgroup_size(16, 16)
+  fn cs_time_spectrum(@builtin(global_invocation_id) id : vec3<u32>) {
+    let n = params.size;
+    if (any(id.xy >= vec2<u32>(n))) {
+      return;
+    }
+    let index = id.y * n + id.x;
+    let negative = (vec2<u32>(n) - id.xy) % vec2<u32>(n);
+    let k = waveVector(id.xy);
+    let kLength = length(k);
+
+    // Deep water dispersion, the field stays real as h(-k) = conj(h(k))
+    let omega = sqrt(9.81 * kLength);
+    let phase = vec2<f32>(cos(omega * params.time), sin(omega * params.time));
+    let h0 = initialSpectrum[index];
+    let h0Negative = initialSpectrum[negative.y * n + negative.x];
+    let h = complexMul(h0, phase)
+            + complexMul(conjugate(h0Negative), conjugate(phase));
+
+    let direction = select(vec2<f32>(0.0), k / kLength, kLength > 0.000001);
+    let ih = rotate90(h);
+    let dx = -direction.x * ih;
+    let dz = -direction.y * ih;
+    let sx = k.x * ih;
+    let sz = k.y * ih;
+
+    // Two real fields a and b per grid as a + i b
+    spectrum[index] = h + rotate90(dx);
+    spectrum[n * n + index] = dz + rotate90(sx);
+    spectrum[2u * n * n + index] = sz;
+  }
+
+  @compute @workgroup_size(16, 16)
+  fn cs_resolve(@builtin(global_invocation_id) id : vec3<u32>) {
+    let n = params.size;
+    if (any(id.xy >= vec2<u32>(n))) {
+      return;
+    }
+    // The ocean is the sum of the waves, undo the scale of the inverse FFT
+    let index = id.y * n + id.x;
+    let scale = f32(n * n);
+    let a = spectrum[index] * scale;
+    let b = spectrum[n * n + index] * scale;
+    let c = spectrum[2u * n * n + index] * scale;
+    let texel = vec2<i32>(id.xy);
+    textureStore(displacementTexture, texel,
+                 vec4<f32>(params.choppiness * a.y, params.choppiness * b.x,
+                           a.x, 0.0));
+    textureStore(slopeTexture, texel, vec4<f32>(b.y, c.x, 0.0, 0.0));
+  }
+);
+
+static const char* ocean_render_shader_wgsl = CODE(
+  struct Scene {
+    elapsedTime : f32,
+    modelMatrix : mat4x4<f32>,
+    viewProjectionMatrix : mat4x4<f32>,
+    viewPosition : vec3<f32>,
+  };
+
+  struct OceanParams {
+    size : u32,
+    seed : u32,
+    patchLength : f32,
+    time : f32,
+    wind : vec2<f32>,
+    amplitude : f32,
+    choppiness : f32,
+  };
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) worldPosition : vec3<f32>,
+    @location(1) uv : vec2<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> scene : Scene;
+  @group(0) @binding(1) var<uniform> ocean : OceanParams;
+  @group(1) @binding(0) var oceanSampler : sampler;
+  @group(1) @binding(1) var displacementTexture : texture_2d<f32>;
+  @group(1) @binding(2) var slopeTexture : texture_2d<f32>;
+
+  // The plane lies in the xy plane of the model, z is up
+  @vertex
+  fn vertex_main(@location(0) position : vec3<f32>) -> VertexOutput {
+    let uv = position.xy / ocean.patchLength;
+    let displacement
+      = textureSampleLevel(displacementTexture, oceanSampler, uv, 0.0).xyz;
+    let worldPosition = scene.modelMatrix * vec4<f32>(position + displacement,
+                                                      1.0);
+
+    var output : VertexOutput;
+    output.position = scene.viewProjectionMatrix * worldPosition;
+    output.worldPosition = worldPosition.xyz;
+    output.uv = uv;
+    return output;
+  }
+
+  @fragment
+  fn fragment_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let slopes = textureSample(slopeTexture, oceanSampler, input.uv).xy;
+    let normal = normalize((scene.modelMatrix
+                            * vec4<f32>(-slopes.x, -slopes.y, 1.0, 0.0)).xyz);
+    let view = normalize(scene.viewPosition - input.worldPosition);
+    let light = normalize(vec3<f32>(0.3, 1.0, 0.4));
+
+    // Sky reflection over the deep water color, Schlick fresnel
+    let fresnel = 0.02 + 0.98 * pow(1.0 - max(dot(normal, view), 0.0), 5.0);
+    let sky = vec3<f32>(0.65, 0.78, 0.9);
+    let water = vec3<f32>(0.0, 0.12, 0.2)
+                * (0.4 + 0.6 * max(dot(normal, light), 0.0));
+    let specular = pow(max(dot(normal, normalize(light + view)), 0.0), 256.0);
+    return vec4<f32>(mix(water, sky, fresnel) + vec3<f32>(specular), 1.0);
+  }
+);
+// clang-format on
+
 static void prepare_example(wgpu_example_context_t* context)
 {
   start_time = context->run_time;
@@ -517,6 +813,316 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   // Partial cleanup
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+
+  // Spectral ocean vertex state
+  WGPUVertexState ocean_vertex_state = wgpu_create_vertex_state(
+             wgpu_context, &(wgpu_vertex_state_t){
+             .shader_desc = (wgpu_shader_desc_t){
+                // Vertex shader WGSL
+                .label            = "Ocean render shader",
+                .wgsl_code.source = ocean_render_shader_wgsl,
+                .entry            = "vertex_main",
+             },
+             .buffer_count = 1,
+             .buffers      = &plane_vertex_buffer_layout,
+           });
+
+  // Spectral ocean fragment state
+  WGPUFragmentState ocean_fragment_state = wgpu_create_fragment_state(
+             wgpu_context, &(wgpu_fragment_state_t){
+             .shader_desc = (wgpu_shader_desc_t){
+                // Fragment shader WGSL
+                .label            = "Ocean render shader",
+                .wgsl_code.source = ocean_render_shader_wgsl,
+                .entry            = "fragment_main",
+             },
+             .target_count = 1,
+             .targets      = &color_target_state,
+           });
+
+  // The layout is derived from the bindings of the shader
+  ocean.render_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label        = "ocean_render_pipeline",
+                            .primitive    = primitive_state,
+                            .vertex       = ocean_vertex_state,
+                            .fragment     = &ocean_fragment_state,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(ocean.render_pipeline != NULL);
+
+  WGPU_RELEASE_RESOURCE(ShaderModule, ocean_vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, ocean_fragment_state.module);
+}
+
+// Bindings of the compute shader used by every kernel, the pipeline layouts
+// only hold these
+static const struct {
+  uint32_t count;
+  uint32_t bindings[5];
+} ocean_kernel_bindings[OceanKernel_Count] = {
+  {2, {0, 1}},       // OceanKernel_InitialSpectrum
+  {3, {0, 1, 2}},    // OceanKernel_TimeSpectrum
+  {4, {0, 2, 3, 4}}, // OceanKernel_Resolve
+};
+
+static void update_ocean_params(wgpu_context_t* wgpu_context)
+{
+  // Phillips amplitude of the significant wave height, four times the
+  // standard deviation of the surface, from the integral of the spectrum
+  const float l       = ocean.wind_speed * ocean.wind_speed / OCEAN_GRAVITY;
+  const float sigma   = ocean.wave_height / 4.0f;
+  const float density = ocean_params.patch_length / (2.0f * PI);
+
+  ocean_params.amplitude = sigma * sigma / (density * density * PI * l * l);
+
+  const float wind_direction = glm_rad(ocean.wind_direction);
+  ocean_params.wind[0]       = ocean.wind_speed * cosf(wind_direction);
+  ocean_params.wind[1]       = ocean.wind_speed * sinf(wind_direction);
+  ocean_params.choppiness    = ocean.choppiness;
+  ocean_params.time          = scene_data.elapsed_time;
+
+  wgpu_queue_write_buffer(wgpu_context, ocean.params_buffer.buffer, 0,
+                          &ocean_params, sizeof(ocean_params));
+}
+
+static void prepare_ocean_texture(wgpu_context_t* wgpu_context,
+                                  const char* label, WGPUTexture* texture,
+                                  WGPUTextureView* view)
+{
+  *texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label = label,
+      .usage = WGPUTextureUsage_StorageBinding
+               | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){OCEAN_FFT_SIZE, OCEAN_FFT_SIZE, 1},
+      .format        = WGPUTextureFormat_RGBA16Float,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(*texture != NULL);
+  *view = wgpuTextureCreateView(*texture, NULL);
+  ASSERT(*view != NULL);
+}
+
+// Spectrum, FFT and the compute kernels of the spectral mode, after the
+// render pipelines
+static void prepare_ocean(wgpu_context_t* wgpu_context)
+{
+  // One ocean patch covers the plane
+  ocean_params.patch_length = plane_mesh.width;
+
+  ocean.fft = wgpu_fft_create(wgpu_context, &(wgpu_fft_desc_t){
+                                              .size        = OCEAN_FFT_SIZE,
+                                              .batch_count = 3,
+                                            });
+  ASSERT(ocean.fft != NULL);
+
+  ocean.params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Ocean parameters buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(ocean_params),
+                  });
+  ocean.initial_spectrum = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "Ocean initial spectrum buffer",
+      .usage = WGPUBufferUsage_Storage,
+      .size  = OCEAN_FFT_SIZE * OCEAN_FFT_SIZE * 2 * sizeof(float),
+    });
+  update_ocean_params(wgpu_context);
+
+  prepare_ocean_texture(wgpu_context, "Ocean displacement texture",
+                        &ocean.displacement.texture, &ocean.displacement.view);
+  prepare_ocean_texture(wgpu_context, "Ocean slope texture",
+                        &ocean.slopes.texture, &ocean.slopes.view);
+
+  // The patch repeats
+  ocean.sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "Ocean sampler",
+                            .addressModeU  = WGPUAddressMode_Repeat,
+                            .addressModeV  = WGPUAddressMode_Repeat,
+                            .addressModeW  = WGPUAddressMode_Repeat,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(ocean.sampler != NULL);
+
+  // Compute kernels, the layouts are derived from the bindings they use
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "Ocean compute shader",
+                    .wgsl_code.source = ocean_compute_shader_wgsl,
+                    .entry            = "cs_time_spectrum",
+                  });
+  const WGPUBindGroupEntry bg_entries[5] = {
+    [0] = (WGPUBindGroupEntry) {
+      // Binding 0: Ocean parameters
+      .binding = 0,
+      .buffer  = ocean.params_buffer.buffer,
+      .size    = ocean.params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      // Binding 1: Initial spectrum
+      .binding = 1,
+      .buffer  = ocean.initial_spectrum.buffer,
+      .size    = ocean.initial_spectrum.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      // Binding 2: Spectrum, transformed in place by the FFT
+      .binding = 2,
+      .buffer  = wgpu_fft_get_buffer(ocean.fft),
+      .size    = WGPU_WHOLE_SIZE,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      // Binding 3: Displacement texture
+      .binding     = 3,
+      .textureView = ocean.displacement.view,
+    },
+    [4] = (WGPUBindGroupEntry) {
+      // Binding 4: Slope texture
+      .binding     = 4,
+      .textureView = ocean.slopes.view,
+    },
+  };
+  for (uint32_t i = 0; i < (uint32_t)OceanKernel_Count; ++i) {
+    WGPUProgrammableStageDescriptor stage
+      = comp_shader.programmable_stage_descriptor;
+    stage.entryPoint = ocean_kernel_entries[i];
+    ocean.kernels[i].pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                              .label   = ocean_kernel_entries[i],
+                              .compute = stage,
+                            });
+    ASSERT(ocean.kernels[i].pipeline != NULL);
+
+    WGPUBindGroupEntry kernel_entries[5] = {0};
+    for (uint32_t b = 0; b < ocean_kernel_bindings[i].count; ++b) {
+      kernel_entries[b] = bg_entries[ocean_kernel_bindings[i].bindings[b]];
+    }
+    WGPUBindGroupLayout bind_group_layout
+      = wgpuComputePipelineGetBindGroupLayout(ocean.kernels[i].pipeline, 0);
+    ocean.kernels[i].bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label      = ocean_kernel_entries[i],
+                              .layout     = bind_group_layout,
+                              .entryCount = ocean_kernel_bindings[i].count,
+                              .entries    = kernel_entries,
+                            });
+    ASSERT(ocean.kernels[i].bind_group != NULL);
+    WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+  }
+  wgpu_shader_release(&comp_shader);
+
+  // Render bind groups
+  {
+    WGPUBindGroupEntry uniform_entries[2] = {
+      [0] = (WGPUBindGroupEntry) {
+        // Binding 0: Uniforms
+        .binding = 0,
+        .buffer  = uniform_buffers.scene.buffer,
+        .size    = uniform_buffers.scene.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        // Binding 1: Ocean parameters
+        .binding = 1,
+        .buffer  = ocean.params_buffer.buffer,
+        .size    = ocean.params_buffer.size,
+      },
+    };
+    WGPUBindGroupEntry texture_entries[3] = {
+      [0] = (WGPUBindGroupEntry) {
+        // Binding 0: Sampler
+        .binding = 0,
+        .sampler = ocean.sampler,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        // Binding 1: Displacement texture
+        .binding     = 1,
+        .textureView = ocean.displacement.view,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        // Binding 2: Slope texture
+        .binding     = 2,
+        .textureView = ocean.slopes.view,
+      },
+    };
+    const WGPUBindGroupEntry* entries[2] = {uniform_entries, texture_entries};
+    const uint32_t entry_counts[2]       = {
+      (uint32_t)ARRAY_SIZE(uniform_entries),
+      (uint32_t)ARRAY_SIZE(texture_entries),
+    };
+    for (uint32_t i = 0; i < 2; ++i) {
+      WGPUBindGroupLayout bind_group_layout
+        = wgpuRenderPipelineGetBindGroupLayout(ocean.render_pipeline, i);
+      ocean.render_bind_groups[i] = wgpuDeviceCreateBindGroup(
+        wgpu_context->device, &(WGPUBindGroupDescriptor){
+                                .label      = "Ocean render bind group",
+                                .layout     = bind_group_layout,
+                                .entryCount = entry_counts[i],
+                                .entries    = entries[i],
+                              });
+      ASSERT(ocean.render_bind_groups[i] != NULL);
+      WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+    }
+  }
+}
+
+static void ocean_dispatch(WGPUComputePassEncoder pass,
+                           ocean_kernel_enum kernel)
+{
+  const uint32_t workgroup_count = (OCEAN_FFT_SIZE + 15) / 16;
+  wgpuComputePassEncoderSetPipeline(pass, ocean.kernels[kernel].pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass, 0, ocean.kernels[kernel].bind_group,
+                                     0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass, workgroup_count,
+                                           workgroup_count, 1);
+}
+
+// Spectrum at the current time to displacements and slopes
+static void record_ocean_compute_pass(wgpu_context_t* wgpu_context)
+{
+  WGPUComputePassEncoder pass
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  if (ocean.spectrum_dirty) {
+    ocean_dispatch(pass, OceanKernel_InitialSpectrum);
+    ocean.spectrum_dirty = false;
+  }
+  ocean_dispatch(pass, OceanKernel_TimeSpectrum);
+  wgpu_fft_record(ocean.fft, pass, true);
+  ocean_dispatch(pass, OceanKernel_Resolve);
+  wgpuComputePassEncoderEnd(pass);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass)
+}
+
+static void release_ocean(void)
+{
+  for (uint32_t i = 0; i < (uint32_t)OceanKernel_Count; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, ocean.kernels[i].bind_group)
+    WGPU_RELEASE_RESOURCE(ComputePipeline, ocean.kernels[i].pipeline)
+  }
+  WGPU_RELEASE_RESOURCE(BindGroup, ocean.render_bind_groups[0])
+  WGPU_RELEASE_RESOURCE(BindGroup, ocean.render_bind_groups[1])
+  WGPU_RELEASE_RESOURCE(RenderPipeline, ocean.render_pipeline)
+  WGPU_RELEASE_RESOURCE(Sampler, ocean.sampler)
+  WGPU_RELEASE_RESOURCE(TextureView, ocean.displacement.view)
+  WGPU_RELEASE_RESOURCE(Texture, ocean.displacement.texture)
+  WGPU_RELEASE_RESOURCE(TextureView, ocean.slopes.view)
+  WGPU_RELEASE_RESOURCE(Texture, ocean.slopes.texture)
+  WGPU_RELEASE_RESOURCE(Buffer, ocean.params_buffer.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, ocean.initial_spectrum.buffer)
+  wgpu_fft_release(ocean.fft);
+  ocean.fft = NULL;
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -693,6 +1299,7 @@ static int example_initialize(wgpu_example_context_t* context)
     setup_pipeline_layout(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
+    prepare_ocean(context->wgpu_context);
     create_multisampled_framebuffer(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
@@ -702,6 +1309,28 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_combo_box(context->imgui_overlay, "Waves", &wave_mode,
+                            wave_modes, (uint32_t)ARRAY_SIZE(wave_modes));
+    if (wave_mode == WaveMode_Spectral) {
+      bool changed = false;
+      changed |= imgui_overlay_slider_float(
+        context->imgui_overlay, "Wave height", &ocean.wave_height, 0.05f, 2.0f);
+      changed |= imgui_overlay_slider_float(
+        context->imgui_overlay, "Wind speed", &ocean.wind_speed, 0.5f, 10.0f);
+      changed |= imgui_overlay_slider_float(context->imgui_overlay,
+                                            "Wind direction",
+                                            &ocean.wind_direction, 0.0f,
+                                            360.0f);
+      imgui_overlay_slider_float(context->imgui_overlay, "Choppiness",
+                                 &ocean.choppiness, 0.0f, 2.0f);
+      ocean.spectrum_dirty |= changed;
+    }
+  }
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   // Set target frame buffer
@@ -721,21 +1350,30 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Ocean displacement of the frame
+  if (wave_mode == WaveMode_Spectral) {
+    record_ocean_compute_pass(wgpu_context);
+  }
+
   // Create render pass
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass.descriptor);
 
   // Record record render pass
-  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
+  const bool spectral = wave_mode == WaveMode_Spectral;
+  wgpuRenderPassEncoderSetPipeline(
+    wgpu_context->rpass_enc, spectral ? ocean.render_pipeline : pipeline);
   wgpuRenderPassEncoderSetVertexBuffer(wgpu_context->rpass_enc, 0,
                                        vertices.buffer, 0, WGPU_WHOLE_SIZE);
   wgpuRenderPassEncoderSetIndexBuffer(wgpu_context->rpass_enc, indices.buffer,
                                       WGPUIndexFormat_Uint32, 0,
                                       WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                    bind_groups.uniforms, 0, 0);
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 1,
-                                    bind_groups.textures, 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(
+    wgpu_context->rpass_enc, 0,
+    spectral ? ocean.render_bind_groups[0] : bind_groups.uniforms, 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(
+    wgpu_context->rpass_enc, 1,
+    spectral ? ocean.render_bind_groups[1] : bind_groups.textures, 0, 0);
   wgpuRenderPassEncoderDrawIndexed(wgpu_context->rpass_enc, indices.count, 1, 0,
                                    0, 0);
 
@@ -743,6 +1381,9 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
   WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
 
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
+
   // Get command buffer
   WGPUCommandBuffer command_buffer
     = wgpu_get_command_buffer(wgpu_context->cmd_enc);
@@ -776,6 +1417,9 @@ static int example_render(wgpu_example_context_t* context)
   }
   update_controls(context);
   update_uniform_buffers_scene(context);
+  if (wave_mode == WaveMode_Spectral) {
+    update_ocean_params(context->wgpu_context);
+  }
   return example_draw(context->wgpu_context);
 }
 
@@ -783,6 +1427,7 @@ static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
 
+  release_ocean();
   wgpu_destroy_texture(&sea_color_texture);
   WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, indices.buffer)
@@ -804,8 +1449,9 @@ void example_gerstner_waves(int argc, char* argv[])
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
-      .title = example_title,
-      .vsync = true,
+      .title   = example_title,
+      .overlay = true,
+      .vsync   = true,
     },
     .example_initialize_func = &example_initialize,
     .example_render_func     = &example_render,
@@ -819,6 +819,8 @@ static void setup_camera(wgpu_example_context_t* context)
   camera_set_rotation(context->camera, (vec3){0.0f, -135.0f, 0.0f});
   camera_set_perspective(context->camera, 60.0f,
                          context->window_size.aspect_ratio, 0.1f, 256.0f);
+  // The context uses the reversed-Z depth, without far plane
+  camera_set_projection(context->camera, CameraProjection_ReversedZInfinite);
   camera_set_rotation_speed(context->camera, 0.5f);
 }
 
@@ -1011,8 +1013,8 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   // Depth stencil state
   WGPUDepthStencilState depth_stencil_state
     = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
-      .format              = WGPUTextureFormat_Depth24PlusStencil8,
       .depth_write_enabled = true,
+      .wgpu_context        = wgpu_context,
     });
 
   // Vertex buffer layout
@@ -1182,8 +1184,9 @@ void example_gltf_loading(int argc, char* argv[])
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
-     .title  = example_title,
-     .overlay = true,
+     .title      = example_title,
+     .overlay    = true,
+     .reversed_z = true,
     },
     .example_initialize_func      = &example_initialize,
     .example_render_func          = &example_render,
@@ -3,9 +3,15 @@
 
 #include <string.h>
 
+#include "../webgpu/ambient_occlusion.h"
+#include "../webgpu/depth_prepass.h"
+#include "../webgpu/depth_pyramid.h"
+#include "../webgpu/frame_graph.h"
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
 #include "../webgpu/texture.h"
+#include "../webgpu/voxelizer.h"
+#include "../webgpu/weighted_oit.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - glTF Scene Rendering
@@ -13,7 +19,32 @@
  * Renders a complete scene loaded from an glTF 2.0 file. The sample uses the
  * glTF model loading functions, and adds data structures, functions and shaders
  * required to render a more complex scene using Crytek's Sponza model with
- * per-material pipelines and normal mapping.
+ * per-material pipelines and normal mapping. With the depth pre-pass enabled,
+ * the opaque geometry is first drawn into the depth buffer only, so that the
+ * per-material shading runs at most once per pixel. The ambient occlusion is
+ * computed from the depth buffer at half resolution and multiplied into the
+ * shaded frame. The alpha blended materials are drawn in any order with
+ * weighted blended order-independent transparency and composited over it.
+ *
+ * The primitives of the model are culled on the GPU before they are drawn,
+ * against the frustum and, with the occlusion culling enabled, against a depth
+ * pyramid built from the depth buffer of the previous frame.
+ *
+ * The voxel view voxelizes the scene with a sphere orbiting through it into a
+ * 3D grid, of which only the voxels of the moving sphere are voxelized again
+ * every frame, and ray marches the grid instead of showing the shaded frame.
+ *
+ * With --stress, or any of the --stress-<option>=<n> options, a reproducible
+ * stress scene is added to the model, to measure the glTF path under load:
+ * - every asset of a fixed list is loaded --stress-copies times (default 4),
+ *   each copy with its own buffers, textures and draw list,
+ * - --stress-instances (default 4096) instances are spread over the copies,
+ *   placed procedurally from --stress-seed (default 1) and drawn with one
+ *   instanced draw per primitive,
+ * - --stress-animated percent (default 25) of the instances of every copy
+ *   spin, their matrices are updated and uploaded every frame.
+ * The load time, the CPU update and encode times, the GPU frame time and the
+ * GPU memory are shown in the overlay and recorded as benchmark counters.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/gltfscenerendering/gltfscenerendering.cpp
@@ -53,6 +84,349 @@ static struct {
   WGPUBindGroup ubo_scene;
 } bind_groups = {0};
 
+// Per-material pipelines, with the depth test of the forward pass and the
+// Equal test after the depth pre-pass
+static struct {
+  WGPURenderPipeline* forward;
+  WGPURenderPipeline* early_z;
+  uint32_t count;
+} material_pipelines = {0};
+
+static wgpu_depth_prepass_t* depth_prepass = NULL;
+
+// Screen space ambient occlusion, applied to the shaded frame in a second
+// render pass
+static wgpu_ambient_occlusion_t* ambient_occlusion = NULL;
+static struct {
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDescriptor descriptor;
+} ambient_occlusion_pass = {0};
+
+// Weighted blended order-independent transparency of the alpha blended
+// materials, the passes of the frame graph follow the opaque geometry and the
+// ambient occlusion. Only created when the model has such materials.
+static struct {
+  wgpu_weighted_oit_t* weighted_oit;
+  wgpu_frame_graph_t* graph;
+  wgpu_frame_graph_resource_t color;
+  wgpu_frame_graph_resource_t depth;
+} transparency = {0};
+
+// Voxels of the scene and of a sphere moving through it, ray marched by a
+// full-screen pass
+#define VOXEL_VIEW_RESOLUTION 128u
+#define VOXEL_VIEW_SPHERE_OBJECT 1u
+
+static struct {
+  struct gltf_model_t* sphere;
+  wgpu_voxelizer_t* voxelizer;
+  struct {
+    mat4 inverse_view_projection;
+    vec4 eye;
+  } ubo;
+  wgpu_buffer_t ubo_buffer;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+  WGPUPipelineLayout pipeline_layout;
+  WGPURenderPipeline pipeline;
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDescriptor descriptor;
+  wgpu_voxelizer_stats_t stats;
+} voxel_view = {0};
+
+// GPU culling of the model, the depth pyramid holds the depth of the previous
+// frame, rendered with previous_view_projection
+static struct {
+  wgpu_depth_pyramid_t* depth_pyramid;
+  bool depth_pyramid_valid;
+  mat4 previous_view_projection;
+} gpu_culling = {0};
+
+static struct {
+  bool depth_prepass;
+  bool ambient_occlusion;
+  bool occlusion_culling;
+  bool voxel_view;
+} settings = {
+  .depth_prepass     = true,
+  .ambient_occlusion = true,
+  .occlusion_culling = true,
+};
+
+// Stress scene, see the description at the top
+#define STRESS_ASSET_COUNT 4u
+#define STRESS_MAX_COPY_COUNT 16u
+#define STRESS_MAX_MODEL_COUNT (STRESS_ASSET_COUNT * STRESS_MAX_COPY_COUNT)
+#define STRESS_MAX_INSTANCE_COUNT 65536u
+
+static const char* stress_asset_filenames[STRESS_ASSET_COUNT] = {
+  "models/teapot.gltf",
+  "models/torusknot.gltf",
+  "models/sphere.gltf",
+  "models/venus.gltf",
+};
+
+// Placement of an instance, from which its matrix is built
+typedef struct {
+  vec4 position_scale; /* xyz: position, w: uniform scale */
+  vec4 axis_phase;     /* xyz: rotation axis, w: rotation at time 0 */
+} stress_instance_t;
+
+static struct {
+  bool enabled;
+  bool animate;
+  uint32_t copy_count;
+  uint32_t instance_count;
+  uint32_t animated_percent;
+  uint32_t seed;
+  struct {
+    struct gltf_model_t* model;
+    wgpu_buffer_t instance_buffer; /* mat4 per instance */
+    uint32_t first_instance;
+    uint32_t instance_count;
+    uint32_t animated_count; /* the first instances of the model */
+  } models[STRESS_MAX_MODEL_COUNT];
+  uint32_t model_count;
+  stress_instance_t* instances;
+  mat4* matrices;
+  WGPUPipelineLayout pipeline_layout;
+  WGPURenderPipeline pipeline;
+  WGPUBindGroup ubo_scene; /* bind group 0 of the stress pipeline layout */
+  struct {
+    float load_ms;
+    float update_ms; /* smoothed */
+    float encode_ms; /* smoothed */
+    float gpu_ms;
+    uint64_t memory_bytes;
+  } stats;
+} stress = {
+  .animate          = true,
+  .copy_count       = 4,
+  .instance_count   = 4096,
+  .animated_percent = 25,
+  .seed             = 1,
+};
+
+// clang-format off
+static const char* stress_shader_wgsl = CODE(
+  struct Scene {
+    projection : mat4x4<f32>,
+    view : mat4x4<f32>,
+    lightPos : vec4<f32>,
+    viewPos : vec4<f32>,
+  };
+
+  struct Primitive {
+    model : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> scene : Scene;
+  @group(1) @binding(0) var<uniform> primitive : Primitive;
+
+  struct VertexInput {
+    @builtin(instance_index) instanceIndex : u32,
+    @location(0) position : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) color : vec4<f32>,
+    @location(3) instance0 : vec4<f32>,
+    @location(4) instance1 : vec4<f32>,
+    @location(5) instance2 : vec4<f32>,
+    @location(6) instance3 : vec4<f32>,
+  };
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) worldPos : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) color : vec3<f32>,
+  };
+
+  // Hue of the instance, so that neighbouring instances are told apart
+  fn instanceColor(index : u32) -> vec3<f32> {
+    let hue = fract(f32(index) * 0.618034);
+    let k = fract(vec3<f32>(1.0, 2.0 / 3.0, 1.0 / 3.0) + hue) * 6.0 - 3.0;
+    let rgb = clamp(abs(k) - 1.0, vec3<f32>(0.0), vec3<f32>(1.0));
+    return mix(vec3<f32>(1.0), rgb, vec3<f32>(0.6));
+  }
+
+  @vertex
+  fn vs_main(input : VertexInput) -> VertexOutput {
+    let instance = mat4x4<f32>(input.instance0, input.instance1,
+                               input.instance2, input.instance3);
+    let model = instance * primitive.model;
+    let worldPos = model * vec4<f32>(input.position, 1.0);
+    var output : VertexOutput;
+    output.position = scene.projection * scene.view * worldPos;
+    output.worldPos = worldPos.xyz;
+    output.normal = (model * vec4<f32>(input.normal, 0.0)).xyz;
+    output.color = input.color.rgb * instanceColor(input.instanceIndex);
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let N = normalize(input.normal);
+    let L = normalize(scene.lightPos.xyz - input.worldPos);
+    let diffuse = max(dot(N, L), 0.0) * 0.75 + 0.25;
+    return vec4<f32>(input.color * diffuse, 1.0);
+  }
+);
+
+// Shading of the alpha blended materials, the output functions of the weighted
+// OIT precede the shader
+static const char* transparent_shader_wgsl = CODE(
+  struct UBOScene {
+    projection : mat4x4<f32>,
+    view : mat4x4<f32>,
+    lightPos : vec4<f32>,
+    viewPos : vec4<f32>,
+  };
+
+  struct Primitive {
+    model : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> uboScene : UBOScene;
+  @group(1) @binding(0) var colorMap : texture_2d<f32>;
+  @group(1) @binding(1) var colorSampler : sampler;
+  @group(1) @binding(2) var normalMap : texture_2d<f32>;
+  @group(1) @binding(3) var normalSampler : sampler;
+  @group(2) @binding(0) var<uniform> primitive : Primitive;
+
+  struct VertexInput {
+    @location(0) position : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) color : vec4<f32>,
+    @location(4) tangent : vec4<f32>,
+  };
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) normal : vec3<f32>,
+    @location(1) color : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) viewVec : vec3<f32>,
+    @location(4) lightVec : vec3<f32>,
+    @location(5) tangent : vec4<f32>,
+  };
+
+  @vertex
+  fn vs_main(input : VertexInput) -> VertexOutput {
+    var output : VertexOutput;
+    let pos = primitive.model * vec4<f32>(input.position, 1.0);
+    output.position = uboScene.projection * uboScene.view * pos;
+    output.normal = (primitive.model * vec4<f32>(input.normal, 0.0)).xyz;
+    output.color = input.color.rgb;
+    output.uv = input.uv;
+    output.lightVec = uboScene.lightPos.xyz - pos.xyz;
+    output.viewVec = uboScene.viewPos.xyz - pos.xyz;
+    output.tangent = input.tangent;
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> WeightedOitOutput {
+    let color = textureSample(colorMap, colorSampler, input.uv)
+                * vec4<f32>(input.color, 1.0);
+    let N0 = normalize(input.normal);
+    let T = normalize(input.tangent.xyz);
+    let B = cross(input.normal, input.tangent.xyz) * input.tangent.w;
+    let TBN = mat3x3<f32>(T, B, N0);
+    let N = TBN * normalize(textureSample(normalMap, normalSampler,
+                                          input.uv).xyz * 2.0 - 1.0);
+    let L = normalize(input.lightVec);
+    let V = normalize(input.viewVec);
+    let R = reflect(-L, N);
+    let diffuse = vec3<f32>(max(dot(N, L), 0.1));
+    let specular = vec3<f32>(pow(max(dot(R, V), 0.0), 32.0));
+    return weightedOitOutput(vec4<f32>(diffuse * color.rgb + specular, color.a),
+                             input.position.z);
+  }
+);
+
+static const char* voxel_view_shader_wgsl = CODE(
+  struct View {
+    inverseViewProjection : mat4x4<f32>,
+    eye : vec4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> view : View;
+  @group(1) @binding(0) var<uniform> voxelGrid : VoxelGrid;
+  @group(1) @binding(1) var<storage, read> voxelGridBits : array<u32>;
+  @group(1) @binding(2) var voxelGridTexture : texture_3d<f32>;
+  @group(1) @binding(3) var voxelGridSampler : sampler;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) ndc : vec2<f32>,
+  };
+
+  @vertex
+  fn vs_main(@builtin(vertex_index) vertexIndex : u32) -> VertexOutput {
+    let uv = vec2<f32>(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+    var output : VertexOutput;
+    output.ndc = uv * 2.0 - 1.0;
+    output.position = vec4<f32>(output.ndc, 0.0, 1.0);
+    return output;
+  }
+
+  // Voxel traversal of the ray through the grid, shaded by the axis of the
+  // face it entered the hit voxel through and by its distance
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let farPoint = view.inverseViewProjection * vec4<f32>(input.ndc, 1.0, 1.0);
+    let origin = voxelGridToGrid(view.eye.xyz);
+    let dir = normalize(voxelGridToGrid(farPoint.xyz / farPoint.w) - origin);
+    let invDir = 1.0 / select(dir, vec3<f32>(1e-6), abs(dir) < vec3<f32>(1e-6));
+    let t0 = (vec3<f32>(0.0) - origin) * invDir;
+    let t1 = (vec3<f32>(f32(voxelGrid.resolution)) - origin) * invDir;
+    let tEnter = max(max(max(min(t0.x, t1.x), min(t0.y, t1.y)),
+                         min(t0.z, t1.z)), 0.0);
+    let tExit = min(min(max(t0.x, t1.x), max(t0.y, t1.y)), max(t0.z, t1.z));
+    let background = vec4<f32>(0.1, 0.1, 0.12, 1.0);
+    if (tEnter >= tExit) {
+      return background;
+    }
+    let start = origin + dir * (tEnter + 1e-4);
+    var voxel = vec3<i32>(floor(start));
+    let stepDir = vec3<i32>(sign(dir));
+    let tDelta = abs(invDir);
+    var tMax = (vec3<f32>(voxel) + max(vec3<f32>(stepDir), vec3<f32>(0.0))
+                - origin) * invDir;
+    var axis = 0u;
+    let stepCount = voxelGrid.resolution * 3u;
+    for (var i = 0u; i < stepCount; i = i + 1u) {
+      if (voxelGridIsOccupied(voxel)) {
+        let shades = vec3<f32>(0.8, 1.0, 0.6);
+        let t = min(min(tMax.x, tMax.y), tMax.z);
+        let fade = 1.0 - 0.5 * clamp(t / f32(voxelGrid.resolution), 0.0, 1.0);
+        let tint = fract(vec3<f32>(voxel) / 8.0) * 0.2 + 0.8;
+        return vec4<f32>(tint * shades[axis] * fade, 1.0);
+      }
+      if (tMax.x < tMax.y && tMax.x < tMax.z) {
+        voxel.x = voxel.x + stepDir.x;
+        tMax.x = tMax.x + tDelta.x;
+        axis = 0u;
+      } else if (tMax.y < tMax.z) {
+        voxel.y = voxel.y + stepDir.y;
+        tMax.y = tMax.y + tDelta.y;
+        axis = 1u;
+      } else {
+        voxel.z = voxel.z + stepDir.z;
+        tMax.z = tMax.z + tDelta.z;
+        axis = 2u;
+      }
+      if (any(voxel < vec3<i32>(0))
+          || any(voxel >= vec3<i32>(i32(voxelGrid.resolution)))) {
+        break;
+      }
+    }
+    return background;
+  }
+);
+// clang-format on
+
 static WGPURenderPassColorAttachment rp_color_att_descriptors[1];
 static WGPURenderPassDescriptor render_pass_desc;
 static WGPUPipelineLayout pipeline_layout;
@@ -74,7 +448,15 @@ static void setup_camera(wgpu_example_context_t* context)
 
 static void load_assets(wgpu_context_t* wgpu_context)
 {
-  const uint32_t gltf_loading_flags = WGPU_GLTF_FileLoadingFlags_None;
+  // The position stream feeds the depth pre-pass, the triangles the voxel view.
+  // The material textures of the same size are packed into texture arrays,
+  // the material bind groups use the views of their layers.
+  const uint32_t gltf_loading_flags
+    = WGPU_GLTF_FileLoadingFlags_PositionStream
+      | WGPU_GLTF_FileLoadingFlags_KeepTriangles
+      | WGPU_GLTF_FileLoadingFlags_GpuCulling
+      | WGPU_GLTF_FileLoadingFlags_PackMaterialTextures
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   gltf_model = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/Sponza/glTF/Sponza.gltf",
@@ -212,6 +594,580 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
   }
 }
 
+static void prepare_depth_prepass(wgpu_context_t* wgpu_context)
+{
+  depth_prepass = wgpu_depth_prepass_create(
+    wgpu_context, &(wgpu_depth_prepass_desc_t){
+                    .depth_format = WGPUTextureFormat_Depth24PlusStencil8,
+                    .model_bind_group_layout = bind_group_layouts.ubo_primitive,
+                  });
+}
+
+static void prepare_ambient_occlusion(wgpu_context_t* wgpu_context)
+{
+  ambient_occlusion = wgpu_ambient_occlusion_create(
+    wgpu_context, &(wgpu_ambient_occlusion_desc_t){
+                    .width  = wgpu_context->surface.width,
+                    .height = wgpu_context->surface.height,
+                    .scale  = WGPU_EFFECT_PASS_SCALE_HALF,
+                    .radius = 0.5f,
+                  });
+}
+
+static void prepare_gpu_culling(wgpu_context_t* wgpu_context)
+{
+  gpu_culling.depth_pyramid = wgpu_depth_pyramid_create(
+    wgpu_context, wgpu_context->surface.width, wgpu_context->surface.height);
+  gpu_culling.depth_pyramid_valid = false;
+}
+
+// Frustum and occlusion tests of the primitives, before any pass draws them
+static void dispatch_gpu_culling(wgpu_context_t* wgpu_context)
+{
+  wgpu_gltf_model_culling_options_t culling_options = {
+    .depth_pyramid = settings.occlusion_culling
+                         && gpu_culling.depth_pyramid_valid ?
+                       gpu_culling.depth_pyramid :
+                       NULL,
+  };
+  glm_mat4_mul(ubo_scene.projection, ubo_scene.view,
+               culling_options.view_projection);
+  glm_mat4_copy(gpu_culling.previous_view_projection,
+                culling_options.previous_view_projection);
+
+  WGPUComputePassEncoder cull_pass
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  wgpu_gltf_model_dispatch_culling(gltf_model, cull_pass, &culling_options);
+  wgpuComputePassEncoderEnd(cull_pass);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, cull_pass)
+}
+
+// Reduction of the depth buffer of this frame, tested against by the next one
+static void build_depth_pyramid(wgpu_context_t* wgpu_context)
+{
+  WGPUComputePassEncoder pyramid_pass
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  wgpu_depth_pyramid_build(gpu_culling.depth_pyramid, pyramid_pass,
+                           wgpu_context->depth_stencil.depth_view);
+  wgpuComputePassEncoderEnd(pyramid_pass);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pyramid_pass)
+  glm_mat4_mul(ubo_scene.projection, ubo_scene.view,
+               gpu_culling.previous_view_projection);
+  gpu_culling.depth_pyramid_valid = true;
+}
+
+// Draws the alpha blended materials into the accumulation pass
+static void draw_transparent_nodes(WGPURenderPassEncoder pass_encoder,
+                                   void* user_data)
+{
+  UNUSED_VAR(user_data);
+
+  wgpuRenderPassEncoderSetBindGroup(pass_encoder, 0, bind_groups.ubo_scene, 0,
+                                    0);
+  wgpu_gltf_model_draw_to_pass(
+    gltf_model, pass_encoder,
+    (wgpu_gltf_model_render_options_t){
+      .render_flags = WGPU_GLTF_RenderFlags_BindImages
+                      | WGPU_GLTF_RenderFlags_RenderAlphaBlendedNodes,
+      .bind_image_set      = 1,
+      .bind_mesh_model_set = 2,
+    });
+}
+
+static void prepare_transparency(wgpu_context_t* wgpu_context)
+{
+  bool has_blended_materials      = false;
+  wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
+  for (uint32_t i = 0; i < materials.material_count; ++i) {
+    has_blended_materials |= materials.materials[i].alpha_mode
+                             == AlphaMode_BLEND;
+  }
+  if (!has_blended_materials) {
+    return;
+  }
+
+  transparency.weighted_oit = wgpu_weighted_oit_create(
+    wgpu_context, &(wgpu_weighted_oit_desc_t){
+                    .color_format = wgpu_context->swap_chain.format,
+                    .depth_format = WGPUTextureFormat_Depth24PlusStencil8,
+                  });
+
+  // The frame buffer and the depth buffer are assigned every frame
+  transparency.graph = wgpu_frame_graph_create(wgpu_context);
+  transparency.color
+    = wgpu_frame_graph_import_texture(transparency.graph, "frame_buffer", NULL);
+  transparency.depth
+    = wgpu_frame_graph_import_texture(transparency.graph, "depth_buffer", NULL);
+  wgpu_weighted_oit_add_passes(transparency.weighted_oit, transparency.graph,
+                               transparency.color, transparency.depth,
+                               draw_transparent_nodes, NULL);
+  wgpu_frame_graph_compile(transparency.graph, wgpu_context->surface.width,
+                           wgpu_context->surface.height);
+}
+
+/* -------------------------------------------------------------------------- *
+ * Stress scene
+ * -------------------------------------------------------------------------- */
+
+// Loads the copies of the assets, each copy on its own
+static void load_stress_models(wgpu_context_t* wgpu_context)
+{
+  const uint64_t start_ns = platform_get_time_ns();
+  stress.model_count      = 0;
+  for (uint32_t c = 0; c < stress.copy_count; ++c) {
+    for (uint32_t a = 0; a < STRESS_ASSET_COUNT; ++a) {
+      struct gltf_model_t* model
+        = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
+          .wgpu_context = wgpu_context,
+          .filename     = stress_asset_filenames[a],
+        });
+      if (model != NULL) {
+        stress.models[stress.model_count++].model = model;
+      }
+    }
+  }
+  stress.stats.load_ms
+    = (float)((double)(platform_get_time_ns() - start_ns) / 1e6);
+}
+
+static void get_stress_instance_matrix(const stress_instance_t* instance,
+                                       float angle, mat4 dest)
+{
+  glm_translate_make(dest, (float*)instance->position_scale);
+  glm_rotate(dest, instance->axis_phase[3] + angle,
+             (float*)instance->axis_phase);
+  glm_scale_uni(dest, instance->position_scale[3]);
+}
+
+// Places the instances inside of the model, the same ones for the same seed
+static void prepare_stress_instances(wgpu_context_t* wgpu_context)
+{
+  if (stress.model_count == 0) {
+    return;
+  }
+  stress.instances = (stress_instance_t*)malloc(stress.instance_count
+                                                * sizeof(stress_instance_t));
+  stress.matrices = (mat4*)malloc(stress.instance_count * sizeof(mat4));
+  srand(stress.seed);
+  for (uint32_t i = 0; i < stress.instance_count; ++i) {
+    stress_instance_t* instance = &stress.instances[i];
+    glm_vec4_copy((vec4){random_float_min_max(-10.0f, 10.0f),
+                         random_float_min_max(0.5f, 6.0f),
+                         random_float_min_max(-4.0f, 4.0f),
+                         random_float_min_max(0.05f, 0.15f)},
+                  instance->position_scale);
+    vec3 axis = {random_float_min_max(-1.0f, 1.0f),
+                 random_float_min_max(0.1f, 1.0f),
+                 random_float_min_max(-1.0f, 1.0f)};
+    glm_vec3_normalize(axis);
+    glm_vec4(axis, random_float_min_max(0.0f, PI2), instance->axis_phase);
+    get_stress_instance_matrix(instance, 0.0f, stress.matrices[i]);
+  }
+
+  // Consecutive ranges of instances per model
+  uint32_t first_instance = 0;
+  for (uint32_t m = 0; m < stress.model_count; ++m) {
+    const uint32_t instance_count
+      = stress.instance_count / stress.model_count
+        + (m < stress.instance_count % stress.model_count ? 1 : 0);
+    stress.models[m].first_instance = first_instance;
+    stress.models[m].instance_count = instance_count;
+    stress.models[m].animated_count
+      = (instance_count * stress.animated_percent + 99) / 100;
+    if (instance_count > 0) {
+      stress.models[m].instance_buffer = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label        = "stress_instance_buffer",
+          .usage        = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+          .size         = instance_count * sizeof(mat4),
+          .initial.data = stress.matrices[first_instance],
+        });
+    }
+    first_instance += instance_count;
+  }
+}
+
+static void prepare_stress_pipeline(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupLayout bind_group_layout_sets[2] = {
+    bind_group_layouts.ubo_scene,     // set 0
+    bind_group_layouts.ubo_primitive, // set 1
+  };
+  stress.pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layout_sets),
+      .bindGroupLayouts     = bind_group_layout_sets,
+    });
+  ASSERT(stress.pipeline_layout != NULL)
+
+  WGPUBlendState blend_state              = wgpu_create_blend_state(false);
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = wgpu_context->swap_chain.format,
+    .blend     = &blend_state,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = WGPUTextureFormat_Depth24PlusStencil8,
+      .depth_write_enabled = true,
+    });
+
+  // Vertex buffer layouts of the model vertices and of the instance matrices
+  WGPU_GLTF_VERTEX_BUFFER_LAYOUT(
+    stress,
+    // Location 0: Position
+    WGPU_GLTF_VERTATTR_DESC(0, WGPU_GLTF_VertexComponent_Position),
+    // Location 1: Vertex normal
+    WGPU_GLTF_VERTATTR_DESC(1, WGPU_GLTF_VertexComponent_Normal),
+    // Location 2: Vertex color
+    WGPU_GLTF_VERTATTR_DESC(2, WGPU_GLTF_VertexComponent_Color));
+  // Location 3..6: Instance matrix
+  WGPU_GLTF_INSTANCE_BUFFER_LAYOUT(stress, 3)
+  WGPUVertexBufferLayout buffers[2] = {
+    [0]                              = stress_vertex_buffer_layout,
+    [WGPU_GLTF_INSTANCE_BUFFER_SLOT] = stress_instance_buffer_layout,
+  };
+
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+            wgpu_context, &(wgpu_vertex_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Vertex shader WGSL
+              .label            = "stress_vertex_shader",
+              .wgsl_code.source = stress_shader_wgsl,
+              .entry            = "vs_main",
+            },
+            .buffer_count = (uint32_t)ARRAY_SIZE(buffers),
+            .buffers      = buffers,
+          });
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+            wgpu_context, &(wgpu_fragment_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Fragment shader WGSL
+              .label            = "stress_fragment_shader",
+              .wgsl_code.source = stress_shader_wgsl,
+              .entry            = "fs_main",
+            },
+            .target_count = 1,
+            .targets      = &color_target_state,
+          });
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  // Both faces are drawn, the assets don't share a winding order
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_None,
+  };
+
+  stress.pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label        = "stress_render_pipeline",
+                            .layout       = stress.pipeline_layout,
+                            .primitive    = primitive_state,
+                            .vertex       = vertex_state,
+                            .fragment     = &fragment_state,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(stress.pipeline != NULL)
+
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+static void prepare_stress_scene(wgpu_context_t* wgpu_context)
+{
+  load_stress_models(wgpu_context);
+  prepare_stress_instances(wgpu_context);
+  prepare_stress_pipeline(wgpu_context);
+  for (uint32_t m = 0; m < stress.model_count; ++m) {
+    wgpu_gltf_model_prepare_nodes_bind_group(stress.models[m].model,
+                                             bind_group_layouts.ubo_primitive);
+  }
+  wgpu_memory_stats_t memory_stats = {0};
+  wgpu_memory_tracker_get_stats(&memory_stats);
+  log_info("Stress scene: %u models, %u instances, loaded in %.1f ms, %.1f MB "
+           "of GPU memory",
+           stress.model_count, stress.instance_count, stress.stats.load_ms,
+           (double)memory_stats.total_bytes / (1024.0 * 1024.0));
+}
+
+// Spins the animated instances at a fixed step per frame, so that every run
+// renders the same frames
+static void update_stress_instances(wgpu_example_context_t* context)
+{
+  if (!stress.animate || stress.instances == NULL) {
+    return;
+  }
+  const uint64_t start_ns = platform_get_time_ns();
+  const float angle       = (float)context->frame.index / 60.0f;
+  for (uint32_t m = 0; m < stress.model_count; ++m) {
+    const uint32_t first = stress.models[m].first_instance;
+    const uint32_t count = stress.models[m].animated_count;
+    if (count == 0) {
+      continue;
+    }
+    for (uint32_t i = first; i < first + count; ++i) {
+      get_stress_instance_matrix(&stress.instances[i], angle,
+                                 stress.matrices[i]);
+    }
+    wgpu_queue_write_buffer(context->wgpu_context,
+                            stress.models[m].instance_buffer.buffer, 0,
+                            stress.matrices[first], count * sizeof(mat4));
+  }
+  const float update_ms
+    = (float)((double)(platform_get_time_ns() - start_ns) / 1e6);
+  stress.stats.update_ms += (update_ms - stress.stats.update_ms) * 0.05f;
+}
+
+// The scene bind group at group 0 is bound by the caller
+static void draw_stress_models(wgpu_context_t* wgpu_context)
+{
+  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, stress.pipeline);
+  for (uint32_t m = 0; m < stress.model_count; ++m) {
+    wgpu_gltf_model_draw_instanced(stress.models[m].model,
+                                   (wgpu_gltf_model_render_options_t){
+                                     .bind_mesh_model_set = 1,
+                                   },
+                                   stress.models[m].instance_buffer.buffer,
+                                   stress.models[m].instance_count);
+  }
+}
+
+static void release_stress_scene(void)
+{
+  for (uint32_t m = 0; m < stress.model_count; ++m) {
+    wgpu_gltf_model_destroy(stress.models[m].model);
+    WGPU_RELEASE_RESOURCE(Buffer, stress.models[m].instance_buffer.buffer)
+  }
+  stress.model_count = 0;
+  free(stress.instances);
+  free(stress.matrices);
+  stress.instances = NULL;
+  stress.matrices  = NULL;
+  WGPU_RELEASE_RESOURCE(RenderPipeline, stress.pipeline)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, stress.pipeline_layout)
+}
+
+// Selects the pipelines of the materials for the current depth test mode, the
+// draw list of the model is sorted again on the next draw
+// Created when the voxel view is first enabled
+static void prepare_voxel_view(wgpu_context_t* wgpu_context)
+{
+  voxel_view.sphere
+    = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
+      .wgpu_context       = wgpu_context,
+      .filename           = "models/sphere.gltf",
+      .file_loading_flags = WGPU_GLTF_FileLoadingFlags_KeepTriangles
+                            | WGPU_GLTF_FileLoadingFlags_UseCache,
+      .scale              = 1.0f,
+    });
+  const wgpu_voxelizer_object_desc_t objects[2] = {
+    {.model = gltf_model, .dynamic = false},
+    [VOXEL_VIEW_SPHERE_OBJECT] = {.model = voxel_view.sphere, .dynamic = true},
+  };
+  voxel_view.voxelizer = wgpu_voxelizer_create(
+    wgpu_context, &(wgpu_voxelizer_desc_t){
+                    .resolution   = VOXEL_VIEW_RESOLUTION,
+                    .objects      = objects,
+                    .object_count = (uint32_t)ARRAY_SIZE(objects),
+                  });
+
+  voxel_view.ubo_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "voxel_view_ubo_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(voxel_view.ubo),
+                  });
+  voxel_view.bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device,
+    &(WGPUBindGroupLayoutDescriptor){
+      .label      = "voxel_view_bgl",
+      .entryCount = 1,
+      .entries    = &(WGPUBindGroupLayoutEntry){
+        // Binding 0: Uniform buffer (Fragment shader) => View
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer     = (WGPUBufferBindingLayout){
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(voxel_view.ubo),
+        },
+      },
+    });
+  ASSERT(voxel_view.bind_group_layout != NULL);
+  voxel_view.bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "voxel_view_bind_group",
+                            .layout     = voxel_view.bind_group_layout,
+                            .entryCount = 1,
+                            .entries    = &(WGPUBindGroupEntry){
+                              .binding = 0,
+                              .buffer  = voxel_view.ubo_buffer.buffer,
+                              .size    = voxel_view.ubo_buffer.size,
+                            },
+                          });
+  ASSERT(voxel_view.bind_group != NULL);
+
+  WGPUBindGroupLayout bind_group_layout_sets[2] = {
+    voxel_view.bind_group_layout,                               // set 0
+    wgpu_voxelizer_get_bind_group_layout(voxel_view.voxelizer), // set 1
+  };
+  voxel_view.pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layout_sets),
+      .bindGroupLayouts     = bind_group_layout_sets,
+    });
+  ASSERT(voxel_view.pipeline_layout != NULL);
+
+  // The query functions of the voxelizer precede the shader
+  const char* functions_wgsl = wgpu_voxelizer_get_wgsl_functions();
+  const size_t wgsl_size
+    = strlen(functions_wgsl) + strlen(voxel_view_shader_wgsl) + 2;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", functions_wgsl, voxel_view_shader_wgsl);
+
+  WGPUBlendState blend_state              = wgpu_create_blend_state(false);
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = wgpu_context->swap_chain.format,
+    .blend     = &blend_state,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+            wgpu_context, &(wgpu_vertex_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Vertex shader WGSL
+              .label            = "voxel_view_vertex_shader",
+              .wgsl_code.source = wgsl,
+              .entry            = "vs_main",
+            },
+            .buffer_count = 0,
+            .buffers      = NULL,
+          });
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+            wgpu_context, &(wgpu_fragment_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Fragment shader WGSL
+              .label            = "voxel_view_fragment_shader",
+              .wgsl_code.source = wgsl,
+              .entry            = "fs_main",
+            },
+            .target_count = 1,
+            .targets      = &color_target_state,
+          });
+  free(wgsl);
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  voxel_view.pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label     = "voxel_view_render_pipeline",
+                            .layout    = voxel_view.pipeline_layout,
+                            .primitive = (WGPUPrimitiveState){
+                              .topology  = WGPUPrimitiveTopology_TriangleList,
+                              .frontFace = WGPUFrontFace_CCW,
+                              .cullMode  = WGPUCullMode_None,
+                            },
+                            .vertex      = vertex_state,
+                            .fragment    = &fragment_state,
+                            .multisample = multisample_state,
+                          });
+  ASSERT(voxel_view.pipeline != NULL);
+
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+
+  // Replaces the shaded frame
+  voxel_view.color_attachments[0] = (WGPURenderPassColorAttachment){
+    .view    = NULL, // Assigned later
+    .loadOp  = WGPULoadOp_Load,
+    .storeOp = WGPUStoreOp_Store,
+  };
+  voxel_view.descriptor = (WGPURenderPassDescriptor){
+    .colorAttachmentCount = 1,
+    .colorAttachments     = voxel_view.color_attachments,
+  };
+}
+
+// Moves the sphere along its orbit through the atrium and updates the camera
+// of the ray marching
+static void update_voxel_view(wgpu_example_context_t* context)
+{
+  const float angle = (float)context->frame.index / 120.0f;
+  mat4 transform    = GLM_MAT4_IDENTITY_INIT;
+  glm_translate(transform,
+                (vec3){4.0f * cosf(angle), 2.0f, 1.5f * sinf(angle)});
+  glm_scale_uni(transform, 0.75f);
+  wgpu_voxelizer_set_transform(voxel_view.voxelizer, VOXEL_VIEW_SPHERE_OBJECT,
+                               transform);
+
+  static uint64_t camera_version = 0;
+  camera_t* camera               = context->camera;
+  if (!camera_changed_since(camera, &camera_version)) {
+    return;
+  }
+  glm_mat4_copy(camera->matrices.inverse_view_projection,
+                voxel_view.ubo.inverse_view_projection);
+  glm_vec4_copy(camera->matrices.inverse_view[3], voxel_view.ubo.eye);
+  wgpu_queue_write_buffer(context->wgpu_context, voxel_view.ubo_buffer.buffer,
+                          0, &voxel_view.ubo, sizeof(voxel_view.ubo));
+}
+
+static void draw_voxel_view(wgpu_context_t* wgpu_context)
+{
+  WGPUComputePassEncoder compute_pass
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  wgpu_voxelizer_update(voxel_view.voxelizer, compute_pass);
+  wgpuComputePassEncoderEnd(compute_pass);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, compute_pass)
+  wgpu_voxelizer_get_stats(voxel_view.voxelizer, &voxel_view.stats);
+
+  voxel_view.color_attachments[0].view = wgpu_context->swap_chain.frame_buffer;
+  WGPURenderPassEncoder render_pass = wgpuCommandEncoderBeginRenderPass(
+    wgpu_context->cmd_enc, &voxel_view.descriptor);
+  wgpuRenderPassEncoderSetPipeline(render_pass, voxel_view.pipeline);
+  wgpuRenderPassEncoderSetBindGroup(render_pass, 0, voxel_view.bind_group, 0,
+                                    0);
+  wgpuRenderPassEncoderSetBindGroup(
+    render_pass, 1, wgpu_voxelizer_get_bind_group(voxel_view.voxelizer), 0, 0);
+  wgpuRenderPassEncoderDraw(render_pass, 3, 1, 0, 0);
+  wgpuRenderPassEncoderEnd(render_pass);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, render_pass)
+}
+
+static void release_voxel_view(void)
+{
+  wgpu_voxelizer_release(voxel_view.voxelizer);
+  if (voxel_view.sphere != NULL) {
+    wgpu_gltf_model_destroy(voxel_view.sphere);
+  }
+  wgpu_destroy_buffer(&voxel_view.ubo_buffer);
+  WGPU_RELEASE_RESOURCE(RenderPipeline, voxel_view.pipeline)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, voxel_view.pipeline_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, voxel_view.bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, voxel_view.bind_group_layout)
+  memset(&voxel_view, 0, sizeof(voxel_view));
+}
+
+static void select_material_pipelines(void)
+{
+  wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
+  for (uint32_t i = 0; i < materials.material_count; ++i) {
+    materials.materials[i].pipeline = settings.depth_prepass ?
+                                        material_pipelines.early_z[i] :
+                                        material_pipelines.forward[i];
+  }
+}
+
 static void setup_bind_groups(wgpu_context_t* wgpu_context)
 {
   // Bind group for scene matrices
@@ -301,8 +1257,11 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
       },
   };
 
-  // Depth attachment
-  wgpu_setup_deph_stencil(wgpu_context, NULL);
+  // Depth attachment, sampled by the ambient occlusion
+  wgpu_setup_deph_stencil(wgpu_context,
+                          &(struct deph_stencil_texture_creation_options_t){
+                            .sampled = true,
+                          });
 
   // Render pass descriptor
   render_pass_desc = (WGPURenderPassDescriptor){
@@ -310,6 +1269,18 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
     .colorAttachments       = rp_color_att_descriptors,
     .depthStencilAttachment = &wgpu_context->depth_stencil.att_desc,
   };
+
+  // Ambient occlusion pass, keeps the shaded frame
+  ambient_occlusion_pass.color_attachments[0]
+    = (WGPURenderPassColorAttachment){
+      .view    = NULL, // Assigned later
+      .loadOp  = WGPULoadOp_Load,
+      .storeOp = WGPUStoreOp_Store,
+    };
+  ambient_occlusion_pass.descriptor = (WGPURenderPassDescriptor){
+    .colorAttachmentCount = 1,
+    .colorAttachments     = ambient_occlusion_pass.color_attachments,
+  };
 }
 
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
@@ -390,34 +1361,126 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     .multisample  = multisample_state,
   };
 
+  // The opaque materials only shade the fragments that passed the depth
+  // pre-pass, alpha masked and blended materials are not part of it
+  WGPUDepthStencilState early_z_depth_stencil_state
+    = wgpu_depth_prepass_get_shading_depth_stencil_state(depth_prepass);
+
+  // The alpha blended materials write the targets of the weighted OIT and
+  // only test the depth
+  WGPURenderPipelineDescriptor transparent_pipeline_descriptor
+    = render_pipeline_descriptor;
+  WGPUColorTargetState transparent_color_target_states[2] = {0};
+  WGPUDepthStencilState transparent_depth_stencil_state   = {0};
+  WGPUVertexState transparent_vertex_state                = {0};
+  WGPUFragmentState transparent_fragment_state            = {0};
+  if (transparency.weighted_oit != NULL) {
+    const char* functions_wgsl = wgpu_weighted_oit_get_wgsl_functions();
+    const size_t wgsl_size
+      = strlen(functions_wgsl) + strlen(transparent_shader_wgsl) + 2;
+    char* wgsl = malloc(wgsl_size);
+    snprintf(wgsl, wgsl_size, "%s\n%s", functions_wgsl,
+             transparent_shader_wgsl);
+    wgpu_weighted_oit_get_color_targets(transparency.weighted_oit,
+                                        transparent_color_target_states);
+    transparent_depth_stencil_state
+      = wgpu_weighted_oit_get_depth_stencil_state(transparency.weighted_oit);
+    transparent_vertex_state = wgpu_create_vertex_state(
+            wgpu_context, &(wgpu_vertex_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Vertex shader WGSL
+              .label            = "gltf_scene_transparent_vertex_shader",
+              .wgsl_code.source = wgsl,
+              .entry            = "vs_main",
+            },
+            .buffer_count = 1,
+            .buffers      = &gltf_scene_vertex_buffer_layout,
+          });
+    transparent_fragment_state = wgpu_create_fragment_state(
+            wgpu_context, &(wgpu_fragment_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Fragment shader WGSL
+              .label            = "gltf_scene_transparent_fragment_shader",
+              .wgsl_code.source = wgsl,
+              .entry            = "fs_main",
+            },
+            .target_count = (uint32_t)ARRAY_SIZE(
+              transparent_color_target_states),
+            .targets = transparent_color_target_states,
+          });
+    free(wgsl);
+    transparent_pipeline_descriptor.label
+      = "gltf_scene_transparent_render_pipeline";
+    transparent_pipeline_descriptor.vertex       = transparent_vertex_state;
+    transparent_pipeline_descriptor.fragment     = &transparent_fragment_state;
+    transparent_pipeline_descriptor.depthStencil
+      = &transparent_depth_stencil_state;
+  }
+
   // Instead of using a few fixed pipelines, we create one pipeline for each
   // material using the properties of that material
   wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
+  material_pipelines.count = materials.material_count;
+  material_pipelines.forward
+    = (WGPURenderPipeline*)calloc(materials.material_count,
+                                  sizeof(WGPURenderPipeline));
+  material_pipelines.early_z
+    = (WGPURenderPipeline*)calloc(materials.material_count,
+                                  sizeof(WGPURenderPipeline));
   for (uint32_t i = 0; i < materials.material_count; ++i) {
     wgpu_gltf_material_t* material = &materials.materials[i];
     // For double sided materials, culling will be disabled
-    WGPUPrimitiveState* primitive_desc = &render_pipeline_descriptor.primitive;
-    primitive_desc->cullMode
+    const WGPUCullMode cull_mode
       = material->double_sided ? WGPUCullMode_None : WGPUCullMode_Back;
-    material->pipeline = wgpuDeviceCreateRenderPipeline(
+    if (material->alpha_mode == AlphaMode_BLEND
+        && transparency.weighted_oit != NULL) {
+      transparent_pipeline_descriptor.primitive.cullMode = cull_mode;
+      material_pipelines.forward[i] = wgpuDeviceCreateRenderPipeline(
+        wgpu_context->device, &transparent_pipeline_descriptor);
+      ASSERT(material_pipelines.forward[i] != NULL)
+      material_pipelines.early_z[i] = material_pipelines.forward[i];
+      continue;
+    }
+    render_pipeline_descriptor.primitive.cullMode = cull_mode;
+    render_pipeline_descriptor.depthStencil       = &depth_stencil_state;
+    material_pipelines.forward[i] = wgpuDeviceCreateRenderPipeline(
       wgpu_context->device, &render_pipeline_descriptor);
-    ASSERT(material->pipeline != NULL)
+    ASSERT(material_pipelines.forward[i] != NULL)
+    if (material->alpha_mode == AlphaMode_OPAQUE) {
+      render_pipeline_descriptor.depthStencil = &early_z_depth_stencil_state;
+      material_pipelines.early_z[i] = wgpuDeviceCreateRenderPipeline(
+        wgpu_context->device, &render_pipeline_descriptor);
+      ASSERT(material_pipelines.early_z[i] != NULL)
+    }
+    else {
+      material_pipelines.early_z[i] = material_pipelines.forward[i];
+    }
   }
+  select_material_pipelines();
 
   // Shader modules are no longer needed once the graphics pipeline has been
   // created
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, transparent_vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, transparent_fragment_state.module);
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
-  camera_t* camera = context->camera;
+  // Only upload the matrices if the camera moved or the projection changed
+  static uint64_t camera_version = 0;
+  camera_t* camera               = context->camera;
+  if (!camera_changed_since(camera, &camera_version)) {
+    return;
+  }
   glm_mat4_copy(camera->matrices.perspective, ubo_scene.projection);
   glm_mat4_copy(camera->matrices.view, ubo_scene.view);
   glm_vec4_copy(camera->view_pos, ubo_scene.view_pos);
   wgpu_queue_write_buffer(context->wgpu_context, ubo_buffers.ubo_scene.buffer,
                           0, &ubo_scene, ubo_buffers.ubo_scene.size);
+  wgpu_depth_prepass_update(depth_prepass, ubo_scene.projection,
+                            ubo_scene.view);
 }
 
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
@@ -457,11 +1520,18 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
-    prepare_uniform_buffers(context);
     setup_pipeline_layout(context->wgpu_context);
+    prepare_depth_prepass(context->wgpu_context);
+    prepare_ambient_occlusion(context->wgpu_context);
+    prepare_gpu_culling(context->wgpu_context);
+    prepare_transparency(context->wgpu_context);
+    prepare_uniform_buffers(context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
+    if (stress.enabled) {
+      prepare_stress_scene(context->wgpu_context);
+    }
     prepared = true;
     return 0;
   }
@@ -469,6 +1539,53 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Depth pre-pass",
+                               &settings.depth_prepass)) {
+      select_material_pipelines();
+    }
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Ambient occlusion",
+                               &settings.ambient_occlusion)) {
+      // The history is outdated after frames without the occlusion
+      wgpu_ambient_occlusion_reset(ambient_occlusion);
+    }
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Occlusion culling",
+                               &settings.occlusion_culling)) {
+      // The pyramid is not built while the occlusion culling is disabled
+      gpu_culling.depth_pyramid_valid = false;
+    }
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Voxel view",
+                               &settings.voxel_view)
+        && voxel_view.voxelizer == NULL) {
+      prepare_voxel_view(context->wgpu_context);
+    }
+  }
+  if (settings.voxel_view && voxel_view.voxelizer != NULL
+      && imgui_overlay_header("Voxels")) {
+    const wgpu_voxelizer_stats_t* stats = &voxel_view.stats;
+    imgui_overlay_text("Grid: %u^3, objects: %u (%u dynamic)",
+                       stats->resolution, stats->object_count,
+                       stats->dynamic_object_count);
+    imgui_overlay_text("Voxelized triangles: %u of %u",
+                       stats->voxelized_triangle_count, stats->triangle_count);
+    imgui_overlay_text("Resolved voxels: %llu",
+                       (unsigned long long)stats->resolved_voxel_count);
+  }
+  if (stress.enabled && imgui_overlay_header("Stress scene")) {
+    imgui_overlay_checkBox(context->imgui_overlay, "Animate", &stress.animate);
+    imgui_overlay_text("Models: %u, instances: %u", stress.model_count,
+                       stress.instance_count);
+    imgui_overlay_text("Load: %.1f ms", stress.stats.load_ms);
+    imgui_overlay_text("CPU update: %.3f ms", stress.stats.update_ms);
+    imgui_overlay_text("CPU encode: %.3f ms", stress.stats.encode_ms);
+    imgui_overlay_text("GPU: %.3f ms", stress.stats.gpu_ms);
+    imgui_overlay_text("GPU memory: %.1f MB",
+                       (double)stress.stats.memory_bytes / (1024.0 * 1024.0));
+  }
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   // Set target frame buffer
@@ -478,14 +1595,14 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Cull the primitives drawn by the passes of the frame
+  dispatch_gpu_culling(wgpu_context);
+
   // Create render pass encoder for encoding drawing commands
-  wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
+  const uint64_t encode_begin_ns = platform_get_time_ns();
+  wgpu_context->rpass_enc        = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass_desc);
 
-  // Set the bind group
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                    bind_groups.ubo_scene, 0, 0);
-
   // Set viewport
   wgpuRenderPassEncoderSetViewport(
     wgpu_context->rpass_enc, 0.0f, 0.0f, (float)wgpu_context->surface.width,
@@ -496,18 +1613,112 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                       wgpu_context->surface.width,
                                       wgpu_context->surface.height);
 
-  // Draw plane
+  // Fill the depth buffer with the opaque geometry
+  wgpu_pipeline_statistics_t* pipeline_statistics
+    = wgpu_context->pipeline_statistics;
+  uint32_t statistics_scope = 0;
+  if (settings.depth_prepass) {
+    statistics_scope = wgpu_pipeline_statistics_begin_render_scope(
+      pipeline_statistics, wgpu_context->rpass_enc, "Depth pre-pass", false);
+    wgpu_depth_prepass_draw_gltf_model(depth_prepass, wgpu_context->rpass_enc,
+                                       gltf_model, NULL);
+    wgpu_pipeline_statistics_end_render_scope(
+      pipeline_statistics, wgpu_context->rpass_enc, statistics_scope);
+  }
+
+  // Set the bind group
+  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
+                                    bind_groups.ubo_scene, 0, 0);
+
+  // Draw plane, the alpha blended materials are left to the transparency
+  // passes when they exist
   static wgpu_gltf_render_flags_enum_t render_flags
     = WGPU_GLTF_RenderFlags_BindImages;
-  wgpu_gltf_model_draw(gltf_model, (wgpu_gltf_model_render_options_t){
-                                     .render_flags        = render_flags,
-                                     .bind_image_set      = 1,
-                                     .bind_mesh_model_set = 2,
-                                   });
+  static const wgpu_gltf_render_flags_enum_t opaque_buckets[2] = {
+    WGPU_GLTF_RenderFlags_RenderOpaqueNodes,
+    WGPU_GLTF_RenderFlags_RenderAlphaMaskedNodes,
+  };
+  const uint32_t bucket_count
+    = transparency.graph != NULL ? (uint32_t)ARRAY_SIZE(opaque_buckets) : 1;
+  statistics_scope = wgpu_pipeline_statistics_begin_render_scope(
+    pipeline_statistics, wgpu_context->rpass_enc, "Shading pass", false);
+  for (uint32_t i = 0; i < bucket_count; ++i) {
+    const uint32_t bucket_flag
+      = transparency.graph != NULL ? opaque_buckets[i] : 0;
+    wgpu_gltf_model_draw(gltf_model, (wgpu_gltf_model_render_options_t){
+                                       .render_flags = render_flags
+                                                       | bucket_flag,
+                                       .bind_image_set      = 1,
+                                       .bind_mesh_model_set = 2,
+                                     });
+  }
+  wgpu_pipeline_statistics_end_render_scope(
+    pipeline_statistics, wgpu_context->rpass_enc, statistics_scope);
+
+  // Draw the instances of the stress scene
+  if (stress.model_count > 0) {
+    statistics_scope = wgpu_pipeline_statistics_begin_render_scope(
+      pipeline_statistics, wgpu_context->rpass_enc, "Stress scene", false);
+    draw_stress_models(wgpu_context);
+    wgpu_pipeline_statistics_end_render_scope(
+      pipeline_statistics, wgpu_context->rpass_enc, statistics_scope);
+  }
 
   // End render pass
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
   WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+  const float encode_ms
+    = (float)((double)(platform_get_time_ns() - encode_begin_ns) / 1e6);
+  stress.stats.encode_ms += (encode_ms - stress.stats.encode_ms) * 0.05f;
+
+  // Depth of the opaque geometry for the occlusion culling of the next frame
+  if (settings.occlusion_culling) {
+    build_depth_pyramid(wgpu_context);
+  }
+
+  // Occlusion of the depth buffer at half resolution, multiplied into the
+  // shaded frame
+  if (settings.ambient_occlusion) {
+    WGPUTextureView depth_view = wgpu_context->depth_stencil.depth_view;
+    WGPUComputePassEncoder ao_compute_pass
+      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    statistics_scope = wgpu_pipeline_statistics_begin_compute_scope(
+      pipeline_statistics, ao_compute_pass, "Ambient occlusion pass");
+    wgpu_ambient_occlusion_compute(ambient_occlusion, ao_compute_pass,
+                                   depth_view);
+    wgpu_pipeline_statistics_end_compute_scope(
+      pipeline_statistics, ao_compute_pass, statistics_scope);
+    wgpuComputePassEncoderEnd(ao_compute_pass);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, ao_compute_pass)
+
+    ambient_occlusion_pass.color_attachments[0].view
+      = wgpu_context->swap_chain.frame_buffer;
+    WGPURenderPassEncoder ao_render_pass = wgpuCommandEncoderBeginRenderPass(
+      wgpu_context->cmd_enc, &ambient_occlusion_pass.descriptor);
+    wgpu_ambient_occlusion_apply(ambient_occlusion, ao_render_pass,
+                                 depth_view);
+    wgpuRenderPassEncoderEnd(ao_render_pass);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, ao_render_pass)
+  }
+
+  // Accumulation of the alpha blended materials, composited over the shaded
+  // frame
+  if (transparency.graph != NULL) {
+    wgpu_frame_graph_set_imported_view(transparency.graph, transparency.color,
+                                       wgpu_context->swap_chain.frame_buffer);
+    wgpu_frame_graph_set_imported_view(
+      transparency.graph, transparency.depth,
+      wgpu_context->depth_stencil.texture_view);
+    wgpu_frame_graph_execute(transparency.graph, wgpu_context->cmd_enc);
+  }
+
+  // Voxelization of the moved objects and ray marching of the grid
+  if (settings.voxel_view && voxel_view.voxelizer != NULL) {
+    draw_voxel_view(wgpu_context);
+  }
+
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
 
   // Get command buffer
   WGPUCommandBuffer command_buffer
@@ -522,6 +1733,15 @@ static int example_draw(wgpu_example_context_t* context)
   // Prepare frame
   prepare_frame(context);
 
+  // The occlusion reprojects its history with the camera of every frame
+  if (settings.ambient_occlusion) {
+    wgpu_ambient_occlusion_update(ambient_occlusion, ubo_scene.projection,
+                                  ubo_scene.view);
+  }
+  if (settings.voxel_view && voxel_view.voxelizer != NULL) {
+    update_voxel_view(context);
+  }
+
   // Command buffer to be submitted to the queue
   wgpu_context_t* wgpu_context                   = context->wgpu_context;
   wgpu_context->submit_info.command_buffer_count = 1;
@@ -537,23 +1757,85 @@ static int example_draw(wgpu_example_context_t* context)
   return 0;
 }
 
+// Statistics of the stress scene, also recorded in benchmark mode
+static void update_stress_stats(wgpu_example_context_t* context)
+{
+  wgpu_memory_stats_t memory_stats = {0};
+  wgpu_memory_tracker_get_stats(&memory_stats);
+  stress.stats.memory_bytes = memory_stats.total_bytes;
+  stress.stats.gpu_ms       = wgpu_gpu_profiler_get_frame_time_ms(
+    context->wgpu_context->gpu_profiler);
+  benchmark_t* benchmark = context->benchmark.instance;
+  if (benchmark != NULL) {
+    benchmark_record_counter(benchmark, "stress.load_ms",
+                             stress.stats.load_ms);
+    benchmark_record_counter(benchmark, "stress.update_ms",
+                             stress.stats.update_ms);
+    benchmark_record_counter(benchmark, "stress.encode_ms",
+                             stress.stats.encode_ms);
+    benchmark_record_counter(benchmark, "stress.instances",
+                             (double)stress.instance_count);
+  }
+}
+
 static int example_render(wgpu_example_context_t* context)
 {
   if (!prepared) {
     return 1;
   }
-  return example_draw(context);
+  update_stress_instances(context);
+  const int draw_result = example_draw(context);
+  if (stress.enabled) {
+    update_stress_stats(context);
+  }
+  return draw_result;
 }
 
 static void example_on_view_changed(wgpu_example_context_t* context)
 {
+  if (context->window_resized) {
+    wgpu_ambient_occlusion_resize(ambient_occlusion,
+                                  context->wgpu_context->surface.width,
+                                  context->wgpu_context->surface.height);
+    // The depth pyramid follows the size of the depth buffer
+    wgpu_depth_pyramid_release(gpu_culling.depth_pyramid);
+    prepare_gpu_culling(context->wgpu_context);
+    if (transparency.graph != NULL) {
+      wgpu_frame_graph_compile(transparency.graph,
+                               context->wgpu_context->surface.width,
+                               context->wgpu_context->surface.height);
+    }
+  }
   update_uniform_buffers(context);
 }
 
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
+
+  // The material pipelines are owned by the example
+  wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
+  for (uint32_t i = 0; i < materials.material_count; ++i) {
+    materials.materials[i].pipeline = NULL;
+  }
+  for (uint32_t i = 0; i < material_pipelines.count; ++i) {
+    if (material_pipelines.early_z[i] != material_pipelines.forward[i]) {
+      WGPU_RELEASE_RESOURCE(RenderPipeline, material_pipelines.early_z[i])
+    }
+    WGPU_RELEASE_RESOURCE(RenderPipeline, material_pipelines.forward[i])
+  }
+  free(material_pipelines.forward);
+  free(material_pipelines.early_z);
   wgpu_gltf_model_destroy(gltf_model);
+  wgpu_depth_prepass_release(depth_prepass);
+  wgpu_ambient_occlusion_release(ambient_occlusion);
+  wgpu_depth_pyramid_release(gpu_culling.depth_pyramid);
+  if (transparency.graph != NULL) {
+    wgpu_frame_graph_release(transparency.graph);
+  }
+  wgpu_weighted_oit_release(transparency.weighted_oit);
+  release_stress_scene();
+  release_voxel_view();
 
   WGPU_RELEASE_RESOURCE(Buffer, ubo_buffers.ubo_scene.buffer)
   for (uint32_t i = 0; i < ubo_buffers.ubo_material_consts.buffer_count; ++i) {
@@ -570,12 +1852,41 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
 }
 
+// --stress enables the stress scene, as does any of its options
+static void parse_stress_arguments(int argc, char* argv[])
+{
+  static const char* options[4] = {"--stress-copies=", "--stress-instances=",
+                                   "--stress-animated=", "--stress-seed="};
+  uint32_t* values[4] = {&stress.copy_count, &stress.instance_count,
+                         &stress.animated_percent, &stress.seed};
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--stress") == 0) {
+      stress.enabled = true;
+      continue;
+    }
+    for (uint32_t o = 0; o < (uint32_t)ARRAY_SIZE(options); ++o) {
+      if (strncmp(argv[i], options[o], strlen(options[o])) == 0) {
+        *values[o]
+          = (uint32_t)strtoul(argv[i] + strlen(options[o]), NULL, 10);
+        stress.enabled = true;
+      }
+    }
+  }
+  stress.copy_count = CLAMP(stress.copy_count, 1u, STRESS_MAX_COPY_COUNT);
+  stress.instance_count
+    = CLAMP(stress.instance_count, 1u, STRESS_MAX_INSTANCE_COUNT);
+  stress.animated_percent = MIN(stress.animated_percent, 100u);
+}
+
 void example_gltf_scene_rendering(int argc, char* argv[])
 {
+  parse_stress_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
-      .title = example_title,
+      .title   = example_title,
+      .overlay = true,
     },
     .example_initialize_func      = &example_initialize,
     .example_render_func          = &example_render,
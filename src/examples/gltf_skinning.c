@@ -1,6 +1,7 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <math.h>
 #include <string.h>
 
 #include "../webgpu/gltf_model.h"
@@ -11,18 +12,114 @@
  * WebGPU Example - glTF Vertex Skinning
  *
  * Shows how to load and display an animated scene from a glTF file using vertex
- * skinning.
+ * skinning. The vertices are skinned in a compute pass before the render pass,
+ * the vertex shader only applies the node and camera matrices. A row of copies
+ * of the model is drawn, their joint matrices share one joint palette. The
+ * animation is either evaluated on the CPU, by one job per copy, or sampled
+ * into the joint matrices by the same compute pass. A cube with morph targets
+ * is drawn at the end of the row, the weights of its targets are set from the
+ * UI and applied by the compute pass before the skinning.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/gltfskinning/gltfskinning.cpp
  * -------------------------------------------------------------------------- */
 
-static struct gltf_model_t* gltf_model;
+// Shaders
+// clang-format off
+static const char* skinned_model_shader_wgsl = CODE(
+  struct UBOScene {
+    projection : mat4x4<f32>,
+    view : mat4x4<f32>,
+    lightPos : vec4<f32>,
+  };
+
+  struct Primitive {
+    model : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> uboScene : UBOScene;
+  @group(1) @binding(0) var<uniform> primitive : Primitive;
+  @group(2) @binding(0) var colorMap : texture_2d<f32>;
+  @group(2) @binding(1) var colorSampler : sampler;
+
+  struct VertexInput {
+    @location(0) position : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) color : vec4<f32>,
+  };
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) normal : vec3<f32>,
+    @location(1) color : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) viewVec : vec3<f32>,
+    @location(4) lightVec : vec3<f32>,
+  };
+
+  // The positions and normals are already skinned by the compute pass
+  @vertex
+  fn vs_main(input : VertexInput) -> VertexOutput {
+    var output : VertexOutput;
+    let modelView = uboScene.view * primitive.model;
+    let pos = modelView * vec4<f32>(input.position, 1.0);
+    output.position = uboScene.projection * pos;
+    output.normal = (modelView * vec4<f32>(input.normal, 0.0)).xyz;
+    output.color = input.color.rgb;
+    output.uv = input.uv;
+    let lightPos = (uboScene.view * vec4<f32>(uboScene.lightPos.xyz, 0.0)).xyz;
+    output.lightVec = lightPos - pos.xyz;
+    output.viewVec = -pos.xyz;
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let color = textureSample(colorMap, colorSampler, input.uv)
+                * vec4<f32>(input.color, 1.0);
+    let N = normalize(input.normal);
+    let L = normalize(input.lightVec);
+    let V = normalize(input.viewVec);
+    let R = reflect(L, N);
+    let diffuse = max(dot(N, L), 0.5) * input.color;
+    let specular = pow(max(dot(R, V), 0.0), 16.0) * vec3<f32>(0.75);
+    return vec4<f32>(diffuse * color.rgb + specular, 1.0);
+  }
+);
+// clang-format on
+
+// Copies of the model, side by side and each at its own animation phase
+#define MODEL_COUNT (4u)
+#define MODEL_SPACING (1.0f)
+
+static struct gltf_model_t* gltf_models[MODEL_COUNT];
+static wgpu_gltf_joint_palette_t* joint_palette;
+
+// Model with morph targets, its first mesh is morphed by the weights of the UI
+#define MORPH_MAX_TARGET_COUNT (8u)
 
 static struct {
+  struct gltf_model_t* model;
+  uint32_t target_count;
+  float weights[MORPH_MAX_TARGET_COUNT];
+  // White texture bound for the materials without base color texture
+  texture_t white_texture;
+} morph = {0};
+
+// Animation state, the time loops over the first animation
+static struct {
+  bool gpu_supported;
+  bool gpu_enabled;
+  float time;
+} animation = {0};
+
+static struct {
+  // Slices of the frame slot uniform buffer written for the current frame, one
+  // per model and the last one for the morph model
   struct {
     WGPUBuffer buffer;
-    uint64_t size;
+    uint64_t offsets[MODEL_COUNT + 1];
   } ubo_scene_matrices;
   struct {
     mat4 projection;
@@ -38,12 +135,14 @@ static struct {
 static struct {
   WGPUBindGroupLayout ubo_scene;
   WGPUBindGroupLayout ubo_primitive;
-  WGPUBindGroupLayout joint_matrices;
   WGPUBindGroupLayout textures;
 } bind_group_layouts;
 
+// Scene matrices bind group per frame slot, rebuilt when the uniform buffer of
+// the slot changes
 static struct bind_group_t {
-  WGPUBindGroup ubo_scene;
+  WGPUBindGroup ubo_scene[WGPU_MAX_FRAMES_IN_FLIGHT];
+  WGPUBuffer ubo_scene_buffers[WGPU_MAX_FRAMES_IN_FLIGHT];
 } bind_groups;
 
 static WGPUPipelineLayout pipeline_layout;
@@ -64,7 +163,7 @@ static void setup_camera(wgpu_example_context_t* context)
   context->camera         = camera_create();
   context->camera->type   = CameraType_LookAt;
   context->camera->flip_y = true;
-  camera_set_position(context->camera, (vec3){0.0f, 0.75f, -2.0f});
+  camera_set_position(context->camera, (vec3){0.0f, 0.75f, -3.5f});
   camera_set_rotation(context->camera, (vec3){0.0f, 0.0f, 0.0f});
   camera_set_perspective(context->camera, 60.0f,
                          context->window_size.aspect_ratio, 0.1f, 256.0f);
@@ -72,12 +171,54 @@ static void setup_camera(wgpu_example_context_t* context)
 
 static void load_assets(wgpu_context_t* wgpu_context)
 {
-  const uint32_t gltf_loading_flags = WGPU_GLTF_FileLoadingFlags_None;
-  gltf_model = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
-    .wgpu_context       = wgpu_context,
-    .filename           = "models/CesiumMan/glTF/CesiumMan.gltf",
-    .file_loading_flags = gltf_loading_flags,
-  });
+  // The skinned vertices are written to a vertex buffer of the model by
+  // wgpu_gltf_model_dispatch_skinning
+  const uint32_t gltf_loading_flags = WGPU_GLTF_FileLoadingFlags_ComputeSkinning
+                                      | WGPU_GLTF_FileLoadingFlags_UseCache;
+  for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+    gltf_models[i]
+      = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
+        .wgpu_context       = wgpu_context,
+        .filename           = "models/CesiumMan/glTF/CesiumMan.gltf",
+        .file_loading_flags = gltf_loading_flags,
+      });
+  }
+
+  // The copies skin from one joint palette, attached before the GPU animation
+  // is prepared so that it writes the joint matrices into the palette
+  joint_palette
+    = wgpu_gltf_joint_palette_create(wgpu_context, gltf_models, MODEL_COUNT);
+  animation.gpu_supported = true;
+  for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+    animation.gpu_supported
+      &= wgpu_gltf_model_prepare_gpu_animation(gltf_models[i]);
+  }
+  animation.gpu_enabled = animation.gpu_supported;
+
+  // The morph targets are evaluated by the compute skinning pass as well, the
+  // model has no skin and is not animated
+  morph.model
+    = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
+      .wgpu_context = wgpu_context,
+      .filename = "models/AnimatedMorphCube/glTF/AnimatedMorphCube.gltf",
+      .file_loading_flags = gltf_loading_flags,
+    });
+  morph.target_count = MIN(
+    wgpu_gltf_model_get_morph_target_count(morph.model, 0),
+    MORPH_MAX_TARGET_COUNT);
+  wgpu_gltf_model_set_morph_weights(morph.model, 0, morph.weights,
+                                    morph.target_count);
+
+  // The empty texture is black, its pixel is replaced by a white one
+  morph.white_texture   = wgpu_create_empty_texture(wgpu_context);
+  uint8_t white_pixel[4] = {255, 255, 255, 255};
+  wgpu_image_to_texure(wgpu_context, morph.white_texture.texture, white_pixel,
+                       (WGPUExtent3D){
+                         .width              = 1,
+                         .height             = 1,
+                         .depthOrArrayLayers = 1,
+                       },
+                       4);
 }
 
 static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
@@ -95,8 +236,9 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
         .binding = 0,
         .visibility = WGPUShaderStage_Vertex,
         .buffer = (WGPUBufferBindingLayout){
-          .type = WGPUBufferBindingType_Uniform,
-          .minBindingSize = sizeof(shader_data.scene_matrices),
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(shader_data.scene_matrices),
         },
         .sampler = {0},
         },
@@ -133,29 +275,6 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     ASSERT(bind_group_layouts.ubo_primitive != NULL);
   }
 
-  // Bind group layout to pass skin joint matrices to the shader
-  {
-    WGPUBindGroupLayoutEntry bgl_entries[1] = {
-      [0] = (WGPUBindGroupLayoutEntry) {
-        // Binding 0: Uniform buffer (Vertex shader) => JointMatrices
-        .binding = 0,
-        .visibility = WGPUShaderStage_Vertex,
-        .buffer = (WGPUBufferBindingLayout){
-          .type = WGPUBufferBindingType_Storage,
-          .minBindingSize = sizeof(mat4),
-        },
-        .sampler = {0},
-      },
-    };
-    WGPUBindGroupLayoutDescriptor bgl_desc = {
-      .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-      .entries    = bgl_entries,
-    };
-    bind_group_layouts.ubo_scene
-      = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
-    ASSERT(bind_group_layouts.ubo_scene != NULL);
-  }
-
   // Bind group layout for passing material textures
   {
     WGPUBindGroupLayoutEntry bgl_entries[2] = {
@@ -194,13 +313,11 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     // The pipeline layout uses three sets:
     // Set 0 = Scene matrices (VS)
     // Set 1 = Primitive matrices (VS)
-    // Set 2 = Joint matrices (VS)
-    // Set 3 = Material texture (FS)
-    WGPUBindGroupLayout bind_group_layout_sets[4] = {
-      bind_group_layouts.ubo_scene,      // set 0
-      bind_group_layouts.ubo_primitive,  // set 1
-      bind_group_layouts.joint_matrices, // set 2
-      bind_group_layouts.textures,       // set 3
+    // Set 2 = Material texture (FS)
+    WGPUBindGroupLayout bind_group_layout_sets[3] = {
+      bind_group_layouts.ubo_scene,     // set 0
+      bind_group_layouts.ubo_primitive, // set 1
+      bind_group_layouts.textures,      // set 2
     };
     // Pipeline layout
     WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
@@ -213,101 +330,109 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
   }
 }
 
-static void update_uniform_buffers(wgpu_example_context_t* context)
-{
-  // Pass matrices to the shaders
-  camera_t* camera = context->camera;
-  glm_mat4_copy(camera->matrices.perspective,
-                shader_data.scene_matrices.projection);
-  glm_mat4_copy(camera->matrices.view, shader_data.scene_matrices.view);
-
-  // Map uniform buffer and update it
-  wgpu_queue_write_buffer(
-    context->wgpu_context, shader_data.ubo_scene_matrices.buffer, 0,
-    &shader_data.scene_matrices, shader_data.ubo_scene_matrices.size);
-}
-
-static void prepare_uniform_buffers(wgpu_example_context_t* context)
-{
-  // Matrices vertex shader uniform buffer
-  shader_data.ubo_scene_matrices.size   = sizeof(shader_data.scene_matrices);
-  shader_data.ubo_scene_matrices.buffer = wgpuDeviceCreateBuffer(
-    context->wgpu_context->device,
-    &(WGPUBufferDescriptor){
-      .usage            = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-      .size             = shader_data.ubo_scene_matrices.size,
-      .mappedAtCreation = false,
-    });
-
-  // Initialize uniform buffers
-  update_uniform_buffers(context);
-}
-
-static void setup_bind_groups(wgpu_context_t* wgpu_context)
+// Bind group for the scene matrices in the uniform buffer of the frame slot
+static WGPUBindGroup get_scene_bind_group(wgpu_context_t* wgpu_context)
 {
-  // Bind group for scene matrices
-  {
+  const uint32_t slot = wgpu_context->frames.index;
+  if (bind_groups.ubo_scene_buffers[slot]
+      != shader_data.ubo_scene_matrices.buffer) {
+    WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.ubo_scene[slot])
     WGPUBindGroupEntry bg_entries[1] = {
       [0] = (WGPUBindGroupEntry) {
         // Binding 0: Uniform buffer (Vertex shader) => UBOScene
         .binding = 0,
         .buffer  = shader_data.ubo_scene_matrices.buffer,
         .offset  = 0,
-        .size    = shader_data.ubo_scene_matrices.size,
+        .size    = sizeof(shader_data.scene_matrices),
       },
     };
-    bind_groups.ubo_scene = wgpuDeviceCreateBindGroup(
+    bind_groups.ubo_scene[slot] = wgpuDeviceCreateBindGroup(
       wgpu_context->device, &(WGPUBindGroupDescriptor){
                               .layout     = bind_group_layouts.ubo_scene,
                               .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
                               .entries    = bg_entries,
                             });
-    ASSERT(bind_groups.ubo_scene != NULL)
+    ASSERT(bind_groups.ubo_scene[slot] != NULL)
+    bind_groups.ubo_scene_buffers[slot] = shader_data.ubo_scene_matrices.buffer;
   }
+  return bind_groups.ubo_scene[slot];
+}
 
+/* The matrices are written every frame into a slice of the uniform buffer of
+ * the frame slot, so that the frames in flight never share the block */
+static void update_uniform_buffers(wgpu_example_context_t* context)
+{
+  // Pass matrices to the shaders, the view of each copy includes its offset in
+  // the row. The light position is a direction, so it is not moved by them.
+  camera_t* camera = context->camera;
+  glm_mat4_copy(camera->matrices.perspective,
+                shader_data.scene_matrices.projection);
+  for (uint32_t i = 0; i < MODEL_COUNT + 1; ++i) {
+    const float x
+      = ((float)i - (float)(MODEL_COUNT - 1) * 0.5f) * MODEL_SPACING;
+    glm_mat4_copy(camera->matrices.view, shader_data.scene_matrices.view);
+    glm_translate(shader_data.scene_matrices.view, (vec3){x, 0.0f, 0.0f});
+    const bool written = wgpu_frame_write_uniform(
+      context->wgpu_context, &shader_data.scene_matrices,
+      sizeof(shader_data.scene_matrices),
+      &shader_data.ubo_scene_matrices.buffer,
+      &shader_data.ubo_scene_matrices.offsets[i]);
+    ASSERT(written);
+    UNUSED_VAR(written);
+  }
+}
+
+static void setup_model_bind_groups(wgpu_context_t* wgpu_context,
+                                    struct gltf_model_t* gltf_model)
+{
   // Bind group for glTF model meshes
   {
     wgpu_gltf_model_prepare_nodes_bind_group(gltf_model,
                                              bind_group_layouts.ubo_primitive);
   }
 
-  // Bind group for glTF model skin joint matrices
-  {
-    wgpu_gltf_model_prepare_skins_bind_group(gltf_model,
-                                             bind_group_layouts.joint_matrices);
-  }
-
-  // Bind group for materials
+  // Bind group for materials, the materials without base color texture sample
+  // the white texture
   {
     wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
     for (uint32_t i = 0; i < materials.material_count; ++i) {
       wgpu_gltf_material_t* material = &materials.materials[i];
-      if (material->base_color_texture) {
-        WGPUBindGroupEntry bg_entries[2] = {
-            [0] = (WGPUBindGroupEntry) {
-              // Binding 0: texture2D (Fragment shader) => Color map
-              .binding = 0,
-              .textureView = material->base_color_texture->wgpu_texture.view,
-            },
-            [1] = (WGPUBindGroupEntry) {
-              // Binding 1: sampler (Fragment shader) => Color map
-              .binding = 1,
-              .sampler =  material->base_color_texture->wgpu_texture.sampler,
-            },
-          };
-        material->bind_group = wgpuDeviceCreateBindGroup(
-          wgpu_context->device,
-          &(WGPUBindGroupDescriptor){
-            .layout     = bind_group_layouts.textures,
-            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-            .entries    = bg_entries,
-          });
-        ASSERT(material->bind_group != NULL)
-      }
+      const texture_t* color_map
+        = material->base_color_texture ?
+            &material->base_color_texture->wgpu_texture :
+            &morph.white_texture;
+      WGPUBindGroupEntry bg_entries[2] = {
+          [0] = (WGPUBindGroupEntry) {
+            // Binding 0: texture2D (Fragment shader) => Color map
+            .binding = 0,
+            .textureView = color_map->view,
+          },
+          [1] = (WGPUBindGroupEntry) {
+            // Binding 1: sampler (Fragment shader) => Color map
+            .binding = 1,
+            .sampler =  color_map->sampler,
+          },
+        };
+      material->bind_group = wgpuDeviceCreateBindGroup(
+        wgpu_context->device,
+        &(WGPUBindGroupDescriptor){
+          .layout     = bind_group_layouts.textures,
+          .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+          .entries    = bg_entries,
+        });
+      ASSERT(material->bind_group != NULL)
     }
   }
 }
 
+static void setup_bind_groups(wgpu_context_t* wgpu_context)
+{
+  for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+    setup_model_bind_groups(wgpu_context, gltf_models[i]);
+  }
+  setup_model_bind_groups(wgpu_context, morph.model);
+}
+
 static void setup_render_pass(wgpu_context_t* wgpu_context)
 {
   // Color attachment
@@ -371,18 +496,15 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     // Location 2: Texture coordinates
     WGPU_GLTF_VERTATTR_DESC(2, WGPU_GLTF_VertexComponent_UV),
     // Location 3: Vertex color
-    WGPU_GLTF_VERTATTR_DESC(3, WGPU_GLTF_VertexComponent_Color),
-    // Location 4: Per-Vertex Joint indices
-    WGPU_GLTF_VERTATTR_DESC(4, WGPU_GLTF_VertexComponent_Joint0),
-    // Location 5: Per-Vertex Joint weights
-    WGPU_GLTF_VERTATTR_DESC(5, WGPU_GLTF_VertexComponent_Weight0));
+    WGPU_GLTF_VERTATTR_DESC(3, WGPU_GLTF_VertexComponent_Color));
 
   // Vertex state
   WGPUVertexState vertex_state_desc = wgpu_create_vertex_state(
             wgpu_context, &(wgpu_vertex_state_t){
             .shader_desc = (wgpu_shader_desc_t){
-              // Vertex shader SPIR-V
-              .file = "shaders/gltf_skinning/skinnedmodel.vert.spv",
+              // Vertex shader WGSL
+              .wgsl_code.source = skinned_model_shader_wgsl,
+              .entry            = "vs_main",
             },
             .buffer_count = 1,
             .buffers = &gltf_scene_vertex_buffer_layout,
@@ -392,8 +514,9 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUFragmentState fragment_state_desc = wgpu_create_fragment_state(
             wgpu_context, &(wgpu_fragment_state_t){
             .shader_desc = (wgpu_shader_desc_t){
-              // Fragment shader SPIR-V
-              .file = "shaders/gltf_skinning/skinnedmodel.frag.spv",
+              // Fragment shader WGSL
+              .wgsl_code.source = skinned_model_shader_wgsl,
+              .entry            = "fs_main",
             },
             .target_count = 1,
             .targets = &color_target_state_desc,
@@ -428,7 +551,6 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
-    prepare_uniform_buffers(context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
@@ -444,6 +566,23 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    if (animation.gpu_supported) {
+      imgui_overlay_checkBox(context->imgui_overlay, "GPU animation",
+                             &animation.gpu_enabled);
+    }
+  }
+  if (morph.target_count > 0 && imgui_overlay_header("Morph targets")) {
+    bool changed = false;
+    for (uint32_t i = 0; i < morph.target_count; ++i) {
+      char caption[STRMAX];
+      snprintf(caption, sizeof(caption), "Weight %u", i);
+      changed |= imgui_overlay_slider_float(context->imgui_overlay, caption,
+                                            &morph.weights[i], 0.0f, 1.0f);
+    }
+    if (changed) {
+      wgpu_gltf_model_set_morph_weights(morph.model, 0, morph.weights,
+                                        morph.target_count);
+    }
   }
 }
 
@@ -456,13 +595,29 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Animate the joints and skin the vertices of the models for the render pass
+  {
+    wgpu_context->cpass_enc
+      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+      if (animation.gpu_enabled) {
+        wgpu_gltf_model_dispatch_animation(gltf_models[i],
+                                           wgpu_context->cpass_enc);
+      }
+      wgpu_gltf_model_dispatch_skinning(gltf_models[i],
+                                        wgpu_context->cpass_enc);
+    }
+    wgpu_gltf_model_dispatch_skinning(morph.model, wgpu_context->cpass_enc);
+    wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  }
+
   // Create render pass encoder for encoding drawing commands
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass.descriptor);
 
-  // Set the bind group
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                    bind_groups.ubo_scene, 0, 0);
+  // Bind the render pipeline
+  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, solid_pipeline);
 
   // Set viewport
   wgpuRenderPassEncoderSetViewport(
@@ -474,14 +629,22 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                       wgpu_context->surface.width,
                                       wgpu_context->surface.height);
 
-  // Draw plane
+  // Draw the models, each with the scene matrices of its place in the row
   static wgpu_gltf_render_flags_enum_t render_flags
     = WGPU_GLTF_RenderFlags_BindImages;
-  wgpu_gltf_model_draw(gltf_model, (wgpu_gltf_model_render_options_t){
-                                     .render_flags        = render_flags,
-                                     .bind_mesh_model_set = 1,
-                                     .bind_image_set      = 3,
-                                   });
+  WGPUBindGroup scene_bind_group = get_scene_bind_group(wgpu_context);
+  for (uint32_t i = 0; i < MODEL_COUNT + 1; ++i) {
+    const uint32_t scene_offset
+      = (uint32_t)shader_data.ubo_scene_matrices.offsets[i];
+    wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
+                                      scene_bind_group, 1, &scene_offset);
+    struct gltf_model_t* model = i < MODEL_COUNT ? gltf_models[i] : morph.model;
+    wgpu_gltf_model_draw(model, (wgpu_gltf_model_render_options_t){
+                                  .render_flags        = render_flags,
+                                  .bind_mesh_model_set = 1,
+                                  .bind_image_set      = 2,
+                                });
+  }
 
   // End render pass
   wgpuRenderPassEncoderEndPass(wgpu_context->rpass_enc);
@@ -503,6 +666,9 @@ static int example_draw(wgpu_example_context_t* context)
   // Prepare frame
   prepare_frame(context);
 
+  // Scene matrices of the frame slot
+  update_uniform_buffers(context);
+
   // Command buffer to be submitted to the queue
   wgpu_context_t* wgpu_context                   = context->wgpu_context;
   wgpu_context->submit_info.command_buffer_count = 1;
@@ -518,32 +684,73 @@ static int example_draw(wgpu_example_context_t* context)
   return 0;
 }
 
+static void update_animation(wgpu_example_context_t* context)
+{
+  const float end = wgpu_gltf_model_get_animation_end(gltf_models[0], 0);
+  if (!context->paused) {
+    animation.time += context->frame_timer;
+    if (end > 0.0f && animation.time > end) {
+      animation.time = fmodf(animation.time, end);
+    }
+  }
+
+  // Every copy is at its own phase of the animation
+  wgpu_gltf_model_animation_update_t updates[MODEL_COUNT];
+  for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+    float time = animation.time + end * (float)i / (float)MODEL_COUNT;
+    if (end > 0.0f && time > end) {
+      time -= end;
+    }
+    updates[i] = (wgpu_gltf_model_animation_update_t){
+      .model           = gltf_models[i],
+      .animation_index = 0,
+      .time            = time,
+    };
+  }
+
+  // The GPU animation replaces the joint matrices of the CPU update, which
+  // evaluates the copies in parallel and uploads the palette at once
+  if (animation.gpu_enabled) {
+    for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+      wgpu_gltf_model_set_animation_blend(
+        gltf_models[i], &(wgpu_gltf_model_animation_blend_t){
+                          .animations = {0, 0},
+                          .times      = {updates[i].time, updates[i].time},
+                          .weight     = 0.0f,
+                        });
+    }
+  }
+  else if (!context->paused) {
+    wgpu_gltf_models_update_animations(updates, MODEL_COUNT);
+  }
+}
+
 static int example_render(wgpu_example_context_t* context)
 {
   if (!prepared) {
     return 1;
   }
-  int draw_result = example_draw(context);
-  if (context->camera->updated) {
-    update_uniform_buffers(context);
-  }
-  if (!context->paused) {
-    // gltf_model_update_animation(gltf_model, 0, context->frame_timer);
-  }
-  return draw_result;
+  update_animation(context);
+  return example_draw(context);
 }
 
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
-  wgpu_gltf_model_destroy(gltf_model);
+  // The palette is released before the models using it
+  wgpu_gltf_joint_palette_release(joint_palette);
+  for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+    wgpu_gltf_model_destroy(gltf_models[i]);
+  }
+  wgpu_gltf_model_destroy(morph.model);
+  wgpu_destroy_texture(&morph.white_texture);
 
-  WGPU_RELEASE_RESOURCE(Buffer, shader_data.ubo_scene_matrices.buffer)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.ubo_scene)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.ubo_primitive)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.joint_matrices)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.textures)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.ubo_scene)
+  for (uint32_t i = 0; i < WGPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.ubo_scene[i])
+  }
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(RenderPipeline, solid_pipeline)
 }
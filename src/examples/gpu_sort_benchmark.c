@@ -0,0 +1,468 @@
+#include "example_base.h"
+#include "examples.h"
+
+#include <string.h>
+
+#include "../core/job_system.h"
+#include "../core/random.h"
+#include "../webgpu/gpu_profiler.h"
+#include "../webgpu/gpu_sort.h"
+#include "../webgpu/imgui_overlay.h"
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU Example - GPU Sort Benchmark
+ *
+ * Measures the GPU primitives of gpu_sort.h on the current adapter: the
+ * exclusive scan, the key/value radix sort and the stream compaction of
+ * random u32 elements. Every frame the random keys are restored before they
+ * are sorted again, the GPU times of the operations are measured with
+ * timestamp queries and reported as elements per second.
+ *
+ * The element count is picked in the settings or with --elements=<n>. With
+ * --compute-only the operations run without a window, the results are read
+ * back and verified once the measured iterations have completed.
+ * -------------------------------------------------------------------------- */
+
+#define DEFAULT_NUM_ELEMENTS 1048576u
+#define MAX_NUM_ELEMENTS 16777216u
+
+// Benchmark resources are recreated when the element count is changed
+static struct {
+  uint32_t num_elements;
+  uint32_t num_flags_set; /* Expected result of the compaction */
+  bool changed;
+} benchmark = {
+  .num_elements = DEFAULT_NUM_ELEMENTS,
+  .changed      = false,
+};
+
+static const char* num_elements_names[5] = {
+  "65536", "262144", "1048576", "4194304", "16777216",
+};
+
+// Profiler scopes, one compute pass per operation
+static const char* scan_scope_name    = "Scan";
+static const char* sort_scope_name    = "Radix sort";
+static const char* compact_scope_name = "Compaction";
+
+// Storage buffers
+static struct {
+  WGPUBuffer random_keys;  /* Random keys restored before every sort */
+  WGPUBuffer indices;      /* Element indices, the initial sort values */
+  WGPUBuffer flags;        /* Random 0 or 1 flags */
+  WGPUBuffer keys;         /* Sorted keys */
+  WGPUBuffer values;       /* Sorted values */
+  WGPUBuffer scan_output;  /* Scanned flags */
+  WGPUBuffer compacted;    /* Indices of the set flags */
+  WGPUBuffer kept_count;   /* Number of set flags */
+} storage_buffers = {0};
+
+static wgpu_gpu_sort_t* gpu_sort;
+
+// Render pass descriptor for frame buffer writes
+static struct {
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDescriptor descriptor;
+} render_pass;
+
+// Other variables
+static const char* example_title = "GPU Sort Benchmark";
+static bool prepared             = false;
+
+static WGPUBuffer create_storage_buffer(wgpu_context_t* wgpu_context,
+                                        const char* label,
+                                        WGPUBufferUsage usage, uint64_t size,
+                                        bool mapped_at_creation)
+{
+  WGPUBuffer buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device, &(WGPUBufferDescriptor){
+                            .label            = label,
+                            .usage            = WGPUBufferUsage_Storage | usage,
+                            .size             = size,
+                            .mappedAtCreation = mapped_at_creation,
+                          });
+  ASSERT(buffer != NULL);
+  return buffer;
+}
+
+// Fills the keys [begin, end) from the generator of the worker thread
+static void random_keys_fill(void* user_data, uint32_t begin, uint32_t end)
+{
+  uint32_t* keys = (uint32_t*)user_data;
+  random_fill_u32(random_get_thread_generator(), &keys[begin], end - begin);
+}
+
+static void prepare_benchmark(wgpu_context_t* wgpu_context)
+{
+  const uint32_t count = benchmark.num_elements;
+  const uint64_t size  = count * sizeof(uint32_t);
+
+  // The inputs are written straight into the mapped buffers
+  storage_buffers.random_keys = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_random_keys_buffer",
+    WGPUBufferUsage_CopySrc, size, true);
+  storage_buffers.indices = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_indices_buffer", WGPUBufferUsage_CopySrc,
+    size, true);
+  storage_buffers.flags = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_flags_buffer", WGPUBufferUsage_None,
+    size, true);
+  uint32_t* keys = (uint32_t*)wgpuBufferGetMappedRange(
+    storage_buffers.random_keys, 0, size);
+  uint32_t* indices
+    = (uint32_t*)wgpuBufferGetMappedRange(storage_buffers.indices, 0, size);
+  uint32_t* flags
+    = (uint32_t*)wgpuBufferGetMappedRange(storage_buffers.flags, 0, size);
+  ASSERT(keys != NULL && indices != NULL && flags != NULL);
+  job_system_parallel_for(job_system_get_shared(), count, 0, random_keys_fill,
+                          keys);
+  random_fill_u32(random_get_thread_generator(), flags, count);
+  benchmark.num_flags_set = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    indices[i] = i;
+    flags[i] &= 1;
+    benchmark.num_flags_set += flags[i];
+  }
+  wgpuBufferUnmap(storage_buffers.random_keys);
+  wgpuBufferUnmap(storage_buffers.indices);
+  wgpuBufferUnmap(storage_buffers.flags);
+
+  storage_buffers.keys = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_keys_buffer",
+    WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc, size, false);
+  storage_buffers.values = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_values_buffer", WGPUBufferUsage_CopyDst,
+    size, false);
+  storage_buffers.scan_output = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_scan_output_buffer",
+    WGPUBufferUsage_None, size, false);
+  storage_buffers.compacted = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_compacted_buffer", WGPUBufferUsage_None,
+    size, false);
+  storage_buffers.kept_count = create_storage_buffer(
+    wgpu_context, "gpu_sort_benchmark_kept_count_buffer",
+    WGPUBufferUsage_CopySrc, sizeof(uint32_t), false);
+
+  gpu_sort = wgpu_gpu_sort_create(wgpu_context, &(wgpu_gpu_sort_desc_t){
+                                                  .max_element_count = count,
+                                                });
+}
+
+static void release_benchmark(void)
+{
+  wgpu_gpu_sort_release(gpu_sort);
+  gpu_sort = NULL;
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.random_keys)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.indices)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.flags)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.keys)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.values)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.scan_output)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.compacted)
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.kept_count)
+}
+
+static void setup_render_pass(wgpu_context_t* wgpu_context)
+{
+  UNUSED_VAR(wgpu_context);
+
+  // Color attachment
+  render_pass.color_attachments[0] = (WGPURenderPassColorAttachment) {
+      .view       = NULL, // Assigned later
+      .loadOp     = WGPULoadOp_Clear,
+      .storeOp    = WGPUStoreOp_Store,
+      .clearValue = (WGPUColor) {
+        .r = 0.0f,
+        .g = 0.0f,
+        .b = 0.0f,
+        .a = 1.0f,
+      },
+  };
+
+  // Render pass descriptor
+  render_pass.descriptor = (WGPURenderPassDescriptor){
+    .colorAttachmentCount = 1,
+    .colorAttachments     = render_pass.color_attachments,
+  };
+}
+
+static int example_initialize(wgpu_example_context_t* context)
+{
+  if (context) {
+    prepare_benchmark(context->wgpu_context);
+    setup_render_pass(context->wgpu_context);
+    prepared = true;
+    return 0;
+  }
+
+  return 1;
+}
+
+static int32_t get_num_elements_index(uint32_t num_elements)
+{
+  for (uint32_t i = 0; i < ARRAY_SIZE(num_elements_names); ++i) {
+    if ((uint32_t)atoi(num_elements_names[i]) == num_elements) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    int32_t num_elements_index = get_num_elements_index(benchmark.num_elements);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Elements",
+                                &num_elements_index, num_elements_names,
+                                ARRAY_SIZE(num_elements_names))) {
+      benchmark.num_elements = atoi(num_elements_names[num_elements_index]);
+      benchmark.changed      = true;
+    }
+  }
+  if (imgui_overlay_header("Statistics")) {
+    if (context->wgpu_context->gpu_profiler == NULL) {
+      imgui_overlay_text("Timestamp queries are not supported");
+      return;
+    }
+    const wgpu_gpu_profiler_result_t* gpu_timings = NULL;
+    const uint32_t gpu_timing_count = wgpu_gpu_profiler_get_results(
+      context->wgpu_context->gpu_profiler, &gpu_timings);
+    const char* scope_names[3] = {
+      scan_scope_name,
+      sort_scope_name,
+      compact_scope_name,
+    };
+    for (uint32_t i = 0; i < gpu_timing_count; ++i) {
+      const float ms = gpu_timings[i].gpu_time_ms;
+      for (uint32_t j = 0; j < ARRAY_SIZE(scope_names) && ms > 0.0f; ++j) {
+        if (strcmp(gpu_timings[i].name, scope_names[j]) == 0) {
+          imgui_overlay_text("%s: %.3f ms, %.1f M keys/s", scope_names[j], ms,
+                             benchmark.num_elements / (ms * 1e3f));
+        }
+      }
+    }
+  }
+}
+
+// Records the scan, the radix sort and the compaction of the elements
+static void record_operations(wgpu_context_t* wgpu_context,
+                              WGPUCommandEncoder cmd_enc)
+{
+  wgpu_gpu_profiler_t* gpu_profiler = wgpu_context->gpu_profiler;
+  const uint32_t count              = benchmark.num_elements;
+
+  // Restore the unsorted keys
+  const uint64_t size = count * sizeof(uint32_t);
+  wgpuCommandEncoderCopyBufferToBuffer(cmd_enc, storage_buffers.random_keys, 0,
+                                       storage_buffers.keys, 0, size);
+  wgpuCommandEncoderCopyBufferToBuffer(cmd_enc, storage_buffers.indices, 0,
+                                       storage_buffers.values, 0, size);
+
+  // Scan
+  uint32_t scope
+    = wgpu_gpu_profiler_begin_scope(gpu_profiler, cmd_enc, scan_scope_name);
+  wgpu_context->cpass_enc = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  wgpu_gpu_sort_scan(gpu_sort, wgpu_context->cpass_enc, storage_buffers.flags,
+                     storage_buffers.scan_output, count);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  wgpu_gpu_profiler_end_scope(gpu_profiler, cmd_enc, scope);
+
+  // Radix sort
+  scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, cmd_enc, sort_scope_name);
+  wgpu_context->cpass_enc = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  wgpu_gpu_sort_radix_sort(gpu_sort, wgpu_context->cpass_enc,
+                           storage_buffers.keys, storage_buffers.values, count);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  wgpu_gpu_profiler_end_scope(gpu_profiler, cmd_enc, scope);
+
+  // Compaction
+  scope = wgpu_gpu_profiler_begin_scope(gpu_profiler, cmd_enc,
+                                        compact_scope_name);
+  wgpu_context->cpass_enc = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  wgpu_gpu_sort_compact(gpu_sort, wgpu_context->cpass_enc,
+                        storage_buffers.indices, storage_buffers.flags,
+                        storage_buffers.compacted, storage_buffers.kept_count,
+                        count);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  wgpu_gpu_profiler_end_scope(gpu_profiler, cmd_enc, scope);
+}
+
+static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context          = context->wgpu_context;
+  render_pass.color_attachments[0].view = wgpu_context->swap_chain.frame_buffer;
+
+  // Create command encoder
+  wgpu_context->cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+
+  if (!context->paused) {
+    record_operations(wgpu_context, wgpu_context->cmd_enc);
+  }
+
+  // Render pass
+  {
+    wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
+      wgpu_context->cmd_enc, &render_pass.descriptor);
+    wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+  }
+
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
+
+  // Get command buffer
+  WGPUCommandBuffer command_buffer
+    = wgpu_get_command_buffer(wgpu_context->cmd_enc);
+  ASSERT(command_buffer != NULL)
+  WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
+
+  return command_buffer;
+}
+
+static int example_draw(wgpu_example_context_t* context)
+{
+  // Prepare frame
+  prepare_frame(context);
+
+  // Command buffer to be submitted to the queue
+  wgpu_context_t* wgpu_context                   = context->wgpu_context;
+  wgpu_context->submit_info.command_buffer_count = 1;
+  wgpu_context->submit_info.command_buffers[0] = build_command_buffer(context);
+
+  // Submit to queue
+  submit_command_buffers(context);
+
+  // Submit frame
+  submit_frame(context);
+
+  return 0;
+}
+
+static int example_render(wgpu_example_context_t* context)
+{
+  if (!prepared) {
+    return 1;
+  }
+  if (benchmark.changed) {
+    release_benchmark();
+    prepare_benchmark(context->wgpu_context);
+    benchmark.changed = false;
+  }
+  return example_draw(context);
+}
+
+// Clean up used resources
+static void example_destroy(wgpu_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  release_benchmark();
+}
+
+static void parse_benchmark_arguments(int argc, char* argv[])
+{
+  static const char elements_option[] = "--elements=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], elements_option, strlen(elements_option)) == 0) {
+      const uint32_t num_elements
+        = (uint32_t)strtoul(argv[i] + strlen(elements_option), NULL, 10);
+      benchmark.num_elements = CLAMP(num_elements, 1u, MAX_NUM_ELEMENTS);
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- *
+ * Compute-only mode
+ * -------------------------------------------------------------------------- */
+
+static int compute_initialize(compute_example_context_t* context)
+{
+  prepare_benchmark(context->wgpu_context);
+  context->work_per_iteration = benchmark.num_elements;
+  context->work_unit          = "keys";
+  return 0;
+}
+
+static void compute_record(compute_example_context_t* context,
+                           WGPUCommandEncoder cmd_enc)
+{
+  record_operations(context->wgpu_context, cmd_enc);
+}
+
+// The keys have to be sorted and the compaction has to keep the set flags
+static bool compute_verify(compute_example_context_t* context)
+{
+  const uint32_t count = benchmark.num_elements;
+  const uint64_t size  = count * sizeof(uint32_t);
+  uint32_t* keys       = (uint32_t*)malloc(size);
+  uint32_t kept_count  = 0;
+  bool valid
+    = wgpu_read_buffer(context->wgpu_context, storage_buffers.keys, 0, size,
+                       keys)
+      && wgpu_read_buffer(context->wgpu_context, storage_buffers.kept_count, 0,
+                          sizeof(uint32_t), &kept_count);
+  for (uint32_t i = 1; valid && i < count; ++i) {
+    valid = keys[i - 1] <= keys[i];
+  }
+  free(keys);
+  if (valid && kept_count != benchmark.num_flags_set) {
+    log_error("Compaction kept %u of %u elements", kept_count,
+              benchmark.num_flags_set);
+    valid = false;
+  }
+  return valid;
+}
+
+static void compute_destroy(compute_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  release_benchmark();
+}
+
+static bool has_compute_only_argument(int argc, char* argv[])
+{
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--compute-only") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void example_gpu_sort_benchmark(int argc, char* argv[])
+{
+  parse_benchmark_arguments(argc, argv);
+
+  if (has_compute_only_argument(argc, argv)) {
+    const int status = compute_example_run(
+      argc, argv,
+      &(compute_refexport_t){
+        .title           = example_title,
+        .initialize_func = &compute_initialize,
+        .record_func     = &compute_record,
+        .verify_func     = &compute_verify,
+        .destroy_func    = &compute_destroy,
+      });
+    if (status != 0) {
+      exit(EXIT_FAILURE);
+    }
+    return;
+  }
+
+  // clang-format off
+  example_run(argc, argv, &(refexport_t){
+    .example_settings = (wgpu_example_settings_t){
+     .title   = example_title,
+     .overlay = true,
+     .vsync   = false,
+    },
+    .example_initialize_func = &example_initialize,
+    .example_render_func     = &example_render,
+    .example_destroy_func    = &example_destroy,
+  });
+  // clang-format on
+}
@@ -3,15 +3,30 @@
 
 #include <string.h>
 
+#include "../webgpu/auto_exposure.h"
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/skybox.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - High Dynamic Range Rendering
  *
  * Implements a high dynamic range rendering pipeline using 16/32 bit floating
  * point precision for all internal formats, textures and calculations,
- * including a bloom pass, manual exposure and tone mapping.
+ * including a bloom pass, manual exposure and tone mapping. The auto exposure
+ * meters the scene color with a luminance histogram in a compute pass and
+ * copies the adapted exposure into the parameters of the next frame, without
+ * readback. The scene color is already tone mapped with the exposure, which
+ * the metering inverts.
+ *
+ * The skybox is drawn after the object at the far plane, only the pixels the
+ * object left uncovered sample the cubemap, and writes the bright pass of the
+ * bloom into the second target. A BC6H cubemap is used when the device
+ * supports it.
+ *
+ * The scene color and bloom targets use the packed RG11B10Ufloat format when
+ * the device can render to it, which takes half the bandwidth of RGBA16Float.
+ * None of the targets needs alpha or negative values.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/hdr
@@ -27,8 +42,10 @@ static struct {
   texture_t envmap;
 } textures = {0};
 
+// Background drawn after the object
+static wgpu_skybox_t* skybox = NULL;
+
 static struct {
-  struct gltf_model_t* skybox;
   struct {
     const char* name;
     const char* filelocation;
@@ -70,13 +87,22 @@ static struct {
   .exposure = 1.0f,
 };
 
+// Histogram-based auto exposure
+static struct {
+  wgpu_auto_exposure_t* meter;
+  bool enabled;
+  float key_value;
+  float delta_time;
+} auto_exposure = {
+  .key_value = 0.5f,
+};
+
 static struct {
   int value;
   uint8_t padding[252];
 } ubo_constants[NUMBER_OF_CONSTANTS] = {0};
 
 static struct {
-  WGPURenderPipeline skybox;
   WGPURenderPipeline reflect;
   WGPURenderPipeline composition;
   WGPURenderPipeline bloom[2];
@@ -90,7 +116,6 @@ static struct {
 
 static struct {
   WGPUBindGroup object;
-  WGPUBindGroup skybox;
   WGPUBindGroup composition;
   WGPUBindGroup bloom_filter;
 } bind_groups = {0};
@@ -140,6 +165,15 @@ static WGPURenderPassDescriptor render_pass_desc;
 
 static WGPUTextureFormat depth_format = WGPUTextureFormat_Depth24PlusStencil8;
 
+// Formats of the scene color and bloom targets, the packed one first
+static struct {
+  WGPUTextureFormat formats[3];
+  const char* names[3];
+  uint32_t count;
+  int32_t index;
+  bool changed;
+} color_formats = {0};
+
 static const char* example_title = "High Dynamic Range Rendering";
 static bool prepared             = false;
 
@@ -158,13 +192,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   // Load glTF models
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_FlipY;
-  models.skybox
-    = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
-      .wgpu_context       = wgpu_context,
-      .filename           = "models/cube.gltf",
-      .file_loading_flags = gltf_loading_flags,
-    });
+      | WGPU_GLTF_FileLoadingFlags_FlipY
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(models.objects); ++i) {
     models.objects[i].object
       = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
@@ -182,13 +211,32 @@ static void load_assets(wgpu_context_t* wgpu_context)
     "textures/cubemaps/uffizi_cube_pz.png", // Back
     "textures/cubemaps/uffizi_cube_nz.png", // Front
   };
-  textures.envmap = wgpu_create_texture_cubemap_from_files(
-    wgpu_context, cubemap,
-    &(struct wgpu_texture_load_options_t){
-      .flip_y = true, // Flip y to match uffizi_cube_nz.ktx hdr cubemap
+  textures.envmap = wgpu_skybox_load_cubemap(
+    wgpu_context, &(wgpu_skybox_cubemap_desc_t){
+      .bc6h_filename  = "textures/cubemaps/uffizi_cube_bc6h.ktx2",
+      .face_filenames = cubemap,
+      .options        = &(struct wgpu_texture_load_options_t){
+        .flip_y = true, // Flip y to match uffizi_cube_nz.ktx hdr cubemap
+      },
     });
 }
 
+static void setup_color_formats(wgpu_context_t* wgpu_context)
+{
+  uint32_t count = 0;
+  if (wgpu_has_feature(wgpu_context,
+                       WGPUFeatureName_RG11B10UfloatRenderable)) {
+    color_formats.formats[count] = WGPUTextureFormat_RG11B10Ufloat;
+    color_formats.names[count++] = "RG11B10Ufloat";
+  }
+  color_formats.formats[count] = WGPUTextureFormat_RGBA16Float;
+  color_formats.names[count++] = "RGBA16Float";
+  color_formats.formats[count] = WGPUTextureFormat_RGBA8Unorm;
+  color_formats.names[count++] = "RGBA8Unorm";
+  color_formats.count = count;
+  color_formats.index = 0;
+}
+
 void create_attachment(wgpu_context_t* wgpu_context, const char* texture_label,
                        WGPUTextureFormat format,
                        wgpu_render_pass_attachment_type_t attachment_type,
@@ -245,6 +293,9 @@ void create_attachment(wgpu_context_t* wgpu_context, const char* texture_label,
 // Prepare a new framebuffer and attachments for offscreen rendering (G-Buffer)
 static void prepare_offscreen(wgpu_context_t* wgpu_context)
 {
+  const WGPUTextureFormat color_format
+    = color_formats.formats[color_formats.index];
+
   {
     offscreen_pass.width  = wgpu_context->surface.width;
     offscreen_pass.height = wgpu_context->surface.height;
@@ -252,12 +303,12 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
     /* Color attachments */
 
     // Two floating point color buffers
-    create_attachment(
-      wgpu_context, "offscreen_color_tex_1", WGPUTextureFormat_RGBA8Unorm,
-      WGPU_RENDER_PASS_COLOR_ATTACHMENT_TYPE, &offscreen_pass.color[0]);
-    create_attachment(
-      wgpu_context, "offscreen_color_tex_2", WGPUTextureFormat_RGBA8Unorm,
-      WGPU_RENDER_PASS_COLOR_ATTACHMENT_TYPE, &offscreen_pass.color[1]);
+    create_attachment(wgpu_context, "offscreen_color_tex_1", color_format,
+                      WGPU_RENDER_PASS_COLOR_ATTACHMENT_TYPE,
+                      &offscreen_pass.color[0]);
+    create_attachment(wgpu_context, "offscreen_color_tex_2", color_format,
+                      WGPU_RENDER_PASS_COLOR_ATTACHMENT_TYPE,
+                      &offscreen_pass.color[1]);
     // Depth attachment
     create_attachment(wgpu_context, "offscreen_tex_depth", depth_format,
                       WGPU_RENDER_PASS_DEPTH_STENCIL_ATTACHMENT_TYPE,
@@ -325,9 +376,9 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
     // Color attachments
 
     // Floating point color buffer
-    create_attachment(
-      wgpu_context, "bloom_color_tex", WGPUTextureFormat_RGBA8Unorm,
-      WGPU_RENDER_PASS_COLOR_ATTACHMENT_TYPE, &filter_pass.color[0]);
+    create_attachment(wgpu_context, "bloom_color_tex", color_format,
+                      WGPU_RENDER_PASS_COLOR_ATTACHMENT_TYPE,
+                      &filter_pass.color[0]);
 
     // Init attachment properties
 
@@ -595,18 +646,6 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
         = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
       ASSERT(bind_groups.object != NULL);
     }
-
-    // Skybox bind group
-    {
-      WGPUBindGroupDescriptor bg_desc = {
-        .layout     = bind_group_layouts.models,
-        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-        .entries    = bg_entries,
-      };
-      bind_groups.skybox
-        = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-      ASSERT(bind_groups.skybox != NULL);
-    }
   }
 
   // Bloom filter bind group
@@ -914,25 +953,6 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
             .targets = color_target_state_desc,
           });
 
-    // Skybox pipeline (background cube)
-    {
-      primitive_state_desc.cullMode              = WGPUCullMode_Back;
-      depth_stencil_state_desc.depthWriteEnabled = false;
-
-      // Create rendering pipeline using the specified states
-      pipelines.skybox = wgpuDeviceCreateRenderPipeline(
-        wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                                .label        = "skybox_render_pipeline",
-                                .layout       = pipeline_layouts.models,
-                                .primitive    = primitive_state_desc,
-                                .vertex       = vertex_state_desc,
-                                .fragment     = &fragment_state_desc,
-                                .depthStencil = &depth_stencil_state_desc,
-                                .multisample  = multisample_state_desc,
-                              });
-      ASSERT(pipelines.skybox);
-    }
-
     // Object rendering pipeline
     {
       // Enable depth write
@@ -971,6 +991,11 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
   wgpu_queue_write_buffer(context->wgpu_context,
                           uniform_buffers.matrices.buffer, 0, &ubo_matrices,
                           uniform_buffers.matrices.size);
+
+  if (skybox != NULL) {
+    wgpu_skybox_set_view_projection(skybox, ubo_matrices.model_view,
+                                    ubo_matrices.projection);
+  }
 }
 
 static void update_params(wgpu_example_context_t* context)
@@ -1028,17 +1053,54 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
   update_dynamic_uniform_buffers(context);
 }
 
+static void prepare_auto_exposure(wgpu_context_t* wgpu_context)
+{
+  auto_exposure.meter = wgpu_auto_exposure_create(
+    wgpu_context, &(wgpu_auto_exposure_desc_t){
+                    .input     = WGPU_AutoExposureInput_ExponentialTonemap,
+                    .key_value = auto_exposure.key_value,
+                  });
+  wgpu_auto_exposure_set_input(auto_exposure.meter,
+                               offscreen_pass.color[0].texture_view,
+                               offscreen_pass.width, offscreen_pass.height);
+}
+
+// The skybox renders to the offscreen targets, tone mapped with the exposure
+// of the parameters like the object
+static void prepare_skybox(wgpu_context_t* wgpu_context)
+{
+  skybox = wgpu_skybox_create(
+    wgpu_context, &(wgpu_skybox_desc_t){
+                    .cubemap_view       = textures.envmap.view,
+                    .sampler            = textures.envmap.sampler,
+                    .color_target_count = 2,
+                    .color_formats      = {
+                      offscreen_pass.color[0].format,
+                      offscreen_pass.color[1].format,
+                    },
+                    .bright_threshold = 0.75f,
+                    .exposure_buffer  = uniform_buffers.params.buffer,
+                    .depth_format     = depth_format,
+                    .sample_count     = 1,
+                  });
+  wgpu_skybox_set_view_projection(skybox, ubo_matrices.model_view,
+                                  ubo_matrices.projection);
+}
+
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
+    setup_color_formats(context->wgpu_context);
     prepare_uniform_buffers(context);
     prepare_offscreen(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
+    prepare_skybox(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
+    prepare_auto_exposure(context->wgpu_context);
     prepared = true;
     return 0;
   }
@@ -1053,10 +1115,33 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
                                 &models.object_index, object_names, 4)) {
       update_uniform_buffers(context);
     }
-    if (imgui_overlay_input_float(context->imgui_overlay, "Exposure",
-                                  &ubo_params.exposure, 0.025f, "%.3f")) {
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Auto exposure",
+                               &auto_exposure.enabled)) {
+      // Both start from the exposure in use, the adapted one is not read back
+      if (auto_exposure.enabled) {
+        wgpu_auto_exposure_reset(auto_exposure.meter, ubo_params.exposure);
+      }
+      else {
+        update_params(context);
+      }
+    }
+    if (auto_exposure.enabled) {
+      if (imgui_overlay_slider_float(context->imgui_overlay, "Key value",
+                                     &auto_exposure.key_value, 0.05f,
+                                     1.0f)) {
+        wgpu_auto_exposure_set_key_value(auto_exposure.meter,
+                                         auto_exposure.key_value);
+      }
+    }
+    else if (imgui_overlay_input_float(context->imgui_overlay, "Exposure",
+                                       &ubo_params.exposure, 0.025f, "%.3f")) {
       update_params(context);
     }
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Render targets",
+                                &color_formats.index, color_formats.names,
+                                color_formats.count)) {
+      color_formats.changed = true;
+    }
     imgui_overlay_checkBox(context->imgui_overlay, "Bloom", &bloom);
     imgui_overlay_checkBox(context->imgui_overlay, "Skybox", &display_skybox);
   }
@@ -1087,17 +1172,6 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                         offscreen_pass.width,
                                         offscreen_pass.height);
 
-    // Skybox
-    if (display_skybox) {
-      wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
-                                       pipelines.skybox);
-      uint32_t dynamic_offset = 0 * (uint32_t)ALIGNMENT;
-      wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                        bind_groups.skybox, 1, &dynamic_offset);
-      wgpu_gltf_model_draw(models.skybox,
-                           (wgpu_gltf_model_render_options_t){0});
-    }
-
     // 3D oject
     wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
                                      pipelines.reflect);
@@ -1107,11 +1181,35 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     wgpu_gltf_model_draw(models.objects[models.object_index].object,
                          (wgpu_gltf_model_render_options_t){0});
 
+    // Skybox, last so that the pixels covered by the object are not shaded
+    if (display_skybox) {
+      wgpu_skybox_draw(skybox, wgpu_context->rpass_enc);
+    }
+
     // End render pass
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
   }
 
+  /*
+   * Auto exposure: meter the scene and expose the next frame with the adapted
+   * exposure
+   */
+  if (auto_exposure.enabled) {
+    WGPUComputePassEncoder cpass_enc
+      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+    wgpu_auto_exposure_record(auto_exposure.meter, cpass_enc,
+                              auto_exposure.delta_time);
+    wgpuComputePassEncoderEnd(cpass_enc);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, cpass_enc)
+
+    wgpuCommandEncoderCopyBufferToBuffer(
+      wgpu_context->cmd_enc,
+      wgpu_auto_exposure_get_buffer(auto_exposure.meter)->buffer,
+      offsetof(wgpu_auto_exposure_result_t, exposure),
+      uniform_buffers.params.buffer, 0, sizeof(ubo_params.exposure));
+  }
+
   /*
    * Second render pass: First bloom pass
    */
@@ -1203,11 +1301,61 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   return command_buffer;
 }
 
+static void release_render_targets(void)
+{
+  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color[0].texture)
+  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color[1].texture)
+  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.depth.texture)
+  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color[0].texture_view)
+  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color[1].texture_view)
+  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.depth.texture_view)
+  WGPU_RELEASE_RESOURCE(Sampler, offscreen_pass.sampler)
+
+  WGPU_RELEASE_RESOURCE(Texture, filter_pass.color[0].texture)
+  WGPU_RELEASE_RESOURCE(TextureView, filter_pass.color[0].texture_view)
+  WGPU_RELEASE_RESOURCE(Sampler, filter_pass.sampler)
+
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.reflect)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.composition)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom[0])
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom[1])
+
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.object)
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.composition)
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.bloom_filter)
+
+  wgpu_skybox_release(skybox);
+  skybox = NULL;
+}
+
+// The targets, the pipelines rendering to them and the bind groups sampling
+// them are created again with the selected format
+static void recreate_render_targets(wgpu_context_t* wgpu_context)
+{
+  release_render_targets();
+  prepare_offscreen(wgpu_context);
+  prepare_pipelines(wgpu_context);
+  prepare_skybox(wgpu_context);
+  setup_bind_groups(wgpu_context);
+  wgpu_auto_exposure_set_input(auto_exposure.meter,
+                               offscreen_pass.color[0].texture_view,
+                               offscreen_pass.width, offscreen_pass.height);
+}
+
 static int example_draw(wgpu_example_context_t* context)
 {
+  // Apply the render target format selected in the last frame
+  if (color_formats.changed) {
+    recreate_render_targets(context->wgpu_context);
+    color_formats.changed = false;
+  }
+
   // Prepare frame
   prepare_frame(context);
 
+  // Adaptation of the auto exposure
+  auto_exposure.delta_time = context->frame_timer;
+
   // Command buffer to be submitted to the queue
   wgpu_context_t* wgpu_context                   = context->wgpu_context;
   wgpu_context->submit_info.command_buffer_count = 1;
@@ -1241,7 +1389,8 @@ static void example_destroy(wgpu_example_context_t* context)
 
   wgpu_destroy_texture(&textures.envmap);
 
-  wgpu_gltf_model_destroy(models.skybox);
+  wgpu_auto_exposure_release(auto_exposure.meter);
+
   for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(models.objects); ++i) {
     wgpu_gltf_model_destroy(models.objects[i].object);
   }
@@ -1250,33 +1399,12 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.params.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.dynamic.buffer)
 
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color[0].texture)
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color[1].texture)
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.depth.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color[0].texture_view)
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color[1].texture_view)
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.depth.texture_view)
-  WGPU_RELEASE_RESOURCE(Sampler, offscreen_pass.sampler)
-
-  WGPU_RELEASE_RESOURCE(Texture, filter_pass.color[0].texture)
-  WGPU_RELEASE_RESOURCE(TextureView, filter_pass.color[0].texture_view)
-  WGPU_RELEASE_RESOURCE(Sampler, filter_pass.sampler)
-
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.skybox)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.reflect)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.composition)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom[0])
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.bloom[1])
+  release_render_targets();
 
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.models)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.composition)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.bloom_filter)
 
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.object)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.skybox)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.composition)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.bloom_filter)
-
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.models)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.composition)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.bloom_filter)
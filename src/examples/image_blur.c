@@ -4,32 +4,27 @@
 
 #include <string.h>
 
+#include "../webgpu/blur.h"
 #include "../webgpu/imgui_overlay.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Image Blur
  *
- * This example shows how to blur an image using a WebGPU compute shader.
+ * This example shows how to blur an image using a WebGPU compute shader. The
+ * separable box blur runs a horizontal and a vertical pass of the blur module
+ * per iteration.
  *
  * Ref:
  * https://github.com/austinEng/webgpu-samples/tree/main/src/sample/imageBlur
  * -------------------------------------------------------------------------- */
 
-// Contants from the blur.wgsl shader.
-static const uint32_t tile_dim = 128;
-static const uint32_t batch[2] = {4, 4};
-
-// Uniform buffers
-static wgpu_buffer_t uniform_buffers[2];
-static uint32_t uniform_buffer_data[2] = {0, 1};
-static wgpu_buffer_t blur_params_buffer;
+// Blur passes
+static wgpu_blur_t* blur = NULL;
 
 // Pipelines
-static WGPUComputePipeline blur_pipeline;
 static WGPURenderPipeline fullscreen_quad_pipeline;
 
 // Bind groups
-static WGPUBindGroup compute_constants_bind_group;
 static WGPUBindGroup compute_bind_groups[3];
 static WGPUBindGroup show_result_bind_group;
 
@@ -45,7 +40,6 @@ static struct {
   .filter_size = 15,
   .iterations  = 2,
 };
-static uint32_t block_dim    = 1;
 static uint32_t image_width  = 0;
 static uint32_t image_height = 0;
 
@@ -122,137 +116,16 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
   };
 }
 
-static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
+static void prepare_bind_groups(wgpu_context_t* wgpu_context)
 {
-  // buffer 0 and buffer 1
-  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(uniform_buffers); ++i) {
-    uniform_buffers[i] = wgpu_create_buffer(
-      wgpu_context,
-      &(wgpu_buffer_desc_t){
-        .usage        = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-        .size         = 4,
-        .initial.data = &uniform_buffer_data[i],
-      });
-  }
-
-  // Compute shader blur parameters
-  blur_params_buffer = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-                    .size  = 8,
-                  });
-
-  // Compute constants bind group
-  {
-    WGPUBindGroupEntry bg_entries[2] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding = 0,
-        .sampler = texture.sampler,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding = 1,
-        .buffer  = blur_params_buffer.buffer,
-        .offset  = 0,
-        .size    = blur_params_buffer.size,
-      },
-    };
-    WGPUBindGroupDescriptor bg_desc = {
-      .label      = "Compute constants bind group",
-      .layout     = wgpuComputePipelineGetBindGroupLayout(blur_pipeline, 0),
-      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-      .entries    = bg_entries,
-    };
-    compute_constants_bind_group
-      = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-    ASSERT(compute_constants_bind_group != NULL);
-  }
-
-  // Compute bind group 0
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding     = 1,
-        .textureView = texture.view,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding     = 2,
-        .textureView = blur_textures[0].view,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        .binding = 3,
-        .buffer  = uniform_buffers[0].buffer,
-        .offset  = 0,
-        .size    = uniform_buffers[0].size,
-      },
-    };
-    WGPUBindGroupDescriptor bg_desc = {
-      .label      = "Compute bind group 0",
-      .layout     = wgpuComputePipelineGetBindGroupLayout(blur_pipeline, 1),
-      .entryCount = 3,
-      .entries    = bg_entries,
-    };
-    compute_bind_groups[0]
-      = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-    ASSERT(compute_bind_groups[0] != NULL);
-  }
-
-  // Compute bind group 1
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding     = 1,
-        .textureView = blur_textures[0].view,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding     = 2,
-        .textureView = blur_textures[1].view,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        .binding = 3,
-        .buffer  = uniform_buffers[1].buffer,
-        .offset  = 0,
-        .size    = uniform_buffers[1].size,
-      },
-    };
-    WGPUBindGroupDescriptor bg_desc = {
-      .label      = "Compute bind group 1",
-      .layout     = wgpuComputePipelineGetBindGroupLayout(blur_pipeline, 1),
-      .entryCount = 3,
-      .entries    = bg_entries,
-    };
-    compute_bind_groups[1]
-      = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-    ASSERT(compute_bind_groups[1] != NULL);
-  }
-
-  // Compute bind group 2
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding     = 1,
-        .textureView = blur_textures[1].view,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding     = 2,
-        .textureView = blur_textures[0].view,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        .binding = 3,
-        .buffer  = uniform_buffers[0].buffer,
-        .offset  = 0,
-        .size    = uniform_buffers[0].size,
-      },
-    };
-    WGPUBindGroupDescriptor bg_desc = {
-      .label      = "Compute bind group 2",
-      .layout     = wgpuComputePipelineGetBindGroupLayout(blur_pipeline, 1),
-      .entryCount = 3,
-      .entries    = bg_entries,
-    };
-    compute_bind_groups[2]
-      = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-    ASSERT(compute_bind_groups[2] != NULL);
-  }
+  // Compute bind groups: the horizontal pass from the image, the vertical pass
+  // and the horizontal pass of the following iterations
+  compute_bind_groups[0]
+    = wgpu_blur_create_bind_group(blur, texture.view, blur_textures[0].view);
+  compute_bind_groups[1] = wgpu_blur_create_bind_group(
+    blur, blur_textures[0].view, blur_textures[1].view);
+  compute_bind_groups[2] = wgpu_blur_create_bind_group(
+    blur, blur_textures[1].view, blur_textures[0].view);
 
   // Uniform bind group
   {
@@ -282,27 +155,11 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
 // Create the compute & graphics pipelines
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
 {
-  // Blur compute pipeline
-  {
-    // Compute shader
-    wgpu_shader_t blur_comp_shader = wgpu_shader_create(
-      wgpu_context, &(wgpu_shader_desc_t){
-                      // Compute shader WGSL
-                      .file = "shaders/image_blur/blur.wgsl",
-                    });
-
-    // Compute pipeline
-    blur_pipeline = wgpuDeviceCreateComputePipeline(
-      wgpu_context->device,
-      &(WGPUComputePipelineDescriptor){
-        .label   = "image_blur_render_pipeline",
-        .compute = blur_comp_shader.programmable_stage_descriptor,
-      });
-    ASSERT(blur_pipeline != NULL);
-
-    // Partial clean-up
-    wgpu_shader_release(&blur_comp_shader);
-  }
+  // Blur passes
+  blur = wgpu_blur_create(wgpu_context, &(wgpu_blur_desc_t){
+                                          .format = texture.format,
+                                          .filter = WGPU_BLUR_FILTER_BOX,
+                                        });
 
   // Fullscreen quad render pipeline
   {
@@ -371,14 +228,10 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
 
 static void update_settings(wgpu_context_t* wgpu_context)
 {
-  block_dim = tile_dim - (settings.filter_size - 1);
-
-  uniform_buffer_data[0] = settings.filter_size;
-  uniform_buffer_data[1] = block_dim;
+  UNUSED_VAR(wgpu_context);
 
-  // Map uniform buffer and update it
-  wgpu_queue_write_buffer(wgpu_context, blur_params_buffer.buffer, 0,
-                          &uniform_buffer_data, sizeof(uniform_buffer_data));
+  wgpu_blur_set_filter(blur, WGPU_BLUR_FILTER_BOX,
+                       (uint32_t)(settings.filter_size - 1) / 2);
 }
 
 static int round_up_to_odd(int value, int min, int max)
@@ -411,34 +264,11 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   {
     wgpu_context->cpass_enc
       = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc, blur_pipeline);
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
-                                       compute_constants_bind_group, 0, NULL);
-
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 1,
-                                       compute_bind_groups[0], 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      wgpu_context->cpass_enc, ceil((float)image_width / block_dim),
-      ceil((float)image_height / batch[1]), 1);
-
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 1,
-                                       compute_bind_groups[1], 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      wgpu_context->cpass_enc, ceil((float)image_height / block_dim),
-      ceil((float)image_width / batch[1]), 1);
-
+    wgpu_blur_record(blur, wgpu_context->cpass_enc, compute_bind_groups[0],
+                     compute_bind_groups[1], image_width, image_height);
     for (uint32_t i = 0; i < (uint32_t)settings.iterations - 1; ++i) {
-      wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 1,
-                                         compute_bind_groups[2], 0, NULL);
-      wgpuComputePassEncoderDispatchWorkgroups(
-        wgpu_context->cpass_enc, ceil((float)image_width / block_dim),
-        ceil((float)image_height / batch[1]), 1);
-
-      wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 1,
-                                         compute_bind_groups[1], 0, NULL);
-      wgpuComputePassEncoderDispatchWorkgroups(
-        wgpu_context->cpass_enc, ceil((float)image_height / block_dim),
-        ceil((float)image_width / batch[1]), 1);
+      wgpu_blur_record(blur, wgpu_context->cpass_enc, compute_bind_groups[2],
+                       compute_bind_groups[1], image_width, image_height);
     }
 
     wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
@@ -494,7 +324,7 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     prepare_texture(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
-    prepare_uniform_buffers(context->wgpu_context);
+    prepare_bind_groups(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     update_settings(context->wgpu_context);
     prepared = true;
@@ -522,15 +352,11 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(Texture, blur_textures[1].texture)
   wgpu_destroy_texture(&texture);
 
-  WGPU_RELEASE_RESOURCE(BindGroup, compute_constants_bind_group)
   WGPU_RELEASE_RESOURCE(BindGroup, compute_bind_groups[0])
   WGPU_RELEASE_RESOURCE(BindGroup, compute_bind_groups[1])
   WGPU_RELEASE_RESOURCE(BindGroup, compute_bind_groups[2])
   WGPU_RELEASE_RESOURCE(BindGroup, show_result_bind_group)
-  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers[0].buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers[1].buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, blur_params_buffer.buffer)
-  WGPU_RELEASE_RESOURCE(ComputePipeline, blur_pipeline)
+  wgpu_blur_release(blur);
   WGPU_RELEASE_RESOURCE(RenderPipeline, fullscreen_quad_pipeline)
 }
 
@@ -1,11 +1,13 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <math.h>
 #include <string.h>
 
 #include "../core/video_decode.h"
 
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/video_upload.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Immersive Video
@@ -13,12 +15,34 @@
  * This example shows how to display a 360-degree video where the viewer has
  * control of the viewing direction.
  *
+ * With the tiled upload, the frame is split into tiles and only the tiles in
+ * view, with a margin, are copied from the staging buffer into the texture
+ * every frame. The hidden tiles are refreshed in turns, one in
+ * HIDDEN_TILE_REFRESH_INTERVAL per frame.
+ *
+ * With the stereo mode, both eyes are rendered side by side in one pass by a
+ * single draw of two instances, the instance index selects the eye and its
+ * matrix in the stereo uniform block. The eyes sample the whole frame of a
+ * monoscopic video, or its top and bottom halves for a top-bottom stereo
+ * video.
+ *
  * Ref:
  * https://gist.github.com/fieldOfView/5106319
  * https://yanwsh.github.io/videojs-panorama/index_v4.html
  * https://github.com/muimota/p5video360
  * -------------------------------------------------------------------------- */
 
+// Tiles of the video frame
+#define VIDEO_TILE_COLUMNS 8u
+#define VIDEO_TILE_ROWS 4u
+#define VIDEO_TILE_COUNT (VIDEO_TILE_COLUMNS * VIDEO_TILE_ROWS)
+
+// Frames between two uploads of a tile out of view
+#define HIDDEN_TILE_REFRESH_INTERVAL 8u
+
+// Margin around the field of view, in degrees
+#define VIEW_MARGIN_DEGREES 15.0f
+
 // Uniform buffer block object
 static wgpu_buffer_t uniform_buffer_vs = {0};
 
@@ -36,6 +60,47 @@ static struct {
   .iVFovDegrees = 80.0f,
 };
 
+// Stereo uniform block data, per-eye matrices from clip space to the view
+// rays and parts of the video frame
+static wgpu_buffer_t uniform_buffer_stereo = {0};
+static struct {
+  struct {
+    mat4 ray_matrix;
+    vec4 uv_rect; // xy: offset, zw: scale of the texture coordinates
+  } eyes[2];
+  uint32_t visualize_input;
+  uint32_t padding[3];
+} stereo_ubo = {0};
+
+// Layouts of the video frame for the stereo mode
+typedef enum video_layout_enum {
+  VideoLayout_Mono      = 0,
+  VideoLayout_TopBottom = 1,
+  VideoLayout_COUNT     = 2,
+} video_layout_enum;
+
+static const char* video_layout_names[VideoLayout_COUNT] = {
+  "Mono",       // VideoLayout_Mono
+  "Top-bottom", // VideoLayout_TopBottom
+};
+
+// Stereo mode state
+static struct {
+  bool enabled;
+  int32_t video_layout;
+} stereo = {
+  .video_layout = VideoLayout_Mono,
+};
+
+// Tiled upload state
+static struct {
+  bool enabled;
+  uint32_t frame_index;
+  uint32_t visible_tile_count;
+} tiled_upload = {
+  .enabled = true,
+};
+
 // Used for mouse pixel coordinates calculation
 static struct {
   vec2 initial_mouse_position;
@@ -51,8 +116,9 @@ static struct {
 // The pipeline layout
 static WGPUPipelineLayout pipeline_layout;
 
-// Pipeline
+// Pipelines
 static WGPURenderPipeline pipeline;
+static WGPURenderPipeline stereo_pipeline;
 
 // Render pass descriptor for frame buffer writes
 static struct {
@@ -63,14 +129,17 @@ static struct {
 // The bind group layout
 static WGPUBindGroupLayout bind_group_layout;
 
-// The bind group
+// The bind groups
 static WGPUBindGroup bind_group;
+static WGPUBindGroup stereo_bind_group;
 
 // Texture and sampler
 static struct video_texture_t {
   WGPUSampler sampler;
   WGPUTexture texture;
   WGPUTextureView view;
+  // Staging buffers the decoder writes the frames into
+  wgpu_video_upload_t* upload;
 } video_texture = {0};
 
 static struct video_info_t {
@@ -78,11 +147,69 @@ static struct video_info_t {
     int32_t width;
     int32_t height;
   } frame_size;
+  // Decoder of the video stream
+  video_decoder_t* decoder;
 } video_info = {0};
 
 static const char* video_file_location
   = "videos/immersive_video/underwater_diving_360degrees.mp4";
 
+// Stereo shader, in the layout of the bind group of the mono shader
+// clang-format off
+static const char* stereo_shader_wgsl = CODE(
+  struct Eye {
+    rayMatrix : mat4x4<f32>,
+    uvRect : vec4<f32>,
+  };
+
+  struct StereoUniforms {
+    eyes : array<Eye, 2>,
+    visualizeInput : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> stereo : StereoUniforms;
+  @group(0) @binding(1) var videoTexture : texture_2d<f32>;
+  @group(0) @binding(2) var videoSampler : sampler;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) ndc : vec2<f32>,
+    @location(1) @interpolate(flat) eye : u32,
+  };
+
+  // Quad of the eye over its half of the target
+  @vertex
+  fn vertexMain(@builtin(vertex_index) vertexIndex : u32,
+                @builtin(instance_index) eye : u32) -> VertexOutput {
+    var corners = array<vec2<f32>, 6>(
+      vec2<f32>(-1.0, -1.0), vec2<f32>(1.0, -1.0), vec2<f32>(-1.0, 1.0),
+      vec2<f32>(-1.0, 1.0), vec2<f32>(1.0, -1.0), vec2<f32>(1.0, 1.0)
+    );
+    let ndc = corners[vertexIndex];
+    var output : VertexOutput;
+    output.position = vec4<f32>(ndc.x * 0.5 - 0.5 + f32(eye), ndc.y, 0.0, 1.0);
+    output.ndc = ndc;
+    output.eye = eye;
+    return output;
+  }
+
+  // Equirectangular mapping, the view center at the texture coordinates the
+  // mono shader maps the mouse to
+  @fragment
+  fn fragmentMain(input : VertexOutput) -> @location(0) vec4<f32> {
+    let eye = stereo.eyes[input.eye];
+    let ray = normalize((eye.rayMatrix * vec4<f32>(input.ndc, 1.0, 1.0)).xyz);
+    let pi = 3.14159265359;
+    let sphereUv = vec2<f32>(atan2(ray.x, -ray.z) / (2.0 * pi) + 0.5,
+                             0.5 - asin(clamp(ray.y, -1.0, 1.0)) / pi);
+    let inputUv = input.ndc * vec2<f32>(0.5, -0.5) + vec2<f32>(0.5);
+    let uv = select(sphereUv, inputUv, stereo.visualizeInput != 0u);
+    return textureSampleLevel(videoTexture, videoSampler,
+                              eye.uvRect.xy + fract(uv) * eye.uvRect.zw, 0.0);
+  }
+);
+// clang-format on
+
 // Other variables
 static const char* example_title = "Immersive Video";
 static bool prepared             = false;
@@ -129,6 +256,18 @@ static void prepare_video_texture(wgpu_context_t* wgpu_context)
                             .maxAnisotropy = 1,
                           });
   ASSERT(video_texture.sampler != NULL);
+
+  // Let the decoder scale the frames straight into the staging buffers
+  video_texture.upload = wgpu_video_upload_create(
+    wgpu_context, &(wgpu_video_upload_desc_t){
+                    .width        = (uint32_t)video_info.frame_size.width,
+                    .height       = (uint32_t)video_info.frame_size.height,
+                    .format       = VideoFrameFormat_RGBA8,
+                    .buffer_count = 3,
+                  });
+  video_frame_sink_t sink
+    = wgpu_video_upload_get_frame_sink(video_texture.upload);
+  video_decoder_set_frame_sink(video_info.decoder, &sink);
 }
 
 static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
@@ -209,6 +348,13 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
   };
   bind_group = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
   ASSERT(bind_group != NULL);
+
+  // Stereo bind group, with the stereo uniform block
+  bg_entries[0].buffer = uniform_buffer_stereo.buffer;
+  bg_entries[0].size   = uniform_buffer_stereo.size;
+  bg_desc.label        = "Immersive video stereo bind group";
+  stereo_bind_group = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
+  ASSERT(stereo_bind_group != NULL);
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -243,6 +389,53 @@ static bool window_resized(wgpu_context_t* wgpu_context)
              != (uint32_t)wgpu_context->surface.height);
 }
 
+/*
+ * Per-eye matrices from the clip space of the eye to its view rays. The view
+ * is centered like the mono shader centers it on the mouse, every eye covers
+ * the field of view over half of the viewport. The eyes share the rotation of
+ * the view, a 360-degree video is at infinity.
+ */
+static void update_stereo_uniform_buffer(wgpu_context_t* wgpu_context)
+{
+  const float yaw
+    = (shader_inputs_ubo.iMouse[0] / shader_inputs_ubo.iResolution[0] - 0.5f)
+      * 2.0f * PI;
+  const float pitch
+    = clamp_float(
+        0.5f - shader_inputs_ubo.iMouse[1] / shader_inputs_ubo.iResolution[1],
+        -0.495f, 0.495f)
+      * PI;
+  vec3 forward = {cosf(pitch) * sinf(yaw), sinf(pitch),
+                  -cosf(pitch) * cosf(yaw)};
+  mat4 view_matrix = GLM_MAT4_IDENTITY_INIT;
+  glm_lookat((vec3){0.0f, 0.0f, 0.0f}, forward, (vec3){0.0f, 1.0f, 0.0f},
+             view_matrix);
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    // The inverse of the rotation, scaled to the field of view
+    mat4* ray_matrix = &stereo_ubo.eyes[i].ray_matrix;
+    glm_mat4_transpose_to(view_matrix, *ray_matrix);
+    glm_scale(*ray_matrix,
+              (vec3){tanf(glm_rad(shader_inputs_ubo.iHFovDegrees) * 0.5f),
+                     tanf(glm_rad(shader_inputs_ubo.iVFovDegrees) * 0.5f),
+                     -1.0f});
+
+    // The left eye samples the top half of a top-bottom video
+    if (stereo.video_layout == VideoLayout_TopBottom) {
+      glm_vec4_copy((vec4){0.0f, 0.5f * i, 1.0f, 0.5f},
+                    stereo_ubo.eyes[i].uv_rect);
+    }
+    else {
+      glm_vec4_copy((vec4){0.0f, 0.0f, 1.0f, 1.0f},
+                    stereo_ubo.eyes[i].uv_rect);
+    }
+  }
+  stereo_ubo.visualize_input = shader_inputs_ubo.iVisualizeInput ? 1u : 0u;
+
+  wgpu_queue_write_buffer(wgpu_context, uniform_buffer_stereo.buffer, 0,
+                          &stereo_ubo, uniform_buffer_stereo.size);
+}
+
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   // iResolution: viewport resolution (in pixels)
@@ -278,6 +471,7 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
   if (shader_inputs_ubo_update_needed) {
     wgpu_queue_write_buffer(context->wgpu_context, uniform_buffer_vs.buffer, 0,
                             &shader_inputs_ubo, uniform_buffer_vs.size);
+    update_stereo_uniform_buffer(context->wgpu_context);
     shader_inputs_ubo_update_needed = false;
   }
 }
@@ -304,6 +498,12 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
       .size         = sizeof(shader_inputs_ubo),
       .initial.data = &shader_inputs_ubo,
     });
+  uniform_buffer_stereo = wgpu_create_buffer(
+    context->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = sizeof(stereo_ubo),
+    });
 
   update_uniform_buffers(context);
 }
@@ -371,38 +571,164 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   // Partial cleanup
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+
+  // Stereo pipeline
+  {
+    WGPUVertexState stereo_vertex_state = wgpu_create_vertex_state(
+                  wgpu_context, &(wgpu_vertex_state_t){
+                  .shader_desc = (wgpu_shader_desc_t){
+                    // Vertex shader WGSL
+                    .label            = "stereo_vertex_shader",
+                    .wgsl_code.source = stereo_shader_wgsl,
+                    .entry            = "vertexMain",
+                  },
+                  .buffer_count = 0,
+                  .buffers      = NULL,
+                });
+    WGPUFragmentState stereo_fragment_state = wgpu_create_fragment_state(
+                  wgpu_context, &(wgpu_fragment_state_t){
+                  .shader_desc = (wgpu_shader_desc_t){
+                    // Fragment shader WGSL
+                    .label            = "stereo_fragment_shader",
+                    .wgsl_code.source = stereo_shader_wgsl,
+                    .entry            = "fragmentMain",
+                  },
+                  .target_count = 1,
+                  .targets      = &color_target_state,
+                });
+
+    stereo_pipeline = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device,
+      &(WGPURenderPipelineDescriptor){
+        .label       = "immersive_video_stereo_render_pipeline",
+        .layout      = pipeline_layout,
+        .primitive   = primitive_state,
+        .vertex      = stereo_vertex_state,
+        .fragment    = &stereo_fragment_state,
+        .multisample = multisample_state,
+      });
+    ASSERT(stereo_pipeline != NULL);
+
+    WGPU_RELEASE_RESOURCE(ShaderModule, stereo_vertex_state.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, stereo_fragment_state.module);
+  }
 }
 
 static int prepare_video(const char* fname)
 {
-  init_video_decode();
-  open_video_file(fname);
+  video_info.decoder = video_decoder_create(&(video_decoder_desc_t){
+    .filename = fname,
+  });
+  ASSERT(video_info.decoder != NULL);
 
-  get_video_dimension(&video_info.frame_size.width,
-                      &video_info.frame_size.height);
+  video_decoder_get_dimension(video_info.decoder, &video_info.frame_size.width,
+                              &video_info.frame_size.height);
 
-  start_video_decode();
+  video_decoder_start(video_info.decoder);
 
   return 0;
 }
 
+/*
+ * Marks the tiles in view. The view is centered on the texture coordinates of
+ * the mouse as the fragment shader maps it: the horizontal mouse position
+ * spans the longitudes over the viewport width, the vertical one the
+ * latitudes over the viewport height. The longitudes in view widen towards
+ * the poles, all of them are in view when a pole is. Each half of a top-bottom
+ * stereo video spans all latitudes.
+ */
+static uint32_t get_tiles_in_view(bool visible[VIDEO_TILE_COUNT])
+{
+  const float u_center
+    = shader_inputs_ubo.iMouse[0] / shader_inputs_ubo.iResolution[0];
+  const float v_center = clamp_float(
+    shader_inputs_ubo.iMouse[1] / shader_inputs_ubo.iResolution[1], 0.0f,
+    1.0f);
+  const float v_half
+    = (shader_inputs_ubo.iVFovDegrees * 0.5f + VIEW_MARGIN_DEGREES) / 180.0f;
+  const float v_min = v_center - v_half;
+  const float v_max = v_center + v_half;
+
+  float u_half = 0.5f;
+  if (v_min > 0.0f && v_max < 1.0f) {
+    const float latitude
+      = MAX(fabsf(v_min - 0.5f), fabsf(v_max - 0.5f)) * PI;
+    u_half = (shader_inputs_ubo.iHFovDegrees * 0.5f + VIEW_MARGIN_DEGREES)
+             / 360.0f / cosf(latitude);
+  }
+
+  // The rows of both halves of a top-bottom video span all latitudes
+  const bool top_bottom
+    = stereo.enabled && stereo.video_layout == VideoLayout_TopBottom;
+  const float row_height = (top_bottom ? 2.0f : 1.0f) / VIDEO_TILE_ROWS;
+
+  uint32_t visible_count = 0;
+  for (uint32_t row = 0; row < VIDEO_TILE_ROWS; ++row) {
+    const float row_v = fmodf(row * row_height, 1.0f);
+    const bool row_visible = row_v + row_height > v_min && row_v < v_max;
+    for (uint32_t column = 0; column < VIDEO_TILE_COLUMNS; ++column) {
+      // Distance between the tile center and the view center around the
+      // sphere
+      float du = (column + 0.5f) / VIDEO_TILE_COLUMNS - u_center;
+      du       = fabsf(du - floorf(du + 0.5f));
+      const bool tile_visible
+        = row_visible
+          && (u_half >= 0.5f || du <= u_half + 0.5f / VIDEO_TILE_COLUMNS);
+      visible[row * VIDEO_TILE_COLUMNS + column] = tile_visible;
+      visible_count += tile_visible ? 1 : 0;
+    }
+  }
+  return visible_count;
+}
+
 static int update_capture_texture(wgpu_context_t* wgpu_context)
 {
-  int video_w, video_h;
-  void* video_buf;
-
-  get_video_dimension(&video_w, &video_h);
-  get_video_buffer(&video_buf);
-
-  if (video_buf) {
-    wgpu_image_to_texure(wgpu_context, video_texture.texture,
-                         (uint8_t*)video_buf,
-                         (WGPUExtent3D){
-                           .width              = video_info.frame_size.width,
-                           .height             = video_info.frame_size.height,
-                           .depthOrArrayLayers = 1,
-                         },
-                         4u);
+  UNUSED_VAR(wgpu_context);
+
+  // Copy the latest decoded frame from its staging buffer into the texture
+  if (!tiled_upload.enabled) {
+    wgpu_video_upload_update(video_texture.upload, video_texture.texture,
+                             NULL);
+    return 0;
+  }
+
+  // Copy the tiles in view and the hidden tiles whose turn it is, the
+  // consecutive tiles of a row in one region
+  bool visible[VIDEO_TILE_COUNT];
+  tiled_upload.visible_tile_count = get_tiles_in_view(visible);
+  const uint32_t width  = (uint32_t)video_info.frame_size.width;
+  const uint32_t height = (uint32_t)video_info.frame_size.height;
+  const uint32_t tile_width
+    = (width + VIDEO_TILE_COLUMNS - 1) / VIDEO_TILE_COLUMNS;
+  const uint32_t tile_height = (height + VIDEO_TILE_ROWS - 1) / VIDEO_TILE_ROWS;
+  const uint32_t turn
+    = tiled_upload.frame_index % HIDDEN_TILE_REFRESH_INTERVAL;
+
+  wgpu_video_upload_region_t regions[VIDEO_TILE_COUNT];
+  uint32_t region_count = 0;
+  for (uint32_t row = 0; row < VIDEO_TILE_ROWS; ++row) {
+    wgpu_video_upload_region_t* region = NULL;
+    for (uint32_t column = 0; column < VIDEO_TILE_COLUMNS; ++column) {
+      const uint32_t tile = row * VIDEO_TILE_COLUMNS + column;
+      if (!visible[tile] && tile % HIDDEN_TILE_REFRESH_INTERVAL != turn) {
+        region = NULL;
+        continue;
+      }
+      if (region == NULL) {
+        region  = &regions[region_count++];
+        *region = (wgpu_video_upload_region_t){
+          .x      = column * tile_width,
+          .y      = row * tile_height,
+          .height = tile_height,
+        };
+      }
+      region->width += tile_width;
+    }
+  }
+  if (wgpu_video_upload_update_regions(video_texture.upload,
+                                       video_texture.texture, NULL, regions,
+                                       region_count)) {
+    ++tiled_upload.frame_index;
   }
 
   return 0;
@@ -447,6 +773,22 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
                                &shader_inputs_ubo.iVisualizeInput)) {
       shader_inputs_ubo_update_needed = true;
     }
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Stereo",
+                               &stereo.enabled)) {
+      shader_inputs_ubo_update_needed = true;
+    }
+    if (stereo.enabled
+        && imgui_overlay_combo_box(context->imgui_overlay, "Video layout",
+                                   &stereo.video_layout, video_layout_names,
+                                   VideoLayout_COUNT)) {
+      shader_inputs_ubo_update_needed = true;
+    }
+    imgui_overlay_checkBox(context->imgui_overlay, "Tiled upload",
+                           &tiled_upload.enabled);
+    if (tiled_upload.enabled) {
+      imgui_overlay_text("Tiles in view: %u / %u",
+                         tiled_upload.visible_tile_count, VIDEO_TILE_COUNT);
+    }
   }
 }
 
@@ -464,11 +806,13 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     wgpu_context->cmd_enc, &render_pass.descriptor);
 
   // Bind the rendering pipeline
-  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
+  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
+                                   stereo.enabled ? stereo_pipeline : pipeline);
 
   // Set the bind group
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0, bind_group, 0,
-                                    0);
+  wgpuRenderPassEncoderSetBindGroup(
+    wgpu_context->rpass_enc, 0, stereo.enabled ? stereo_bind_group : bind_group,
+    0, 0);
 
   // Set viewport
   wgpuRenderPassEncoderSetViewport(
@@ -480,8 +824,13 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                       wgpu_context->surface.width,
                                       wgpu_context->surface.height);
 
-  // Draw quad
-  wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
+  // Draw quad, or a quad per eye as an instance
+  if (stereo.enabled) {
+    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 6, 2, 0, 0);
+  }
+  else {
+    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
+  }
 
   // End render pass
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
@@ -536,14 +885,19 @@ static int example_render(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
+  video_decoder_release(video_info.decoder);
+  wgpu_video_upload_release(video_texture.upload);
   WGPU_RELEASE_RESOURCE(Texture, video_texture.texture)
   WGPU_RELEASE_RESOURCE(TextureView, video_texture.view)
   WGPU_RELEASE_RESOURCE(Sampler, video_texture.sampler)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer_vs.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer_stereo.buffer)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, stereo_bind_group)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, stereo_pipeline)
 }
 
 void example_immersive_video(int argc, char* argv[])
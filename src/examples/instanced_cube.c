@@ -10,22 +10,82 @@
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Instanced Cube
  *
- * This example shows the use of instancing.
+ * This example shows the use of instancing. The model view projection
+ * matrices of the instances are computed in a compute pass into a storage
+ * buffer, which the vertex shader indexes with the instance index, so that
+ * the instance count is only limited by the storage buffer binding size.
+ *
+ * The instance count is picked in the settings or with --instances=<n>.
  *
  * Ref:
  * https://github.com/austinEng/webgpu-samples/blob/main/src/sample/instancedCube
  * -------------------------------------------------------------------------- */
 
-#define MAX_NUM_INSTANCES 16
+#define DEFAULT_NUM_INSTANCES 16u
+// 128MB storage buffer binding of 64 bytes matrices
+#define MAX_NUM_INSTANCES 2097152u
+
+#define INSTANCES_WORKGROUP_SIZE 64u
 
 // Shaders
 // clang-format off
-static const char* instanced_vertex_shader_wgsl = CODE(
-  struct Uniforms {
-    modelViewProjectionMatrix : array<mat4x4<f32>, 16>,
+static const char* instances_compute_shader_wgsl = CODE(
+  struct Params {
+    viewProjectionMatrix : mat4x4<f32>,
+    time : f32,
+    count : u32,
+    side : u32,
+    step : f32,
+  }
+
+  @binding(0) @group(0) var<uniform> params : Params;
+  @binding(1) @group(0) var<storage, read_write> modelViewProjectionMatrices :
+    array<mat4x4<f32>>;
+
+  // Rotation about a normalized axis
+  fn rotation(axis : vec3<f32>, angle : f32) -> mat4x4<f32> {
+    let c = cos(angle);
+    let s = sin(angle);
+    let t = axis * (1.0 - c);
+    return mat4x4<f32>(
+      vec4<f32>(t.x * axis.x + c, t.x * axis.y + s * axis.z,
+                t.x * axis.z - s * axis.y, 0.0),
+      vec4<f32>(t.y * axis.x - s * axis.z, t.y * axis.y + c,
+                t.y * axis.z + s * axis.x, 0.0),
+      vec4<f32>(t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x,
+                t.z * axis.z + c, 0.0),
+      vec4<f32>(0.0, 0.0, 0.0, 1.0)
+    );
+  }
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= params.count) {
+      return;
+    }
+    // Instances are laid out in columns of side cubes, centered on the origin
+    let x = f32(index / params.side);
+    let y = f32(index % params.side);
+    let center = f32(params.side) * 0.5 - 0.5;
+    let scale = params.step / 4.0;
+    let translation = mat4x4<f32>(
+      vec4<f32>(scale, 0.0, 0.0, 0.0),
+      vec4<f32>(0.0, scale, 0.0, 0.0),
+      vec4<f32>(0.0, 0.0, scale, 0.0),
+      vec4<f32>(params.step * (x - center), params.step * (y - center), 0.0,
+                1.0)
+    );
+    let axis = normalize(vec3<f32>(sin((x + 0.5) * params.time),
+                                   cos((y + 0.5) * params.time), 0.0));
+    let model = translation * rotation(axis, 1.0);
+    modelViewProjectionMatrices[index] = params.viewProjectionMatrix * model;
   }
+);
 
-  @binding(0) @group(0) var<uniform> uniforms : Uniforms;
+static const char* instanced_vertex_shader_wgsl = CODE(
+  @binding(0) @group(0) var<storage, read> modelViewProjectionMatrices :
+    array<mat4x4<f32>>;
 
   struct VertexOutput {
     @builtin(position) Position : vec4<f32>,
@@ -40,7 +100,7 @@ static const char* instanced_vertex_shader_wgsl = CODE(
     @location(1) uv : vec2<f32>
   ) -> VertexOutput {
     var output : VertexOutput;
-    output.Position = uniforms.modelViewProjectionMatrix[instanceIdx] * position;
+    output.Position = modelViewProjectionMatrices[instanceIdx] * position;
     output.fragUV = uv;
     output.fragPosition = 0.5 * (position + vec4<f32>(1.0, 1.0, 1.0, 1.0));
     return output;
@@ -48,12 +108,18 @@ static const char* instanced_vertex_shader_wgsl = CODE(
 );
 // clang-format on
 
-static const uint32_t x_count             = 4;
-static const uint32_t y_count             = 4;
-static const uint32_t num_instances       = x_count * y_count;
-static const uint32_t matrix_float_count  = 16; // 4x4 matrix
-static const uint32_t matrix_size         = 4 * matrix_float_count;
-static const uint32_t uniform_buffer_size = num_instances * matrix_size;
+// Instance resources are recreated when the instance count is changed
+static struct {
+  uint32_t num_instances;
+  bool changed;
+} instancing = {
+  .num_instances = DEFAULT_NUM_INSTANCES,
+  .changed       = false,
+};
+
+static const char* num_instances_names[5] = {
+  "16", "1024", "65536", "1048576", "2097152",
+};
 
 // Cube mesh
 static cube_mesh_t cube_mesh      = {0};
@@ -62,21 +128,32 @@ static uint32_t cube_vertex_count = 36;
 // Vertex buffer
 static wgpu_buffer_t vertices = {0};
 
-// Uniform buffer object
+// Parameters of the compute pass, the instances are laid out in a square
 static struct {
-  wgpu_buffer_t buffer;
-  WGPUBindGroup bind_group;
-} uniform_buffer = {0};
+  mat4 view_projection;
+  float time;
+  uint32_t count;
+  uint32_t side;
+  float step;
+} instances_params = {0};
 
 static struct {
   mat4 projection;
   mat4 view;
-  mat4 model[MAX_NUM_INSTANCES];
-  float model_view_projection[16 * MAX_NUM_INSTANCES];
-  mat4 tmp;
 } view_matrices = {0};
 
-// Pipeline
+// Uniform buffer of the parameters and storage buffer of the matrices
+static wgpu_buffer_t params_buffer    = {0};
+static wgpu_buffer_t instances_buffer = {0};
+
+// Bind groups
+static struct {
+  WGPUBindGroup compute;
+  WGPUBindGroup render;
+} bind_groups = {0};
+
+// Pipelines
+static WGPUComputePipeline compute_pipeline;
 static WGPURenderPipeline pipeline;
 
 // Render pass descriptor for frame buffer writes
@@ -132,41 +209,14 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
   };
 }
 
-static void update_transformation_matrix(wgpu_example_context_t* context)
-{
-  const float now = context->frame.timestamp_millis / 1000.0f;
-
-  uint32_t m = 0, i = 0;
-  for (uint32_t x = 0; x < x_count; x++) {
-    for (uint32_t y = 0; y < y_count; y++) {
-      memcpy(view_matrices.tmp, view_matrices.model[i], sizeof(mat4));
-      glm_rotate(view_matrices.tmp, 1.0f,
-                 (vec3){
-                   sin(((float)x + 0.5f) * now), // x
-                   cos(((float)y + 0.5f) * now), // y
-                   0.0f                          // z
-                 });
-
-      glm_mat4_mul(view_matrices.view, view_matrices.tmp, view_matrices.tmp);
-      glm_mat4_mul(view_matrices.projection, view_matrices.tmp,
-                   view_matrices.tmp);
-
-      memcpy(&view_matrices.model_view_projection[m], view_matrices.tmp,
-             sizeof(view_matrices.tmp));
-
-      ++i;
-      m += matrix_float_count;
-    }
-  }
-}
-
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
-  update_transformation_matrix(context);
+  if (!context->paused) {
+    instances_params.time = context->frame.timestamp_millis / 1000.0f;
+  }
 
-  wgpu_queue_write_buffer(context->wgpu_context, uniform_buffer.buffer.buffer,
-                          0, &view_matrices.model_view_projection,
-                          uniform_buffer.buffer.size);
+  wgpu_queue_write_buffer(context->wgpu_context, params_buffer.buffer, 0,
+                          &instances_params, params_buffer.size);
 }
 
 static void prepare_view_matrices(wgpu_context_t* wgpu_context)
@@ -183,28 +233,8 @@ static void prepare_view_matrices(wgpu_context_t* wgpu_context)
   glm_mat4_identity(view_matrices.view);
   glm_translate(view_matrices.view, (vec3){0.0f, 0.0f, -12.0f});
 
-  // Temporary matrix
-  glm_mat4_identity(view_matrices.tmp);
-}
-
-static void prepare_model_matrices()
-{
-  const float step = 4.0f;
-
-  // Initialize the matrix data for every instance.
-  uint32_t m = 0;
-  for (uint32_t x = 0; x < x_count; x++) {
-    for (uint32_t y = 0; y < y_count; y++) {
-      glm_mat4_identity(view_matrices.model[m]);
-      glm_translate(view_matrices.model[m],
-                    (vec3){
-                      step * (x - x_count / 2.0f + 0.5f), // x
-                      step * (y - y_count / 2.0f + 0.5f), // y
-                      0.0f                                // z
-                    });
-      ++m;
-    }
-  }
+  glm_mat4_mul(view_matrices.projection, view_matrices.view,
+               instances_params.view_projection);
 }
 
 static void prepare_uniform_buffer(wgpu_context_t* wgpu_context)
@@ -212,35 +242,102 @@ static void prepare_uniform_buffer(wgpu_context_t* wgpu_context)
   // Camera
   prepare_view_matrices(wgpu_context);
 
-  // Unform buffer: allocate a buffer large enough to hold transforms for every
-  // instance.
-  uniform_buffer.buffer = wgpu_create_buffer(
+  params_buffer = wgpu_create_buffer(
     wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Instances params buffer",
                     .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-                    .size  = uniform_buffer_size,
+                    .size  = sizeof(instances_params),
                   });
 }
 
-static void setup_bind_groups(wgpu_context_t* wgpu_context)
+// Creates the matrices of the instances and the bind groups referencing them
+static void prepare_instances(wgpu_context_t* wgpu_context)
 {
-  // Uniform bind group
+  // The 4x4 instances of the original sample span 16 units, larger counts
+  // shrink the cubes to keep the square in view
+  const uint32_t count   = instancing.num_instances;
+  instances_params.count = count;
+  instances_params.side  = (uint32_t)ceilf(sqrtf((float)count));
+  instances_params.step  = 16.0f / (float)instances_params.side;
+
+  instances_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Instances matrices buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = count * sizeof(mat4),
+                  });
+
+  // Compute bind group
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = params_buffer.buffer,
+      .offset  = 0,
+      .size    = params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = instances_buffer.buffer,
+      .offset  = 0,
+      .size    = instances_buffer.size,
+    },
+  };
+  bind_groups.compute = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label  = "Instances compute bind group",
+      .layout = wgpuComputePipelineGetBindGroupLayout(compute_pipeline, 0),
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(bind_groups.compute != NULL);
+
+  // Render bind group
   WGPUBindGroupDescriptor bg_desc = {
     .label      = "cube_bind_group",
     .layout     = wgpuRenderPipelineGetBindGroupLayout(pipeline, 0),
     .entryCount = 1,
     .entries    = &(WGPUBindGroupEntry) {
       .binding = 0,
-      .buffer  = uniform_buffer.buffer.buffer,
+      .buffer  = instances_buffer.buffer,
       .offset  = 0,
-      .size    = uniform_buffer.buffer.size,
+      .size    = instances_buffer.size,
     },
   };
-  uniform_buffer.bind_group
+  bind_groups.render
     = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-  ASSERT(uniform_buffer.bind_group != NULL);
+  ASSERT(bind_groups.render != NULL);
+}
+
+static void release_instances(void)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.compute)
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.render)
+  WGPU_RELEASE_RESOURCE(Buffer, instances_buffer.buffer)
+}
+
+static void prepare_compute_pipeline(wgpu_context_t* wgpu_context)
+{
+  // Compute shader
+  wgpu_shader_t instances_comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "instances_compute_shader_wgsl",
+                    .wgsl_code.source = instances_compute_shader_wgsl,
+                    .entry            = "main",
+                  });
+
+  // Create compute pipeline
+  compute_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "instances_compute_pipeline",
+      .compute = instances_comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(compute_pipeline != NULL);
 
-  // Model matrices
-  prepare_model_matrices();
+  // Partial cleanup
+  wgpu_shader_release(&instances_comp_shader);
 }
 
 static void prepare_pipeline(wgpu_context_t* wgpu_context)
@@ -332,9 +429,10 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     prepare_cube_mesh();
     prepare_vertex_buffer(context->wgpu_context);
+    prepare_compute_pipeline(context->wgpu_context);
     prepare_pipeline(context->wgpu_context);
     prepare_uniform_buffer(context->wgpu_context);
-    setup_bind_groups(context->wgpu_context);
+    prepare_instances(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
     return 0;
@@ -343,10 +441,28 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static int32_t get_num_instances_index(uint32_t num_instances)
+{
+  for (uint32_t i = 0; i < ARRAY_SIZE(num_instances_names); ++i) {
+    if ((uint32_t)atoi(num_instances_names[i]) == num_instances) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    int32_t num_instances_index
+      = get_num_instances_index(instancing.num_instances);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Instances",
+                                &num_instances_index, num_instances_names,
+                                ARRAY_SIZE(num_instances_names))) {
+      instancing.num_instances = atoi(num_instances_names[num_instances_index]);
+      instancing.changed       = true;
+    }
   }
 }
 
@@ -356,6 +472,21 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+
+  // Compute the matrices of the instances
+  wgpu_context->cpass_enc
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc, compute_pipeline);
+  wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
+                                     bind_groups.compute, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    wgpu_context->cpass_enc,
+    (instancing.num_instances + INSTANCES_WORKGROUP_SIZE - 1)
+      / INSTANCES_WORKGROUP_SIZE,
+    1, 1);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass.descriptor);
   wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
@@ -363,9 +494,9 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                        vertices.buffer, 0, WGPU_WHOLE_SIZE);
 
   wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                    uniform_buffer.bind_group, 0, 0);
+                                    bind_groups.render, 0, 0);
   wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, cube_vertex_count,
-                            num_instances, 0, 0);
+                            instancing.num_instances, 0, 0);
 
   // End render pass
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
@@ -407,9 +538,16 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  if (instancing.changed) {
+    release_instances();
+    prepare_instances(context->wgpu_context);
+    instancing.changed = false;
+  }
+  update_uniform_buffers(context);
   const int draw_result = example_draw(context);
-  if (!context->paused) {
-    update_uniform_buffers(context);
+  if (context->benchmark.instance != NULL) {
+    benchmark_record_counter(context->benchmark.instance, "instances",
+                             (double)instancing.num_instances);
   }
   return draw_result;
 }
@@ -417,14 +555,29 @@ static int example_render(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
-  WGPU_RELEASE_RESOURCE(BindGroup, uniform_buffer.bind_group)
-  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer.buffer.buffer)
+  release_instances();
+  WGPU_RELEASE_RESOURCE(Buffer, params_buffer.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, compute_pipeline)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
 }
 
+static void parse_instancing_arguments(int argc, char* argv[])
+{
+  static const char instances_option[] = "--instances=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], instances_option, strlen(instances_option)) == 0) {
+      const uint32_t num_instances
+        = (uint32_t)strtoul(argv[i] + strlen(instances_option), NULL, 10);
+      instancing.num_instances = CLAMP(num_instances, 1u, MAX_NUM_INSTANCES);
+    }
+  }
+}
+
 void example_instanced_cube(int argc, char* argv[])
 {
+  parse_instancing_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
@@ -5,6 +5,9 @@
 
 #include "../core/log.h"
 #include "../core/macro.h"
+#include "../core/mesh_cache.h"
+#include "../core/mesh_optimizer.h"
+#include "../webgpu/mesh_buffer.h"
 
 /* -------------------------------------------------------------------------- *
  * Plane mesh
@@ -278,11 +281,88 @@ static int face_cb(p_ply_argument argument)
   return 1;
 }
 
+#define STANFORD_DRAGON_MESH_FILENAME "meshes/dragon_vrip_res4.ply"
+
+static void stanford_dragon_mesh_get_cache_filename(char* cache_filename)
+{
+  file_get_cache_filename(MESH_CACHE_DIRECTORY, STANFORD_DRAGON_MESH_FILENAME,
+                          MESH_CACHE_FILE_EXTENSION, cache_filename, STRMAX);
+}
+
+typedef enum stanford_dragon_mesh_stream_enum {
+  StanfordDragonMeshStream_POSITIONS = 0,
+  StanfordDragonMeshStream_NORMALS   = 1,
+  StanfordDragonMeshStream_UVS       = 2,
+  StanfordDragonMeshStream_INDICES   = 3,
+  StanfordDragonMeshStream_COUNT     = 4,
+} stanford_dragon_mesh_stream_enum;
+
+static void
+stanford_dragon_mesh_get_streams(stanford_dragon_mesh_t* stanford_dragon_mesh,
+                                 mesh_cache_stream_t* streams)
+{
+  streams[StanfordDragonMeshStream_POSITIONS] = (mesh_cache_stream_t){
+    .data = stanford_dragon_mesh->positions.data,
+    .size = sizeof(stanford_dragon_mesh->positions.data),
+  };
+  streams[StanfordDragonMeshStream_NORMALS] = (mesh_cache_stream_t){
+    .data = stanford_dragon_mesh->normals.data,
+    .size = sizeof(stanford_dragon_mesh->normals.data),
+  };
+  streams[StanfordDragonMeshStream_UVS] = (mesh_cache_stream_t){
+    .data = stanford_dragon_mesh->uvs.data,
+    .size = sizeof(stanford_dragon_mesh->uvs.data),
+  };
+  streams[StanfordDragonMeshStream_INDICES] = (mesh_cache_stream_t){
+    .data = stanford_dragon_mesh->triangles.data,
+    .size = sizeof(stanford_dragon_mesh->triangles.data),
+  };
+}
+
+/*
+ * Fills the mesh from its cache file, skipping the PLY parsing and the
+ * optimization, normal and uv passes. Returns false if there is no valid cache
+ * for the PLY file.
+ */
+static bool
+stanford_dragon_mesh_load_cache(stanford_dragon_mesh_t* stanford_dragon_mesh)
+{
+  mesh_cache_stream_t expected[StanfordDragonMeshStream_COUNT];
+  mesh_cache_stream_t streams[StanfordDragonMeshStream_COUNT];
+  file_mapping_t mapping = {0};
+  char cache_filename[STRMAX];
+  stanford_dragon_mesh_get_cache_filename(cache_filename);
+  if (!mesh_cache_map(cache_filename, STANFORD_DRAGON_MESH_FILENAME, &mapping,
+                      streams, StanfordDragonMeshStream_COUNT)) {
+    return false;
+  }
+  stanford_dragon_mesh_get_streams(stanford_dragon_mesh, expected);
+  bool valid = true;
+  for (uint32_t i = 0; i < StanfordDragonMeshStream_COUNT; ++i) {
+    valid = valid && (streams[i].size == expected[i].size);
+  }
+  if (valid) {
+    for (uint32_t i = 0; i < StanfordDragonMeshStream_COUNT; ++i) {
+      memcpy((void*)expected[i].data, streams[i].data, streams[i].size);
+    }
+    stanford_dragon_mesh->positions.count = POSITION_COUNT_RES_4;
+    stanford_dragon_mesh->normals.count   = POSITION_COUNT_RES_4;
+    stanford_dragon_mesh->uvs.count       = POSITION_COUNT_RES_4;
+    stanford_dragon_mesh->triangles.count = CELL_COUNT_RES_4;
+  }
+  file_unmap(&mapping);
+  return valid;
+}
+
 int stanford_dragon_mesh_init(stanford_dragon_mesh_t* stanford_dragon_mesh)
 {
   ASSERT(stanford_dragon_mesh)
 
-  p_ply ply = ply_open("meshes/dragon_vrip_res4.ply", NULL, 0, NULL);
+  if (stanford_dragon_mesh_load_cache(stanford_dragon_mesh)) {
+    return 0;
+  }
+
+  p_ply ply = ply_open(STANFORD_DRAGON_MESH_FILENAME, NULL, 0, NULL);
   if (!ply) {
     return 1;
   }
@@ -314,6 +394,25 @@ int stanford_dragon_mesh_init(stanford_dragon_mesh_t* stanford_dragon_mesh)
   debug_print(stanford_dragon_mesh);
 #endif
 
+  // Reorder the triangles for the vertex cache and less overdraw, the 16-bit
+  // indices are widened for the optimizer
+  {
+    const uint32_t index_count
+      = (uint32_t)stanford_dragon_mesh->triangles.count * 3;
+    uint16_t* triangles = &stanford_dragon_mesh->triangles.data[0][0];
+    uint32_t* indices   = malloc(index_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < index_count; ++i) {
+      indices[i] = triangles[i];
+    }
+    mesh_optimize_triangle_order(
+      indices, index_count, (uint32_t)stanford_dragon_mesh->positions.count,
+      &stanford_dragon_mesh->positions.data[0][0], sizeof(float) * 3);
+    for (uint32_t i = 0; i < index_count; ++i) {
+      triangles[i] = (uint16_t)indices[i];
+    }
+    free(indices);
+  }
+
   // Compute surface normals
   stanford_dragon_mesh_compute_normals(stanford_dragon_mesh);
 
@@ -321,6 +420,16 @@ int stanford_dragon_mesh_init(stanford_dragon_mesh_t* stanford_dragon_mesh)
   stanford_dragon_mesh_compute_projected_plane_uvs(stanford_dragon_mesh,
                                                    ProjectedPlane_XY);
 
+  // Cache the streams for the next launches
+  {
+    mesh_cache_stream_t streams[StanfordDragonMeshStream_COUNT];
+    stanford_dragon_mesh_get_streams(stanford_dragon_mesh, streams);
+    char cache_filename[STRMAX];
+    stanford_dragon_mesh_get_cache_filename(cache_filename);
+    mesh_cache_write(cache_filename, STANFORD_DRAGON_MESH_FILENAME, streams,
+                     StanfordDragonMeshStream_COUNT);
+  }
+
   return 0;
 }
 
@@ -395,3 +504,45 @@ void stanford_dragon_mesh_compute_projected_plane_uvs(
     (*uv)[1] = ((*uv)[1] - extent_min[1]) / (extent_max[1] - extent_min[1]);
   }
 }
+
+uint32_t stanford_dragon_mesh_add_to_mesh_buffer(
+  stanford_dragon_mesh_t* stanford_dragon_mesh,
+  wgpu_mesh_buffer_t* mesh_buffer)
+{
+  const uint64_t vertex_count = stanford_dragon_mesh->positions.count;
+
+  // The streams are appended back to back, the attribute offsets are relative
+  // to the positions
+  const uint64_t positions_offset = wgpu_mesh_buffer_add_vertex_data(
+    mesh_buffer, stanford_dragon_mesh->positions.data,
+    vertex_count * sizeof(float) * 3);
+  const uint64_t normals_offset = wgpu_mesh_buffer_add_vertex_data(
+    mesh_buffer, stanford_dragon_mesh->normals.data,
+    vertex_count * sizeof(float) * 3);
+  const uint64_t uvs_offset = wgpu_mesh_buffer_add_vertex_data(
+    mesh_buffer, stanford_dragon_mesh->uvs.data,
+    vertex_count * sizeof(float) * 2);
+
+  wgpu_mesh_desc_t desc = {
+    .vertex_offset = positions_offset,
+    .indices       = stanford_dragon_mesh->triangles.data,
+    .index_count   = (uint32_t)stanford_dragon_mesh->triangles.count * 3,
+    .index_size    = sizeof(uint16_t),
+  };
+  desc.attributes[WGPU_MeshAttribute_Position] = (wgpu_mesh_attribute_t){
+    .format = WGPU_MeshAttributeFormat_Float32x3,
+    .offset = 0,
+    .stride = sizeof(float) * 3,
+  };
+  desc.attributes[WGPU_MeshAttribute_Normal] = (wgpu_mesh_attribute_t){
+    .format = WGPU_MeshAttributeFormat_Float32x3,
+    .offset = (uint32_t)(normals_offset - positions_offset),
+    .stride = sizeof(float) * 3,
+  };
+  desc.attributes[WGPU_MeshAttribute_UV] = (wgpu_mesh_attribute_t){
+    .format = WGPU_MeshAttributeFormat_Float32x2,
+    .offset = (uint32_t)(uvs_offset - positions_offset),
+    .stride = sizeof(float) * 2,
+  };
+  return wgpu_mesh_buffer_add_mesh(mesh_buffer, &desc);
+}
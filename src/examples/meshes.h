@@ -133,4 +133,15 @@ void stanford_dragon_mesh_compute_projected_plane_uvs(
   stanford_dragon_mesh_t* stanford_dragon_mesh,
   projected_plane_enum projected_plane);
 
+struct wgpu_mesh_buffer;
+
+/**
+ * @brief Appends the positions, normals and uvs as separate streams and the
+ * 16-bit triangle indices to a mesh buffer for vertex pulling.
+ * @return the mesh index in the mesh buffer
+ */
+uint32_t stanford_dragon_mesh_add_to_mesh_buffer(
+  stanford_dragon_mesh_t* stanford_dragon_mesh,
+  struct wgpu_mesh_buffer* mesh_buffer);
+
 #endif /* MESHES_H */
@@ -10,8 +10,9 @@
  *
  * The parts of this example enabling MSAA are:
  * *    The render pipeline is created with a sample_count > 1.
- * *    A new texture with a sample_count > 1 is created and set as the
- *      color_attachment instead of the swapchain.
+ * *    A texture with a sample_count > 1 is set as the color_attachment
+ *      instead of the swapchain, the shared multisampled attachment of the
+ *      context whose samples are discarded after the pass.
  * *    The swapchain is now specified as a resolve_target.
  *
  * The parts of this example enabling LineList are:
@@ -39,17 +40,13 @@ static WGPUPipelineLayout pipeline_layout;
 // Pipeline
 static WGPURenderPipeline pipeline;
 
-// Render pass descriptor for frame buffer writes
+// Render pass descriptor for frame buffer writes, without MSAA
 static WGPURenderPassColorAttachment rp_color_att_descriptors[1];
 static WGPURenderPassDescriptor render_pass_desc;
 
 // Render bundle
 static WGPURenderBundle render_bundle;
 
-// Multi-sampled texture
-static WGPUTexture multisampled_texture;
-static WGPUTextureView multisampled_framebuffer;
-
 // Other variables
 static const char* example_title = "MSAA Line";
 static bool prepared             = false;
@@ -82,40 +79,6 @@ static void prepare_vertex_buffer(wgpu_context_t* wgpu_context)
                   });
 }
 
-static void create_multisampled_framebuffer(wgpu_context_t* wgpu_context)
-{
-  // Create the multi-sampled texture
-  WGPUTextureDescriptor multisampled_frame_desc = {
-    .label         = "Multi-sampled texture",
-    .size          = (WGPUExtent3D){
-      .width               = wgpu_context->surface.width,
-      .height              = wgpu_context->surface.height,
-      .depthOrArrayLayers  = 1,
-     },
-    .mipLevelCount = 1,
-    .sampleCount   = sample_count,
-    .dimension     = WGPUTextureDimension_2D,
-    .format        = wgpu_context->swap_chain.format,
-    .usage         = WGPUTextureUsage_RenderAttachment,
-  };
-  multisampled_texture
-    = wgpuDeviceCreateTexture(wgpu_context->device, &multisampled_frame_desc);
-  ASSERT(multisampled_texture != NULL);
-
-  // Create the multi-sampled texture view
-  multisampled_framebuffer = wgpuTextureCreateView(
-    multisampled_texture, &(WGPUTextureViewDescriptor){
-                            .label           = "Multi-sampled texture view",
-                            .format          = wgpu_context->swap_chain.format,
-                            .dimension       = WGPUTextureViewDimension_2D,
-                            .baseMipLevel    = 0,
-                            .mipLevelCount   = 1,
-                            .baseArrayLayer  = 0,
-                            .arrayLayerCount = 1,
-                          });
-  ASSERT(multisampled_framebuffer != NULL);
-}
-
 static void setup_render_bundle(wgpu_context_t* wgpu_context)
 {
   WGPURenderBundleEncoderDescriptor rbe_desc = {
@@ -138,7 +101,18 @@ static void setup_render_bundle(wgpu_context_t* wgpu_context)
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
 {
-  UNUSED_VAR(wgpu_context);
+  // Multisampled color attachment, resolved into the frame buffer
+  if (sample_count > 1) {
+    wgpu_setup_msaa_attachments(wgpu_context,
+                                &(wgpu_msaa_attachments_options_t){
+                                  .sample_count = sample_count,
+                                });
+    render_pass_desc = (WGPURenderPassDescriptor){
+      .colorAttachmentCount = 1,
+      .colorAttachments     = &wgpu_context->msaa.color_att_desc,
+    };
+    return;
+  }
 
   // Color attachment
   rp_color_att_descriptors[0] = (WGPURenderPassColorAttachment) {
@@ -249,7 +223,6 @@ static int example_initialize(wgpu_example_context_t* context)
     prepare_vertex_buffer(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
-    create_multisampled_framebuffer(context->wgpu_context);
     setup_render_bundle(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
@@ -264,11 +237,9 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   // Set target frame buffer
   if (sample_count == 1) {
     rp_color_att_descriptors[0].view = wgpu_context->swap_chain.frame_buffer;
-    rp_color_att_descriptors[0].resolveTarget = NULL;
   }
   else {
-    rp_color_att_descriptors[0].view = multisampled_framebuffer;
-    rp_color_att_descriptors[0].resolveTarget
+    wgpu_context->msaa.color_att_desc.resolveTarget
       = wgpu_context->swap_chain.frame_buffer;
   }
 
@@ -328,8 +299,6 @@ static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
   WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
-  WGPU_RELEASE_RESOURCE(Texture, multisampled_texture)
-  WGPU_RELEASE_RESOURCE(TextureView, multisampled_framebuffer)
   WGPU_RELEASE_RESOURCE(RenderBundle, render_bundle)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
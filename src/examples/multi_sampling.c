@@ -5,12 +5,22 @@
 
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/mesh_buffer.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Multisampling
  *
  * Implements multisample anti-aliasing (MSAA) using a renderpass with
  * multisampled attachment that get resolved into the visible frame buffer.
+ * The multisampled color and depth attachments are shared context attachments
+ * whose samples are discarded at the end of the render pass, only the
+ * resolved frame buffer is stored.
+ * The static model is recorded once per sample count into a render bundle that
+ * is replayed every frame. Its material textures are packed into texture
+ * arrays, the fragment shader reads the layer and the factor of each material
+ * from the material table of the model, selected by the material index.
+ * With vertex pulling, the primitives are drawn from a mesh buffer without
+ * vertex and index buffers, the vertex shader fetches their vertices.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/multisampling/multisampling.cpp
@@ -18,16 +28,151 @@
 
 static const uint32_t msaa_sample_count = 4;
 static bool use_msaa                    = false;
+static bool use_vertex_pulling          = false;
+
+// Shaders
+// clang-format off
+static const char* mesh_shader_wgsl = CODE(
+  struct UBO {
+    projection : mat4x4<f32>,
+    model : mat4x4<f32>,
+    lightPos : vec4<f32>,
+  };
 
-static struct {
-  struct {
-    WGPUTexture texture;
-    WGPUTextureView view;
-  } color;
-} multi_sample_target = {0};
+  struct MaterialIndex {
+    index : u32,
+  };
+
+  // wgpu_gltf_material_data_t
+  struct Material {
+    baseColorFactor : vec4<f32>,
+    emissiveFactor : vec4<f32>,
+    metallicFactor : f32,
+    roughnessFactor : f32,
+    alphaCutoff : f32,
+    alphaMode : u32,
+    baseColorLayer : u32,
+    metallicRoughnessLayer : u32,
+    normalLayer : u32,
+    occlusionLayer : u32,
+    emissiveLayer : u32,
+    padding0 : u32,
+    padding1 : u32,
+    padding2 : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> ubo : UBO;
+  @group(1) @binding(0) var colorMaps : texture_2d_array<f32>;
+  @group(1) @binding(1) var colorSampler : sampler;
+  @group(2) @binding(0) var<uniform> material : MaterialIndex;
+  @group(2) @binding(1) var<storage, read> materials : array<Material>;
+
+  struct VertexInput {
+    @location(0) position : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) color : vec3<f32>,
+  };
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) normal : vec3<f32>,
+    @location(1) color : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) viewVec : vec3<f32>,
+    @location(4) lightVec : vec3<f32>,
+  };
+
+  @vertex
+  fn vs_main(input : VertexInput) -> VertexOutput {
+    var output : VertexOutput;
+    let pos = ubo.model * vec4<f32>(input.position, 1.0);
+    output.position = ubo.projection * pos;
+    output.normal = (ubo.model * vec4<f32>(input.normal, 0.0)).xyz;
+    output.color = input.color;
+    output.uv = input.uv;
+    output.lightVec = ubo.lightPos.xyz - pos.xyz;
+    output.viewVec = -pos.xyz;
+    return output;
+  }
+
+  const NO_TEXTURE_LAYER = 0xffffffffu;
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let m = materials[material.index];
+    var color = m.baseColorFactor * vec4<f32>(input.color, 1.0);
+    if (m.baseColorLayer != NO_TEXTURE_LAYER) {
+      color = color * textureSample(colorMaps, colorSampler, input.uv,
+                                    m.baseColorLayer);
+    }
+    let N = normalize(input.normal);
+    let L = normalize(input.lightVec);
+    let V = normalize(input.viewVec);
+    let R = reflect(-L, N);
+    let diffuse = max(dot(N, L), 0.15) * color.rgb;
+    let specular = pow(max(dot(R, V), 0.0), 16.0) * vec3<f32>(0.75);
+    return vec4<f32>(diffuse + specular, 1.0);
+  }
+);
+
+// Vertex shader fetching the vertices from the mesh buffer, appended to the
+// WGSL functions of the mesh buffer. The instance index selects the mesh.
+static const char* pulled_vertex_shader_wgsl = CODE(
+  struct UBO {
+    projection : mat4x4<f32>,
+    model : mat4x4<f32>,
+    lightPos : vec4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> ubo : UBO;
+  @group(3) @binding(0)
+  var<storage, read> meshBufferMeshes : array<MeshBufferMesh>;
+  @group(3) @binding(1)
+  var<storage, read> meshBufferVertices : array<u32>;
+  @group(3) @binding(2)
+  var<storage, read> meshBufferIndices : array<u32>;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) normal : vec3<f32>,
+    @location(1) color : vec3<f32>,
+    @location(2) uv : vec2<f32>,
+    @location(3) viewVec : vec3<f32>,
+    @location(4) lightVec : vec3<f32>,
+  };
+
+  @vertex
+  fn vs_main(@builtin(instance_index) mesh : u32,
+             @builtin(vertex_index) vertexIndex : u32) -> VertexOutput {
+    let input = meshBufferGetVertex(mesh, vertexIndex);
+    var output : VertexOutput;
+    let pos = ubo.model * vec4<f32>(input.position, 1.0);
+    output.position = ubo.projection * pos;
+    output.normal = (ubo.model * vec4<f32>(input.normal, 0.0)).xyz;
+    output.color = input.color.rgb;
+    output.uv = input.uv;
+    output.lightVec = ubo.lightPos.xyz - pos.xyz;
+    output.viewVec = -pos.xyz;
+    return output;
+  }
+);
+// clang-format on
 
 static struct gltf_model_t* gltf_model;
 
+// Vertices and indices of the model primitives for vertex pulling
+static wgpu_mesh_buffer_t* mesh_buffer;
+
+// Brightness applied to the base color factors of the loaded materials, the
+// material table is written again when it changes
+static struct {
+  float brightness;
+  vec4* base_color_factors;
+} material_settings = {
+  .brightness = 1.0f,
+};
+
 static wgpu_buffer_t uniform_buffer;
 
 static struct {
@@ -41,18 +186,23 @@ static struct {
 static struct {
   WGPUBindGroupLayout ubo_vs;
   WGPUBindGroupLayout textures;
+  WGPUBindGroupLayout material;
 } bind_group_layouts = {0};
 
 static struct {
   WGPURenderPipeline normal;
   WGPURenderPipeline msaa;
+  WGPURenderPipeline pulled_normal;
+  WGPURenderPipeline pulled_msaa;
 } pipelines = {0};
 
-// Render pass descriptor for frame buffer writes
+// Render pass descriptors for frame buffer writes, without and with MSAA
 static WGPURenderPassColorAttachment rp_color_att_descriptors[1];
 static WGPURenderPassDescriptor render_pass_desc;
+static WGPURenderPassDescriptor msaa_render_pass_desc;
 
 static WGPUPipelineLayout pipeline_layout;
+static WGPUPipelineLayout pulled_pipeline_layout;
 static WGPUBindGroup bind_group;
 static WGPUBindGroupLayout bind_group_layout;
 
@@ -73,50 +223,17 @@ static void setup_camera(wgpu_example_context_t* context)
 static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
-    = WGPU_GLTF_FileLoadingFlags_PreTransformVertices;
+    = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
+      | WGPU_GLTF_FileLoadingFlags_PackMaterialTextures
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
+  mesh_buffer = wgpu_mesh_buffer_create(wgpu_context);
   gltf_model = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/voyager.gltf",
     .file_loading_flags = gltf_loading_flags,
+    .mesh_buffer        = mesh_buffer,
   });
-}
-
-// Creates a multi sample render target (texture and view) that is used to
-// resolve into the visible frame buffer target in the render pass
-static void setup_multisample_target(wgpu_context_t* wgpu_context)
-{
-  // Color target
-  {
-    // Create the multi-sampled texture
-    WGPUTextureDescriptor multisampled_frame_desc = {
-      .size          = (WGPUExtent3D){
-        .width               = wgpu_context->surface.width,
-        .height              = wgpu_context->surface.height,
-        .depthOrArrayLayers  = 1,
-      },
-      .mipLevelCount = 1,
-      .sampleCount   = msaa_sample_count,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = wgpu_context->swap_chain.format,
-      .usage         = WGPUTextureUsage_RenderAttachment,
-    };
-    multi_sample_target.color.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &multisampled_frame_desc);
-    ASSERT(multi_sample_target.color.texture != NULL);
-
-    // Create the multi-sampled texture view
-    multi_sample_target.color.view
-      = wgpuTextureCreateView(multi_sample_target.color.texture,
-                              &(WGPUTextureViewDescriptor){
-                                .format       = wgpu_context->swap_chain.format,
-                                .dimension    = WGPUTextureViewDimension_2D,
-                                .baseMipLevel = 0,
-                                .mipLevelCount   = 1,
-                                .baseArrayLayer  = 0,
-                                .arrayLayerCount = 1,
-                              });
-    ASSERT(multi_sample_target.color.view != NULL);
-  }
+  wgpu_mesh_buffer_upload(mesh_buffer);
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -146,11 +263,24 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
     .colorAttachments       = rp_color_att_descriptors,
     .depthStencilAttachment = &wgpu_context->depth_stencil.att_desc,
   };
+
+  // Multisampled color and depth attachments, resolved into the frame buffer
+  wgpu_setup_msaa_attachments(
+    wgpu_context, &(wgpu_msaa_attachments_options_t){
+                    .sample_count = msaa_sample_count,
+                    .depth_format = WGPUTextureFormat_Depth24PlusStencil8,
+                  });
+
+  // MSAA render pass descriptor
+  msaa_render_pass_desc = (WGPURenderPassDescriptor){
+    .colorAttachmentCount   = 1,
+    .colorAttachments       = &wgpu_context->msaa.color_att_desc,
+    .depthStencilAttachment = &wgpu_context->msaa.depth_att_desc,
+  };
 }
 
 static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
 {
-
   // Set 0 for passing vertex shader ubo
   {
     WGPUBindGroupLayoutEntry bgl_entry= {
@@ -172,16 +302,16 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     ASSERT(bind_group_layouts.ubo_vs != NULL);
   }
 
-  // Set 1 for fragment shader images (taken from glTF model)
+  // Set 1 for fragment shader images (texture arrays of the glTF model)
   {
     WGPUBindGroupLayoutEntry bgl_entries[2] = {
       [0] = (WGPUBindGroupLayoutEntry) {
-        // Binding 0: texture2D (Fragment shader) => Color map
+        // Binding 0: texture2DArray (Fragment shader) => Color maps
         .binding    = 0,
         .visibility = WGPUShaderStage_Fragment,
         .texture = (WGPUTextureBindingLayout) {
           .sampleType    = WGPUTextureSampleType_Float,
-          .viewDimension = WGPUTextureViewDimension_2D,
+          .viewDimension = WGPUTextureViewDimension_2DArray,
           .multisampled  = false,
         },
         .storageTexture = {0},
@@ -205,11 +335,47 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     ASSERT(bind_group_layouts.textures != NULL);
   }
 
+  // Set 2 for the material table, see
+  // wgpu_gltf_model_prepare_material_bind_group
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[2] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Uniform buffer (Fragment shader) => MaterialIndex
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout){
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = 16,
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Storage buffer (Fragment shader) => Materials
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout){
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = sizeof(wgpu_gltf_material_data_t),
+        },
+        .sampler = {0},
+      },
+    };
+    WGPUBindGroupLayoutDescriptor bgl_desc = {
+      .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+      .entries    = bgl_entries,
+    };
+    bind_group_layouts.material
+      = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
+    ASSERT(bind_group_layouts.material != NULL);
+  }
+
   // Pipeline layout using the bind group layouts
   {
-    WGPUBindGroupLayout bind_group_layout_sets[2] = {
+    WGPUBindGroupLayout bind_group_layout_sets[3] = {
       bind_group_layouts.ubo_vs,   // set 0
       bind_group_layouts.textures, // set 1
+      bind_group_layouts.material, // set 2
     };
     // Pipeline layout
     WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
@@ -220,6 +386,23 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
                                                      &pipeline_layout_desc);
     ASSERT(pipeline_layout != NULL);
   }
+
+  // Pipeline layout of vertex pulling, set 3 for the mesh buffer
+  {
+    WGPUBindGroupLayout bind_group_layout_sets[4] = {
+      bind_group_layouts.ubo_vs,                           // set 0
+      bind_group_layouts.textures,                         // set 1
+      bind_group_layouts.material,                         // set 2
+      wgpu_mesh_buffer_get_bind_group_layout(mesh_buffer), // set 3
+    };
+    WGPUPipelineLayoutDescriptor pipeline_layout_desc = {
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layout_sets),
+      .bindGroupLayouts     = bind_group_layout_sets,
+    };
+    pulled_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+      wgpu_context->device, &pipeline_layout_desc);
+    ASSERT(pulled_pipeline_layout != NULL);
+  }
 }
 
 static void setup_bind_groups(wgpu_context_t* wgpu_context)
@@ -242,35 +425,74 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
     ASSERT(bind_group != NULL);
   }
 
-  // Bind group for materials
+  // Bind groups for the texture arrays, shared by the materials whose base
+  // color textures are in the same array, with the sampler of the first one.
+  // Materials without a packed texture use the first array and ignore it.
   {
+    wgpu_gltf_texture_array_t* arrays = NULL;
+    const uint32_t array_count
+      = wgpu_gltf_model_get_texture_arrays(gltf_model, &arrays);
+    WGPUBindGroup* array_bind_groups
+      = (WGPUBindGroup*)calloc(MAX(array_count, 1u), sizeof(WGPUBindGroup));
     wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
     for (uint32_t i = 0; i < materials.material_count; ++i) {
-      wgpu_gltf_material_t* material = &materials.materials[i];
-      if (material->base_color_texture) {
+      wgpu_gltf_texture_t* texture = materials.materials[i].base_color_texture;
+      if (texture == NULL || texture->array == NULL) {
+        continue;
+      }
+      const uint32_t a = (uint32_t)(texture->array - arrays);
+      if (array_bind_groups[a] == NULL) {
         WGPUBindGroupEntry bg_entries[2] = {
             [0] = (WGPUBindGroupEntry) {
-              // Binding 0: texture2D (Fragment shader) => Color map
+              // Binding 0: texture2DArray (Fragment shader) => Color maps
               .binding     = 0,
-              .textureView = material->base_color_texture->wgpu_texture.view,
+              .textureView = arrays[a].view,
             },
             [1] = (WGPUBindGroupEntry) {
               // Binding 1: sampler (Fragment shader) => Color map
               .binding = 1,
-              .sampler =  material->base_color_texture->wgpu_texture.sampler,
+              .sampler = texture->wgpu_texture.sampler,
             }
           };
-        material->bind_group = wgpuDeviceCreateBindGroup(
+        array_bind_groups[a] = wgpuDeviceCreateBindGroup(
           wgpu_context->device,
           &(WGPUBindGroupDescriptor){
             .layout     = bind_group_layouts.textures,
             .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
             .entries    = bg_entries,
           });
-        ASSERT(material->bind_group != NULL);
+        ASSERT(array_bind_groups[a] != NULL);
+      }
+      else {
+        // Every material releases its reference to the shared bind group
+        wgpuBindGroupReference(array_bind_groups[a]);
       }
+      materials.materials[i].bind_group = array_bind_groups[a];
+    }
+    for (uint32_t i = 0; i < materials.material_count; ++i) {
+      wgpu_gltf_material_t* material = &materials.materials[i];
+      if (material->bind_group == NULL && array_bind_groups[0] != NULL) {
+        wgpuBindGroupReference(array_bind_groups[0]);
+        material->bind_group = array_bind_groups[0];
+      }
+    }
+    free(array_bind_groups);
+  }
+
+  // Base color factors, scaled by the brightness
+  {
+    wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
+    material_settings.base_color_factors
+      = (vec4*)calloc(MAX(materials.material_count, 1u), sizeof(vec4));
+    for (uint32_t i = 0; i < materials.material_count; ++i) {
+      glm_vec4_copy(materials.materials[i].base_color_factor,
+                    material_settings.base_color_factors[i]);
     }
   }
+
+  // Bind group for the material table, set 2
+  wgpu_gltf_model_prepare_material_bind_group(gltf_model,
+                                              bind_group_layouts.material);
 }
 
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
@@ -313,9 +535,10 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
                     wgpu_context, &(wgpu_vertex_state_t){
                     .shader_desc = (wgpu_shader_desc_t){
-                      // Vertex shader SPIR-V
-                      .label = "mesh_vertex_shader",
-                      .file  = "shaders/multi_sampling/mesh.vert.spv",
+                      // Vertex shader WGSL
+                      .label            = "mesh_vertex_shader",
+                      .wgsl_code.source = mesh_shader_wgsl,
+                      .entry            = "vs_main",
                     },
                     .buffer_count = 1,
                     .buffers      = &multi_sampling_vertex_buffer_layout,
@@ -325,9 +548,10 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
                     wgpu_context, &(wgpu_fragment_state_t){
                     .shader_desc = (wgpu_shader_desc_t){
-                      // Fragment shader SPIR-V
-                      .label = "mesh_fragment_shader",
-                      .file  = "shaders/multi_sampling/mesh.frag.spv",
+                      // Fragment shader WGSL
+                      .label            = "mesh_fragment_shader",
+                      .wgsl_code.source = mesh_shader_wgsl,
+                      .entry            = "fs_main",
                     },
                     .target_count = 1,
                     .targets      = &color_target_state,
@@ -379,8 +603,55 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     ASSERT(pipelines.msaa != NULL);
   }
 
+  // Vertex state without vertex buffer layout, the shader is appended to the
+  // WGSL functions of the mesh buffer
+  const char* mesh_buffer_wgsl = wgpu_mesh_buffer_get_wgsl_functions();
+  char* pulled_wgsl = malloc(strlen(mesh_buffer_wgsl)
+                             + strlen(pulled_vertex_shader_wgsl) + 1);
+  strcpy(pulled_wgsl, mesh_buffer_wgsl);
+  strcat(pulled_wgsl, pulled_vertex_shader_wgsl);
+  WGPUVertexState pulled_vertex_state = wgpu_create_vertex_state(
+                    wgpu_context, &(wgpu_vertex_state_t){
+                    .shader_desc = (wgpu_shader_desc_t){
+                      // Vertex shader WGSL
+                      .label            = "pulled_vertex_shader",
+                      .wgsl_code.source = pulled_wgsl,
+                      .entry            = "vs_main",
+                    },
+                    .buffer_count = 0,
+                    .buffers      = NULL,
+                  });
+  free(pulled_wgsl);
+
+  // Vertex pulling pipelines, without and with MSAA
+  for (uint32_t i = 0; i < 2; ++i) {
+    WGPUMultisampleState multisample_state
+      = wgpu_create_multisample_state_descriptor(
+        &(create_multisample_state_desc_t){
+          .sample_count = i == 0 ? 1 : msaa_sample_count,
+        });
+    WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                              .label        = "pulled_render_pipeline",
+                              .layout       = pulled_pipeline_layout,
+                              .primitive    = primitive_state,
+                              .vertex       = pulled_vertex_state,
+                              .fragment     = &fragment_state,
+                              .depthStencil = &depth_stencil_state,
+                              .multisample  = multisample_state,
+                            });
+    ASSERT(pipeline != NULL);
+    if (i == 0) {
+      pipelines.pulled_normal = pipeline;
+    }
+    else {
+      pipelines.pulled_msaa = pipeline;
+    }
+  }
+
   // Partial cleanup
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, pulled_vertex_state.module);
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
 }
 
@@ -412,7 +683,6 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
-    setup_multisample_target(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     prepare_uniform_buffers(context);
@@ -425,10 +695,28 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void update_material_factors(void)
+{
+  wgpu_gltf_materials_t materials = wgpu_gltf_model_get_materials(gltf_model);
+  for (uint32_t i = 0; i < materials.material_count; ++i) {
+    float* factor = materials.materials[i].base_color_factor;
+    glm_vec3_scale(material_settings.base_color_factors[i],
+                   material_settings.brightness, factor);
+  }
+  wgpu_gltf_model_update_material_buffer(gltf_model);
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "MSAA", &use_msaa);
+    imgui_overlay_checkBox(context->imgui_overlay, "Vertex pulling",
+                           &use_vertex_pulling);
+    if (imgui_overlay_slider_float(context->imgui_overlay, "Brightness",
+                                   &material_settings.brightness, 0.0f,
+                                   2.0f)) {
+      update_material_factors();
+    }
   }
 }
 
@@ -436,13 +724,11 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   // Set target frame buffer
   if (use_msaa) {
-    rp_color_att_descriptors[0].view = multi_sample_target.color.view;
-    rp_color_att_descriptors[0].resolveTarget
+    wgpu_context->msaa.color_att_desc.resolveTarget
       = wgpu_context->swap_chain.frame_buffer;
   }
   else {
     rp_color_att_descriptors[0].view = wgpu_context->swap_chain.frame_buffer;
-    rp_color_att_descriptors[0].resolveTarget = NULL;
   }
 
   // Create command encoder
@@ -451,27 +737,41 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 
   // Create render pass
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-    wgpu_context->cmd_enc, &render_pass_desc);
-
-  // Bind the rendering pipeline
-  if (use_msaa) {
-    wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipelines.msaa);
+    wgpu_context->cmd_enc, use_msaa ? &msaa_render_pass_desc :
+                                      &render_pass_desc);
+
+  // Draw model, the rendering pipeline and the scene matrices bind group (set
+  // 0) are part of the bundle, one is recorded per pipeline. The materials
+  // only change the dynamic offset of the material table (set 2) between
+  // draws, unless their textures are in another array (set 1). Pulled vertices
+  // are fetched from the mesh buffer (set 3).
+  uint32_t render_flags = WGPU_GLTF_RenderFlags_BindImages
+                          | WGPU_GLTF_RenderFlags_BindMaterialIndex;
+  WGPURenderPipeline pipeline = use_msaa ? pipelines.msaa : pipelines.normal;
+  WGPUBindGroup mesh_buffer_bind_group = NULL;
+  if (use_vertex_pulling) {
+    render_flags |= WGPU_GLTF_RenderFlags_VertexPulling;
+    pipeline = use_msaa ? pipelines.pulled_msaa : pipelines.pulled_normal;
+    mesh_buffer_bind_group = wgpu_mesh_buffer_get_bind_group(mesh_buffer);
   }
-  else {
-    wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipelines.normal);
-  }
-
-  // Bind scene matrices descriptor to set 0
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0, bind_group, 0,
-                                    0);
-
-  // Draw model
-  static wgpu_gltf_render_flags_enum_t render_flags
-    = WGPU_GLTF_RenderFlags_BindImages;
-  wgpu_gltf_model_draw(gltf_model, (wgpu_gltf_model_render_options_t){
-                                     .render_flags   = render_flags,
-                                     .bind_image_set = 1,
-                                   });
+  wgpu_gltf_model_draw_bundled(
+    gltf_model,
+    (wgpu_gltf_model_render_options_t){
+      .render_flags      = render_flags,
+      .bind_image_set    = 1,
+      .bind_material_set = 2,
+    },
+    &(wgpu_gltf_model_bundle_options_t){
+      .formats = {
+        .color_format_count   = 1,
+        .color_formats[0]     = wgpu_context->swap_chain.format,
+        .depth_stencil_format = WGPUTextureFormat_Depth24PlusStencil8,
+        .sample_count         = use_msaa ? msaa_sample_count : 1,
+      },
+      .pipeline       = pipeline,
+      .bind_groups[0] = bind_group,
+      .bind_groups[3] = mesh_buffer_bind_group,
+    });
 
   // End render pass
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
@@ -525,14 +825,18 @@ static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
   wgpu_gltf_model_destroy(gltf_model);
-  WGPU_RELEASE_RESOURCE(Texture, multi_sample_target.color.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, multi_sample_target.color.view)
+  wgpu_mesh_buffer_release(mesh_buffer);
+  free(material_settings.base_color_factors);
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer.buffer)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.ubo_vs)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.textures)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.material)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.normal)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.msaa)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.pulled_normal)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.pulled_msaa)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pulled_pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
 }
@@ -0,0 +1,505 @@
+#include "common_shaders.h"
+#include "example_base.h"
+#include "examples.h"
+#include "meshes.h"
+
+#include <string.h>
+
+#include "../core/window.h"
+#include "../webgpu/imgui_overlay.h"
+#include "../webgpu/surface_group.h"
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU Example - Multi Window
+ *
+ * This example drives a second window from the device of the example with a
+ * surface group. The main window shows a rotating cube, the second window a
+ * magnified viewport of the same canvas, rendered with the view projection of
+ * the canvas premultiplied by the viewport matrix of the surface. Both windows
+ * are recorded into the same command buffer and submitted once per frame.
+ * -------------------------------------------------------------------------- */
+
+// One uniform buffer slice per window, 256-byte aligned
+#define UNIFORM_BUFFER_OFFSET 256u
+#define WINDOW_COUNT 2u
+
+// Settings
+static struct {
+  // Viewport of the second window, relative to the canvas
+  float zoom;
+  float center_x;
+  float center_y;
+} settings = {
+  .zoom     = 2.0f,
+  .center_x = 0.5f,
+  .center_y = 0.5f,
+};
+
+// Cube mesh
+static cube_mesh_t cube_mesh = {0};
+
+// Vertex buffer
+static wgpu_buffer_t vertices = {0};
+
+// Uniform buffer, the model view projection matrix of each window
+static WGPUBuffer uniform_buffer;
+static WGPUBindGroup uniform_bind_groups[WINDOW_COUNT];
+
+static struct {
+  mat4 projection;
+  mat4 view;
+  mat4 model;
+  mat4 model_view_projection[WINDOW_COUNT];
+} view_matrices = {0};
+
+// Second window, presented through the surface group
+static struct {
+  window_t* window;
+  wgpu_surface_group_t* surface_group;
+  uint32_t canvas_width;
+  uint32_t canvas_height;
+  WGPUTexture depth_texture;
+  WGPUTextureView depth_view;
+} second_window = {0};
+
+// Pipeline
+static WGPURenderPipeline pipeline;
+
+// Render pass descriptor for frame buffer writes
+static struct {
+  WGPURenderPassColorAttachment color_attachments[1];
+  WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
+  WGPURenderPassDescriptor descriptor;
+} render_pass;
+
+// Other variables
+static const char* example_title = "Multi Window";
+static bool prepared             = false;
+
+// Create a vertex buffer from the cube data.
+static void prepare_vertex_buffer(wgpu_context_t* wgpu_context)
+{
+  cube_mesh_init(&cube_mesh);
+  vertices = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+                    .size  = sizeof(cube_mesh.vertex_array),
+                    .initial.data = cube_mesh.vertex_array,
+                  });
+}
+
+static void setup_render_pass(wgpu_context_t* wgpu_context)
+{
+  // Color attachment
+  render_pass.color_attachments[0] = (WGPURenderPassColorAttachment) {
+      .view       = NULL, // Assigned later
+      .loadOp     = WGPULoadOp_Clear,
+      .storeOp    = WGPUStoreOp_Store,
+      .clearColor = (WGPUColor) {
+        .r = 0.1f,
+        .g = 0.2f,
+        .b = 0.3f,
+        .a = 1.0f,
+      },
+  };
+
+  // Depth attachment
+  wgpu_setup_deph_stencil(wgpu_context, NULL);
+
+  // Render pass descriptor, the attachments are assigned per window
+  render_pass.descriptor = (WGPURenderPassDescriptor){
+    .colorAttachmentCount   = 1,
+    .colorAttachments       = render_pass.color_attachments,
+    .depthStencilAttachment = &render_pass.depth_stencil_attachment,
+  };
+}
+
+// Depth buffer of the second window, at the size of its swap chain
+static void setup_second_window_depth_stencil(wgpu_context_t* wgpu_context)
+{
+  wgpu_surface_group_surface_t* surface
+    = wgpu_surface_group_get_surface(second_window.surface_group, 0);
+
+  WGPU_RELEASE_RESOURCE(TextureView, second_window.depth_view)
+  WGPU_RELEASE_RESOURCE(Texture, second_window.depth_texture)
+  second_window.depth_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "multi_window_depth_texture",
+      .usage         = WGPUTextureUsage_RenderAttachment,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = {surface->width, surface->height, 1},
+      .format        = WGPUTextureFormat_Depth24PlusStencil8,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(second_window.depth_texture != NULL);
+  second_window.depth_view
+    = wgpuTextureCreateView(second_window.depth_texture, NULL);
+  ASSERT(second_window.depth_view != NULL);
+}
+
+// Viewport of the second window over the canvas, from the settings
+static void update_second_window_viewport(void)
+{
+  const float canvas_width  = (float)second_window.canvas_width;
+  const float canvas_height = (float)second_window.canvas_height;
+  const float width         = canvas_width / settings.zoom;
+  const float height        = canvas_height / settings.zoom;
+  const float x = glm_clamp(settings.center_x * canvas_width - 0.5f * width,
+                            0.0f, canvas_width - width);
+  const float y = glm_clamp(settings.center_y * canvas_height - 0.5f * height,
+                            0.0f, canvas_height - height);
+  wgpu_surface_group_set_viewport(second_window.surface_group, 0,
+                                  &(wgpu_surface_viewport_t){
+                                    .x      = (uint32_t)x,
+                                    .y      = (uint32_t)y,
+                                    .width  = (uint32_t)width,
+                                    .height = (uint32_t)height,
+                                  });
+}
+
+static void prepare_second_window(wgpu_context_t* wgpu_context)
+{
+  // Same aspect ratio as the main window, at half its size
+  second_window.window = window_create(&(window_config_t){
+    .title     = "Multi Window - Magnified",
+    .width     = MAX(wgpu_context->surface.width / 2u, 1u),
+    .height    = MAX(wgpu_context->surface.height / 2u, 1u),
+    .resizable = true,
+  });
+
+  // The canvas is the main window, at its initial size
+  second_window.canvas_width  = wgpu_context->surface.width;
+  second_window.canvas_height = wgpu_context->surface.height;
+  second_window.surface_group = wgpu_surface_group_create(
+    wgpu_context, &(wgpu_surface_group_desc_t){
+                    .canvas_width  = second_window.canvas_width,
+                    .canvas_height = second_window.canvas_height,
+                  });
+  wgpu_surface_group_add_surface(second_window.surface_group,
+                                 second_window.window,
+                                 &(wgpu_surface_viewport_t){
+                                   .width  = second_window.canvas_width,
+                                   .height = second_window.canvas_height,
+                                 });
+  update_second_window_viewport();
+  setup_second_window_depth_stencil(wgpu_context);
+}
+
+static void prepare_view_matrices(wgpu_context_t* wgpu_context)
+{
+  const float aspect_ratio
+    = (float)wgpu_context->surface.width / (float)wgpu_context->surface.height;
+
+  // Projection matrix
+  glm_mat4_identity(view_matrices.projection);
+  glm_perspective((2 * PI) / 5.0f, aspect_ratio, 1.0f, 100.0f,
+                  view_matrices.projection);
+
+  // View matrix
+  glm_mat4_identity(view_matrices.view);
+  glm_translate(view_matrices.view, (vec3){0.0f, 0.0f, -4.0f});
+}
+
+static void update_uniform_buffers(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  const float now              = context->frame.timestamp_millis / 1000.0f;
+
+  // Main window, the view projection of the canvas
+  glm_mat4_identity(view_matrices.model);
+  glm_rotate(view_matrices.model, 1.0f, (vec3){sinf(now), cosf(now), 0.0f});
+  glm_mat4_mul(view_matrices.view, view_matrices.model,
+               view_matrices.model_view_projection[0]);
+  glm_mat4_mul(view_matrices.projection,
+               view_matrices.model_view_projection[0],
+               view_matrices.model_view_projection[0]);
+
+  // Second window, cropped to its viewport of the canvas
+  mat4 viewport_matrix;
+  wgpu_surface_group_get_viewport_matrix(second_window.surface_group, 0,
+                                         viewport_matrix);
+  glm_mat4_mul(viewport_matrix, view_matrices.model_view_projection[0],
+               view_matrices.model_view_projection[1]);
+
+  for (uint32_t i = 0; i < WINDOW_COUNT; ++i) {
+    wgpu_queue_write_buffer(wgpu_context, uniform_buffer,
+                            i * UNIFORM_BUFFER_OFFSET,
+                            &view_matrices.model_view_projection[i],
+                            sizeof(mat4));
+  }
+}
+
+static void prepare_uniform_buffer(wgpu_context_t* wgpu_context)
+{
+  // Setup the view matrices for the camera
+  prepare_view_matrices(wgpu_context);
+
+  uniform_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "multi_window_uniform_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = (WINDOW_COUNT - 1) * UNIFORM_BUFFER_OFFSET + sizeof(mat4),
+    });
+  ASSERT(uniform_buffer != NULL);
+}
+
+static void setup_bind_groups(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupLayout bind_group_layout
+    = wgpuRenderPipelineGetBindGroupLayout(pipeline, 0);
+  for (uint32_t i = 0; i < WINDOW_COUNT; ++i) {
+    uniform_bind_groups[i] = wgpuDeviceCreateBindGroup(
+      wgpu_context->device,
+      &(WGPUBindGroupDescriptor) {
+        .layout     = bind_group_layout,
+        .entryCount = 1,
+        .entries    = &(WGPUBindGroupEntry) {
+          .binding = 0,
+          .buffer  = uniform_buffer,
+          .offset  = i * UNIFORM_BUFFER_OFFSET,
+          .size    = sizeof(mat4),
+        },
+      }
+    );
+    ASSERT(uniform_bind_groups[i] != NULL);
+  }
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+}
+
+static void prepare_pipeline(wgpu_context_t* wgpu_context)
+{
+  // Primitive state
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_Back,
+  };
+
+  // Color target state, the swap chains of both windows share the format
+  WGPUBlendState blend_state              = wgpu_create_blend_state(true);
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = wgpu_context->swap_chain.format,
+    .blend     = &blend_state,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+
+  // Depth stencil state
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = WGPUTextureFormat_Depth24PlusStencil8,
+      .depth_write_enabled = true,
+    });
+
+  // Vertex buffer layout
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    multi_window, cube_mesh.vertex_size,
+    // Attribute location 0: Position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x4,
+                       cube_mesh.position_offset),
+    // Attribute location 1: Color
+    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x4, cube_mesh.color_offset))
+
+  // Vertex state
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+        wgpu_context, &(wgpu_vertex_state_t){
+        .shader_desc = (wgpu_shader_desc_t){
+           // Vertex shader WGSL
+           .label            = "basic_vertex_shader_wgsl",
+           .wgsl_code.source = basic_vertex_shader_wgsl,
+        },
+        .buffer_count = 1,
+        .buffers = &multi_window_vertex_buffer_layout,
+      });
+
+  // Fragment state
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+        wgpu_context, &(wgpu_fragment_state_t){
+        .shader_desc = (wgpu_shader_desc_t){
+          // Fragment shader WGSL
+          .label            = "vertex_position_color_fragment_shader_wgsl",
+          .wgsl_code.source = vertex_position_color_fragment_shader_wgsl,
+        },
+        .target_count = 1,
+        .targets = &color_target_state,
+      });
+
+  // Multisample state
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  // Create rendering pipeline using the specified states
+  pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label        = "multi_window_render_pipeline",
+                            .primitive    = primitive_state,
+                            .vertex       = vertex_state,
+                            .fragment     = &fragment_state,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+static int example_initialize(wgpu_example_context_t* context)
+{
+  if (context) {
+    prepare_vertex_buffer(context->wgpu_context);
+    prepare_pipeline(context->wgpu_context);
+    prepare_uniform_buffer(context->wgpu_context);
+    setup_bind_groups(context->wgpu_context);
+    setup_render_pass(context->wgpu_context);
+    prepare_second_window(context->wgpu_context);
+    prepared = true;
+    return 0;
+  }
+
+  return 1;
+}
+
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    bool changed = false;
+    changed |= imgui_overlay_slider_float(context->imgui_overlay, "Zoom",
+                                          &settings.zoom, 1.0f, 8.0f);
+    changed |= imgui_overlay_slider_float(context->imgui_overlay, "Center x",
+                                          &settings.center_x, 0.0f, 1.0f);
+    changed |= imgui_overlay_slider_float(context->imgui_overlay, "Center y",
+                                          &settings.center_y, 0.0f, 1.0f);
+    if (changed) {
+      update_second_window_viewport();
+    }
+  }
+}
+
+static void draw_cube(WGPUCommandEncoder cmd_enc, WGPUTextureView frame_buffer,
+                      WGPUTextureView depth_view, uint32_t window_index)
+{
+  render_pass.color_attachments[0].view     = frame_buffer;
+  render_pass.depth_stencil_attachment.view = depth_view;
+
+  WGPURenderPassEncoder rpass_enc
+    = wgpuCommandEncoderBeginRenderPass(cmd_enc, &render_pass.descriptor);
+  wgpuRenderPassEncoderSetPipeline(rpass_enc, pipeline);
+  wgpuRenderPassEncoderSetVertexBuffer(rpass_enc, 0, vertices.buffer, 0,
+                                       WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0,
+                                    uniform_bind_groups[window_index], 0, 0);
+  wgpuRenderPassEncoderDraw(rpass_enc, cube_mesh.vertex_count, 1, 0, 0);
+  wgpuRenderPassEncoderEnd(rpass_enc);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+}
+
+static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
+{
+  wgpu_context->cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+
+  // Main window, with the depth buffer of the context
+  render_pass.depth_stencil_attachment = wgpu_context->depth_stencil.att_desc;
+  draw_cube(wgpu_context->cmd_enc, wgpu_context->swap_chain.frame_buffer,
+            wgpu_context->depth_stencil.texture_view, 0);
+
+  // Second window, in the same command buffer
+  wgpu_surface_group_surface_t* surface
+    = wgpu_surface_group_get_surface(second_window.surface_group, 0);
+  draw_cube(wgpu_context->cmd_enc, surface->frame_buffer,
+            second_window.depth_view, 1);
+
+  // Draw ui overlay, on the main window
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
+
+  // Get command buffer
+  WGPUCommandBuffer command_buffer
+    = wgpu_get_command_buffer(wgpu_context->cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
+
+  return command_buffer;
+}
+
+static int example_draw(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+
+  // Follow the size of the second window
+  uint32_t width = 0, height = 0;
+  window_get_size(second_window.window, &width, &height);
+  if (wgpu_surface_group_resize_surface(second_window.surface_group, 0, width,
+                                        height)) {
+    setup_second_window_depth_stencil(wgpu_context);
+  }
+
+  // Prepare frame
+  prepare_frame(context);
+  wgpu_surface_group_acquire(second_window.surface_group);
+
+  // Command buffer to be submitted to the queue
+  wgpu_context->submit_info.command_buffer_count = 1;
+  wgpu_context->submit_info.command_buffers[0]
+    = build_command_buffer(context->wgpu_context);
+
+  // Submit to queue
+  submit_command_buffers(context);
+
+  // Present the second window, then submit frame
+  wgpu_surface_group_present(second_window.surface_group);
+  submit_frame(context);
+
+  return 0;
+}
+
+static int example_render(wgpu_example_context_t* context)
+{
+  if (!prepared) {
+    return 1;
+  }
+  if (!context->paused) {
+    update_uniform_buffers(context);
+  }
+  return example_draw(context);
+}
+
+static void example_destroy(wgpu_example_context_t* context)
+{
+  UNUSED_VAR(context);
+  wgpu_surface_group_release(second_window.surface_group);
+  second_window.surface_group = NULL;
+  WGPU_RELEASE_RESOURCE(TextureView, second_window.depth_view)
+  WGPU_RELEASE_RESOURCE(Texture, second_window.depth_texture)
+  if (second_window.window != NULL) {
+    window_destroy(second_window.window);
+    second_window.window = NULL;
+  }
+  WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer)
+  for (uint32_t i = 0; i < WINDOW_COUNT; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, uniform_bind_groups[i])
+  }
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
+}
+
+void example_multi_window(int argc, char* argv[])
+{
+  // clang-format off
+  example_run(argc, argv, &(refexport_t){
+    .example_settings = (wgpu_example_settings_t){
+     .title   = example_title,
+     .overlay = true,
+    },
+    .example_initialize_func = &example_initialize,
+    .example_render_func     = &example_render,
+    .example_destroy_func    = &example_destroy
+  });
+  // clang-format on
+}
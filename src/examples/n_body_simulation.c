@@ -1,32 +1,89 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "../webgpu/gpu_random.h"
 #include "../webgpu/imgui_overlay.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - N-Body Simulation
  *
- * A simple N-body simulation implemented using WebGPU.
+ * A simple N-body simulation implemented using WebGPU. The all-pairs force
+ * kernel stages the positions of a tile of bodies in workgroup memory, so that
+ * every workgroup reads each body from the storage buffer once. The body count
+ * and the workgroup size can be set on the command line with --bodies=<n> and
+ * --workgroup-size=<n>, or changed in the settings.
+ *
+ * The hierarchical grid mode (--mode=grid) approximates the forces in
+ * O(N log N): the bodies are binned into the finest level of a grid pyramid,
+ * a full octree of fixed depth, and every level stores the mass and the center
+ * of mass of its cells. A body sums the gravity of the cells of each level
+ * that are children of the neighbours of its parent cell but not neighbours
+ * of its own cell, plus its neighbours at the finest level, as in Barnes-Hut
+ * with a fixed opening criterion. The all-pairs kernel remains the accuracy
+ * reference.
+ *
+ * With a simulation rate (--sim-rate=<Hz>) the steps of a frame are recorded
+ * into its compute pass, and the bodies are drawn interpolated between the
+ * last two steps, so that render-only frames still move smoothly.
+ *
+ * With async compute (--async-compute) the positions are double-buffered: the
+ * steps of a frame continue from a copy of the drawn positions in the other
+ * state and are submitted in their own command buffer ahead of the render, so
+ * that they do not wait for the draw of the previous steps. The bodies are
+ * then drawn one frame of steps behind.
  *
  * Ref:
  * https://github.com/jrprice/NBody-WebGPU
  * https://en.wikipedia.org/wiki/N-body_simulation
  * -------------------------------------------------------------------------- */
 
-#define NUM_BODIES 8192u
-#define WORKGROUP_SIZE 64u
+#define DEFAULT_NUM_BODIES 8192u
+#define MAX_NUM_BODIES (1024u * 1024u)
+#define DEFAULT_WORKGROUP_SIZE 64u
+
+// Grid pyramid from 64^3 down to 4^3 cells over the cube [-2, 2]^3, bodies
+// outside are clamped to the border cells. Must match the grid shader.
+#define GRID_LEVEL_COUNT 5u
+#define GRID_FINEST_DIM 64u
+#define GRID_WORKGROUP_SIZE 64u
+#define GRID_LEVEL_PARAMS_STRIDE 256u
 #define INITIAL_EYE_POSITION                                                   \
   {                                                                            \
     0.0f, 0.0f, -1.5f                                                          \
   }
 
-// Simulation parameters
-static const uint32_t num_bodies = NUM_BODIES;
+typedef enum simulation_mode_t {
+  SIMULATION_MODE_ALL_PAIRS = 0,
+  SIMULATION_MODE_GRID      = 1,
+} simulation_mode_t;
 
-// Shader parameters.
-static const uint32_t workgroup_size = WORKGROUP_SIZE;
+// Simulation parameters, the compute resources are recreated when changed
+static struct {
+  simulation_mode_t mode;
+  uint32_t num_bodies;
+  uint32_t workgroup_size;
+  // Double-buffered position states, 2 with async compute
+  uint32_t state_count;
+  bool changed;
+} simulation = {
+  .mode           = SIMULATION_MODE_ALL_PAIRS,
+  .num_bodies     = DEFAULT_NUM_BODIES,
+  .workgroup_size = DEFAULT_WORKGROUP_SIZE,
+  .state_count    = 1,
+  .changed        = false,
+};
+
+// Settings
+static const char* simulation_mode_names[2] = {"All pairs", "Grid"};
+static const char* num_bodies_names[10]
+  = {"1024",  "4096",   "8192",   "16384",  "32768",
+     "65536", "131072", "262144", "524288", "1048576"};
+static const char* workgroup_size_names[6]
+  = {"32", "64", "128", "256", "512", "1024"};
+static const char* step_scope_name         = "N-body steps";
 
 // Render parameters
 static vec3 eye_position = INITIAL_EYE_POSITION;
@@ -40,31 +97,49 @@ static struct {
   mat4 view_projection_matrix;
   mat4 projection_matrix;
   bool changed;
+  // Interpolation factor between the previous and the current positions,
+  // last written to the uniform buffer
+  float alpha;
 } render_params = {
   .view_projection_matrix = GLM_MAT4_ZERO_INIT,
   .projection_matrix      = GLM_MAT4_ZERO_INIT,
   .changed                = true,
+  .alpha                  = -1.0f,
 };
 
-// Storage buffer block objects
+// Storage buffer block objects, a ping-pong pair of position buffers for each
+// state
 static struct {
-  struct {
-    wgpu_buffer_t buffer;
-    float positions[NUM_BODIES * 4];
-  } positions_in;
-  wgpu_buffer_t positions_out;
+  wgpu_buffer_t positions[2][2];
   wgpu_buffer_t velocities;
 } storage_buffers = {0};
 
+// Grid pyramid of the hierarchical grid mode
+static struct {
+  wgpu_buffer_t accumulators; /* fixed point sums of the finest cells */
+  wgpu_buffer_t cells;        /* center of mass and mass of every level */
+  wgpu_buffer_t level_params; /* level of each pass, dynamic offset */
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+  WGPUPipelineLayout pipeline_layout;
+  struct {
+    WGPUComputePipeline clear;
+    WGPUComputePipeline bin;
+    WGPUComputePipeline resolve;
+    WGPUComputePipeline reduce;
+    WGPUComputePipeline force;
+  } pipelines;
+} grid = {0};
+
 // Bind group layouts
 static struct {
   WGPUBindGroupLayout compute;
   WGPUBindGroupLayout render;
 } bind_group_layouts = {0};
 
-// Bind groups
+// Bind groups, compute[state][i] reads positions[state][i]
 static struct {
-  WGPUBindGroup compute[2];
+  WGPUBindGroup compute[2][2];
   WGPUBindGroup render;
 } bind_groups = {0};
 
@@ -92,6 +167,8 @@ static struct {
   float num_frames_since_fps_update;
   float last_fps_update_time;
   float fps;
+  uint32_t num_steps_since_fps_update;
+  float steps_per_second;
   bool last_fps_update_time_valid;
 } fps_counter = {
   .fps_update_interval         = 500.0f,
@@ -99,7 +176,326 @@ static struct {
   .last_fps_update_time_valid  = false,
 };
 
-static uint32_t frame_idx = 0;
+// Pair index of the last positions of each state
+static uint32_t frame_idx[2] = {0};
+// Set once a step has written the state since the simulation was prepared,
+// the positions of the previous step are only valid then
+static bool has_previous_positions[2] = {false};
+
+// clang-format off
+static const char* n_body_compute_shader_wgsl = CODE(
+  @group(0) @binding(0) var<storage, read> positionsIn : array<vec4<f32>>;
+  @group(0) @binding(1)
+  var<storage, read_write> positionsOut : array<vec4<f32>>;
+  @group(0) @binding(2) var<storage, read_write> velocities : array<vec4<f32>>;
+
+  override kWorkgroupSize : u32 = 64u;
+  let kDelta = 0.000025;
+  let kSoftening = 0.2;
+
+  var<workgroup> tile : array<vec4<f32>, kWorkgroupSize>;
+
+  fn computeForce(ipos : vec4<f32>, jpos : vec4<f32>) -> vec4<f32> {
+    let d = vec4<f32>((jpos - ipos).xyz, 0.0);
+    let distSq = dot(d, d) + kSoftening * kSoftening;
+    let dist = inverseSqrt(distSq);
+    let coeff = jpos.w * (dist * dist * dist);
+    return coeff * d;
+  }
+
+  @compute @workgroup_size(kWorkgroupSize)
+  fn cs_main(@builtin(global_invocation_id) globalId : vec3<u32>,
+             @builtin(local_invocation_id) localId : vec3<u32>) {
+    let numBodies = arrayLength(&positionsIn);
+    let idx = min(globalId.x, numBodies - 1u);
+    let pos = positionsIn[idx];
+
+    // The workgroup loads a tile of bodies together, one per invocation, and
+    // every invocation accumulates the forces of the whole tile
+    var force = vec4<f32>(0.0);
+    for (var tileStart = 0u; tileStart < numBodies;
+         tileStart = tileStart + kWorkgroupSize) {
+      // Bodies past the end are massless
+      let j = tileStart + localId.x;
+      tile[localId.x] = select(vec4<f32>(0.0),
+                               positionsIn[min(j, numBodies - 1u)],
+                               j < numBodies);
+      workgroupBarrier();
+      for (var i = 0u; i < kWorkgroupSize; i = i + 1u) {
+        force = force + computeForce(pos, tile[i]);
+      }
+      workgroupBarrier();
+    }
+
+    if (globalId.x >= numBodies) {
+      return;
+    }
+    let velocity = velocities[idx] + force * kDelta;
+    velocities[idx] = velocity;
+    positionsOut[idx] = pos + velocity * kDelta;
+  }
+);
+
+static const char* n_body_grid_shader_wgsl = CODE(
+  @group(0) @binding(0) var<storage, read> positionsIn : array<vec4<f32>>;
+  @group(0) @binding(1)
+  var<storage, read_write> positionsOut : array<vec4<f32>>;
+  @group(0) @binding(2) var<storage, read_write> velocities : array<vec4<f32>>;
+
+  struct GridLevel {
+    level : u32,
+    padding0 : u32,
+    padding1 : u32,
+    padding2 : u32,
+  };
+
+  @group(1) @binding(0)
+  var<storage, read_write> gridAccumulators : array<atomic<u32>>;
+  @group(1) @binding(1) var<storage, read_write> gridCells : array<vec4<f32>>;
+  @group(1) @binding(2) var<uniform> gridLevel : GridLevel;
+
+  let kGridDim = 64u;
+  let kLevelCount = 5u;
+  let kGridMin = -2.0;
+  let kGridExtent = 4.0;
+  let kFixedPointScale = 1024.0;
+  let kDelta = 0.000025;
+  let kSoftening = 0.2;
+
+  fn levelDim(level : u32) -> u32 {
+    return kGridDim >> level;
+  }
+
+  fn levelOffset(level : u32) -> u32 {
+    var offset = 0u;
+    for (var l = 0u; l < level; l = l + 1u) {
+      let dim = levelDim(l);
+      offset = offset + dim * dim * dim;
+    }
+    return offset;
+  }
+
+  fn cellSize(level : u32) -> f32 {
+    return kGridExtent / f32(levelDim(level));
+  }
+
+  fn cellCoord(p : vec3<f32>, level : u32) -> vec3<i32> {
+    let c = floor((p - vec3<f32>(kGridMin)) / cellSize(level));
+    return clamp(vec3<i32>(c), vec3<i32>(0),
+                 vec3<i32>(i32(levelDim(level)) - 1));
+  }
+
+  fn cellIndex(c : vec3<i32>, level : u32) -> u32 {
+    let dim = levelDim(level);
+    let u = vec3<u32>(c);
+    return levelOffset(level) + u.x + dim * (u.y + dim * u.z);
+  }
+
+  fn indexToCell(i : u32, level : u32) -> vec3<i32> {
+    let dim = levelDim(level);
+    return vec3<i32>(vec3<u32>(i % dim, (i / dim) % dim, i / (dim * dim)));
+  }
+
+  fn cellForce(p : vec3<f32>, cell : vec4<f32>) -> vec3<f32> {
+    let d = cell.xyz - p;
+    let distSq = dot(d, d) + kSoftening * kSoftening;
+    let dist = inverseSqrt(distSq);
+    return cell.w * (dist * dist * dist) * d;
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_clear(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x < arrayLength(&gridAccumulators)) {
+      atomicStore(&gridAccumulators[id.x], 0u);
+    }
+  }
+
+  // Floats have no atomics, the bodies are summed in fixed point relative to
+  // the origin of their cell
+  @compute @workgroup_size(64)
+  fn cs_bin(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= arrayLength(&positionsIn)) {
+      return;
+    }
+    let body = positionsIn[id.x];
+    let c = cellCoord(body.xyz, 0u);
+    let origin = vec3<f32>(kGridMin) + vec3<f32>(c) * cellSize(0u);
+    let rel = clamp((body.xyz - origin) / cellSize(0u), vec3<f32>(0.0),
+                    vec3<f32>(1.0));
+    let m = body.w * kFixedPointScale;
+    let i = cellIndex(c, 0u) * 4u;
+    atomicAdd(&gridAccumulators[i], u32(m + 0.5));
+    atomicAdd(&gridAccumulators[i + 1u], u32(m * rel.x + 0.5));
+    atomicAdd(&gridAccumulators[i + 2u], u32(m * rel.y + 0.5));
+    atomicAdd(&gridAccumulators[i + 3u], u32(m * rel.z + 0.5));
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_resolve(@builtin(global_invocation_id) id : vec3<u32>) {
+    let dim = levelDim(0u);
+    if (id.x >= dim * dim * dim) {
+      return;
+    }
+    let i = id.x * 4u;
+    let m = f32(atomicLoad(&gridAccumulators[i]));
+    let origin = vec3<f32>(kGridMin)
+                 + (vec3<f32>(indexToCell(id.x, 0u)) + vec3<f32>(0.5))
+                     * cellSize(0u);
+    var cell = vec4<f32>(origin, 0.0);
+    if (m > 0.0) {
+      let rel = vec3<f32>(f32(atomicLoad(&gridAccumulators[i + 1u])),
+                          f32(atomicLoad(&gridAccumulators[i + 2u])),
+                          f32(atomicLoad(&gridAccumulators[i + 3u]))) / m;
+      cell = vec4<f32>(origin + (rel - vec3<f32>(0.5)) * cellSize(0u),
+                       m / kFixedPointScale);
+    }
+    gridCells[id.x] = cell;
+  }
+
+  // Sums the eight children of the cells of gridLevel.level
+  @compute @workgroup_size(64)
+  fn cs_reduce(@builtin(global_invocation_id) id : vec3<u32>) {
+    let level = gridLevel.level;
+    let dim = levelDim(level);
+    if (id.x >= dim * dim * dim) {
+      return;
+    }
+    let c = indexToCell(id.x, level);
+    var weighted = vec3<f32>(0.0);
+    var mass = 0.0;
+    for (var child = 0u; child < 8u; child = child + 1u) {
+      let offset = vec3<i32>(vec3<u32>(child & 1u, (child >> 1u) & 1u,
+                                       child >> 2u));
+      let cell = gridCells[cellIndex(c * 2 + offset, level - 1u)];
+      weighted = weighted + cell.xyz * cell.w;
+      mass = mass + cell.w;
+    }
+    let center = vec3<f32>(kGridMin)
+                 + (vec3<f32>(c) + vec3<f32>(0.5)) * cellSize(level);
+    gridCells[levelOffset(level) + id.x]
+      = select(vec4<f32>(center, 0.0), vec4<f32>(weighted / mass, mass),
+               mass > 0.0);
+  }
+
+  fn isNeighbour(a : vec3<i32>, b : vec3<i32>) -> bool {
+    return all(abs(a - b) <= vec3<i32>(1));
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_force(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= arrayLength(&positionsIn)) {
+      return;
+    }
+    let body = positionsIn[id.x];
+    let p = body.xyz;
+    var force = vec3<f32>(0.0);
+
+    // Coarsest level: all the cells beyond the neighbours
+    let top = kLevelCount - 1u;
+    let topDim = i32(levelDim(top));
+    let topCell = cellCoord(p, top);
+    for (var i = 0; i < topDim * topDim * topDim; i = i + 1) {
+      let k = indexToCell(u32(i), top);
+      if (!isNeighbour(k, topCell)) {
+        force = force + cellForce(p, gridCells[cellIndex(k, top)]);
+      }
+    }
+
+    // Finer levels: the children of the neighbours of the parent cell, which
+    // the coarser level skipped, that are not neighbours themselves
+    for (var l = 1u; l < kLevelCount; l = l + 1u) {
+      let level = top - l;
+      let c = cellCoord(p, level);
+      let lo = max((c / 2 - vec3<i32>(1)) * 2, vec3<i32>(0));
+      let hi = min((c / 2 + vec3<i32>(1)) * 2 + vec3<i32>(1),
+                   vec3<i32>(i32(levelDim(level)) - 1));
+      for (var z = lo.z; z <= hi.z; z = z + 1) {
+        for (var y = lo.y; y <= hi.y; y = y + 1) {
+          for (var x = lo.x; x <= hi.x; x = x + 1) {
+            let k = vec3<i32>(x, y, z);
+            if (!isNeighbour(k, c)) {
+              force = force + cellForce(p, gridCells[cellIndex(k, level)]);
+            }
+          }
+        }
+      }
+    }
+
+    // Neighbours at the finest level, the body is taken out of its own cell
+    let c = cellCoord(p, 0u);
+    let lo = max(c - vec3<i32>(1), vec3<i32>(0));
+    let hi = min(c + vec3<i32>(1), vec3<i32>(i32(kGridDim) - 1));
+    for (var z = lo.z; z <= hi.z; z = z + 1) {
+      for (var y = lo.y; y <= hi.y; y = y + 1) {
+        for (var x = lo.x; x <= hi.x; x = x + 1) {
+          let k = vec3<i32>(x, y, z);
+          var cell = gridCells[cellIndex(k, 0u)];
+          if (all(k == c)) {
+            let mass = cell.w - body.w;
+            if (mass <= 0.0) {
+              continue;
+            }
+            cell = vec4<f32>((cell.xyz * cell.w - p * body.w) / mass, mass);
+          }
+          force = force + cellForce(p, cell);
+        }
+      }
+    }
+
+    let velocity = velocities[id.x] + vec4<f32>(force, 0.0) * kDelta;
+    velocities[id.x] = velocity;
+    positionsOut[id.x] = body + velocity * kDelta;
+  }
+);
+
+static const char* n_body_render_shader_wgsl = CODE(
+  struct RenderParams {
+    viewProjectionMatrix : mat4x4<f32>,
+    alpha : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> renderParams : RenderParams;
+
+  struct VertexOut {
+    @builtin(position) position : vec4<f32>,
+    @location(0) positionInQuad : vec2<f32>,
+  };
+
+  @vertex
+  fn vs_main(@builtin(vertex_index) vertexIndex : u32,
+             @location(0) currentPosition : vec4<f32>,
+             @location(1) previousPosition : vec4<f32>) -> VertexOut {
+    let kPointSize = 0.004;
+    var vertexOffsets = array<vec2<f32>, 6>(
+      vec2<f32>(-1.0, -1.0),
+      vec2<f32>(-1.0,  1.0),
+      vec2<f32>( 1.0, -1.0),
+      vec2<f32>( 1.0, -1.0),
+      vec2<f32>(-1.0,  1.0),
+      vec2<f32>( 1.0,  1.0)
+    );
+    let offset = vertexOffsets[vertexIndex];
+    let position = mix(previousPosition, currentPosition, renderParams.alpha);
+    var out : VertexOut;
+    out.position = renderParams.viewProjectionMatrix
+                   * vec4<f32>(position.xy + offset * kPointSize,
+                               position.z, 1.0);
+    out.positionInQuad = offset;
+    return out;
+  }
+
+  @fragment
+  fn fs_main(@location(0) positionInQuad : vec2<f32>)
+    -> @location(0) vec4<f32> {
+    // Round points with a falloff towards the edge
+    let d = length(positionInQuad);
+    if (d > 1.0) {
+      discard;
+    }
+    return vec4<f32>(1.0, 0.6, 0.2, 1.0) * (1.0 - d) * 0.5;
+  }
+);
+// clang-format on
 
 // Other variables
 static const char* example_title = "N-Body Simulation";
@@ -123,12 +519,28 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
 
   // Write the render parameters to the uniform buffer
   wgpu_queue_write_buffer(wgpu_context, uniform_buffers.render_params.buffer, 0,
-                          render_params.view_projection_matrix,
-                          uniform_buffers.render_params.size);
+                          render_params.view_projection_matrix, sizeof(mat4));
 
   render_params.changed = false;
 }
 
+// The bodies are drawn between the last two steps, as far as the frame is past
+// the last one
+static void update_interpolation(wgpu_example_context_t* context)
+{
+  const float alpha
+    = has_previous_positions[context->simulation.read_index]
+          && !context->paused ?
+        context->simulation.alpha :
+        1.0f;
+  if (alpha != render_params.alpha) {
+    wgpu_queue_write_buffer(context->wgpu_context,
+                            uniform_buffers.render_params.buffer, sizeof(mat4),
+                            &alpha, sizeof(float));
+    render_params.alpha = alpha;
+  }
+}
+
 // Prepare and initialize uniform buffer containing shader uniforms
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
 {
@@ -137,63 +549,67 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
     context->wgpu_context,
     &(wgpu_buffer_desc_t){
       .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-      .size  = sizeof(mat4), // sizeof(mat4x4<f32>)
+      .size  = sizeof(mat4) + 4 * sizeof(float), // sizeof(RenderParams)
     });
 
   update_uniform_buffers(context);
 }
 
-// Generate initial positions on the surface of a sphere
-static void init_bodies(wgpu_context_t* wgpu_context)
-{
-  const float radius = 0.6f;
-  float* positions   = storage_buffers.positions_in.positions;
-  ASSERT(positions)
-  float longitude = 0.0f, latitude = 0.0f;
-  for (uint32_t i = 0; i < num_bodies; ++i) {
-    longitude            = 2.0f * PI * random_float();
-    latitude             = acos((2.0f * random_float() - 1.0f));
-    positions[i * 4 + 0] = radius * sin(latitude) * cos(longitude);
-    positions[i * 4 + 1] = radius * sin(latitude) * sin(longitude);
-    positions[i * 4 + 2] = radius * cos(latitude);
-    positions[i * 4 + 3] = 1.0f;
-  }
-
-  // Write the render parameters to the uniform buffer
-  wgpu_queue_write_buffer(wgpu_context,
-                          storage_buffers.positions_in.buffer.buffer, 0,
-                          storage_buffers.positions_in.positions,
-                          storage_buffers.positions_in.buffer.size);
-}
-
 // Create buffers for body positions and velocities.
-static void prepare_storage_buffers(wgpu_example_context_t* context)
+static void prepare_storage_buffers(wgpu_context_t* wgpu_context)
 {
-  storage_buffers.positions_in.buffer = wgpu_create_buffer(
-    context->wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage
-               | WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
-      .size = num_bodies * 4 * 4,
-    });
-
-  storage_buffers.positions_out = wgpu_create_buffer(
-    context->wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage
-               | WGPUBufferUsage_Vertex,
-      .size = num_bodies * 4 * 4,
-    });
+  const uint32_t size = simulation.num_bodies * 4 * sizeof(float);
+  // The steps of a state continue from a copy of the other one
+  const WGPUBufferUsage usage
+    = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex
+      | (simulation.state_count > 1 ?
+           WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst :
+           WGPUBufferUsage_None);
+
+  static const char* labels[2][2] = {
+    {"n_body_positions_in_buffer", "n_body_positions_out_buffer"},
+    {"n_body_async_positions_in_buffer", "n_body_async_positions_out_buffer"},
+  };
+  // The initial positions are generated on the GPU on the surface of a
+  // sphere, every state starts with them so that the drawn one is valid
+  wgpu_gpu_random_fill_desc_t fills[2] = {0};
+  const uint32_t seed                  = (uint32_t)rand();
+  for (uint32_t state = 0; state < simulation.state_count; ++state) {
+    storage_buffers.positions[state][0] = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = labels[state][0],
+                      .usage = usage,
+                      .size  = size,
+                      .count = simulation.num_bodies,
+                    });
+    storage_buffers.positions[state][1] = wgpu_create_buffer(
+      wgpu_context, &(wgpu_buffer_desc_t){
+                      .label = labels[state][1],
+                      .usage = usage,
+                      .size  = size,
+                    });
+
+    fills[state] = (wgpu_gpu_random_fill_desc_t){
+      .buffer          = storage_buffers.positions[state][0].buffer,
+      .element_count   = simulation.num_bodies,
+      .component_count = 4,
+      .distribution    = WGPU_GPU_RANDOM_DISTRIBUTION_SPHERE_SHELL,
+      .seed            = seed,
+      .min             = {0.0f, 0.0f, 0.0f, 1.0f}, /* w = 1 */
+      .max             = {0.0f, 0.0f, 0.0f, 1.0f},
+      .inner_radius    = 0.6f,
+      .outer_radius    = 0.6f,
+    };
+  }
+  wgpu_gpu_random_fill(wgpu_context, fills, simulation.state_count);
 
+  // Buffers are zero initialized, the bodies start at rest
   storage_buffers.velocities = wgpu_create_buffer(
-    context->wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
-      .size  = num_bodies * 4 * 4,
-    });
-
-  // Generate initial positions on the surface of a sphere
-  init_bodies(context->wgpu_context);
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "n_body_velocities_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = size,
+                  });
 }
 
 static void setup_compute_pipeline_layout(wgpu_context_t* wgpu_context)
@@ -205,7 +621,7 @@ static void setup_compute_pipeline_layout(wgpu_context_t* wgpu_context)
       .visibility = WGPUShaderStage_Compute,
       .buffer = (WGPUBufferBindingLayout) {
         .type           = WGPUBufferBindingType_ReadOnlyStorage,
-        .minBindingSize = storage_buffers.positions_in.buffer.size,
+        .minBindingSize = storage_buffers.positions[0][0].size,
       },
       .sampler = {0},
     },
@@ -214,7 +630,7 @@ static void setup_compute_pipeline_layout(wgpu_context_t* wgpu_context)
       .visibility = WGPUShaderStage_Compute,
       .buffer = (WGPUBufferBindingLayout) {
         .type           = WGPUBufferBindingType_Storage,
-        .minBindingSize = storage_buffers.positions_out.size,
+        .minBindingSize = storage_buffers.positions[0][1].size,
       },
       .sampler = {0},
     },
@@ -228,20 +644,14 @@ static void setup_compute_pipeline_layout(wgpu_context_t* wgpu_context)
       .sampler = {0},
     },
   };
-  WGPUBindGroupLayoutDescriptor bgl_desc = {
-    .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-    .entries    = bgl_entries,
-  };
-  bind_group_layouts.compute
-    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
+  // The layouts are shared with earlier simulations of the same body count,
+  // so are their compute pipelines in the pipeline cache
+  bind_group_layouts.compute = wgpu_get_bind_group_layout(
+    wgpu_context, bgl_entries, (uint32_t)ARRAY_SIZE(bgl_entries));
   ASSERT(bind_group_layouts.compute != NULL);
 
-  WGPUPipelineLayoutDescriptor compute_pipeline_layout_desc = {
-    .bindGroupLayoutCount = 1,
-    .bindGroupLayouts     = &bind_group_layouts.compute,
-  };
-  pipeline_layouts.compute = wgpuDeviceCreatePipelineLayout(
-    wgpu_context->device, &compute_pipeline_layout_desc);
+  pipeline_layouts.compute
+    = wgpu_get_pipeline_layout(wgpu_context, &bind_group_layouts.compute, 1);
   ASSERT(pipeline_layouts.compute != NULL);
 }
 
@@ -276,75 +686,46 @@ static void setup_render_pipeline_layout(wgpu_context_t* wgpu_context)
   ASSERT(pipeline_layouts.render != NULL);
 }
 
-// Create the bind group for the compute shader.
-static void setup_compute_bind_group(wgpu_context_t* wgpu_context)
+// Create the bind groups for the compute shader, ping-ponging the positions
+static void setup_compute_bind_groups(wgpu_context_t* wgpu_context,
+                                      uint32_t state)
 {
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-    [0] = (WGPUBindGroupEntry) {
-      // Binding 0 : Input Positions
-      .binding = 0,
-      .buffer  = storage_buffers.positions_in.buffer.buffer,
-      .offset  = 0,
-      .size    = storage_buffers.positions_in.buffer.size,
-    },
-    [1] = (WGPUBindGroupEntry) {
-      // Binding 1 : Output Positions
-      .binding = 1,
-      .buffer  = storage_buffers.positions_out.buffer,
-      .offset  = 0,
-      .size    = storage_buffers.positions_out.size,
-    },
-    [2] = (WGPUBindGroupEntry) {
-      // Binding 2 : Velocities
-      .binding = 2,
-      .buffer  = storage_buffers.velocities.buffer,
-      .offset  = 0,
-      .size    = storage_buffers.velocities.size,
-    },
+  const wgpu_buffer_t* positions[2] = {
+    &storage_buffers.positions[state][0],
+    &storage_buffers.positions[state][1],
   };
-
-    bind_groups.compute[0] = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, &(WGPUBindGroupDescriptor){
-                              .layout     = bind_group_layouts.compute,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            });
-    ASSERT(bind_groups.compute[0] != NULL);
-  }
-
-  {
+  for (uint32_t i = 0; i < 2; ++i) {
     WGPUBindGroupEntry bg_entries[3] = {
       [0] = (WGPUBindGroupEntry) {
-        // Binding 0 : Output Positions
+        // Binding 0 : Input Positions
         .binding = 0,
-        .buffer  = storage_buffers.positions_out.buffer,
+        .buffer  = positions[i]->buffer,
         .offset  = 0,
-        .size    = storage_buffers.positions_out.size,
+        .size    = positions[i]->size,
       },
       [1] = (WGPUBindGroupEntry) {
-        // Binding 1 : Input Positions
+        // Binding 1 : Output Positions
         .binding = 1,
-        .buffer  = storage_buffers.positions_in.buffer.buffer,
+        .buffer  = positions[1 - i]->buffer,
         .offset  = 0,
-        .size    = storage_buffers.positions_in.buffer.size,
+        .size    = positions[1 - i]->size,
       },
-    [2] = (WGPUBindGroupEntry) {
-      // Binding 2 : Velocities
-      .binding = 2,
-      .buffer  = storage_buffers.velocities.buffer,
-      .offset  = 0,
-      .size    = storage_buffers.velocities.size,
-    },
-  };
+      [2] = (WGPUBindGroupEntry) {
+        // Binding 2 : Velocities
+        .binding = 2,
+        .buffer  = storage_buffers.velocities.buffer,
+        .offset  = 0,
+        .size    = storage_buffers.velocities.size,
+      },
+    };
 
-    bind_groups.compute[1] = wgpuDeviceCreateBindGroup(
+    bind_groups.compute[state][i] = wgpuDeviceCreateBindGroup(
       wgpu_context->device, &(WGPUBindGroupDescriptor){
                               .layout     = bind_group_layouts.compute,
                               .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
                               .entries    = bg_entries,
                             });
-    ASSERT(bind_groups.compute[1] != NULL);
+    ASSERT(bind_groups.compute[state][i] != NULL);
   }
 }
 
@@ -398,16 +779,29 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
 // Create the compute pipeline
 static void prepare_compute_pipeline(wgpu_context_t* wgpu_context)
 {
+  // The workgroup size and the tile size of the shader are specialized with
+  // an override constant, the compiler unrolls the tile loop and the module
+  // is shared by all workgroup sizes
+  WGPUConstantEntry constants[1] = {
+    [0] = (WGPUConstantEntry){
+      .key   = "kWorkgroupSize",
+      .value = (double)simulation.workgroup_size,
+    },
+  };
+
   // Compute shader
   wgpu_shader_t compute_shader = wgpu_shader_create(
     wgpu_context, &(wgpu_shader_desc_t){
                     // Compute shader WGSL
-                    .file  = "shaders/n_body_simulation/n_body_simulation.wgsl",
-                    .entry = "cs_main",
+                    .label            = "n_body_compute_shader",
+                    .wgsl_code.source = n_body_compute_shader_wgsl,
+                    .entry            = "cs_main",
+                    .constant_count   = (uint32_t)ARRAY_SIZE(constants),
+                    .constants        = constants,
                   });
 
-  pipelines.compute = wgpuDeviceCreateComputePipeline(
-    wgpu_context->device,
+  pipelines.compute = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context,
     &(WGPUComputePipelineDescriptor){
       .label   = "n_body_simulation_compute_pipeline",
       .layout  = pipeline_layouts.compute,
@@ -419,6 +813,230 @@ static void prepare_compute_pipeline(wgpu_context_t* wgpu_context)
   wgpu_shader_release(&compute_shader);
 }
 
+// Clamp the simulation parameters to the device limits
+static void validate_simulation(wgpu_context_t* wgpu_context)
+{
+  simulation.num_bodies
+    = MIN(MAX(simulation.num_bodies, 1u), (uint32_t)MAX_NUM_BODIES);
+
+  WGPUSupportedLimits supported = {0};
+  if (wgpuDeviceGetLimits(wgpu_context->device, &supported)) {
+    const WGPULimits* limits = &supported.limits;
+    if (simulation.workgroup_size == 0
+        || simulation.workgroup_size > limits->maxComputeInvocationsPerWorkgroup
+        || simulation.workgroup_size > limits->maxComputeWorkgroupSizeX
+        || simulation.workgroup_size * 4 * sizeof(float)
+             > limits->maxComputeWorkgroupStorageSize) {
+      log_warn("Unsupported workgroup size %u, using %u",
+               simulation.workgroup_size, DEFAULT_WORKGROUP_SIZE);
+      simulation.workgroup_size = DEFAULT_WORKGROUP_SIZE;
+    }
+  }
+}
+
+static uint32_t get_grid_level_cell_count(uint32_t level)
+{
+  const uint32_t dim = GRID_FINEST_DIM >> level;
+  return dim * dim * dim;
+}
+
+// Create the grid pyramid buffers and bind group, independent of the bodies
+static void prepare_grid(wgpu_context_t* wgpu_context)
+{
+  uint32_t cell_count = 0;
+  for (uint32_t level = 0; level < GRID_LEVEL_COUNT; ++level) {
+    cell_count += get_grid_level_cell_count(level);
+  }
+
+  grid.accumulators = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "n_body_grid_accumulators_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size = get_grid_level_cell_count(0) * 4 * sizeof(uint32_t),
+                  });
+  grid.cells = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "n_body_grid_cells_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = cell_count * 4 * sizeof(float),
+                  });
+
+  uint8_t level_params[GRID_LEVEL_COUNT * GRID_LEVEL_PARAMS_STRIDE] = {0};
+  for (uint32_t level = 0; level < GRID_LEVEL_COUNT; ++level) {
+    memcpy(&level_params[level * GRID_LEVEL_PARAMS_STRIDE], &level,
+           sizeof(level));
+  }
+  grid.level_params = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label        = "n_body_grid_level_params_buffer",
+                    .usage        = WGPUBufferUsage_Uniform,
+                    .size         = sizeof(level_params),
+                    .initial.data = level_params,
+                  });
+
+  WGPUBindGroupLayoutEntry bgl_entries[3] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Fixed point accumulators
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = grid.accumulators.size,
+      },
+      .sampler = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Cells of all levels
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = grid.cells.size,
+      },
+      .sampler = {0},
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Level of the pass
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type             = WGPUBufferBindingType_Uniform,
+        .hasDynamicOffset = true,
+        .minBindingSize   = 4 * sizeof(uint32_t),
+      },
+      .sampler = {0},
+    },
+  };
+  grid.bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "n_body_grid_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(grid.bind_group_layout != NULL);
+
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = grid.accumulators.buffer,
+      .size    = grid.accumulators.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = grid.cells.buffer,
+      .size    = grid.cells.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = grid.level_params.buffer,
+      .size    = 4 * sizeof(uint32_t),
+    },
+  };
+  grid.bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "n_body_grid_bind_group",
+                            .layout     = grid.bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(grid.bind_group != NULL);
+}
+
+// Create the grid pipelines, sharing the body bindings of the compute pipeline
+static void prepare_grid_pipelines(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupLayout bind_group_layouts_grid[2] = {
+    bind_group_layouts.compute, /* Group 0 */
+    grid.bind_group_layout,     /* Group 1 */
+  };
+  grid.pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "n_body_grid_pipeline_layout",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts_grid),
+      .bindGroupLayouts     = bind_group_layouts_grid,
+    });
+  ASSERT(grid.pipeline_layout != NULL);
+
+  wgpu_shader_t grid_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "n_body_grid_shader",
+                    .wgsl_code.source = n_body_grid_shader_wgsl,
+                    .entry            = "cs_clear",
+                  });
+
+  struct {
+    WGPUComputePipeline* pipeline;
+    const char* entry;
+  } grid_passes[5] = {
+    {&grid.pipelines.clear, "cs_clear"},
+    {&grid.pipelines.bin, "cs_bin"},
+    {&grid.pipelines.resolve, "cs_resolve"},
+    {&grid.pipelines.reduce, "cs_reduce"},
+    {&grid.pipelines.force, "cs_force"},
+  };
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(grid_passes); ++i) {
+    WGPUProgrammableStageDescriptor stage
+      = grid_shader.programmable_stage_descriptor;
+    stage.entryPoint          = grid_passes[i].entry;
+    *grid_passes[i].pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                              .label   = "n_body_grid_pipeline",
+                              .layout  = grid.pipeline_layout,
+                              .compute = stage,
+                            });
+    ASSERT(*grid_passes[i].pipeline != NULL);
+  }
+
+  // Partial cleanup
+  wgpu_shader_release(&grid_shader);
+}
+
+static void release_grid(void)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, grid.bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, grid.bind_group_layout)
+  wgpu_destroy_buffer(&grid.level_params);
+  wgpu_destroy_buffer(&grid.cells);
+  wgpu_destroy_buffer(&grid.accumulators);
+}
+
+// Create the compute resources of the current body count and workgroup size
+static void prepare_simulation(wgpu_context_t* wgpu_context)
+{
+  validate_simulation(wgpu_context);
+  prepare_storage_buffers(wgpu_context);
+  setup_compute_pipeline_layout(wgpu_context);
+  prepare_compute_pipeline(wgpu_context);
+  prepare_grid_pipelines(wgpu_context);
+  for (uint32_t state = 0; state < simulation.state_count; ++state) {
+    setup_compute_bind_groups(wgpu_context, state);
+    frame_idx[state]              = 0;
+    has_previous_positions[state] = false;
+  }
+}
+
+static void release_simulation(void)
+{
+  for (uint32_t state = 0; state < simulation.state_count; ++state) {
+    for (uint32_t i = 0; i < 2; ++i) {
+      WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.positions[state][i].buffer)
+      WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.compute[state][i])
+    }
+  }
+  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.velocities.buffer)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.compute)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.compute)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, pipelines.compute)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, grid.pipelines.clear)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, grid.pipelines.bin)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, grid.pipelines.resolve)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, grid.pipelines.reduce)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, grid.pipelines.force)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, grid.pipeline_layout)
+}
+
 // Create the graphics pipeline
 static void prepare_render_pipeline(wgpu_context_t* wgpu_context)
 {
@@ -451,17 +1069,29 @@ static void prepare_render_pipeline(wgpu_context_t* wgpu_context)
     // Attribute location 0: Position
     WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x4, 0))
   position_vertex_buffer_layout.stepMode = WGPUVertexStepMode_Instance;
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    previous_position, 4 * sizeof(float),
+    /* Attribute descriptions */
+    // Attribute location 1: Position of the previous step
+    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x4, 0))
+  previous_position_vertex_buffer_layout.stepMode
+    = WGPUVertexStepMode_Instance;
+  WGPUVertexBufferLayout vertex_buffer_layouts[2] = {
+    position_vertex_buffer_layout,
+    previous_position_vertex_buffer_layout,
+  };
 
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
                 wgpu_context, &(wgpu_vertex_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
                   // Vertex shader WGSL
-                  .file  = "shaders/n_body_simulation/n_body_simulation.wgsl",
-                  .entry = "vs_main",
+                  .label            = "n_body_render_shader",
+                  .wgsl_code.source = n_body_render_shader_wgsl,
+                  .entry            = "vs_main",
                 },
-                .buffer_count = 1,
-                .buffers = &position_vertex_buffer_layout,
+                .buffer_count = (uint32_t)ARRAY_SIZE(vertex_buffer_layouts),
+                .buffers      = vertex_buffer_layouts,
               });
 
   // Fragment state
@@ -469,8 +1099,9 @@ static void prepare_render_pipeline(wgpu_context_t* wgpu_context)
                 wgpu_context, &(wgpu_fragment_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
                   // Fragment shader WGSL
-                  .file  = "shaders/n_body_simulation/n_body_simulation.wgsl",
-                  .entry = "fs_main",
+                  .label            = "n_body_render_shader",
+                  .wgsl_code.source = n_body_render_shader_wgsl,
+                  .entry            = "fs_main",
                 },
                 .target_count = 1,
                 .targets = &color_target_state,
@@ -504,13 +1135,13 @@ static void prepare_render_pipeline(wgpu_context_t* wgpu_context)
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
+    simulation.state_count
+      = context->simulation.settings.async_compute ? 2 : 1;
     prepare_uniform_buffers(context);
-    prepare_storage_buffers(context);
-    setup_compute_pipeline_layout(context->wgpu_context);
+    prepare_grid(context->wgpu_context);
+    prepare_simulation(context->wgpu_context);
     setup_render_pipeline_layout(context->wgpu_context);
-    prepare_compute_pipeline(context->wgpu_context);
     prepare_render_pipeline(context->wgpu_context);
-    setup_compute_bind_group(context->wgpu_context);
     setup_render_bind_group(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
@@ -520,11 +1151,172 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static int32_t get_setting_index(const char** names, uint32_t count,
+                                 uint32_t value)
+{
+  for (uint32_t i = 0; i < count; ++i) {
+    if ((uint32_t)atoi(names[i]) == value) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    int32_t mode = (int32_t)simulation.mode;
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Mode", &mode,
+                                simulation_mode_names,
+                                ARRAY_SIZE(simulation_mode_names))) {
+      simulation.mode = (simulation_mode_t)mode;
+    }
+    int32_t num_bodies_index
+      = get_setting_index(num_bodies_names, ARRAY_SIZE(num_bodies_names),
+                          simulation.num_bodies);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Bodies",
+                                &num_bodies_index, num_bodies_names,
+                                ARRAY_SIZE(num_bodies_names))) {
+      simulation.num_bodies = atoi(num_bodies_names[num_bodies_index]);
+      simulation.changed    = true;
+    }
+    int32_t workgroup_size_index = get_setting_index(
+      workgroup_size_names, ARRAY_SIZE(workgroup_size_names),
+      simulation.workgroup_size);
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Workgroup size",
+                                &workgroup_size_index, workgroup_size_names,
+                                ARRAY_SIZE(workgroup_size_names))) {
+      simulation.workgroup_size
+        = atoi(workgroup_size_names[workgroup_size_index]);
+      simulation.changed = true;
+    }
+  }
+  if (imgui_overlay_header("Statistics")) {
+    imgui_overlay_text("%.1f fps", fps_counter.fps);
+    imgui_overlay_text("%.1f steps/s", fps_counter.steps_per_second);
+    if (simulation.mode == SIMULATION_MODE_ALL_PAIRS) {
+      const double interactions
+        = (double)simulation.num_bodies * simulation.num_bodies;
+      imgui_overlay_text("%.2f G interactions/s",
+                         interactions * fps_counter.steps_per_second / 1e9);
+    }
+    const wgpu_gpu_profiler_result_t* gpu_timings = NULL;
+    const uint32_t gpu_timing_count = wgpu_gpu_profiler_get_results(
+      context->wgpu_context->gpu_profiler, &gpu_timings);
+    for (uint32_t i = 0; i < gpu_timing_count; ++i) {
+      if (strcmp(gpu_timings[i].name, step_scope_name) == 0) {
+        imgui_overlay_text("Steps: %.3f ms", gpu_timings[i].gpu_time_ms);
+      }
+    }
+    if (simulation.state_count > 1) {
+      const wgpu_queue_fence_t* fence = &context->simulation.fence;
+      imgui_overlay_text("Step submissions in flight: %llu",
+                         (unsigned long long)(fence->signaled
+                                              - fence->completed));
+    }
+  }
+}
+
+static void dispatch_grid_pass(WGPUComputePassEncoder pass_encoder,
+                               WGPUComputePipeline pipeline, uint32_t level,
+                               uint32_t invocation_count)
+{
+  const uint32_t dynamic_offset = level * GRID_LEVEL_PARAMS_STRIDE;
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, grid.bind_group, 1,
+                                     &dynamic_offset);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    (invocation_count + GRID_WORKGROUP_SIZE - 1) / GRID_WORKGROUP_SIZE, 1, 1);
+}
+
+// Bin the bodies, build the pyramid bottom-up and integrate the bodies
+static void record_grid_step(WGPUComputePassEncoder pass_encoder,
+                             WGPUBindGroup bind_group)
+{
+  const uint32_t finest_cell_count = get_grid_level_cell_count(0);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  dispatch_grid_pass(pass_encoder, grid.pipelines.clear, 0,
+                     finest_cell_count * 4);
+  dispatch_grid_pass(pass_encoder, grid.pipelines.bin, 0,
+                     simulation.num_bodies);
+  dispatch_grid_pass(pass_encoder, grid.pipelines.resolve, 0,
+                     finest_cell_count);
+  for (uint32_t level = 1; level < GRID_LEVEL_COUNT; ++level) {
+    dispatch_grid_pass(pass_encoder, grid.pipelines.reduce, level,
+                       get_grid_level_cell_count(level));
   }
+  dispatch_grid_pass(pass_encoder, grid.pipelines.force, 0,
+                     simulation.num_bodies);
+}
+
+// Compute pass with the steps scheduled for this frame, writing the given
+// state
+static void record_steps(wgpu_context_t* wgpu_context,
+                         WGPUCommandEncoder cmd_enc, uint32_t state,
+                         uint32_t step_count)
+{
+  const uint32_t scope = wgpu_gpu_profiler_begin_scope(
+    wgpu_context->gpu_profiler, cmd_enc, step_scope_name);
+  wgpu_context->cpass_enc = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  const uint32_t statistics_scope
+    = wgpu_pipeline_statistics_begin_compute_scope(
+      wgpu_context->pipeline_statistics, wgpu_context->cpass_enc,
+      step_scope_name);
+  for (uint32_t step = 0; step < step_count; ++step) {
+    WGPUBindGroup bind_group = bind_groups.compute[state][frame_idx[state]];
+    if (simulation.mode == SIMULATION_MODE_GRID) {
+      record_grid_step(wgpu_context->cpass_enc, bind_group);
+    }
+    else {
+      // Set up the compute shader dispatch
+      wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
+                                        pipelines.compute);
+      wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
+                                         bind_group, 0, NULL);
+      wgpuComputePassEncoderDispatchWorkgroups(
+        wgpu_context->cpass_enc,
+        (simulation.num_bodies + simulation.workgroup_size - 1)
+          / simulation.workgroup_size,
+        1, 1);
+    }
+    frame_idx[state] = (frame_idx[state] + 1) % 2;
+  }
+  wgpu_pipeline_statistics_end_compute_scope(
+    wgpu_context->pipeline_statistics, wgpu_context->cpass_enc,
+    statistics_scope);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+  wgpu_gpu_profiler_end_scope(wgpu_context->gpu_profiler, cmd_enc, scope);
+  has_previous_positions[state] = true;
+  fps_counter.num_steps_since_fps_update += step_count;
+}
+
+// Async compute: the steps continue from a copy of the drawn positions in the
+// other state, in a command buffer of their own
+static WGPUCommandBuffer
+build_simulation_command_buffer(wgpu_example_context_t* context,
+                                uint32_t step_count)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  const uint32_t read          = context->simulation.read_index;
+  const uint32_t write         = context->simulation.write_index;
+
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  const wgpu_buffer_t* positions = &storage_buffers.positions[read][0];
+  wgpuCommandEncoderCopyBufferToBuffer(
+    cmd_enc, positions[frame_idx[read]].buffer, 0,
+    storage_buffers.positions[write][0].buffer, 0, positions->size);
+  frame_idx[write] = 0;
+  record_steps(wgpu_context, cmd_enc, write, step_count);
+
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  ASSERT(command_buffer != NULL)
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+
+  return command_buffer;
 }
 
 static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
@@ -536,35 +1328,30 @@ static WGPUCommandBuffer build_command_buffer(wgpu_example_context_t* context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  // Compute pass
-  if (!context->paused) {
-    // Set up the compute shader dispatch
-    wgpu_context->cpass_enc
-      = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
-    wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
-                                      pipelines.compute);
-    wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
-                                       bind_groups.compute[frame_idx], 0, NULL);
-    wgpuComputePassEncoderDispatchWorkgroups(
-      wgpu_context->cpass_enc, ceil(num_bodies / (float)workgroup_size), 1, 1);
-    wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
-    WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
-    frame_idx = (frame_idx + 1) % 2;
-  }
-
-  // Render pass
+  // Compute pass, unless the steps were submitted ahead with async compute
+  const uint32_t step_count
+    = context->paused ? 0 : context->simulation.step_count;
+  if (step_count > 0 && simulation.state_count == 1) {
+    record_steps(wgpu_context, wgpu_context->cmd_enc, 0, step_count);
+  }
+
+  // Render pass, drawing the last and the previous positions of the state
   {
-    wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
+    const uint32_t state           = context->simulation.read_index;
+    const wgpu_buffer_t* positions = storage_buffers.positions[state];
+    wgpu_context->rpass_enc        = wgpuCommandEncoderBeginRenderPass(
       wgpu_context->cmd_enc, &render_pass.descriptor);
     wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipelines.render);
     wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
                                       bind_groups.render, 0, NULL);
     wgpuRenderPassEncoderSetVertexBuffer(
-      wgpu_context->rpass_enc, 0,
-      frame_idx == 0 ? storage_buffers.positions_in.buffer.buffer :
-                       storage_buffers.positions_out.buffer,
-      0, WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 6, num_bodies, 0, 0);
+      wgpu_context->rpass_enc, 0, positions[frame_idx[state]].buffer, 0,
+      WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderSetVertexBuffer(
+      wgpu_context->rpass_enc, 1, positions[1 - frame_idx[state]].buffer, 0,
+      WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 6,
+                              simulation.num_bodies, 0, 0);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
   }
@@ -586,6 +1373,16 @@ static int example_draw(wgpu_example_context_t* context)
   // Prepare frame
   prepare_frame(context);
 
+  // With async compute the steps are submitted first, writing the state that
+  // is not drawn
+  if (simulation.state_count > 1 && !context->paused
+      && context->simulation.step_count > 0) {
+    submit_simulation_command_buffer(
+      context,
+      build_simulation_command_buffer(context,
+                                      context->simulation.step_count));
+  }
+
   // Command buffer to be submitted to the queue
   wgpu_context_t* wgpu_context                   = context->wgpu_context;
   wgpu_context->submit_info.command_buffer_count = 1;
@@ -608,8 +1405,11 @@ static void update_fps_counter(wgpu_example_context_t* context)
     if (time_since_last_log >= fps_counter.fps_update_interval) {
       fps_counter.fps = fps_counter.num_frames_since_fps_update
                         / (time_since_last_log / 1000.0);
+      fps_counter.steps_per_second = fps_counter.num_steps_since_fps_update
+                                     / (time_since_last_log / 1000.0);
       fps_counter.last_fps_update_time        = now;
       fps_counter.num_frames_since_fps_update = 0;
+      fps_counter.num_steps_since_fps_update  = 0;
     }
   }
   else {
@@ -624,7 +1424,13 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  if (simulation.changed) {
+    release_simulation();
+    prepare_simulation(context->wgpu_context);
+    simulation.changed = false;
+  }
   update_fps_counter(context);
+  update_interpolation(context);
   bool result = example_draw(context);
   if (render_params.changed) {
     update_uniform_buffers(context);
@@ -652,29 +1458,57 @@ static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
 
+  release_simulation();
+  release_grid();
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.render_params.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.positions_in.buffer.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.positions_out.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, storage_buffers.velocities.buffer)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.compute)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.render)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.compute[0])
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.compute[1])
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.render)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.compute)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.render)
-  WGPU_RELEASE_RESOURCE(ComputePipeline, pipelines.compute)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.render)
 }
 
+// Parse the --mode=<all-pairs|grid>, --bodies=<n> and --workgroup-size=<n>
+// options
+static void parse_simulation_arguments(int argc, char* argv[])
+{
+  static const char bodies_option[]         = "--bodies=";
+  static const char workgroup_size_option[] = "--workgroup-size=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--mode=grid") == 0) {
+      simulation.mode = SIMULATION_MODE_GRID;
+    }
+    else if (strcmp(argv[i], "--mode=all-pairs") == 0) {
+      simulation.mode = SIMULATION_MODE_ALL_PAIRS;
+    }
+    else if (strncmp(argv[i], bodies_option, strlen(bodies_option)) == 0) {
+      simulation.num_bodies
+        = (uint32_t)strtoul(argv[i] + strlen(bodies_option), NULL, 10);
+    }
+    else if (strncmp(argv[i], workgroup_size_option,
+                     strlen(workgroup_size_option))
+             == 0) {
+      simulation.workgroup_size = (uint32_t)strtoul(
+        argv[i] + strlen(workgroup_size_option), NULL, 10);
+    }
+  }
+}
+
 void example_n_body_simulation(int argc, char* argv[])
 {
+  parse_simulation_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
       .title   = example_title,
       .overlay = true,
       .vsync   = true,
+      // Workgroups above the default limit of 256 invocations, where the
+      // adapter supports them
+      .required_limits = {
+        .max_compute_invocations_per_workgroup = 1024u,
+        .max_compute_workgroup_size_x          = 1024u,
+      },
     },
     .example_initialize_func     = &example_initialize,
     .example_render_func         = &example_render,
@@ -1,10 +1,9 @@
 #include "example_base.h"
 #include "examples.h"
 
-#include <string.h>
-
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/occlusion_query_pool.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Occlusion Queries
@@ -12,11 +11,24 @@
  * Demonstrated how to use occlusion queries to get the number of fragment
  * samples that pass all the per-fragment tests for a set of drawing commands.
  *
+ * The queries go through a query pool that re-queries a rotating subset of
+ * the objects per frame, one of the two objects here, and keeps the last known
+ * visibility of the others. The results are read back asynchronously a few
+ * frames later, which scales to thousands of objects without stalls.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/occlusionquery/occlusionquery.cpp
  * -------------------------------------------------------------------------- */
 
-#define MAX_DEST_BUFFERS 1
+// Readback buffers of the query results, the results of a frame are displayed
+// a few frames later
+#define READBACK_BUFFER_COUNT 3u
+
+// Queried objects, re-queried in turns
+#define OBJECT_TEAPOT 0u
+#define OBJECT_SPHERE 1u
+#define OBJECT_COUNT 2u
+#define QUERIES_PER_FRAME 1u
 
 static struct {
   struct gltf_model_t* teapot;
@@ -61,13 +73,7 @@ static WGPUPipelineLayout pipeline_layout;
 static WGPUBindGroup bind_group;
 static WGPUBindGroupLayout bind_group_layout;
 
-static WGPUQuerySet occlusion_query_set;
-static WGPUBuffer occlusion_query_set_src_buffer;
-static WGPUBuffer occlusion_query_set_dst_buffer[MAX_DEST_BUFFERS];
-static bool dest_buffer_mapped[MAX_DEST_BUFFERS] = {0};
-
-// Passed query samples
-static uint64_t passed_samples[2] = {1, 1};
+static wgpu_occlusion_query_pool_t* occlusion_queries = NULL;
 
 // Other variables
 static const char* example_title = "Occlusion Queries";
@@ -89,7 +95,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
       | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   models.plane
     = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
       .wgpu_context       = wgpu_context,
@@ -223,19 +230,13 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
   // Depth attachment
   wgpu_setup_deph_stencil(wgpu_context, NULL);
 
-  // Occlusion query set
-  occlusion_query_set = wgpuDeviceCreateQuerySet(
-    wgpu_context->device, &(WGPUQuerySetDescriptor){
-                            .type  = WGPUQueryType_Occlusion,
-                            .count = 2,
-                          });
-
   // Render pass descriptor
   render_pass_desc = (WGPURenderPassDescriptor){
     .colorAttachmentCount   = 1,
     .colorAttachments       = rp_color_att_descriptors,
     .depthStencilAttachment = &wgpu_context->depth_stencil.att_desc,
-    .occlusionQuerySet      = occlusion_query_set,
+    .occlusionQuerySet
+    = wgpu_occlusion_query_pool_get_query_set(occlusion_queries),
   };
 }
 
@@ -432,7 +433,10 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
 
   // Teapot
   // Toggle color depending on visibility
-  ubo_vs.visible = (passed_samples[0] > 0) ? 1.0f : 0.0f;
+  ubo_vs.visible
+    = wgpu_occlusion_query_pool_is_visible(occlusion_queries, OBJECT_TEAPOT) ?
+        1.0f :
+        0.0f;
   glm_mat4_identity(identity_mtx);
   glm_translate(identity_mtx, (vec3){0.0f, 0.0f, -3.0f});
   glm_mat4_copy(identity_mtx, ubo_vs.model);
@@ -442,7 +446,10 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
 
   // Sphere
   // Toggle color depending on visibility
-  ubo_vs.visible = (passed_samples[1] > 0) ? 1.0f : 0.0f;
+  ubo_vs.visible
+    = wgpu_occlusion_query_pool_is_visible(occlusion_queries, OBJECT_SPHERE) ?
+        1.0f :
+        0.0f;
   glm_mat4_identity(identity_mtx);
   glm_translate(identity_mtx, (vec3){0.0f, 0.0f, 3.0f});
   glm_mat4_copy(identity_mtx, ubo_vs.model);
@@ -481,26 +488,16 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
   update_uniform_buffers(context);
 }
 
-// Create a buffers for storing the occlusion query result
-static void prepare_occlusion_query_set_buffers(wgpu_context_t* wgpu_context)
+// Create the query pool of the objects, the query set and the buffers for
+// storing the occlusion query results
+static void prepare_occlusion_queries(wgpu_context_t* wgpu_context)
 {
-  occlusion_query_set_src_buffer = wgpuDeviceCreateBuffer(
-    wgpu_context->device,
-    &(WGPUBufferDescriptor){
-      .usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc,
-      .size  = sizeof(passed_samples),
-      .mappedAtCreation = false,
-    });
-
-  for (uint32_t i = 0; i < (uint32_t)MAX_DEST_BUFFERS; ++i) {
-    occlusion_query_set_dst_buffer[i] = wgpuDeviceCreateBuffer(
-      wgpu_context->device,
-      &(WGPUBufferDescriptor){
-        .usage            = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
-        .size             = sizeof(passed_samples),
-        .mappedAtCreation = false,
-      });
-  }
+  occlusion_queries = wgpu_occlusion_query_pool_create(
+    wgpu_context, &(wgpu_occlusion_query_pool_desc_t){
+                    .object_count      = OBJECT_COUNT,
+                    .queries_per_frame = QUERIES_PER_FRAME,
+                    .buffer_count      = READBACK_BUFFER_COUNT,
+                  });
 }
 
 static int example_initialize(wgpu_example_context_t* context)
@@ -508,8 +505,8 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
+    prepare_occlusion_queries(context->wgpu_context);
     prepare_uniform_buffers(context);
-    prepare_occlusion_query_set_buffers(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_group(context->wgpu_context);
@@ -521,78 +518,15 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
-static int32_t get_unmapped_dest_buffer_index()
-{
-  int32_t index = -1;
-  for (uint32_t i = 0; i < (uint32_t)MAX_DEST_BUFFERS; ++i) {
-    if (!dest_buffer_mapped[i]) {
-      index = i;
-      break;
-    }
-  }
-  return index;
-}
-
-static int32_t get_mapped_dest_buffer_index()
-{
-  int32_t index = -1;
-  for (uint32_t i = 0; i < (uint32_t)MAX_DEST_BUFFERS; ++i) {
-    if (dest_buffer_mapped[i]) {
-      index = i;
-      break;
-    }
-  }
-  return index;
-}
-
-static void read_buffer_map_cb(WGPUBufferMapAsyncStatus status, void* user_data)
-{
-  UNUSED_VAR(user_data);
-
-  if (status == WGPUBufferMapAsyncStatus_Success) {
-    int32_t mapped_dest_buffer_index = get_mapped_dest_buffer_index();
-    uint64_t const* mapping          = (uint64_t*)wgpuBufferGetConstMappedRange(
-               occlusion_query_set_dst_buffer[mapped_dest_buffer_index], 0,
-               sizeof(passed_samples));
-    ASSERT(mapping)
-    memcpy(passed_samples, mapping, sizeof(passed_samples));
-    wgpuBufferUnmap(occlusion_query_set_dst_buffer[mapped_dest_buffer_index]);
-    dest_buffer_mapped[(uint64_t)mapped_dest_buffer_index] = false;
-  }
-}
-
-// Retrieves the results of the occlusion queries submitted to the command
-// buffer
-static void get_occlusion_query_results(void)
-{
-  int32_t unmapped_dest_buffer_index = get_unmapped_dest_buffer_index();
-  if (unmapped_dest_buffer_index != -1) {
-    dest_buffer_mapped[(uint64_t)unmapped_dest_buffer_index] = true;
-    wgpuBufferMapAsync(
-      occlusion_query_set_dst_buffer[(uint64_t)unmapped_dest_buffer_index],
-      WGPUMapMode_Read, 0, sizeof(passed_samples), read_buffer_map_cb, NULL);
-  }
-}
-
 static WGPUCommandBuffer resolve_query_set(wgpu_context_t* wgpu_context)
 {
   // Create command encoder
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  // Resolve occlusion queries
-  wgpuCommandEncoderResolveQuerySet(wgpu_context->cmd_enc, occlusion_query_set,
-                                    0, (uint32_t)ARRAY_SIZE(passed_samples),
-                                    occlusion_query_set_src_buffer, 0);
-
-  int32_t unmapped_dest_buffer_index = get_unmapped_dest_buffer_index();
-  if (unmapped_dest_buffer_index != -1) {
-    // Copy occlusion query result to destination buffer
-    wgpuCommandEncoderCopyBufferToBuffer(
-      wgpu_context->cmd_enc, occlusion_query_set_src_buffer, 0,
-      occlusion_query_set_dst_buffer[(uint64_t)unmapped_dest_buffer_index], 0,
-      sizeof(passed_samples));
-  }
+  // Resolve the occlusion queries of the frame and copy the results to the
+  // next readback buffer
+  wgpu_occlusion_query_pool_resolve(occlusion_queries, wgpu_context->cmd_enc);
 
   // Get command buffer
   WGPUCommandBuffer command_buffer
@@ -606,8 +540,21 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
   if (imgui_overlay_header("Occlusion query results")) {
-    imgui_overlay_text("Teapot: %d samples passed", passed_samples[0]);
-    imgui_overlay_text("Sphere: %d samples passed", passed_samples[1]);
+    const uint64_t frame
+      = wgpu_occlusion_query_pool_get_frame(occlusion_queries);
+    const char* names[OBJECT_COUNT] = {"Teapot", "Sphere"};
+    for (uint32_t i = 0; i < OBJECT_COUNT; ++i) {
+      const uint64_t result_frame
+        = wgpu_occlusion_query_pool_get_result_frame(occlusion_queries, i);
+      if (result_frame == WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME) {
+        imgui_overlay_text("%s: no result yet", names[i]);
+        continue;
+      }
+      imgui_overlay_text(
+        "%s: %d samples passed, %d frames old", names[i],
+        (int)wgpu_occlusion_query_pool_get_samples(occlusion_queries, i),
+        (int)(frame - result_frame));
+    }
   }
 }
 
@@ -616,6 +563,9 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   // Set target frame buffer
   rp_color_att_descriptors[0].view = wgpu_context->swap_chain.frame_buffer;
 
+  // Next subset of objects to query
+  wgpu_occlusion_query_pool_begin_frame(occlusion_queries);
+
   // Create command encoder
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
@@ -642,19 +592,25 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                     0);
   wgpu_gltf_model_draw(models.plane, (wgpu_gltf_model_render_options_t){0});
 
-  // Teapot
-  wgpuRenderPassEncoderBeginOcclusionQuery(wgpu_context->rpass_enc, 0);
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                    bind_groups.teapot, 0, 0);
-  wgpu_gltf_model_draw(models.teapot, (wgpu_gltf_model_render_options_t){0});
-  wgpuRenderPassEncoderEndOcclusionQuery(wgpu_context->rpass_enc);
+  // Teapot, only drawn when queried in this frame
+  if (wgpu_occlusion_query_pool_begin_query(
+        occlusion_queries, wgpu_context->rpass_enc, OBJECT_TEAPOT)) {
+    wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
+                                      bind_groups.teapot, 0, 0);
+    wgpu_gltf_model_draw(models.teapot, (wgpu_gltf_model_render_options_t){0});
+    wgpu_occlusion_query_pool_end_query(occlusion_queries,
+                                        wgpu_context->rpass_enc);
+  }
 
-  // Sphere
-  wgpuRenderPassEncoderBeginOcclusionQuery(wgpu_context->rpass_enc, 1);
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                    bind_groups.sphere, 0, 0);
-  wgpu_gltf_model_draw(models.sphere, (wgpu_gltf_model_render_options_t){0});
-  wgpuRenderPassEncoderEndOcclusionQuery(wgpu_context->rpass_enc);
+  // Sphere, only drawn when queried in this frame
+  if (wgpu_occlusion_query_pool_begin_query(
+        occlusion_queries, wgpu_context->rpass_enc, OBJECT_SPHERE)) {
+    wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
+                                      bind_groups.sphere, 0, 0);
+    wgpu_gltf_model_draw(models.sphere, (wgpu_gltf_model_render_options_t){0});
+    wgpu_occlusion_query_pool_end_query(occlusion_queries,
+                                        wgpu_context->rpass_enc);
+  }
 
   // Visible pass
   wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipelines.solid);
@@ -706,8 +662,8 @@ static int example_draw(wgpu_example_context_t* context)
   // Submit to queue
   submit_command_buffers(context);
 
-  // Read query results for displaying in next frame
-  get_occlusion_query_results();
+  // Read back the query results of earlier frames for displaying
+  wgpu_occlusion_query_pool_update(occlusion_queries);
 
   // Submit frame
   submit_frame(context);
@@ -751,15 +707,8 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
 
-  WGPU_RELEASE_RESOURCE(QuerySet, occlusion_query_set)
-  WGPU_RELEASE_RESOURCE(Buffer, occlusion_query_set_src_buffer)
-  for (uint32_t i = 0; i < (uint32_t)MAX_DEST_BUFFERS; ++i) {
-    if (dest_buffer_mapped[i]) {
-      wgpuBufferUnmap(occlusion_query_set_dst_buffer[i]);
-      dest_buffer_mapped[i] = false;
-    }
-    WGPU_RELEASE_RESOURCE(Buffer, occlusion_query_set_dst_buffer[i])
-  }
+  wgpu_occlusion_query_pool_release(occlusion_queries);
+  occlusion_queries = NULL;
 }
 
 void example_occlusion_query(int argc, char* argv[])
@@ -12,14 +12,19 @@
  * Basic offscreen rendering in two passes. First pass renders the mirrored
  * scene to a separate framebuffer with color and depth attachments, second pass
  * samples from that color attachment for rendering a mirror surface.
+ * The reflection pass is cheaper than the scene pass: it renders at a fraction
+ * of the surface resolution with a diffuse only shading, its near plane is the
+ * mirror plane (oblique projection), which culls everything on the side of the
+ * camera, and it can be updated every few frames only while the camera stays
+ * in place.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/offscreen
  * -------------------------------------------------------------------------- */
 
 // Offscreen frame buffer properties
-#define FB_DIM 512
 #define FB_COLOR_FORMAT WGPUTextureFormat_RGBA8Unorm
+#define MAX_REFLECTION_UPDATE_INTERVAL 8
 
 static bool debug_display = false;
 
@@ -55,6 +60,7 @@ static struct {
   WGPURenderPipeline debug;
   WGPURenderPipeline shaded;
   WGPURenderPipeline shaded_offscreen;
+  WGPURenderPipeline simple_offscreen;
   WGPURenderPipeline mirror;
 } pipelines = {0};
 
@@ -89,12 +95,76 @@ static struct offscreen_pass_t {
   } render_pass;
 } offscreen_pass = {0};
 
+// Cost of the reflection pass
+static const char* reflection_resolution_names[3] = {"Full", "Half", "Quarter"};
+static struct {
+  int32_t resolution_index; // 1 / 2^index of the surface size
+  bool resolution_changed;
+  int32_t update_interval; // frames between updates of the animation
+  bool simple_shading;
+  bool oblique_clipping;
+} reflection_settings = {
+  .resolution_index = 1,
+  .update_interval  = 1,
+  .simple_shading   = true,
+  .oblique_clipping = true,
+};
+
+static struct {
+  bool valid;
+  bool update; // render the reflection in this frame
+  uint32_t frames_since_update;
+} reflection_state = {0};
+
 static WGPURenderPassColorAttachment rp_color_att_descriptors[1];
 static WGPURenderPassDescriptor render_pass_desc;
 
 static const char* example_title = "Offscreen Rendering";
 static bool prepared             = false;
 
+// Diffuse only shading of the reflection, the specular highlights of the Phong
+// shading are hardly visible in the mirror
+// clang-format off
+static const char* simple_reflection_shader_wgsl = CODE(
+  struct UBO {
+    projection : mat4x4<f32>,
+    view : mat4x4<f32>,
+    model : mat4x4<f32>,
+    lightPos : vec4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> ubo : UBO;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) color : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+    @location(2) lightVec : vec3<f32>,
+  };
+
+  @vertex
+  fn vs_main(@location(0) position : vec3<f32>,
+             @location(1) color : vec4<f32>,
+             @location(2) normal : vec3<f32>) -> VertexOutput {
+    var output : VertexOutput;
+    let modelView = ubo.view * ubo.model;
+    let viewPosition = modelView * vec4<f32>(position, 1.0);
+    output.position = ubo.projection * viewPosition;
+    output.color = color.rgb;
+    output.normal = (modelView * vec4<f32>(normal, 0.0)).xyz;
+    output.lightVec = (ubo.view * ubo.lightPos).xyz - viewPosition.xyz;
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let diffuse = max(dot(normalize(input.normal),
+                          normalize(input.lightVec)), 0.0);
+    return vec4<f32>(input.color * (0.25 + 0.75 * diffuse), 1.0);
+  }
+);
+// clang-format on
+
 static void setup_camera(wgpu_example_context_t* context)
 {
   context->timer_speed *= 0.25f;
@@ -111,7 +181,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors;
+      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   models.plane
     = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
       .wgpu_context       = wgpu_context,
@@ -126,10 +197,13 @@ static void load_assets(wgpu_context_t* wgpu_context)
     });
 }
 
+// The mirror samples the reflection at its screen position, the resolution
+// is a fraction of the surface size
 static void prepare_offscreen(wgpu_context_t* wgpu_context)
 {
-  offscreen_pass.width  = (uint32_t)FB_DIM;
-  offscreen_pass.height = (uint32_t)FB_DIM;
+  const uint32_t divisor = 1u << reflection_settings.resolution_index;
+  offscreen_pass.width   = MAX(1u, wgpu_context->surface.width / divisor);
+  offscreen_pass.height  = MAX(1u, wgpu_context->surface.height / divisor);
 
   // Create the texture
   WGPUExtent3D texture_extent = {
@@ -190,7 +264,7 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
       .sampleCount   = 1,
       .dimension     = WGPUTextureDimension_2D,
       .format        = WGPUTextureFormat_Depth24PlusStencil8,
-      .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+      .usage         = WGPUTextureUsage_RenderAttachment,
     };
     offscreen_pass.depth_stencil.texture
       = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
@@ -321,9 +395,18 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
   }
 }
 
-static void setup_bind_groups(wgpu_context_t* wgpu_context)
+static void release_offscreen(void)
+{
+  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color.texture)
+  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.depth_stencil.texture)
+  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color.texture_view)
+  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.depth_stencil.texture_view)
+  WGPU_RELEASE_RESOURCE(Sampler, offscreen_pass.sampler)
+}
+
+// Bind group for Mirror, recreated with the offscreen frame buffer
+static void setup_mirror_bind_group(wgpu_context_t* wgpu_context)
 {
-  // Bind group for Mirror
   {
     WGPUBindGroupEntry bg_entries[3] = {
       [0] = (WGPUBindGroupEntry) {
@@ -353,6 +436,11 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
                             });
     ASSERT(bind_groups.mirror != NULL);
   }
+}
+
+static void setup_bind_groups(wgpu_context_t* wgpu_context)
+{
+  setup_mirror_bind_group(wgpu_context);
 
   // Bind group for Model
   {
@@ -590,6 +678,46 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
     WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
     WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
   }
+
+  // Simplified shading of the reflection, same states as the offscreen Phong
+  // shading pipeline
+  {
+    // Vertex state
+    WGPUVertexState vertex_state = wgpu_create_vertex_state(
+              wgpu_context, &(wgpu_vertex_state_t){
+              .shader_desc = (wgpu_shader_desc_t){
+                // Vertex shader WGSL
+                .label            = "simple_reflection_shader",
+                .wgsl_code.source = simple_reflection_shader_wgsl,
+                .entry            = "vs_main",
+              },
+              .buffer_count = 1,
+              .buffers      = &gltf_model_vertex_buffer_layout,
+            });
+
+    // Fragment state
+    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+              wgpu_context, &(wgpu_fragment_state_t){
+              .shader_desc = (wgpu_shader_desc_t){
+                // Fragment shader WGSL
+                .label            = "simple_reflection_shader",
+                .wgsl_code.source = simple_reflection_shader_wgsl,
+                .entry            = "fs_main",
+              },
+              .target_count = 1,
+              .targets      = &color_target_state,
+            });
+
+    pipeline_desc.vertex   = vertex_state;
+    pipeline_desc.fragment = &fragment_state;
+    pipelines.simple_offscreen
+      = wgpuDeviceCreateRenderPipeline(wgpu_context->device, &pipeline_desc);
+    ASSERT(pipelines.simple_offscreen != NULL);
+
+    // Partial cleanup
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+  }
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
@@ -624,6 +752,23 @@ static void update_uniform_buffer_offscreen(wgpu_example_context_t* context)
              (vec3){0.0f, 1.0f, 0.0f});
   glm_scale(ubo_shared_vs.model, (vec3){1.0f, -1.0f, 1.0f});
   glm_translate(ubo_shared_vs.model, model.position);
+
+  // The mirrored scene is on the other side of the mirror plane y = 0 than the
+  // camera, the mirror plane becomes the near plane
+  mat4 inv_view = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv(ubo_shared_vs.view, inv_view);
+  const float camera_height = inv_view[3][1];
+  if (reflection_settings.oblique_clipping && fabsf(camera_height) > 0.01f) {
+    // Mirror plane in view space, the planes transform with the inverse
+    // transpose, offset a bit to keep the contact with the mirror
+    vec4 world_plane = {0.0f, camera_height > 0.0f ? -1.0f : 1.0f, 0.0f,
+                        0.005f};
+    vec4 view_plane = GLM_VEC4_ZERO_INIT;
+    glm_mat4_transpose(inv_view);
+    glm_mat4_mulv(inv_view, world_plane, view_plane);
+    projection_matrix_apply_oblique_clip_plane(ubo_shared_vs.projection,
+                                               view_plane);
+  }
   wgpu_queue_write_buffer(context->wgpu_context,
                           uniform_buffers_vs.offScreen.buffer, 0,
                           &ubo_shared_vs, uniform_buffers_vs.offScreen.size);
@@ -660,6 +805,24 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
   update_uniform_buffer_offscreen(context);
 }
 
+static void update_reflection_state(wgpu_example_context_t* context)
+{
+  // The mirror samples the reflection where the camera sees it, it is
+  // rendered again whenever the camera moved
+  bool update = !reflection_state.valid || context->camera->updated;
+  if (!context->paused) {
+    ++reflection_state.frames_since_update;
+    update = update
+             || reflection_state.frames_since_update
+                  >= (uint32_t)reflection_settings.update_interval;
+  }
+  if (update) {
+    reflection_state.frames_since_update = 0;
+  }
+  reflection_state.update = update;
+  reflection_state.valid  = true;
+}
+
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
@@ -685,6 +848,24 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
     imgui_overlay_checkBox(context->imgui_overlay, "Display render target",
                            &debug_display);
   }
+  if (imgui_overlay_header("Reflection")) {
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Resolution",
+                                &reflection_settings.resolution_index,
+                                reflection_resolution_names,
+                                ARRAY_SIZE(reflection_resolution_names))) {
+      reflection_settings.resolution_changed = true;
+    }
+    imgui_overlay_slider_int(context->imgui_overlay, "Update interval",
+                             &reflection_settings.update_interval, 1,
+                             MAX_REFLECTION_UPDATE_INTERVAL);
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Simplified shading",
+                               &reflection_settings.simple_shading)
+        || imgui_overlay_checkBox(context->imgui_overlay, "Oblique near plane",
+                                  &reflection_settings.oblique_clipping)) {
+      update_uniform_buffer_offscreen(context);
+      reflection_state.valid = false;
+    }
+  }
 }
 
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
@@ -694,9 +875,10 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
   /*
-   * First render pass: Offscreen rendering
+   * First render pass: Offscreen rendering, kept from the previous frames
+   * between the updates
    */
-  {
+  if (reflection_state.update) {
     // Create render pass encoder for encoding drawing commands
     wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
       wgpu_context->cmd_enc,
@@ -714,7 +896,9 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 
     // Mirrored scene
     wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
-                                     pipelines.shaded_offscreen);
+                                     reflection_settings.simple_shading ?
+                                       pipelines.simple_offscreen :
+                                       pipelines.shaded_offscreen);
     wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
                                       bind_groups.offscreen, 0, 0);
     wgpu_gltf_model_draw(models.dragon, (wgpu_gltf_model_render_options_t){0});
@@ -806,12 +990,28 @@ static int example_draw(wgpu_example_context_t* context)
   return 0;
 }
 
+// The offscreen frame buffer has a fraction of the surface size, it is
+// recreated with the bind group sampling it on resize
+static void example_on_view_changed(wgpu_example_context_t* context)
+{
+  release_offscreen();
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.mirror)
+  prepare_offscreen(context->wgpu_context);
+  setup_mirror_bind_group(context->wgpu_context);
+  reflection_state.valid = false;
+}
+
 static int example_render(wgpu_example_context_t* context)
 {
   if (!prepared) {
     return 1;
   }
-  int result = example_draw(context);
+  if (reflection_settings.resolution_changed) {
+    reflection_settings.resolution_changed = false;
+    example_on_view_changed(context);
+  }
+  // The uniforms of the frame are written before it is drawn, so that the
+  // reflection updates see the camera they are rendered for
   if (!context->paused || context->camera->updated) {
     if (!context->paused) {
       model.rotation[1] += context->frame_timer * 10.0f;
@@ -819,7 +1019,8 @@ static int example_render(wgpu_example_context_t* context)
     update_uniform_buffers(context);
     update_uniform_buffer_offscreen(context);
   }
-  return result;
+  update_reflection_state(context);
+  return example_draw(context);
 }
 
 static void example_destroy(wgpu_example_context_t* context)
@@ -829,13 +1030,7 @@ static void example_destroy(wgpu_example_context_t* context)
   wgpu_gltf_model_destroy(models.dragon);
   wgpu_gltf_model_destroy(models.plane);
 
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color.texture)
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.depth_stencil.texture)
-
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color.texture_view)
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.depth_stencil.texture_view)
-
-  WGPU_RELEASE_RESOURCE(Sampler, offscreen_pass.sampler)
+  release_offscreen();
 
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers_vs.shared.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers_vs.mirror.buffer)
@@ -844,6 +1039,7 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.debug)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.shaded)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.shaded_offscreen)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.simple_offscreen)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipelines.mirror)
 
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.shaded)
@@ -865,9 +1061,10 @@ void example_offscreen_rendering(int argc, char* argv[])
       .title   = example_title,
       .overlay = true,
     },
-    .example_initialize_func = &example_initialize,
-    .example_render_func     = &example_render,
-    .example_destroy_func    = &example_destroy,
+    .example_initialize_func      = &example_initialize,
+    .example_render_func          = &example_render,
+    .example_destroy_func         = &example_destroy,
+    .example_on_view_changed_func = &example_on_view_changed,
   });
   // clang-format on
 }
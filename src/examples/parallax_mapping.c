@@ -14,6 +14,12 @@
  * texture information: Normal mapping, parallax mapping, steep parallax mapping
  * and parallax occlusion mapping (best quality, worst performance).
  *
+ * Parallax occlusion mapping adapts its layer count to the view angle and to
+ * the number of height map texels the ray crosses at the sampled mip level,
+ * skips the ray march when the offset stays within a texel, and refines the
+ * intersection with a binary search. Cone step mapping takes larger steps
+ * with a cone map computed from the height map on the GPU at load.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/parallaxmapping/parallaxmapping.cpp
  * -------------------------------------------------------------------------- */
@@ -26,6 +32,14 @@ static struct {
 
 struct gltf_model_t* plane;
 
+// Cone map of the height map, the cones are searched within a radius of 16
+// texels of the first mip level of at most CONE_MAP_MAX_SIZE texels
+#define CONE_MAP_MAX_SIZE 512u
+static struct {
+  WGPUTexture texture;
+  WGPUTextureView view;
+} cone_map = {0};
+
 static struct {
   wgpu_buffer_t vertex_shader;
   wgpu_buffer_t fragment_shader;
@@ -45,10 +59,16 @@ static struct {
     // tweak)
     float parallax_bias;
     // Number of layers for steep parallax and parallax occlusion (more layer =
-    // better result for less performance)
+    // better result for less performance), the maximum for adaptive layers
     float num_layers;
     // (Parallax) mapping mode to use
     int32_t mapping_mode;
+    // Layers at perpendicular view of adaptive parallax occlusion mapping
+    float min_layers;
+    // Binary search steps refining the intersection, 0 interpolates linearly
+    int32_t refinement_steps;
+    int32_t adaptive_layers;
+    int32_t cone_steps;
   } fragment_shader;
 } ubos = {
   .vertex_shader = {
@@ -59,6 +79,10 @@ static struct {
     .parallax_bias = -0.02f,
     .num_layers = 48.0f,
     .mapping_mode = 4,
+    .min_layers = 8.0f,
+    .refinement_steps = 4,
+    .adaptive_layers = 1,
+    .cone_steps = 12,
   },
 };
 
@@ -71,14 +95,245 @@ static WGPURenderPipeline pipeline;
 static WGPUBindGroupLayout bind_group_layout;
 static WGPUBindGroup bind_group;
 
-static const char* mapping_modes[5] = {
+static const char* mapping_modes[6] = {
   "Color only",                 //
   "Normal mapping",             //
   "Parallax mapping",           //
   "Steep parallax mapping",     //
   "Parallax occlusion mapping", //
+  "Cone step mapping",          //
 };
 
+// clang-format off
+static const char* cone_map_shader_wgsl = CODE(
+  @group(0) @binding(0) var heightMap : texture_2d<f32>;
+  @group(0) @binding(1) var coneMap : texture_storage_2d<r32float, write>;
+
+  const radius = 16;
+
+  // Ratio of the widest cone opening up from the texel that contains no
+  // height map texel, in texture coordinates per unit of depth
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let size = vec2<i32>(textureDimensions(coneMap));
+    let p = vec2<i32>(id.xy);
+    if (p.x >= size.x || p.y >= size.y) {
+      return;
+    }
+    let texelSize = 1.0 / vec2<f32>(size);
+    let depth = 1.0 - textureLoad(heightMap, p, 0).a;
+    // The texels beyond the radius are at least that far away
+    var cone = min(f32(radius) * min(texelSize.x, texelSize.y)
+                     / max(depth, 1e-4), 1.0);
+    for (var y = -radius; y <= radius; y++) {
+      for (var x = -radius; x <= radius; x++) {
+        let q = p + vec2<i32>(x, y);
+        if (any(q < vec2<i32>(0)) || any(q >= size)) {
+          continue;
+        }
+        let d = 1.0 - textureLoad(heightMap, q, 0).a;
+        if (d < depth) {
+          let distance = length(vec2<f32>(f32(x), f32(y)) * texelSize);
+          cone = min(cone, distance / (depth - d));
+        }
+      }
+    }
+    textureStore(coneMap, p, vec4<f32>(cone, 0.0, 0.0, 0.0));
+  }
+);
+
+static const char* parallax_fragment_shader_wgsl = CODE(
+  struct UBO {
+    heightScale : f32,
+    parallaxBias : f32,
+    numLayers : f32,
+    mappingMode : i32,
+    minLayers : f32,
+    refinementSteps : i32,
+    adaptiveLayers : i32,
+    coneSteps : i32,
+  };
+
+  @group(0) @binding(1) var colorMap : texture_2d<f32>;
+  @group(0) @binding(2) var colorSampler : sampler;
+  @group(0) @binding(3) var normalHeightMap : texture_2d<f32>;
+  @group(0) @binding(4) var normalHeightSampler : sampler;
+  @group(0) @binding(5) var<uniform> ubo : UBO;
+  @group(0) @binding(6) var coneMap : texture_2d<f32>;
+
+  fn sampleDepth(uv : vec2<f32>, lod : f32) -> f32 {
+    return 1.0 - textureSampleLevel(normalHeightMap, normalHeightSampler, uv,
+                                    lod).a;
+  }
+
+  fn parallaxMapping(uv : vec2<f32>, V : vec3<f32>) -> vec2<f32> {
+    let height = sampleDepth(uv, 0.0);
+    let p = V.xy * (height * (ubo.heightScale * 0.5) + ubo.parallaxBias)
+            / V.z;
+    return uv - p;
+  }
+
+  fn steepParallaxMapping(uv : vec2<f32>, V : vec3<f32>) -> vec2<f32> {
+    let layerDepth = 1.0 / ubo.numLayers;
+    var currLayerDepth = 0.0;
+    let deltaUV = V.xy * ubo.heightScale / (V.z * ubo.numLayers);
+    var currUV = uv;
+    for (var i = 0; i < i32(ubo.numLayers); i++) {
+      currLayerDepth += layerDepth;
+      currUV -= deltaUV;
+      if (sampleDepth(currUV, 0.0) < currLayerDepth) {
+        break;
+      }
+    }
+    return currUV;
+  }
+
+  // Layers for the ray: more at grazing angles, at most one per texel the
+  // ray crosses at the sampled mip level, none within a single texel
+  fn layerCount(maxOffset : vec2<f32>, V : vec3<f32>, lod : f32) -> f32 {
+    if (ubo.adaptiveLayers == 0) {
+      return ubo.numLayers;
+    }
+    let texSize = vec2<f32>(textureDimensions(normalHeightMap, 0));
+    let texels = length(maxOffset * texSize) * exp2(-lod);
+    if (texels < 1.0) {
+      return 0.0;
+    }
+    let layers = mix(ubo.numLayers, ubo.minLayers, abs(V.z));
+    return clamp(min(layers, ceil(texels)), 1.0, ubo.numLayers);
+  }
+
+  // Binary search between the last layer above and the first layer below the
+  // surface
+  fn refineIntersection(uv : vec2<f32>, layerDepth : f32, deltaUV : vec2<f32>,
+                        depth : f32, lod : f32) -> vec2<f32> {
+    var currUV = uv;
+    var currDepth = layerDepth;
+    var stepUV = deltaUV;
+    var stepDepth = 1.0;
+    var surfaceDepth = depth;
+    for (var i = 0; i < ubo.refinementSteps; i++) {
+      stepUV *= 0.5;
+      stepDepth *= 0.5;
+      if (surfaceDepth > currDepth) {
+        currUV -= stepUV;
+        currDepth += stepDepth * layerDepth;
+      }
+      else {
+        currUV += stepUV;
+        currDepth -= stepDepth * layerDepth;
+      }
+      surfaceDepth = sampleDepth(currUV, lod);
+    }
+    return currUV;
+  }
+
+  fn parallaxOcclusionMapping(uv : vec2<f32>, V : vec3<f32>,
+                              lod : f32) -> vec2<f32> {
+    let maxOffset = V.xy * ubo.heightScale / V.z;
+    let layers = layerCount(maxOffset, V, lod);
+    if (layers == 0.0) {
+      return uv;
+    }
+    let layerDepth = 1.0 / layers;
+    let deltaUV = maxOffset / layers;
+    var currLayerDepth = 0.0;
+    var currUV = uv;
+    var depth = sampleDepth(currUV, lod);
+    for (var i = 0; i < i32(layers) && depth > currLayerDepth; i++) {
+      currLayerDepth += layerDepth;
+      currUV -= deltaUV;
+      depth = sampleDepth(currUV, lod);
+    }
+    if (ubo.refinementSteps > 0) {
+      return refineIntersection(currUV, currLayerDepth, deltaUV, depth, lod);
+    }
+    let prevUV = currUV + deltaUV;
+    let nextDepth = depth - currLayerDepth;
+    let prevDepth = sampleDepth(prevUV, lod) - currLayerDepth + layerDepth;
+    return mix(currUV, prevUV, nextDepth / (nextDepth - prevDepth));
+  }
+
+  // Steps of a ray inside the empty cones never cross the surface
+  fn coneStepMapping(uv : vec2<f32>, V : vec3<f32>, lod : f32) -> vec2<f32> {
+    let rayUV = -V.xy * ubo.heightScale / V.z;
+    let texSize = vec2<f32>(textureDimensions(normalHeightMap, 0));
+    if (length(rayUV * texSize) * exp2(-lod) < 1.0) {
+      return uv;
+    }
+    let coneSize = vec2<i32>(textureDimensions(coneMap));
+    let rayLength = length(rayUV);
+    var t = 0.0;
+    for (var i = 0; i < ubo.coneSteps; i++) {
+      let p = uv + rayUV * t;
+      let depth = sampleDepth(p, lod);
+      if (depth <= t) {
+        break;
+      }
+      let texel = clamp(vec2<i32>(p * vec2<f32>(coneSize)), vec2<i32>(0),
+                        coneSize - vec2<i32>(1));
+      let cone = textureLoad(coneMap, texel, 0).r;
+      t += cone * (depth - t) / (cone + rayLength);
+    }
+    return uv + rayUV * t;
+  }
+
+  @fragment
+  fn main(@location(0) inUV : vec2<f32>,
+          @location(1) inTangentLightPos : vec3<f32>,
+          @location(2) inTangentViewPos : vec3<f32>,
+          @location(3) inTangentFragPos : vec3<f32>) -> @location(0) vec4<f32> {
+    // Mip level of the height map, derivatives need uniform control flow
+    let texSize = vec2<f32>(textureDimensions(normalHeightMap, 0));
+    let duvdx = dpdx(inUV);
+    let duvdy = dpdy(inUV);
+    let dx = duvdx * texSize;
+    let dy = duvdy * texSize;
+    let lod = max(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0);
+    let color0 = textureSample(colorMap, colorSampler, inUV);
+    if (ubo.mappingMode == 0) {
+      return color0;
+    }
+
+    let V = normalize(inTangentViewPos - inTangentFragPos);
+    var uv = inUV;
+    switch (ubo.mappingMode) {
+      case 2: {
+        uv = parallaxMapping(inUV, V);
+      }
+      case 3: {
+        uv = steepParallaxMapping(inUV, V);
+      }
+      case 4: {
+        uv = parallaxOcclusionMapping(inUV, V, lod);
+      }
+      case 5: {
+        uv = coneStepMapping(inUV, V, lod);
+      }
+      default: {
+      }
+    }
+
+    // Discard fragments at texture border
+    if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0) {
+      discard;
+    }
+    let normalHeightMapLod = textureSampleLevel(normalHeightMap,
+                                                normalHeightSampler, uv,
+                                                0.0).rgb;
+    let color = textureSampleGrad(colorMap, colorSampler, uv, duvdx,
+                                  duvdy).rgb;
+    let N = normalize(normalHeightMapLod * 2.0 - 1.0);
+    let L = normalize(inTangentLightPos - inTangentFragPos);
+    let H = normalize(L + V);
+    let ambient = 0.2 * color;
+    let diffuse = max(dot(L, N), 0.0) * color;
+    let specular = vec3<f32>(0.15) * pow(max(dot(N, H), 0.0), 32.0);
+    return vec4<f32>(ambient + diffuse + specular, 1.0);
+  }
+);
+// clang-format on
+
 // Other variables
 static const char* example_title = "Parallax Mapping";
 static bool prepared             = false;
@@ -99,7 +354,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
       | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   plane = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/plane.gltf",
@@ -111,10 +367,109 @@ static void load_assets(wgpu_context_t* wgpu_context)
     wgpu_context, "textures/rocks_color_rgba.ktx", NULL);
 }
 
+// Computes the cone map from a mip level of the height map
+static void generate_cone_map(wgpu_context_t* wgpu_context)
+{
+  const texture_t* height_map = &textures.normal_height_map;
+  uint32_t level              = 0;
+  while (level + 1 < height_map->mip_level_count
+         && MAX(height_map->size.width, height_map->size.height) >> level
+              > CONE_MAP_MAX_SIZE) {
+    ++level;
+  }
+  const uint32_t width  = MAX(height_map->size.width >> level, 1u);
+  const uint32_t height = MAX(height_map->size.height >> level, 1u);
+
+  cone_map.texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label = "Cone map texture",
+      .usage
+      = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){width, height, 1},
+      .format        = WGPUTextureFormat_R32Float,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(cone_map.texture != NULL);
+  cone_map.view = wgpuTextureCreateView(cone_map.texture, NULL);
+  ASSERT(cone_map.view != NULL);
+
+  WGPUTextureView height_view = wgpuTextureCreateView(
+    height_map->texture, &(WGPUTextureViewDescriptor){
+                           .format          = height_map->format,
+                           .dimension       = WGPUTextureViewDimension_2D,
+                           .baseMipLevel    = level,
+                           .mipLevelCount   = 1,
+                           .baseArrayLayer  = 0,
+                           .arrayLayerCount = 1,
+                         });
+  ASSERT(height_view != NULL);
+
+  wgpu_shader_t cone_map_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "cone_map_compute_shader",
+                    .wgsl_code.source = cone_map_shader_wgsl,
+                    .entry            = "main",
+                  });
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "cone_map_compute_pipeline",
+      .compute = cone_map_shader.programmable_stage_descriptor,
+    });
+  ASSERT(pipeline != NULL);
+  wgpu_shader_release(&cone_map_shader);
+
+  WGPUBindGroupLayout layout
+    = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      // Binding 0: Height map mip level
+      .binding     = 0,
+      .textureView = height_view,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      // Binding 1: Cone map
+      .binding     = 1,
+      .textureView = cone_map.view,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "Cone map bind group",
+                            .layout     = layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(bind_group != NULL);
+
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder cpass_enc
+    = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  wgpuComputePassEncoderSetPipeline(cpass_enc, pipeline);
+  wgpuComputePassEncoderSetBindGroup(cpass_enc, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(cpass_enc, (width + 7) / 8,
+                                           (height + 7) / 8, 1);
+  wgpuComputePassEncoderEnd(cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, cpass_enc)
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpu_flush_command_buffers(wgpu_context, &command_buffer, 1);
+
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, layout)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, pipeline)
+  WGPU_RELEASE_RESOURCE(TextureView, height_view)
+}
+
 static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
 {
   // Bind group layout
-  WGPUBindGroupLayoutEntry bgl_entries[6] = {
+  WGPUBindGroupLayoutEntry bgl_entries[7] = {
     [0] = (WGPUBindGroupLayoutEntry) {
       // Binding 0: Uniform buffer (Vertex shader)
       .binding    = 0,
@@ -174,6 +529,16 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
       },
       .sampler = {0},
     },
+    [6] = (WGPUBindGroupLayoutEntry) {
+      // Binding 6: Fragment shader cone map view
+      .binding    = 6,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
   };
   bind_group_layout = wgpuDeviceCreateBindGroupLayout(
     wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
@@ -197,7 +562,7 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
 static void setup_bind_group(wgpu_context_t* wgpu_context)
 {
   // Bind Group
-  WGPUBindGroupEntry bg_entries[6] = {
+  WGPUBindGroupEntry bg_entries[7] = {
     [0] = (WGPUBindGroupEntry) {
       // Binding 0: Uniform buffer (Vertex shader)
       .binding = 0,
@@ -232,6 +597,11 @@ static void setup_bind_group(wgpu_context_t* wgpu_context)
       .offset  = 0,
       .size    = uniform_buffers.fragment_shader.size,
     },
+    [6] = (WGPUBindGroupEntry) {
+      // Binding 6: Fragment shader cone map view
+      .binding     = 6,
+      .textureView = cone_map.view,
+    },
   };
 
   bind_group = wgpuDeviceCreateBindGroup(
@@ -322,9 +692,10 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
             wgpu_context, &(wgpu_fragment_state_t){
             .shader_desc = (wgpu_shader_desc_t){
-              // Fragment shader SPIR-V
-              .label = "parallax_mapping_fragment_shader",
-              .file  = "shaders/parallax_mapping/parallax.frag.spv",
+              // Fragment shader WGSL
+              .label            = "parallax_mapping_fragment_shader",
+              .wgsl_code.source = parallax_fragment_shader_wgsl,
+              .entry            = "main",
             },
             .target_count = 1,
             .targets      = &color_target_state,
@@ -411,6 +782,7 @@ static int example_initialize(wgpu_example_context_t* context)
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
+    generate_cone_map(context->wgpu_context);
     prepare_uniform_buffers(context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
@@ -429,7 +801,33 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
     if (imgui_overlay_combo_box(context->imgui_overlay, "Mode",
                                 &ubos.fragment_shader.mapping_mode,
-                                mapping_modes, 5)) {
+                                mapping_modes,
+                                (uint32_t)ARRAY_SIZE(mapping_modes))) {
+      update_uniform_buffers(context);
+    }
+    bool adaptive_layers = ubos.fragment_shader.adaptive_layers != 0;
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Adaptive layers",
+                               &adaptive_layers)) {
+      ubos.fragment_shader.adaptive_layers = adaptive_layers ? 1 : 0;
+      update_uniform_buffers(context);
+    }
+    if (imgui_overlay_slider_float(context->imgui_overlay, "Max. layers",
+                                   &ubos.fragment_shader.num_layers, 1.0f,
+                                   128.0f)) {
+      update_uniform_buffers(context);
+    }
+    if (imgui_overlay_slider_float(context->imgui_overlay, "Min. layers",
+                                   &ubos.fragment_shader.min_layers, 1.0f,
+                                   64.0f)) {
+      update_uniform_buffers(context);
+    }
+    if (imgui_overlay_slider_int(context->imgui_overlay, "Refinement steps",
+                                 &ubos.fragment_shader.refinement_steps, 0,
+                                 8)) {
+      update_uniform_buffers(context);
+    }
+    if (imgui_overlay_slider_int(context->imgui_overlay, "Cone steps",
+                                 &ubos.fragment_shader.cone_steps, 1, 32)) {
       update_uniform_buffers(context);
     }
   }
@@ -526,6 +924,8 @@ static void example_destroy(wgpu_example_context_t* context)
   wgpu_gltf_model_destroy(plane);
   wgpu_destroy_texture(&textures.color_map);
   wgpu_destroy_texture(&textures.normal_height_map);
+  WGPU_RELEASE_RESOURCE(TextureView, cone_map.view)
+  WGPU_RELEASE_RESOURCE(Texture, cone_map.texture)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.vertex_shader.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.fragment_shader.buffer)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
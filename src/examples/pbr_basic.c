@@ -1,6 +1,7 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <math.h>
 #include <string.h>
 
 #include "../webgpu/gltf_model.h"
@@ -73,6 +74,7 @@ static const char* object_names[4] = {"Sphere", "Teapot", "Torusknot", "Venus"};
 
 static int32_t current_material_index = 0;
 static int32_t current_object_index   = 0;
+static bool level_of_detail           = true;
 
 static struct {
   // Object vertex shader uniform buffer
@@ -147,7 +149,9 @@ static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_GenerateLods
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   for (uint8_t i = 0; i < (uint8_t)ARRAY_SIZE(models); ++i) {
     models[i].object
       = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
@@ -530,6 +534,8 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
                                 &current_object_index, object_names, 4)) {
       update_dynamic_uniform_buffer(context->wgpu_context);
     }
+    imgui_overlay_checkBox(context->imgui_overlay, "Level of detail",
+                           &level_of_detail);
   }
 }
 
@@ -559,6 +565,17 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   // Bind the rendering pipeline
   wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
 
+  // The levels of detail are selected per object, with the camera position in
+  // the space of the model, which is rotated and moved to its grid position
+  camera_t* camera = ((wgpu_example_context_t*)wgpu_context->context)->camera;
+  mat4 inverse_model;
+  glm_mat4_inv(ubo_matrices.model, inverse_model);
+  wgpu_gltf_model_lod_options_t lod = {
+    .enabled          = level_of_detail,
+    .projection_scale = (float)wgpu_context->surface.height
+                        / (2.0f * tanf(glm_rad(camera->fov) * 0.5f)),
+  };
+
   for (uint32_t i = 0; i < GRID_DIM * GRID_DIM; ++i) {
     uint32_t dynamic_offset     = i * (uint32_t)ALIGNMENT;
     uint32_t dynamic_offsets[2] = {dynamic_offset, dynamic_offset};
@@ -566,8 +583,13 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0, bind_group, 2,
                                       dynamic_offsets);
     // Draw object
+    vec3 eye;
+    glm_vec3_sub(ubo_matrices.cam_pos, object_params_dynamic[i].position, eye);
+    glm_mat4_mulv3(inverse_model, eye, 1.0f, lod.eye);
     wgpu_gltf_model_draw(models[current_object_index].object,
-                         (wgpu_gltf_model_render_options_t){0});
+                         (wgpu_gltf_model_render_options_t){
+                           .lod = lod,
+                         });
   }
 
   // End render pass
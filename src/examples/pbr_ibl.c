@@ -1,10 +1,12 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <stdio.h>
 #include <string.h>
 
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/reflection_probe.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Physical Based Rendering With Image Based Lighting
@@ -14,7 +16,14 @@
  * even more realistic look the scene as the light contribution used by the
  * materials is now controlled by the environment. Also shows how to generate
  * the BRDF 2D-LUT and irradiance and filtered cube maps from the environment
- * map.
+ * map in compute shaders, and how to cache them in KTX2 files for the next run.
+ * The environment cubemap is loaded from six face images, or converted from an
+ * equirectangular panorama given with --environment=<file>.
+ *
+ * With dynamic reflections the objects are lit by a reflection probe instead,
+ * rendered from in front of the row of objects and filtered at runtime. Its
+ * update is spread over the frames within a GPU time budget, so that the
+ * reflections follow the rotating environment without a frame time spike.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/pbribl
@@ -32,9 +41,21 @@
 
 static bool display_skybox = true;
 
+static const char* environment_cube_files[6] = {
+  "textures/cubemaps/pisa_cube_px.png", // Right
+  "textures/cubemaps/pisa_cube_nx.png", // Left
+  "textures/cubemaps/pisa_cube_py.png", // Top
+  "textures/cubemaps/pisa_cube_ny.png", // Bottom
+  "textures/cubemaps/pisa_cube_pz.png", // Back
+  "textures/cubemaps/pisa_cube_nz.png", // Front
+};
+
+// Equirectangular panorama used instead of the cube faces, HDR or LDR
+static const char* environment_panorama_file = NULL;
+
 static struct {
   texture_t environment_cube;
-  // Generated at runtime
+  // Generated at runtime or loaded from the cache
   texture_t lut_brdf;
   texture_t irradiance_cube;
   texture_t prefiltered_cube;
@@ -81,7 +102,7 @@ static struct {
   } object_params;
 } uniform_buffers = {0};
 
-static struct {
+static struct ubo_matrices_t {
   mat4 projection;
   mat4 model;
   mat4 view;
@@ -135,6 +156,30 @@ static struct {
   WGPURenderPassDescriptor descriptor;
 } render_pass = {0};
 
+// Reflection probe and the resources of its faces, one uniform block per face
+static struct {
+  wgpu_reflection_probe_t* probe;
+  wgpu_buffer_t object_ubo;
+  wgpu_buffer_t skybox_ubo;
+  wgpu_buffer_t params_ubo;
+  WGPUBindGroup object_bind_groups[6];
+  WGPUBindGroup skybox_bind_groups[6];
+  WGPURenderPipeline pbr_pipeline;
+  WGPURenderPipeline skybox_pipeline;
+} reflection_probe = {0};
+
+static struct {
+  bool dynamic_reflections;
+  bool rotate_environment;
+  float environment_rotation; // degrees around the y axis
+  float gpu_budget_ms;
+  vec3 position; // between the camera and the row of objects
+} reflection_probe_settings = {
+  .dynamic_reflections = true,
+  .gpu_budget_ms       = WGPU_REFLECTION_PROBE_DEFAULT_GPU_BUDGET_MS,
+  .position            = {0.0f, 0.0f, -3.0f},
+};
+
 // Default materials to select from
 static struct {
   const char* name;
@@ -196,7 +241,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   // Load glTF models
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   // Skybox
   models.skybox
     = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
@@ -214,19 +260,21 @@ static void load_assets(wgpu_context_t* wgpu_context)
       });
   }
   // Cube map
-  static const char* cubemap[6] = {
-    "textures/cubemaps/pisa_cube_px.png", // Right
-    "textures/cubemaps/pisa_cube_nx.png", // Left
-    "textures/cubemaps/pisa_cube_py.png", // Top
-    "textures/cubemaps/pisa_cube_ny.png", // Bottom
-    "textures/cubemaps/pisa_cube_pz.png", // Back
-    "textures/cubemaps/pisa_cube_nz.png", // Front
-  };
-  textures.environment_cube = wgpu_create_texture_cubemap_from_files(
-    wgpu_context, cubemap,
-    &(struct wgpu_texture_load_options_t){
-      .flip_y = true, // Flip y to match pisa_cube.ktx hdr cubemap
-    });
+  if (environment_panorama_file != NULL) {
+    textures.environment_cube
+      = wgpu_create_texture_cubemap_from_equirectangular_file(
+        wgpu_context, environment_panorama_file,
+        &(struct wgpu_texture_load_options_t){
+          .generate_mipmaps = true,
+        });
+  }
+  else {
+    textures.environment_cube = wgpu_create_texture_cubemap_from_files(
+      wgpu_context, environment_cube_files,
+      &(struct wgpu_texture_load_options_t){
+        .flip_y = true, // Flip y to match pisa_cube.ktx hdr cubemap
+      });
+  }
 }
 
 static void setup_bind_group_layouts(wgpu_context_t* wgpu_context)
@@ -425,117 +473,172 @@ static void setup_pipeline_layouts(wgpu_context_t* wgpu_context)
   }
 }
 
+// Bind group of the objects, lit by the precomputed IBL textures or by the
+// reflection probe
+static WGPUBindGroup create_objects_bind_group(wgpu_context_t* wgpu_context,
+                                               WGPUBuffer matrices_buffer,
+                                               uint64_t matrices_offset,
+                                               WGPUBuffer params_buffer,
+                                               bool use_reflection_probe)
+{
+  WGPUTextureView irradiance_view  = textures.irradiance_cube.view;
+  WGPUSampler irradiance_sampler   = textures.irradiance_cube.sampler;
+  WGPUTextureView prefiltered_view = textures.prefiltered_cube.view;
+  WGPUSampler prefiltered_sampler  = textures.prefiltered_cube.sampler;
+  if (use_reflection_probe) {
+    irradiance_view
+      = wgpu_reflection_probe_get_irradiance_view(reflection_probe.probe);
+    prefiltered_view
+      = wgpu_reflection_probe_get_prefiltered_view(reflection_probe.probe);
+    irradiance_sampler
+      = wgpu_reflection_probe_get_sampler(reflection_probe.probe);
+    prefiltered_sampler = irradiance_sampler;
+  }
+
+  WGPUBindGroupEntry bg_entries[10] = {
+    [0] = (WGPUBindGroupEntry) {
+      // Binding 0: Uniform buffer (Vertex shader & Fragment shader)
+      .binding = 0,
+      .buffer  = matrices_buffer,
+      .offset  = matrices_offset,
+      .size    = uniform_buffers.object.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      // Binding 1: Uniform buffer (Fragment shader)
+      .binding = 1,
+      .buffer  = params_buffer,
+      .offset  = 0,
+      .size    = uniform_buffers.ubo_params.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      // Binding 2: Dynamic uniform buffer (Fragment shader)
+      .binding = 2,
+      .buffer  = uniform_buffers.material_params.buffer,
+      .offset  = 0,
+      .size    = uniform_buffers.material_params.model_size,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      // Binding 3: Dynamic uniform buffer (Vertex shader)
+      .binding = 3,
+      .buffer  = uniform_buffers.object_params.buffer,
+      .offset  = 0,
+      .size    = uniform_buffers.object_params.model_size,
+    },
+    [4] = (WGPUBindGroupEntry) {
+      // Binding 4: Fragment shader image view
+      .binding     = 4,
+      .textureView = irradiance_view,
+    },
+    [5] = (WGPUBindGroupEntry) {
+      // Binding 5: Fragment shader image sampler
+      .binding = 5,
+      .sampler = irradiance_sampler,
+    },
+    [6] = (WGPUBindGroupEntry) {
+      // Binding 6: Fragment shader image view
+      .binding     = 6,
+      .textureView = textures.lut_brdf.view
+    },
+    [7] = (WGPUBindGroupEntry) {
+      // Binding 7: Fragment shader image sampler
+      .binding = 7,
+      .sampler = textures.lut_brdf.sampler,
+    },
+    [8] = (WGPUBindGroupEntry) {
+      // Binding 8: Fragment shader image view
+      .binding     = 8,
+      .textureView = prefiltered_view,
+    },
+    [9] = (WGPUBindGroupEntry) {
+      // Binding 9: Fragment shader image sampler
+      .binding = 9,
+      .sampler = prefiltered_sampler,
+    },
+  };
+
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .layout     = bind_group_layouts.objects,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(bind_group != NULL);
+  return bind_group;
+}
+
+static WGPUBindGroup create_skybox_bind_group(wgpu_context_t* wgpu_context,
+                                              WGPUBuffer matrices_buffer,
+                                              uint64_t matrices_offset,
+                                              WGPUBuffer params_buffer)
+{
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      // Binding 0: Vertex shader uniform UBO
+      .binding = 0,
+      .buffer  = matrices_buffer,
+      .offset  = matrices_offset,
+      .size    = uniform_buffers.skybox.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      // Binding 1: Fragment uniform UBOParams
+      .binding = 1,
+      .buffer  = params_buffer,
+      .offset  = 0,
+      .size    = uniform_buffers.ubo_params.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      // Binding 2: Fragment shader image view
+      .binding     = 2,
+      .textureView = textures.environment_cube.view
+    },
+    [3] = (WGPUBindGroupEntry) {
+      // Binding 3: Fragment shader image sampler
+      .binding = 3,
+      .sampler = textures.environment_cube.sampler,
+    },
+  };
+
+  WGPUBindGroupDescriptor bg_desc = {
+    .layout     = bind_group_layouts.skybox,
+    .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+    .entries    = bg_entries,
+  };
+  WGPUBindGroup bind_group
+    = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
+  ASSERT(bind_group != NULL);
+  return bind_group;
+}
+
+// The objects sample the reflection probe while dynamic reflections are on,
+// recreated when the probe has completed an update
+static void setup_objects_bind_group(wgpu_context_t* wgpu_context)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.objects)
+  bind_groups.objects = create_objects_bind_group(
+    wgpu_context, uniform_buffers.object.buffer, 0,
+    uniform_buffers.ubo_params.buffer,
+    reflection_probe_settings.dynamic_reflections);
+}
+
 static void setup_bind_groups(wgpu_context_t* wgpu_context)
 {
   // Bind group for objects
-  {
-    WGPUBindGroupEntry bg_entries[10] = {
-      [0] = (WGPUBindGroupEntry) {
-        // Binding 0: Uniform buffer (Vertex shader & Fragment shader)
-        .binding = 0,
-        .buffer  = uniform_buffers.object.buffer,
-        .offset  = 0,
-        .size    = uniform_buffers.object.size,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        // Binding 1: Uniform buffer (Fragment shader)
-        .binding = 1,
-        .buffer  = uniform_buffers.ubo_params.buffer,
-        .offset  = 0,
-        .size    = uniform_buffers.ubo_params.size,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        // Binding 2: Dynamic uniform buffer (Fragment shader)
-        .binding = 2,
-        .buffer  = uniform_buffers.material_params.buffer,
-        .offset  = 0,
-        .size    = uniform_buffers.material_params.model_size,
-      },
-      [3] = (WGPUBindGroupEntry) {
-        // Binding 3: Dynamic uniform buffer (Vertex shader)
-        .binding = 3,
-        .buffer  = uniform_buffers.object_params.buffer,
-        .offset  = 0,
-        .size    = uniform_buffers.object_params.model_size,
-      },
-      [4] = (WGPUBindGroupEntry) {
-        // Binding 4: Fragment shader image view
-        .binding     = 4,
-        .textureView = textures.irradiance_cube.view
-      },
-      [5] = (WGPUBindGroupEntry) {
-        // Binding 5: Fragment shader image sampler
-        .binding = 5,
-        .sampler = textures.irradiance_cube.sampler,
-      },
-      [6] = (WGPUBindGroupEntry) {
-        // Binding 6: Fragment shader image view
-        .binding     = 6,
-        .textureView = textures.lut_brdf.view
-      },
-      [7] = (WGPUBindGroupEntry) {
-        // Binding 7: Fragment shader image sampler
-        .binding = 7,
-        .sampler = textures.lut_brdf.sampler,
-      },
-      [8] = (WGPUBindGroupEntry) {
-        // Binding 8: Fragment shader image view
-        .binding     = 8,
-        .textureView = textures.prefiltered_cube.view
-      },
-      [9] = (WGPUBindGroupEntry) {
-        // Binding 9: Fragment shader image sampler
-        .binding = 9,
-        .sampler = textures.prefiltered_cube.sampler,
-      },
-    };
-
-    bind_groups.objects = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, &(WGPUBindGroupDescriptor){
-                              .layout     = bind_group_layouts.objects,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            });
-    ASSERT(bind_groups.objects != NULL);
-  }
+  setup_objects_bind_group(wgpu_context);
 
   // Bind group for skybox
-  {
-    WGPUBindGroupEntry bg_entries[4] = {
-      [0] = (WGPUBindGroupEntry) {
-        // Binding 0: Vertex shader uniform UBO
-        .binding = 0,
-        .buffer  = uniform_buffers.skybox.buffer,
-        .offset  = 0,
-        .size    = uniform_buffers.skybox.size,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        // Binding 1: Fragment uniform UBOParams
-        .binding = 1,
-        .buffer  = uniform_buffers.ubo_params.buffer,
-        .offset  = 0,
-        .size    = uniform_buffers.ubo_params.size,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        // Binding 2: Fragment shader image view
-        .binding     = 2,
-        .textureView = textures.environment_cube.view
-      },
-      [3] = (WGPUBindGroupEntry) {
-        // Binding 3: Fragment shader image sampler
-        .binding = 3,
-        .sampler = textures.environment_cube.sampler,
-      },
-    };
-
-    WGPUBindGroupDescriptor bg_desc = {
-      .layout     = bind_group_layouts.skybox,
-      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-      .entries    = bg_entries,
-    };
-    bind_groups.skybox
-      = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-    ASSERT(bind_groups.skybox != NULL);
+  bind_groups.skybox = create_skybox_bind_group(
+    wgpu_context, uniform_buffers.skybox.buffer, 0,
+    uniform_buffers.ubo_params.buffer);
+
+  // Bind groups of the probe faces, the objects in the probe are lit by the
+  // precomputed IBL textures
+  for (uint32_t f = 0; f < 6; ++f) {
+    reflection_probe.object_bind_groups[f] = create_objects_bind_group(
+      wgpu_context, reflection_probe.object_ubo.buffer, f * ALIGNMENT,
+      reflection_probe.params_ubo.buffer, false);
+    reflection_probe.skybox_bind_groups[f] = create_skybox_bind_group(
+      wgpu_context, reflection_probe.skybox_ubo.buffer, f * ALIGNMENT,
+      reflection_probe.params_ubo.buffer);
   }
 }
 
@@ -567,6 +670,10 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
 
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
 {
+  // The pipelines are compiled asynchronously and in parallel
+  wgpu_pipeline_factory_t* pipeline_factory
+    = wgpu_pipeline_factory_create(wgpu_context);
+
   // Construct the different states making up the pipeline
 
   // Primitive state
@@ -638,17 +745,36 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
           });
 
     // Create rendering pipeline using the specified states
-    pipelines.skybox = wgpuDeviceCreateRenderPipeline(
-      wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                              .label        = "skybox_render_pipeline",
-                              .layout       = pipeline_layouts.skybox,
-                              .primitive    = primitive_state,
-                              .vertex       = vertex_state,
-                              .fragment     = &fragment_state,
-                              .depthStencil = &depth_stencil_state,
-                              .multisample  = multisample_state,
-                            });
-    ASSERT(pipelines.skybox != NULL);
+    wgpu_pipeline_factory_create_render_pipeline(
+      pipeline_factory,
+      &(WGPURenderPipelineDescriptor){
+        .label        = "skybox_render_pipeline",
+        .layout       = pipeline_layouts.skybox,
+        .primitive    = primitive_state,
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      },
+      &pipelines.skybox);
+
+    // Skybox of the probe faces, the mirrored face views turn the inside of
+    // the cube to front faces
+    primitive_state.cullMode  = WGPUCullMode_Back;
+    color_target_state.format = WGPU_REFLECTION_PROBE_COLOR_FORMAT;
+    wgpu_pipeline_factory_create_render_pipeline(
+      pipeline_factory,
+      &(WGPURenderPipelineDescriptor){
+        .label        = "skybox_probe_render_pipeline",
+        .layout       = pipeline_layouts.skybox,
+        .primitive    = primitive_state,
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      },
+      &reflection_probe.skybox_pipeline);
+    color_target_state.format = wgpu_context->swap_chain.format;
 
     // Partial cleanup
     WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
@@ -687,22 +813,47 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
           });
 
     // Create rendering pipeline using the specified states
-    pipelines.pbr = wgpuDeviceCreateRenderPipeline(
-      wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                              .label        = "pbr_render_pipeline",
-                              .layout       = pipeline_layouts.pbr,
-                              .primitive    = primitive_state,
-                              .vertex       = vertex_state,
-                              .fragment     = &fragment_state,
-                              .depthStencil = &depth_stencil_state,
-                              .multisample  = multisample_state,
-                            });
-    ASSERT(pipelines.pbr != NULL);
+    wgpu_pipeline_factory_create_render_pipeline(
+      pipeline_factory,
+      &(WGPURenderPipelineDescriptor){
+        .label        = "pbr_render_pipeline",
+        .layout       = pipeline_layouts.pbr,
+        .primitive    = primitive_state,
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      },
+      &pipelines.pbr);
+
+    // Objects of the probe faces
+    color_target_state.format = WGPU_REFLECTION_PROBE_COLOR_FORMAT;
+    wgpu_pipeline_factory_create_render_pipeline(
+      pipeline_factory,
+      &(WGPURenderPipelineDescriptor){
+        .label        = "pbr_probe_render_pipeline",
+        .layout       = pipeline_layouts.pbr,
+        .primitive    = primitive_state,
+        .vertex       = vertex_state,
+        .fragment     = &fragment_state,
+        .depthStencil = &depth_stencil_state,
+        .multisample  = multisample_state,
+      },
+      &reflection_probe.pbr_pipeline);
+    color_target_state.format = wgpu_context->swap_chain.format;
 
     // Partial cleanup
     WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
     WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
   }
+
+  // Wait for the pipelines to be ready
+  wgpu_pipeline_factory_wait(pipeline_factory);
+  wgpu_pipeline_factory_release(pipeline_factory);
+  ASSERT(pipelines.skybox != NULL);
+  ASSERT(pipelines.pbr != NULL);
+  ASSERT(reflection_probe.skybox_pipeline != NULL);
+  ASSERT(reflection_probe.pbr_pipeline != NULL);
 }
 
 static uint64_t calc_constant_buffer_byte_size(uint64_t byte_size)
@@ -710,1178 +861,563 @@ static uint64_t calc_constant_buffer_byte_size(uint64_t byte_size)
   return (byte_size + 255) & ~255;
 }
 
-// Generate a BRDF integration map used as a look-up-table (stores roughness /
-// NdotV)
-static void generate_brdf_lut(wgpu_context_t* wgpu_context)
-{
-  const WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
-  const int32_t dim              = (int32_t)BRDF_LUT_DIM;
-
-  // Texture dimensions
-  WGPUExtent3D texture_extent = {
-    .width              = dim,
-    .height             = dim,
-    .depthOrArrayLayers = 1,
-  };
-
-  // Create the texture
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .label         = "lut_brdf_texture",
-      .size          = texture_extent,
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = format,
-      .usage
-      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
-    };
-    textures.lut_brdf.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-    ASSERT(textures.lut_brdf.texture != NULL);
-  }
-
-  // Create the texture view
-  {
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .label           = "lut_brdf_texture_view",
-      .dimension       = WGPUTextureViewDimension_2D,
-      .format          = format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = 1,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = 1,
-    };
-    textures.lut_brdf.view
-      = wgpuTextureCreateView(textures.lut_brdf.texture, &texture_view_dec);
-    ASSERT(textures.lut_brdf.view != NULL);
-  }
-
-  // Create the sampler
-  {
-    textures.lut_brdf.sampler = wgpuDeviceCreateSampler(
-      wgpu_context->device, &(WGPUSamplerDescriptor){
-                              .label         = "lut_brdf_texture_sampler",
-                              .addressModeU  = WGPUAddressMode_ClampToEdge,
-                              .addressModeV  = WGPUAddressMode_ClampToEdge,
-                              .addressModeW  = WGPUAddressMode_ClampToEdge,
-                              .minFilter     = WGPUFilterMode_Linear,
-                              .magFilter     = WGPUFilterMode_Linear,
-                              .mipmapFilter  = WGPUFilterMode_Linear,
-                              .lodMinClamp   = 0.0f,
-                              .lodMaxClamp   = 1.0f,
-                              .maxAnisotropy = 1,
-                            });
-    ASSERT(textures.lut_brdf.sampler != NULL);
-  }
-
-  // Look-up-table (from BRDF) pipeline
-  WGPURenderPipeline pipeline = NULL;
-  {
-    // Primitive state
-    WGPUPrimitiveState primitive_state = {
-      .topology  = WGPUPrimitiveTopology_TriangleList,
-      .frontFace = WGPUFrontFace_CCW,
-      .cullMode  = WGPUCullMode_None,
-    };
-
-    // Color target state
-    WGPUBlendState blend_state              = wgpu_create_blend_state(false);
-    WGPUColorTargetState color_target_state = (WGPUColorTargetState){
-      .format    = format,
-      .blend     = &blend_state,
-      .writeMask = WGPUColorWriteMask_All,
-    };
-
-    // Multisample state
-    WGPUMultisampleState multisample_state
-      = wgpu_create_multisample_state_descriptor(
-        &(create_multisample_state_desc_t){
-          .sample_count = 1,
-        });
-
-    // Vertex state
-    WGPUVertexState vertex_state = wgpu_create_vertex_state(
-              wgpu_context, &(wgpu_vertex_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Vertex shader SPIR-V
-                .label = "genbrdflut_vertex_shader",
-                .file  = "shaders/pbr_ibl/genbrdflut.vert.spv",
-              },
-              .buffer_count = 0,
-              .buffers      = NULL,
-            });
-
-    // Fragment state
-    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
-              wgpu_context, &(wgpu_fragment_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Fragment shader SPIR-V
-                .label = "genbrdflut_fragment_shader",
-                .file  = "shaders/pbr_ibl/genbrdflut.frag.spv",
-              },
-              .target_count = 1,
-              .targets      = &color_target_state,
-            });
+/* -------------------------------------------------------------------------- *
+ * Precomputed IBL textures
+ *
+ * The BRDF look-up-table and the irradiance and pre-filtered cube maps are
+ * generated in compute shaders, one dispatch per mip level covering all six
+ * cube faces. The results are saved to KTX2 files in the texture cache
+ * directory, named after the environment map and keyed by a hash of the
+ * environment images and the generator settings, and loaded from there on the
+ * next run.
+ * -------------------------------------------------------------------------- */
 
-    // Create rendering pipeline using the specified states
-    pipeline = wgpuDeviceCreateRenderPipeline(
-      wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                              .label        = "genbrdflut_render_pipeline",
-                              .primitive    = primitive_state,
-                              .vertex       = vertex_state,
-                              .fragment     = &fragment_state,
-                              .depthStencil = NULL,
-                              .multisample  = multisample_state,
-                            });
-    ASSERT(pipeline != NULL);
+// Bump when the generators change to invalidate the cache files
+#define IBL_CACHE_VERSION 1u
+#define IBL_WORKGROUP_SIZE 8u
+
+typedef enum ibl_texture_enum {
+  IblTexture_BrdfLut,
+  IblTexture_IrradianceCube,
+  IblTexture_PrefilteredCube,
+  IblTexture_Count,
+} ibl_texture_enum;
+
+// Layout of IblParams, one block per mip level
+typedef struct ibl_params_t {
+  uint32_t size;
+  uint32_t sample_count;
+  float roughness;
+  float padding;
+} ibl_params_t;
 
-    // Partial cleanup
-    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
-    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
-  }
+static const struct {
+  const char* name;
+  const char* entry;
+  uint32_t dim;
+  uint32_t mip_level_count;
+  uint32_t face_count;
+} ibl_textures[IblTexture_Count] = {
+  // clang-format off
+  [IblTexture_BrdfLut]         = {"brdf_lut",         "cs_brdf_lut",         BRDF_LUT_DIM,         1,                         1},
+  [IblTexture_IrradianceCube]  = {"irradiance_cube",  "cs_irradiance_cube",  IRRADIANCE_CUBE_DIM,  IRRADIANCE_CUBE_NUM_MIPS,  6},
+  [IblTexture_PrefilteredCube] = {"prefiltered_cube", "cs_prefiltered_cube", PREFILTERED_CUBE_DIM, PREFILTERED_CUBE_NUM_MIPS, 6},
+  // clang-format on
+};
 
-  // Create the actual renderpass
-  struct {
-    WGPURenderPassColorAttachment color_attachment[1];
-    WGPURenderPassDescriptor render_pass_descriptor;
-  } render_pass = {
-    .color_attachment[0]= (WGPURenderPassColorAttachment) {
-        .view       = textures.lut_brdf.view,
-        .loadOp     = WGPULoadOp_Clear,
-        .storeOp    = WGPUStoreOp_Store,
-        .clearColor = (WGPUColor) {
-          .r = 0.0f,
-          .g = 0.0f,
-          .b = 0.0f,
-          .a = 1.0f,
-        },
-     },
-  };
-  render_pass.render_pass_descriptor = (WGPURenderPassDescriptor){
-    .colorAttachmentCount   = 1,
-    .colorAttachments       = render_pass.color_attachment,
-    .depthStencilAttachment = NULL,
+// clang-format off
+static const char* ibl_compute_shader_wgsl = CODE(
+  struct IblParams {
+    size : u32,
+    sampleCount : u32,
+    roughness : f32,
+    padding : f32,
   };
 
-  // Render
-  {
-    wgpu_context->cmd_enc
-      = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
-    wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-      wgpu_context->cmd_enc, &render_pass.render_pass_descriptor);
-    wgpuRenderPassEncoderSetViewport(wgpu_context->rpass_enc, 0.0f, 0.0f,
-                                     (float)dim, (float)dim, 0.0f, 1.0f);
-    wgpuRenderPassEncoderSetScissorRect(wgpu_context->rpass_enc, 0u, 0u, dim,
-                                        dim);
-    wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
-    wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
-    wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
-
-    WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
-
-    WGPUCommandBuffer command_buffer
-      = wgpuCommandEncoderFinish(wgpu_context->cmd_enc, NULL);
-    ASSERT(command_buffer != NULL);
-    WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
-
-    // Sumbit commmand buffer and cleanup
-    wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
-    WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+  @group(0) @binding(0) var environmentMap : texture_cube<f32>;
+  @group(0) @binding(1) var environmentSampler : sampler;
+  @group(0) @binding(2) var<uniform> params : IblParams;
+  @group(0) @binding(3) var cubeOutput :
+    texture_storage_2d_array<rgba8unorm, write>;
+  @group(0) @binding(4) var lutOutput : texture_storage_2d<rgba8unorm, write>;
+
+  let PI = 3.1415926535897932384626433832795;
+
+  // Direction through the center of a texel of a cube face
+  fn cubeDirection(face : u32, texel : vec2<u32>) -> vec3<f32> {
+    let uv = (vec2<f32>(texel) + 0.5) / f32(params.size) * 2.0 - 1.0;
+    var dir = vec3<f32>(-uv.x, -uv.y, -1.0);
+    switch (face) {
+      case 0u: { dir = vec3<f32>(1.0, -uv.y, -uv.x); }
+      case 1u: { dir = vec3<f32>(-1.0, -uv.y, uv.x); }
+      case 2u: { dir = vec3<f32>(uv.x, 1.0, uv.y); }
+      case 3u: { dir = vec3<f32>(uv.x, -1.0, -uv.y); }
+      case 4u: { dir = vec3<f32>(uv.x, -uv.y, 1.0); }
+      default: {}
+    }
+    return normalize(dir);
   }
 
-  // Cleanup
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline);
-}
-
-// Generate an irradiance cube map from the environment cube map
-static void generate_irradiance_cube(wgpu_context_t* wgpu_context)
-{
-  const WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
-  const int32_t dim              = (int32_t)IRRADIANCE_CUBE_DIM;
-  const uint32_t num_mips        = (uint32_t)IRRADIANCE_CUBE_NUM_MIPS;
-  ASSERT(num_mips == ((uint32_t)(floor(log2(dim)))) + 1);
-  const uint32_t array_layer_count = 6; // Cube map
-
-  /** Pre-filtered cube map **/
-  // Texture dimensions
-  WGPUExtent3D texture_extent = {
-    .width              = dim,
-    .height             = dim,
-    .depthOrArrayLayers = array_layer_count,
-  };
+  fn random(co : vec2<f32>) -> f32 {
+    let dt = dot(co, vec2<f32>(12.9898, 78.233));
+    return fract(sin(dt % 3.14) * 43758.5453);
+  }
 
-  // Create the texture
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .label         = "irradiance_cube_texture",
-      .size          = texture_extent,
-      .mipLevelCount = num_mips,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = format,
-      .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopyDst
-               | WGPUTextureUsage_TextureBinding,
-    };
-    textures.irradiance_cube.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-    ASSERT(textures.irradiance_cube.texture != NULL);
+  fn hammersley2d(i : u32, n : u32) -> vec2<f32> {
+    var bits = (i << 16u) | (i >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2<f32>(f32(i) / f32(n), f32(bits) * 2.3283064365386963e-10);
   }
 
-  // Create the texture view
-  {
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .label           = "irradiance_cube_texture_view",
-      .dimension       = WGPUTextureViewDimension_Cube,
-      .format          = format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = num_mips,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = array_layer_count,
-    };
-    textures.irradiance_cube.view = wgpuTextureCreateView(
-      textures.irradiance_cube.texture, &texture_view_dec);
-    ASSERT(textures.irradiance_cube.view != NULL);
+  // Halfway vector around the normal, GGX distributed
+  fn importanceSampleGGX(xi : vec2<f32>, roughness : f32, normal : vec3<f32>,
+                         phiJitter : f32) -> vec3<f32> {
+    let alpha = roughness * roughness;
+    let phi = 2.0 * PI * xi.x + phiJitter;
+    let cosTheta = sqrt((1.0 - xi.y) / (1.0 + (alpha * alpha - 1.0) * xi.y));
+    let sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+    let h = vec3<f32>(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+    let up = select(vec3<f32>(1.0, 0.0, 0.0), vec3<f32>(0.0, 0.0, 1.0),
+                    abs(normal.z) < 0.999);
+    let tangentX = normalize(cross(up, normal));
+    let tangentY = normalize(cross(normal, tangentX));
+    return normalize(tangentX * h.x + tangentY * h.y + normal * h.z);
   }
 
-  // Create the sampler
-  {
-    textures.irradiance_cube.sampler = wgpuDeviceCreateSampler(
-      wgpu_context->device, &(WGPUSamplerDescriptor){
-                              .label        = "irradiance_cube_texture_sampler",
-                              .addressModeU = WGPUAddressMode_ClampToEdge,
-                              .addressModeV = WGPUAddressMode_ClampToEdge,
-                              .addressModeW = WGPUAddressMode_ClampToEdge,
-                              .minFilter    = WGPUFilterMode_Linear,
-                              .magFilter    = WGPUFilterMode_Linear,
-                              .mipmapFilter = WGPUFilterMode_Linear,
-                              .lodMinClamp  = 0.0f,
-                              .lodMaxClamp  = (float)num_mips,
-                              .maxAnisotropy = 1,
-                            });
-    ASSERT(textures.irradiance_cube.sampler != NULL);
+  fn dGGX(dotNH : f32, roughness : f32) -> f32 {
+    let alpha = roughness * roughness;
+    let alpha2 = alpha * alpha;
+    let denom = dotNH * dotNH * (alpha2 - 1.0) + 1.0;
+    return alpha2 / (PI * denom * denom);
   }
 
-  // Framebuffer for offscreen rendering
-  struct {
-    WGPUTexture texture;
-    WGPUTextureView texture_views[6 * (uint32_t)IRRADIANCE_CUBE_NUM_MIPS];
-  } offscreen;
+  fn gSchlicksmithGGX(dotNL : f32, dotNV : f32, roughness : f32) -> f32 {
+    let k = (roughness * roughness) / 2.0;
+    let gl = dotNL / (dotNL * (1.0 - k) + k);
+    let gv = dotNV / (dotNV * (1.0 - k) + k);
+    return gl * gv;
+  }
 
-  // Offscreen framebuffer
-  {
-    // Color attachment
-    {
-      // Create the texture
-      WGPUTextureDescriptor texture_desc = {
-        .label         = "irradiance_cube_offscreen_texture",
-        .size          = (WGPUExtent3D) {
-          .width              = dim,
-          .height             = dim,
-          .depthOrArrayLayers = array_layer_count,
-        },
-        .mipLevelCount = num_mips,
-        .sampleCount   = 1,
-        .dimension     = WGPUTextureDimension_2D,
-        .format        = format,
-        .usage = WGPUTextureUsage_CopySrc | WGPUTextureUsage_TextureBinding
-                 | WGPUTextureUsage_RenderAttachment,
-      };
-      offscreen.texture
-        = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-      ASSERT(offscreen.texture != NULL);
-
-      // Create the texture views
-      uint32_t idx = 0;
-      for (uint32_t array_layer = 0; array_layer < array_layer_count;
-           ++array_layer) {
-        for (uint32_t i = 0; i < num_mips; ++i) {
-          idx = (array_layer * num_mips) + i;
-          WGPUTextureViewDescriptor texture_view_dec = {
-            .label           = "irradiance_cube_offscreen_texture_view",
-            .aspect          = WGPUTextureAspect_All,
-            .dimension       = WGPUTextureViewDimension_2D,
-            .format          = texture_desc.format,
-            .baseMipLevel    = i,
-            .mipLevelCount   = 1,
-            .baseArrayLayer  = array_layer,
-            .arrayLayerCount = 1,
-          };
-          offscreen.texture_views[idx]
-            = wgpuTextureCreateView(offscreen.texture, &texture_view_dec);
-          ASSERT(offscreen.texture_views[idx] != NULL);
-        }
+  // BRDF integration map, stores the scale and the bias to F0 by NdotV and
+  // roughness
+  @compute @workgroup_size(8, 8, 1)
+  fn cs_brdf_lut(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size || id.y >= params.size) {
+      return;
+    }
+    let uv = (vec2<f32>(id.xy) + 0.5) / f32(params.size);
+    let dotNV = uv.x;
+    let roughness = 1.0 - uv.y;
+    let n = vec3<f32>(0.0, 0.0, 1.0);
+    let v = vec3<f32>(sqrt(1.0 - dotNV * dotNV), 0.0, dotNV);
+    var lut = vec2<f32>(0.0);
+    for (var i = 0u; i < params.sampleCount; i = i + 1u) {
+      let xi = hammersley2d(i, params.sampleCount);
+      let h = importanceSampleGGX(xi, roughness, n, 0.0);
+      let l = 2.0 * dot(v, h) * h - v;
+      let dotNL = max(dot(n, l), 0.0);
+      let dotVH = max(dot(v, h), 0.0);
+      let dotNH = max(dot(h, n), 0.0);
+      if (dotNL > 0.0) {
+        let g = gSchlicksmithGGX(dotNL, dotNV, roughness);
+        let gVis = (g * dotVH) / (dotNH * dotNV);
+        let fc = pow(1.0 - dotVH, 5.0);
+        lut = lut + vec2<f32>((1.0 - fc) * gVis, fc * gVis);
       }
     }
+    textureStore(lutOutput, vec2<i32>(id.xy),
+                 vec4<f32>(lut / f32(params.sampleCount), 0.0, 1.0));
   }
 
-  struct push_block_vs_t {
-    mat4 mvp;
-    uint8_t padding[192];
-  } push_block_vs[(uint32_t)IRRADIANCE_CUBE_NUM_MIPS * 6];
-
-  struct push_block_fs_t {
-    float delta_phi;
-    float delta_theta;
-    uint8_t padding[248];
-  } push_block_fs[(uint32_t)IRRADIANCE_CUBE_NUM_MIPS * 6];
-
-  // Update shader push constant block data
-  {
-    mat4 matrices[6] = {
-      GLM_MAT4_IDENTITY_INIT, // POSITIVE_X
-      GLM_MAT4_IDENTITY_INIT, // NEGATIVE_X
-      GLM_MAT4_IDENTITY_INIT, // POSITIVE_Y
-      GLM_MAT4_IDENTITY_INIT, // NEGATIVE_Y
-      GLM_MAT4_IDENTITY_INIT, // POSITIVE_Z
-      GLM_MAT4_IDENTITY_INIT, // NEGATIVE_Z
-    };
-    // NEGATIVE_X
-    glm_rotate(matrices[0], glm_rad(90.0f), (vec3){0.0f, 1.0f, 0.0f});
-    glm_rotate(matrices[0], glm_rad(180.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // NEGATIVE_X
-    glm_rotate(matrices[1], glm_rad(-90.0f), (vec3){0.0f, 1.0f, 0.0f});
-    glm_rotate(matrices[1], glm_rad(180.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // POSITIVE_Y
-    glm_rotate(matrices[2], glm_rad(90.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // NEGATIVE_Y
-    glm_rotate(matrices[3], glm_rad(-90.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // POSITIVE_Z
-    glm_rotate(matrices[4], glm_rad(180.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // NEGATIVE_Z
-    glm_rotate(matrices[5], glm_rad(180.0f), (vec3){0.0f, 0.0f, 1.0f});
-
-    mat4 projection = GLM_MAT4_IDENTITY_INIT;
-    glm_perspective(PI / 2.0f, 1.0f, 0.1f, 512.0f, projection);
-    // Sampling deltas
-    const float delta_phi   = (2.0f * PI) / 180.0f;
-    const float delta_theta = (0.5f * PI) / 64.0f;
-    uint32_t idx            = 0;
-    for (uint32_t m = 0; m < num_mips; ++m) {
-      for (uint32_t f = 0; f < 6; ++f) {
-        idx = (m * 6) + f;
-        // Set vertex shader push constant block
-        glm_mat4_mul(projection, matrices[f], push_block_vs[idx].mvp);
-        // Set fragment shader push constant block
-        push_block_fs[idx].delta_phi   = delta_phi;
-        push_block_fs[idx].delta_theta = delta_theta;
+  // Diffuse irradiance, the cosine weighted environment over the hemisphere
+  @compute @workgroup_size(8, 8, 1)
+  fn cs_irradiance_cube(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size || id.y >= params.size) {
+      return;
+    }
+    let n = cubeDirection(id.z, id.xy);
+    let upAxis = select(vec3<f32>(0.0, 0.0, 1.0), vec3<f32>(0.0, 1.0, 0.0),
+                        abs(n.y) < 0.999);
+    let right = normalize(cross(upAxis, n));
+    let up = cross(n, right);
+    let deltaPhi = (2.0 * PI) / 180.0;
+    let deltaTheta = (0.5 * PI) / 64.0;
+    var color = vec3<f32>(0.0);
+    var sampleCount = 0u;
+    for (var phi = 0.0; phi < 2.0 * PI; phi = phi + deltaPhi) {
+      for (var theta = 0.0; theta < 0.5 * PI; theta = theta + deltaTheta) {
+        let tempVec = cos(phi) * right + sin(phi) * up;
+        let sampleVector = cos(theta) * n + sin(theta) * tempVec;
+        color = color + textureSampleLevel(environmentMap, environmentSampler,
+                                           sampleVector, 0.0).rgb
+                          * cos(theta) * sin(theta);
+        sampleCount = sampleCount + 1u;
       }
     }
+    textureStore(cubeOutput, vec2<i32>(id.xy), i32(id.z),
+                 vec4<f32>(PI * color / f32(sampleCount), 1.0));
   }
 
-  static struct {
-    // Vertex shader parameter uniform buffer
-    struct {
-      WGPUBuffer buffer;
-      uint64_t buffer_size;
-      uint64_t model_size;
-    } vs;
-    // Fragment parameter uniform buffer
-    struct {
-      WGPUBuffer buffer;
-      uint64_t buffer_size;
-      uint64_t model_size;
-    } fs;
-  } irradiance_cube_ubos;
-
-  // Vertex shader parameter uniform buffer
-  {
-    irradiance_cube_ubos.vs.model_size = sizeof(mat4);
-    irradiance_cube_ubos.vs.buffer_size
-      = calc_constant_buffer_byte_size(sizeof(push_block_vs));
-    irradiance_cube_ubos.vs.buffer = wgpu_create_buffer_from_data(
-      wgpu_context, push_block_vs, irradiance_cube_ubos.vs.buffer_size,
-      WGPUBufferUsage_Uniform);
-  }
-
-  // Fragment shader parameter uniform buffer
-  {
-    irradiance_cube_ubos.fs.model_size = sizeof(float) * 2;
-    irradiance_cube_ubos.fs.buffer_size
-      = calc_constant_buffer_byte_size(sizeof(push_block_fs));
-    irradiance_cube_ubos.fs.buffer = wgpu_create_buffer_from_data(
-      wgpu_context, push_block_fs, irradiance_cube_ubos.fs.buffer_size,
-      WGPUBufferUsage_Uniform);
-  }
-
-  // Bind group layout
-  WGPUBindGroupLayout bind_group_layout = NULL;
-  {
-    WGPUBindGroupLayoutEntry bgl_entries[4] = {
-      [0] = (WGPUBindGroupLayoutEntry) {
-        // Binding 0: Vertex shader uniform UBO
-        .binding    = 0,
-        .visibility = WGPUShaderStage_Vertex,
-        .buffer = (WGPUBufferBindingLayout) {
-          .type             = WGPUBufferBindingType_Uniform,
-          .hasDynamicOffset = true,
-          .minBindingSize   = irradiance_cube_ubos.vs.model_size,
-        },
-        .sampler = {0},
-      },
-      [1] = (WGPUBindGroupLayoutEntry) {
-        // Binding 1: Fragment shader uniform UBO
-        .binding    = 1,
-        .visibility = WGPUShaderStage_Fragment,
-        .buffer = (WGPUBufferBindingLayout) {
-          .type             = WGPUBufferBindingType_Uniform,
-          .hasDynamicOffset = true,
-          .minBindingSize   = irradiance_cube_ubos.fs.model_size,
-        },
-        .sampler = {0},
-      },
-      [2] = (WGPUBindGroupLayoutEntry) {
-        // Binding 2: Fragment shader image view
-        .binding    = 2,
-        .visibility = WGPUShaderStage_Fragment,
-        .texture = (WGPUTextureBindingLayout) {
-          .sampleType    = WGPUTextureSampleType_Float,
-          .viewDimension = WGPUTextureViewDimension_Cube,
-          .multisampled  = false,
-        },
-        .storageTexture = {0},
-      },
-      [3] = (WGPUBindGroupLayoutEntry) {
-        // Binding 3: Fragment shader image sampler
-        .binding    = 3,
-        .visibility = WGPUShaderStage_Fragment,
-        .sampler = (WGPUSamplerBindingLayout){
-          .type = WGPUSamplerBindingType_Filtering,
-        },
-        .texture = {0},
-      },
-    };
-    bind_group_layout = wgpuDeviceCreateBindGroupLayout(
-      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
-                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-                              .entries    = bgl_entries,
-                            });
-    ASSERT(bind_group_layout != NULL);
-  }
-
-  // Bind group
-  WGPUBindGroup bind_group = NULL;
-  {
-    WGPUBindGroupEntry bg_entries[4] = {
-      [0] = (WGPUBindGroupEntry) {
-        // Binding 0: Vertex shader uniform UBO
-        .binding = 0,
-        .buffer  = irradiance_cube_ubos.vs.buffer,
-        .offset  = 0,
-        .size    = irradiance_cube_ubos.vs.model_size,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        // Binding 1: Fragment shader uniform UBO
-        .binding = 1,
-        .buffer  = irradiance_cube_ubos.fs.buffer,
-        .offset  = 0,
-        .size    = irradiance_cube_ubos.fs.model_size,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        // Binding 2: Fragment shader image view
-        .binding     = 2,
-        .textureView = textures.environment_cube.view
-      },
-      [3] = (WGPUBindGroupEntry) {
-        // Binding 3: Fragment shader image sampler
-        .binding = 3,
-        .sampler = textures.environment_cube.sampler,
-      },
-    };
-    bind_group = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, &(WGPUBindGroupDescriptor){
-                              .layout     = bind_group_layout,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            });
-    ASSERT(bind_group != NULL);
-  }
-
-  // Pipeline layout
-  WGPUPipelineLayout pipeline_layout = NULL;
-  {
-    pipeline_layout = wgpuDeviceCreatePipelineLayout(
-      wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
-                              .bindGroupLayoutCount = 1,
-                              .bindGroupLayouts     = &bind_group_layout,
-                            });
-    ASSERT(pipeline_layout != NULL);
-  }
-
-  // Irradiance cube map pipeline
-  WGPURenderPipeline pipeline = NULL;
-  {
-    // Primitive state
-    WGPUPrimitiveState primitive_state = {
-      .topology  = WGPUPrimitiveTopology_TriangleList,
-      .frontFace = WGPUFrontFace_CCW,
-      .cullMode  = WGPUCullMode_None,
-    };
-
-    // Color target state
-    WGPUBlendState blend_state              = wgpu_create_blend_state(false);
-    WGPUColorTargetState color_target_state = (WGPUColorTargetState){
-      .format    = format,
-      .blend     = &blend_state,
-      .writeMask = WGPUColorWriteMask_All,
-    };
-
-    // Vertex buffer layout
-    WGPU_GLTF_VERTEX_BUFFER_LAYOUT(
-      skybox,
-      // Location 0: Position
-      WGPU_GLTF_VERTATTR_DESC(0, WGPU_GLTF_VertexComponent_Position));
-
-    // Vertex state
-    WGPUVertexState vertex_state = wgpu_create_vertex_state(
-              wgpu_context, &(wgpu_vertex_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Vertex shader SPIR-
-                .label = "filtercube_vertex_shader",
-                .file  = "shaders/pbr_ibl/filtercube.vert.spv",
-              },
-             .buffer_count = 1,
-             .buffers      = &skybox_vertex_buffer_layout,
-            });
-
-    // Fragment state
-    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
-              wgpu_context, &(wgpu_fragment_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Fragment shader SPIR-V
-                .label = "irradiancecube_fragment_shader",
-                .file  = "shaders/pbr_ibl/irradiancecube.frag.spv",
-              },
-              .target_count = 1,
-              .targets      = &color_target_state,
-            });
-
-    // Multisample state
-    WGPUMultisampleState multisample_state
-      = wgpu_create_multisample_state_descriptor(
-        &(create_multisample_state_desc_t){
-          .sample_count = 1,
-        });
-
-    // Create rendering pipeline using the specified states
-    pipeline = wgpuDeviceCreateRenderPipeline(
-      wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                              .label  = "irradiance_cube_map_render_pipeline",
-                              .layout = pipeline_layout,
-                              .primitive    = primitive_state,
-                              .vertex       = vertex_state,
-                              .fragment     = &fragment_state,
-                              .depthStencil = NULL,
-                              .multisample  = multisample_state,
-                            });
-    ASSERT(pipeline != NULL);
-
-    // Partial cleanup
-    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
-    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
-  }
-
-  // Create the actual renderpass
-  struct {
-    WGPURenderPassColorAttachment color_attachment[1];
-    WGPURenderPassDescriptor render_pass_descriptor;
-  } render_pass = {
-    .color_attachment[0]= (WGPURenderPassColorAttachment) {
-        .view       = NULL,
-        .loadOp     = WGPULoadOp_Clear,
-        .storeOp    = WGPUStoreOp_Store,
-        .clearColor = (WGPUColor) {
-          .r = 0.0f,
-          .g = 0.0f,
-          .b = 0.2f,
-          .a = 0.0f,
-        },
-     },
-  };
-  render_pass.render_pass_descriptor = (WGPURenderPassDescriptor){
-    .colorAttachmentCount   = 1,
-    .colorAttachments       = render_pass.color_attachment,
-    .depthStencilAttachment = NULL,
-  };
-
-  // Render
-  {
-    wgpu_context->cmd_enc
-      = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
-
-    uint32_t idx         = 0;
-    float viewport_width = 0.0f, viewport_height = 0.0f;
-    for (uint32_t m = 0; m < num_mips; ++m) {
-      viewport_width  = (float)(dim * pow(0.5f, m));
-      viewport_height = (float)(dim * pow(0.5f, m));
-      for (uint32_t f = 0; f < 6; ++f) {
-        render_pass.color_attachment[0].view
-          = offscreen.texture_views[(f * num_mips) + m];
-        idx = (m * 6) + f;
-        // Render scene from cube face's point of view
-        wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-          wgpu_context->cmd_enc, &render_pass.render_pass_descriptor);
-        wgpuRenderPassEncoderSetViewport(wgpu_context->rpass_enc, 0.0f, 0.0f,
-                                         viewport_width, viewport_height, 0.0f,
-                                         1.0f);
-        wgpuRenderPassEncoderSetScissorRect(wgpu_context->rpass_enc, 0u, 0u,
-                                            (uint32_t)viewport_width,
-                                            (uint32_t)viewport_height);
-        wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
-        // Calculate the dynamic offsets
-        uint32_t dynamic_offset     = idx * (uint32_t)ALIGNMENT;
-        uint32_t dynamic_offsets[2] = {dynamic_offset, dynamic_offset};
-        // Bind the bind group for rendering a mesh using the dynamic offset
-        wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                          bind_group, 2, dynamic_offsets);
-        // Draw object
-        wgpu_gltf_model_draw(models.skybox,
-                             (wgpu_gltf_model_render_options_t){0});
-        // End render pass
-        wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
-        WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
-      }
+  // Specular environment pre-filtered for the roughness of the mip level, the
+  // samples read from environment mips matching their solid angle
+  @compute @workgroup_size(8, 8, 1)
+  fn cs_prefiltered_cube(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size || id.y >= params.size) {
+      return;
     }
-
-    // Copy region for transfer from framebuffer to cube face
-    for (uint32_t m = 0; m < num_mips; ++m) {
-      WGPUExtent3D copy_size = (WGPUExtent3D){
-        .width              = (float)(dim * pow(0.5f, m)),
-        .height             = (float)(dim * pow(0.5f, m)),
-        .depthOrArrayLayers = array_layer_count,
-      };
-      wgpuCommandEncoderCopyTextureToTexture(
-        wgpu_context->cmd_enc,
-        // source
-        &(WGPUImageCopyTexture){
-          .texture  = offscreen.texture,
-          .mipLevel = m,
-        },
-        // destination
-        &(WGPUImageCopyTexture){
-          .texture  = textures.irradiance_cube.texture,
-          .mipLevel = m,
-        },
-        // copySize
-        &copy_size);
+    let n = cubeDirection(id.z, id.xy);
+    let v = n;
+    let roughness = params.roughness;
+    let envMapDim = f32(textureDimensions(environmentMap).x);
+    let omegaP = 4.0 * PI / (6.0 * envMapDim * envMapDim);
+    var color = vec3<f32>(0.0);
+    var totalWeight = 0.0;
+    for (var i = 0u; i < params.sampleCount; i = i + 1u) {
+      let xi = hammersley2d(i, params.sampleCount);
+      let h = importanceSampleGGX(xi, roughness, n, random(n.xz) * 0.1);
+      let l = 2.0 * dot(v, h) * h - v;
+      let dotNL = clamp(dot(n, l), 0.0, 1.0);
+      if (dotNL > 0.0) {
+        let dotNH = clamp(dot(n, h), 0.0, 1.0);
+        let dotVH = clamp(dot(v, h), 0.0, 1.0);
+        let pdf = dGGX(dotNH, roughness) * dotNH / (4.0 * dotVH) + 0.0001;
+        let omegaS = 1.0 / (f32(params.sampleCount) * pdf);
+        let mipLevel = select(max(0.5 * log2(omegaS / omegaP) + 1.0, 0.0), 0.0,
+                              roughness == 0.0);
+        color = color + textureSampleLevel(environmentMap, environmentSampler,
+                                           l, mipLevel).rgb * dotNL;
+        totalWeight = totalWeight + dotNL;
+      }
     }
-
-    WGPUCommandBuffer command_buffer
-      = wgpuCommandEncoderFinish(wgpu_context->cmd_enc, NULL);
-    ASSERT(command_buffer != NULL);
-    WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
-
-    // Sumbit commmand buffer and cleanup
-    wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
-    WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
-  }
-
-  // Cleanup
-  WGPU_RELEASE_RESOURCE(Texture, offscreen.texture)
-  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(offscreen.texture_views); ++i) {
-    WGPU_RELEASE_RESOURCE(TextureView, offscreen.texture_views[i])
+    textureStore(cubeOutput, vec2<i32>(id.xy), i32(id.z),
+                 vec4<f32>(color / totalWeight, 1.0));
   }
-  WGPU_RELEASE_RESOURCE(Buffer, irradiance_cube_ubos.vs.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, irradiance_cube_ubos.fs.buffer)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
-}
-
-// Prefilter environment cubemap
-// See
-// https://placeholderart.wordpress.com/2015/07/28/implementation-notes-runtime-environment-map-filtering-for-image-based-lighting/
-static void generate_prefiltered_cube(wgpu_context_t* wgpu_context)
+);
+// clang-format on
+
+// Hash of the environment images and the generator settings of a texture, the
+// BRDF look-up-table does not depend on the environment
+static uint64_t ibl_cache_hash(const char** environment_files,
+                               uint32_t environment_file_count,
+                               ibl_texture_enum texture_index)
 {
-  const WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
-  const int32_t dim              = (int32_t)PREFILTERED_CUBE_DIM;
-  const uint32_t num_mips        = (uint32_t)PREFILTERED_CUBE_NUM_MIPS;
-  ASSERT(num_mips == ((uint32_t)(floor(log2(dim)))) + 1)
-  const uint32_t array_layer_count = 6; // Cube map
-
-  /** Pre-filtered cube map **/
-  // Texture dimensions
-  WGPUExtent3D texture_extent = {
-    .width              = dim,
-    .height             = dim,
-    .depthOrArrayLayers = array_layer_count,
-  };
-
-  // Create the texture
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .label         = "prefiltered_cube_texture",
-      .size          = texture_extent,
-      .mipLevelCount = num_mips,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = format,
-      .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopyDst
-               | WGPUTextureUsage_TextureBinding,
-    };
-    textures.prefiltered_cube.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-    ASSERT(textures.prefiltered_cube.texture != NULL);
-  }
-
-  // Create the texture view
-  {
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .label           = "prefiltered_cube_texture_view",
-      .dimension       = WGPUTextureViewDimension_Cube,
-      .format          = format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = num_mips,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = array_layer_count,
-    };
-    textures.prefiltered_cube.view = wgpuTextureCreateView(
-      textures.prefiltered_cube.texture, &texture_view_dec);
-    ASSERT(textures.prefiltered_cube.view != NULL);
-  }
-
-  // Create the sampler
-  {
-    textures.prefiltered_cube.sampler = wgpuDeviceCreateSampler(
-      wgpu_context->device, &(WGPUSamplerDescriptor){
-                              .label = "prefiltered_cube_texture_sampler",
-                              .addressModeU  = WGPUAddressMode_ClampToEdge,
-                              .addressModeV  = WGPUAddressMode_ClampToEdge,
-                              .addressModeW  = WGPUAddressMode_ClampToEdge,
-                              .minFilter     = WGPUFilterMode_Linear,
-                              .magFilter     = WGPUFilterMode_Linear,
-                              .mipmapFilter  = WGPUFilterMode_Linear,
-                              .lodMinClamp   = 0.0f,
-                              .lodMaxClamp   = (float)num_mips,
-                              .maxAnisotropy = 1,
-                            });
-    ASSERT(textures.prefiltered_cube.sampler != NULL);
-  }
-
-  // Framebuffer for offscreen rendering
-  struct {
-    WGPUTexture texture;
-    WGPUTextureView texture_views[6 * (uint32_t)PREFILTERED_CUBE_NUM_MIPS];
-  } offscreen;
-
-  // Offscreen framebuffer
-  {
-    // Color attachment
-    {
-      // Create the texture
-      WGPUTextureDescriptor texture_desc = {
-        .label         = "prefiltered_cube_offscreen_texture",
-        .size          = (WGPUExtent3D) {
-          .width              = dim,
-          .height             = dim,
-          .depthOrArrayLayers = array_layer_count,
-        },
-        .mipLevelCount = num_mips,
-        .sampleCount   = 1,
-        .dimension     = WGPUTextureDimension_2D,
-        .format        = format,
-        .usage = WGPUTextureUsage_CopySrc | WGPUTextureUsage_TextureBinding
-                 | WGPUTextureUsage_RenderAttachment,
-      };
-      offscreen.texture
-        = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-      ASSERT(offscreen.texture != NULL)
-
-      // Create the texture views
-      uint32_t idx = 0;
-      for (uint32_t array_layer = 0; array_layer < array_layer_count;
-           ++array_layer) {
-        for (uint32_t i = 0; i < num_mips; ++i) {
-          idx = (array_layer * num_mips) + i;
-          WGPUTextureViewDescriptor texture_view_dec = {
-            .label           = "prefiltered_cube_offscreen_texture_view",
-            .aspect          = WGPUTextureAspect_All,
-            .dimension       = WGPUTextureViewDimension_2D,
-            .format          = texture_desc.format,
-            .baseMipLevel    = i,
-            .mipLevelCount   = 1,
-            .baseArrayLayer  = array_layer,
-            .arrayLayerCount = 1,
-          };
-          offscreen.texture_views[idx]
-            = wgpuTextureCreateView(offscreen.texture, &texture_view_dec);
-          ASSERT(offscreen.texture_views[idx] != NULL)
-        }
+  uint64_t hash = WGPU_RENDER_BUNDLE_HASH_SEED;
+  if (texture_index != IblTexture_BrdfLut) {
+    for (uint32_t i = 0; i < environment_file_count; ++i) {
+      file_mapping_t mapping = {0};
+      if (file_map(environment_files[i], &mapping)) {
+        hash = wgpu_render_bundle_hash(hash, mapping.data, mapping.size);
+        file_unmap(&mapping);
       }
     }
   }
+  const uint32_t settings[5] = {
+    IBL_CACHE_VERSION,
+    ibl_textures[texture_index].dim,
+    ibl_textures[texture_index].mip_level_count,
+    ibl_textures[texture_index].face_count,
+    (uint32_t)WGPUTextureFormat_RGBA8Unorm,
+  };
+  return wgpu_render_bundle_hash(hash, settings, sizeof(settings));
+}
 
-  struct push_block_vs_t {
-    mat4 mvp;
-    uint8_t padding[192];
-  } push_block_vs[(uint32_t)PREFILTERED_CUBE_NUM_MIPS * 6];
-
-  struct push_block_fs_t {
-    float roughness;
-    uint32_t num_samples;
-    uint8_t padding[248];
-  } push_block_fs[(uint32_t)PREFILTERED_CUBE_NUM_MIPS * 6];
+static void ibl_cache_get_filename(const char** environment_files,
+                                   ibl_texture_enum texture_index,
+                                   uint64_t hash, char* filename)
+{
+  char suffix[STRMAX];
+  snprintf(suffix, sizeof(suffix), ".%016llx.%s.ktx2",
+           (unsigned long long)hash, ibl_textures[texture_index].name);
+  file_get_cache_filename(WGPU_TEXTURE_CACHE_DIRECTORY, environment_files[0],
+                          suffix, filename, STRMAX);
+}
 
-  // Update shader push constant block data
-  {
-    mat4 matrices[6] = {
-      GLM_MAT4_IDENTITY_INIT, // POSITIVE_X
-      GLM_MAT4_IDENTITY_INIT, // NEGATIVE_X
-      GLM_MAT4_IDENTITY_INIT, // POSITIVE_Y
-      GLM_MAT4_IDENTITY_INIT, // NEGATIVE_Y
-      GLM_MAT4_IDENTITY_INIT, // POSITIVE_Z
-      GLM_MAT4_IDENTITY_INIT, // NEGATIVE_Z
-    };
-    // NEGATIVE_X
-    glm_rotate(matrices[0], glm_rad(90.0f), (vec3){0.0f, 1.0f, 0.0f});
-    glm_rotate(matrices[0], glm_rad(180.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // NEGATIVE_X
-    glm_rotate(matrices[1], glm_rad(-90.0f), (vec3){0.0f, 1.0f, 0.0f});
-    glm_rotate(matrices[1], glm_rad(180.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // POSITIVE_Y
-    glm_rotate(matrices[2], glm_rad(90.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // NEGATIVE_Y
-    glm_rotate(matrices[3], glm_rad(-90.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // POSITIVE_Z
-    glm_rotate(matrices[4], glm_rad(180.0f), (vec3){1.0f, 0.0f, 0.0f});
-    // NEGATIVE_Z
-    glm_rotate(matrices[5], glm_rad(180.0f), (vec3){0.0f, 0.0f, 1.0f});
-
-    mat4 projection = GLM_MAT4_IDENTITY_INIT;
-    glm_perspective(PI / 2.0f, 1.0f, 0.1f, 512.0f, projection);
-    // Sampling deltas
-    uint32_t idx = 0;
-    for (uint32_t m = 0; m < num_mips; ++m) {
-      for (uint32_t f = 0; f < 6; ++f) {
-        idx = (m * 6) + f;
-        // Set vertex shader push constant block
-        glm_mat4_mul(projection, matrices[f], push_block_vs[idx].mvp);
-        // Set fragment shader push constant block
-        push_block_fs[idx].roughness   = (float)m / (float)(num_mips - 1);
-        push_block_fs[idx].num_samples = 32u;
-      }
-    }
-  }
+static void create_ibl_sampler(wgpu_context_t* wgpu_context,
+                               texture_t* texture)
+{
+  WGPU_RELEASE_RESOURCE(Sampler, texture->sampler)
+  texture->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "ibl_texture_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Linear,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = (float)texture->mip_level_count,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(texture->sampler != NULL);
+}
 
-  static struct {
-    // Vertex shader parameter uniform buffer
-    struct {
-      WGPUBuffer buffer;
-      uint64_t buffer_size;
-      uint64_t model_size;
-    } vs;
-    // Fragment parameter uniform buffer
-    struct {
-      WGPUBuffer buffer;
-      uint64_t buffer_size;
-      uint64_t model_size;
-    } fs;
-  } prefiltered_cube_ubos;
-
-  // Vertex shader parameter uniform buffer
-  {
-    prefiltered_cube_ubos.vs.model_size = sizeof(mat4);
-    prefiltered_cube_ubos.vs.buffer_size
-      = calc_constant_buffer_byte_size(sizeof(push_block_vs));
-    prefiltered_cube_ubos.vs.buffer = wgpu_create_buffer_from_data(
-      wgpu_context, push_block_vs, prefiltered_cube_ubos.vs.buffer_size,
-      WGPUBufferUsage_Uniform);
+// Loads a texture from its cache file, returns false when there is none or it
+// does not match the generator settings
+static bool load_ibl_texture(wgpu_context_t* wgpu_context,
+                             const char* filename,
+                             ibl_texture_enum texture_index,
+                             texture_t* texture)
+{
+  if (!file_exists(filename)) {
+    return false;
   }
-
-  // Fragment shader parameter uniform buffer
-  {
-    prefiltered_cube_ubos.fs.model_size = sizeof(float) + sizeof(uint32_t);
-    prefiltered_cube_ubos.fs.buffer_size
-      = calc_constant_buffer_byte_size(sizeof(push_block_fs));
-    prefiltered_cube_ubos.fs.buffer = wgpu_create_buffer_from_data(
-      wgpu_context, push_block_fs, prefiltered_cube_ubos.fs.buffer_size,
-      WGPUBufferUsage_Uniform);
+  *texture = wgpu_create_texture_from_file(wgpu_context, filename, NULL);
+  if (texture->texture == NULL
+      || texture->size.width != ibl_textures[texture_index].dim
+      || texture->size.depth != ibl_textures[texture_index].face_count
+      || texture->mip_level_count
+           != ibl_textures[texture_index].mip_level_count) {
+    wgpu_destroy_texture(texture);
+    memset(texture, 0, sizeof(*texture));
+    return false;
   }
+  create_ibl_sampler(wgpu_context, texture);
+  return true;
+}
 
-  // Bind group layout
-  WGPUBindGroupLayout bind_group_layout = NULL;
-  {
-    WGPUBindGroupLayoutEntry bgl_entries[4] = {
-      [0] = (WGPUBindGroupLayoutEntry) {
-        // Binding 0: Vertex shader uniform UBO
-        .binding   = 0,
-        .visibility = WGPUShaderStage_Vertex,
-        .buffer = (WGPUBufferBindingLayout) {
-          .type             = WGPUBufferBindingType_Uniform,
-          .hasDynamicOffset = true,
-          .minBindingSize   = prefiltered_cube_ubos.vs.model_size,
-        },
-        .sampler = {0},
-      },
-      [1] = (WGPUBindGroupLayoutEntry) {
-        // Binding 1: Fragment shader uniform UBO
-        .binding    = 1,
-        .visibility = WGPUShaderStage_Fragment,
-        .buffer = (WGPUBufferBindingLayout) {
-          .type             = WGPUBufferBindingType_Uniform,
-          .hasDynamicOffset = true,
-          .minBindingSize   = prefiltered_cube_ubos.fs.model_size,
-        },
-        .sampler = {0},
-      },
-      [2] = (WGPUBindGroupLayoutEntry) {
-        // Binding 2: Fragment shader image view
-        .binding    = 2,
-        .visibility = WGPUShaderStage_Fragment,
-        .texture = (WGPUTextureBindingLayout) {
-          .sampleType    = WGPUTextureSampleType_Float,
-          .viewDimension = WGPUTextureViewDimension_Cube,
-          .multisampled  = false,
-        },
-        .storageTexture = {0},
-      },
-      [3] = (WGPUBindGroupLayoutEntry) {
-        // Binding 3: Fragment shader image sampler
-        .binding    = 3,
-        .visibility = WGPUShaderStage_Fragment,
-        .sampler = (WGPUSamplerBindingLayout){
-          .type = WGPUSamplerBindingType_Filtering,
-        },
-        .texture = {0},
-      },
+// Records the generation of a texture, one dispatch per mip level over all
+// faces, into a storage view of that level
+static void generate_ibl_texture(wgpu_context_t* wgpu_context,
+                                 WGPUComputePassEncoder pass_encoder,
+                                 wgpu_shader_t* comp_shader,
+                                 ibl_texture_enum texture_index,
+                                 texture_t* texture, wgpu_buffer_t* params)
+{
+  const uint32_t dim             = ibl_textures[texture_index].dim;
+  const uint32_t mip_level_count = ibl_textures[texture_index].mip_level_count;
+  const uint32_t face_count      = ibl_textures[texture_index].face_count;
+  const bool is_cube             = face_count == 6;
+
+  texture->size.width      = dim;
+  texture->size.height     = dim;
+  texture->size.depth      = face_count;
+  texture->mip_level_count = mip_level_count;
+  texture->format          = WGPUTextureFormat_RGBA8Unorm;
+  texture->dimension       = WGPUTextureDimension_2D;
+  texture->texture         = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label = ibl_textures[texture_index].name,
+      .usage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding
+               | WGPUTextureUsage_CopySrc,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){dim, dim, face_count},
+      .format        = texture->format,
+      .mipLevelCount = mip_level_count,
+      .sampleCount   = 1,
+    });
+  ASSERT(texture->texture != NULL);
+  texture->view = wgpuTextureCreateView(
+    texture->texture, &(WGPUTextureViewDescriptor){
+                        .format    = texture->format,
+                        .dimension = is_cube ? WGPUTextureViewDimension_Cube :
+                                               WGPUTextureViewDimension_2D,
+                        .baseMipLevel    = 0,
+                        .mipLevelCount   = mip_level_count,
+                        .baseArrayLayer  = 0,
+                        .arrayLayerCount = face_count,
+                      });
+  ASSERT(texture->view != NULL);
+  create_ibl_sampler(wgpu_context, texture);
+
+  WGPUProgrammableStageDescriptor stage
+    = comp_shader->programmable_stage_descriptor;
+  stage.entryPoint             = ibl_textures[texture_index].entry;
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = ibl_textures[texture_index].entry,
+                            .compute = stage,
+                          });
+  ASSERT(pipeline != NULL);
+  WGPUBindGroupLayout bind_group_layout
+    = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+
+  // One parameter block per mip level
+  const uint32_t params_stride = (uint32_t)ALIGNMENT;
+  *params = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "ibl_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = mip_level_count * params_stride,
+                  });
+
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  for (uint32_t m = 0; m < mip_level_count; ++m) {
+    const uint32_t size           = MAX(1u, dim >> m);
+    const ibl_params_t ibl_params = {
+      .size         = size,
+      .sample_count = texture_index == IblTexture_BrdfLut ? 1024u : 32u,
+      .roughness
+      = mip_level_count > 1 ? (float)m / (float)(mip_level_count - 1) : 0.0f,
     };
-    bind_group_layout = wgpuDeviceCreateBindGroupLayout(
-      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
-                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-                              .entries    = bgl_entries,
-                            });
-    ASSERT(bind_group_layout != NULL);
-  }
-
-  // Bind group
-  WGPUBindGroup bind_group = NULL;
-  {
-    WGPUBindGroupEntry bg_entries[4] = {
-      [0] = (WGPUBindGroupEntry) {
-        // Binding 0: Vertex shader uniform UBO
-        .binding = 0,
-        .buffer  = prefiltered_cube_ubos.vs.buffer,
-        .offset  = 0,
-        .size    = prefiltered_cube_ubos.vs.model_size,
-      },
-      [1] = (WGPUBindGroupEntry) {
-        // Binding 1: Fragment shader uniform UBO
+    wgpu_queue_write_buffer(wgpu_context, params->buffer, m * params_stride,
+                            &ibl_params, sizeof(ibl_params));
+
+    WGPUTextureView mip_view = wgpuTextureCreateView(
+      texture->texture,
+      &(WGPUTextureViewDescriptor){
+        .format          = texture->format,
+        .dimension       = is_cube ? WGPUTextureViewDimension_2DArray :
+                                     WGPUTextureViewDimension_2D,
+        .baseMipLevel    = m,
+        .mipLevelCount   = 1,
+        .baseArrayLayer  = 0,
+        .arrayLayerCount = face_count,
+      });
+    ASSERT(mip_view != NULL);
+
+    WGPUBindGroupEntry bg_entries[4] = {0};
+    uint32_t bg_entry_count          = 0;
+    if (is_cube) {
+      bg_entries[bg_entry_count++] = (WGPUBindGroupEntry){
+        // Binding 0: Environment cube map
+        .binding     = 0,
+        .textureView = textures.environment_cube.view,
+      };
+      bg_entries[bg_entry_count++] = (WGPUBindGroupEntry){
+        // Binding 1: Environment sampler
         .binding = 1,
-        .buffer  = prefiltered_cube_ubos.fs.buffer,
-        .offset  = 0,
-        .size    = prefiltered_cube_ubos.fs.model_size,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        // Binding 2: Fragment shader image view
-        .binding     = 2,
-        .textureView = textures.environment_cube.view
-      },
-      [3] = (WGPUBindGroupEntry) {
-        // Binding 3: Fragment shader image sampler
-        .binding = 3,
         .sampler = textures.environment_cube.sampler,
-      },
+      };
+    }
+    bg_entries[bg_entry_count++] = (WGPUBindGroupEntry){
+      // Binding 2: Parameters of the mip level
+      .binding = 2,
+      .buffer  = params->buffer,
+      .offset  = m * params_stride,
+      .size    = sizeof(ibl_params_t),
     };
-    bind_group = wgpuDeviceCreateBindGroup(
+    bg_entries[bg_entry_count++] = (WGPUBindGroupEntry){
+      // Binding 3 or 4: Mip level written
+      .binding     = is_cube ? 3 : 4,
+      .textureView = mip_view,
+    };
+    WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
       wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label      = ibl_textures[texture_index].name,
                               .layout     = bind_group_layout,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entryCount = bg_entry_count,
                               .entries    = bg_entries,
                             });
     ASSERT(bind_group != NULL);
-  }
 
-  // Pipeline layout
-  WGPUPipelineLayout pipeline_layout = NULL;
-  {
-    pipeline_layout = wgpuDeviceCreatePipelineLayout(
-      wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
-                              .bindGroupLayoutCount = 1,
-                              .bindGroupLayouts     = &bind_group_layout,
-                            });
-    ASSERT(pipeline_layout != NULL)
-  }
-
-  // Prefiltered cube map pipeline
-  WGPURenderPipeline pipeline = NULL;
-  {
-    // Primitive state
-    WGPUPrimitiveState primitive_state = {
-      .topology  = WGPUPrimitiveTopology_TriangleList,
-      .frontFace = WGPUFrontFace_CCW,
-      .cullMode  = WGPUCullMode_None,
-    };
+    // All faces of the mip level in one dispatch
+    const uint32_t group_count
+      = (size + IBL_WORKGROUP_SIZE - 1) / IBL_WORKGROUP_SIZE;
+    wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+    wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, group_count,
+                                             group_count, face_count);
 
-    // Color target state
-    WGPUBlendState blend_state              = wgpu_create_blend_state(false);
-    WGPUColorTargetState color_target_state = (WGPUColorTargetState){
-      .format    = format,
-      .blend     = &blend_state,
-      .writeMask = WGPUColorWriteMask_All,
-    };
-
-    // Vertex buffer layout
-    WGPU_GLTF_VERTEX_BUFFER_LAYOUT(
-      skybox,
-      // Location 0: Position
-      WGPU_GLTF_VERTATTR_DESC(0, WGPU_GLTF_VertexComponent_Position));
-
-    // Vertex state
-    WGPUVertexState vertex_state = wgpu_create_vertex_state(
-              wgpu_context, &(wgpu_vertex_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Vertex shader SPIR-V
-                .label = "filtercube_vertex_shaders",
-                .file  = "shaders/pbr_ibl/filtercube.vert.spv",
-              },
-             .buffer_count = 1,
-             .buffers = &skybox_vertex_buffer_layout,
-            });
-
-    // Fragment state
-    WGPUFragmentState fragment_state = wgpu_create_fragment_state(
-              wgpu_context, &(wgpu_fragment_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Fragment shader SPIR-V
-                .label = "prefilterenvmap_fragment_shaders",
-                .file  = "shaders/pbr_ibl/prefilterenvmap.frag.spv",
-              },
-              .target_count = 1,
-              .targets = &color_target_state,
-            });
-
-    // Multisample state
-    WGPUMultisampleState multisample_state
-      = wgpu_create_multisample_state_descriptor(
-        &(create_multisample_state_desc_t){
-          .sample_count = 1,
-        });
+    // Released resources stay alive until the recorded work has finished
+    WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+    WGPU_RELEASE_RESOURCE(TextureView, mip_view)
+  }
 
-    // Create rendering pipeline using the specified states
-    pipeline = wgpuDeviceCreateRenderPipeline(
-      wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                              .label  = "prefiltered_cube_map_render_pipeline",
-                              .layout = pipeline_layout,
-                              .primitive    = primitive_state,
-                              .vertex       = vertex_state,
-                              .fragment     = &fragment_state,
-                              .depthStencil = NULL,
-                              .multisample  = multisample_state,
-                            });
-    ASSERT(pipeline != NULL);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, pipeline)
+}
 
-    // Partial cleanup
-    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
-    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+// Loads the IBL textures from the cache, the missing ones are generated and
+// saved to the cache once the GPU has finished them
+static void prepare_ibl_textures(wgpu_context_t* wgpu_context,
+                                 const char** environment_files,
+                                 uint32_t environment_file_count)
+{
+  texture_t* ibl_texture_targets[IblTexture_Count] = {
+    [IblTexture_BrdfLut]         = &textures.lut_brdf,
+    [IblTexture_IrradianceCube]  = &textures.irradiance_cube,
+    [IblTexture_PrefilteredCube] = &textures.prefiltered_cube,
+  };
+  char filenames[IblTexture_Count][STRMAX];
+  bool generate[IblTexture_Count] = {0};
+  bool generate_any               = false;
+  for (uint32_t i = 0; i < (uint32_t)IblTexture_Count; ++i) {
+    ibl_cache_get_filename(environment_files, (ibl_texture_enum)i,
+                           ibl_cache_hash(environment_files,
+                                          environment_file_count,
+                                          (ibl_texture_enum)i),
+                           filenames[i]);
+    generate[i] = !load_ibl_texture(wgpu_context, filenames[i],
+                                    (ibl_texture_enum)i,
+                                    ibl_texture_targets[i]);
+    generate_any = generate_any || generate[i];
+  }
+  if (!generate_any) {
+    return;
   }
 
-  // Create the actual renderpass
-  struct {
-    WGPURenderPassColorAttachment color_attachment[1];
-    WGPURenderPassDescriptor render_pass_descriptor;
-  } render_pass = {
-    .color_attachment[0]= (WGPURenderPassColorAttachment) {
-        .view       = NULL,
-        .loadOp     = WGPULoadOp_Clear,
-        .storeOp    = WGPUStoreOp_Store,
-        .clearColor = (WGPUColor) {
-          .r = 0.0f,
-          .g = 0.0f,
-          .b = 0.2f,
-          .a = 0.0f,
-        },
-     },
-  };
-  render_pass.render_pass_descriptor = (WGPURenderPassDescriptor){
-    .colorAttachmentCount   = 1,
-    .colorAttachments       = render_pass.color_attachment,
-    .depthStencilAttachment = NULL,
-  };
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "ibl_compute_shader",
+                    .wgsl_code.source = ibl_compute_shader_wgsl,
+                    .entry            = "cs_brdf_lut",
+                  });
+  wgpu_buffer_t params_buffers[IblTexture_Count] = {0};
 
-  // Render
-  {
-    wgpu_context->cmd_enc
-      = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
-
-    uint32_t idx         = 0;
-    float viewport_width = 0.0f, viewport_height = 0.0f;
-    for (uint32_t m = 0; m < num_mips; ++m) {
-      viewport_width  = (float)(dim * pow(0.5f, m));
-      viewport_height = (float)(dim * pow(0.5f, m));
-      for (uint32_t f = 0; f < 6; ++f) {
-        render_pass.color_attachment[0].view
-          = offscreen.texture_views[(f * num_mips) + m];
-        idx = (m * 6) + f;
-        // Render scene from cube face's point of view
-        wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-          wgpu_context->cmd_enc, &render_pass.render_pass_descriptor);
-        wgpuRenderPassEncoderSetViewport(wgpu_context->rpass_enc, 0.0f, 0.0f,
-                                         viewport_width, viewport_height, 0.0f,
-                                         1.0f);
-        wgpuRenderPassEncoderSetScissorRect(wgpu_context->rpass_enc, 0u, 0u,
-                                            (uint32_t)viewport_width,
-                                            (uint32_t)viewport_height);
-        wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
-        // Calculate the dynamic offsets
-        uint32_t dynamic_offset     = idx * (uint32_t)ALIGNMENT;
-        uint32_t dynamic_offsets[2] = {dynamic_offset, dynamic_offset};
-        // Bind the bind group for rendering a mesh using the dynamic offset
-        wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
-                                          bind_group, 2, dynamic_offsets);
-        // Draw object
-        wgpu_gltf_model_draw(models.skybox,
-                             (wgpu_gltf_model_render_options_t){0});
-        // End render pass
-        wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
-        WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
-      }
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder pass_encoder
+    = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  for (uint32_t i = 0; i < (uint32_t)IblTexture_Count; ++i) {
+    if (generate[i]) {
+      generate_ibl_texture(wgpu_context, pass_encoder, &comp_shader,
+                           (ibl_texture_enum)i, ibl_texture_targets[i],
+                           &params_buffers[i]);
     }
-
-    // Copy region for transfer from framebuffer to cube face
-    for (uint32_t m = 0; m < num_mips; ++m) {
-      WGPUExtent3D copy_size = (WGPUExtent3D){
-        .width              = (float)(dim * pow(0.5f, m)),
-        .height             = (float)(dim * pow(0.5f, m)),
-        .depthOrArrayLayers = array_layer_count,
-      };
-      wgpuCommandEncoderCopyTextureToTexture(
-        wgpu_context->cmd_enc,
-        // source
-        &(WGPUImageCopyTexture){
-          .texture  = offscreen.texture,
-          .mipLevel = m,
-        },
-        // destination
-        &(WGPUImageCopyTexture){
-          .texture  = textures.prefiltered_cube.texture,
-          .mipLevel = m,
+  }
+  wgpuComputePassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass_encoder)
+  WGPUCommandBuffer command_buffer = wgpuCommandEncoderFinish(cmd_enc, NULL);
+  ASSERT(command_buffer != NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  // The files are written in the background once the copies have landed
+  for (uint32_t i = 0; i < (uint32_t)IblTexture_Count; ++i) {
+    if (generate[i]) {
+      wgpu_texture_save_to_ktx2_file(
+        wgpu_context,
+        &(wgpu_texture_save_desc_t){
+          .texture         = ibl_texture_targets[i]->texture,
+          .format          = ibl_texture_targets[i]->format,
+          .width           = ibl_texture_targets[i]->size.width,
+          .height          = ibl_texture_targets[i]->size.height,
+          .face_count      = ibl_texture_targets[i]->size.depth,
+          .mip_level_count = ibl_texture_targets[i]->mip_level_count,
         },
-        // copySize
-        &copy_size);
+        filenames[i]);
+      wgpu_destroy_buffer(&params_buffers[i]);
     }
+  }
+  wgpu_shader_release(&comp_shader);
+}
 
-    WGPUCommandBuffer command_buffer
-      = wgpuCommandEncoderFinish(wgpu_context->cmd_enc, NULL);
-    ASSERT(command_buffer != NULL);
-    WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
+static void get_object_model_matrix(mat4 model)
+{
+  glm_mat4_identity(model);
+  glm_rotate(model,
+             glm_rad(-90.0f + (models.object_index == 1 ? 45.0f : 0.0f)),
+             (vec3){0.0f, 1.0f, 0.0f});
+}
 
-    // Sumbit commmand buffer and cleanup
-    wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
-    WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
-  }
+// Rotation of the view and of the environment
+static void get_skybox_model_matrix(mat4 view, mat4 model)
+{
+  mat3 mat3_tmp = GLM_MAT3_ZERO_INIT;
+  glm_mat4_pick3(view, mat3_tmp);
+  glm_mat4_identity(model);
+  glm_mat4_ins3(mat3_tmp, model);
+  glm_rotate(model, glm_rad(reflection_probe_settings.environment_rotation),
+             (vec3){0.0f, 1.0f, 0.0f});
+}
 
-  // Cleanup
-  WGPU_RELEASE_RESOURCE(Texture, offscreen.texture)
-  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(offscreen.texture_views); ++i) {
-    WGPU_RELEASE_RESOURCE(TextureView, offscreen.texture_views[i])
+// Cameras of the probe faces, the faces rendered in a frame use the matrices of
+// that frame
+static void
+update_reflection_probe_uniform_buffers(wgpu_context_t* wgpu_context)
+{
+  for (uint32_t f = 0; f < 6; ++f) {
+    struct ubo_matrices_t face_matrices = {0};
+    wgpu_reflection_probe_get_face_matrices(
+      reflection_probe.probe, f, face_matrices.projection, face_matrices.view);
+    glm_vec3_copy(reflection_probe_settings.position, face_matrices.cam_pos);
+
+    get_object_model_matrix(face_matrices.model);
+    wgpu_queue_write_buffer(wgpu_context, reflection_probe.object_ubo.buffer,
+                            f * ALIGNMENT, &face_matrices,
+                            sizeof(face_matrices));
+
+    get_skybox_model_matrix(face_matrices.view, face_matrices.model);
+    wgpu_queue_write_buffer(wgpu_context, reflection_probe.skybox_ubo.buffer,
+                            f * ALIGNMENT, &face_matrices,
+                            sizeof(face_matrices));
   }
-  WGPU_RELEASE_RESOURCE(Buffer, prefiltered_cube_ubos.vs.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, prefiltered_cube_ubos.fs.buffer)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
@@ -1890,21 +1426,17 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
   camera_t* camera = context->camera;
   glm_mat4_copy(camera->matrices.perspective, ubo_matrices.projection);
   glm_mat4_copy(camera->matrices.view, ubo_matrices.view);
-  glm_mat4_identity(ubo_matrices.model);
-  glm_rotate(ubo_matrices.model,
-             glm_rad(-90.0f + (models.object_index == 1 ? 45.0f : 0.0f)),
-             (vec3){0.0f, 1.0f, 0.0f});
+  get_object_model_matrix(ubo_matrices.model);
   glm_vec3_scale(camera->position, -1.0f, ubo_matrices.cam_pos);
   wgpu_queue_write_buffer(context->wgpu_context, uniform_buffers.object.buffer,
                           0, &ubo_matrices, uniform_buffers.object.size);
 
   // Skybox
-  mat3 mat3_tmp = GLM_MAT3_ZERO_INIT;
-  glm_mat4_pick3(camera->matrices.view, mat3_tmp);
-  glm_mat4_ins3(mat3_tmp, ubo_matrices.model);
-  ubo_matrices.model[3][3] = 1.0f;
+  get_skybox_model_matrix(camera->matrices.view, ubo_matrices.model);
   wgpu_queue_write_buffer(context->wgpu_context, uniform_buffers.skybox.buffer,
                           0, &ubo_matrices, uniform_buffers.skybox.size);
+
+  update_reflection_probe_uniform_buffers(context->wgpu_context);
 }
 
 static void update_dynamic_uniform_buffer(wgpu_context_t* wgpu_context)
@@ -1944,6 +1476,14 @@ static void update_params(wgpu_context_t* wgpu_context)
 
   wgpu_queue_write_buffer(wgpu_context, uniform_buffers.ubo_params.buffer, 0,
                           &ubo_params, uniform_buffers.ubo_params.size);
+
+  // The probe faces are captured without the gamma correction, the frame
+  // applies it once to the reflections
+  const float gamma = ubo_params.gamma;
+  ubo_params.gamma  = 1.0f;
+  wgpu_queue_write_buffer(wgpu_context, reflection_probe.params_ubo.buffer, 0,
+                          &ubo_params, uniform_buffers.ubo_params.size);
+  ubo_params.gamma = gamma;
 }
 
 // Prepare and initialize uniform buffer containing shader uniforms
@@ -2001,24 +1541,110 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
       = wgpuDeviceCreateBuffer(context->wgpu_context->device, &ubo_desc);
   }
 
+  // Probe face uniform buffers, one block per face
+  reflection_probe.object_ubo = wgpu_create_buffer(
+    context->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "reflection_probe_object_ubo",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = 6 * ALIGNMENT,
+    });
+  reflection_probe.skybox_ubo = wgpu_create_buffer(
+    context->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "reflection_probe_skybox_ubo",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = 6 * ALIGNMENT,
+    });
+  reflection_probe.params_ubo = wgpu_create_buffer(
+    context->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "reflection_probe_params_ubo",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = sizeof(ubo_params),
+    });
+
   update_uniform_buffers(context);
   update_dynamic_uniform_buffer(context->wgpu_context);
   update_params(context->wgpu_context);
 }
 
+static void prepare_reflection_probe(wgpu_context_t* wgpu_context)
+{
+  reflection_probe.probe = wgpu_reflection_probe_create(
+    wgpu_context, &(wgpu_reflection_probe_desc_t){
+                    .gpu_budget_ms = reflection_probe_settings.gpu_budget_ms,
+                    .continuous = reflection_probe_settings.rotate_environment,
+                  });
+  wgpu_reflection_probe_set_position(reflection_probe.probe,
+                                     reflection_probe_settings.position);
+}
+
+static void draw_reflection_probe_face(WGPURenderPassEncoder pass_encoder,
+                                       uint32_t face, void* user_data)
+{
+  UNUSED_VAR(user_data);
+
+  // Skybox
+  if (display_skybox) {
+    wgpuRenderPassEncoderSetPipeline(pass_encoder,
+                                     reflection_probe.skybox_pipeline);
+    wgpuRenderPassEncoderSetBindGroup(
+      pass_encoder, 0, reflection_probe.skybox_bind_groups[face], 0, 0);
+    wgpu_gltf_model_draw_to_pass(models.skybox, pass_encoder,
+                                 (wgpu_gltf_model_render_options_t){0});
+  }
+
+  // Objects
+  wgpuRenderPassEncoderSetPipeline(pass_encoder, reflection_probe.pbr_pipeline);
+  for (uint32_t i = 0; i < (uint32_t)SINGLE_ROW_OBJECT_COUNT; ++i) {
+    uint32_t dynamic_offset     = i * (uint32_t)ALIGNMENT;
+    uint32_t dynamic_offsets[2] = {dynamic_offset, dynamic_offset};
+    wgpuRenderPassEncoderSetBindGroup(pass_encoder, 0,
+                                      reflection_probe.object_bind_groups[face],
+                                      2, dynamic_offsets);
+    wgpu_gltf_model_draw_to_pass(models.objects[models.object_index].object,
+                                 pass_encoder,
+                                 (wgpu_gltf_model_render_options_t){0});
+  }
+}
+
+// Renders and filters the whole probe before the first frame
+static void prime_reflection_probe(wgpu_context_t* wgpu_context)
+{
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  wgpu_reflection_probe_update_all(reflection_probe.probe, cmd_enc,
+                                   draw_reflection_probe_face, NULL);
+  WGPUCommandBuffer command_buffer = wgpuCommandEncoderFinish(cmd_enc, NULL);
+  ASSERT(command_buffer != NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  setup_objects_bind_group(wgpu_context);
+}
+
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
     setup_camera(context);
     load_assets(context->wgpu_context);
-    generate_brdf_lut(context->wgpu_context);
-    generate_irradiance_cube(context->wgpu_context);
-    generate_prefiltered_cube(context->wgpu_context);
+    if (environment_panorama_file != NULL) {
+      prepare_ibl_textures(context->wgpu_context, &environment_panorama_file,
+                           1);
+    }
+    else {
+      prepare_ibl_textures(context->wgpu_context, environment_cube_files,
+                           (uint32_t)ARRAY_SIZE(environment_cube_files));
+    }
+    prepare_reflection_probe(context->wgpu_context);
     prepare_uniform_buffers(context);
     setup_bind_group_layouts(context->wgpu_context);
     setup_pipeline_layouts(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_groups(context->wgpu_context);
+    prime_reflection_probe(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
     return 0;
@@ -2033,20 +1659,55 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
     if (imgui_overlay_combo_box(context->imgui_overlay, "Material",
                                 &current_material_index, material_names, 11)) {
       update_dynamic_uniform_buffer(context->wgpu_context);
+      wgpu_reflection_probe_invalidate(reflection_probe.probe);
     }
     if (imgui_overlay_combo_box(context->imgui_overlay, "Object type",
                                 &models.object_index, object_names, 4)) {
       update_dynamic_uniform_buffer(context->wgpu_context);
+      wgpu_reflection_probe_invalidate(reflection_probe.probe);
     }
     if (imgui_overlay_input_float(context->imgui_overlay, "Exposure",
                                   &ubo_params.exposure, 0.1f, "%.2f")) {
       update_params(context->wgpu_context);
+      wgpu_reflection_probe_invalidate(reflection_probe.probe);
     }
     if (imgui_overlay_input_float(context->imgui_overlay, "Gamma",
                                   &ubo_params.gamma, 0.1f, "%.2f")) {
       update_params(context->wgpu_context);
     }
-    imgui_overlay_checkBox(context->imgui_overlay, "Skybox", &display_skybox);
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Skybox",
+                               &display_skybox)) {
+      wgpu_reflection_probe_invalidate(reflection_probe.probe);
+    }
+  }
+  if (imgui_overlay_header("Reflection probe")) {
+    if (imgui_overlay_checkBox(
+          context->imgui_overlay, "Dynamic reflections",
+          &reflection_probe_settings.dynamic_reflections)) {
+      setup_objects_bind_group(context->wgpu_context);
+    }
+    if (imgui_overlay_checkBox(context->imgui_overlay, "Rotate environment",
+                               &reflection_probe_settings.rotate_environment)) {
+      wgpu_reflection_probe_set_continuous(
+        reflection_probe.probe, reflection_probe_settings.rotate_environment);
+    }
+    if (imgui_overlay_slider_float(context->imgui_overlay, "GPU budget (ms)",
+                                   &reflection_probe_settings.gpu_budget_ms,
+                                   0.1f, 4.0f)) {
+      wgpu_reflection_probe_set_gpu_budget(
+        reflection_probe.probe, reflection_probe_settings.gpu_budget_ms);
+    }
+    wgpu_reflection_probe_stats_t stats = {0};
+    wgpu_reflection_probe_get_stats(reflection_probe.probe, &stats);
+    imgui_overlay_text("Work items: %u / %u per frame", stats.frame_item_count,
+                       stats.item_count);
+    imgui_overlay_text("Update: %u frames", stats.update_frame_count);
+    if (stats.frame_gpu_time_ms >= 0.0f) {
+      imgui_overlay_text("GPU: %.3f ms", stats.frame_gpu_time_ms);
+    }
+    else {
+      imgui_overlay_text("GPU: n/a");
+    }
   }
 }
 
@@ -2059,6 +1720,14 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Work items of the reflection probe within the budget of the frame
+  if (reflection_probe_settings.dynamic_reflections
+      && wgpu_reflection_probe_update(reflection_probe.probe,
+                                      wgpu_context->cmd_enc,
+                                      draw_reflection_probe_face, NULL)) {
+    setup_objects_bind_group(wgpu_context);
+  }
+
   // Create render pass encoder for encoding drawing commands
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass.descriptor);
@@ -2137,6 +1806,13 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
+  if (reflection_probe_settings.rotate_environment && !context->paused) {
+    reflection_probe_settings.environment_rotation
+      = fmodf(reflection_probe_settings.environment_rotation
+                + context->frame_timer * 10.0f,
+              360.0f);
+    update_uniform_buffers(context);
+  }
   return example_draw(context);
 }
 
@@ -2169,10 +1845,33 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layouts.skybox)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.pbr)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.skybox)
+  for (uint32_t f = 0; f < 6; ++f) {
+    WGPU_RELEASE_RESOURCE(BindGroup, reflection_probe.object_bind_groups[f])
+    WGPU_RELEASE_RESOURCE(BindGroup, reflection_probe.skybox_bind_groups[f])
+  }
+  WGPU_RELEASE_RESOURCE(RenderPipeline, reflection_probe.pbr_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, reflection_probe.skybox_pipeline)
+  wgpu_destroy_buffer(&reflection_probe.object_ubo);
+  wgpu_destroy_buffer(&reflection_probe.skybox_ubo);
+  wgpu_destroy_buffer(&reflection_probe.params_ubo);
+  wgpu_reflection_probe_release(reflection_probe.probe);
+}
+
+static void parse_environment_arguments(int argc, char* argv[])
+{
+  static const char environment_option[] = "--environment=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], environment_option, strlen(environment_option))
+        == 0) {
+      environment_panorama_file = argv[i] + strlen(environment_option);
+    }
+  }
 }
 
 void example_pbr_ibl(int argc, char* argv[])
 {
+  parse_environment_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
@@ -121,7 +121,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
       | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   // Skybox
   models.skybox
     = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
@@ -150,17 +151,22 @@ static void load_assets(wgpu_context_t* wgpu_context)
     &(struct wgpu_texture_load_options_t){
       .flip_y = true, // Flip y to match gcanyon.ktx hdr cubemap
     });
-  // Model textures
-  textures.albedo_map = wgpu_create_texture_from_file(
-    wgpu_context, "models/Cerberus/albedo.png", NULL);
-  textures.normal_map = wgpu_create_texture_from_file(
-    wgpu_context, "models/Cerberus/normal.png", NULL);
-  textures.ao_map = wgpu_create_texture_from_file(
-    wgpu_context, "models/Cerberus/ao.png", NULL);
-  textures.metallic_map = wgpu_create_texture_from_file(
-    wgpu_context, "models/Cerberus/metallic.png", NULL);
-  textures.roughness_map = wgpu_create_texture_from_file(
-    wgpu_context, "models/Cerberus/roughness.png", NULL);
+  // Model textures, decoded concurrently
+  static const char* model_textures[5] = {
+    "models/Cerberus/albedo.png",    // Albedo
+    "models/Cerberus/normal.png",    // Normal
+    "models/Cerberus/ao.png",        // Ambient occlusion
+    "models/Cerberus/metallic.png",  // Metallic
+    "models/Cerberus/roughness.png", // Roughness
+  };
+  texture_t model_texture_results[5] = {0};
+  wgpu_create_textures_from_files(wgpu_context, 5, model_textures, NULL,
+                                  model_texture_results);
+  textures.albedo_map    = model_texture_results[0];
+  textures.normal_map    = model_texture_results[1];
+  textures.ao_map        = model_texture_results[2];
+  textures.metallic_map  = model_texture_results[3];
+  textures.roughness_map = model_texture_results[4];
 }
 
 static void setup_bind_group_layouts(wgpu_context_t* wgpu_context)
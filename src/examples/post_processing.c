@@ -10,7 +10,9 @@
  * WebGPU Example - Post-processing
  *
  * This example shows how to use a post-processing effect to blend between two
- * scenes.
+ * scenes. Each scene is rendered to a texture of its own, which caches it: a
+ * scene is rendered again only when the camera moved since, and not at all
+ * while the transition shows the other scene only.
  *
  * Ref:
  * https://github.com/gnikoloff/webgpu-dojo/tree/master/src/examples/postprocessing-01
@@ -25,6 +27,9 @@
 #define WORLD_SIZE_Y 20u
 #define WORLD_SIZE_Z 20u
 
+/* Distance to the tween factor target below which the transition ends */
+#define TWEEN_FACTOR_SETTLE_EPSILON 0.001f
+
 /* -------------------------------------------------------------------------- *
  * Base transform class to handle vectors and matrices
  *
@@ -914,12 +919,14 @@ static void generate_gpu_buffers_from_instanced_geometry(
 
 static struct {
   bool animatable;
+  bool orbit_camera;
   float tween_factor;
   float tween_factor_target;
   vec3 light_position;
   vec3 base_colors[2];
 } options = {
   .animatable          = true,
+  .orbit_camera        = true,
   .tween_factor        = 0.0f,
   .tween_factor_target = 0.0f,
   .light_position      = {0.5f, 0.5f, 0.50f},
@@ -967,12 +974,13 @@ static struct {
   texture_t cutoff_mask;
 } textures = {0};
 
-/* Framebuffer for offscreen rendering */
+/* Framebuffer for offscreen rendering, the scenes render into the post-fx
+ * textures */
 static struct {
   struct {
     WGPUTexture texture;
     WGPUTextureView texture_view;
-  } color, depth_stencil;
+  } depth_stencil;
 } offscreen_framebuffer = {0};
 
 static struct {
@@ -1006,8 +1014,17 @@ static struct {
 static struct {
   float old_time;
   float last_tween_factor_target_change_time;
+  float camera_time; /* only advances while the camera orbits */
 } time_info = {0};
 
+/* Cameras the scenes in the post-fx textures were rendered with */
+static struct {
+  bool valid[2];
+  mat4 view_matrices[2];
+  mat4 projection_matrices[2];
+  uint32_t rendered_count; /* scenes rendered in the last frame */
+} scene_cache = {0};
+
 // Other variables
 static const char* example_title = "Post-processing";
 static bool prepared             = false;
@@ -1113,11 +1130,15 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
   }
 
   /* Write perspective camera projection and view matrix to uniform block */
+  if (options.orbit_camera) {
+    time_info.camera_time += dt;
+  }
+  const float ct = time_info.camera_time;
   perspective_camera_set_position(&cameras.perspective_camera,
                                   (vec3){
-                                    cos(ts * 0.2f) * WORLD_SIZE_X, // x
+                                    cos(ct * 0.2f) * WORLD_SIZE_X, // x
                                     0.0f,                          // y
-                                    sin(ts * 0.2f) * WORLD_SIZE_Z, // z
+                                    sin(ct * 0.2f) * WORLD_SIZE_Z, // z
                                   });
   perspective_camera_look_at(&cameras.perspective_camera, GLM_VEC3_ZERO);
   perspective_camera_update_projection_matrix(&cameras.perspective_camera);
@@ -1148,10 +1169,15 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
     context->wgpu_context, uniform_buffers.quad_transform.buffer, 0,
     quad_transform.model_matrix, sizeof(quad_transform.model_matrix));
 
-  /* Write tween factor */
+  /* Write tween factor, the transition ends at the target instead of only
+   * approaching it, so that the hidden scene is no longer rendered */
   if (options.animatable) {
     options.tween_factor
       += (options.tween_factor_target - options.tween_factor) * (dt * 2.0f);
+    if (fabsf(options.tween_factor_target - options.tween_factor)
+        < TWEEN_FACTOR_SETTLE_EPSILON) {
+      options.tween_factor = options.tween_factor_target;
+    }
   }
   update_tween_factor(context->wgpu_context);
 }
@@ -1208,43 +1234,24 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
   }
 }
 
+static void release_offscreen_framebuffer(void)
+{
+  WGPU_RELEASE_RESOURCE(Texture, offscreen_framebuffer.depth_stencil.texture)
+  WGPU_RELEASE_RESOURCE(TextureView,
+                        offscreen_framebuffer.depth_stencil.texture_view)
+}
+
 static void prepare_offscreen_framebuffer(wgpu_context_t* wgpu_context)
 {
+  // The attachments of a previous initialization are not reused
+  release_offscreen_framebuffer();
+
   WGPUExtent3D texture_extent = {
     .width              = wgpu_context->surface.width,
     .height             = wgpu_context->surface.height,
     .depthOrArrayLayers = 1,
   };
 
-  // Color attachment
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .size          = texture_extent,
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = wgpu_context->swap_chain.format,
-      .usage         = WGPUTextureUsage_RenderAttachment
-               | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopySrc,
-    };
-    offscreen_framebuffer.color.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-    ASSERT(offscreen_framebuffer.color.texture != NULL);
-
-    // Create the texture view
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .dimension       = WGPUTextureViewDimension_2D,
-      .format          = texture_desc.format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = 1,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = 1,
-    };
-    offscreen_framebuffer.color.texture_view = wgpuTextureCreateView(
-      offscreen_framebuffer.color.texture, &texture_view_dec);
-    ASSERT(offscreen_framebuffer.color.texture_view != NULL);
-  }
-
   // Depth stencil attachment
   {
     WGPUTextureDescriptor texture_desc = {
@@ -1254,7 +1261,7 @@ static void prepare_offscreen_framebuffer(wgpu_context_t* wgpu_context)
       .sampleCount   = 1,
       .dimension     = WGPUTextureDimension_2D,
       .format        = WGPUTextureFormat_Depth24PlusStencil8,
-      .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+      .usage         = WGPUTextureUsage_RenderAttachment,
     };
     offscreen_framebuffer.depth_stencil.texture
       = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
@@ -1277,9 +1284,22 @@ static void prepare_offscreen_framebuffer(wgpu_context_t* wgpu_context)
   }
 }
 
+static void release_textures(void)
+{
+  WGPU_RELEASE_RESOURCE(Texture, textures.post_fx0.texture)
+  WGPU_RELEASE_RESOURCE(TextureView, textures.post_fx0.view)
+  WGPU_RELEASE_RESOURCE(Texture, textures.post_fx1.texture)
+  WGPU_RELEASE_RESOURCE(TextureView, textures.post_fx1.view)
+  WGPU_RELEASE_RESOURCE(Sampler, textures.post_fx_sampler)
+  wgpu_destroy_texture(&textures.cutoff_mask);
+}
+
 /* Set up texture and sampler needed for postprocessing */
 static void prepare_textures(wgpu_context_t* wgpu_context)
 {
+  release_textures();
+  scene_cache.valid[0] = scene_cache.valid[1] = false;
+
   WGPUExtent3D texture_size = {
     .width              = wgpu_context->surface.width,
     .height             = wgpu_context->surface.height,
@@ -1291,7 +1311,8 @@ static void prepare_textures(wgpu_context_t* wgpu_context)
     /* Create texture */
     WGPUTextureDescriptor texture_desc = {
       .label     = "post-fx0-texture",
-      .usage     = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
+      .usage
+      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
       .dimension = WGPUTextureDimension_2D,
       .size      = texture_size,
       .format    = wgpu_context->swap_chain.format,
@@ -1323,7 +1344,8 @@ static void prepare_textures(wgpu_context_t* wgpu_context)
     /* Create texture */
     WGPUTextureDescriptor texture_desc = {
       .label     = "post-fx1-texture",
-      .usage     = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
+      .usage
+      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
       .dimension = WGPUTextureDimension_2D,
       .size      = texture_size,
       .format    = wgpu_context->swap_chain.format,
@@ -1868,10 +1890,13 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Animatable",
                            &options.animatable);
+    imgui_overlay_checkBox(context->imgui_overlay, "Orbit camera",
+                           &options.orbit_camera);
     if (imgui_overlay_slider_float(context->imgui_overlay, "Tween Factor",
                                    &options.tween_factor, 0.0f, 1.0f)) {
       update_tween_factor(context->wgpu_context);
     }
+    imgui_overlay_text("Scenes rendered: %u", scene_cache.rendered_count);
   }
 }
 
@@ -1894,17 +1919,49 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+/* Scene 0 shows fully at tween factor 0 and scene 1 at tween factor 1 */
+static bool scene_is_visible(uint32_t scene)
+{
+  return scene == 0 ? options.tween_factor < 1.0f :
+                      options.tween_factor > 0.0f;
+}
+
+/* A visible scene is rendered when its texture holds no result yet or one
+ * rendered with another camera */
+static bool scene_needs_render(uint32_t scene)
+{
+  const perspective_camera_t* camera = &cameras.perspective_camera;
+  return scene_is_visible(scene)
+         && (!scene_cache.valid[scene]
+             || memcmp(scene_cache.view_matrices[scene], camera->view_matrix,
+                       sizeof(mat4))
+                  != 0
+             || memcmp(scene_cache.projection_matrices[scene],
+                       camera->projection_matrix, sizeof(mat4))
+                  != 0);
+}
+
+static void scene_cache_update(uint32_t scene)
+{
+  const perspective_camera_t* camera = &cameras.perspective_camera;
+  glm_mat4_copy((vec4*)camera->view_matrix, scene_cache.view_matrices[scene]);
+  glm_mat4_copy((vec4*)camera->projection_matrix,
+                scene_cache.projection_matrices[scene]);
+  scene_cache.valid[scene] = true;
+  scene_cache.rendered_count++;
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  // Set target frame buffer
-  render_passes.scene_render.color_attachments[0].view
-    = offscreen_framebuffer.color.texture_view;
+  scene_cache.rendered_count = 0;
 
-  /* Render instanced cubes scene to default swapchainTexture */
-  {
+  /* Render instanced cubes scene to the post-fx0 texture */
+  if (scene_needs_render(0)) {
+    render_passes.scene_render.color_attachments[0].view
+      = textures.post_fx0.view;
     render_passes.scene_render.color_attachments[0].clearColor = (WGPUColor){
       .r = 0.1f,
       .g = 0.1f,
@@ -1942,35 +1999,13 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                      INSTANCES_COUNT, 0, 0, 0);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+    scene_cache_update(0);
   }
 
-  /**
-   * Copy offscreen texture to another texture that will be outputted on the
-   * fullscreen quad
-   */
-  {
-    wgpuCommandEncoderCopyTextureToTexture(
-      wgpu_context->cmd_enc,
-      // source
-      &(WGPUImageCopyTexture){
-        .texture  = offscreen_framebuffer.color.texture,
-        .mipLevel = 0,
-      },
-      // destination
-      &(WGPUImageCopyTexture){
-        .texture  = textures.post_fx0.texture,
-        .mipLevel = 0,
-      },
-      // copySize
-      &(WGPUExtent3D){
-        .width              = wgpu_context->surface.width,
-        .height             = wgpu_context->surface.height,
-        .depthOrArrayLayers = 1,
-      });
-  }
-
-  /* Render instanced spheres scene to default swapchainTexture */
-  {
+  /* Render instanced spheres scene to the post-fx1 texture */
+  if (scene_needs_render(1)) {
+    render_passes.scene_render.color_attachments[0].view
+      = textures.post_fx1.view;
     render_passes.scene_render.color_attachments[0].clearColor = (WGPUColor){
       .r = 0.225f,
       .g = 0.225f,
@@ -2008,31 +2043,7 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
                                      INSTANCES_COUNT, 0, 0, 0);
     wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
     WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
-  }
-
-  /**
-   * Copy offscreen texture to another texture that will be outputted on the
-   * fullscreen quad
-   */
-  {
-    wgpuCommandEncoderCopyTextureToTexture(
-      wgpu_context->cmd_enc,
-      // source
-      &(WGPUImageCopyTexture){
-        .texture  = offscreen_framebuffer.color.texture,
-        .mipLevel = 0,
-      },
-      // destination
-      &(WGPUImageCopyTexture){
-        .texture  = textures.post_fx1.texture,
-        .mipLevel = 0,
-      },
-      // copySize
-      &(WGPUExtent3D){
-        .width              = wgpu_context->surface.width,
-        .height             = wgpu_context->surface.height,
-        .depthOrArrayLayers = 1,
-      });
+    scene_cache_update(1);
   }
 
   // Set target frame buffer
@@ -2129,18 +2140,8 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.base_colors[0].buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.base_colors[1].buffer)
 
-  WGPU_RELEASE_RESOURCE(Texture, textures.post_fx0.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, textures.post_fx0.view)
-  WGPU_RELEASE_RESOURCE(Texture, textures.post_fx1.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, textures.post_fx1.view)
-  WGPU_RELEASE_RESOURCE(Sampler, textures.post_fx_sampler)
-  wgpu_destroy_texture(&textures.cutoff_mask);
-
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_framebuffer.color.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_framebuffer.color.texture_view)
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_framebuffer.depth_stencil.texture)
-  WGPU_RELEASE_RESOURCE(TextureView,
-                        offscreen_framebuffer.depth_stencil.texture_view)
+  release_textures();
+  release_offscreen_framebuffer();
 
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.persp_camera)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.ortho_camera)
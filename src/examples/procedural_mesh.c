@@ -3,6 +3,7 @@
 
 #include <string.h>
 
+#include "../core/job_system.h"
 #include "../webgpu/imgui_overlay.h"
 
 #define PAR_SHAPES_IMPLEMENTATION
@@ -13,19 +14,21 @@
  *
  * This WebGPU sample shows how to efficiently draw several procedurally
  * generated meshes:
- *  - All vertices and indices are stored in one large vertex/index buffer
- *  - Two bind groups are used - frame bind group and draw bind group
+ *  - The meshes are generated in parallel on the job system
+ *  - All vertices and indices are stored in one large vertex/index buffer,
+ *    with the draw range of every mesh
+ *  - The transforms and colors of all drawables are stored in one storage
+ *    buffer indexed with the instance index, the drawables of a mesh are its
+ *    instances
  *  - Simple physically-based shading is used
  *  - Single-pass wireframe rendering
- *  - Main drawing loop is optimized and changes just one dynamic offset before
- *    each draw call
+ *  - Main drawing loop binds everything once and issues one instanced draw
+ *    call per mesh
  *
  * Ref:
  * https://github.com/michal-z/zig-gamedev/tree/main/samples/procedural_mesh_wgpu
  * -------------------------------------------------------------------------- */
 
-#define ALIGNMENT 256u // 256-byte alignment
-
 /* -------------------------------------------------------------------------- *
  * WGSl Shaders
  * -------------------------------------------------------------------------- */
@@ -43,13 +46,14 @@ static const char* vertex_shader_wgsl = CODE(
     object_to_world: mat4x4<f32>,
     basecolor_roughness: vec4<f32>,
   }
-  @group(1) @binding(0) var<uniform> draw_uniforms: DrawUniforms;
+  @group(1) @binding(0) var<storage, read> draw_uniforms: array<DrawUniforms>;
 
   struct VertexOut {
     @builtin(position) position_clip: vec4<f32>,
     @location(0) position: vec3<f32>,
     @location(1) normal: vec3<f32>,
     @location(2) barycentrics: vec3<f32>,
+    @location(3) @interpolate(flat) basecolor_roughness: vec4<f32>,
   }
 
   @vertex
@@ -57,18 +61,21 @@ static const char* vertex_shader_wgsl = CODE(
     @location(0) position: vec3<f32>,
     @location(1) normal: vec3<f32>,
     @builtin(vertex_index) vertex_index: u32,
+    @builtin(instance_index) instance_index: u32,
   ) -> VertexOut {
+    let draw = draw_uniforms[instance_index];
     var output: VertexOut;
-    output.position_clip = vec4<f32>(position, 1.0);
-    // output.position_clip = vec4(position, 1.0) * draw_uniforms.object_to_world * frame_uniforms.world_to_clip;
-    output.position = (vec4(position, 1.0) * draw_uniforms.object_to_world).xyz;
+    output.position_clip = vec4(position, 1.0) * draw.object_to_world
+                           * frame_uniforms.world_to_clip;
+    output.position = (vec4(position, 1.0) * draw.object_to_world).xyz;
     output.normal = normal * mat3x3(
-      draw_uniforms.object_to_world[0].xyz,
-      draw_uniforms.object_to_world[1].xyz,
-      draw_uniforms.object_to_world[2].xyz,
+      draw.object_to_world[0].xyz,
+      draw.object_to_world[1].xyz,
+      draw.object_to_world[2].xyz,
     );
     let index = vertex_index % 3u;
     output.barycentrics = vec3(f32(index == 0u), f32(index == 1u), f32(index == 2u));
+    output.basecolor_roughness = draw.basecolor_roughness;
     return output;
   }
   );
@@ -80,12 +87,6 @@ static const char* fragment_shader_wgsl = CODE(
   }
   @group(0) @binding(0) var<uniform> frame_uniforms: FrameUniforms;
 
-  struct DrawUniforms {
-    object_to_world: mat4x4<f32>,
-    basecolor_roughness: vec4<f32>,
-  }
-  @group(1) @binding(0) var<uniform> draw_uniforms: DrawUniforms;
-
   let pi = 3.1415926;
 
   fn saturate(x: f32) -> f32 { return clamp(x, 0.0, 1.0); }
@@ -117,13 +118,14 @@ static const char* fragment_shader_wgsl = CODE(
     @location(0) position: vec3<f32>,
     @location(1) normal: vec3<f32>,
     @location(2) barycentrics: vec3<f32>,
+    @location(3) @interpolate(flat) basecolor_roughness: vec4<f32>,
   ) -> @location(0) vec4<f32> {
     let v = normalize(frame_uniforms.camera_position - position);
     let n = normalize(normal);
 
-    let base_color = draw_uniforms.basecolor_roughness.xyz;
+    let base_color = basecolor_roughness.xyz;
     let ao = 1.0;
-    var roughness = draw_uniforms.basecolor_roughness.a;
+    var roughness = basecolor_roughness.a;
     var metallic: f32;
     if (roughness < 0.0) { metallic = 1.0; } else { metallic = 0.0; }
     roughness = abs(roughness);
@@ -333,6 +335,46 @@ static shape_t init_trefoil_knot(int32_t slices, int32_t stacks, float radius)
   return init_shape(par_shapes_create_trefoil_knot(slices, stacks, radius));
 }
 
+static shape_t init_parametric_sphere(int32_t slices, int32_t stacks)
+{
+  return init_shape(par_shapes_create_parametric_sphere(slices, stacks));
+}
+
+static shape_t init_subdivided_sphere(int32_t nsubdivisions)
+{
+  return init_shape(par_shapes_create_subdivided_sphere(nsubdivisions));
+}
+
+static shape_t init_icosahedron(void)
+{
+  return init_shape(par_shapes_create_icosahedron());
+}
+
+static shape_t init_dodecahedron(void)
+{
+  return init_shape(par_shapes_create_dodecahedron());
+}
+
+static shape_t init_cylinder(int32_t slices, int32_t stacks)
+{
+  return init_shape(par_shapes_create_cylinder(slices, stacks));
+}
+
+static shape_t init_cone(int32_t slices, int32_t stacks)
+{
+  return init_shape(par_shapes_create_cone(slices, stacks));
+}
+
+static shape_t init_torus(int32_t slices, int32_t stacks, float radius)
+{
+  return init_shape(par_shapes_create_torus(slices, stacks, radius));
+}
+
+static shape_t init_rock(int32_t seed, int32_t nsubdivisions)
+{
+  return init_shape(par_shapes_create_rock(seed, nsubdivisions));
+}
+
 /* -------------------------------------------------------------------------- *
  * Procedural Mesh Example
  * -------------------------------------------------------------------------- */
@@ -357,6 +399,9 @@ typedef struct {
   int32_t vertex_offset;
   uint32_t num_indices;
   uint32_t num_vertices;
+  // Drawables of the mesh, drawn as instances
+  uint32_t first_instance;
+  uint32_t num_instances;
 } mesh_t;
 
 typedef struct {
@@ -365,6 +410,38 @@ typedef struct {
   vec4 basecolor_roughness;
 } drawable_t;
 
+// Meshes of the scene
+enum {
+  MESH_TREFOIL_KNOT,
+  MESH_PARAMETRIC_SPHERE,
+  MESH_ICOSAHEDRON,
+  MESH_DODECAHEDRON,
+  MESH_CYLINDER,
+  MESH_CONE,
+  MESH_TORUS,
+  MESH_SUBDIVIDED_SPHERE,
+  MESH_ROCK,
+  MESH_COUNT,
+};
+
+// Drawables of the scene, grouped by mesh. A negative roughness selects a
+// metallic surface.
+static const drawable_t scene_drawables[] = {
+  {MESH_TREFOIL_KNOT, {0.0f, 1.0f, 0.0f}, {0.0f, 0.7f, 0.0f, 0.6f}},
+  {MESH_PARAMETRIC_SPHERE, {3.0f, 1.0f, 0.0f}, {0.7f, 0.0f, 0.0f, 0.2f}},
+  {MESH_PARAMETRIC_SPHERE, {-3.0f, 1.0f, 0.0f}, {0.7f, 0.7f, 0.0f, -0.3f}},
+  {MESH_ICOSAHEDRON, {-3.0f, 1.0f, 3.0f}, {0.7f, 0.6f, 0.1f, -0.4f}},
+  {MESH_DODECAHEDRON, {0.0f, 1.0f, 3.0f}, {0.0f, 0.1f, 1.0f, 0.2f}},
+  {MESH_CYLINDER, {3.0f, 0.0f, 3.0f}, {1.0f, 0.0f, 0.0f, 0.3f}},
+  {MESH_CONE, {-3.0f, 0.0f, -3.0f}, {0.7f, 0.3f, 0.0f, 0.5f}},
+  {MESH_TORUS, {0.0f, 1.0f, -3.0f}, {0.0f, 0.7f, 0.7f, -0.5f}},
+  {MESH_SUBDIVIDED_SPHERE, {3.0f, 1.0f, -3.0f}, {0.2f, 0.2f, 1.0f, 0.1f}},
+  {MESH_ROCK, {-6.0f, 0.0f, 0.0f}, {0.7f, 0.7f, 0.7f, 0.5f}},
+  {MESH_ROCK, {6.0f, 0.0f, 0.0f}, {0.7f, 0.7f, 0.7f, 0.5f}},
+  {MESH_ROCK, {-6.0f, 0.0f, 3.0f}, {0.7f, 0.7f, 0.7f, 0.5f}},
+  {MESH_ROCK, {6.0f, 0.0f, 3.0f}, {0.7f, 0.7f, 0.7f, 0.5f}},
+};
+
 static struct {
   WGPUBindGroupLayout frame_bind_group_layout;
   WGPUBindGroupLayout draw_bind_group_layout;
@@ -381,7 +458,7 @@ static struct {
   wgpu_buffer_t index_buffer;
   struct {
     wgpu_buffer_t frame;
-    wgpu_buffer_t draw;
+    wgpu_buffer_t draw; // Storage buffer of the draw uniforms of all drawables
   } uniform_buffers;
 
   WGPUTexture depth_texture;
@@ -394,8 +471,7 @@ static struct {
     WGPURenderPassDescriptor descriptor;
   } render_pass;
 
-  drawable_t drawables[1];
-  mesh_t meshes[1];
+  mesh_t meshes[MESH_COUNT];
 
   struct {
     vec3 position;
@@ -409,7 +485,6 @@ static struct {
   } camera;
 
   frame_uniforms_t frame_uniforms;
-  draw_uniforms_t draw_uniforms;
 
   struct {
     float xpos;
@@ -420,8 +495,8 @@ static struct {
   const char* example_title;
   bool prepared;
 } demo_state = {
-  .camera.position          = {0.0f, 4.0f, -4.0f},
-  .camera.forward           = {0.0f, 0.0f, 1.0f},
+  .camera.position          = {0.0f, 6.0f, -12.0f},
+  .camera.forward           = {0.0f, -0.4f, 1.0f},
   .camera.updir             = {0.0f, 1.0f, 0.0f},
   .camera.pitch             = 0.15f * PI,
   .camera.yaw               = 0.0f,
@@ -490,31 +565,89 @@ static void append_mesh(uint32_t mesh_index, shape_t* mesh, mesh_t* meshes,
          mesh->normals.data, mesh->normals.len * sizeof(*mesh->normals.data));
 }
 
-static void init_scene(drawable_t* drawables, mesh_t* meshes,
-                       uint16_t** meshes_indices, uint32_t* meshes_indices_len,
-                       vec3** meshes_positions, uint32_t* meshes_positions_len,
-                       vec3** meshes_normals, uint32_t* meshes_normals_len)
+// Unwelded meshes with their normals, the vertex index selects the
+// barycentrics of the wireframe
+static shape_t init_scene_mesh(uint32_t mesh_index)
 {
-  uint32_t mesh_index = 0;
+  shape_t mesh = {0};
+  switch (mesh_index) {
+    case MESH_TREFOIL_KNOT:
+      mesh = init_trefoil_knot(10, 128, 0.8f);
+      shape_rotate(&mesh, PI_2, 1.0f, 0.0f, 0.0f);
+      break;
+    case MESH_PARAMETRIC_SPHERE:
+      mesh = init_parametric_sphere(64, 64);
+      break;
+    case MESH_ICOSAHEDRON:
+      mesh = init_icosahedron();
+      break;
+    case MESH_DODECAHEDRON:
+      mesh = init_dodecahedron();
+      break;
+    case MESH_CYLINDER:
+      mesh = init_cylinder(32, 8);
+      shape_rotate(&mesh, -PI_2, 1.0f, 0.0f, 0.0f);
+      break;
+    case MESH_CONE:
+      mesh = init_cone(32, 8);
+      shape_rotate(&mesh, -PI_2, 1.0f, 0.0f, 0.0f);
+      break;
+    case MESH_TORUS:
+      mesh = init_torus(16, 64, 0.2f);
+      shape_rotate(&mesh, -PI_2, 1.0f, 0.0f, 0.0f);
+      break;
+    case MESH_SUBDIVIDED_SPHERE:
+      mesh = init_subdivided_sphere(5);
+      break;
+    case MESH_ROCK:
+      mesh = init_rock(123, 4);
+      break;
+    default:
+      ASSERT(false);
+      break;
+  }
+  shape_unweld(&mesh);
+  shape_compute_normals(&mesh);
+  // 16-bit indices relative to the base vertex of the mesh
+  ASSERT(mesh.positions.len <= 65536);
+  return mesh;
+}
 
-  // Trefoil knot
-  {
-    shape_t mesh = init_trefoil_knot(10, 128, 0.8f);
-    shape_rotate(&mesh, PI_2, 1.0, 0.0, 0.0);
-    shape_unweld(&mesh);
-    shape_compute_normals(&mesh);
-
-    drawables[mesh_index] = (drawable_t){
-      .mesh_index          = mesh_index,
-      .position            = {0.f, 1.f, 0.f},
-      .basecolor_roughness = {0.0f, 0.7f, 0.0f, 0.6f},
-    };
+static void generate_scene_meshes(void* user_data, uint32_t begin,
+                                  uint32_t end)
+{
+  shape_t* shapes = (shape_t*)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    shapes[i] = init_scene_mesh(i);
+  }
+}
 
-    append_mesh(mesh_index, &mesh, meshes, meshes_indices, meshes_indices_len,
-                meshes_positions, meshes_positions_len, meshes_normals,
-                meshes_normals_len);
+static void init_scene(mesh_t* meshes, uint16_t** meshes_indices,
+                       uint32_t* meshes_indices_len, vec3** meshes_positions,
+                       uint32_t* meshes_positions_len, vec3** meshes_normals,
+                       uint32_t* meshes_normals_len)
+{
+  // Generate the meshes on the shared job system, the high subdivision ones
+  // take the longest
+  shape_t shapes[MESH_COUNT] = {0};
+  job_system_parallel_for(job_system_get_shared(), MESH_COUNT, 1,
+                          generate_scene_meshes, shapes);
+
+  for (uint32_t mesh_index = 0; mesh_index < MESH_COUNT; ++mesh_index) {
+    append_mesh(mesh_index, &shapes[mesh_index], meshes, meshes_indices,
+                meshes_indices_len, meshes_positions, meshes_positions_len,
+                meshes_normals, meshes_normals_len);
+    shape_deinit(&shapes[mesh_index]);
+  }
 
-    shape_deinit(&mesh);
+  // The drawables of a mesh are its instances
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(scene_drawables); ++i) {
+    mesh_t* mesh = &meshes[scene_drawables[i].mesh_index];
+    if (mesh->num_instances == 0) {
+      mesh->first_instance = i;
+    }
+    ASSERT(mesh->first_instance + mesh->num_instances == i);
+    ++mesh->num_instances;
   }
 }
 
@@ -526,9 +659,9 @@ static void prepare_vertex_and_index_buffer(wgpu_context_t* wgpu_context)
   uint32_t meshes_positions_len = 0;
   vec3* meshes_normals          = NULL;
   uint32_t meshes_normals_len   = 0;
-  init_scene(demo_state.drawables, demo_state.meshes, &meshes_indices,
-             &meshes_indices_len, &meshes_positions, &meshes_positions_len,
-             &meshes_normals, &meshes_normals_len);
+  init_scene(demo_state.meshes, &meshes_indices, &meshes_indices_len,
+             &meshes_positions, &meshes_positions_len, &meshes_normals,
+             &meshes_normals_len);
 
   demo_state.total_num_vertices = meshes_positions_len;
   demo_state.total_num_indices  = meshes_indices_len;
@@ -599,10 +732,9 @@ static void setup_bind_group_layouts(wgpu_context_t* wgpu_context)
     WGPUBindGroupLayoutEntry bgl_entries[1] = {
       [0] = (WGPUBindGroupLayoutEntry) {
         .binding = 0,
-        .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
+        .visibility = WGPUShaderStage_Vertex,
         .buffer = (WGPUBufferBindingLayout) {
-          .type = WGPUBufferBindingType_Uniform,
-          .hasDynamicOffset = false,
+          .type = WGPUBufferBindingType_ReadOnlyStorage,
           .minBindingSize = sizeof(draw_uniforms_t),
         },
         .sampler = {0},
@@ -726,9 +858,9 @@ static void update_camera(wgpu_context_t* wgpu_context)
                      (float)wgpu_context->surface.width
                        / (float)wgpu_context->surface.height,
                      0.01f, 200.0f, &demo_state.camera.cam_view_to_clip);
-  glm_mat4_mulN((mat4*[]){&demo_state.camera.cam_world_to_view,
-                          &demo_state.camera.cam_view_to_clip},
-                2, demo_state.camera.cam_world_to_clip);
+  glm_mat4_mul(demo_state.camera.cam_view_to_clip,
+               demo_state.camera.cam_world_to_view,
+               demo_state.camera.cam_world_to_clip);
 }
 
 static void update_frame_uniform_buffers(wgpu_context_t* wgpu_context)
@@ -750,24 +882,24 @@ static void update_frame_uniform_buffers(wgpu_context_t* wgpu_context)
 
 static void update_draw_uniform_buffers(wgpu_context_t* wgpu_context)
 {
-  // Update "object to world" xform
-  vec3* drawable_pos   = &demo_state.drawables[0].position;
-  mat4 object_to_world = {
-    {1.0f, 0.0f, 0.0f, 0.0f},                                           //
-    {0.0f, 1.0f, 0.0f, 0.0f},                                           //
-    {0.0f, 0.0f, 1.0f, 0.0f},                                           //
-    {(*drawable_pos)[0], (*drawable_pos)[1], (*drawable_pos)[2], 1.0f}, //
-  };
-  glm_mat4_transpose(object_to_world);
-
-  glm_mat4_copy(object_to_world, demo_state.draw_uniforms.object_to_world);
-  glm_vec4_copy(demo_state.drawables[0].basecolor_roughness,
-                demo_state.draw_uniforms.basecolor_roughness);
+  draw_uniforms_t draw_uniforms[ARRAY_SIZE(scene_drawables)];
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(scene_drawables); ++i) {
+    // Update "object to world" xform
+    const float* drawable_pos = scene_drawables[i].position;
+    mat4 object_to_world      = {
+      {1.0f, 0.0f, 0.0f, 0.0f},                                  //
+      {0.0f, 1.0f, 0.0f, 0.0f},                                  //
+      {0.0f, 0.0f, 1.0f, 0.0f},                                  //
+      {drawable_pos[0], drawable_pos[1], drawable_pos[2], 1.0f}, //
+    };
+    glm_mat4_transpose_to(object_to_world, draw_uniforms[i].object_to_world);
+    memcpy(draw_uniforms[i].basecolor_roughness,
+           scene_drawables[i].basecolor_roughness, sizeof(vec4));
+  }
 
   // Map uniform buffer and update it
   wgpu_queue_write_buffer(wgpu_context, demo_state.uniform_buffers.draw.buffer,
-                          0, &demo_state.draw_uniforms.object_to_world,
-                          demo_state.uniform_buffers.draw.size);
+                          0, draw_uniforms, sizeof(draw_uniforms));
 }
 
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
@@ -780,12 +912,12 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
       .size  = sizeof(frame_uniforms_t),
     });
 
-  // Create a draw uniform buffer
+  // Create the draw uniforms buffer, indexed with the instance index
   demo_state.uniform_buffers.draw = wgpu_create_buffer(
     context->wgpu_context,
     &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-      .size  = sizeof(draw_uniforms_t),
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = ARRAY_SIZE(scene_drawables) * sizeof(draw_uniforms_t),
     });
 
   update_frame_uniform_buffers(context->wgpu_context);
@@ -960,19 +1092,18 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
                                    demo_state.pipeline);
 
-  // Set the bind group
+  // Set the bind groups
   wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
                                     demo_state.frame_bind_group, 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 1,
+                                    demo_state.draw_bind_group, 0, 0);
 
-  // Draw indexed geometries
-  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(demo_state.drawables); ++i) {
-    uint32_t dynamic_offset = i * ALIGNMENT;
-    wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 1,
-                                      demo_state.draw_bind_group, 0,
-                                      &dynamic_offset);
+  // Draw indexed geometries, the drawables of a mesh as its instances
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(demo_state.meshes); ++i) {
+    const mesh_t* mesh = &demo_state.meshes[i];
     wgpuRenderPassEncoderDrawIndexed(
-      wgpu_context->rpass_enc, demo_state.meshes[i].num_indices, 1,
-      demo_state.meshes[i].index_offset, demo_state.meshes[i].vertex_offset, 0);
+      wgpu_context->rpass_enc, mesh->num_indices, mesh->num_instances,
+      mesh->index_offset, mesh->vertex_offset, mesh->first_instance);
   }
 
   // End render pass
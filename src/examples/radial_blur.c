@@ -13,13 +13,17 @@
  * into an offscreen framebuffer at lower resolution and rendered as a
  * fullscreen quad atop the scene using a radial blur fragment shader.
  *
+ * The offscreen framebuffer is the effect texture of an effect pass at half
+ * the resolution of the surface, the radial blur does its own upsampling as the
+ * glow has to bleed over the edges of the scene.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/radialblur
  * http://halisavakis.com/my-take-on-shaders-radial-blur/
  * -------------------------------------------------------------------------- */
 
 // Offscreen frame buffer properties
-#define FB_DIM 512u
+#define FB_SCALE WGPU_EFFECT_PASS_SCALE_HALF
 #define FB_COLOR_FORMAT WGPUTextureFormat_RGBA8Unorm
 #define FB_DEPTH_STENCIL_FORMAT WGPUTextureFormat_Depth24PlusStencil8
 
@@ -79,11 +83,13 @@ static struct {
 
 static struct {
   uint32_t width, height;
-  // Framebuffer for offscreen rendering
+  // Framebuffer for offscreen rendering, the color attachment is the effect
+  // texture
+  wgpu_effect_pass_t* effect_pass;
   struct {
     WGPUTexture texture;
     WGPUTextureView texture_view;
-  } color, depth_stencil;
+  } depth_stencil;
   WGPUSampler sampler;
   struct {
     WGPURenderPassColorAttachment color_attachment[1];
@@ -116,7 +122,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors;
+      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   scene = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/glowsphere.gltf",
@@ -131,8 +138,17 @@ static void load_assets(wgpu_context_t* wgpu_context)
 // the fragment shader of the final pass
 static void prepare_offscreen(wgpu_context_t* wgpu_context)
 {
-  offscreen_pass.width  = FB_DIM;
-  offscreen_pass.height = FB_DIM;
+  offscreen_pass.effect_pass = wgpu_effect_pass_create(
+    wgpu_context, &(wgpu_effect_pass_desc_t){
+                    .width  = wgpu_context->surface.width,
+                    .height = wgpu_context->surface.height,
+                    .scale  = FB_SCALE,
+                    .format = FB_COLOR_FORMAT,
+                  });
+  offscreen_pass.width
+    = wgpu_effect_pass_get_width(offscreen_pass.effect_pass);
+  offscreen_pass.height
+    = wgpu_effect_pass_get_height(offscreen_pass.effect_pass);
 
   // Create the texture
   WGPUExtent3D texture_extent = {
@@ -141,35 +157,6 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
     .depthOrArrayLayers = 1,
   };
 
-  // Color attachment
-  {
-    WGPUTextureDescriptor texture_desc = {
-      .size          = texture_extent,
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = FB_COLOR_FORMAT,
-      .usage
-      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
-    };
-    offscreen_pass.color.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-    ASSERT(offscreen_pass.color.texture != NULL);
-
-    // Create the texture view
-    WGPUTextureViewDescriptor texture_view_desc = {
-      .dimension       = WGPUTextureViewDimension_2D,
-      .format          = texture_desc.format,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = 1,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = 1,
-    };
-    offscreen_pass.color.texture_view
-      = wgpuTextureCreateView(offscreen_pass.color.texture, &texture_view_desc);
-    ASSERT(offscreen_pass.color.texture_view != NULL);
-  }
-
   // Create sampler to sample from the attachment in the fragment shader
   offscreen_pass.sampler = wgpuDeviceCreateSampler(
     wgpu_context->device, &(WGPUSamplerDescriptor){
@@ -219,7 +206,7 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
   // Color attachment
   offscreen_pass.render_pass.color_attachment[0]
     = (WGPURenderPassColorAttachment) {
-      .view       = offscreen_pass.color.texture_view,
+      .view       = wgpu_effect_pass_get_color_view(offscreen_pass.effect_pass),
       .loadOp     = WGPULoadOp_Clear,
       .storeOp    = WGPUStoreOp_Store,
       .clearColor = (WGPUColor) {
@@ -414,7 +401,8 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
       [1] = (WGPUBindGroupEntry) {
        // Binding 1: Fragment shader image sampler
         .binding     = 1,
-        .textureView = offscreen_pass.color.texture_view,
+        .textureView
+        = wgpu_effect_pass_get_color_view(offscreen_pass.effect_pass),
       },
       [2] = (WGPUBindGroupEntry) {
         // Binding 2: Fragment shader image sampler
@@ -926,10 +914,9 @@ static void example_destroy(wgpu_example_context_t* context)
   wgpu_destroy_texture(&textures.gradient);
   wgpu_gltf_model_destroy(scene);
 
-  WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.color.texture)
+  wgpu_effect_pass_release(offscreen_pass.effect_pass);
   WGPU_RELEASE_RESOURCE(Texture, offscreen_pass.depth_stencil.texture)
 
-  WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.color.texture_view)
   WGPU_RELEASE_RESOURCE(TextureView, offscreen_pass.depth_stencil.texture_view)
 
   WGPU_RELEASE_RESOURCE(Sampler, offscreen_pass.sampler)
@@ -5,9 +5,7 @@
 
 #include "../webgpu/gltf_model.h"
 #include "../webgpu/imgui_overlay.h"
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
+#include "../webgpu/readback.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Saving Framebuffer To Screenshot
@@ -20,13 +18,15 @@
  * sufficient for "taking a screenshot," with the added benefit that this method
  * would not require a window to be created.
  *
+ * The copies go into a ring of readback buffers which are mapped a few frames
+ * later and encoded on a worker thread, so that every frame can be captured
+ * without stalling the rendering.
+ *
  * Ref:
  * https://github.com/gfx-rs/wgpu/tree/master/wgpu/examples/capture
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/screenshot
  * -------------------------------------------------------------------------- */
 
-#define COPY_BYTES_PER_ROW_ALIGNMENT 256
-
 static struct gltf_model_t* dragon;
 static wgpu_buffer_t uniform_buffer;
 
@@ -40,9 +40,8 @@ static WGPUPipelineLayout pipeline_layout;
 static WGPUBindGroupLayout bind_group_layout;
 static WGPUBindGroup bind_group;
 
-static const char* screenshot_filename = "Screenshot.png";
-static bool screenshot_requested       = false;
-static bool screenshot_saved           = false;
+static bool screenshot_requested = false;
+static bool capture_frames       = false;
 
 static struct scene_rendering_t {
   WGPURenderPipeline pipeline;
@@ -65,17 +64,8 @@ static struct offscreen_rendering_t {
     WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
     WGPURenderPassDescriptor render_pass_descriptor;
   } render_pass;
-  // The pixel buffer lets us retrieve the framebuffer data as an array
-  struct {
-    wgpu_buffer_t buffer;
-    bool buffer_mapped;
-    struct {
-      uint64_t width;
-      uint64_t height;
-      uint64_t unpadded_bytes_per_row;
-      uint64_t padded_bytes_per_row;
-    } buffer_dimensions;
-  } pixel_data;
+  // The readback ring lets us retrieve the framebuffer data as an array
+  wgpu_readback_t* readback;
 } offscreen_rendering = {0};
 
 static const char* example_title = "Saving Framebuffer To Screenshot";
@@ -95,7 +85,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors;
+      | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   dragon = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/chinesedragon.gltf",
@@ -104,46 +95,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   ASSERT(dragon != NULL);
 }
 
-// It is a WebGPU requirement that ImageCopyBuffer.layout.bytes_per_row %
-// wgpu::COPY_BYTES_PER_ROW_ALIGNMENT == 0 So we calculate padded_bytes_per_row
-// by rounding unpadded_bytes_per_row up to the next multiple of
-// wgpu::COPY_BYTES_PER_ROW_ALIGNMENT.
-// https://en.wikipedia.org/wiki/Data_structure_alignment#Computing_padding
-static void calculate_buffer_dimensions(uint32_t width, uint32_t height)
-{
-  uint32_t bytes_per_pixel        = sizeof(uint8_t) * 4;
-  uint32_t unpadded_bytes_per_row = width * bytes_per_pixel;
-  uint32_t align                  = (uint32_t)COPY_BYTES_PER_ROW_ALIGNMENT;
-  uint32_t padded_bytes_per_row_padding
-    = (align - unpadded_bytes_per_row % align) % align;
-  uint32_t padded_bytes_per_row
-    = unpadded_bytes_per_row + padded_bytes_per_row_padding;
-  {
-    offscreen_rendering.pixel_data.buffer_dimensions.width  = width;
-    offscreen_rendering.pixel_data.buffer_dimensions.height = height;
-    offscreen_rendering.pixel_data.buffer_dimensions.unpadded_bytes_per_row
-      = unpadded_bytes_per_row;
-    offscreen_rendering.pixel_data.buffer_dimensions.padded_bytes_per_row
-      = padded_bytes_per_row;
-  }
-}
-
 static void prepare_offscreen(wgpu_context_t* wgpu_context)
 {
-  // Prepare pixel output buffer
-  calculate_buffer_dimensions(wgpu_context->surface.width,
-                              wgpu_context->surface.height);
-  // The output buffer lets us retrieve the data as an array
-  offscreen_rendering.pixel_data.buffer = wgpu_create_buffer(
-    wgpu_context,
-    &(wgpu_buffer_desc_t){
-      .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
-      .size
-      = (uint64_t)(offscreen_rendering.pixel_data.buffer_dimensions
-                     .padded_bytes_per_row
-                   * offscreen_rendering.pixel_data.buffer_dimensions.height),
-    });
-
   // Attachment formats
   offscreen_rendering.color.format = WGPUTextureFormat_RGBA8UnormSrgb;
   offscreen_rendering.depth_stencil.format
@@ -151,8 +104,8 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
 
   // Create the texture
   WGPUExtent3D texture_extent = {
-    .width  = offscreen_rendering.pixel_data.buffer_dimensions.width,
-    .height = offscreen_rendering.pixel_data.buffer_dimensions.height,
+    .width              = wgpu_context->surface.width,
+    .height             = wgpu_context->surface.height,
     .depthOrArrayLayers = 1,
   };
 
@@ -213,6 +166,18 @@ static void prepare_offscreen(wgpu_context_t* wgpu_context)
     ASSERT(offscreen_rendering.depth_stencil.texture_view != NULL);
   }
 
+  // Readback ring, each buffer is mapped two frames after its copy
+  offscreen_rendering.readback = wgpu_readback_create(
+    wgpu_context, &(wgpu_readback_desc_t){
+                    .width        = wgpu_context->surface.width,
+                    .height       = wgpu_context->surface.height,
+                    .format       = offscreen_rendering.color.format,
+                    .buffer_count = 4,
+                    .map_delay    = 2,
+                    .file_format  = ReadbackFileFormat_Png,
+                    .file_prefix  = "screenshot",
+                  });
+
   // Create a separate render pass for the offscreen rendering as it may differ
   // from the one used for scene rendering
   // Color attachment
@@ -478,8 +443,17 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
     if (imgui_overlay_button(context->imgui_overlay, "Take screenshot")) {
       screenshot_requested = true;
     }
-    if (screenshot_saved) {
-      imgui_overlay_text("Screenshot saved as: %s", screenshot_filename);
+    imgui_overlay_checkBox(context->imgui_overlay, "Capture every frame",
+                           &capture_frames);
+    const char* filename
+      = wgpu_readback_get_last_filename(offscreen_rendering.readback);
+    if (filename[0] != '\0') {
+      imgui_overlay_text("Screenshot saved as: %s", filename);
+    }
+    const uint32_t dropped_count
+      = wgpu_readback_get_dropped_count(offscreen_rendering.readback);
+    if (dropped_count > 0) {
+      imgui_overlay_text("Dropped frames: %u", dropped_count);
     }
   }
 }
@@ -521,32 +495,21 @@ build_command_buffer(wgpu_context_t* wgpu_context,
 }
 
 static WGPUCommandBuffer
-build_copy_texture_to_buffer_command_buffer(wgpu_context_t* wgpu_context)
+build_copy_texture_to_buffer_command_buffer(wgpu_example_context_t* context)
 {
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  wgpuCommandEncoderCopyTextureToBuffer(wgpu_context->cmd_enc,
-    // Source
-    &(WGPUImageCopyTexture){
-      .texture  = offscreen_rendering.color.texture,
-      .mipLevel =0,
-    },
-    // Destination
-    &(WGPUImageCopyBuffer){
-      .buffer  = offscreen_rendering.pixel_data.buffer.buffer,
-      .layout = (WGPUTextureDataLayout) {
-        .offset      = 0,
-        .bytesPerRow = offscreen_rendering.pixel_data.buffer_dimensions.padded_bytes_per_row,
-        .rowsPerImage = offscreen_rendering.pixel_data.buffer_dimensions.height,
-      },
-    },
-    // CopySize
-    &(WGPUExtent3D) {
-      .width  = offscreen_rendering.pixel_data.buffer_dimensions.width,
-      .height = offscreen_rendering.pixel_data.buffer_dimensions.height,
-      .depthOrArrayLayers = 1,
-    });
+  // Copy into the next readback buffer, the request stays pending while all
+  // buffers are in use
+  if (wgpu_readback_copy_texture(offscreen_rendering.readback,
+                                 wgpu_context->cmd_enc,
+                                 offscreen_rendering.color.texture,
+                                 context->frame.index)) {
+    screenshot_requested = false;
+  }
 
   // Get command buffer
   WGPUCommandBuffer command_buffer
@@ -556,33 +519,6 @@ build_copy_texture_to_buffer_command_buffer(wgpu_context_t* wgpu_context)
   return command_buffer;
 }
 
-static void read_buffer_map_cb(WGPUBufferMapAsyncStatus status, void* user_data)
-{
-  UNUSED_VAR(user_data);
-
-  if (status == WGPUBufferMapAsyncStatus_Success) {
-    int w            = offscreen_rendering.pixel_data.buffer_dimensions.width;
-    int h            = offscreen_rendering.pixel_data.buffer_dimensions.height;
-    int channels_num = 4;
-
-    size_t pixels_size     = w * h * channels_num;
-    uint8_t* pixels        = (uint8_t*)malloc(pixels_size);
-    uint8_t const* mapping = (uint8_t*)wgpuBufferGetConstMappedRange(
-      offscreen_rendering.pixel_data.buffer.buffer, 0,
-      sizeof(offscreen_rendering.pixel_data.buffer.size));
-    ASSERT(mapping);
-    memcpy(pixels, mapping, pixels_size);
-    stbi_write_png(screenshot_filename, w, h, channels_num, pixels,
-                   w * sizeof(int));
-    wgpuBufferUnmap(offscreen_rendering.pixel_data.buffer.buffer);
-    free(pixels);
-
-    offscreen_rendering.pixel_data.buffer_mapped = false;
-    screenshot_requested                         = false;
-    screenshot_saved                             = true;
-  }
-}
-
 static int example_draw(wgpu_example_context_t* context)
 {
   wgpu_context_t* wgpu_context = context->wgpu_context;
@@ -597,8 +533,7 @@ static int example_draw(wgpu_example_context_t* context)
     = offscreen_rendering.color.texture_view;
 
   // Command buffer to be submitted to the queue
-  bool buffer_mapped   = offscreen_rendering.pixel_data.buffer_mapped;
-  bool save_screenshot = !buffer_mapped && screenshot_requested;
+  bool save_screenshot = screenshot_requested || capture_frames;
   wgpu_context->submit_info.command_buffer_count = save_screenshot ? 3 : 1;
   wgpu_context->submit_info.command_buffers[0]   = build_command_buffer(
       wgpu_context, &scene_rendering.render_pass.render_pass_descriptor,
@@ -608,7 +543,7 @@ static int example_draw(wgpu_example_context_t* context)
       wgpu_context, &offscreen_rendering.render_pass.render_pass_descriptor,
       offscreen_rendering.pipeline, false);
     wgpu_context->submit_info.command_buffers[2]
-      = build_copy_texture_to_buffer_command_buffer(wgpu_context);
+      = build_copy_texture_to_buffer_command_buffer(context);
   }
 
   // Submit to queue
@@ -617,13 +552,8 @@ static int example_draw(wgpu_example_context_t* context)
   // Submit frame
   submit_frame(context);
 
-  // Read query results for displaying in next frame
-  if (save_screenshot) {
-    offscreen_rendering.pixel_data.buffer_mapped = true;
-    wgpuBufferMapAsync(
-      offscreen_rendering.pixel_data.buffer.buffer, WGPUMapMode_Read, 0,
-      offscreen_rendering.pixel_data.buffer.size, read_buffer_map_cb, NULL);
-  }
+  // Map the readback buffers of earlier frames
+  wgpu_readback_update(offscreen_rendering.readback);
 
   return 0;
 }
@@ -655,7 +585,7 @@ static void example_destroy(wgpu_example_context_t* context)
                         offscreen_rendering.depth_stencil.texture_view)
 
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, offscreen_rendering.pixel_data.buffer.buffer)
+  wgpu_readback_release(offscreen_rendering.readback);
 
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
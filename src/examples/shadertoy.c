@@ -3,17 +3,193 @@
 
 #include <string.h>
 
+#include "../webgpu/frame_graph.h"
+#include "../webgpu/imgui_overlay.h"
+
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Shadertoy
  *
  * Minimal "shadertoy launcher" using WebGPU, demonstrating how to load an
  * example Shadertoy shader 'Cube lines'.
  *
+ * Multi-pass programs are supported as well: the Buffer A-D passes render
+ * into ping-pong float targets of the frame graph, at a resolution relative to
+ * the surface, which the later passes and the next frame sample through the
+ * iChannel0-3 bindings. The passes are only rendered again when the playback
+ * advances or the inputs change, while paused no frame is rendered at all.
+ *
  * Ref:
  * https://www.shadertoy.com/view/NslGRN
  * https://www.saschawillems.de/blog/2016/08/13/vulkan-tutorial-on-rendering-a-fullscreen-quad-without-buffers/
+ * https://www.shadertoy.com/howto
  * -------------------------------------------------------------------------- */
 
+#define SHADERTOY_BUFFER_COUNT 4u
+#define SHADERTOY_CHANNEL_COUNT 4u
+// Buffer A-D, followed by the image pass
+#define SHADERTOY_PASS_COUNT (SHADERTOY_BUFFER_COUNT + 1u)
+#define SHADERTOY_IMAGE_PASS SHADERTOY_BUFFER_COUNT
+#define SHADERTOY_BUFFER_FORMAT WGPUTextureFormat_RGBA16Float
+
+// While paused, frames are only rendered for this time after an input event,
+// which keeps the overlay responsive
+static const float SHADERTOY_INPUT_RENDER_TIME = 0.5f;
+// Time slept instead of rendering a frame while paused
+static const float SHADERTOY_IDLE_SLEEP_TIME = 1.0f / 60.0f;
+
+// Texture bound to a channel
+typedef enum shadertoy_channel_t {
+  SHADERTOY_CHANNEL_NONE = 0,
+  SHADERTOY_CHANNEL_BUFFER_A,
+  SHADERTOY_CHANNEL_BUFFER_B,
+  SHADERTOY_CHANNEL_BUFFER_C,
+  SHADERTOY_CHANNEL_BUFFER_D,
+} shadertoy_channel_t;
+
+typedef struct shadertoy_pass_desc_t {
+  // WGSL source of the mainImage function, NULL for an unused buffer
+  const char* wgsl;
+  // Resolution of a buffer relative to the surface, 0 selects 1
+  float scale;
+  shadertoy_channel_t channels[SHADERTOY_CHANNEL_COUNT];
+} shadertoy_pass_desc_t;
+
+typedef struct shadertoy_program_t {
+  // SPIR-V shaders of a program made of the image pass only, in place of WGSL
+  const char* vert_spv;
+  const char* frag_spv;
+  // Buffer A-D and the image pass
+  shadertoy_pass_desc_t passes[SHADERTOY_PASS_COUNT];
+} shadertoy_program_t;
+
+// clang-format off
+// Declarations shared by the WGSL passes
+static const char* shadertoy_prelude_wgsl = CODE(
+  struct ShaderInputs {
+    iResolution : vec2<f32>,
+    iTime : f32,
+    iTimeDelta : f32,
+    iFrame : i32,
+    iMouse : vec4<f32>,
+    iDate : vec4<f32>,
+    iSampleRate : f32,
+  };
+
+  // Resolution of the pass and of its channels, in texels
+  struct PassInputs {
+    iResolution : vec4<f32>,
+    iChannelResolution : array<vec4<f32>, 4>,
+  };
+
+  @group(0) @binding(0) var<uniform> inputs : ShaderInputs;
+  @group(0) @binding(1) var<uniform> passInputs : PassInputs;
+  @group(0) @binding(2) var channelSampler : sampler;
+  @group(0) @binding(3) var iChannel0 : texture_2d<f32>;
+  @group(0) @binding(4) var iChannel1 : texture_2d<f32>;
+  @group(0) @binding(5) var iChannel2 : texture_2d<f32>;
+  @group(0) @binding(6) var iChannel3 : texture_2d<f32>;
+
+  // Samples a channel at Shadertoy texture coordinates, whose origin is the
+  // bottom left corner
+  fn sampleChannel(channel : texture_2d<f32>, uv : vec2<f32>) -> vec4<f32> {
+    return textureSampleLevel(channel, channelSampler,
+                              vec2<f32>(uv.x, 1.0 - uv.y), 0.0);
+  }
+);
+
+// Full screen triangle calling the mainImage function of the pass
+static const char* shadertoy_main_wgsl = CODE(
+  @vertex
+  fn vs_main(@builtin(vertex_index) index : u32)
+    -> @builtin(position) vec4<f32> {
+    let uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+    return vec4<f32>(uv * 2.0 - vec2<f32>(1.0), 0.0, 1.0);
+  }
+
+  @fragment
+  fn fs_main(@builtin(position) coord : vec4<f32>) -> @location(0) vec4<f32> {
+    // The fragment coordinates of Shadertoy start at the bottom left corner
+    let fragCoord = vec2<f32>(coord.x, passInputs.iResolution.y - coord.y);
+    return mainImage(fragCoord);
+  }
+);
+
+static const shadertoy_program_t programs[2] = {
+  [0] = {
+    .vert_spv = "shaders/shadertoy/main.vert.spv",
+    .frag_spv = "shaders/shadertoy/main.frag.spv",
+  },
+  [1] = {
+    .passes = {
+      // Buffer A: emitters leaving trails in the fading previous frame
+      [0] = {
+        .channels = {SHADERTOY_CHANNEL_BUFFER_A},
+        .wgsl     = CODE(
+          fn mainImage(fragCoord : vec2<f32>) -> vec4<f32> {
+            let resolution = passInputs.iResolution.xy;
+            let uv = fragCoord / resolution;
+            let center = vec2<f32>(0.5);
+            var color = sampleChannel(iChannel0,
+                                      center + (uv - center) * 0.995).rgb;
+            color = select(color * 0.98, vec3<f32>(0.0), inputs.iFrame == 0);
+            // Emitters moving on Lissajous curves
+            let aspect = vec2<f32>(resolution.x / resolution.y, 1.0);
+            for (var i = 0; i < 3; i = i + 1) {
+              let phase = f32(i) * 2.094;
+              let t = inputs.iTime * (0.6 + 0.15 * f32(i)) + phase;
+              let emitter = center + vec2<f32>(cos(t), sin(1.3 * t)) * 0.35;
+              let d = length((uv - emitter) * aspect);
+              let tint = vec3<f32>(0.5)
+                         + 0.5 * cos(vec3<f32>(0.0, 2.094, 4.188) + phase);
+              color = color + tint * (1.0 - smoothstep(0.0, 0.025, d));
+            }
+            return vec4<f32>(color, 1.0);
+          }
+        ),
+      },
+      // Buffer B: glow of the trails at half resolution
+      [1] = {
+        .scale    = 0.5f,
+        .channels = {SHADERTOY_CHANNEL_BUFFER_A},
+        .wgsl     = CODE(
+          fn mainImage(fragCoord : vec2<f32>) -> vec4<f32> {
+            let uv = fragCoord / passInputs.iResolution.xy;
+            let texel = vec2<f32>(2.0) / passInputs.iChannelResolution[0].xy;
+            var sum = vec3<f32>(0.0);
+            var weight = 0.0;
+            for (var y = -3; y <= 3; y = y + 1) {
+              for (var x = -3; x <= 3; x = x + 1) {
+                let offset = vec2<f32>(f32(x), f32(y));
+                let w = exp(-dot(offset, offset) / 8.0);
+                sum = sum
+                      + w * sampleChannel(iChannel0, uv + offset * texel).rgb;
+                weight = weight + w;
+              }
+            }
+            return vec4<f32>(sum / weight, 1.0);
+          }
+        ),
+      },
+      // Image: trails and glow, tone mapped
+      [SHADERTOY_IMAGE_PASS] = {
+        .channels = {SHADERTOY_CHANNEL_BUFFER_A, SHADERTOY_CHANNEL_BUFFER_B},
+        .wgsl     = CODE(
+          fn mainImage(fragCoord : vec2<f32>) -> vec4<f32> {
+            let uv = fragCoord / passInputs.iResolution.xy;
+            let color = sampleChannel(iChannel0, uv).rgb
+                        + 2.0 * sampleChannel(iChannel1, uv).rgb;
+            return vec4<f32>(color / (vec3<f32>(1.0) + color), 1.0);
+          }
+        ),
+      },
+    },
+  },
+};
+// clang-format on
+
+// In the order of the programs
+static const char* program_names[2] = {"Cube lines", "Feedback trails"};
+
 // Uniform buffer block object
 static wgpu_buffer_t uniform_buffer_vs = {0};
 
@@ -28,6 +204,12 @@ static struct {
   float iSampleRate; // sound sample rate (i.e., 44100)
 } shader_inputs_ubo = {0};
 
+// Uniform block data - inputs of a single pass
+typedef struct {
+  vec4 iResolution;                                 // pass resolution
+  vec4 iChannelResolution[SHADERTOY_CHANNEL_COUNT]; // channel resolutions
+} pass_inputs_ubo_t;
+
 // Used for mouse pixel coordinates calculation
 static struct {
   vec2 initial_mouse_position;
@@ -41,13 +223,48 @@ static struct {
   .dragging               = false,
 };
 
+// A pass of the program
+typedef struct {
+  uint32_t index;
+  bool enabled;
+  WGPURenderPipeline pipeline;
+  wgpu_buffer_t uniform_buffer;
+  // Indexed by the ping-pong target the buffers write in the frame
+  WGPUBindGroup bind_groups[2];
+} shadertoy_pass_t;
+
+// Passes of the selected program. Each buffer has two persistent targets in
+// the frame graph, written in turns: a pass reads the current target of the
+// buffers before it and the previous target of itself and the later buffers.
+static struct {
+  int32_t program_index;
+  bool program_changed;
+  wgpu_frame_graph_t* graph;
+  wgpu_frame_graph_resource_t targets[SHADERTOY_BUFFER_COUNT][2];
+  wgpu_frame_graph_resource_t swap_chain;
+  shadertoy_pass_t passes[SHADERTOY_PASS_COUNT];
+  uint32_t width;
+  uint32_t height;
+  // Target written by the buffers in the last step
+  uint32_t parity;
+  // The buffers are only rendered in frames stepping the playback
+  bool step;
+  // The next frame steps even while paused, e.g. after the buffers lost their
+  // contents
+  bool invalidated;
+  // Playback time and frame, frozen while paused
+  float time;
+  int32_t frame;
+  // Bound to the unused channels
+  WGPUTexture dummy_texture;
+  WGPUTextureView dummy_view;
+  WGPUSampler sampler;
+} shadertoy = {0};
+
 // The pipeline layout
 static WGPUPipelineLayout pipeline_layout;
 
-// Pipeline
-static WGPURenderPipeline pipeline;
-
-// Render pass descriptor for frame buffer writes
+// Render pass descriptor for the pass targets
 static struct {
   WGPURenderPassColorAttachment color_attachments[1];
   WGPURenderPassDescriptor descriptor;
@@ -56,9 +273,6 @@ static struct {
 // The bind group layout
 static WGPUBindGroupLayout bind_group_layout;
 
-// The bind group
-static WGPUBindGroup bind_group;
-
 // Other variables
 static const char* example_title = "Shadertoy";
 static bool prepared             = false;
@@ -66,10 +280,9 @@ static bool prepared             = false;
 static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
 {
   // Create the bind group layout
-  WGPUBindGroupLayoutDescriptor bgl_desc = {
-    .entryCount = 1,
-    .entries = &(WGPUBindGroupLayoutEntry) {
-      // Binding 0: Uniform buffer (Fragment shader)
+  WGPUBindGroupLayoutEntry bgl_entries[3 + SHADERTOY_CHANNEL_COUNT] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Shader inputs uniform buffer (Fragment shader)
       .binding    = 0,
       .visibility = WGPUShaderStage_Fragment,
       .buffer = (WGPUBufferBindingLayout){
@@ -77,10 +290,45 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
         .minBindingSize = sizeof(shader_inputs_ubo),
       },
       .sampler = {0},
-    }
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Pass inputs uniform buffer (Fragment shader)
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Fragment,
+      .buffer = (WGPUBufferBindingLayout){
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(pass_inputs_ubo_t),
+      },
+      .sampler = {0},
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Channel sampler (Fragment shader)
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Fragment,
+      .sampler = (WGPUSamplerBindingLayout){
+        .type = WGPUSamplerBindingType_Filtering,
+      },
+      .texture = {0},
+    },
   };
-  bind_group_layout
-    = wgpuDeviceCreateBindGroupLayout(wgpu_context->device, &bgl_desc);
+  for (uint32_t i = 0; i < SHADERTOY_CHANNEL_COUNT; ++i) {
+    // Binding 3-6: iChannel0-3 (Fragment shader)
+    bgl_entries[3 + i] = (WGPUBindGroupLayoutEntry) {
+      .binding    = 3 + i,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_Float,
+        .viewDimension = WGPUTextureViewDimension_2D,
+        .multisampled  = false,
+      },
+      .storageTexture = {0},
+    };
+  }
+  bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
   ASSERT(bind_group_layout != NULL);
 
   // Create the pipeline layout
@@ -92,22 +340,129 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
   ASSERT(pipeline_layout != NULL);
 }
 
+static void prepare_channel_resources(wgpu_context_t* wgpu_context)
+{
+  // Linear sampling, clamped to the edges
+  shadertoy.sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "shadertoy_channel_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(shadertoy.sampler != NULL);
+
+  // Black 1x1 texture, textures are zero initialized
+  shadertoy.dummy_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "shadertoy_dummy_texture",
+      .usage         = WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){
+        .width              = 1,
+        .height             = 1,
+        .depthOrArrayLayers = 1,
+      },
+      .format        = WGPUTextureFormat_RGBA8Unorm,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(shadertoy.dummy_texture != NULL);
+  shadertoy.dummy_view = wgpuTextureCreateView(shadertoy.dummy_texture, NULL);
+  ASSERT(shadertoy.dummy_view != NULL);
+}
+
+// A pass reads the buffers rendered before it in the same frame, itself and
+// the later buffers from the previous frame
+static wgpu_frame_graph_resource_t get_channel_resource(uint32_t pass_index,
+                                                        uint32_t buffer,
+                                                        uint32_t parity)
+{
+  return shadertoy.targets[buffer][buffer < pass_index ? parity : 1 - parity];
+}
+
 static void setup_bind_groups(wgpu_context_t* wgpu_context)
 {
-  // Bind Group
-  WGPUBindGroupDescriptor bg_desc = {
-    .layout     = bind_group_layout,
-    .entryCount = 1,
-    .entries    = &(WGPUBindGroupEntry) {
-      .binding = 0,
-      .buffer  = uniform_buffer_vs.buffer,
-      .offset  = 0,
-      .size    = uniform_buffer_vs.size,
-    },
-  };
+  const shadertoy_program_t* program = &programs[shadertoy.program_index];
+  for (uint32_t p = 0; p < SHADERTOY_PASS_COUNT; ++p) {
+    shadertoy_pass_t* pass = &shadertoy.passes[p];
+    if (!pass->enabled) {
+      continue;
+    }
 
-  bind_group = wgpuDeviceCreateBindGroup(wgpu_context->device, &bg_desc);
-  ASSERT(bind_group != NULL);
+    pass_inputs_ubo_t pass_inputs = {0};
+    uint32_t width = wgpu_context->surface.width;
+    uint32_t height = wgpu_context->surface.height;
+    if (p != SHADERTOY_IMAGE_PASS) {
+      wgpu_frame_graph_get_size(shadertoy.graph, shadertoy.targets[p][0],
+                                &width, &height);
+    }
+    glm_vec4_copy((vec4){(float)width, (float)height, 1.0f, 0.0f},
+                  pass_inputs.iResolution);
+
+    for (uint32_t parity = 0; parity < 2; ++parity) {
+      WGPUBindGroupEntry bg_entries[3 + SHADERTOY_CHANNEL_COUNT] = {
+        [0] = (WGPUBindGroupEntry) {
+          // Binding 0: Shader inputs uniform buffer
+          .binding = 0,
+          .buffer  = uniform_buffer_vs.buffer,
+          .offset  = 0,
+          .size    = uniform_buffer_vs.size,
+        },
+        [1] = (WGPUBindGroupEntry) {
+          // Binding 1: Pass inputs uniform buffer
+          .binding = 1,
+          .buffer  = pass->uniform_buffer.buffer,
+          .offset  = 0,
+          .size    = pass->uniform_buffer.size,
+        },
+        [2] = (WGPUBindGroupEntry) {
+          // Binding 2: Channel sampler
+          .binding = 2,
+          .sampler = shadertoy.sampler,
+        },
+      };
+      for (uint32_t c = 0; c < SHADERTOY_CHANNEL_COUNT; ++c) {
+        // Binding 3-6: iChannel0-3
+        const shadertoy_channel_t channel = program->passes[p].channels[c];
+        WGPUTextureView view              = shadertoy.dummy_view;
+        uint32_t channel_width = 1, channel_height = 1;
+        if (channel != SHADERTOY_CHANNEL_NONE) {
+          const wgpu_frame_graph_resource_t resource = get_channel_resource(
+            p, (uint32_t)(channel - SHADERTOY_CHANNEL_BUFFER_A), parity);
+          view = wgpu_frame_graph_get_view(shadertoy.graph, resource);
+          wgpu_frame_graph_get_size(shadertoy.graph, resource, &channel_width,
+                                    &channel_height);
+        }
+        bg_entries[3 + c] = (WGPUBindGroupEntry){
+          .binding     = 3 + c,
+          .textureView = view,
+        };
+        glm_vec4_copy(
+          (vec4){(float)channel_width, (float)channel_height, 1.0f, 0.0f},
+          pass_inputs.iChannelResolution[c]);
+      }
+
+      WGPU_RELEASE_RESOURCE(BindGroup, pass->bind_groups[parity])
+      pass->bind_groups[parity] = wgpuDeviceCreateBindGroup(
+        wgpu_context->device, &(WGPUBindGroupDescriptor){
+                                .layout     = bind_group_layout,
+                                .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                                .entries    = bg_entries,
+                              });
+      ASSERT(pass->bind_groups[parity] != NULL);
+    }
+
+    wgpu_queue_write_buffer(wgpu_context, pass->uniform_buffer.buffer, 0,
+                            &pass_inputs, sizeof(pass_inputs));
+  }
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -134,6 +489,37 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
   };
 }
 
+// Returns true when the mouse input of the shaders changed
+static bool update_mouse_state(wgpu_example_context_t* context)
+{
+  // iMouse: mouse pixel coords. xy: current (if MLB down), zw: click
+  vec2 mouse_position = {
+    context->mouse_position[0],
+    (float)context->wgpu_context->surface.height - context->mouse_position[1],
+  };
+  const bool mouse_down
+    = context->mouse_buttons.left
+      && !(context->show_imgui_overlay && imgui_overlay_want_capture_mouse());
+  bool changed = false;
+  if (!mouse_state.dragging && mouse_down) {
+    glm_vec2_copy(mouse_position, mouse_state.prev_mouse_position);
+    mouse_state.dragging = true;
+  }
+  else if (mouse_state.dragging && mouse_down) {
+    glm_vec2_sub(mouse_position, mouse_state.prev_mouse_position,
+                 mouse_state.mouse_drag_distance);
+    glm_vec2_add(shader_inputs_ubo.iMouse, mouse_state.mouse_drag_distance,
+                 shader_inputs_ubo.iMouse);
+    glm_vec2_copy(mouse_position, mouse_state.prev_mouse_position);
+    changed = mouse_state.mouse_drag_distance[0] != 0.0f
+              || mouse_state.mouse_drag_distance[1] != 0.0f;
+  }
+  else if (mouse_state.dragging && !mouse_down) {
+    mouse_state.dragging = false;
+  }
+  return changed;
+}
+
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   // iResolution: viewport resolution (in pixels)
@@ -143,31 +529,13 @@ static void update_uniform_buffers(wgpu_example_context_t* context)
     = (float)context->wgpu_context->surface.height;
 
   // iTime: Time since the shader started (in seconds)
-  shader_inputs_ubo.iTime = context->run_time;
+  shader_inputs_ubo.iTime = shadertoy.time;
 
   // iTimeDelta: time between each frame (duration since the previous frame)
-  shader_inputs_ubo.iTimeDelta = context->frame_timer;
+  shader_inputs_ubo.iTimeDelta = context->paused ? 0.0f : context->frame_timer;
 
   // iFrame: shader playback frame
-  shader_inputs_ubo.iFrame = (int)context->frame.index;
-
-  // iMouse: mouse pixel coords. xy: current (if MLB down), zw: click
-  context->mouse_position[1]
-    = context->wgpu_context->surface.height - context->mouse_position[1];
-  if (!mouse_state.dragging && context->mouse_buttons.left) {
-    glm_vec2_copy(context->mouse_position, mouse_state.prev_mouse_position);
-    mouse_state.dragging = true;
-  }
-  else if (mouse_state.dragging && context->mouse_buttons.left) {
-    glm_vec2_sub(context->mouse_position, mouse_state.prev_mouse_position,
-                 mouse_state.mouse_drag_distance);
-    glm_vec2_add(shader_inputs_ubo.iMouse, mouse_state.mouse_drag_distance,
-                 shader_inputs_ubo.iMouse);
-    glm_vec2_copy(context->mouse_position, mouse_state.prev_mouse_position);
-  }
-  else if (mouse_state.dragging && !context->mouse_buttons.left) {
-    mouse_state.dragging = false;
-  }
+  shader_inputs_ubo.iFrame = shadertoy.frame;
 
   // iDate: year, month, day, time in seconds
   struct date_t current_date;
@@ -201,30 +569,53 @@ static void prepare_uniform_buffers(wgpu_example_context_t* context)
   update_uniform_buffers(context);
 }
 
-static void prepare_pipelines(wgpu_context_t* wgpu_context)
+// Prepends the shared declarations and appends the entry points to the
+// mainImage function of a pass
+static char* build_pass_wgsl(const char* wgsl)
+{
+  const size_t size = strlen(shadertoy_prelude_wgsl) + strlen(wgsl)
+                      + strlen(shadertoy_main_wgsl) + 3;
+  char* source = (char*)malloc(size);
+  snprintf(source, size, "%s\n%s\n%s", shadertoy_prelude_wgsl, wgsl,
+           shadertoy_main_wgsl);
+  return source;
+}
+
+static void prepare_pass_pipeline(wgpu_context_t* wgpu_context,
+                                  const shadertoy_program_t* program,
+                                  shadertoy_pass_t* pass)
 {
   // Primitive state
   WGPUPrimitiveState primitive_state = {
     .topology  = WGPUPrimitiveTopology_TriangleList,
     .frontFace = WGPUFrontFace_CCW,
-    .cullMode  = WGPUCullMode_Back,
+    .cullMode  = WGPUCullMode_None,
   };
 
-  // Color target state
+  // Color target state, the buffers are float targets
   WGPUBlendState blend_state              = wgpu_create_blend_state(false);
   WGPUColorTargetState color_target_state = (WGPUColorTargetState){
-    .format    = wgpu_context->swap_chain.format,
+    .format    = pass->index == SHADERTOY_IMAGE_PASS ?
+                   wgpu_context->swap_chain.format :
+                   SHADERTOY_BUFFER_FORMAT,
     .blend     = &blend_state,
     .writeMask = WGPUColorWriteMask_All,
   };
 
+  // SPIR-V shaders of the program or the WGSL pass
+  char* wgsl = program->frag_spv != NULL ?
+                 NULL :
+                 build_pass_wgsl(program->passes[pass->index].wgsl);
+
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
                     wgpu_context, &(wgpu_vertex_state_t){
                     .shader_desc = (wgpu_shader_desc_t){
-                      // Vertex shader SPIR-V
-                      .label = "main_vertex_shader",
-                      .file  = "shaders/shadertoy/main.vert.spv",
+                      // Vertex shader SPIR-V or WGSL
+                      .label            = "main_vertex_shader",
+                      .file             = program->vert_spv,
+                      .wgsl_code.source = wgsl,
+                      .entry            = wgsl != NULL ? "vs_main" : NULL,
                     },
                     .buffer_count = 0,
                     .buffers      = NULL,
@@ -234,13 +625,16 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
                     wgpu_context, &(wgpu_fragment_state_t){
                     .shader_desc = (wgpu_shader_desc_t){
-                      // Fragment shader SPIR-V
-                      .label = "main_fragment_shader",
-                      .file  = "shaders/shadertoy/main.frag.spv",
+                      // Fragment shader SPIR-V or WGSL
+                      .label            = "main_fragment_shader",
+                      .file             = program->frag_spv,
+                      .wgsl_code.source = wgsl,
+                      .entry            = wgsl != NULL ? "fs_main" : NULL,
                     },
                     .target_count = 1,
                     .targets      = &color_target_state,
                   });
+  free(wgsl);
 
   // Multisample state
   WGPUMultisampleState multisample_state
@@ -250,7 +644,7 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
       });
 
   // Create rendering pipeline using the specified states
-  pipeline = wgpuDeviceCreateRenderPipeline(
+  pass->pipeline = wgpuDeviceCreateRenderPipeline(
     wgpu_context->device, &(WGPURenderPipelineDescriptor){
                             .label       = "shadertoy_render_pipeline",
                             .layout      = pipeline_layout,
@@ -259,20 +653,140 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
                             .fragment    = &fragment_state,
                             .multisample = multisample_state,
                           });
+  ASSERT(pass->pipeline != NULL);
 
   // Partial cleanup
   WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
 }
 
+// Records a pass into its target of the frame
+static void shadertoy_pass_execute(wgpu_frame_graph_t* graph,
+                                   WGPUCommandEncoder cmd_enc, void* user_data)
+{
+  const shadertoy_pass_t* pass = (const shadertoy_pass_t*)user_data;
+  const bool image_pass        = pass->index == SHADERTOY_IMAGE_PASS;
+  // The feedback only advances in the frames stepping the playback
+  if (!image_pass && !shadertoy.step) {
+    return;
+  }
+
+  render_pass.color_attachments[0].view = wgpu_frame_graph_get_view(
+    graph, image_pass ? shadertoy.swap_chain :
+                        shadertoy.targets[pass->index][shadertoy.parity]);
+  WGPURenderPassEncoder rpass_enc
+    = wgpuCommandEncoderBeginRenderPass(cmd_enc, &render_pass.descriptor);
+  wgpuRenderPassEncoderSetPipeline(rpass_enc, pass->pipeline);
+  wgpuRenderPassEncoderSetBindGroup(
+    rpass_enc, 0, pass->bind_groups[shadertoy.parity], 0, 0);
+  // Draw full screen triangle
+  wgpuRenderPassEncoderDraw(rpass_enc, 3, 1, 0, 0);
+  wgpuRenderPassEncoderEnd(rpass_enc);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+}
+
+static void release_program(void)
+{
+  for (uint32_t p = 0; p < SHADERTOY_PASS_COUNT; ++p) {
+    shadertoy_pass_t* pass = &shadertoy.passes[p];
+    WGPU_RELEASE_RESOURCE(RenderPipeline, pass->pipeline)
+    WGPU_RELEASE_RESOURCE(BindGroup, pass->bind_groups[0])
+    WGPU_RELEASE_RESOURCE(BindGroup, pass->bind_groups[1])
+    WGPU_RELEASE_RESOURCE(Buffer, pass->uniform_buffer.buffer)
+    pass->enabled = false;
+  }
+}
+
+// Declares the passes of the selected program in the frame graph
+static void prepare_program(wgpu_context_t* wgpu_context)
+{
+  release_program();
+
+  const shadertoy_program_t* program = &programs[shadertoy.program_index];
+  wgpu_frame_graph_t* graph          = shadertoy.graph;
+  wgpu_frame_graph_reset(graph);
+  for (uint32_t b = 0; b < SHADERTOY_BUFFER_COUNT; ++b) {
+    shadertoy.targets[b][0] = WGPU_FRAME_GRAPH_INVALID_RESOURCE;
+    shadertoy.targets[b][1] = WGPU_FRAME_GRAPH_INVALID_RESOURCE;
+    if (program->passes[b].wgsl == NULL) {
+      continue;
+    }
+    for (uint32_t i = 0; i < 2; ++i) {
+      shadertoy.targets[b][i] = wgpu_frame_graph_create_texture(
+        graph, &(wgpu_frame_graph_texture_desc_t){
+                 .label      = "shadertoy_buffer",
+                 .format     = SHADERTOY_BUFFER_FORMAT,
+                 .scale      = program->passes[b].scale,
+                 .persistent = true,
+               });
+    }
+  }
+  shadertoy.swap_chain
+    = wgpu_frame_graph_import_texture(graph, "shadertoy_image", NULL);
+
+  static const char* pass_labels[SHADERTOY_PASS_COUNT]
+    = {"Buffer A", "Buffer B", "Buffer C", "Buffer D", "Image"};
+  for (uint32_t p = 0; p < SHADERTOY_PASS_COUNT; ++p) {
+    shadertoy_pass_t* pass = &shadertoy.passes[p];
+    pass->index            = p;
+    pass->enabled
+      = p == SHADERTOY_IMAGE_PASS || program->passes[p].wgsl != NULL;
+    if (!pass->enabled) {
+      continue;
+    }
+
+    wgpu_frame_graph_pass_desc_t pass_desc = {
+      .label     = pass_labels[p],
+      .func      = shadertoy_pass_execute,
+      .user_data = pass,
+    };
+    for (uint32_t c = 0; c < SHADERTOY_CHANNEL_COUNT; ++c) {
+      const shadertoy_channel_t channel = program->passes[p].channels[c];
+      if (channel != SHADERTOY_CHANNEL_NONE) {
+        const uint32_t b = (uint32_t)(channel - SHADERTOY_CHANNEL_BUFFER_A);
+        ASSERT(program->passes[b].wgsl != NULL);
+        pass_desc.inputs[pass_desc.input_count++] = shadertoy.targets[b][0];
+        pass_desc.inputs[pass_desc.input_count++] = shadertoy.targets[b][1];
+      }
+    }
+    if (p == SHADERTOY_IMAGE_PASS) {
+      pass_desc.outputs[pass_desc.output_count++] = shadertoy.swap_chain;
+    }
+    else {
+      pass_desc.outputs[pass_desc.output_count++] = shadertoy.targets[p][0];
+      pass_desc.outputs[pass_desc.output_count++] = shadertoy.targets[p][1];
+    }
+    wgpu_frame_graph_add_pass(graph, &pass_desc);
+
+    pass->uniform_buffer = wgpu_create_buffer(
+      wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size  = sizeof(pass_inputs_ubo_t),
+      });
+    prepare_pass_pipeline(wgpu_context, program, pass);
+  }
+
+  shadertoy.width  = wgpu_context->surface.width;
+  shadertoy.height = wgpu_context->surface.height;
+  wgpu_frame_graph_compile(graph, shadertoy.width, shadertoy.height);
+  setup_bind_groups(wgpu_context);
+
+  // The playback restarts with the program
+  shadertoy.time        = 0.0f;
+  shadertoy.frame       = 0;
+  shadertoy.invalidated = true;
+}
+
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
     prepare_uniform_buffers(context);
     setup_pipeline_layout(context->wgpu_context);
-    setup_bind_groups(context->wgpu_context);
-    prepare_pipelines(context->wgpu_context);
+    prepare_channel_resources(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
+    shadertoy.graph = wgpu_frame_graph_create(context->wgpu_context);
+    prepare_program(context->wgpu_context);
     prepared = true;
     return 0;
   }
@@ -280,42 +794,39 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    // Applied before the next frame, the passes are recorded already
+    if (imgui_overlay_combo_box(context->imgui_overlay, "Program",
+                                &shadertoy.program_index, program_names,
+                                ARRAY_SIZE(program_names))) {
+      shadertoy.program_changed = true;
+    }
+    if (imgui_overlay_button(context->imgui_overlay, "Restart")) {
+      shadertoy.program_changed = true;
+    }
+    imgui_overlay_text("iTime: %.2f", shadertoy.time);
+    imgui_overlay_text("iFrame: %d", shadertoy.frame);
+  }
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   // Set target frame buffer
-  render_pass.color_attachments[0].view = wgpu_context->swap_chain.frame_buffer;
+  wgpu_frame_graph_set_imported_view(shadertoy.graph, shadertoy.swap_chain,
+                                     wgpu_context->swap_chain.frame_buffer);
 
   // Create command encoder
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
-  // Create render pass encoder for encoding drawing commands
-  wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-    wgpu_context->cmd_enc, &render_pass.descriptor);
-
-  // Bind the rendering pipeline
-  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
-
-  // Set the bind group
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0, bind_group, 0,
-                                    0);
-
-  // Set viewport
-  wgpuRenderPassEncoderSetViewport(
-    wgpu_context->rpass_enc, 0.0f, 0.0f, (float)wgpu_context->surface.width,
-    (float)wgpu_context->surface.height, 0.0f, 1.0f);
-
-  // Set scissor rectangle
-  wgpuRenderPassEncoderSetScissorRect(wgpu_context->rpass_enc, 0u, 0u,
-                                      wgpu_context->surface.width,
-                                      wgpu_context->surface.height);
-
-  // Draw quad
-  wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
+  // Record the buffer passes and the image pass
+  wgpu_frame_graph_execute(shadertoy.graph, wgpu_context->cmd_enc);
 
-  // End render pass
-  wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
-  WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
 
   // Get command buffer
   WGPUCommandBuffer command_buffer
@@ -354,17 +865,73 @@ static int example_render(wgpu_example_context_t* context)
   if (!prepared) {
     return 1;
   }
-  return example_draw(context);
+
+  if (shadertoy.program_changed) {
+    prepare_program(context->wgpu_context);
+    shadertoy.program_changed = false;
+  }
+
+  // The playback steps every frame, while paused only when the inputs of the
+  // shaders changed
+  const bool inputs_changed = update_mouse_state(context);
+  shadertoy.step = !context->paused || inputs_changed || shadertoy.invalidated;
+  const bool overlay_input
+    = context->show_imgui_overlay
+      && context->run_time - context->overlay.input_time
+           < SHADERTOY_INPUT_RENDER_TIME;
+  if (!shadertoy.step && !overlay_input) {
+    // The last presented frame stays on screen
+    platform_sleep(SHADERTOY_IDLE_SLEEP_TIME);
+    return 0;
+  }
+
+  if (shadertoy.step) {
+    shadertoy.parity = 1 - shadertoy.parity;
+  }
+  const int result = example_draw(context);
+  if (shadertoy.step) {
+    ++shadertoy.frame;
+    shadertoy.invalidated = false;
+  }
+  if (!context->paused) {
+    shadertoy.time += context->frame_timer;
+  }
+  return result;
+}
+
+// Reallocates the buffers for the new surface size, which drops the feedback
+static void example_on_view_changed(wgpu_example_context_t* context)
+{
+  wgpu_context_t* wgpu_context = context->wgpu_context;
+  if (!prepared
+      || (shadertoy.width == wgpu_context->surface.width
+          && shadertoy.height == wgpu_context->surface.height)) {
+    return;
+  }
+  shadertoy.width  = wgpu_context->surface.width;
+  shadertoy.height = wgpu_context->surface.height;
+  if (wgpu_frame_graph_compile(shadertoy.graph, shadertoy.width,
+                               shadertoy.height)) {
+    // The new buffers start over
+    shadertoy.frame = 0;
+  }
+  setup_bind_groups(wgpu_context);
+  shadertoy.invalidated = true;
 }
 
 static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
+  release_program();
+  if (shadertoy.graph != NULL) {
+    wgpu_frame_graph_release(shadertoy.graph);
+  }
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer_vs.buffer)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
+  WGPU_RELEASE_RESOURCE(TextureView, shadertoy.dummy_view)
+  WGPU_RELEASE_RESOURCE(Texture, shadertoy.dummy_texture)
+  WGPU_RELEASE_RESOURCE(Sampler, shadertoy.sampler)
 }
 
 void example_shadertoy(int argc, char* argv[])
@@ -372,12 +939,14 @@ void example_shadertoy(int argc, char* argv[])
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
-     .title = example_title,
-     .vsync = true,
+     .title   = example_title,
+     .overlay = true,
+     .vsync   = true,
     },
-    .example_initialize_func = &example_initialize,
-    .example_render_func     = &example_render,
-    .example_destroy_func    = &example_destroy,
+    .example_initialize_func      = &example_initialize,
+    .example_render_func          = &example_render,
+    .example_destroy_func         = &example_destroy,
+    .example_on_view_changed_func = &example_on_view_changed,
   });
   // clang-format on
 }
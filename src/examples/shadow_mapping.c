@@ -4,12 +4,22 @@
 
 #include <string.h>
 
+#include "../webgpu/cascaded_shadow_map.h"
 #include "../webgpu/imgui_overlay.h"
+#include "../webgpu/meshlet_culling.h"
+#include "../webgpu/parallel_encoding.h"
+#include "../webgpu/shadow_atlas.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Shadow Mapping
  *
  * This example shows how to sample from a depth texture to render shadows.
+ * The shadows are rendered into cascaded shadow maps, the far cascades are
+ * cached and only rendered again when the camera leaves them. The shadow passes
+ * and the color pass are independent and encoded in parallel into command
+ * buffers of their own. The dragon is culled by meshlets on the GPU before the
+ * color pass. Two spot lights, a static one and one circling the dragon, are
+ * shadowed through tiles of a shadow atlas.
  *
  * Ref:
  * https://github.com/austinEng/webgpu-samples/blob/main/src/pages/samples/shadowMapping.ts
@@ -20,14 +30,49 @@ static struct {
   vec3 up_vector;
   vec3 origin;
   mat4 projection_matrix;
+  mat4 view_matrix;
   mat4 view_proj_matrix;
+  vec3 eye_position;
+  mat4 model_matrix;
 } view_matrices = {0};
 
 static stanford_dragon_mesh_t stanford_dragon_mesh = {0};
-static const uint32_t shadow_depth_texture_size    = 1024;
 
-// Vertex and index buffers
-static WGPUBuffer vertex_buffer;
+// Camera planes and the distance up to which shadows are rendered
+static const float z_near          = 1.0f;
+static const float z_far           = 2000.0f;
+static const float shadow_distance = 400.0f;
+
+static vec3 light_position = {50.0f, 100.0f, -100.0f};
+
+// Spot lights, laid out as in the scene uniform buffer after the position of
+// the directional light
+#define SPOT_LIGHT_COUNT 2u
+
+typedef struct spot_light_t {
+  vec3 position;
+  float cos_outer;
+  vec3 direction;
+  float cos_inner;
+  vec4 color;
+} spot_light_t;
+
+static struct {
+  spot_light_t params[SPOT_LIGHT_COUNT];
+  wgpu_shadow_atlas_light_t shadows[SPOT_LIGHT_COUNT];
+} spot_lights = {0};
+
+// Offset and size of the scene uniform buffer
+static const uint64_t spot_lights_offset = sizeof(mat4) + sizeof(vec4);
+static const uint64_t scene_buffer_size
+  = sizeof(mat4) + sizeof(vec4) + sizeof(spot_light_t) * SPOT_LIGHT_COUNT;
+
+// Vertex and index buffers, the positions are kept in their own buffer so that
+// the shadow pass only fetches positions
+static struct {
+  WGPUBuffer positions;
+  WGPUBuffer normals;
+} vertex_buffers = {0};
 static WGPUBuffer index_buffer;
 static uint32_t index_count;
 
@@ -39,22 +84,15 @@ static struct {
 
 // The pipeline layout
 static struct {
-  WGPUPipelineLayout shadow;
   WGPUPipelineLayout color;
 } pipeline_layouts = {0};
 
 // Pipelines
 static struct {
-  WGPURenderPipeline shadow;
   WGPURenderPipeline color;
 } render_pipelines = {0};
 
 // Render pass descriptor for frame buffer writes
-static struct {
-  WGPURenderPassColorAttachment color_attachments[1];
-  WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
-  WGPURenderPassDescriptor descriptor;
-} shadow_render_pass = {0};
 static struct {
   WGPURenderPassColorAttachment color_attachments[1];
   WGPURenderPassDepthStencilAttachment depth_stencil_attachment;
@@ -63,7 +101,6 @@ static struct {
 
 // Bind groups
 static struct {
-  WGPUBindGroup scene_shadow;
   WGPUBindGroup scene_render;
   WGPUBindGroup model;
 } bind_groups = {0};
@@ -72,22 +109,105 @@ static struct {
 static struct {
   WGPUBindGroupLayout uniform_buffer_scene;
   WGPUBindGroupLayout uniform_buffer_model;
-  WGPUBindGroupLayout render;
 } bind_groups_layouts = {0};
 
-// Texture and sampler
+// Texture
 static struct {
   struct {
     WGPUTexture texture;
     WGPUTextureView view;
   } depth_texture;
-  struct {
-    WGPUTexture texture;
-    WGPUTextureView view;
-  } shadow_depth_texture;
-  WGPUSampler sampler;
 } textures = {0};
 
+// Cascaded shadow map of the light, with the number of cascades rendered in
+// the last frame
+static wgpu_cascaded_shadow_map_t* cascaded_shadow_map = NULL;
+static uint32_t rendered_cascade_count                 = 0;
+
+// Shadow atlas of the spot lights, with the number of tiles rendered in the
+// last frame
+static wgpu_shadow_atlas_t* shadow_atlas = NULL;
+static uint32_t rendered_tile_count      = 0;
+
+// Meshlet culling of the dragon against the camera, the shadow passes draw all
+// of its triangles
+static wgpu_meshlet_culling_t* meshlet_culling = NULL;
+
+// clang-format off
+static const char* shadow_mapping_shader_wgsl = CODE(
+  struct SpotLight {
+    position : vec3<f32>,
+    cosOuter : f32,
+    direction : vec3<f32>,
+    cosInner : f32,
+    color : vec4<f32>,
+  };
+
+  struct Scene {
+    cameraViewProj : mat4x4<f32>,
+    lightPosition : vec3<f32>,
+    spotLights : array<SpotLight, 2>,
+  };
+
+  @group(0) @binding(0) var<uniform> scene : Scene;
+  @group(1) @binding(0) var<uniform> model : mat4x4<f32>;
+  @group(2) @binding(0) var<uniform> shadowParams : CascadedShadowParams;
+  @group(2) @binding(1) var shadowMap : texture_depth_2d_array;
+  @group(2) @binding(2) var shadowSampler : sampler_comparison;
+  @group(3) @binding(0) var<uniform> shadowAtlasParams : ShadowAtlasParams;
+  @group(3) @binding(1) var shadowAtlas : texture_depth_2d;
+  @group(3) @binding(2) var shadowAtlasSampler : sampler_comparison;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) worldPosition : vec3<f32>,
+    @location(1) normal : vec3<f32>,
+  };
+
+  @vertex
+  fn vs_main(@location(0) position : vec3<f32>,
+             @location(1) normal : vec3<f32>) -> VertexOutput {
+    var output : VertexOutput;
+    let worldPosition = model * vec4<f32>(position, 1.0);
+    output.position = scene.cameraViewProj * worldPosition;
+    output.worldPosition = worldPosition.xyz;
+    output.normal = normal;
+    return output;
+  }
+
+  let albedo = vec3<f32>(0.9);
+  let ambientFactor = 0.2;
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let visibility = cascadedShadowGetVisibility(input.worldPosition);
+    let lambertFactor
+      = max(dot(normalize(scene.lightPosition - input.worldPosition),
+                input.normal),
+            0.0);
+    let lightingFactor = min(ambientFactor + visibility * lambertFactor, 1.0);
+    // The light of the spots is added inside of their cone
+    let normal = normalize(input.normal);
+    var spotColor = vec3<f32>(0.0);
+    for (var i = 0u; i < 2u; i = i + 1u) {
+      let spot = scene.spotLights[i];
+      let toLight = normalize(spot.position - input.worldPosition);
+      let cone = smoothstep(spot.cosOuter, spot.cosInner,
+                            dot(-toLight, spot.direction));
+      let spotFactor = max(dot(toLight, normal), 0.0) * cone;
+      if (spotFactor > 0.0) {
+        spotColor = spotColor
+                    + spot.color.rgb * spotFactor
+                        * shadowAtlasGetVisibility(i, input.worldPosition);
+      }
+    }
+    return vec4<f32>(min((lightingFactor + spotColor) * albedo,
+                         vec3<f32>(1.0)),
+                     1.0);
+  }
+);
+// clang-format on
+
 // Other variables
 static const char* example_title = "Shadow Mapping";
 static bool prepared             = false;
@@ -97,26 +217,33 @@ static void
 prepare_vertex_and_index_buffers(wgpu_context_t* wgpu_context,
                                  stanford_dragon_mesh_t* dragon_mesh)
 {
-  // Create the model vertex buffer
+  // Create the model vertex buffers
   {
     const uint8_t ground_plane_vertex_count = 4;
     uint64_t vertex_buffer_size
-      = (dragon_mesh->positions.count + ground_plane_vertex_count) * 3 * 2
+      = (dragon_mesh->positions.count + ground_plane_vertex_count) * 3
         * sizeof(float);
     WGPUBufferDescriptor buffer_desc = {
       .usage            = WGPUBufferUsage_Vertex,
       .size             = vertex_buffer_size,
       .mappedAtCreation = true,
     };
-    vertex_buffer = wgpuDeviceCreateBuffer(wgpu_context->device, &buffer_desc);
-    ASSERT(vertex_buffer);
-    float* mapping
-      = (float*)wgpuBufferGetMappedRange(vertex_buffer, 0, vertex_buffer_size);
-    ASSERT(mapping);
-    for (uint64_t i = 0; i < dragon_mesh->positions.count; ++i) {
-      memcpy(&mapping[6 * i], dragon_mesh->positions.data[i], sizeof(vec3));
-      memcpy(&mapping[6 * i + 3], dragon_mesh->normals.data[i], sizeof(vec3));
-    }
+    vertex_buffers.positions
+      = wgpuDeviceCreateBuffer(wgpu_context->device, &buffer_desc);
+    ASSERT(vertex_buffers.positions);
+    vertex_buffers.normals
+      = wgpuDeviceCreateBuffer(wgpu_context->device, &buffer_desc);
+    ASSERT(vertex_buffers.normals);
+    float* positions = (float*)wgpuBufferGetMappedRange(
+      vertex_buffers.positions, 0, vertex_buffer_size);
+    ASSERT(positions);
+    float* normals = (float*)wgpuBufferGetMappedRange(vertex_buffers.normals, 0,
+                                                      vertex_buffer_size);
+    ASSERT(normals);
+    memcpy(positions, dragon_mesh->positions.data,
+           dragon_mesh->positions.count * sizeof(vec3));
+    memcpy(normals, dragon_mesh->normals.data,
+           dragon_mesh->positions.count * sizeof(vec3));
     // Push vertex attributes for an additional ground plane
     static const vec3 ground_plane_positions[4] = {
       {-100.0f, 20.0f, -100.0f}, //
@@ -130,13 +257,13 @@ prepare_vertex_and_index_buffers(wgpu_context_t* wgpu_context,
       {0.0f, 1.0f, 0.0f}, //
       {0.0f, 1.0f, 0.0f}, //
     };
-    const uint64_t offset = dragon_mesh->positions.count * 6;
-    for (uint64_t i = 0; i < ground_plane_vertex_count; ++i) {
-      memcpy(&mapping[offset + 6 * i], ground_plane_positions[i], sizeof(vec3));
-      memcpy(&mapping[offset + 6 * i + 3], ground_plane_normals[i],
-             sizeof(vec3));
-    }
-    wgpuBufferUnmap(vertex_buffer);
+    const uint64_t offset = dragon_mesh->positions.count * 3;
+    memcpy(&positions[offset], ground_plane_positions,
+           sizeof(ground_plane_positions));
+    memcpy(&normals[offset], ground_plane_normals,
+           sizeof(ground_plane_normals));
+    wgpuBufferUnmap(vertex_buffers.positions);
+    wgpuBufferUnmap(vertex_buffers.normals);
   }
 
   // Create the model index buffer
@@ -174,42 +301,29 @@ prepare_vertex_and_index_buffers(wgpu_context_t* wgpu_context,
   }
 }
 
-static void prepare_texture(wgpu_context_t* wgpu_context)
+// Builds the meshlets of the dragon, the ground plane is drawn without culling
+static void prepare_meshlet_culling(wgpu_context_t* wgpu_context,
+                                    stanford_dragon_mesh_t* dragon_mesh)
 {
-  // Create the depth texture for rendering/sampling the shadow map
-  {
-    WGPUExtent3D texture_extent = {
-      .width              = shadow_depth_texture_size,
-      .height             = shadow_depth_texture_size,
-      .depthOrArrayLayers = 1,
-    };
-    WGPUTextureDescriptor texture_desc = {
-      .size          = texture_extent,
-      .mipLevelCount = 1,
-      .sampleCount   = 1,
-      .dimension     = WGPUTextureDimension_2D,
-      .format        = WGPUTextureFormat_Depth32Float,
-      .usage
-      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
-    };
-    textures.shadow_depth_texture.texture
-      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-    ASSERT(textures.shadow_depth_texture.texture != NULL);
-
-    // Create the texture view
-    WGPUTextureViewDescriptor texture_view_dec = {
-      .dimension       = WGPUTextureViewDimension_2D,
-      .format          = WGPUTextureFormat_Depth32Float,
-      .baseMipLevel    = 0,
-      .mipLevelCount   = 1,
-      .baseArrayLayer  = 0,
-      .arrayLayerCount = 1,
-    };
-    textures.shadow_depth_texture.view = wgpuTextureCreateView(
-      textures.shadow_depth_texture.texture, &texture_view_dec);
-    ASSERT(textures.shadow_depth_texture.view != NULL);
+  const uint32_t dragon_index_count = dragon_mesh->triangles.count * 3;
+  uint32_t* indices = malloc(dragon_index_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < dragon_index_count; ++i) {
+    indices[i] = dragon_mesh->triangles.data[i / 3][i % 3];
   }
+  meshlet_culling = wgpu_meshlet_culling_create(
+    wgpu_context, &(wgpu_meshlet_culling_desc_t){
+                    .indices         = indices,
+                    .index_count     = dragon_index_count,
+                    .positions       = &dragon_mesh->positions.data[0][0],
+                    .position_stride = sizeof(vec3),
+                    .vertex_count    = dragon_mesh->positions.count,
+                  });
+  ASSERT(meshlet_culling != NULL);
+  free(indices);
+}
 
+static void prepare_texture(wgpu_context_t* wgpu_context)
+{
   // Create a depth/stencil texture for the color rendering pipeline
   {
     WGPUExtent3D texture_extent = {
@@ -245,277 +359,151 @@ static void prepare_texture(wgpu_context_t* wgpu_context)
   }
 }
 
-static void prepare_sampler(wgpu_context_t* wgpu_context)
-{
-  textures.sampler = wgpuDeviceCreateSampler(
-    wgpu_context->device, &(WGPUSamplerDescriptor){
-                            .addressModeU  = WGPUAddressMode_ClampToEdge,
-                            .addressModeV  = WGPUAddressMode_ClampToEdge,
-                            .addressModeW  = WGPUAddressMode_ClampToEdge,
-                            .minFilter     = WGPUFilterMode_Nearest,
-                            .magFilter     = WGPUFilterMode_Linear,
-                            .mipmapFilter  = WGPUFilterMode_Nearest,
-                            .compare       = WGPUCompareFunction_Less,
-                            .lodMinClamp   = 0.0f,
-                            .lodMaxClamp   = 1.0f,
-                            .maxAnisotropy = 1,
-                          });
-  ASSERT(textures.sampler != NULL);
-}
-
-static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
+static void setup_bind_group_layouts(wgpu_context_t* wgpu_context)
 {
-  // Bind group layout for unform buffers in shadow pipeline
+  // Bind group layout for scene uniform
   {
-    // Bind group layout for scene uniform
-    {
-      WGPUBindGroupLayoutEntry bgl_entries[1] = {
-        [0] = (WGPUBindGroupLayoutEntry) {
-          // Binding 0: Uniform
-          .binding    = 0,
-          .visibility = WGPUShaderStage_Vertex,
-          .buffer = (WGPUBufferBindingLayout) {
-            .type             = WGPUBufferBindingType_Uniform,
-            .hasDynamicOffset = false,
-            .minBindingSize   = sizeof(mat4) + sizeof(mat4) + sizeof(vec3),
-          },
-          .sampler = {0},
-        },
-      };
-      bind_groups_layouts.uniform_buffer_scene
-        = wgpuDeviceCreateBindGroupLayout(
-          wgpu_context->device,
-          &(WGPUBindGroupLayoutDescriptor){
-            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-            .entries    = bgl_entries,
-          });
-      ASSERT(bind_groups_layouts.uniform_buffer_scene != NULL);
-    }
-
-    // Bind group layout for model uniform
-    {
-      WGPUBindGroupLayoutEntry bgl_entries[1] = {
-        [0] = (WGPUBindGroupLayoutEntry) {
-          // Binding 0: Uniform
-          .binding    = 0,
-          .visibility = WGPUShaderStage_Vertex,
-          .buffer = (WGPUBufferBindingLayout) {
-            .type             = WGPUBufferBindingType_Uniform,
-            .hasDynamicOffset = false,
-            .minBindingSize   = sizeof(mat4),
-          },
-          .sampler = {0},
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Uniform
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = false,
+          .minBindingSize   = scene_buffer_size,
         },
-      };
-      bind_groups_layouts.uniform_buffer_model
-        = wgpuDeviceCreateBindGroupLayout(
-          wgpu_context->device,
-          &(WGPUBindGroupLayoutDescriptor){
-            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-            .entries    = bgl_entries,
-          });
-      ASSERT(bind_groups_layouts.uniform_buffer_model != NULL);
-    }
-
-    WGPUBindGroupLayout bind_group_layouts[2] = {
-      bind_groups_layouts.uniform_buffer_scene,
-      bind_groups_layouts.uniform_buffer_model,
+        .sampler = {0},
+      },
     };
-    pipeline_layouts.shadow = wgpuDeviceCreatePipelineLayout(
-      wgpu_context->device,
-      &(WGPUPipelineLayoutDescriptor){
-        .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
-        .bindGroupLayouts     = bind_group_layouts,
-      });
-    ASSERT(pipeline_layouts.shadow != NULL);
+    bind_groups_layouts.uniform_buffer_scene = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(bind_groups_layouts.uniform_buffer_scene != NULL);
   }
 
-  // Create a bind group layout which holds the scene uniforms and
-  // the texture+sampler for depth. We create it manually because the WebPU
-  // implementation doesn't infer this from the shader (yet).
+  // Bind group layout for model uniform, shared with the depth-only pipeline
+  // of the cascaded shadow map
   {
-    WGPUBindGroupLayoutEntry bgl_entries[3] = {
-    [0] = (WGPUBindGroupLayoutEntry) {
-      // Binding 0: Uniform
-      .binding    = 0,
-      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type             = WGPUBufferBindingType_Uniform,
-        .hasDynamicOffset = false,
-        .minBindingSize   = sizeof(mat4) + sizeof(mat4) + sizeof(vec3),
-      },
-      .sampler = {0},
-    },
-    [1] = (WGPUBindGroupLayoutEntry) {
-      // Binding 1: Texture view
-      .binding    = 1,
-      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
-      .texture = (WGPUTextureBindingLayout) {
-        .sampleType    = WGPUTextureSampleType_Depth,
-        .viewDimension = WGPUTextureViewDimension_2D,
-        .multisampled  = false,
-      },
-      .storageTexture = {0},
-    },
-    [2] = (WGPUBindGroupLayoutEntry) {
-      // Binding 2: Sampler
-      .binding    = 2,
-      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
-      .sampler = (WGPUSamplerBindingLayout){
-        .type = WGPUSamplerBindingType_Comparison,
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Uniform
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Vertex,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = false,
+          .minBindingSize   = sizeof(mat4),
+        },
+        .sampler = {0},
       },
-      .texture = {0},
-    }
-  };
-    bind_groups_layouts.render = wgpuDeviceCreateBindGroupLayout(
+    };
+    bind_groups_layouts.uniform_buffer_model = wgpuDeviceCreateBindGroupLayout(
       wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
                               .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
                               .entries    = bgl_entries,
                             });
-    ASSERT(bind_groups_layouts.render != NULL);
-
-    // Specify the pipeline layout. The layout for the model is the same, so
-    // reuse it from the shadow pipeline.
-    WGPUBindGroupLayout bind_group_layouts[2] = {
-      bind_groups_layouts.render,               // Group 0
-      bind_groups_layouts.uniform_buffer_model, // Group 1
-    };
-    pipeline_layouts.color = wgpuDeviceCreatePipelineLayout(
-      wgpu_context->device,
-      &(WGPUPipelineLayoutDescriptor){
-        .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
-        .bindGroupLayouts     = bind_group_layouts,
-      });
-    ASSERT(pipeline_layouts.color != NULL);
+    ASSERT(bind_groups_layouts.uniform_buffer_model != NULL);
   }
 }
 
-static void setup_render_pass(wgpu_context_t* wgpu_context)
+static void prepare_cascaded_shadow_map(wgpu_context_t* wgpu_context)
 {
-  UNUSED_VAR(wgpu_context);
-
-  // Shadow rendering
-  {
-    // Shadow pass descriptor
-    shadow_render_pass.depth_stencil_attachment
-      = (WGPURenderPassDepthStencilAttachment){
-        .view            = textures.shadow_depth_texture.view,
-        .depthLoadOp     = WGPULoadOp_Clear,
-        .depthStoreOp    = WGPUStoreOp_Store,
-        .depthClearValue = 1.0f,
-        .clearDepth      = 1.0f,
-        .clearStencil    = 0,
-      };
-
-    shadow_render_pass.descriptor = (WGPURenderPassDescriptor){
-      .colorAttachmentCount   = 0,
-      .colorAttachments       = shadow_render_pass.color_attachments,
-      .depthStencilAttachment = &shadow_render_pass.depth_stencil_attachment,
-      .occlusionQuerySet      = NULL,
-    };
-  }
-
-  // Color rendering
-  {
-    // Color attachment
-    color_render_pass.color_attachments[0] = (WGPURenderPassColorAttachment) {
-      .view       = NULL, // view is acquired and set in render loop.
-      .loadOp     = WGPULoadOp_Clear,
-      .storeOp    = WGPUStoreOp_Store,
-      .clearColor = (WGPUColor) {
-        .r = 0.5f,
-        .g = 0.5f,
-        .b = 0.5f,
-        .a = 1.0f,
-      },
-    };
-
-    // Render pass descriptor
-    color_render_pass.depth_stencil_attachment
-      = (WGPURenderPassDepthStencilAttachment){
-        .view           = textures.depth_texture.view,
-        .depthLoadOp    = WGPULoadOp_Clear,
-        .depthStoreOp   = WGPUStoreOp_Store,
-        .clearDepth     = 1.0f,
-        .stencilLoadOp  = WGPULoadOp_Clear,
-        .stencilStoreOp = WGPUStoreOp_Store,
-        .clearStencil   = 0,
-      };
-    color_render_pass.descriptor = (WGPURenderPassDescriptor){
-      .colorAttachmentCount   = 1,
-      .colorAttachments       = color_render_pass.color_attachments,
-      .depthStencilAttachment = &color_render_pass.depth_stencil_attachment,
-      .occlusionQuerySet      = NULL,
-    };
-  }
+  // The dragon and the ground plane are static, only the near cascade is
+  // rendered every frame
+  cascaded_shadow_map = wgpu_cascaded_shadow_map_create(
+    wgpu_context, &(wgpu_cascaded_shadow_map_desc_t){
+                    .cascade_count           = 4,
+                    .size                    = 2048,
+                    .split_lambda            = 0.75f,
+                    .dynamic_cascade_count   = 1,
+                    .caster_distance         = 300.0f,
+                    .model_bind_group_layout
+                    = bind_groups_layouts.uniform_buffer_model,
+                  });
 }
 
-static void prepare_view_matrices(wgpu_context_t* wgpu_context)
+static void prepare_shadow_atlas(wgpu_context_t* wgpu_context)
 {
-  const float aspect_ratio
-    = (float)wgpu_context->surface.width / (float)wgpu_context->surface.height;
-
-  vec3 eye_position = {0.0f, 50.0f, -100.0f};
-  memcpy(view_matrices.up_vector, (vec3){0.0f, 1.0f, 0.0f}, sizeof(vec3));
-  memcpy(view_matrices.origin, (vec3){0.0f, 0.0f, 0.0f}, sizeof(vec3));
-
-  glm_mat4_identity(view_matrices.projection_matrix);
-  glm_perspective((2.0f * PI) / 5.0f, aspect_ratio, 1.f, 2000.f,
-                  view_matrices.projection_matrix);
-
-  mat4 view_matrix = GLM_MAT4_IDENTITY_INIT;
-  glm_lookat(eye_position,            // eye vector
-             view_matrices.origin,    // center vector
-             view_matrices.up_vector, // up vector
-             view_matrix              // result matrix
-  );
-
-  vec3 light_position    = {50.0f, 100.0f, -100.0f};
-  mat4 light_view_matrix = GLM_MAT4_IDENTITY_INIT;
-  glm_lookat(light_position,          // eye vector
-             view_matrices.origin,    // center vector
-             view_matrices.up_vector, // up vector
-             light_view_matrix        // result matrix
-  );
-
-  mat4 light_projection_matrix = GLM_MAT4_IDENTITY_INIT;
-  {
-    const float left   = -80.0f;
-    const float right  = 80.0f;
-    const float bottom = -80.0f;
-    const float top    = 80.0f;
-    const float near   = -200.0f;
-    const float far    = 300.0f;
-    glm_ortho(left, right, bottom, top, near, far, light_projection_matrix);
-  }
-
-  mat4 light_view_proj_matrix = GLM_MAT4_IDENTITY_INIT;
-  glm_mat4_mulN((mat4*[]){&light_projection_matrix, &light_view_matrix}, 2,
-                light_view_proj_matrix);
-
-  glm_mat4_identity(view_matrices.view_proj_matrix);
-  glm_mat4_mulN((mat4*[]){&view_matrices.projection_matrix, &view_matrix}, 2,
-                view_matrices.view_proj_matrix);
+  shadow_atlas = wgpu_shadow_atlas_create(
+    wgpu_context, &(wgpu_shadow_atlas_desc_t){
+                    .size                    = 2048,
+                    .model_bind_group_layout
+                    = bind_groups_layouts.uniform_buffer_model,
+                  });
+}
 
-  // Move the model so it's centered.
-  mat4 model_matrix = GLM_MAT4_IDENTITY_INIT;
-  glm_translate(model_matrix, (vec3){0.0f, -5.0f, 0.0f});
-  glm_translate(model_matrix, (vec3){0.0f, -40.0f, 0.0f});
+static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
+{
+  // Specify the pipeline layout. The layout for the model is the same as the
+  // one of the depth-only pipeline of the shadow map.
+  WGPUBindGroupLayout bind_group_layouts[4] = {
+    bind_groups_layouts.uniform_buffer_scene, // Group 0
+    bind_groups_layouts.uniform_buffer_model, // Group 1
+    wgpu_cascaded_shadow_map_get_bind_group_layout(
+      cascaded_shadow_map), // Group 2
+    wgpu_shadow_atlas_get_bind_group_layout(shadow_atlas), // Group 3
+  };
+  pipeline_layouts.color = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(pipeline_layouts.color != NULL);
+}
 
-  // The camera/light aren't moving, so write them into buffers now.
-  {
-    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.scene, 0,
-                         light_view_proj_matrix, sizeof(mat4));
+static void setup_render_pass(wgpu_context_t* wgpu_context)
+{
+  UNUSED_VAR(wgpu_context);
 
-    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.scene, 64,
-                         view_matrices.view_proj_matrix, sizeof(mat4));
+  // Color attachment
+  color_render_pass.color_attachments[0] = (WGPURenderPassColorAttachment) {
+    .view       = NULL, // view is acquired and set in render loop.
+    .loadOp     = WGPULoadOp_Clear,
+    .storeOp    = WGPUStoreOp_Store,
+    .clearColor = (WGPUColor) {
+      .r = 0.5f,
+      .g = 0.5f,
+      .b = 0.5f,
+      .a = 1.0f,
+    },
+  };
 
-    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.scene, 128,
-                         light_position, sizeof(vec3));
+  // Render pass descriptor
+  color_render_pass.depth_stencil_attachment
+    = (WGPURenderPassDepthStencilAttachment){
+      .view           = textures.depth_texture.view,
+      .depthLoadOp    = WGPULoadOp_Clear,
+      .depthStoreOp   = WGPUStoreOp_Store,
+      .clearDepth     = 1.0f,
+      .stencilLoadOp  = WGPULoadOp_Clear,
+      .stencilStoreOp = WGPUStoreOp_Store,
+      .clearStencil   = 0,
+    };
+  color_render_pass.descriptor = (WGPURenderPassDescriptor){
+    .colorAttachmentCount   = 1,
+    .colorAttachments       = color_render_pass.color_attachments,
+    .depthStencilAttachment = &color_render_pass.depth_stencil_attachment,
+    .occlusionQuerySet      = NULL,
+  };
+}
 
-    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.model, 0,
-                         model_matrix, sizeof(mat4));
-  }
+// Fits the cascades to the camera, the light shines to the origin
+static void update_cascaded_shadow_map(void)
+{
+  wgpu_cascaded_shadow_map_view_t shadow_view = {
+    .z_near          = z_near,
+    .shadow_distance = shadow_distance,
+  };
+  glm_mat4_copy(view_matrices.view_matrix, shadow_view.view_matrix);
+  glm_mat4_copy(view_matrices.projection_matrix,
+                shadow_view.projection_matrix);
+  glm_vec3_sub(view_matrices.origin, light_position,
+               shadow_view.light_direction);
+  wgpu_cascaded_shadow_map_update(cascaded_shadow_map, &shadow_view);
 }
 
 /**
@@ -548,31 +536,130 @@ static void glm_vec3_rotate_y(vec3 a, vec3 b, float rad, vec3* out)
   (*out)[2] = r[2] + b[2];
 }
 
+// Places the spot lights and assigns their tiles in the shadow atlas, the
+// second light circles around the dragon
+static void update_spot_lights(wgpu_context_t* wgpu_context,
+                               float timestamp_millis)
+{
+  static const struct {
+    vec3 position;
+    float angle;
+    vec4 color;
+  } spot_light_defs[SPOT_LIGHT_COUNT] = {
+    {{-60.0f, 60.0f, -40.0f}, PI / 6.0f, {0.6f, 0.45f, 0.3f, 1.0f}},
+    {{80.0f, 70.0f, 0.0f}, PI / 8.0f, {0.2f, 0.35f, 0.6f, 1.0f}},
+  };
+  static const vec3 target = {0.0f, -20.0f, 0.0f};
+  static const float far   = 300.0f;
+
+  for (uint32_t i = 0; i < SPOT_LIGHT_COUNT; ++i) {
+    spot_light_t* spot                = &spot_lights.params[i];
+    wgpu_shadow_atlas_light_t* shadow = &spot_lights.shadows[i];
+    glm_vec3_copy((float*)spot_light_defs[i].position, spot->position);
+    if (i == 1) {
+      const float rad = PI * (timestamp_millis / 4000.0f);
+      glm_vec3_rotate_y(spot->position, view_matrices.origin, rad,
+                        &spot->position);
+    }
+    glm_vec3_sub((float*)target, spot->position, spot->direction);
+    glm_vec3_normalize(spot->direction);
+    spot->cos_outer = cosf(spot_light_defs[i].angle);
+    spot->cos_inner = cosf(spot_light_defs[i].angle * 0.8f);
+    glm_vec4_copy((float*)spot_light_defs[i].color, spot->color);
+
+    // The static light gets the larger tile
+    mat4 view_matrix, projection_matrix;
+    glm_lookat(spot->position, (float*)target, view_matrices.up_vector,
+               view_matrix);
+    perspective_zo(&projection_matrix, 2.0f * spot_light_defs[i].angle, 1.0f,
+                   1.0f, &far);
+    glm_mat4_mul(projection_matrix, view_matrix, shadow->view_projection);
+    shadow->importance = (i == 0) ? 1.0f : 0.25f;
+    shadow->is_static  = (i == 0);
+  }
+
+  wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.scene,
+                       spot_lights_offset, spot_lights.params,
+                       sizeof(spot_lights.params));
+  wgpu_shadow_atlas_update(shadow_atlas, spot_lights.shadows,
+                           SPOT_LIGHT_COUNT);
+}
+
+static void prepare_view_matrices(wgpu_context_t* wgpu_context)
+{
+  const float aspect_ratio
+    = (float)wgpu_context->surface.width / (float)wgpu_context->surface.height;
+
+  glm_vec3_copy((vec3){0.0f, 50.0f, -100.0f}, view_matrices.eye_position);
+  memcpy(view_matrices.up_vector, (vec3){0.0f, 1.0f, 0.0f}, sizeof(vec3));
+  memcpy(view_matrices.origin, (vec3){0.0f, 0.0f, 0.0f}, sizeof(vec3));
+
+  glm_mat4_identity(view_matrices.projection_matrix);
+  glm_perspective((2.0f * PI) / 5.0f, aspect_ratio, z_near, z_far,
+                  view_matrices.projection_matrix);
+
+  glm_mat4_identity(view_matrices.view_matrix);
+  glm_lookat(view_matrices.eye_position, // eye vector
+             view_matrices.origin,       // center vector
+             view_matrices.up_vector,    // up vector
+             view_matrices.view_matrix   // result matrix
+  );
+
+  glm_mat4_identity(view_matrices.view_proj_matrix);
+  glm_mat4_mulN(
+    (mat4*[]){&view_matrices.projection_matrix, &view_matrices.view_matrix},
+    2, view_matrices.view_proj_matrix);
+
+  // Move the model so it's centered.
+  glm_mat4_identity(view_matrices.model_matrix);
+  glm_translate(view_matrices.model_matrix, (vec3){0.0f, -5.0f, 0.0f});
+  glm_translate(view_matrices.model_matrix, (vec3){0.0f, -40.0f, 0.0f});
+
+  // The light isn't moving, so write it into the buffer now.
+  {
+    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.scene, 0,
+                         view_matrices.view_proj_matrix, sizeof(mat4));
+
+    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.scene, 64,
+                         light_position, sizeof(vec3));
+
+    wgpuQueueWriteBuffer(wgpu_context->queue, uniform_buffers.model, 0,
+                         view_matrices.model_matrix, sizeof(mat4));
+  }
+
+  update_cascaded_shadow_map();
+  update_spot_lights(wgpu_context, 0.0f);
+}
+
 // Rotates the camera around the origin based on time.
 static mat4* get_camera_view_proj_matrix(wgpu_example_context_t* context)
 {
   vec3 eye_position = {0.0f, 50.0f, -100.0f};
 
   float rad = PI * (context->frame.timestamp_millis / 2000.0f);
-  glm_vec3_rotate_y(eye_position, view_matrices.origin, rad, &eye_position);
-
-  mat4 view_matrix = GLM_MAT4_IDENTITY_INIT;
-  glm_lookat(eye_position,            // eye vector
-             view_matrices.origin,    // center vector
-             view_matrices.up_vector, // up vector
-             view_matrix              // result matrix
+  glm_vec3_rotate_y(eye_position, view_matrices.origin, rad,
+                    &view_matrices.eye_position);
+
+  glm_mat4_identity(view_matrices.view_matrix);
+  glm_lookat(view_matrices.eye_position, // eye vector
+             view_matrices.origin,       // center vector
+             view_matrices.up_vector,    // up vector
+             view_matrices.view_matrix   // result matrix
   );
 
-  glm_mat4_mulN((mat4*[]){&view_matrices.projection_matrix, &view_matrix}, 2,
-                view_matrices.view_proj_matrix);
+  glm_mat4_mulN(
+    (mat4*[]){&view_matrices.projection_matrix, &view_matrices.view_matrix},
+    2, view_matrices.view_proj_matrix);
   return &view_matrices.view_proj_matrix;
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
   mat4* camera_view_proj = get_camera_view_proj_matrix(context);
-  wgpuQueueWriteBuffer(context->wgpu_context->queue, uniform_buffers.scene, 64,
+  wgpuQueueWriteBuffer(context->wgpu_context->queue, uniform_buffers.scene, 0,
                        *camera_view_proj, sizeof(mat4));
+  update_cascaded_shadow_map();
+  update_spot_lights(context->wgpu_context, context->frame.timestamp_millis);
 }
 
 static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
@@ -593,56 +680,30 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
     uniform_buffers.scene = wgpuDeviceCreateBuffer(
       wgpu_context->device,
       &(WGPUBufferDescriptor){
-        // Two 4x4 viewProj matrices, one for the camera and one for the light.
-        // Then a vec3 for the light position.
-        .size  = sizeof(mat4) + sizeof(mat4) + sizeof(vec3),
+        // The 4x4 viewProj matrix of the camera, then a vec3 for the light
+        // position padded to a vec4 and the spot lights.
+        .size  = scene_buffer_size,
         .usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst,
       });
     ASSERT(uniform_buffers.scene);
   }
 
-  // Scene bind group for shadow
+  // Scene bind group for render
   {
     WGPUBindGroupEntry bg_entries[1] = {
       [0] = (WGPUBindGroupEntry) {
         .binding = 0,
         .buffer  = uniform_buffers.scene,
-        .size    = sizeof(mat4) + sizeof(mat4) + sizeof(vec3),
+        .size    = scene_buffer_size,
       },
     };
-    bind_groups.scene_shadow = wgpuDeviceCreateBindGroup(
+    bind_groups.scene_render = wgpuDeviceCreateBindGroup(
       wgpu_context->device,
       &(WGPUBindGroupDescriptor){
         .layout     = bind_groups_layouts.uniform_buffer_scene,
         .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
         .entries    = bg_entries,
       });
-    ASSERT(bind_groups.scene_shadow != NULL);
-  }
-
-  // Scene bind group for render
-  {
-    WGPUBindGroupEntry bg_entries[3] = {
-      [0] = (WGPUBindGroupEntry) {
-        .binding = 0,
-        .buffer  = uniform_buffers.scene,
-        .size    = sizeof(mat4) + sizeof(mat4) + sizeof(vec3),
-      },
-      [1] = (WGPUBindGroupEntry) {
-        .binding     = 1,
-        .textureView = textures.shadow_depth_texture.view,
-      },
-      [2] = (WGPUBindGroupEntry) {
-        .binding = 2,
-        .sampler = textures.sampler,
-      },
-    };
-    bind_groups.scene_render = wgpuDeviceCreateBindGroup(
-      wgpu_context->device, &(WGPUBindGroupDescriptor){
-                              .layout     = bind_groups_layouts.render,
-                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                              .entries    = bg_entries,
-                            });
     ASSERT(bind_groups.scene_render != NULL);
   }
 
@@ -666,69 +727,6 @@ static void prepare_uniform_buffers(wgpu_context_t* wgpu_context)
   }
 }
 
-// Create the shadow pipeline
-static void prepare_shadow_pipeline(wgpu_context_t* wgpu_context)
-{
-  /// Primitive state
-  WGPUPrimitiveState primitive_state = {
-    .topology  = WGPUPrimitiveTopology_TriangleList,
-    .frontFace = WGPUFrontFace_CCW,
-    .cullMode  = WGPUCullMode_Back,
-  };
-
-  // Depth stencil state
-  WGPUDepthStencilState depth_stencil_state
-    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
-      .format              = WGPUTextureFormat_Depth32Float,
-      .depth_write_enabled = true,
-    });
-  depth_stencil_state.depthCompare = WGPUCompareFunction_Less;
-
-  /// Vertex buffer layout
-  WGPU_VERTEX_BUFFER_LAYOUT(
-    shadow, sizeof(float) * 6,
-    // Attribute location 0: Position
-    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0),
-    // Attribute location 1: Normal
-    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x3, sizeof(float) * 3))
-
-  // Vertex state
-  WGPUVertexState vertex_state = wgpu_create_vertex_state(
-                wgpu_context, &(wgpu_vertex_state_t){
-                .shader_desc = (wgpu_shader_desc_t){
-                  // Vertex shader WGSL
-                  .label = "vertex_shadow_shader",
-                  .file  = "shaders/shadow_mapping/vertexShadow.wgsl",
-                  .entry = "main",
-                },
-                .buffer_count = 1,
-                .buffers      = &shadow_vertex_buffer_layout,
-              });
-
-  // Multisample state
-  WGPUMultisampleState multisample_state
-    = wgpu_create_multisample_state_descriptor(
-      &(create_multisample_state_desc_t){
-        .sample_count = 1,
-      });
-
-  // Create rendering pipeline using the specified states
-  render_pipelines.shadow = wgpuDeviceCreateRenderPipeline(
-    wgpu_context->device, &(WGPURenderPipelineDescriptor){
-                            .label        = "shadow_render_pipeline",
-                            .layout       = pipeline_layouts.shadow,
-                            .primitive    = primitive_state,
-                            .vertex       = vertex_state,
-                            .fragment     = NULL,
-                            .depthStencil = &depth_stencil_state,
-                            .multisample  = multisample_state,
-                          });
-  ASSERT(render_pipelines.shadow != NULL);
-
-  // Partial cleanup
-  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
-}
-
 // Create the color rendering pipeline
 static void prepare_color_rendering_pipeline(wgpu_context_t* wgpu_context)
 {
@@ -775,27 +773,40 @@ static void prepare_color_rendering_pipeline(wgpu_context_t* wgpu_context)
     .stencilWriteMask = 0xFFFFFFFF,
   };
 
-  // Vertex buffer layout
-  // Create some common descriptors used for both the shadow pipeline and the
-  // color rendering pipeline.
+  // Vertex buffer layouts, positions and normals are read from two buffers
   WGPU_VERTEX_BUFFER_LAYOUT(
-    color, sizeof(float) * 6,
+    position, sizeof(float) * 3,
     // Attribute location 0: Position
-    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0),
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0))
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    normal, sizeof(float) * 3,
     // Attribute location 1: Normal
-    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x3, sizeof(float) * 3))
+    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x3, 0))
+  WGPUVertexBufferLayout color_buffer_layouts[2] = {
+    position_vertex_buffer_layout,
+    normal_vertex_buffer_layout,
+  };
+
+  // Shader, with the shadow lookup functions
+  const char* shadow_wgsl = wgpu_cascaded_shadow_map_get_wgsl_functions();
+  const char* atlas_wgsl  = wgpu_shadow_atlas_get_wgsl_functions();
+  const size_t wgsl_size  = strlen(shadow_wgsl) + strlen(atlas_wgsl)
+                           + strlen(shadow_mapping_shader_wgsl) + 3;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s\n%s", shadow_wgsl, atlas_wgsl,
+           shadow_mapping_shader_wgsl);
 
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
                 wgpu_context, &(wgpu_vertex_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
                   // Vertex shader WGSL
-                  .label = "vertex_shader",
-                  .file  = "shaders/shadow_mapping/vertex.wgsl",
-                  .entry = "main",
+                  .label            = "vertex_shader",
+                  .wgsl_code.source = wgsl,
+                  .entry            = "vs_main",
                 },
-                .buffer_count = 1,
-                .buffers      = &color_vertex_buffer_layout,
+                .buffer_count = (uint32_t)ARRAY_SIZE(color_buffer_layouts),
+                .buffers      = color_buffer_layouts,
               });
 
   // Fragment state
@@ -803,13 +814,14 @@ static void prepare_color_rendering_pipeline(wgpu_context_t* wgpu_context)
                 wgpu_context, &(wgpu_fragment_state_t){
                 .shader_desc = (wgpu_shader_desc_t){
                   // Fragment shader WGSL
-                  .label = "fragment_shader",
-                  .file  = "shaders/shadow_mapping/fragment.wgsl",
-                  .entry = "main",
+                  .label            = "fragment_shader",
+                  .wgsl_code.source = wgsl,
+                  .entry            = "fs_main",
                 },
                 .target_count = 1,
                 .targets      = &color_target_state,
               });
+  free(wgsl);
 
   // Multisample state
   WGPUMultisampleState multisample_state
@@ -842,10 +854,12 @@ static int example_initialize(wgpu_example_context_t* context)
     stanford_dragon_mesh_init(&stanford_dragon_mesh);
     prepare_vertex_and_index_buffers(context->wgpu_context,
                                      &stanford_dragon_mesh);
+    prepare_meshlet_culling(context->wgpu_context, &stanford_dragon_mesh);
     prepare_texture(context->wgpu_context);
-    prepare_sampler(context->wgpu_context);
+    setup_bind_group_layouts(context->wgpu_context);
+    prepare_cascaded_shadow_map(context->wgpu_context);
+    prepare_shadow_atlas(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
-    prepare_shadow_pipeline(context->wgpu_context);
     prepare_color_rendering_pipeline(context->wgpu_context);
     prepare_uniform_buffers(context->wgpu_context);
     prepare_view_matrices(context->wgpu_context);
@@ -861,51 +875,108 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
     imgui_overlay_checkBox(context->imgui_overlay, "Paused", &context->paused);
+    imgui_overlay_text("Rendered cascades: %u", rendered_cascade_count);
+    imgui_overlay_text("Rendered atlas tiles: %u", rendered_tile_count);
   }
 }
 
-static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
+// Draws the shadow casters into a cascade or into the atlas tile of a spot
+// light, all of them are static
+static void draw_shadow_casters(WGPURenderPassEncoder shadow_pass,
+                                uint32_t index, bool static_only,
+                                void* user_data)
 {
-  wgpu_context->cmd_enc
+  UNUSED_VAR(index);
+  UNUSED_VAR(static_only);
+  UNUSED_VAR(user_data);
+
+  wgpuRenderPassEncoderSetBindGroup(shadow_pass, 1, bind_groups.model, 0, 0);
+  wgpuRenderPassEncoderSetVertexBuffer(shadow_pass, 0, vertex_buffers.positions,
+                                       0, WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderSetIndexBuffer(shadow_pass, index_buffer,
+                                      WGPUIndexFormat_Uint16, 0,
+                                      WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderDrawIndexed(shadow_pass, index_count, 1, 0, 0, 0);
+}
+
+// Shadow passes of the cascades and the atlas tiles which are not cached, on a
+// worker thread
+static void encode_shadow_passes(WGPUCommandEncoder cmd_enc, void* user_data)
+{
+  UNUSED_VAR(user_data);
+
+  rendered_cascade_count = wgpu_cascaded_shadow_map_render(
+    cascaded_shadow_map, cmd_enc, draw_shadow_casters, NULL);
+  rendered_tile_count = wgpu_shadow_atlas_render(shadow_atlas, cmd_enc,
+                                                 draw_shadow_casters, NULL);
+}
+
+// Color render pass, on a worker thread. It samples the cascades, so its
+// command buffer is submitted after the one of the shadow passes.
+static void encode_color_pass(WGPUCommandEncoder cmd_enc, void* user_data)
+{
+  UNUSED_VAR(user_data);
+
+  WGPURenderPassEncoder render_pass = wgpuCommandEncoderBeginRenderPass(
+    cmd_enc, &color_render_pass.descriptor);
+  wgpuRenderPassEncoderSetPipeline(render_pass, render_pipelines.color);
+  wgpuRenderPassEncoderSetBindGroup(render_pass, 0, bind_groups.scene_render, 0,
+                                    0);
+  wgpuRenderPassEncoderSetBindGroup(render_pass, 1, bind_groups.model, 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(
+    render_pass, 2,
+    wgpu_cascaded_shadow_map_get_bind_group(cascaded_shadow_map), 0, 0);
+  wgpuRenderPassEncoderSetBindGroup(
+    render_pass, 3, wgpu_shadow_atlas_get_bind_group(shadow_atlas), 0, 0);
+  wgpuRenderPassEncoderSetVertexBuffer(render_pass, 0, vertex_buffers.positions,
+                                       0, WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderSetVertexBuffer(render_pass, 1, vertex_buffers.normals,
+                                       0, WGPU_WHOLE_SIZE);
+  // The visible meshlets of the dragon
+  wgpu_meshlet_culling_draw(meshlet_culling, render_pass);
+  // The ground plane, after the triangles of the dragon
+  wgpuRenderPassEncoderSetIndexBuffer(render_pass, index_buffer,
+                                      WGPUIndexFormat_Uint16, 0,
+                                      WGPU_WHOLE_SIZE);
+  const uint32_t first_index = stanford_dragon_mesh.triangles.count * 3;
+  wgpuRenderPassEncoderDrawIndexed(render_pass, index_count - first_index, 1,
+                                   first_index, 0, 0);
+
+  wgpuRenderPassEncoderEnd(render_pass);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, render_pass)
+}
+
+// The meshlet culling writes its parameters to the queue, so it is recorded on
+// the main thread and submitted before the color pass
+static WGPUCommandBuffer build_culling_command_buffer(
+  wgpu_context_t* wgpu_context)
+{
+  wgpu_meshlet_culling_options_t options = {0};
+  glm_mat4_copy(view_matrices.model_matrix, options.model);
+  glm_mat4_copy(view_matrices.view_proj_matrix, options.view_projection);
+  glm_vec3_copy(view_matrices.eye_position, options.camera_position);
+
+  WGPUCommandEncoder cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder compute_pass
+    = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+  wgpu_meshlet_culling_dispatch(meshlet_culling, compute_pass, &options);
+  wgpuComputePassEncoderEnd(compute_pass);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, compute_pass)
 
-  // Shadow pass
-  {
-    WGPURenderPassEncoder shadow_pass = wgpuCommandEncoderBeginRenderPass(
-      wgpu_context->cmd_enc, &shadow_render_pass.descriptor);
-    wgpuRenderPassEncoderSetPipeline(shadow_pass, render_pipelines.shadow);
-    wgpuRenderPassEncoderSetBindGroup(shadow_pass, 0, bind_groups.scene_shadow,
-                                      0, 0);
-    wgpuRenderPassEncoderSetBindGroup(shadow_pass, 1, bind_groups.model, 0, 0);
-    wgpuRenderPassEncoderSetVertexBuffer(shadow_pass, 0, vertex_buffer, 0,
-                                         WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderSetIndexBuffer(
-      shadow_pass, index_buffer, WGPUIndexFormat_Uint16, 0, WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderDrawIndexed(shadow_pass, index_count, 1, 0, 0, 0);
-
-    wgpuRenderPassEncoderEnd(shadow_pass);
-    WGPU_RELEASE_RESOURCE(RenderPassEncoder, shadow_pass)
-  }
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  ASSERT(command_buffer != NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
 
-  // Color render pass
-  {
-    color_render_pass.color_attachments[0].view
-      = wgpu_context->swap_chain.frame_buffer;
-    WGPURenderPassEncoder render_pass = wgpuCommandEncoderBeginRenderPass(
-      wgpu_context->cmd_enc, &color_render_pass.descriptor);
-    wgpuRenderPassEncoderSetPipeline(render_pass, render_pipelines.color);
-    wgpuRenderPassEncoderSetBindGroup(render_pass, 0, bind_groups.scene_render,
-                                      0, 0);
-    wgpuRenderPassEncoderSetBindGroup(render_pass, 1, bind_groups.model, 0, 0);
-    wgpuRenderPassEncoderSetVertexBuffer(render_pass, 0, vertex_buffer, 0,
-                                         WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderSetIndexBuffer(
-      render_pass, index_buffer, WGPUIndexFormat_Uint16, 0, WGPU_WHOLE_SIZE);
-    wgpuRenderPassEncoderDrawIndexed(render_pass, index_count, 1, 0, 0, 0);
-
-    wgpuRenderPassEncoderEnd(render_pass);
-    WGPU_RELEASE_RESOURCE(RenderPassEncoder, render_pass)
-  }
+  return command_buffer;
+}
+
+// The overlay is drawn on the main thread, over the color pass
+static WGPUCommandBuffer build_overlay_command_buffer(
+  wgpu_context_t* wgpu_context)
+{
+  wgpu_context->cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
   // Draw ui overlay
   draw_ui(wgpu_context->context, example_on_update_ui_overlay);
@@ -919,16 +990,35 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   return command_buffer;
 }
 
+static void build_command_buffers(wgpu_context_t* wgpu_context)
+{
+  color_render_pass.color_attachments[0].view
+    = wgpu_context->swap_chain.frame_buffer;
+
+  // Command buffers of the culling, the shadow passes and the color pass, in
+  // this order
+  static const wgpu_encode_pass_desc_t passes[2] = {
+    {.label = "shadow_passes", .func = encode_shadow_passes},
+    {.label = "color_pass", .func = encode_color_pass},
+  };
+  wgpu_context->submit_info.command_buffer_count = 0;
+  wgpu_context->submit_info
+    .command_buffers[wgpu_context->submit_info.command_buffer_count++]
+    = build_culling_command_buffer(wgpu_context);
+  wgpu_encode_passes(wgpu_context, NULL, passes, (uint32_t)ARRAY_SIZE(passes));
+
+  wgpu_context->submit_info
+    .command_buffers[wgpu_context->submit_info.command_buffer_count++]
+    = build_overlay_command_buffer(wgpu_context);
+}
+
 static int example_draw(wgpu_example_context_t* context)
 {
   // Prepare frame
   prepare_frame(context);
 
-  // Command buffer to be submitted to the queue
-  wgpu_context_t* wgpu_context                   = context->wgpu_context;
-  wgpu_context->submit_info.command_buffer_count = 1;
-  wgpu_context->submit_info.command_buffers[0]
-    = build_command_buffer(context->wgpu_context);
+  // Command buffers to be submitted to the queue
+  build_command_buffers(context->wgpu_context);
 
   // Submit to queue
   submit_command_buffers(context);
@@ -955,27 +1045,24 @@ static int example_render(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
-  WGPU_RELEASE_RESOURCE(Buffer, vertex_buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, vertex_buffers.positions)
+  WGPU_RELEASE_RESOURCE(Buffer, vertex_buffers.normals)
   WGPU_RELEASE_RESOURCE(Buffer, index_buffer)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.model)
   WGPU_RELEASE_RESOURCE(Buffer, uniform_buffers.scene)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.shadow)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layouts.color)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, render_pipelines.shadow);
   WGPU_RELEASE_RESOURCE(RenderPipeline, render_pipelines.color)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.scene_shadow)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.scene_render)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.model)
   WGPU_RELEASE_RESOURCE(BindGroupLayout,
                         bind_groups_layouts.uniform_buffer_scene)
   WGPU_RELEASE_RESOURCE(BindGroupLayout,
                         bind_groups_layouts.uniform_buffer_model)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_groups_layouts.render)
-  WGPU_RELEASE_RESOURCE(Sampler, textures.sampler)
   WGPU_RELEASE_RESOURCE(Texture, textures.depth_texture.texture)
   WGPU_RELEASE_RESOURCE(TextureView, textures.depth_texture.view)
-  WGPU_RELEASE_RESOURCE(Texture, textures.shadow_depth_texture.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, textures.shadow_depth_texture.view)
+  wgpu_cascaded_shadow_map_release(cascaded_shadow_map);
+  wgpu_meshlet_culling_release(meshlet_culling);
+  wgpu_shadow_atlas_release(shadow_atlas);
 }
 
 void example_shadow_mapping(int argc, char* argv[])
@@ -1,14 +1,16 @@
 #include "example_base.h"
 #include "examples.h"
 
-#include <string.h>
-
+#include "../webgpu/skybox.h"
 #include "../webgpu/texture.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Skybox
  *
- * This example shows how to render a skybox.
+ * This example shows how to render a skybox. The skybox is drawn last, at the
+ * far plane with a depth test, so that only the pixels no scene geometry
+ * covers sample the cubemap. The cubemap is loaded compressed in BC6H when the
+ * device supports BC textures and the KTX2 file exists.
  *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/tree/master/examples/texturecubemap
@@ -17,20 +19,8 @@
  * http://www.humus.name/index.php?page=Textures&ID=139
  * -------------------------------------------------------------------------- */
 
-// Uniform block vertex shader
-static struct {
-  mat4 projection_matrix;
-  mat4 view_matrix;
-} ubo_vs = {0};
-
-// Uniform buffer block object
-static struct wgpu_buffer_t uniform_buffer_vs = {0};
-
-// The pipeline layout
-static WGPUPipelineLayout pipeline_layout;
-
-// Pipeline
-static WGPURenderPipeline pipeline;
+// Skybox drawn behind the scene at the far plane
+static wgpu_skybox_t* skybox = NULL;
 
 // Render pass descriptor for frame buffer writes
 static struct {
@@ -38,10 +28,6 @@ static struct {
   WGPURenderPassDescriptor descriptor;
 } render_pass = {0};
 
-// Bind groups stores the resources bound to the binding points in a shader
-static WGPUBindGroup bind_group;
-static WGPUBindGroupLayout bind_group_layout;
-
 // Texture and sampler
 static texture_t texture;
 
@@ -61,69 +47,18 @@ static void setup_camera(wgpu_example_context_t* context)
                          context->window_size.aspect_ratio, 0.1f, 256.0f);
 }
 
-static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
-{
-  WGPUBindGroupLayoutEntry bgl_entries[3] = {
-    [0] = (WGPUBindGroupLayoutEntry) {
-      // Transform
-      .binding    = 0,
-      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
-      .buffer = (WGPUBufferBindingLayout) {
-        .type             = WGPUBufferBindingType_Uniform,
-        .hasDynamicOffset = false,
-        .minBindingSize   = 128,
-      },
-      .sampler = {0},
-    },
-    [1] = (WGPUBindGroupLayoutEntry) {
-      // Texture view
-      .binding    = 1,
-      .visibility = WGPUShaderStage_Fragment,
-      .texture = (WGPUTextureBindingLayout) {
-        .sampleType    = WGPUTextureSampleType_Float,
-        .viewDimension = WGPUTextureViewDimension_Cube,
-        .multisampled  = false,
-      },
-      .storageTexture = {0},
-    },
-    [2] = (WGPUBindGroupLayoutEntry) {
-      // Sampler
-      .binding    = 2,
-      .visibility = WGPUShaderStage_Fragment,
-      .sampler = (WGPUSamplerBindingLayout){
-        .type = WGPUSamplerBindingType_Filtering,
-      },
-      .texture = {0},
-    }
-  };
-  bind_group_layout = wgpuDeviceCreateBindGroupLayout(
-    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
-                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
-                            .entries    = bgl_entries,
-                          });
-  ASSERT(bind_group_layout != NULL);
-
-  // Create the pipeline layout that is used to generate the rendering pipelines
-  // that are based on this bind group layout
-  pipeline_layout = wgpuDeviceCreatePipelineLayout(
-    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
-                            .bindGroupLayoutCount = 1,
-                            .bindGroupLayouts     = &bind_group_layout,
-                          });
-  ASSERT(pipeline_layout != NULL);
-}
-
 // Upload texture image data to the GPU
 static void load_texture(wgpu_context_t* wgpu_context)
 {
-  texture = wgpu_create_texture_from_file(
-    wgpu_context, "textures/cubemap_yokohama_rgba.ktx", NULL);
+  texture = wgpu_skybox_load_cubemap(
+    wgpu_context, &(wgpu_skybox_cubemap_desc_t){
+                    .bc6h_filename = "textures/cubemap_yokohama_bc6h.ktx2",
+                    .filename      = "textures/cubemap_yokohama_rgba.ktx",
+                  });
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
 {
-  UNUSED_VAR(wgpu_context);
-
   // Color attachment
   render_pass.color_attachments[0] = (WGPURenderPassColorAttachment) {
       .view       = NULL, // Assigned later
@@ -137,141 +72,39 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
       },
   };
 
+  // Depth attachment, cleared to the far plane
+  wgpu_setup_deph_stencil(wgpu_context, NULL);
+
   // Render pass descriptor
   render_pass.descriptor = (WGPURenderPassDescriptor){
     .colorAttachmentCount   = 1,
     .colorAttachments       = render_pass.color_attachments,
-    .depthStencilAttachment = NULL,
+    .depthStencilAttachment = &wgpu_context->depth_stencil.att_desc,
   };
 }
 
 static void update_uniform_buffers(wgpu_example_context_t* context)
 {
-  // Pass matrices to the shaders
-  memcpy(ubo_vs.projection_matrix, context->camera->matrices.perspective,
-         sizeof(mat4));
-  memcpy(ubo_vs.view_matrix, context->camera->matrices.view, sizeof(mat4));
-
-  // Map uniform buffer and update it
-  wgpu_queue_write_buffer(context->wgpu_context, uniform_buffer_vs.buffer, 0,
-                          &ubo_vs, sizeof(ubo_vs));
+  wgpu_skybox_set_view_projection(skybox, context->camera->matrices.view,
+                                  context->camera->matrices.perspective);
 }
 
-static void prepare_uniform_buffers(wgpu_example_context_t* context)
+static void prepare_skybox(wgpu_example_context_t* context)
 {
-  wgpu_context_t* wgpu_context = context->wgpu_context;
-
-  // Create the uniform bind group
-  uniform_buffer_vs = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-                    .size  = sizeof(ubo_vs),
-                    .initial.data = &ubo_vs,
-                  });
-
+  skybox = wgpu_skybox_create(context->wgpu_context,
+                              &(wgpu_skybox_desc_t){
+                                .cubemap_view = texture.view,
+                                .sampler      = texture.sampler,
+                              });
   update_uniform_buffers(context);
-
-  WGPUBindGroupEntry bg_entries[3] = {
-    [0] = (WGPUBindGroupEntry) {
-      .binding = 0,
-      .buffer  = uniform_buffer_vs.buffer,
-      .offset  = 0,
-      .size    = uniform_buffer_vs.size,
-    },
-    [1] = (WGPUBindGroupEntry) {
-      .binding     = 1,
-      .textureView = texture.view,
-    },
-    [2] = (WGPUBindGroupEntry) {
-      .binding = 2,
-      .sampler = texture.sampler,
-    },
-  };
-  bind_group = wgpuDeviceCreateBindGroup(
-    wgpu_context->device, &(WGPUBindGroupDescriptor){
-                            .layout     = bind_group_layout,
-                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
-                            .entries    = bg_entries,
-                          });
-  ASSERT(bind_group != NULL);
-}
-
-static void prepare_pipelines(wgpu_context_t* wgpu_context)
-{
-  // Primitive state
-  WGPUPrimitiveState primitive_state = {
-    .topology  = WGPUPrimitiveTopology_TriangleList,
-    .frontFace = WGPUFrontFace_CCW,
-    .cullMode  = WGPUCullMode_None,
-  };
-
-  // Color target state
-  WGPUBlendState blend_state              = wgpu_create_blend_state(true);
-  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
-    .format    = wgpu_context->swap_chain.format,
-    .blend     = &blend_state,
-    .writeMask = WGPUColorWriteMask_All,
-  };
-
-  // Vertex buffer layout
-  WGPUVertexBufferLayout skybox_vertex_buffer_layout = {0};
-
-  // Vertex state
-  WGPUVertexState vertex_state = wgpu_create_vertex_state(
-                wgpu_context, &(wgpu_vertex_state_t){
-                .shader_desc = (wgpu_shader_desc_t){
-                  // Vertex shader SPIR-V
-                  .label = "skybox_vertex_shader",
-                  .file  = "shaders/skybox/shader.vert.spv",
-                },
-                .buffer_count = 0,
-                .buffers      = &skybox_vertex_buffer_layout,
-              });
-
-  // Fragment state
-  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
-                wgpu_context, &(wgpu_fragment_state_t){
-                .shader_desc = (wgpu_shader_desc_t){
-                  // Fragment shader SPIR-V
-                  .label = "skybox_fragment_shader",
-                  .file  = "shaders/skybox/shader.frag.spv",
-                },
-                .target_count = 1,
-                .targets      = &color_target_state,
-              });
-
-  // Multisample state
-  WGPUMultisampleState multisample_state
-    = wgpu_create_multisample_state_descriptor(
-      &(create_multisample_state_desc_t){
-        .sample_count = 1,
-      });
-
-  // Create rendering pipeline using the specified states
-  pipeline = wgpuDeviceCreateRenderPipeline(wgpu_context->device,
-                                            &(WGPURenderPipelineDescriptor){
-                                              .label = "skybox_render_pipeline",
-                                              .layout      = pipeline_layout,
-                                              .primitive   = primitive_state,
-                                              .vertex      = vertex_state,
-                                              .fragment    = &fragment_state,
-                                              .multisample = multisample_state,
-                                            });
-  ASSERT(pipeline != NULL);
-
-  // Partial cleanup
-  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
-  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
 }
 
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
     setup_camera(context);
-    setup_pipeline_layout(context->wgpu_context);
     load_texture(context->wgpu_context);
-    prepare_uniform_buffers(context);
-    prepare_pipelines(context->wgpu_context);
+    prepare_skybox(context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
     return 0;
@@ -293,15 +126,8 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass.descriptor);
 
-  // Bind the rendering pipeline
-  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
-
-  // Set the bind group
-  wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0, bind_group, 0,
-                                    0);
-
-  // Draw skybox
-  wgpuRenderPassEncoderDraw(wgpu_context->rpass_enc, 3, 1, 0, 0);
+  // Draw skybox, after the opaque geometry of the scene
+  wgpu_skybox_draw(skybox, wgpu_context->rpass_enc);
 
   // End render pass
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
@@ -352,15 +178,8 @@ static void example_on_view_changed(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
+  wgpu_skybox_release(skybox);
   wgpu_destroy_texture(&texture);
-  WGPU_RELEASE_RESOURCE(TextureView, texture.view)
-  WGPU_RELEASE_RESOURCE(Texture, texture.texture)
-  WGPU_RELEASE_RESOURCE(Sampler, texture.sampler)
-  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
-  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
-  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
-  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer_vs.buffer)
-  WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
 }
 
 void example_skybox(int argc, char* argv[])
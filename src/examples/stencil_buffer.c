@@ -67,7 +67,8 @@ static void setup_camera(wgpu_example_context_t* context)
 static void load_assets(wgpu_context_t* wgpu_context)
 {
   const uint32_t gltf_loading_flags
-    = WGPU_GLTF_FileLoadingFlags_PreTransformVertices;
+    = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   model = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/venus.gltf",
@@ -1,33 +1,97 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <stb_image.h>
+
+#include "../webgpu/imgui_overlay.h"
+#include "../webgpu/procedural_mesh.h"
+
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Terrain Mesh
  *
  * This example shows how to render an infinite landscape for the camera to
- * meander around in. The terrain consists of a tiled planar mesh that is
+ * meander around in. The terrain consists of instanced planar patches that are
  * displaced with a heightmap.
  *
+ * The patches are selected from a quadtree around the camera every frame: a
+ * node is split while the projected size of its grid spacing exceeds the
+ * allowed screen-space error, nodes outside of the view frustum are skipped.
+ * All patches share one grid mesh scaled per instance, its vertices morph to
+ * the grid of the next coarser level before a patch meets a coarser
+ * neighbour, so that the levels join without cracks. The allowed error is
+ * raised until the patches fit in the patch budget, which keeps the triangle
+ * count constant however far the terrain extends.
+ *
+ * The heights are held in a clipmap of nested grids around the camera, each
+ * level with twice the spacing of the previous one, and are updated
+ * toroidally: only the rows and columns that enter a level as the camera moves
+ * are fetched and uploaded, from the heightmap image or from a raw 16-bit
+ * heightmap streamed with asynchronous byte-range reads (--heightmap=<file>
+ * --heightmap-size=<width>x<height> [--heightmap-spacing=<meters>]). The
+ * memory used stays the same for any size of terrain.
+ *
+ * A compute pre-pass runs when the heights of a level stream in: it stores
+ * the height derivatives, from which the vertex shader gets the normal with
+ * one fetch, and a min/max height pyramid of the level. A coarse mip of the
+ * pyramid is read back asynchronously and bounds the heights of the quadtree
+ * nodes, for tighter boxes in the frustum culling and the patch distances.
+ *
  * The example demonstrates the following:
  *  * texture creation and sampling
- *  * displacement mapping in GLSL
+ *  * displacement mapping in WGSL
  *  * bind groups for efficient resource binding
  *  * indexed and instanced draw calls
+ *  * continuous level of detail with quadtree selection and geomorphing
+ *  * streaming heights into a toroidally addressed clipmap
+ *  * derivative maps and min/max pyramids computed on the GPU
  *
  * Ref:
  * https://metalbyexample.com/webgpu-part-one/
  * https://metalbyexample.com/webgpu-part-two/
  * https://blogs.igalia.com/itoral/2016/10/13/opengl-terrain-renderer-rendering-the-terrain-mesh/
+ * https://github.com/fstrugar/CDLOD/blob/master/cdlod_paper_latest.pdf
+ * https://hhoppe.com/geomclipmap.pdf
  * -------------------------------------------------------------------------- */
 
-// Terrain patch parameters
+// Terrain patch parameters, the heightmap image repeats every PATCH_SIZE
+// meters
 #define PATCH_SIZE 50
-#define PATCH_SEGMENT_COUNT 40
+#define PATCH_SEGMENT_COUNT 32
 #define PATCH_INDEX_COUNT PATCH_SEGMENT_COUNT* PATCH_SEGMENT_COUNT * 6
-#define PATCH_VERTEX_COUNT (PATCH_SEGMENT_COUNT + 1) * (PATCH_SEGMENT_COUNT + 1)
-#define PATCH_FLOATS_PER_VERTEX 6
+#define TERRAIN_HEIGHT 4.0f
+
+// Quadtree parameters, the roots are laid out in a grid around the camera
+#define LOD_LEVEL_COUNT 6
+#define LOD_ROOT_SIZE 200.0f
+#define LOD_ROOT_GRID_SIZE 3
+#define MAX_PATCH_COUNT 1024
+// Smallest ratio of the split distance of a level to its node size, which
+// keeps neighbouring patches within one level of each other
+#define LOD_MIN_RANGE_RATIO 4.0f
+// Fraction of the split distance of the next level where the morph starts
+#define LOD_MORPH_START 0.75f
+
+// Height clipmap parameters: texels per level side, number of levels and
+// number of window moves of a level in flight
+#define CLIPMAP_SIZE 256
+#define CLIPMAP_LEVEL_COUNT 6
+#define CLIPMAP_MAX_UPDATES 16
+
+// Maps computed from the clipmap heights: mip m of the min/max height pyramid
+// bounds tiles of 2^(m+1) texels, the tiles of the read back mip bound the
+// quadtree nodes
+#define CLIPMAP_BOUNDS_MIP_COUNT 8
+#define CLIPMAP_BOUNDS_READBACK_MIP 3
+#define CLIPMAP_BOUNDS_TILE_SIZE (2 << CLIPMAP_BOUNDS_READBACK_MIP)
+#define CLIPMAP_BOUNDS_TILE_COUNT (CLIPMAP_SIZE / CLIPMAP_BOUNDS_TILE_SIZE)
+#define CLIPMAP_BOUNDS_ROW_PITCH 256
+#define CLIPMAP_READBACK_BUFFER_COUNT 3
 
 // Camera parameters
 static const float fov_y  = TO_RADIANS(60.0f);
@@ -40,40 +104,106 @@ static const float camera_speed                 = 8.0f; // meters per second
 
 // Used to calculate view and projection matrices
 static float rot_y[16], trans[16], view_matrix[16], projection_matrix[16];
-
-// Camera matrices
-static float model_matrix[16], model_view_matrix[16];
-static float model_view_projection_matrix[16];
-
-// Nine terrain patches
-static vec3 patch_centers[9];
+static float view_projection_matrix[16];
 
 // Time-related state
 static float last_frame_time            = -1.0f;
 static float direction_change_countdown = 6.0f; // seconds
 
-// Internal constants
-static const uint32_t instance_length
-  = 16 * 2; // Length of the data associated with a single instance
-static const uint32_t max_instance_count = 9;
-static const uint64_t instance_buffer_length
-  = 4 * instance_length * max_instance_count; // in bytes
-static float* instance_data    = NULL;
-static uint32_t instance_count = 1;
-
-// Vertex buffer
-static wgpu_buffer_t vertices = {0};
-
-// Index buffer
-static wgpu_buffer_t indices = {0};
+// Frame uniforms: view and projection matrices, camera position, terrain
+// parameters, the morph distances of every level, the clipmap parameters and
+// the resident texels of every clipmap level
+static struct {
+  float view_matrix[16];
+  float projection_matrix[16];
+  vec4 camera_position;
+  vec4 terrain;
+  vec4 morph_ranges[8];
+  vec4 clipmap;
+  vec4 clipmap_resident[8];
+} frame_uniforms = {0};
+
+// Instance data: origin, size and level of a patch
+typedef struct {
+  float origin[2];
+  float size;
+  uint32_t level;
+} terrain_patch_t;
+
+static terrain_patch_t patches[MAX_PATCH_COUNT];
+static uint32_t instance_count = 0;
+
+// Level of detail selection
+static struct {
+  frustum_t frustum;
+  // Split distance of every level
+  float ranges[LOD_LEVEL_COUNT];
+  // Allowed projected size of a grid cell, in pixels
+  float pixel_error;
+  // Error used for the last selection, at least pixel_error
+  float effective_pixel_error;
+  int32_t patch_budget;
+  bool frustum_culling;
+  // Node boxes bounded by the read back height pyramid
+  bool height_bounds;
+  uint32_t culled_node_count;
+  uint32_t bounded_node_count;
+} lod = {
+  .pixel_error           = 2.0f,
+  .effective_pixel_error = 2.0f,
+  .patch_budget          = 256,
+  .frustum_culling       = true,
+  .height_bounds         = true,
+};
+
+// Source of the heights: the heightmap image, or a raw heightmap of 16-bit
+// little-endian samples streamed from a file
+static struct {
+  const char* filename;
+  uint8_t* image;
+  uint32_t width, height;
+  // Distance of the samples, in meters
+  float spacing;
+} heightmap_source = {
+  .spacing = 0.5f,
+};
+
+// Window move of a clipmap level, resident once no operation is pending
+typedef struct {
+  uint32_t level;
+  int32_t origin[2];
+  uint32_t pending;
+} clipmap_update_t;
+
+typedef struct {
+  // Texel of the window corner, the window is centered on the camera
+  int32_t origin[2];
+  bool initialized;
+  // Texels known to be in the texture: x0, z0, x1, z1
+  int32_t resident[4];
+  clipmap_update_t updates[CLIPMAP_MAX_UPDATES];
+  uint32_t first_update;
+  uint32_t update_count;
+} clipmap_level_t;
 
-// Instance buffer
+static struct {
+  wgpu_context_t* wgpu_context;
+  WGPUTexture texture;
+  WGPUTextureView view;
+  clipmap_level_t levels[CLIPMAP_LEVEL_COUNT];
+  bool released;
+} clipmap = {0};
+
+// Patch grid, generated on the GPU into the vertex and index buffers
+static wgpu_procedural_mesh_t* patch_mesh = NULL;
+
+// Frame uniform buffer and patch instance buffer
+static wgpu_buffer_t uniform_buffer  = {0};
 static wgpu_buffer_t instance_buffer = {0};
 
 // Textures
 static struct {
   texture_t color;
-  texture_t heightmap;
 } textures;
 static WGPUSampler linear_sampler = {0};
 
@@ -174,60 +304,1222 @@ static void mat4_perspective_fov(float fovY, float aspect, float near,
  * Terrain Mesh example
  * -------------------------------------------------------------------------- */
 
+// clang-format off
+static const char* terrain_shader_wgsl = CODE(
+  struct Frame {
+    viewMatrix : mat4x4<f32>,
+    projectionMatrix : mat4x4<f32>,
+    cameraPosition : vec4<f32>,
+    // Color texture repeat, grid segments, height scale and fog distance
+    terrain : vec4<f32>,
+    morphRanges : array<vec4<f32>, 8>,
+    // Spacing of the finest level, level count and level size
+    clipmap : vec4<f32>,
+    clipmapResident : array<vec4<f32>, 8>,
+  };
+
+  struct Patch {
+    origin : vec2<f32>,
+    size : f32,
+    level : u32,
+  };
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) texCoords : vec2<f32>,
+    @location(1) viewDistance : f32,
+    @location(2) normal : vec3<f32>,
+  };
+
+  @group(0) @binding(0) var linearSampler : sampler;
+  @group(0) @binding(1) var colorTexture : texture_2d<f32>;
+  @group(0) @binding(2) var heightClipmap : texture_2d_array<f32>;
+  @group(0) @binding(3) var derivativeClipmap : texture_2d_array<f32>;
+
+  @group(1) @binding(0) var<uniform> frame : Frame;
+  @group(1) @binding(1) var<storage, read> patches : array<Patch>;
+
+  fn terrainTexCoords(xz : vec2<f32>) -> vec2<f32> {
+    return xz / frame.terrain.x + vec2<f32>(0.5);
+  }
+
+  fn clipmapHeight(texel : vec2<i32>, level : i32) -> f32 {
+    let n = i32(frame.clipmap.z);
+    let slot = ((texel % vec2<i32>(n)) + vec2<i32>(n)) % vec2<i32>(n);
+    return textureLoad(heightClipmap, slot, level, 0).r;
+  }
+
+  // Bilinear height from the finest level with the point resident
+  fn terrainHeight(xz : vec2<f32>) -> f32 {
+    let levelCount = u32(frame.clipmap.y);
+    for (var level = 0u; level < levelCount; level = level + 1u) {
+      let texel = xz / (frame.clipmap.x * exp2(f32(level)));
+      let base = floor(texel);
+      let resident = frame.clipmapResident[level];
+      if (any(base < resident.xy)
+          || any(base + vec2<f32>(1.0) >= resident.zw)) {
+        continue;
+      }
+      let t = vec2<i32>(base);
+      let l = i32(level);
+      let f = texel - base;
+      let h0 = mix(clipmapHeight(t, l), clipmapHeight(t + vec2<i32>(1, 0), l),
+                   f.x);
+      let h1 = mix(clipmapHeight(t + vec2<i32>(0, 1), l),
+                   clipmapHeight(t + vec2<i32>(1, 1), l), f.x);
+      return mix(h0, h1, f.y);
+    }
+    return 0.0;
+  }
+
+  // Normal from the derivatives of the finest level with the point resident,
+  // one fetch of the texel nearest to the point
+  fn terrainNormal(xz : vec2<f32>) -> vec3<f32> {
+    let n = i32(frame.clipmap.z);
+    let levelCount = u32(frame.clipmap.y);
+    for (var level = 0u; level < levelCount; level = level + 1u) {
+      let texel = floor(xz / (frame.clipmap.x * exp2(f32(level)))
+                        + vec2<f32>(0.5));
+      let resident = frame.clipmapResident[level];
+      if (any(texel < resident.xy) || any(texel >= resident.zw)) {
+        continue;
+      }
+      let slot = ((vec2<i32>(texel) % vec2<i32>(n)) + vec2<i32>(n))
+                 % vec2<i32>(n);
+      let slope = textureLoad(derivativeClipmap, slot, i32(level), 0).xy
+                  * frame.terrain.z;
+      return normalize(vec3<f32>(-slope.x, 1.0, -slope.y));
+    }
+    return vec3<f32>(0.0, 1.0, 0.0);
+  }
+
+  @vertex
+  fn vs_main(@location(0) grid : vec2<f32>,
+             @builtin(instance_index) instance : u32) -> VertexOutput {
+    let terrainPatch = patches[instance];
+    let spacing = terrainPatch.size / frame.terrain.y;
+    var xz = terrainPatch.origin + grid * spacing;
+
+    // Odd vertices slide onto their even neighbours, the coarser grid, as the
+    // patch gets close to the distance of the next level. The shared vertices
+    // of neighbouring patches morph alike.
+    let eye = frame.cameraPosition.xyz;
+    let morphRange = frame.morphRanges[terrainPatch.level];
+    let dist = distance(vec3<f32>(xz.x, 0.0, xz.y), eye);
+    let morph = clamp((dist - morphRange.x) / (morphRange.y - morphRange.x),
+                      0.0, 1.0);
+    xz = xz - fract(grid * 0.5) * 2.0 * spacing * morph;
+
+    let texCoords = terrainTexCoords(xz);
+    let height = terrainHeight(xz);
+    let viewPosition = frame.viewMatrix
+                       * vec4<f32>(xz.x, height * frame.terrain.z, xz.y, 1.0);
+
+    var output : VertexOutput;
+    output.position = frame.projectionMatrix * viewPosition;
+    output.texCoords = texCoords;
+    output.viewDistance = length(viewPosition.xyz);
+    output.normal = terrainNormal(xz);
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let color = textureSample(colorTexture, linearSampler, input.texCoords);
+    // Sun light
+    let sun = normalize(vec3<f32>(0.3, 0.8, 0.5));
+    let light = 0.4 + 0.6 * max(dot(normalize(input.normal), sun), 0.0);
+    // Fade into the clear color towards the far plane
+    let fog = smoothstep(0.6, 1.0, input.viewDistance / frame.terrain.w);
+    return vec4<f32>(mix(color.rgb * light, vec3<f32>(0.812, 0.914, 1.0), fog),
+                     1.0);
+  }
+);
+// clang-format on
+
+/*
+ * One patch grid of unit cells shared by all levels, the vertex shader scales
+ * it to the patch
+ */
 static void prepare_patch_mesh(wgpu_context_t* wgpu_context)
 {
-  float vertices_data[PATCH_VERTEX_COUNT * PATCH_FLOATS_PER_VERTEX] = {0};
-  uint32_t indices_data[PATCH_INDEX_COUNT]                          = {0};
-
-  const uint32_t patch_size          = (uint32_t)PATCH_SIZE;
-  const uint32_t patch_segment_count = (uint32_t)PATCH_SEGMENT_COUNT;
-  const uint32_t floats_per_vertex   = (uint32_t)PATCH_FLOATS_PER_VERTEX;
-
-  for (uint32_t zi = 0, v = 0; zi < patch_segment_count + 1; ++zi) {
-    for (uint32_t xi = 0; xi < patch_segment_count + 1; ++xi) {
-      float s               = xi / (float)patch_segment_count;
-      float t               = zi / (float)patch_segment_count;
-      uint64_t vi           = v * floats_per_vertex;
-      vertices_data[vi + 0] = (s * patch_size) - (patch_size * 0.5f); // x
-      vertices_data[vi + 1] = 0.0f;                                   // y
-      vertices_data[vi + 2] = (t * patch_size) - (patch_size * 0.5f); // z
-      vertices_data[vi + 3] = 1.0f;                                   // w
-      vertices_data[vi + 4] = s;
-      vertices_data[vi + 5] = t;
-      ++v;
-    }
-  }
-
-  for (uint32_t zi = 0, ii = 0; zi < patch_segment_count; ++zi) {
-    for (uint32_t xi = 0; xi < patch_segment_count; ++xi) {
-      const uint32_t bi    = zi * (patch_segment_count + 1);
-      indices_data[ii + 0] = bi + xi;
-      indices_data[ii + 1] = bi + xi + (patch_segment_count + 1);
-      indices_data[ii + 2] = bi + xi + (patch_segment_count + 1) + 1;
-      indices_data[ii + 3] = bi + xi + (patch_segment_count + 1) + 1;
-      indices_data[ii + 4] = bi + xi + 1;
-      indices_data[ii + 5] = bi + xi;
-      ii += 6;
-    }
-  }
-
-  // Create vertex buffer
-  vertices = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
-                    .size  = sizeof(vertices_data),
-                    .count = (uint32_t)ARRAY_SIZE(vertices_data),
-                    .initial.data = vertices_data,
+  // Vertex (x, y) of the plane is the grid position (x, z), in cells
+  patch_mesh = wgpu_procedural_mesh_create(wgpu_context);
+  wgpu_procedural_mesh_add_shape(
+    patch_mesh, &(wgpu_procedural_shape_desc_t){
+                  .shape = WGPU_ProceduralShape_Plane,
+                  .plane = {
+                    .width   = (float)PATCH_SEGMENT_COUNT,
+                    .height  = (float)PATCH_SEGMENT_COUNT,
+                    .columns = (uint32_t)PATCH_SEGMENT_COUNT,
+                    .rows    = (uint32_t)PATCH_SEGMENT_COUNT,
+                  },
+                });
+  wgpu_procedural_mesh_generate(patch_mesh);
+}
+
+/* -------------------------------------------------------------------------- *
+ * Height clipmap
+ *
+ * Every level holds CLIPMAP_SIZE^2 heights around the camera, with twice the
+ * spacing of the previous level, in a layer of a texture array addressed
+ * toroidally: the height of level texel (i, j) is stored at (i mod N, j mod N).
+ * When the camera moves, only the rows and columns that enter the window of a
+ * level are fetched from the source and uploaded through the upload
+ * scheduler. The shader samples the finest level whose resident region
+ * contains the point, so the memory does not depend on the terrain size.
+ * -------------------------------------------------------------------------- */
+
+// A rectangle of level texels fetched from the source for one level update
+typedef struct clipmap_rect_t clipmap_rect_t;
+
+// Read of one source row of a rectangle
+typedef struct {
+  clipmap_rect_t* rect;
+  uint32_t row;
+} clipmap_row_read_t;
+
+struct clipmap_rect_t {
+  uint32_t level;
+  uint32_t update;
+  int32_t x, z;
+  uint32_t width, height;
+  float* heights;
+  uint32_t rows_remaining;
+  clipmap_row_read_t* rows;
+};
+
+static float clipmap_level_spacing(uint32_t level)
+{
+  return heightmap_source.spacing * (float)(1u << level);
+}
+
+// Texels outside of a window may be overwritten once it has been issued
+static void clipmap_clip_resident(clipmap_level_t* clipmap_level,
+                                  const int32_t origin[2])
+{
+  int32_t* resident = clipmap_level->resident;
+  for (uint32_t i = 0; i < 2; ++i) {
+    resident[i]     = MAX(resident[i], origin[i]);
+    resident[i + 2] = MIN(resident[i + 2], origin[i] + (int32_t)CLIPMAP_SIZE);
+  }
+}
+
+/*
+ * The updates of a level complete in issue order. The resident region is the
+ * window of the last completed update within the windows issued after it.
+ */
+static void clipmap_advance_level(uint32_t level)
+{
+  clipmap_level_t* clipmap_level = &clipmap.levels[level];
+  bool advanced                  = false;
+  while (clipmap_level->update_count > 0) {
+    clipmap_update_t* update
+      = &clipmap_level->updates[clipmap_level->first_update];
+    if (update->pending > 0) {
+      break;
+    }
+    clipmap_level->resident[0] = update->origin[0];
+    clipmap_level->resident[1] = update->origin[1];
+    clipmap_level->resident[2] = update->origin[0] + (int32_t)CLIPMAP_SIZE;
+    clipmap_level->resident[3] = update->origin[1] + (int32_t)CLIPMAP_SIZE;
+    clipmap_level->first_update
+      = (clipmap_level->first_update + 1) % CLIPMAP_MAX_UPDATES;
+    --clipmap_level->update_count;
+    advanced = true;
+  }
+  if (!advanced) {
+    return;
+  }
+  for (uint32_t i = 0; i < clipmap_level->update_count; ++i) {
+    const uint32_t u = (clipmap_level->first_update + i) % CLIPMAP_MAX_UPDATES;
+    clipmap_clip_resident(clipmap_level, clipmap_level->updates[u].origin);
+  }
+}
+
+static void clipmap_on_uploaded(void* user_data)
+{
+  clipmap_update_t* update = (clipmap_update_t*)user_data;
+  ASSERT(update->pending > 0);
+  --update->pending;
+  clipmap_advance_level(update->level);
+}
+
+static void clipmap_finish_operation(uint32_t level, uint32_t update)
+{
+  clipmap_update_t* clipmap_update = &clipmap.levels[level].updates[update];
+  ASSERT(clipmap_update->pending > 0);
+  --clipmap_update->pending;
+  clipmap_advance_level(level);
+}
+
+static int32_t clipmap_slot(int32_t texel)
+{
+  return ((texel % (int32_t)CLIPMAP_SIZE) + (int32_t)CLIPMAP_SIZE)
+         % (int32_t)CLIPMAP_SIZE;
+}
+
+/*
+ * Uploads the part of a fetched rectangle that is still in the window of its
+ * level, split where the toroidal addressing wraps around
+ */
+static void clipmap_upload_rect(clipmap_rect_t* rect)
+{
+  clipmap_level_t* clipmap_level = &clipmap.levels[rect->level];
+  clipmap_update_t* update       = &clipmap_level->updates[rect->update];
+
+  const int32_t x0 = MAX(rect->x, clipmap_level->origin[0]);
+  const int32_t z0 = MAX(rect->z, clipmap_level->origin[1]);
+  const int32_t x1 = MIN(rect->x + (int32_t)rect->width,
+                         clipmap_level->origin[0] + (int32_t)CLIPMAP_SIZE);
+  const int32_t z1 = MIN(rect->z + (int32_t)rect->height,
+                         clipmap_level->origin[1] + (int32_t)CLIPMAP_SIZE);
+
+  wgpu_upload_scheduler_t* upload_scheduler
+    = wgpu_get_upload_scheduler(clipmap.wgpu_context);
+  for (int32_t z = z0; z < z1;) {
+    const int32_t piece_height
+      = MIN(z1 - z, (int32_t)CLIPMAP_SIZE - clipmap_slot(z));
+    for (int32_t x = x0; x < x1;) {
+      const int32_t piece_width
+        = MIN(x1 - x, (int32_t)CLIPMAP_SIZE - clipmap_slot(x));
+
+      // The scheduler copies tightly packed rows
+      float* piece = (float*)malloc(sizeof(float) * piece_width * piece_height);
+      for (int32_t j = 0; j < piece_height; ++j) {
+        memcpy(piece + j * piece_width,
+               rect->heights + (z + j - rect->z) * rect->width + (x - rect->x),
+               sizeof(float) * piece_width);
+      }
+      ++update->pending;
+      wgpu_upload_scheduler_upload_texture(
+        upload_scheduler,
+        &(wgpu_texture_upload_desc_t){
+          .texture = clipmap.texture,
+          .origin  = (WGPUOrigin3D){(uint32_t)clipmap_slot(x),
+                                    (uint32_t)clipmap_slot(z), rect->level},
+          .size = (WGPUExtent3D){(uint32_t)piece_width,
+                                 (uint32_t)piece_height, 1},
+          .data          = piece,
+          .bytes_per_row = sizeof(float) * piece_width,
+          // Coarse levels cover the largest area
+          .priority  = (int32_t)rect->level,
+          .callback  = clipmap_on_uploaded,
+          .user_data = update,
+        });
+      free(piece);
+      x += piece_width;
+    }
+    z += piece_height;
+  }
+}
+
+static void clipmap_free_rect(clipmap_rect_t* rect)
+{
+  free(rect->heights);
+  free(rect->rows);
+  free(rect);
+}
+
+/*
+ * Source sample of a level texel of a raw heightmap, clamped at its edges. The
+ * heightmap is centered on the origin like the image.
+ */
+static int32_t clipmap_source_column(uint32_t level, int32_t x)
+{
+  const int32_t w = (int32_t)heightmap_source.width;
+  return CLAMP(x * (int32_t)(1u << level) + w / 2, 0, w - 1);
+}
+
+static int32_t clipmap_source_row(uint32_t level, int32_t z)
+{
+  const int32_t h = (int32_t)heightmap_source.height;
+  return CLAMP(z * (int32_t)(1u << level) + h / 2, 0, h - 1);
+}
+
+static void clipmap_on_row_read(const file_read_response_t* response)
+{
+  const clipmap_row_read_t* row_read
+    = (const clipmap_row_read_t*)response->user_data;
+  clipmap_rect_t* rect = row_read->rect;
+
+  if (clipmap.released) {
+    if (--rect->rows_remaining == 0) {
+      clipmap_free_rect(rect);
+    }
+    return;
+  }
+
+  // Every 2^level-th height of the source row
+  const int32_t first_x = clipmap_source_column(rect->level, rect->x);
+  float* heights        = rect->heights + row_read->row * rect->width;
+  const uint64_t count  = response->size / sizeof(uint16_t);
+  if (response->success && response->data != NULL && count > 0) {
+    const uint16_t* source = (const uint16_t*)response->data;
+    for (uint32_t i = 0; i < rect->width; ++i) {
+      const int32_t x
+        = clipmap_source_column(rect->level, rect->x + (int32_t)i);
+      const uint64_t index = MIN((uint64_t)(x - first_x), count - 1);
+      heights[i]           = source[index] / 65535.0f;
+    }
+  }
+  else {
+    log_error("Couldn't read a row of '%s'\n", response->filename);
+  }
+
+  if (--rect->rows_remaining == 0) {
+    clipmap_upload_rect(rect);
+    clipmap_finish_operation(rect->level, rect->update);
+    clipmap_free_rect(rect);
+  }
+}
+
+// Fetches a rectangle of level texels from the source, part of an update
+static void clipmap_fetch_rect(uint32_t level, uint32_t update, int32_t x,
+                               int32_t z, uint32_t width, uint32_t height)
+{
+  if (width == 0 || height == 0) {
+    return;
+  }
+
+  clipmap_rect_t* rect = (clipmap_rect_t*)calloc(1, sizeof(clipmap_rect_t));
+  *rect                = (clipmap_rect_t){
+    .level   = level,
+    .update  = update,
+    .x       = x,
+    .z       = z,
+    .width   = width,
+    .height  = height,
+    .heights = (float*)calloc(width * height, sizeof(float)),
+  };
+  ++clipmap.levels[level].updates[update].pending;
+
+  const uint32_t stride = 1u << level;
+
+  // The image repeats, with the origin in its center like the color texture
+  if (heightmap_source.filename == NULL) {
+    const int32_t w = (int32_t)heightmap_source.width;
+    const int32_t h = (int32_t)heightmap_source.height;
+    for (uint32_t j = 0; j < height; ++j) {
+      const int32_t sz
+        = ((((z + (int32_t)j) * (int32_t)stride + h / 2) % h) + h) % h;
+      for (uint32_t i = 0; i < width; ++i) {
+        const int32_t sx
+          = ((((x + (int32_t)i) * (int32_t)stride + w / 2) % w) + w) % w;
+        rect->heights[j * width + i]
+          = heightmap_source.image[sz * w + sx] / 255.0f;
+      }
+    }
+    clipmap_upload_rect(rect);
+    clipmap_finish_operation(level, update);
+    clipmap_free_rect(rect);
+    return;
+  }
+
+  // A read of the covered span of the source row for every level row
+  const int32_t first_x = clipmap_source_column(level, x);
+  const int32_t last_x  = clipmap_source_column(level, x + (int32_t)width - 1);
+  rect->rows_remaining  = height;
+  rect->rows = (clipmap_row_read_t*)calloc(height, sizeof(clipmap_row_read_t));
+  for (uint32_t j = 0; j < height; ++j) {
+    const int32_t sz = clipmap_source_row(level, z + (int32_t)j);
+    rect->rows[j]    = (clipmap_row_read_t){
+      .rect = rect,
+      .row  = j,
+    };
+    file_read_async(&(file_read_request_t){
+      .filename = heightmap_source.filename,
+      .offset   = sizeof(uint16_t)
+                * ((uint64_t)sz * heightmap_source.width + first_x),
+      .size        = sizeof(uint16_t) * (uint64_t)(last_x - first_x + 1),
+      .on_complete = clipmap_on_row_read,
+      .user_data   = &rect->rows[j],
+    });
+  }
+}
+
+// Moves the window of a level over the camera, fetching the exposed texels
+static void clipmap_update_level(uint32_t level)
+{
+  clipmap_level_t* clipmap_level = &clipmap.levels[level];
+  const float spacing            = clipmap_level_spacing(level);
+  const int32_t origin[2]        = {
+    (int32_t)floorf(camera_position[0] / spacing) - CLIPMAP_SIZE / 2,
+    (int32_t)floorf(camera_position[2] / spacing) - CLIPMAP_SIZE / 2,
+  };
+  const int32_t dx = origin[0] - clipmap_level->origin[0];
+  const int32_t dz = origin[1] - clipmap_level->origin[1];
+  if (clipmap_level->initialized && dx == 0 && dz == 0) {
+    return;
+  }
+  // The window waits while too many updates are in flight
+  if (clipmap_level->update_count == CLIPMAP_MAX_UPDATES) {
+    return;
+  }
+
+  const uint32_t update_index
+    = (clipmap_level->first_update + clipmap_level->update_count)
+      % CLIPMAP_MAX_UPDATES;
+  clipmap_update_t* update = &clipmap_level->updates[update_index];
+  *update                  = (clipmap_update_t){
+    .level   = level,
+    .origin  = {origin[0], origin[1]},
+    .pending = 1,
+  };
+  ++clipmap_level->update_count;
+
+  const int32_t size = (int32_t)CLIPMAP_SIZE;
+  const bool full_update
+    = !clipmap_level->initialized || abs(dx) >= size || abs(dz) >= size;
+  const int32_t previous_x = clipmap_level->origin[0];
+  clipmap_level->origin[0]   = origin[0];
+  clipmap_level->origin[1]   = origin[1];
+  clipmap_level->initialized = true;
+  clipmap_clip_resident(clipmap_level, origin);
+
+  if (full_update) {
+    clipmap_fetch_rect(level, update_index, origin[0], origin[1], size, size);
+  }
+  else {
+    // Columns entering the window, then the rows entering it over the other
+    // columns
+    if (dx != 0) {
+      const int32_t x = dx > 0 ? previous_x + size : origin[0];
+      clipmap_fetch_rect(level, update_index, x, origin[1], abs(dx), size);
+    }
+    if (dz != 0) {
+      const int32_t x = dx > 0 ? origin[0] : origin[0] - dx;
+      const int32_t z = dz > 0 ? origin[1] + size - dz : origin[1];
+      clipmap_fetch_rect(level, update_index, x, z, size - abs(dx), abs(dz));
+    }
+  }
+
+  // The update itself was counted as pending until all fetches were issued
+  clipmap_finish_operation(level, update_index);
+}
+
+static void clipmap_update(void)
+{
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    clipmap_update_level(l);
+  }
+
+  frame_uniforms.clipmap[0] = heightmap_source.spacing;
+  frame_uniforms.clipmap[1] = (float)CLIPMAP_LEVEL_COUNT;
+  frame_uniforms.clipmap[2] = (float)CLIPMAP_SIZE;
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    const int32_t* resident = clipmap.levels[l].resident;
+    for (uint32_t i = 0; i < 4; ++i) {
+      frame_uniforms.clipmap_resident[l][i] = (float)resident[i];
+    }
+  }
+}
+
+static void prepare_clipmap(wgpu_context_t* wgpu_context)
+{
+  clipmap.wgpu_context = wgpu_context;
+  clipmap.released     = false;
+
+  // The heightmap image, unless a raw heightmap is streamed
+  if (heightmap_source.filename == NULL) {
+    int width = 0, height = 0, channels = 0;
+    heightmap_source.image
+      = stbi_load("textures/heightmap.png", &width, &height, &channels, 1);
+    if (heightmap_source.image == NULL) {
+      log_error("Couldn't load textures/heightmap.png\n");
+      heightmap_source.image = (uint8_t*)calloc(1, 1);
+      width = height = 1;
+    }
+    heightmap_source.width   = (uint32_t)width;
+    heightmap_source.height  = (uint32_t)height;
+    heightmap_source.spacing = (float)PATCH_SIZE / (float)width;
+  }
+
+  clipmap.texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "terrain_height_clipmap",
+      .usage
+      = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){CLIPMAP_SIZE, CLIPMAP_SIZE,
+                                      CLIPMAP_LEVEL_COUNT},
+      .format        = WGPUTextureFormat_R32Float,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(clipmap.texture != NULL);
+  clipmap.view = wgpuTextureCreateView(
+    clipmap.texture, &(WGPUTextureViewDescriptor){
+                       .format          = WGPUTextureFormat_R32Float,
+                       .dimension       = WGPUTextureViewDimension_2DArray,
+                       .mipLevelCount   = 1,
+                       .arrayLayerCount = CLIPMAP_LEVEL_COUNT,
+                     });
+  ASSERT(clipmap.view != NULL);
+}
+
+static void release_clipmap(void)
+{
+  // Reads in flight free their rectangles when they complete
+  clipmap.released = true;
+  wgpu_upload_scheduler_t* upload_scheduler
+    = wgpu_get_upload_scheduler(clipmap.wgpu_context);
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    for (uint32_t u = 0; u < CLIPMAP_MAX_UPDATES; ++u) {
+      wgpu_upload_scheduler_cancel(upload_scheduler,
+                                   &clipmap.levels[l].updates[u]);
+    }
+  }
+  memset(clipmap.levels, 0, sizeof(clipmap.levels));
+
+  WGPU_RELEASE_RESOURCE(TextureView, clipmap.view)
+  WGPU_RELEASE_RESOURCE(Texture, clipmap.texture)
+  if (heightmap_source.image != NULL) {
+    stbi_image_free(heightmap_source.image);
+    heightmap_source.image = NULL;
+  }
+}
+
+/* -------------------------------------------------------------------------- *
+ * Clipmap derivative and height bounds maps
+ *
+ * A compute pre-pass runs for every level whose resident texels changed. It
+ * stores the height derivatives of the resident texels and builds a pyramid of
+ * the minimum and maximum heights of tiles of the level, both addressed
+ * toroidally like the heights: a pyramid tile bounds the resident texels of
+ * its slots. The tiles of a coarse mip are read back asynchronously and bound
+ * the quadtree nodes on the CPU, the full pyramid is left for GPU-side
+ * queries, e.g. ray marched shadows.
+ * -------------------------------------------------------------------------- */
+
+// Window, layer and resident texels of a level the maps are computed for, one
+// uniform slot per level
+typedef struct {
+  int32_t origin[2];
+  int32_t layer;
+  float spacing;
+  int32_t resident[4];
+  uint8_t padding[224];
+} clipmap_maps_params_t;
+
+// Resident texels of a level the maps were computed for
+typedef struct {
+  bool valid;
+  int32_t origin[2];
+  int32_t resident[4];
+} clipmap_maps_snapshot_t;
+
+static struct {
+  wgpu_context_t* wgpu_context;
+  WGPUTexture derivatives;
+  WGPUTextureView derivatives_view;
+  WGPUTexture bounds;
+  WGPUTextureView bounds_views[CLIPMAP_BOUNDS_MIP_COUNT];
+  WGPUBuffer params_buffer;
+  // Read back mip of every level, rows padded to CLIPMAP_BOUNDS_ROW_PITCH
+  WGPUBuffer bounds_buffer;
+  wgpu_buffer_readback_t* readback;
+  WGPUBindGroupLayout derivatives_bind_group_layout;
+  WGPUBindGroupLayout bounds_bind_group_layout;
+  WGPUComputePipeline derivatives_pipeline;
+  WGPUComputePipeline bounds_pipeline;
+  WGPUComputePipeline downsample_pipeline;
+  WGPUBindGroup derivatives_bind_group;
+  // Bind group i writes mip i, from the heights or from mip i - 1
+  WGPUBindGroup bounds_bind_groups[CLIPMAP_BOUNDS_MIP_COUNT];
+  // Levels the maps were computed for, and the levels to compute this frame
+  clipmap_maps_snapshot_t computed[CLIPMAP_LEVEL_COUNT];
+  bool dirty[CLIPMAP_LEVEL_COUNT];
+  // The read back mip is copied again until a readback buffer is free
+  bool readback_pending;
+  uint64_t frame;
+  struct {
+    uint64_t frame;
+    clipmap_maps_snapshot_t levels[CLIPMAP_LEVEL_COUNT];
+  } snapshots[CLIPMAP_READBACK_BUFFER_COUNT + 1];
+  // Last read back bounds, normalized heights
+  clipmap_maps_snapshot_t levels[CLIPMAP_LEVEL_COUNT];
+  float tiles[CLIPMAP_LEVEL_COUNT][CLIPMAP_BOUNDS_TILE_COUNT]
+             [CLIPMAP_BOUNDS_TILE_COUNT][2];
+} clipmap_maps = {0};
+
+// clang-format off
+static const char* clipmap_maps_common_wgsl = CODE(
+  struct Level {
+    origin : vec2<i32>,
+    layer : i32,
+    spacing : f32,
+    // Resident texels: x0, z0, x1, z1
+    resident : vec4<i32>,
+  };
+
+  @group(0) @binding(0) var<uniform> level : Level;
+
+  fn slotOf(texel : vec2<i32>, n : i32) -> vec2<i32> {
+    return ((texel % vec2<i32>(n)) + vec2<i32>(n)) % vec2<i32>(n);
+  }
+
+  // Level texel of the window stored in a slot
+  fn windowTexel(slot : vec2<i32>, n : i32) -> vec2<i32> {
+    return level.origin + slotOf(slot - level.origin, n);
+  }
+
+  fn isResident(texel : vec2<i32>) -> bool {
+    return all(texel >= level.resident.xy) && all(texel < level.resident.zw);
+  }
+);
+
+// Central differences of the resident heights, one-sided at the edges of the
+// resident texels
+static const char* clipmap_derivatives_shader_wgsl = CODE(
+  @group(0) @binding(1) var heights : texture_2d_array<f32>;
+  @group(0) @binding(2) var derivatives :
+    texture_storage_2d_array<rgba16float, write>;
+
+  fn height(texel : vec2<i32>, n : i32) -> f32 {
+    return textureLoad(heights, slotOf(texel, n), level.layer, 0).r;
+  }
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let n = i32(textureDimensions(heights).x);
+    let slot = vec2<i32>(id.xy);
+    if (any(slot >= vec2<i32>(n))) {
+      return;
+    }
+    let texel = windowTexel(slot, n);
+    var slope = vec2<f32>(0.0);
+    if (isResident(texel)) {
+      let lo = max(texel - vec2<i32>(1), level.resident.xy);
+      let hi = min(texel + vec2<i32>(1), level.resident.zw - vec2<i32>(1));
+      let span = vec2<f32>(max(hi - lo, vec2<i32>(1))) * level.spacing;
+      slope = vec2<f32>(
+        height(vec2<i32>(hi.x, texel.y), n)
+          - height(vec2<i32>(lo.x, texel.y), n),
+        height(vec2<i32>(texel.x, hi.y), n)
+          - height(vec2<i32>(texel.x, lo.y), n)) / span;
+    }
+    textureStore(derivatives, slot, level.layer, vec4<f32>(slope, 0.0, 1.0));
+  }
+);
+
+// Tiles without resident texels hold an empty range
+static const char* clipmap_bounds_shader_wgsl = CODE(
+  @group(0) @binding(1) var src : texture_2d_array<f32>;
+  @group(0) @binding(2) var dst : texture_storage_2d_array<rg32float, write>;
+
+  const emptyBounds = vec2<f32>(3.0e38, -3.0e38);
+
+  // Mip 0: the resident heights of 2x2 slots
+  @compute @workgroup_size(8, 8)
+  fn bounds_main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let pos = vec2<i32>(id.xy);
+    if (any(pos >= vec2<i32>(textureDimensions(dst)))) {
+      return;
+    }
+    let n = i32(textureDimensions(src).x);
+    var bounds = emptyBounds;
+    for (var y = 0; y < 2; y = y + 1) {
+      for (var x = 0; x < 2; x = x + 1) {
+        let slot = pos * 2 + vec2<i32>(x, y);
+        if (isResident(windowTexel(slot, n))) {
+          let h = textureLoad(src, slot, level.layer, 0).r;
+          bounds = vec2<f32>(min(bounds.x, h), max(bounds.y, h));
+        }
+      }
+    }
+    textureStore(dst, pos, level.layer, vec4<f32>(bounds, 0.0, 1.0));
+  }
+
+  // Mip m: 2x2 tiles of mip m - 1
+  @compute @workgroup_size(8, 8)
+  fn downsample_main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let pos = vec2<i32>(id.xy);
+    if (any(pos >= vec2<i32>(textureDimensions(dst)))) {
+      return;
+    }
+    var bounds = emptyBounds;
+    for (var y = 0; y < 2; y = y + 1) {
+      for (var x = 0; x < 2; x = x + 1) {
+        let tile = textureLoad(src, pos * 2 + vec2<i32>(x, y), level.layer, 0);
+        bounds = vec2<f32>(min(bounds.x, tile.r), max(bounds.y, tile.g));
+      }
+    }
+    textureStore(dst, pos, level.layer, vec4<f32>(bounds, 0.0, 1.0));
+  }
+);
+// clang-format on
+
+static WGPUComputePipeline clipmap_maps_create_pipeline(
+  const char* label, const char* wgsl, const char* entry,
+  WGPUBindGroupLayout bind_group_layout)
+{
+  wgpu_context_t* wgpu_context = clipmap_maps.wgpu_context;
+
+  const size_t common_length = strlen(clipmap_maps_common_wgsl);
+  const size_t length        = strlen(wgsl);
+  char* source               = (char*)malloc(common_length + length + 1);
+  memcpy(source, clipmap_maps_common_wgsl, common_length);
+  memcpy(source + common_length, wgsl, length + 1);
+
+  WGPUPipelineLayout layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts     = &bind_group_layout,
+                          });
+  ASSERT(layout != NULL);
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = label,
+                    .wgsl_code.source = source,
+                    .entry            = entry,
                   });
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = label,
+      .layout  = layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, layout)
+  free(source);
 
-  // Create index buffer
-  indices = wgpu_create_buffer(
-    wgpu_context, &(wgpu_buffer_desc_t){
-                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
-                    .size  = sizeof(indices_data),
-                    .count = (uint32_t)ARRAY_SIZE(indices_data),
-                    .initial.data = indices_data,
+  return pipeline;
+}
+
+static WGPUBindGroupLayout
+clipmap_maps_create_bind_group_layout(WGPUTextureFormat storage_format)
+{
+  WGPUBindGroupLayoutEntry bgl_entries[3] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Level parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type             = WGPUBufferBindingType_Uniform,
+        .hasDynamicOffset = true,
+        .minBindingSize   = offsetof(clipmap_maps_params_t, padding),
+      },
+      .sampler = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Heights or the previous pyramid mip, not filterable
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2DArray,
+      },
+      .storageTexture = {0},
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Derivatives or pyramid mip
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .storageTexture = (WGPUStorageTextureBindingLayout) {
+        .access        = WGPUStorageTextureAccess_WriteOnly,
+        .format        = storage_format,
+        .viewDimension = WGPUTextureViewDimension_2DArray,
+      },
+      .sampler = {0},
+    },
+  };
+  WGPUBindGroupLayout bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    clipmap_maps.wgpu_context->device,
+    &(WGPUBindGroupLayoutDescriptor){
+      .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+      .entries    = bgl_entries,
+    });
+  ASSERT(bind_group_layout != NULL);
+  return bind_group_layout;
+}
+
+static WGPUBindGroup clipmap_maps_create_bind_group(WGPUBindGroupLayout layout,
+                                                    WGPUTextureView src,
+                                                    WGPUTextureView dst)
+{
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = clipmap_maps.params_buffer,
+      .offset  = 0,
+      .size    = offsetof(clipmap_maps_params_t, padding),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = src,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = dst,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    clipmap_maps.wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .layout     = layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(bind_group != NULL);
+  return bind_group;
+}
+
+// Keeps the read back tiles, unless the snapshot of their frame was reused
+static void clipmap_maps_bounds_read(const void* data, uint64_t size,
+                                     uint64_t frame_number, void* user_data)
+{
+  UNUSED_VAR(size);
+  UNUSED_VAR(user_data);
+
+  const uint32_t snapshot_count = (uint32_t)ARRAY_SIZE(clipmap_maps.snapshots);
+  if (clipmap_maps.snapshots[frame_number % snapshot_count].frame
+      != frame_number) {
+    return;
+  }
+
+  const uint8_t* rows = (const uint8_t*)data;
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    for (uint32_t z = 0; z < CLIPMAP_BOUNDS_TILE_COUNT; ++z) {
+      memcpy(clipmap_maps.tiles[l][z],
+             rows + (l * CLIPMAP_BOUNDS_TILE_COUNT + z)
+                      * CLIPMAP_BOUNDS_ROW_PITCH,
+             sizeof(clipmap_maps.tiles[l][z]));
+    }
+  }
+  memcpy(clipmap_maps.levels,
+         clipmap_maps.snapshots[frame_number % snapshot_count].levels,
+         sizeof(clipmap_maps.levels));
+}
+
+static void prepare_clipmap_maps(wgpu_context_t* wgpu_context)
+{
+  clipmap_maps.wgpu_context = wgpu_context;
+
+  // Derivatives, RGBA16Float is the smallest float format to store into
+  clipmap_maps.derivatives = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label = "terrain_derivative_clipmap",
+      .usage
+      = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_StorageBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){CLIPMAP_SIZE, CLIPMAP_SIZE,
+                                      CLIPMAP_LEVEL_COUNT},
+      .format        = WGPUTextureFormat_RGBA16Float,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(clipmap_maps.derivatives != NULL);
+  clipmap_maps.derivatives_view = wgpuTextureCreateView(
+    clipmap_maps.derivatives,
+    &(WGPUTextureViewDescriptor){
+      .format          = WGPUTextureFormat_RGBA16Float,
+      .dimension       = WGPUTextureViewDimension_2DArray,
+      .mipLevelCount   = 1,
+      .arrayLayerCount = CLIPMAP_LEVEL_COUNT,
+    });
+  ASSERT(clipmap_maps.derivatives_view != NULL);
+
+  // Min/max height pyramid, mip 0 has half the size of a level
+  clipmap_maps.bounds = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label = "terrain_height_bounds_pyramid",
+      .usage = WGPUTextureUsage_TextureBinding
+               | WGPUTextureUsage_StorageBinding | WGPUTextureUsage_CopySrc,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){CLIPMAP_SIZE / 2, CLIPMAP_SIZE / 2,
+                                      CLIPMAP_LEVEL_COUNT},
+      .format        = WGPUTextureFormat_RG32Float,
+      .mipLevelCount = CLIPMAP_BOUNDS_MIP_COUNT,
+      .sampleCount   = 1,
+    });
+  ASSERT(clipmap_maps.bounds != NULL);
+  for (uint32_t m = 0; m < CLIPMAP_BOUNDS_MIP_COUNT; ++m) {
+    clipmap_maps.bounds_views[m] = wgpuTextureCreateView(
+      clipmap_maps.bounds, &(WGPUTextureViewDescriptor){
+                             .format        = WGPUTextureFormat_RG32Float,
+                             .dimension     = WGPUTextureViewDimension_2DArray,
+                             .baseMipLevel  = m,
+                             .mipLevelCount = 1,
+                             .arrayLayerCount = CLIPMAP_LEVEL_COUNT,
+                           });
+    ASSERT(clipmap_maps.bounds_views[m] != NULL);
+  }
+
+  clipmap_maps.params_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "terrain_clipmap_maps_params",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = sizeof(clipmap_maps_params_t) * CLIPMAP_LEVEL_COUNT,
+    });
+  ASSERT(clipmap_maps.params_buffer != NULL);
+
+  const uint64_t bounds_size = (uint64_t)CLIPMAP_BOUNDS_ROW_PITCH
+                               * CLIPMAP_BOUNDS_TILE_COUNT
+                               * CLIPMAP_LEVEL_COUNT;
+  clipmap_maps.bounds_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "terrain_height_bounds_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc,
+      .size  = bounds_size,
+    });
+  ASSERT(clipmap_maps.bounds_buffer != NULL);
+  clipmap_maps.readback = wgpu_buffer_readback_create(
+    wgpu_context, &(wgpu_buffer_readback_desc_t){
+                    .size         = bounds_size,
+                    .buffer_count = CLIPMAP_READBACK_BUFFER_COUNT,
+                    .func         = clipmap_maps_bounds_read,
                   });
+  for (uint32_t i = 0; i < ARRAY_SIZE(clipmap_maps.snapshots); ++i) {
+    clipmap_maps.snapshots[i].frame = ~0ull;
+  }
+
+  // Pipelines and bind groups
+  clipmap_maps.derivatives_bind_group_layout
+    = clipmap_maps_create_bind_group_layout(WGPUTextureFormat_RGBA16Float);
+  clipmap_maps.bounds_bind_group_layout
+    = clipmap_maps_create_bind_group_layout(WGPUTextureFormat_RG32Float);
+  clipmap_maps.derivatives_pipeline = clipmap_maps_create_pipeline(
+    "terrain_derivatives_pipeline", clipmap_derivatives_shader_wgsl, "main",
+    clipmap_maps.derivatives_bind_group_layout);
+  clipmap_maps.bounds_pipeline = clipmap_maps_create_pipeline(
+    "terrain_bounds_pipeline", clipmap_bounds_shader_wgsl, "bounds_main",
+    clipmap_maps.bounds_bind_group_layout);
+  clipmap_maps.downsample_pipeline = clipmap_maps_create_pipeline(
+    "terrain_bounds_downsample_pipeline", clipmap_bounds_shader_wgsl,
+    "downsample_main", clipmap_maps.bounds_bind_group_layout);
+
+  clipmap_maps.derivatives_bind_group = clipmap_maps_create_bind_group(
+    clipmap_maps.derivatives_bind_group_layout, clipmap.view,
+    clipmap_maps.derivatives_view);
+  for (uint32_t m = 0; m < CLIPMAP_BOUNDS_MIP_COUNT; ++m) {
+    clipmap_maps.bounds_bind_groups[m] = clipmap_maps_create_bind_group(
+      clipmap_maps.bounds_bind_group_layout,
+      m == 0 ? clipmap.view : clipmap_maps.bounds_views[m - 1],
+      clipmap_maps.bounds_views[m]);
+  }
+}
+
+static void release_clipmap_maps(void)
+{
+  // Delivers the pending readbacks
+  wgpu_buffer_readback_release(clipmap_maps.readback);
+  clipmap_maps.readback = NULL;
+
+  for (uint32_t m = 0; m < CLIPMAP_BOUNDS_MIP_COUNT; ++m) {
+    WGPU_RELEASE_RESOURCE(BindGroup, clipmap_maps.bounds_bind_groups[m])
+    WGPU_RELEASE_RESOURCE(TextureView, clipmap_maps.bounds_views[m])
+  }
+  WGPU_RELEASE_RESOURCE(BindGroup, clipmap_maps.derivatives_bind_group)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, clipmap_maps.derivatives_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, clipmap_maps.bounds_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, clipmap_maps.downsample_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        clipmap_maps.derivatives_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, clipmap_maps.bounds_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(Buffer, clipmap_maps.params_buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, clipmap_maps.bounds_buffer)
+  WGPU_RELEASE_RESOURCE(TextureView, clipmap_maps.derivatives_view)
+  WGPU_RELEASE_RESOURCE(Texture, clipmap_maps.derivatives)
+  WGPU_RELEASE_RESOURCE(Texture, clipmap_maps.bounds)
+}
+
+// Marks the levels whose resident texels changed since their maps were
+// computed, after the clipmap update of the frame
+static void clipmap_maps_update(void)
+{
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    const clipmap_level_t* clipmap_level = &clipmap.levels[l];
+    const int32_t* resident              = clipmap_level->resident;
+    clipmap_maps_snapshot_t* computed    = &clipmap_maps.computed[l];
+    if (!clipmap_level->initialized || resident[0] >= resident[2]
+        || resident[1] >= resident[3]) {
+      // The bounds of the level are dropped with the next readback
+      clipmap_maps.readback_pending
+        = clipmap_maps.readback_pending || computed->valid;
+      computed->valid = false;
+      continue;
+    }
+    if (computed->valid
+        && memcmp(computed->origin, clipmap_level->origin,
+                  sizeof(computed->origin))
+             == 0
+        && memcmp(computed->resident, resident, sizeof(computed->resident))
+             == 0) {
+      continue;
+    }
+
+    computed->valid = true;
+    memcpy(computed->origin, clipmap_level->origin, sizeof(computed->origin));
+    memcpy(computed->resident, resident, sizeof(computed->resident));
+    clipmap_maps_params_t params = {
+      .origin   = {clipmap_level->origin[0], clipmap_level->origin[1]},
+      .layer    = (int32_t)l,
+      .spacing  = clipmap_level_spacing(l),
+      .resident = {resident[0], resident[1], resident[2], resident[3]},
+    };
+    wgpu_queue_write_buffer(clipmap_maps.wgpu_context,
+                            clipmap_maps.params_buffer,
+                            l * sizeof(clipmap_maps_params_t), &params,
+                            sizeof(params));
+    clipmap_maps.dirty[l] = true;
+  }
+}
+
+static void clipmap_maps_dispatch(WGPUComputePassEncoder cpass_enc,
+                                  uint32_t size)
+{
+  const uint32_t group_count = (size + 7) / 8;
+  wgpuComputePassEncoderDispatchWorkgroups(cpass_enc, group_count,
+                                           group_count, 1);
+}
+
+// Computes the maps of the marked levels and reads back their bounds
+static void clipmap_maps_record(WGPUCommandEncoder cmd_enc)
+{
+  bool dirty = false;
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    dirty = dirty || clipmap_maps.dirty[l];
+  }
+
+  if (dirty) {
+    WGPUComputePassEncoder cpass_enc
+      = wgpuCommandEncoderBeginComputePass(cmd_enc, NULL);
+    for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+      if (!clipmap_maps.dirty[l]) {
+        continue;
+      }
+      const uint32_t offset = l * sizeof(clipmap_maps_params_t);
+      wgpuComputePassEncoderSetPipeline(cpass_enc,
+                                        clipmap_maps.derivatives_pipeline);
+      wgpuComputePassEncoderSetBindGroup(
+        cpass_enc, 0, clipmap_maps.derivatives_bind_group, 1, &offset);
+      clipmap_maps_dispatch(cpass_enc, CLIPMAP_SIZE);
+      for (uint32_t m = 0; m < CLIPMAP_BOUNDS_MIP_COUNT; ++m) {
+        wgpuComputePassEncoderSetPipeline(
+          cpass_enc, m == 0 ? clipmap_maps.bounds_pipeline :
+                              clipmap_maps.downsample_pipeline);
+        wgpuComputePassEncoderSetBindGroup(
+          cpass_enc, 0, clipmap_maps.bounds_bind_groups[m], 1, &offset);
+        clipmap_maps_dispatch(cpass_enc, CLIPMAP_SIZE >> (m + 1));
+      }
+    }
+    wgpuComputePassEncoderEnd(cpass_enc);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, cpass_enc)
+
+    // The read back mip of the levels, the others keep their last copy
+    for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+      if (!clipmap_maps.dirty[l]) {
+        continue;
+      }
+      wgpuCommandEncoderCopyTextureToBuffer(
+        cmd_enc,
+        &(WGPUImageCopyTexture){
+          .texture  = clipmap_maps.bounds,
+          .mipLevel = CLIPMAP_BOUNDS_READBACK_MIP,
+          .origin   = (WGPUOrigin3D){0, 0, l},
+        },
+        &(WGPUImageCopyBuffer){
+          .buffer = clipmap_maps.bounds_buffer,
+          .layout = (WGPUTextureDataLayout){
+            .offset = (uint64_t)l * CLIPMAP_BOUNDS_TILE_COUNT
+                      * CLIPMAP_BOUNDS_ROW_PITCH,
+            .bytesPerRow  = CLIPMAP_BOUNDS_ROW_PITCH,
+            .rowsPerImage = CLIPMAP_BOUNDS_TILE_COUNT,
+          },
+        },
+        &(WGPUExtent3D){
+          .width              = CLIPMAP_BOUNDS_TILE_COUNT,
+          .height             = CLIPMAP_BOUNDS_TILE_COUNT,
+          .depthOrArrayLayers = 1,
+        });
+      clipmap_maps.dirty[l] = false;
+    }
+    clipmap_maps.readback_pending = true;
+  }
+
+  if (clipmap_maps.readback_pending) {
+    const uint32_t snapshot_count
+      = (uint32_t)ARRAY_SIZE(clipmap_maps.snapshots);
+    const uint64_t frame = ++clipmap_maps.frame;
+    clipmap_maps.snapshots[frame % snapshot_count].frame = frame;
+    memcpy(clipmap_maps.snapshots[frame % snapshot_count].levels,
+           clipmap_maps.computed, sizeof(clipmap_maps.computed));
+    clipmap_maps.readback_pending = !wgpu_buffer_readback_copy_buffer(
+      clipmap_maps.readback, cmd_enc, clipmap_maps.bounds_buffer, 0,
+      (uint64_t)CLIPMAP_BOUNDS_ROW_PITCH * CLIPMAP_BOUNDS_TILE_COUNT
+        * CLIPMAP_LEVEL_COUNT,
+      frame);
+  }
+}
+
+static int32_t clipmap_floor_div(int32_t a, int32_t b)
+{
+  return (a >= 0 ? a : a - b + 1) / b;
+}
+
+/*
+ * Height range of a node from the read back tiles. The vertex shader samples
+ * the finest level holding a point, the range is the union over the levels
+ * down to the first one that holds the whole node. Returns false when no
+ * level holds it.
+ */
+static bool clipmap_node_height_bounds(float x, float z, float size,
+                                       float bounds[2])
+{
+  float min_height = FLT_MAX, max_height = -FLT_MAX;
+  for (uint32_t l = 0; l < CLIPMAP_LEVEL_COUNT; ++l) {
+    const clipmap_maps_snapshot_t* level = &clipmap_maps.levels[l];
+    if (!level->valid) {
+      continue;
+    }
+    // Texels of the bilinear samples of the node, x0, z0, x1, z1
+    const float spacing  = clipmap_level_spacing(l);
+    const int32_t node[4] = {
+      (int32_t)floorf(x / spacing),
+      (int32_t)floorf(z / spacing),
+      (int32_t)floorf((x + size) / spacing) + 2,
+      (int32_t)floorf((z + size) / spacing) + 2,
+    };
+    const int32_t x0 = MAX(node[0], level->resident[0]);
+    const int32_t z0 = MAX(node[1], level->resident[1]);
+    const int32_t x1 = MIN(node[2], level->resident[2]);
+    const int32_t z1 = MIN(node[3], level->resident[3]);
+    if (x0 >= x1 || z0 >= z1) {
+      continue;
+    }
+
+    // The tiles of the slots of the texels
+    const int32_t tile_size  = CLIPMAP_BOUNDS_TILE_SIZE;
+    const int32_t tile_count = CLIPMAP_BOUNDS_TILE_COUNT;
+    for (int32_t tz = clipmap_floor_div(z0, tile_size);
+         tz <= clipmap_floor_div(z1 - 1, tile_size); ++tz) {
+      for (int32_t tx = clipmap_floor_div(x0, tile_size);
+           tx <= clipmap_floor_div(x1 - 1, tile_size); ++tx) {
+        const float* tile
+          = clipmap_maps.tiles[l][((tz % tile_count) + tile_count)
+                                  % tile_count]
+                              [((tx % tile_count) + tile_count) % tile_count];
+        min_height = MIN(min_height, tile[0]);
+        max_height = MAX(max_height, tile[1]);
+      }
+    }
+
+    if (x0 == node[0] && z0 == node[1] && x1 == node[2] && z1 == node[3]) {
+      bounds[0] = min_height * TERRAIN_HEIGHT;
+      bounds[1] = max_height * TERRAIN_HEIGHT;
+      return min_height <= max_height;
+    }
+  }
+  return false;
 }
 
 static void prepare_textures(wgpu_context_t* wgpu_context)
@@ -238,12 +1530,9 @@ static void prepare_textures(wgpu_context_t* wgpu_context)
     textures.color   = wgpu_create_texture_from_file(wgpu_context, file, NULL);
   }
 
-  // Heightmap texture
-  {
-    const char* file = "textures/heightmap.png";
-    textures.heightmap
-      = wgpu_create_texture_from_file(wgpu_context, file, NULL);
-  }
+  // Height clipmap and its derivative and height bounds maps
+  prepare_clipmap(wgpu_context);
+  prepare_clipmap_maps(wgpu_context);
 
   // Linear sampler
   WGPUSamplerDescriptor sampler_desc = {
@@ -313,6 +1602,120 @@ static void update_camera_pose(float dt)
   direction_change_countdown -= dt;
 }
 
+/* -------------------------------------------------------------------------- *
+ * Level of detail selection
+ * -------------------------------------------------------------------------- */
+
+// Level 0 holds the smallest patches, the roots are at the last level
+static float lod_node_size(uint32_t level)
+{
+  return LOD_ROOT_SIZE / (float)(1u << (LOD_LEVEL_COUNT - 1 - level));
+}
+
+/*
+ * The cells of a level-l node project to spacing * scale / distance pixels, it
+ * is split when nearer than the distance where that exceeds the pixel error
+ */
+static void update_lod_ranges(float viewport_height, float pixel_error)
+{
+  const float projection_scale = viewport_height / (2.0f * tan(fov_y * 0.5f));
+  for (uint32_t l = 0; l < LOD_LEVEL_COUNT; ++l) {
+    const float size    = lod_node_size(l);
+    const float spacing = size / (float)PATCH_SEGMENT_COUNT;
+    lod.ranges[l]       = MAX(spacing * projection_scale / pixel_error,
+                              size * LOD_MIN_RANGE_RATIO);
+  }
+}
+
+static float distance_to_box(vec3 p, vec3 box_min, vec3 box_max)
+{
+  float d2 = 0.0f;
+  for (uint32_t i = 0; i < 3; ++i) {
+    const float d = p[i] - CLAMP(p[i], box_min[i], box_max[i]);
+    d2 += d * d;
+  }
+  return sqrtf(d2);
+}
+
+static void select_lod_node(float x, float z, uint32_t level)
+{
+  const float size = lod_node_size(level);
+  vec3 box_min     = {x, 0.0f, z};
+  vec3 box_max     = {x + size, TERRAIN_HEIGHT, z + size};
+
+  float height_bounds[2];
+  if (lod.height_bounds
+      && clipmap_node_height_bounds(x, z, size, height_bounds)) {
+    box_min[1] = height_bounds[0];
+    box_max[1] = height_bounds[1];
+    ++lod.bounded_node_count;
+  }
+
+  const float dist = distance_to_box(camera_position, box_min, box_max);
+  if (dist > far_z
+      || (lod.frustum_culling
+          && !frustum_check_box(&lod.frustum, box_min, box_max))) {
+    ++lod.culled_node_count;
+    return;
+  }
+
+  if (level == 0 || dist >= lod.ranges[level]) {
+    if (instance_count < MAX_PATCH_COUNT) {
+      patches[instance_count++] = (terrain_patch_t){
+        .origin = {x, z},
+        .size   = size,
+        .level  = level,
+      };
+    }
+    return;
+  }
+
+  const float half_size = size * 0.5f;
+  select_lod_node(x, z, level - 1);
+  select_lod_node(x + half_size, z, level - 1);
+  select_lod_node(x, z + half_size, level - 1);
+  select_lod_node(x + half_size, z + half_size, level - 1);
+}
+
+static void select_patches(float viewport_height)
+{
+  // Root nodes around the one below the camera
+  const float root_x
+    = (floorf(camera_position[0] / LOD_ROOT_SIZE) - LOD_ROOT_GRID_SIZE / 2)
+      * LOD_ROOT_SIZE;
+  const float root_z
+    = (floorf(camera_position[2] / LOD_ROOT_SIZE) - LOD_ROOT_GRID_SIZE / 2)
+      * LOD_ROOT_SIZE;
+
+  // Coarser selections until the patches fit in the budget
+  lod.effective_pixel_error = lod.pixel_error;
+  for (uint32_t attempt = 0; attempt < 16; ++attempt) {
+    update_lod_ranges(viewport_height, lod.effective_pixel_error);
+    instance_count        = 0;
+    lod.culled_node_count  = 0;
+    lod.bounded_node_count = 0;
+    for (uint32_t rz = 0; rz < LOD_ROOT_GRID_SIZE; ++rz) {
+      for (uint32_t rx = 0; rx < LOD_ROOT_GRID_SIZE; ++rx) {
+        select_lod_node(root_x + rx * LOD_ROOT_SIZE,
+                        root_z + rz * LOD_ROOT_SIZE, LOD_LEVEL_COUNT - 1);
+      }
+    }
+    if (instance_count <= (uint32_t)lod.patch_budget) {
+      break;
+    }
+    lod.effective_pixel_error *= 1.25f;
+  }
+
+  // A patch morphs into the grid of its parent towards the distance where the
+  // parent is no longer split, the roots never do
+  for (uint32_t l = 0; l < LOD_LEVEL_COUNT; ++l) {
+    const float morph_end
+      = (l + 1 < LOD_LEVEL_COUNT) ? lod.ranges[l + 1] : 2.0f * far_z;
+    frame_uniforms.morph_ranges[l][0] = morph_end * LOD_MORPH_START;
+    frame_uniforms.morph_ranges[l][1] = morph_end;
+  }
+}
+
 static void update_uniforms(wgpu_example_context_t* context)
 {
   const float frame_timestamp_millis = context->frame.timestamp_millis;
@@ -321,28 +1724,6 @@ static void update_uniforms(wgpu_example_context_t* context)
 
   update_camera_pose(dt);
 
-  const float patch_size = (float)PATCH_SIZE;
-
-  // Determine the nearest nine terrain patches and calculate their positions
-  const vec3 nearest_patch_center = {
-    round(camera_position[0] / patch_size) * patch_size, // x
-    0.0f,                                                // y
-    round(camera_position[2] / patch_size) * patch_size  // z
-  };
-  uint32_t patch_index = 0;
-  for (int8_t pz = -1; pz <= 1; ++pz) {
-    for (int8_t px = -1; px <= 1; ++px) {
-      glm_vec3_copy(
-        (vec3){
-          nearest_patch_center[0] + patch_size * px, // x
-          nearest_patch_center[1],                   // y
-          nearest_patch_center[2] + patch_size * pz  // z
-        },
-        patch_centers[patch_index]);
-      ++patch_index;
-    }
-  }
-
   // Calculate view and projection matrices
   mat4_rotation_y(&rot_y, -camera_heading);
   mat4_translation(&trans, (vec3){-camera_position[0], -camera_position[1],
@@ -350,36 +1731,50 @@ static void update_uniforms(wgpu_example_context_t* context)
   mat4_mul(&rot_y, &trans, &view_matrix);
   const float aspect_ratio = context->window_size.aspect_ratio;
   mat4_perspective_fov(fov_y, aspect_ratio, near_z, far_z, &projection_matrix);
-
-  // Calculate the per-instance matrices
-  if (instance_data == NULL) {
-    instance_data = calloc(instance_buffer_length / 4, sizeof(float));
+  mat4_mul(&projection_matrix, &view_matrix, &view_projection_matrix);
+
+  // Select the patches in the view frustum
+  mat4 frustum_matrix;
+  memcpy(frustum_matrix, view_projection_matrix, sizeof(frustum_matrix));
+  frustum_update(&lod.frustum, frustum_matrix);
+  select_patches((float)context->wgpu_context->surface.height);
+
+  // Move the clipmap levels with the camera
+  clipmap_update();
+  clipmap_maps_update();
+
+  // Write the frame uniforms and the patches
+  memcpy(frame_uniforms.view_matrix, view_matrix, sizeof(view_matrix));
+  memcpy(frame_uniforms.projection_matrix, projection_matrix,
+         sizeof(projection_matrix));
+  glm_vec4_copy((vec4){camera_position[0], camera_position[1],
+                       camera_position[2], 1.0f},
+                frame_uniforms.camera_position);
+  glm_vec4_copy((vec4){(float)PATCH_SIZE, (float)PATCH_SEGMENT_COUNT,
+                       TERRAIN_HEIGHT, far_z},
+                frame_uniforms.terrain);
+  wgpu_queue_write_buffer(context->wgpu_context, uniform_buffer.buffer, 0,
+                          &frame_uniforms, sizeof(frame_uniforms));
+  if (instance_count > 0) {
+    wgpu_queue_write_buffer(context->wgpu_context, instance_buffer.buffer, 0,
+                            patches, instance_count * sizeof(terrain_patch_t));
   }
-  instance_count = MIN(ARRAY_SIZE(patch_centers), max_instance_count);
-  for (uint32_t i = 0; i < instance_count; ++i) {
-    mat4_translation(&model_matrix, patch_centers[i]);
-    mat4_mul(&view_matrix, &model_matrix, &model_view_matrix);
-    mat4_mul(&projection_matrix, &model_view_matrix,
-             &model_view_projection_matrix);
-    memcpy(instance_data + (i * instance_length), model_view_matrix,
-           sizeof(model_view_matrix));
-    memcpy(instance_data + (i * instance_length + 16),
-           model_view_projection_matrix, sizeof(model_view_projection_matrix));
-  }
-
-  // Write the instance data to the instance buffer
-  wgpu_queue_write_buffer(context->wgpu_context, instance_buffer.buffer, 0,
-                          instance_data,
-                          (instance_buffer_length / 4) * sizeof(float));
 }
 
 static void prepare_uniform_buffers(wgpu_example_context_t* context)
 {
-  instance_buffer = wgpu_create_buffer(
+  uniform_buffer = wgpu_create_buffer(
     context->wgpu_context,
     &(wgpu_buffer_desc_t){
       .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
-      .size  = instance_buffer_length,
+      .size  = sizeof(frame_uniforms),
+    });
+
+  instance_buffer = wgpu_create_buffer(
+    context->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = sizeof(patches),
     });
 }
 
@@ -387,7 +1782,7 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
 {
   // Frame constants bind group layout
   {
-    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+    WGPUBindGroupLayoutEntry bgl_entries[4] = {
       [0] = (WGPUBindGroupLayoutEntry) {
         // Sampler
         .binding    = 0,
@@ -409,12 +1804,23 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
         .storageTexture = {0},
       },
       [2] = (WGPUBindGroupLayoutEntry) {
-        // Texture view
+        // Height clipmap, R32Float texels are not filterable
         .binding    = 2,
         .visibility = WGPUShaderStage_Vertex,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+          .viewDimension = WGPUTextureViewDimension_2DArray,
+          .multisampled  = false,
+        },
+        .storageTexture = {0},
+      },
+      [3] = (WGPUBindGroupLayoutEntry) {
+        // Derivative clipmap
+        .binding    = 3,
+        .visibility = WGPUShaderStage_Vertex,
         .texture = (WGPUTextureBindingLayout) {
           .sampleType    = WGPUTextureSampleType_Float,
-          .viewDimension = WGPUTextureViewDimension_2D,
+          .viewDimension = WGPUTextureViewDimension_2DArray,
           .multisampled  = false,
         },
         .storageTexture = {0},
@@ -428,17 +1834,28 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
     ASSERT(bind_group_layouts.frame_constants != NULL)
   }
 
-  // Instance buffer bind group
+  // Frame uniforms and instance buffer bind group
   {
-    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+    WGPUBindGroupLayoutEntry bgl_entries[2] = {
       [0] = (WGPUBindGroupLayoutEntry) {
-        // Transform
+        // Frame uniforms
         .binding = 0,
-        .visibility = WGPUShaderStage_Vertex,
+        .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
         .buffer = (WGPUBufferBindingLayout) {
           .type = WGPUBufferBindingType_Uniform,
           .hasDynamicOffset = false,
-          .minBindingSize   = instance_buffer_length,
+          .minBindingSize   = sizeof(frame_uniforms),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Patches
+        .binding = 1,
+        .visibility = WGPUShaderStage_Vertex,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type = WGPUBufferBindingType_ReadOnlyStorage,
+          .hasDynamicOffset = false,
+          .minBindingSize   = sizeof(terrain_patch_t),
         },
         .sampler = {0},
       },
@@ -470,7 +1887,7 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
 {
   // Frame constants bind group
   {
-    WGPUBindGroupEntry bg_entries[3] = {
+    WGPUBindGroupEntry bg_entries[4] = {
       [0] = (WGPUBindGroupEntry) {
         .binding = 0,
         .sampler = linear_sampler,
@@ -481,7 +1898,11 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
       },
       [2] = (WGPUBindGroupEntry) {
         .binding     = 2,
-        .textureView = textures.heightmap.view,
+        .textureView = clipmap.view,
+      },
+      [3] = (WGPUBindGroupEntry) {
+        .binding     = 3,
+        .textureView = clipmap_maps.derivatives_view,
       }
     };
     WGPUBindGroupDescriptor bg_desc = {
@@ -494,11 +1915,17 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
     ASSERT(bind_groups.frame_constants != NULL)
   }
 
-  // Instance buffer bind group
+  // Frame uniforms and instance buffer bind group
   {
-    WGPUBindGroupEntry bg_entries[1] = {
+    WGPUBindGroupEntry bg_entries[2] = {
       [0] = (WGPUBindGroupEntry) {
         .binding = 0,
+        .buffer  = uniform_buffer.buffer,
+        .offset  = 0,
+        .size    = uniform_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding = 1,
         .buffer  = instance_buffer.buffer,
         .offset  = 0,
         .size    = instance_buffer.size,
@@ -517,10 +1944,11 @@ static void setup_bind_groups(wgpu_context_t* wgpu_context)
 
 static void prepare_pipelines(wgpu_context_t* wgpu_context)
 {
-  // Primitive state
+  // Primitive state, the plane is counter-clockwise in the (x, y) plane, i.e.
+  // clockwise in the (x, z) plane of the terrain
   WGPUPrimitiveState primitive_state = {
     .topology  = WGPUPrimitiveTopology_TriangleList,
-    .frontFace = WGPUFrontFace_CCW,
+    .frontFace = WGPUFrontFace_CW,
     .cullMode  = WGPUCullMode_Back,
   };
 
@@ -542,20 +1970,20 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
 
   // Vertex buffer layout
   WGPU_VERTEX_BUFFER_LAYOUT(
-    terrain_mesh, 24,
+    terrain_mesh, sizeof(wgpu_procedural_vertex_t),
     /* Attribute descriptions */
-    // Attribute location 0: Position
-    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x4, 0),
-    // Attribute location 1: Texture coordinates
-    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x2, 16))
+    // Attribute location 0: Grid position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x2,
+                       offsetof(wgpu_procedural_vertex_t, position)))
 
   // Vertex state
   WGPUVertexState vertex_state = wgpu_create_vertex_state(
                     wgpu_context, &(wgpu_vertex_state_t){
                     .shader_desc = (wgpu_shader_desc_t){
-                      // Vertex shader SPIR-V
-                      .label = "terrain_mesh_vertex_shader",
-                      .file  = "shaders/terrain_mesh/shader.vert.spv",
+                      // Vertex shader WGSL
+                      .label            = "terrain_mesh_vertex_shader",
+                      .wgsl_code.source = terrain_shader_wgsl,
+                      .entry            = "vs_main",
                     },
                     .buffer_count = 1,
                     .buffers      = &terrain_mesh_vertex_buffer_layout,
@@ -565,9 +1993,10 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPUFragmentState fragment_state = wgpu_create_fragment_state(
                     wgpu_context, &(wgpu_fragment_state_t){
                     .shader_desc = (wgpu_shader_desc_t){
-                      // Fragment shader SPIR-V
-                      .label = "terrain_mesh_fragment_shader",
-                      .file  = "shaders/terrain_mesh/shader.frag.spv",
+                      // Fragment shader WGSL
+                      .label            = "terrain_mesh_fragment_shader",
+                      .wgsl_code.source = terrain_shader_wgsl,
+                      .entry            = "fs_main",
                     },
                     .target_count = 1,
                     .targets      = &color_target_state,
@@ -614,6 +2043,28 @@ static int example_initialize(wgpu_example_context_t* context)
   return 1;
 }
 
+static void example_on_update_ui_overlay(wgpu_example_context_t* context)
+{
+  if (imgui_overlay_header("Settings")) {
+    imgui_overlay_slider_float(context->imgui_overlay, "Pixel error",
+                               &lod.pixel_error, 0.5f, 16.0f);
+    imgui_overlay_slider_int(context->imgui_overlay, "Patch budget",
+                             &lod.patch_budget, 16, MAX_PATCH_COUNT);
+    imgui_overlay_checkBox(context->imgui_overlay, "Frustum culling",
+                           &lod.frustum_culling);
+    imgui_overlay_checkBox(context->imgui_overlay, "Height bounds",
+                           &lod.height_bounds);
+  }
+  if (imgui_overlay_header("Statistics")) {
+    imgui_overlay_text("Patches: %u", instance_count);
+    imgui_overlay_text("Triangles: %u",
+                       instance_count * (uint32_t)PATCH_INDEX_COUNT / 3);
+    imgui_overlay_text("Culled nodes: %u", lod.culled_node_count);
+    imgui_overlay_text("Bounded nodes: %u", lod.bounded_node_count);
+    imgui_overlay_text("Effective error: %.2f px", lod.effective_pixel_error);
+  }
+}
+
 static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 {
   // Set target frame buffer
@@ -623,28 +2074,31 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Derivatives and height bounds of the changed clipmap levels
+  clipmap_maps_record(wgpu_context->cmd_enc);
+
   // Create render pass encoder for encoding drawing commands
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass_desc);
 
   wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, render_pipeline);
-  wgpuRenderPassEncoderSetVertexBuffer(wgpu_context->rpass_enc, 0,
-                                       vertices.buffer, 0, WGPU_WHOLE_SIZE);
+  wgpu_procedural_mesh_bind(patch_mesh, wgpu_context->rpass_enc, 0);
   wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0,
                                     bind_groups.frame_constants, 0, 0);
   wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 1,
                                     bind_groups.instance_buffer, 0, 0);
-  wgpuRenderPassEncoderSetIndexBuffer(wgpu_context->rpass_enc, indices.buffer,
-                                      WGPUIndexFormat_Uint32, 0,
-                                      WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderDrawIndexed(wgpu_context->rpass_enc,
-                                   (uint32_t)PATCH_INDEX_COUNT, instance_count,
-                                   0, 0, 0);
+  if (instance_count > 0) {
+    wgpu_procedural_mesh_draw(patch_mesh, wgpu_context->rpass_enc, 0,
+                              instance_count, 0);
+  }
 
   // Create command buffer and cleanup
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
   WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
 
+  // Draw ui overlay
+  draw_ui(wgpu_context->context, example_on_update_ui_overlay);
+
   WGPUCommandBuffer command_buffer
     = wgpu_get_command_buffer(wgpu_context->cmd_enc);
   WGPU_RELEASE_RESOURCE(CommandEncoder, wgpu_context->cmd_enc)
@@ -665,6 +2119,7 @@ static int example_draw(wgpu_example_context_t* context)
 
   // Submit to queue
   submit_command_buffers(context);
+  wgpu_buffer_readback_update(clipmap_maps.readback);
 
   // Submit frame
   submit_frame(context);
@@ -685,16 +2140,13 @@ static void example_destroy(wgpu_example_context_t* context)
 {
   UNUSED_VAR(context);
 
-  if (instance_data != NULL) {
-    free(instance_data);
-  }
-
   wgpu_destroy_texture(&textures.color);
-  wgpu_destroy_texture(&textures.heightmap);
+  release_clipmap_maps();
+  release_clipmap();
   WGPU_RELEASE_RESOURCE(Sampler, linear_sampler)
 
-  WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
-  WGPU_RELEASE_RESOURCE(Buffer, indices.buffer)
+  wgpu_procedural_mesh_release(patch_mesh);
+  WGPU_RELEASE_RESOURCE(Buffer, uniform_buffer.buffer)
   WGPU_RELEASE_RESOURCE(Buffer, instance_buffer.buffer)
   WGPU_RELEASE_RESOURCE(RenderPipeline, render_pipeline)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
@@ -704,12 +2156,47 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_groups.instance_buffer)
 }
 
+// --heightmap=<file> streams a raw heightmap of --heightmap-size=<w>x<h>
+// samples, --heightmap-spacing=<meters> apart
+static void parse_terrain_arguments(int argc, char* argv[])
+{
+  static const char file_option[]    = "--heightmap=";
+  static const char size_option[]    = "--heightmap-size=";
+  static const char spacing_option[] = "--heightmap-spacing=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], file_option, strlen(file_option)) == 0) {
+      heightmap_source.filename = argv[i] + strlen(file_option);
+    }
+    else if (strncmp(argv[i], size_option, strlen(size_option)) == 0) {
+      unsigned int width = 0, height = 0;
+      if (sscanf(argv[i] + strlen(size_option), "%ux%u", &width, &height)
+          == 2) {
+        heightmap_source.width  = width;
+        heightmap_source.height = height;
+      }
+    }
+    else if (strncmp(argv[i], spacing_option, strlen(spacing_option)) == 0) {
+      heightmap_source.spacing
+        = MAX((float)atof(argv[i] + strlen(spacing_option)), 0.01f);
+    }
+  }
+  if (heightmap_source.filename != NULL
+      && (heightmap_source.width == 0 || heightmap_source.height == 0)) {
+    log_error("The size of '%s' is missing, use --heightmap-size=<w>x<h>\n",
+              heightmap_source.filename);
+    heightmap_source.filename = NULL;
+  }
+}
+
 void example_terrain_mesh(int argc, char* argv[])
 {
+  parse_terrain_arguments(argc, argv);
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
-      .title = example_title,
+      .title   = example_title,
+      .overlay = true,
     },
     .example_initialize_func = &example_initialize,
     .example_render_func     = &example_render,
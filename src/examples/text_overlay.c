@@ -71,7 +71,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
   const uint32_t gltf_loading_flags
     = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
       | WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors
-      | WGPU_GLTF_FileLoadingFlags_DontLoadImages;
+      | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+      | WGPU_GLTF_FileLoadingFlags_UseCache;
   model = wgpu_gltf_model_load_from_file(&(wgpu_gltf_model_load_options_t){
     .wgpu_context       = wgpu_context,
     .filename           = "models/cube.gltf",
@@ -317,8 +318,11 @@ void update_text_overlay(wgpu_example_context_t* context)
   vec3 projected = GLM_VEC3_ZERO_INIT;
   glm_project((vec3){0.0f, 0.0f, 0.0}, model_view_projection,
               (vec4){0.f, 0.f, width, height}, projected);
+  // The distance field atlas serves larger text as well
+  text_overlay_set_text_size(text_overlay.handle, 32.0f);
   text_overlay_add_text(text_overlay.handle, "A cube", projected[0],
                         height - projected[1], TextOverlay_Text_AlignCenter);
+  text_overlay_set_text_size(text_overlay.handle, 18.0f);
 
   text_overlay_end_text_update(text_overlay.handle);
 }
@@ -3,6 +3,9 @@
 
 #include <string.h>
 
+#include "../core/job_system.h"
+#include "../core/random.h"
+#include "../webgpu/gpu_profiler.h"
 #include "../webgpu/imgui_overlay.h"
 #include "../webgpu/texture.h"
 
@@ -15,6 +18,12 @@
  * device and samples it to render an animation. 3D textures store volumetric
  * data and interpolate in all three dimensions.
  *
+ * The noise can also be generated by a compute shader, with the permutation
+ * table in a uniform buffer, which is fast enough to regenerate volumes of up
+ * to 512^3 interactively. R8Unorm is not a storage texture format, so the
+ * shader packs four voxels per word into a storage buffer that is then copied
+ * into the texture. The CPU generator is kept as the reference.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/texture3d/texture3d.cpp
  * -------------------------------------------------------------------------- */
@@ -47,28 +56,6 @@ static float grad(int hash, float x, float y, float z)
   return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
 
-/**
- * @brief Fisher–Yates shuffle implementation.
- * @see
- * https://stackoverflow.com/questions/42321370/fisher-yates-shuffling-algorithm-in-c
- * @see
- * https://stackoverflow.com/questions/3343797/is-this-c-implementation-of-fisher-yates-shuffle-correct
- * @ref https://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle
- */
-static void fisher_yates_shuffle(uint8_t* values, int n)
-{
-  // implementation of Fisher
-  int i = 0, j = 0; // create local variables to hold values for shuffle
-  uint8_t tmp = 0;
-
-  for (i = n - 1; i > 0; i--) {   // for loop to shuffle
-    j         = rand() % (i + 1); // randomise j for shuffle with Fisher Yates
-    tmp       = values[j];
-    values[j] = values[i];
-    values[i] = tmp;
-  }
-}
-
 static void perlin_noise_init(perlin_noise_t* perlin_noise)
 {
   // Generate random lookup for permutations containing all numbers from 0..255
@@ -76,7 +63,7 @@ static void perlin_noise_init(perlin_noise_t* perlin_noise)
   for (uint32_t i = 0; i < 256; i++) {
     plookup[i] = (uint8_t)i;
   }
-  fisher_yates_shuffle(plookup, 256);
+  random_shuffle(random_get_thread_generator(), plookup, 256, 1);
   for (uint32_t i = 0; i < 256; i++) {
     perlin_noise->permutations[i]       = plookup[i];
     perlin_noise->permutations[256 + i] = plookup[i];
@@ -168,11 +155,19 @@ static float fractal_noise_generate(fractal_noise_t* fractal_noise, float x,
  * WebGPU 3D textures example
  * -------------------------------------------------------------------------- */
 
-#define NOISE_TEXTURE_WIDTH 128
-#define NOISE_TEXTURE_HEIGHT 128
-#define NOISE_TEXTURE_DEPTH 128
-#define NOISE_TEXTURE_SIZE                                                     \
-  (NOISE_TEXTURE_WIDTH * NOISE_TEXTURE_HEIGHT * NOISE_TEXTURE_DEPTH)
+// Selectable noise texture dimensions, in voxels per side
+static const uint32_t noise_texture_dims[4] = {64, 128, 256, 512};
+static const char* noise_texture_dim_names[4] = {"64^3", "128^3", "256^3",
+                                                 "512^3"};
+
+typedef enum noise_generator_enum {
+  NOISE_GENERATOR_CPU = 0,
+  NOISE_GENERATOR_GPU = 1,
+} noise_generator_enum;
+
+static const char* noise_generator_names[2] = {"CPU (reference)", "GPU"};
+
+static const char* noise_scope_name = "Noise generation";
 
 // Contains all Vulkan objects that are required to store and use a 3D texture
 static struct {
@@ -182,13 +177,151 @@ static struct {
   WGPUTextureFormat format;
   uint32_t width, height, depth;
   uint32_t mip_levels;
-  uint8_t data[NOISE_TEXTURE_SIZE];
+  uint8_t* data; // Voxels of the CPU generator
   struct {
     perlin_noise_t perlin_noise;
     fractal_noise_t fractal_noise;
   } data_generation;
 } noise_texture;
 
+// Noise generation settings and timings
+static struct {
+  int32_t generator;
+  int32_t dim_index;
+  bool regenerate;   // Generate new noise before the next frame
+  bool resize;       // Recreate the texture before the next frame
+  bool gpu_pending;  // Record the GPU generation into the next frame
+  float cpu_time_ms; // Generation and upload of the last CPU run
+  float gpu_time_ms; // Compute shader and copy of the last GPU run
+} generation = {
+  .generator   = NOISE_GENERATOR_GPU,
+  .dim_index   = 1,
+  .regenerate  = true,
+  .gpu_time_ms = -1.0f,
+  .cpu_time_ms = -1.0f,
+};
+
+// Compute noise generator
+static struct {
+  wgpu_buffer_t uniform_buffer;
+  // Four voxels per word, the rows are padded to the copy alignment
+  wgpu_buffer_t voxels;
+  uint32_t bytes_per_row;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+  WGPUPipelineLayout pipeline_layout;
+  WGPUComputePipeline pipeline;
+} noise_compute;
+
+static struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t words_per_row;
+  float scale;
+  uint32_t octaves;
+  float persistence;
+  uint32_t padding;
+  uint32_t permutations[512];
+} noise_params;
+
+// Compute shader, a translation of perlin_noise_generate and
+// fractal_noise_generate
+// clang-format off
+static const char* noise_compute_shader_wgsl = CODE(
+  struct NoiseParams {
+    size : vec3<u32>,
+    wordsPerRow : u32,
+    scale : f32,
+    octaves : u32,
+    persistence : f32,
+    padding : u32,
+    permutations : array<vec4<u32>, 128>,
+  };
+
+  @group(0) @binding(0) var<uniform> params : NoiseParams;
+  @group(0) @binding(1) var<storage, read_write> voxels : array<u32>;
+
+  fn perm(i : u32) -> u32 {
+    return params.permutations[i / 4u][i % 4u];
+  }
+
+  fn fade(t : f32) -> f32 {
+    return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+  }
+
+  fn grad(hash : u32, x : f32, y : f32, z : f32) -> f32 {
+    let h = hash & 15u;
+    let u = select(y, x, h < 8u);
+    let v = select(select(z, x, h == 12u || h == 14u), y, h < 4u);
+    return select(-u, u, (h & 1u) == 0u) + select(-v, v, (h & 2u) == 0u);
+  }
+
+  fn perlinNoise(p : vec3<f32>) -> f32 {
+    let X = u32(i32(floor(p.x)) & 255);
+    let Y = u32(i32(floor(p.y)) & 255);
+    let Z = u32(i32(floor(p.z)) & 255);
+    let x = p.x - floor(p.x);
+    let y = p.y - floor(p.y);
+    let z = p.z - floor(p.z);
+
+    let u = fade(x);
+    let v = fade(y);
+    let w = fade(z);
+
+    let A = perm(X) + Y;
+    let AA = perm(A) + Z;
+    let AB = perm(A + 1u) + Z;
+    let B = perm(X + 1u) + Y;
+    let BA = perm(B) + Z;
+    let BB = perm(B + 1u) + Z;
+
+    return mix(
+      mix(mix(grad(perm(AA), x, y, z), grad(perm(BA), x - 1.0, y, z), u),
+          mix(grad(perm(AB), x, y - 1.0, z),
+              grad(perm(BB), x - 1.0, y - 1.0, z), u), v),
+      mix(mix(grad(perm(AA + 1u), x, y, z - 1.0),
+              grad(perm(BA + 1u), x - 1.0, y, z - 1.0), u),
+          mix(grad(perm(AB + 1u), x, y - 1.0, z - 1.0),
+              grad(perm(BB + 1u), x - 1.0, y - 1.0, z - 1.0), u), v), w);
+  }
+
+  fn fractalNoise(p : vec3<f32>) -> f32 {
+    var sum = 0.0;
+    var frequency = 1.0;
+    var amplitude = 1.0;
+    var maxValue = 0.0;
+    for (var i = 0u; i < params.octaves; i = i + 1u) {
+      sum = sum + perlinNoise(p * frequency) * amplitude;
+      maxValue = maxValue + amplitude;
+      amplitude = amplitude * params.persistence;
+      frequency = frequency * 2.0;
+    }
+    sum = sum / maxValue;
+    return (sum + 1.0) / 2.0;
+  }
+
+  // Four consecutive voxels of a row per invocation
+  @compute @workgroup_size(8, 8, 4)
+  fn main(@builtin(global_invocation_id) global_id : vec3<u32>) {
+    if (global_id.x * 4u >= params.size.x || global_id.y >= params.size.y
+        || global_id.z >= params.size.z) {
+      return;
+    }
+    var word = 0u;
+    for (var i = 0u; i < 4u; i = i + 1u) {
+      let voxel = vec3<u32>(global_id.x * 4u + i, global_id.yz);
+      var n = fractalNoise(vec3<f32>(voxel) / vec3<f32>(params.size)
+                           * params.scale);
+      n = n - floor(n);
+      word = word | (u32(floor(n * 255.0)) << (i * 8u));
+    }
+    voxels[(global_id.z * params.size.y + global_id.y) * params.wordsPerRow
+           + global_id.x] = word;
+  }
+);
+// clang-format on
+
 // Vertex layout for this example
 typedef struct vertex_t {
   vec3 pos;
@@ -245,19 +378,13 @@ static void setup_camera(wgpu_example_context_t* context)
                          context->window_size.aspect_ratio, 0.1f, 256.0f);
 }
 
-// Generate randomized noise and upload it to the 3D texture using staging
-static void update_noise_texture(wgpu_context_t* wgpu_context)
+// Fills the z slices [begin, end) of the noise texture
+static void generate_noise_slices(void* user_data, uint32_t begin,
+                                  uint32_t end)
 {
-  memset(noise_texture.data, 0, (uint64_t)NOISE_TEXTURE_SIZE);
+  const float noiseScale = *(float*)user_data;
 
-  perlin_noise_init(&noise_texture.data_generation.perlin_noise);
-  fractal_noise_init(&noise_texture.data_generation.fractal_noise,
-                     &noise_texture.data_generation.perlin_noise);
-
-  const float noiseScale = (float)(rand() % 10) + 4.0f;
-
-#pragma omp parallel for
-  for (int32_t z = 0; z < (int32_t)noise_texture.depth; z++) {
+  for (int32_t z = (int32_t)begin; z < (int32_t)end; z++) {
     for (int32_t y = 0; y < (int32_t)noise_texture.height; y++) {
       for (int32_t x = 0; x < (int32_t)noise_texture.width; x++) {
         float nx = (float)x / (float)noise_texture.width;
@@ -279,6 +406,23 @@ static void update_noise_texture(wgpu_context_t* wgpu_context)
       }
     }
   }
+}
+
+// Generate randomized noise and upload it to the 3D texture using staging
+static void update_noise_texture(wgpu_context_t* wgpu_context,
+                                 float noise_scale)
+{
+  const float start_time = platform_get_time();
+
+  if (noise_texture.data == NULL) {
+    noise_texture.data = malloc((size_t)noise_texture.width
+                                * noise_texture.height * noise_texture.depth);
+    ASSERT(noise_texture.data != NULL);
+  }
+
+  // Generate the z slices on the shared job system
+  job_system_parallel_for(job_system_get_shared(), noise_texture.depth, 1,
+                          generate_noise_slices, &noise_scale);
 
   // Copy 3D noise data to texture
   wgpu_image_to_texure(wgpu_context, noise_texture.texture, noise_texture.data,
@@ -288,6 +432,49 @@ static void update_noise_texture(wgpu_context_t* wgpu_context)
                          .depthOrArrayLayers = noise_texture.depth,
                        },
                        1u);
+
+  generation.cpu_time_ms = (platform_get_time() - start_time) * 1000.0f;
+}
+
+// Hands the permutations and the scale to the compute shader, the noise is
+// generated by the next command buffer
+static void update_noise_params(wgpu_context_t* wgpu_context,
+                                float noise_scale)
+{
+  const fractal_noise_t* fractal_noise
+    = &noise_texture.data_generation.fractal_noise;
+  noise_params.width         = noise_texture.width;
+  noise_params.height        = noise_texture.height;
+  noise_params.depth         = noise_texture.depth;
+  noise_params.words_per_row = noise_compute.bytes_per_row / 4;
+  noise_params.scale         = noise_scale;
+  noise_params.octaves       = fractal_noise->octaves;
+  noise_params.persistence   = fractal_noise->persistence;
+  memcpy(noise_params.permutations,
+         noise_texture.data_generation.perlin_noise.permutations,
+         sizeof(noise_params.permutations));
+
+  wgpu_queue_write_buffer(wgpu_context, noise_compute.uniform_buffer.buffer, 0,
+                          &noise_params, sizeof(noise_params));
+  generation.gpu_pending = true;
+}
+
+// New random permutations and scale for the selected generator
+static void regenerate_noise(wgpu_context_t* wgpu_context)
+{
+  perlin_noise_init(&noise_texture.data_generation.perlin_noise);
+  fractal_noise_init(&noise_texture.data_generation.fractal_noise,
+                     &noise_texture.data_generation.perlin_noise);
+
+  const float noise_scale
+    = (float)random_next_bounded(random_get_thread_generator(), 10) + 4.0f;
+
+  if (generation.generator == NOISE_GENERATOR_CPU) {
+    update_noise_texture(wgpu_context, noise_scale);
+  }
+  else {
+    update_noise_params(wgpu_context, noise_scale);
+  }
 }
 
 // Prepare all Vulkan resources for the 3D texture
@@ -342,7 +529,28 @@ static void prepare_noise_texture(wgpu_context_t* wgpu_context, uint32_t width,
     = wgpuTextureCreateView(noise_texture.texture, &texture_view_dec);
   ASSERT(noise_texture.view != NULL);
 
-  update_noise_texture(wgpu_context);
+  // Output of the compute shader, copied into the texture
+  noise_compute.bytes_per_row = (noise_texture.width + 255) & ~255u;
+  const uint64_t voxels_size  = (uint64_t)noise_compute.bytes_per_row
+                               * noise_texture.height * noise_texture.depth;
+  noise_compute.voxels = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "texture_3d_noise_voxels_buffer",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+                    .size  = voxels_size,
+                  });
+}
+
+static void release_noise_texture(void)
+{
+  WGPU_RELEASE_RESOURCE(Texture, noise_texture.texture)
+  WGPU_RELEASE_RESOURCE(TextureView, noise_texture.view)
+  WGPU_RELEASE_RESOURCE(Sampler, noise_texture.sampler)
+  wgpu_destroy_buffer(&noise_compute.voxels);
+  if (noise_texture.data != NULL) {
+    free(noise_texture.data);
+    noise_texture.data = NULL;
+  }
 }
 
 static void generate_quad(wgpu_context_t* wgpu_context)
@@ -517,6 +725,140 @@ static void setup_bind_group(wgpu_context_t* wgpu_context)
   ASSERT(bind_group != NULL);
 }
 
+static void prepare_noise_compute(wgpu_context_t* wgpu_context)
+{
+  noise_compute.uniform_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "texture_3d_noise_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(noise_params),
+                  });
+
+  WGPUBindGroupLayoutEntry bgl_entries[2] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Noise parameters and permutations
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(noise_params),
+      },
+      .sampler = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Packed voxels
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = 0,
+      },
+      .sampler = {0},
+    },
+  };
+  noise_compute.bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label = "texture_3d_noise_bind_group_layout",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(noise_compute.bind_group_layout != NULL);
+
+  noise_compute.pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &noise_compute.bind_group_layout,
+                          });
+  ASSERT(noise_compute.pipeline_layout != NULL);
+
+  wgpu_shader_t noise_comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "texture_3d_noise_compute_shader",
+                    .wgsl_code.source = noise_compute_shader_wgsl,
+                    .entry            = "main",
+                  });
+  noise_compute.pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "texture_3d_noise_compute_pipeline",
+      .layout  = noise_compute.pipeline_layout,
+      .compute = noise_comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(noise_compute.pipeline != NULL);
+  wgpu_shader_release(&noise_comp_shader);
+}
+
+static void setup_noise_compute_bind_group(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      // Binding 0: Noise parameters and permutations
+      .binding = 0,
+      .buffer  = noise_compute.uniform_buffer.buffer,
+      .offset  = 0,
+      .size    = noise_compute.uniform_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      // Binding 1: Packed voxels
+      .binding = 1,
+      .buffer  = noise_compute.voxels.buffer,
+      .offset  = 0,
+      .size    = noise_compute.voxels.size,
+    },
+  };
+  noise_compute.bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label  = "texture_3d_noise_bind_group",
+                            .layout = noise_compute.bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(noise_compute.bind_group != NULL);
+}
+
+// Records the compute noise generation and the copy into the 3D texture
+static void record_noise_generation(wgpu_context_t* wgpu_context)
+{
+  const uint32_t scope = wgpu_gpu_profiler_begin_scope(
+    wgpu_context->gpu_profiler, wgpu_context->cmd_enc, noise_scope_name);
+
+  wgpu_context->cpass_enc
+    = wgpuCommandEncoderBeginComputePass(wgpu_context->cmd_enc, NULL);
+  wgpuComputePassEncoderSetPipeline(wgpu_context->cpass_enc,
+                                    noise_compute.pipeline);
+  wgpuComputePassEncoderSetBindGroup(wgpu_context->cpass_enc, 0,
+                                     noise_compute.bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    wgpu_context->cpass_enc, (noise_texture.width / 4 + 7) / 8,
+    (noise_texture.height + 7) / 8, (noise_texture.depth + 3) / 4);
+  wgpuComputePassEncoderEnd(wgpu_context->cpass_enc);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, wgpu_context->cpass_enc)
+
+  wgpuCommandEncoderCopyBufferToTexture(
+    wgpu_context->cmd_enc,
+    &(WGPUImageCopyBuffer){
+      .buffer = noise_compute.voxels.buffer,
+      .layout = (WGPUTextureDataLayout){
+        .offset       = 0,
+        .bytesPerRow  = noise_compute.bytes_per_row,
+        .rowsPerImage = noise_texture.height,
+      },
+    },
+    &(WGPUImageCopyTexture){
+      .texture = noise_texture.texture,
+    },
+    &(WGPUExtent3D){
+      .width              = noise_texture.width,
+      .height             = noise_texture.height,
+      .depthOrArrayLayers = noise_texture.depth,
+    });
+
+  wgpu_gpu_profiler_end_scope(wgpu_context->gpu_profiler,
+                              wgpu_context->cmd_enc, scope);
+}
+
 static void setup_render_pass(wgpu_context_t* wgpu_context)
 {
   // Color attachment
@@ -634,12 +976,13 @@ static int example_initialize(wgpu_example_context_t* context)
     setup_camera(context);
     generate_quad(context->wgpu_context);
     prepare_uniform_buffers(context);
-    prepare_noise_texture(context->wgpu_context, (uint32_t)NOISE_TEXTURE_WIDTH,
-                          (uint32_t)NOISE_TEXTURE_HEIGHT,
-                          (uint32_t)NOISE_TEXTURE_DEPTH);
+    const uint32_t dim = noise_texture_dims[generation.dim_index];
+    prepare_noise_texture(context->wgpu_context, dim, dim, dim);
+    prepare_noise_compute(context->wgpu_context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
     setup_bind_group(context->wgpu_context);
+    setup_noise_compute_bind_group(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
     return 0;
@@ -651,8 +994,40 @@ static int example_initialize(wgpu_example_context_t* context)
 static void example_on_update_ui_overlay(wgpu_example_context_t* context)
 {
   if (imgui_overlay_header("Settings")) {
+    imgui_overlay_combo_box(context->imgui_overlay, "Generator",
+                            &generation.generator, noise_generator_names,
+                            (uint32_t)ARRAY_SIZE(noise_generator_names));
+    if (imgui_overlay_combo_box(
+          context->imgui_overlay, "Size", &generation.dim_index,
+          noise_texture_dim_names,
+          (uint32_t)ARRAY_SIZE(noise_texture_dim_names))) {
+      generation.resize = generation.regenerate = true;
+    }
     if (imgui_overlay_button(context->imgui_overlay, "Generate new texture")) {
-      update_noise_texture(context->wgpu_context);
+      generation.regenerate = true;
+    }
+  }
+  if (imgui_overlay_header("Timings")) {
+    // The GPU time is read back a few frames after the generation
+    const wgpu_gpu_profiler_result_t* gpu_timings = NULL;
+    const uint32_t gpu_timing_count = wgpu_gpu_profiler_get_results(
+      context->wgpu_context->gpu_profiler, &gpu_timings);
+    for (uint32_t i = 0; i < gpu_timing_count; ++i) {
+      if (strcmp(gpu_timings[i].name, noise_scope_name) == 0) {
+        generation.gpu_time_ms = gpu_timings[i].gpu_time_ms;
+      }
+    }
+    if (generation.cpu_time_ms >= 0.0f) {
+      imgui_overlay_text("CPU: %.1f ms", generation.cpu_time_ms);
+    }
+    else {
+      imgui_overlay_text("CPU: -");
+    }
+    if (generation.gpu_time_ms >= 0.0f) {
+      imgui_overlay_text("GPU: %.2f ms", generation.gpu_time_ms);
+    }
+    else {
+      imgui_overlay_text("GPU: -");
     }
   }
 }
@@ -667,6 +1042,12 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpu_context->cmd_enc
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
 
+  // Generate the noise requested for this frame
+  if (generation.gpu_pending) {
+    record_noise_generation(wgpu_context);
+    generation.gpu_pending = false;
+  }
+
   // Create render pass encoder for encoding drawing commands
   wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
     wgpu_context->cmd_enc, &render_pass_desc);
@@ -736,11 +1117,31 @@ static int example_draw(wgpu_example_context_t* context)
   return 0;
 }
 
+// Applies the size and generation requests of the overlay
+static void update_noise(wgpu_context_t* wgpu_context)
+{
+  if (generation.resize) {
+    release_noise_texture();
+    WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+    WGPU_RELEASE_RESOURCE(BindGroup, noise_compute.bind_group)
+    const uint32_t dim = noise_texture_dims[generation.dim_index];
+    prepare_noise_texture(wgpu_context, dim, dim, dim);
+    setup_bind_group(wgpu_context);
+    setup_noise_compute_bind_group(wgpu_context);
+    generation.resize = false;
+  }
+  if (generation.regenerate) {
+    regenerate_noise(wgpu_context);
+    generation.regenerate = false;
+  }
+}
+
 static int example_render(wgpu_example_context_t* context)
 {
   if (!prepared) {
     return 1;
   }
+  update_noise(context->wgpu_context);
   const int draw_result = example_draw(context);
   if (!context->paused || context->camera->updated) {
     update_uniform_buffers(context, context->camera->updated);
@@ -751,9 +1152,12 @@ static int example_render(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
-  WGPU_RELEASE_RESOURCE(Texture, noise_texture.texture)
-  WGPU_RELEASE_RESOURCE(TextureView, noise_texture.view)
-  WGPU_RELEASE_RESOURCE(Sampler, noise_texture.sampler)
+  release_noise_texture();
+  wgpu_destroy_buffer(&noise_compute.uniform_buffer);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, noise_compute.bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, noise_compute.bind_group)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, noise_compute.pipeline_layout)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, noise_compute.pipeline)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
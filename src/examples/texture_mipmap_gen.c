@@ -108,22 +108,6 @@ static void load_texture(wgpu_context_t* wgpu_context, const char* filename,
   // Calculated as log2(max(width, height, depth))c + 1 (see specs)
   texture.mip_levels = floor(log2(MAX(texture.width, texture.height))) + 1;
 
-  // Create a host-visible staging buffer that contains the raw image data
-  WGPUBufferDescriptor staging_buffer_desc = {
-    .usage            = WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite,
-    .size             = ktx_texture_size,
-    .mappedAtCreation = true,
-  };
-  WGPUBuffer staging_buffer
-    = wgpuDeviceCreateBuffer(wgpu_context->device, &staging_buffer_desc);
-  ASSERT(staging_buffer);
-
-  // Copy texture data into staging buffer
-  void* mapping = wgpuBufferGetMappedRange(staging_buffer, 0, ktx_texture_size);
-  ASSERT(mapping)
-  memcpy(mapping, ktx_texture_data, ktx_texture_size);
-  wgpuBufferUnmap(staging_buffer);
-
   // Create texture
   WGPUTextureDescriptor texture_desc = {
     .size          = (WGPUExtent3D) {
@@ -142,54 +126,26 @@ static void load_texture(wgpu_context_t* wgpu_context, const char* filename,
     = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
   ASSERT(texture.texture != NULL);
 
-  // Copy the first mip of the chain, remaining mips will be generated
-  // Upload staging buffer to texture
-  WGPUCommandEncoder cmd_encoder
-    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
-
-  wgpuCommandEncoderCopyBufferToTexture(cmd_encoder,
-    // Source
-    &(WGPUImageCopyBuffer) {
-      .buffer = staging_buffer,
-      .layout = (WGPUTextureDataLayout) {
-        .offset       = 0,
-        .bytesPerRow  = texture.width * 4,
-        .rowsPerImage = texture.height,
-      },
-    },
-    // Destination
-    &(WGPUImageCopyTexture){
-      .texture = texture.texture,
+  // Copy the first mip of the chain, remaining mips will be generated. The
+  // queue write reads the KTX data directly, without a staging buffer copy.
+  wgpuQueueWriteTexture(wgpu_context->queue,
+    &(WGPUImageCopyTexture) {
+      .texture  = texture.texture,
       .mipLevel = 0,
-      .origin = (WGPUOrigin3D) {
-        .x = 0,
-        .y = 0,
-        .z = 0,
-      },
-      .aspect = WGPUTextureAspect_All,
+      .aspect   = WGPUTextureAspect_All,
+    },
+    ktx_texture_data, ktx_texture_size,
+    &(WGPUTextureDataLayout){
+      .offset       = 0,
+      .bytesPerRow  = texture.width * 4,
+      .rowsPerImage = texture.height,
     },
-    // Copy size
     &(WGPUExtent3D){
       .width               = texture.width,
       .height              = texture.height,
       .depthOrArrayLayers  = 1,
     });
 
-  WGPUCommandBuffer command_buffer
-    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
-  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
-
-  // Sumbit commmand buffer and cleanup
-  ASSERT(command_buffer != NULL)
-
-  // Submit to the queue
-  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
-
-  // Release command buffer
-  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
-
-  // Clean up staging resources
-  WGPU_RELEASE_RESOURCE(Buffer, staging_buffer)
   ktxTexture_Destroy(ktx_texture);
 
   // Generate the mip chain
@@ -253,7 +209,8 @@ static void load_assets(wgpu_context_t* wgpu_context)
     .wgpu_context       = wgpu_context,
     .filename           = "models/tunnel_cylinder.gltf",
     .file_loading_flags = WGPU_GLTF_FileLoadingFlags_PreTransformVertices
-                          | WGPU_GLTF_FileLoadingFlags_DontLoadImages,
+                          | WGPU_GLTF_FileLoadingFlags_DontLoadImages
+                          | WGPU_GLTF_FileLoadingFlags_UseCache,
   });
   load_texture(wgpu_context, "textures/metalplate_nomips_rgba.ktx",
                WGPUTextureFormat_RGBA8Unorm);
@@ -144,10 +144,31 @@ static void setup_pipeline_layout(wgpu_context_t* wgpu_context)
   ASSERT(pipeline_layout != NULL);
 }
 
+static void setup_bind_groups(wgpu_context_t* wgpu_context);
+
+static void texture_loaded(texture_t* loaded_texture, void* user_data)
+{
+  // Keep the placeholder texture if the image could not be loaded
+  if (loaded_texture->view == NULL) {
+    return;
+  }
+
+  // Swap the placeholder texture for the loaded one
+  wgpu_destroy_texture(&texture);
+  texture = *loaded_texture;
+
+  // Recreate the bind group referencing the texture
+  WGPU_RELEASE_RESOURCE(BindGroup, cube.uniform_buffer_bind_group)
+  setup_bind_groups((wgpu_context_t*)user_data);
+}
+
 static void prepare_texture(wgpu_context_t* wgpu_context)
 {
+  // Render with a placeholder texture while the image loads in the background
+  texture          = wgpu_create_empty_texture(wgpu_context);
   const char* file = "textures/Di-3d.png";
-  texture          = wgpu_create_texture_from_file(wgpu_context, file, NULL);
+  wgpu_create_texture_from_file_async(wgpu_context, file, NULL, texture_loaded,
+                                      wgpu_context);
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -1,16 +1,22 @@
 #include "example_base.h"
 #include "examples.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "../webgpu/imgui_overlay.h"
 #include "../webgpu/texture.h"
+#include "../webgpu/tile_cache.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Textured Quad
  *
  * This example shows how to load and sample textures (including mip maps).
  *
+ * With --tile-pyramid=<file> it becomes a viewer for images of any size: the
+ * quad samples a tiled pyramid (see tile_cache.h) through a virtual texture
+ * tile cache, which streams the visible tiles into a fixed-size atlas.
+ *
  * Ref:
  * https://github.com/SaschaWillems/Vulkan/blob/master/examples/texture/texture.cpp
  * -------------------------------------------------------------------------- */
@@ -55,7 +61,17 @@ static WGPUBindGroup bind_group;
 static WGPUBindGroupLayout bind_group_layout;
 
 // Contains all WebGPU objects that are required to store and use a texture
-static texture_t texture;
+static const texture_t* texture = NULL;
+
+// The texture is created with its mip tail, the finer levels are streamed in
+static wgpu_texture_streamer_t* texture_streamer   = NULL;
+static wgpu_streaming_texture_t* streaming_texture = NULL;
+
+// Gigapixel viewer mode, the tiles of the image are streamed on demand
+static const char* tile_pyramid_filename = NULL;
+static wgpu_tile_cache_t* tile_cache     = NULL;
+static WGPUPipelineLayout tile_cache_pipeline_layout;
+static WGPURenderPipeline tile_cache_pipeline;
 
 // Other variables
 static const char* example_title = "Textured Quad";
@@ -77,14 +93,23 @@ static void load_texture(wgpu_context_t* wgpu_context)
 {
   // We use the Khronos texture format
   // (https://www.khronos.org/opengles/sdk/tools/KTX/file_format_spec/)
-  texture = wgpu_create_texture_from_file(
-    wgpu_context, "textures/metalplate01_rgba.ktx", NULL);
+  texture_streamer  = wgpu_texture_streamer_create(wgpu_context, NULL);
+  streaming_texture = wgpu_texture_streamer_load(
+    texture_streamer, "textures/metalplate01_rgba.ktx", NULL);
+  texture = wgpu_streaming_texture_get_texture(streaming_texture);
+
+  if (tile_pyramid_filename != NULL) {
+    tile_cache = wgpu_tile_cache_create(wgpu_context,
+                                        &(wgpu_tile_cache_desc_t){
+                                          .filename = tile_pyramid_filename,
+                                        });
+  }
 }
 
 static void generate_quad(wgpu_context_t* wgpu_context)
 {
   // Setup vertices for a single uv-mapped quad made from two triangles
-  static const vertex_t vertices_data[4] = {
+  vertex_t vertices_data[4] = {
     [0] = {
       .pos    = {1.0f, 1.0f, 0.0f},
       .uv     = {1.0f, 1.0f},
@@ -106,6 +131,15 @@ static void generate_quad(wgpu_context_t* wgpu_context)
       .normal = {0.0f, 0.0f, 1.0f},
     },
   };
+  // The quad has the aspect ratio of the streamed image
+  if (tile_cache != NULL) {
+    wgpu_tile_cache_stats_t stats;
+    wgpu_tile_cache_get_stats(tile_cache, &stats);
+    const float aspect_ratio = (float)stats.width / (float)stats.height;
+    for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(vertices_data); ++i) {
+      vertices_data[i].pos[0] *= aspect_ratio;
+    }
+  }
   vertices = wgpu_create_buffer(
     wgpu_context, &(wgpu_buffer_desc_t){
                     .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
@@ -222,12 +256,12 @@ static void setup_bind_group(wgpu_context_t* wgpu_context)
     [1] = (WGPUBindGroupEntry) {
       // Binding 1 : Fragment shader texture view
       .binding     = 1,
-      .textureView = texture.view,
+      .textureView = texture->view,
     },
     [2] = (WGPUBindGroupEntry) {
       // Binding 2: Fragment shader image sampler
       .binding = 2,
-      .sampler = texture.sampler,
+      .sampler = texture->sampler,
     },
   };
 
@@ -352,6 +386,132 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
   WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
 }
 
+// clang-format off
+static const char* tile_cache_shader_wgsl = CODE(
+  struct UBO {
+    projection : mat4x4<f32>,
+    modelView : mat4x4<f32>,
+    viewPos : vec4<f32>,
+    lodBias : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> ubo : UBO;
+
+  @group(1) @binding(0) var<uniform> tileCacheParams : TileCacheParams;
+  @group(1) @binding(1) var tileCacheAtlas : texture_2d<f32>;
+  @group(1) @binding(2) var tileCacheIndirection : texture_2d<u32>;
+  @group(1) @binding(3) var tileCacheSampler : sampler;
+  @group(1) @binding(4) var<storage, read_write> tileCacheFeedback :
+    array<atomic<u32>>;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) uv : vec2<f32>,
+  };
+
+  @vertex
+  fn vs_main(@location(0) pos : vec3<f32>,
+             @location(1) uv : vec2<f32>) -> VertexOutput {
+    var output : VertexOutput;
+    output.position = ubo.projection * ubo.modelView * vec4<f32>(pos, 1.0);
+    // The image starts at its top left corner
+    output.uv = vec2<f32>(uv.x, 1.0 - uv.y);
+    return output;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    return tileCacheSample(input.uv, input.position.xy);
+  }
+);
+// clang-format on
+
+// Pipeline of the gigapixel viewer mode, the tile cache bind group is bound to
+// group 1
+static void prepare_tile_cache_pipeline(wgpu_context_t* wgpu_context)
+{
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    bind_group_layout,
+    wgpu_tile_cache_get_bind_group_layout(tile_cache),
+  };
+  tile_cache_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(tile_cache_pipeline_layout != NULL);
+
+  const char* tile_cache_wgsl = wgpu_tile_cache_get_wgsl_functions();
+  const size_t wgsl_size
+    = strlen(tile_cache_wgsl) + strlen(tile_cache_shader_wgsl) + 2;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", tile_cache_wgsl, tile_cache_shader_wgsl);
+
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = wgpu_context->swap_chain.format,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = WGPUTextureFormat_Depth24PlusStencil8,
+      .depth_write_enabled = true,
+    });
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    tile_cache_quad, sizeof(vertex_t),
+    // Attribute location 0: Position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, offsetof(vertex_t, pos)),
+    // Attribute location 1: Texture coordinates
+    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x2, offsetof(vertex_t, uv)))
+
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "tile_cache_vertex_shader",
+                  .wgsl_code.source = wgsl,
+                  .entry            = "vs_main",
+                },
+                .buffer_count = 1,
+                .buffers      = &tile_cache_quad_vertex_buffer_layout,
+              });
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+                wgpu_context, &(wgpu_fragment_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Fragment shader WGSL
+                  .label            = "tile_cache_fragment_shader",
+                  .wgsl_code.source = wgsl,
+                  .entry            = "fs_main",
+                },
+                .target_count = 1,
+                .targets      = &color_target_state,
+              });
+  free(wgsl);
+
+  tile_cache_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device,
+    &(WGPURenderPipelineDescriptor){
+      .label     = "tile_cache_render_pipeline",
+      .layout    = tile_cache_pipeline_layout,
+      .primitive = (WGPUPrimitiveState){
+        .topology  = WGPUPrimitiveTopology_TriangleList,
+        .frontFace = WGPUFrontFace_CCW,
+        .cullMode  = WGPUCullMode_None,
+      },
+      .vertex       = vertex_state,
+      .fragment     = &fragment_state,
+      .depthStencil = &depth_stencil_state,
+      .multisample  = wgpu_create_multisample_state_descriptor(
+        &(create_multisample_state_desc_t){
+          .sample_count = 1,
+        }),
+    });
+  ASSERT(tile_cache_pipeline != NULL);
+
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
 static int example_initialize(wgpu_example_context_t* context)
 {
   if (context) {
@@ -361,6 +521,9 @@ static int example_initialize(wgpu_example_context_t* context)
     prepare_uniform_buffers(context);
     setup_pipeline_layout(context->wgpu_context);
     prepare_pipelines(context->wgpu_context);
+    if (tile_cache != NULL) {
+      prepare_tile_cache_pipeline(context->wgpu_context);
+    }
     setup_bind_group(context->wgpu_context);
     setup_render_pass(context->wgpu_context);
     prepared = true;
@@ -375,9 +538,26 @@ static void example_on_update_ui_overlay(wgpu_example_context_t* context)
   if (imgui_overlay_header("Settings")) {
     if (imgui_overlay_slider_float(context->imgui_overlay, "LOD bias",
                                    &ubo_vs.lodBias, 0.0f,
-                                   (float)texture.mip_level_count)) {
+                                   (float)texture->mip_level_count)) {
       update_uniform_buffers(context);
     }
+    imgui_overlay_text(
+      "Resident mip level: %u",
+      wgpu_streaming_texture_get_resident_level(streaming_texture));
+  }
+  if (tile_cache != NULL && imgui_overlay_header("Tile cache")) {
+    wgpu_tile_cache_stats_t stats;
+    wgpu_tile_cache_get_stats(tile_cache, &stats);
+    imgui_overlay_text("Image: %ux%u, %u levels", stats.width, stats.height,
+                       stats.level_count);
+    imgui_overlay_text("Resident tiles: %u / %u", stats.resident_count,
+                       stats.slot_count);
+    imgui_overlay_text("Pending tiles: %u", stats.pending_count);
+    imgui_overlay_text("Loaded / evicted: %llu / %llu",
+                       (unsigned long long)stats.loaded_count,
+                       (unsigned long long)stats.evicted_count);
+    imgui_overlay_text("Atlas: %.1f MiB",
+                       (double)stats.atlas_bytes / (1024.0 * 1024.0));
   }
 }
 
@@ -396,11 +576,17 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
     wgpu_context->cmd_enc, &render_pass.descriptor);
 
   // Bind the rendering pipeline
-  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc, pipeline);
+  wgpuRenderPassEncoderSetPipeline(wgpu_context->rpass_enc,
+                                   tile_cache ? tile_cache_pipeline : pipeline);
 
   // Set the bind group
   wgpuRenderPassEncoderSetBindGroup(wgpu_context->rpass_enc, 0, bind_group, 0,
                                     0);
+  if (tile_cache != NULL) {
+    wgpuRenderPassEncoderSetBindGroup(
+      wgpu_context->rpass_enc, 1, wgpu_tile_cache_get_bind_group(tile_cache), 0,
+      0);
+  }
 
   // Set viewport
   wgpuRenderPassEncoderSetViewport(
@@ -429,6 +615,11 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
   wgpuRenderPassEncoderEnd(wgpu_context->rpass_enc);
   WGPU_RELEASE_RESOURCE(RenderPassEncoder, wgpu_context->rpass_enc)
 
+  // Read back the tiles sampled by the pass
+  if (tile_cache != NULL) {
+    wgpu_tile_cache_record_feedback(tile_cache, wgpu_context->cmd_enc);
+  }
+
   // Draw ui overlay
   draw_ui(wgpu_context->context, example_on_update_ui_overlay);
 
@@ -442,6 +633,15 @@ static WGPUCommandBuffer build_command_buffer(wgpu_context_t* wgpu_context)
 
 static int example_draw(wgpu_example_context_t* context)
 {
+  // The sampler is replaced whenever a streamed mip level lands
+  if (wgpu_texture_streamer_update(texture_streamer)) {
+    WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+    setup_bind_group(context->wgpu_context);
+  }
+  if (tile_cache != NULL) {
+    wgpu_tile_cache_update(tile_cache);
+  }
+
   // Prepare frame
   prepare_frame(context);
 
@@ -476,7 +676,10 @@ static void example_on_view_changed(wgpu_example_context_t* context)
 static void example_destroy(wgpu_example_context_t* context)
 {
   camera_release(context->camera);
-  wgpu_destroy_texture(&texture);
+  wgpu_texture_streamer_release(texture_streamer);
+  wgpu_tile_cache_release(tile_cache);
+  WGPU_RELEASE_RESOURCE(RenderPipeline, tile_cache_pipeline)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, tile_cache_pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
   WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout)
   WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
@@ -488,6 +691,14 @@ static void example_destroy(wgpu_example_context_t* context)
 
 void example_textured_quad(int argc, char* argv[])
 {
+  static const char* tile_pyramid_option = "--tile-pyramid=";
+  for (int32_t i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], tile_pyramid_option, strlen(tile_pyramid_option))
+        == 0) {
+      tile_pyramid_filename = argv[i] + strlen(tile_pyramid_option);
+    }
+  }
+
   // clang-format off
   example_run(argc, argv, &(refexport_t){
     .example_settings = (wgpu_example_settings_t){
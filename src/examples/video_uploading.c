@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "../core/video_decode.h"
+#include "../webgpu/video_upload.h"
 
 /* -------------------------------------------------------------------------- *
  * WebGPU Example - Video Texture
@@ -37,13 +38,22 @@ static const char* vertex_shader_wgsl = CODE(
   }
 );
 
+// Converts the NV12 planes from limited range BT.709 YUV to RGB
 static const char* fragment_shader_wgsl = CODE(
   @group(0) @binding(0) var mySampler: sampler;
-  @group(0) @binding(1) var myTexture: texture_2d<f32>;
+  @group(0) @binding(1) var yTexture: texture_2d<f32>;
+  @group(0) @binding(2) var uvTexture: texture_2d<f32>;
 
   @fragment
   fn main(@location(0) fragUV : vec2<f32>) -> @location(0) vec4<f32> {
-    return textureSample(myTexture, mySampler, fragUV);
+    let y = (textureSample(yTexture, mySampler, fragUV).r - 16.0 / 255.0)
+            * (255.0 / 219.0);
+    let uv = (textureSample(uvTexture, mySampler, fragUV).rg - 128.0 / 255.0)
+             * (255.0 / 224.0);
+    let rgb = vec3<f32>(y + 1.5748 * uv.y,
+                        y - 0.1873 * uv.x - 0.4681 * uv.y,
+                        y + 1.8556 * uv.x);
+    return vec4<f32>(clamp(rgb, vec3<f32>(0.0), vec3<f32>(1.0)), 1.0);
   }
 );
 // clang-format on
@@ -63,11 +73,15 @@ static struct {
   WGPURenderPassDescriptor descriptor;
 } render_pass = {0};
 
-// Texture and sampler
+// Textures of the Y and UV planes and sampler
 static struct {
   WGPUSampler sampler;
   WGPUTexture texture;
   WGPUTextureView view;
+  WGPUTexture uv_texture;
+  WGPUTextureView uv_view;
+  // Staging buffers the decoder writes the frames into
+  wgpu_video_upload_t* upload;
 } video_texture = {0};
 
 static struct {
@@ -75,6 +89,8 @@ static struct {
     int32_t width;
     int32_t height;
   } frame_size;
+  // Decoder of the video stream
+  video_decoder_t* decoder;
 } video_info = {0};
 
 static const char* video_file_location
@@ -107,35 +123,55 @@ static void prepare_vertex_buffer(wgpu_context_t* wgpu_context)
                   });
 }
 
-static void prepare_video_texture(wgpu_context_t* wgpu_context)
+static WGPUTexture create_plane_texture(wgpu_context_t* wgpu_context,
+                                        uint32_t width, uint32_t height,
+                                        WGPUTextureFormat format,
+                                        WGPUTextureView* view)
 {
   // Create the texture
-  video_texture.texture = wgpuDeviceCreateTexture(
+  WGPUTexture texture = wgpuDeviceCreateTexture(
     wgpu_context->device,
     &(WGPUTextureDescriptor){
       .size          = (WGPUExtent3D){
-        .width               = video_info.frame_size.width,
-        .height              = video_info.frame_size.height,
+        .width               = width,
+        .height              = height,
         .depthOrArrayLayers  = 1,
       },
       .mipLevelCount = 1,
       .sampleCount   = 1,
       .dimension     = WGPUTextureDimension_2D,
-      .format        = WGPUTextureFormat_RGBA8Unorm,
+      .format        = format,
       .usage         = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
   });
+  ASSERT(texture != NULL);
 
   // Create the texture view
-  video_texture.view = wgpuTextureCreateView(
-    video_texture.texture, &(WGPUTextureViewDescriptor){
-                             .format          = WGPUTextureFormat_RGBA8Unorm,
-                             .dimension       = WGPUTextureViewDimension_2D,
-                             .baseMipLevel    = 0,
-                             .mipLevelCount   = 1,
-                             .baseArrayLayer  = 0,
-                             .arrayLayerCount = 1,
-                           });
-  ASSERT(video_texture.view != NULL);
+  *view = wgpuTextureCreateView(
+    texture, &(WGPUTextureViewDescriptor){
+               .format          = format,
+               .dimension       = WGPUTextureViewDimension_2D,
+               .baseMipLevel    = 0,
+               .mipLevelCount   = 1,
+               .baseArrayLayer  = 0,
+               .arrayLayerCount = 1,
+             });
+  ASSERT(*view != NULL);
+
+  return texture;
+}
+
+static void prepare_video_texture(wgpu_context_t* wgpu_context)
+{
+  // The frames are uploaded as NV12, the planes are converted to RGB in the
+  // fragment shader so that the decode thread does no color conversion
+  const uint32_t width  = (uint32_t)video_info.frame_size.width;
+  const uint32_t height = (uint32_t)video_info.frame_size.height;
+  video_texture.texture
+    = create_plane_texture(wgpu_context, width, height,
+                           WGPUTextureFormat_R8Unorm, &video_texture.view);
+  video_texture.uv_texture = create_plane_texture(
+    wgpu_context, (width + 1) / 2, (height + 1) / 2, WGPUTextureFormat_RG8Unorm,
+    &video_texture.uv_view);
 
   // Create the sampler
   video_texture.sampler = wgpuDeviceCreateSampler(
@@ -149,6 +185,18 @@ static void prepare_video_texture(wgpu_context_t* wgpu_context)
                             .maxAnisotropy = 1,
                           });
   ASSERT(video_texture.sampler != NULL);
+
+  // Let the decoder write the planes straight into the staging buffers
+  video_texture.upload = wgpu_video_upload_create(
+    wgpu_context, &(wgpu_video_upload_desc_t){
+                    .width        = width,
+                    .height       = height,
+                    .format       = VideoFrameFormat_NV12,
+                    .buffer_count = 3,
+                  });
+  video_frame_sink_t sink
+    = wgpu_video_upload_get_frame_sink(video_texture.upload);
+  video_decoder_set_frame_sink(video_info.decoder, &sink);
 }
 
 static void setup_render_pass(wgpu_context_t* wgpu_context)
@@ -178,7 +226,7 @@ static void setup_render_pass(wgpu_context_t* wgpu_context)
 static void prepare_uniform_bind_group(wgpu_context_t* wgpu_context)
 {
   // Uniform bind group
-  WGPUBindGroupEntry bg_entries[2] = {
+  WGPUBindGroupEntry bg_entries[3] = {
     [0] = (WGPUBindGroupEntry) {
       .binding = 0,
       .sampler = video_texture.sampler,
@@ -187,6 +235,10 @@ static void prepare_uniform_bind_group(wgpu_context_t* wgpu_context)
       .binding     = 1,
       .textureView = video_texture.view,
     },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = video_texture.uv_view,
+    },
   };
   uniform_bind_group = wgpuDeviceCreateBindGroup(
     wgpu_context->device,
@@ -272,35 +324,26 @@ static void prepare_pipelines(wgpu_context_t* wgpu_context)
 
 static int prepare_video(const char* fname)
 {
-  init_video_decode();
-  open_video_file(fname);
+  video_info.decoder = video_decoder_create(&(video_decoder_desc_t){
+    .filename = fname,
+  });
+  ASSERT(video_info.decoder != NULL);
 
-  get_video_dimension(&video_info.frame_size.width,
-                      &video_info.frame_size.height);
+  video_decoder_get_dimension(video_info.decoder, &video_info.frame_size.width,
+                              &video_info.frame_size.height);
 
-  start_video_decode();
+  video_decoder_start(video_info.decoder);
 
   return 0;
 }
 
 static int update_capture_texture(wgpu_context_t* wgpu_context)
 {
-  int video_w = 0, video_h = 0;
-  void* video_buf = NULL;
-
-  get_video_dimension(&video_w, &video_h);
-  get_video_buffer(&video_buf);
-
-  if (video_buf) {
-    wgpu_image_to_texure(wgpu_context, video_texture.texture,
-                         (uint8_t*)video_buf,
-                         (WGPUExtent3D){
-                           .width              = video_info.frame_size.width,
-                           .height             = video_info.frame_size.height,
-                           .depthOrArrayLayers = 1,
-                         },
-                         4u);
-  }
+  UNUSED_VAR(wgpu_context);
+
+  // Copy the latest decoded frame from its staging buffer into the textures
+  wgpu_video_upload_update(video_texture.upload, video_texture.texture,
+                           video_texture.uv_texture);
 
   return 0;
 }
@@ -390,9 +433,13 @@ static void example_destroy(wgpu_example_context_t* context)
   WGPU_RELEASE_RESOURCE(Buffer, vertices.buffer)
   WGPU_RELEASE_RESOURCE(RenderPipeline, pipeline)
   WGPU_RELEASE_RESOURCE(BindGroup, uniform_bind_group)
+  video_decoder_release(video_info.decoder);
+  wgpu_video_upload_release(video_texture.upload);
   WGPU_RELEASE_RESOURCE(Sampler, video_texture.sampler)
   WGPU_RELEASE_RESOURCE(Texture, video_texture.texture)
   WGPU_RELEASE_RESOURCE(TextureView, video_texture.view)
+  WGPU_RELEASE_RESOURCE(Texture, video_texture.uv_texture)
+  WGPU_RELEASE_RESOURCE(TextureView, video_texture.uv_view)
 }
 
 void example_video_uploading(int argc, char* argv[])
@@ -6,6 +6,7 @@
 
 #include "core/api.h"
 #include "core/argparse.h"
+#include "examples/example_base.h"
 #include "examples/examples.h"
 
 int main(int argc, char* argv[])
@@ -14,7 +15,9 @@ int main(int argc, char* argv[])
   initialize_default_path();
 
   const char* example_name = NULL;
-  int demo_mode = 0, window_width = 0, window_height = 0;
+  int demo_mode = 0, demo_cycles = 1, window_width = 0, window_height = 0;
+  int benchmark = 0, warmup_frame_count = 0, frame_count = 0;
+  const char* benchmark_output = NULL;
   struct argparse_option options[] = {
     OPT_BOOLEAN('?', "help", NULL, "show this help message and exit",
                 argparse_help_cb, 0, OPT_NONEG),
@@ -25,6 +28,23 @@ int main(int argc, char* argv[])
     OPT_BOOLEAN('d', "demo-mode", &demo_mode,
                 "demo mode, this mode runs every example for 10 seconds", NULL,
                 0, 0),
+    OPT_INTEGER(0, "demo-cycles", &demo_cycles,
+                "number of demo mode cycles, the GPU memory is checked for "
+                "leaks from the second one on, 0 cycles until it leaks "
+                "(default: 1)",
+                NULL, 0, 0),
+    OPT_GROUP("Benchmark options"),
+    OPT_BOOLEAN('b', "benchmark", &benchmark,
+                "benchmark mode, runs the sample (or every example when no "
+                "sample is given) with v-sync off and reports frame statistics",
+                NULL, 0, 0),
+    OPT_INTEGER(0, "warmup-frames", &warmup_frame_count,
+                "number of warm-up frames (default: 60)", NULL, 0, 0),
+    OPT_INTEGER(0, "frames", &frame_count,
+                "number of measured frames (default: 600)", NULL, 0, 0),
+    OPT_STRING('o', "benchmark-output", &benchmark_output,
+               "benchmark output file, .json (one object per line) or .csv",
+               NULL, 0, 0),
     OPT_END(),
   };
 
@@ -59,12 +79,60 @@ int main(int argc, char* argv[])
       example->example_func(argc, argv);
     }
   }
-  if (demo_mode != 0) {
+  if (benchmark != 0 && example_name == NULL) {
     examplecase_t* examples = get_examples();
     uint32_t example_count  = get_number_of_examples();
-    printf("Running demo mode, found %d examples\n", example_count);
+    printf("Running benchmark mode, found %d examples\n", example_count);
     for (uint32_t i = 0; i < example_count; ++i) {
       printf("Running example: %s\n", examples[i].example_name);
+      examples[i].example_func(argc, argv);
+    }
+  }
+  if (demo_mode != 0) {
+    examplecase_t* examples = get_examples();
+    uint32_t example_count  = get_number_of_examples();
+    printf("Running demo mode, found %d examples\n", example_count);
+    // The examples exit after 10 seconds
+    char** demo_argv = (char**)malloc(sizeof(char*) * (argc + 2));
+    memcpy(demo_argv, argv, sizeof(char*) * argc);
+    demo_argv[argc]     = "--run-time=10";
+    demo_argv[argc + 1] = NULL;
+    // All examples run on the window and device of one host, switching
+    // between them only initializes the examples
+    example_host_t* host = example_host_create(argc + 1, demo_argv);
+    example_host_set_active(host);
+    // The GPU memory still tracked after an example exited is leaked, it
+    // would grow with every cycle. The first cycle also creates the shared
+    // objects of the host on first use, the memory is checked after it
+    bool memory_grew = false;
+    for (int32_t cycle = 0; demo_cycles <= 0 || cycle < demo_cycles; ++cycle) {
+      for (uint32_t i = 0; i < example_count && !example_host_is_closed(host);
+           ++i) {
+        wgpu_memory_stats_t before = {0}, after = {0};
+        wgpu_memory_tracker_get_stats(&before);
+        printf("Running example: %s\n", examples[i].example_name);
+        examples[i].example_func(argc + 1, demo_argv);
+        wgpu_memory_tracker_get_stats(&after);
+        if (cycle > 0 && after.total_bytes > before.total_bytes) {
+          fprintf(stderr, "%s leaked %.2f MiB of GPU memory\n",
+                  examples[i].example_name,
+                  (double)(after.total_bytes - before.total_bytes)
+                    / (1024.0 * 1024.0));
+          memory_grew = true;
+        }
+      }
+      if (memory_grew) {
+        fprintf(stderr, "GPU memory grew in demo cycle %d\n", cycle + 1);
+        break;
+      }
+      if (example_host_is_closed(host)) {
+        break;
+      }
+    }
+    example_host_release(host);
+    free(demo_argv);
+    if (memory_grew) {
+      return EXIT_FAILURE;
     }
   }
   if (argparse_argc != 0) {
@@ -2,6 +2,7 @@
 
 #include "../core/macro.h"
 
+#include <errno.h>
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
@@ -30,13 +31,6 @@ void initialize_default_path(void)
 
 /* misc platform functions */
 
-static double get_native_time(void)
-{
-  struct timespec ts;
-  clock_gettime(CLOCK_MONOTONIC, &ts);
-  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
-}
-
 void get_local_time(date_t* current_date)
 {
   struct timeval te;
@@ -59,9 +53,31 @@ void get_local_time(date_t* current_date)
 
 float platform_get_time(void)
 {
-  static double initial = -1.0;
-  if (initial < 0.0) {
-    initial = get_native_time();
+  static uint64_t initial = 0;
+  if (initial == 0) {
+    initial = platform_get_time_ns();
+  }
+  return (float)((double)(platform_get_time_ns() - initial) / 1e9);
+}
+
+uint64_t platform_get_time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void platform_sleep(float seconds)
+{
+  if (seconds <= 0.0f) {
+    return;
+  }
+  struct timespec ts = {
+    .tv_sec  = (time_t)seconds,
+    .tv_nsec = (long)((seconds - (float)(time_t)seconds) * 1e9f),
+  };
+  /* Sleep for the remaining time when interrupted by a signal, other errors
+   * (e.g. an out of range time) would fail again */
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
   }
-  return (float)(get_native_time() - initial);
 }
@@ -0,0 +1,122 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../core/job_system.h"
+#include "tests.h"
+
+/* Time a test waits for its jobs, the jobs of a stuck job system never
+ * finish */
+#define TEST_TIMEOUT_SECONDS 5.0
+
+static double get_time_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Waits for the counter without running jobs on the calling thread, unlike
+ * job_system_wait, so that only the workers make progress */
+static bool wait_for_counter(job_counter_t* counter)
+{
+  const double start_time = get_time_seconds();
+  while (!job_counter_is_done(counter)) {
+    if (get_time_seconds() - start_time > TEST_TIMEOUT_SECONDS) {
+      return false;
+    }
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 1000000};
+    nanosleep(&delay, NULL);
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- *
+ * Dependency queued before its dependent on a single worker
+ * -------------------------------------------------------------------------- */
+
+static struct {
+  job_system_t* job_system;
+  job_counter_t dependency_counter;
+  job_counter_t done_counter;
+  volatile bool dependency_done;
+  volatile bool dependent_ran_after_dependency;
+} dependency_test = {0};
+
+static void dependency_job(void* user_data)
+{
+  (void)user_data;
+  dependency_test.dependency_done = true;
+}
+
+static void dependent_job(void* user_data)
+{
+  (void)user_data;
+  dependency_test.dependent_ran_after_dependency
+    = dependency_test.dependency_done;
+}
+
+/* Runs on the worker, both jobs go to its own queue: the dependent is on top
+ * of the dependency and popped first */
+static void spawn_job(void* user_data)
+{
+  (void)user_data;
+  job_system_submit(dependency_test.job_system,
+                    &(job_desc_t){
+                      .func = dependency_job,
+                    },
+                    &dependency_test.dependency_counter);
+  job_system_submit(dependency_test.job_system,
+                    &(job_desc_t){
+                      .func       = dependent_job,
+                      .dependency = &dependency_test.dependency_counter,
+                    },
+                    &dependency_test.done_counter);
+}
+
+static bool test_dependency_queued_before_dependent(void)
+{
+  dependency_test.job_system = job_system_create(1);
+
+  job_counter_t spawn_counter = {0};
+  job_system_submit(dependency_test.job_system,
+                    &(job_desc_t){
+                      .func = spawn_job,
+                    },
+                    &spawn_counter);
+  if (!wait_for_counter(&spawn_counter)
+      || !wait_for_counter(&dependency_test.done_counter)) {
+    /* The worker is stuck, it can not be joined */
+    return false;
+  }
+
+  job_system_release(dependency_test.job_system);
+  return dependency_test.dependent_ran_after_dependency;
+}
+
+/* -------------------------------------------------------------------------- *
+ * Test runner
+ * -------------------------------------------------------------------------- */
+
+static const test_case_t test_cases[] = {
+  {"dependency_queued_before_dependent",
+   test_dependency_queued_before_dependent},
+  {"mesh_decode_index_buffer_v0", test_mesh_decode_index_buffer_v0},
+  {"mesh_decode_index_buffer_v1", test_mesh_decode_index_buffer_v1},
+  {"mesh_decode_index_buffer_explicit_fifo",
+   test_mesh_decode_index_buffer_explicit_fifo},
+};
+
+int main(void)
+{
+  const size_t test_count = sizeof(test_cases) / sizeof(test_cases[0]);
+  size_t failed_count     = 0;
+  for (size_t i = 0; i < test_count; ++i) {
+    const bool passed = test_cases[i].func();
+    printf("[%s] %s\n", passed ? "PASS" : "FAIL", test_cases[i].name);
+    failed_count += passed ? 0 : 1;
+  }
+  printf("%zu of %zu tests passed\n", test_count - failed_count, test_count);
+  return failed_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
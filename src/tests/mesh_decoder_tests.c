@@ -0,0 +1,82 @@
+#include "tests.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../core/mesh_decoder.h"
+
+/* Frequent vertex codes of the encoder, the last 16 bytes of every stream */
+#define MESH_CODEAUX_TABLE                                                     \
+  0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98,      \
+    0x01, 0x69, 0x00, 0x00
+
+/* Decodes the stream to 16 and 32 bit indices and compares both */
+static bool decode_and_compare(const uint8_t* buffer, size_t buffer_size,
+                               const uint32_t* expected, uint32_t index_count)
+{
+  uint16_t indices16[32];
+  uint32_t indices32[32];
+  if (index_count > 32
+      || !mesh_decode_index_buffer(indices16, index_count, 2, buffer,
+                                   buffer_size)
+      || !mesh_decode_index_buffer(indices32, index_count, 4, buffer,
+                                   buffer_size)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < index_count; ++i) {
+    if (indices16[i] != expected[i] || indices32[i] != expected[i]) {
+      return false;
+    }
+  }
+  /* Truncated streams are rejected */
+  return !mesh_decode_index_buffer(indices32, index_count, 4, buffer,
+                                   buffer_size - 1);
+}
+
+/* -------------------------------------------------------------------------- *
+ * Streams of the meshoptimizer encoder, version 0 and version 1 with a restart
+ * and delta coded free indices
+ * -------------------------------------------------------------------------- */
+
+bool test_mesh_decode_index_buffer_v0(void)
+{
+  static const uint32_t indices[] = {0, 1, 2, 2, 1, 3, 4, 6, 5, 7, 8, 9};
+  static const uint8_t data[]     = {
+    0xe0, 0xf0, 0x10, 0xfe, 0xff, 0xf0, 0x0c, 0xff,
+    0x02, 0x02, 0x02, MESH_CODEAUX_TABLE,
+  };
+  return decode_and_compare(data, sizeof(data), indices,
+                            sizeof(indices) / sizeof(indices[0]));
+}
+
+bool test_mesh_decode_index_buffer_v1(void)
+{
+  static const uint32_t indices[] = {0, 1, 2, 2, 1, 3, 0, 1, 2,
+                                     2, 1, 5, 2, 1, 4};
+  static const uint8_t data[]     = {
+    0xe1, 0xf0, 0x10, 0xfe, 0x1f, 0x3d, 0x00, 0x0a, MESH_CODEAUX_TABLE,
+  };
+  return decode_and_compare(data, sizeof(data), indices,
+                            sizeof(indices) / sizeof(indices[0]));
+}
+
+/* -------------------------------------------------------------------------- *
+ * Explicit codes referencing recent vertices: the second triangle is coded
+ * 0xfe with the vertices 3 and 2 entries back in the vertex FIFO, the third
+ * one 0xff with an entry 2 back between two free indices
+ * -------------------------------------------------------------------------- */
+
+bool test_mesh_decode_index_buffer_explicit_fifo(void)
+{
+  static const uint32_t indices[] = {0, 1, 2, 3, 0, 1, 7, 2, 5};
+  static const uint8_t data[]     = {
+    0xe1, 0xf0, 0xfe, 0xff,
+    /* 0xfe: codeaux */
+    0x32,
+    /* 0xff: codeaux, then 7 and 5 as zigzag deltas to the last free index */
+    0x2f, 0x0e, 0x03,
+    MESH_CODEAUX_TABLE,
+  };
+  return decode_and_compare(data, sizeof(data), indices,
+                            sizeof(indices) / sizeof(indices[0]));
+}
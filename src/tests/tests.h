@@ -0,0 +1,19 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <stdbool.h>
+
+/* Unit tests of the core modules, run by wgpu_core_tests */
+typedef bool (*test_func_t)(void);
+
+typedef struct test_case_t {
+  const char* name;
+  test_func_t func;
+} test_case_t;
+
+/* mesh_decoder_tests.c */
+bool test_mesh_decode_index_buffer_v0(void);
+bool test_mesh_decode_index_buffer_v1(void);
+bool test_mesh_decode_index_buffer_explicit_fifo(void);
+
+#endif /* TESTS_H */
@@ -0,0 +1,740 @@
+#include "ambient_occlusion.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+#define WGPU_AMBIENT_OCCLUSION_WORKGROUP_SIZE 8u
+
+typedef struct ambient_occlusion_params_t {
+  /* View space of the frame to clip space of the previous frame */
+  mat4 reprojection;
+  /* 1 / P[0][0], 1 / P[1][1], P[2][0], P[2][1] of the projection */
+  float proj_info[4];
+  /* Texture coordinates of an effect texel at the full resolution */
+  float texel_uv[2];
+  /* Effect texels per view space unit at a view depth of 1 */
+  float projection_scale;
+  float far_depth;
+  float radius;
+  float intensity;
+  float feedback;
+  float depth_threshold;
+  uint32_t frame_index;
+  uint32_t history_valid;
+  uint32_t padding[2];
+} ambient_occlusion_params_t;
+
+struct wgpu_ambient_occlusion {
+  wgpu_context_t* wgpu_context;
+  wgpu_ambient_occlusion_desc_t desc;
+  wgpu_effect_pass_t* effect_pass;
+  ambient_occlusion_params_t params;
+  wgpu_buffer_t params_buffer;
+  WGPUSampler sampler;
+  WGPUBindGroupLayout occlusion_bind_group_layout;
+  WGPUComputePipeline occlusion_pipeline;
+  WGPUBindGroupLayout filter_bind_group_layout;
+  WGPUComputePipeline filter_pipeline;
+  /* Unfiltered r32float occlusion of the frame */
+  WGPUTexture raw_texture;
+  WGPUTextureView raw_view;
+  WGPUBindGroup occlusion_bind_group;
+  /* Ping-pong history of the filtered occlusion and its view depth, the
+   * filter reads one and writes the other */
+  WGPUTexture history_textures[2];
+  WGPUTextureView history_views[2];
+  WGPUBindGroup filter_bind_groups[2];
+  uint32_t current; /* history texture written last */
+  bool history_valid;
+  uint32_t frame_index;
+  mat4 prev_view_projection;
+};
+
+// clang-format off
+static const char* ambient_occlusion_common_wgsl = CODE(
+  struct Params {
+    reprojection : mat4x4<f32>,
+    projInfo : vec4<f32>,
+    texelUV : vec2<f32>,
+    projectionScale : f32,
+    farDepth : f32,
+    radius : f32,
+    intensity : f32,
+    feedback : f32,
+    depthThreshold : f32,
+    frameIndex : u32,
+    historyValid : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1) var effectDepth : texture_2d<f32>;
+
+  fn loadDepth(texel : vec2<i32>) -> f32 {
+    let maxTexel = vec2<i32>(textureDimensions(effectDepth)) - vec2<i32>(1);
+    return textureLoad(effectDepth, clamp(texel, vec2<i32>(0), maxTexel), 0).r;
+  }
+
+  // Nothing was drawn where the depth is the one of the far plane
+  fn isBackground(depth : f32) -> bool {
+    return depth >= params.farDepth * 0.999;
+  }
+
+  // View space position of an effect texel from its positive view depth
+  fn viewPosition(texel : vec2<i32>, depth : f32) -> vec3<f32> {
+    let uv = (vec2<f32>(texel) + vec2<f32>(0.5)) * params.texelUV;
+    let ndc = vec2<f32>(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0);
+    return vec3<f32>((ndc + params.projInfo.zw) * params.projInfo.xy * depth,
+                     -depth);
+  }
+);
+
+static const char* ambient_occlusion_shader_wgsl = CODE(
+  @group(0) @binding(2) var occlusion : texture_storage_2d<r32float, write>;
+
+  fn texelPosition(texel : vec2<i32>) -> vec3<f32> {
+    return viewPosition(texel, loadDepth(texel));
+  }
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (any(id.xy >= textureDimensions(occlusion))) {
+      return;
+    }
+    let texel = vec2<i32>(id.xy);
+    let depth = loadDepth(texel);
+    // Screen space radius in effect texels
+    let radiusTexels = params.radius * params.projectionScale / depth;
+    if (isBackground(depth) || radiusTexels < 1.0) {
+      textureStore(occlusion, texel, vec4<f32>(1.0, 0.0, 0.0, 0.0));
+      return;
+    }
+    let position = viewPosition(texel, depth);
+
+    // Normal from the neighbors closer in depth on each axis, which keeps
+    // the edges of the other surfaces out
+    let left = texelPosition(texel - vec2<i32>(1, 0));
+    let right = texelPosition(texel + vec2<i32>(1, 0));
+    let up = texelPosition(texel - vec2<i32>(0, 1));
+    let down = texelPosition(texel + vec2<i32>(0, 1));
+    let dx = select(position - left, right - position,
+                    abs(right.z - position.z) < abs(left.z - position.z));
+    let dy = select(position - up, down - position,
+                    abs(down.z - position.z) < abs(up.z - position.z));
+    var normal = normalize(cross(dx, dy));
+    if (dot(normal, position) > 0.0) {
+      normal = -normal;
+    }
+
+    // Interleaved 4x4 pattern of the rotation and the step offset, shifted
+    // every frame so that the history gathers more directions
+    let pattern = (id.x & 3u) + ((id.y & 3u) << 2u);
+    let frame = f32(params.frameIndex % 16u);
+    let rotation = fract((f32(pattern) + frame * 0.618034) / 16.0) * 1.570796;
+    let jitter = (f32((pattern * 5u + params.frameIndex) & 15u) + 0.5) / 16.0;
+    let stepTexels = min(radiusTexels, 64.0) / 4.0;
+
+    // Horizon cosines of 4 steps along 4 directions, fading out at the radius
+    let radius2 = params.radius * params.radius;
+    var occlusionSum = 0.0;
+    for (var d = 0u; d < 4u; d = d + 1u) {
+      let angle = rotation + f32(d) * 1.570796;
+      let direction = vec2<f32>(cos(angle), sin(angle));
+      for (var s = 0u; s < 4u; s = s + 1u) {
+        let offset = direction * max((f32(s) + jitter) * stepTexels, 1.0);
+        let v = texelPosition(texel + vec2<i32>(round(offset))) - position;
+        let distance2 = dot(v, v);
+        let cosine = dot(normal, v) * inverseSqrt(max(distance2, 1e-6));
+        occlusionSum = occlusionSum + max(cosine - 0.1, 0.0)
+                                      * max(1.0 - distance2 / radius2, 0.0);
+      }
+    }
+    // The cosines of a fully occluded hemisphere average to about 0.5
+    let ao = clamp(1.0 - params.intensity * occlusionSum / 8.0, 0.0, 1.0);
+    textureStore(occlusion, texel, vec4<f32>(ao, 0.0, 0.0, 0.0));
+  }
+);
+
+static const char* ambient_occlusion_filter_shader_wgsl = CODE(
+  @group(0) @binding(2) var rawOcclusion : texture_2d<f32>;
+  @group(0) @binding(3) var historyTexture : texture_2d<f32>;
+  @group(0) @binding(4) var linearSampler : sampler;
+  @group(0) @binding(5) var historyOutput
+    : texture_storage_2d<rgba16float, write>;
+  @group(0) @binding(6) var effectOutput
+    : texture_storage_2d<rgba16float, write>;
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (any(id.xy >= textureDimensions(historyOutput))) {
+      return;
+    }
+    let texel = vec2<i32>(id.xy);
+    let depth = loadDepth(texel);
+    let threshold = params.depthThreshold * depth;
+
+    // Depth aware blur over the 4x4 tile of the interleaved pattern, the
+    // texel itself always contributes
+    let maxTexel = vec2<i32>(textureDimensions(rawOcclusion)) - vec2<i32>(1);
+    var sum = 0.0;
+    var weight = 0.0;
+    for (var y = -2; y < 2; y = y + 1) {
+      for (var x = -2; x < 2; x = x + 1) {
+        let t = clamp(texel + vec2<i32>(x, y), vec2<i32>(0), maxTexel);
+        let difference = abs(textureLoad(effectDepth, t, 0).r - depth);
+        let w = max(1.0 - difference / threshold, 0.0);
+        sum = sum + w * textureLoad(rawOcclusion, t, 0).r;
+        weight = weight + w;
+      }
+    }
+    var ao = sum / weight;
+
+    // Accumulation with the history where the surface was visible in the
+    // previous frame at the same view depth
+    if (params.historyValid != 0u && !isBackground(depth)) {
+      let previous = params.reprojection
+                     * vec4<f32>(viewPosition(texel, depth), 1.0);
+      let uv = (previous.xy / previous.w) * vec2<f32>(0.5, -0.5)
+               + vec2<f32>(0.5);
+      if (all(uv >= vec2<f32>(0.0)) && all(uv <= vec2<f32>(1.0))) {
+        let size = vec2<f32>(textureDimensions(historyTexture));
+        let history = textureSampleLevel(historyTexture, linearSampler,
+                                         uv / (params.texelUV * size), 0.0);
+        if (abs(history.g - previous.w) < params.depthThreshold * previous.w) {
+          ao = mix(ao, history.r, params.feedback);
+        }
+      }
+    }
+    textureStore(historyOutput, texel, vec4<f32>(ao, depth, 0.0, 0.0));
+    textureStore(effectOutput, texel, vec4<f32>(vec3<f32>(ao), 1.0));
+  }
+);
+// clang-format on
+
+// Prepends the shared uniform block and functions to a shader
+static char* ambient_occlusion_build_wgsl(const char* wgsl)
+{
+  const size_t size = strlen(ambient_occlusion_common_wgsl) + strlen(wgsl) + 2;
+  char* source      = (char*)malloc(size);
+  snprintf(source, size, "%s\n%s", ambient_occlusion_common_wgsl, wgsl);
+  return source;
+}
+
+static WGPUComputePipeline
+ambient_occlusion_create_pipeline(wgpu_context_t* wgpu_context,
+                                  const char* label, const char* wgsl_source,
+                                  WGPUBindGroupLayout bind_group_layout)
+{
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = label,
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts     = &bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  char* wgsl                = ambient_occlusion_build_wgsl(wgsl_source);
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = label,
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = label,
+      .layout  = pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(pipeline != NULL);
+
+  // Partial cleanup
+  wgpu_shader_release(&comp_shader);
+  free(wgsl);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+
+  return pipeline;
+}
+
+// The r32float textures are not filterable, which the default layouts would
+// assume
+static void
+ambient_occlusion_create_pipelines(wgpu_ambient_occlusion_t* ambient_occlusion)
+{
+  wgpu_context_t* wgpu_context = ambient_occlusion->wgpu_context;
+
+  const WGPUBindGroupLayoutEntry params_entry = {
+    // Binding 0: Parameters
+    .binding    = 0,
+    .visibility = WGPUShaderStage_Compute,
+    .buffer = (WGPUBufferBindingLayout) {
+      .type           = WGPUBufferBindingType_Uniform,
+      .minBindingSize = sizeof(ambient_occlusion_params_t),
+    },
+    .sampler = {0},
+  };
+  const WGPUBindGroupLayoutEntry effect_depth_entry = {
+    // Binding 1: Effect depth
+    .binding    = 1,
+    .visibility = WGPUShaderStage_Compute,
+    .texture = (WGPUTextureBindingLayout) {
+      .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+      .viewDimension = WGPUTextureViewDimension_2D,
+    },
+    .storageTexture = {0},
+  };
+
+  // Occlusion pipeline
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+      [0] = params_entry,
+      [1] = effect_depth_entry,
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Unfiltered occlusion
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Compute,
+        .storageTexture = (WGPUStorageTextureBindingLayout) {
+          .access        = WGPUStorageTextureAccess_WriteOnly,
+          .format        = WGPUTextureFormat_R32Float,
+          .viewDimension = WGPUTextureViewDimension_2D,
+        },
+        .sampler = {0},
+      },
+    };
+    ambient_occlusion->occlusion_bind_group_layout
+      = wgpuDeviceCreateBindGroupLayout(
+        wgpu_context->device,
+        &(WGPUBindGroupLayoutDescriptor){
+          .label      = "ambient_occlusion_bgl",
+          .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+          .entries    = bgl_entries,
+        });
+    ASSERT(ambient_occlusion->occlusion_bind_group_layout != NULL);
+
+    ambient_occlusion->occlusion_pipeline = ambient_occlusion_create_pipeline(
+      wgpu_context, "ambient_occlusion_pipeline", ambient_occlusion_shader_wgsl,
+      ambient_occlusion->occlusion_bind_group_layout);
+  }
+
+  // Spatial and temporal filter pipeline
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[7] = {
+      [0] = params_entry,
+      [1] = effect_depth_entry,
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Unfiltered occlusion
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Compute,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+          .viewDimension = WGPUTextureViewDimension_2D,
+        },
+        .storageTexture = {0},
+      },
+      [3] = (WGPUBindGroupLayoutEntry) {
+        // Binding 3: Previous history
+        .binding    = 3,
+        .visibility = WGPUShaderStage_Compute,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_Float,
+          .viewDimension = WGPUTextureViewDimension_2D,
+        },
+        .storageTexture = {0},
+      },
+      [4] = (WGPUBindGroupLayoutEntry) {
+        // Binding 4: Linear sampler of the history
+        .binding    = 4,
+        .visibility = WGPUShaderStage_Compute,
+        .sampler = (WGPUSamplerBindingLayout) {
+          .type = WGPUSamplerBindingType_Filtering,
+        },
+        .texture = {0},
+      },
+      [5] = (WGPUBindGroupLayoutEntry) {
+        // Binding 5: Next history
+        .binding    = 5,
+        .visibility = WGPUShaderStage_Compute,
+        .storageTexture = (WGPUStorageTextureBindingLayout) {
+          .access        = WGPUStorageTextureAccess_WriteOnly,
+          .format        = WGPUTextureFormat_RGBA16Float,
+          .viewDimension = WGPUTextureViewDimension_2D,
+        },
+        .sampler = {0},
+      },
+      [6] = (WGPUBindGroupLayoutEntry) {
+        // Binding 6: Effect texture of the upsampling
+        .binding    = 6,
+        .visibility = WGPUShaderStage_Compute,
+        .storageTexture = (WGPUStorageTextureBindingLayout) {
+          .access        = WGPUStorageTextureAccess_WriteOnly,
+          .format        = WGPUTextureFormat_RGBA16Float,
+          .viewDimension = WGPUTextureViewDimension_2D,
+        },
+        .sampler = {0},
+      },
+    };
+    ambient_occlusion->filter_bind_group_layout
+      = wgpuDeviceCreateBindGroupLayout(
+        wgpu_context->device,
+        &(WGPUBindGroupLayoutDescriptor){
+          .label      = "ambient_occlusion_filter_bgl",
+          .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+          .entries    = bgl_entries,
+        });
+    ASSERT(ambient_occlusion->filter_bind_group_layout != NULL);
+
+    ambient_occlusion->filter_pipeline = ambient_occlusion_create_pipeline(
+      wgpu_context, "ambient_occlusion_filter_pipeline",
+      ambient_occlusion_filter_shader_wgsl,
+      ambient_occlusion->filter_bind_group_layout);
+  }
+}
+
+static void ambient_occlusion_create_texture(
+  wgpu_ambient_occlusion_t* ambient_occlusion, const char* label,
+  WGPUTextureFormat format, WGPUTexture* texture, WGPUTextureView* view)
+{
+  *texture = wgpuDeviceCreateTexture(
+    ambient_occlusion->wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = label,
+      .usage         = WGPUTextureUsage_StorageBinding
+                       | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){
+        wgpu_effect_pass_get_width(ambient_occlusion->effect_pass),
+        wgpu_effect_pass_get_height(ambient_occlusion->effect_pass),
+        1,
+      },
+      .format        = format,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(*texture != NULL);
+
+  *view = wgpuTextureCreateView(
+    *texture, &(WGPUTextureViewDescriptor){
+                .label           = label,
+                .format          = format,
+                .dimension       = WGPUTextureViewDimension_2D,
+                .baseMipLevel    = 0,
+                .mipLevelCount   = 1,
+                .baseArrayLayer  = 0,
+                .arrayLayerCount = 1,
+                .aspect          = WGPUTextureAspect_All,
+              });
+  ASSERT(*view != NULL);
+}
+
+// Textures at the effect resolution and the bind groups sampling them
+static void
+ambient_occlusion_create_textures(wgpu_ambient_occlusion_t* ambient_occlusion)
+{
+  wgpu_context_t* wgpu_context = ambient_occlusion->wgpu_context;
+  WGPUTextureView effect_depth_view
+    = wgpu_effect_pass_get_depth_view(ambient_occlusion->effect_pass);
+
+  ambient_occlusion_create_texture(
+    ambient_occlusion, "ambient_occlusion_raw_texture",
+    WGPUTextureFormat_R32Float, &ambient_occlusion->raw_texture,
+    &ambient_occlusion->raw_view);
+  for (uint32_t i = 0; i < 2; ++i) {
+    ambient_occlusion_create_texture(
+      ambient_occlusion, "ambient_occlusion_history_texture",
+      WGPUTextureFormat_RGBA16Float, &ambient_occlusion->history_textures[i],
+      &ambient_occlusion->history_views[i]);
+  }
+
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = ambient_occlusion->params_buffer.buffer,
+      .size    = ambient_occlusion->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = effect_depth_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = ambient_occlusion->raw_view,
+    },
+  };
+  ambient_occlusion->occlusion_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "ambient_occlusion_bind_group",
+      .layout     = ambient_occlusion->occlusion_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(ambient_occlusion->occlusion_bind_group != NULL);
+
+  // Bind group i reads the history i and writes the other one
+  for (uint32_t i = 0; i < 2; ++i) {
+    WGPUBindGroupEntry filter_bg_entries[7] = {
+      [0] = bg_entries[0],
+      [1] = bg_entries[1],
+      [2] = (WGPUBindGroupEntry) {
+        .binding     = 2,
+        .textureView = ambient_occlusion->raw_view,
+      },
+      [3] = (WGPUBindGroupEntry) {
+        .binding     = 3,
+        .textureView = ambient_occlusion->history_views[i],
+      },
+      [4] = (WGPUBindGroupEntry) {
+        .binding = 4,
+        .sampler = ambient_occlusion->sampler,
+      },
+      [5] = (WGPUBindGroupEntry) {
+        .binding     = 5,
+        .textureView = ambient_occlusion->history_views[1 - i],
+      },
+      [6] = (WGPUBindGroupEntry) {
+        .binding     = 6,
+        .textureView
+        = wgpu_effect_pass_get_color_view(ambient_occlusion->effect_pass),
+      },
+    };
+    ambient_occlusion->filter_bind_groups[i] = wgpuDeviceCreateBindGroup(
+      wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "ambient_occlusion_filter_bind_group",
+        .layout     = ambient_occlusion->filter_bind_group_layout,
+        .entryCount = (uint32_t)ARRAY_SIZE(filter_bg_entries),
+        .entries    = filter_bg_entries,
+      });
+    ASSERT(ambient_occlusion->filter_bind_groups[i] != NULL);
+  }
+
+  ambient_occlusion->current       = 0;
+  ambient_occlusion->history_valid = false;
+}
+
+static void
+ambient_occlusion_release_textures(wgpu_ambient_occlusion_t* ambient_occlusion)
+{
+  for (uint32_t i = 0; i < 2; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, ambient_occlusion->filter_bind_groups[i]);
+    WGPU_RELEASE_RESOURCE(TextureView, ambient_occlusion->history_views[i]);
+    WGPU_RELEASE_RESOURCE(Texture, ambient_occlusion->history_textures[i]);
+  }
+  WGPU_RELEASE_RESOURCE(BindGroup, ambient_occlusion->occlusion_bind_group);
+  WGPU_RELEASE_RESOURCE(TextureView, ambient_occlusion->raw_view);
+  WGPU_RELEASE_RESOURCE(Texture, ambient_occlusion->raw_texture);
+}
+
+wgpu_ambient_occlusion_t*
+wgpu_ambient_occlusion_create(wgpu_context_t* wgpu_context,
+                              const wgpu_ambient_occlusion_desc_t* desc)
+{
+  ASSERT(desc != NULL && desc->width > 0 && desc->height > 0);
+
+  wgpu_ambient_occlusion_t* ambient_occlusion
+    = (wgpu_ambient_occlusion_t*)malloc(sizeof(wgpu_ambient_occlusion_t));
+  memset(ambient_occlusion, 0, sizeof(wgpu_ambient_occlusion_t));
+  ambient_occlusion->wgpu_context = wgpu_context;
+  ambient_occlusion->desc         = *desc;
+  if (desc->scale == 0) {
+    ambient_occlusion->desc.scale = WGPU_EFFECT_PASS_SCALE_HALF;
+  }
+  if (desc->radius <= 0.0f) {
+    ambient_occlusion->desc.radius = 0.5f;
+  }
+  if (desc->intensity <= 0.0f) {
+    ambient_occlusion->desc.intensity = 1.0f;
+  }
+  if (desc->feedback <= 0.0f) {
+    ambient_occlusion->desc.feedback = 0.9f;
+  }
+
+  // The occlusion darkens the target, its alpha is kept
+  const WGPUBlendState multiply_blend = {
+    .color = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_Dst,
+      .dstFactor = WGPUBlendFactor_Zero,
+    },
+    .alpha = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_Zero,
+      .dstFactor = WGPUBlendFactor_One,
+    },
+  };
+  ambient_occlusion->effect_pass = wgpu_effect_pass_create(
+    wgpu_context, &(wgpu_effect_pass_desc_t){
+                    .width         = desc->width,
+                    .height        = desc->height,
+                    .scale         = ambient_occlusion->desc.scale,
+                    .format        = WGPUTextureFormat_RGBA16Float,
+                    .upsample      = WGPU_EFFECT_PASS_UPSAMPLE_BILATERAL,
+                    .target_format = desc->target_format,
+                    .blend         = &multiply_blend,
+                  });
+
+  ambient_occlusion->params = (ambient_occlusion_params_t){
+    .radius          = ambient_occlusion->desc.radius,
+    .intensity       = ambient_occlusion->desc.intensity,
+    .feedback        = ambient_occlusion->desc.feedback,
+    .depth_threshold = 0.1f,
+  };
+  ambient_occlusion->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "ambient_occlusion_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(ambient_occlusion_params_t),
+                  });
+
+  ambient_occlusion->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "ambient_occlusion_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(ambient_occlusion->sampler != NULL);
+
+  ambient_occlusion_create_pipelines(ambient_occlusion);
+  ambient_occlusion_create_textures(ambient_occlusion);
+
+  return ambient_occlusion;
+}
+
+void wgpu_ambient_occlusion_release(wgpu_ambient_occlusion_t* ambient_occlusion)
+{
+  if (ambient_occlusion == NULL) {
+    return;
+  }
+
+  ambient_occlusion_release_textures(ambient_occlusion);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, ambient_occlusion->filter_pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        ambient_occlusion->filter_bind_group_layout);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, ambient_occlusion->occlusion_pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        ambient_occlusion->occlusion_bind_group_layout);
+  WGPU_RELEASE_RESOURCE(Sampler, ambient_occlusion->sampler);
+  wgpu_destroy_buffer(&ambient_occlusion->params_buffer);
+  wgpu_effect_pass_release(ambient_occlusion->effect_pass);
+
+  free(ambient_occlusion);
+}
+
+void wgpu_ambient_occlusion_resize(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                   uint32_t width, uint32_t height)
+{
+  ambient_occlusion_release_textures(ambient_occlusion);
+  wgpu_effect_pass_resize(ambient_occlusion->effect_pass, width, height);
+  ambient_occlusion->desc.width  = width;
+  ambient_occlusion->desc.height = height;
+  ambient_occlusion_create_textures(ambient_occlusion);
+}
+
+void wgpu_ambient_occlusion_reset(wgpu_ambient_occlusion_t* ambient_occlusion)
+{
+  ambient_occlusion->history_valid = false;
+}
+
+void wgpu_ambient_occlusion_update(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                   mat4 projection, mat4 view)
+{
+  ambient_occlusion_params_t* params = &ambient_occlusion->params;
+  const uint32_t scale = (uint32_t)ambient_occlusion->desc.scale;
+
+  params->proj_info[0] = 1.0f / projection[0][0];
+  params->proj_info[1] = 1.0f / projection[1][1];
+  params->proj_info[2] = projection[2][0];
+  params->proj_info[3] = projection[2][1];
+  params->texel_uv[0]  = (float)scale / (float)ambient_occlusion->desc.width;
+  params->texel_uv[1]  = (float)scale / (float)ambient_occlusion->desc.height;
+  params->projection_scale
+    = 0.5f * projection[1][1]
+      * (float)wgpu_effect_pass_get_height(ambient_occlusion->effect_pass);
+
+  // View depth of the far plane, where nothing is occluded
+  mat4 inv_projection = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv(projection, inv_projection);
+  vec4 far_plane = GLM_VEC4_ZERO_INIT;
+  glm_mat4_mulv(inv_projection, (vec4){0.0f, 0.0f, 1.0f, 1.0f}, far_plane);
+  params->far_depth = fabsf(far_plane[2] / far_plane[3]);
+
+  // The history is reprojected from the view space of this frame
+  mat4 inv_view = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv(view, inv_view);
+  glm_mat4_mul(ambient_occlusion->prev_view_projection, inv_view,
+               params->reprojection);
+  glm_mat4_mul(projection, view, ambient_occlusion->prev_view_projection);
+  params->frame_index   = ambient_occlusion->frame_index;
+  params->history_valid = ambient_occlusion->history_valid ? 1u : 0u;
+
+  wgpuQueueWriteBuffer(ambient_occlusion->wgpu_context->queue,
+                       ambient_occlusion->params_buffer.buffer, 0, params,
+                       sizeof(*params));
+  wgpu_effect_pass_set_projection(ambient_occlusion->effect_pass, projection);
+}
+
+void wgpu_ambient_occlusion_compute(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                    WGPUComputePassEncoder pass_encoder,
+                                    WGPUTextureView depth_view)
+{
+  wgpu_effect_pass_downsample_depth(ambient_occlusion->effect_pass,
+                                    pass_encoder, depth_view);
+
+  const uint32_t group_size = WGPU_AMBIENT_OCCLUSION_WORKGROUP_SIZE;
+  const uint32_t group_count_x
+    = (wgpu_effect_pass_get_width(ambient_occlusion->effect_pass) + group_size
+       - 1)
+      / group_size;
+  const uint32_t group_count_y
+    = (wgpu_effect_pass_get_height(ambient_occlusion->effect_pass) + group_size
+       - 1)
+      / group_size;
+
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    ambient_occlusion->occlusion_pipeline);
+  wgpuComputePassEncoderSetBindGroup(
+    pass_encoder, 0, ambient_occlusion->occlusion_bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, group_count_x,
+                                           group_count_y, 1);
+
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    ambient_occlusion->filter_pipeline);
+  wgpuComputePassEncoderSetBindGroup(
+    pass_encoder, 0,
+    ambient_occlusion->filter_bind_groups[ambient_occlusion->current], 0,
+    NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, group_count_x,
+                                           group_count_y, 1);
+
+  ambient_occlusion->current       = 1 - ambient_occlusion->current;
+  ambient_occlusion->history_valid = true;
+  ++ambient_occlusion->frame_index;
+}
+
+void wgpu_ambient_occlusion_apply(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                  WGPURenderPassEncoder pass_encoder,
+                                  WGPUTextureView depth_view)
+{
+  wgpu_effect_pass_upsample(ambient_occlusion->effect_pass, pass_encoder,
+                            depth_view);
+}
+
+WGPUTextureView
+wgpu_ambient_occlusion_get_view(wgpu_ambient_occlusion_t* ambient_occlusion)
+{
+  return wgpu_effect_pass_get_color_view(ambient_occlusion->effect_pass);
+}
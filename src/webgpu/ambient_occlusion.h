@@ -0,0 +1,76 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+#include "effect_pass.h"
+
+typedef struct wgpu_ambient_occlusion wgpu_ambient_occlusion_t;
+
+typedef struct wgpu_ambient_occlusion_desc_t {
+  /* Full resolution of the depth buffer and of the target */
+  uint32_t width;
+  uint32_t height;
+  /* 0 selects WGPU_EFFECT_PASS_SCALE_HALF */
+  wgpu_effect_pass_scale_t scale;
+  /* Format of the target the occlusion is applied to, Undefined selects the
+   * swap chain format */
+  WGPUTextureFormat target_format;
+  /* View space radius of the occluders, 0 selects 0.5 */
+  float radius;
+  /* Strength of the occlusion, 0 selects 1.0 */
+  float intensity;
+  /* Weight of the history in the output, 0 selects 0.9 */
+  float feedback;
+} wgpu_ambient_occlusion_desc_t;
+
+/*
+ * Screen space ambient occlusion at a fraction of the full resolution, on top
+ * of the effect pass. Only the depth buffer is needed, e.g. of a depth
+ * pre-pass or a GBuffer, the normals are reconstructed from the downsampled
+ * view depth. Each frame
+ * - the horizon based occlusion is estimated with 4 directions of 4 steps,
+ *   rotated by a 4x4 interleaved pattern that changes every frame,
+ * - a depth aware 4x4 blur removes the pattern,
+ * - the result is accumulated with the reprojected history of the previous
+ *   frames, disoccluded texels are rejected by their view depth,
+ * - and multiplied into the target with the depth aware upsampling.
+ * @ref Bavoil et al.: Image-Space Horizon-Based Ambient Occlusion, SIGGRAPH
+ * 2008
+ */
+wgpu_ambient_occlusion_t*
+wgpu_ambient_occlusion_create(wgpu_context_t* wgpu_context,
+                              const wgpu_ambient_occlusion_desc_t* desc);
+void wgpu_ambient_occlusion_release(
+  wgpu_ambient_occlusion_t* ambient_occlusion);
+
+/* Recreates the textures for a new full resolution, which drops the history */
+void wgpu_ambient_occlusion_resize(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                   uint32_t width, uint32_t height);
+/* Drops the history, after camera cuts or when the occlusion was off */
+void wgpu_ambient_occlusion_reset(wgpu_ambient_occlusion_t* ambient_occlusion);
+
+/* Writes the camera matrices of the frame, projection without jitter */
+void wgpu_ambient_occlusion_update(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                   mat4 projection, mat4 view);
+
+/*
+ * Records the depth downsampling, the occlusion and its filtering. The depth
+ * texture needs the TextureBinding usage and the view the depth aspect only.
+ */
+void wgpu_ambient_occlusion_compute(
+  wgpu_ambient_occlusion_t* ambient_occlusion,
+  WGPUComputePassEncoder pass_encoder, WGPUTextureView depth_view);
+
+/* Multiplies the upsampled occlusion into a render pass of the target
+ * format */
+void wgpu_ambient_occlusion_apply(wgpu_ambient_occlusion_t* ambient_occlusion,
+                                  WGPURenderPassEncoder pass_encoder,
+                                  WGPUTextureView depth_view);
+
+/* rgba16float occlusion at the effect resolution, 1 for unoccluded */
+WGPUTextureView
+wgpu_ambient_occlusion_get_view(wgpu_ambient_occlusion_t* ambient_occlusion);
+
+#endif
@@ -3,9 +3,52 @@
 
 #include <dawn/webgpu.h>
 
+#include "ambient_occlusion.h"
+#include "api_trace.h"
+#include "auto_exposure.h"
+#include "bind_group_cache.h"
+#include "blur.h"
 #include "buffer.h"
+#include "bvh.h"
+#include "cascaded_shadow_map.h"
 #include "context.h"
+#include "convolution.h"
+#include "depth_prepass.h"
+#include "depth_pyramid.h"
+#include "dynamic_resolution.h"
+#include "effect_pass.h"
+#include "fft.h"
+#include "frame_graph.h"
+#include "frame_uniforms.h"
+#include "gpu_profiler.h"
+#include "gpu_random.h"
+#include "gpu_sort.h"
+#include "light_clusters.h"
+#include "memory_tracker.h"
+#include "mesh_buffer.h"
+#include "meshlet_culling.h"
+#include "occlusion_query_pool.h"
+#include "offscreen_swap_chain.h"
+#include "parallel_encoding.h"
+#include "particles.h"
+#include "pipeline_cache.h"
+#include "pipeline_factory.h"
+#include "pipeline_statistics.h"
+#include "procedural_mesh.h"
+#include "readback.h"
+#include "reflection_probe.h"
+#include "render_bundle_cache.h"
+#include "sampler_cache.h"
 #include "shader.h"
+#include "shadow_atlas.h"
+#include "skybox.h"
+#include "spatial_hash.h"
+#include "surface_group.h"
+#include "temporal_upscale.h"
 #include "texture.h"
+#include "tile_cache.h"
+#include "upload_scheduler.h"
+#include "voxelizer.h"
+#include "weighted_oit.h"
 
 #endif
@@ -0,0 +1,1102 @@
+#include "api_trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../lib/wgpu_native/wgpu_native.h"
+#include "../core/file.h"
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "shader.h"
+
+#define WGPU_API_TRACE_MAGIC 0x52544157u /* "WATR" */
+#define WGPU_API_TRACE_VERSION 2u
+#define WGPU_API_TRACE_INITIAL_CAPACITY 1024u
+/* Most command buffers of a replayed submit */
+#define WGPU_API_TRACE_MAX_COMMAND_COUNT 16u
+/* Stand-in index buffer of the replayed indexed indirect draws */
+#define WGPU_API_TRACE_INDEX_COUNT 65536u
+/* Size of the stand-in render target of the replayed render passes */
+#define WGPU_API_TRACE_TARGET_SIZE 64u
+
+/* Key of the removed entries, the probe sequences continue over them */
+#define WGPU_API_TRACE_TOMBSTONE ((void const*)(uintptr_t)1)
+
+/* -------------------------------------------------------------------------- *
+ * Trace format: a header followed by records, each a record header, the
+ * parameters of its type and data_size bytes of data, padded to keep the
+ * records 8-byte aligned
+ * -------------------------------------------------------------------------- */
+
+#define WGPU_API_TRACE_PADDED_SIZE(size) (((size) + 7u) & ~(uint64_t)7u)
+
+typedef enum wgpu_api_trace_record_type_t {
+  WGPU_API_TRACE_RECORD_BUFFER_CREATE  = 1,
+  WGPU_API_TRACE_RECORD_TEXTURE_CREATE = 2,
+  WGPU_API_TRACE_RECORD_RELEASE        = 3,
+  WGPU_API_TRACE_RECORD_DESTROY        = 4,
+  WGPU_API_TRACE_RECORD_WRITE_BUFFER   = 5,
+  WGPU_API_TRACE_RECORD_WRITE_TEXTURE  = 6,
+  WGPU_API_TRACE_RECORD_SUBMIT         = 7,
+  WGPU_API_TRACE_RECORD_END_FRAME      = 8,
+} wgpu_api_trace_record_type_t;
+
+typedef struct wgpu_api_trace_header_t {
+  uint32_t magic;
+  uint32_t version;
+} wgpu_api_trace_header_t;
+
+typedef struct wgpu_api_trace_record_t {
+  uint32_t type;
+  /* Object of the record, numbered from 1 in creation order, 0 for none */
+  uint32_t id;
+  uint64_t data_size;
+} wgpu_api_trace_record_t;
+
+typedef struct wgpu_api_trace_buffer_params_t {
+  uint64_t size;
+  uint32_t usage;
+  uint32_t mapped_at_creation;
+} wgpu_api_trace_buffer_params_t;
+
+typedef struct wgpu_api_trace_texture_params_t {
+  uint32_t dimension;
+  uint32_t width, height, depth_or_array_layers;
+  uint32_t format;
+  uint32_t mip_level_count;
+  uint32_t sample_count;
+  uint32_t usage;
+} wgpu_api_trace_texture_params_t;
+
+typedef struct wgpu_api_trace_write_buffer_params_t {
+  uint64_t buffer_offset;
+} wgpu_api_trace_write_buffer_params_t;
+
+typedef struct wgpu_api_trace_write_texture_params_t {
+  uint32_t mip_level;
+  uint32_t x, y, z;
+  uint32_t aspect;
+  uint32_t bytes_per_row;
+  uint32_t rows_per_image;
+  uint32_t width, height, depth_or_array_layers;
+  uint64_t offset;
+} wgpu_api_trace_write_texture_params_t;
+
+/* The data of a submit is, for each of its command buffers, the command count
+ * of the command buffer as a uint64_t followed by its pass commands */
+typedef struct wgpu_api_trace_submit_params_t {
+  uint32_t command_count;
+  uint32_t padding;
+} wgpu_api_trace_submit_params_t;
+
+typedef struct wgpu_api_trace_command_t {
+  uint32_t type; /* wgpu_trace_pass_command_type_t */
+  /* Indirect buffer, 0 for none or when it is not known to the trace */
+  uint32_t buffer_id;
+  uint32_t args[4];
+  uint64_t indirect_offset;
+} wgpu_api_trace_command_t;
+
+static size_t record_params_size(uint32_t type)
+{
+  switch (type) {
+    case WGPU_API_TRACE_RECORD_BUFFER_CREATE:
+      return sizeof(wgpu_api_trace_buffer_params_t);
+    case WGPU_API_TRACE_RECORD_TEXTURE_CREATE:
+      return sizeof(wgpu_api_trace_texture_params_t);
+    case WGPU_API_TRACE_RECORD_WRITE_BUFFER:
+      return sizeof(wgpu_api_trace_write_buffer_params_t);
+    case WGPU_API_TRACE_RECORD_WRITE_TEXTURE:
+      return sizeof(wgpu_api_trace_write_texture_params_t);
+    case WGPU_API_TRACE_RECORD_SUBMIT:
+      return sizeof(wgpu_api_trace_submit_params_t);
+    default:
+      return 0;
+  }
+}
+
+/* -------------------------------------------------------------------------- *
+ * Capture
+ * -------------------------------------------------------------------------- */
+
+typedef struct wgpu_api_trace_entry_t {
+  void const* handle; /* NULL for empty entries */
+  uint32_t id;
+  /* Mirror of the reference count of the handle, from the application side */
+  uint32_t ref_count;
+} wgpu_api_trace_entry_t;
+
+/* Pass commands of a command encoder, then of its command buffer until it is
+ * submitted */
+typedef struct wgpu_api_trace_command_list_t {
+  void const* owner; /* command encoder, then command buffer once finished */
+  void const* pass;  /* last pass begun on the encoder, NULL once finished */
+  wgpu_api_trace_command_t* commands;
+  uint32_t count;
+  uint32_t capacity;
+} wgpu_api_trace_command_list_t;
+
+static struct {
+  bool capturing;
+  pthread_mutex_t mutex;
+  FILE* file;
+  /* Open addressing hash map of the live handles, linear probing */
+  wgpu_api_trace_entry_t* entries;
+  uint32_t capacity; /* power of two */
+  uint32_t count;
+  uint32_t tombstone_count;
+  uint32_t next_id;
+  /* Command lists of the encoders and of the unsubmitted command buffers, a
+   * handful at a time */
+  wgpu_api_trace_command_list_t* lists;
+  uint32_t list_count;
+  uint32_t list_capacity;
+  /* Submit data, reused across the submits */
+  uint8_t* submit_data;
+  size_t submit_data_capacity;
+} wgpu_api_trace = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint32_t hash_handle(void const* handle)
+{
+  /* Fibonacci hashing of the pointer, its low bits are mostly alignment */
+  uint64_t key = (uint64_t)(uintptr_t)handle;
+  return (uint32_t)((key * 11400714819323198485ull) >> 32);
+}
+
+/* Entry of the handle, or the empty entry to insert it at */
+static wgpu_api_trace_entry_t* find_entry(wgpu_api_trace_entry_t* entries,
+                                          uint32_t capacity,
+                                          void const* handle)
+{
+  const uint32_t mask               = capacity - 1u;
+  wgpu_api_trace_entry_t* insert_at = NULL;
+  for (uint32_t i = hash_handle(handle) & mask;; i = (i + 1u) & mask) {
+    wgpu_api_trace_entry_t* entry = &entries[i];
+    if (entry->handle == handle) {
+      return entry;
+    }
+    if (entry->handle == WGPU_API_TRACE_TOMBSTONE) {
+      if (insert_at == NULL) {
+        insert_at = entry;
+      }
+    }
+    else if (entry->handle == NULL) {
+      return insert_at != NULL ? insert_at : entry;
+    }
+  }
+}
+
+static void rehash(uint32_t capacity)
+{
+  wgpu_api_trace_entry_t* entries = calloc(capacity, sizeof(*entries));
+  ASSERT(entries != NULL);
+  for (uint32_t i = 0; i < wgpu_api_trace.capacity; ++i) {
+    wgpu_api_trace_entry_t* entry = &wgpu_api_trace.entries[i];
+    if (entry->handle != NULL && entry->handle != WGPU_API_TRACE_TOMBSTONE) {
+      *find_entry(entries, capacity, entry->handle) = *entry;
+    }
+  }
+  free(wgpu_api_trace.entries);
+  wgpu_api_trace.entries         = entries;
+  wgpu_api_trace.capacity        = capacity;
+  wgpu_api_trace.tombstone_count = 0;
+}
+
+/* Handles created before the capture started are not known */
+static wgpu_api_trace_entry_t* lookup(void const* handle)
+{
+  if (wgpu_api_trace.count == 0) {
+    return NULL;
+  }
+  wgpu_api_trace_entry_t* entry
+    = find_entry(wgpu_api_trace.entries, wgpu_api_trace.capacity, handle);
+  return entry->handle == handle ? entry : NULL;
+}
+
+/* Writes a record, called with the mutex locked */
+static void write_record(uint32_t type, uint32_t id, void const* params,
+                         void const* data, uint64_t data_size)
+{
+  if (wgpu_api_trace.file == NULL) {
+    return;
+  }
+  const wgpu_api_trace_record_t record = {
+    .type      = type,
+    .id        = id,
+    .data_size = data_size,
+  };
+  fwrite(&record, sizeof(record), 1, wgpu_api_trace.file);
+  const size_t params_size = record_params_size(type);
+  if (params_size > 0) {
+    fwrite(params, params_size, 1, wgpu_api_trace.file);
+  }
+  if (data_size > 0) {
+    static const uint8_t padding[8] = {0};
+    fwrite(data, (size_t)data_size, 1, wgpu_api_trace.file);
+    fwrite(padding, (size_t)(WGPU_API_TRACE_PADDED_SIZE(data_size) - data_size),
+           1, wgpu_api_trace.file);
+  }
+}
+
+/* Registers a created handle and returns its id, called with the mutex
+ * locked */
+static uint32_t insert_handle(void const* handle)
+{
+  /* Grow at 3/4 occupancy, tombstones included */
+  if ((wgpu_api_trace.count + wgpu_api_trace.tombstone_count + 1u) * 4u
+      > wgpu_api_trace.capacity * 3u) {
+    rehash(wgpu_api_trace.capacity == 0 ?
+             WGPU_API_TRACE_INITIAL_CAPACITY :
+             (wgpu_api_trace.count * 2u > wgpu_api_trace.capacity ?
+                wgpu_api_trace.capacity * 2u :
+                wgpu_api_trace.capacity));
+  }
+  wgpu_api_trace_entry_t* entry
+    = find_entry(wgpu_api_trace.entries, wgpu_api_trace.capacity, handle);
+  /* Handles are not reused while they are alive */
+  ASSERT(entry->handle != handle);
+  if (entry->handle == WGPU_API_TRACE_TOMBSTONE) {
+    --wgpu_api_trace.tombstone_count;
+  }
+  ++wgpu_api_trace.count;
+  entry->handle    = handle;
+  entry->id        = ++wgpu_api_trace.next_id;
+  entry->ref_count = 1;
+  return entry->id;
+}
+
+static void on_buffer_created(WGPUBuffer buffer,
+                              WGPUBufferDescriptor const* descriptor)
+{
+  const wgpu_api_trace_buffer_params_t params = {
+    .size               = descriptor->size,
+    .usage              = (uint32_t)descriptor->usage,
+    .mapped_at_creation = descriptor->mappedAtCreation ? 1u : 0u,
+  };
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  const uint32_t id = insert_handle(buffer);
+  write_record(WGPU_API_TRACE_RECORD_BUFFER_CREATE, id, &params, NULL, 0);
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_texture_created(WGPUTexture texture,
+                               WGPUTextureDescriptor const* descriptor)
+{
+  const wgpu_api_trace_texture_params_t params = {
+    .dimension             = (uint32_t)descriptor->dimension,
+    .width                 = descriptor->size.width,
+    .height                = descriptor->size.height,
+    .depth_or_array_layers = descriptor->size.depthOrArrayLayers,
+    .format                = (uint32_t)descriptor->format,
+    .mip_level_count       = descriptor->mipLevelCount,
+    .sample_count          = descriptor->sampleCount,
+    .usage                 = (uint32_t)descriptor->usage,
+  };
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  const uint32_t id = insert_handle(texture);
+  write_record(WGPU_API_TRACE_RECORD_TEXTURE_CREATE, id, &params, NULL, 0);
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_referenced(void const* handle)
+{
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_entry_t* entry = lookup(handle);
+  if (entry != NULL) {
+    ++entry->ref_count;
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_released(void const* handle)
+{
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_entry_t* entry = lookup(handle);
+  if (entry != NULL && --entry->ref_count == 0) {
+    write_record(WGPU_API_TRACE_RECORD_RELEASE, entry->id, NULL, NULL, 0);
+    entry->handle = WGPU_API_TRACE_TOMBSTONE;
+    --wgpu_api_trace.count;
+    ++wgpu_api_trace.tombstone_count;
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_destroyed(void const* handle)
+{
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_entry_t* entry = lookup(handle);
+  if (entry != NULL) {
+    write_record(WGPU_API_TRACE_RECORD_DESTROY, entry->id, NULL, NULL, 0);
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_queue_write_buffer(WGPUBuffer buffer, uint64_t buffer_offset,
+                                  void const* data, size_t size)
+{
+  const wgpu_api_trace_write_buffer_params_t params = {
+    .buffer_offset = buffer_offset,
+  };
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_entry_t* entry = lookup(buffer);
+  if (entry != NULL) {
+    write_record(WGPU_API_TRACE_RECORD_WRITE_BUFFER, entry->id, &params, data,
+                 size);
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_queue_write_texture(WGPUImageCopyTexture const* destination,
+                                   void const* data, size_t data_size,
+                                   WGPUTextureDataLayout const* data_layout,
+                                   WGPUExtent3D const* write_size)
+{
+  const wgpu_api_trace_write_texture_params_t params = {
+    .mip_level             = destination->mipLevel,
+    .x                     = destination->origin.x,
+    .y                     = destination->origin.y,
+    .z                     = destination->origin.z,
+    .aspect                = (uint32_t)destination->aspect,
+    .bytes_per_row         = data_layout->bytesPerRow,
+    .rows_per_image        = data_layout->rowsPerImage,
+    .width                 = write_size->width,
+    .height                = write_size->height,
+    .depth_or_array_layers = write_size->depthOrArrayLayers,
+    .offset                = data_layout->offset,
+  };
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_entry_t* entry = lookup(destination->texture);
+  if (entry != NULL) {
+    write_record(WGPU_API_TRACE_RECORD_WRITE_TEXTURE, entry->id, &params, data,
+                 data_size);
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+/* Command list of an encoder, a command buffer or a pass, called with the
+ * mutex locked */
+static wgpu_api_trace_command_list_t* find_command_list(void const* owner,
+                                                        void const* pass)
+{
+  for (uint32_t i = 0; i < wgpu_api_trace.list_count; ++i) {
+    wgpu_api_trace_command_list_t* list = &wgpu_api_trace.lists[i];
+    if ((owner != NULL && list->owner == owner)
+        || (pass != NULL && list->pass == pass)) {
+      return list;
+    }
+  }
+  return NULL;
+}
+
+static void remove_command_list(wgpu_api_trace_command_list_t* list)
+{
+  free(list->commands);
+  *list = wgpu_api_trace.lists[--wgpu_api_trace.list_count];
+}
+
+static void append_command(wgpu_api_trace_command_list_t* list,
+                           const wgpu_api_trace_command_t* command)
+{
+  if (list->count == list->capacity) {
+    list->capacity = MAX(16u, list->capacity * 2u);
+    list->commands = realloc(list->commands,
+                             list->capacity * sizeof(wgpu_api_trace_command_t));
+    ASSERT(list->commands != NULL);
+  }
+  list->commands[list->count++] = *command;
+}
+
+static void on_pass_begun(WGPUCommandEncoder encoder, void const* pass,
+                          wgpu_trace_pass_command_type_t type)
+{
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_command_list_t* list = find_command_list(encoder, NULL);
+  if (list == NULL) {
+    if (wgpu_api_trace.list_count == wgpu_api_trace.list_capacity) {
+      wgpu_api_trace.list_capacity = MAX(8u, wgpu_api_trace.list_capacity * 2u);
+      wgpu_api_trace.lists
+        = realloc(wgpu_api_trace.lists, wgpu_api_trace.list_capacity
+                                          * sizeof(*wgpu_api_trace.lists));
+      ASSERT(wgpu_api_trace.lists != NULL);
+    }
+    list = &wgpu_api_trace.lists[wgpu_api_trace.list_count++];
+    *list = (wgpu_api_trace_command_list_t){.owner = encoder};
+  }
+  list->pass = pass;
+  append_command(list, &(wgpu_api_trace_command_t){.type = (uint32_t)type});
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_pass_command(void const* pass,
+                            wgpu_trace_pass_command_t const* command)
+{
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  /* Passes begun before the capture started are not known */
+  wgpu_api_trace_command_list_t* list = find_command_list(NULL, pass);
+  if (list != NULL) {
+    wgpu_api_trace_command_t trace_command = {
+      .type            = (uint32_t)command->type,
+      .indirect_offset = command->indirect_offset,
+    };
+    memcpy(trace_command.args, command->args, sizeof(trace_command.args));
+    if (command->indirect_buffer != NULL) {
+      wgpu_api_trace_entry_t* entry = lookup(command->indirect_buffer);
+      trace_command.buffer_id       = entry != NULL ? entry->id : 0;
+    }
+    append_command(list, &trace_command);
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_command_encoder_finished(WGPUCommandEncoder encoder,
+                                        WGPUCommandBuffer command_buffer)
+{
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace_command_list_t* list = find_command_list(encoder, NULL);
+  if (list != NULL) {
+    list->owner = command_buffer;
+    list->pass  = NULL;
+  }
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+static void on_queue_submit(uint32_t command_count,
+                            WGPUCommandBuffer const* commands)
+{
+  const wgpu_api_trace_submit_params_t params = {
+    .command_count = command_count,
+  };
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  /* Gather the command lists of the command buffers, which are consumed by
+   * the submit */
+  size_t data_size = 0;
+  for (uint32_t i = 0; i < command_count; ++i) {
+    wgpu_api_trace_command_list_t* list = find_command_list(commands[i], NULL);
+    const uint32_t count                = list != NULL ? list->count : 0;
+    const size_t size
+      = sizeof(uint64_t) + count * sizeof(wgpu_api_trace_command_t);
+    if (data_size + size > wgpu_api_trace.submit_data_capacity) {
+      wgpu_api_trace.submit_data_capacity
+        = MAX(data_size + size, wgpu_api_trace.submit_data_capacity * 2u);
+      wgpu_api_trace.submit_data = realloc(
+        wgpu_api_trace.submit_data, wgpu_api_trace.submit_data_capacity);
+      ASSERT(wgpu_api_trace.submit_data != NULL);
+    }
+    const uint64_t command_list_count = count;
+    memcpy(wgpu_api_trace.submit_data + data_size, &command_list_count,
+           sizeof(uint64_t));
+    if (count > 0) {
+      memcpy(wgpu_api_trace.submit_data + data_size + sizeof(uint64_t),
+             list->commands, count * sizeof(wgpu_api_trace_command_t));
+    }
+    data_size += size;
+    if (list != NULL) {
+      remove_command_list(list);
+    }
+  }
+  write_record(WGPU_API_TRACE_RECORD_SUBMIT, 0, &params,
+               wgpu_api_trace.submit_data, data_size);
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+bool wgpu_api_trace_begin_capture(const char* filename)
+{
+  if (wgpu_api_trace.capturing) {
+    return true;
+  }
+  FILE* file = fopen(filename, "wb");
+  if (file == NULL) {
+    log_error("Could not create API trace file: %s", filename);
+    return false;
+  }
+  const wgpu_api_trace_header_t header = {
+    .magic   = WGPU_API_TRACE_MAGIC,
+    .version = WGPU_API_TRACE_VERSION,
+  };
+  fwrite(&header, sizeof(header), 1, file);
+
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  wgpu_api_trace.file    = file;
+  wgpu_api_trace.next_id = 0;
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+
+  static const wgpu_trace_hooks_t hooks = {
+    .buffer_created           = on_buffer_created,
+    .texture_created          = on_texture_created,
+    .referenced               = on_referenced,
+    .released                 = on_released,
+    .destroyed                = on_destroyed,
+    .queue_write_buffer       = on_queue_write_buffer,
+    .queue_write_texture      = on_queue_write_texture,
+    .queue_submit             = on_queue_submit,
+    .pass_begun               = on_pass_begun,
+    .pass_command             = on_pass_command,
+    .command_encoder_finished = on_command_encoder_finished,
+  };
+  wgpu_set_trace_hooks(&hooks);
+  wgpu_api_trace.capturing = true;
+  return true;
+}
+
+void wgpu_api_trace_end_capture(void)
+{
+  if (!wgpu_api_trace.capturing) {
+    return;
+  }
+  wgpu_set_trace_hooks(NULL);
+  wgpu_api_trace.capturing = false;
+
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  fclose(wgpu_api_trace.file);
+  wgpu_api_trace.file = NULL;
+  free(wgpu_api_trace.entries);
+  wgpu_api_trace.entries         = NULL;
+  wgpu_api_trace.capacity        = 0;
+  wgpu_api_trace.count           = 0;
+  wgpu_api_trace.tombstone_count = 0;
+  while (wgpu_api_trace.list_count > 0) {
+    remove_command_list(&wgpu_api_trace.lists[0]);
+  }
+  free(wgpu_api_trace.lists);
+  wgpu_api_trace.lists         = NULL;
+  wgpu_api_trace.list_capacity = 0;
+  free(wgpu_api_trace.submit_data);
+  wgpu_api_trace.submit_data          = NULL;
+  wgpu_api_trace.submit_data_capacity = 0;
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+bool wgpu_api_trace_is_capturing(void)
+{
+  return wgpu_api_trace.capturing;
+}
+
+void wgpu_api_trace_end_frame(void)
+{
+  if (!wgpu_api_trace.capturing) {
+    return;
+  }
+  pthread_mutex_lock(&wgpu_api_trace.mutex);
+  write_record(WGPU_API_TRACE_RECORD_END_FRAME, 0, NULL, NULL, 0);
+  pthread_mutex_unlock(&wgpu_api_trace.mutex);
+}
+
+/* -------------------------------------------------------------------------- *
+ * Replay
+ * -------------------------------------------------------------------------- */
+
+typedef struct wgpu_api_trace_object_t {
+  uint32_t type; /* record type of the creation, 0 while not alive */
+  void* handle;  /* WGPUBuffer or WGPUTexture */
+} wgpu_api_trace_object_t;
+
+struct wgpu_api_trace_replay {
+  wgpu_context_t* wgpu_context;
+  file_mapping_t mapping;
+  /* Offset of the first record of every captured frame in the mapping, and
+   * the end of the last frame */
+  uint64_t* frame_offsets;
+  uint32_t captured_frame_count;
+  /* Objects by id */
+  wgpu_api_trace_object_t* objects;
+  uint32_t object_count;
+  /* Stand-ins for the pipelines and the attachments of the passes, which are
+   * not captured */
+  struct {
+    WGPUTexture depth_texture;
+    WGPUTextureView depth_view;
+    WGPUBuffer index_buffer;
+    WGPURenderPipeline render_pipeline;
+    WGPUComputePipeline compute_pipeline;
+  } stand_in;
+};
+
+/* The vertices of the stand-in draws are behind the far plane, the draws
+ * cost their vertex work and no fragment work */
+// clang-format off
+static const char* stand_in_vertex_shader_wgsl = CODE(
+  @vertex
+  fn main() -> @builtin(position) vec4<f32> {
+    return vec4<f32>(0.0, 0.0, 2.0, 1.0);
+  }
+);
+
+static const char* stand_in_compute_shader_wgsl = CODE(
+  @compute @workgroup_size(64)
+  fn main() {
+  }
+);
+// clang-format on
+
+static void create_stand_ins(wgpu_api_trace_replay_t* replay)
+{
+  wgpu_context_t* wgpu_context = replay->wgpu_context;
+
+  replay->stand_in.depth_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "api_trace_stand_in_depth_texture",
+      .usage         = WGPUTextureUsage_RenderAttachment,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = {WGPU_API_TRACE_TARGET_SIZE, WGPU_API_TRACE_TARGET_SIZE,
+                        1},
+      .format        = WGPUTextureFormat_Depth32Float,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(replay->stand_in.depth_texture != NULL);
+  replay->stand_in.depth_view
+    = wgpuTextureCreateView(replay->stand_in.depth_texture, NULL);
+  ASSERT(replay->stand_in.depth_view != NULL);
+
+  /* Zero indices, the indexed indirect draws past them are skipped by the
+   * validation of Dawn */
+  replay->stand_in.index_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "api_trace_stand_in_index_buffer",
+      .usage = WGPUBufferUsage_Index,
+      .size  = WGPU_API_TRACE_INDEX_COUNT * sizeof(uint32_t),
+    });
+  ASSERT(replay->stand_in.index_buffer != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label = "api_trace_stand_in_pl",
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = WGPUTextureFormat_Depth32Float,
+      .depth_write_enabled = true,
+    });
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "api_trace_stand_in_vertex_shader",
+                  .wgsl_code.source = stand_in_vertex_shader_wgsl,
+                  .entry            = "main",
+                },
+              });
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+  replay->stand_in.render_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label  = "api_trace_stand_in_render_pipeline",
+                            .layout = pipeline_layout,
+                            .primitive = (WGPUPrimitiveState){
+                              .topology = WGPUPrimitiveTopology_TriangleList,
+                              .frontFace = WGPUFrontFace_CCW,
+                              .cullMode  = WGPUCullMode_None,
+                            },
+                            .vertex       = vertex_state,
+                            .fragment     = NULL,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(replay->stand_in.render_pipeline != NULL);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "api_trace_stand_in_compute_shader",
+                    .wgsl_code.source = stand_in_compute_shader_wgsl,
+                    .entry            = "main",
+                  });
+  replay->stand_in.compute_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "api_trace_stand_in_compute_pipeline",
+      .layout  = pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(replay->stand_in.compute_pipeline != NULL);
+
+  // Partial cleanup
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+/* Record at an offset of the trace, NULL past its end or when truncated */
+static const wgpu_api_trace_record_t*
+get_record(wgpu_api_trace_replay_t* replay, uint64_t offset, uint64_t* next)
+{
+  const uint64_t size = replay->mapping.size;
+  if (offset + sizeof(wgpu_api_trace_record_t) > size) {
+    return NULL;
+  }
+  const wgpu_api_trace_record_t* record
+    = (const wgpu_api_trace_record_t*)(replay->mapping.data + offset);
+  const uint64_t record_size = sizeof(wgpu_api_trace_record_t)
+                               + record_params_size(record->type)
+                               + WGPU_API_TRACE_PADDED_SIZE(record->data_size);
+  if (record_size > size - offset) {
+    return NULL;
+  }
+  *next = offset + record_size;
+  return record;
+}
+
+/* Indexes the frames and counts the objects of the trace */
+static bool index_trace(wgpu_api_trace_replay_t* replay)
+{
+  uint32_t frame_capacity = 0;
+  uint64_t offset         = sizeof(wgpu_api_trace_header_t);
+  uint64_t frame_start    = offset;
+  uint64_t next           = 0;
+  const wgpu_api_trace_record_t* record;
+  while ((record = get_record(replay, offset, &next)) != NULL) {
+    replay->object_count = MAX(replay->object_count, record->id + 1u);
+    if (record->type == WGPU_API_TRACE_RECORD_END_FRAME) {
+      if (replay->captured_frame_count + 1u >= frame_capacity) {
+        frame_capacity = MAX(64u, frame_capacity * 2u);
+        replay->frame_offsets
+          = realloc(replay->frame_offsets, frame_capacity * sizeof(uint64_t));
+        ASSERT(replay->frame_offsets != NULL);
+      }
+      replay->frame_offsets[replay->captured_frame_count++] = frame_start;
+      replay->frame_offsets[replay->captured_frame_count]   = next;
+      frame_start                                           = next;
+    }
+    offset = next;
+  }
+  if (offset != replay->mapping.size) {
+    log_warn("API trace truncated after %llu bytes",
+             (unsigned long long)offset);
+  }
+  return replay->captured_frame_count > 0;
+}
+
+static void release_object(wgpu_api_trace_object_t* object)
+{
+  if (object->type == WGPU_API_TRACE_RECORD_BUFFER_CREATE) {
+    wgpuBufferRelease((WGPUBuffer)object->handle);
+  }
+  else if (object->type == WGPU_API_TRACE_RECORD_TEXTURE_CREATE) {
+    wgpuTextureRelease((WGPUTexture)object->handle);
+  }
+  object->type   = 0;
+  object->handle = NULL;
+}
+
+/* Traced indirect buffer, NULL when it is not known or not alive */
+static WGPUBuffer get_indirect_buffer(wgpu_api_trace_replay_t* replay,
+                                      uint32_t id)
+{
+  if (id == 0 || id >= replay->object_count
+      || replay->objects[id].type != WGPU_API_TRACE_RECORD_BUFFER_CREATE) {
+    return NULL;
+  }
+  return (WGPUBuffer)replay->objects[id].handle;
+}
+
+static void end_passes(WGPURenderPassEncoder* render_pass,
+                       WGPUComputePassEncoder* compute_pass)
+{
+  if (*render_pass != NULL) {
+    wgpuRenderPassEncoderEnd(*render_pass);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, *render_pass);
+  }
+  if (*compute_pass != NULL) {
+    wgpuComputePassEncoderEnd(*compute_pass);
+    WGPU_RELEASE_RESOURCE(ComputePassEncoder, *compute_pass);
+  }
+}
+
+/* Re-issues the pass commands of a command buffer with the stand-in
+ * pipelines, the passes end where the next one begins. The indexed draws are
+ * replayed as draws of as many vertices, the indirect commands read the
+ * arguments from the replayed buffer. */
+static WGPUCommandBuffer
+replay_command_buffer(wgpu_api_trace_replay_t* replay,
+                      const wgpu_api_trace_command_t* commands,
+                      uint32_t command_count)
+{
+  WGPUCommandEncoder encoder
+    = wgpuDeviceCreateCommandEncoder(replay->wgpu_context->device, NULL);
+  WGPURenderPassEncoder render_pass   = NULL;
+  WGPUComputePassEncoder compute_pass = NULL;
+  for (uint32_t i = 0; i < command_count; ++i) {
+    const wgpu_api_trace_command_t* c = &commands[i];
+    WGPUBuffer indirect_buffer = get_indirect_buffer(replay, c->buffer_id);
+    switch (c->type) {
+      case WGPU_TRACE_PASS_COMMAND_BEGIN_RENDER_PASS:
+        end_passes(&render_pass, &compute_pass);
+        render_pass = wgpuCommandEncoderBeginRenderPass(
+          encoder, &(WGPURenderPassDescriptor){
+                     .label = "api_trace_stand_in_pass",
+                     .depthStencilAttachment
+                     = &(WGPURenderPassDepthStencilAttachment){
+                       .view            = replay->stand_in.depth_view,
+                       .depthLoadOp     = WGPULoadOp_Clear,
+                       .depthStoreOp    = WGPUStoreOp_Discard,
+                       .depthClearValue = 1.0f,
+                       .clearDepth      = 1.0f,
+                     },
+                   });
+        wgpuRenderPassEncoderSetPipeline(render_pass,
+                                         replay->stand_in.render_pipeline);
+        wgpuRenderPassEncoderSetIndexBuffer(
+          render_pass, replay->stand_in.index_buffer, WGPUIndexFormat_Uint32,
+          0, WGPU_WHOLE_SIZE);
+        break;
+      case WGPU_TRACE_PASS_COMMAND_BEGIN_COMPUTE_PASS:
+        end_passes(&render_pass, &compute_pass);
+        compute_pass = wgpuCommandEncoderBeginComputePass(encoder, NULL);
+        wgpuComputePassEncoderSetPipeline(compute_pass,
+                                          replay->stand_in.compute_pipeline);
+        break;
+      case WGPU_TRACE_PASS_COMMAND_DRAW:
+        if (render_pass != NULL) {
+          wgpuRenderPassEncoderDraw(render_pass, c->args[0], c->args[1],
+                                    c->args[2], c->args[3]);
+        }
+        break;
+      case WGPU_TRACE_PASS_COMMAND_DRAW_INDEXED:
+        if (render_pass != NULL) {
+          wgpuRenderPassEncoderDraw(render_pass, c->args[0], c->args[1], 0,
+                                    c->args[3]);
+        }
+        break;
+      case WGPU_TRACE_PASS_COMMAND_DRAW_INDIRECT:
+        if (render_pass != NULL && indirect_buffer != NULL) {
+          wgpuRenderPassEncoderDrawIndirect(render_pass, indirect_buffer,
+                                            c->indirect_offset);
+        }
+        break;
+      case WGPU_TRACE_PASS_COMMAND_DRAW_INDEXED_INDIRECT:
+        if (render_pass != NULL && indirect_buffer != NULL) {
+          wgpuRenderPassEncoderDrawIndexedIndirect(
+            render_pass, indirect_buffer, c->indirect_offset);
+        }
+        break;
+      case WGPU_TRACE_PASS_COMMAND_DISPATCH:
+        if (compute_pass != NULL) {
+          wgpuComputePassEncoderDispatchWorkgroups(compute_pass, c->args[0],
+                                                   c->args[1], c->args[2]);
+        }
+        break;
+      case WGPU_TRACE_PASS_COMMAND_DISPATCH_INDIRECT:
+        if (compute_pass != NULL && indirect_buffer != NULL) {
+          wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+            compute_pass, indirect_buffer, c->indirect_offset);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  end_passes(&render_pass, &compute_pass);
+  WGPUCommandBuffer command_buffer = wgpuCommandEncoderFinish(encoder, NULL);
+  wgpuCommandEncoderRelease(encoder);
+  return command_buffer;
+}
+
+static void replay_submit(wgpu_api_trace_replay_t* replay,
+                          uint32_t command_count, const uint8_t* data,
+                          uint64_t data_size)
+{
+  WGPUCommandBuffer command_buffers[WGPU_API_TRACE_MAX_COMMAND_COUNT];
+  command_count   = MIN(command_count, WGPU_API_TRACE_MAX_COMMAND_COUNT);
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < command_count; ++i) {
+    /* The commands are 8-byte aligned like the data */
+    uint64_t count = 0;
+    if (offset + sizeof(uint64_t) <= data_size) {
+      memcpy(&count, data + offset, sizeof(uint64_t));
+      offset += sizeof(uint64_t);
+    }
+    if (count > (data_size - offset) / sizeof(wgpu_api_trace_command_t)) {
+      count = 0;
+    }
+    command_buffers[i] = replay_command_buffer(
+      replay, (const wgpu_api_trace_command_t*)(data + offset),
+      (uint32_t)count);
+    offset += count * sizeof(wgpu_api_trace_command_t);
+  }
+  wgpuQueueSubmit(replay->wgpu_context->queue, command_count, command_buffers);
+  for (uint32_t i = 0; i < command_count; ++i) {
+    wgpuCommandBufferRelease(command_buffers[i]);
+  }
+}
+
+static void replay_record(wgpu_api_trace_replay_t* replay,
+                          const wgpu_api_trace_record_t* record)
+{
+  wgpu_context_t* wgpu_context    = replay->wgpu_context;
+  const void* params              = record + 1;
+  const uint8_t* data             = (const uint8_t*)params
+                        + record_params_size(record->type);
+  wgpu_api_trace_object_t* object = &replay->objects[record->id];
+
+  switch (record->type) {
+    case WGPU_API_TRACE_RECORD_BUFFER_CREATE: {
+      const wgpu_api_trace_buffer_params_t* p = params;
+      /* Replayed again, the buffer of the last replay goes first */
+      release_object(object);
+      WGPUBuffer buffer = wgpuDeviceCreateBuffer(
+        wgpu_context->device, &(WGPUBufferDescriptor){
+                                .usage            = p->usage,
+                                .size             = p->size,
+                                .mappedAtCreation = p->mapped_at_creation != 0,
+                              });
+      /* The contents written through the mapping are not captured */
+      if (p->mapped_at_creation != 0) {
+        wgpuBufferUnmap(buffer);
+      }
+      object->type   = record->type;
+      object->handle = buffer;
+    } break;
+    case WGPU_API_TRACE_RECORD_TEXTURE_CREATE: {
+      const wgpu_api_trace_texture_params_t* p = params;
+      release_object(object);
+      object->type   = record->type;
+      object->handle = wgpuDeviceCreateTexture(
+        wgpu_context->device,
+        &(WGPUTextureDescriptor){
+          .usage         = p->usage,
+          .dimension     = (WGPUTextureDimension)p->dimension,
+          .size          = {p->width, p->height, p->depth_or_array_layers},
+          .format        = (WGPUTextureFormat)p->format,
+          .mipLevelCount = p->mip_level_count,
+          .sampleCount   = p->sample_count,
+        });
+    } break;
+    case WGPU_API_TRACE_RECORD_RELEASE:
+      release_object(object);
+      break;
+    case WGPU_API_TRACE_RECORD_DESTROY:
+      if (object->type == WGPU_API_TRACE_RECORD_BUFFER_CREATE) {
+        wgpuBufferDestroy((WGPUBuffer)object->handle);
+      }
+      else if (object->type == WGPU_API_TRACE_RECORD_TEXTURE_CREATE) {
+        wgpuTextureDestroy((WGPUTexture)object->handle);
+      }
+      break;
+    case WGPU_API_TRACE_RECORD_WRITE_BUFFER: {
+      const wgpu_api_trace_write_buffer_params_t* p = params;
+      if (object->type == WGPU_API_TRACE_RECORD_BUFFER_CREATE) {
+        wgpuQueueWriteBuffer(wgpu_context->queue, (WGPUBuffer)object->handle,
+                             p->buffer_offset, data,
+                             (size_t)record->data_size);
+      }
+    } break;
+    case WGPU_API_TRACE_RECORD_WRITE_TEXTURE: {
+      const wgpu_api_trace_write_texture_params_t* p = params;
+      if (object->type == WGPU_API_TRACE_RECORD_TEXTURE_CREATE) {
+        wgpuQueueWriteTexture(
+          wgpu_context->queue,
+          &(WGPUImageCopyTexture){
+            .texture  = (WGPUTexture)object->handle,
+            .mipLevel = p->mip_level,
+            .origin   = {p->x, p->y, p->z},
+            .aspect   = (WGPUTextureAspect)p->aspect,
+          },
+          data, (size_t)record->data_size,
+          &(WGPUTextureDataLayout){
+            .offset       = p->offset,
+            .bytesPerRow  = p->bytes_per_row,
+            .rowsPerImage = p->rows_per_image,
+          },
+          &(WGPUExtent3D){p->width, p->height, p->depth_or_array_layers});
+      }
+    } break;
+    case WGPU_API_TRACE_RECORD_SUBMIT: {
+      const wgpu_api_trace_submit_params_t* p = params;
+      replay_submit(replay, p->command_count, data, record->data_size);
+    } break;
+    default:
+      break;
+  }
+}
+
+static void replay_captured_frame(wgpu_api_trace_replay_t* replay,
+                                  uint32_t captured_frame)
+{
+  uint64_t offset    = replay->frame_offsets[captured_frame];
+  const uint64_t end = replay->frame_offsets[captured_frame + 1];
+  uint64_t next      = 0;
+  while (offset < end) {
+    const wgpu_api_trace_record_t* record = get_record(replay, offset, &next);
+    replay_record(replay, record);
+    offset = next;
+  }
+}
+
+wgpu_api_trace_replay_t*
+wgpu_api_trace_replay_create(wgpu_context_t* wgpu_context,
+                             const char* filename)
+{
+  wgpu_api_trace_replay_t* replay
+    = (wgpu_api_trace_replay_t*)malloc(sizeof(wgpu_api_trace_replay_t));
+  memset(replay, 0, sizeof(wgpu_api_trace_replay_t));
+  replay->wgpu_context = wgpu_context;
+
+  const wgpu_api_trace_header_t* header = NULL;
+  if (file_map(filename, &replay->mapping)
+      && replay->mapping.size >= sizeof(wgpu_api_trace_header_t)) {
+    header = (const wgpu_api_trace_header_t*)replay->mapping.data;
+  }
+  if (header == NULL || header->magic != WGPU_API_TRACE_MAGIC
+      || header->version != WGPU_API_TRACE_VERSION || !index_trace(replay)) {
+    log_error("Not an API trace with a complete frame: %s", filename);
+    wgpu_api_trace_replay_release(replay);
+    return NULL;
+  }
+  replay->objects
+    = calloc(replay->object_count, sizeof(wgpu_api_trace_object_t));
+  ASSERT(replay->objects != NULL);
+  create_stand_ins(replay);
+
+  /* The resources of the application, loaded before the first frame */
+  replay_captured_frame(replay, 0);
+  wgpu_wait_for_submitted_work(wgpu_context);
+
+  return replay;
+}
+
+void wgpu_api_trace_replay_release(wgpu_api_trace_replay_t* replay)
+{
+  if (replay == NULL) {
+    return;
+  }
+
+  if (replay->objects != NULL) {
+    for (uint32_t i = 0; i < replay->object_count; ++i) {
+      release_object(&replay->objects[i]);
+    }
+    free(replay->objects);
+  }
+  WGPU_RELEASE_RESOURCE(ComputePipeline, replay->stand_in.compute_pipeline);
+  WGPU_RELEASE_RESOURCE(RenderPipeline, replay->stand_in.render_pipeline);
+  WGPU_RELEASE_RESOURCE(Buffer, replay->stand_in.index_buffer);
+  WGPU_RELEASE_RESOURCE(TextureView, replay->stand_in.depth_view);
+  WGPU_RELEASE_RESOURCE(Texture, replay->stand_in.depth_texture);
+  free(replay->frame_offsets);
+  if (replay->mapping.data != NULL) {
+    file_unmap(&replay->mapping);
+  }
+  free(replay);
+}
+
+uint32_t wgpu_api_trace_replay_get_frame_count(wgpu_api_trace_replay_t* replay)
+{
+  return replay->captured_frame_count - 1u;
+}
+
+void wgpu_api_trace_replay_frame(wgpu_api_trace_replay_t* replay,
+                                 uint32_t frame_index)
+{
+  ASSERT(frame_index < wgpu_api_trace_replay_get_frame_count(replay));
+  replay_captured_frame(replay, frame_index + 1u);
+}
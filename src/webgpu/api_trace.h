@@ -0,0 +1,64 @@
+#ifndef API_TRACE_H
+#define API_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "context.h"
+
+/*
+ * API trace: a capture of the WebGPU calls of an application into a compact
+ * binary trace, and its replay without the application logic, e.g. to measure
+ * the cost of Dawn and of the driver for the frames of a heavy scene across
+ * driver updates. The capture hooks into the proc table like the memory
+ * tracker and records:
+ *   - the creation and the release of the buffers and the textures, from
+ *     their descriptors
+ *   - the buffer and texture writes of the queue, with their data
+ *   - the submits, with the passes and the draw and dispatch calls of their
+ *     command buffers
+ *   - the frame boundaries, see wgpu_api_trace_end_frame()
+ *
+ * The pipelines, the bind groups and the attachments of the passes are not
+ * captured: the passes are replayed with stand-in pipelines doing no fragment
+ * work, so the replay measures the submission and the vertex and compute
+ * dispatch cost of the frames rather than their shading. The commands of the
+ * render bundles and the copies are not captured. Resources created before
+ * the capture
+ * started are not known to the trace, their writes are dropped. The trace is
+ * written in the byte order of the capturing machine.
+ */
+
+/* Capture, global like the memory tracker. Starts before the device is
+ * created, returns false when the trace file cannot be created. */
+bool wgpu_api_trace_begin_capture(const char* filename);
+/* Closes the trace file, the resources still alive are not released in the
+ * trace */
+void wgpu_api_trace_end_capture(void);
+bool wgpu_api_trace_is_capturing(void);
+
+/* Marks the end of a frame in the trace, nothing without capture */
+void wgpu_api_trace_end_frame(void);
+
+/* Replay */
+typedef struct wgpu_api_trace_replay wgpu_api_trace_replay_t;
+
+/**
+ * @brief Loads a trace and replays its first frame, which includes the
+ * loading of the application, on the device of the context. Returns NULL when
+ * the file is no trace.
+ */
+wgpu_api_trace_replay_t*
+wgpu_api_trace_replay_create(wgpu_context_t* wgpu_context,
+                             const char* filename);
+void wgpu_api_trace_replay_release(wgpu_api_trace_replay_t* replay);
+
+/* Frames after the first one, which can be replayed in any order and any
+ * number of times */
+uint32_t wgpu_api_trace_replay_get_frame_count(wgpu_api_trace_replay_t* replay);
+
+/* Re-issues the calls of a frame, frame_index in [0, frame count) */
+void wgpu_api_trace_replay_frame(wgpu_api_trace_replay_t* replay,
+                                 uint32_t frame_index);
+
+#endif
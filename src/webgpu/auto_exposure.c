@@ -0,0 +1,461 @@
+#include "auto_exposure.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "pipeline_cache.h"
+#include "shader.h"
+
+#define AUTO_EXPOSURE_BIN_COUNT 256u
+/* Texels covered by a histogram workgroup of 16x16 invocations, 2x2 each */
+#define AUTO_EXPOSURE_TILE_SIZE 32u
+
+/* Layout of Params */
+typedef struct auto_exposure_params_t {
+  float min_log_luminance;
+  float log_luminance_range;
+  float low_percentile;
+  float high_percentile;
+  float key_value;
+  float speed_up;
+  float speed_down;
+  float delta_time;
+  uint32_t input_encoding;
+  uint32_t padding[3];
+} auto_exposure_params_t;
+
+struct wgpu_auto_exposure {
+  wgpu_context_t* wgpu_context;
+  auto_exposure_params_t params;
+  uint32_t width;
+  uint32_t height;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t histogram;
+  wgpu_buffer_t result;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+  WGPUComputePipeline histogram_pipeline;
+  WGPUComputePipeline reduce_pipeline;
+};
+
+// clang-format off
+static const char* auto_exposure_result_wgsl = CODE(
+  struct AutoExposure {
+    exposure : f32,
+    averageLuminance : f32,
+    targetLuminance : f32,
+    padding : f32,
+  };
+);
+
+static const char* auto_exposure_shader_wgsl = CODE(
+  struct Params {
+    minLogLuminance : f32,
+    logLuminanceRange : f32,
+    lowPercentile : f32,
+    highPercentile : f32,
+    keyValue : f32,
+    speedUp : f32,
+    speedDown : f32,
+    deltaTime : f32,
+    inputEncoding : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1)
+  var<storage, read_write> histogram : array<atomic<u32>, 256>;
+  @group(0) @binding(2) var<storage, read_write> result : AutoExposure;
+  @group(0) @binding(3) var colorTexture : texture_2d<f32>;
+
+  var<workgroup> localHistogram : array<atomic<u32>, 256>;
+  var<workgroup> prefixSums : array<u32, 256>;
+  var<workgroup> weightedSums : array<f32, 256>;
+
+  // Bin 0 holds the texels darker than the metered range
+  fn luminanceToBin(luminance : f32) -> u32 {
+    if (luminance <= 0.0) {
+      return 0u;
+    }
+    let logLuminance = log2(luminance);
+    if (logLuminance < params.minLogLuminance) {
+      return 0u;
+    }
+    let t = clamp((logLuminance - params.minLogLuminance)
+                  / params.logLuminanceRange, 0.0, 1.0);
+    return u32(t * 254.0) + 1u;
+  }
+
+  // The last 8 bit step stands for the saturated colors, which cannot be
+  // inverted
+  fn sceneColor(color : vec3<f32>) -> vec3<f32> {
+    if (params.inputEncoding == 1u) {
+      let c = min(color, vec3<f32>(254.5 / 255.0));
+      return -log(vec3<f32>(1.0) - c) / result.exposure;
+    }
+    return color;
+  }
+
+  @compute @workgroup_size(16, 16)
+  fn cs_histogram(@builtin(workgroup_id) group : vec3<u32>,
+                  @builtin(local_invocation_id) local : vec3<u32>,
+                  @builtin(local_invocation_index) index : u32) {
+    atomicStore(&localHistogram[index], 0u);
+    workgroupBarrier();
+
+    let size = textureDimensions(colorTexture);
+    let base = group.xy * 32u + local.xy * 2u;
+    for (var i = 0u; i < 4u; i = i + 1u) {
+      let pos = base + vec2<u32>(i & 1u, i >> 1u);
+      if (all(pos < size)) {
+        let texel = textureLoad(colorTexture, vec2<i32>(pos), 0);
+        let color = sceneColor(texel.rgb);
+        let luminance = dot(color, vec3<f32>(0.2126, 0.7152, 0.0722));
+        atomicAdd(&localHistogram[luminanceToBin(luminance)], 1u);
+      }
+    }
+    workgroupBarrier();
+
+    let count = atomicLoad(&localHistogram[index]);
+    if (count > 0u) {
+      atomicAdd(&histogram[index], count);
+    }
+  }
+
+  @compute @workgroup_size(256)
+  fn cs_reduce(@builtin(local_invocation_index) index : u32) {
+    // The histogram is cleared for the next frame
+    let count = select(atomicLoad(&histogram[index]), 0u, index == 0u);
+    atomicStore(&histogram[index], 0u);
+
+    // Inclusive prefix sum of the bin counts
+    prefixSums[index] = count;
+    workgroupBarrier();
+    for (var offset = 1u; offset < 256u; offset = offset * 2u) {
+      var sum = prefixSums[index];
+      if (index >= offset) {
+        sum = sum + prefixSums[index - offset];
+      }
+      workgroupBarrier();
+      prefixSums[index] = sum;
+      workgroupBarrier();
+    }
+
+    // Texels of the bin between the percentiles, weighted by its luminance
+    let total = f32(prefixSums[255]);
+    let low = total * params.lowPercentile;
+    let high = total * params.highPercentile;
+    let end = f32(prefixSums[index]);
+    let metered = max(min(end, high) - max(end - f32(count), low), 0.0);
+    let binLogLuminance = params.minLogLuminance
+                          + (f32(index) - 0.5) / 254.0
+                            * params.logLuminanceRange;
+    weightedSums[index] = metered * binLogLuminance;
+    workgroupBarrier();
+    for (var stride = 128u; stride > 0u; stride = stride / 2u) {
+      if (index < stride) {
+        weightedSums[index] = weightedSums[index]
+                              + weightedSums[index + stride];
+      }
+      workgroupBarrier();
+    }
+
+    // Without metered texels the exposure is kept
+    if (index != 0u || high <= low) {
+      return;
+    }
+    let targetLuminance = exp2(weightedSums[0] / (high - low));
+    let previous = result.averageLuminance;
+    let speed = select(params.speedDown, params.speedUp,
+                       targetLuminance > previous);
+    var adapted = targetLuminance;
+    if (previous > 0.0) {
+      adapted = previous + (targetLuminance - previous)
+                           * (1.0 - exp(-params.deltaTime * speed));
+    }
+    result.exposure = params.keyValue / adapted;
+    result.averageLuminance = adapted;
+    result.targetLuminance = targetLuminance;
+  }
+);
+// clang-format on
+
+static void
+auto_exposure_create_pipelines(wgpu_auto_exposure_t* auto_exposure)
+{
+  wgpu_context_t* wgpu_context = auto_exposure->wgpu_context;
+
+  WGPUBindGroupLayoutEntry bgl_entries[4] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(auto_exposure_params_t),
+      },
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Luminance histogram
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = AUTO_EXPOSURE_BIN_COUNT * sizeof(uint32_t),
+      },
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Exposure
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = sizeof(wgpu_auto_exposure_result_t),
+      },
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Metered color texture
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Compute,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_Float,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+    },
+  };
+  auto_exposure->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "auto_exposure_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(auto_exposure->bind_group_layout != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "auto_exposure_layout",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &auto_exposure->bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  // The AutoExposure struct is shared with the shaders reading the exposure
+  const size_t wgsl_size
+    = strlen(auto_exposure_result_wgsl) + strlen(auto_exposure_shader_wgsl) + 2;
+  char* wgsl = (char*)malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", auto_exposure_result_wgsl,
+           auto_exposure_shader_wgsl);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "auto_exposure_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "cs_histogram",
+                  });
+  free(wgsl);
+
+  WGPUProgrammableStageDescriptor stage
+    = comp_shader.programmable_stage_descriptor;
+  auto_exposure->histogram_pipeline = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context, &(WGPUComputePipelineDescriptor){
+                    .label   = "auto_exposure_histogram_pipeline",
+                    .layout  = pipeline_layout,
+                    .compute = stage,
+                  });
+  ASSERT(auto_exposure->histogram_pipeline != NULL);
+
+  stage.entryPoint               = "cs_reduce";
+  auto_exposure->reduce_pipeline = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context, &(WGPUComputePipelineDescriptor){
+                    .label   = "auto_exposure_reduce_pipeline",
+                    .layout  = pipeline_layout,
+                    .compute = stage,
+                  });
+  ASSERT(auto_exposure->reduce_pipeline != NULL);
+
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_auto_exposure_t*
+wgpu_auto_exposure_create(wgpu_context_t* wgpu_context,
+                          const wgpu_auto_exposure_desc_t* desc)
+{
+  wgpu_auto_exposure_t* auto_exposure
+    = (wgpu_auto_exposure_t*)malloc(sizeof(wgpu_auto_exposure_t));
+  memset(auto_exposure, 0, sizeof(wgpu_auto_exposure_t));
+  auto_exposure->wgpu_context = wgpu_context;
+
+  float min_log_luminance = desc->min_log_luminance;
+  float max_log_luminance = desc->max_log_luminance;
+  if (min_log_luminance == 0.0f && max_log_luminance == 0.0f) {
+    min_log_luminance = -8.0f;
+    max_log_luminance = 4.0f;
+  }
+  ASSERT(max_log_luminance > min_log_luminance);
+  float low_percentile  = desc->low_percentile;
+  float high_percentile = desc->high_percentile;
+  if (high_percentile == 0.0f) {
+    low_percentile  = 0.5f;
+    high_percentile = 0.95f;
+  }
+  auto_exposure->params = (auto_exposure_params_t){
+    .min_log_luminance   = min_log_luminance,
+    .log_luminance_range = max_log_luminance - min_log_luminance,
+    .low_percentile      = low_percentile,
+    .high_percentile     = high_percentile,
+    .key_value           = desc->key_value > 0.0f ? desc->key_value : 0.18f,
+    .speed_up            = desc->speed_up > 0.0f ? desc->speed_up : 3.0f,
+    .speed_down          = desc->speed_down > 0.0f ? desc->speed_down : 1.0f,
+    .input_encoding      = (uint32_t)desc->input,
+  };
+
+  auto_exposure->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "auto_exposure_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(auto_exposure_params_t),
+                  });
+  auto_exposure->histogram = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "auto_exposure_histogram_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = AUTO_EXPOSURE_BIN_COUNT * sizeof(uint32_t),
+                  });
+  // The adaptation starts at the first metered luminance
+  const wgpu_auto_exposure_result_t result = {
+    .exposure = 1.0f,
+  };
+  auto_exposure->result = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label        = "auto_exposure_result_buffer",
+      .usage        = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc
+               | WGPUBufferUsage_Storage,
+      .size         = sizeof(wgpu_auto_exposure_result_t),
+      .initial.data = &result,
+    });
+
+  auto_exposure_create_pipelines(auto_exposure);
+
+  return auto_exposure;
+}
+
+void wgpu_auto_exposure_release(wgpu_auto_exposure_t* auto_exposure)
+{
+  if (auto_exposure == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, auto_exposure->bind_group)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, auto_exposure->histogram_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, auto_exposure->reduce_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, auto_exposure->bind_group_layout)
+  wgpu_destroy_buffer(&auto_exposure->params_buffer);
+  wgpu_destroy_buffer(&auto_exposure->histogram);
+  wgpu_destroy_buffer(&auto_exposure->result);
+  free(auto_exposure);
+}
+
+void wgpu_auto_exposure_set_input(wgpu_auto_exposure_t* auto_exposure,
+                                  WGPUTextureView view, uint32_t width,
+                                  uint32_t height)
+{
+  auto_exposure->width  = width;
+  auto_exposure->height = height;
+
+  WGPU_RELEASE_RESOURCE(BindGroup, auto_exposure->bind_group)
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = auto_exposure->params_buffer.buffer,
+      .size    = auto_exposure->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = auto_exposure->histogram.buffer,
+      .size    = auto_exposure->histogram.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = auto_exposure->result.buffer,
+      .size    = auto_exposure->result.size,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding     = 3,
+      .textureView = view,
+    },
+  };
+  auto_exposure->bind_group = wgpuDeviceCreateBindGroup(
+    auto_exposure->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "auto_exposure_bind_group",
+      .layout     = auto_exposure->bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(auto_exposure->bind_group != NULL);
+}
+
+void wgpu_auto_exposure_set_key_value(wgpu_auto_exposure_t* auto_exposure,
+                                      float key_value)
+{
+  auto_exposure->params.key_value = key_value;
+}
+
+void wgpu_auto_exposure_reset(wgpu_auto_exposure_t* auto_exposure,
+                              float exposure)
+{
+  const wgpu_auto_exposure_result_t result = {
+    .exposure          = exposure,
+    .average_luminance = auto_exposure->params.key_value / exposure,
+    .target_luminance  = auto_exposure->params.key_value / exposure,
+  };
+  wgpu_queue_write_buffer(auto_exposure->wgpu_context,
+                          auto_exposure->result.buffer, 0, &result,
+                          sizeof(result));
+}
+
+void wgpu_auto_exposure_record(wgpu_auto_exposure_t* auto_exposure,
+                               WGPUComputePassEncoder pass_encoder,
+                               float delta_time)
+{
+  if (auto_exposure->bind_group == NULL) {
+    return;
+  }
+
+  auto_exposure->params.delta_time = delta_time;
+  wgpu_queue_write_buffer(auto_exposure->wgpu_context,
+                          auto_exposure->params_buffer.buffer, 0,
+                          &auto_exposure->params,
+                          sizeof(auto_exposure_params_t));
+
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0,
+                                     auto_exposure->bind_group, 0, NULL);
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    auto_exposure->histogram_pipeline);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    (auto_exposure->width + AUTO_EXPOSURE_TILE_SIZE - 1)
+      / AUTO_EXPOSURE_TILE_SIZE,
+    (auto_exposure->height + AUTO_EXPOSURE_TILE_SIZE - 1)
+      / AUTO_EXPOSURE_TILE_SIZE,
+    1);
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    auto_exposure->reduce_pipeline);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, 1, 1, 1);
+}
+
+const wgpu_buffer_t*
+wgpu_auto_exposure_get_buffer(wgpu_auto_exposure_t* auto_exposure)
+{
+  return &auto_exposure->result;
+}
+
+const char* wgpu_auto_exposure_get_wgsl(void)
+{
+  return auto_exposure_result_wgsl;
+}
@@ -0,0 +1,82 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include "buffer.h"
+#include "context.h"
+
+typedef struct wgpu_auto_exposure wgpu_auto_exposure_t;
+
+/* Encoding of the metered color texture */
+typedef enum wgpu_auto_exposure_input_enum_t {
+  /* Linear scene color, e.g. of a rgba16float target */
+  WGPU_AutoExposureInput_Linear = 0,
+  /* Color tone mapped as 1 - exp(-color * exposure) with the exposure of the
+   * previous frame, which the metering inverts */
+  WGPU_AutoExposureInput_ExponentialTonemap = 1,
+} wgpu_auto_exposure_input_enum_t;
+
+typedef struct wgpu_auto_exposure_desc_t {
+  wgpu_auto_exposure_input_enum_t input;
+  /* Metered luminance range in log2 units, both 0 select -8 to 4. Darker
+   * texels are not metered, brighter ones count as the brightest. */
+  float min_log_luminance;
+  float max_log_luminance;
+  /* Part of the histogram averaged, the darkest and brightest texels outside
+   * are ignored. The high percentile 0 selects 0.5 to 0.95. */
+  float low_percentile;
+  float high_percentile;
+  /* Luminance the average is exposed to, 0 selects 0.18 */
+  float key_value;
+  /* Adaptation rates per second to brighter and darker scenes, 0 selects 3
+   * and 1 */
+  float speed_up;
+  float speed_down;
+} wgpu_auto_exposure_desc_t;
+
+/* Layout of the exposure buffer */
+typedef struct wgpu_auto_exposure_result_t {
+  float exposure;
+  /* Adapted and current average luminance of the metered part */
+  float average_luminance;
+  float target_luminance;
+  float padding;
+} wgpu_auto_exposure_result_t;
+
+/*
+ * Histogram-based auto exposure on the GPU, without readback. A first pass
+ * bins the log luminance of the texels into a 256 bin histogram with workgroup
+ * shared atomics, each workgroup covering a 32x32 texel tile and adding its
+ * bins to the global histogram once. A single workgroup then averages the
+ * luminance between the percentiles, adapts it over time and writes the
+ * exposure in a storage buffer read by the tone mapping pass.
+ */
+wgpu_auto_exposure_t*
+wgpu_auto_exposure_create(wgpu_context_t* wgpu_context,
+                          const wgpu_auto_exposure_desc_t* desc);
+void wgpu_auto_exposure_release(wgpu_auto_exposure_t* auto_exposure);
+
+/* Sets the metered color texture, to be set again when it is recreated. The
+ * texture needs the TextureBinding usage with a float sample type. */
+void wgpu_auto_exposure_set_input(wgpu_auto_exposure_t* auto_exposure,
+                                  WGPUTextureView view, uint32_t width,
+                                  uint32_t height);
+void wgpu_auto_exposure_set_key_value(wgpu_auto_exposure_t* auto_exposure,
+                                      float key_value);
+/* Restarts the adaptation from the exposure, e.g. when switching from manual
+ * exposure */
+void wgpu_auto_exposure_reset(wgpu_auto_exposure_t* auto_exposure,
+                              float exposure);
+
+/* Records the metering and the adaptation by the time since the last frame */
+void wgpu_auto_exposure_record(wgpu_auto_exposure_t* auto_exposure,
+                               WGPUComputePassEncoder pass_encoder,
+                               float delta_time);
+
+/* Storage buffer of wgpu_auto_exposure_result_t, also usable as copy source */
+const wgpu_buffer_t*
+wgpu_auto_exposure_get_buffer(wgpu_auto_exposure_t* auto_exposure);
+
+/* WGSL declaration of the AutoExposure struct of the exposure buffer */
+const char* wgpu_auto_exposure_get_wgsl(void);
+
+#endif
@@ -0,0 +1,295 @@
+#include "bind_group_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+#include "render_bundle_cache.h"
+
+/* Bind group entry without the chain, cleared for memcmp */
+typedef struct wgpu_bind_group_key_entry_t {
+  uint64_t offset;
+  uint64_t size;
+  const void* buffer;
+  const void* sampler;
+  const void* texture_view;
+  uint32_t binding;
+  uint32_t padding;
+} wgpu_bind_group_key_entry_t;
+
+typedef struct wgpu_bind_group_cache_entry_t {
+  uint64_t hash;
+  WGPUBindGroupLayout layout;
+  wgpu_bind_group_key_entry_t* entries;
+  uint32_t entry_count;
+  WGPUBindGroup bind_group;
+} wgpu_bind_group_cache_entry_t;
+
+struct wgpu_bind_group_cache_t {
+  wgpu_bind_group_cache_entry_t* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  uint32_t hit_count;
+  uint32_t miss_count;
+  uint32_t invalidation_count;
+  /* Caches of all contexts, for wgpu_bind_group_cache_invalidate */
+  wgpu_bind_group_cache_t* next;
+};
+
+static wgpu_bind_group_cache_t* wgpu_bind_group_caches = NULL;
+
+/* 64-bit FNV-1a */
+static uint64_t wgpu_bind_group_cache_hash(uint64_t hash, const void* data,
+                                           size_t size)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static wgpu_bind_group_cache_t* wgpu_bind_group_cache_create(void)
+{
+  wgpu_bind_group_cache_t* bind_group_cache
+    = (wgpu_bind_group_cache_t*)malloc(sizeof(wgpu_bind_group_cache_t));
+  memset(bind_group_cache, 0, sizeof(wgpu_bind_group_cache_t));
+  bind_group_cache->next = wgpu_bind_group_caches;
+  wgpu_bind_group_caches = bind_group_cache;
+  return bind_group_cache;
+}
+
+static void
+wgpu_bind_group_cache_entry_release(wgpu_bind_group_cache_entry_t* entry)
+{
+  /* The render bundles using the bind group are released with it */
+  wgpu_render_bundle_cache_invalidate_object(entry->bind_group);
+  WGPU_RELEASE_RESOURCE(BindGroup, entry->bind_group)
+  free(entry->entries);
+  entry->entries = NULL;
+}
+
+void wgpu_bind_group_cache_destroy(wgpu_bind_group_cache_t* bind_group_cache)
+{
+  log_debug("Bind group cache: %u bind groups, %u hits, %u misses, %u "
+            "invalidated",
+            bind_group_cache->entry_count, bind_group_cache->hit_count,
+            bind_group_cache->miss_count, bind_group_cache->invalidation_count);
+  for (uint32_t i = 0; i < bind_group_cache->entry_count; ++i) {
+    wgpu_bind_group_cache_entry_release(&bind_group_cache->entries[i]);
+  }
+  free(bind_group_cache->entries);
+
+  wgpu_bind_group_cache_t** link = &wgpu_bind_group_caches;
+  while (*link != NULL && *link != bind_group_cache) {
+    link = &(*link)->next;
+  }
+  if (*link != NULL) {
+    *link = bind_group_cache->next;
+  }
+  free(bind_group_cache);
+}
+
+/* Fills the key entries, false when the descriptor has chained structs */
+static bool wgpu_bind_group_key_init(wgpu_bind_group_key_entry_t* key_entries,
+                                     WGPUBindGroupDescriptor const* desc)
+{
+  if (desc->nextInChain != NULL) {
+    return false;
+  }
+  memset(key_entries, 0, desc->entryCount * sizeof(*key_entries));
+  for (uint32_t i = 0; i < desc->entryCount; ++i) {
+    const WGPUBindGroupEntry* entry = &desc->entries[i];
+    if (entry->nextInChain != NULL) {
+      return false;
+    }
+    key_entries[i].binding      = entry->binding;
+    key_entries[i].buffer       = entry->buffer;
+    key_entries[i].offset       = entry->buffer != NULL ? entry->offset : 0;
+    key_entries[i].size         = entry->buffer != NULL ? entry->size : 0;
+    key_entries[i].sampler      = entry->sampler;
+    key_entries[i].texture_view = entry->textureView;
+  }
+  return true;
+}
+
+static wgpu_bind_group_cache_t*
+wgpu_get_bind_group_cache(wgpu_context_t* wgpu_context)
+{
+  if (wgpu_context->bind_group_cache == NULL) {
+    wgpu_context->bind_group_cache = wgpu_bind_group_cache_create();
+  }
+  return wgpu_context->bind_group_cache;
+}
+
+/* Returns the entry of the key, NULL on a miss */
+static wgpu_bind_group_cache_entry_t*
+wgpu_bind_group_cache_find(wgpu_bind_group_cache_t* bind_group_cache,
+                           WGPUBindGroupLayout layout,
+                           const wgpu_bind_group_key_entry_t* key_entries,
+                           uint32_t entry_count, uint64_t hash)
+{
+  for (uint32_t i = 0; i < bind_group_cache->entry_count; ++i) {
+    wgpu_bind_group_cache_entry_t* entry = &bind_group_cache->entries[i];
+    if (entry->hash == hash && entry->layout == layout
+        && entry->entry_count == entry_count
+        && memcmp(entry->entries, key_entries,
+                  entry_count * sizeof(*key_entries))
+             == 0) {
+      ++bind_group_cache->hit_count;
+      return entry;
+    }
+  }
+  ++bind_group_cache->miss_count;
+  return NULL;
+}
+
+/* Appends an entry, the key entries are moved to the entry */
+static void
+wgpu_bind_group_cache_insert(wgpu_bind_group_cache_t* bind_group_cache,
+                             const wgpu_bind_group_cache_entry_t* entry)
+{
+  if (bind_group_cache->entry_count == bind_group_cache->entry_capacity) {
+    uint32_t capacity = MAX(bind_group_cache->entry_capacity * 2, 16u);
+    wgpu_bind_group_cache_entry_t* entries
+      = (wgpu_bind_group_cache_entry_t*)realloc(
+        bind_group_cache->entries,
+        capacity * sizeof(wgpu_bind_group_cache_entry_t));
+    ASSERT(entries != NULL);
+    bind_group_cache->entries        = entries;
+    bind_group_cache->entry_capacity = capacity;
+  }
+  bind_group_cache->entries[bind_group_cache->entry_count++] = *entry;
+}
+
+WGPUBindGroup
+wgpu_bind_group_cache_get_bind_group(wgpu_context_t* wgpu_context,
+                                     WGPUBindGroupDescriptor const* desc)
+{
+  wgpu_bind_group_key_entry_t* key_entries
+    = (wgpu_bind_group_key_entry_t*)malloc(
+      MAX(desc->entryCount, 1u) * sizeof(wgpu_bind_group_key_entry_t));
+  if (!wgpu_bind_group_key_init(key_entries, desc)) {
+    free(key_entries);
+    return wgpuDeviceCreateBindGroup(wgpu_context->device, desc);
+  }
+
+  wgpu_bind_group_cache_t* bind_group_cache
+    = wgpu_get_bind_group_cache(wgpu_context);
+  uint64_t hash = wgpu_bind_group_cache_hash(
+    0xcbf29ce484222325ull, &desc->layout, sizeof(desc->layout));
+  hash = wgpu_bind_group_cache_hash(hash, key_entries,
+                                    desc->entryCount * sizeof(*key_entries));
+  wgpu_bind_group_cache_entry_t* entry = wgpu_bind_group_cache_find(
+    bind_group_cache, desc->layout, key_entries, desc->entryCount, hash);
+  if (entry != NULL) {
+    free(key_entries);
+    wgpuBindGroupReference(entry->bind_group);
+    return entry->bind_group;
+  }
+
+  WGPUBindGroup bind_group
+    = wgpuDeviceCreateBindGroup(wgpu_context->device, desc);
+  if (bind_group == NULL) {
+    free(key_entries);
+    return NULL;
+  }
+  wgpu_bind_group_cache_insert(bind_group_cache,
+                               &(wgpu_bind_group_cache_entry_t){
+                                 .hash        = hash,
+                                 .layout      = desc->layout,
+                                 .entries     = key_entries,
+                                 .entry_count = desc->entryCount,
+                                 .bind_group  = bind_group,
+                               });
+
+  /* One reference for the cache, one for the caller */
+  wgpuBindGroupReference(bind_group);
+  return bind_group;
+}
+
+static bool
+wgpu_bind_group_cache_entry_binds(const wgpu_bind_group_cache_entry_t* entry,
+                                  const void* resource)
+{
+  for (uint32_t i = 0; i < entry->entry_count; ++i) {
+    const wgpu_bind_group_key_entry_t* key_entry = &entry->entries[i];
+    if (key_entry->buffer == resource || key_entry->sampler == resource
+        || key_entry->texture_view == resource) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* True when the entry binds a range of the buffer overlapping [begin, end),
+ * whole size bindings extend to the end of the buffer */
+static bool wgpu_bind_group_cache_entry_binds_range(
+  const wgpu_bind_group_cache_entry_t* entry, const void* buffer,
+  uint64_t begin, uint64_t end)
+{
+  for (uint32_t i = 0; i < entry->entry_count; ++i) {
+    const wgpu_bind_group_key_entry_t* key_entry = &entry->entries[i];
+    if (key_entry->buffer != buffer) {
+      continue;
+    }
+    const uint64_t entry_end
+      = (key_entry->size == 0 || key_entry->size == WGPU_WHOLE_SIZE) ?
+          UINT64_MAX :
+          key_entry->offset + key_entry->size;
+    if (key_entry->offset < end && begin < entry_end) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Releases the entries binding the resource, within [begin, end) for buffers
+ * bound with an offset */
+static void wgpu_bind_group_cache_invalidate_range(const void* resource,
+                                                   uint64_t begin,
+                                                   uint64_t end)
+{
+  if (resource == NULL) {
+    return;
+  }
+
+  const bool whole_resource = begin == 0 && end == UINT64_MAX;
+  if (whole_resource) {
+    wgpu_render_bundle_cache_invalidate_object(resource);
+  }
+  for (wgpu_bind_group_cache_t* bind_group_cache = wgpu_bind_group_caches;
+       bind_group_cache != NULL; bind_group_cache = bind_group_cache->next) {
+    for (uint32_t i = 0; i < bind_group_cache->entry_count;) {
+      wgpu_bind_group_cache_entry_t* entry = &bind_group_cache->entries[i];
+      const bool binds
+        = whole_resource ?
+            wgpu_bind_group_cache_entry_binds(entry, resource) :
+            wgpu_bind_group_cache_entry_binds_range(entry, resource, begin,
+                                                    end);
+      if (!binds) {
+        ++i;
+        continue;
+      }
+      // The order of the entries doesn't matter, the last one fills the gap
+      wgpu_bind_group_cache_entry_release(entry);
+      *entry = bind_group_cache->entries[--bind_group_cache->entry_count];
+      ++bind_group_cache->invalidation_count;
+    }
+  }
+}
+
+void wgpu_bind_group_cache_invalidate(const void* resource)
+{
+  wgpu_bind_group_cache_invalidate_range(resource, 0, UINT64_MAX);
+}
+
+void wgpu_bind_group_cache_invalidate_buffer_range(WGPUBuffer buffer,
+                                                   uint64_t offset,
+                                                   uint64_t size)
+{
+  wgpu_bind_group_cache_invalidate_range(buffer, offset, offset + size);
+}
@@ -0,0 +1,41 @@
+#ifndef BIND_GROUP_CACHE_H
+#define BIND_GROUP_CACHE_H
+
+#include "context.h"
+
+/**
+ * Bind group cache: bind groups are shared per context, keyed by their layout
+ * and the bound resources (binding, buffer with offset and size, sampler,
+ * texture view) except for the label. Passes that built the same bind group
+ * every frame or after every resize get it from the cache instead, without
+ * validating and allocating it again.
+ *
+ * A cached bind group keeps its resources alive, entries are released when one
+ * of their resources is invalidated. wgpu_destroy_buffer and
+ * wgpu_destroy_texture invalidate the resources they release, resources
+ * released directly have to be invalidated by their owner, otherwise they stay
+ * alive until the context is released. The render bundles using the released
+ * bind groups are released as well. Descriptors with chained structs are
+ * not cached. Every returned bind group holds its own reference and must be
+ * released by the caller as before.
+ */
+typedef struct wgpu_bind_group_cache_t wgpu_bind_group_cache_t;
+void wgpu_bind_group_cache_destroy(wgpu_bind_group_cache_t* bind_group_cache);
+
+/* Returns the bind group of the descriptor, creating it on first use */
+WGPUBindGroup
+wgpu_bind_group_cache_get_bind_group(wgpu_context_t* wgpu_context,
+                                     WGPUBindGroupDescriptor const* desc);
+
+/* Releases the cached bind groups binding the buffer, sampler or texture view,
+ * of all contexts. To be called before the resource is released. */
+void wgpu_bind_group_cache_invalidate(const void* resource);
+
+/* Releases the cached bind groups binding a range of the buffer overlapping
+ * [offset, offset + size), e.g. a pooled slice sharing its backing buffer with
+ * other slices that stay alive */
+void wgpu_bind_group_cache_invalidate_buffer_range(WGPUBuffer buffer,
+                                                   uint64_t offset,
+                                                   uint64_t size);
+
+#endif
@@ -0,0 +1,504 @@
+#include "blur.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "buffer.h"
+#include "pipeline_cache.h"
+#include "shader.h"
+
+/* Bounds of the tile width, the tile plus the apron of the largest radius
+ * has to fit into the workgroup memory */
+#define BLUR_MIN_TILE_SIZE 64u
+#define BLUR_MAX_TILE_SIZE 1024u
+
+#define BLUR_WEIGHT_VEC4_COUNT ((WGPU_BLUR_MAX_RADIUS + 4) / 4)
+#define BLUR_TAP_COUNT ((WGPU_BLUR_FOLDED_MAX_RADIUS + 1) / 2)
+
+/* Layout of BlurParams */
+typedef struct blur_params_t {
+  uint32_t radius;
+  uint32_t vertical;
+  uint32_t tap_count;
+  uint32_t padding;
+  float weights[BLUR_WEIGHT_VEC4_COUNT * 4];
+  float taps[BLUR_TAP_COUNT][4]; /* offset, weight */
+} blur_params_t;
+
+struct wgpu_blur {
+  wgpu_context_t* wgpu_context;
+  WGPUTextureFormat format;
+  uint32_t tile_size;
+  uint32_t radius;
+  /* Horizontal and vertical parameters, selected with a dynamic offset */
+  wgpu_buffer_t params_buffer;
+  uint32_t params_stride;
+  WGPUSampler sampler;
+  WGPUBindGroupLayout params_bind_group_layout;
+  WGPUBindGroupLayout textures_bind_group_layout;
+  WGPUBindGroup params_bind_group;
+  WGPUComputePipeline tiled_pipeline;
+  WGPUComputePipeline folded_pipeline;
+};
+
+// clang-format off
+static const char* blur_shader_wgsl = CODE(
+  struct BlurParams {
+    radius : u32,
+    vertical : u32,
+    tapCount : u32,
+    padding : u32,
+    weights : array<vec4<f32>, %u>,
+    taps : array<vec4<f32>, %u>,
+  };
+
+  @group(0) @binding(0) var<uniform> params : BlurParams;
+  @group(1) @binding(0) var srcTexture : texture_2d<f32>;
+  @group(1) @binding(1) var dstTexture : texture_storage_2d<%s, write>;
+  @group(1) @binding(2) var srcSampler : sampler;
+
+  // Specialized per device, the tile capacity adds the apron of the largest
+  // radius to the tile
+  override tileSize : i32 = 64;
+  override tileCapacity : i32 = 128;
+
+  var<workgroup> tile : array<vec4<f32>, tileCapacity>;
+
+  fn weight(i : u32) -> f32 {
+    return params.weights[i >> 2u][i & 3u];
+  }
+
+  // Positions of a pass run along the blur axis in x, the vertical pass
+  // swaps the coordinates of the image
+  fn toImage(p : vec2<i32>) -> vec2<i32> {
+    if (params.vertical != 0u) {
+      return p.yx;
+    }
+    return p;
+  }
+
+  fn passSize() -> vec2<i32> {
+    let size = vec2<i32>(textureDimensions(srcTexture));
+    if (params.vertical != 0u) {
+      return size.yx;
+    }
+    return size;
+  }
+
+  @compute @workgroup_size(tileSize)
+  fn main_tiled(@builtin(workgroup_id) groupId : vec3<u32>,
+                @builtin(local_invocation_id) localId : vec3<u32>) {
+    let size = passSize();
+    let radius = i32(params.radius);
+    let row = i32(groupId.y);
+    let tileStart = i32(groupId.x) * tileSize;
+
+    // Every texel of the tile and its apron is loaded once
+    for (var i = i32(localId.x); i < tileSize + 2 * radius;
+         i = i + tileSize) {
+      let x = clamp(tileStart - radius + i, 0, size.x - 1);
+      tile[i] = textureLoad(srcTexture, toImage(vec2<i32>(x, row)), 0);
+    }
+    workgroupBarrier();
+
+    let x = tileStart + i32(localId.x);
+    if (x >= size.x) {
+      return;
+    }
+    let center = i32(localId.x) + radius;
+    var color = tile[center] * weight(0u);
+    for (var i = 1; i <= radius; i = i + 1) {
+      color = color + (tile[center - i] + tile[center + i]) * weight(u32(i));
+    }
+    textureStore(dstTexture, toImage(vec2<i32>(x, row)), color);
+  }
+
+  // A linear sample between two texels at the offset weighted by their
+  // weights returns their weighted sum, one fetch per pair of weights
+  @compute @workgroup_size(tileSize)
+  fn main_folded(@builtin(global_invocation_id) id : vec3<u32>) {
+    let size = passSize();
+    let p = vec2<i32>(id.xy);
+    if (p.x >= size.x) {
+      return;
+    }
+    let texelSize = 1.0 / vec2<f32>(textureDimensions(srcTexture));
+    let axis = vec2<f32>(toImage(vec2<i32>(1, 0))) * texelSize;
+    let uv = (vec2<f32>(toImage(p)) + vec2<f32>(0.5)) * texelSize;
+    var color = textureSampleLevel(srcTexture, srcSampler, uv, 0.0)
+                * weight(0u);
+    for (var i = 0u; i < params.tapCount; i = i + 1u) {
+      let offset = axis * params.taps[i].x;
+      color = color
+              + (textureSampleLevel(srcTexture, srcSampler, uv - offset, 0.0)
+                 + textureSampleLevel(srcTexture, srcSampler, uv + offset, 0.0))
+                  * params.taps[i].y;
+    }
+    textureStore(dstTexture, toImage(p), color);
+  }
+);
+// clang-format on
+
+static const char* blur_get_wgsl_format(WGPUTextureFormat format)
+{
+  switch (format) {
+    case WGPUTextureFormat_RGBA8Unorm:
+      return "rgba8unorm";
+    case WGPUTextureFormat_RGBA16Float:
+      return "rgba16float";
+    case WGPUTextureFormat_RGBA32Float:
+      return "rgba32float";
+    case WGPUTextureFormat_R32Float:
+      return "r32float";
+    default:
+      log_error("Unsupported blur storage texture format: %d", format);
+      return NULL;
+  }
+}
+
+/* Widest power of two tile the workgroup limits of the device allow, wider
+ * tiles spend a smaller share of their loads on the apron */
+static uint32_t blur_select_tile_size(wgpu_context_t* wgpu_context)
+{
+  WGPUSupportedLimits supported = {0};
+  if (!wgpuDeviceGetLimits(wgpu_context->device, &supported)) {
+    return BLUR_MIN_TILE_SIZE;
+  }
+
+  const WGPULimits* limits = &supported.limits;
+  uint32_t tile_size       = BLUR_MAX_TILE_SIZE;
+  while (tile_size > BLUR_MIN_TILE_SIZE
+         && (tile_size > limits->maxComputeInvocationsPerWorkgroup
+             || tile_size > limits->maxComputeWorkgroupSizeX
+             || (tile_size + 2 * WGPU_BLUR_MAX_RADIUS) * 4 * sizeof(float)
+                  > limits->maxComputeWorkgroupStorageSize)) {
+    tile_size /= 2;
+  }
+  return tile_size;
+}
+
+static void blur_create_bind_group_layouts(wgpu_blur_t* blur)
+{
+  wgpu_context_t* wgpu_context = blur->wgpu_context;
+
+  // Parameters
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Blur parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(blur_params_t),
+        },
+        .sampler = {0},
+      },
+    };
+    blur->params_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "blur_params_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(blur->params_bind_group_layout != NULL);
+  }
+
+  // Textures
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Source texture
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_Float,
+          .viewDimension = WGPUTextureViewDimension_2D,
+          .multisampled  = false,
+        },
+        .storageTexture = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Destination texture
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Compute,
+        .storageTexture = (WGPUStorageTextureBindingLayout) {
+          .access        = WGPUStorageTextureAccess_WriteOnly,
+          .format        = blur->format,
+          .viewDimension = WGPUTextureViewDimension_2D,
+        },
+        .texture = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Linear sampler of the folded taps
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Compute,
+        .sampler = (WGPUSamplerBindingLayout) {
+          .type = WGPUSamplerBindingType_Filtering,
+        },
+        .texture = {0},
+      },
+    };
+    blur->textures_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "blur_textures_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(blur->textures_bind_group_layout != NULL);
+  }
+}
+
+static void blur_create_pipelines(wgpu_blur_t* blur)
+{
+  wgpu_context_t* wgpu_context = blur->wgpu_context;
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    blur->params_bind_group_layout,   /* Group 0 */
+    blur->textures_bind_group_layout, /* Group 1 */
+  };
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "blur_pipeline_layout",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(pipeline_layout != NULL);
+
+  // The array sizes and the storage format are baked into the source, the
+  // tile width is specialized with override constants
+  const char* wgsl_format = blur_get_wgsl_format(blur->format);
+  ASSERT(wgsl_format != NULL);
+  const size_t wgsl_size = strlen(blur_shader_wgsl) + 64;
+  char* wgsl             = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, blur_shader_wgsl, BLUR_WEIGHT_VEC4_COUNT,
+           BLUR_TAP_COUNT, wgsl_format);
+  WGPUConstantEntry constants[2] = {
+    [0] = (WGPUConstantEntry){
+      .key   = "tileSize",
+      .value = (double)blur->tile_size,
+    },
+    [1] = (WGPUConstantEntry){
+      .key   = "tileCapacity",
+      .value = (double)(blur->tile_size + 2 * WGPU_BLUR_MAX_RADIUS),
+    },
+  };
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "blur_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main_tiled",
+                    .constant_count   = (uint32_t)ARRAY_SIZE(constants),
+                    .constants        = constants,
+                  });
+  blur->tiled_pipeline = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "blur_tiled_pipeline",
+      .layout  = pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(blur->tiled_pipeline != NULL);
+
+  WGPUProgrammableStageDescriptor folded_stage
+    = comp_shader.programmable_stage_descriptor;
+  // The folded entry point does not use the tile memory
+  folded_stage.entryPoint    = "main_folded";
+  folded_stage.constantCount = 1;
+  blur->folded_pipeline      = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context, &(WGPUComputePipelineDescriptor){
+                         .label   = "blur_folded_pipeline",
+                         .layout  = pipeline_layout,
+                         .compute = folded_stage,
+                       });
+  ASSERT(blur->folded_pipeline != NULL);
+
+  wgpu_shader_release(&comp_shader);
+  free(wgsl);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_blur_t* wgpu_blur_create(wgpu_context_t* wgpu_context,
+                              const wgpu_blur_desc_t* desc)
+{
+  wgpu_blur_t* blur = (wgpu_blur_t*)malloc(sizeof(wgpu_blur_t));
+  memset(blur, 0, sizeof(wgpu_blur_t));
+  blur->wgpu_context = wgpu_context;
+  blur->format       = desc->format != WGPUTextureFormat_Undefined ?
+                         desc->format :
+                         WGPUTextureFormat_RGBA8Unorm;
+  blur->tile_size    = blur_select_tile_size(wgpu_context);
+
+  // Parameter blocks are aligned to the uniform buffer offset alignment
+  blur->params_stride = (uint32_t)((sizeof(blur_params_t) + 255) & ~255);
+  blur->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "blur_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = 2 * blur->params_stride,
+                  });
+
+  blur->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "blur_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(blur->sampler != NULL);
+
+  blur_create_bind_group_layouts(blur);
+  blur_create_pipelines(blur);
+
+  WGPUBindGroupEntry bg_entries[1] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = blur->params_buffer.buffer,
+      .size    = sizeof(blur_params_t),
+    },
+  };
+  blur->params_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "blur_params_bind_group",
+                            .layout     = blur->params_bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(blur->params_bind_group != NULL);
+
+  wgpu_blur_set_filter(blur, desc->filter, desc->radius);
+
+  return blur;
+}
+
+void wgpu_blur_release(wgpu_blur_t* blur)
+{
+  if (blur == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(ComputePipeline, blur->folded_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, blur->tiled_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, blur->params_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, blur->textures_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, blur->params_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(Sampler, blur->sampler)
+  wgpu_destroy_buffer(&blur->params_buffer);
+  free(blur);
+}
+
+void wgpu_blur_set_filter(wgpu_blur_t* blur, wgpu_blur_filter_t filter,
+                          uint32_t radius)
+{
+  ASSERT(radius <= WGPU_BLUR_MAX_RADIUS);
+
+  blur_params_t params = {
+    .radius = radius,
+  };
+
+  // Weights of the center and one side, normalized over both sides
+  float sum = 0.0f;
+  for (uint32_t i = 0; i <= radius; ++i) {
+    float weight = 1.0f;
+    if (filter == WGPU_BLUR_FILTER_GAUSSIAN && radius > 0) {
+      const float sigma = radius / 3.0f;
+      weight            = expf(-0.5f * (i * i) / (sigma * sigma));
+    }
+    params.weights[i] = weight;
+    sum += i == 0 ? weight : 2.0f * weight;
+  }
+  for (uint32_t i = 0; i <= radius; ++i) {
+    params.weights[i] /= sum;
+  }
+
+  // Neighbouring side weights folded into one linear tap
+  if (radius <= WGPU_BLUR_FOLDED_MAX_RADIUS) {
+    for (uint32_t i = 1; i <= radius; i += 2) {
+      const float w0 = params.weights[i];
+      const float w1 = i + 1 <= radius ? params.weights[i + 1] : 0.0f;
+      float* tap     = params.taps[params.tap_count++];
+      tap[0]         = (i * w0 + (i + 1) * w1) / (w0 + w1);
+      tap[1]         = w0 + w1;
+    }
+  }
+
+  wgpu_context_t* wgpu_context = blur->wgpu_context;
+  for (uint32_t i = 0; i < 2; ++i) {
+    params.vertical = i;
+    wgpuQueueWriteBuffer(wgpu_context->queue, blur->params_buffer.buffer,
+                         i * blur->params_stride, &params, sizeof(params));
+  }
+  blur->radius = radius;
+}
+
+WGPUBindGroup wgpu_blur_create_bind_group(wgpu_blur_t* blur,
+                                          WGPUTextureView src_view,
+                                          WGPUTextureView dst_view)
+{
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding     = 0,
+      .textureView = src_view,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = dst_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .sampler = blur->sampler,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    blur->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "blur_textures_bind_group",
+      .layout     = blur->textures_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(bind_group != NULL);
+  return bind_group;
+}
+
+void wgpu_blur_dispatch(wgpu_blur_t* blur, WGPUComputePassEncoder pass_encoder,
+                        WGPUBindGroup bind_group, bool vertical,
+                        uint32_t width, uint32_t height)
+{
+  const uint32_t dynamic_offset = vertical ? blur->params_stride : 0;
+  const uint32_t length         = vertical ? height : width;
+  const uint32_t rows           = vertical ? width : height;
+
+  wgpuComputePassEncoderSetPipeline(
+    pass_encoder, blur->radius <= WGPU_BLUR_FOLDED_MAX_RADIUS ?
+                    blur->folded_pipeline :
+                    blur->tiled_pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, blur->params_bind_group,
+                                     1, &dynamic_offset);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder, (length + blur->tile_size - 1) / blur->tile_size, rows, 1);
+}
+
+void wgpu_blur_record(wgpu_blur_t* blur, WGPUComputePassEncoder pass_encoder,
+                      WGPUBindGroup horizontal_bind_group,
+                      WGPUBindGroup vertical_bind_group, uint32_t width,
+                      uint32_t height)
+{
+  wgpu_blur_dispatch(blur, pass_encoder, horizontal_bind_group, false, width,
+                     height);
+  wgpu_blur_dispatch(blur, pass_encoder, vertical_bind_group, true, width,
+                     height);
+}
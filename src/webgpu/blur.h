@@ -0,0 +1,69 @@
+#ifndef BLUR_H
+#define BLUR_H
+
+#include "context.h"
+
+/* Largest supported blur radius in texels */
+#define WGPU_BLUR_MAX_RADIUS 64u
+
+/* Radii up to this one are blurred with folded bilinear taps */
+#define WGPU_BLUR_FOLDED_MAX_RADIUS 8u
+
+typedef enum wgpu_blur_filter_t {
+  WGPU_BLUR_FILTER_GAUSSIAN = 0,
+  WGPU_BLUR_FILTER_BOX      = 1,
+} wgpu_blur_filter_t;
+
+/*
+ * Separable blur compute kernel: a horizontal and a vertical pass over 2D
+ * textures with one pipeline, the vertical pass swaps the coordinates so that
+ * both directions run through the same code path.
+ *
+ * Radii above WGPU_BLUR_FOLDED_MAX_RADIUS load a row tile plus its apron into
+ * workgroup memory once and filter from there. Smaller radii skip the tile and
+ * its barrier, they sample the source with a linear sampler at the weighted
+ * position between two texels, so that every tap fetches two weights at once.
+ * The tile width is picked from the workgroup limits of the device.
+ */
+typedef struct wgpu_blur wgpu_blur_t;
+
+typedef struct wgpu_blur_desc_t {
+  /* Format of the storage textures written by the passes, Undefined selects
+   * RGBA8Unorm */
+  WGPUTextureFormat format;
+  wgpu_blur_filter_t filter;
+  /* Blur radius up to WGPU_BLUR_MAX_RADIUS */
+  uint32_t radius;
+} wgpu_blur_desc_t;
+
+/* Blur creating/releasing */
+wgpu_blur_t* wgpu_blur_create(wgpu_context_t* wgpu_context,
+                              const wgpu_blur_desc_t* desc);
+void wgpu_blur_release(wgpu_blur_t* blur);
+
+/* Writes the weights of the filter */
+void wgpu_blur_set_filter(wgpu_blur_t* blur, wgpu_blur_filter_t filter,
+                          uint32_t radius);
+
+/**
+ * @brief Creates the bind group of a pass reading src_view, a filterable 2D
+ * texture, and writing dst_view, a storage texture of the format of the blur
+ * with the same size. Released by the caller.
+ */
+WGPUBindGroup wgpu_blur_create_bind_group(wgpu_blur_t* blur,
+                                          WGPUTextureView src_view,
+                                          WGPUTextureView dst_view);
+
+/* Records one pass over a width x height texture */
+void wgpu_blur_dispatch(wgpu_blur_t* blur, WGPUComputePassEncoder pass_encoder,
+                        WGPUBindGroup bind_group, bool vertical,
+                        uint32_t width, uint32_t height);
+
+/* Records the horizontal pass from the source into the intermediate texture
+ * followed by the vertical pass into the destination */
+void wgpu_blur_record(wgpu_blur_t* blur, WGPUComputePassEncoder pass_encoder,
+                      WGPUBindGroup horizontal_bind_group,
+                      WGPUBindGroup vertical_bind_group, uint32_t width,
+                      uint32_t height);
+
+#endif
@@ -1,9 +1,12 @@
 #include "buffer.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "../core/job_system.h"
 #include "../core/macro.h"
 
+#include "bind_group_cache.h"
 #include "context.h"
 
 wgpu_buffer_t wgpu_create_buffer(struct wgpu_context_t* wgpu_context,
@@ -47,24 +50,82 @@ wgpu_buffer_t wgpu_create_buffer(struct wgpu_context_t* wgpu_context,
   return wgpu_buffer;
 }
 
+typedef struct wgpu_buffer_fill_job_t {
+  const wgpu_buffer_fill_desc_t* fill;
+  void* mapping;
+} wgpu_buffer_fill_job_t;
+
+static void wgpu_buffer_fill_range(void* user_data, uint32_t begin,
+                                   uint32_t end)
+{
+  wgpu_buffer_fill_job_t* job = (wgpu_buffer_fill_job_t*)user_data;
+  job->fill->func(job->fill->user_data, job->mapping, begin, end);
+}
+
+wgpu_buffer_t
+wgpu_create_buffer_with_fill(struct wgpu_context_t* wgpu_context,
+                             const wgpu_buffer_desc_t* desc,
+                             const wgpu_buffer_fill_desc_t* fill)
+{
+  ASSERT(fill->func != NULL);
+
+  /* Ensure that buffer size is a multiple of 4 */
+  const uint32_t size = (desc->size + 3) & ~3;
+
+  wgpu_buffer_t wgpu_buffer = {
+    .usage = desc->usage,
+    .size  = size,
+    .count = desc->count,
+  };
+  wgpu_buffer.buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device, &(WGPUBufferDescriptor){
+                            .label            = desc->label,
+                            .usage            = desc->usage,
+                            .size             = size,
+                            .mappedAtCreation = true,
+                          });
+  ASSERT(wgpu_buffer.buffer != NULL);
+  void* mapping = wgpuBufferGetMappedRange(wgpu_buffer.buffer, 0, size);
+  ASSERT(mapping != NULL);
+
+  const uint32_t element_count
+    = (fill->element_count == 0) ? desc->count : fill->element_count;
+  if (fill->parallel && element_count > 1) {
+    wgpu_buffer_fill_job_t job = {
+      .fill    = fill,
+      .mapping = mapping,
+    };
+    job_system_parallel_for(job_system_get_shared(), element_count, 0,
+                            wgpu_buffer_fill_range, &job);
+  }
+  else if (element_count > 0) {
+    fill->func(fill->user_data, mapping, 0, element_count);
+  }
+  wgpuBufferUnmap(wgpu_buffer.buffer);
+
+  return wgpu_buffer;
+}
+
 void wgpu_destroy_buffer(wgpu_buffer_t* buffer)
 {
   ASSERT(buffer->buffer);
+  /* Pooled slices share their backing buffer, only the bind groups of the
+   * slice are released. Buffers wrapped without size are released whole. */
+  if (buffer->size > 0) {
+    wgpu_bind_group_cache_invalidate_buffer_range(
+      buffer->buffer, buffer->offset, buffer->size);
+  }
+  else {
+    wgpu_bind_group_cache_invalidate(buffer->buffer);
+  }
   WGPU_RELEASE_RESOURCE(Buffer, buffer->buffer)
 }
 
-void wgpu_record_copy_data_to_buffer(struct wgpu_context_t* wgpu_context,
-                                     wgpu_buffer_t* buff, uint32_t buff_offset,
-                                     uint32_t buff_size, const void* data,
-                                     uint32_t data_size)
+static void wgpu_record_copy_data_via_temporary_staging_buffer(
+  struct wgpu_context_t* wgpu_context, wgpu_buffer_t* buff,
+  uint32_t buff_offset, uint32_t buff_size, const void* data,
+  uint32_t data_size)
 {
-  ASSERT(wgpu_context->cmd_enc != NULL);
-  ASSERT(data && data_size > 0);
-  /*ASSERT(
-    buff->buffer && buff_size >= buff_offset + data_size
-    && (buff->usage & (WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc)));*/
-  ASSERT(buff_size % 4 == 0);
-
   WGPUBufferDescriptor staging_buffer_desc = {
     .usage            = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc,
     .size             = buff_size,
@@ -80,10 +141,44 @@ void wgpu_record_copy_data_to_buffer(struct wgpu_context_t* wgpu_context,
   wgpuBufferUnmap(staging);
 
   wgpuCommandEncoderCopyBufferToBuffer(wgpu_context->cmd_enc, staging, 0,
-                                       buff->buffer, buff_offset, buff_size);
+                                       buff->buffer, buff->offset + buff_offset,
+                                       buff_size);
   WGPU_RELEASE_RESOURCE(Buffer, staging);
 }
 
+void wgpu_record_copy_data_to_buffer(struct wgpu_context_t* wgpu_context,
+                                     wgpu_buffer_t* buff, uint32_t buff_offset,
+                                     uint32_t buff_size, const void* data,
+                                     uint32_t data_size)
+{
+  ASSERT(wgpu_context->cmd_enc != NULL);
+  ASSERT(data && data_size > 0);
+  /*ASSERT(
+    buff->buffer && buff_size >= buff_offset + data_size
+    && (buff->usage & (WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc)));*/
+  ASSERT(buff_size % 4 == 0);
+
+  /* Create the staging ring on first use */
+  if (wgpu_context->staging_ring == NULL) {
+    wgpu_context->staging_ring = wgpu_staging_ring_create(
+      wgpu_context, WGPU_STAGING_RING_DEFAULT_PARTITION_SIZE);
+  }
+
+  WGPUBuffer staging      = NULL;
+  uint64_t staging_offset = 0;
+  if (wgpu_staging_ring_write(wgpu_context->staging_ring, data, data_size,
+                              buff_size, &staging, &staging_offset)) {
+    wgpuCommandEncoderCopyBufferToBuffer(wgpu_context->cmd_enc, staging,
+                                         staging_offset, buff->buffer,
+                                         buff->offset + buff_offset, buff_size);
+  }
+  else {
+    /* Ring partition exhausted or still in use by the GPU */
+    wgpu_record_copy_data_via_temporary_staging_buffer(
+      wgpu_context, buff, buff_offset, buff_size, data, data_size);
+  }
+}
+
 WGPUCommandBuffer wgpu_copy_buffer_to_texture(
   struct wgpu_context_t* wgpu_context, WGPUImageCopyBuffer* buffer_copy_view,
   WGPUImageCopyTexture* texture_copy_view, WGPUExtent3D* texture_size)
@@ -100,3 +195,403 @@ WGPUCommandBuffer wgpu_copy_buffer_to_texture(
 
   return command_buffer;
 }
+
+typedef struct wgpu_read_buffer_state_t {
+  bool done;
+  WGPUBufferMapAsyncStatus status;
+} wgpu_read_buffer_state_t;
+
+static void wgpu_read_buffer_map_cb(WGPUBufferMapAsyncStatus status,
+                                    void* user_data)
+{
+  wgpu_read_buffer_state_t* state = (wgpu_read_buffer_state_t*)user_data;
+  state->status                   = status;
+  state->done                     = true;
+}
+
+bool wgpu_read_buffer(struct wgpu_context_t* wgpu_context, WGPUBuffer buffer,
+                      uint64_t offset, uint64_t size, void* data)
+{
+  ASSERT(offset % 4 == 0 && size % 4 == 0 && size > 0);
+
+  WGPUBuffer readback_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "read_buffer_readback_buffer",
+      .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+      .size  = size,
+    });
+  ASSERT(readback_buffer != NULL);
+
+  WGPUCommandEncoder cmd_encoder
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  wgpuCommandEncoderCopyBufferToBuffer(cmd_encoder, buffer, offset,
+                                       readback_buffer, 0, size);
+  WGPUCommandBuffer command_buffer
+    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  ASSERT(command_buffer != NULL);
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  wgpu_read_buffer_state_t state = {0};
+  wgpuBufferMapAsync(readback_buffer, WGPUMapMode_Read, 0, size,
+                     wgpu_read_buffer_map_cb, &state);
+  while (!state.done) {
+    wgpuDeviceTick(wgpu_context->device);
+  }
+
+  const bool success = state.status == WGPUBufferMapAsyncStatus_Success;
+  if (success) {
+    const void* mapping
+      = wgpuBufferGetConstMappedRange(readback_buffer, 0, size);
+    memcpy(data, mapping, size);
+    wgpuBufferUnmap(readback_buffer);
+  }
+  WGPU_RELEASE_RESOURCE(Buffer, readback_buffer)
+  return success;
+}
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU staging ring
+ * -------------------------------------------------------------------------- */
+
+/* Buffer copy offsets and sizes must be a multiple of 4 bytes */
+#define WGPU_STAGING_RING_ALIGNMENT 4u
+
+typedef enum wgpu_staging_partition_state_enum_t {
+  STAGING_PARTITION_STATE_MAPPED   = 0, /* Writable by the CPU */
+  STAGING_PARTITION_STATE_UNMAPPED = 1, /* Submitted, not yet recycled */
+  STAGING_PARTITION_STATE_PENDING  = 2, /* Waiting for the GPU to finish */
+} wgpu_staging_partition_state_enum_t;
+
+typedef struct wgpu_staging_partition_t {
+  WGPUBuffer buffer;
+  uint64_t size;
+  uint64_t offset;   /* Next free byte in the partition */
+  uint64_t overflow; /* Bytes that did not fit in the partition this frame */
+  uint8_t* mapping;
+  wgpu_staging_partition_state_enum_t state;
+} wgpu_staging_partition_t;
+
+struct wgpu_staging_ring_t {
+  struct wgpu_context_t* wgpu_context;
+  wgpu_staging_partition_t partitions[WGPU_STAGING_RING_PARTITION_COUNT];
+  uint32_t current_partition;
+};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void
+wgpu_staging_partition_create_buffer(struct wgpu_context_t* wgpu_context,
+                                     wgpu_staging_partition_t* partition,
+                                     uint64_t size)
+{
+  WGPUBufferDescriptor buffer_desc = {
+    .label            = "staging-ring-partition",
+    .usage            = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc,
+    .size             = size,
+    .mappedAtCreation = true,
+  };
+  partition->buffer = wgpuDeviceCreateBuffer(wgpu_context->device, &buffer_desc);
+  ASSERT(partition->buffer != NULL);
+  partition->mapping
+    = (uint8_t*)wgpuBufferGetMappedRange(partition->buffer, 0, size);
+  ASSERT(partition->mapping != NULL);
+  partition->size     = size;
+  partition->offset   = 0;
+  partition->overflow = 0;
+  partition->state    = STAGING_PARTITION_STATE_MAPPED;
+}
+
+static void wgpu_staging_partition_map_cb(WGPUBufferMapAsyncStatus status,
+                                          void* user_data)
+{
+  wgpu_staging_partition_t* partition = (wgpu_staging_partition_t*)user_data;
+
+  if (status == WGPUBufferMapAsyncStatus_Success) {
+    partition->mapping = (uint8_t*)wgpuBufferGetMappedRange(
+      partition->buffer, 0, partition->size);
+    ASSERT(partition->mapping != NULL);
+    partition->offset = 0;
+    partition->state  = STAGING_PARTITION_STATE_MAPPED;
+  }
+  else if (status != WGPUBufferMapAsyncStatus_DestroyedBeforeCallback
+           && status != WGPUBufferMapAsyncStatus_UnmappedBeforeCallback) {
+    /* Retry mapping the partition the next time it gets recycled */
+    partition->mapping = NULL;
+    partition->state   = STAGING_PARTITION_STATE_UNMAPPED;
+  }
+}
+
+wgpu_staging_ring_t*
+wgpu_staging_ring_create(struct wgpu_context_t* wgpu_context,
+                         uint64_t partition_size)
+{
+  wgpu_staging_ring_t* staging_ring
+    = (wgpu_staging_ring_t*)malloc(sizeof(wgpu_staging_ring_t));
+  memset(staging_ring, 0, sizeof(wgpu_staging_ring_t));
+  staging_ring->wgpu_context = wgpu_context;
+
+  partition_size = align_up(partition_size > 0 ?
+                              partition_size :
+                              WGPU_STAGING_RING_DEFAULT_PARTITION_SIZE,
+                            WGPU_STAGING_RING_ALIGNMENT);
+  for (uint32_t i = 0; i < WGPU_STAGING_RING_PARTITION_COUNT; ++i) {
+    wgpu_staging_partition_create_buffer(
+      wgpu_context, &staging_ring->partitions[i], partition_size);
+  }
+
+  return staging_ring;
+}
+
+void wgpu_staging_ring_destroy(wgpu_staging_ring_t* staging_ring)
+{
+  if (staging_ring == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < WGPU_STAGING_RING_PARTITION_COUNT; ++i) {
+    wgpu_staging_partition_t* partition = &staging_ring->partitions[i];
+    if (partition->buffer) {
+      /* Destroying the buffer cancels a pending map request */
+      wgpuBufferDestroy(partition->buffer);
+      WGPU_RELEASE_RESOURCE(Buffer, partition->buffer)
+    }
+  }
+  free(staging_ring);
+}
+
+void* wgpu_staging_ring_allocate(wgpu_staging_ring_t* staging_ring,
+                                 uint64_t size, WGPUBuffer* buffer,
+                                 uint64_t* offset)
+{
+  wgpu_staging_partition_t* partition
+    = &staging_ring->partitions[staging_ring->current_partition];
+
+  /* A partition which is not mapped again yet is not full, the caller falls
+   * back without growing it */
+  if (partition->state != STAGING_PARTITION_STATE_MAPPED) {
+    return NULL;
+  }
+
+  const uint64_t alloc_size = align_up(size, WGPU_STAGING_RING_ALIGNMENT);
+  if (partition->offset + alloc_size > partition->size) {
+    partition->overflow += alloc_size;
+    return NULL;
+  }
+
+  void* mapping = partition->mapping + partition->offset;
+  *buffer       = partition->buffer;
+  *offset       = partition->offset;
+  partition->offset += alloc_size;
+
+  return mapping;
+}
+
+bool wgpu_staging_ring_write(wgpu_staging_ring_t* staging_ring,
+                             const void* data, uint64_t data_size,
+                             uint64_t size, WGPUBuffer* buffer,
+                             uint64_t* offset)
+{
+  ASSERT(data_size <= size);
+
+  void* mapping
+    = wgpu_staging_ring_allocate(staging_ring, size, buffer, offset);
+  if (mapping == NULL) {
+    return false;
+  }
+
+  memcpy(mapping, data, data_size);
+
+  return true;
+}
+
+void wgpu_staging_ring_unmap(wgpu_staging_ring_t* staging_ring)
+{
+  wgpu_staging_partition_t* partition
+    = &staging_ring->partitions[staging_ring->current_partition];
+
+  if (partition->state == STAGING_PARTITION_STATE_MAPPED
+      && partition->offset > 0) {
+    wgpuBufferUnmap(partition->buffer);
+    partition->mapping = NULL;
+    partition->state   = STAGING_PARTITION_STATE_UNMAPPED;
+  }
+}
+
+void wgpu_staging_ring_next_frame(wgpu_staging_ring_t* staging_ring)
+{
+  wgpu_staging_partition_t* partition
+    = &staging_ring->partitions[staging_ring->current_partition];
+
+  /* Nothing to recycle when the partition was not used this frame */
+  if (partition->state != STAGING_PARTITION_STATE_UNMAPPED
+      && partition->overflow == 0) {
+    return;
+  }
+
+  if (partition->overflow > 0) {
+    /* Grow the partition so that the whole frame fits in it next time */
+    uint64_t required_size = partition->size + partition->overflow;
+    uint64_t new_size      = partition->size;
+    while (new_size < required_size) {
+      new_size *= 2;
+    }
+    if (partition->state == STAGING_PARTITION_STATE_MAPPED) {
+      wgpuBufferDestroy(partition->buffer);
+    }
+    WGPU_RELEASE_RESOURCE(Buffer, partition->buffer)
+    wgpu_staging_partition_create_buffer(staging_ring->wgpu_context,
+                                         partition, new_size);
+  }
+  else if (partition->state == STAGING_PARTITION_STATE_UNMAPPED) {
+    /* The map request completes once the GPU finished the submitted copies */
+    partition->state = STAGING_PARTITION_STATE_PENDING;
+    wgpuBufferMapAsync(partition->buffer, WGPUMapMode_Write, 0,
+                       partition->size, wgpu_staging_partition_map_cb,
+                       partition);
+  }
+
+  staging_ring->current_partition
+    = (staging_ring->current_partition + 1) % WGPU_STAGING_RING_PARTITION_COUNT;
+}
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU buffer pool
+ * -------------------------------------------------------------------------- */
+
+typedef struct wgpu_buffer_pool_block_t {
+  WGPUBuffer buffer;
+  uint64_t offset; /* first free byte in the block */
+} wgpu_buffer_pool_block_t;
+
+struct wgpu_buffer_pool_t {
+  struct wgpu_context_t* wgpu_context;
+  const char* label;
+  WGPUBufferUsage usage;
+  uint64_t block_size;
+  wgpu_buffer_pool_block_t blocks[WGPU_BUFFER_POOL_MAX_BLOCK_COUNT];
+  uint32_t block_count;
+};
+
+wgpu_buffer_pool_t*
+wgpu_buffer_pool_create(struct wgpu_context_t* wgpu_context,
+                        const wgpu_buffer_pool_desc_t* desc)
+{
+  wgpu_buffer_pool_t* buffer_pool
+    = (wgpu_buffer_pool_t*)malloc(sizeof(wgpu_buffer_pool_t));
+  memset(buffer_pool, 0, sizeof(wgpu_buffer_pool_t));
+  buffer_pool->wgpu_context = wgpu_context;
+  buffer_pool->label        = desc->label;
+  buffer_pool->usage        = desc->usage;
+  buffer_pool->block_size   = align_up(desc->block_size > 0 ?
+                                         desc->block_size :
+                                         WGPU_BUFFER_POOL_DEFAULT_BLOCK_SIZE,
+                                       WGPU_BUFFER_POOL_ALIGNMENT);
+
+  return buffer_pool;
+}
+
+void wgpu_buffer_pool_destroy(wgpu_buffer_pool_t* buffer_pool)
+{
+  if (buffer_pool == NULL) {
+    return;
+  }
+
+  /* Outstanding allocations keep their backing buffer alive */
+  for (uint32_t i = 0; i < buffer_pool->block_count; ++i) {
+    WGPU_RELEASE_RESOURCE(Buffer, buffer_pool->blocks[i].buffer)
+  }
+
+  free(buffer_pool);
+}
+
+static wgpu_buffer_pool_block_t*
+wgpu_buffer_pool_find_block(wgpu_buffer_pool_t* buffer_pool, uint64_t size)
+{
+  for (uint32_t i = 0; i < buffer_pool->block_count; ++i) {
+    wgpu_buffer_pool_block_t* block = &buffer_pool->blocks[i];
+    if (block->offset + size <= buffer_pool->block_size) {
+      return block;
+    }
+  }
+
+  if (buffer_pool->block_count == WGPU_BUFFER_POOL_MAX_BLOCK_COUNT) {
+    return NULL;
+  }
+
+  wgpu_buffer_pool_block_t* block
+    = &buffer_pool->blocks[buffer_pool->block_count++];
+  block->buffer = wgpuDeviceCreateBuffer(
+    buffer_pool->wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label            = buffer_pool->label,
+      .usage            = buffer_pool->usage,
+      .size             = buffer_pool->block_size,
+      .mappedAtCreation = false,
+    });
+  ASSERT(block->buffer != NULL);
+  block->offset = 0;
+
+  return block;
+}
+
+wgpu_buffer_t wgpu_buffer_pool_allocate(wgpu_buffer_pool_t* buffer_pool,
+                                        const wgpu_buffer_desc_t* desc)
+{
+  ASSERT((desc->usage & buffer_pool->usage) == desc->usage);
+
+  /* Ensure that buffer size is a multiple of 4 */
+  const uint32_t size = (desc->size + 3) & ~3;
+  const uint64_t alloc_size = align_up(size, WGPU_BUFFER_POOL_ALIGNMENT);
+
+  wgpu_buffer_pool_block_t* block
+    = (alloc_size <= buffer_pool->block_size) ?
+        wgpu_buffer_pool_find_block(buffer_pool, alloc_size) :
+        NULL;
+  if (block == NULL) {
+    /* Too large for the pool or pool exhausted: dedicated buffer */
+    wgpu_buffer_desc_t dedicated_desc = *desc;
+    dedicated_desc.usage              = buffer_pool->usage;
+    return wgpu_create_buffer(buffer_pool->wgpu_context, &dedicated_desc);
+  }
+
+  wgpu_buffer_t wgpu_buffer = {
+    .buffer = block->buffer,
+    .usage  = buffer_pool->usage,
+    .size   = size,
+    .count  = desc->count,
+    .offset = block->offset,
+  };
+  block->offset += alloc_size;
+
+  /* The slice shares the backing buffer */
+  wgpuBufferReference(wgpu_buffer.buffer);
+
+  const uint32_t initial_size
+    = (desc->initial.size == 0) ? desc->size : desc->initial.size;
+  if (desc->initial.data && initial_size > 0 && initial_size <= desc->size) {
+    ASSERT(buffer_pool->usage & WGPUBufferUsage_CopyDst);
+    /* Queue writes must be a multiple of 4 bytes, pad the tail */
+    const uint32_t head_size = initial_size & ~3;
+    if (head_size > 0) {
+      wgpuQueueWriteBuffer(buffer_pool->wgpu_context->queue,
+                           wgpu_buffer.buffer, wgpu_buffer.offset,
+                           desc->initial.data, head_size);
+    }
+    if (head_size < initial_size) {
+      uint8_t tail[4] = {0};
+      memcpy(tail, (const uint8_t*)desc->initial.data + head_size,
+             initial_size - head_size);
+      wgpuQueueWriteBuffer(buffer_pool->wgpu_context->queue,
+                           wgpu_buffer.buffer, wgpu_buffer.offset + head_size,
+                           tail, sizeof(tail));
+    }
+  }
+
+  return wgpu_buffer;
+}
@@ -1,6 +1,7 @@
 #ifndef BUFFER_H_
 #define BUFFER_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <dawn/webgpu.h>
@@ -24,7 +25,8 @@ typedef struct wgpu_buffer_t {
   WGPUBuffer buffer;
   WGPUBufferUsage usage;
   uint32_t size;
-  uint32_t count; /* numer of elements in the buffer (optional) */
+  uint32_t count;  /* numer of elements in the buffer (optional) */
+  uint64_t offset; /* offset of the slice in buffer (non-zero when pooled) */
 } wgpu_buffer_t;
 
 /* WebGPU buffer creating  / destroy */
@@ -33,8 +35,38 @@ wgpu_buffer_t wgpu_create_buffer(struct wgpu_context_t* wgpu_context,
 void wgpu_destroy_buffer(wgpu_buffer_t* buffer);
 
 /*
- * Copies data into buff.buffer via a temporary staging buffer, doesn't submit
- * the resulting command
+ * Writes the elements [begin, end) of a buffer created with
+ * wgpu_create_buffer_with_fill(), mapping points to the first element of the
+ * buffer. The bytes not written stay zero.
+ */
+typedef void (*wgpu_buffer_fill_func_t)(void* user_data, void* mapping,
+                                        uint32_t begin, uint32_t end);
+
+typedef struct wgpu_buffer_fill_desc_t {
+  wgpu_buffer_fill_func_t func;
+  void* user_data;
+  /* Number of elements to fill, the count of the buffer when 0 */
+  uint32_t element_count;
+  /* Splits the elements into batches filled on the shared job system, the
+   * fill function must then be thread safe (e.g. random_float_hashed() in
+   * place of random_float()) */
+  bool parallel;
+} wgpu_buffer_fill_desc_t;
+
+/**
+ * @brief Creates a buffer mapped at creation and lets the fill function write
+ * the initial data straight into the mapping, without an intermediate copy on
+ * the CPU. The initial data of desc is ignored.
+ */
+wgpu_buffer_t
+wgpu_create_buffer_with_fill(struct wgpu_context_t* wgpu_context,
+                             const wgpu_buffer_desc_t* desc,
+                             const wgpu_buffer_fill_desc_t* fill);
+
+/*
+ * Copies data into buff.buffer via the staging ring of the context (or a
+ * temporary staging buffer when the ring is exhausted), doesn't submit the
+ * resulting command
  */
 void wgpu_record_copy_data_to_buffer(struct wgpu_context_t* wgpu_context,
                                      wgpu_buffer_t* buff, uint32_t buff_offset,
@@ -45,4 +77,115 @@ WGPUCommandBuffer wgpu_copy_buffer_to_texture(
   struct wgpu_context_t* wgpu_context, WGPUImageCopyBuffer* buffer_copy_view,
   WGPUImageCopyTexture* texture_copy_view, WGPUExtent3D* texture_size);
 
+/*
+ * Copies size bytes at offset of the buffer, which needs the CopySrc usage,
+ * through a MapRead buffer into data. Submits the copy and blocks until the
+ * mapping completes, meant for results of compute passes and for tests rather
+ * than for per-frame readbacks. Offset and size must be multiples of 4.
+ */
+bool wgpu_read_buffer(struct wgpu_context_t* wgpu_context, WGPUBuffer buffer,
+                      uint64_t offset, uint64_t size, void* data);
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU staging ring
+ * -------------------------------------------------------------------------- */
+
+/* Number of frame partitions in the staging ring */
+#define WGPU_STAGING_RING_PARTITION_COUNT 3u
+/* Default size in bytes of a single staging ring partition */
+#define WGPU_STAGING_RING_DEFAULT_PARTITION_SIZE (1u << 20)
+
+/**
+ * @brief Persistent, frame-partitioned ring of MapWrite|CopySrc buffers used
+ * to sub-allocate upload space. A partition is filled during a frame, unmapped
+ * before the submission and mapped again once the GPU is done with it. A
+ * partition that overflowed is grown when it gets recycled.
+ */
+typedef struct wgpu_staging_ring_t wgpu_staging_ring_t;
+
+/* Staging ring creating / destroy */
+wgpu_staging_ring_t*
+wgpu_staging_ring_create(struct wgpu_context_t* wgpu_context,
+                         uint64_t partition_size);
+void wgpu_staging_ring_destroy(wgpu_staging_ring_t* staging_ring);
+
+/**
+ * @brief Sub-allocates size bytes from the current partition and fills them
+ * with data.
+ * @param staging_ring the staging ring to allocate from
+ * @param data the data to upload
+ * @param data_size the number of bytes to copy from data
+ * @param size the number of bytes to allocate (>= data_size)
+ * @param buffer output staging buffer
+ * @param offset output offset into the staging buffer
+ * @return true on success, false when the current partition is not mapped yet
+ * or cannot hold the allocation (only a full partition records the overflow
+ * so that it grows)
+ */
+bool wgpu_staging_ring_write(wgpu_staging_ring_t* staging_ring,
+                             const void* data, uint64_t data_size,
+                             uint64_t size, WGPUBuffer* buffer,
+                             uint64_t* offset);
+
+/**
+ * @brief Sub-allocates size bytes from the current partition without filling
+ * them, so that the caller can write its data into the mapping directly.
+ * @return the mapped allocation, NULL when the current partition is not mapped
+ * yet or cannot hold it (only a full partition records the overflow so that
+ * it grows)
+ */
+void* wgpu_staging_ring_allocate(wgpu_staging_ring_t* staging_ring,
+                                 uint64_t size, WGPUBuffer* buffer,
+                                 uint64_t* offset);
+
+/* Unmaps the current partition, must be called before queue submission */
+void wgpu_staging_ring_unmap(wgpu_staging_ring_t* staging_ring);
+
+/* Recycles the current partition after submission and advances the ring */
+void wgpu_staging_ring_next_frame(wgpu_staging_ring_t* staging_ring);
+
+
+/* -------------------------------------------------------------------------- *
+ * WebGPU buffer pool
+ * -------------------------------------------------------------------------- */
+
+/* Alignment of pooled allocations (minUniformBufferOffsetAlignment) */
+#define WGPU_BUFFER_POOL_ALIGNMENT 256u
+/* Default size in bytes of a single backing buffer of the pool */
+#define WGPU_BUFFER_POOL_DEFAULT_BLOCK_SIZE (1u << 20)
+/* Maximum number of backing buffers of a pool */
+#define WGPU_BUFFER_POOL_MAX_BLOCK_COUNT 64u
+
+typedef struct wgpu_buffer_pool_desc_t {
+  const char* label;
+  WGPUBufferUsage usage; /* usage of the backing buffers */
+  uint32_t block_size;   /* size of a backing buffer (optional) */
+} wgpu_buffer_pool_desc_t;
+
+/**
+ * @brief Opt-in sub-allocator that carves small buffers out of large backing
+ * buffers. Every allocation holds a reference on its backing buffer, so a
+ * pooled wgpu_buffer_t is released with wgpu_destroy_buffer() like any other
+ * buffer. Pooled buffers must be bound / written using their offset.
+ */
+typedef struct wgpu_buffer_pool_t wgpu_buffer_pool_t;
+
+/* Buffer pool creating / destroy */
+wgpu_buffer_pool_t*
+wgpu_buffer_pool_create(struct wgpu_context_t* wgpu_context,
+                        const wgpu_buffer_pool_desc_t* desc);
+void wgpu_buffer_pool_destroy(wgpu_buffer_pool_t* buffer_pool);
+
+/**
+ * @brief Allocates a buffer slice from the pool, the usage flags of desc must
+ * be a subset of the pool usage. Allocations larger than the block size get a
+ * dedicated buffer (with a zero offset).
+ * @param buffer_pool the buffer pool to allocate from
+ * @param desc the buffer description, the initial data is uploaded through the
+ * queue and requires the pool usage to contain WGPUBufferUsage_CopyDst
+ * @return the allocated buffer slice
+ */
+wgpu_buffer_t wgpu_buffer_pool_allocate(wgpu_buffer_pool_t* buffer_pool,
+                                        const wgpu_buffer_desc_t* desc);
+
 #endif // BUFFER_H_
@@ -0,0 +1,605 @@
+#include "bvh.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/job_system.h"
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "../core/platform.h"
+#include "buffer.h"
+
+#define BVH_BIN_COUNT 16u
+#define BVH_DEFAULT_MAX_LEAF_SIZE 4u
+#define BVH_TRAVERSAL_COST 1.0f
+#define BVH_INTERSECTION_COST 1.0f
+/* Subtrees with fewer triangles are not split into further build tasks */
+#define BVH_MIN_TASK_TRIANGLE_COUNT 4096u
+#define BVH_TASKS_PER_WORKER 4u
+#define BVH_NO_NODE UINT32_MAX
+
+typedef struct bvh_aabb_t {
+  float min[3];
+  float max[3];
+} bvh_aabb_t;
+
+/* Node of the build, leaves reference [first, first + count) of the triangle
+ * references */
+typedef struct bvh_build_node_t {
+  bvh_aabb_t bounds;
+  uint32_t children[2]; /* BVH_NO_NODE for leaves */
+  uint32_t first;
+  uint32_t count;
+} bvh_build_node_t;
+
+/* Subtree built by a job, the nodes of its descendants are taken from a
+ * reserved range */
+typedef struct bvh_build_task_t {
+  uint32_t node;
+  uint32_t first_free_node;
+  uint32_t begin;
+  uint32_t end;
+} bvh_build_task_t;
+
+typedef struct bvh_builder_t {
+  const wgpu_bvh_desc_t* desc;
+  uint32_t position_stride;
+  uint32_t max_leaf_size;
+  bvh_aabb_t* triangle_bounds;
+  float (*centroids)[3];
+  uint32_t* references; /* triangle indices in the order of the leaves */
+  bvh_build_node_t* nodes;
+  /* Subtrees up to this size become build tasks, 0 once they are running */
+  uint32_t task_triangle_count;
+  bvh_build_task_t* tasks;
+  uint32_t task_count;
+  uint32_t task_capacity;
+} bvh_builder_t;
+
+/* Layout of BvhNode */
+typedef struct bvh_node_t {
+  float aabb_min[3];
+  uint32_t count; /* 0 for inner nodes */
+  float aabb_max[3];
+  uint32_t offset; /* first triangle of leaves, miss link of inner nodes */
+} bvh_node_t;
+
+/* Layout of BvhTriangle */
+typedef struct bvh_triangle_t {
+  float v0[3];
+  uint32_t data;
+  float v1[3];
+  uint32_t index;
+  float v2[3];
+  uint32_t padding;
+} bvh_triangle_t;
+
+struct wgpu_bvh {
+  wgpu_context_t* wgpu_context;
+  wgpu_bvh_stats_t stats;
+  wgpu_buffer_t node_buffer;
+  wgpu_buffer_t triangle_buffer;
+};
+
+// clang-format off
+static const char* bvh_wgsl_functions = CODE(
+  struct BvhNode {
+    aabbMin : vec3<f32>,
+    count : u32,
+    aabbMax : vec3<f32>,
+    offset : u32,
+  };
+
+  struct BvhTriangle {
+    v0 : vec4<f32>,
+    v1 : vec4<f32>,
+    v2 : vec4<f32>,
+  };
+
+  struct BvhHit {
+    t : f32,
+    u : f32,
+    v : f32,
+    triangle : u32,
+  };
+
+  fn bvhIntersectBox(origin : vec3<f32>, invDir : vec3<f32>, node : BvhNode,
+                     tMin : f32, tMax : f32) -> bool {
+    let t0 = (node.aabbMin - origin) * invDir;
+    let t1 = (node.aabbMax - origin) * invDir;
+    let tNear = max(max(min(t0.x, t1.x), min(t0.y, t1.y)),
+                    max(min(t0.z, t1.z), tMin));
+    let tFar = min(min(max(t0.x, t1.x), max(t0.y, t1.y)),
+                   min(max(t0.z, t1.z), tMax));
+    return tNear <= tFar;
+  }
+
+  // Moeller-Trumbore, returns t, u and v with a negative t without a hit
+  fn bvhIntersectTriangle(origin : vec3<f32>, dir : vec3<f32>,
+                          triangle : BvhTriangle) -> vec3<f32> {
+    let e1 = triangle.v1.xyz - triangle.v0.xyz;
+    let e2 = triangle.v2.xyz - triangle.v0.xyz;
+    let p = cross(dir, e2);
+    let det = dot(e1, p);
+    if (abs(det) < 1e-12) {
+      return vec3<f32>(-1.0, 0.0, 0.0);
+    }
+    let invDet = 1.0 / det;
+    let s = origin - triangle.v0.xyz;
+    let u = dot(s, p) * invDet;
+    let q = cross(s, e1);
+    let v = dot(dir, q) * invDet;
+    if (u < 0.0 || v < 0.0 || u + v > 1.0) {
+      return vec3<f32>(-1.0, 0.0, 0.0);
+    }
+    return vec3<f32>(dot(e2, q) * invDet, u, v);
+  }
+
+  // Stackless traversal: a node box that is hit continues with the next node,
+  // which is the first child of inner nodes, a missed box skips its subtree.
+  // The node after a leaf is always the next one.
+  fn bvhTraverse(origin : vec3<f32>, dir : vec3<f32>, tMin : f32, tMax : f32,
+                 anyHit : bool) -> BvhHit {
+    var hit = BvhHit(tMax, 0.0, 0.0, 0xffffffffu);
+    // Avoids infinities for axis-aligned rays
+    let invDir = 1.0 / select(dir, vec3<f32>(1e-20),
+                              abs(dir) < vec3<f32>(1e-20));
+    let nodeCount = arrayLength(&bvhNodes);
+    var index = 0u;
+    loop {
+      if (index >= nodeCount) {
+        break;
+      }
+      let node = bvhNodes[index];
+      if (!bvhIntersectBox(origin, invDir, node, tMin, hit.t)) {
+        index = select(node.offset, index + 1u, node.count > 0u);
+        continue;
+      }
+      for (var i = node.offset; i < node.offset + node.count; i = i + 1u) {
+        let tuv = bvhIntersectTriangle(origin, dir, bvhTriangles[i]);
+        if (tuv.x > tMin && tuv.x < hit.t) {
+          hit = BvhHit(tuv.x, tuv.y, tuv.z, i);
+        }
+      }
+      if (anyHit && hit.triangle != 0xffffffffu) {
+        break;
+      }
+      index = index + 1u;
+    }
+    return hit;
+  }
+
+  fn bvhIntersect(origin : vec3<f32>, dir : vec3<f32>, tMin : f32,
+                  tMax : f32) -> BvhHit {
+    return bvhTraverse(origin, dir, tMin, tMax, false);
+  }
+
+  fn bvhOccluded(origin : vec3<f32>, dir : vec3<f32>, tMin : f32,
+                 tMax : f32) -> bool {
+    return bvhTraverse(origin, dir, tMin, tMax, true).triangle != 0xffffffffu;
+  }
+
+  fn bvhTriangleNormal(triangle : u32) -> vec3<f32> {
+    let t = bvhTriangles[triangle];
+    return normalize(cross(t.v1.xyz - t.v0.xyz, t.v2.xyz - t.v0.xyz));
+  }
+);
+// clang-format on
+
+static void bvh_aabb_reset(bvh_aabb_t* aabb)
+{
+  for (uint32_t i = 0; i < 3; ++i) {
+    aabb->min[i] = FLT_MAX;
+    aabb->max[i] = -FLT_MAX;
+  }
+}
+
+static void bvh_aabb_grow_point(bvh_aabb_t* aabb, const float* point)
+{
+  for (uint32_t i = 0; i < 3; ++i) {
+    aabb->min[i] = MIN(aabb->min[i], point[i]);
+    aabb->max[i] = MAX(aabb->max[i], point[i]);
+  }
+}
+
+static void bvh_aabb_grow(bvh_aabb_t* aabb, const bvh_aabb_t* other)
+{
+  for (uint32_t i = 0; i < 3; ++i) {
+    aabb->min[i] = MIN(aabb->min[i], other->min[i]);
+    aabb->max[i] = MAX(aabb->max[i], other->max[i]);
+  }
+}
+
+/* Half the surface area, empty boxes have none */
+static float bvh_aabb_area(const bvh_aabb_t* aabb)
+{
+  const float dx = aabb->max[0] - aabb->min[0];
+  const float dy = aabb->max[1] - aabb->min[1];
+  const float dz = aabb->max[2] - aabb->min[2];
+  if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+    return 0.0f;
+  }
+  return dx * dy + dy * dz + dz * dx;
+}
+
+static const float* bvh_get_position(const bvh_builder_t* builder,
+                                     uint32_t vertex)
+{
+  ASSERT(vertex < builder->desc->vertex_count);
+  return (const float*)((const uint8_t*)builder->desc->positions
+                        + (size_t)vertex * builder->position_stride);
+}
+
+/* Job: bounds and centroids of a range of triangles */
+static void bvh_compute_triangle_bounds(void* user_data, uint32_t begin,
+                                        uint32_t end)
+{
+  bvh_builder_t* builder  = (bvh_builder_t*)user_data;
+  const uint32_t* indices = builder->desc->indices;
+  for (uint32_t t = begin; t < end; ++t) {
+    bvh_aabb_t* bounds = &builder->triangle_bounds[t];
+    bvh_aabb_reset(bounds);
+    for (uint32_t v = 0; v < 3; ++v) {
+      bvh_aabb_grow_point(bounds,
+                          bvh_get_position(builder, indices[t * 3 + v]));
+    }
+    for (uint32_t i = 0; i < 3; ++i) {
+      builder->centroids[t][i] = 0.5f * (bounds->min[i] + bounds->max[i]);
+    }
+    builder->references[t] = t;
+  }
+}
+
+static void bvh_push_task(bvh_builder_t* builder, const bvh_build_task_t* task)
+{
+  if (builder->task_count == builder->task_capacity) {
+    builder->task_capacity = MAX(builder->task_capacity * 2, 64u);
+    builder->tasks         = realloc(
+      builder->tasks, builder->task_capacity * sizeof(*builder->tasks));
+  }
+  builder->tasks[builder->task_count++] = *task;
+}
+
+/* Partitions the references of [begin, end) in place and returns the first one
+ * of the right child, or begin when the range becomes a leaf */
+static uint32_t bvh_find_split(bvh_builder_t* builder, uint32_t begin,
+                               uint32_t end, const bvh_aabb_t* bounds)
+{
+  const uint32_t count = end - begin;
+  uint32_t* references = builder->references;
+
+  // Split along the largest extent of the centroids
+  bvh_aabb_t centroid_bounds;
+  bvh_aabb_reset(&centroid_bounds);
+  for (uint32_t i = begin; i < end; ++i) {
+    bvh_aabb_grow_point(&centroid_bounds, builder->centroids[references[i]]);
+  }
+  uint32_t axis = 0;
+  for (uint32_t i = 1; i < 3; ++i) {
+    if (centroid_bounds.max[i] - centroid_bounds.min[i]
+        > centroid_bounds.max[axis] - centroid_bounds.min[axis]) {
+      axis = i;
+    }
+  }
+  const float axis_min = centroid_bounds.min[axis];
+  const float extent   = centroid_bounds.max[axis] - axis_min;
+  if (extent <= 0.0f) {
+    // Coincident centroids, only split to bound the leaf size
+    return count > builder->max_leaf_size ? begin + count / 2 : begin;
+  }
+
+  // Bin the centroids
+  struct {
+    bvh_aabb_t bounds;
+    uint32_t count;
+  } bins[BVH_BIN_COUNT];
+  for (uint32_t b = 0; b < BVH_BIN_COUNT; ++b) {
+    bvh_aabb_reset(&bins[b].bounds);
+    bins[b].count = 0;
+  }
+  const float bin_scale = (float)BVH_BIN_COUNT / extent;
+#define BVH_BIN_INDEX(reference)                                               \
+  MIN((uint32_t)((builder->centroids[reference][axis] - axis_min)              \
+                 * bin_scale),                                                 \
+      BVH_BIN_COUNT - 1)
+  for (uint32_t i = begin; i < end; ++i) {
+    const uint32_t b = BVH_BIN_INDEX(references[i]);
+    bvh_aabb_grow(&bins[b].bounds, &builder->triangle_bounds[references[i]]);
+    ++bins[b].count;
+  }
+
+  // Sweep the bins from the right, then evaluate the splits from the left
+  float right_areas[BVH_BIN_COUNT];
+  uint32_t right_counts[BVH_BIN_COUNT];
+  bvh_aabb_t accumulated;
+  bvh_aabb_reset(&accumulated);
+  uint32_t accumulated_count = 0;
+  for (uint32_t b = BVH_BIN_COUNT - 1; b > 0; --b) {
+    bvh_aabb_grow(&accumulated, &bins[b].bounds);
+    accumulated_count += bins[b].count;
+    right_areas[b]  = bvh_aabb_area(&accumulated);
+    right_counts[b] = accumulated_count;
+  }
+  float best_cost     = FLT_MAX;
+  uint32_t best_split = 0;
+  bvh_aabb_reset(&accumulated);
+  accumulated_count = 0;
+  for (uint32_t b = 0; b < BVH_BIN_COUNT - 1; ++b) {
+    bvh_aabb_grow(&accumulated, &bins[b].bounds);
+    accumulated_count += bins[b].count;
+    if (accumulated_count == 0 || right_counts[b + 1] == 0) {
+      continue;
+    }
+    const float cost = bvh_aabb_area(&accumulated) * (float)accumulated_count
+                       + right_areas[b + 1] * (float)right_counts[b + 1];
+    if (cost < best_cost) {
+      best_cost  = cost;
+      best_split = b + 1;
+    }
+  }
+
+  // Keep the leaf when it is cheaper than the split
+  const float area      = bvh_aabb_area(bounds);
+  const float leaf_cost = BVH_INTERSECTION_COST * (float)count;
+  const float split_cost
+    = area > 0.0f ?
+        BVH_TRAVERSAL_COST + BVH_INTERSECTION_COST * best_cost / area :
+        FLT_MAX;
+  if (count <= builder->max_leaf_size && leaf_cost <= split_cost) {
+    return begin;
+  }
+  if (best_split == 0) {
+    return begin + count / 2;
+  }
+
+  // Partition the references by their bin
+  uint32_t left  = begin;
+  uint32_t right = end;
+  while (left < right) {
+    if (BVH_BIN_INDEX(references[left]) < best_split) {
+      ++left;
+    }
+    else {
+      const uint32_t reference = references[left];
+      references[left]         = references[--right];
+      references[right]        = reference;
+    }
+  }
+#undef BVH_BIN_INDEX
+  return (left == begin || left == end) ? begin + count / 2 : left;
+}
+
+/* Builds the subtree of [begin, end) into node_index, the descendants are
+ * allocated from next_node */
+static void bvh_build_node(bvh_builder_t* builder, uint32_t node_index,
+                           uint32_t begin, uint32_t end, uint32_t* next_node)
+{
+  const uint32_t count = end - begin;
+  if (builder->task_triangle_count > 0
+      && count <= builder->task_triangle_count) {
+    // A subtree has at most 2 * count - 1 nodes including its root
+    bvh_push_task(builder, &(bvh_build_task_t){
+                             .node            = node_index,
+                             .first_free_node = *next_node,
+                             .begin           = begin,
+                             .end             = end,
+                           });
+    *next_node += 2 * count - 2;
+    return;
+  }
+
+  bvh_build_node_t* node = &builder->nodes[node_index];
+  bvh_aabb_reset(&node->bounds);
+  for (uint32_t i = begin; i < end; ++i) {
+    bvh_aabb_grow(&node->bounds,
+                  &builder->triangle_bounds[builder->references[i]]);
+  }
+  node->children[0] = BVH_NO_NODE;
+  node->children[1] = BVH_NO_NODE;
+  node->first       = begin;
+  node->count       = count;
+  if (count <= 1) {
+    return;
+  }
+
+  const uint32_t split = bvh_find_split(builder, begin, end, &node->bounds);
+  if (split == begin) {
+    return;
+  }
+  node->children[0] = (*next_node)++;
+  node->children[1] = (*next_node)++;
+  node->count       = 0;
+  bvh_build_node(builder, node->children[0], begin, split, next_node);
+  bvh_build_node(builder, node->children[1], split, end, next_node);
+}
+
+/* Job: builds a range of subtrees */
+static void bvh_run_build_tasks(void* user_data, uint32_t begin, uint32_t end)
+{
+  bvh_builder_t* builder = (bvh_builder_t*)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    const bvh_build_task_t* task = &builder->tasks[i];
+    uint32_t next_node           = task->first_free_node;
+    bvh_build_node(builder, task->node, task->begin, task->end, &next_node);
+  }
+}
+
+/* Writes the subtree of a build node depth-first and accumulates the
+ * statistics */
+static void bvh_flatten(wgpu_bvh_t* bvh, const bvh_builder_t* builder,
+                        uint32_t build_index, uint32_t depth,
+                        bvh_node_t* nodes)
+{
+  const bvh_build_node_t* build_node = &builder->nodes[build_index];
+  wgpu_bvh_stats_t* stats            = &bvh->stats;
+  bvh_node_t* node                   = &nodes[stats->node_count++];
+  memcpy(node->aabb_min, build_node->bounds.min, sizeof(node->aabb_min));
+  memcpy(node->aabb_max, build_node->bounds.max, sizeof(node->aabb_max));
+  stats->max_depth = MAX(stats->max_depth, depth);
+  const float area = bvh_aabb_area(&build_node->bounds);
+  if (build_node->children[0] == BVH_NO_NODE) {
+    node->count  = build_node->count;
+    node->offset = build_node->first;
+    ++stats->leaf_count;
+    stats->sah_cost += BVH_INTERSECTION_COST * area * (float)build_node->count;
+    return;
+  }
+  stats->sah_cost += BVH_TRAVERSAL_COST * area;
+  bvh_flatten(bvh, builder, build_node->children[0], depth + 1, nodes);
+  bvh_flatten(bvh, builder, build_node->children[1], depth + 1, nodes);
+  node->count  = 0;
+  node->offset = stats->node_count;
+}
+
+static void bvh_create_buffers(wgpu_bvh_t* bvh, const bvh_node_t* nodes,
+                               uint32_t node_count,
+                               const bvh_triangle_t* triangles,
+                               uint32_t triangle_count)
+{
+  bvh->node_buffer = wgpu_create_buffer(
+    bvh->wgpu_context, &(wgpu_buffer_desc_t){
+                         .label        = "bvh_node_buffer",
+                         .usage        = WGPUBufferUsage_Storage,
+                         .size         = node_count * sizeof(bvh_node_t),
+                         .initial.data = nodes,
+                       });
+  bvh->triangle_buffer = wgpu_create_buffer(
+    bvh->wgpu_context, &(wgpu_buffer_desc_t){
+                         .label = "bvh_triangle_buffer",
+                         .usage = WGPUBufferUsage_Storage,
+                         .size  = triangle_count * sizeof(bvh_triangle_t),
+                         .initial.data = triangles,
+                       });
+}
+
+wgpu_bvh_t* wgpu_bvh_create(wgpu_context_t* wgpu_context,
+                            const wgpu_bvh_desc_t* desc)
+{
+  ASSERT(desc->index_count % 3 == 0);
+  ASSERT(desc->index_count == 0
+         || (desc->positions != NULL && desc->indices != NULL));
+
+  wgpu_bvh_t* bvh = (wgpu_bvh_t*)malloc(sizeof(wgpu_bvh_t));
+  memset(bvh, 0, sizeof(wgpu_bvh_t));
+  bvh->wgpu_context = wgpu_context;
+
+  const uint32_t triangle_count = desc->index_count / 3;
+  if (triangle_count == 0) {
+    // The only node is skipped by the traversal, hit or not
+    const bvh_node_t node         = {.count = 0, .offset = 1};
+    const bvh_triangle_t triangle = {0};
+    bvh_create_buffers(bvh, &node, 1, &triangle, 1);
+    bvh->stats.node_count = 1;
+    return bvh;
+  }
+
+  const float start_time = platform_get_time();
+
+  bvh_builder_t builder = {
+    .desc            = desc,
+    .position_stride = desc->position_stride > 0 ? desc->position_stride :
+                                                   3 * sizeof(float),
+    .max_leaf_size   = desc->max_leaf_size > 0 ? desc->max_leaf_size :
+                                                 BVH_DEFAULT_MAX_LEAF_SIZE,
+    .triangle_bounds = malloc(triangle_count * sizeof(bvh_aabb_t)),
+    .centroids       = malloc(triangle_count * sizeof(*builder.centroids)),
+    .references      = malloc(triangle_count * sizeof(uint32_t)),
+    .nodes = malloc((2 * triangle_count - 1) * sizeof(bvh_build_node_t)),
+  };
+
+  job_system_t* job_system = job_system_get_shared();
+  job_system_parallel_for(job_system, triangle_count, 0,
+                          bvh_compute_triangle_bounds, &builder);
+
+  // Split serially until the subtrees are small enough to keep all workers
+  // busy, then build the subtrees in parallel
+  const uint32_t worker_count = job_system_get_worker_count(job_system) + 1;
+  builder.task_triangle_count
+    = MAX(triangle_count / (worker_count * BVH_TASKS_PER_WORKER),
+          BVH_MIN_TASK_TRIANGLE_COUNT);
+  uint32_t next_node = 1;
+  if (triangle_count <= builder.task_triangle_count) {
+    builder.task_triangle_count = 0;
+    bvh_build_node(&builder, 0, 0, triangle_count, &next_node);
+  }
+  else {
+    bvh_build_node(&builder, 0, 0, triangle_count, &next_node);
+    builder.task_triangle_count = 0;
+    job_system_parallel_for(job_system, builder.task_count, 1,
+                            bvh_run_build_tasks, &builder);
+  }
+
+  // Depth-first nodes and the triangles in the order of the leaves
+  bvh_node_t* nodes = malloc((2 * triangle_count - 1) * sizeof(bvh_node_t));
+  bvh_flatten(bvh, &builder, 0, 0, nodes);
+  const float root_area = bvh_aabb_area(&builder.nodes[0].bounds);
+  bvh->stats.sah_cost
+    = root_area > 0.0f ? bvh->stats.sah_cost / root_area : triangle_count;
+
+  bvh_triangle_t* triangles = malloc(triangle_count * sizeof(bvh_triangle_t));
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    const uint32_t t         = builder.references[i];
+    const uint32_t* indices  = &desc->indices[t * 3];
+    bvh_triangle_t* triangle = &triangles[i];
+    memcpy(triangle->v0, bvh_get_position(&builder, indices[0]),
+           sizeof(triangle->v0));
+    memcpy(triangle->v1, bvh_get_position(&builder, indices[1]),
+           sizeof(triangle->v1));
+    memcpy(triangle->v2, bvh_get_position(&builder, indices[2]),
+           sizeof(triangle->v2));
+    triangle->data
+      = desc->triangle_data != NULL ? desc->triangle_data[t] : 0;
+    triangle->index   = t;
+    triangle->padding = 0;
+  }
+
+  bvh_create_buffers(bvh, nodes, bvh->stats.node_count, triangles,
+                     triangle_count);
+  bvh->stats.triangle_count = triangle_count;
+  bvh->stats.build_time_ms  = (platform_get_time() - start_time) * 1000.0f;
+  log_debug("BVH: %u triangles, %u nodes, depth %u, SAH cost %.2f, %.1f ms\n",
+            triangle_count, bvh->stats.node_count, bvh->stats.max_depth,
+            bvh->stats.sah_cost, bvh->stats.build_time_ms);
+
+  free(triangles);
+  free(nodes);
+  free(builder.tasks);
+  free(builder.nodes);
+  free(builder.references);
+  free(builder.centroids);
+  free(builder.triangle_bounds);
+
+  return bvh;
+}
+
+void wgpu_bvh_release(wgpu_bvh_t* bvh)
+{
+  if (bvh == NULL) {
+    return;
+  }
+
+  wgpu_destroy_buffer(&bvh->node_buffer);
+  wgpu_destroy_buffer(&bvh->triangle_buffer);
+  free(bvh);
+}
+
+void wgpu_bvh_get_stats(wgpu_bvh_t* bvh, wgpu_bvh_stats_t* stats)
+{
+  *stats = bvh->stats;
+}
+
+WGPUBuffer wgpu_bvh_get_node_buffer(wgpu_bvh_t* bvh)
+{
+  return bvh->node_buffer.buffer;
+}
+
+WGPUBuffer wgpu_bvh_get_triangle_buffer(wgpu_bvh_t* bvh)
+{
+  return bvh->triangle_buffer.buffer;
+}
+
+const char* wgpu_bvh_get_wgsl_functions(void)
+{
+  return bvh_wgsl_functions;
+}
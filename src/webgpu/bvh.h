@@ -0,0 +1,76 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "context.h"
+
+/*
+ * Bounding volume hierarchy over a triangle mesh for ray queries in compute
+ * shaders.
+ *
+ * The hierarchy is built on the CPU with the binned surface area heuristic,
+ * the subtrees below the first splits are built in parallel on the job system.
+ * The nodes are stored depth-first with the first child following its parent
+ * and a miss link to the node after the subtree, so that the traversal needs
+ * no stack: a ray that hits a node box goes on with the next node, otherwise
+ * it skips to the miss link. The triangles are copied in the order of the
+ * leaves, every leaf references a contiguous range of them.
+ */
+typedef struct wgpu_bvh wgpu_bvh_t;
+
+typedef struct wgpu_bvh_desc_t {
+  /* Vertex positions, three floats each, position_stride bytes apart (0
+   * selects tightly packed positions) */
+  const float* positions;
+  uint32_t position_stride;
+  uint32_t vertex_count;
+  /* Three indices per triangle */
+  const uint32_t* indices;
+  uint32_t index_count;
+  /* Optional value per triangle stored with it, e.g. a material index */
+  const uint32_t* triangle_data;
+  /* Largest number of triangles per leaf, 0 selects 4 */
+  uint32_t max_leaf_size;
+} wgpu_bvh_desc_t;
+
+typedef struct wgpu_bvh_stats_t {
+  uint32_t triangle_count;
+  uint32_t node_count;
+  uint32_t leaf_count;
+  uint32_t max_depth;
+  /* Expected cost of a random ray, in triangle tests */
+  float sah_cost;
+  float build_time_ms;
+} wgpu_bvh_stats_t;
+
+/* BVH creating/releasing */
+wgpu_bvh_t* wgpu_bvh_create(wgpu_context_t* wgpu_context,
+                            const wgpu_bvh_desc_t* desc);
+void wgpu_bvh_release(wgpu_bvh_t* bvh);
+
+void wgpu_bvh_get_stats(wgpu_bvh_t* bvh, wgpu_bvh_stats_t* stats);
+
+/*
+ * Read-only storage buffers of the queries:
+ *   var<storage, read> bvhNodes : array<BvhNode>
+ *   var<storage, read> bvhTriangles : array<BvhTriangle>
+ * An empty mesh has one node that is never hit and one degenerate triangle.
+ */
+WGPUBuffer wgpu_bvh_get_node_buffer(wgpu_bvh_t* bvh);
+WGPUBuffer wgpu_bvh_get_triangle_buffer(wgpu_bvh_t* bvh);
+
+/*
+ * WGSL traversal functions for queries, to be prepended to their source. The
+ * shader declares the two bindings above:
+ *   fn bvhIntersect(origin : vec3<f32>, dir : vec3<f32>, tMin : f32,
+ *                   tMax : f32) -> BvhHit
+ *   fn bvhOccluded(origin : vec3<f32>, dir : vec3<f32>, tMin : f32,
+ *                  tMax : f32) -> bool
+ *   fn bvhTriangleNormal(triangle : u32) -> vec3<f32>
+ * BvhHit holds the distance t, the barycentrics u and v of the second and
+ * third vertex and the triangle index, 0xffffffffu without a hit. The triangle
+ * data is bitcast<u32>(bvhTriangles[triangle].v0.w), the index of the
+ * triangle in the mesh bitcast<u32>(bvhTriangles[triangle].v1.w).
+ */
+const char* wgpu_bvh_get_wgsl_functions(void);
+
+#endif
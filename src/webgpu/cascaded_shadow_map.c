@@ -0,0 +1,677 @@
+#include "cascaded_shadow_map.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+/* Offset alignment of the dynamic cascade uniforms */
+#define CASCADED_SHADOW_MAP_CASCADE_STRIDE 256u
+
+/* Radius of the sphere cached cascades are fitted to, relative to their part
+ * of the frustum */
+#define CASCADED_SHADOW_MAP_CACHE_MARGIN 1.25f
+
+/* Offset of the compared depth, on top of the slope scaled pipeline bias */
+#define CASCADED_SHADOW_MAP_DEPTH_BIAS 0.0005f
+
+/* Layout of CascadedShadowParams */
+typedef struct cascaded_shadow_params_t {
+  mat4 view_matrix;
+  mat4 view_proj[WGPU_CASCADED_SHADOW_MAP_MAX_CASCADES];
+  float split_depths[WGPU_CASCADED_SHADOW_MAP_MAX_CASCADES];
+  uint32_t cascade_count;
+  float texel_size;
+  float depth_bias;
+  uint32_t padding;
+} cascaded_shadow_params_t;
+
+typedef struct cascaded_shadow_cascade_t {
+  vec3 center; /* bounding sphere the projection is fitted to */
+  float radius;
+  bool dirty; /* has to be rendered */
+  WGPUTextureView view;
+} cascaded_shadow_cascade_t;
+
+struct wgpu_cascaded_shadow_map {
+  wgpu_context_t* wgpu_context;
+  uint32_t size;
+  uint32_t dynamic_cascade_count;
+  float split_lambda;
+  float caster_distance;
+  cascaded_shadow_params_t params;
+  cascaded_shadow_cascade_t cascades[WGPU_CASCADED_SHADOW_MAP_MAX_CASCADES];
+  vec3 light_direction;
+  WGPUTexture texture;
+  WGPUTextureView texture_view; /* all cascades */
+  WGPUSampler sampler;
+  wgpu_buffer_t params_buffer;
+  /* View projection of every cascade, CASCADE_STRIDE bytes apart */
+  wgpu_buffer_t cascade_buffer;
+  WGPUBindGroupLayout cascade_bind_group_layout;
+  WGPUBindGroup cascade_bind_group;
+  WGPURenderPipeline pipeline;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* cascaded_shadow_map_wgsl_functions = CODE(
+  struct CascadedShadowParams {
+    viewMatrix : mat4x4<f32>,
+    viewProj : array<mat4x4<f32>, 4>,
+    splitDepths : vec4<f32>,
+    cascadeCount : u32,
+    texelSize : f32,
+    depthBias : f32,
+    padding : u32,
+  };
+
+  fn cascadedShadowGetCascade(worldPosition : vec3<f32>) -> u32 {
+    let viewPosition = shadowParams.viewMatrix * vec4<f32>(worldPosition, 1.0);
+    let depth = -viewPosition.z;
+    var cascade = 0u;
+    for (var i = 0u; i < shadowParams.cascadeCount; i = i + 1u) {
+      if (depth > shadowParams.splitDepths[i]) {
+        cascade = i + 1u;
+      }
+    }
+    return cascade;
+  }
+
+  // 3x3 percentage closer filtering in the cascade of the position
+  fn cascadedShadowGetVisibility(worldPosition : vec3<f32>) -> f32 {
+    let cascade = cascadedShadowGetCascade(worldPosition);
+    if (cascade >= shadowParams.cascadeCount) {
+      return 1.0;
+    }
+    let lightPosition
+      = shadowParams.viewProj[cascade] * vec4<f32>(worldPosition, 1.0);
+    let uv = lightPosition.xy * vec2<f32>(0.5, -0.5) + vec2<f32>(0.5);
+    let depth = lightPosition.z - shadowParams.depthBias;
+    var visibility = 0.0;
+    for (var y = -1; y <= 1; y = y + 1) {
+      for (var x = -1; x <= 1; x = x + 1) {
+        let offset = vec2<f32>(f32(x), f32(y)) * shadowParams.texelSize;
+        visibility = visibility
+                     + textureSampleCompareLevel(shadowMap, shadowSampler,
+                                                 uv + offset, i32(cascade),
+                                                 depth);
+      }
+    }
+    return visibility / 9.0;
+  }
+);
+
+static const char* cascaded_shadow_map_depth_shader_wgsl = CODE(
+  struct Cascade {
+    viewProj : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> cascade : Cascade;
+  @group(1) @binding(0) var<uniform> model : mat4x4<f32>;
+
+  @vertex
+  fn main(@location(0) position : vec3<f32>) -> @builtin(position) vec4<f32> {
+    return cascade.viewProj * model * vec4<f32>(position, 1.0);
+  }
+);
+// clang-format on
+
+/* Right-handed orthographic projection to the [0, 1] depth range of WebGPU */
+static void cascaded_shadow_map_ortho(float left, float right, float bottom,
+                                      float top, float near, float far,
+                                      mat4 dest)
+{
+  glm_mat4_zero(dest);
+  dest[0][0] = 2.0f / (right - left);
+  dest[1][1] = 2.0f / (top - bottom);
+  dest[2][2] = -1.0f / (far - near);
+  dest[3][0] = -(right + left) / (right - left);
+  dest[3][1] = -(top + bottom) / (top - bottom);
+  dest[3][2] = -near / (far - near);
+  dest[3][3] = 1.0f;
+}
+
+static void cascaded_shadow_map_create_textures(
+  wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  wgpu_context_t* wgpu_context = shadow_map->wgpu_context;
+  const uint32_t cascade_count = shadow_map->params.cascade_count;
+
+  WGPUTextureDescriptor texture_desc = {
+    .label         = "cascaded_shadow_map_texture",
+    .size          = (WGPUExtent3D) {
+      .width              = shadow_map->size,
+      .height             = shadow_map->size,
+      .depthOrArrayLayers = cascade_count,
+    },
+    .mipLevelCount = 1,
+    .sampleCount   = 1,
+    .dimension     = WGPUTextureDimension_2D,
+    .format        = WGPUTextureFormat_Depth32Float,
+    .usage
+    = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
+  };
+  shadow_map->texture
+    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+  ASSERT(shadow_map->texture != NULL);
+
+  // The shading passes sample the cascades as an array
+  shadow_map->texture_view = wgpuTextureCreateView(
+    shadow_map->texture, &(WGPUTextureViewDescriptor){
+                           .label     = "cascaded_shadow_map_texture_view",
+                           .dimension = WGPUTextureViewDimension_2DArray,
+                           .format    = WGPUTextureFormat_Depth32Float,
+                           .baseMipLevel    = 0,
+                           .mipLevelCount   = 1,
+                           .baseArrayLayer  = 0,
+                           .arrayLayerCount = cascade_count,
+                           .aspect          = WGPUTextureAspect_All,
+                         });
+  ASSERT(shadow_map->texture_view != NULL);
+
+  // The depth passes render into the layer of their cascade
+  for (uint32_t i = 0; i < cascade_count; ++i) {
+    shadow_map->cascades[i].view = wgpuTextureCreateView(
+      shadow_map->texture, &(WGPUTextureViewDescriptor){
+                             .label     = "cascaded_shadow_map_cascade_view",
+                             .dimension = WGPUTextureViewDimension_2D,
+                             .format    = WGPUTextureFormat_Depth32Float,
+                             .baseMipLevel    = 0,
+                             .mipLevelCount   = 1,
+                             .baseArrayLayer  = i,
+                             .arrayLayerCount = 1,
+                             .aspect          = WGPUTextureAspect_All,
+                           });
+    ASSERT(shadow_map->cascades[i].view != NULL);
+  }
+
+  shadow_map->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "cascaded_shadow_map_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .compare       = WGPUCompareFunction_Less,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(shadow_map->sampler != NULL);
+}
+
+static void cascaded_shadow_map_create_bind_group_layouts(
+  wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  wgpu_context_t* wgpu_context = shadow_map->wgpu_context;
+
+  // Depth passes
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Cascade view projection
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Vertex,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(mat4),
+        },
+        .sampler = {0},
+      },
+    };
+    shadow_map->cascade_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label = "cascaded_shadow_map_cascade_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(shadow_map->cascade_bind_group_layout != NULL);
+  }
+
+  // Shading
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Shadow parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(cascaded_shadow_params_t),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Cascades
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Fragment,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_Depth,
+          .viewDimension = WGPUTextureViewDimension_2DArray,
+          .multisampled  = false,
+        },
+        .storageTexture = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Comparison sampler
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Fragment,
+        .sampler = (WGPUSamplerBindingLayout){
+          .type = WGPUSamplerBindingType_Comparison,
+        },
+        .texture = {0},
+      },
+    };
+    shadow_map->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "cascaded_shadow_map_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(shadow_map->bind_group_layout != NULL);
+  }
+}
+
+static void cascaded_shadow_map_create_bind_groups(
+  wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  wgpu_context_t* wgpu_context = shadow_map->wgpu_context;
+
+  // Depth passes
+  {
+    WGPUBindGroupEntry bg_entries[1] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = shadow_map->cascade_buffer.buffer,
+        .size    = sizeof(mat4),
+      },
+    };
+    shadow_map->cascade_bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "cascaded_shadow_map_cascade_bind_group",
+        .layout     = shadow_map->cascade_bind_group_layout,
+        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+        .entries    = bg_entries,
+      });
+    ASSERT(shadow_map->cascade_bind_group != NULL);
+  }
+
+  // Shading
+  {
+    WGPUBindGroupEntry bg_entries[3] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = shadow_map->params_buffer.buffer,
+        .size    = shadow_map->params_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding     = 1,
+        .textureView = shadow_map->texture_view,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding = 2,
+        .sampler = shadow_map->sampler,
+      },
+    };
+    shadow_map->bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label  = "cascaded_shadow_map_bind_group",
+                              .layout = shadow_map->bind_group_layout,
+                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entries    = bg_entries,
+                            });
+    ASSERT(shadow_map->bind_group != NULL);
+  }
+}
+
+static void
+cascaded_shadow_map_create_pipeline(wgpu_cascaded_shadow_map_t* shadow_map,
+                                    WGPUBindGroupLayout model_layout)
+{
+  wgpu_context_t* wgpu_context = shadow_map->wgpu_context;
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    shadow_map->cascade_bind_group_layout, // Group 0
+    model_layout,                          // Group 1
+  };
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "cascaded_shadow_map_pl",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(pipeline_layout != NULL);
+
+  // Primitive state
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_Back,
+  };
+
+  // Depth stencil state, with a slope scaled bias against shadow acne
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = WGPUTextureFormat_Depth32Float,
+      .depth_write_enabled = true,
+    });
+  depth_stencil_state.depthCompare        = WGPUCompareFunction_Less;
+  depth_stencil_state.depthBiasSlopeScale = 1.5f;
+
+  // Vertex buffer layout, the depth passes only read positions
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    cascade, sizeof(float) * 3,
+    // Attribute location 0: Position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0))
+
+  // Vertex state
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "cascaded_shadow_map_depth_shader",
+                  .wgsl_code.source = cascaded_shadow_map_depth_shader_wgsl,
+                  .entry            = "main",
+                },
+                .buffer_count = 1,
+                .buffers      = &cascade_vertex_buffer_layout,
+              });
+
+  // Multisample state
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  shadow_map->pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label        = "cascaded_shadow_map_pipeline",
+                            .layout       = pipeline_layout,
+                            .primitive    = primitive_state,
+                            .vertex       = vertex_state,
+                            .fragment     = NULL,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(shadow_map->pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_cascaded_shadow_map_t*
+wgpu_cascaded_shadow_map_create(wgpu_context_t* wgpu_context,
+                                const wgpu_cascaded_shadow_map_desc_t* desc)
+{
+  ASSERT(desc->cascade_count <= WGPU_CASCADED_SHADOW_MAP_MAX_CASCADES);
+  ASSERT(desc->split_lambda >= 0.0f && desc->split_lambda <= 1.0f);
+  ASSERT(desc->model_bind_group_layout != NULL);
+
+  wgpu_cascaded_shadow_map_t* shadow_map
+    = (wgpu_cascaded_shadow_map_t*)malloc(sizeof(wgpu_cascaded_shadow_map_t));
+  memset(shadow_map, 0, sizeof(wgpu_cascaded_shadow_map_t));
+  shadow_map->wgpu_context = wgpu_context;
+
+  cascaded_shadow_params_t* params = &shadow_map->params;
+  params->cascade_count
+    = desc->cascade_count > 0 ? desc->cascade_count :
+                                WGPU_CASCADED_SHADOW_MAP_DEFAULT_CASCADE_COUNT;
+  shadow_map->size = desc->size > 0 ? desc->size :
+                                      WGPU_CASCADED_SHADOW_MAP_DEFAULT_SIZE;
+  shadow_map->dynamic_cascade_count
+    = MIN(desc->dynamic_cascade_count > 0 ? desc->dynamic_cascade_count : 1,
+          params->cascade_count);
+  shadow_map->split_lambda    = desc->split_lambda;
+  shadow_map->caster_distance = desc->caster_distance;
+  params->texel_size          = 1.0f / (float)shadow_map->size;
+  params->depth_bias          = CASCADED_SHADOW_MAP_DEPTH_BIAS;
+  for (uint32_t i = 0; i < params->cascade_count; ++i) {
+    shadow_map->cascades[i].dirty = true;
+  }
+
+  shadow_map->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "cascaded_shadow_map_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(cascaded_shadow_params_t),
+                  });
+  shadow_map->cascade_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "cascaded_shadow_map_cascade_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = params->cascade_count * CASCADED_SHADOW_MAP_CASCADE_STRIDE,
+    });
+
+  cascaded_shadow_map_create_textures(shadow_map);
+  cascaded_shadow_map_create_bind_group_layouts(shadow_map);
+  cascaded_shadow_map_create_bind_groups(shadow_map);
+  cascaded_shadow_map_create_pipeline(shadow_map,
+                                      desc->model_bind_group_layout);
+
+  return shadow_map;
+}
+
+void wgpu_cascaded_shadow_map_release(wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  if (shadow_map == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(RenderPipeline, shadow_map->pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, shadow_map->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, shadow_map->cascade_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, shadow_map->bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        shadow_map->cascade_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(Sampler, shadow_map->sampler)
+  for (uint32_t i = 0; i < shadow_map->params.cascade_count; ++i) {
+    WGPU_RELEASE_RESOURCE(TextureView, shadow_map->cascades[i].view)
+  }
+  WGPU_RELEASE_RESOURCE(TextureView, shadow_map->texture_view)
+  WGPU_RELEASE_RESOURCE(Texture, shadow_map->texture)
+  wgpu_destroy_buffer(&shadow_map->cascade_buffer);
+  wgpu_destroy_buffer(&shadow_map->params_buffer);
+  free(shadow_map);
+}
+
+/* Bounding sphere of the part of the view frustum between two view depths */
+static void cascaded_shadow_map_get_bounding_sphere(
+  const wgpu_cascaded_shadow_map_view_t* view, mat4 inverse_view_matrix,
+  float near, float far, vec3 center, float* radius)
+{
+  const float tan_x = 1.0f / view->projection_matrix[0][0];
+  const float tan_y = 1.0f / view->projection_matrix[1][1];
+  const float depths[2] = {near, far};
+
+  vec3 corners[8];
+  glm_vec3_zero(center);
+  for (uint32_t i = 0; i < 8; ++i) {
+    const float depth = depths[i / 4];
+    const float sx    = (i & 1) ? 1.0f : -1.0f;
+    const float sy    = (i & 2) ? 1.0f : -1.0f;
+    glm_mat4_mulv3(inverse_view_matrix,
+                   (vec3){sx * depth * tan_x, sy * depth * tan_y, -depth},
+                   1.0f, corners[i]);
+    glm_vec3_add(center, corners[i], center);
+  }
+  glm_vec3_scale(center, 1.0f / 8.0f, center);
+
+  *radius = 0.0f;
+  for (uint32_t i = 0; i < 8; ++i) {
+    *radius = MAX(*radius, glm_vec3_distance(center, corners[i]));
+  }
+  // Rounded up so that the texel size does not change with the precision
+  *radius = ceilf(*radius * 16.0f) / 16.0f;
+}
+
+void wgpu_cascaded_shadow_map_update(
+  wgpu_cascaded_shadow_map_t* shadow_map,
+  const wgpu_cascaded_shadow_map_view_t* view)
+{
+  cascaded_shadow_params_t* params = &shadow_map->params;
+  const uint32_t cascade_count     = params->cascade_count;
+
+  // All cascades are rendered again when the light turns
+  vec3 light_direction;
+  glm_vec3_normalize_to((float*)view->light_direction, light_direction);
+  if (glm_vec3_dot(light_direction, shadow_map->light_direction) < 0.9999f) {
+    glm_vec3_copy(light_direction, shadow_map->light_direction);
+    wgpu_cascaded_shadow_map_invalidate(shadow_map);
+  }
+
+  // Light space with the world origin at its origin, so that the snapping to
+  // texels does not depend on the camera
+  vec3 up = {0.0f, 1.0f, 0.0f};
+  if (fabsf(light_direction[1]) > 0.99f) {
+    glm_vec3_copy((vec3){0.0f, 0.0f, 1.0f}, up);
+  }
+  mat4 light_view_matrix = GLM_MAT4_IDENTITY_INIT;
+  glm_lookat((vec3){0.0f, 0.0f, 0.0f}, light_direction, up,
+             light_view_matrix);
+
+  mat4 inverse_view_matrix = GLM_MAT4_IDENTITY_INIT;
+  glm_mat4_inv((vec4*)view->view_matrix, inverse_view_matrix);
+  glm_mat4_copy((vec4*)view->view_matrix, params->view_matrix);
+
+  const float z_near = view->z_near, z_far = view->shadow_distance;
+  const float caster_distance
+    = shadow_map->caster_distance > 0.0f ? shadow_map->caster_distance : z_far;
+  float split_near = z_near;
+  for (uint32_t i = 0; i < cascade_count; ++i) {
+    cascaded_shadow_cascade_t* cascade = &shadow_map->cascades[i];
+
+    // Practical split scheme
+    const float p         = (float)(i + 1) / (float)cascade_count;
+    const float log_split = z_near * powf(z_far / z_near, p);
+    const float uni_split = z_near + (z_far - z_near) * p;
+    const float split_far = shadow_map->split_lambda * log_split
+                            + (1.0f - shadow_map->split_lambda) * uni_split;
+    params->split_depths[i] = split_far;
+
+    vec3 center;
+    float radius;
+    cascaded_shadow_map_get_bounding_sphere(view, inverse_view_matrix,
+                                            split_near, split_far, center,
+                                            &radius);
+    split_near = split_far;
+
+    if (i < shadow_map->dynamic_cascade_count) {
+      glm_vec3_copy(center, cascade->center);
+      cascade->radius = radius;
+      cascade->dirty  = true;
+    }
+    else if (cascade->dirty
+             || glm_vec3_distance(center, cascade->center) + radius
+                  > cascade->radius) {
+      // Cached cascades are kept until the frustum leaves their sphere
+      glm_vec3_copy(center, cascade->center);
+      cascade->radius = radius * CASCADED_SHADOW_MAP_CACHE_MARGIN;
+      cascade->dirty  = true;
+    }
+    else {
+      continue;
+    }
+
+    // Orthographic projection around the sphere, with its center snapped to
+    // the texels of the cascade
+    vec3 light_center;
+    glm_mat4_mulv3(light_view_matrix, cascade->center, 1.0f, light_center);
+    const float texel = 2.0f * cascade->radius / (float)shadow_map->size;
+    light_center[0]   = floorf(light_center[0] / texel) * texel;
+    light_center[1]   = floorf(light_center[1] / texel) * texel;
+    mat4 projection_matrix;
+    cascaded_shadow_map_ortho(
+      light_center[0] - cascade->radius, light_center[0] + cascade->radius,
+      light_center[1] - cascade->radius, light_center[1] + cascade->radius,
+      -light_center[2] - cascade->radius - caster_distance,
+      -light_center[2] + cascade->radius, projection_matrix);
+    glm_mat4_mul(projection_matrix, light_view_matrix, params->view_proj[i]);
+
+    wgpuQueueWriteBuffer(shadow_map->wgpu_context->queue,
+                         shadow_map->cascade_buffer.buffer,
+                         i * CASCADED_SHADOW_MAP_CASCADE_STRIDE,
+                         params->view_proj[i], sizeof(mat4));
+  }
+
+  wgpuQueueWriteBuffer(shadow_map->wgpu_context->queue,
+                       shadow_map->params_buffer.buffer, 0, params,
+                       sizeof(*params));
+}
+
+void wgpu_cascaded_shadow_map_invalidate(
+  wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  for (uint32_t i = 0; i < shadow_map->params.cascade_count; ++i) {
+    shadow_map->cascades[i].dirty = true;
+  }
+}
+
+uint32_t wgpu_cascaded_shadow_map_render(
+  wgpu_cascaded_shadow_map_t* shadow_map, WGPUCommandEncoder cmd_encoder,
+  wgpu_cascaded_shadow_map_draw_callback_t draw_callback, void* user_data)
+{
+  uint32_t rendered_count = 0;
+  for (uint32_t i = 0; i < shadow_map->params.cascade_count; ++i) {
+    cascaded_shadow_cascade_t* cascade = &shadow_map->cascades[i];
+    if (!cascade->dirty) {
+      continue;
+    }
+
+    WGPURenderPassDepthStencilAttachment depth_stencil_attachment = {
+      .view            = cascade->view,
+      .depthLoadOp     = WGPULoadOp_Clear,
+      .depthStoreOp    = WGPUStoreOp_Store,
+      .depthClearValue = 1.0f,
+      .clearDepth      = 1.0f,
+      .clearStencil    = 0,
+    };
+    WGPURenderPassEncoder pass_encoder = wgpuCommandEncoderBeginRenderPass(
+      cmd_encoder, &(WGPURenderPassDescriptor){
+                     .label                  = "cascaded_shadow_map_pass",
+                     .colorAttachmentCount   = 0,
+                     .depthStencilAttachment = &depth_stencil_attachment,
+                   });
+    const uint32_t dynamic_offset = i * CASCADED_SHADOW_MAP_CASCADE_STRIDE;
+    wgpuRenderPassEncoderSetPipeline(pass_encoder, shadow_map->pipeline);
+    wgpuRenderPassEncoderSetBindGroup(
+      pass_encoder, 0, shadow_map->cascade_bind_group, 1, &dynamic_offset);
+    draw_callback(pass_encoder, i, i >= shadow_map->dynamic_cascade_count,
+                  user_data);
+    wgpuRenderPassEncoderEnd(pass_encoder);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, pass_encoder)
+
+    cascade->dirty = false;
+    ++rendered_count;
+  }
+  return rendered_count;
+}
+
+WGPUBindGroupLayout wgpu_cascaded_shadow_map_get_bind_group_layout(
+  wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  return shadow_map->bind_group_layout;
+}
+
+WGPUBindGroup
+wgpu_cascaded_shadow_map_get_bind_group(wgpu_cascaded_shadow_map_t* shadow_map)
+{
+  return shadow_map->bind_group;
+}
+
+const char* wgpu_cascaded_shadow_map_get_wgsl_functions(void)
+{
+  return cascaded_shadow_map_wgsl_functions;
+}
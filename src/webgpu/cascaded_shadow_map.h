@@ -0,0 +1,116 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+#define WGPU_CASCADED_SHADOW_MAP_MAX_CASCADES 4u
+
+/* Defaults */
+#define WGPU_CASCADED_SHADOW_MAP_DEFAULT_CASCADE_COUNT 4u
+#define WGPU_CASCADED_SHADOW_MAP_DEFAULT_SIZE 2048u
+
+/*
+ * Cascaded shadow map of a directional light: the view frustum of the camera
+ * up to the shadow distance is split into cascades with the practical split
+ * scheme, a blend of the logarithmic and the uniform split distances. Every
+ * cascade is a layer of a Depth32Float texture array, rendered with an
+ * orthographic projection fitted to the bounding sphere of its part of the
+ * frustum and snapped to the shadow map texels, so that the shadows do not
+ * shimmer when the camera moves.
+ *
+ * The near cascades are rendered every frame. The far cascades are cached:
+ * they are fitted to a sphere with a margin and only re-rendered when the
+ * light direction changes, when the camera leaves the margin or after
+ * wgpu_cascaded_shadow_map_invalidate(). They should only be drawn with the
+ * static geometry of the scene.
+ *
+ * The cascades are rendered with a depth-only pipeline over a position-only
+ * vertex stream, a vec3<f32> at location 0 of the vertex buffer at slot 0:
+ *   @group(0) cascade view projection, set by the shadow map
+ *   @group(1) @binding(0) var<uniform> model : mat4x4<f32>, set by the caller
+ */
+typedef struct wgpu_cascaded_shadow_map wgpu_cascaded_shadow_map_t;
+
+typedef struct wgpu_cascaded_shadow_map_desc_t {
+  /* Number of cascades up to WGPU_CASCADED_SHADOW_MAP_MAX_CASCADES, 0 selects
+   * the default */
+  uint32_t cascade_count;
+  /* Width and height of the cascades in texels, 0 selects the default */
+  uint32_t size;
+  /* Weight of the logarithmic split distances, 0 gives uniform splits */
+  float split_lambda;
+  /* Number of near cascades rendered every frame, 0 selects one */
+  uint32_t dynamic_cascade_count;
+  /* Distance from the cascades towards the light that casters are rendered
+   * from, 0 selects the shadow distance */
+  float caster_distance;
+  /* Layout of the model matrix at group 1 of the depth-only pipeline */
+  WGPUBindGroupLayout model_bind_group_layout;
+} wgpu_cascaded_shadow_map_desc_t;
+
+/* Camera and light of the frame the cascades are fitted for */
+typedef struct wgpu_cascaded_shadow_map_view_t {
+  mat4 view_matrix;
+  mat4 projection_matrix; /* perspective projection looking along -z */
+  float z_near;
+  float shadow_distance; /* no shadows beyond, at most the far plane */
+  vec3 light_direction;  /* direction the light shines to */
+} wgpu_cascaded_shadow_map_view_t;
+
+/* Called by wgpu_cascaded_shadow_map_render() for every cascade to render,
+ * with the depth-only pipeline and its group 0 set. static_only is set for
+ * the cached cascades. */
+typedef void (*wgpu_cascaded_shadow_map_draw_callback_t)(
+  WGPURenderPassEncoder pass_encoder, uint32_t cascade, bool static_only,
+  void* user_data);
+
+/* Cascaded shadow map creating/releasing */
+wgpu_cascaded_shadow_map_t*
+wgpu_cascaded_shadow_map_create(wgpu_context_t* wgpu_context,
+                                const wgpu_cascaded_shadow_map_desc_t* desc);
+void wgpu_cascaded_shadow_map_release(wgpu_cascaded_shadow_map_t* shadow_map);
+
+/* Fits the cascades to the camera and writes their parameters */
+void wgpu_cascaded_shadow_map_update(
+  wgpu_cascaded_shadow_map_t* shadow_map,
+  const wgpu_cascaded_shadow_map_view_t* view);
+
+/* Marks the cached cascades for re-rendering, e.g. when static geometry has
+ * been added, removed or moved */
+void wgpu_cascaded_shadow_map_invalidate(
+  wgpu_cascaded_shadow_map_t* shadow_map);
+
+/**
+ * @brief Records a depth pass for each cascade which has to be rendered in
+ * this frame. The shading passes of the frame have to be recorded afterwards.
+ * Returns the number of rendered cascades.
+ */
+uint32_t wgpu_cascaded_shadow_map_render(
+  wgpu_cascaded_shadow_map_t* shadow_map, WGPUCommandEncoder cmd_encoder,
+  wgpu_cascaded_shadow_map_draw_callback_t draw_callback, void* user_data);
+
+/*
+ * Bind group of the shading passes, visible from fragment shaders:
+ *   binding 0: var<uniform> shadowParams : CascadedShadowParams
+ *   binding 1: var shadowMap : texture_depth_2d_array
+ *   binding 2: var shadowSampler : sampler_comparison
+ */
+WGPUBindGroupLayout wgpu_cascaded_shadow_map_get_bind_group_layout(
+  wgpu_cascaded_shadow_map_t* shadow_map);
+WGPUBindGroup
+wgpu_cascaded_shadow_map_get_bind_group(wgpu_cascaded_shadow_map_t* shadow_map);
+
+/*
+ * WGSL shadow lookup functions for shading passes, to be prepended to their
+ * source. The shader declares the bindings of the bind group above with the
+ * names shadowParams, shadowMap and shadowSampler. The cascade is
+ * shadowParams.cascadeCount beyond the shadow distance, where the visibility
+ * is 1.0:
+ *   fn cascadedShadowGetCascade(worldPosition : vec3<f32>) -> u32
+ *   fn cascadedShadowGetVisibility(worldPosition : vec3<f32>) -> f32
+ */
+const char* wgpu_cascaded_shadow_map_get_wgsl_functions(void);
+
+#endif
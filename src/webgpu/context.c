@@ -8,11 +8,28 @@
 #include "../core/platform.h"
 #include "../core/window.h"
 
+#include "../webgpu/api_trace.h"
+#include "../webgpu/bind_group_cache.h"
 #include "../webgpu/buffer.h"
+#include "../webgpu/dynamic_resolution.h"
+#include "../webgpu/frame_uniforms.h"
+#include "../webgpu/gpu_profiler.h"
+#include "../webgpu/memory_tracker.h"
+#include "../webgpu/pipeline_statistics.h"
+#include "../webgpu/offscreen_swap_chain.h"
+#include "../webgpu/pipeline_cache.h"
+#include "../webgpu/render_bundle_cache.h"
+#include "../webgpu/sampler_cache.h"
+#include "../webgpu/shader.h"
 #include "../webgpu/texture.h"
+#include "../webgpu/upload_scheduler.h"
 
 #include "../../lib/wgpu_native/wgpu_native.h"
 
+/* Forward declarations */
+static void
+wgpu_queue_write_batch_destroy(struct wgpu_queue_write_batch_t* write_batch);
+
 /* WebGPU context creating/releasing */
 wgpu_context_t* wgpu_context_create(wgpu_context_create_options_t* options)
 {
@@ -23,6 +40,60 @@ wgpu_context_t* wgpu_context_create(wgpu_context_create_options_t* options)
     = options ?
         (options->vsync ? WGPUPresentMode_Fifo : WGPUPresentMode_Mailbox) :
         WGPUPresentMode_Mailbox;
+  if (options != NULL) {
+    switch (options->present_mode) {
+      case PresentMode_Fifo:
+        context->swap_chain.present_mode = WGPUPresentMode_Fifo;
+        break;
+      case PresentMode_Mailbox:
+        context->swap_chain.present_mode = WGPUPresentMode_Mailbox;
+        break;
+      case PresentMode_Immediate:
+        context->swap_chain.present_mode = WGPUPresentMode_Immediate;
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (options != NULL) {
+    context->device_requirements.power_preference = options->power_preference;
+    context->device_requirements.adapter_selection = options->adapter_selection;
+    context->device_requirements.feature_count
+      = MIN(options->required_feature_count, WGPU_FEATURE_COUNT);
+    for (uint32_t i = 0; i < context->device_requirements.feature_count; ++i) {
+      context->device_requirements.features[i] = options->required_features[i];
+    }
+    context->device_requirements.limits      = options->required_limits;
+    context->device_requirements.gpu_queries = options->gpu_queries;
+    context->depth_stencil.reversed_z        = options->reversed_z;
+  }
+
+  const uint32_t frames_in_flight
+    = (options && options->frames_in_flight > 0) ?
+        options->frames_in_flight :
+        WGPU_DEFAULT_FRAMES_IN_FLIGHT;
+  context->frames.count = MIN(frames_in_flight, WGPU_MAX_FRAMES_IN_FLIGHT);
+  for (uint32_t i = 0; i < WGPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+    context->frames.slots[i].wgpu_context = context;
+  }
+
+  /* Account the memory of the resources, from before the device exists */
+  wgpu_memory_tracker_enable();
+  wgpu_memory_tracker_set_budget(options ? options->memory_budget : 0);
+  context->lifetime_tracking.enabled = options && options->track_lifetimes;
+  context->lifetime_tracking.first_creation
+    = wgpu_memory_tracker_get_creation_count();
+  wgpu_memory_tracker_set_lifetime_tracking(context->lifetime_tracking.enabled);
+
+  /* Driven by the GPU frame times, see wgpu_end_frame */
+  if (options != NULL && options->target_gpu_frame_time_ms > 0.0f) {
+    context->dynamic_resolution = wgpu_dynamic_resolution_create(
+      &(wgpu_dynamic_resolution_desc_t){
+        .target_frame_time_ms = options->target_gpu_frame_time_ms,
+        .min_scale            = options->min_resolution_scale,
+      });
+  }
 
   return context;
 }
@@ -34,15 +105,128 @@ void wgpu_context_release(wgpu_context_t* wgpu_context)
     wgpu_context->texture_client = NULL;
   }
 
+  if (wgpu_context->gpu_profiler != NULL) {
+    wgpu_gpu_profiler_release(wgpu_context->gpu_profiler);
+    wgpu_context->gpu_profiler = NULL;
+  }
+
+  if (wgpu_context->dynamic_resolution != NULL) {
+    wgpu_dynamic_resolution_release(wgpu_context->dynamic_resolution);
+    wgpu_context->dynamic_resolution = NULL;
+  }
+
+  if (wgpu_context->pipeline_statistics != NULL) {
+    wgpu_pipeline_statistics_release(wgpu_context->pipeline_statistics);
+    wgpu_context->pipeline_statistics = NULL;
+  }
+
+  if (wgpu_context->staging_ring != NULL) {
+    wgpu_staging_ring_destroy(wgpu_context->staging_ring);
+    wgpu_context->staging_ring = NULL;
+  }
+
+  if (wgpu_context->upload_scheduler != NULL) {
+    wgpu_upload_scheduler_release(wgpu_context->upload_scheduler);
+    wgpu_context->upload_scheduler = NULL;
+  }
+
+  if (wgpu_context->write_batch != NULL) {
+    wgpu_queue_write_batch_destroy(wgpu_context->write_batch);
+    wgpu_context->write_batch = NULL;
+  }
+
+  linear_arena_release(&wgpu_context->frame_arena);
+
+  wgpu_frame_uniforms_destroy(wgpu_context->frame_uniforms);
+  wgpu_context->frame_uniforms = NULL;
+
+  if (wgpu_context->render_bundle_cache != NULL) {
+    wgpu_render_bundle_cache_destroy(wgpu_context->render_bundle_cache);
+    wgpu_context->render_bundle_cache = NULL;
+  }
+
+  if (wgpu_context->bind_group_cache != NULL) {
+    wgpu_bind_group_cache_destroy(wgpu_context->bind_group_cache);
+    wgpu_context->bind_group_cache = NULL;
+  }
+
+  if (wgpu_context->pipeline_cache != NULL) {
+    wgpu_pipeline_cache_destroy(wgpu_context->pipeline_cache);
+    wgpu_context->pipeline_cache = NULL;
+  }
+
+  if (wgpu_context->sampler_cache != NULL) {
+    wgpu_sampler_cache_destroy(wgpu_context->sampler_cache);
+    wgpu_context->sampler_cache = NULL;
+  }
+
+  if (wgpu_context->shader_cache != NULL) {
+    wgpu_shader_cache_destroy(wgpu_context->shader_cache);
+    wgpu_context->shader_cache = NULL;
+  }
+
+  for (uint32_t i = 0; i < WGPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+    WGPU_RELEASE_RESOURCE(Buffer, wgpu_context->frames.slots[i].uniforms.buffer)
+  }
+
   WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->depth_stencil.texture_view);
+  WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->depth_stencil.depth_view);
   WGPU_RELEASE_RESOURCE(Texture, wgpu_context->depth_stencil.texture);
+  WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->msaa.color_view);
+  WGPU_RELEASE_RESOURCE(Texture, wgpu_context->msaa.color_texture);
+  WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->msaa.depth_view);
+  WGPU_RELEASE_RESOURCE(Texture, wgpu_context->msaa.depth_texture);
+  if (wgpu_context->offscreen_swap_chain != NULL) {
+    wgpu_offscreen_swap_chain_release(wgpu_context->offscreen_swap_chain);
+    wgpu_context->offscreen_swap_chain = NULL;
+  }
   WGPU_RELEASE_RESOURCE(SwapChain, wgpu_context->swap_chain.instance);
+
+  /* Everything the context and the example created is released by now */
+  if (wgpu_context->lifetime_tracking.enabled) {
+    wgpu_memory_tracker_report_live(
+      wgpu_context->lifetime_tracking.first_creation);
+    wgpu_memory_tracker_set_lifetime_tracking(false);
+  }
+
   WGPU_RELEASE_RESOURCE(Queue, wgpu_context->queue);
   WGPU_RELEASE_RESOURCE(Device, wgpu_context->device);
 
   free(wgpu_context);
 }
 
+void wgpu_context_reset(wgpu_context_t* wgpu_context)
+{
+  wgpu_wait_for_submitted_work(wgpu_context);
+
+  /* The batched writes and the uploads target resources of the application,
+   * they are dropped with it */
+  if (wgpu_context->upload_scheduler != NULL) {
+    wgpu_upload_scheduler_release(wgpu_context->upload_scheduler);
+    wgpu_context->upload_scheduler = NULL;
+  }
+
+  if (wgpu_context->write_batch != NULL) {
+    wgpu_queue_write_batch_destroy(wgpu_context->write_batch);
+    wgpu_context->write_batch = NULL;
+  }
+  memset(&wgpu_context->write_stats, 0, sizeof(wgpu_context->write_stats));
+
+  /* The next application starts at the full resolution */
+  wgpu_dynamic_resolution_reset(wgpu_context->dynamic_resolution);
+
+  if (wgpu_context->render_bundle_cache != NULL) {
+    wgpu_render_bundle_cache_destroy(wgpu_context->render_bundle_cache);
+    wgpu_context->render_bundle_cache = NULL;
+  }
+
+  wgpu_bind_group_cache_invalidate(wgpu_context->depth_stencil.texture_view);
+  wgpu_bind_group_cache_invalidate(wgpu_context->depth_stencil.depth_view);
+  WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->depth_stencil.texture_view);
+  WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->depth_stencil.depth_view);
+  WGPU_RELEASE_RESOURCE(Texture, wgpu_context->depth_stencil.texture);
+}
+
 /* WebGPU info functions */
 void wgpu_get_context_info(char (*adapter_info)[256])
 {
@@ -64,22 +248,166 @@ WGPUBuffer wgpu_create_buffer_from_data(wgpu_context_t* wgpu_context,
   return buffer;
 }
 
+static bool wgpu_feature_is_required(const WGPUFeatureName* features,
+                                     uint32_t feature_count,
+                                     WGPUFeatureName feature)
+{
+  for (uint32_t i = 0; i < feature_count; ++i) {
+    if (features[i] == feature) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Requested limit clamped to the supported one, warns when clamped */
+#define WGPU_REQUIRED_LIMIT(name, requested)                                   \
+  if ((requested) > 0) {                                                       \
+    limits->limits.name = MIN((requested), supported.limits.name);             \
+    if ((requested) > supported.limits.name) {                                 \
+      log_warn("Required limit " #name " of %llu clamped to %llu",             \
+               (unsigned long long)(requested),                                \
+               (unsigned long long)supported.limits.name);                     \
+    }                                                                          \
+    has_limits = true;                                                         \
+  }
+
+/* Fills the required limits of the device, returns false when only the
+ * default limits are required */
+static bool wgpu_get_required_limits(wgpu_context_t* wgpu_context,
+                                     const wgpu_required_limits_t* requested,
+                                     WGPURequiredLimits* limits)
+{
+  WGPUSupportedLimits supported = {0};
+  if (!wgpuAdapterGetLimits(wgpu_context->adapter, &supported)) {
+    return false;
+  }
+
+  /* All bytes set marks every limit as undefined, WGPU_LIMIT_U32_UNDEFINED
+   * and WGPU_LIMIT_U64_UNDEFINED, the device then uses the default ones */
+  memset(&limits->limits, 0xFF, sizeof(limits->limits));
+  bool has_limits = false;
+  WGPU_REQUIRED_LIMIT(maxStorageBufferBindingSize,
+                      requested->max_storage_buffer_binding_size)
+  WGPU_REQUIRED_LIMIT(maxComputeWorkgroupStorageSize,
+                      requested->max_compute_workgroup_storage_size)
+  WGPU_REQUIRED_LIMIT(maxComputeInvocationsPerWorkgroup,
+                      requested->max_compute_invocations_per_workgroup)
+  WGPU_REQUIRED_LIMIT(maxComputeWorkgroupSizeX,
+                      requested->max_compute_workgroup_size_x)
+  return has_limits;
+}
+
+#undef WGPU_REQUIRED_LIMIT
+
 void wgpu_create_device_and_queue(wgpu_context_t* wgpu_context)
 {
+  /* Persist compiled shaders / pipelines between runs */
+  wgpu_enable_pipeline_cache(WGPU_PIPELINE_CACHE_DIRECTORY);
+
   wgpu_log_available_adapters();
 
   /* WebGPU adapter creation */
-  wgpu_context->adapter = wgpu_request_adapter(&(WGPURequestAdapterOptions){
-    .powerPreference = WGPUPowerPreference_HighPerformance,
-  });
+  const WGPUPowerPreference power_preference
+    = wgpu_context->device_requirements.power_preference
+          != WGPUPowerPreference_Undefined ?
+        wgpu_context->device_requirements.power_preference :
+        WGPUPowerPreference_HighPerformance;
+  wgpu_context->adapter = wgpu_request_adapter_with_selection(
+    &(WGPURequestAdapterOptions){
+      .powerPreference = power_preference,
+    },
+    wgpu_context->device_requirements.adapter_selection);
+  if (wgpu_context->adapter == NULL) {
+    log_fatal("No adapter matches the adapter selection");
+  }
+  ASSERT(wgpu_context->adapter != NULL);
 
   /* WebGPU device creation */
-  WGPUFeatureName required_features[1] = {
-    WGPUFeatureName_TextureCompressionBC,
+  WGPUFeatureName required_features[6 + WGPU_FEATURE_COUNT] = {0};
+  uint32_t required_feature_count = 0;
+  /* BC compressed textures are transcoded to other formats when missing */
+  if (wgpuAdapterHasFeature(wgpu_context->adapter,
+                            WGPUFeatureName_TextureCompressionBC)) {
+    required_features[required_feature_count++]
+      = WGPUFeatureName_TextureCompressionBC;
+  }
+  /* Timestamp queries are used by the GPU profiler when requested */
+  const bool gpu_queries = wgpu_context->device_requirements.gpu_queries;
+  if (gpu_queries
+      && wgpuAdapterHasFeature(wgpu_context->adapter,
+                               WGPUFeatureName_TimestampQuery)) {
+    required_features[required_feature_count++]
+      = WGPUFeatureName_TimestampQuery;
+  }
+  /* And pipeline statistics queries by the pipeline statistics collector */
+  if (gpu_queries
+      && wgpuAdapterHasFeature(wgpu_context->adapter,
+                               WGPUFeatureName_PipelineStatisticsQuery)) {
+    required_features[required_feature_count++]
+      = WGPUFeatureName_PipelineStatisticsQuery;
+  }
+  /* Half precision shaders use f16 when available (see
+   * wgpu_shader_desc_t.half_precision) */
+  if (wgpuAdapterHasFeature(wgpu_context->adapter,
+                            WGPUFeatureName_DawnShaderFloat16)) {
+    required_features[required_feature_count++]
+      = WGPUFeatureName_DawnShaderFloat16;
+  }
+  /* Packed float HDR render targets (see wgpu_has_feature) */
+  if (wgpuAdapterHasFeature(wgpu_context->adapter,
+                            WGPUFeatureName_RG11B10UfloatRenderable)) {
+    required_features[required_feature_count++]
+      = WGPUFeatureName_RG11B10UfloatRenderable;
+  }
+  /* The reversed-Z depth is stored with stencil when available */
+  if (wgpu_context->depth_stencil.reversed_z
+      && wgpuAdapterHasFeature(wgpu_context->adapter,
+                               WGPUFeatureName_Depth32FloatStencil8)) {
+    required_features[required_feature_count++]
+      = WGPUFeatureName_Depth32FloatStencil8;
+  }
+  /* Features of the creation options */
+  for (uint32_t i = 0; i < wgpu_context->device_requirements.feature_count;
+       ++i) {
+    const WGPUFeatureName feature
+      = wgpu_context->device_requirements.features[i];
+    if (wgpu_feature_is_required(required_features, required_feature_count,
+                                 feature)) {
+      continue;
+    }
+    if (!wgpuAdapterHasFeature(wgpu_context->adapter, feature)) {
+      log_warn("Required feature %d is not supported by the adapter",
+               feature);
+      continue;
+    }
+    required_features[required_feature_count++] = feature;
+  }
+  WGPURequiredLimits required_limits = {0};
+  const bool has_required_limits     = wgpu_get_required_limits(
+    wgpu_context, &wgpu_context->device_requirements.limits, &required_limits);
+  /* Timestamp and pipeline statistics queries are only exposed with unsafe
+   * APIs allowed, which stay disallowed for the devices without them */
+  const bool allow_unsafe_apis
+    = wgpu_feature_is_required(required_features, required_feature_count,
+                               WGPUFeatureName_TimestampQuery)
+      || wgpu_feature_is_required(required_features, required_feature_count,
+                                  WGPUFeatureName_PipelineStatisticsQuery);
+  static const char* const disabled_toggles[1] = {
+    "disallow_unsafe_apis",
+  };
+  WGPUDawnTogglesDeviceDescriptor toggles_desc = {
+    .chain.sType               = WGPUSType_DawnTogglesDeviceDescriptor,
+    .forceDisabledTogglesCount = (uint32_t)ARRAY_SIZE(disabled_toggles),
+    .forceDisabledToggles      = disabled_toggles,
   };
+  WGPUChainedStruct const* toggles_chain
+    = allow_unsafe_apis ? (WGPUChainedStruct const*)&toggles_desc : NULL;
   WGPUDeviceDescriptor deviceDescriptor = {
-    .requiredFeaturesCount = (uint32_t)ARRAY_SIZE(required_features),
+    .nextInChain           = toggles_chain,
+    .requiredFeaturesCount = required_feature_count,
     .requiredFeatures      = required_features,
+    .requiredLimits        = has_required_limits ? &required_limits : NULL,
   };
   wgpu_context->device
     = wgpuAdapterCreateDevice(wgpu_context->adapter, &deviceDescriptor);
@@ -99,6 +427,7 @@ void wgpu_create_device_and_queue(wgpu_context_t* wgpu_context)
     WGPUFeatureName_DawnShaderFloat16,
     WGPUFeatureName_DawnInternalUsages,
     WGPUFeatureName_DawnMultiPlanarFormats,
+    WGPUFeatureName_RG11B10UfloatRenderable,
   };
   for (uint32_t i = 0; i < WGPU_FEATURE_COUNT; ++i) {
     wgpu_context->features[i].feature_name = feature_names[i];
@@ -130,24 +459,81 @@ void wgpu_setup_window_surface(wgpu_context_t* wgpu_context, void* window)
                   &wgpu_context->surface.height);
 }
 
+WGPUTextureFormat wgpu_get_depth_format(wgpu_context_t* wgpu_context)
+{
+  if (!wgpu_context->depth_stencil.reversed_z) {
+    return WGPUTextureFormat_Depth24PlusStencil8;
+  }
+  return wgpu_has_feature(wgpu_context, WGPUFeatureName_Depth32FloatStencil8) ?
+           WGPUTextureFormat_Depth32FloatStencil8 :
+           WGPUTextureFormat_Depth32Float;
+}
+
+WGPUCompareFunction wgpu_get_depth_compare(wgpu_context_t* wgpu_context,
+                                           bool or_equal)
+{
+  if (wgpu_context->depth_stencil.reversed_z) {
+    return or_equal ? WGPUCompareFunction_GreaterEqual :
+                      WGPUCompareFunction_Greater;
+  }
+  return or_equal ? WGPUCompareFunction_LessEqual : WGPUCompareFunction_Less;
+}
+
+float wgpu_get_depth_clear_value(wgpu_context_t* wgpu_context)
+{
+  return wgpu_context->depth_stencil.reversed_z ? 0.0f : 1.0f;
+}
+
+static bool wgpu_depth_format_has_stencil(WGPUTextureFormat format)
+{
+  return format == WGPUTextureFormat_Depth24PlusStencil8
+         || format == WGPUTextureFormat_Depth32FloatStencil8;
+}
+
 void wgpu_setup_deph_stencil(
   wgpu_context_t* wgpu_context,
   struct deph_stencil_texture_creation_options_t* options)
 {
-  if ((wgpu_context->depth_stencil.texture != NULL)
-      && (wgpu_context->depth_stencil.texture_view != NULL)) {
-    return;
-  }
-
-  WGPUTextureFormat format = options != NULL ?
-                               (options->format != WGPUTextureFormat_Undefined ?
-                                  options->format :
-                                  WGPUTextureFormat_Depth24PlusStencil8) :
-                               WGPUTextureFormat_Depth24PlusStencil8;
+  WGPUTextureFormat format
+    = (options != NULL && options->format != WGPUTextureFormat_Undefined) ?
+        options->format :
+        wgpu_get_depth_format(wgpu_context);
   uint32_t sample_count = options != NULL ? MAX(1, options->sample_count) : 1;
+  const bool sampled    = options != NULL && options->sampled;
+  const bool copy_src   = options != NULL && options->copy_src;
+
+  /* Keep the existing texture unless the surface was resized or the options
+   * changed */
+  const bool recreate = wgpu_context->depth_stencil.texture != NULL;
+  if (recreate) {
+    if (wgpu_context->depth_stencil.width == wgpu_context->surface.width
+        && wgpu_context->depth_stencil.height == wgpu_context->surface.height
+        && wgpu_context->depth_stencil.format == format
+        && wgpu_context->depth_stencil.sample_count == sample_count
+        && wgpu_context->depth_stencil.sampled == sampled
+        && wgpu_context->depth_stencil.copy_src == copy_src) {
+      return;
+    }
+    wgpu_bind_group_cache_invalidate(wgpu_context->depth_stencil.texture_view);
+    wgpu_bind_group_cache_invalidate(wgpu_context->depth_stencil.depth_view);
+    WGPU_RELEASE_RESOURCE(TextureView,
+                          wgpu_context->depth_stencil.texture_view);
+    WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->depth_stencil.depth_view);
+    WGPU_RELEASE_RESOURCE(Texture, wgpu_context->depth_stencil.texture);
+  }
+  wgpu_context->depth_stencil.format       = format;
+  wgpu_context->depth_stencil.sample_count = sample_count;
+  wgpu_context->depth_stencil.sampled      = sampled;
+  wgpu_context->depth_stencil.copy_src     = copy_src;
+  wgpu_context->depth_stencil.width        = wgpu_context->surface.width;
+  wgpu_context->depth_stencil.height       = wgpu_context->surface.height;
 
   WGPUTextureDescriptor depth_texture_desc = {
-    .usage         = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+    .usage         = WGPUTextureUsage_RenderAttachment
+                     | (sampled ? WGPUTextureUsage_TextureBinding :
+                                  WGPUTextureUsage_None)
+                     | (copy_src ? WGPUTextureUsage_CopySrc :
+                                   WGPUTextureUsage_None),
     .format        = format,
     .dimension     = WGPUTextureDimension_2D,
     .mipLevelCount = 1,
@@ -173,25 +559,162 @@ void wgpu_setup_deph_stencil(
   wgpu_context->depth_stencil.texture_view = wgpuTextureCreateView(
     wgpu_context->depth_stencil.texture, &depth_texture_view_dec);
 
+  /* Combined depth-stencil views cannot be bound as textures */
+  if (sampled && sample_count == 1) {
+    depth_texture_view_dec.aspect = WGPUTextureAspect_DepthOnly;
+    wgpu_context->depth_stencil.depth_view = wgpuTextureCreateView(
+      wgpu_context->depth_stencil.texture, &depth_texture_view_dec);
+  }
+
+  /* The read-only aspects are loaded and kept as they are */
+  wgpu_context->depth_stencil.read_only_att_desc
+    = (WGPURenderPassDepthStencilAttachment){
+      .view            = wgpu_context->depth_stencil.texture_view,
+      .depthLoadOp     = WGPULoadOp_Load,
+      .depthStoreOp    = WGPUStoreOp_Store,
+      .depthReadOnly   = true,
+      .stencilReadOnly = true,
+    };
+  if (wgpu_depth_format_has_stencil(format)) {
+    wgpu_context->depth_stencil.read_only_att_desc.stencilLoadOp
+      = WGPULoadOp_Load;
+    wgpu_context->depth_stencil.read_only_att_desc.stencilStoreOp
+      = WGPUStoreOp_Store;
+  }
+
+  /* Render pass descriptors point to the attachment and may have changed its
+   * clear values, so a resize only replaces the view */
+  if (recreate) {
+    wgpu_context->depth_stencil.att_desc.view
+      = wgpu_context->depth_stencil.texture_view;
+    return;
+  }
+
   wgpu_context->depth_stencil.att_desc = (WGPURenderPassDepthStencilAttachment){
     .view            = wgpu_context->depth_stencil.texture_view,
     .depthLoadOp     = WGPULoadOp_Clear,
     .depthStoreOp    = WGPUStoreOp_Store,
-    .depthClearValue = 1.0f,
-    .clearDepth      = 1.0f,
+    .depthClearValue = wgpu_get_depth_clear_value(wgpu_context),
+    .clearDepth      = wgpu_get_depth_clear_value(wgpu_context),
     .clearStencil    = 0,
   };
 
   // stencilLoadOp & stencilStoreOp must be set if the attachment has stencil
   // aspect or stencilReadOnly is false
-  if (format == WGPUTextureFormat_Depth24PlusStencil8) {
+  if (wgpu_depth_format_has_stencil(format)) {
     wgpu_context->depth_stencil.att_desc.stencilLoadOp  = WGPULoadOp_Clear;
     wgpu_context->depth_stencil.att_desc.stencilStoreOp = WGPUStoreOp_Store;
   }
 }
 
+static WGPUTexture wgpu_create_msaa_attachment(wgpu_context_t* wgpu_context,
+                                               const char* label,
+                                               WGPUTextureFormat format,
+                                               WGPUTextureView* view)
+{
+  WGPUTexture texture = wgpuDeviceCreateTexture(
+    wgpu_context->device, &(WGPUTextureDescriptor){
+                            .label         = label,
+                            .usage         = WGPUTextureUsage_RenderAttachment,
+                            .format        = format,
+                            .dimension     = WGPUTextureDimension_2D,
+                            .mipLevelCount = 1,
+                            .sampleCount   = wgpu_context->msaa.sample_count,
+                            .size          = (WGPUExtent3D){
+                              .width              = wgpu_context->msaa.width,
+                              .height             = wgpu_context->msaa.height,
+                              .depthOrArrayLayers = 1,
+                            },
+                          });
+  ASSERT(texture != NULL);
+  *view = wgpuTextureCreateView(texture, NULL);
+  ASSERT(*view != NULL);
+  return texture;
+}
+
+void wgpu_setup_msaa_attachments(wgpu_context_t* wgpu_context,
+                                 const wgpu_msaa_attachments_options_t* options)
+{
+  const uint32_t sample_count
+    = options != NULL && options->sample_count > 0 ? options->sample_count :
+                                                     4;
+  const WGPUTextureFormat color_format
+    = options != NULL && options->color_format != WGPUTextureFormat_Undefined ?
+        options->color_format :
+        wgpu_context->swap_chain.format;
+  const WGPUTextureFormat depth_format
+    = options != NULL ? options->depth_format : WGPUTextureFormat_Undefined;
+
+  /* Shared with the previous applications when the options match */
+  const bool recreate = wgpu_context->msaa.color_texture != NULL;
+  if (recreate) {
+    if (wgpu_context->msaa.width == wgpu_context->surface.width
+        && wgpu_context->msaa.height == wgpu_context->surface.height
+        && wgpu_context->msaa.sample_count == sample_count
+        && wgpu_context->msaa.color_format == color_format
+        && wgpu_context->msaa.depth_format == depth_format) {
+      return;
+    }
+    WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->msaa.color_view);
+    WGPU_RELEASE_RESOURCE(Texture, wgpu_context->msaa.color_texture);
+    WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->msaa.depth_view);
+    WGPU_RELEASE_RESOURCE(Texture, wgpu_context->msaa.depth_texture);
+  }
+  wgpu_context->msaa.sample_count = sample_count;
+  wgpu_context->msaa.color_format = color_format;
+  wgpu_context->msaa.depth_format = depth_format;
+  wgpu_context->msaa.width        = wgpu_context->surface.width;
+  wgpu_context->msaa.height       = wgpu_context->surface.height;
+
+  wgpu_context->msaa.color_texture = wgpu_create_msaa_attachment(
+    wgpu_context, "msaa_color_texture", color_format,
+    &wgpu_context->msaa.color_view);
+  if (depth_format != WGPUTextureFormat_Undefined) {
+    wgpu_context->msaa.depth_texture = wgpu_create_msaa_attachment(
+      wgpu_context, "msaa_depth_texture", depth_format,
+      &wgpu_context->msaa.depth_view);
+  }
+
+  /* Render pass descriptors point to the attachments and may have changed
+   * their clear values, so a recreate only replaces the views */
+  if (recreate) {
+    wgpu_context->msaa.color_att_desc.view = wgpu_context->msaa.color_view;
+    wgpu_context->msaa.depth_att_desc.view = wgpu_context->msaa.depth_view;
+    return;
+  }
+
+  /* Only the resolved frame buffer is stored */
+  wgpu_context->msaa.color_att_desc = (WGPURenderPassColorAttachment){
+    .view          = wgpu_context->msaa.color_view,
+    .resolveTarget = NULL,
+    .loadOp        = WGPULoadOp_Clear,
+    .storeOp       = WGPUStoreOp_Discard,
+    .clearValue    = (WGPUColor){0.0f, 0.0f, 0.0f, 1.0f},
+  };
+  wgpu_context->msaa.depth_att_desc = (WGPURenderPassDepthStencilAttachment){
+    .view            = wgpu_context->msaa.depth_view,
+    .depthLoadOp     = WGPULoadOp_Clear,
+    .depthStoreOp    = WGPUStoreOp_Discard,
+    .depthClearValue = wgpu_get_depth_clear_value(wgpu_context),
+    .clearDepth      = wgpu_get_depth_clear_value(wgpu_context),
+    .clearStencil    = 0,
+  };
+  if (wgpu_depth_format_has_stencil(depth_format)) {
+    wgpu_context->msaa.depth_att_desc.stencilLoadOp  = WGPULoadOp_Clear;
+    wgpu_context->msaa.depth_att_desc.stencilStoreOp = WGPUStoreOp_Discard;
+  }
+}
+
 void wgpu_setup_swap_chain(wgpu_context_t* wgpu_context)
 {
+  /* Headless rendering, the offscreen images follow the surface size */
+  if (wgpu_context->offscreen_swap_chain != NULL) {
+    wgpu_offscreen_swap_chain_resize(wgpu_context->offscreen_swap_chain,
+                                     wgpu_context->surface.width,
+                                     wgpu_context->surface.height);
+    return;
+  }
+
   /* Create the swap chain */
   WGPUSwapChainDescriptor swap_chain_descriptor = {
     .usage       = WGPUTextureUsage_RenderAttachment,
@@ -212,6 +735,56 @@ void wgpu_setup_swap_chain(wgpu_context_t* wgpu_context)
   wgpu_context->swap_chain.format = swap_chain_descriptor.format;
 }
 
+const char* wgpu_get_present_mode_name(WGPUPresentMode present_mode)
+{
+  switch (present_mode) {
+    case WGPUPresentMode_Immediate:
+      return "Immediate";
+    case WGPUPresentMode_Mailbox:
+      return "Mailbox";
+    case WGPUPresentMode_Fifo:
+      return "Fifo";
+    default:
+      return "Unknown";
+  }
+}
+
+bool wgpu_resize_surface(wgpu_context_t* wgpu_context, uint32_t width,
+                         uint32_t height)
+{
+  if ((width == 0 || height == 0)
+      || (width == wgpu_context->surface.width
+          && height == wgpu_context->surface.height)) {
+    return false;
+  }
+  wgpu_context->surface.width  = width;
+  wgpu_context->surface.height = height;
+
+  /* The swap chain is created with the surface size */
+  wgpu_setup_swap_chain(wgpu_context);
+
+  if (wgpu_context->depth_stencil.texture != NULL) {
+    wgpu_setup_deph_stencil(
+      wgpu_context, &(struct deph_stencil_texture_creation_options_t){
+                      .format       = wgpu_context->depth_stencil.format,
+                      .sample_count = wgpu_context->depth_stencil.sample_count,
+                      .sampled      = wgpu_context->depth_stencil.sampled,
+                      .copy_src     = wgpu_context->depth_stencil.copy_src,
+                    });
+  }
+
+  if (wgpu_context->msaa.color_texture != NULL) {
+    wgpu_setup_msaa_attachments(
+      wgpu_context, &(wgpu_msaa_attachments_options_t){
+                      .sample_count = wgpu_context->msaa.sample_count,
+                      .color_format = wgpu_context->msaa.color_format,
+                      .depth_format = wgpu_context->msaa.depth_format,
+                    });
+  }
+
+  return true;
+}
+
 void wgpu_error_callback(WGPUErrorType error_type, char const* message,
                          void* userdata)
 {
@@ -246,6 +819,186 @@ void wgpu_queue_write_buffer(wgpu_context_t* wgpu_context, WGPUBuffer buffer,
   wgpuQueueWriteBuffer(wgpu_context->queue, buffer, buffer_offset, data, size);
 }
 
+/* Batched queue writes */
+#define WGPU_QUEUE_WRITE_BATCH_INITIAL_CAPACITY 64u
+#define WGPU_QUEUE_WRITE_BATCH_INITIAL_ARENA_SIZE (1u << 16)
+
+typedef struct wgpu_queue_write_t {
+  WGPUBuffer buffer;
+  uint64_t buffer_offset;
+  uint64_t size;
+  uint64_t arena_offset; /* location of the data in the arena */
+  uint32_t sequence;     /* record order, later writes win */
+} wgpu_queue_write_t;
+
+typedef struct wgpu_queue_write_batch_t {
+  wgpu_queue_write_t* writes;
+  uint32_t write_count;
+  uint64_t write_capacity;
+  uint8_t* arena;
+  uint64_t arena_size;
+  uint64_t arena_capacity;
+  uint8_t* scratch; /* merged write data */
+  uint64_t scratch_capacity;
+} wgpu_queue_write_batch_t;
+
+static wgpu_queue_write_batch_t* wgpu_queue_write_batch_create(void)
+{
+  wgpu_queue_write_batch_t* write_batch
+    = (wgpu_queue_write_batch_t*)malloc(sizeof(wgpu_queue_write_batch_t));
+  memset(write_batch, 0, sizeof(wgpu_queue_write_batch_t));
+
+  write_batch->write_capacity = WGPU_QUEUE_WRITE_BATCH_INITIAL_CAPACITY;
+  write_batch->writes         = (wgpu_queue_write_t*)malloc(
+    write_batch->write_capacity * sizeof(wgpu_queue_write_t));
+  write_batch->arena_capacity = WGPU_QUEUE_WRITE_BATCH_INITIAL_ARENA_SIZE;
+  write_batch->arena = (uint8_t*)malloc(write_batch->arena_capacity);
+
+  return write_batch;
+}
+
+static void
+wgpu_queue_write_batch_destroy(struct wgpu_queue_write_batch_t* write_batch)
+{
+  free(write_batch->writes);
+  free(write_batch->arena);
+  free(write_batch->scratch);
+  free(write_batch);
+}
+
+static void* wgpu_grow_allocation(void* memory, uint64_t* capacity,
+                                  uint64_t required, size_t element_size)
+{
+  if (required <= *capacity) {
+    return memory;
+  }
+  uint64_t new_capacity = MAX(*capacity, 1u);
+  while (new_capacity < required) {
+    new_capacity *= 2;
+  }
+  void* new_memory = realloc(memory, new_capacity * element_size);
+  ASSERT(new_memory != NULL);
+  *capacity = new_capacity;
+  return new_memory;
+}
+
+void wgpu_queue_write_buffer_batched(wgpu_context_t* wgpu_context,
+                                     WGPUBuffer buffer, uint64_t buffer_offset,
+                                     void const* data, size_t size)
+{
+  ASSERT(buffer != NULL && data != NULL);
+  ASSERT(buffer_offset % 4 == 0 && size % 4 == 0);
+
+  /* Create the write batch on first use */
+  if (wgpu_context->write_batch == NULL) {
+    wgpu_context->write_batch = wgpu_queue_write_batch_create();
+  }
+  wgpu_queue_write_batch_t* write_batch = wgpu_context->write_batch;
+
+  write_batch->writes = wgpu_grow_allocation(
+    write_batch->writes, &write_batch->write_capacity,
+    write_batch->write_count + 1, sizeof(wgpu_queue_write_t));
+  write_batch->arena
+    = wgpu_grow_allocation(write_batch->arena, &write_batch->arena_capacity,
+                           write_batch->arena_size + size, 1);
+
+  memcpy(write_batch->arena + write_batch->arena_size, data, size);
+  write_batch->writes[write_batch->write_count] = (wgpu_queue_write_t){
+    .buffer        = buffer,
+    .buffer_offset = buffer_offset,
+    .size          = size,
+    .arena_offset  = write_batch->arena_size,
+    .sequence      = write_batch->write_count,
+  };
+  ++write_batch->write_count;
+  write_batch->arena_size += size;
+}
+
+/* Orders the writes by destination buffer and offset */
+static int wgpu_queue_write_compare_location(const void* a, const void* b)
+{
+  const wgpu_queue_write_t* wa = (const wgpu_queue_write_t*)a;
+  const wgpu_queue_write_t* wb = (const wgpu_queue_write_t*)b;
+  if (wa->buffer != wb->buffer) {
+    return ((uintptr_t)wa->buffer < (uintptr_t)wb->buffer) ? -1 : 1;
+  }
+  if (wa->buffer_offset != wb->buffer_offset) {
+    return (wa->buffer_offset < wb->buffer_offset) ? -1 : 1;
+  }
+  return (wa->sequence < wb->sequence) ? -1 : 1;
+}
+
+/* Orders the writes by record order */
+static int wgpu_queue_write_compare_sequence(const void* a, const void* b)
+{
+  const wgpu_queue_write_t* wa = (const wgpu_queue_write_t*)a;
+  const wgpu_queue_write_t* wb = (const wgpu_queue_write_t*)b;
+  return (wa->sequence < wb->sequence) ? -1 : 1;
+}
+
+void wgpu_flush_queue_writes(wgpu_context_t* wgpu_context)
+{
+  wgpu_queue_write_batch_t* write_batch = wgpu_context->write_batch;
+  if (write_batch == NULL || write_batch->write_count == 0) {
+    return;
+  }
+
+  wgpu_queue_write_stats_t stats = {
+    .write_count = write_batch->write_count,
+  };
+
+  qsort(write_batch->writes, write_batch->write_count,
+        sizeof(wgpu_queue_write_t), wgpu_queue_write_compare_location);
+
+  uint32_t run_start = 0;
+  while (run_start < write_batch->write_count) {
+    /* Collect the writes touching or overlapping the current range */
+    const wgpu_queue_write_t* first = &write_batch->writes[run_start];
+    uint64_t range_end              = first->buffer_offset + first->size;
+    uint32_t run_end                = run_start + 1;
+    while (run_end < write_batch->write_count) {
+      const wgpu_queue_write_t* next = &write_batch->writes[run_end];
+      if (next->buffer != first->buffer || next->buffer_offset > range_end) {
+        break;
+      }
+      range_end = MAX(range_end, next->buffer_offset + next->size);
+      ++run_end;
+    }
+
+    const uint64_t range_size = range_end - first->buffer_offset;
+    if (run_end - run_start == 1) {
+      wgpuQueueWriteBuffer(wgpu_context->queue, first->buffer,
+                           first->buffer_offset,
+                           write_batch->arena + first->arena_offset,
+                           first->size);
+    }
+    else {
+      /* Merge the run in record order so that later writes win */
+      const WGPUBuffer buffer    = first->buffer;
+      const uint64_t range_start = first->buffer_offset;
+      write_batch->scratch       = wgpu_grow_allocation(
+        write_batch->scratch, &write_batch->scratch_capacity, range_size, 1);
+      qsort(&write_batch->writes[run_start], run_end - run_start,
+            sizeof(wgpu_queue_write_t), wgpu_queue_write_compare_sequence);
+      for (uint32_t i = run_start; i < run_end; ++i) {
+        const wgpu_queue_write_t* write = &write_batch->writes[i];
+        memcpy(write_batch->scratch + (write->buffer_offset - range_start),
+               write_batch->arena + write->arena_offset, write->size);
+      }
+      wgpuQueueWriteBuffer(wgpu_context->queue, buffer, range_start,
+                           write_batch->scratch, range_size);
+    }
+    ++stats.queue_write_count;
+    stats.byte_count += range_size;
+
+    run_start = run_end;
+  }
+
+  write_batch->write_count  = 0;
+  write_batch->arena_size   = 0;
+  wgpu_context->write_stats = stats;
+}
+
 /* Render helper functions */
 
 /* Get a new command buffer */
@@ -257,7 +1010,10 @@ WGPUCommandBuffer wgpu_get_command_buffer(WGPUCommandEncoder cmd_encoder)
 WGPUTextureView wgpu_swap_chain_get_current_image(wgpu_context_t* wgpu_context)
 {
   wgpu_context->swap_chain.frame_buffer
-    = wgpuSwapChainGetCurrentTextureView(wgpu_context->swap_chain.instance);
+    = wgpu_context->offscreen_swap_chain != NULL ?
+        wgpu_offscreen_swap_chain_get_current_image(
+          wgpu_context->offscreen_swap_chain) :
+        wgpuSwapChainGetCurrentTextureView(wgpu_context->swap_chain.instance);
   return wgpu_context->swap_chain.frame_buffer;
 }
 
@@ -268,8 +1024,44 @@ void wgpu_flush_command_buffers(wgpu_context_t* wgpu_context,
 {
   ASSERT(command_buffers != NULL)
 
-  /* Submit to the queue */
-  wgpuQueueSubmit(wgpu_context->queue, command_buffer_count, command_buffers);
+  /* Apply the batched queue writes before the commands that consume them */
+  wgpu_flush_queue_writes(wgpu_context);
+
+  /* Staging memory must be unmapped before the copies are submitted */
+  if (wgpu_context->staging_ring != NULL) {
+    wgpu_staging_ring_unmap(wgpu_context->staging_ring);
+  }
+
+  /* Submit to the queue, between the frame timestamps of the GPU profiler */
+  WGPUCommandBuffer frame_begin = NULL, frame_end = NULL;
+  wgpu_gpu_profiler_get_submit_commands(wgpu_context->gpu_profiler,
+                                        &frame_begin, &frame_end);
+  if (frame_begin == NULL && frame_end == NULL) {
+    wgpuQueueSubmit(wgpu_context->queue, command_buffer_count,
+                    command_buffers);
+  }
+  else {
+    ASSERT(command_buffer_count <= MAX_COMMAND_BUFFER_COUNT);
+    WGPUCommandBuffer submitted[MAX_COMMAND_BUFFER_COUNT + 2];
+    uint32_t submitted_count = 0;
+    if (frame_begin != NULL) {
+      submitted[submitted_count++] = frame_begin;
+    }
+    memcpy(&submitted[submitted_count], command_buffers,
+           command_buffer_count * sizeof(WGPUCommandBuffer));
+    submitted_count += command_buffer_count;
+    if (frame_end != NULL) {
+      submitted[submitted_count++] = frame_end;
+    }
+    wgpuQueueSubmit(wgpu_context->queue, submitted_count, submitted);
+    WGPU_RELEASE_RESOURCE(CommandBuffer, frame_begin)
+    WGPU_RELEASE_RESOURCE(CommandBuffer, frame_end)
+  }
+
+  /* Recycle the staging memory used by this submission */
+  if (wgpu_context->staging_ring != NULL) {
+    wgpu_staging_ring_next_frame(wgpu_context->staging_ring);
+  }
 
   /* Release command buffer */
   for (uint32_t i = 0; i < command_buffer_count; ++i) {
@@ -277,9 +1069,176 @@ void wgpu_flush_command_buffers(wgpu_context_t* wgpu_context,
   }
 }
 
+static void wgpu_frame_slot_work_done_cb(WGPUQueueWorkDoneStatus status,
+                                         void* userdata)
+{
+  wgpu_frame_slot_t* frame_slot = (wgpu_frame_slot_t*)userdata;
+  if (status != WGPUQueueWorkDoneStatus_Success) {
+    log_warn("Frame %llu did not complete successfully (status: %d)",
+             (unsigned long long)frame_slot->frame_number, status);
+  }
+  frame_slot->in_flight = false;
+}
+
+void wgpu_begin_frame(wgpu_context_t* wgpu_context)
+{
+  wgpu_frame_slot_t* frame_slot
+    = &wgpu_context->frames.slots[wgpu_context->frames.index];
+
+  /* Wait until the GPU is done with the frame that last used this slot */
+  while (frame_slot->in_flight) {
+    wgpuDeviceTick(wgpu_context->device);
+  }
+
+  frame_slot->frame_number    = wgpu_context->frames.frame_number;
+  frame_slot->uniforms.offset = 0;
+
+  /* The scratch memory of the last frame is no longer referenced */
+  if (wgpu_context->frame_arena.data != NULL) {
+    linear_arena_reset(&wgpu_context->frame_arena);
+  }
+
+  /* Write this frame's share of the scheduled uploads ahead of its commands */
+  if (wgpu_context->upload_scheduler != NULL) {
+    wgpu_upload_scheduler_process(wgpu_context->upload_scheduler);
+  }
+
+  /* Mark the start of the GPU work of this frame */
+  wgpu_gpu_profiler_begin_frame(wgpu_context->gpu_profiler);
+}
+
+void wgpu_end_frame(wgpu_context_t* wgpu_context)
+{
+  wgpu_frame_slot_t* frame_slot
+    = &wgpu_context->frames.slots[wgpu_context->frames.index];
+
+  /* Resolve the GPU timestamps and statistics recorded during this frame */
+  wgpu_gpu_profiler_end_frame(wgpu_context->gpu_profiler);
+  wgpu_pipeline_statistics_end_frame(wgpu_context->pipeline_statistics);
+
+  /* Scale the render resolution of the next frames to the GPU frame time */
+  if (wgpu_context->dynamic_resolution != NULL) {
+    wgpu_dynamic_resolution_update(
+      wgpu_context->dynamic_resolution,
+      wgpu_gpu_profiler_get_frame_time_ms(wgpu_context->gpu_profiler));
+  }
+
+  /* Signaled once all the work submitted for this frame has completed */
+  frame_slot->in_flight = true;
+  wgpuQueueOnSubmittedWorkDone(wgpu_context->queue, 0,
+                               wgpu_frame_slot_work_done_cb, frame_slot);
+
+  /* Frame boundary of the API trace, when capturing */
+  wgpu_api_trace_end_frame();
+
+  wgpu_context->frames.index
+    = (wgpu_context->frames.index + 1) % wgpu_context->frames.count;
+  ++wgpu_context->frames.frame_number;
+}
+
+static void wgpu_submitted_work_done_cb(WGPUQueueWorkDoneStatus status,
+                                        void* userdata)
+{
+  UNUSED_VAR(status);
+  *(bool*)userdata = true;
+}
+
+void wgpu_wait_for_submitted_work(wgpu_context_t* wgpu_context)
+{
+  bool done = false;
+  wgpuQueueOnSubmittedWorkDone(wgpu_context->queue, 0,
+                               wgpu_submitted_work_done_cb, &done);
+  while (!done) {
+    wgpuDeviceTick(wgpu_context->device);
+  }
+}
+
+static void wgpu_queue_fence_work_done_cb(WGPUQueueWorkDoneStatus status,
+                                          void* userdata)
+{
+  wgpu_queue_fence_t* fence = (wgpu_queue_fence_t*)userdata;
+  if (status != WGPUQueueWorkDoneStatus_Success) {
+    log_warn("Fence value %llu did not complete successfully (status: %d)",
+             (unsigned long long)(fence->completed + 1), status);
+  }
+  ++fence->completed;
+}
+
+uint64_t wgpu_queue_fence_signal(wgpu_context_t* wgpu_context,
+                                 wgpu_queue_fence_t* fence)
+{
+  wgpuQueueOnSubmittedWorkDone(wgpu_context->queue, 0,
+                               wgpu_queue_fence_work_done_cb, fence);
+  return ++fence->signaled;
+}
+
+bool wgpu_queue_fence_is_completed(const wgpu_queue_fence_t* fence,
+                                   uint64_t value)
+{
+  return fence->completed >= value;
+}
+
+void wgpu_queue_fence_wait(wgpu_context_t* wgpu_context,
+                           wgpu_queue_fence_t* fence, uint64_t value)
+{
+  ASSERT(value <= fence->signaled)
+  while (fence->completed < value) {
+    wgpuDeviceTick(wgpu_context->device);
+  }
+}
+
+bool wgpu_frame_write_uniform(wgpu_context_t* wgpu_context, const void* data,
+                              uint64_t size, WGPUBuffer* buffer,
+                              uint64_t* offset)
+{
+  wgpu_frame_slot_t* frame_slot
+    = &wgpu_context->frames.slots[wgpu_context->frames.index];
+
+  /* Create the uniform buffer of the frame slot on first use */
+  if (frame_slot->uniforms.buffer == NULL) {
+    frame_slot->uniforms.size   = WGPU_FRAME_UNIFORM_BUFFER_SIZE;
+    frame_slot->uniforms.buffer = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .label = "frame-uniform-buffer",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size  = frame_slot->uniforms.size,
+      });
+    ASSERT(frame_slot->uniforms.buffer != NULL);
+  }
+
+  /* Slices are aligned to minUniformBufferOffsetAlignment */
+  const uint64_t slice_size = (size + 255) & ~((uint64_t)255);
+  if (frame_slot->uniforms.offset + slice_size > frame_slot->uniforms.size) {
+    return false;
+  }
+
+  *buffer = frame_slot->uniforms.buffer;
+  *offset = frame_slot->uniforms.offset;
+  wgpu_queue_write_buffer(wgpu_context, *buffer, *offset, data, size);
+  frame_slot->uniforms.offset += slice_size;
+
+  return true;
+}
+
+void* wgpu_frame_alloc(wgpu_context_t* wgpu_context, size_t size)
+{
+  /* Create the frame arena on first use */
+  if (wgpu_context->frame_arena.data == NULL) {
+    linear_arena_init(&wgpu_context->frame_arena,
+                      WGPU_FRAME_ARENA_INITIAL_SIZE);
+  }
+  return linear_arena_alloc(&wgpu_context->frame_arena, size);
+}
+
 void wgpu_swap_chain_present(wgpu_context_t* wgpu_context)
 {
-  wgpuSwapChainPresent(wgpu_context->swap_chain.instance);
+  if (wgpu_context->offscreen_swap_chain != NULL) {
+    wgpu_offscreen_swap_chain_present(wgpu_context->offscreen_swap_chain);
+  }
+  else {
+    wgpuSwapChainPresent(wgpu_context->swap_chain.instance);
+  }
 
   WGPU_RELEASE_RESOURCE(TextureView, wgpu_context->swap_chain.frame_buffer)
 }
@@ -324,10 +1283,20 @@ wgpu_create_depth_stencil_state(create_depth_stencil_state_desc_t* desc)
     .passOp      = WGPUStencilOperation_Keep,
   };
 
+  /* Without context the conventional depth range */
+  wgpu_context_t* wgpu_context = desc->wgpu_context;
+  WGPUTextureFormat format     = desc->format;
+  if (format == WGPUTextureFormat_Undefined && wgpu_context != NULL) {
+    format = wgpu_get_depth_format(wgpu_context);
+  }
+  const WGPUCompareFunction depth_compare
+    = wgpu_context != NULL ? wgpu_get_depth_compare(wgpu_context, true) :
+                             WGPUCompareFunction_LessEqual;
+
   return (WGPUDepthStencilState){
     .depthWriteEnabled   = desc->depth_write_enabled,
-    .format              = desc->format,
-    .depthCompare        = WGPUCompareFunction_LessEqual,
+    .format              = format,
+    .depthCompare        = depth_compare,
     .stencilFront        = stencil_state_face_descriptor,
     .stencilBack         = stencil_state_face_descriptor,
     .stencilReadMask     = 0xFFFFFFFF,
@@ -3,6 +3,9 @@
 
 #include <dawn/webgpu.h>
 
+#include "../../lib/wgpu_native/wgpu_native.h"
+#include "../core/arena.h"
+
 #define WGPU_RELEASE_RESOURCE(Type, Name)                                      \
   if (Name) {                                                                  \
     wgpu##Type##Release(Name);                                                 \
@@ -42,18 +45,110 @@
 
 #define MAX_COMMAND_BUFFER_COUNT 256
 #define WGPU_FEATURE_COUNT 12u
+#define WGPU_MAX_FRAMES_IN_FLIGHT 3u
+#define WGPU_DEFAULT_FRAMES_IN_FLIGHT 2u
+#define WGPU_FRAME_UNIFORM_BUFFER_SIZE (1u << 16)
+#define WGPU_FRAME_ARENA_INITIAL_SIZE (1u << 16)
+#define WGPU_PIPELINE_CACHE_DIRECTORY "pipeline_cache"
+#define WGPU_TEXTURE_CACHE_DIRECTORY "texture_cache"
+#define WGPU_MODEL_CACHE_DIRECTORY "model_cache"
 
 /* Initializers */
 
 /* Forward declarations */
+struct wgpu_bind_group_cache_t;
 struct wgpu_buffer_t;
+struct wgpu_dynamic_resolution;
+struct wgpu_gpu_profiler;
+struct wgpu_pipeline_cache_t;
+struct wgpu_pipeline_statistics;
+struct wgpu_queue_write_batch_t;
+struct wgpu_render_bundle_cache_t;
+struct wgpu_sampler_cache_t;
+struct wgpu_shader_cache_t;
+struct wgpu_staging_ring_t;
 struct wgpu_texture_client_t;
+struct wgpu_upload_scheduler;
 
 /* WebGPU context create options */
+/* Present mode of the swap chain, the default one follows vsync */
+typedef enum wgpu_present_mode_enum {
+  PresentMode_Default   = 0,
+  PresentMode_Fifo      = 1, /* vsync, queues frames */
+  PresentMode_Mailbox   = 2, /* vsync, the newest frame replaces queued ones */
+  PresentMode_Immediate = 3, /* no vsync, may tear */
+} wgpu_present_mode_enum;
+
+/* Limits requested above the defaults of WebGPU, zero keeps the default. They
+ * are clamped to the limits of the adapter. */
+typedef struct wgpu_required_limits_t {
+  uint64_t max_storage_buffer_binding_size;
+  uint32_t max_compute_workgroup_storage_size;
+  uint32_t max_compute_invocations_per_workgroup;
+  uint32_t max_compute_workgroup_size_x;
+} wgpu_required_limits_t;
+
 typedef struct wgpu_context_create_options_t {
   bool vsync;
+  wgpu_present_mode_enum present_mode; /* overrides vsync (optional) */
+  uint32_t frames_in_flight; /* 1..WGPU_MAX_FRAMES_IN_FLIGHT (optional) */
+  /* High performance when undefined (optional) */
+  WGPUPowerPreference power_preference;
+  /* Adapter to create the device on, the best ranked one when NULL, it has to
+   * outlive the device creation (optional) */
+  const wgpu_adapter_selection_t* adapter_selection;
+  /* Requested in addition to the default ones, the features the adapter
+   * lacks are skipped with a warning (optional) */
+  uint32_t required_feature_count; /* up to WGPU_FEATURE_COUNT */
+  WGPUFeatureName const* required_features;
+  wgpu_required_limits_t required_limits; /* (optional) */
+  /* GPU memory of the buffers and textures in bytes, exceeding it is warned
+   * about (optional) */
+  uint64_t memory_budget;
+  /* Records the creation stacks of the resources and reports the ones still
+   * alive at wgpu_context_release, see memory_tracker.h (optional) */
+  bool track_lifetimes;
+  /* GPU frame time in milliseconds the render resolution is scaled to hold,
+   * 0 disables the scaling, see dynamic_resolution.h (optional) */
+  float target_gpu_frame_time_ms;
+  float min_resolution_scale; /* 0 selects 0.5 (optional) */
+  /* Reversed-Z depth convention, see wgpu_get_depth_format (optional) */
+  bool reversed_z;
+  /* Timestamp and pipeline statistics queries of the GPU profiler and of the
+   * pipeline statistics, they need the device to allow unsafe APIs
+   * (optional) */
+  bool gpu_queries;
 } wgpu_context_create_options_t;
 
+/* Statistics of the last flush of the batched queue writes */
+typedef struct wgpu_queue_write_stats_t {
+  uint32_t write_count;       /* number of recorded writes */
+  uint32_t queue_write_count; /* number of emitted wgpuQueueWriteBuffer calls */
+  uint64_t byte_count;        /* number of uploaded bytes */
+} wgpu_queue_write_stats_t;
+
+/* Per-frame resources, reused once the GPU has finished the frame */
+typedef struct wgpu_frame_slot_t {
+  struct wgpu_context_t* wgpu_context;
+  uint64_t frame_number; /* frame recorded with this slot */
+  bool in_flight;        /* submitted, GPU work not yet completed */
+  struct {
+    WGPUBuffer buffer;
+    uint64_t size;
+    uint64_t offset; /* first free byte */
+  } uniforms;
+} wgpu_frame_slot_t;
+
+/**
+ * @brief Fence on the queue: every signal counts the work submitted so far,
+ * completed counts the signals whose work the GPU has finished. The work done
+ * callbacks run in submission order, so the signals are completed in order.
+ */
+typedef struct wgpu_queue_fence_t {
+  uint64_t signaled;  /* value of the last signal */
+  uint64_t completed; /* value of the last completed signal */
+} wgpu_queue_fence_t;
+
 /* WebGPU context */
 typedef struct wgpu_context_t {
   void* context;
@@ -65,6 +160,15 @@ typedef struct wgpu_context_t {
     WGPUFeatureName feature_name;
     bool is_supported;
   } features[WGPU_FEATURE_COUNT];
+  /* Device requirements of the creation options */
+  struct {
+    WGPUPowerPreference power_preference;
+    const wgpu_adapter_selection_t* adapter_selection;
+    uint32_t feature_count;
+    WGPUFeatureName features[WGPU_FEATURE_COUNT];
+    wgpu_required_limits_t limits;
+    bool gpu_queries;
+  } device_requirements;
   struct {
     void* instance;
     uint32_t width;
@@ -82,28 +186,123 @@ typedef struct wgpu_context_t {
   struct {
     WGPUTexture texture;
     WGPUTextureView texture_view;
+    WGPUTextureView depth_view; /* depth aspect, for sampled depth buffers */
     WGPURenderPassDepthStencilAttachment att_desc;
+    /* Read-only attachment of the depth and stencil for the passes that only
+     * test them, e.g. the overlay, or that sample depth_view while testing
+     * it. Draws in such passes must not write depth or stencil. */
+    WGPURenderPassDepthStencilAttachment read_only_att_desc;
+    /* Creation options, to recreate the texture when the surface is resized */
+    WGPUTextureFormat format;
+    uint32_t sample_count;
+    bool sampled;
+    bool copy_src;
+    uint32_t width;
+    uint32_t height;
+    /* Depth convention of the context, see wgpu_get_depth_format */
+    bool reversed_z;
   } depth_stencil;
+  /* Multisampled attachments, see wgpu_setup_msaa_attachments */
+  struct {
+    WGPUTexture color_texture;
+    WGPUTextureView color_view;
+    WGPUTexture depth_texture; /* NULL without depth attachment */
+    WGPUTextureView depth_view;
+    WGPURenderPassColorAttachment color_att_desc;
+    WGPURenderPassDepthStencilAttachment depth_att_desc;
+    WGPUTextureFormat color_format;
+    WGPUTextureFormat depth_format;
+    uint32_t sample_count;
+    uint32_t width;
+    uint32_t height;
+  } msaa;
   struct {
     uint32_t command_buffer_count;
     WGPUCommandBuffer command_buffers[MAX_COMMAND_BUFFER_COUNT];
   } submit_info;
+  struct {
+    uint32_t count;        /* number of frames in flight */
+    uint32_t index;        /* index of the current frame slot */
+    uint64_t frame_number; /* number of the frame being recorded */
+    wgpu_frame_slot_t slots[WGPU_MAX_FRAMES_IN_FLIGHT];
+  } frames;
+  struct wgpu_queue_write_batch_t* write_batch;
+  wgpu_queue_write_stats_t write_stats;
+  struct wgpu_staging_ring_t* staging_ring;
+  /* Scratch memory of the frame being recorded, see wgpu_frame_alloc */
+  linear_arena_t frame_arena;
+  /* Camera, time and resolution of the frame, see frame_uniforms.h */
+  struct wgpu_frame_uniforms_t* frame_uniforms;
+  /* Budgeted uploads, see upload_scheduler.h */
+  struct wgpu_upload_scheduler* upload_scheduler;
   struct wgpu_texture_client_t* texture_client;
+  struct wgpu_gpu_profiler* gpu_profiler;
+  /* Scale of the render resolution, NULL when fixed */
+  struct wgpu_dynamic_resolution* dynamic_resolution;
+  /* Pass statistics, see pipeline_statistics.h */
+  struct wgpu_pipeline_statistics* pipeline_statistics;
+  struct wgpu_shader_cache_t* shader_cache;
+  struct wgpu_render_bundle_cache_t* render_bundle_cache;
+  struct wgpu_pipeline_cache_t* pipeline_cache;
+  struct wgpu_sampler_cache_t* sampler_cache;
+  struct wgpu_bind_group_cache_t* bind_group_cache;
+  /* Replaces the swap chain in headless mode, see offscreen_swap_chain.h */
+  struct wgpu_offscreen_swap_chain_t* offscreen_swap_chain;
+  /* Resources created with this context, reported when alive at release */
+  struct {
+    bool enabled;
+    uint64_t first_creation;
+  } lifetime_tracking;
 } wgpu_context_t;
 
 /* WebGPU context creating/releasing */
 wgpu_context_t* wgpu_context_create(wgpu_context_create_options_t* options);
 void wgpu_context_release(wgpu_context_t* wgpu_context);
+/* Releases the state of the application using the context, i.e. its render
+ * bundles, pending uploads and queue writes and the depth stencil texture,
+ * once the GPU is idle. The device, the swap chain, the caches, the
+ * multisampled attachments and the texture client stay alive for the next
+ * application. */
+void wgpu_context_reset(wgpu_context_t* wgpu_context);
 
 /* WebGPU info functions */
 void wgpu_get_context_info(char (*adapter_info)[256]);
 bool wgpu_has_feature(wgpu_context_t* wgpu_context,
                       WGPUFeatureName feature_name);
 
+/*
+ * Depth convention of the context.
+ *
+ * By default the depth is cleared to 1 and tested with Less(Equal) in
+ * Depth24PlusStencil8. With reversed_z set in the creation options the near
+ * plane maps to 1 and the far plane to 0, which, with the precision of floats
+ * growing towards 0, spreads the precision evenly over the distance. Large
+ * scenes then render with an infinite far plane without depth fighting, see
+ * CameraProjection_ReversedZInfinite. The depth is cleared to 0, tested with
+ * Greater(Equal) and stored in Depth32FloatStencil8 when the adapter supports
+ * it, in Depth32Float otherwise.
+ */
+/* Default depth format, of wgpu_setup_deph_stencil and the depth stencil
+ * states created with the context */
+WGPUTextureFormat wgpu_get_depth_format(wgpu_context_t* wgpu_context);
+/* Compare function passing the nearer fragments, and equal ones with
+ * or_equal */
+WGPUCompareFunction wgpu_get_depth_compare(wgpu_context_t* wgpu_context,
+                                           bool or_equal);
+/* Depth of the far plane, the clear value of the depth attachments */
+float wgpu_get_depth_clear_value(wgpu_context_t* wgpu_context);
+
 /* WebGPU context helper functions */
 typedef struct deph_stencil_texture_creation_options_t {
+  /* Undefined selects wgpu_get_depth_format */
   WGPUTextureFormat format;
   uint32_t sample_count;
+  /* Adds the TextureBinding usage and, for single-sampled depth buffers, the
+   * depth-only view to read the depth in shaders, e.g. to build a Hi-Z
+   * pyramid */
+  bool sampled;
+  /* Adds the CopySrc usage to copy the depth out of the texture */
+  bool copy_src;
 } deph_stencil_texture_creation_options;
 
 WGPUBuffer wgpu_create_buffer_from_data(wgpu_context_t* wgpu_context,
@@ -111,10 +310,49 @@ WGPUBuffer wgpu_create_buffer_from_data(wgpu_context_t* wgpu_context,
                                         WGPUBufferUsage usage);
 void wgpu_create_device_and_queue(wgpu_context_t* wgpu_context);
 void wgpu_setup_window_surface(wgpu_context_t* wgpu_context, void* window);
+/**
+ * @brief Sets up the depth stencil texture of the surface size in
+ * wgpu_context->depth_stencil. The texture only gets the usages the options
+ * ask for, as extra usages can disable the depth compression on some drivers.
+ */
 void wgpu_setup_deph_stencil(
   wgpu_context_t* wgpu_context,
   struct deph_stencil_texture_creation_options_t* options);
+
+typedef struct wgpu_msaa_attachments_options_t {
+  uint32_t sample_count; /* 0 selects 4 */
+  /* Undefined selects the swap chain format */
+  WGPUTextureFormat color_format;
+  /* Undefined sets up no depth attachment */
+  WGPUTextureFormat depth_format;
+} wgpu_msaa_attachments_options_t;
+
+/**
+ * @brief Sets up multisampled color and depth attachments of the surface size
+ * in wgpu_context->msaa. Their contents only live during the render pass: the
+ * color attachment is resolved into its resolveTarget, to be set to the frame
+ * buffer, and both attachments are discarded at the end of the pass, which
+ * spares tiled GPUs from writing the samples back to memory.
+ *
+ * The attachments belong to the context and are shared by the applications
+ * using it: they are kept by wgpu_context_reset, recreated on resize and
+ * otherwise only when the options change. As with the depth stencil texture,
+ * a recreate keeps the fields of the attachment descriptors set by the
+ * applications and only replaces their views.
+ */
+void wgpu_setup_msaa_attachments(
+  wgpu_context_t* wgpu_context, const wgpu_msaa_attachments_options_t* options);
 void wgpu_setup_swap_chain(wgpu_context_t* wgpu_context);
+const char* wgpu_get_present_mode_name(WGPUPresentMode present_mode);
+/**
+ * @brief Resizes the surface: recreates the swap chain and, when they have been
+ * set up, the depth stencil texture and the multisampled attachments with the
+ * options they were created with. The attachment descriptors keep the other
+ * fields set by the examples, only their views are replaced. Returns false
+ * when the size did not change.
+ */
+bool wgpu_resize_surface(wgpu_context_t* wgpu_context, uint32_t width,
+                         uint32_t height);
 void wgpu_error_callback(WGPUErrorType type, char const* message,
                          void* userdata);
 
@@ -122,6 +360,15 @@ void wgpu_error_callback(WGPUErrorType type, char const* message,
 void wgpu_queue_write_buffer(wgpu_context_t* wgpu_context, WGPUBuffer buffer,
                              uint64_t buffer_offset, void const* data,
                              size_t size);
+/*
+ * Records the write into a CPU arena instead of issuing it immediately. The
+ * recorded writes are merged into as few queue writes as possible when the
+ * next command buffers are flushed (later writes win on overlapping ranges).
+ */
+void wgpu_queue_write_buffer_batched(wgpu_context_t* wgpu_context,
+                                     WGPUBuffer buffer, uint64_t buffer_offset,
+                                     void const* data, size_t size);
+void wgpu_flush_queue_writes(wgpu_context_t* wgpu_context);
 
 /* Render helper functions */
 WGPUCommandBuffer wgpu_get_command_buffer(WGPUCommandEncoder cmd_encoder);
@@ -131,6 +378,34 @@ void wgpu_flush_command_buffers(wgpu_context_t* wgpu_context,
                                 uint32_t command_buffer_count);
 void wgpu_swap_chain_present(wgpu_context_t* wgpu_context);
 
+/* Frames in flight */
+void wgpu_begin_frame(wgpu_context_t* wgpu_context);
+void wgpu_end_frame(wgpu_context_t* wgpu_context);
+/* Blocks until the GPU has finished all work submitted so far, e.g. to sample
+ * the input of the next frame as late as possible */
+void wgpu_wait_for_submitted_work(wgpu_context_t* wgpu_context);
+/* Queue fences, signal returns the value reached once the work submitted
+ * before the call has completed */
+uint64_t wgpu_queue_fence_signal(wgpu_context_t* wgpu_context,
+                                 wgpu_queue_fence_t* fence);
+bool wgpu_queue_fence_is_completed(const wgpu_queue_fence_t* fence,
+                                   uint64_t value);
+void wgpu_queue_fence_wait(wgpu_context_t* wgpu_context,
+                           wgpu_queue_fence_t* fence, uint64_t value);
+/* Writes data into a 256-byte aligned slice of the uniform buffer of the
+ * current frame slot, to be bound with the returned offset as dynamic offset.
+ * The slices are reused once the GPU has finished the frame, so the blocks
+ * written every frame are never shared by the frames in flight. Returns false
+ * when the buffer of the slot is full. */
+bool wgpu_frame_write_uniform(wgpu_context_t* wgpu_context, const void* data,
+                              uint64_t size, WGPUBuffer* buffer,
+                              uint64_t* offset);
+/* Scratch memory valid until the next wgpu_begin_frame, the helpers use it
+ * instead of the heap for their temporary data of the frame. Only the heap
+ * allocations of frames larger than all previous ones are counted in
+ * frame_arena.heap_allocation_count. */
+void* wgpu_frame_alloc(wgpu_context_t* wgpu_context, size_t size);
+
 /* Texture client creation */
 void wgpu_create_texture_client(wgpu_context_t* wgpu_context);
 
@@ -138,8 +413,13 @@ void wgpu_create_texture_client(wgpu_context_t* wgpu_context);
 WGPUBlendState wgpu_create_blend_state(bool enable_blend);
 
 typedef struct create_depth_stencil_state_desc_t {
+  /* Undefined selects the default format of wgpu_context */
   WGPUTextureFormat format;
   bool depth_write_enabled;
+  /* Follows the depth convention of the context: its default format and the
+   * GreaterEqual compare function with reversed-Z. LessEqual without
+   * (optional) */
+  wgpu_context_t* wgpu_context;
 } create_depth_stencil_state_desc_t;
 WGPUDepthStencilState
 wgpu_create_depth_stencil_state(create_depth_stencil_state_desc_t* desc);
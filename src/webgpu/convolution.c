@@ -0,0 +1,1004 @@
+#include "convolution.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "buffer.h"
+#include "fft.h"
+#include "pipeline_cache.h"
+#include "shader.h"
+
+/* Workgroup sizes, the direct tile is stored with a row stride of two tiles
+ * so that its apron fits up to the largest direct radius */
+#define CONVOLUTION_DIRECT_TILE_SIZE 16u
+#define CONVOLUTION_ROW_TILE_SIZE 256u
+#define CONVOLUTION_FFT_WORKGROUP_SIZE 8u
+#define CONVOLUTION_FFT_MIN_GRID_SIZE 16u
+
+/* Relative error up to which a kernel counts as an outer product */
+#define CONVOLUTION_SEPARABLE_TOLERANCE 1e-4f
+
+/* Parameter slots, the FFT batches follow the two separable passes */
+#define CONVOLUTION_SLOT_HORIZONTAL 0u
+#define CONVOLUTION_SLOT_VERTICAL 1u
+#define CONVOLUTION_SLOT_FFT_BATCH 2u
+
+/* Layout of ConvolutionParams */
+typedef struct convolution_params_t {
+  uint32_t size[2];
+  uint32_t kernel_size;
+  uint32_t vertical;
+  uint32_t grid_size;
+  uint32_t valid_size;
+  uint32_t tiles_x;
+  uint32_t first_tile;
+  uint32_t tile_count;
+  uint32_t padding[3];
+} convolution_params_t;
+
+struct wgpu_convolution {
+  wgpu_context_t* wgpu_context;
+  uint32_t width;
+  uint32_t height;
+  WGPUTextureFormat format;
+  uint32_t fft_threshold;
+  wgpu_convolution_method_t forced_method;
+  wgpu_convolution_method_t method;
+  uint32_t kernel_size;
+  WGPUTextureView src_view;
+  WGPUTextureView dst_view;
+  /* One slot per pass, selected with a dynamic offset */
+  wgpu_buffer_t params_buffer;
+  uint32_t params_stride;
+  uint32_t params_slot_count;
+  /* Kernel weights, or the row followed by the column of a separable one */
+  wgpu_buffer_t weights_buffer;
+  WGPUBindGroupLayout params_bind_group_layout;
+  WGPUBindGroupLayout output_bind_group_layout;
+  WGPUBindGroupLayout intermediate_bind_group_layout;
+  WGPUBindGroupLayout fft_bind_group_layout;
+  WGPUBindGroup params_bind_group;
+  WGPUBindGroup direct_bind_group;
+  WGPUBindGroup horizontal_bind_group;
+  WGPUBindGroup vertical_bind_group;
+  WGPUBindGroup fft_bind_group;
+  WGPUComputePipeline direct_pipeline;
+  WGPUComputePipeline horizontal_pipeline;
+  WGPUComputePipeline vertical_pipeline;
+  /* Result of the horizontal pass, created with the first separable kernel */
+  WGPUTexture intermediate_texture;
+  WGPUTextureView intermediate_view;
+  /* Overlap-save tiling, created with the first kernel using the FFT */
+  struct {
+    wgpu_fft_t* fft;
+    uint32_t grid_size;
+    uint32_t valid_size;
+    uint32_t tiles_x;
+    uint32_t tile_count;
+    uint32_t batch_tile_count;
+    uint32_t batch_count;
+    wgpu_buffer_t spectrum_buffer;
+    bool spectrum_dirty;
+    WGPUComputePipeline kernel_pipeline;
+    WGPUComputePipeline spectrum_pipeline;
+    WGPUComputePipeline load_pipeline;
+    WGPUComputePipeline multiply_pipeline;
+    WGPUComputePipeline store_pipeline;
+  } fft;
+};
+
+// clang-format off
+static const char* convolution_params_wgsl = CODE(
+  struct ConvolutionParams {
+    size : vec2<u32>,
+    kernelSize : u32,
+    vertical : u32,
+    gridSize : u32,
+    validSize : u32,
+    tilesX : u32,
+    firstTile : u32,
+    tileCount : u32,
+    padding0 : u32,
+    padding1 : u32,
+    padding2 : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : ConvolutionParams;
+  @group(0) @binding(1) var<storage, read> weights : array<f32>;
+  @group(1) @binding(0) var srcTexture : texture_2d<f32>;
+  @group(1) @binding(1) var dstTexture : texture_storage_2d<%s, write>;
+
+  fn loadClamped(p : vec2<i32>) -> vec4<f32> {
+    let size = vec2<i32>(textureDimensions(srcTexture));
+    return textureLoad(srcTexture, clamp(p, vec2<i32>(0), size - 1), 0);
+  }
+);
+
+static const char* convolution_shader_wgsl = CODE(
+  var<workgroup> directTile : array<vec4<f32>, 1024>;
+  var<workgroup> rowTile : array<vec4<f32>, 384>;
+
+  // Every texel of the tile and its apron is loaded once, the taps are read
+  // from the workgroup memory
+  @compute @workgroup_size(16, 16)
+  fn main_direct(@builtin(workgroup_id) groupId : vec3<u32>,
+                 @builtin(local_invocation_id) localId : vec3<u32>,
+                 @builtin(local_invocation_index) localIndex : u32) {
+    let n = i32(params.kernelSize);
+    let radius = n / 2;
+    let tileStart = vec2<i32>(groupId.xy) * 16 - radius;
+    let tileWidth = 16 + 2 * radius;
+    for (var i = i32(localIndex); i < tileWidth * tileWidth; i = i + 256) {
+      let t = vec2<i32>(i % tileWidth, i / tileWidth);
+      directTile[t.y * 32 + t.x] = loadClamped(tileStart + t);
+    }
+    workgroupBarrier();
+
+    let p = vec2<i32>(groupId.xy * 16u + localId.xy);
+    if (any(p >= vec2<i32>(params.size))) {
+      return;
+    }
+    let l = vec2<i32>(localId.xy);
+    var color = vec4<f32>(0.0);
+    for (var j = 0; j < n; j = j + 1) {
+      for (var i = 0; i < n; i = i + 1) {
+        color = color + directTile[(l.y + j) * 32 + l.x + i]
+                        * weights[j * n + i];
+      }
+    }
+    textureStore(dstTexture, p, color);
+  }
+
+  // Positions of a pass run along the kernel axis in x, the vertical pass
+  // swaps the coordinates of the image
+  fn toImage(p : vec2<i32>) -> vec2<i32> {
+    if (params.vertical != 0u) {
+      return p.yx;
+    }
+    return p;
+  }
+
+  // One factor of a separable kernel along a row tile and its apron, the
+  // vertical pass reads the column after the row weights
+  @compute @workgroup_size(256)
+  fn main_separable(@builtin(workgroup_id) groupId : vec3<u32>,
+                    @builtin(local_invocation_id) localId : vec3<u32>) {
+    var size = vec2<i32>(params.size);
+    if (params.vertical != 0u) {
+      size = size.yx;
+    }
+    let n = params.kernelSize;
+    let radius = i32(n / 2u);
+    let row = i32(groupId.y);
+    let tileStart = i32(groupId.x) * 256;
+    for (var i = i32(localId.x); i < 256 + 2 * radius; i = i + 256) {
+      let x = clamp(tileStart - radius + i, 0, size.x - 1);
+      rowTile[i] = textureLoad(srcTexture, toImage(vec2<i32>(x, row)), 0);
+    }
+    workgroupBarrier();
+
+    let x = tileStart + i32(localId.x);
+    if (x >= size.x) {
+      return;
+    }
+    let offset = params.vertical * n;
+    var color = vec4<f32>(0.0);
+    for (var i = 0u; i < n; i = i + 1u) {
+      color = color + rowTile[localId.x + i] * weights[offset + i];
+    }
+    textureStore(dstTexture, toImage(vec2<i32>(x, row)), color);
+  }
+);
+
+static const char* convolution_fft_shader_wgsl = CODE(
+  @group(1) @binding(2) var<storage, read_write> data : array<vec2<f32>>;
+  @group(1) @binding(3) var<storage, read_write> spectrum : array<vec2<f32>>;
+
+  // Image position of the first grid texel of a tile of the batch, the grid
+  // starts an apron before the texels the tile writes
+  fn tileOrigin(tile : u32) -> vec2<i32> {
+    let t = params.firstTile + tile;
+    let start = vec2<u32>(t % params.tilesX, t / params.tilesX)
+                * params.validSize;
+    return vec2<i32>(start) - i32(params.kernelSize / 2u);
+  }
+
+  fn complexMul(a : vec2<f32>, b : vec2<f32>) -> vec2<f32> {
+    return vec2<f32>(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+  }
+
+  // Kernel centered at the origin of the first grid and mirrored, which turns
+  // the correlation of the weights into a convolution
+  @compute @workgroup_size(8, 8)
+  fn main_kernel(@builtin(global_invocation_id) id : vec3<u32>) {
+    let g = params.gridSize;
+    if (any(id.xy >= vec2<u32>(g))) {
+      return;
+    }
+    let n = params.kernelSize;
+    let radius = n / 2u;
+    let i = (radius + g - id.x) % g;
+    let j = (radius + g - id.y) % g;
+    var w = 0.0;
+    if (i < n && j < n) {
+      w = weights[j * n + i];
+    }
+    data[id.y * g + id.x] = vec2<f32>(w, 0.0);
+  }
+
+  @compute @workgroup_size(8, 8)
+  fn main_spectrum(@builtin(global_invocation_id) id : vec3<u32>) {
+    let g = params.gridSize;
+    if (any(id.xy >= vec2<u32>(g))) {
+      return;
+    }
+    spectrum[id.y * g + id.x] = data[id.y * g + id.x];
+  }
+
+  // Red and green into the first grid of a tile, blue and alpha into the
+  // second, the kernel is real so the channels stay apart
+  @compute @workgroup_size(8, 8)
+  fn main_load(@builtin(global_invocation_id) id : vec3<u32>) {
+    let g = params.gridSize;
+    if (any(id.xy >= vec2<u32>(g))) {
+      return;
+    }
+    let color = loadClamped(tileOrigin(id.z) + vec2<i32>(id.xy));
+    let base = id.z * 2u * g * g + id.y * g + id.x;
+    data[base] = color.rg;
+    data[base + g * g] = color.ba;
+  }
+
+  @compute @workgroup_size(64)
+  fn main_multiply(@builtin(global_invocation_id) id : vec3<u32>) {
+    let gridTexels = params.gridSize * params.gridSize;
+    if (id.x >= gridTexels) {
+      return;
+    }
+    let index = id.y * gridTexels + id.x;
+    data[index] = complexMul(data[index], spectrum[id.x]);
+  }
+
+  // The texels past the apron are free of the wrap around of the circular
+  // convolution
+  @compute @workgroup_size(8, 8)
+  fn main_store(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (any(id.xy >= vec2<u32>(params.validSize))
+        || params.firstTile + id.z >= params.tileCount) {
+      return;
+    }
+    let g = params.gridSize;
+    let radius = params.kernelSize / 2u;
+    let p = tileOrigin(id.z) + vec2<i32>(id.xy + radius);
+    if (any(p >= vec2<i32>(params.size))) {
+      return;
+    }
+    let grid = id.xy + radius;
+    let base = id.z * 2u * g * g + grid.y * g + grid.x;
+    textureStore(dstTexture, p, vec4<f32>(data[base], data[base + g * g]));
+  }
+);
+// clang-format on
+
+static const char* convolution_get_wgsl_format(WGPUTextureFormat format)
+{
+  switch (format) {
+    case WGPUTextureFormat_RGBA8Unorm:
+      return "rgba8unorm";
+    case WGPUTextureFormat_RGBA16Float:
+      return "rgba16float";
+    case WGPUTextureFormat_RGBA32Float:
+      return "rgba32float";
+    default:
+      log_error("Unsupported convolution storage texture format: %d", format);
+      return NULL;
+  }
+}
+
+static WGPUBindGroupLayout
+convolution_create_textures_bind_group_layout(wgpu_convolution_t* convolution,
+                                              WGPUTextureFormat format,
+                                              bool fft, const char* label)
+{
+  WGPUBindGroupLayoutEntry bgl_entries[4] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Source texture
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+        .multisampled  = false,
+      },
+      .storageTexture = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Destination texture
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .storageTexture = (WGPUStorageTextureBindingLayout) {
+        .access        = WGPUStorageTextureAccess_WriteOnly,
+        .format        = format,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .texture = {0},
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Grids of the FFT, the size follows the transform size
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = 0,
+      },
+      .sampler = {0},
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Spectrum of the kernel
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = 0,
+      },
+      .sampler = {0},
+    },
+  };
+  WGPUBindGroupLayout bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    convolution->wgpu_context->device,
+    &(WGPUBindGroupLayoutDescriptor){
+      .label      = label,
+      .entryCount = fft ? 4 : 2,
+      .entries    = bgl_entries,
+    });
+  ASSERT(bind_group_layout != NULL);
+  return bind_group_layout;
+}
+
+static void
+convolution_create_bind_group_layouts(wgpu_convolution_t* convolution)
+{
+  WGPUBindGroupLayoutEntry bgl_entries[2] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Convolution parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type             = WGPUBufferBindingType_Uniform,
+        .hasDynamicOffset = true,
+        .minBindingSize   = sizeof(convolution_params_t),
+      },
+      .sampler = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Kernel weights
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = convolution->weights_buffer.size,
+      },
+      .sampler = {0},
+    },
+  };
+  convolution->params_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    convolution->wgpu_context->device,
+    &(WGPUBindGroupLayoutDescriptor){
+      .label      = "convolution_params_bgl",
+      .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+      .entries    = bgl_entries,
+    });
+  ASSERT(convolution->params_bind_group_layout != NULL);
+
+  convolution->output_bind_group_layout
+    = convolution_create_textures_bind_group_layout(
+      convolution, convolution->format, false, "convolution_output_bgl");
+  convolution->intermediate_bind_group_layout
+    = convolution_create_textures_bind_group_layout(
+      convolution, WGPUTextureFormat_RGBA16Float, false,
+      "convolution_intermediate_bgl");
+  convolution->fft_bind_group_layout
+    = convolution_create_textures_bind_group_layout(
+      convolution, convolution->format, true, "convolution_fft_bgl");
+}
+
+/* Shader of the parameters followed by the passes, with the storage format
+ * of the destination baked in */
+static wgpu_shader_t convolution_create_shader(wgpu_convolution_t* convolution,
+                                               WGPUTextureFormat format,
+                                               const char* shader_wgsl,
+                                               const char* entry)
+{
+  const char* wgsl_format = convolution_get_wgsl_format(format);
+  ASSERT(wgsl_format != NULL);
+  const size_t params_size = strlen(convolution_params_wgsl) + 32;
+  char* params_wgsl        = malloc(params_size);
+  snprintf(params_wgsl, params_size, convolution_params_wgsl, wgsl_format);
+  const size_t wgsl_size = strlen(params_wgsl) + strlen(shader_wgsl) + 2;
+  char* wgsl             = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", params_wgsl, shader_wgsl);
+  wgpu_shader_t shader = wgpu_shader_create(
+    convolution->wgpu_context, &(wgpu_shader_desc_t){
+                                 // Compute shader WGSL
+                                 .label            = "convolution_shader",
+                                 .wgsl_code.source = wgsl,
+                                 .entry            = entry,
+                               });
+  free(wgsl);
+  free(params_wgsl);
+  return shader;
+}
+
+static WGPUComputePipeline
+convolution_create_pipeline(wgpu_convolution_t* convolution,
+                            WGPUBindGroupLayout layout,
+                            const wgpu_shader_t* shader, const char* entry,
+                            const char* label)
+{
+  wgpu_context_t* wgpu_context = convolution->wgpu_context;
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    convolution->params_bind_group_layout, /* Group 0 */
+    layout,                                /* Group 1 */
+  };
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "convolution_pipeline_layout",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(pipeline_layout != NULL);
+
+  WGPUProgrammableStageDescriptor stage = shader->programmable_stage_descriptor;
+  stage.entryPoint                      = entry;
+  WGPUComputePipeline pipeline = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context, &(WGPUComputePipelineDescriptor){
+                    .label   = label,
+                    .layout  = pipeline_layout,
+                    .compute = stage,
+                  });
+  ASSERT(pipeline != NULL);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+  return pipeline;
+}
+
+static void convolution_create_pipelines(wgpu_convolution_t* convolution)
+{
+  wgpu_shader_t shader = convolution_create_shader(
+    convolution, convolution->format, convolution_shader_wgsl, "main_direct");
+  convolution->direct_pipeline = convolution_create_pipeline(
+    convolution, convolution->output_bind_group_layout, &shader, "main_direct",
+    "convolution_direct_pipeline");
+  convolution->vertical_pipeline = convolution_create_pipeline(
+    convolution, convolution->output_bind_group_layout, &shader,
+    "main_separable", "convolution_vertical_pipeline");
+  wgpu_shader_release(&shader);
+
+  // The horizontal pass writes the intermediate texture
+  shader = convolution_create_shader(convolution, WGPUTextureFormat_RGBA16Float,
+                                     convolution_shader_wgsl, "main_separable");
+  convolution->horizontal_pipeline = convolution_create_pipeline(
+    convolution, convolution->intermediate_bind_group_layout, &shader,
+    "main_separable", "convolution_horizontal_pipeline");
+  wgpu_shader_release(&shader);
+}
+
+static void convolution_create_fft_pipelines(wgpu_convolution_t* convolution)
+{
+  static const char* entries[5] = {"main_kernel", "main_spectrum", "main_load",
+                                   "main_multiply", "main_store"};
+  WGPUComputePipeline* pipelines[5] = {
+    &convolution->fft.kernel_pipeline,   &convolution->fft.spectrum_pipeline,
+    &convolution->fft.load_pipeline,     &convolution->fft.multiply_pipeline,
+    &convolution->fft.store_pipeline,
+  };
+  wgpu_shader_t shader = convolution_create_shader(
+    convolution, convolution->format, convolution_fft_shader_wgsl, entries[0]);
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(entries); ++i) {
+    *pipelines[i] = convolution_create_pipeline(
+      convolution, convolution->fft_bind_group_layout, &shader, entries[i],
+      "convolution_fft_pipeline");
+  }
+  wgpu_shader_release(&shader);
+}
+
+/* Parameter slots of the passes, grown with the batches of the FFT */
+static void convolution_reserve_params(wgpu_convolution_t* convolution,
+                                       uint32_t slot_count)
+{
+  if (slot_count <= convolution->params_slot_count) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->params_bind_group)
+  wgpu_destroy_buffer(&convolution->params_buffer);
+  convolution->params_slot_count = slot_count;
+  convolution->params_buffer     = wgpu_create_buffer(
+    convolution->wgpu_context,
+    &(wgpu_buffer_desc_t){
+          .label = "convolution_params_buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+          .size  = slot_count * convolution->params_stride,
+    });
+
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = convolution->params_buffer.buffer,
+      .size    = sizeof(convolution_params_t),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = convolution->weights_buffer.buffer,
+      .size    = convolution->weights_buffer.size,
+    },
+  };
+  convolution->params_bind_group = wgpuDeviceCreateBindGroup(
+    convolution->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "convolution_params_bind_group",
+      .layout     = convolution->params_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(convolution->params_bind_group != NULL);
+}
+
+static WGPUBindGroup
+convolution_create_textures_bind_group(wgpu_convolution_t* convolution,
+                                       WGPUBindGroupLayout layout,
+                                       WGPUTextureView src_view,
+                                       WGPUTextureView dst_view, bool fft)
+{
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding     = 0,
+      .textureView = src_view,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = dst_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = fft ? wgpu_fft_get_buffer(convolution->fft.fft) : NULL,
+      .size    = WGPU_WHOLE_SIZE,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = convolution->fft.spectrum_buffer.buffer,
+      .size    = convolution->fft.spectrum_buffer.size,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    convolution->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "convolution_textures_bind_group",
+      .layout     = layout,
+      .entryCount = fft ? 4 : 2,
+      .entries    = bg_entries,
+    });
+  ASSERT(bind_group != NULL);
+  return bind_group;
+}
+
+/* Bind groups of the textures and of the resources of the method */
+static void convolution_create_bind_groups(wgpu_convolution_t* convolution)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->direct_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->horizontal_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->vertical_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->fft_bind_group)
+  if (convolution->src_view == NULL || convolution->dst_view == NULL) {
+    return;
+  }
+
+  convolution->direct_bind_group = convolution_create_textures_bind_group(
+    convolution, convolution->output_bind_group_layout, convolution->src_view,
+    convolution->dst_view, false);
+  if (convolution->intermediate_view != NULL) {
+    convolution->horizontal_bind_group = convolution_create_textures_bind_group(
+      convolution, convolution->intermediate_bind_group_layout,
+      convolution->src_view, convolution->intermediate_view, false);
+    convolution->vertical_bind_group = convolution_create_textures_bind_group(
+      convolution, convolution->output_bind_group_layout,
+      convolution->intermediate_view, convolution->dst_view, false);
+  }
+  if (convolution->fft.fft != NULL) {
+    convolution->fft_bind_group = convolution_create_textures_bind_group(
+      convolution, convolution->fft_bind_group_layout, convolution->src_view,
+      convolution->dst_view, true);
+  }
+}
+
+static void
+convolution_create_intermediate_texture(wgpu_convolution_t* convolution)
+{
+  if (convolution->intermediate_texture != NULL) {
+    return;
+  }
+
+  convolution->intermediate_texture = wgpuDeviceCreateTexture(
+    convolution->wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label     = "convolution_intermediate_texture",
+      .usage     = WGPUTextureUsage_StorageBinding
+                   | WGPUTextureUsage_TextureBinding,
+      .dimension = WGPUTextureDimension_2D,
+      .size      = (WGPUExtent3D){
+        .width              = convolution->width,
+        .height             = convolution->height,
+        .depthOrArrayLayers = 1,
+      },
+      .format        = WGPUTextureFormat_RGBA16Float,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(convolution->intermediate_texture != NULL);
+  convolution->intermediate_view
+    = wgpuTextureCreateView(convolution->intermediate_texture, NULL);
+  ASSERT(convolution->intermediate_view != NULL);
+  convolution_create_bind_groups(convolution);
+}
+
+static uint32_t
+convolution_get_tile_count(const wgpu_convolution_t* convolution,
+                           uint32_t valid_size)
+{
+  return ((convolution->width + valid_size - 1) / valid_size)
+         * ((convolution->height + valid_size - 1) / valid_size);
+}
+
+/* Transform size with the fewest butterflies per image, larger grids waste
+ * less of every tile on the apron */
+static uint32_t convolution_select_grid_size(wgpu_convolution_t* convolution,
+                                             uint32_t kernel_size)
+{
+  uint32_t best_size = 0;
+  double best_cost   = 0.0;
+  for (uint32_t size = CONVOLUTION_FFT_MIN_GRID_SIZE; size <= WGPU_FFT_MAX_SIZE;
+       size *= 2) {
+    if (size < 2 * (kernel_size - 1)) {
+      continue;
+    }
+    const double cost
+      = (double)convolution_get_tile_count(convolution, size - kernel_size + 1)
+        * size * size * log2((double)size);
+    if (best_size == 0 || cost < best_cost) {
+      best_size = size;
+      best_cost = cost;
+    }
+  }
+  return best_size;
+}
+
+static void convolution_prepare_fft(wgpu_convolution_t* convolution,
+                                    uint32_t kernel_size)
+{
+  if (convolution->fft.kernel_pipeline == NULL) {
+    convolution_create_fft_pipelines(convolution);
+  }
+
+  const uint32_t grid_size
+    = convolution_select_grid_size(convolution, kernel_size);
+  ASSERT(grid_size > 0);
+  convolution->fft.valid_size = grid_size - kernel_size + 1;
+  convolution->fft.tiles_x
+    = (convolution->width + convolution->fft.valid_size - 1)
+      / convolution->fft.valid_size;
+  convolution->fft.tile_count
+    = convolution_get_tile_count(convolution, convolution->fft.valid_size);
+  convolution->fft.spectrum_dirty = true;
+  if (grid_size == convolution->fft.grid_size) {
+    return;
+  }
+
+  // Batches of tiles share the grids between the transforms
+  wgpu_fft_release(convolution->fft.fft);
+  wgpu_destroy_buffer(&convolution->fft.spectrum_buffer);
+  convolution->fft.grid_size        = grid_size;
+  convolution->fft.batch_tile_count = MIN(
+    convolution->fft.tile_count, WGPU_CONVOLUTION_FFT_BATCH_TILE_COUNT);
+  convolution->fft.fft = wgpu_fft_create(
+    convolution->wgpu_context,
+    &(wgpu_fft_desc_t){
+      .size        = grid_size,
+      .batch_count = 2 * convolution->fft.batch_tile_count,
+    });
+  ASSERT(convolution->fft.fft != NULL);
+  convolution->fft.spectrum_buffer = wgpu_create_buffer(
+    convolution->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "convolution_spectrum_buffer",
+      .usage = WGPUBufferUsage_Storage,
+      .size  = (uint64_t)grid_size * grid_size * 2 * sizeof(float),
+    });
+  convolution_create_bind_groups(convolution);
+}
+
+wgpu_convolution_t*
+wgpu_convolution_create(wgpu_context_t* wgpu_context,
+                        const wgpu_convolution_desc_t* desc)
+{
+  ASSERT(desc->width > 0 && desc->height > 0);
+
+  wgpu_convolution_t* convolution
+    = (wgpu_convolution_t*)malloc(sizeof(wgpu_convolution_t));
+  memset(convolution, 0, sizeof(wgpu_convolution_t));
+  convolution->wgpu_context  = wgpu_context;
+  convolution->width         = desc->width;
+  convolution->height        = desc->height;
+  convolution->format        = desc->format != WGPUTextureFormat_Undefined ?
+                                 desc->format :
+                                 WGPUTextureFormat_RGBA8Unorm;
+  convolution->fft_threshold = desc->fft_threshold > 0 ?
+                                 MIN(desc->fft_threshold,
+                                     WGPU_CONVOLUTION_MAX_DIRECT_KERNEL_SIZE) :
+                                 WGPU_CONVOLUTION_MAX_DIRECT_KERNEL_SIZE;
+  convolution->forced_method = desc->method;
+
+  // Parameter blocks are aligned to the uniform buffer offset alignment
+  convolution->params_stride
+    = (uint32_t)((sizeof(convolution_params_t) + 255) & ~255);
+  convolution->weights_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "convolution_weights_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = WGPU_CONVOLUTION_MAX_KERNEL_SIZE
+              * WGPU_CONVOLUTION_MAX_KERNEL_SIZE * sizeof(float),
+    });
+
+  convolution_create_bind_group_layouts(convolution);
+  convolution_create_pipelines(convolution);
+  convolution_reserve_params(convolution, CONVOLUTION_SLOT_FFT_BATCH);
+
+  // Identity until a kernel is set
+  const float identity = 1.0f;
+  wgpu_convolution_set_kernel(convolution, &identity, 1);
+
+  return convolution;
+}
+
+void wgpu_convolution_release(wgpu_convolution_t* convolution)
+{
+  if (convolution == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->fft.kernel_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->fft.spectrum_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->fft.load_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->fft.multiply_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->fft.store_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->direct_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->horizontal_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, convolution->vertical_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->fft_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->vertical_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->horizontal_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->direct_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, convolution->params_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, convolution->fft_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        convolution->intermediate_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, convolution->output_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, convolution->params_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(TextureView, convolution->intermediate_view)
+  WGPU_RELEASE_RESOURCE(Texture, convolution->intermediate_texture)
+  wgpu_fft_release(convolution->fft.fft);
+  wgpu_destroy_buffer(&convolution->fft.spectrum_buffer);
+  wgpu_destroy_buffer(&convolution->weights_buffer);
+  wgpu_destroy_buffer(&convolution->params_buffer);
+  free(convolution);
+}
+
+/* Factors a rank one kernel into its column and row through its largest
+ * weight, returns false for other kernels */
+static bool convolution_factor_kernel(const float* weights, uint32_t size,
+                                      float* row, float* column)
+{
+  uint32_t pivot   = 0;
+  float max_weight = 0.0f;
+  for (uint32_t i = 0; i < size * size; ++i) {
+    if (fabsf(weights[i]) > max_weight) {
+      max_weight = fabsf(weights[i]);
+      pivot      = i;
+    }
+  }
+  if (max_weight == 0.0f) {
+    return false;
+  }
+
+  const uint32_t pivot_x = pivot % size, pivot_y = pivot / size;
+  for (uint32_t i = 0; i < size; ++i) {
+    row[i]    = weights[pivot_y * size + i];
+    column[i] = weights[i * size + pivot_x] / weights[pivot];
+  }
+  for (uint32_t j = 0; j < size; ++j) {
+    for (uint32_t i = 0; i < size; ++i) {
+      if (fabsf(weights[j * size + i] - column[j] * row[i])
+          > CONVOLUTION_SEPARABLE_TOLERANCE * max_weight) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+wgpu_convolution_method_t
+wgpu_convolution_set_kernel(wgpu_convolution_t* convolution,
+                            const float* weights, uint32_t size)
+{
+  ASSERT(size % 2 == 1 && size <= WGPU_CONVOLUTION_MAX_KERNEL_SIZE);
+
+  float factors[2 * WGPU_CONVOLUTION_MAX_KERNEL_SIZE];
+  const bool separable
+    = convolution_factor_kernel(weights, size, factors, factors + size);
+  wgpu_convolution_method_t method = convolution->forced_method;
+  if ((method == WGPU_CONVOLUTION_METHOD_SEPARABLE && !separable)
+      || (method == WGPU_CONVOLUTION_METHOD_DIRECT
+          && size > WGPU_CONVOLUTION_MAX_DIRECT_KERNEL_SIZE)) {
+    log_warn("Kernel of size %u cannot use the forced convolution method",
+             size);
+    method = WGPU_CONVOLUTION_METHOD_AUTO;
+  }
+  if (method == WGPU_CONVOLUTION_METHOD_AUTO) {
+    method = separable                            ?
+               WGPU_CONVOLUTION_METHOD_SEPARABLE :
+             size <= convolution->fft_threshold ?
+               WGPU_CONVOLUTION_METHOD_DIRECT :
+               WGPU_CONVOLUTION_METHOD_FFT;
+  }
+  convolution->method      = method;
+  convolution->kernel_size = size;
+
+  wgpu_context_t* wgpu_context = convolution->wgpu_context;
+  if (method == WGPU_CONVOLUTION_METHOD_SEPARABLE) {
+    convolution_create_intermediate_texture(convolution);
+    wgpu_queue_write_buffer(wgpu_context, convolution->weights_buffer.buffer,
+                            0, factors, 2 * size * sizeof(float));
+  }
+  else {
+    wgpu_queue_write_buffer(wgpu_context, convolution->weights_buffer.buffer,
+                            0, weights, size * size * sizeof(float));
+  }
+  uint32_t slot_count = CONVOLUTION_SLOT_FFT_BATCH;
+  if (method == WGPU_CONVOLUTION_METHOD_FFT) {
+    convolution_prepare_fft(convolution, size);
+    convolution->fft.batch_count
+      = (convolution->fft.tile_count + convolution->fft.batch_tile_count - 1)
+        / convolution->fft.batch_tile_count;
+    slot_count += convolution->fft.batch_count;
+  }
+  convolution_reserve_params(convolution, slot_count);
+
+  // Separable passes, then one slot per batch of tiles
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    convolution_params_t params = {
+      .size        = {convolution->width, convolution->height},
+      .kernel_size = size,
+      .vertical    = i == CONVOLUTION_SLOT_VERTICAL,
+      .grid_size   = convolution->fft.grid_size,
+      .valid_size  = convolution->fft.valid_size,
+      .tiles_x     = convolution->fft.tiles_x,
+      .tile_count  = convolution->fft.tile_count,
+    };
+    if (i >= CONVOLUTION_SLOT_FFT_BATCH) {
+      params.first_tile = (i - CONVOLUTION_SLOT_FFT_BATCH)
+                          * convolution->fft.batch_tile_count;
+    }
+    wgpu_queue_write_buffer(wgpu_context, convolution->params_buffer.buffer,
+                            i * convolution->params_stride, &params,
+                            sizeof(params));
+  }
+  return method;
+}
+
+void wgpu_convolution_set_textures(wgpu_convolution_t* convolution,
+                                   WGPUTextureView src_view,
+                                   WGPUTextureView dst_view)
+{
+  convolution->src_view = src_view;
+  convolution->dst_view = dst_view;
+  convolution_create_bind_groups(convolution);
+}
+
+static void convolution_dispatch(wgpu_convolution_t* convolution,
+                                 WGPUComputePassEncoder pass_encoder,
+                                 WGPUComputePipeline pipeline, uint32_t slot,
+                                 WGPUBindGroup bind_group, uint32_t x,
+                                 uint32_t y, uint32_t z)
+{
+  const uint32_t dynamic_offset = slot * convolution->params_stride;
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  wgpuComputePassEncoderSetBindGroup(
+    pass_encoder, 0, convolution->params_bind_group, 1, &dynamic_offset);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, x, y, z);
+}
+
+static void convolution_record_fft(wgpu_convolution_t* convolution,
+                                   WGPUComputePassEncoder pass_encoder)
+{
+  const uint32_t grid_groups
+    = convolution->fft.grid_size / CONVOLUTION_FFT_WORKGROUP_SIZE;
+  const uint32_t valid_groups = (convolution->fft.valid_size
+                                 + CONVOLUTION_FFT_WORKGROUP_SIZE - 1)
+                                / CONVOLUTION_FFT_WORKGROUP_SIZE;
+  const uint32_t grid_texels
+    = convolution->fft.grid_size * convolution->fft.grid_size;
+  WGPUBindGroup bind_group = convolution->fft_bind_group;
+
+  // Spectrum of a new kernel, transformed in the first grid
+  if (convolution->fft.spectrum_dirty) {
+    convolution_dispatch(convolution, pass_encoder,
+                         convolution->fft.kernel_pipeline,
+                         CONVOLUTION_SLOT_FFT_BATCH, bind_group, grid_groups,
+                         grid_groups, 1);
+    wgpu_fft_record(convolution->fft.fft, pass_encoder, false);
+    convolution_dispatch(convolution, pass_encoder,
+                         convolution->fft.spectrum_pipeline,
+                         CONVOLUTION_SLOT_FFT_BATCH, bind_group, grid_groups,
+                         grid_groups, 1);
+    convolution->fft.spectrum_dirty = false;
+  }
+
+  for (uint32_t b = 0; b < convolution->fft.batch_count; ++b) {
+    const uint32_t slot = CONVOLUTION_SLOT_FFT_BATCH + b;
+    convolution_dispatch(convolution, pass_encoder,
+                         convolution->fft.load_pipeline, slot, bind_group,
+                         grid_groups, grid_groups,
+                         convolution->fft.batch_tile_count);
+    wgpu_fft_record(convolution->fft.fft, pass_encoder, false);
+    convolution_dispatch(convolution, pass_encoder,
+                         convolution->fft.multiply_pipeline, slot, bind_group,
+                         (grid_texels + 63) / 64,
+                         2 * convolution->fft.batch_tile_count, 1);
+    wgpu_fft_record(convolution->fft.fft, pass_encoder, true);
+    convolution_dispatch(convolution, pass_encoder,
+                         convolution->fft.store_pipeline, slot, bind_group,
+                         valid_groups, valid_groups,
+                         convolution->fft.batch_tile_count);
+  }
+}
+
+void wgpu_convolution_record(wgpu_convolution_t* convolution,
+                             WGPUComputePassEncoder pass_encoder)
+{
+  ASSERT(convolution->direct_bind_group != NULL);
+
+  const uint32_t width  = convolution->width;
+  const uint32_t height = convolution->height;
+  switch (convolution->method) {
+    case WGPU_CONVOLUTION_METHOD_SEPARABLE:
+      convolution_dispatch(
+        convolution, pass_encoder, convolution->horizontal_pipeline,
+        CONVOLUTION_SLOT_HORIZONTAL, convolution->horizontal_bind_group,
+        (width + CONVOLUTION_ROW_TILE_SIZE - 1) / CONVOLUTION_ROW_TILE_SIZE,
+        height, 1);
+      convolution_dispatch(
+        convolution, pass_encoder, convolution->vertical_pipeline,
+        CONVOLUTION_SLOT_VERTICAL, convolution->vertical_bind_group,
+        (height + CONVOLUTION_ROW_TILE_SIZE - 1) / CONVOLUTION_ROW_TILE_SIZE,
+        width, 1);
+      break;
+    case WGPU_CONVOLUTION_METHOD_FFT:
+      convolution_record_fft(convolution, pass_encoder);
+      break;
+    default:
+      convolution_dispatch(
+        convolution, pass_encoder, convolution->direct_pipeline,
+        CONVOLUTION_SLOT_HORIZONTAL, convolution->direct_bind_group,
+        (width + CONVOLUTION_DIRECT_TILE_SIZE - 1)
+          / CONVOLUTION_DIRECT_TILE_SIZE,
+        (height + CONVOLUTION_DIRECT_TILE_SIZE - 1)
+          / CONVOLUTION_DIRECT_TILE_SIZE,
+        1);
+      break;
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include "context.h"
+
+/* Largest supported kernel, kernels are square with an odd size */
+#define WGPU_CONVOLUTION_MAX_KERNEL_SIZE 127u
+
+/* Largest kernel of the direct pass, its tile and apron fill the workgroup
+ * memory */
+#define WGPU_CONVOLUTION_MAX_DIRECT_KERNEL_SIZE 17u
+
+/* Tiles of the image transformed per batch by the FFT method */
+#define WGPU_CONVOLUTION_FFT_BATCH_TILE_COUNT 8u
+
+typedef enum wgpu_convolution_method_t {
+  /* Separable kernels run as two 1D passes, the others directly up to the
+   * FFT threshold and as FFT above it */
+  WGPU_CONVOLUTION_METHOD_AUTO      = 0,
+  WGPU_CONVOLUTION_METHOD_DIRECT    = 1,
+  WGPU_CONVOLUTION_METHOD_SEPARABLE = 2,
+  WGPU_CONVOLUTION_METHOD_FFT       = 3,
+} wgpu_convolution_method_t;
+
+/*
+ * Convolution of 2D textures with square kernels in compute shaders. The
+ * kernel is applied as out(p) = sum of weights[j][i] * in(p + (i - r, j - r))
+ * over the kernel of radius r, the image is clamped at its edges.
+ *
+ * The method follows the kernel:
+ * - a kernel of rank one, the outer product of a column and a row, is applied
+ *   as a horizontal pass into an intermediate rgba16float texture followed by
+ *   a vertical pass, 2N instead of N^2 taps per texel. Both passes load a row
+ *   tile and its apron into workgroup memory once,
+ * - smaller kernels loop over all taps of a 2D tile and its apron in
+ *   workgroup memory,
+ * - larger kernels are convolved in the frequency domain with the FFT of
+ *   fft.h, overlap-save: the image is cut into tiles of the transform size
+ *   minus the kernel apron, two color channels are packed into the real and
+ *   imaginary part of one grid, and the grids of a batch of tiles are
+ *   transformed, multiplied with the spectrum of the kernel and transformed
+ *   back. The cost per texel no longer grows with the kernel size.
+ */
+typedef struct wgpu_convolution wgpu_convolution_t;
+
+typedef struct wgpu_convolution_desc_t {
+  /* Size of the source and destination textures */
+  uint32_t width;
+  uint32_t height;
+  /* Format of the destination storage texture, Undefined selects
+   * RGBA8Unorm */
+  WGPUTextureFormat format;
+  /* Non-separable kernels larger than this one use the FFT, 0 selects
+   * WGPU_CONVOLUTION_MAX_DIRECT_KERNEL_SIZE, which also bounds it */
+  uint32_t fft_threshold;
+  /* Forces a method where the kernel allows it */
+  wgpu_convolution_method_t method;
+} wgpu_convolution_desc_t;
+
+/* Convolution creating/releasing */
+wgpu_convolution_t*
+wgpu_convolution_create(wgpu_context_t* wgpu_context,
+                        const wgpu_convolution_desc_t* desc);
+void wgpu_convolution_release(wgpu_convolution_t* convolution);
+
+/**
+ * @brief Sets the kernel, size x size weights in row major order of an odd
+ * size up to WGPU_CONVOLUTION_MAX_KERNEL_SIZE, and selects the method. A
+ * forced method the kernel does not allow is replaced by the automatic one.
+ * @return the method the kernel is applied with
+ */
+wgpu_convolution_method_t
+wgpu_convolution_set_kernel(wgpu_convolution_t* convolution,
+                            const float* weights, uint32_t size);
+
+/* Sets the source, a 2D float texture, and the destination, a storage texture
+ * of the format of the convolution, both of the size of the convolution */
+void wgpu_convolution_set_textures(wgpu_convolution_t* convolution,
+                                   WGPUTextureView src_view,
+                                   WGPUTextureView dst_view);
+
+/* Records the passes of the method of the kernel, overwrites the bind groups
+ * 0 and 1 */
+void wgpu_convolution_record(wgpu_convolution_t* convolution,
+                             WGPUComputePassEncoder pass_encoder);
+
+#endif
@@ -0,0 +1,267 @@
+#include "depth_prepass.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "gltf_model.h"
+#include "shader.h"
+
+/* Layout of Camera */
+typedef struct depth_prepass_camera_t {
+  mat4 projection;
+  mat4 view;
+} depth_prepass_camera_t;
+
+struct wgpu_depth_prepass {
+  wgpu_context_t* wgpu_context;
+  WGPUTextureFormat depth_format;
+  wgpu_buffer_t camera_buffer;
+  WGPUBindGroupLayout camera_bind_group_layout;
+  WGPUBindGroup camera_bind_group;
+  /* Back face culling and double sided */
+  WGPURenderPipeline pipelines[2];
+};
+
+// Same association as the shading vertex shaders, the depths have to be
+// bitwise identical for the Equal test
+// clang-format off
+static const char* depth_prepass_shader_wgsl = CODE(
+  struct Camera {
+    projection : mat4x4<f32>,
+    view : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> camera : Camera;
+  @group(1) @binding(0) var<uniform> model : mat4x4<f32>;
+
+  @vertex
+  fn main(@location(0) position : vec3<f32>) -> @builtin(position) vec4<f32> {
+    return camera.projection * camera.view * model * vec4<f32>(position, 1.0);
+  }
+);
+// clang-format on
+
+static void depth_prepass_create_camera(wgpu_depth_prepass_t* depth_prepass)
+{
+  wgpu_context_t* wgpu_context = depth_prepass->wgpu_context;
+
+  depth_prepass->camera_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "depth_prepass_camera_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(depth_prepass_camera_t),
+                  });
+
+  WGPUBindGroupLayoutEntry bgl_entries[1] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Camera
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Vertex,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(depth_prepass_camera_t),
+      },
+      .sampler = {0},
+    },
+  };
+  depth_prepass->camera_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "depth_prepass_camera_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(depth_prepass->camera_bind_group_layout != NULL);
+
+  WGPUBindGroupEntry bg_entries[1] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = depth_prepass->camera_buffer.buffer,
+      .size    = depth_prepass->camera_buffer.size,
+    },
+  };
+  depth_prepass->camera_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "depth_prepass_camera_bind_group",
+      .layout     = depth_prepass->camera_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(depth_prepass->camera_bind_group != NULL);
+}
+
+static void depth_prepass_create_pipelines(wgpu_depth_prepass_t* depth_prepass,
+                                           WGPUBindGroupLayout model_layout,
+                                           uint32_t sample_count)
+{
+  wgpu_context_t* wgpu_context = depth_prepass->wgpu_context;
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    depth_prepass->camera_bind_group_layout, // Group 0
+    model_layout,                            // Group 1
+  };
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "depth_prepass_pl",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(pipeline_layout != NULL);
+
+  // Depth stencil state
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = depth_prepass->depth_format,
+      .depth_write_enabled = true,
+    });
+
+  // Vertex buffer layout, the pre-pass only reads positions
+  WGPU_VERTEX_BUFFER_LAYOUT(
+    depth_prepass, sizeof(float) * 3,
+    // Attribute location 0: Position
+    WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0))
+
+  // Vertex state
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "depth_prepass_shader",
+                  .wgsl_code.source = depth_prepass_shader_wgsl,
+                  .entry            = "main",
+                },
+                .buffer_count = 1,
+                .buffers      = &depth_prepass_vertex_buffer_layout,
+              });
+
+  // Multisample state
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = sample_count,
+      });
+
+  // The culling follows the one of the shading pipelines, a back face missing
+  // in the depth buffer would hide the surface behind it
+  static const WGPUCullMode cull_modes[2] = {
+    WGPUCullMode_Back, // Single sided
+    WGPUCullMode_None, // Double sided
+  };
+  for (uint32_t i = 0; i < ARRAY_SIZE(cull_modes); ++i) {
+    depth_prepass->pipelines[i] = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                              .label     = "depth_prepass_pipeline",
+                              .layout    = pipeline_layout,
+                              .primitive = (WGPUPrimitiveState){
+                                .topology  = WGPUPrimitiveTopology_TriangleList,
+                                .frontFace = WGPUFrontFace_CCW,
+                                .cullMode  = cull_modes[i],
+                              },
+                              .vertex       = vertex_state,
+                              .fragment     = NULL,
+                              .depthStencil = &depth_stencil_state,
+                              .multisample  = multisample_state,
+                            });
+    ASSERT(depth_prepass->pipelines[i] != NULL);
+  }
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_depth_prepass_t*
+wgpu_depth_prepass_create(wgpu_context_t* wgpu_context,
+                          const wgpu_depth_prepass_desc_t* desc)
+{
+  ASSERT(desc->model_bind_group_layout != NULL);
+
+  wgpu_depth_prepass_t* depth_prepass
+    = (wgpu_depth_prepass_t*)malloc(sizeof(wgpu_depth_prepass_t));
+  memset(depth_prepass, 0, sizeof(wgpu_depth_prepass_t));
+  depth_prepass->wgpu_context = wgpu_context;
+  depth_prepass->depth_format
+    = desc->depth_format != WGPUTextureFormat_Undefined ?
+        desc->depth_format :
+        WGPUTextureFormat_Depth24PlusStencil8;
+
+  depth_prepass_create_camera(depth_prepass);
+  depth_prepass_create_pipelines(depth_prepass, desc->model_bind_group_layout,
+                                 desc->sample_count > 0 ? desc->sample_count :
+                                                          1);
+
+  return depth_prepass;
+}
+
+void wgpu_depth_prepass_release(wgpu_depth_prepass_t* depth_prepass)
+{
+  if (depth_prepass == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < ARRAY_SIZE(depth_prepass->pipelines); ++i) {
+    WGPU_RELEASE_RESOURCE(RenderPipeline, depth_prepass->pipelines[i])
+  }
+  WGPU_RELEASE_RESOURCE(BindGroup, depth_prepass->camera_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        depth_prepass->camera_bind_group_layout)
+  wgpu_destroy_buffer(&depth_prepass->camera_buffer);
+  free(depth_prepass);
+}
+
+void wgpu_depth_prepass_update(wgpu_depth_prepass_t* depth_prepass,
+                               mat4 projection, mat4 view)
+{
+  depth_prepass_camera_t camera;
+  glm_mat4_copy(projection, camera.projection);
+  glm_mat4_copy(view, camera.view);
+  wgpu_queue_write_buffer(depth_prepass->wgpu_context,
+                          depth_prepass->camera_buffer.buffer, 0, &camera,
+                          sizeof(camera));
+}
+
+void wgpu_depth_prepass_bind(wgpu_depth_prepass_t* depth_prepass,
+                             WGPURenderPassEncoder pass_encoder,
+                             bool double_sided)
+{
+  wgpuRenderPassEncoderSetPipeline(pass_encoder,
+                                   depth_prepass->pipelines[double_sided]);
+  wgpuRenderPassEncoderSetBindGroup(pass_encoder, 0,
+                                    depth_prepass->camera_bind_group, 0, NULL);
+}
+
+void wgpu_depth_prepass_draw_gltf_model(wgpu_depth_prepass_t* depth_prepass,
+                                        WGPURenderPassEncoder pass_encoder,
+                                        struct gltf_model_t* model,
+                                        struct frustum_t* frustum)
+{
+  wgpu_depth_prepass_bind(depth_prepass, pass_encoder, false);
+  wgpu_gltf_model_draw_to_pass(
+    model, pass_encoder,
+    (wgpu_gltf_model_render_options_t){
+      .render_flags = WGPU_GLTF_RenderFlags_PositionsOnly
+                      | WGPU_GLTF_RenderFlags_RenderOpaqueNodes,
+      .bind_mesh_model_set = 1,
+      .frustum             = frustum,
+      .position_pipelines  = {
+        depth_prepass->pipelines[0],
+        depth_prepass->pipelines[1],
+      },
+    });
+}
+
+WGPUDepthStencilState
+wgpu_depth_prepass_get_shading_depth_stencil_state(
+  wgpu_depth_prepass_t* depth_prepass)
+{
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = depth_prepass->depth_format,
+      .depth_write_enabled = false,
+    });
+  depth_stencil_state.depthCompare = WGPUCompareFunction_Equal;
+  return depth_stencil_state;
+}
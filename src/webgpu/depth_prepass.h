@@ -0,0 +1,71 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+struct frustum_t;
+struct gltf_model_t;
+
+/*
+ * Depth pre-pass of forward renderers: the opaque geometry is drawn first with
+ * a depth-only pipeline over a position-only vertex stream, a vec3<f32> at
+ * location 0 of the vertex buffer at slot 0:
+ *   @group(0) camera projection and view, set by the pre-pass
+ *   @group(1) @binding(0) var<uniform> model : mat4x4<f32>, set by the caller
+ * The shading pipelines drawn afterwards in the same render pass test against
+ * the resolved depth with the Equal compare function and without depth
+ * writes, so that the expensive fragment shading only runs once per pixel.
+ * Their vertex shaders have to compute the clip space position with the same
+ * expression, projection * view * model * position, for the depths to match.
+ * Alpha masked and blended geometry is not part of the pre-pass and is shaded
+ * with the usual Less compare function.
+ */
+typedef struct wgpu_depth_prepass wgpu_depth_prepass_t;
+
+typedef struct wgpu_depth_prepass_desc_t {
+  /* Depth format of the render pass, Undefined selects Depth24PlusStencil8 */
+  WGPUTextureFormat depth_format;
+  /* Sample count of the render pass, 0 selects 1 */
+  uint32_t sample_count;
+  /* Layout of the model matrix at group 1 of the depth-only pipeline, the
+   * glTF node bind groups are prepared with it */
+  WGPUBindGroupLayout model_bind_group_layout;
+} wgpu_depth_prepass_desc_t;
+
+/* Depth pre-pass creating/releasing */
+wgpu_depth_prepass_t*
+wgpu_depth_prepass_create(wgpu_context_t* wgpu_context,
+                          const wgpu_depth_prepass_desc_t* desc);
+void wgpu_depth_prepass_release(wgpu_depth_prepass_t* depth_prepass);
+
+/* Writes the camera matrices of the frame */
+void wgpu_depth_prepass_update(wgpu_depth_prepass_t* depth_prepass,
+                               mat4 projection, mat4 view);
+
+/* Binds the depth-only pipeline, culling back faces unless double_sided, and
+ * the camera at group 0 */
+void wgpu_depth_prepass_bind(wgpu_depth_prepass_t* depth_prepass,
+                             WGPURenderPassEncoder pass_encoder,
+                             bool double_sided);
+
+/**
+ * @brief Draws the opaque nodes of a glTF model loaded with
+ * WGPU_GLTF_FileLoadingFlags_PositionStream into the depth buffer, the node
+ * bind groups have been prepared with the model bind group layout. The
+ * frustum is optional. The pipeline and group 0 of the shading pass have to
+ * be set again afterwards.
+ */
+void wgpu_depth_prepass_draw_gltf_model(wgpu_depth_prepass_t* depth_prepass,
+                                        WGPURenderPassEncoder pass_encoder,
+                                        struct gltf_model_t* model,
+                                        struct frustum_t* frustum);
+
+/* Depth stencil state of the shading pipelines of the opaque geometry drawn
+ * after the pre-pass */
+WGPUDepthStencilState
+wgpu_depth_prepass_get_shading_depth_stencil_state(
+  wgpu_depth_prepass_t* depth_prepass);
+
+#endif
@@ -0,0 +1,396 @@
+#include "depth_pyramid.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "shader.h"
+
+#define WGPU_DEPTH_PYRAMID_WORKGROUP_SIZE 8u
+
+struct wgpu_depth_pyramid {
+  wgpu_context_t* wgpu_context;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_level_count;
+  WGPUTexture texture;
+  WGPUTextureView view; /* all mip levels */
+  WGPUTextureView mip_views[WGPU_DEPTH_PYRAMID_MAX_MIP_LEVEL_COUNT];
+  WGPUComputePipeline copy_pipeline;
+  WGPUBindGroupLayout reduce_bind_group_layout;
+  WGPUComputePipeline reduce_pipeline;
+  /* Bind group i reads level i and writes level i + 1 */
+  WGPUBindGroup reduce_bind_groups[WGPU_DEPTH_PYRAMID_MAX_MIP_LEVEL_COUNT];
+};
+
+// clang-format off
+static const char* depth_pyramid_copy_shader_wgsl = CODE(
+  @group(0) @binding(0) var src : texture_depth_2d;
+  @group(0) @binding(1) var dst : texture_storage_2d<rg32float, write>;
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let pos = vec2<i32>(id.xy);
+    if (any(pos >= vec2<i32>(textureDimensions(dst)))) {
+      return;
+    }
+    let depth = textureLoad(src, pos, 0);
+    textureStore(dst, pos, vec4<f32>(depth, depth, 0.0, 1.0));
+  }
+);
+
+// Every texel of the source level is covered, the last texel of an odd sized
+// row or column also covers the one left over by the rounded down size
+static const char* depth_pyramid_reduce_shader_wgsl = CODE(
+  @group(0) @binding(0) var src : texture_2d<f32>;
+  @group(0) @binding(1) var dst : texture_storage_2d<rg32float, write>;
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let pos = vec2<i32>(id.xy);
+    let dstSize = vec2<i32>(textureDimensions(dst));
+    if (any(pos >= dstSize)) {
+      return;
+    }
+    let srcSize = vec2<i32>(textureDimensions(src));
+    let maxPos = srcSize - vec2<i32>(1);
+    let base = pos * 2;
+    var extent = vec2<i32>(2);
+    if (pos.x == dstSize.x - 1 && (srcSize.x & 1) == 1 && srcSize.x > 1) {
+      extent.x = 3;
+    }
+    if (pos.y == dstSize.y - 1 && (srcSize.y & 1) == 1 && srcSize.y > 1) {
+      extent.y = 3;
+    }
+    var depthRange = vec2<f32>(1.0, 0.0);
+    for (var y = 0; y < extent.y; y = y + 1) {
+      for (var x = 0; x < extent.x; x = x + 1) {
+        let texel = min(base + vec2<i32>(x, y), maxPos);
+        let range = textureLoad(src, texel, 0).rg;
+        depthRange = vec2<f32>(min(depthRange.x, range.x),
+                               max(depthRange.y, range.y));
+      }
+    }
+    textureStore(dst, pos, vec4<f32>(depthRange, 0.0, 1.0));
+  }
+);
+
+static const char* depth_pyramid_wgsl_functions = CODE(
+  // Nearest and farthest depth of the pyramid texels covering a rectangle in
+  // texture coordinates, from the level where it covers at most 2x2 texels
+  fn hizGetDepthRange(pyramid : texture_2d<f32>, rectMin : vec2<f32>,
+                      rectMax : vec2<f32>) -> vec2<f32> {
+    let rMin = clamp(rectMin, vec2<f32>(0.0), vec2<f32>(1.0));
+    let rMax = clamp(rectMax, vec2<f32>(0.0), vec2<f32>(1.0));
+    let size = (rMax - rMin) * vec2<f32>(textureDimensions(pyramid, 0));
+    let level = i32(min(u32(ceil(log2(max(max(size.x, size.y), 1.0)))),
+                        u32(textureNumLevels(pyramid)) - 1u));
+    let levelSize = vec2<i32>(textureDimensions(pyramid, level));
+    let maxTexel = levelSize - vec2<i32>(1);
+    let t0 = clamp(vec2<i32>(rMin * vec2<f32>(levelSize)), vec2<i32>(0),
+                   maxTexel);
+    let t1 = clamp(vec2<i32>(rMax * vec2<f32>(levelSize)), vec2<i32>(0),
+                   maxTexel);
+    let d00 = textureLoad(pyramid, t0, level).rg;
+    let d10 = textureLoad(pyramid, vec2<i32>(t1.x, t0.y), level).rg;
+    let d01 = textureLoad(pyramid, vec2<i32>(t0.x, t1.y), level).rg;
+    let d11 = textureLoad(pyramid, t1, level).rg;
+    return vec2<f32>(min(min(d00.x, d10.x), min(d01.x, d11.x)),
+                     max(max(d00.y, d10.y), max(d01.y, d11.y)));
+  }
+
+  // True when a box, transformed to clip space by m, lies behind the
+  // farthest depth of the pyramid. Boxes crossing the near plane are visible.
+  fn hizIsBoxOccluded(pyramid : texture_2d<f32>, m : mat4x4<f32>,
+                      bbMin : vec3<f32>, bbMax : vec3<f32>) -> bool {
+    var rectMin = vec2<f32>(1.0);
+    var rectMax = vec2<f32>(0.0);
+    var nearestDepth = 1.0;
+    for (var i = 0u; i < 8u; i = i + 1u) {
+      let corner = vec3<f32>(select(bbMin.x, bbMax.x, (i & 1u) != 0u),
+                             select(bbMin.y, bbMax.y, (i & 2u) != 0u),
+                             select(bbMin.z, bbMax.z, (i & 4u) != 0u));
+      let c = m * vec4<f32>(corner, 1.0);
+      if (c.w <= 0.0) {
+        return false;
+      }
+      let ndc = c.xyz / c.w;
+      let uv = vec2<f32>(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+      rectMin = min(rectMin, uv);
+      rectMax = max(rectMax, uv);
+      nearestDepth = min(nearestDepth, ndc.z);
+    }
+    return nearestDepth > hizGetDepthRange(pyramid, rectMin, rectMax).y;
+  }
+);
+// clang-format on
+
+static WGPUComputePipeline
+depth_pyramid_create_pipeline(wgpu_context_t* wgpu_context, const char* label,
+                              const char* wgsl, WGPUPipelineLayout layout)
+{
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = label,
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = label,
+      .layout  = layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+
+  return pipeline;
+}
+
+static void depth_pyramid_create_pipelines(wgpu_depth_pyramid_t* pyramid)
+{
+  wgpu_context_t* wgpu_context = pyramid->wgpu_context;
+
+  // Depth to rg32float copy, the default layout matches the depth binding
+  pyramid->copy_pipeline = depth_pyramid_create_pipeline(
+    wgpu_context, "depth_pyramid_copy_pipeline",
+    depth_pyramid_copy_shader_wgsl, NULL);
+
+  // rg32float is not filterable, which the default layout would assume
+  WGPUBindGroupLayoutEntry bgl_entries[2] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Source mip level
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Destination mip level
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .storageTexture = (WGPUStorageTextureBindingLayout) {
+        .access        = WGPUStorageTextureAccess_WriteOnly,
+        .format        = WGPUTextureFormat_RG32Float,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .sampler = {0},
+    },
+  };
+  pyramid->reduce_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "depth_pyramid_reduce_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(pyramid->reduce_bind_group_layout != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "depth_pyramid_reduce_pl",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &pyramid->reduce_bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+  pyramid->reduce_pipeline = depth_pyramid_create_pipeline(
+    wgpu_context, "depth_pyramid_reduce_pipeline",
+    depth_pyramid_reduce_shader_wgsl, pipeline_layout);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_depth_pyramid_t* wgpu_depth_pyramid_create(wgpu_context_t* wgpu_context,
+                                                uint32_t width,
+                                                uint32_t height)
+{
+  ASSERT(width > 0 && height > 0);
+
+  wgpu_depth_pyramid_t* pyramid
+    = (wgpu_depth_pyramid_t*)malloc(sizeof(wgpu_depth_pyramid_t));
+  memset(pyramid, 0, sizeof(wgpu_depth_pyramid_t));
+  pyramid->wgpu_context = wgpu_context;
+  pyramid->width        = width;
+  pyramid->height       = height;
+
+  // Down to a single texel
+  uint32_t size = MAX(width, height);
+  while (size > 0
+         && pyramid->mip_level_count < WGPU_DEPTH_PYRAMID_MAX_MIP_LEVEL_COUNT) {
+    ++pyramid->mip_level_count;
+    size >>= 1;
+  }
+
+  pyramid->texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "depth_pyramid_texture",
+      .usage         = WGPUTextureUsage_StorageBinding
+                       | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){width, height, 1},
+      .format        = WGPUTextureFormat_RG32Float,
+      .mipLevelCount = pyramid->mip_level_count,
+      .sampleCount   = 1,
+    });
+  ASSERT(pyramid->texture != NULL);
+
+  pyramid->view = wgpuTextureCreateView(
+    pyramid->texture, &(WGPUTextureViewDescriptor){
+                        .label           = "depth_pyramid_view",
+                        .format          = WGPUTextureFormat_RG32Float,
+                        .dimension       = WGPUTextureViewDimension_2D,
+                        .baseMipLevel    = 0,
+                        .mipLevelCount   = pyramid->mip_level_count,
+                        .baseArrayLayer  = 0,
+                        .arrayLayerCount = 1,
+                        .aspect          = WGPUTextureAspect_All,
+                      });
+  ASSERT(pyramid->view != NULL);
+  for (uint32_t i = 0; i < pyramid->mip_level_count; ++i) {
+    pyramid->mip_views[i] = wgpuTextureCreateView(
+      pyramid->texture, &(WGPUTextureViewDescriptor){
+                          .label           = "depth_pyramid_mip_view",
+                          .format          = WGPUTextureFormat_RG32Float,
+                          .dimension       = WGPUTextureViewDimension_2D,
+                          .baseMipLevel    = i,
+                          .mipLevelCount   = 1,
+                          .baseArrayLayer  = 0,
+                          .arrayLayerCount = 1,
+                          .aspect          = WGPUTextureAspect_All,
+                        });
+    ASSERT(pyramid->mip_views[i] != NULL);
+  }
+
+  depth_pyramid_create_pipelines(pyramid);
+
+  // The reductions only depend on the pyramid itself
+  for (uint32_t i = 0; i + 1 < pyramid->mip_level_count; ++i) {
+    WGPUBindGroupEntry bg_entries[2] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding     = 0,
+        .textureView = pyramid->mip_views[i],
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding     = 1,
+        .textureView = pyramid->mip_views[i + 1],
+      },
+    };
+    pyramid->reduce_bind_groups[i] = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label  = "depth_pyramid_reduce_bind_group",
+                              .layout = pyramid->reduce_bind_group_layout,
+                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entries    = bg_entries,
+                            });
+    ASSERT(pyramid->reduce_bind_groups[i] != NULL);
+  }
+
+  return pyramid;
+}
+
+void wgpu_depth_pyramid_release(wgpu_depth_pyramid_t* depth_pyramid)
+{
+  if (depth_pyramid == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < depth_pyramid->mip_level_count; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, depth_pyramid->reduce_bind_groups[i]);
+    WGPU_RELEASE_RESOURCE(TextureView, depth_pyramid->mip_views[i]);
+  }
+  WGPU_RELEASE_RESOURCE(ComputePipeline, depth_pyramid->reduce_pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        depth_pyramid->reduce_bind_group_layout);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, depth_pyramid->copy_pipeline);
+  WGPU_RELEASE_RESOURCE(TextureView, depth_pyramid->view);
+  WGPU_RELEASE_RESOURCE(Texture, depth_pyramid->texture);
+
+  free(depth_pyramid);
+}
+
+static void depth_pyramid_dispatch(WGPUComputePassEncoder pass_encoder,
+                                   uint32_t width, uint32_t height)
+{
+  const uint32_t group_size = WGPU_DEPTH_PYRAMID_WORKGROUP_SIZE;
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder, (width + group_size - 1) / group_size,
+    (height + group_size - 1) / group_size, 1);
+}
+
+void wgpu_depth_pyramid_build(wgpu_depth_pyramid_t* depth_pyramid,
+                              WGPUComputePassEncoder pass_encoder,
+                              WGPUTextureView depth_view)
+{
+  wgpu_context_t* wgpu_context = depth_pyramid->wgpu_context;
+
+  // Level 0, the depth view may change with every frame
+  WGPUBindGroupLayout copy_bind_group_layout
+    = wgpuComputePipelineGetBindGroupLayout(depth_pyramid->copy_pipeline, 0);
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding     = 0,
+      .textureView = depth_view,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = depth_pyramid->mip_views[0],
+    },
+  };
+  WGPUBindGroup copy_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "depth_pyramid_copy_bind_group",
+                            .layout     = copy_bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(copy_bind_group != NULL);
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    depth_pyramid->copy_pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, copy_bind_group, 0,
+                                     NULL);
+  depth_pyramid_dispatch(pass_encoder, depth_pyramid->width,
+                         depth_pyramid->height);
+  // The pass encoder keeps its own references on the bound resources
+  WGPU_RELEASE_RESOURCE(BindGroup, copy_bind_group);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, copy_bind_group_layout);
+
+  // Following levels, each dispatch reads the level written by the previous
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    depth_pyramid->reduce_pipeline);
+  for (uint32_t i = 1; i < depth_pyramid->mip_level_count; ++i) {
+    wgpuComputePassEncoderSetBindGroup(
+      pass_encoder, 0, depth_pyramid->reduce_bind_groups[i - 1], 0, NULL);
+    depth_pyramid_dispatch(pass_encoder, MAX(1u, depth_pyramid->width >> i),
+                           MAX(1u, depth_pyramid->height >> i));
+  }
+}
+
+WGPUTextureView wgpu_depth_pyramid_get_view(wgpu_depth_pyramid_t* pyramid)
+{
+  return pyramid->view;
+}
+
+uint32_t wgpu_depth_pyramid_get_width(wgpu_depth_pyramid_t* pyramid)
+{
+  return pyramid->width;
+}
+
+uint32_t wgpu_depth_pyramid_get_height(wgpu_depth_pyramid_t* pyramid)
+{
+  return pyramid->height;
+}
+
+uint32_t wgpu_depth_pyramid_get_mip_level_count(wgpu_depth_pyramid_t* pyramid)
+{
+  return pyramid->mip_level_count;
+}
+
+const char* wgpu_depth_pyramid_get_wgsl_functions(void)
+{
+  return depth_pyramid_wgsl_functions;
+}
@@ -0,0 +1,50 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include "context.h"
+
+#define WGPU_DEPTH_PYRAMID_MAX_MIP_LEVEL_COUNT 16u
+
+/*
+ * Hierarchical depth buffer (Hi-Z) for occlusion culling on the GPU. Mip level
+ * 0 is a copy of the depth buffer, every texel of the following levels holds
+ * the nearest (r) and farthest (g) depth of the texels it covers in the
+ * previous level. Depth is expected to increase with the distance to the
+ * camera (no reversed z).
+ */
+typedef struct wgpu_depth_pyramid wgpu_depth_pyramid_t;
+
+/* Depth pyramid creating/releasing, width and height of the depth buffer */
+wgpu_depth_pyramid_t* wgpu_depth_pyramid_create(wgpu_context_t* wgpu_context,
+                                                uint32_t width,
+                                                uint32_t height);
+void wgpu_depth_pyramid_release(wgpu_depth_pyramid_t* depth_pyramid);
+
+/*
+ * Records the reduction of a single-sampled depth buffer with the size the
+ * pyramid was created with. The depth texture needs the TextureBinding usage
+ * and the view the depth aspect only, see
+ * deph_stencil_texture_creation_options_t.sampled.
+ */
+void wgpu_depth_pyramid_build(wgpu_depth_pyramid_t* depth_pyramid,
+                              WGPUComputePassEncoder pass_encoder,
+                              WGPUTextureView depth_view);
+
+/* rg32float view of all mip levels, to be read with textureLoad */
+WGPUTextureView wgpu_depth_pyramid_get_view(wgpu_depth_pyramid_t* pyramid);
+uint32_t wgpu_depth_pyramid_get_width(wgpu_depth_pyramid_t* pyramid);
+uint32_t wgpu_depth_pyramid_get_height(wgpu_depth_pyramid_t* pyramid);
+uint32_t wgpu_depth_pyramid_get_mip_level_count(wgpu_depth_pyramid_t* pyramid);
+
+/*
+ * WGSL visibility test functions for culling shaders, to be prepended to their
+ * source. The pyramid is bound as texture_2d<f32> with an unfilterable-float
+ * sample type:
+ *   fn hizGetDepthRange(pyramid : texture_2d<f32>, rectMin : vec2<f32>,
+ *                       rectMax : vec2<f32>) -> vec2<f32>
+ *   fn hizIsBoxOccluded(pyramid : texture_2d<f32>, m : mat4x4<f32>,
+ *                       bbMin : vec3<f32>, bbMax : vec3<f32>) -> bool
+ */
+const char* wgpu_depth_pyramid_get_wgsl_functions(void);
+
+#endif
@@ -0,0 +1,151 @@
+#include "dynamic_resolution.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+/* Frames after a scale change whose times are skipped, the GPU profiler reads
+ * the timestamps back a few frames late */
+#define WGPU_DYNAMIC_RESOLUTION_LATENCY_FRAMES 4u
+/* Frames averaged after the latency until the scale may change again */
+#define WGPU_DYNAMIC_RESOLUTION_SETTLE_FRAMES 8u
+/* Weight of a new frame time in the moving average */
+#define WGPU_DYNAMIC_RESOLUTION_SMOOTHING 0.2f
+/* The scale is lowered above the target and raised again below this share of
+ * it, the band in between keeps the scale from oscillating */
+#define WGPU_DYNAMIC_RESOLUTION_RAISE_THRESHOLD 0.8f
+/* Share of the target frame time a new scale aims for */
+#define WGPU_DYNAMIC_RESOLUTION_HEADROOM 0.9f
+/* Largest changes of the scale per adjustment, lowering is faster than raising
+ * to recover quickly from spikes */
+#define WGPU_DYNAMIC_RESOLUTION_MAX_DECREASE 0.15f
+#define WGPU_DYNAMIC_RESOLUTION_MAX_INCREASE 0.05f
+
+struct wgpu_dynamic_resolution {
+  wgpu_dynamic_resolution_desc_t desc;
+  float scale;
+  float frame_time_ms; /* moving average, 0 until the first sample */
+  uint32_t frames_since_change;
+};
+
+wgpu_dynamic_resolution_t*
+wgpu_dynamic_resolution_create(const wgpu_dynamic_resolution_desc_t* desc)
+{
+  ASSERT(desc != NULL && desc->target_frame_time_ms > 0.0f);
+
+  wgpu_dynamic_resolution_t* dynamic_resolution
+    = (wgpu_dynamic_resolution_t*)malloc(sizeof(wgpu_dynamic_resolution_t));
+  memset(dynamic_resolution, 0, sizeof(wgpu_dynamic_resolution_t));
+
+  dynamic_resolution->desc = *desc;
+  wgpu_dynamic_resolution_desc_t* d = &dynamic_resolution->desc;
+  d->max_scale = d->max_scale > 0.0f ? MIN(d->max_scale, 1.0f) : 1.0f;
+  d->min_scale = d->min_scale > 0.0f ? MIN(d->min_scale, d->max_scale) :
+                                       MIN(0.5f, d->max_scale);
+  wgpu_dynamic_resolution_reset(dynamic_resolution);
+
+  log_debug("Dynamic resolution: %.2f ms target, scale %.2f - %.2f",
+            d->target_frame_time_ms, d->min_scale, d->max_scale);
+
+  return dynamic_resolution;
+}
+
+void wgpu_dynamic_resolution_release(
+  wgpu_dynamic_resolution_t* dynamic_resolution)
+{
+  free(dynamic_resolution);
+}
+
+void wgpu_dynamic_resolution_reset(
+  wgpu_dynamic_resolution_t* dynamic_resolution)
+{
+  if (dynamic_resolution == NULL) {
+    return;
+  }
+
+  dynamic_resolution->scale               = dynamic_resolution->desc.max_scale;
+  dynamic_resolution->frame_time_ms       = 0.0f;
+  dynamic_resolution->frames_since_change = 0;
+}
+
+void wgpu_dynamic_resolution_update(
+  wgpu_dynamic_resolution_t* dynamic_resolution, float gpu_frame_time_ms)
+{
+  if (dynamic_resolution == NULL || gpu_frame_time_ms <= 0.0f) {
+    return;
+  }
+
+  /* The frames read back right after a change were rendered at the previous
+   * scale */
+  if (++dynamic_resolution->frames_since_change
+      <= WGPU_DYNAMIC_RESOLUTION_LATENCY_FRAMES) {
+    return;
+  }
+  dynamic_resolution->frame_time_ms
+    = dynamic_resolution->frame_time_ms > 0.0f ?
+        dynamic_resolution->frame_time_ms
+          + (gpu_frame_time_ms - dynamic_resolution->frame_time_ms)
+              * WGPU_DYNAMIC_RESOLUTION_SMOOTHING :
+        gpu_frame_time_ms;
+  if (dynamic_resolution->frames_since_change
+      < WGPU_DYNAMIC_RESOLUTION_LATENCY_FRAMES
+          + WGPU_DYNAMIC_RESOLUTION_SETTLE_FRAMES) {
+    return;
+  }
+
+  const wgpu_dynamic_resolution_desc_t* desc = &dynamic_resolution->desc;
+  const float frame_time_ms = dynamic_resolution->frame_time_ms;
+  if (frame_time_ms <= desc->target_frame_time_ms
+      && frame_time_ms >= desc->target_frame_time_ms
+                            * WGPU_DYNAMIC_RESOLUTION_RAISE_THRESHOLD) {
+    return;
+  }
+
+  /* The frame time scales with the pixel count, the square of the scale */
+  const float scale = dynamic_resolution->scale;
+  float new_scale   = scale
+                    * sqrtf(desc->target_frame_time_ms
+                            * WGPU_DYNAMIC_RESOLUTION_HEADROOM / frame_time_ms);
+  new_scale = CLAMP(new_scale, scale - WGPU_DYNAMIC_RESOLUTION_MAX_DECREASE,
+                    scale + WGPU_DYNAMIC_RESOLUTION_MAX_INCREASE);
+  new_scale = CLAMP(new_scale, desc->min_scale, desc->max_scale);
+  if (new_scale == scale) {
+    return;
+  }
+
+  dynamic_resolution->scale               = new_scale;
+  dynamic_resolution->frame_time_ms       = 0.0f;
+  dynamic_resolution->frames_since_change = 0;
+}
+
+float wgpu_dynamic_resolution_get_scale(
+  wgpu_dynamic_resolution_t* dynamic_resolution)
+{
+  return dynamic_resolution != NULL ? dynamic_resolution->scale : 1.0f;
+}
+
+void wgpu_dynamic_resolution_get_viewport(
+  wgpu_dynamic_resolution_t* dynamic_resolution, uint32_t width,
+  uint32_t height, float* viewport_width, float* viewport_height)
+{
+  const float scale = wgpu_dynamic_resolution_get_scale(dynamic_resolution);
+  *viewport_width   = MAX((float)width * scale, 1.0f);
+  *viewport_height  = MAX((float)height * scale, 1.0f);
+}
+
+float wgpu_dynamic_resolution_get_frame_time_ms(
+  wgpu_dynamic_resolution_t* dynamic_resolution)
+{
+  return dynamic_resolution != NULL ? dynamic_resolution->frame_time_ms : 0.0f;
+}
+
+float wgpu_dynamic_resolution_get_target_frame_time_ms(
+  wgpu_dynamic_resolution_t* dynamic_resolution)
+{
+  return dynamic_resolution != NULL ?
+           dynamic_resolution->desc.target_frame_time_ms :
+           0.0f;
+}
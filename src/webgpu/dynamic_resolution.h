@@ -0,0 +1,61 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <stdint.h>
+
+typedef struct wgpu_dynamic_resolution wgpu_dynamic_resolution_t;
+
+typedef struct wgpu_dynamic_resolution_desc_t {
+  /* GPU time of a frame the controller holds, in milliseconds */
+  float target_frame_time_ms;
+  /* Bounds of the scale of the render resolution */
+  float min_scale; /* 0 selects 0.5 */
+  float max_scale; /* 0 selects 1 */
+} wgpu_dynamic_resolution_desc_t;
+
+/*
+ * Dynamic resolution controller. It watches the GPU frame times measured with
+ * the timestamp queries of the GPU profiler and scales the internal render
+ * resolution within the configured bounds to hold the target frame time. The
+ * scale applies to both dimensions, the GPU time of fill-bound passes being
+ * taken as proportional to the number of pixels.
+ *
+ * The offscreen targets keep the size of the maximum scale, so that changing
+ * the scale doesn't reallocate them: the passes render into a viewport of the
+ * scaled size and the final pass upscales it by sampling the targets with the
+ * texture coordinates multiplied by the scale.
+ */
+wgpu_dynamic_resolution_t*
+wgpu_dynamic_resolution_create(const wgpu_dynamic_resolution_desc_t* desc);
+void wgpu_dynamic_resolution_release(
+  wgpu_dynamic_resolution_t* dynamic_resolution);
+
+/* Restores the maximum scale and drops the measured frame times */
+void wgpu_dynamic_resolution_reset(
+  wgpu_dynamic_resolution_t* dynamic_resolution);
+
+/*
+ * Adjusts the scale from the GPU time of the last read back frame, called once
+ * per frame. Frame times of 0 (timestamp queries not supported, no frame read
+ * back yet) are ignored.
+ */
+void wgpu_dynamic_resolution_update(
+  wgpu_dynamic_resolution_t* dynamic_resolution, float gpu_frame_time_ms);
+
+/* Current scale of the render resolution, 1 when the controller is NULL */
+float wgpu_dynamic_resolution_get_scale(
+  wgpu_dynamic_resolution_t* dynamic_resolution);
+
+/* Size of the viewport to render into a target of the maximum scale size */
+void wgpu_dynamic_resolution_get_viewport(
+  wgpu_dynamic_resolution_t* dynamic_resolution, uint32_t width,
+  uint32_t height, float* viewport_width, float* viewport_height);
+
+/* Smoothed GPU frame time the scale is derived from, 0 until measured at the
+ * current scale or when the controller is NULL */
+float wgpu_dynamic_resolution_get_frame_time_ms(
+  wgpu_dynamic_resolution_t* dynamic_resolution);
+float wgpu_dynamic_resolution_get_target_frame_time_ms(
+  wgpu_dynamic_resolution_t* dynamic_resolution);
+
+#endif
@@ -0,0 +1,564 @@
+#include "effect_pass.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "bind_group_cache.h"
+#include "buffer.h"
+#include "shader.h"
+
+#define WGPU_EFFECT_PASS_WORKGROUP_SIZE 8u
+
+typedef struct effect_pass_params_t {
+  mat4 inv_projection;
+  uint32_t scale;
+  uint32_t upsample;
+  float depth_threshold;
+  uint32_t padding;
+} effect_pass_params_t;
+
+struct wgpu_effect_pass {
+  wgpu_context_t* wgpu_context;
+  wgpu_effect_pass_desc_t desc;
+  /* Copy of the blend state of the upsampling, desc.blend points to it */
+  WGPUBlendState blend;
+  effect_pass_params_t params;
+  wgpu_buffer_t params_buffer;
+  WGPUComputePipeline downsample_pipeline;
+  WGPUBindGroupLayout downsample_bind_group_layout;
+  WGPUBindGroupLayout upsample_bind_group_layout;
+  WGPURenderPipeline upsample_pipeline;
+  /* Effect textures at 1/scale of the full resolution */
+  uint32_t width;
+  uint32_t height;
+  struct {
+    WGPUTexture texture;
+    WGPUTextureView view;
+  } color, depth;
+};
+
+// clang-format off
+static const char* effect_pass_view_depth_wgsl = CODE(
+  struct Params {
+    invProjection : mat4x4<f32>,
+    scale : u32,
+    upsample : u32,
+    depthThreshold : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+
+  // Positive view space depth of a depth buffer value
+  fn viewDepth(depth : f32) -> f32 {
+    let view = params.invProjection * vec4<f32>(0.0, 0.0, depth, 1.0);
+    return abs(view.z / view.w);
+  }
+);
+
+static const char* effect_pass_downsample_shader_wgsl = CODE(
+  @group(0) @binding(1) var depthTexture : texture_depth_2d;
+  @group(0) @binding(2) var effectDepth : texture_storage_2d<r32float, write>;
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (any(id.xy >= textureDimensions(effectDepth))) {
+      return;
+    }
+    // Closest sample of the scale x scale pixels of the texel
+    let maxPixel = vec2<i32>(textureDimensions(depthTexture)) - vec2<i32>(1);
+    let origin = vec2<i32>(id.xy * params.scale);
+    let scale = i32(params.scale);
+    var closest = 1.0;
+    for (var y = 0; y < scale; y = y + 1) {
+      for (var x = 0; x < scale; x = x + 1) {
+        let pixel = min(origin + vec2<i32>(x, y), maxPixel);
+        closest = min(closest, textureLoad(depthTexture, pixel, 0));
+      }
+    }
+    textureStore(effectDepth, vec2<i32>(id.xy),
+                 vec4<f32>(viewDepth(closest), 0.0, 0.0, 0.0));
+  }
+);
+
+static const char* effect_pass_upsample_shader_wgsl = CODE(
+  @group(0) @binding(1) var depthTexture : texture_depth_2d;
+  @group(0) @binding(2) var effectTexture : texture_2d<f32>;
+  @group(0) @binding(3) var effectDepth : texture_2d<f32>;
+
+  @vertex
+  fn vs_main(@builtin(vertex_index) index : u32)
+    -> @builtin(position) vec4<f32> {
+    let uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+    return vec4<f32>(uv * 2.0 - vec2<f32>(1.0), 0.0, 1.0);
+  }
+
+  @fragment
+  fn fs_main(@builtin(position) coord : vec4<f32>) -> @location(0) vec4<f32> {
+    let depth = viewDepth(textureLoad(depthTexture, vec2<i32>(coord.xy), 0));
+    let threshold = params.depthThreshold * depth;
+
+    // The pixel center lies between the centers of 4 effect texels
+    let position = coord.xy / f32(params.scale) - vec2<f32>(0.5);
+    let base = vec2<i32>(floor(position));
+    let f = position - floor(position);
+    let maxTexel = vec2<i32>(textureDimensions(effectTexture)) - vec2<i32>(1);
+
+    var bilinearSum = vec4<f32>(0.0);
+    var bilateralSum = vec4<f32>(0.0);
+    var bilateralWeight = 0.0;
+    var nearest = vec4<f32>(0.0);
+    var nearestDifference = 3.4e38;
+    var coherent = true;
+    for (var i = 0; i < 4; i = i + 1) {
+      let offset = vec2<i32>(i & 1, i >> 1u);
+      let texel = clamp(base + offset, vec2<i32>(0), maxTexel);
+      let color = textureLoad(effectTexture, texel, 0);
+      let difference = abs(textureLoad(effectDepth, texel, 0).r - depth);
+      let w = mix(vec2<f32>(1.0) - f, f, vec2<f32>(offset));
+      let bilinear = w.x * w.y;
+      let similarity = max(1.0 - difference / threshold, 0.0);
+      bilinearSum = bilinearSum + bilinear * color;
+      bilateralSum = bilateralSum + bilinear * similarity * color;
+      bilateralWeight = bilateralWeight + bilinear * similarity;
+      if (difference < nearestDifference) {
+        nearestDifference = difference;
+        nearest = color;
+      }
+      coherent = coherent && difference < threshold;
+    }
+
+    if (params.upsample == 0u) {
+      if (bilateralWeight > 1e-4) {
+        return bilateralSum / bilateralWeight;
+      }
+      return nearest;
+    }
+    return select(nearest, bilinearSum, coherent);
+  }
+);
+// clang-format on
+
+// Prepends the shared uniform block and functions to a shader
+static char* effect_pass_build_wgsl(const char* wgsl)
+{
+  const size_t size = strlen(effect_pass_view_depth_wgsl) + strlen(wgsl) + 2;
+  char* source      = (char*)malloc(size);
+  snprintf(source, size, "%s\n%s", effect_pass_view_depth_wgsl, wgsl);
+  return source;
+}
+
+static void effect_pass_create_pipelines(wgpu_effect_pass_t* effect_pass)
+{
+  wgpu_context_t* wgpu_context = effect_pass->wgpu_context;
+
+  // Downsampling, the default layout matches the bindings
+  {
+    char* wgsl = effect_pass_build_wgsl(effect_pass_downsample_shader_wgsl);
+    wgpu_shader_t comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "effect_pass_downsample_shader",
+                      .wgsl_code.source = wgsl,
+                      .entry            = "main",
+                    });
+    effect_pass->downsample_pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device,
+      &(WGPUComputePipelineDescriptor){
+        .label   = "effect_pass_downsample_pipeline",
+        .layout  = NULL,
+        .compute = comp_shader.programmable_stage_descriptor,
+      });
+    ASSERT(effect_pass->downsample_pipeline != NULL);
+    effect_pass->downsample_bind_group_layout
+      = wgpuComputePipelineGetBindGroupLayout(effect_pass->downsample_pipeline,
+                                              0);
+    wgpu_shader_release(&comp_shader);
+    free(wgsl);
+  }
+
+  // Upsampling, r32float is not filterable, which the default layout would
+  // assume
+  WGPUBindGroupLayoutEntry bgl_entries[4] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Fragment,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(effect_pass_params_t),
+      },
+      .sampler = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Full resolution depth
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_Depth,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Effect
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Effect depth
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
+  };
+  effect_pass->upsample_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "effect_pass_upsample_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(effect_pass->upsample_bind_group_layout != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "effect_pass_upsample_pl",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &effect_pass->upsample_bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  // A full screen triangle
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_None,
+  };
+
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = effect_pass->desc.target_format,
+    .blend     = effect_pass->desc.blend,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+
+  char* wgsl = effect_pass_build_wgsl(effect_pass_upsample_shader_wgsl);
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "effect_pass_upsample_shader",
+                  .wgsl_code.source = wgsl,
+                  .entry            = "vs_main",
+                },
+                .buffer_count = 0,
+                .buffers      = NULL,
+              });
+
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+                wgpu_context, &(wgpu_fragment_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Fragment shader WGSL
+                  .label            = "effect_pass_upsample_shader",
+                  .wgsl_code.source = wgsl,
+                  .entry            = "fs_main",
+                },
+                .target_count = 1,
+                .targets      = &color_target_state,
+              });
+  free(wgsl);
+
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  effect_pass->upsample_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label       = "effect_pass_upsample_pipeline",
+                            .layout      = pipeline_layout,
+                            .primitive   = primitive_state,
+                            .vertex      = vertex_state,
+                            .fragment    = &fragment_state,
+                            .multisample = multisample_state,
+                          });
+  ASSERT(effect_pass->upsample_pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+static void effect_pass_create_texture(wgpu_effect_pass_t* effect_pass,
+                                       const char* label,
+                                       WGPUTextureFormat format,
+                                       WGPUTextureUsageFlags usage,
+                                       WGPUTexture* texture,
+                                       WGPUTextureView* view)
+{
+  *texture = wgpuDeviceCreateTexture(
+    effect_pass->wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = label,
+      .usage         = usage | WGPUTextureUsage_StorageBinding
+                       | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){effect_pass->width, effect_pass->height,
+                                      1},
+      .format        = format,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(*texture != NULL);
+
+  *view = wgpuTextureCreateView(
+    *texture, &(WGPUTextureViewDescriptor){
+                .label           = label,
+                .format          = format,
+                .dimension       = WGPUTextureViewDimension_2D,
+                .baseMipLevel    = 0,
+                .mipLevelCount   = 1,
+                .baseArrayLayer  = 0,
+                .arrayLayerCount = 1,
+                .aspect          = WGPUTextureAspect_All,
+              });
+  ASSERT(*view != NULL);
+}
+
+static void effect_pass_create_textures(wgpu_effect_pass_t* effect_pass)
+{
+  const uint32_t scale = (uint32_t)effect_pass->desc.scale;
+  effect_pass->width   = (effect_pass->desc.width + scale - 1) / scale;
+  effect_pass->height  = (effect_pass->desc.height + scale - 1) / scale;
+
+  effect_pass_create_texture(
+    effect_pass, "effect_pass_color_texture", effect_pass->desc.format,
+    WGPUTextureUsage_RenderAttachment, &effect_pass->color.texture,
+    &effect_pass->color.view);
+  effect_pass_create_texture(effect_pass, "effect_pass_depth_texture",
+                             WGPUTextureFormat_R32Float, WGPUTextureUsage_None,
+                             &effect_pass->depth.texture,
+                             &effect_pass->depth.view);
+}
+
+static void effect_pass_release_textures(wgpu_effect_pass_t* effect_pass)
+{
+  wgpu_bind_group_cache_invalidate(effect_pass->color.view);
+  wgpu_bind_group_cache_invalidate(effect_pass->depth.view);
+  WGPU_RELEASE_RESOURCE(TextureView, effect_pass->color.view);
+  WGPU_RELEASE_RESOURCE(Texture, effect_pass->color.texture);
+  WGPU_RELEASE_RESOURCE(TextureView, effect_pass->depth.view);
+  WGPU_RELEASE_RESOURCE(Texture, effect_pass->depth.texture);
+}
+
+static void effect_pass_write_params(wgpu_effect_pass_t* effect_pass)
+{
+  wgpuQueueWriteBuffer(effect_pass->wgpu_context->queue,
+                       effect_pass->params_buffer.buffer, 0,
+                       &effect_pass->params, sizeof(effect_pass->params));
+}
+
+wgpu_effect_pass_t*
+wgpu_effect_pass_create(wgpu_context_t* wgpu_context,
+                        const wgpu_effect_pass_desc_t* desc)
+{
+  ASSERT(desc != NULL && desc->width > 0 && desc->height > 0);
+
+  wgpu_effect_pass_t* effect_pass
+    = (wgpu_effect_pass_t*)malloc(sizeof(wgpu_effect_pass_t));
+  memset(effect_pass, 0, sizeof(wgpu_effect_pass_t));
+  effect_pass->wgpu_context = wgpu_context;
+  effect_pass->desc         = *desc;
+  if (desc->scale == 0) {
+    effect_pass->desc.scale = WGPU_EFFECT_PASS_SCALE_HALF;
+  }
+  if (desc->format == WGPUTextureFormat_Undefined) {
+    effect_pass->desc.format = WGPUTextureFormat_RGBA16Float;
+  }
+  if (desc->target_format == WGPUTextureFormat_Undefined) {
+    effect_pass->desc.target_format = wgpu_context->swap_chain.format;
+  }
+  if (desc->blend != NULL) {
+    effect_pass->blend      = *desc->blend;
+    effect_pass->desc.blend = &effect_pass->blend;
+  }
+  if (desc->depth_threshold <= 0.0f) {
+    effect_pass->desc.depth_threshold = 0.1f;
+  }
+
+  effect_pass->params = (effect_pass_params_t){
+    .scale           = (uint32_t)effect_pass->desc.scale,
+    .upsample        = (uint32_t)effect_pass->desc.upsample,
+    .depth_threshold = effect_pass->desc.depth_threshold,
+  };
+  glm_mat4_identity(effect_pass->params.inv_projection);
+  effect_pass->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "effect_pass_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(effect_pass_params_t),
+                  });
+  effect_pass_write_params(effect_pass);
+
+  effect_pass_create_pipelines(effect_pass);
+  effect_pass_create_textures(effect_pass);
+
+  return effect_pass;
+}
+
+void wgpu_effect_pass_release(wgpu_effect_pass_t* effect_pass)
+{
+  if (effect_pass == NULL) {
+    return;
+  }
+
+  effect_pass_release_textures(effect_pass);
+  WGPU_RELEASE_RESOURCE(RenderPipeline, effect_pass->upsample_pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        effect_pass->upsample_bind_group_layout);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        effect_pass->downsample_bind_group_layout);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, effect_pass->downsample_pipeline);
+  wgpu_destroy_buffer(&effect_pass->params_buffer);
+
+  free(effect_pass);
+}
+
+void wgpu_effect_pass_resize(wgpu_effect_pass_t* effect_pass, uint32_t width,
+                             uint32_t height)
+{
+  ASSERT(width > 0 && height > 0);
+
+  effect_pass_release_textures(effect_pass);
+  effect_pass->desc.width  = width;
+  effect_pass->desc.height = height;
+  effect_pass_create_textures(effect_pass);
+}
+
+void wgpu_effect_pass_set_projection(wgpu_effect_pass_t* effect_pass,
+                                     mat4 projection)
+{
+  glm_mat4_inv(projection, effect_pass->params.inv_projection);
+  effect_pass_write_params(effect_pass);
+}
+
+void wgpu_effect_pass_downsample_depth(wgpu_effect_pass_t* effect_pass,
+                                       WGPUComputePassEncoder pass_encoder,
+                                       WGPUTextureView depth_view)
+{
+  ASSERT(depth_view != NULL);
+
+  wgpu_context_t* wgpu_context = effect_pass->wgpu_context;
+
+  // The depth view may change with every frame, each one has its bind group
+  // in the bind group cache
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = effect_pass->params_buffer.buffer,
+      .size    = effect_pass->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = depth_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = effect_pass->depth.view,
+    },
+  };
+  WGPUBindGroup bind_group = wgpu_bind_group_cache_get_bind_group(
+    wgpu_context, &(WGPUBindGroupDescriptor){
+                    .label      = "effect_pass_downsample_bind_group",
+                    .layout     = effect_pass->downsample_bind_group_layout,
+                    .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                    .entries    = bg_entries,
+                  });
+  ASSERT(bind_group != NULL);
+
+  const uint32_t group_size = WGPU_EFFECT_PASS_WORKGROUP_SIZE;
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    effect_pass->downsample_pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder, (effect_pass->width + group_size - 1) / group_size,
+    (effect_pass->height + group_size - 1) / group_size, 1);
+  // The pass encoder keeps its own references on the bound resources
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group);
+}
+
+void wgpu_effect_pass_upsample(wgpu_effect_pass_t* effect_pass,
+                               WGPURenderPassEncoder pass_encoder,
+                               WGPUTextureView depth_view)
+{
+  ASSERT(depth_view != NULL);
+
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = effect_pass->params_buffer.buffer,
+      .size    = effect_pass->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = depth_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = effect_pass->color.view,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding     = 3,
+      .textureView = effect_pass->depth.view,
+    },
+  };
+  WGPUBindGroup bind_group = wgpu_bind_group_cache_get_bind_group(
+    effect_pass->wgpu_context,
+    &(WGPUBindGroupDescriptor){
+      .label      = "effect_pass_upsample_bind_group",
+      .layout     = effect_pass->upsample_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(bind_group != NULL);
+
+  wgpuRenderPassEncoderSetPipeline(pass_encoder,
+                                   effect_pass->upsample_pipeline);
+  wgpuRenderPassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  wgpuRenderPassEncoderDraw(pass_encoder, 3, 1, 0, 0);
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group);
+}
+
+WGPUTextureView
+wgpu_effect_pass_get_color_view(wgpu_effect_pass_t* effect_pass)
+{
+  return effect_pass->color.view;
+}
+
+WGPUTextureView
+wgpu_effect_pass_get_depth_view(wgpu_effect_pass_t* effect_pass)
+{
+  return effect_pass->depth.view;
+}
+
+uint32_t wgpu_effect_pass_get_width(wgpu_effect_pass_t* effect_pass)
+{
+  return effect_pass->width;
+}
+
+uint32_t wgpu_effect_pass_get_height(wgpu_effect_pass_t* effect_pass)
+{
+  return effect_pass->height;
+}
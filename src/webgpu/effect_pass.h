@@ -0,0 +1,98 @@
+#ifndef EFFECT_PASS_H
+#define EFFECT_PASS_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+typedef struct wgpu_effect_pass wgpu_effect_pass_t;
+
+/* Resolution of the effect, as a divisor of the full resolution */
+typedef enum wgpu_effect_pass_scale_t {
+  WGPU_EFFECT_PASS_SCALE_HALF    = 2,
+  WGPU_EFFECT_PASS_SCALE_QUARTER = 4,
+} wgpu_effect_pass_scale_t;
+
+typedef enum wgpu_effect_pass_upsample_t {
+  /* Bilinear weights scaled by the depth similarity of the 4 nearest effect
+   * texels */
+  WGPU_EFFECT_PASS_UPSAMPLE_BILATERAL = 0,
+  /* Bilinear where the 4 nearest effect texels are on the surface of the
+   * pixel, the texel of the closest depth otherwise */
+  WGPU_EFFECT_PASS_UPSAMPLE_NEAREST_DEPTH = 1,
+} wgpu_effect_pass_upsample_t;
+
+typedef struct wgpu_effect_pass_desc_t {
+  /* Full resolution of the depth buffer and of the upsampling target */
+  uint32_t width;
+  uint32_t height;
+  /* 0 selects WGPU_EFFECT_PASS_SCALE_HALF */
+  wgpu_effect_pass_scale_t scale;
+  /* Format of the effect texture, a storage texture format, Undefined
+   * selects RGBA16Float */
+  WGPUTextureFormat format;
+  wgpu_effect_pass_upsample_t upsample;
+  /* Format of the upsampling target, Undefined selects the swap chain
+   * format */
+  WGPUTextureFormat target_format;
+  /* Optional blending of the upsampled effect into the target, e.g. additive
+   * for glow or multiplicative for occlusion, NULL replaces the target */
+  const WGPUBlendState* blend;
+  /* Relative view depth difference at which effect texels stop contributing
+   * to a pixel, 0 selects 0.1 */
+  float depth_threshold;
+} wgpu_effect_pass_desc_t;
+
+/*
+ * Screen space effects at a fraction of the full resolution, e.g. ambient
+ * occlusion, volumetrics, blur or glow. The effect texture has 1/scale of the
+ * full resolution on each axis and can be rendered to, written as storage
+ * texture or sampled. Each frame
+ * - the full resolution depth buffer is downsampled to the view depth of the
+ *   closest sample of every effect texel,
+ * - the effect is computed at low resolution by the caller,
+ * - and upsampled into the full resolution target, the depth aware filter
+ *   keeps the effect of the background from bleeding over the edges of the
+ *   foreground and the other way around.
+ * Depth is expected to be in [0, 1] and to increase with the distance to the
+ * camera (no reversed z), the depth buffer single-sampled.
+ */
+wgpu_effect_pass_t*
+wgpu_effect_pass_create(wgpu_context_t* wgpu_context,
+                        const wgpu_effect_pass_desc_t* desc);
+void wgpu_effect_pass_release(wgpu_effect_pass_t* effect_pass);
+
+/* Recreates the effect textures for a new full resolution */
+void wgpu_effect_pass_resize(wgpu_effect_pass_t* effect_pass, uint32_t width,
+                             uint32_t height);
+
+/* Sets the projection matrix that linearizes the depth buffer */
+void wgpu_effect_pass_set_projection(wgpu_effect_pass_t* effect_pass,
+                                     mat4 projection);
+
+/*
+ * Records the downsampling of the depth buffer into the effect depth. The
+ * depth texture needs the TextureBinding usage and the view the depth aspect
+ * only, see deph_stencil_texture_creation_options_t.sampled.
+ */
+void wgpu_effect_pass_downsample_depth(wgpu_effect_pass_t* effect_pass,
+                                       WGPUComputePassEncoder pass_encoder,
+                                       WGPUTextureView depth_view);
+
+/* Draws the upsampled effect in a render pass of the target format */
+void wgpu_effect_pass_upsample(wgpu_effect_pass_t* effect_pass,
+                               WGPURenderPassEncoder pass_encoder,
+                               WGPUTextureView depth_view);
+
+/* Effect texture, render attachment, storage and texture binding */
+WGPUTextureView
+wgpu_effect_pass_get_color_view(wgpu_effect_pass_t* effect_pass);
+/* r32float positive view depth of the effect texels, storage and texture
+ * binding, to be read with textureLoad */
+WGPUTextureView
+wgpu_effect_pass_get_depth_view(wgpu_effect_pass_t* effect_pass);
+/* Size of the effect textures */
+uint32_t wgpu_effect_pass_get_width(wgpu_effect_pass_t* effect_pass);
+uint32_t wgpu_effect_pass_get_height(wgpu_effect_pass_t* effect_pass);
+
+#endif
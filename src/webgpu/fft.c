@@ -0,0 +1,317 @@
+#include "fft.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+/* Layout of FftParams */
+typedef struct fft_params_t {
+  uint32_t size;
+  uint32_t log2_size;
+  uint32_t vertical;
+  uint32_t inverse;
+} fft_params_t;
+
+struct wgpu_fft {
+  wgpu_context_t* wgpu_context;
+  uint32_t size;
+  uint32_t batch_count;
+  wgpu_buffer_t data_buffer;
+  /* Row and column passes of both directions, selected with a dynamic
+   * offset */
+  wgpu_buffer_t params_buffer;
+  uint32_t params_stride;
+  WGPUBindGroupLayout params_bind_group_layout;
+  WGPUBindGroupLayout data_bind_group_layout;
+  WGPUBindGroup params_bind_group;
+  WGPUBindGroup data_bind_group;
+  WGPUComputePipeline pipeline;
+};
+
+// clang-format off
+static const char* fft_shader_wgsl = CODE(
+  struct FftParams {
+    size : u32,
+    log2Size : u32,
+    vertical : u32,
+    inverse : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : FftParams;
+  @group(1) @binding(0) var<storage, read_write> data : array<vec2<f32>>;
+
+  // Two lines, the source and the destination of a stage
+  var<workgroup> lines : array<vec2<f32>, %u>;
+
+  fn elementIndex(grid : u32, line : u32, i : u32) -> u32 {
+    let base = grid * params.size * params.size;
+    if (params.vertical != 0u) {
+      return base + i * params.size + line;
+    }
+    return base + line * params.size + i;
+  }
+
+  fn complexMul(a : vec2<f32>, b : vec2<f32>) -> vec2<f32> {
+    return vec2<f32>(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+  }
+
+  @compute @workgroup_size(%u)
+  fn main(@builtin(workgroup_id) groupId : vec3<u32>,
+          @builtin(local_invocation_id) localId : vec3<u32>) {
+    let n = params.size;
+    let halfSize = n / 2u;
+    let j = localId.x;
+    let line = groupId.x;
+    let grid = groupId.y;
+
+    lines[j] = data[elementIndex(grid, line, j)];
+    lines[j + halfSize] = data[elementIndex(grid, line, j + halfSize)];
+    workgroupBarrier();
+
+    // Stage s combines the transforms of length p = 2^s of the even and odd
+    // elements into ones of length 2p
+    let direction = select(-1.0, 1.0, params.inverse != 0u);
+    var src = 0u;
+    var p = 1u;
+    for (var s = 0u; s < params.log2Size; s = s + 1u) {
+      let dst = n - src;
+      let k = j & (p - 1u);
+      let angle = direction * 3.14159265359 * f32(k) / f32(p);
+      let x0 = lines[src + j];
+      let x1 = complexMul(vec2<f32>(cos(angle), sin(angle)),
+                          lines[src + j + halfSize]);
+      let o = (j - k) * 2u + k;
+      lines[dst + o] = x0 + x1;
+      lines[dst + o + p] = x0 - x1;
+      workgroupBarrier();
+      src = dst;
+      p = p * 2u;
+    }
+
+    let scale = select(1.0, 1.0 / f32(n), params.inverse != 0u);
+    data[elementIndex(grid, line, j)] = lines[src + j] * scale;
+    data[elementIndex(grid, line, j + halfSize)]
+      = lines[src + j + halfSize] * scale;
+  }
+);
+// clang-format on
+
+static void fft_create_bind_group_layouts(wgpu_fft_t* fft)
+{
+  wgpu_context_t* wgpu_context = fft->wgpu_context;
+
+  // Parameters
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: FFT parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(fft_params_t),
+        },
+        .sampler = {0},
+      },
+    };
+    fft->params_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "fft_params_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(fft->params_bind_group_layout != NULL);
+  }
+
+  // Data
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Complex grids
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Storage,
+          .hasDynamicOffset = false,
+          .minBindingSize   = fft->data_buffer.size,
+        },
+        .sampler = {0},
+      },
+    };
+    fft->data_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "fft_data_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(fft->data_bind_group_layout != NULL);
+  }
+}
+
+static void fft_create_pipeline(wgpu_fft_t* fft)
+{
+  wgpu_context_t* wgpu_context = fft->wgpu_context;
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    fft->params_bind_group_layout, /* Group 0 */
+    fft->data_bind_group_layout,   /* Group 1 */
+  };
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "fft_pipeline_layout",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(pipeline_layout != NULL);
+
+  // The workgroup size and memory follow the transform size
+  const size_t wgsl_size = strlen(fft_shader_wgsl) + 32;
+  char* wgsl             = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, fft_shader_wgsl, 2 * fft->size, fft->size / 2);
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "fft_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  fft->pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "fft_pipeline",
+      .layout  = pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(fft->pipeline != NULL);
+
+  wgpu_shader_release(&comp_shader);
+  free(wgsl);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_fft_t* wgpu_fft_create(wgpu_context_t* wgpu_context,
+                            const wgpu_fft_desc_t* desc)
+{
+  if (desc->size < 2 || desc->size > WGPU_FFT_MAX_SIZE
+      || (desc->size & (desc->size - 1)) != 0) {
+    log_error("FFT size %u is not a power of two between 2 and %u\n",
+              desc->size, WGPU_FFT_MAX_SIZE);
+    return NULL;
+  }
+
+  wgpu_fft_t* fft = (wgpu_fft_t*)malloc(sizeof(wgpu_fft_t));
+  memset(fft, 0, sizeof(wgpu_fft_t));
+  fft->wgpu_context = wgpu_context;
+  fft->size         = desc->size;
+  fft->batch_count  = MAX(desc->batch_count, 1u);
+
+  fft->data_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "fft_data_buffer",
+      .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst
+               | WGPUBufferUsage_CopySrc,
+      .size = (uint64_t)fft->batch_count * fft->size * fft->size * 2
+              * sizeof(float),
+    });
+
+  // Parameter blocks are aligned to the uniform buffer offset alignment
+  fft->params_stride = (uint32_t)((sizeof(fft_params_t) + 255) & ~255);
+  fft->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "fft_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = 4 * fft->params_stride,
+                  });
+  uint32_t log2_size = 0;
+  while ((1u << log2_size) < fft->size) {
+    ++log2_size;
+  }
+  for (uint32_t i = 0; i < 4; ++i) {
+    const fft_params_t params = {
+      .size      = fft->size,
+      .log2_size = log2_size,
+      .vertical  = i & 1,
+      .inverse   = i >> 1,
+    };
+    wgpuQueueWriteBuffer(wgpu_context->queue, fft->params_buffer.buffer,
+                         i * fft->params_stride, &params, sizeof(params));
+  }
+
+  fft_create_bind_group_layouts(fft);
+  fft_create_pipeline(fft);
+
+  fft->params_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "fft_params_bind_group",
+      .layout     = fft->params_bind_group_layout,
+      .entryCount = 1,
+      .entries    = &(WGPUBindGroupEntry){
+        .binding = 0,
+        .buffer  = fft->params_buffer.buffer,
+        .size    = sizeof(fft_params_t),
+      },
+    });
+  ASSERT(fft->params_bind_group != NULL);
+
+  fft->data_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "fft_data_bind_group",
+      .layout     = fft->data_bind_group_layout,
+      .entryCount = 1,
+      .entries    = &(WGPUBindGroupEntry){
+        .binding = 0,
+        .buffer  = fft->data_buffer.buffer,
+        .size    = fft->data_buffer.size,
+      },
+    });
+  ASSERT(fft->data_bind_group != NULL);
+
+  return fft;
+}
+
+void wgpu_fft_release(wgpu_fft_t* fft)
+{
+  if (fft == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(ComputePipeline, fft->pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, fft->data_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, fft->params_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, fft->data_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, fft->params_bind_group_layout)
+  wgpu_destroy_buffer(&fft->params_buffer);
+  wgpu_destroy_buffer(&fft->data_buffer);
+  free(fft);
+}
+
+WGPUBuffer wgpu_fft_get_buffer(wgpu_fft_t* fft)
+{
+  return fft->data_buffer.buffer;
+}
+
+void wgpu_fft_record(wgpu_fft_t* fft, WGPUComputePassEncoder pass_encoder,
+                     bool inverse)
+{
+  wgpuComputePassEncoderSetPipeline(pass_encoder, fft->pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, fft->data_bind_group, 0,
+                                     NULL);
+  // Rows, then columns
+  for (uint32_t vertical = 0; vertical < 2; ++vertical) {
+    const uint32_t dynamic_offset
+      = ((inverse ? 2 : 0) + vertical) * fft->params_stride;
+    wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, fft->params_bind_group,
+                                       1, &dynamic_offset);
+    wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, fft->size,
+                                             fft->batch_count, 1);
+  }
+}
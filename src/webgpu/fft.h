@@ -0,0 +1,50 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "context.h"
+
+/* Largest supported transform size, a line of it is transformed by one
+ * workgroup of WGPU_FFT_MAX_SIZE / 2 invocations */
+#define WGPU_FFT_MAX_SIZE 512u
+
+/*
+ * Two-dimensional fast Fourier transform of square complex grids in compute
+ * shaders.
+ *
+ * A radix-2 Stockham transform: every workgroup loads one row or column into
+ * workgroup memory and runs all log2(size) butterfly stages there, ping-ponging
+ * between two halves of the memory, so that the elements come out in natural
+ * order without a bit reversal. A transform is one dispatch over the rows
+ * followed by one over the columns, in place in the data buffer. Several grids
+ * of the same size are transformed together as a batch.
+ *
+ * The forward transform uses exp(-i 2 pi k x / size), the inverse one
+ * exp(+i 2 pi k x / size) and is scaled by 1 / size^2.
+ */
+typedef struct wgpu_fft wgpu_fft_t;
+
+typedef struct wgpu_fft_desc_t {
+  /* Width and height of the grids, a power of two up to WGPU_FFT_MAX_SIZE */
+  uint32_t size;
+  /* Number of grids, 0 selects 1 */
+  uint32_t batch_count;
+} wgpu_fft_desc_t;
+
+/* FFT creating/releasing */
+wgpu_fft_t* wgpu_fft_create(wgpu_context_t* wgpu_context,
+                            const wgpu_fft_desc_t* desc);
+void wgpu_fft_release(wgpu_fft_t* fft);
+
+/*
+ * Storage buffer holding the grids before and after a transform:
+ *   var<storage, read_write> data : array<vec2<f32>>
+ * Element (x, y) of grid b, real and imaginary part, is at index
+ * (b * size + y) * size + x.
+ */
+WGPUBuffer wgpu_fft_get_buffer(wgpu_fft_t* fft);
+
+/* Records the transform of all grids, overwrites the bind groups 0 and 1 */
+void wgpu_fft_record(wgpu_fft_t* fft, WGPUComputePassEncoder pass_encoder,
+                     bool inverse);
+
+#endif
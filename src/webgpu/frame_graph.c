@@ -0,0 +1,394 @@
+#include "frame_graph.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+#define WGPU_FRAME_GRAPH_NO_PASS UINT32_MAX
+
+typedef struct wgpu_frame_graph_resource_entry_t {
+  wgpu_frame_graph_texture_desc_t desc;
+  bool imported;
+  WGPUTextureView imported_view;
+  /* Resolved by the last compile */
+  uint32_t width;
+  uint32_t height;
+  uint32_t first_pass;
+  uint32_t last_pass;
+  uint32_t texture_index;
+  uint64_t texture_id;
+} wgpu_frame_graph_resource_entry_t;
+
+/* Pooled texture, shared by all resources of the same format, size and usage
+ * whose lifetimes do not overlap */
+typedef struct wgpu_frame_graph_texture_t {
+  WGPUTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  WGPUTextureUsage usage;
+  WGPUTexture texture;
+  WGPUTextureView view;
+  uint64_t id;
+  bool used;          /* assigned by the current compile */
+  uint32_t last_pass; /* last pass of the current occupant */
+} wgpu_frame_graph_texture_t;
+
+struct wgpu_frame_graph {
+  wgpu_context_t* wgpu_context;
+  wgpu_frame_graph_resource_entry_t* resources;
+  uint32_t resource_count;
+  uint32_t resource_capacity;
+  wgpu_frame_graph_pass_desc_t* passes;
+  uint32_t pass_count;
+  uint32_t pass_capacity;
+  wgpu_frame_graph_texture_t* textures;
+  uint32_t texture_count;
+  uint32_t texture_capacity;
+  uint64_t next_texture_id;
+  bool compiled;
+};
+
+/* Grows an array to hold at least one more element */
+static void* wgpu_frame_graph_grow(void* array, uint32_t count,
+                                   uint32_t* capacity, size_t element_size)
+{
+  if (count < *capacity) {
+    return array;
+  }
+  const uint32_t new_capacity = MAX(*capacity * 2, 8u);
+  void* new_array             = realloc(array, new_capacity * element_size);
+  ASSERT(new_array != NULL);
+  *capacity = new_capacity;
+  return new_array;
+}
+
+wgpu_frame_graph_t* wgpu_frame_graph_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_frame_graph_t* graph
+    = (wgpu_frame_graph_t*)malloc(sizeof(wgpu_frame_graph_t));
+  memset(graph, 0, sizeof(wgpu_frame_graph_t));
+  graph->wgpu_context = wgpu_context;
+  return graph;
+}
+
+void wgpu_frame_graph_release(wgpu_frame_graph_t* graph)
+{
+  for (uint32_t i = 0; i < graph->texture_count; ++i) {
+    WGPU_RELEASE_RESOURCE(TextureView, graph->textures[i].view)
+    WGPU_RELEASE_RESOURCE(Texture, graph->textures[i].texture)
+  }
+  free(graph->textures);
+  free(graph->resources);
+  free(graph->passes);
+  free(graph);
+}
+
+void wgpu_frame_graph_reset(wgpu_frame_graph_t* graph)
+{
+  graph->resource_count = 0;
+  graph->pass_count     = 0;
+  graph->compiled       = false;
+}
+
+static wgpu_frame_graph_resource_t
+wgpu_frame_graph_add_resource(wgpu_frame_graph_t* graph,
+                              const wgpu_frame_graph_resource_entry_t* entry)
+{
+  graph->resources = wgpu_frame_graph_grow(
+    graph->resources, graph->resource_count, &graph->resource_capacity,
+    sizeof(wgpu_frame_graph_resource_entry_t));
+  graph->resources[graph->resource_count] = *entry;
+  graph->compiled                         = false;
+  return graph->resource_count++;
+}
+
+wgpu_frame_graph_resource_t
+wgpu_frame_graph_create_texture(wgpu_frame_graph_t* graph,
+                                const wgpu_frame_graph_texture_desc_t* desc)
+{
+  wgpu_frame_graph_resource_entry_t entry = {
+    .desc          = *desc,
+    .texture_index = UINT32_MAX,
+  };
+  if (entry.desc.usage == WGPUTextureUsage_None) {
+    entry.desc.usage
+      = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
+  }
+  return wgpu_frame_graph_add_resource(graph, &entry);
+}
+
+wgpu_frame_graph_resource_t
+wgpu_frame_graph_import_texture(wgpu_frame_graph_t* graph, const char* label,
+                                WGPUTextureView view)
+{
+  return wgpu_frame_graph_add_resource(
+    graph, &(wgpu_frame_graph_resource_entry_t){
+             .desc.label    = label,
+             .imported      = true,
+             .imported_view = view,
+             .texture_index = UINT32_MAX,
+           });
+}
+
+void wgpu_frame_graph_set_imported_view(wgpu_frame_graph_t* graph,
+                                        wgpu_frame_graph_resource_t resource,
+                                        WGPUTextureView view)
+{
+  ASSERT(resource < graph->resource_count);
+  ASSERT(graph->resources[resource].imported);
+  graph->resources[resource].imported_view = view;
+}
+
+void wgpu_frame_graph_add_pass(wgpu_frame_graph_t* graph,
+                               const wgpu_frame_graph_pass_desc_t* desc)
+{
+  ASSERT(desc->input_count <= WGPU_FRAME_GRAPH_MAX_PASS_RESOURCES);
+  ASSERT(desc->output_count <= WGPU_FRAME_GRAPH_MAX_PASS_RESOURCES);
+  graph->passes
+    = wgpu_frame_graph_grow(graph->passes, graph->pass_count,
+                            &graph->pass_capacity, sizeof(*desc));
+  graph->passes[graph->pass_count++] = *desc;
+  graph->compiled                    = false;
+}
+
+static void wgpu_frame_graph_use(wgpu_frame_graph_t* graph,
+                                 wgpu_frame_graph_resource_t resource,
+                                 uint32_t pass)
+{
+  ASSERT(resource < graph->resource_count);
+  wgpu_frame_graph_resource_entry_t* entry = &graph->resources[resource];
+  if (entry->first_pass == WGPU_FRAME_GRAPH_NO_PASS) {
+    entry->first_pass = pass;
+  }
+  entry->last_pass = pass;
+}
+
+static bool
+wgpu_frame_graph_texture_matches(const wgpu_frame_graph_texture_t* texture,
+                                 const wgpu_frame_graph_resource_entry_t* entry)
+{
+  return texture->texture != NULL && texture->format == entry->desc.format
+         && texture->width == entry->width && texture->height == entry->height
+         && texture->usage == entry->desc.usage;
+}
+
+/* Returns a free pooled texture matching the resource, created when none is
+ * left */
+static uint32_t
+wgpu_frame_graph_acquire_texture(wgpu_frame_graph_t* graph,
+                                 wgpu_frame_graph_resource_entry_t* entry)
+{
+  // A persistent resource keeps the texture of the previous compile, and with
+  // it the contents
+  if (entry->desc.persistent && entry->texture_index < graph->texture_count) {
+    wgpu_frame_graph_texture_t* texture
+      = &graph->textures[entry->texture_index];
+    if (!texture->used && texture->id == entry->texture_id
+        && wgpu_frame_graph_texture_matches(texture, entry)) {
+      return entry->texture_index;
+    }
+  }
+
+  uint32_t empty_slot = UINT32_MAX;
+  for (uint32_t i = 0; i < graph->texture_count; ++i) {
+    wgpu_frame_graph_texture_t* texture = &graph->textures[i];
+    if (texture->texture == NULL) {
+      empty_slot = MIN(empty_slot, i);
+      continue;
+    }
+    if (wgpu_frame_graph_texture_matches(texture, entry)
+        && (!texture->used || texture->last_pass < entry->first_pass)) {
+      return i;
+    }
+  }
+
+  if (empty_slot == UINT32_MAX) {
+    graph->textures = wgpu_frame_graph_grow(
+      graph->textures, graph->texture_count, &graph->texture_capacity,
+      sizeof(wgpu_frame_graph_texture_t));
+    empty_slot = graph->texture_count++;
+  }
+  wgpu_frame_graph_texture_t* texture = &graph->textures[empty_slot];
+  *texture                            = (wgpu_frame_graph_texture_t){
+    .format = entry->desc.format,
+    .width  = entry->width,
+    .height = entry->height,
+    .usage  = entry->desc.usage,
+    .id     = ++graph->next_texture_id,
+  };
+  texture->texture = wgpuDeviceCreateTexture(
+    graph->wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = entry->desc.label,
+      .usage         = entry->desc.usage,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){
+        .width              = entry->width,
+        .height             = entry->height,
+        .depthOrArrayLayers = 1,
+      },
+      .format        = entry->desc.format,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(texture->texture != NULL);
+  texture->view = wgpuTextureCreateView(texture->texture, NULL);
+  ASSERT(texture->view != NULL);
+  return empty_slot;
+}
+
+/* Assigns a pooled texture to a resource, returns true when it changed */
+static bool
+wgpu_frame_graph_assign_texture(wgpu_frame_graph_t* graph,
+                                wgpu_frame_graph_resource_entry_t* entry)
+{
+  const uint32_t index = wgpu_frame_graph_acquire_texture(graph, entry);
+  wgpu_frame_graph_texture_t* texture = &graph->textures[index];
+  texture->used                       = true;
+  texture->last_pass                  = entry->last_pass;
+  const bool changed   = entry->texture_id != texture->id;
+  entry->texture_index = index;
+  entry->texture_id    = texture->id;
+  return changed;
+}
+
+bool wgpu_frame_graph_compile(wgpu_frame_graph_t* graph, uint32_t width,
+                              uint32_t height)
+{
+  // Sizes and lifetimes, a pass index range per resource
+  for (uint32_t i = 0; i < graph->resource_count; ++i) {
+    wgpu_frame_graph_resource_entry_t* entry = &graph->resources[i];
+    const float scale = entry->desc.scale > 0.0f ? entry->desc.scale : 1.0f;
+    entry->width      = entry->desc.width > 0 ?
+                          entry->desc.width :
+                          MAX((uint32_t)((float)width * scale), 1u);
+    entry->height     = entry->desc.height > 0 ?
+                          entry->desc.height :
+                          MAX((uint32_t)((float)height * scale), 1u);
+    entry->first_pass = WGPU_FRAME_GRAPH_NO_PASS;
+    entry->last_pass  = WGPU_FRAME_GRAPH_NO_PASS;
+  }
+  for (uint32_t p = 0; p < graph->pass_count; ++p) {
+    const wgpu_frame_graph_pass_desc_t* pass = &graph->passes[p];
+    for (uint32_t i = 0; i < pass->input_count; ++i) {
+      wgpu_frame_graph_use(graph, pass->inputs[i], p);
+    }
+    for (uint32_t i = 0; i < pass->output_count; ++i) {
+      wgpu_frame_graph_use(graph, pass->outputs[i], p);
+    }
+  }
+  // Persistent resources outlive the last pass, no other resource can take
+  // their textures
+  for (uint32_t i = 0; i < graph->resource_count; ++i) {
+    wgpu_frame_graph_resource_entry_t* entry = &graph->resources[i];
+    if (entry->desc.persistent
+        && entry->first_pass != WGPU_FRAME_GRAPH_NO_PASS) {
+      entry->first_pass = 0;
+      entry->last_pass  = graph->pass_count;
+    }
+  }
+
+  // Assign the textures in the order the resources come alive, a texture is
+  // free again after the last pass of its current occupant. The persistent
+  // resources go first, so that they get their previous textures back.
+  for (uint32_t i = 0; i < graph->texture_count; ++i) {
+    graph->textures[i].used = false;
+  }
+  bool changed = false;
+  for (uint32_t i = 0; i < graph->resource_count; ++i) {
+    wgpu_frame_graph_resource_entry_t* entry = &graph->resources[i];
+    if (!entry->imported && entry->desc.persistent
+        && entry->first_pass != WGPU_FRAME_GRAPH_NO_PASS) {
+      changed = wgpu_frame_graph_assign_texture(graph, entry) || changed;
+    }
+  }
+  for (uint32_t p = 0; p < graph->pass_count; ++p) {
+    for (uint32_t i = 0; i < graph->resource_count; ++i) {
+      wgpu_frame_graph_resource_entry_t* entry = &graph->resources[i];
+      if (entry->imported || entry->desc.persistent || entry->first_pass != p) {
+        continue;
+      }
+      changed = wgpu_frame_graph_assign_texture(graph, entry) || changed;
+    }
+  }
+  for (uint32_t i = 0; i < graph->resource_count; ++i) {
+    wgpu_frame_graph_resource_entry_t* entry = &graph->resources[i];
+    if (!entry->imported && entry->first_pass == WGPU_FRAME_GRAPH_NO_PASS) {
+      entry->texture_index = UINT32_MAX;
+      entry->texture_id    = 0;
+    }
+  }
+
+  // Textures of previous sizes or declarations are no longer needed
+  for (uint32_t i = 0; i < graph->texture_count; ++i) {
+    wgpu_frame_graph_texture_t* texture = &graph->textures[i];
+    if (!texture->used && texture->texture != NULL) {
+      WGPU_RELEASE_RESOURCE(TextureView, texture->view)
+      WGPU_RELEASE_RESOURCE(Texture, texture->texture)
+    }
+  }
+
+  graph->compiled = true;
+  log_debug("Frame graph: %u passes, %u resources, %u textures",
+            graph->pass_count, graph->resource_count,
+            wgpu_frame_graph_get_texture_count(graph));
+  return changed;
+}
+
+void wgpu_frame_graph_execute(wgpu_frame_graph_t* graph,
+                              WGPUCommandEncoder cmd_enc)
+{
+  ASSERT(graph->compiled);
+  for (uint32_t p = 0; p < graph->pass_count; ++p) {
+    const wgpu_frame_graph_pass_desc_t* pass = &graph->passes[p];
+    if (pass->func != NULL) {
+      pass->func(graph, cmd_enc, pass->user_data);
+    }
+  }
+}
+
+WGPUTexture wgpu_frame_graph_get_texture(wgpu_frame_graph_t* graph,
+                                         wgpu_frame_graph_resource_t resource)
+{
+  ASSERT(resource < graph->resource_count);
+  const wgpu_frame_graph_resource_entry_t* entry = &graph->resources[resource];
+  if (entry->imported || entry->texture_index == UINT32_MAX) {
+    return NULL;
+  }
+  return graph->textures[entry->texture_index].texture;
+}
+
+WGPUTextureView
+wgpu_frame_graph_get_view(wgpu_frame_graph_t* graph,
+                          wgpu_frame_graph_resource_t resource)
+{
+  ASSERT(resource < graph->resource_count);
+  const wgpu_frame_graph_resource_entry_t* entry = &graph->resources[resource];
+  if (entry->imported) {
+    return entry->imported_view;
+  }
+  if (entry->texture_index == UINT32_MAX) {
+    return NULL;
+  }
+  return graph->textures[entry->texture_index].view;
+}
+
+void wgpu_frame_graph_get_size(wgpu_frame_graph_t* graph,
+                               wgpu_frame_graph_resource_t resource,
+                               uint32_t* width, uint32_t* height)
+{
+  ASSERT(resource < graph->resource_count);
+  *width  = graph->resources[resource].width;
+  *height = graph->resources[resource].height;
+}
+
+uint32_t wgpu_frame_graph_get_texture_count(wgpu_frame_graph_t* graph)
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < graph->texture_count; ++i) {
+    count += graph->textures[i].texture != NULL ? 1 : 0;
+  }
+  return count;
+}
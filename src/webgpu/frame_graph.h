@@ -0,0 +1,102 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include "context.h"
+
+#define WGPU_FRAME_GRAPH_MAX_PASS_RESOURCES 8u
+#define WGPU_FRAME_GRAPH_INVALID_RESOURCE UINT32_MAX
+
+/*
+ * Frame graph for multi-pass chains, e.g. post processing. Passes declare the
+ * textures they read and write, the graph derives the lifetime of every
+ * transient texture from the pass order and lets textures with the same
+ * format, size and usage whose lifetimes do not overlap share one WGPUTexture.
+ * The textures are pooled across compiles, so resizing only recreates the
+ * textures whose size changed. Persistent textures keep their contents from
+ * frame to frame, e.g. the ping-pong targets of feedback passes.
+ */
+typedef struct wgpu_frame_graph wgpu_frame_graph_t;
+typedef uint32_t wgpu_frame_graph_resource_t;
+
+typedef struct wgpu_frame_graph_texture_desc_t {
+  const char* label;
+  WGPUTextureFormat format;
+  /* Size in texels, 0 selects the size the graph is compiled with multiplied
+   * by scale, which for example gives half resolution bloom textures */
+  uint32_t width;
+  uint32_t height;
+  float scale; /* 0 selects 1 */
+  /* None selects RenderAttachment | TextureBinding */
+  WGPUTextureUsage usage;
+  /* Alive during all passes, so never shared, and kept across compiles while
+   * its size does not change */
+  bool persistent;
+} wgpu_frame_graph_texture_desc_t;
+
+typedef void (*wgpu_frame_graph_execute_func_t)(wgpu_frame_graph_t* graph,
+                                                WGPUCommandEncoder cmd_enc,
+                                                void* user_data);
+
+typedef struct wgpu_frame_graph_pass_desc_t {
+  const char* label;
+  uint32_t input_count;
+  wgpu_frame_graph_resource_t inputs[WGPU_FRAME_GRAPH_MAX_PASS_RESOURCES];
+  uint32_t output_count;
+  wgpu_frame_graph_resource_t outputs[WGPU_FRAME_GRAPH_MAX_PASS_RESOURCES];
+  wgpu_frame_graph_execute_func_t func;
+  void* user_data;
+} wgpu_frame_graph_pass_desc_t;
+
+/* Frame graph creating/releasing, releasing frees all pooled textures */
+wgpu_frame_graph_t* wgpu_frame_graph_create(wgpu_context_t* wgpu_context);
+void wgpu_frame_graph_release(wgpu_frame_graph_t* graph);
+
+/* Removes all resources and passes, the pooled textures are kept for the next
+ * compile */
+void wgpu_frame_graph_reset(wgpu_frame_graph_t* graph);
+
+/* Declares a transient texture, allocated by wgpu_frame_graph_compile */
+wgpu_frame_graph_resource_t
+wgpu_frame_graph_create_texture(wgpu_frame_graph_t* graph,
+                                const wgpu_frame_graph_texture_desc_t* desc);
+
+/* Declares a texture owned by the caller, e.g. the swap chain image, whose
+ * view can be changed every frame with wgpu_frame_graph_set_imported_view */
+wgpu_frame_graph_resource_t
+wgpu_frame_graph_import_texture(wgpu_frame_graph_t* graph, const char* label,
+                                WGPUTextureView view);
+void wgpu_frame_graph_set_imported_view(wgpu_frame_graph_t* graph,
+                                        wgpu_frame_graph_resource_t resource,
+                                        WGPUTextureView view);
+
+/* Appends a pass, passes are executed in the order they are added */
+void wgpu_frame_graph_add_pass(wgpu_frame_graph_t* graph,
+                               const wgpu_frame_graph_pass_desc_t* desc);
+
+/**
+ * @brief Assigns pooled textures to the transient resources for the given
+ * size, to be called after declaring the graph and on resize. Returns true
+ * when the texture of any resource changed, the bind groups referencing them
+ * have to be recreated then.
+ */
+bool wgpu_frame_graph_compile(wgpu_frame_graph_t* graph, uint32_t width,
+                              uint32_t height);
+
+/* Records all passes into the command encoder */
+void wgpu_frame_graph_execute(wgpu_frame_graph_t* graph,
+                              WGPUCommandEncoder cmd_enc);
+
+/* Texture and view of a resource, valid until the next compile */
+WGPUTexture wgpu_frame_graph_get_texture(wgpu_frame_graph_t* graph,
+                                         wgpu_frame_graph_resource_t resource);
+WGPUTextureView
+wgpu_frame_graph_get_view(wgpu_frame_graph_t* graph,
+                          wgpu_frame_graph_resource_t resource);
+void wgpu_frame_graph_get_size(wgpu_frame_graph_t* graph,
+                               wgpu_frame_graph_resource_t resource,
+                               uint32_t* width, uint32_t* height);
+
+/* Number of textures allocated for the transient resources */
+uint32_t wgpu_frame_graph_get_texture_count(wgpu_frame_graph_t* graph);
+
+#endif
@@ -0,0 +1,151 @@
+#include "frame_uniforms.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+struct wgpu_frame_uniforms_t {
+  wgpu_frame_uniforms_data_t data;
+  wgpu_buffer_t buffer;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* frame_uniforms_wgsl = CODE(
+  struct FrameUniforms {
+    view : mat4x4<f32>,
+    projection : mat4x4<f32>,
+    viewProjection : mat4x4<f32>,
+    jitteredViewProjection : mat4x4<f32>,
+    inverseView : mat4x4<f32>,
+    inverseProjection : mat4x4<f32>,
+    inverseViewProjection : mat4x4<f32>,
+    cameraPosition : vec4<f32>,
+    resolution : vec4<f32>,
+    jitter : vec2<f32>,
+    zNear : f32,
+    zFar : f32,
+    time : f32,
+    deltaTime : f32,
+    timer : f32,
+    frameIndex : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> frame : FrameUniforms;
+);
+// clang-format on
+
+static wgpu_frame_uniforms_t*
+wgpu_frame_uniforms_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_frame_uniforms_t* frame_uniforms
+    = (wgpu_frame_uniforms_t*)malloc(sizeof(wgpu_frame_uniforms_t));
+  memset(frame_uniforms, 0, sizeof(wgpu_frame_uniforms_t));
+
+  glm_mat4_identity(frame_uniforms->data.view);
+  glm_mat4_identity(frame_uniforms->data.projection);
+  glm_mat4_identity(frame_uniforms->data.view_projection);
+  glm_mat4_identity(frame_uniforms->data.jittered_view_projection);
+  glm_mat4_identity(frame_uniforms->data.inverse_view);
+  glm_mat4_identity(frame_uniforms->data.inverse_projection);
+  glm_mat4_identity(frame_uniforms->data.inverse_view_projection);
+
+  frame_uniforms->buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "frame_uniforms_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(wgpu_frame_uniforms_data_t),
+                    .initial.data = &frame_uniforms->data,
+                  });
+
+  WGPUBindGroupLayoutEntry bgl_entries[1] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Frame uniforms
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment
+                    | WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(wgpu_frame_uniforms_data_t),
+      },
+    },
+  };
+  frame_uniforms->bind_group_layout = wgpu_get_bind_group_layout(
+    wgpu_context, bgl_entries, (uint32_t)ARRAY_SIZE(bgl_entries));
+  ASSERT(frame_uniforms->bind_group_layout != NULL);
+
+  WGPUBindGroupEntry bg_entries[1] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = frame_uniforms->buffer.buffer,
+      .size    = frame_uniforms->buffer.size,
+    },
+  };
+  frame_uniforms->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "frame_uniforms_bind_group",
+                            .layout     = frame_uniforms->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(frame_uniforms->bind_group != NULL);
+
+  return frame_uniforms;
+}
+
+void wgpu_frame_uniforms_destroy(wgpu_frame_uniforms_t* frame_uniforms)
+{
+  if (frame_uniforms == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, frame_uniforms->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, frame_uniforms->bind_group_layout)
+  wgpu_destroy_buffer(&frame_uniforms->buffer);
+  free(frame_uniforms);
+}
+
+static wgpu_frame_uniforms_t*
+wgpu_get_frame_uniforms(wgpu_context_t* wgpu_context)
+{
+  if (wgpu_context->frame_uniforms == NULL) {
+    wgpu_context->frame_uniforms = wgpu_frame_uniforms_create(wgpu_context);
+  }
+  return wgpu_context->frame_uniforms;
+}
+
+void wgpu_frame_uniforms_update(wgpu_context_t* wgpu_context,
+                                const wgpu_frame_uniforms_data_t* data)
+{
+  wgpu_frame_uniforms_t* frame_uniforms = wgpu_get_frame_uniforms(wgpu_context);
+  memcpy(&frame_uniforms->data, data, sizeof(wgpu_frame_uniforms_data_t));
+  wgpu_queue_write_buffer(wgpu_context, frame_uniforms->buffer.buffer, 0,
+                          &frame_uniforms->data,
+                          sizeof(wgpu_frame_uniforms_data_t));
+}
+
+const wgpu_frame_uniforms_data_t*
+wgpu_frame_uniforms_get_data(wgpu_context_t* wgpu_context)
+{
+  return &wgpu_get_frame_uniforms(wgpu_context)->data;
+}
+
+WGPUBindGroupLayout
+wgpu_frame_uniforms_get_bind_group_layout(wgpu_context_t* wgpu_context)
+{
+  return wgpu_get_frame_uniforms(wgpu_context)->bind_group_layout;
+}
+
+WGPUBindGroup wgpu_frame_uniforms_get_bind_group(wgpu_context_t* wgpu_context)
+{
+  return wgpu_get_frame_uniforms(wgpu_context)->bind_group;
+}
+
+const char* wgpu_frame_uniforms_get_wgsl(void)
+{
+  return frame_uniforms_wgsl;
+}
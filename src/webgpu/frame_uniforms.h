@@ -0,0 +1,71 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+/* Bind group of the frame uniforms in the pipelines using them */
+#define WGPU_FRAME_UNIFORMS_GROUP 0u
+
+/* Contents of the block, laid out as the FrameUniforms struct of the WGSL
+ * declaration */
+typedef struct wgpu_frame_uniforms_data_t {
+  mat4 view;
+  mat4 projection;
+  mat4 view_projection;
+  /* view projection with the jittered projection of the camera */
+  mat4 jittered_view_projection;
+  mat4 inverse_view;
+  mat4 inverse_projection;
+  mat4 inverse_view_projection;
+  /* World space position of the camera, w = 1 */
+  vec4 camera_position;
+  /* width, height, 1 / width, 1 / height of the surface */
+  vec4 resolution;
+  /* Sub-pixel offset of the jittered projection in normalized device
+   * coordinates */
+  vec2 jitter;
+  float znear;
+  float zfar;
+  /* Run time and frame time in seconds, animation timer in [0, 1) */
+  float time;
+  float delta_time;
+  float timer;
+  uint32_t frame_index;
+} wgpu_frame_uniforms_data_t;
+
+/*
+ * Frame uniforms: one uniform block with the camera matrices, time,
+ * resolution and jitter of the frame, shared by all passes through one bind
+ * group at group 0 instead of a camera buffer per example and pass.
+ *
+ * The block is written once per frame, before the passes are recorded. The
+ * queue writes are ordered with the submissions, so one buffer serves all
+ * frames in flight, and as the bind group never changes the render bundles
+ * can bind it as well. The block is shared per context and created on first
+ * use.
+ */
+typedef struct wgpu_frame_uniforms_t wgpu_frame_uniforms_t;
+void wgpu_frame_uniforms_destroy(wgpu_frame_uniforms_t* frame_uniforms);
+
+/* Writes the block of the frame being recorded */
+void wgpu_frame_uniforms_update(wgpu_context_t* wgpu_context,
+                                const wgpu_frame_uniforms_data_t* data);
+
+/* Contents of the last update, e.g. for the passes computing on the CPU */
+const wgpu_frame_uniforms_data_t*
+wgpu_frame_uniforms_get_data(wgpu_context_t* wgpu_context);
+
+/* Layout of group WGPU_FRAME_UNIFORMS_GROUP and the bind group to set there,
+ * both owned by the context. The block is visible to all shader stages. */
+WGPUBindGroupLayout
+wgpu_frame_uniforms_get_bind_group_layout(wgpu_context_t* wgpu_context);
+WGPUBindGroup wgpu_frame_uniforms_get_bind_group(wgpu_context_t* wgpu_context);
+
+/* WGSL declaration of the block, `frame` at binding 0 of group
+ * WGPU_FRAME_UNIFORMS_GROUP, prefixed to the shaders with frame_uniforms set
+ * in their wgpu_shader_desc_t */
+const char* wgpu_frame_uniforms_get_wgsl(void);
+
+#endif
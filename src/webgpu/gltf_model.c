@@ -7,8 +7,15 @@
 #include <cgltf.h>
 
 #include "../core/file.h"
+#include "../core/frustum.h"
+#include "../core/job_system.h"
 #include "../core/log.h"
 #include "../core/macro.h"
+#include "../core/math.h"
+#include "../core/mesh_decoder.h"
+#include "../core/mesh_optimizer.h"
+#include "../core/profiler.h"
+#include "../core/transform_batch.h"
 
 /*
  * Forward declarations
@@ -18,6 +25,11 @@ struct gltf_node_t;
 static struct gltf_node_t*
 gltf_model_node_from_index(struct gltf_model_t* model, uint32_t index);
 static void gltf_model_get_scene_dimensions(struct gltf_model_t* model);
+static void gltf_model_build_draw_list(struct gltf_model_t* model);
+static void gltf_model_prepare_gpu_culling(struct gltf_model_t* model);
+static void gltf_model_create_animation_bind_group(struct gltf_model_t* model,
+                                                   WGPUBuffer joint_buffer,
+                                                   uint64_t joint_offset);
 
 /*
  * glTF enums
@@ -53,30 +65,25 @@ static vec3* vec3_max(vec3* x, vec3* y)
 static void bounding_get_aabb(bounding_box_t* bounding_box, mat4 m,
                               bounding_box_t* dest)
 {
-  vec3 min = {m[0][3], m[0][3], m[0][3]};
+  // Transformed box enclosing the eight transformed corners: the translation
+  // plus the smaller and larger extent along each basis vector of m
+  vec3 min = {m[3][0], m[3][1], m[3][2]};
   vec3 max = GLM_VEC3_ZERO_INIT;
   glm_vec3_copy(min, max);
   vec3 v0 = GLM_VEC3_ZERO_INIT, v1 = GLM_VEC3_ZERO_INIT;
-
-  vec3 right = {m[0][0], m[0][0], m[0][0]};
-  glm_vec3_scale(right, bounding_box->min[0], v0);
-  glm_vec3_scale(right, bounding_box->max[0], v1);
-  glm_vec3_add(min, *vec3_min(&v0, &v1), min);
-  glm_vec3_add(max, *vec3_max(&v0, &v1), max);
-
-  vec3 up = {m[0][1], m[0][1], m[0][1]};
-  glm_vec3_scale(up, bounding_box->min[1], v0);
-  glm_vec3_scale(up, bounding_box->max[1], v1);
-  glm_vec3_add(min, *vec3_min(&v0, &v1), min);
-  glm_vec3_add(max, *vec3_max(&v0, &v1), max);
-
-  vec3 back = {m[0][2], m[0][2], m[0][2]};
-  glm_vec3_scale(back, bounding_box->min[2], v0);
-  glm_vec3_scale(back, bounding_box->max[2], v1);
-  glm_vec3_add(min, *vec3_min(&v0, &v1), min);
-  glm_vec3_add(max, *vec3_max(&v0, &v1), max);
+  vec3 v_min = GLM_VEC3_ZERO_INIT, v_max = GLM_VEC3_ZERO_INIT;
+
+  for (uint32_t i = 0; i < 3; ++i) {
+    glm_vec3_scale(m[i], bounding_box->min[i], v0);
+    glm_vec3_scale(m[i], bounding_box->max[i], v1);
+    glm_vec3_minv(v0, v1, v_min);
+    glm_vec3_maxv(v0, v1, v_max);
+    glm_vec3_add(min, v_min, min);
+    glm_vec3_add(max, v_max, max);
+  }
 
   bounding_box_init(dest, min, max);
+  dest->valid = bounding_box->valid;
 }
 
 /*
@@ -133,6 +140,9 @@ static void gltf_texture_init(gltf_texture_t* texture,
                               wgpu_context_t* wgpu_context)
 {
   texture->wgpu_context = wgpu_context;
+  texture->array        = NULL;
+  texture->layer        = 0;
+  texture->registry_key = 0;
 }
 
 static void gltf_texture_destroy(gltf_texture_t* texture)
@@ -141,7 +151,14 @@ static void gltf_texture_destroy(gltf_texture_t* texture)
     return;
   }
 
-  wgpu_destroy_texture(&texture->wgpu_texture);
+  if (texture->registry_key != 0) {
+    wgpu_texture_client_release_texture(texture->wgpu_context->texture_client,
+                                         texture->registry_key,
+                                         &texture->wgpu_texture);
+  }
+  else {
+    wgpu_destroy_texture(&texture->wgpu_texture);
+  }
 }
 
 static void get_relative_file_path(const char* base_path, const char* new_path,
@@ -158,35 +175,175 @@ static void get_relative_file_path(const char* base_path, const char* new_path,
   snprintf(insert_point, strlen(new_path) + 1, "%s", new_path);
 }
 
-static void gltf_texture_from_gltf_image(const char* model_uri,
-                                         gltf_texture_t* texture,
-                                         cgltf_image* gltf_image)
+/* Data of a buffer view, decoded for views compressed with
+ * EXT_meshopt_compression */
+static uint8_t* gltf_buffer_view_data(const cgltf_buffer_view* view)
+{
+  return view->data != NULL ? (uint8_t*)view->data :
+                              (uint8_t*)view->buffer->data + view->offset;
+}
+
+static uint8_t* gltf_accessor_data(const cgltf_accessor* accessor)
 {
-  ASSERT(texture && texture->wgpu_context != NULL);
+  return gltf_buffer_view_data(accessor->buffer_view) + accessor->offset;
+}
 
-  if (gltf_image->uri != NULL) {
+static bool gltf_decode_meshopt_buffer_view(cgltf_buffer_view* view)
+{
+  const cgltf_meshopt_compression* compression = &view->meshopt_compression;
+  if (compression->buffer->data == NULL || compression->count > UINT32_MAX
+      || compression->stride > UINT32_MAX) {
+    return false;
+  }
+  const uint8_t* source
+    = (const uint8_t*)compression->buffer->data + compression->offset;
+  const uint32_t count  = (uint32_t)compression->count;
+  const uint32_t stride = (uint32_t)compression->stride;
+  void* result          = malloc(MAX((size_t)count * stride, (size_t)1));
+
+  bool success = false;
+  switch (compression->mode) {
+    case cgltf_meshopt_compression_mode_attributes:
+      success = mesh_decode_vertex_buffer(result, count, stride, source,
+                                          compression->size);
+      break;
+    case cgltf_meshopt_compression_mode_triangles:
+      success = mesh_decode_index_buffer(result, count, stride, source,
+                                         compression->size);
+      break;
+    case cgltf_meshopt_compression_mode_indices:
+      success = mesh_decode_index_sequence(result, count, stride, source,
+                                           compression->size);
+      break;
+    default:
+      break;
+  }
+  if (!success) {
+    free(result);
+    return false;
+  }
+
+  switch (compression->filter) {
+    case cgltf_meshopt_compression_filter_octahedral:
+      mesh_decode_filter_octahedral(result, count, stride);
+      break;
+    case cgltf_meshopt_compression_filter_quaternion:
+      mesh_decode_filter_quaternion(result, count, stride);
+      break;
+    case cgltf_meshopt_compression_filter_exponential:
+      mesh_decode_filter_exponential(result, count, stride);
+      break;
+    default:
+      break;
+  }
+  // Released by cgltf_free
+  view->data = result;
+  return true;
+}
+
+static void gltf_decode_meshopt_range(void* user_data, uint32_t begin,
+                                      uint32_t end)
+{
+  cgltf_data* data = (cgltf_data*)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    cgltf_buffer_view* view = &data->buffer_views[i];
+    if (view->has_meshopt_compression && view->data == NULL) {
+      gltf_decode_meshopt_buffer_view(view);
+    }
+  }
+}
+
+/*
+ * Decodes the buffer views compressed with EXT_meshopt_compression on the job
+ * system, one job per view. Returns false if a view could not be decoded.
+ */
+static bool gltf_decode_meshopt_buffer_views(cgltf_data* data)
+{
+  job_system_parallel_for(job_system_get_shared(),
+                          (uint32_t)data->buffer_views_count, 1,
+                          gltf_decode_meshopt_range, data);
+  for (cgltf_size i = 0; i < data->buffer_views_count; ++i) {
+    const cgltf_buffer_view* view = &data->buffer_views[i];
+    if (view->has_meshopt_compression && view->data == NULL) {
+      log_error("Could not decode meshopt compressed buffer view %u\n",
+                (uint32_t)i);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Draco decoding is not supported, only uncompressed fallbacks are loaded */
+static void gltf_check_required_extensions(const cgltf_data* data,
+                                           const char* filename)
+{
+  for (cgltf_size i = 0; i < data->extensions_required_count; ++i) {
+    if (strcmp(data->extensions_required[i], "KHR_draco_mesh_compression")
+        == 0) {
+      log_warn("%s requires KHR_draco_mesh_compression, Draco compressed "
+               "primitives are skipped\n",
+               filename);
+    }
+  }
+}
+
+/*
+ * Texture source of either the image file referenced by uri (relative to the
+ * model file) or the encoded image data embedded in the model, usage
+ * WGPUTextureUsage_None selects the default usage of the texture loaders. The
+ * filename is written to image_uri.
+ */
+static wgpu_texture_source_t
+gltf_texture_source(const char* model_uri, const char* uri, const void* data,
+                    size_t size, WGPUTextureUsage usage,
+                    char image_uri[STRMAX])
+{
+  if (uri != NULL) {
     /* Load image data from file */
-    char image_uri[STRMAX];
-    get_relative_file_path(model_uri, gltf_image->uri, image_uri);
+    get_relative_file_path(model_uri, uri, image_uri);
     if (filename_has_extension(image_uri, "jpg")
         || filename_has_extension(image_uri, "png")
         || filename_has_extension(image_uri, "ktx")) {
-      texture->wgpu_texture = wgpu_create_texture_from_file(
-        texture->wgpu_context, image_uri,
-        &(struct wgpu_texture_load_options_t){
+      return (wgpu_texture_source_t){
+        .filename = image_uri,
+        .options  = {
           .generate_mipmaps = true,
+          .usage            = usage,
           .address_mode     = WGPUAddressMode_Repeat,
-        });
+        },
+      };
     }
   }
-  else if (gltf_image->buffer_view) {
+  else if (data != NULL) {
     /* Load image data from memory */
-    texture->wgpu_texture = wgpu_create_texture_from_memory(
-      texture->wgpu_context,
-      (void*)((uint8_t*)gltf_image->buffer_view->buffer->data
-              + gltf_image->buffer_view->offset),
-      gltf_image->buffer_view->size, NULL);
+    return (wgpu_texture_source_t){
+      .data      = data,
+      .data_size = size,
+      .options   = {
+        .usage        = usage,
+        .address_mode = WGPUAddressMode_ClampToEdge,
+      },
+    };
+  }
+  return (wgpu_texture_source_t){0};
+}
+
+static wgpu_texture_source_t
+gltf_texture_source_from_gltf_image(const char* model_uri,
+                                    cgltf_image* gltf_image,
+                                    WGPUTextureUsage usage,
+                                    char image_uri[STRMAX])
+{
+  if (gltf_image->uri != NULL) {
+    return gltf_texture_source(model_uri, gltf_image->uri, NULL, 0, usage,
+                               image_uri);
   }
+  else if (gltf_image->buffer_view) {
+    return gltf_texture_source(model_uri, NULL,
+                               gltf_buffer_view_data(gltf_image->buffer_view),
+                               gltf_image->buffer_view->size, usage, image_uri);
+  }
+  return (wgpu_texture_source_t){0};
 }
 
 /*
@@ -227,6 +384,7 @@ static void gltf_material_init(gltf_material_t* material,
   material->pbr_workflows.specular_glossiness = false;
   material->bind_group                        = NULL;
   material->pipeline                          = NULL;
+  material->index                             = 0;
 }
 
 static void gltf_material_destroy(gltf_material_t* material)
@@ -238,6 +396,15 @@ static void gltf_material_destroy(gltf_material_t* material)
 /*
  * glTF primitive
  */
+#define GLTF_MAX_LOD_COUNT 4u
+
+/* Index range of a level of detail referencing the primitive's vertices */
+typedef struct gltf_primitive_lod_t {
+  uint32_t first_index;
+  uint32_t index_count;
+  float error; /* geometric error in mesh units, 0 for the full resolution */
+} gltf_primitive_lod_t;
+
 typedef struct gltf_primitive_t {
   uint32_t first_index;
   uint32_t index_count;
@@ -246,6 +413,15 @@ typedef struct gltf_primitive_t {
   gltf_material_t* material;
   bool has_indices;
   bounding_box_t bb;
+  /* lods[0] is the full resolution range, coarser levels follow */
+  gltf_primitive_lod_t lods[GLTF_MAX_LOD_COUNT];
+  uint32_t lod_count;
+  /* Mesh buffer mesh of lods[0], the other levels follow */
+  uint32_t first_pulled_mesh;
+  /* Morph target deltas, the vertices of each target follow the ones of the
+   * previous target */
+  uint32_t morph_target_count;
+  uint32_t first_morph_delta;
 } gltf_primitive_t;
 
 static void gltf_primitive_init(gltf_primitive_t* primitive,
@@ -259,6 +435,14 @@ static void gltf_primitive_init(gltf_primitive_t* primitive,
   primitive->material     = material;
   primitive->has_indices  = index_count > 0;
   bounding_box_init(&primitive->bb, GLM_VEC3_ZERO, GLM_VEC3_ZERO);
+  primitive->lods[0] = (gltf_primitive_lod_t){
+    .first_index = first_index,
+    .index_count = index_count,
+  };
+  primitive->lod_count          = 1;
+  primitive->first_pulled_mesh  = 0;
+  primitive->morph_target_count = 0;
+  primitive->first_morph_delta  = 0;
 }
 
 static void gltf_primitive_set_bounding_box(gltf_primitive_t* primitive,
@@ -281,6 +465,7 @@ typedef struct gltf_mesh_t {
   bounding_box_t aabb;
   struct {
     WGPUBuffer buffer;
+    uint64_t offset; /* offset of the slice in the pooled buffer */
     uint64_t size;
     WGPUBindGroup bind_group;
   } uniform_buffer;
@@ -289,19 +474,30 @@ typedef struct gltf_mesh_t {
     mat4 joint_matrix[WGPU_GLTF_MAX_NUM_JOINTS];
     float joint_count;
   } uniform_block;
+  uint64_t upload_size; /* bytes of uniform_block to write, 0 if unchanged */
+  /* Weights of the morph targets in the weights of the model */
+  uint32_t morph_target_count;
+  uint32_t first_morph_weight;
 } gltf_mesh_t;
 
 static void gltf_mesh_init(gltf_mesh_t* mesh, wgpu_context_t* wgpu_context,
+                           wgpu_buffer_pool_t* uniform_buffer_pool,
                            mat4 matrix)
 {
   memset(mesh, 0, sizeof(gltf_mesh_t));
 
   mesh->wgpu_context = wgpu_context;
   glm_mat4_copy(matrix, mesh->uniform_block.matrix);
-  mesh->uniform_buffer.size   = sizeof(mesh->uniform_block);
-  mesh->uniform_buffer.buffer = wgpu_create_buffer_from_data(
-    wgpu_context, &mesh->uniform_block, mesh->uniform_buffer.size,
-    WGPUBufferUsage_Uniform);
+  wgpu_buffer_desc_t uniform_buffer_desc = {
+    .usage        = WGPUBufferUsage_Uniform,
+    .size         = sizeof(mesh->uniform_block),
+    .initial.data = &mesh->uniform_block,
+  };
+  wgpu_buffer_t uniform_buffer
+    = wgpu_buffer_pool_allocate(uniform_buffer_pool, &uniform_buffer_desc);
+  mesh->uniform_buffer.buffer = uniform_buffer.buffer;
+  mesh->uniform_buffer.offset = uniform_buffer.offset;
+  mesh->uniform_buffer.size   = uniform_buffer.size;
 }
 
 static void gltf_mesh_destroy(gltf_mesh_t* mesh)
@@ -356,6 +552,13 @@ typedef struct gltf_node_t {
   vec3 translation;
   vec3 scale;
   versor rotation;
+  bool has_matrix;    /* matrix is applied after translation, rotation, scale */
+  uint32_t transform_index; /* in model->transforms, the linear node index */
+  mat4 world_matrix;  /* local matrix concatenated with the parent ones */
+  bool dirty;         /* translation, rotation or scale changed */
+  bool world_changed; /* world matrix changed during the last update */
+  uint32_t joint_matrix_offset; /* first joint matrix for compute skinning */
+  uint32_t cull_index; /* in model->culling.nodes, UINT32_MAX if not culled */
   bounding_box_t bvh;
   bounding_box_t aabb;
 } gltf_node_t;
@@ -373,112 +576,70 @@ static void gltf_node_init(gltf_node_t* node)
   glm_vec3_zero(node->translation);
   glm_vec3_one(node->scale);
   glm_quat_identity(node->rotation);
+  glm_mat4_identity(node->world_matrix);
+  node->has_matrix      = false;
+  node->transform_index = UINT32_MAX;
+  node->dirty           = true;
+  node->world_changed   = false;
+  node->cull_index      = UINT32_MAX;
   bounding_box_init(&node->bvh, GLM_VEC3_ZERO, GLM_VEC3_ZERO);
   bounding_box_init(&node->aabb, GLM_VEC3_ZERO, GLM_VEC3_ZERO);
 }
 
-static void glm_cast_versor_to_mat3(versor q, mat3* result)
-{
-  float qxx = q[0] * q[0];
-  float qyy = q[1] * q[1];
-  float qzz = q[2] * q[2];
-  float qxz = q[0] * q[2];
-  float qxy = q[0] * q[1];
-  float qyz = q[1] * q[2];
-  float qwx = q[3] * q[0];
-  float qwy = q[3] * q[1];
-  float qwz = q[3] * q[2];
-
-  (*result)[0][0] = 1.0f - 2.0f * (qyy + qzz);
-  (*result)[0][1] = 2.0f * (qxy + qwz);
-  (*result)[0][2] = 2.0f * (qxz - qwy);
-
-  (*result)[1][0] = 2.0f * (qxy - qwz);
-  (*result)[1][1] = 1.0f - 2.0f * (qxx + qzz);
-  (*result)[1][2] = 2.0f * (qyz + qwx);
-
-  (*result)[2][0] = 2.0f * (qxz + qwy);
-  (*result)[2][1] = 2.0f * (qyz - qwx);
-  (*result)[2][2] = 1.0f - 2.0f * (qxx + qyy);
-}
-
-static void glm_cast_versor_to_mat4(versor q, mat4* result)
-{
-  mat3 m3 = GLM_MAT3_ZERO_INIT;
-  glm_cast_versor_to_mat3(q, &m3);
-  glm_mat4_identity(*result);
-  glm_mat4_ins3(m3, *result);
-}
-
-/*
- * Get a node's local matrix from the current translation, rotation and scale
- * values.These are calculated from the current animation an need to be
- * calculated dynamically.
- */
-static void gltf_node_get_local_matrix(gltf_node_t* node, mat4* dest)
-{
-  mat4 mat_translate = GLM_MAT4_IDENTITY_INIT;
-  glm_translate(mat_translate, node->translation);
-  mat4 mat_scale = GLM_MAT4_IDENTITY_INIT;
-  glm_scale(mat_scale, node->scale);
-  mat4 mat_rotation = GLM_MAT4_IDENTITY_INIT;
-  glm_cast_versor_to_mat4(node->rotation, &mat_rotation);
-  glm_mat4_mulN(
-    (mat4*[]){&mat_translate, &mat_rotation, &mat_scale, &node->matrix}, 4,
-    *dest);
-}
-
 /*
- * Traverse the node hierarchy to the top-most parent to get the local matrix of
- * the given node
+ * Update the matrices of the uniform block of a mesh node when the node or, for
+ * skinned meshes, one of the joints moved, and set the size of the block to
+ * upload. World matrices must be up to date. With compute skinning the joint
+ * matrices are written to joint_matrices instead of the uniform block, returns
+ * true if they changed. Touches no GPU state, so that the nodes of different
+ * models can be evaluated on different threads.
  */
-static void gltf_node_get_matrix(gltf_node_t* node, mat4* dest)
-{
-  gltf_node_get_local_matrix(node, dest);
-  gltf_node_t* p    = node->parent;
-  mat4 local_matrix = GLM_MAT4_ZERO_INIT;
-  while (p != NULL) {
-    gltf_node_get_local_matrix(p, &local_matrix);
-    glm_mat4_mul(local_matrix, *dest, *dest);
-    p = p->parent;
-  }
-}
-
-static void gltf_node_update(wgpu_context_t* wgpu_context, gltf_node_t* node)
+static bool gltf_node_evaluate_mesh(gltf_node_t* node, mat4* joint_matrices)
 {
-  if (node->mesh != NULL) {
-    mat4 m = GLM_MAT4_ZERO_INIT;
-    gltf_node_get_local_matrix(node, &m);
-    if (node->skin != NULL) {
-      gltf_skin_t* skin = node->skin;
-      glm_mat4_copy(m, node->mesh->uniform_block.matrix);
-      // Update the joint matrices
-      mat4 inverse_transform = GLM_MAT4_ZERO_INIT;
-      glm_mat4_inv(m, inverse_transform);
-      size_t num_joints = MIN(skin->joint_count, WGPU_GLTF_MAX_NUM_JOINTS);
-      for (size_t i = 0; i < num_joints; ++i) {
-        gltf_node_t* joint_node = skin->joints[i];
-        mat4 joint_mat          = GLM_MAT4_ZERO_INIT;
-        mat4 joint_node_mat     = GLM_MAT4_ZERO_INIT;
-        gltf_node_get_matrix(joint_node, &joint_node_mat);
-        glm_mat4_mul(joint_node_mat, skin->inverse_bind_matrices[i], joint_mat);
-        glm_mat4_mul(inverse_transform, joint_mat, joint_mat);
-        glm_mat4_copy(joint_mat, node->mesh->uniform_block.joint_matrix[i]);
-      }
-      node->mesh->uniform_block.joint_count = (float)skin->joint_count;
-      wgpu_queue_write_buffer(wgpu_context, node->mesh->uniform_buffer.buffer,
-                              0, &node->mesh->uniform_block,
-                              sizeof(node->mesh->uniform_buffer));
+  gltf_mesh_t* mesh = node->mesh;
+  gltf_skin_t* skin = node->skin;
+  if (skin != NULL) {
+    const bool compute_skinning = joint_matrices != NULL;
+    const uint32_t num_joints
+      = compute_skinning ?
+          skin->current_joint_index :
+          MIN(skin->current_joint_index, WGPU_GLTF_MAX_NUM_JOINTS);
+    bool changed = node->world_changed;
+    for (uint32_t i = 0; i < num_joints && !changed; ++i) {
+      changed = skin->joints[i]->world_changed;
     }
-    else {
-      wgpu_queue_write_buffer(wgpu_context, node->mesh->uniform_buffer.buffer,
-                              0, &m, sizeof(mat4));
+    if (!changed) {
+      return false;
     }
+    glm_mat4_copy(node->world_matrix, mesh->uniform_block.matrix);
+    // Update the joint matrices
+    mat4* dest = compute_skinning ? &joint_matrices[node->joint_matrix_offset] :
+                                    mesh->uniform_block.joint_matrix;
+    mat4 inverse_transform = GLM_MAT4_ZERO_INIT;
+    glm_mat4_inv(node->world_matrix, inverse_transform);
+    for (uint32_t i = 0; i < num_joints; ++i) {
+      mat4 joint_mat = GLM_MAT4_ZERO_INIT;
+      if (i < skin->inverse_bind_matrix_count) {
+        glm_mat4_mul(skin->joints[i]->world_matrix,
+                     skin->inverse_bind_matrices[i], joint_mat);
+      }
+      else {
+        glm_mat4_copy(skin->joints[i]->world_matrix, joint_mat);
+      }
+      glm_mat4_mul(inverse_transform, joint_mat, dest[i]);
+    }
+    // The vertices are already skinned when using compute skinning, a zero
+    // joint count makes the vertex shaders skip skinning
+    mesh->uniform_block.joint_count
+      = compute_skinning ? 0.0f : (float)skin->joint_count;
+    mesh->upload_size = sizeof(mesh->uniform_block);
+    return compute_skinning;
   }
-
-  for (uint32_t i = 0; i < node->child_count; ++i) {
-    gltf_node_update(wgpu_context, node->children[i]);
+  else if (node->world_changed) {
+    glm_mat4_copy(node->world_matrix, mesh->uniform_block.matrix);
+    mesh->upload_size = MAX(mesh->upload_size, sizeof(mat4));
   }
+  return false;
 }
 
 static void gltf_node_destroy(gltf_node_t* node)
@@ -501,6 +662,7 @@ typedef struct gltf_animation_channel_t {
   path_type_enum path;
   gltf_node_t* node;
   uint32_t sampler_index;
+  uint32_t key_cursor; /* keyframe interval of the last evaluation */
   bool is_valid;
 } gltf_animation_channel_t;
 
@@ -508,6 +670,7 @@ static void gltf_animation_channel_init(gltf_animation_channel_t* channel)
 {
   channel->node          = NULL;
   channel->sampler_index = 0;
+  channel->key_cursor    = 0;
   channel->is_valid      = false;
 }
 
@@ -627,6 +790,153 @@ uint64_t wgpu_gltf_get_vertex_size()
   return sizeof(gltf_vertex_t);
 }
 
+/* glTF compact vertex, 48 instead of 96 bytes */
+typedef struct gltf_compact_vertex_t {
+  vec3 pos;
+  int16_t normal[4];  /* snorm16, w unused */
+  uint16_t uv[2];     /* float16 */
+  uint8_t color[4];   /* unorm8 */
+  int16_t tangent[4]; /* snorm16, w is the bitangent sign */
+  uint16_t joint0[4];
+  uint8_t weight0[4]; /* unorm8, the weights sum up to 255 */
+} gltf_compact_vertex_t;
+
+WGPUVertexAttribute wgpu_gltf_get_compact_vertex_attribute_description(
+  uint32_t shader_location, wgpu_gltf_vertex_component_enum_t component)
+{
+  switch (component) {
+    case WGPU_GLTF_VertexComponent_Position:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Float32x3,
+        .offset         = offsetof(gltf_compact_vertex_t, pos),
+      };
+    case WGPU_GLTF_VertexComponent_Normal:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Snorm16x4,
+        .offset         = offsetof(gltf_compact_vertex_t, normal),
+      };
+    case WGPU_GLTF_VertexComponent_UV:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Float16x2,
+        .offset         = offsetof(gltf_compact_vertex_t, uv),
+      };
+    case WGPU_GLTF_VertexComponent_Color:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Unorm8x4,
+        .offset         = offsetof(gltf_compact_vertex_t, color),
+      };
+    case WGPU_GLTF_VertexComponent_Tangent:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Snorm16x4,
+        .offset         = offsetof(gltf_compact_vertex_t, tangent),
+      };
+    case WGPU_GLTF_VertexComponent_Joint0:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Uint16x4,
+        .offset         = offsetof(gltf_compact_vertex_t, joint0),
+      };
+    case WGPU_GLTF_VertexComponent_Weight0:
+      return (WGPUVertexAttribute){
+        .shaderLocation = shader_location,
+        .format         = WGPUVertexFormat_Unorm8x4,
+        .offset         = offsetof(gltf_compact_vertex_t, weight0),
+      };
+    default:
+      return (WGPUVertexAttribute){0};
+  }
+}
+
+uint64_t wgpu_gltf_get_compact_vertex_size()
+{
+  return sizeof(gltf_compact_vertex_t);
+}
+
+/*
+ * Vertex quantization
+ */
+static int16_t gltf_quantize_snorm16(float value)
+{
+  return (int16_t)roundf(glm_clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static uint8_t gltf_quantize_unorm8(float value)
+{
+  return (uint8_t)roundf(glm_clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+static void gltf_vertex_compact(const gltf_vertex_t* vertex,
+                                gltf_compact_vertex_t* dest)
+{
+  glm_vec3_copy((float*)vertex->pos, dest->pos);
+  for (uint32_t i = 0; i < 3; ++i) {
+    dest->normal[i] = gltf_quantize_snorm16(vertex->normal[i]);
+  }
+  dest->normal[3] = 0;
+  dest->uv[0]     = float_to_half(vertex->uv[0]);
+  dest->uv[1]     = float_to_half(vertex->uv[1]);
+  for (uint32_t i = 0; i < 4; ++i) {
+    dest->color[i]   = gltf_quantize_unorm8(vertex->color[i]);
+    dest->tangent[i] = gltf_quantize_snorm16(vertex->tangent[i]);
+    dest->joint0[i]  = (uint16_t)vertex->joint0[i];
+    dest->weight0[i] = gltf_quantize_unorm8(vertex->weight0[i]);
+  }
+
+  // Give the rounding error of the weights to the largest one, so that they
+  // still sum up to one
+  uint32_t weight_sum = 0, largest = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    weight_sum += dest->weight0[i];
+    if (dest->weight0[i] > dest->weight0[largest]) {
+      largest = i;
+    }
+  }
+  if (weight_sum > 0) {
+    const int32_t weight = (int32_t)dest->weight0[largest]
+                           + (255 - (int32_t)weight_sum);
+    dest->weight0[largest] = (uint8_t)glm_clamp((float)weight, 0.0f, 255.0f);
+  }
+}
+
+/*
+ * glTF draw list item
+ */
+typedef struct gltf_draw_item_t {
+  gltf_node_t* node;
+  gltf_primitive_t* primitive;
+  /* Material state when the draw list was sorted */
+  WGPURenderPipeline pipeline;
+  WGPUBindGroup bind_group;
+  uint32_t order;
+} gltf_draw_item_t;
+
+/*
+ * GPU culling item, one per draw list item in the same order. The bounds are
+ * in mesh space and transformed by the matrix of the node.
+ */
+#define GLTF_CULL_ITEM_ALWAYS_VISIBLE 0x1u
+/* indexCount, instanceCount, firstIndex, baseVertex, firstInstance */
+#define GLTF_CULL_DRAW_ARGS_COUNT 5u
+
+typedef struct gltf_cull_item_t {
+  vec3 bb_min;
+  uint32_t flags;
+  vec3 bb_max;
+  uint32_t node_index;
+  uint32_t index_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t padding;
+} gltf_cull_item_t;
+
+/* One bucket per alpha mode */
+#define GLTF_DRAW_BUCKET_COUNT 3u
+
 /*
  * glTF model loading and rendering class
  */
@@ -640,7 +950,13 @@ typedef struct gltf_model_t {
   struct {
     WGPUBuffer buffer;
     uint32_t count;
+    /* 16-bit indices are relative to the first vertex of their primitive */
+    WGPUIndexFormat format;
   } indices;
+  /* Optional deinterleaved vertex positions for depth-only passes */
+  struct {
+    WGPUBuffer buffer;
+  } positions;
 
   mat4 aabb;
 
@@ -649,6 +965,8 @@ typedef struct gltf_model_t {
 
   gltf_node_t** linear_nodes;
   uint32_t linear_node_count;
+  /* Local transforms of the linear nodes, composed in SIMD batches */
+  transform_batch_t transforms;
 
   gltf_skin_t* skins;
   uint32_t skin_count;
@@ -664,8 +982,30 @@ typedef struct gltf_model_t {
   gltf_material_t* materials;
   uint32_t material_count;
 
+  /* Material textures packed into 2D array textures */
+  struct {
+    bool enabled;
+    wgpu_gltf_texture_array_t* arrays;
+    uint32_t array_count;
+  } texture_packing;
+
+  /* PNG and JPEG images compressed to BC7 at load time */
+  bool compress_textures;
+
+  /* Textures shared with other models loading the same images */
+  bool share_textures;
+
+  /* Material parameters indexed by the material index, which is read from the
+   * index buffer at the dynamic offset of the material */
+  struct {
+    WGPUBuffer buffer;
+    WGPUBuffer index_buffer;
+    WGPUBindGroup bind_group;
+  } material_table;
+
   gltf_mesh_t* meshes;
   uint32_t mesh_count;
+  wgpu_buffer_pool_t* uniform_buffer_pool; /* per-mesh uniform buffers */
 
   gltf_animation_t* animations;
   uint32_t animation_count;
@@ -675,7 +1015,122 @@ typedef struct gltf_model_t {
     vec3 max;
   } dimensions;
 
+  /* Skinning in a compute pass writing skinned vertices to a vertex buffer */
+  struct {
+    bool enabled;
+    mat4* joint_matrices;
+    uint32_t joint_matrix_count;
+    bool joint_matrices_dirty;
+    WGPUBuffer joint_buffer;
+    WGPUBuffer job_buffer;
+    WGPUBuffer skinned_vertex_buffer;
+    WGPUComputePipeline pipeline;
+    WGPUBindGroup bind_group;
+    uint32_t job_count;
+    uint32_t max_vertex_count;
+    /* Bound part of the vertex buffers */
+    uint64_t vertex_binding_offset;
+    uint64_t vertex_binding_size;
+    /* Shared joint palette the joint matrices are uploaded to, if any */
+    struct wgpu_gltf_joint_palette* palette;
+    uint32_t palette_offset;
+  } compute_skinning;
+
+  /* Morph targets applied in a compute pass before the skinning */
+  struct {
+    float* weights;
+    uint32_t weight_count;
+    bool weights_dirty;
+    /* Deltas of all targets, released once uploaded */
+    float* deltas;
+    uint32_t delta_count;
+    struct gltf_morph_primitive_t* primitives;
+    struct gltf_morph_job_t* jobs;
+    struct gltf_morph_target_t* targets;
+    uint32_t job_count;
+    uint32_t target_capacity;
+    uint32_t max_vertex_count;
+    WGPUBuffer delta_buffer;
+    WGPUBuffer job_buffer;
+    WGPUBuffer target_buffer;
+    WGPUComputePipeline pipeline;
+    WGPUBindGroup bind_group;
+  } morph_targets;
+
+  struct {
+    gltf_draw_item_t* items;
+    uint32_t count;
+    /* Items of bucket b are in [bucket_offsets[b], bucket_offsets[b + 1]) */
+    uint32_t bucket_offsets[GLTF_DRAW_BUCKET_COUNT + 1];
+    bool sorted;
+    uint32_t version; /* incremented with every sort */
+  } draw_list;
+
+  /* Frustum culling of the nodes with bounded and unskinned meshes, the
+   * visibility is kept per draw so that passes can be encoded in parallel */
+  struct {
+    gltf_node_t** nodes;
+    uint32_t node_count;
+    bool pre_transformed; /* vertices are in world space */
+    bool flip_y;          /* vertex positions are mirrored along y */
+  } culling;
+
+  /* Visibility tests in a compute pass writing one indirect draw per item of
+   * the draw list */
+  struct {
+    bool enabled;
+    gltf_cull_item_t* items;
+    mat4* node_matrices;
+    WGPUBuffer item_buffer;
+    WGPUBuffer matrix_buffer;
+    WGPUBuffer params_buffer;
+    WGPUBuffer args_buffer;
+    WGPUTexture dummy_texture; /* bound when occlusion culling is off */
+    WGPUTextureView dummy_view;
+    WGPUBindGroupLayout bind_group_layout;
+    WGPUComputePipeline pipeline;
+    bool items_dirty;    /* draw list order changed since the last upload */
+    bool matrices_dirty; /* world matrices changed since the last upload */
+    bool args_valid;     /* indirect draws match the draw list */
+  } gpu_culling;
+
+  /* Keyframe sampling and animation blending in compute passes */
+  struct {
+    WGPUBuffer keyframe_buffer;
+    WGPUBuffer table_buffer;
+    WGPUBuffer node_buffer;
+    WGPUBuffer joint_buffer;
+    WGPUBuffer matrix_buffer;
+    WGPUBuffer params_buffer;
+    uint64_t keyframe_size;
+    uint64_t table_size;
+    uint32_t node_count;
+    uint32_t joint_count;
+    uint32_t channel_table;
+    uint32_t range_table;
+    WGPUBindGroupLayout bind_group_layout;
+    WGPUBindGroup bind_group;
+    WGPUComputePipeline sample_pipeline;
+    WGPUComputePipeline world_pipeline;
+    WGPUComputePipeline joint_pipeline;
+  } gpu_animation;
+
+  /* Triangles kept on the CPU, see wgpu_gltf_model_get_triangles */
+  struct {
+    bool enabled;
+    float* positions;
+    uint32_t vertex_count;
+    uint32_t* indices;
+    uint32_t index_count;
+    uint32_t* materials;
+  } triangles;
+
+  bool compact_vertices; /* vertex buffer uses gltf_compact_vertex_t */
+  bool position_stream;  /* positions buffer is created */
+  /* Optional, see WGPU_GLTF_RenderFlags_VertexPulling */
+  wgpu_mesh_buffer_t* mesh_buffer;
   bool buffers_bound;
+  uint32_t pending_upload_count; /* buffer uploads not written yet */
   char path[STRMAX];
 } gltf_model_t;
 
@@ -695,6 +1150,51 @@ static gltf_texture_t* gltf_model_get_texture(gltf_model_t* model,
   return NULL;
 }
 
+/* Textures are copied into their texture arrays when they are packed */
+static WGPUTextureUsage gltf_model_get_texture_usage(gltf_model_t* model)
+{
+  return model->texture_packing.enabled ?
+           WGPUTextureUsage_CopySrc | WGPUTextureUsage_CopyDst
+             | WGPUTextureUsage_TextureBinding :
+           WGPUTextureUsage_None;
+}
+
+/* The compression is skipped by the texture loaders for other images */
+static void gltf_model_set_texture_compression(gltf_model_t* model,
+                                               wgpu_texture_source_t* sources,
+                                               uint32_t source_count)
+{
+  if (!model->compress_textures) {
+    return;
+  }
+  for (uint32_t i = 0; i < source_count; ++i) {
+    sources[i].options.compression = TEXTURE_COMPRESSION_COLOR;
+  }
+}
+
+/* Takes the textures already loaded by other models from the registry of the
+ * texture client, their sources are cleared to skip loading them again */
+static void gltf_model_acquire_shared_textures(gltf_model_t* model,
+                                               wgpu_texture_source_t* sources,
+                                               uint32_t source_count)
+{
+  if (!model->share_textures) {
+    return;
+  }
+  wgpu_create_texture_client(model->wgpu_context);
+  struct wgpu_texture_client_t* texture_client
+    = model->wgpu_context->texture_client;
+  for (uint32_t i = 0; i < source_count; ++i) {
+    gltf_texture_t* texture = &model->textures[i];
+    texture->registry_key   = wgpu_texture_source_get_key(&sources[i]);
+    if (texture->registry_key != 0
+        && wgpu_texture_client_acquire_texture(
+          texture_client, texture->registry_key, &texture->wgpu_texture)) {
+      sources[i] = (wgpu_texture_source_t){0};
+    }
+  }
+}
+
 static void gltf_model_create_empty_texture(gltf_model_t* model)
 {
   gltf_texture_t* empty_texture = calloc(1, sizeof(gltf_texture_t));
@@ -738,9 +1238,57 @@ static void gltf_model_init(gltf_model_t* model,
   model->meshes     = NULL;
   model->mesh_count = 0;
 
+  wgpu_buffer_pool_desc_t uniform_buffer_pool_desc = {
+    .label = "glTF mesh uniform buffer pool",
+    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+  };
+  model->uniform_buffer_pool
+    = wgpu_buffer_pool_create(model->wgpu_context, &uniform_buffer_pool_desc);
+
   model->animations      = NULL;
   model->animation_count = 0;
 
+  model->compute_skinning.enabled
+    = options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_ComputeSkinning;
+  model->compact_vertices
+    = options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_CompactVertices;
+  model->position_stream
+    = (options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_PositionStream)
+      && !model->compute_skinning.enabled;
+  if (model->compact_vertices && model->compute_skinning.enabled) {
+    log_warn("Compact vertices are not supported with compute skinning\n");
+    model->compact_vertices = false;
+  }
+  if (!model->position_stream
+      && (options->file_loading_flags
+          & WGPU_GLTF_FileLoadingFlags_PositionStream)) {
+    log_warn("Position streams are not supported with compute skinning\n");
+  }
+  model->gpu_culling.enabled
+    = options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_GpuCulling;
+  model->culling.pre_transformed
+    = options->file_loading_flags
+      & WGPU_GLTF_FileLoadingFlags_PreTransformVertices;
+  model->culling.flip_y
+    = options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_FlipY;
+  model->texture_packing.enabled
+    = options->file_loading_flags
+      & WGPU_GLTF_FileLoadingFlags_PackMaterialTextures;
+  model->compress_textures
+    = options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_CompressTextures;
+  if (model->compress_textures && model->texture_packing.enabled) {
+    log_warn("Packed material textures are not compressed\n");
+    model->compress_textures = false;
+  }
+  /* Packed textures are copied into the texture arrays of the model */
+  model->share_textures = !model->texture_packing.enabled;
+  model->triangles.enabled
+    = options->file_loading_flags & WGPU_GLTF_FileLoadingFlags_KeepTriangles;
+  model->mesh_buffer = options->mesh_buffer;
+  if (model->mesh_buffer != NULL && model->compute_skinning.enabled) {
+    log_warn("Vertex pulling draws compute skinned models in bind pose\n");
+  }
+
   glm_vec3_copy((vec3){FLT_MAX, FLT_MAX, FLT_MAX}, model->dimensions.min);
   glm_vec3_copy((vec3){-FLT_MAX, -FLT_MAX, -FLT_MAX}, model->dimensions.max);
 }
@@ -754,14 +1302,71 @@ void wgpu_gltf_model_destroy(gltf_model_t* model)
     return;
   }
 
+  wgpu_render_bundle_cache_invalidate(model->wgpu_context, model);
+  if (model->pending_upload_count > 0) {
+    wgpu_upload_scheduler_cancel(wgpu_get_upload_scheduler(model->wgpu_context),
+                                 model);
+  }
+
   WGPU_RELEASE_RESOURCE(Buffer, model->vertices.buffer);
   WGPU_RELEASE_RESOURCE(Buffer, model->indices.buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->positions.buffer);
+
+  WGPU_RELEASE_RESOURCE(Buffer, model->compute_skinning.joint_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->compute_skinning.job_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->compute_skinning.skinned_vertex_buffer);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, model->compute_skinning.pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroup, model->compute_skinning.bind_group);
+  free(model->compute_skinning.joint_matrices);
+
+  WGPU_RELEASE_RESOURCE(Buffer, model->morph_targets.delta_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->morph_targets.job_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->morph_targets.target_buffer);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, model->morph_targets.pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroup, model->morph_targets.bind_group);
+  free(model->morph_targets.weights);
+  free(model->morph_targets.deltas);
+  free(model->morph_targets.primitives);
+  free(model->morph_targets.jobs);
+  free(model->morph_targets.targets);
+
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_animation.keyframe_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_animation.table_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_animation.node_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_animation.joint_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_animation.matrix_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_animation.params_buffer);
+  WGPU_RELEASE_RESOURCE(BindGroup, model->gpu_animation.bind_group);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        model->gpu_animation.bind_group_layout);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, model->gpu_animation.sample_pipeline);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, model->gpu_animation.world_pipeline);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, model->gpu_animation.joint_pipeline);
+
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_culling.item_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_culling.matrix_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_culling.params_buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, model->gpu_culling.args_buffer);
+  WGPU_RELEASE_RESOURCE(TextureView, model->gpu_culling.dummy_view);
+  WGPU_RELEASE_RESOURCE(Texture, model->gpu_culling.dummy_texture);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, model->gpu_culling.bind_group_layout);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, model->gpu_culling.pipeline);
+  free(model->gpu_culling.items);
+  free(model->gpu_culling.node_matrices);
+
+  free(model->draw_list.items);
+  free(model->culling.nodes);
+
+  free(model->triangles.positions);
+  free(model->triangles.indices);
+  free(model->triangles.materials);
 
   if (model->skin_count > 0) {
     for (uint32_t i = 0; i < model->skin_count; ++i) {
       if (model->skins[i].joint_count > 0) {
         free(model->skins[i].joints);
       }
+      free(model->skins[i].inverse_bind_matrices);
     }
     free(model->skins);
   }
@@ -779,12 +1384,14 @@ void wgpu_gltf_model_destroy(gltf_model_t* model)
     gltf_mesh_destroy(&model->meshes[i]);
   }
   free(model->meshes);
+  wgpu_buffer_pool_destroy(model->uniform_buffer_pool);
 
   for (uint32_t i = 0; i < model->node_count; ++i) {
     gltf_node_destroy(&model->nodes[i]);
   }
   free(model->nodes);
   free(model->linear_nodes);
+  transform_batch_release(&model->transforms);
 
   gltf_texture_destroy(model->empty_texture);
   free(model->empty_texture);
@@ -794,39 +1401,241 @@ void wgpu_gltf_model_destroy(gltf_model_t* model)
   }
   free(model->materials);
 
+  for (uint32_t i = 0; i < model->texture_packing.array_count; ++i) {
+    WGPU_RELEASE_RESOURCE(TextureView, model->texture_packing.arrays[i].view)
+    WGPU_RELEASE_RESOURCE(Texture, model->texture_packing.arrays[i].texture)
+  }
+  free(model->texture_packing.arrays);
+  WGPU_RELEASE_RESOURCE(Buffer, model->material_table.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, model->material_table.index_buffer)
+  WGPU_RELEASE_RESOURCE(BindGroup, model->material_table.bind_group)
+
   free(model);
 }
 
-static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
-                                 cgltf_node* node, cgltf_data* data,
-                                 gltf_vertex_t** vertices,
-                                 uint32_t* vertex_count, uint32_t** indices,
-                                 uint32_t* index_count, float global_scale)
+/*
+ * Vertex and index conversion of a primitive, recorded while the nodes are
+ * loaded and run on the job system afterwards
+ */
+typedef struct gltf_primitive_build_t {
+  const float* buffer_pos;
+  const float* buffer_normals;
+  const float* buffer_texcoords;
+  const float* buffer_colors;
+  const float* buffer_tangents;
+  uint32_t num_color_components;
+  const uint16_t* buffer_joints;
+  const float* buffer_weights;
+  const cgltf_accessor* index_accessor;
+  uint32_t first_vertex;
+  uint32_t vertex_count;
+  uint32_t first_index;
+  uint32_t index_count;
+} gltf_primitive_build_t;
+
+/*
+ * Vertex and index arrays of a model, sized by counting the accessors of the
+ * scene before the nodes are loaded so that they are allocated once
+ */
+typedef struct gltf_geometry_build_t {
+  gltf_vertex_t* vertices;
+  uint32_t vertex_count;
+  uint32_t vertex_capacity;
+  uint32_t* indices;
+  uint32_t index_count;
+  uint32_t index_capacity;
+  gltf_primitive_build_t* primitives;
+  uint32_t primitive_count;
+  uint32_t primitive_capacity;
+} gltf_geometry_build_t;
+
+/*
+ * Primitives are loaded with indices and positions in buffer views, Draco
+ * compressed primitives without uncompressed fallback are skipped
+ */
+static bool gltf_primitive_has_geometry(const cgltf_primitive* primitive)
 {
-  gltf_node_t* new_node = &model->nodes[node - data->nodes];
-  gltf_node_init(new_node);
-  new_node->index = (int32_t)(node - data->nodes);
-  if (node->name) {
-    snprintf(new_node->name, strlen(node->name) + 1, "%s", node->name);
+  if (primitive->indices == NULL || primitive->indices->buffer_view == NULL) {
+    return false;
   }
-  new_node->skin_index  = (int32_t)(node->skin - data->skins);
-  new_node->children    = calloc(node->children_count, sizeof(gltf_node_t*));
-  new_node->child_count = node->children_count;
+  for (cgltf_size i = 0; i < primitive->attributes_count; ++i) {
+    const cgltf_attribute* attribute = &primitive->attributes[i];
+    if (attribute->type == cgltf_attribute_type_position) {
+      return attribute->data->buffer_view != NULL;
+    }
+  }
+  return false;
+}
 
-  // Generate local node matrix
-  // It's either made up from translation, rotation, scale or a 4x4 matrix
-  if (node->has_translation) {
-    glm_vec3_copy(node->translation, new_node->translation);
+/* Counts the vertices, indices and primitives of a node and its children */
+static void gltf_geometry_build_count(gltf_geometry_build_t* build,
+                                      const cgltf_node* node)
+{
+  for (cgltf_size i = 0; i < node->children_count; ++i) {
+    gltf_geometry_build_count(build, node->children[i]);
   }
-  if (node->has_rotation) {
-    versor q = GLM_VEC4_ONE_INIT;
-    memcpy(q, node->rotation, sizeof(node->rotation));
-    glm_quat_copy(q, new_node->rotation);
+  if (node->mesh == NULL) {
+    return;
   }
-  if (node->has_scale) {
-    glm_vec3_copy(node->scale, new_node->scale);
+  for (cgltf_size i = 0; i < node->mesh->primitives_count; ++i) {
+    const cgltf_primitive* primitive = &node->mesh->primitives[i];
+    if (!gltf_primitive_has_geometry(primitive)) {
+      continue;
+    }
+    for (cgltf_size j = 0; j < primitive->attributes_count; ++j) {
+      const cgltf_attribute* attribute = &primitive->attributes[j];
+      if (attribute->type == cgltf_attribute_type_position) {
+        build->vertex_capacity += (uint32_t)attribute->data->count;
+      }
+    }
+    build->index_capacity += (uint32_t)primitive->indices->count;
+    ++build->primitive_capacity;
   }
-  if (node->has_matrix) {
+}
+
+static void gltf_geometry_build_alloc(gltf_geometry_build_t* build)
+{
+  build->vertices
+    = build->vertex_capacity > 0 ?
+        malloc(build->vertex_capacity * sizeof(*build->vertices)) :
+        NULL;
+  build->indices = build->index_capacity > 0 ?
+                     malloc(build->index_capacity * sizeof(*build->indices)) :
+                     NULL;
+  build->primitives
+    = build->primitive_capacity > 0 ?
+        malloc(build->primitive_capacity * sizeof(*build->primitives)) :
+        NULL;
+}
+
+static void gltf_primitive_build(const gltf_primitive_build_t* job,
+                                 gltf_vertex_t* vertices, uint32_t* indices)
+{
+  // Append data to model's vertex buffer
+  const bool has_skin
+    = (job->buffer_joints != NULL && job->buffer_weights != NULL);
+  for (uint32_t v = 0; v < job->vertex_count; ++v) {
+    gltf_vertex_t vert = {0};
+    memcpy(&vert.pos, &job->buffer_pos[v * 3], sizeof(vec3));
+    if (job->buffer_normals != NULL) {
+      memcpy(&vert.normal, &job->buffer_normals[v * 3], sizeof(vec3));
+    }
+    if (job->buffer_texcoords != NULL) {
+      memcpy(&vert.uv, &job->buffer_texcoords[v * 2], sizeof(vec2));
+    }
+    if (job->buffer_colors) {
+      switch (job->num_color_components) {
+        case 3: {
+          glm_vec4_one(vert.color);
+          vec3 tmp_vec3 = GLM_VEC3_ZERO_INIT;
+          memcpy(&tmp_vec3, &job->buffer_colors[v * 3], sizeof(vec3));
+          glm_vec4_copy3(tmp_vec3, vert.color);
+        } break;
+        case 4:
+          memcpy(&vert.color, &job->buffer_colors[v * 4], sizeof(vec4));
+          break;
+      }
+    }
+    else {
+      glm_vec4_one(vert.color);
+    }
+    if (job->buffer_tangents) {
+      memcpy(&vert.tangent, &job->buffer_tangents[v * 4], sizeof(vec4));
+    }
+    if (has_skin) {
+      uint16_t tmp_joint[4] = {0};
+      memcpy(&tmp_joint, &job->buffer_joints[v * 4], sizeof(tmp_joint));
+      glm_vec4_copy(
+        (vec4){tmp_joint[0], tmp_joint[1], tmp_joint[2], tmp_joint[3]},
+        vert.joint0);
+      memcpy(&vert.weight0, &job->buffer_weights[v * 4], sizeof(vec4));
+    }
+    vertices[job->first_vertex + v] = vert;
+  }
+
+  // glTF supports different component types of indices
+  const cgltf_accessor* accessor = job->index_accessor;
+  const unsigned char* src       = gltf_accessor_data(accessor);
+  uint32_t* dst                  = &indices[job->first_index];
+  switch (accessor->component_type) {
+    case cgltf_component_type_r_32u: {
+      for (uint32_t index = 0; index < job->index_count; ++index) {
+        uint32_t value = 0;
+        memcpy(&value, &src[index * sizeof(value)], sizeof(value));
+        dst[index] = value + job->first_vertex;
+      }
+      break;
+    }
+    case cgltf_component_type_r_16u: {
+      for (uint32_t index = 0; index < job->index_count; ++index) {
+        uint16_t value = 0;
+        memcpy(&value, &src[index * sizeof(value)], sizeof(value));
+        dst[index] = value + job->first_vertex;
+      }
+      break;
+    }
+    case cgltf_component_type_r_8u: {
+      for (uint32_t index = 0; index < job->index_count; ++index) {
+        dst[index] = src[index] + job->first_vertex;
+      }
+      break;
+    }
+    default: {
+      assert(false);
+    }
+  }
+}
+
+static void gltf_primitive_build_range(void* user_data, uint32_t begin,
+                                       uint32_t end)
+{
+  gltf_geometry_build_t* build = (gltf_geometry_build_t*)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    gltf_primitive_build(&build->primitives[i], build->vertices,
+                         build->indices);
+  }
+}
+
+/* Converts the vertices and indices of all recorded primitives */
+static void gltf_geometry_build_run(gltf_geometry_build_t* build)
+{
+  job_system_parallel_for(job_system_get_shared(), build->primitive_count, 1,
+                          gltf_primitive_build_range, build);
+}
+
+static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
+                                 cgltf_node* node, cgltf_data* data,
+                                 gltf_geometry_build_t* build,
+                                 float global_scale)
+{
+  gltf_node_t* new_node = &model->nodes[node - data->nodes];
+  gltf_node_init(new_node);
+  // Parents are added before their children, so the linear node list is in
+  // topological order
+  model->linear_nodes[model->linear_node_count++] = new_node;
+  new_node->index = (int32_t)(node - data->nodes);
+  if (node->name) {
+    snprintf(new_node->name, strlen(node->name) + 1, "%s", node->name);
+  }
+  new_node->skin_index
+    = node->skin ? (int32_t)(node->skin - data->skins) : -1;
+  new_node->children    = calloc(node->children_count, sizeof(gltf_node_t*));
+  new_node->child_count = node->children_count;
+
+  // Generate local node matrix
+  // It's either made up from translation, rotation, scale or a 4x4 matrix
+  if (node->has_translation) {
+    glm_vec3_copy(node->translation, new_node->translation);
+  }
+  if (node->has_rotation) {
+    versor q = GLM_VEC4_ONE_INIT;
+    memcpy(q, node->rotation, sizeof(node->rotation));
+    glm_quat_copy(q, new_node->rotation);
+  }
+  if (node->has_scale) {
+    glm_vec3_copy(node->scale, new_node->scale);
+  }
+  if (node->has_matrix) {
     memcpy(new_node->matrix, node->matrix, sizeof(node->matrix));
     if (global_scale != 1.0f) {
       // Not support yet
@@ -836,8 +1645,8 @@ static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
   // Node with children
   if (node->children_count > 0) {
     for (cgltf_size i = 0, len = node->children_count; i < len; ++i) {
-      gltf_model_load_node(model, node, node->children[i], data, vertices,
-                           vertex_count, indices, index_count, global_scale);
+      gltf_model_load_node(model, node, node->children[i], data, build,
+                           global_scale);
     }
   }
 
@@ -846,7 +1655,8 @@ static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
   if (node->mesh != NULL) {
     cgltf_mesh* mesh      = node->mesh;
     gltf_mesh_t* new_mesh = &model->meshes[node->mesh - data->meshes];
-    gltf_mesh_init(new_mesh, model->wgpu_context, new_node->matrix);
+    gltf_mesh_init(new_mesh, model->wgpu_context, model->uniform_buffer_pool,
+                   new_node->matrix);
     if (mesh->name) {
       snprintf(new_mesh->name, strlen(mesh->name) + 1, "%s", mesh->name);
     }
@@ -860,16 +1670,15 @@ static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
     // Iterate through all primitives of this node's mesh
     for (uint32_t i = 0; i < mesh->primitives_count; ++i) {
       cgltf_primitive* primitive = &mesh->primitives[i];
-      if (primitive->indices == NULL) {
+      if (!gltf_primitive_has_geometry(primitive)) {
         continue;
       }
-      uint32_t index_start       = *index_count;
-      uint32_t vertex_start      = *vertex_count;
+      uint32_t index_start       = build->index_count;
+      uint32_t vertex_start      = build->vertex_count;
       uint32_t prim_index_count  = 0;
       uint32_t prim_vertex_count = 0;
       vec3 pos_min               = GLM_VEC3_ZERO_INIT;
       vec3 pos_max               = GLM_VEC3_ZERO_INIT;
-      bool has_skin              = false;
 
       // Vertices
       {
@@ -887,11 +1696,8 @@ static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
         for (uint32_t j = 0; j < primitive->attributes_count; ++j) {
           // Get buffer data for vertex normals
           if (primitive->attributes[j].type == cgltf_attribute_type_position) {
-            pos_accessor                = primitive->attributes[j].data;
-            cgltf_buffer_view* pos_view = pos_accessor->buffer_view;
-            buffer_pos
-              = (float*)&((unsigned char*)pos_view->buffer
-                            ->data)[pos_accessor->offset + pos_view->offset];
+            pos_accessor = primitive->attributes[j].data;
+            buffer_pos   = (float*)gltf_accessor_data(pos_accessor);
             if (pos_accessor->has_min) {
               glm_vec3_copy(
                 (vec3){
@@ -914,172 +1720,76 @@ static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
           // Get buffer data for vertex normals
           if (primitive->attributes[j].type == cgltf_attribute_type_normal) {
             cgltf_accessor* normal_accessor = primitive->attributes[j].data;
-            cgltf_buffer_view* normal_view  = normal_accessor->buffer_view;
-            buffer_normals                  = (float*)&(
-              (unsigned char*)normal_view->buffer
-                ->data)[normal_accessor->offset + normal_view->offset];
+            buffer_normals = (float*)gltf_accessor_data(normal_accessor);
           }
           // Get buffer data for vertex texture coordinates
           if (primitive->attributes[j].type == cgltf_attribute_type_texcoord) {
             cgltf_accessor* texcoord_accessor = primitive->attributes[j].data;
-            cgltf_buffer_view* texcoord_view  = texcoord_accessor->buffer_view;
-            buffer_texcoords                  = (float*)&(
-              ((unsigned char*)texcoord_view->buffer
-                 ->data)[texcoord_accessor->offset + texcoord_view->offset]);
+            buffer_texcoords = (float*)gltf_accessor_data(texcoord_accessor);
           }
           // Get buffer data for vertex colors
           if (primitive->attributes[j].type == cgltf_attribute_type_color) {
             cgltf_accessor* color_accessor = primitive->attributes[j].data;
-            cgltf_buffer_view* color_view  = color_accessor->buffer_view;
             // Color buffer are either of type vec3 or vec4
             num_color_components
               = color_accessor->type == cgltf_type_vec3 ? 3 : 4;
-            buffer_colors = (float*)&(
-              ((unsigned char*)color_view->buffer
-                 ->data)[color_accessor->offset + color_view->offset]);
+            buffer_colors = (float*)gltf_accessor_data(color_accessor);
           }
           // Get buffer data for vertex tangents
           if (primitive->attributes[j].type == cgltf_attribute_type_tangent) {
             cgltf_accessor* tangent_accessor = primitive->attributes[j].data;
-            cgltf_buffer_view* tangent_view  = tangent_accessor->buffer_view;
-            buffer_tangents                  = (float*)&(
-              ((unsigned char*)tangent_view->buffer
-                 ->data)[tangent_accessor->offset + tangent_view->offset]);
+            buffer_tangents = (float*)gltf_accessor_data(tangent_accessor);
           }
 
           // Skinning
           // Get vertex joint indices
           if (primitive->attributes[j].type == cgltf_attribute_type_joints) {
             cgltf_accessor* joint_accessor = primitive->attributes[j].data;
-            cgltf_buffer_view* joint_view  = joint_accessor->buffer_view;
-            buffer_joints                  = (uint16_t*)&(
-              ((unsigned char*)joint_view->buffer
-                 ->data)[joint_accessor->offset + joint_view->offset]);
+            buffer_joints = (uint16_t*)gltf_accessor_data(joint_accessor);
           }
           // Get vertex joint weights
           if (primitive->attributes[j].type == cgltf_attribute_type_weights) {
             cgltf_accessor* weight_accessor = primitive->attributes[j].data;
-            cgltf_buffer_view* weight_view  = weight_accessor->buffer_view;
-            buffer_weights                  = (float*)&(
-              ((unsigned char*)weight_view->buffer
-                 ->data)[weight_accessor->offset + weight_view->offset]);
+            buffer_weights = (float*)gltf_accessor_data(weight_accessor);
           }
         }
 
-        has_skin = (buffer_joints != NULL && buffer_weights != NULL);
-
         // Position attribute is required
         ASSERT(pos_accessor != NULL);
 
         prim_vertex_count = (uint32_t)pos_accessor->count;
 
-        *vertex_count += prim_vertex_count;
-        *vertices = realloc(*vertices, (*vertex_count) * sizeof(gltf_vertex_t));
-
-        // Append data to model's vertex buffer
-        for (uint32_t v = 0; v < pos_accessor->count; ++v) {
-          gltf_vertex_t vert = {0};
-          memcpy(&vert.pos, &buffer_pos[v * 3], sizeof(vec3));
-          if (buffer_normals != NULL) {
-            memcpy(&vert.normal, &buffer_normals[v * 3], sizeof(vec3));
-          }
-          if (buffer_texcoords != NULL) {
-            memcpy(&vert.uv, &buffer_texcoords[v * 2], sizeof(vec2));
-          }
-          if (buffer_colors) {
-            switch (num_color_components) {
-              case 3: {
-                glm_vec4_one(vert.color);
-                vec3 tmp_vec3 = GLM_VEC3_ZERO_INIT;
-                memcpy(&tmp_vec3, &buffer_colors[v * 3], sizeof(vec3));
-                glm_vec4_copy3(tmp_vec3, vert.color);
-              } break;
-              case 4:
-                memcpy(&vert.color, &buffer_colors[v * 4], sizeof(vec4));
-                break;
-            }
-          }
-          else {
-            glm_vec4_one(vert.color);
-          }
-          if (buffer_tangents) {
-            memcpy(&vert.tangent, &buffer_tangents[v * 4], sizeof(vec4));
-          }
-          if (has_skin) {
-            uint16_t tmp_joint[4] = {0};
-            memcpy(&tmp_joint, &buffer_joints[v * 4], sizeof(tmp_joint));
-            glm_vec4_copy(
-              (vec4){tmp_joint[0], tmp_joint[1], tmp_joint[2], tmp_joint[3]},
-              vert.joint0);
-          }
-          if (has_skin) {
-            memcpy(&vert.weight0, &buffer_weights[v * 4], sizeof(vec4));
-          }
-          (*vertices)[(*vertex_count) - pos_accessor->count + v] = vert;
-        }
-      }
-
-      // Indices
-      {
-        cgltf_accessor* accessor       = primitive->indices;
-        cgltf_buffer_view* buffer_view = accessor->buffer_view;
-        cgltf_buffer* buffer           = buffer_view->buffer;
-
-        prim_index_count = (uint32_t)accessor->count;
-
-        *index_count += prim_index_count;
-        *indices = realloc(*indices, (*index_count) * sizeof(**indices));
-
-        // glTF supports different component types of indices
-        switch (accessor->component_type) {
-          case cgltf_component_type_r_32u: {
-            uint32_t* buf = calloc(accessor->count, sizeof(*buf));
-            memcpy(buf,
-                   &((unsigned char*)
-                       buffer->data)[accessor->offset + buffer_view->offset],
-                   accessor->count * sizeof(*buf));
-            for (size_t index = 0; index < accessor->count; index++) {
-              (*indices)[(*index_count) - prim_index_count + index]
-                = buf[index] + vertex_start;
-            }
-            free(buf);
-            break;
-          }
-          case cgltf_component_type_r_16u: {
-            uint16_t* buf = calloc(accessor->count, sizeof(*buf));
-            memcpy(buf,
-                   &((unsigned char*)
-                       buffer->data)[accessor->offset + buffer_view->offset],
-                   accessor->count * sizeof(*buf));
-            for (size_t index = 0; index < accessor->count; index++) {
-              (*indices)[(*index_count) - prim_index_count + index]
-                = buf[index] + vertex_start;
-            }
-            free(buf);
-            break;
-          }
-          case cgltf_component_type_r_8u: {
-            uint8_t* buf = calloc(accessor->count, sizeof(*buf));
-            memcpy(buf,
-                   &((unsigned char*)
-                       buffer->data)[accessor->offset + buffer_view->offset],
-                   accessor->count * sizeof(*buf));
-            for (size_t index = 0; index < accessor->count; index++) {
-              (*indices)[(*index_count) - prim_index_count + index]
-                = buf[index] + vertex_start;
-            }
-            free(buf);
-            break;
-          }
-          default: {
-            assert(false);
-          }
-        }
+        prim_index_count = (uint32_t)primitive->indices->count;
+        ASSERT(build->vertex_count + prim_vertex_count
+                 <= build->vertex_capacity
+               && build->index_count + prim_index_count
+                    <= build->index_capacity
+               && build->primitive_count < build->primitive_capacity);
+        build->vertex_count += prim_vertex_count;
+        build->index_count += prim_index_count;
+
+        build->primitives[build->primitive_count++] = (gltf_primitive_build_t){
+          .buffer_pos           = buffer_pos,
+          .buffer_normals       = buffer_normals,
+          .buffer_texcoords     = buffer_texcoords,
+          .buffer_colors        = buffer_colors,
+          .buffer_tangents      = buffer_tangents,
+          .num_color_components = num_color_components,
+          .buffer_joints        = buffer_joints,
+          .buffer_weights       = buffer_weights,
+          .index_accessor       = primitive->indices,
+          .first_vertex         = vertex_start,
+          .vertex_count         = prim_vertex_count,
+          .first_index          = index_start,
+          .index_count          = prim_index_count,
+        };
       }
       gltf_primitive_t new_primitive = {0};
       gltf_primitive_init(
         &new_primitive, index_start, prim_index_count,
-        &model->materials[primitive->material - data->materials]);
+        primitive->material ?
+          &model->materials[primitive->material - data->materials] :
+          &model->materials[model->material_count - 1]);
       new_primitive.first_vertex = vertex_start;
       new_primitive.vertex_count = prim_vertex_count;
       gltf_primitive_set_bounding_box(&new_primitive, pos_min, pos_max);
@@ -1104,7 +1814,6 @@ static void gltf_model_load_node(gltf_model_t* model, cgltf_node* parent,
     new_node->parent->children[new_node->parent->current_child_index++]
       = new_node;
   }
-  model->linear_nodes[model->linear_node_count++] = new_node;
 }
 
 static void gltf_model_load_skins(gltf_model_t* model, cgltf_data* data)
@@ -1132,7 +1841,7 @@ static void gltf_model_load_skins(gltf_model_t* model, cgltf_data* data)
           NULL;
     for (uint32_t j = 0; j < new_skin->joint_count; ++j) {
       gltf_node_t* node
-        = gltf_model_node_from_index(model, skin->joints[i] - data->nodes);
+        = gltf_model_node_from_index(model, skin->joints[j] - data->nodes);
       if (node != NULL) {
         new_skin->joints[new_skin->current_joint_index++] = node;
       }
@@ -1141,29 +1850,73 @@ static void gltf_model_load_skins(gltf_model_t* model, cgltf_data* data)
     // Get the inverse bind matrices from the buffer associated to this skin
     if (skin->inverse_bind_matrices != NULL) {
       cgltf_accessor* accessor            = skin->inverse_bind_matrices;
-      cgltf_buffer_view* buffer_view      = accessor->buffer_view;
       new_skin->inverse_bind_matrix_count = accessor->count;
+      new_skin->inverse_bind_matrices
+        = malloc(new_skin->inverse_bind_matrix_count
+                 * sizeof(*new_skin->inverse_bind_matrices));
       memcpy(new_skin->inverse_bind_matrices,
-             (mat4*)&((unsigned char*)buffer_view->buffer
-                        ->data)[accessor->offset + buffer_view->offset],
+             (mat4*)gltf_accessor_data(accessor),
              new_skin->inverse_bind_matrix_count
                * sizeof(*new_skin->inverse_bind_matrices));
     }
   }
 }
 
-static void gltf_model_load_images(gltf_model_t* model, cgltf_data* data)
+/*
+ * Starts decoding the images on the job system, the textures are created by
+ * gltf_model_finish_images
+ */
+static wgpu_texture_batch_t* gltf_model_load_images(gltf_model_t* model,
+                                                    cgltf_data* data)
 {
   model->texture_count = (uint32_t)data->images_count;
   model->textures      = model->texture_count > 0 ?
                            calloc(model->texture_count, sizeof(*model->textures)) :
                            NULL;
+  const uint32_t alloc_count     = MAX(model->texture_count, 1u);
+  wgpu_texture_source_t* sources = calloc(alloc_count, sizeof(*sources));
+  char(*image_uris)[STRMAX]      = calloc(alloc_count, sizeof(*image_uris));
+  for (uint32_t i = 0; i < model->texture_count; ++i) {
+    gltf_texture_init(&model->textures[i], model->wgpu_context);
+    sources[i] = gltf_texture_source_from_gltf_image(
+      model->uri, &data->images[i], gltf_model_get_texture_usage(model),
+      image_uris[i]);
+  }
+  gltf_model_set_texture_compression(model, sources, model->texture_count);
+  gltf_model_acquire_shared_textures(model, sources, model->texture_count);
+  wgpu_texture_batch_t* batch = wgpu_texture_batch_begin(
+    model->wgpu_context, model->texture_count, sources);
+  free(sources);
+  free(image_uris);
+  return batch;
+}
+
+/* Uploads the decoded images in order and registers the shared ones */
+static void gltf_model_finish_images(gltf_model_t* model,
+                                     wgpu_texture_batch_t* batch)
+{
+  texture_t* textures
+    = calloc(MAX(model->texture_count, 1u), sizeof(*textures));
+  wgpu_texture_batch_finish(batch, textures);
   for (uint32_t i = 0; i < model->texture_count; ++i) {
-    cgltf_image* image      = &data->images[i];
     gltf_texture_t* texture = &model->textures[i];
-    gltf_texture_init(texture, model->wgpu_context);
-    gltf_texture_from_gltf_image(model->uri, texture, image);
+    if (texture->wgpu_texture.texture != NULL) {
+      /* Acquired from the registry */
+      continue;
+    }
+    texture->wgpu_texture = textures[i];
+    if (texture->registry_key != 0) {
+      if (texture->wgpu_texture.texture != NULL) {
+        wgpu_texture_client_register_texture(
+          model->wgpu_context->texture_client, texture->registry_key,
+          &texture->wgpu_texture);
+      }
+      else {
+        texture->registry_key = 0;
+      }
+    }
   }
+  free(textures);
   // Create an empty texture to be used for empty material images
   gltf_model_create_empty_texture(model);
 }
@@ -1198,6 +1951,7 @@ static void gltf_model_load_materials(gltf_model_t* model, cgltf_data* data)
     cgltf_material* mat       = &data->materials[i];
     gltf_material_t* material = &model->materials[i];
     gltf_material_init(material, model->wgpu_context);
+    material->index = i;
 
     // Metallic roughness workflow
     if (mat->has_pbr_metallic_roughness) {
@@ -1246,6 +2000,234 @@ static void gltf_model_load_materials(gltf_model_t* model, cgltf_data* data)
   // assigned
   gltf_material_init(&model->materials[model->material_count - 1],
                      model->wgpu_context);
+  model->materials[model->material_count - 1].index = model->material_count - 1;
+}
+
+/*
+ * Material texture packing: the textures of the same format, size and mip
+ * count are copied into the layers of 2D array textures, their own textures
+ * are released afterwards and their views replaced by 2D views of their layers
+ */
+#define GLTF_MAX_TEXTURE_ARRAY_LAYERS 256u
+
+static uint32_t gltf_texture_get_layer(const gltf_texture_t* texture)
+{
+  return (texture != NULL && texture->array != NULL) ?
+           texture->layer :
+           WGPU_GLTF_NO_TEXTURE_LAYER;
+}
+
+static void gltf_model_pack_material_textures(gltf_model_t* model)
+{
+  if (!model->texture_packing.enabled || model->texture_count == 0) {
+    return;
+  }
+
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+
+  // Assign the textures to the arrays of their format, size and mip count, an
+  // array is never reallocated so that the textures can point to it
+  wgpu_gltf_texture_array_t* arrays
+    = calloc(model->texture_count, sizeof(*arrays));
+  uint32_t array_count = 0;
+  for (uint32_t i = 0; i < model->texture_count; ++i) {
+    gltf_texture_t* texture = &model->textures[i];
+    const texture_t* source = &texture->wgpu_texture;
+    if (source->texture == NULL || source->size.depth != 1) {
+      continue;
+    }
+    wgpu_gltf_texture_array_t* array = NULL;
+    for (uint32_t a = 0; a < array_count && array == NULL; ++a) {
+      if (arrays[a].format == source->format
+          && arrays[a].width == source->size.width
+          && arrays[a].height == source->size.height
+          && arrays[a].mip_level_count == source->mip_level_count
+          && arrays[a].layer_count < GLTF_MAX_TEXTURE_ARRAY_LAYERS) {
+        array = &arrays[a];
+      }
+    }
+    if (array == NULL) {
+      array  = &arrays[array_count++];
+      *array = (wgpu_gltf_texture_array_t){
+        .format          = source->format,
+        .width           = source->size.width,
+        .height          = source->size.height,
+        .mip_level_count = source->mip_level_count,
+      };
+    }
+    texture->array = array;
+    texture->layer = array->layer_count++;
+  }
+  if (array_count == 0) {
+    free(arrays);
+    return;
+  }
+  model->texture_packing.arrays      = arrays;
+  model->texture_packing.array_count = array_count;
+
+  for (uint32_t a = 0; a < array_count; ++a) {
+    wgpu_gltf_texture_array_t* array   = &arrays[a];
+    WGPUTextureDescriptor texture_desc = {
+      .label         = "glTF material texture array",
+      .usage         = WGPUTextureUsage_CopyDst
+                       | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){
+        .width              = array->width,
+        .height             = array->height,
+        .depthOrArrayLayers = array->layer_count,
+      },
+      .format        = array->format,
+      .mipLevelCount = array->mip_level_count,
+      .sampleCount   = 1,
+    };
+    array->texture
+      = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+    array->view = wgpuTextureCreateView(
+      array->texture, &(WGPUTextureViewDescriptor){
+                        .format          = array->format,
+                        .dimension       = WGPUTextureViewDimension_2DArray,
+                        .baseMipLevel    = 0,
+                        .mipLevelCount   = array->mip_level_count,
+                        .baseArrayLayer  = 0,
+                        .arrayLayerCount = array->layer_count,
+                      });
+  }
+
+  // Copy all levels of the packed textures into their layers
+  WGPUCommandEncoder cmd_encoder
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  for (uint32_t i = 0; i < model->texture_count; ++i) {
+    gltf_texture_t* texture = &model->textures[i];
+    if (texture->array == NULL) {
+      continue;
+    }
+    for (uint32_t level = 0; level < texture->array->mip_level_count;
+         ++level) {
+      wgpuCommandEncoderCopyTextureToTexture(
+        cmd_encoder,
+        &(WGPUImageCopyTexture){
+          .texture  = texture->wgpu_texture.texture,
+          .mipLevel = level,
+        },
+        &(WGPUImageCopyTexture){
+          .texture  = texture->array->texture,
+          .mipLevel = level,
+          .origin   = (WGPUOrigin3D){.z = texture->layer},
+        },
+        &(WGPUExtent3D){
+          .width              = MAX(1u, texture->array->width >> level),
+          .height             = MAX(1u, texture->array->height >> level),
+          .depthOrArrayLayers = 1,
+        });
+    }
+  }
+  WGPUCommandBuffer command_buffer
+    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  // The samplers of the packed textures stay valid, their views are views of
+  // their layers so that the bind groups of the per-texture views keep working
+  for (uint32_t i = 0; i < model->texture_count; ++i) {
+    gltf_texture_t* texture = &model->textures[i];
+    if (texture->array != NULL) {
+      WGPU_RELEASE_RESOURCE(TextureView, texture->wgpu_texture.view)
+      WGPU_RELEASE_RESOURCE(Texture, texture->wgpu_texture.texture)
+      texture->wgpu_texture.view = wgpuTextureCreateView(
+        texture->array->texture,
+        &(WGPUTextureViewDescriptor){
+          .format          = texture->array->format,
+          .dimension       = WGPUTextureViewDimension_2D,
+          .baseMipLevel    = 0,
+          .mipLevelCount   = texture->array->mip_level_count,
+          .baseArrayLayer  = texture->layer,
+          .arrayLayerCount = 1,
+        });
+      ASSERT(texture->wgpu_texture.view != NULL);
+    }
+  }
+}
+
+/*
+ * Material table: one wgpu_gltf_material_data_t per material in a storage
+ * buffer, and the material indices in a uniform buffer, one per dynamic offset
+ */
+#define GLTF_MATERIAL_INDEX_STRIDE 256u /* minUniformBufferOffsetAlignment */
+#define GLTF_MATERIAL_INDEX_SIZE 16u
+
+static void gltf_model_write_material_buffer(gltf_model_t* model)
+{
+  if (model->material_table.buffer == NULL) {
+    return;
+  }
+
+  wgpu_gltf_material_data_t* material_data
+    = calloc(model->material_count, sizeof(*material_data));
+  for (uint32_t i = 0; i < model->material_count; ++i) {
+    const gltf_material_t* material = &model->materials[i];
+    wgpu_gltf_material_data_t* data = &material_data[material->index];
+    *data                           = (wgpu_gltf_material_data_t){
+      .metallic_factor  = material->metallic_factor,
+      .roughness_factor = material->roughness_factor,
+      .alpha_cutoff     = material->alpha_cutoff,
+      .alpha_mode       = (uint32_t)material->alpha_mode,
+      .base_color_layer = gltf_texture_get_layer(material->base_color_texture),
+      .metallic_roughness_layer
+      = gltf_texture_get_layer(material->metallic_roughness_texture),
+      .normal_layer    = gltf_texture_get_layer(material->normal_texture),
+      .occlusion_layer = gltf_texture_get_layer(material->occlusion_texture),
+      .emissive_layer  = gltf_texture_get_layer(material->emissive_texture),
+    };
+    glm_vec4_copy((float*)material->base_color_factor, data->base_color_factor);
+    glm_vec4_copy((float*)material->emissive_factor, data->emissive_factor);
+  }
+  wgpuQueueWriteBuffer(model->wgpu_context->queue, model->material_table.buffer,
+                       0, material_data,
+                       model->material_count * sizeof(*material_data));
+  free(material_data);
+}
+
+static void gltf_model_create_material_table(gltf_model_t* model)
+{
+  if (model->material_count == 0) {
+    return;
+  }
+
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+
+  model->material_table.buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF material buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+          .size  = model->material_count * sizeof(wgpu_gltf_material_data_t),
+        })
+        .buffer;
+  gltf_model_write_material_buffer(model);
+
+  const uint32_t index_buffer_size
+    = model->material_count * GLTF_MATERIAL_INDEX_STRIDE;
+  uint8_t* indices = calloc(index_buffer_size, 1);
+  for (uint32_t i = 0; i < model->material_count; ++i) {
+    memcpy(indices + i * GLTF_MATERIAL_INDEX_STRIDE, &i, sizeof(i));
+  }
+  model->material_table.index_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label   = "glTF material index buffer",
+          .usage   = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+          .size    = index_buffer_size,
+          .initial = {
+            .data = indices,
+            .size = index_buffer_size,
+          },
+        })
+        .buffer;
+  free(indices);
 }
 
 /*
@@ -1288,8 +2270,6 @@ static void gltf_model_load_animations(gltf_model_t* model, cgltf_data* data)
       // Read sampler input time values
       {
         cgltf_accessor* accessor       = samp->input;
-        cgltf_buffer_view* buffer_view = accessor->buffer_view;
-        cgltf_buffer* buffer           = buffer_view->buffer;
 
         ASSERT(accessor->component_type == cgltf_component_type_r_32f);
 
@@ -1301,8 +2281,7 @@ static void gltf_model_load_animations(gltf_model_t* model, cgltf_data* data)
 
         float* buf = calloc(accessor->count, sizeof(float));
         memcpy(buf,
-               (float*)&(((unsigned char*)buffer
-                            ->data)[accessor->offset + buffer_view->offset]),
+               (float*)gltf_accessor_data(accessor),
                accessor->count * sizeof(*buf));
         for (size_t index = 0; index < accessor->count; index++) {
           sampler->inputs[index] = buf[index];
@@ -1324,8 +2303,6 @@ static void gltf_model_load_animations(gltf_model_t* model, cgltf_data* data)
       // Read sampler keyframe output translate/rotate/scale values
       {
         cgltf_accessor* accessor       = samp->output;
-        cgltf_buffer_view* buffer_view = accessor->buffer_view;
-        cgltf_buffer* buffer           = buffer_view->buffer;
 
         ASSERT(accessor->component_type == cgltf_component_type_r_32f);
 
@@ -1337,13 +2314,12 @@ static void gltf_model_load_animations(gltf_model_t* model, cgltf_data* data)
 
             vec3* buf = calloc(accessor->count, sizeof(vec3));
             memcpy(buf,
-                   (vec3*)&(((unsigned char*)buffer
-                               ->data)[accessor->offset + buffer_view->offset]),
+                   (vec3*)gltf_accessor_data(accessor),
                    accessor->count * sizeof(*buf));
 
             for (size_t index = 0; index < accessor->count; ++index) {
-              glm_vec4_zero(sampler->outputs_vec4[i]);
-              glm_vec4_copy3(buf[index], sampler->outputs_vec4[i]);
+              glm_vec4_zero(sampler->outputs_vec4[index]);
+              glm_vec4_copy3(buf[index], sampler->outputs_vec4[index]);
             }
 
             free(buf);
@@ -1355,12 +2331,11 @@ static void gltf_model_load_animations(gltf_model_t* model, cgltf_data* data)
 
             vec4* buf = calloc(accessor->count, sizeof(vec4));
             memcpy(buf,
-                   (vec4*)&(((unsigned char*)buffer
-                               ->data)[accessor->offset + buffer_view->offset]),
+                   (vec4*)gltf_accessor_data(accessor),
                    accessor->count * sizeof(*buf));
 
             for (size_t index = 0; index < accessor->count; ++index) {
-              glm_vec4_copy(buf[index], sampler->outputs_vec4[i]);
+              glm_vec4_copy(buf[index], sampler->outputs_vec4[index]);
             }
 
             free(buf);
@@ -1407,252 +2382,4454 @@ static void gltf_model_load_animations(gltf_model_t* model, cgltf_data* data)
   }
 }
 
-gltf_model_t* wgpu_gltf_model_load_from_file(
-  struct wgpu_gltf_model_load_options_t* load_options)
+/* The glTF / GLB file and its external buffers are memory-mapped instead of
+ * being copied to the heap */
+typedef struct gltf_file_mappings_t {
+  file_mapping_t* items;
+  uint32_t count;
+  uint32_t capacity;
+} gltf_file_mappings_t;
+
+static cgltf_result
+gltf_file_map_read(const struct cgltf_memory_options* memory_options,
+                   const struct cgltf_file_options* file_options,
+                   const char* path, cgltf_size* size, void** data)
 {
-  uint32_t file_loading_flags = load_options->file_loading_flags;
+  UNUSED_VAR(memory_options);
 
-  gltf_model_t* gltf_model = NULL;
+  gltf_file_mappings_t* mappings = file_options->user_data;
+  file_mapping_t mapping         = {0};
+  if (!file_map(path, &mapping)) {
+    return cgltf_result_file_not_found;
+  }
+  if (mapping.data == NULL) {
+    return cgltf_result_io_error;
+  }
 
-  cgltf_options options = {0};
-  cgltf_data* gltf_data = NULL;
-  cgltf_result result
-    = cgltf_parse_file(&options, load_options->filename, &gltf_data);
+  if (mappings->count == mappings->capacity) {
+    uint32_t capacity = MAX(mappings->capacity * 2, 4u);
+    file_mapping_t* items
+      = realloc(mappings->items, capacity * sizeof(file_mapping_t));
+    ASSERT(items != NULL);
+    mappings->items    = items;
+    mappings->capacity = capacity;
+  }
+  mappings->items[mappings->count++] = mapping;
 
-  // Vertex buffer & Index buffer
-  gltf_vertex_t* vertices = NULL;
-  uint32_t* indices       = NULL;
+  *size = (cgltf_size)mapping.size;
+  *data = (void*)mapping.data;
+  return cgltf_result_success;
+}
 
-  if (result == cgltf_result_success) {
-    cgltf_result buffers_result
-      = cgltf_load_buffers(&options, gltf_data, load_options->filename);
+static void
+gltf_file_map_release(const struct cgltf_memory_options* memory_options,
+                      const struct cgltf_file_options* file_options,
+                      void* data)
+{
+  UNUSED_VAR(memory_options);
+
+  gltf_file_mappings_t* mappings = file_options->user_data;
+  for (uint32_t i = 0; i < mappings->count; ++i) {
+    if (mappings->items[i].data == data) {
+      file_unmap(&mappings->items[i]);
+      mappings->items[i] = mappings->items[--mappings->count];
+      return;
+    }
+  }
+}
 
-    if (buffers_result == cgltf_result_success) {
-      gltf_model = calloc(1, sizeof(gltf_model_t));
-      gltf_model_init(gltf_model, load_options);
+/*
+ * Compose the local matrices of the dirty nodes from their translation,
+ * rotation and scale. The range of linear nodes spanning all dirty ones is
+ * composed in SIMD batches, recomposing the clean nodes in between is cheaper
+ * than splitting the batches.
+ */
+static void gltf_model_compose_local_matrices(gltf_model_t* model)
+{
+  transform_batch_t* transforms = &model->transforms;
+  uint32_t first = UINT32_MAX, last = 0;
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->dirty) {
+      transform_batch_set(transforms, i, node->translation, node->rotation,
+                          node->scale);
+      first = MIN(first, i);
+      last  = i;
+    }
+  }
+  if (first > last) {
+    return;
+  }
 
-      // Load samplers and images
-      if (!(file_loading_flags & WGPU_GLTF_FileLoadingFlags_DontLoadImages)) {
-        gltf_model_load_texture_samplers(gltf_model, gltf_data);
-        gltf_model_load_images(gltf_model, gltf_data);
-      }
+  transform_batch_compose_local(transforms, first, last - first + 1);
+  for (uint32_t i = first; i <= last; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->has_matrix) {
+      glm_mat4_mul(transforms->local_matrices[i], node->matrix,
+                   transforms->local_matrices[i]);
+    }
+  }
+}
 
-      // Load materials
-      gltf_model_load_materials(gltf_model, gltf_data);
+/*
+ * Shared joint palette
+ */
+struct wgpu_gltf_joint_palette {
+  wgpu_context_t* wgpu_context;
+  gltf_model_t** models;
+  uint32_t model_count;
+  mat4* matrices;
+  uint32_t matrix_count;
+  WGPUBuffer buffer;
+  /* Range of matrices changed since the last upload */
+  uint32_t dirty_begin;
+  uint32_t dirty_end;
+};
+
+static void gltf_joint_palette_flush(wgpu_gltf_joint_palette_t* palette)
+{
+  if (palette->dirty_begin >= palette->dirty_end) {
+    return;
+  }
+  wgpu_queue_write_buffer_batched(
+    palette->wgpu_context, palette->buffer, palette->dirty_begin * sizeof(mat4),
+    &palette->matrices[palette->dirty_begin],
+    (palette->dirty_end - palette->dirty_begin) * sizeof(mat4));
+  palette->dirty_begin = UINT32_MAX;
+  palette->dirty_end   = 0;
+}
 
-      // If there is no default scene specified, then the default is the first
-      // one. It is not an error for a glTF file to have zero scenes.
-      const cgltf_scene* scene
-        = gltf_data->scene ? gltf_data->scene : gltf_data->scenes;
-      if (!scene) {
-        return NULL;
+/*
+ * Update the world matrices of the dirty nodes and their descendants in a
+ * single pass over the topologically ordered linear node list, then the
+ * uniform blocks and joint matrices of the affected meshes. Joint matrices of
+ * a model attached to a joint palette are copied to their range of it. Only
+ * touches the model and its palette range, see gltf_model_upload_nodes.
+ */
+static void gltf_model_evaluate_nodes(gltf_model_t* model)
+{
+  gltf_model_compose_local_matrices(model);
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node   = model->linear_nodes[i];
+    gltf_node_t* parent = node->parent;
+    node->world_changed = node->dirty || (parent && parent->world_changed);
+    if (node->world_changed) {
+      glm_mat4_copy(model->transforms.local_matrices[i], node->world_matrix);
+      if (parent != NULL) {
+        glm_mat4_mul(parent->world_matrix, node->world_matrix,
+                     node->world_matrix);
       }
+      node->dirty                       = false;
+      model->gpu_culling.matrices_dirty = true;
+    }
+  }
 
-      // Vertex buffer & Index buffer
-      gltf_model->vertices.count = 0;
-      gltf_model->indices.count  = 0;
-
-      // Nodes and meshes
-      gltf_model->node_count = (uint32_t)gltf_data->nodes_count;
-      gltf_model->nodes = calloc(gltf_model->node_count, sizeof(gltf_node_t));
+  bool joint_matrices_changed = false;
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->mesh != NULL) {
+      joint_matrices_changed |= gltf_node_evaluate_mesh(
+        node, model->compute_skinning.joint_matrices);
+    }
+  }
 
-      gltf_model->linear_nodes
-        = calloc(gltf_model->node_count, sizeof(gltf_node_t*));
+  if (joint_matrices_changed) {
+    model->compute_skinning.joint_matrices_dirty = true;
+    wgpu_gltf_joint_palette_t* palette = model->compute_skinning.palette;
+    if (palette != NULL) {
+      memcpy(&palette->matrices[model->compute_skinning.palette_offset],
+             model->compute_skinning.joint_matrices,
+             model->compute_skinning.joint_matrix_count * sizeof(mat4));
+    }
+  }
+}
 
-      gltf_model->mesh_count = (uint32_t)gltf_data->meshes_count;
+/*
+ * Queue the writes of the uniform blocks and joint matrices updated by
+ * gltf_model_evaluate_nodes, to be called from the main thread. The joint
+ * matrices of a model attached to a joint palette only extend the range of it
+ * to upload.
+ */
+static void gltf_model_upload_nodes(gltf_model_t* model)
+{
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_mesh_t* mesh = model->linear_nodes[i]->mesh;
+    if (mesh != NULL && mesh->upload_size > 0) {
+      wgpu_queue_write_buffer_batched(
+        model->wgpu_context, mesh->uniform_buffer.buffer,
+        mesh->uniform_buffer.offset, &mesh->uniform_block, mesh->upload_size);
+      mesh->upload_size = 0;
+    }
+  }
+
+  // Upload the joint matrices of all skinned nodes at once
+  if (!model->compute_skinning.joint_matrices_dirty) {
+    return;
+  }
+  wgpu_gltf_joint_palette_t* palette = model->compute_skinning.palette;
+  if (palette != NULL) {
+    const uint32_t begin = model->compute_skinning.palette_offset;
+    const uint32_t end   = begin + model->compute_skinning.joint_matrix_count;
+    palette->dirty_begin = MIN(palette->dirty_begin, begin);
+    palette->dirty_end   = MAX(palette->dirty_end, end);
+    model->compute_skinning.joint_matrices_dirty = false;
+  }
+  else if (model->compute_skinning.joint_buffer != NULL) {
+    wgpu_queue_write_buffer_batched(
+      model->wgpu_context, model->compute_skinning.joint_buffer, 0,
+      model->compute_skinning.joint_matrices,
+      model->compute_skinning.joint_matrix_count * sizeof(mat4));
+    model->compute_skinning.joint_matrices_dirty = false;
+  }
+}
+
+static void gltf_model_update_nodes(gltf_model_t* model)
+{
+  gltf_model_evaluate_nodes(model);
+  gltf_model_upload_nodes(model);
+  if (model->compute_skinning.palette != NULL) {
+    gltf_joint_palette_flush(model->compute_skinning.palette);
+  }
+}
+
+/*
+ * Assign skins and set the initial pose of the nodes
+ */
+static void gltf_model_setup_skins_and_pose(gltf_model_t* model)
+{
+  // Assign skins and transforms, linear nodes follow their parents
+  mat4 identity = GLM_MAT4_IDENTITY_INIT;
+  transform_batch_init(&model->transforms, model->linear_node_count);
+  uint32_t joint_matrix_count = 0;
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    const int32_t parent_transform
+      = (node->parent != NULL && node->parent->transform_index < i) ?
+          (int32_t)node->parent->transform_index :
+          -1;
+    node->transform_index
+      = transform_batch_add(&model->transforms, parent_transform);
+    node->has_matrix = memcmp(node->matrix, identity, sizeof(mat4)) != 0;
+    if (node->skin_index > -1
+        && (uint32_t)node->skin_index < model->skin_count) {
+      node->skin = &model->skins[(uint32_t)node->skin_index];
+      if (node->mesh != NULL) {
+        node->joint_matrix_offset = joint_matrix_count;
+        joint_matrix_count += node->skin->current_joint_index;
+      }
+    }
+    node->dirty = true;
+  }
+  // Joint matrices of all skinned nodes for compute skinning, not limited to
+  // WGPU_GLTF_MAX_NUM_JOINTS
+  if (model->compute_skinning.enabled && joint_matrix_count > 0) {
+    model->compute_skinning.joint_matrix_count = joint_matrix_count;
+    model->compute_skinning.joint_matrices
+      = calloc(joint_matrix_count, sizeof(mat4));
+  }
+  // Initial pose
+  gltf_model_update_nodes(model);
+}
+
+/*
+ * Compute skinning
+ *
+ * One job per primitive of a skinned mesh node, the vertex range is relative
+ * to the bound part of the vertex buffers
+ */
+#define GLTF_SKINNING_WORKGROUP_SIZE 64u
+/* Vertex index granularity making binding offsets a multiple of 256 bytes */
+#define GLTF_SKINNING_VERTEX_ALIGNMENT 8u
+
+typedef struct gltf_skinning_job_t {
+  uint32_t first_vertex;
+  uint32_t vertex_count;
+  uint32_t joint_offset;
+  uint32_t joint_count;
+  /* Non-zero when the morph targets pass wrote the vertices to skin to the
+   * skinned vertex buffer */
+  uint32_t morphed;
+} gltf_skinning_job_t;
+
+// clang-format off
+static const char* gltf_skinning_compute_shader_wgsl = CODE(
+  struct SkinningJob {
+    firstVertex : u32,
+    vertexCount : u32,
+    jointOffset : u32,
+    jointCount : u32,
+    morphed : u32,
+  };
+
+  @group(0) @binding(0) var<storage, read> jobs : array<SkinningJob>;
+  @group(0) @binding(1) var<storage, read> jointMatrices : array<mat4x4<f32>>;
+  @group(0) @binding(2) var<storage, read> srcVertices : array<f32>;
+  @group(0) @binding(3) var<storage, read_write> dstVertices : array<f32>;
+
+  fn readVec3(index : u32) -> vec3<f32> {
+    return vec3<f32>(srcVertices[index], srcVertices[index + 1u],
+                     srcVertices[index + 2u]);
+  }
+
+  fn readVec4(index : u32) -> vec4<f32> {
+    return vec4<f32>(readVec3(index), srcVertices[index + 3u]);
+  }
+
+  fn writeVec3(index : u32, value : vec3<f32>) {
+    dstVertices[index]      = value.x;
+    dstVertices[index + 1u] = value.y;
+    dstVertices[index + 2u] = value.z;
+  }
+
+  // Morphed attributes are read from the output of the morph targets pass
+  fn readMorphedVec3(index : u32, morphed : bool) -> vec3<f32> {
+    if (morphed) {
+      return vec3<f32>(dstVertices[index], dstVertices[index + 1u],
+                       dstVertices[index + 2u]);
+    }
+    return readVec3(index);
+  }
+
+  fn safeNormalize(v : vec3<f32>) -> vec3<f32> {
+    if (dot(v, v) > 0.0) {
+      return normalize(v);
+    }
+    return v;
+  }
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let job = jobs[id.y];
+    let morphed = job.morphed != 0u;
+    if (id.x >= job.vertexCount) {
+      return;
+    }
+
+    let base = (job.firstVertex + id.x) * FLOATS_PER_VERTEX;
+    let maxJoint = vec4<u32>(job.jointCount - 1u);
+    let joint = min(vec4<u32>(readVec4(base + JOINT_OFFSET)), maxJoint)
+                + vec4<u32>(job.jointOffset);
+    let weight = readVec4(base + WEIGHT_OFFSET);
+    let skinMatrix = weight.x * jointMatrices[joint.x]
+                   + weight.y * jointMatrices[joint.y]
+                   + weight.z * jointMatrices[joint.z]
+                   + weight.w * jointMatrices[joint.w];
+
+    let position = skinMatrix
+                   * vec4<f32>(readMorphedVec3(base + POSITION_OFFSET,
+                                               morphed), 1.0);
+    let normal = skinMatrix
+                 * vec4<f32>(readMorphedVec3(base + NORMAL_OFFSET, morphed),
+                             0.0);
+    let tangent = skinMatrix
+                  * vec4<f32>(readMorphedVec3(base + TANGENT_OFFSET, morphed),
+                              0.0);
+    writeVec3(base + POSITION_OFFSET, position.xyz);
+    writeVec3(base + NORMAL_OFFSET, safeNormalize(normal.xyz));
+    writeVec3(base + TANGENT_OFFSET, safeNormalize(tangent.xyz));
+  }
+);
+// clang-format on
+
+/*
+ * (Re)create the bind group of the skinning pass, reading the joint matrices
+ * from joint_buffer at joint_offset bytes
+ */
+static void gltf_model_create_skinning_bind_group(gltf_model_t* model,
+                                                  WGPUBuffer joint_buffer,
+                                                  uint64_t joint_offset)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, model->compute_skinning.bind_group);
+
+  WGPUBindGroupLayout bind_group_layout = wgpuComputePipelineGetBindGroupLayout(
+    model->compute_skinning.pipeline, 0);
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = model->compute_skinning.job_buffer,
+      .size    = model->compute_skinning.job_count
+                 * sizeof(gltf_skinning_job_t),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = joint_buffer,
+      .offset  = joint_offset,
+      .size    = model->compute_skinning.joint_matrix_count * sizeof(mat4),
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = model->vertices.buffer,
+      .offset  = model->compute_skinning.vertex_binding_offset,
+      .size    = model->compute_skinning.vertex_binding_size,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = model->compute_skinning.skinned_vertex_buffer,
+      .offset  = model->compute_skinning.vertex_binding_offset,
+      .size    = model->compute_skinning.vertex_binding_size,
+    },
+  };
+  model->compute_skinning.bind_group = wgpuDeviceCreateBindGroup(
+    model->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "gltf_skinning_bind_group",
+      .layout     = bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(model->compute_skinning.bind_group != NULL);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+
+  // The animation passes write the joint matrices the skinning pass reads
+  if (model->gpu_animation.bind_group_layout != NULL) {
+    gltf_model_create_animation_bind_group(model, joint_buffer, joint_offset);
+  }
+}
+
+static void gltf_model_prepare_compute_skinning(gltf_model_t* model,
+                                                const gltf_vertex_t* vertices)
+{
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+  uint32_t job_count           = 0;
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->mesh != NULL && node->skin != NULL) {
+      job_count += node->mesh->primitive_count;
+    }
+  }
+  if (job_count == 0 || model->compute_skinning.joint_matrix_count == 0) {
+    return;
+  }
+
+  // Skinning jobs and the range of vertices they cover
+  gltf_skinning_job_t* jobs = calloc(job_count, sizeof(*jobs));
+  uint32_t first_vertex = UINT32_MAX, end_vertex = 0, max_vertex_count = 0;
+  job_count = 0;
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->mesh == NULL || node->skin == NULL) {
+      continue;
+    }
+    for (uint32_t p = 0; p < node->mesh->primitive_count; ++p) {
+      gltf_primitive_t* primitive = &node->mesh->primitives[p];
+      if (primitive->vertex_count == 0
+          || node->skin->current_joint_index == 0) {
+        continue;
+      }
+      jobs[job_count++] = (gltf_skinning_job_t){
+        .first_vertex = primitive->first_vertex,
+        .vertex_count = primitive->vertex_count,
+        .joint_offset = node->joint_matrix_offset,
+        .joint_count  = node->skin->current_joint_index,
+        .morphed      = primitive->morph_target_count > 0,
+      };
+      first_vertex = MIN(first_vertex, primitive->first_vertex);
+      end_vertex
+        = MAX(end_vertex, primitive->first_vertex + primitive->vertex_count);
+      max_vertex_count = MAX(max_vertex_count, primitive->vertex_count);
+    }
+  }
+  if (job_count == 0) {
+    free(jobs);
+    return;
+  }
+  first_vertex = (first_vertex / GLTF_SKINNING_VERTEX_ALIGNMENT)
+                 * GLTF_SKINNING_VERTEX_ALIGNMENT;
+  for (uint32_t i = 0; i < job_count; ++i) {
+    jobs[i].first_vertex -= first_vertex;
+  }
+  const uint64_t binding_offset = first_vertex * sizeof(gltf_vertex_t);
+  const uint64_t binding_size
+    = (end_vertex - first_vertex) * sizeof(gltf_vertex_t);
+
+  model->compute_skinning.job_count        = job_count;
+  model->compute_skinning.max_vertex_count = max_vertex_count;
+  model->compute_skinning.job_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF skinning job buffer",
+                           .usage = WGPUBufferUsage_Storage,
+                           .size  = job_count * sizeof(gltf_skinning_job_t),
+                           .initial.data = jobs,
+                         })
+        .buffer;
+  model->compute_skinning.joint_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF joint matrix buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+          .size  = model->compute_skinning.joint_matrix_count * sizeof(mat4),
+          .initial.data = model->compute_skinning.joint_matrices,
+        })
+        .buffer;
+  model->compute_skinning.joint_matrices_dirty = false;
+  // Starts as a copy of the vertex buffer so that the attributes the compute
+  // pass doesn't write and the vertices of unskinned meshes are valid
+  model->compute_skinning.skinned_vertex_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF skinned vertex buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex
+                   | WGPUBufferUsage_Storage,
+          .size         = model->vertices.count * sizeof(gltf_vertex_t),
+          .initial.data = vertices,
+        })
+        .buffer;
+  free(jobs);
+
+  // Compute pipeline, the vertex layout is passed as constants
+  char wgsl[4096];
+  snprintf(wgsl, sizeof(wgsl),
+           "let FLOATS_PER_VERTEX : u32 = %uu;\n"
+           "let POSITION_OFFSET : u32 = %uu;\n"
+           "let NORMAL_OFFSET : u32 = %uu;\n"
+           "let JOINT_OFFSET : u32 = %uu;\n"
+           "let WEIGHT_OFFSET : u32 = %uu;\n"
+           "let TANGENT_OFFSET : u32 = %uu;\n"
+           "%s",
+           (uint32_t)(sizeof(gltf_vertex_t) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, pos) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, normal) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, joint0) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, weight0) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, tangent) / sizeof(float)),
+           gltf_skinning_compute_shader_wgsl);
+  wgpu_shader_t skinning_comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "gltf_skinning_compute_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  model->compute_skinning.pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "gltf_skinning_compute_pipeline",
+      .compute = skinning_comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(model->compute_skinning.pipeline != NULL);
+  wgpu_shader_release(&skinning_comp_shader);
+
+  // Bind group
+  model->compute_skinning.vertex_binding_offset = binding_offset;
+  model->compute_skinning.vertex_binding_size   = binding_size;
+  gltf_model_create_skinning_bind_group(
+    model, model->compute_skinning.joint_buffer, 0);
+}
+
+/*
+ * Morph targets
+ *
+ * The position, normal and tangent deltas of the targets of a primitive are
+ * stored one target after the other in a storage buffer. Each frame a compute
+ * pass adds the deltas of the targets with non-zero weights to the vertices
+ * of the primitive and writes them to the skinned vertex buffer, where the
+ * skinning pass reads them for skinned meshes. Only the active targets of a
+ * primitive are listed, so unused targets cost nothing.
+ */
+#define GLTF_MORPH_FLOATS_PER_DELTA 9u
+
+/* One job per primitive with morph targets, the vertex range is relative to
+ * the bound part of the vertex buffers */
+typedef struct gltf_morph_job_t {
+  uint32_t first_vertex;
+  uint32_t vertex_count;
+  uint32_t first_target; /* first active target in the target buffer */
+  uint32_t target_count; /* active targets */
+} gltf_morph_job_t;
+
+typedef struct gltf_morph_target_t {
+  uint32_t first_delta;
+  float weight;
+} gltf_morph_target_t;
+
+/* Primitive of a morph job */
+typedef struct gltf_morph_primitive_t {
+  uint32_t first_delta;
+  uint32_t target_count;
+  uint32_t vertex_count;
+  uint32_t first_weight;
+} gltf_morph_primitive_t;
+
+/* Adds the attribute deltas of a target to the deltas of the primitive */
+static void gltf_morph_target_load_attribute(float* deltas,
+                                             uint32_t vertex_count,
+                                             const cgltf_accessor* accessor,
+                                             uint32_t component_offset,
+                                             bool flip_y)
+{
+  const cgltf_size component_count = cgltf_num_components(accessor->type);
+  if (accessor->count < vertex_count || component_count < 3) {
+    return;
+  }
+  const cgltf_size float_count = vertex_count * component_count;
+  float* values                = malloc(float_count * sizeof(float));
+  cgltf_accessor_unpack_floats(accessor, values, float_count);
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    float* delta = &deltas[v * GLTF_MORPH_FLOATS_PER_DELTA + component_offset];
+    memcpy(delta, &values[v * component_count], 3 * sizeof(float));
+    // Positions and normals are flipped like the vertices
+    if (flip_y && component_offset < 6) {
+      delta[1] *= -1.0f;
+    }
+  }
+  free(values);
+}
+
+/* Loads the targets of the primitives and the default weights of the meshes,
+ * after the geometry of the nodes */
+static void gltf_model_load_morph_targets(gltf_model_t* model, cgltf_data* data)
+{
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    cgltf_mesh* mesh      = &data->meshes[m];
+    gltf_mesh_t* new_mesh = &model->meshes[m];
+    uint32_t target_count = 0;
+    for (uint32_t p = 0; p < new_mesh->primitive_count; ++p) {
+      target_count
+        = MAX(target_count, (uint32_t)mesh->primitives[p].targets_count);
+    }
+    if (target_count == 0) {
+      continue;
+    }
+
+    // Default weights of the mesh
+    float* weights = realloc(model->morph_targets.weights,
+                             (model->morph_targets.weight_count + target_count)
+                               * sizeof(float));
+    ASSERT(weights != NULL);
+    model->morph_targets.weights = weights;
+    new_mesh->morph_target_count = target_count;
+    new_mesh->first_morph_weight = model->morph_targets.weight_count;
+    for (uint32_t t = 0; t < target_count; ++t) {
+      weights[new_mesh->first_morph_weight + t]
+        = t < mesh->weights_count ? mesh->weights[t] : 0.0f;
+    }
+    model->morph_targets.weight_count += target_count;
+
+    // Deltas of the targets of the primitives
+    for (uint32_t p = 0; p < new_mesh->primitive_count; ++p) {
+      cgltf_primitive* primitive      = &mesh->primitives[p];
+      gltf_primitive_t* new_primitive = &new_mesh->primitives[p];
+      const uint32_t vertex_count     = new_primitive->vertex_count;
+      if (primitive->targets_count == 0 || vertex_count == 0) {
+        continue;
+      }
+      const uint32_t delta_count
+        = (uint32_t)primitive->targets_count * vertex_count;
+      float* deltas = realloc(model->morph_targets.deltas,
+                              (model->morph_targets.delta_count + delta_count)
+                                * GLTF_MORPH_FLOATS_PER_DELTA * sizeof(float));
+      ASSERT(deltas != NULL);
+      model->morph_targets.deltas = deltas;
+      float* primitive_deltas
+        = &deltas[model->morph_targets.delta_count
+                  * GLTF_MORPH_FLOATS_PER_DELTA];
+      memset(primitive_deltas, 0,
+             delta_count * GLTF_MORPH_FLOATS_PER_DELTA * sizeof(float));
+      for (uint32_t t = 0; t < primitive->targets_count; ++t) {
+        const cgltf_morph_target* target = &primitive->targets[t];
+        float* target_deltas
+          = &primitive_deltas[t * vertex_count * GLTF_MORPH_FLOATS_PER_DELTA];
+        for (uint32_t a = 0; a < target->attributes_count; ++a) {
+          const cgltf_attribute* attribute = &target->attributes[a];
+          const uint32_t component_offset
+            = attribute->type == cgltf_attribute_type_position ? 0 :
+              attribute->type == cgltf_attribute_type_normal   ? 3 :
+              attribute->type == cgltf_attribute_type_tangent  ? 6 :
+                                                                 UINT32_MAX;
+          if (component_offset != UINT32_MAX) {
+            gltf_morph_target_load_attribute(target_deltas, vertex_count,
+                                             attribute->data, component_offset,
+                                             model->culling.flip_y);
+          }
+        }
+      }
+      new_primitive->morph_target_count = (uint32_t)primitive->targets_count;
+      new_primitive->first_morph_delta  = model->morph_targets.delta_count;
+      model->morph_targets.delta_count += delta_count;
+    }
+  }
+}
+
+// clang-format off
+static const char* gltf_morph_compute_shader_wgsl = CODE(
+  struct MorphJob {
+    firstVertex : u32,
+    vertexCount : u32,
+    firstTarget : u32,
+    targetCount : u32,
+  };
+
+  struct MorphTarget {
+    firstDelta : u32,
+    weight : f32,
+  };
+
+  @group(0) @binding(0) var<storage, read> jobs : array<MorphJob>;
+  @group(0) @binding(1) var<storage, read> morphTargets : array<MorphTarget>;
+  @group(0) @binding(2) var<storage, read> deltas : array<f32>;
+  @group(0) @binding(3) var<storage, read> srcVertices : array<f32>;
+  @group(0) @binding(4) var<storage, read_write> dstVertices : array<f32>;
+
+  fn readVec3(index : u32) -> vec3<f32> {
+    return vec3<f32>(srcVertices[index], srcVertices[index + 1u],
+                     srcVertices[index + 2u]);
+  }
+
+  fn readDelta(index : u32) -> vec3<f32> {
+    return vec3<f32>(deltas[index], deltas[index + 1u], deltas[index + 2u]);
+  }
+
+  fn writeVec3(index : u32, value : vec3<f32>) {
+    dstVertices[index]      = value.x;
+    dstVertices[index + 1u] = value.y;
+    dstVertices[index + 2u] = value.z;
+  }
+
+  fn safeNormalize(v : vec3<f32>) -> vec3<f32> {
+    if (dot(v, v) > 0.0) {
+      return normalize(v);
+    }
+    return v;
+  }
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let job = jobs[id.y];
+    if (id.x >= job.vertexCount) {
+      return;
+    }
+
+    let base = (job.firstVertex + id.x) * FLOATS_PER_VERTEX;
+    var position = readVec3(base + POSITION_OFFSET);
+    var normal = readVec3(base + NORMAL_OFFSET);
+    var tangent = readVec3(base + TANGENT_OFFSET);
+    for (var t = 0u; t < job.targetCount; t = t + 1u) {
+      let morphTarget = morphTargets[job.firstTarget + t];
+      let delta = (morphTarget.firstDelta + id.x) * FLOATS_PER_DELTA;
+      position = position + morphTarget.weight * readDelta(delta);
+      normal = normal + morphTarget.weight * readDelta(delta + 3u);
+      tangent = tangent + morphTarget.weight * readDelta(delta + 6u);
+    }
+    writeVec3(base + POSITION_OFFSET, position);
+    writeVec3(base + NORMAL_OFFSET, safeNormalize(normal));
+    writeVec3(base + TANGENT_OFFSET, safeNormalize(tangent));
+  }
+);
+// clang-format on
+
+static void gltf_model_prepare_morph_targets(gltf_model_t* model,
+                                             const gltf_vertex_t* vertices)
+{
+  if (model->morph_targets.delta_count == 0) {
+    return;
+  }
+
+  // Jobs of the primitives, each reserving a slot per target in the target
+  // buffer
+  uint32_t job_count = 0;
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    for (uint32_t p = 0; p < model->meshes[m].primitive_count; ++p) {
+      job_count += model->meshes[m].primitives[p].morph_target_count > 0;
+    }
+  }
+  model->morph_targets.jobs       = calloc(job_count, sizeof(gltf_morph_job_t));
+  model->morph_targets.primitives = calloc(job_count,
+                                           sizeof(gltf_morph_primitive_t));
+  uint32_t first_vertex = UINT32_MAX, end_vertex = 0, target_capacity = 0;
+  job_count = 0;
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    const gltf_mesh_t* mesh = &model->meshes[m];
+    for (uint32_t p = 0; p < mesh->primitive_count; ++p) {
+      const gltf_primitive_t* primitive = &mesh->primitives[p];
+      if (primitive->morph_target_count == 0) {
+        continue;
+      }
+      model->morph_targets.jobs[job_count] = (gltf_morph_job_t){
+        .first_vertex = primitive->first_vertex,
+        .vertex_count = primitive->vertex_count,
+        .first_target = target_capacity,
+      };
+      model->morph_targets.primitives[job_count++] = (gltf_morph_primitive_t){
+        .first_delta  = primitive->first_morph_delta,
+        .target_count = MIN(primitive->morph_target_count,
+                            mesh->morph_target_count),
+        .vertex_count = primitive->vertex_count,
+        .first_weight = mesh->first_morph_weight,
+      };
+      target_capacity += primitive->morph_target_count;
+      first_vertex = MIN(first_vertex, primitive->first_vertex);
+      end_vertex
+        = MAX(end_vertex, primitive->first_vertex + primitive->vertex_count);
+      model->morph_targets.max_vertex_count
+        = MAX(model->morph_targets.max_vertex_count, primitive->vertex_count);
+    }
+  }
+  first_vertex = (first_vertex / GLTF_SKINNING_VERTEX_ALIGNMENT)
+                 * GLTF_SKINNING_VERTEX_ALIGNMENT;
+  for (uint32_t i = 0; i < job_count; ++i) {
+    model->morph_targets.jobs[i].first_vertex -= first_vertex;
+  }
+  const uint64_t binding_offset = first_vertex * sizeof(gltf_vertex_t);
+  const uint64_t binding_size
+    = (end_vertex - first_vertex) * sizeof(gltf_vertex_t);
+  model->morph_targets.job_count       = job_count;
+  model->morph_targets.target_capacity = target_capacity;
+  model->morph_targets.targets
+    = calloc(target_capacity, sizeof(gltf_morph_target_t));
+  model->morph_targets.weights_dirty = true;
+
+  // Buffers, the jobs and active targets are written before the dispatch
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+  model->morph_targets.delta_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF morph target delta buffer",
+                           .usage = WGPUBufferUsage_Storage,
+                           .size  = model->morph_targets.delta_count
+                                   * GLTF_MORPH_FLOATS_PER_DELTA
+                                   * sizeof(float),
+                           .initial.data = model->morph_targets.deltas,
+                         })
+        .buffer;
+  free(model->morph_targets.deltas);
+  model->morph_targets.deltas = NULL;
+  model->morph_targets.job_buffer
+    = wgpu_create_buffer(
+        wgpu_context, &(wgpu_buffer_desc_t){
+                        .label = "glTF morph target job buffer",
+                        .usage = WGPUBufferUsage_CopyDst
+                                 | WGPUBufferUsage_Storage,
+                        .size  = job_count * sizeof(gltf_morph_job_t),
+                      })
+        .buffer;
+  model->morph_targets.target_buffer
+    = wgpu_create_buffer(
+        wgpu_context, &(wgpu_buffer_desc_t){
+                        .label = "glTF morph target buffer",
+                        .usage = WGPUBufferUsage_CopyDst
+                                 | WGPUBufferUsage_Storage,
+                        .size  = target_capacity * sizeof(gltf_morph_target_t),
+                      })
+        .buffer;
+  // Meshes without skin are drawn from the skinned vertex buffer as well
+  if (model->compute_skinning.skinned_vertex_buffer == NULL) {
+    model->compute_skinning.skinned_vertex_buffer
+      = wgpu_create_buffer(
+          wgpu_context,
+          &(wgpu_buffer_desc_t){
+            .label = "glTF skinned vertex buffer",
+            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex
+                     | WGPUBufferUsage_Storage,
+            .size         = model->vertices.count * sizeof(gltf_vertex_t),
+            .initial.data = vertices,
+          })
+          .buffer;
+  }
+
+  // Compute pipeline, the vertex layout is passed as constants
+  char wgsl[4096];
+  snprintf(wgsl, sizeof(wgsl),
+           "let FLOATS_PER_VERTEX : u32 = %uu;\n"
+           "let FLOATS_PER_DELTA : u32 = %uu;\n"
+           "let POSITION_OFFSET : u32 = %uu;\n"
+           "let NORMAL_OFFSET : u32 = %uu;\n"
+           "let TANGENT_OFFSET : u32 = %uu;\n"
+           "%s",
+           (uint32_t)(sizeof(gltf_vertex_t) / sizeof(float)),
+           GLTF_MORPH_FLOATS_PER_DELTA,
+           (uint32_t)(offsetof(gltf_vertex_t, pos) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, normal) / sizeof(float)),
+           (uint32_t)(offsetof(gltf_vertex_t, tangent) / sizeof(float)),
+           gltf_morph_compute_shader_wgsl);
+  wgpu_shader_t morph_comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "gltf_morph_compute_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  model->morph_targets.pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "gltf_morph_compute_pipeline",
+      .compute = morph_comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(model->morph_targets.pipeline != NULL);
+  wgpu_shader_release(&morph_comp_shader);
+
+  // Bind group
+  WGPUBindGroupLayout bind_group_layout = wgpuComputePipelineGetBindGroupLayout(
+    model->morph_targets.pipeline, 0);
+  WGPUBindGroupEntry bg_entries[5] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = model->morph_targets.job_buffer,
+      .size    = job_count * sizeof(gltf_morph_job_t),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = model->morph_targets.target_buffer,
+      .size    = target_capacity * sizeof(gltf_morph_target_t),
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = model->morph_targets.delta_buffer,
+      .size    = model->morph_targets.delta_count
+                 * GLTF_MORPH_FLOATS_PER_DELTA * sizeof(float),
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = model->vertices.buffer,
+      .offset  = binding_offset,
+      .size    = binding_size,
+    },
+    [4] = (WGPUBindGroupEntry) {
+      .binding = 4,
+      .buffer  = model->compute_skinning.skinned_vertex_buffer,
+      .offset  = binding_offset,
+      .size    = binding_size,
+    },
+  };
+  model->morph_targets.bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "gltf_morph_bind_group",
+      .layout     = bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(model->morph_targets.bind_group != NULL);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+}
+
+/* Lists the targets with non-zero weights of each job */
+static void gltf_model_upload_morph_weights(gltf_model_t* model)
+{
+  const float* weights  = model->morph_targets.weights;
+  uint32_t active_count = 0;
+  for (uint32_t i = 0; i < model->morph_targets.job_count; ++i) {
+    const gltf_morph_primitive_t* primitive
+      = &model->morph_targets.primitives[i];
+    gltf_morph_job_t* job = &model->morph_targets.jobs[i];
+    job->target_count     = 0;
+    for (uint32_t t = 0; t < primitive->target_count; ++t) {
+      const float weight = weights[primitive->first_weight + t];
+      if (weight != 0.0f) {
+        model->morph_targets.targets[job->first_target + job->target_count++]
+          = (gltf_morph_target_t){
+            .first_delta = primitive->first_delta + t * primitive->vertex_count,
+            .weight      = weight,
+          };
+      }
+    }
+    active_count = MAX(active_count, job->first_target + job->target_count);
+  }
+  wgpu_queue_write_buffer_batched(
+    model->wgpu_context, model->morph_targets.job_buffer, 0,
+    model->morph_targets.jobs,
+    model->morph_targets.job_count * sizeof(gltf_morph_job_t));
+  if (active_count > 0) {
+    wgpu_queue_write_buffer_batched(
+      model->wgpu_context, model->morph_targets.target_buffer, 0,
+      model->morph_targets.targets, active_count * sizeof(gltf_morph_target_t));
+  }
+  model->morph_targets.weights_dirty = false;
+}
+
+static void
+gltf_model_dispatch_morph_targets(gltf_model_t* model,
+                                  WGPUComputePassEncoder pass_encoder)
+{
+  if (model->morph_targets.pipeline == NULL) {
+    return;
+  }
+  if (model->morph_targets.weights_dirty) {
+    gltf_model_upload_morph_weights(model);
+  }
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    model->morph_targets.pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0,
+                                     model->morph_targets.bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    (model->morph_targets.max_vertex_count + GLTF_SKINNING_WORKGROUP_SIZE - 1)
+      / GLTF_SKINNING_WORKGROUP_SIZE,
+    model->morph_targets.job_count, 1);
+}
+
+/*
+ * Reorder the triangles of each primitive for the post-transform vertex cache
+ * and less overdraw. Blended primitives keep the authored triangle order.
+ */
+static void gltf_model_optimize_indices(gltf_model_t* model,
+                                        const gltf_vertex_t* vertices,
+                                        uint32_t* indices)
+{
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    for (uint32_t p = 0; p < model->meshes[m].primitive_count; ++p) {
+      gltf_primitive_t* primitive = &model->meshes[m].primitives[p];
+      if (primitive->index_count < 6 || primitive->vertex_count == 0
+          || primitive->material->alpha_mode == AlphaMode_BLEND) {
+        continue;
+      }
+      // The optimizer works on indices relative to the primitive's vertices
+      uint32_t* prim_indices = &indices[primitive->first_index];
+      for (uint32_t i = 0; i < primitive->index_count; ++i) {
+        prim_indices[i] -= primitive->first_vertex;
+      }
+      mesh_optimize_triangle_order(
+        prim_indices, primitive->index_count, primitive->vertex_count,
+        vertices[primitive->first_vertex].pos, sizeof(gltf_vertex_t));
+      for (uint32_t i = 0; i < primitive->index_count; ++i) {
+        prim_indices[i] += primitive->first_vertex;
+      }
+    }
+  }
+}
+
+/*
+ * Append coarser index ranges to the primitives by vertex clustering, on grids
+ * of GLTF_LOD_GRID_RESOLUTION cells along the largest extent halved per level.
+ * Levels not saving at least a quarter of the triangles are skipped.
+ */
+#define GLTF_LOD_GRID_RESOLUTION 32.0f
+#define GLTF_LOD_MIN_INDEX_COUNT 384u
+
+static void gltf_model_generate_lods(gltf_model_t* model,
+                                     const gltf_vertex_t* vertices,
+                                     uint32_t** indices, uint32_t* index_count)
+{
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    for (uint32_t p = 0; p < model->meshes[m].primitive_count; ++p) {
+      gltf_primitive_t* primitive = &model->meshes[m].primitives[p];
+      if (primitive->index_count < GLTF_LOD_MIN_INDEX_COUNT
+          || !primitive->bb.valid
+          || primitive->material->alpha_mode == AlphaMode_BLEND) {
+        continue;
+      }
+      vec3 extent = GLM_VEC3_ZERO_INIT;
+      glm_vec3_sub(primitive->bb.max, primitive->bb.min, extent);
+      const float max_extent = glm_vec3_max(extent);
+      if (max_extent <= 0.0f) {
+        continue;
+      }
+
+      // The clustering works on indices relative to the primitive's vertices
+      const gltf_vertex_t* prim_vertices = &vertices[primitive->first_vertex];
+
+      const size_t size = primitive->index_count * sizeof(uint32_t);
+      uint32_t* base_indices = malloc(size);
+      uint32_t* lod_indices  = malloc(size);
+      for (uint32_t i = 0; i < primitive->index_count; ++i) {
+        base_indices[i]
+          = (*indices)[primitive->first_index + i] - primitive->first_vertex;
+      }
+      uint32_t lod_count = 1;
+      for (float cell_size = max_extent / GLTF_LOD_GRID_RESOLUTION;
+           lod_count < GLTF_MAX_LOD_COUNT && cell_size <= max_extent;
+           cell_size *= 2.0f) {
+        const uint32_t lod_index_count = mesh_simplify(
+          base_indices, primitive->index_count, primitive->vertex_count,
+          prim_vertices[0].pos, sizeof(gltf_vertex_t), cell_size, lod_indices);
+        const uint32_t previous_count
+          = primitive->lods[lod_count - 1].index_count;
+        if (lod_index_count == 0) {
+          break;
+        }
+        if (lod_index_count * 4 > previous_count * 3) {
+          continue;
+        }
+        mesh_optimize_triangle_order(lod_indices, lod_index_count,
+                                     primitive->vertex_count,
+                                     prim_vertices[0].pos,
+                                     sizeof(gltf_vertex_t));
+        *indices = realloc(*indices,
+                           (*index_count + lod_index_count) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < lod_index_count; ++i) {
+          (*indices)[*index_count + i]
+            = lod_indices[i] + primitive->first_vertex;
+        }
+        primitive->lods[lod_count++] = (gltf_primitive_lod_t){
+          .first_index = *index_count,
+          .index_count = lod_index_count,
+          .error       = cell_size,
+        };
+        *index_count += lod_index_count;
+      }
+      primitive->lod_count = lod_count;
+      free(base_indices);
+      free(lod_indices);
+    }
+  }
+}
+
+/*
+ * Create the vertex and index buffers, each with a single copy into the buffer
+ * mapped at creation
+ */
+static void gltf_model_on_buffer_uploaded(void* user_data)
+{
+  gltf_model_t* model = user_data;
+  --model->pending_upload_count;
+}
+
+// Queue the initial contents of a buffer on the upload scheduler, the model is
+// drawn once all of them have been written
+static void gltf_model_upload_buffer(gltf_model_t* model, WGPUBuffer buffer,
+                                     const void* data, size_t size)
+{
+  ++model->pending_upload_count;
+  wgpu_upload_scheduler_upload_buffer(
+    wgpu_get_upload_scheduler(model->wgpu_context),
+    &(wgpu_buffer_upload_desc_t){
+      .buffer    = buffer,
+      .data      = data,
+      .size      = size,
+      .priority  = 1,
+      .callback  = gltf_model_on_buffer_uploaded,
+      .user_data = model,
+    });
+}
+
+/*
+ * Copies the full resolution triangles of the meshes of all nodes, with the
+ * positions transformed by the node matrices
+ */
+static void gltf_model_copy_triangles(gltf_model_t* model,
+                                      const gltf_vertex_t* vertices,
+                                      const uint32_t* indices)
+{
+  uint32_t vertex_count = 0, index_count = 0;
+  for (uint32_t n = 0; n < model->linear_node_count; ++n) {
+    const gltf_mesh_t* mesh = model->linear_nodes[n]->mesh;
+    for (uint32_t p = 0; mesh != NULL && p < mesh->primitive_count; ++p) {
+      const gltf_primitive_t* primitive = &mesh->primitives[p];
+      vertex_count += primitive->vertex_count;
+      index_count += primitive->has_indices ? primitive->lods[0].index_count :
+                                              primitive->vertex_count;
+    }
+  }
+
+  model->triangles.positions = malloc(MAX(vertex_count, 1u) * sizeof(vec3));
+  model->triangles.indices   = malloc(MAX(index_count, 1u) * sizeof(uint32_t));
+  model->triangles.materials
+    = malloc(MAX(index_count / 3, 1u) * sizeof(uint32_t));
+  model->triangles.vertex_count = 0;
+  model->triangles.index_count  = 0;
+
+  for (uint32_t n = 0; n < model->linear_node_count; ++n) {
+    gltf_node_t* node       = model->linear_nodes[n];
+    const gltf_mesh_t* mesh = node->mesh;
+    for (uint32_t p = 0; mesh != NULL && p < mesh->primitive_count; ++p) {
+      const gltf_primitive_t* primitive = &mesh->primitives[p];
+      const uint32_t first_vertex       = model->triangles.vertex_count;
+      for (uint32_t i = 0; i < primitive->vertex_count; ++i) {
+        float* position
+          = &model->triangles.positions[(first_vertex + i) * 3];
+        vec4 pos = GLM_VEC4_ZERO_INIT;
+        glm_vec4((float*)vertices[primitive->first_vertex + i].pos, 1.0f, pos);
+        if (!model->culling.pre_transformed) {
+          glm_mat4_mulv(node->world_matrix, pos, pos);
+        }
+        glm_vec3(pos, position);
+      }
+      model->triangles.vertex_count += primitive->vertex_count;
+
+      const uint32_t first_index = model->triangles.index_count;
+      const uint32_t primitive_index_count
+        = primitive->has_indices ? primitive->lods[0].index_count :
+                                   primitive->vertex_count;
+      for (uint32_t i = 0; i < primitive_index_count; ++i) {
+        model->triangles.indices[first_index + i]
+          = primitive->has_indices ?
+              first_vertex
+                + indices[primitive->lods[0].first_index + i]
+                - primitive->first_vertex :
+              first_vertex + i;
+      }
+      for (uint32_t t = 0; t < primitive_index_count / 3; ++t) {
+        model->triangles.materials[first_index / 3 + t]
+          = primitive->material != NULL ? primitive->material->index : 0;
+      }
+      model->triangles.index_count += primitive_index_count;
+    }
+  }
+}
+
+/*
+ * Vertex pulling attributes of the default and the compact vertex layout
+ */
+static void
+gltf_model_get_mesh_attributes(gltf_model_t* model,
+                               wgpu_mesh_attribute_t* attributes)
+{
+  if (model->compact_vertices) {
+    const uint32_t stride = sizeof(gltf_compact_vertex_t);
+    attributes[WGPU_MeshAttribute_Position] = (wgpu_mesh_attribute_t){
+      WGPU_MeshAttributeFormat_Float32x3, offsetof(gltf_compact_vertex_t, pos),
+      stride};
+    attributes[WGPU_MeshAttribute_Normal] = (wgpu_mesh_attribute_t){
+      WGPU_MeshAttributeFormat_Snorm16x4,
+      offsetof(gltf_compact_vertex_t, normal), stride};
+    attributes[WGPU_MeshAttribute_UV] = (wgpu_mesh_attribute_t){
+      WGPU_MeshAttributeFormat_Float16x2, offsetof(gltf_compact_vertex_t, uv),
+      stride};
+    attributes[WGPU_MeshAttribute_Color] = (wgpu_mesh_attribute_t){
+      WGPU_MeshAttributeFormat_Unorm8x4, offsetof(gltf_compact_vertex_t, color),
+      stride};
+    attributes[WGPU_MeshAttribute_Tangent] = (wgpu_mesh_attribute_t){
+      WGPU_MeshAttributeFormat_Snorm16x4,
+      offsetof(gltf_compact_vertex_t, tangent), stride};
+    return;
+  }
+
+  const uint32_t stride = sizeof(gltf_vertex_t);
+  attributes[WGPU_MeshAttribute_Position] = (wgpu_mesh_attribute_t){
+    WGPU_MeshAttributeFormat_Float32x3, offsetof(gltf_vertex_t, pos), stride};
+  attributes[WGPU_MeshAttribute_Normal] = (wgpu_mesh_attribute_t){
+    WGPU_MeshAttributeFormat_Float32x3, offsetof(gltf_vertex_t, normal),
+    stride};
+  attributes[WGPU_MeshAttribute_UV] = (wgpu_mesh_attribute_t){
+    WGPU_MeshAttributeFormat_Float32x2, offsetof(gltf_vertex_t, uv), stride};
+  attributes[WGPU_MeshAttribute_Color] = (wgpu_mesh_attribute_t){
+    WGPU_MeshAttributeFormat_Float32x4, offsetof(gltf_vertex_t, color),
+    stride};
+  attributes[WGPU_MeshAttribute_Tangent] = (wgpu_mesh_attribute_t){
+    WGPU_MeshAttributeFormat_Float32x4, offsetof(gltf_vertex_t, tangent),
+    stride};
+}
+
+/*
+ * Appends the vertex buffer data and one mesh per primitive level of detail to
+ * the mesh buffer. 16-bit indices are relative to the first vertex of their
+ * primitive, 32-bit ones to the model's first vertex.
+ */
+static void gltf_model_add_to_mesh_buffer(gltf_model_t* model,
+                                          const void* vertex_data,
+                                          uint64_t vertex_data_size,
+                                          const uint32_t* indices,
+                                          const uint16_t* indices_16)
+{
+  const uint64_t vertex_offset = wgpu_mesh_buffer_add_vertex_data(
+    model->mesh_buffer, vertex_data, vertex_data_size);
+  const uint64_t vertex_size   = model->compact_vertices ?
+                                   sizeof(gltf_compact_vertex_t) :
+                                   sizeof(gltf_vertex_t);
+
+  wgpu_mesh_desc_t desc = {0};
+  gltf_model_get_mesh_attributes(model, desc.attributes);
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    for (uint32_t p = 0; p < model->meshes[m].primitive_count; ++p) {
+      gltf_primitive_t* primitive = &model->meshes[m].primitives[p];
+      desc.vertex_offset
+        = vertex_offset
+          + (indices_16 != NULL ? primitive->first_vertex * vertex_size : 0);
+      for (uint32_t l = 0; l < primitive->lod_count; ++l) {
+        const gltf_primitive_lod_t* lod = &primitive->lods[l];
+        desc.indices     = indices_16 != NULL ?
+                             (const void*)&indices_16[lod->first_index] :
+                             (const void*)&indices[lod->first_index];
+        desc.index_count = lod->index_count;
+        desc.index_size
+          = indices_16 != NULL ? sizeof(uint16_t) : sizeof(uint32_t);
+        const uint32_t mesh
+          = wgpu_mesh_buffer_add_mesh(model->mesh_buffer, &desc);
+        if (l == 0) {
+          primitive->first_pulled_mesh = mesh;
+        }
+      }
+    }
+  }
+}
+
+static void gltf_model_create_buffers(gltf_model_t* model,
+                                      const gltf_vertex_t* vertices,
+                                      const uint32_t* indices)
+{
+  size_t vertex_buffer_size = model->vertices.count * sizeof(gltf_vertex_t);
+  size_t index_buffer_size  = model->indices.count * sizeof(uint32_t);
+
+  // Use 16-bit indices relative to the first vertex of each primitive when no
+  // primitive has more than 65536 vertices
+  model->indices.format = WGPUIndexFormat_Uint16;
+  for (uint32_t m = 0; m < model->mesh_count; ++m) {
+    for (uint32_t p = 0; p < model->meshes[m].primitive_count; ++p) {
+      if (model->meshes[m].primitives[p].vertex_count > UINT16_MAX + 1u) {
+        model->indices.format = WGPUIndexFormat_Uint32;
+      }
+    }
+  }
+  uint16_t* indices_16 = NULL;
+  if (model->indices.format == WGPUIndexFormat_Uint16) {
+    // Buffer sizes must be a multiple of 4 bytes
+    index_buffer_size = ((model->indices.count + 1) / 2) * 2 * sizeof(uint16_t);
+    indices_16        = calloc(1, index_buffer_size);
+    for (uint32_t m = 0; m < model->mesh_count; ++m) {
+      for (uint32_t p = 0; p < model->meshes[m].primitive_count; ++p) {
+        const gltf_primitive_t* primitive = &model->meshes[m].primitives[p];
+        for (uint32_t l = 0; l < primitive->lod_count; ++l) {
+          const gltf_primitive_lod_t* lod = &primitive->lods[l];
+          for (uint32_t i = lod->first_index;
+               i < lod->first_index + lod->index_count; ++i) {
+            indices_16[i] = (uint16_t)(indices[i] - primitive->first_vertex);
+          }
+        }
+      }
+    }
+  }
+
+  assert((vertex_buffer_size > 0) && (index_buffer_size > 0));
+
+  // Quantize the vertices into the compact layout
+  gltf_compact_vertex_t* compact_vertices = NULL;
+  if (model->compact_vertices) {
+    vertex_buffer_size = model->vertices.count * sizeof(gltf_compact_vertex_t);
+    compact_vertices
+      = malloc(model->vertices.count * sizeof(gltf_compact_vertex_t));
+    for (uint32_t i = 0; i < model->vertices.count; ++i) {
+      gltf_vertex_compact(&vertices[i], &compact_vertices[i]);
+    }
+  }
+
+  // Create vertex buffer
+  model->vertices.buffer
+    = wgpu_create_buffer(model->wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF vertex buffer",
+                           .usage = WGPUBufferUsage_CopyDst
+                                    | WGPUBufferUsage_Vertex
+                                    | (model->compute_skinning.enabled ?
+                                         WGPUBufferUsage_Storage :
+                                         WGPUBufferUsage_None),
+                           .size = (uint32_t)vertex_buffer_size,
+                         })
+        .buffer;
+  gltf_model_upload_buffer(model, model->vertices.buffer,
+                           compact_vertices != NULL ?
+                             (const void*)compact_vertices :
+                             (const void*)vertices,
+                           vertex_buffer_size);
+  if (model->mesh_buffer != NULL) {
+    gltf_model_add_to_mesh_buffer(model,
+                                  compact_vertices != NULL ?
+                                    (const void*)compact_vertices :
+                                    (const void*)vertices,
+                                  vertex_buffer_size, indices, indices_16);
+  }
+  free(compact_vertices);
+
+  // Create the position-only vertex buffer
+  if (model->position_stream) {
+    const size_t position_buffer_size = model->vertices.count * sizeof(vec3);
+    vec3* positions                   = malloc(position_buffer_size);
+    for (uint32_t i = 0; i < model->vertices.count; ++i) {
+      glm_vec3_copy((float*)vertices[i].pos, positions[i]);
+    }
+    model->positions.buffer
+      = wgpu_create_buffer(model->wgpu_context,
+                           &(wgpu_buffer_desc_t){
+                             .label = "glTF position buffer",
+                             .usage = WGPUBufferUsage_CopyDst
+                                      | WGPUBufferUsage_Vertex,
+                             .size = (uint32_t)position_buffer_size,
+                           })
+          .buffer;
+    gltf_model_upload_buffer(model, model->positions.buffer, positions,
+                             position_buffer_size);
+    free(positions);
+  }
+
+  // Create index buffer
+  model->indices.buffer
+    = wgpu_create_buffer(model->wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF index buffer",
+                           .usage = WGPUBufferUsage_CopyDst
+                                    | WGPUBufferUsage_Index,
+                           .size = (uint32_t)index_buffer_size,
+                         })
+        .buffer;
+  gltf_model_upload_buffer(model, model->indices.buffer,
+                           indices_16 != NULL ? (const void*)indices_16 :
+                                                (const void*)indices,
+                           index_buffer_size);
+  free(indices_16);
+
+  if (model->compute_skinning.enabled) {
+    gltf_model_prepare_compute_skinning(model, vertices);
+    gltf_model_prepare_morph_targets(model, vertices);
+  }
+
+  if (model->triangles.enabled) {
+    gltf_model_copy_triangles(model, vertices, indices);
+  }
+}
+
+/*
+ * glTF model cache
+ *
+ * The converted model (interleaved vertices, indices, node table, meshes,
+ * materials, skins and animations) is written to WGPU_MODEL_CACHE_DIRECTORY,
+ * named after the model file, when loading with
+ * WGPU_GLTF_FileLoadingFlags_UseCache. On the next load the cache file is
+ * memory-mapped and the model is rebuilt from it without parsing the glTF
+ * file, the vertex and index data are copied straight from the mapping
+ * into the GPU buffers. The cache is rebuilt when the size or modification
+ * time of the model file or of one of its external buffer files, the loading
+ * flags or the scale change. Images referenced by uri are read from their
+ * files on every load.
+ */
+#define GLTF_CACHE_MAGIC 0x43544c47u /* "GLTC" */
+#define GLTF_CACHE_VERSION 6u
+#define GLTF_CACHE_FILE_EXTENSION ".cache"
+#define GLTF_CACHE_SECTION_ALIGNMENT 16u
+#define GLTF_CACHE_NO_TEXTURE -1
+#define GLTF_CACHE_EMPTY_TEXTURE -2
+
+typedef enum cache_section_enum {
+  CacheSection_VERTICES              = 0,
+  CacheSection_INDICES               = 1,
+  CacheSection_NODES                 = 2,
+  CacheSection_NODE_CHILDREN         = 3,
+  CacheSection_LINEAR_NODES          = 4,
+  CacheSection_MESHES                = 5,
+  CacheSection_PRIMITIVES            = 6,
+  CacheSection_MATERIALS             = 7,
+  CacheSection_IMAGES                = 8,
+  CacheSection_IMAGE_DATA            = 9,
+  CacheSection_TEXTURE_SAMPLERS      = 10,
+  CacheSection_SKINS                 = 11,
+  CacheSection_SKIN_JOINTS           = 12,
+  CacheSection_INVERSE_BIND_MATRICES = 13,
+  CacheSection_ANIMATIONS            = 14,
+  CacheSection_ANIMATION_SAMPLERS    = 15,
+  CacheSection_ANIMATION_INPUTS      = 16,
+  CacheSection_ANIMATION_OUTPUTS     = 17,
+  CacheSection_ANIMATION_CHANNELS    = 18,
+  CacheSection_BUFFER_FILES          = 19,
+  CacheSection_COUNT                 = 20,
+} cache_section_enum;
+
+typedef struct gltf_cache_section_t {
+  uint64_t offset;
+  uint64_t size;
+} gltf_cache_section_t;
+
+typedef struct gltf_cache_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_modification_time;
+  uint32_t file_loading_flags;
+  float scale;
+  uint32_t vertex_size;
+  uint32_t section_count;
+  gltf_cache_section_t sections[CacheSection_COUNT];
+} gltf_cache_header_t;
+
+typedef struct gltf_cache_node_t {
+  int32_t parent; /* -1 for root nodes */
+  int32_t mesh;   /* -1 for nodes without mesh */
+  int32_t skin_index;
+  uint32_t index;
+  uint32_t first_child;
+  uint32_t child_count;
+  uint32_t has_children;
+  mat4 matrix;
+  vec3 translation;
+  vec3 scale;
+  versor rotation;
+  char name[STRMAX];
+} gltf_cache_node_t;
+
+typedef struct gltf_cache_mesh_t {
+  uint32_t initialized;
+  uint32_t first_primitive;
+  uint32_t primitive_count;
+  mat4 matrix;
+  bounding_box_t bb;
+  char name[STRMAX];
+} gltf_cache_mesh_t;
+
+typedef struct gltf_cache_primitive_t {
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t first_vertex;
+  uint32_t vertex_count;
+  uint32_t material;
+  uint32_t has_indices;
+  bounding_box_t bb;
+  uint32_t lod_count;
+  gltf_primitive_lod_t lods[GLTF_MAX_LOD_COUNT];
+} gltf_cache_primitive_t;
+
+typedef struct gltf_cache_material_t {
+  uint32_t alpha_mode;
+  uint32_t blend;
+  uint32_t double_sided;
+  float alpha_cutoff;
+  float metallic_factor;
+  float roughness_factor;
+  vec4 base_color_factor;
+  vec4 emissive_factor;
+  vec4 diffuse_factor;
+  vec3 specular_factor;
+  /* Texture indices, GLTF_CACHE_NO_TEXTURE or GLTF_CACHE_EMPTY_TEXTURE */
+  int32_t base_color_texture;
+  int32_t metallic_roughness_texture;
+  int32_t normal_texture;
+  int32_t occlusion_texture;
+  int32_t emissive_texture;
+  int32_t specular_glossiness_texture;
+  int32_t diffuse_texture;
+  uint8_t tex_coord_sets[6];
+  uint8_t pbr_workflows[2];
+} gltf_cache_material_t;
+
+/* External buffer file of the model, as found when the cache was written */
+typedef struct gltf_cache_buffer_file_t {
+  char path[STRMAX];
+  uint64_t size;
+  int64_t modification_time;
+} gltf_cache_buffer_file_t;
+
+typedef struct gltf_cache_image_t {
+  char uri[STRMAX]; /* empty for images embedded in the model */
+  uint64_t data_offset;
+  uint64_t data_size;
+} gltf_cache_image_t;
+
+typedef struct gltf_cache_skin_t {
+  int32_t skeleton_root;
+  uint32_t joint_count;
+  uint32_t first_joint;
+  uint32_t resolved_joint_count;
+  uint32_t first_inverse_bind_matrix;
+  uint32_t inverse_bind_matrix_count;
+  char name[STRMAX];
+} gltf_cache_skin_t;
+
+typedef struct gltf_cache_animation_t {
+  float start;
+  float end;
+  uint32_t first_sampler;
+  uint32_t sampler_count;
+  uint32_t first_channel;
+  uint32_t channel_count;
+  char name[STRMAX];
+} gltf_cache_animation_t;
+
+typedef struct gltf_cache_animation_sampler_t {
+  uint32_t interpolation;
+  uint32_t first_input;
+  uint32_t input_count;
+  uint32_t first_output;
+  uint32_t output_count;
+} gltf_cache_animation_sampler_t;
+
+typedef struct gltf_cache_animation_channel_t {
+  uint32_t path;
+  int32_t node;
+  uint32_t sampler_index;
+  uint32_t is_valid;
+} gltf_cache_animation_channel_t;
+
+static int32_t gltf_cache_texture_index(gltf_model_t* model,
+                                        gltf_texture_t* texture)
+{
+  if (texture == NULL) {
+    return GLTF_CACHE_NO_TEXTURE;
+  }
+  if (texture == model->empty_texture) {
+    return GLTF_CACHE_EMPTY_TEXTURE;
+  }
+  return (int32_t)(texture - model->textures);
+}
+
+static gltf_texture_t* gltf_cache_texture_from_index(gltf_model_t* model,
+                                                     int32_t index)
+{
+  if (index == GLTF_CACHE_EMPTY_TEXTURE) {
+    return model->empty_texture;
+  }
+  if (index < 0 || (uint32_t)index >= model->texture_count) {
+    return NULL;
+  }
+  return &model->textures[index];
+}
+
+static void gltf_cache_get_filename(const char* filename, char* cache_filename)
+{
+  file_get_cache_filename(WGPU_MODEL_CACHE_DIRECTORY, filename,
+                          GLTF_CACHE_FILE_EXTENSION, cache_filename, STRMAX);
+}
+
+/*
+ * Write the model in its final, converted form to the cache file
+ */
+static void gltf_model_write_cache(gltf_model_t* model, cgltf_data* data,
+                                   const char* cache_filename,
+                                   const gltf_cache_header_t* cache_header,
+                                   const gltf_vertex_t* vertices,
+                                   const uint32_t* indices)
+{
+  const void* section_data[CacheSection_COUNT] = {0};
+  uint64_t section_size[CacheSection_COUNT]    = {0};
+
+  // Count the variable length data
+  uint32_t child_count = 0, primitive_count = 0, joint_count = 0,
+           inverse_bind_matrix_count = 0, sampler_count = 0, input_count = 0,
+           output_count = 0, channel_count = 0;
+  uint64_t image_data_size = 0;
+  for (uint32_t i = 0; i < model->node_count; ++i) {
+    child_count += model->nodes[i].child_count;
+  }
+  for (uint32_t i = 0; i < model->mesh_count; ++i) {
+    primitive_count += model->meshes[i].primitive_count;
+  }
+  for (uint32_t i = 0; i < model->skin_count; ++i) {
+    joint_count += model->skins[i].current_joint_index;
+    inverse_bind_matrix_count += model->skins[i].inverse_bind_matrix_count;
+  }
+  for (uint32_t i = 0; i < model->animation_count; ++i) {
+    gltf_animation_t* animation = &model->animations[i];
+    sampler_count += animation->sampler_count;
+    channel_count += animation->channel_count;
+    for (uint32_t j = 0; j < animation->sampler_count; ++j) {
+      input_count += animation->samplers[j].input_count;
+      output_count += animation->samplers[j].outputs_vec4_count;
+    }
+  }
+  for (uint32_t i = 0; i < model->texture_count; ++i) {
+    cgltf_image* image = &data->images[i];
+    if (image->uri == NULL && image->buffer_view != NULL) {
+      image_data_size += image->buffer_view->size;
+    }
+  }
+
+  // External buffer files, data URIs are part of the model file
+  const uint32_t buffer_count = (uint32_t)data->buffers_count;
+  uint32_t buffer_file_count   = 0;
+  gltf_cache_buffer_file_t* buffer_files
+    = calloc(MAX(buffer_count, 1u), sizeof(*buffer_files));
+  for (uint32_t i = 0; i < buffer_count; ++i) {
+    const char* uri = data->buffers[i].uri;
+    if (uri == NULL || strncmp(uri, "data:", 5) == 0) {
+      continue;
+    }
+    char decoded_uri[STRMAX];
+    snprintf(decoded_uri, sizeof(decoded_uri), "%s", uri);
+    cgltf_decode_uri(decoded_uri);
+    gltf_cache_buffer_file_t* dest = &buffer_files[buffer_file_count];
+    get_relative_file_path(model->uri, decoded_uri, dest->path);
+    file_info_t info = {0};
+    if (!file_get_info(dest->path, &info)) {
+      // Without the info the cache could never be validated
+      free(buffer_files);
+      return;
+    }
+    dest->size              = info.size;
+    dest->modification_time = info.modification_time;
+    ++buffer_file_count;
+  }
+
+  gltf_cache_node_t* nodes
+    = calloc(MAX(model->node_count, 1u), sizeof(*nodes));
+  uint32_t* node_children  = calloc(MAX(child_count, 1u), sizeof(uint32_t));
+  uint32_t* linear_nodes   = calloc(MAX(model->linear_node_count, 1u),
+                                    sizeof(uint32_t));
+  gltf_cache_mesh_t* meshes
+    = calloc(MAX(model->mesh_count, 1u), sizeof(*meshes));
+  gltf_cache_primitive_t* primitives
+    = calloc(MAX(primitive_count, 1u), sizeof(*primitives));
+  gltf_cache_material_t* materials
+    = calloc(MAX(model->material_count, 1u), sizeof(*materials));
+  gltf_cache_image_t* images
+    = calloc(MAX(model->texture_count, 1u), sizeof(*images));
+  uint8_t* image_data = malloc(MAX(image_data_size, 1u));
+  gltf_cache_skin_t* skins
+    = calloc(MAX(model->skin_count, 1u), sizeof(*skins));
+  uint32_t* skin_joints = calloc(MAX(joint_count, 1u), sizeof(uint32_t));
+  mat4* inverse_bind_matrices
+    = calloc(MAX(inverse_bind_matrix_count, 1u), sizeof(mat4));
+  gltf_cache_animation_t* animations
+    = calloc(MAX(model->animation_count, 1u), sizeof(*animations));
+  gltf_cache_animation_sampler_t* samplers
+    = calloc(MAX(sampler_count, 1u), sizeof(*samplers));
+  float* inputs = calloc(MAX(input_count, 1u), sizeof(float));
+  vec4* outputs = calloc(MAX(output_count, 1u), sizeof(vec4));
+  gltf_cache_animation_channel_t* channels
+    = calloc(MAX(channel_count, 1u), sizeof(*channels));
+
+  // Node table
+  child_count = 0;
+  for (uint32_t i = 0; i < model->node_count; ++i) {
+    gltf_node_t* node       = &model->nodes[i];
+    gltf_cache_node_t* dest = &nodes[i];
+    dest->parent
+      = node->parent ? (int32_t)(node->parent - model->nodes) : -1;
+    dest->mesh = node->mesh ? (int32_t)(node->mesh - model->meshes) : -1;
+    dest->skin_index   = node->skin_index;
+    dest->index        = node->index;
+    dest->first_child  = child_count;
+    dest->child_count  = node->child_count;
+    dest->has_children = node->children != NULL;
+    glm_mat4_copy(node->matrix, dest->matrix);
+    glm_vec3_copy(node->translation, dest->translation);
+    glm_vec3_copy(node->scale, dest->scale);
+    glm_quat_copy(node->rotation, dest->rotation);
+    memcpy(dest->name, node->name, sizeof(dest->name));
+    for (uint32_t c = 0; c < node->child_count; ++c) {
+      node_children[child_count++]
+        = node->children[c] ? (uint32_t)(node->children[c] - model->nodes) :
+                              UINT32_MAX;
+    }
+  }
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    linear_nodes[i] = (uint32_t)(model->linear_nodes[i] - model->nodes);
+  }
+
+  // Meshes and primitives
+  primitive_count = 0;
+  for (uint32_t i = 0; i < model->mesh_count; ++i) {
+    gltf_mesh_t* mesh       = &model->meshes[i];
+    gltf_cache_mesh_t* dest = &meshes[i];
+    dest->initialized       = mesh->uniform_buffer.buffer != NULL;
+    dest->first_primitive   = primitive_count;
+    dest->primitive_count   = mesh->primitive_count;
+    glm_mat4_copy(mesh->uniform_block.matrix, dest->matrix);
+    dest->bb = mesh->bb;
+    memcpy(dest->name, mesh->name, sizeof(dest->name));
+    for (uint32_t p = 0; p < mesh->primitive_count; ++p) {
+      gltf_primitive_t* primitive       = &mesh->primitives[p];
+      gltf_cache_primitive_t* dest_prim = &primitives[primitive_count++];
+      dest_prim->first_index            = primitive->first_index;
+      dest_prim->index_count            = primitive->index_count;
+      dest_prim->first_vertex           = primitive->first_vertex;
+      dest_prim->vertex_count           = primitive->vertex_count;
+      dest_prim->has_indices            = primitive->has_indices;
+      dest_prim->bb                     = primitive->bb;
+      dest_prim->lod_count              = primitive->lod_count;
+      memcpy(dest_prim->lods, primitive->lods, sizeof(dest_prim->lods));
+      dest_prim->material
+        = primitive->material ?
+            (uint32_t)(primitive->material - model->materials) :
+            model->material_count - 1;
+    }
+  }
+
+  // Materials
+  for (uint32_t i = 0; i < model->material_count; ++i) {
+    gltf_material_t* material   = &model->materials[i];
+    gltf_cache_material_t* dest = &materials[i];
+    dest->alpha_mode            = (uint32_t)material->alpha_mode;
+    dest->blend                 = material->blend;
+    dest->double_sided          = material->double_sided;
+    dest->alpha_cutoff          = material->alpha_cutoff;
+    dest->metallic_factor       = material->metallic_factor;
+    dest->roughness_factor      = material->roughness_factor;
+    glm_vec4_copy(material->base_color_factor, dest->base_color_factor);
+    glm_vec4_copy(material->emissive_factor, dest->emissive_factor);
+    glm_vec4_copy(material->extension.diffuse_factor, dest->diffuse_factor);
+    glm_vec3_copy(material->extension.specular_factor, dest->specular_factor);
+    dest->base_color_texture
+      = gltf_cache_texture_index(model, material->base_color_texture);
+    dest->metallic_roughness_texture
+      = gltf_cache_texture_index(model, material->metallic_roughness_texture);
+    dest->normal_texture
+      = gltf_cache_texture_index(model, material->normal_texture);
+    dest->occlusion_texture
+      = gltf_cache_texture_index(model, material->occlusion_texture);
+    dest->emissive_texture
+      = gltf_cache_texture_index(model, material->emissive_texture);
+    dest->specular_glossiness_texture = gltf_cache_texture_index(
+      model, material->extension.specular_glossiness_texture);
+    dest->diffuse_texture
+      = gltf_cache_texture_index(model, material->extension.diffuse_texture);
+    memcpy(dest->tex_coord_sets, &material->tex_coord_sets,
+           sizeof(dest->tex_coord_sets));
+    dest->pbr_workflows[0] = material->pbr_workflows.metallic_roughness;
+    dest->pbr_workflows[1] = material->pbr_workflows.specular_glossiness;
+  }
+
+  // Images, the encoded image data of embedded images is stored in the cache
+  image_data_size = 0;
+  for (uint32_t i = 0; i < model->texture_count; ++i) {
+    cgltf_image* image       = &data->images[i];
+    gltf_cache_image_t* dest = &images[i];
+    if (image->uri != NULL) {
+      snprintf(dest->uri, sizeof(dest->uri), "%s", image->uri);
+    }
+    else if (image->buffer_view != NULL) {
+      dest->data_offset = image_data_size;
+      dest->data_size   = image->buffer_view->size;
+      memcpy(image_data + image_data_size,
+             gltf_buffer_view_data(image->buffer_view),
+             image->buffer_view->size);
+      image_data_size += image->buffer_view->size;
+    }
+  }
+
+  // Skins
+  joint_count = inverse_bind_matrix_count = 0;
+  for (uint32_t i = 0; i < model->skin_count; ++i) {
+    gltf_skin_t* skin       = &model->skins[i];
+    gltf_cache_skin_t* dest = &skins[i];
+    dest->skeleton_root
+      = skin->skeleton_root ? (int32_t)(skin->skeleton_root - model->nodes) :
+                              -1;
+    dest->joint_count               = skin->joint_count;
+    dest->first_joint               = joint_count;
+    dest->resolved_joint_count      = skin->current_joint_index;
+    dest->first_inverse_bind_matrix = inverse_bind_matrix_count;
+    dest->inverse_bind_matrix_count = skin->inverse_bind_matrix_count;
+    memcpy(dest->name, skin->name, sizeof(dest->name));
+    for (uint32_t j = 0; j < skin->current_joint_index; ++j) {
+      skin_joints[joint_count++] = (uint32_t)(skin->joints[j] - model->nodes);
+    }
+    if (skin->inverse_bind_matrix_count > 0) {
+      memcpy(inverse_bind_matrices[inverse_bind_matrix_count],
+             skin->inverse_bind_matrices,
+             skin->inverse_bind_matrix_count * sizeof(mat4));
+      inverse_bind_matrix_count += skin->inverse_bind_matrix_count;
+    }
+  }
+
+  // Animations
+  sampler_count = input_count = output_count = channel_count = 0;
+  for (uint32_t i = 0; i < model->animation_count; ++i) {
+    gltf_animation_t* animation  = &model->animations[i];
+    gltf_cache_animation_t* dest = &animations[i];
+    dest->start                  = animation->start;
+    dest->end                    = animation->end;
+    dest->first_sampler          = sampler_count;
+    dest->sampler_count          = animation->sampler_count;
+    dest->first_channel          = channel_count;
+    dest->channel_count          = animation->channel_count;
+    memcpy(dest->name, animation->name, sizeof(dest->name));
+    for (uint32_t j = 0; j < animation->sampler_count; ++j) {
+      gltf_animation_sampler_t* sampler = &animation->samplers[j];
+      gltf_cache_animation_sampler_t* dest_sampler
+        = &samplers[sampler_count++];
+      dest_sampler->interpolation = (uint32_t)sampler->interpolation;
+      dest_sampler->first_input   = input_count;
+      dest_sampler->input_count   = sampler->input_count;
+      dest_sampler->first_output  = output_count;
+      dest_sampler->output_count  = sampler->outputs_vec4_count;
+      if (sampler->input_count > 0) {
+        memcpy(&inputs[input_count], sampler->inputs,
+               sampler->input_count * sizeof(float));
+        input_count += sampler->input_count;
+      }
+      if (sampler->outputs_vec4_count > 0) {
+        memcpy(outputs[output_count], sampler->outputs_vec4,
+               sampler->outputs_vec4_count * sizeof(vec4));
+        output_count += sampler->outputs_vec4_count;
+      }
+    }
+    for (uint32_t j = 0; j < animation->channel_count; ++j) {
+      gltf_animation_channel_t* channel = &animation->channels[j];
+      gltf_cache_animation_channel_t* dest_channel
+        = &channels[channel_count++];
+      dest_channel->path = (uint32_t)channel->path;
+      dest_channel->node
+        = channel->node ? (int32_t)(channel->node - model->nodes) : -1;
+      dest_channel->sampler_index = channel->sampler_index;
+      dest_channel->is_valid      = channel->is_valid;
+    }
+  }
+
+#define GLTF_CACHE_SET_SECTION(section, ptr, count)                            \
+  section_data[section] = (ptr);                                               \
+  section_size[section] = (uint64_t)(count) * sizeof(*(ptr));
+  GLTF_CACHE_SET_SECTION(CacheSection_VERTICES, vertices,
+                         model->vertices.count)
+  GLTF_CACHE_SET_SECTION(CacheSection_INDICES, indices, model->indices.count)
+  GLTF_CACHE_SET_SECTION(CacheSection_NODES, nodes, model->node_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_NODE_CHILDREN, node_children,
+                         child_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_LINEAR_NODES, linear_nodes,
+                         model->linear_node_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_MESHES, meshes, model->mesh_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_PRIMITIVES, primitives, primitive_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_MATERIALS, materials,
+                         model->material_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_IMAGES, images, model->texture_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_IMAGE_DATA, image_data, image_data_size)
+  GLTF_CACHE_SET_SECTION(CacheSection_TEXTURE_SAMPLERS, model->texture_samplers,
+                         model->texture_sampler_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_SKINS, skins, model->skin_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_SKIN_JOINTS, skin_joints, joint_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_INVERSE_BIND_MATRICES,
+                         inverse_bind_matrices, inverse_bind_matrix_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_ANIMATIONS, animations,
+                         model->animation_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_ANIMATION_SAMPLERS, samplers,
+                         sampler_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_ANIMATION_INPUTS, inputs, input_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_ANIMATION_OUTPUTS, outputs, output_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_ANIMATION_CHANNELS, channels,
+                         channel_count)
+  GLTF_CACHE_SET_SECTION(CacheSection_BUFFER_FILES, buffer_files,
+                         buffer_file_count)
+#undef GLTF_CACHE_SET_SECTION
+
+  // Lay out the sections
+  gltf_cache_header_t header = *cache_header;
+  uint64_t offset            = sizeof(header);
+  for (uint32_t i = 0; i < CacheSection_COUNT; ++i) {
+    offset = (offset + GLTF_CACHE_SECTION_ALIGNMENT - 1)
+             & ~(uint64_t)(GLTF_CACHE_SECTION_ALIGNMENT - 1);
+    header.sections[i].offset = offset;
+    header.sections[i].size   = section_size[i];
+    offset += section_size[i];
+  }
+
+  // Write to a temporary file first so that an interrupted write never leaves
+  // a truncated cache file behind
+  char tmp_filename[STRMAX];
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", cache_filename);
+  FILE* file = fopen(tmp_filename, "wb");
+  bool ok    = file != NULL;
+  if (ok) {
+    static const uint8_t padding[GLTF_CACHE_SECTION_ALIGNMENT] = {0};
+    uint64_t position = sizeof(header);
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (uint32_t i = 0; ok && i < CacheSection_COUNT; ++i) {
+      const uint64_t padding_size = header.sections[i].offset - position;
+      ok = fwrite(padding, 1, padding_size, file) == padding_size;
+      if (ok && section_size[i] > 0) {
+        ok = fwrite(section_data[i], 1, section_size[i], file)
+             == section_size[i];
+      }
+      position = header.sections[i].offset + section_size[i];
+    }
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && (rename(tmp_filename, cache_filename) == 0);
+    if (!ok) {
+      remove(tmp_filename);
+    }
+  }
+  if (!ok) {
+    log_warn("Could not write glTF cache file: %s\n", cache_filename);
+  }
+
+  free(nodes);
+  free(node_children);
+  free(linear_nodes);
+  free(meshes);
+  free(primitives);
+  free(materials);
+  free(images);
+  free(image_data);
+  free(skins);
+  free(skin_joints);
+  free(inverse_bind_matrices);
+  free(animations);
+  free(samplers);
+  free(inputs);
+  free(outputs);
+  free(channels);
+  free(buffer_files);
+}
+
+/*
+ * Returns a pointer to the data of a cache section and its element count
+ */
+static const void* gltf_cache_get_section(const file_mapping_t* mapping,
+                                          cache_section_enum section,
+                                          size_t element_size, uint32_t* count)
+{
+  const gltf_cache_header_t* header = (const gltf_cache_header_t*)mapping->data;
+  *count = (uint32_t)(header->sections[section].size / element_size);
+  return mapping->data + header->sections[section].offset;
+}
+
+static bool gltf_cache_is_valid(const file_mapping_t* mapping,
+                                const gltf_cache_header_t* expected_header)
+{
+  if (mapping->data == NULL || mapping->size < sizeof(gltf_cache_header_t)) {
+    return false;
+  }
+  const gltf_cache_header_t* header = (const gltf_cache_header_t*)mapping->data;
+  if (header->magic != expected_header->magic
+      || header->version != expected_header->version
+      || header->source_size != expected_header->source_size
+      || header->source_modification_time
+           != expected_header->source_modification_time
+      || header->file_loading_flags != expected_header->file_loading_flags
+      || header->scale != expected_header->scale
+      || header->vertex_size != expected_header->vertex_size
+      || header->section_count != expected_header->section_count) {
+    return false;
+  }
+  for (uint32_t i = 0; i < CacheSection_COUNT; ++i) {
+    const gltf_cache_section_t* section = &header->sections[i];
+    if (section->offset % GLTF_CACHE_SECTION_ALIGNMENT != 0
+        || section->offset > mapping->size
+        || section->size > mapping->size - section->offset) {
+      return false;
+    }
+  }
+
+  // The external buffers of the model are unchanged
+  uint32_t buffer_file_count                   = 0;
+  const gltf_cache_buffer_file_t* buffer_files = gltf_cache_get_section(
+    mapping, CacheSection_BUFFER_FILES, sizeof(gltf_cache_buffer_file_t),
+    &buffer_file_count);
+  for (uint32_t i = 0; i < buffer_file_count; ++i) {
+    file_info_t info = {0};
+    if (!file_get_info(buffer_files[i].path, &info)
+        || info.size != buffer_files[i].size
+        || info.modification_time != buffer_files[i].modification_time) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Rebuild the model from its cache file, returns NULL if there is no valid
+ * cache for the model
+ */
+static gltf_model_t*
+gltf_model_load_from_cache(struct wgpu_gltf_model_load_options_t* load_options,
+                           const char* cache_filename,
+                           const gltf_cache_header_t* cache_header)
+{
+  file_mapping_t mapping = {0};
+  if (!file_exists(cache_filename) || !file_map(cache_filename, &mapping)) {
+    return NULL;
+  }
+  if (!gltf_cache_is_valid(&mapping, cache_header)) {
+    file_unmap(&mapping);
+    return NULL;
+  }
+
+  uint32_t vertex_count = 0, index_count = 0, node_count = 0, child_count = 0,
+           linear_node_count = 0, mesh_count = 0, primitive_count = 0,
+           material_count = 0, image_count = 0, image_data_size = 0,
+           texture_sampler_count = 0, skin_count = 0, joint_count = 0,
+           inverse_bind_matrix_count = 0, animation_count = 0,
+           sampler_count = 0, input_count = 0, output_count = 0,
+           channel_count = 0;
+  const gltf_vertex_t* vertices = gltf_cache_get_section(
+    &mapping, CacheSection_VERTICES, sizeof(gltf_vertex_t), &vertex_count);
+  const uint32_t* indices = gltf_cache_get_section(
+    &mapping, CacheSection_INDICES, sizeof(uint32_t), &index_count);
+  const gltf_cache_node_t* nodes = gltf_cache_get_section(
+    &mapping, CacheSection_NODES, sizeof(gltf_cache_node_t), &node_count);
+  const uint32_t* node_children = gltf_cache_get_section(
+    &mapping, CacheSection_NODE_CHILDREN, sizeof(uint32_t), &child_count);
+  const uint32_t* linear_nodes = gltf_cache_get_section(
+    &mapping, CacheSection_LINEAR_NODES, sizeof(uint32_t), &linear_node_count);
+  const gltf_cache_mesh_t* meshes = gltf_cache_get_section(
+    &mapping, CacheSection_MESHES, sizeof(gltf_cache_mesh_t), &mesh_count);
+  const gltf_cache_primitive_t* primitives
+    = gltf_cache_get_section(&mapping, CacheSection_PRIMITIVES,
+                             sizeof(gltf_cache_primitive_t), &primitive_count);
+  const gltf_cache_material_t* materials
+    = gltf_cache_get_section(&mapping, CacheSection_MATERIALS,
+                             sizeof(gltf_cache_material_t), &material_count);
+  const gltf_cache_image_t* images = gltf_cache_get_section(
+    &mapping, CacheSection_IMAGES, sizeof(gltf_cache_image_t), &image_count);
+  const uint8_t* image_data = gltf_cache_get_section(
+    &mapping, CacheSection_IMAGE_DATA, sizeof(uint8_t), &image_data_size);
+  const gltf_texture_sampler_t* texture_samplers = gltf_cache_get_section(
+    &mapping, CacheSection_TEXTURE_SAMPLERS, sizeof(gltf_texture_sampler_t),
+    &texture_sampler_count);
+  const gltf_cache_skin_t* skins = gltf_cache_get_section(
+    &mapping, CacheSection_SKINS, sizeof(gltf_cache_skin_t), &skin_count);
+  const uint32_t* skin_joints = gltf_cache_get_section(
+    &mapping, CacheSection_SKIN_JOINTS, sizeof(uint32_t), &joint_count);
+  const mat4* inverse_bind_matrices
+    = gltf_cache_get_section(&mapping, CacheSection_INVERSE_BIND_MATRICES,
+                             sizeof(mat4), &inverse_bind_matrix_count);
+  const gltf_cache_animation_t* animations
+    = gltf_cache_get_section(&mapping, CacheSection_ANIMATIONS,
+                             sizeof(gltf_cache_animation_t), &animation_count);
+  const gltf_cache_animation_sampler_t* samplers = gltf_cache_get_section(
+    &mapping, CacheSection_ANIMATION_SAMPLERS,
+    sizeof(gltf_cache_animation_sampler_t), &sampler_count);
+  const float* inputs = gltf_cache_get_section(
+    &mapping, CacheSection_ANIMATION_INPUTS, sizeof(float), &input_count);
+  const vec4* outputs = gltf_cache_get_section(
+    &mapping, CacheSection_ANIMATION_OUTPUTS, sizeof(vec4), &output_count);
+  const gltf_cache_animation_channel_t* channels = gltf_cache_get_section(
+    &mapping, CacheSection_ANIMATION_CHANNELS,
+    sizeof(gltf_cache_animation_channel_t), &channel_count);
+
+  if (vertex_count == 0 || index_count == 0 || material_count == 0) {
+    file_unmap(&mapping);
+    return NULL;
+  }
+
+  gltf_model_t* model = calloc(1, sizeof(gltf_model_t));
+  gltf_model_init(model, load_options);
+
+  // Samplers and images
+  if (!(load_options->file_loading_flags
+        & WGPU_GLTF_FileLoadingFlags_DontLoadImages)) {
+    model->texture_sampler_count = texture_sampler_count;
+    model->texture_samplers
+      = texture_sampler_count > 0 ?
+          calloc(texture_sampler_count, sizeof(*model->texture_samplers)) :
+          NULL;
+    if (texture_sampler_count > 0) {
+      memcpy(model->texture_samplers, texture_samplers,
+             texture_sampler_count * sizeof(*model->texture_samplers));
+    }
+    model->texture_count = image_count;
+    model->textures
+      = image_count > 0 ? calloc(image_count, sizeof(*model->textures)) : NULL;
+    const uint32_t alloc_count     = MAX(image_count, 1u);
+    wgpu_texture_source_t* sources = calloc(alloc_count, sizeof(*sources));
+    char(*image_uris)[STRMAX]      = calloc(alloc_count, sizeof(*image_uris));
+    for (uint32_t i = 0; i < image_count; ++i) {
+      const gltf_cache_image_t* image = &images[i];
+      gltf_texture_init(&model->textures[i], model->wgpu_context);
+      if (image->uri[0] != '\0') {
+        sources[i]
+          = gltf_texture_source(model->uri, image->uri, NULL, 0,
+                                gltf_model_get_texture_usage(model),
+                                image_uris[i]);
+      }
+      else if (image->data_size > 0
+               && image->data_offset + image->data_size <= image_data_size) {
+        sources[i] = gltf_texture_source(
+          model->uri, NULL, image_data + image->data_offset,
+          (size_t)image->data_size, gltf_model_get_texture_usage(model),
+          image_uris[i]);
+      }
+    }
+    gltf_model_set_texture_compression(model, sources, image_count);
+    gltf_model_acquire_shared_textures(model, sources, image_count);
+    wgpu_texture_batch_t* batch
+      = wgpu_texture_batch_begin(model->wgpu_context, image_count, sources);
+    free(sources);
+    free(image_uris);
+    gltf_model_finish_images(model, batch);
+  }
+
+  // Materials
+  model->material_count = material_count;
+  model->materials      = calloc(material_count, sizeof(*model->materials));
+  for (uint32_t i = 0; i < material_count; ++i) {
+    const gltf_cache_material_t* src = &materials[i];
+    gltf_material_t* material        = &model->materials[i];
+    gltf_material_init(material, model->wgpu_context);
+    material->index            = i;
+    material->alpha_mode       = (alpha_mode_enum)src->alpha_mode;
+    material->blend            = src->blend;
+    material->double_sided     = src->double_sided;
+    material->alpha_cutoff     = src->alpha_cutoff;
+    material->metallic_factor  = src->metallic_factor;
+    material->roughness_factor = src->roughness_factor;
+    glm_vec4_copy((float*)src->base_color_factor, material->base_color_factor);
+    glm_vec4_copy((float*)src->emissive_factor, material->emissive_factor);
+    glm_vec4_copy((float*)src->diffuse_factor,
+                  material->extension.diffuse_factor);
+    glm_vec3_copy((float*)src->specular_factor,
+                  material->extension.specular_factor);
+    material->base_color_texture
+      = gltf_cache_texture_from_index(model, src->base_color_texture);
+    material->metallic_roughness_texture
+      = gltf_cache_texture_from_index(model, src->metallic_roughness_texture);
+    material->normal_texture
+      = gltf_cache_texture_from_index(model, src->normal_texture);
+    material->occlusion_texture
+      = gltf_cache_texture_from_index(model, src->occlusion_texture);
+    material->emissive_texture
+      = gltf_cache_texture_from_index(model, src->emissive_texture);
+    material->extension.specular_glossiness_texture
+      = gltf_cache_texture_from_index(model, src->specular_glossiness_texture);
+    material->extension.diffuse_texture
+      = gltf_cache_texture_from_index(model, src->diffuse_texture);
+    memcpy(&material->tex_coord_sets, src->tex_coord_sets,
+           sizeof(src->tex_coord_sets));
+    material->pbr_workflows.metallic_roughness  = src->pbr_workflows[0];
+    material->pbr_workflows.specular_glossiness = src->pbr_workflows[1];
+  }
+  gltf_model_pack_material_textures(model);
+  gltf_model_create_material_table(model);
+
+  // Meshes
+  model->mesh_count = mesh_count;
+  model->meshes     = calloc(MAX(mesh_count, 1u), sizeof(gltf_mesh_t));
+  for (uint32_t i = 0; i < mesh_count; ++i) {
+    const gltf_cache_mesh_t* src = &meshes[i];
+    gltf_mesh_t* mesh            = &model->meshes[i];
+    if (!src->initialized) {
+      continue;
+    }
+    gltf_mesh_init(mesh, model->wgpu_context, model->uniform_buffer_pool,
+                   (vec4*)src->matrix);
+    memcpy(mesh->name, src->name, sizeof(mesh->name));
+    mesh->bb              = src->bb;
+    mesh->primitive_count = src->primitive_count;
+    mesh->primitives
+      = src->primitive_count > 0 ?
+          calloc(src->primitive_count, sizeof(*mesh->primitives)) :
+          NULL;
+    for (uint32_t p = 0; p < src->primitive_count
+                         && src->first_primitive + p < primitive_count;
+         ++p) {
+      const gltf_cache_primitive_t* src_prim
+        = &primitives[src->first_primitive + p];
+      gltf_primitive_t* primitive = &mesh->primitives[p];
+      primitive->first_index      = src_prim->first_index;
+      primitive->index_count      = src_prim->index_count;
+      primitive->first_vertex     = src_prim->first_vertex;
+      primitive->vertex_count     = src_prim->vertex_count;
+      primitive->has_indices      = src_prim->has_indices;
+      primitive->bb               = src_prim->bb;
+      primitive->material
+        = &model->materials[MIN(src_prim->material, material_count - 1)];
+      // Levels of detail outside of the index buffer are dropped
+      primitive->lods[0] = (gltf_primitive_lod_t){
+        .first_index = primitive->first_index,
+        .index_count = primitive->index_count,
+      };
+      primitive->lod_count = 1;
+      for (uint32_t l = 1; l < MIN(src_prim->lod_count, GLTF_MAX_LOD_COUNT);
+           ++l) {
+        const gltf_primitive_lod_t* lod = &src_prim->lods[l];
+        if ((uint64_t)lod->first_index + lod->index_count > index_count) {
+          break;
+        }
+        primitive->lods[primitive->lod_count++] = *lod;
+      }
+    }
+  }
+
+  // Nodes
+  model->node_count   = node_count;
+  model->nodes        = calloc(MAX(node_count, 1u), sizeof(gltf_node_t));
+  model->linear_nodes = calloc(MAX(node_count, 1u), sizeof(gltf_node_t*));
+  for (uint32_t i = 0; i < node_count; ++i) {
+    const gltf_cache_node_t* src = &nodes[i];
+    gltf_node_t* node            = &model->nodes[i];
+    node->parent = (src->parent >= 0 && (uint32_t)src->parent < node_count) ?
+                     &model->nodes[src->parent] :
+                     NULL;
+    node->mesh = (src->mesh >= 0 && (uint32_t)src->mesh < mesh_count) ?
+                   &model->meshes[src->mesh] :
+                   NULL;
+    node->index      = src->index;
+    node->skin_index = src->skin_index;
+    glm_mat4_copy((vec4*)src->matrix, node->matrix);
+    glm_vec3_copy((float*)src->translation, node->translation);
+    glm_vec3_copy((float*)src->scale, node->scale);
+    glm_quat_copy((float*)src->rotation, node->rotation);
+    glm_mat4_identity(node->world_matrix);
+    node->dirty = true;
+    memcpy(node->name, src->name, sizeof(node->name));
+    if (src->has_children) {
+      node->child_count = src->child_count;
+      node->children
+        = calloc(MAX(src->child_count, 1u), sizeof(*node->children));
+      for (uint32_t c = 0; c < src->child_count
+                           && src->first_child + c < child_count;
+           ++c) {
+        const uint32_t child = node_children[src->first_child + c];
+        node->children[c]    = child < node_count ? &model->nodes[child] : NULL;
+      }
+      node->current_child_index = src->child_count;
+    }
+  }
+  for (uint32_t i = 0; i < linear_node_count; ++i) {
+    if (linear_nodes[i] < node_count) {
+      model->linear_nodes[model->linear_node_count++]
+        = &model->nodes[linear_nodes[i]];
+    }
+  }
+
+  // Skins
+  model->skin_count = skin_count;
+  model->skins
+    = skin_count > 0 ? calloc(skin_count, sizeof(*model->skins)) : NULL;
+  for (uint32_t i = 0; i < skin_count; ++i) {
+    const gltf_cache_skin_t* src = &skins[i];
+    gltf_skin_t* skin            = &model->skins[i];
+    memcpy(skin->name, src->name, sizeof(skin->name));
+    if (src->skeleton_root >= 0 && (uint32_t)src->skeleton_root < node_count) {
+      skin->skeleton_root = &model->nodes[src->skeleton_root];
+    }
+    skin->joint_count = src->joint_count;
+    skin->joints
+      = src->joint_count > 0 ? calloc(src->joint_count, sizeof(*skin->joints)) :
+                               NULL;
+    for (uint32_t j = 0; j < src->resolved_joint_count && j < src->joint_count
+                         && src->first_joint + j < joint_count;
+         ++j) {
+      const uint32_t joint = skin_joints[src->first_joint + j];
+      if (joint < node_count) {
+        skin->joints[skin->current_joint_index++] = &model->nodes[joint];
+      }
+    }
+    if (src->inverse_bind_matrix_count > 0
+        && src->first_inverse_bind_matrix + src->inverse_bind_matrix_count
+             <= inverse_bind_matrix_count) {
+      skin->inverse_bind_matrix_count = src->inverse_bind_matrix_count;
+      skin->inverse_bind_matrices
+        = malloc(skin->inverse_bind_matrix_count * sizeof(mat4));
+      memcpy(skin->inverse_bind_matrices,
+             inverse_bind_matrices[src->first_inverse_bind_matrix],
+             skin->inverse_bind_matrix_count * sizeof(mat4));
+    }
+  }
+
+  // Animations
+  model->animation_count = animation_count;
+  model->animations
+    = animation_count > 0 ?
+        calloc(animation_count, sizeof(*model->animations)) :
+        NULL;
+  for (uint32_t i = 0; i < animation_count; ++i) {
+    const gltf_cache_animation_t* src = &animations[i];
+    gltf_animation_t* animation       = &model->animations[i];
+    gltf_animation_init(animation);
+    memcpy(animation->name, src->name, sizeof(animation->name));
+    animation->start = src->start;
+    animation->end   = src->end;
+
+    // Samplers
+    if (src->first_sampler + src->sampler_count <= sampler_count) {
+      animation->sampler_count = src->sampler_count;
+    }
+    animation->samplers
+      = animation->sampler_count > 0 ?
+          calloc(animation->sampler_count, sizeof(*animation->samplers)) :
+          NULL;
+    for (uint32_t j = 0; j < animation->sampler_count; ++j) {
+      const gltf_cache_animation_sampler_t* src_sampler
+        = &samplers[src->first_sampler + j];
+      gltf_animation_sampler_t* sampler = &animation->samplers[j];
+      gltf_animation_sampler_init(sampler);
+      sampler->interpolation
+        = (interpolation_type_enum)src_sampler->interpolation;
+      if (src_sampler->input_count > 0
+          && src_sampler->first_input + src_sampler->input_count
+               <= input_count) {
+        sampler->input_count = src_sampler->input_count;
+        sampler->inputs = malloc(sampler->input_count * sizeof(float));
+        memcpy(sampler->inputs, &inputs[src_sampler->first_input],
+               sampler->input_count * sizeof(float));
+      }
+      if (src_sampler->output_count > 0
+          && src_sampler->first_output + src_sampler->output_count
+               <= output_count) {
+        sampler->outputs_vec4_count = src_sampler->output_count;
+        sampler->outputs_vec4
+          = malloc(sampler->outputs_vec4_count * sizeof(vec4));
+        memcpy(sampler->outputs_vec4, outputs[src_sampler->first_output],
+               sampler->outputs_vec4_count * sizeof(vec4));
+      }
+    }
+
+    // Channels
+    if (src->first_channel + src->channel_count <= channel_count) {
+      animation->channel_count = src->channel_count;
+    }
+    animation->channels
+      = calloc(MAX(animation->channel_count, 1u), sizeof(*animation->channels));
+    for (uint32_t j = 0; j < animation->channel_count; ++j) {
+      const gltf_cache_animation_channel_t* src_channel
+        = &channels[src->first_channel + j];
+      gltf_animation_channel_t* channel = &animation->channels[j];
+      gltf_animation_channel_init(channel);
+      channel->path          = (path_type_enum)src_channel->path;
+      channel->sampler_index = src_channel->sampler_index;
+      channel->node
+        = (src_channel->node >= 0 && (uint32_t)src_channel->node < node_count) ?
+            &model->nodes[src_channel->node] :
+            NULL;
+      channel->is_valid = src_channel->is_valid && channel->node != NULL
+                          && channel->sampler_index < animation->sampler_count;
+    }
+  }
+
+  gltf_model_setup_skins_and_pose(model);
+
+  // Vertex and index buffers straight from the mapped cache file
+  model->vertices.count = vertex_count;
+  model->indices.count  = index_count;
+  gltf_model_create_buffers(model, vertices, indices);
+  gltf_model_build_draw_list(model);
+  gltf_model_prepare_gpu_culling(model);
+
+  // Get scene dimensions
+  gltf_model_get_scene_dimensions(model);
+
+  file_unmap(&mapping);
+
+  return model;
+}
+
+static gltf_model_t*
+gltf_model_load_from_file(struct wgpu_gltf_model_load_options_t* load_options)
+{
+  uint32_t file_loading_flags = load_options->file_loading_flags;
+
+  // Model cache
+  const bool use_cache
+    = file_loading_flags & WGPU_GLTF_FileLoadingFlags_UseCache;
+  char cache_filename[STRMAX]      = {0};
+  gltf_cache_header_t cache_header = {0};
+  if (use_cache) {
+    file_info_t source_info = {0};
+    if (file_get_info(load_options->filename, &source_info)) {
+      cache_header = (gltf_cache_header_t){
+        .magic                    = GLTF_CACHE_MAGIC,
+        .version                  = GLTF_CACHE_VERSION,
+        .source_size              = source_info.size,
+        .source_modification_time = source_info.modification_time,
+        .file_loading_flags       = file_loading_flags,
+        .scale                    = load_options->scale,
+        .vertex_size              = (uint32_t)sizeof(gltf_vertex_t),
+        .section_count            = CacheSection_COUNT,
+      };
+      gltf_cache_get_filename(load_options->filename, cache_filename);
+      gltf_model_t* cached_model = gltf_model_load_from_cache(
+        load_options, cache_filename, &cache_header);
+      if (cached_model != NULL) {
+        return cached_model;
+      }
+    }
+  }
+
+  gltf_model_t* gltf_model = NULL;
+
+  gltf_file_mappings_t file_mappings = {0};
+  cgltf_options options               = {
+    .file = {
+      .read      = gltf_file_map_read,
+      .release   = gltf_file_map_release,
+      .user_data = &file_mappings,
+    },
+  };
+  cgltf_data* gltf_data = NULL;
+  cgltf_result result
+    = cgltf_parse_file(&options, load_options->filename, &gltf_data);
+
+  // Vertex buffer & Index buffer
+  gltf_vertex_t* vertices = NULL;
+  uint32_t* indices       = NULL;
+
+  if (result == cgltf_result_success) {
+    cgltf_result buffers_result
+      = cgltf_load_buffers(&options, gltf_data, load_options->filename);
+    gltf_check_required_extensions(gltf_data, load_options->filename);
+
+    if (buffers_result == cgltf_result_success
+        && !gltf_decode_meshopt_buffer_views(gltf_data)) {
+      log_error("Could not decode gltf file: %s\n", load_options->filename);
+      cgltf_free(gltf_data);
+      free(file_mappings.items);
+      return NULL;
+    }
+    if (buffers_result == cgltf_result_success) {
+      gltf_model = calloc(1, sizeof(gltf_model_t));
+      gltf_model_init(gltf_model, load_options);
+
+      // Load samplers and start decoding the images, which runs on the job
+      // system while the nodes and meshes are loaded
+      wgpu_texture_batch_t* image_batch = NULL;
+      if (!(file_loading_flags & WGPU_GLTF_FileLoadingFlags_DontLoadImages)) {
+        gltf_model_load_texture_samplers(gltf_model, gltf_data);
+        image_batch = gltf_model_load_images(gltf_model, gltf_data);
+      }
+
+      // Load materials
+      gltf_model_load_materials(gltf_model, gltf_data);
+
+      // If there is no default scene specified, then the default is the first
+      // one. It is not an error for a glTF file to have zero scenes.
+      const cgltf_scene* scene
+        = gltf_data->scene ? gltf_data->scene : gltf_data->scenes;
+      if (!scene) {
+        if (image_batch != NULL) {
+          gltf_model_finish_images(gltf_model, image_batch);
+        }
+        return NULL;
+      }
+
+      // Vertex buffer & Index buffer, allocated once for all primitives
+      gltf_geometry_build_t geometry = {0};
+      for (cgltf_size i = 0, len = scene->nodes_count; i < len; ++i) {
+        gltf_geometry_build_count(&geometry, scene->nodes[i]);
+      }
+      gltf_geometry_build_alloc(&geometry);
+
+      // Nodes and meshes
+      gltf_model->node_count = (uint32_t)gltf_data->nodes_count;
+      gltf_model->nodes = calloc(gltf_model->node_count, sizeof(gltf_node_t));
+
+      gltf_model->linear_nodes
+        = calloc(gltf_model->node_count, sizeof(gltf_node_t*));
+
+      gltf_model->mesh_count = (uint32_t)gltf_data->meshes_count;
       gltf_model->meshes = calloc(gltf_model->mesh_count, sizeof(gltf_mesh_t));
 
-      // Recursively create all nodes.
-      for (cgltf_size i = 0, len = scene->nodes_count; i < len; ++i) {
-        gltf_model_load_node(gltf_model, NULL, scene->nodes[i], gltf_data,
-                             &vertices, &gltf_model->vertices.count, &indices,
-                             &gltf_model->indices.count, load_options->scale);
+      // Recursively create all nodes.
+      for (cgltf_size i = 0, len = scene->nodes_count; i < len; ++i) {
+        gltf_model_load_node(gltf_model, NULL, scene->nodes[i], gltf_data,
+                             &geometry, load_options->scale);
+      }
+
+      // Convert the vertices and indices of the primitives concurrently
+      gltf_geometry_build_run(&geometry);
+      vertices                   = geometry.vertices;
+      indices                    = geometry.indices;
+      gltf_model->vertices.count = geometry.vertex_count;
+      gltf_model->indices.count  = geometry.index_count;
+      free(geometry.primitives);
+
+      // Morph targets are evaluated by the compute skinning, pre-transformed
+      // vertices are static
+      if (gltf_model->compute_skinning.enabled
+          && !gltf_model->culling.pre_transformed) {
+        gltf_model_load_morph_targets(gltf_model, gltf_data);
+      }
+
+      // Load animations
+      if (gltf_data->animations_count > 0) {
+        gltf_model_load_animations(gltf_model, gltf_data);
+      }
+
+      // Load skins
+      gltf_model_load_skins(gltf_model, gltf_data);
+
+      // Assign skins and initial pose
+      gltf_model_setup_skins_and_pose(gltf_model);
+
+      // Join the image decoding, then upload the textures and pack them with
+      // the materials
+      if (image_batch != NULL) {
+        gltf_model_finish_images(gltf_model, image_batch);
+      }
+      gltf_model_pack_material_textures(gltf_model);
+      gltf_model_create_material_table(gltf_model);
+
+      // Reorder the triangles and generate the levels of detail, the result
+      // is stored in the cache
+      gltf_model_optimize_indices(gltf_model, vertices, indices);
+      if (file_loading_flags & WGPU_GLTF_FileLoadingFlags_GenerateLods) {
+        gltf_model_generate_lods(gltf_model, vertices, &indices,
+                                 &gltf_model->indices.count);
+      }
+    }
+  }
+  else {
+    log_error("Could not load gltf file: %s, error: %d\n",
+              load_options->filename, result);
+    return NULL;
+  }
+
+  ASSERT(gltf_model != NULL);
+
+  // Pre-Calculations for requested features
+  if ((file_loading_flags & WGPU_GLTF_FileLoadingFlags_PreTransformVertices)
+      || (file_loading_flags
+          & WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors)
+      || (file_loading_flags & WGPU_GLTF_FileLoadingFlags_FlipY)) {
+    const bool preTransform
+      = file_loading_flags & WGPU_GLTF_FileLoadingFlags_PreTransformVertices;
+    const bool preMultiplyColor
+      = file_loading_flags & WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors;
+    const bool flipY = file_loading_flags & WGPU_GLTF_FileLoadingFlags_FlipY;
+    for (uint32_t n = 0; n < gltf_model->linear_node_count; ++n) {
+      gltf_node_t* node = gltf_model->linear_nodes[n];
+      if (node->mesh != NULL) {
+        mat4 local_matrix = GLM_MAT4_ZERO_INIT;
+        glm_mat4_copy(node->world_matrix, local_matrix);
+        for (uint32_t p = 0; p < node->mesh->primitive_count; ++p) {
+          gltf_primitive_t* primitive = &node->mesh->primitives[p];
+          for (uint32_t i = 0; i < primitive->vertex_count; ++i) {
+            gltf_vertex_t* vertex = &vertices[primitive->first_vertex + i];
+            // Pre-transform vertex positions by node-hierarchy
+            if (preTransform) {
+              // Vertex position
+              vec4 vertex_pos_tmp = GLM_VEC4_ZERO_INIT;
+              glm_vec4(vertex->pos, 1.0f, vertex_pos_tmp);
+              glm_mat4_mulv(local_matrix, vertex_pos_tmp, vertex_pos_tmp);
+              glm_vec3(vertex_pos_tmp, vertex->pos);
+              // Vertex normal
+              mat3 local_matrix_tmp = GLM_MAT3_ZERO_INIT;
+              glm_mat4_pick3(local_matrix, local_matrix_tmp);
+              vec3 mulv_result;
+              glm_mat3_mulv(local_matrix_tmp, vertex->normal, mulv_result);
+              glm_normalize_to(mulv_result, vertex->normal);
+            }
+            // Flip Y-Axis of vertex positions
+            if (flipY) {
+              vertex->pos[1] *= -1.0f;
+              vertex->normal[1] *= -1.0f;
+            }
+            // Pre-Multiply vertex colors with material base color
+            if (preMultiplyColor) {
+              glm_vec4_mul(primitive->material->base_color_factor,
+                           vertex->color, vertex->color);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Vertex and index buffers
+  gltf_model_create_buffers(gltf_model, vertices, indices);
+  gltf_model_build_draw_list(gltf_model);
+  gltf_model_prepare_gpu_culling(gltf_model);
+
+  // Store the converted model for the next load
+  // The cache has no morph targets, such models are always loaded from glTF
+  if (use_cache && cache_header.magic == GLTF_CACHE_MAGIC
+      && gltf_model->morph_targets.weight_count == 0) {
+    gltf_model_write_cache(gltf_model, gltf_data, cache_filename,
+                           &cache_header, vertices, indices);
+  }
+
+  if (vertices != NULL) {
+    free(vertices);
+  }
+  if (indices != NULL) {
+    free(indices);
+  }
+
+  // Get scene dimensions
+  gltf_model_get_scene_dimensions(gltf_model);
+
+  // Cleanup
+  cgltf_free(gltf_data);
+  free(file_mappings.items);
+
+  return gltf_model;
+}
+
+gltf_model_t* wgpu_gltf_model_load_from_file(
+  struct wgpu_gltf_model_load_options_t* load_options)
+{
+  PROFILE_BEGIN("wgpu_gltf_model_load_from_file");
+  gltf_model_t* gltf_model = gltf_model_load_from_file(load_options);
+  PROFILE_END();
+  return gltf_model;
+}
+
+/*
+ * Render pass or render bundle encoder the draw list is recorded to
+ */
+typedef struct gltf_draw_encoder_t {
+  WGPURenderPassEncoder rpass_enc;
+  WGPURenderBundleEncoder bundle_enc;
+} gltf_draw_encoder_t;
+
+static void gltf_draw_encoder_set_pipeline(gltf_draw_encoder_t* encoder,
+                                           WGPURenderPipeline pipeline)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderSetPipeline(encoder->bundle_enc, pipeline);
+  }
+  else {
+    wgpuRenderPassEncoderSetPipeline(encoder->rpass_enc, pipeline);
+  }
+}
+
+static void gltf_draw_encoder_set_bind_group(gltf_draw_encoder_t* encoder,
+                                             uint32_t group_index,
+                                             WGPUBindGroup bind_group)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderSetBindGroup(encoder->bundle_enc, group_index,
+                                        bind_group, 0, 0);
+  }
+  else {
+    wgpuRenderPassEncoderSetBindGroup(encoder->rpass_enc, group_index,
+                                      bind_group, 0, 0);
+  }
+}
+
+static void gltf_draw_encoder_set_dynamic_bind_group(
+  gltf_draw_encoder_t* encoder, uint32_t group_index, WGPUBindGroup bind_group,
+  uint32_t dynamic_offset)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderSetBindGroup(encoder->bundle_enc, group_index,
+                                        bind_group, 1, &dynamic_offset);
+  }
+  else {
+    wgpuRenderPassEncoderSetBindGroup(encoder->rpass_enc, group_index,
+                                      bind_group, 1, &dynamic_offset);
+  }
+}
+
+static void gltf_draw_encoder_set_vertex_buffer(gltf_draw_encoder_t* encoder,
+                                                uint32_t slot,
+                                                WGPUBuffer buffer)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderSetVertexBuffer(encoder->bundle_enc, slot, buffer,
+                                           0, WGPU_WHOLE_SIZE);
+  }
+  else {
+    wgpuRenderPassEncoderSetVertexBuffer(encoder->rpass_enc, slot, buffer, 0,
+                                         WGPU_WHOLE_SIZE);
+  }
+}
+
+static void gltf_draw_encoder_set_index_buffer(gltf_draw_encoder_t* encoder,
+                                               WGPUBuffer buffer,
+                                               WGPUIndexFormat format)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderSetIndexBuffer(encoder->bundle_enc, buffer, format,
+                                          0, WGPU_WHOLE_SIZE);
+  }
+  else {
+    wgpuRenderPassEncoderSetIndexBuffer(encoder->rpass_enc, buffer, format, 0,
+                                        WGPU_WHOLE_SIZE);
+  }
+}
+
+static void gltf_draw_encoder_draw(gltf_draw_encoder_t* encoder,
+                                   uint32_t vertex_count,
+                                   uint32_t instance_count,
+                                   uint32_t first_vertex,
+                                   uint32_t first_instance)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderDraw(encoder->bundle_enc, vertex_count,
+                                instance_count, first_vertex, first_instance);
+  }
+  else {
+    wgpuRenderPassEncoderDraw(encoder->rpass_enc, vertex_count, instance_count,
+                              first_vertex, first_instance);
+  }
+}
+
+static void gltf_draw_encoder_draw_indexed(gltf_draw_encoder_t* encoder,
+                                           uint32_t index_count,
+                                           uint32_t instance_count,
+                                           uint32_t first_index,
+                                           int32_t base_vertex)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderDrawIndexed(encoder->bundle_enc, index_count,
+                                       instance_count, first_index,
+                                       base_vertex, 0);
+  }
+  else {
+    wgpuRenderPassEncoderDrawIndexed(encoder->rpass_enc, index_count,
+                                     instance_count, first_index, base_vertex,
+                                     0);
+  }
+}
+
+static void
+gltf_draw_encoder_draw_indexed_indirect(gltf_draw_encoder_t* encoder,
+                                        WGPUBuffer buffer, uint64_t offset)
+{
+  if (encoder->bundle_enc != NULL) {
+    wgpuRenderBundleEncoderDrawIndexedIndirect(encoder->bundle_enc, buffer,
+                                               offset);
+  }
+  else {
+    wgpuRenderPassEncoderDrawIndexedIndirect(encoder->rpass_enc, buffer,
+                                             offset);
+  }
+}
+
+static void gltf_model_bind_buffers(gltf_model_t* model,
+                                    gltf_draw_encoder_t* encoder,
+                                    uint32_t render_flags)
+{
+  // Pulled vertices are fetched from the mesh buffer bind group
+  if (render_flags & WGPU_GLTF_RenderFlags_VertexPulling) {
+    return;
+  }
+  WGPUBuffer vertex_buffer
+    = model->compute_skinning.skinned_vertex_buffer != NULL ?
+        model->compute_skinning.skinned_vertex_buffer :
+        model->vertices.buffer;
+  // Depth-only passes fetch the positions from their own stream
+  if (render_flags & WGPU_GLTF_RenderFlags_PositionsOnly) {
+    ASSERT(model->positions.buffer != NULL);
+    vertex_buffer = model->positions.buffer;
+  }
+  gltf_draw_encoder_set_vertex_buffer(encoder, 0, vertex_buffer);
+  gltf_draw_encoder_set_index_buffer(encoder, model->indices.buffer,
+                                     model->indices.format);
+  // model->buffers_bound = true;
+}
+
+/*
+ * Flat draw list, built at load time and sorted by pipeline, material bind
+ * group and mesh within the opaque and alpha masked buckets. Blended
+ * primitives keep the scene order.
+ */
+static int gltf_draw_item_compare(const void* a, const void* b)
+{
+  const gltf_draw_item_t* item_a = a;
+  const gltf_draw_item_t* item_b = b;
+  if (item_a->pipeline != item_b->pipeline) {
+    return (uintptr_t)item_a->pipeline < (uintptr_t)item_b->pipeline ? -1 : 1;
+  }
+  if (item_a->bind_group != item_b->bind_group) {
+    return (uintptr_t)item_a->bind_group < (uintptr_t)item_b->bind_group ? -1 :
+                                                                           1;
+  }
+  if (item_a->node->mesh != item_b->node->mesh) {
+    return (uintptr_t)item_a->node->mesh < (uintptr_t)item_b->node->mesh ? -1 :
+                                                                           1;
+  }
+  // Keep the scene order for equal keys
+  return item_a->order < item_b->order ? -1 : (item_a->order > item_b->order);
+}
+
+static void gltf_model_build_draw_list(gltf_model_t* model)
+{
+  uint32_t counts[GLTF_DRAW_BUCKET_COUNT] = {0};
+  for (uint32_t pass = 0; pass < 2; ++pass) {
+    uint32_t offsets[GLTF_DRAW_BUCKET_COUNT] = {0};
+    if (pass == 1) {
+      uint32_t count = 0;
+      for (uint32_t b = 0; b < GLTF_DRAW_BUCKET_COUNT; ++b) {
+        model->draw_list.bucket_offsets[b] = offsets[b] = count;
+        count += counts[b];
+      }
+      model->draw_list.bucket_offsets[GLTF_DRAW_BUCKET_COUNT] = count;
+      model->draw_list.count                                  = count;
+      model->draw_list.items
+        = count > 0 ? calloc(count, sizeof(gltf_draw_item_t)) : NULL;
+    }
+    for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+      gltf_node_t* node = model->linear_nodes[i];
+      if (node->mesh == NULL) {
+        continue;
       }
+      for (uint32_t p = 0; p < node->mesh->primitive_count; ++p) {
+        gltf_primitive_t* primitive = &node->mesh->primitives[p];
+        if (primitive->index_count == 0 || primitive->material == NULL) {
+          continue;
+        }
+        // Buckets are indexed by alpha mode
+        const uint32_t bucket = (uint32_t)primitive->material->alpha_mode;
+        if (pass == 0) {
+          ++counts[bucket];
+          continue;
+        }
+        const uint32_t index = offsets[bucket]++;
+        model->draw_list.items[index] = (gltf_draw_item_t){
+          .node      = node,
+          .primitive = primitive,
+          .order     = index,
+        };
+      }
+    }
+  }
+  model->draw_list.sorted = false;
 
-      // Load animations
-      if (gltf_data->animations_count > 0) {
-        gltf_model_load_animations(gltf_model, gltf_data);
+  // Nodes taking part in frustum culling, the bind pose bounds of skinned
+  // meshes do not enclose the animated vertices
+  uint32_t cull_count = 0;
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->mesh != NULL && node->mesh->bb.valid && node->skin == NULL) {
+      ++cull_count;
+    }
+  }
+  if (cull_count == 0) {
+    return;
+  }
+  model->culling.nodes = calloc(cull_count, sizeof(gltf_node_t*));
+  for (uint32_t i = 0; i < model->linear_node_count; ++i) {
+    gltf_node_t* node = model->linear_nodes[i];
+    if (node->mesh != NULL && node->mesh->bb.valid && node->skin == NULL) {
+      node->cull_index = model->culling.node_count;
+      model->culling.nodes[model->culling.node_count++] = node;
+    }
+  }
+}
+
+/*
+ * Returns the box enclosing the vertices of a node's mesh, or primitive, as
+ * they are drawn, in the space of the node matrices
+ */
+static void gltf_model_get_world_box(gltf_model_t* model, gltf_node_t* node,
+                                     bounding_box_t* bb, bounding_box_t* dest)
+{
+  bounding_box_t local = *bb;
+  if (model->culling.flip_y && !model->culling.pre_transformed) {
+    local.min[1] = -bb->max[1];
+    local.max[1] = -bb->min[1];
+  }
+  bounding_get_aabb(&local, node->world_matrix, dest);
+  if (model->culling.flip_y && model->culling.pre_transformed) {
+    const float min_y = dest->min[1];
+    dest->min[1]      = -dest->max[1];
+    dest->max[1]      = -min_y;
+  }
+}
+
+/*
+ * Returns the visibility mask of the culled nodes in the frustum, bit i is set
+ * for the node of cull index i. All boxes are tested in one SIMD batch. The
+ * mask is owned by the caller.
+ */
+static uint32_t* gltf_model_cull_nodes(gltf_model_t* model, frustum_t* frustum)
+{
+  const uint32_t node_count = model->culling.node_count;
+  if (node_count == 0) {
+    return NULL;
+  }
+  // Centers and half extents, one array per component
+  float* boxes      = malloc(6 * node_count * sizeof(float));
+  uint32_t* visible  = malloc(((node_count + 31) / 32) * sizeof(uint32_t));
+  ASSERT(boxes != NULL && visible != NULL);
+  for (uint32_t i = 0; i < node_count; ++i) {
+    gltf_node_t* node = model->culling.nodes[i];
+    bounding_box_t box;
+    gltf_model_get_world_box(model, node, &node->mesh->bb, &box);
+    for (uint32_t c = 0; c < 3; ++c) {
+      boxes[c * node_count + i]       = (box.min[c] + box.max[c]) * 0.5f;
+      boxes[(c + 3) * node_count + i] = (box.max[c] - box.min[c]) * 0.5f;
+    }
+  }
+  frustum_cull_aabbs(frustum,
+                     &(frustum_aabbs_t){
+                       .center_x = boxes,
+                       .center_y = boxes + node_count,
+                       .center_z = boxes + 2 * node_count,
+                       .extent_x = boxes + 3 * node_count,
+                       .extent_y = boxes + 4 * node_count,
+                       .extent_z = boxes + 5 * node_count,
+                     },
+                     node_count,
+                     &(frustum_cull_result_t){
+                       .visibility_mask = visible,
+                     });
+  free(boxes);
+  return visible;
+}
+
+/*
+ * Tests a primitive of a visible node on its own, only done for meshes with
+ * several primitives
+ */
+static bool gltf_model_primitive_is_visible(gltf_model_t* model,
+                                            gltf_draw_item_t* item,
+                                            frustum_t* frustum,
+                                            const uint32_t* node_visible)
+{
+  gltf_node_t* node = item->node;
+  if (node_visible != NULL && node->cull_index != UINT32_MAX
+      && !(node_visible[node->cull_index / 32]
+           & (1u << (node->cull_index % 32)))) {
+    return false;
+  }
+  if (node->skin != NULL || node->mesh->primitive_count < 2
+      || !item->primitive->bb.valid) {
+    return true;
+  }
+  bounding_box_t box;
+  gltf_model_get_world_box(model, node, &item->primitive->bb, &box);
+  return frustum_check_box(frustum, box.min, box.max);
+}
+
+/*
+ * Selects the coarsest level of detail whose geometric error projects to at
+ * most the allowed number of pixels
+ */
+static const gltf_primitive_lod_t*
+gltf_model_select_lod(gltf_model_t* model, gltf_draw_item_t* item,
+                      const wgpu_gltf_model_lod_options_t* options)
+{
+  gltf_primitive_t* primitive = item->primitive;
+  if (!options->enabled || primitive->lod_count < 2 || !primitive->bb.valid) {
+    return &primitive->lods[0];
+  }
+
+  bounding_box_t box;
+  gltf_model_get_world_box(model, item->node, &primitive->bb, &box);
+  vec3 center = GLM_VEC3_ZERO_INIT;
+  glm_vec3_center(box.min, box.max, center);
+  const float radius   = 0.5f * glm_vec3_distance(box.min, box.max);
+  const float distance
+    = glm_vec3_distance(center, (float*)options->eye) - radius;
+  if (distance <= 0.0f) {
+    return &primitive->lods[0];
+  }
+
+  // The errors are in mesh units, scale them by the largest node axis scale
+  mat4* world_matrix = &item->node->world_matrix;
+  const float scale  = MAX(glm_vec3_norm((*world_matrix)[0]),
+                           MAX(glm_vec3_norm((*world_matrix)[1]),
+                               glm_vec3_norm((*world_matrix)[2])));
+  const float pixels_per_unit = options->projection_scale * scale / distance;
+  const float pixel_error
+    = options->pixel_error > 0.0f ? options->pixel_error : 1.0f;
+  uint32_t selected = 0;
+  for (uint32_t l = 1; l < primitive->lod_count; ++l) {
+    if (primitive->lods[l].error * pixels_per_unit <= pixel_error) {
+      selected = l;
+    }
+  }
+  return &primitive->lods[selected];
+}
+
+/*
+ * Sort the opaque and alpha masked buckets by the current material state
+ */
+static void gltf_model_sort_draw_list(gltf_model_t* model)
+{
+  for (uint32_t i = 0; i < model->draw_list.count; ++i) {
+    gltf_draw_item_t* item = &model->draw_list.items[i];
+    item->pipeline         = item->primitive->material->pipeline;
+    item->bind_group       = item->primitive->material->bind_group;
+  }
+  for (uint32_t b = AlphaMode_OPAQUE; b <= AlphaMode_MASK; ++b) {
+    const uint32_t begin = model->draw_list.bucket_offsets[b];
+    const uint32_t end   = model->draw_list.bucket_offsets[b + 1];
+    if (end - begin > 1) {
+      qsort(&model->draw_list.items[begin], end - begin,
+            sizeof(gltf_draw_item_t), gltf_draw_item_compare);
+    }
+  }
+  model->draw_list.sorted        = true;
+  model->gpu_culling.items_dirty = true;
+  // Render bundles recorded with the previous order are stale
+  ++model->draw_list.version;
+  wgpu_render_bundle_cache_invalidate(model->wgpu_context, model);
+}
+
+// Material pipelines and bind groups are unchanged since the last sort
+static bool gltf_model_draw_list_is_current(gltf_model_t* model)
+{
+  if (!model->draw_list.sorted) {
+    return false;
+  }
+  for (uint32_t i = 0; i < model->draw_list.count; ++i) {
+    gltf_draw_item_t* item    = &model->draw_list.items[i];
+    gltf_material_t* material = item->primitive->material;
+    if (material->pipeline != item->pipeline
+        || material->bind_group != item->bind_group) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+gltf_model_draw_list(gltf_model_t* model, gltf_draw_encoder_t* encoder,
+                     wgpu_gltf_model_render_options_t render_options,
+                     uint32_t instance_count, bool allow_indirect)
+{
+  const uint32_t render_flags = render_options.render_flags;
+
+  // Materials get their pipelines and bind groups after loading, resort when
+  // they changed since the last sort. The check only reads the model, so
+  // prepared models can be drawn from several threads at once.
+  if (!gltf_model_draw_list_is_current(model)) {
+    gltf_model_sort_draw_list(model);
+  }
+
+  // The indirect draws of the culling pass replace the CPU side visibility
+  // and level of detail, as long as they match the draw list order. Their
+  // arguments are indexed draws, which don't apply to pulled vertices.
+  const bool vertex_pulling
+    = render_flags & WGPU_GLTF_RenderFlags_VertexPulling;
+  ASSERT(!vertex_pulling || model->mesh_buffer != NULL);
+  const bool indirect = allow_indirect && !vertex_pulling
+                        && model->gpu_culling.args_valid
+                        && !model->gpu_culling.items_dirty;
+  if (indirect) {
+    render_options.frustum = NULL;
+  }
+
+  frustum_t* frustum = render_options.frustum;
+  uint32_t* node_visible
+    = frustum != NULL ? gltf_model_cull_nodes(model, frustum) : NULL;
+
+  // The last alpha mode flag set selects the bucket, all buckets are drawn
+  // when no flag is set
+  uint32_t first_bucket = AlphaMode_OPAQUE, last_bucket = AlphaMode_BLEND;
+  if (render_flags & WGPU_GLTF_RenderFlags_RenderAlphaBlendedNodes) {
+    first_bucket = last_bucket = AlphaMode_BLEND;
+  }
+  else if (render_flags & WGPU_GLTF_RenderFlags_RenderAlphaMaskedNodes) {
+    first_bucket = last_bucket = AlphaMode_MASK;
+  }
+  else if (render_flags & WGPU_GLTF_RenderFlags_RenderOpaqueNodes) {
+    first_bucket = last_bucket = AlphaMode_OPAQUE;
+  }
+  const bool bind_images = render_flags & WGPU_GLTF_RenderFlags_BindImages;
+  const bool bind_material_index
+    = (render_flags & WGPU_GLTF_RenderFlags_BindMaterialIndex)
+      && model->material_table.bind_group != NULL;
+  const bool relative_indices = model->indices.format == WGPUIndexFormat_Uint16;
+  const bool position_pipelines
+    = (render_flags & WGPU_GLTF_RenderFlags_PositionsOnly)
+      && render_options.position_pipelines[0] != NULL;
+
+  // Only state changes between consecutive items are recorded
+  WGPURenderPipeline bound_pipeline  = NULL;
+  WGPUBindGroup bound_material_group = NULL;
+  WGPUBindGroup bound_mesh_group     = NULL;
+  gltf_material_t* bound_material    = NULL;
+
+  const uint32_t begin = model->draw_list.bucket_offsets[first_bucket];
+  const uint32_t end   = model->draw_list.bucket_offsets[last_bucket + 1];
+  for (uint32_t i = begin; i < end; ++i) {
+    gltf_draw_item_t* item    = &model->draw_list.items[i];
+    gltf_material_t* material = item->primitive->material;
+    if (frustum != NULL
+        && !gltf_model_primitive_is_visible(model, item, frustum,
+                                            node_visible)) {
+      continue;
+    }
+
+    WGPUBindGroup mesh_group = item->node->mesh->uniform_buffer.bind_group;
+    if (mesh_group != NULL && mesh_group != bound_mesh_group) {
+      gltf_draw_encoder_set_bind_group(
+        encoder, render_options.bind_mesh_model_set, mesh_group);
+      bound_mesh_group = mesh_group;
+    }
+    // Bind the pipeline for the node's material if present
+    WGPURenderPipeline pipeline
+      = position_pipelines ?
+          render_options.position_pipelines[material->double_sided ? 1 : 0] :
+          material->pipeline;
+    if (pipeline != NULL && pipeline != bound_pipeline) {
+      gltf_draw_encoder_set_pipeline(encoder, pipeline);
+      bound_pipeline = pipeline;
+    }
+    if (bind_images && material->bind_group != NULL
+        && material->bind_group != bound_material_group) {
+      gltf_draw_encoder_set_bind_group(encoder, render_options.bind_image_set,
+                                       material->bind_group);
+      bound_material_group = material->bind_group;
+    }
+    if (bind_material_index && material != bound_material) {
+      gltf_draw_encoder_set_dynamic_bind_group(
+        encoder, render_options.bind_material_set,
+        model->material_table.bind_group,
+        material->index * GLTF_MATERIAL_INDEX_STRIDE);
+      bound_material = material;
+    }
+    if (indirect) {
+      gltf_draw_encoder_draw_indexed_indirect(
+        encoder, model->gpu_culling.args_buffer,
+        i * GLTF_CULL_DRAW_ARGS_COUNT * sizeof(uint32_t));
+      continue;
+    }
+    const gltf_primitive_lod_t* lod
+      = gltf_model_select_lod(model, item, &render_options.lod);
+    if (vertex_pulling) {
+      const uint32_t mesh = item->primitive->first_pulled_mesh
+                            + (uint32_t)(lod - item->primitive->lods);
+      const wgpu_mesh_buffer_mesh_t range
+        = wgpu_mesh_buffer_get_mesh(model->mesh_buffer, mesh);
+      gltf_draw_encoder_draw(encoder, range.index_count, instance_count,
+                             range.first_index, mesh);
+      continue;
+    }
+    const int32_t base_vertex
+      = relative_indices ? (int32_t)item->primitive->first_vertex : 0;
+    gltf_draw_encoder_draw_indexed(encoder, lod->index_count, instance_count,
+                                   lod->first_index, base_vertex);
+  }
+  free(node_visible);
+}
+
+// Draw the glTF scene from the flat draw list
+void wgpu_gltf_model_draw(gltf_model_t* model,
+                          wgpu_gltf_model_render_options_t render_options)
+{
+  wgpu_gltf_model_draw_to_pass(model, model->wgpu_context->rpass_enc,
+                               render_options);
+}
+
+void wgpu_gltf_model_draw_to_pass(
+  gltf_model_t* model, WGPURenderPassEncoder rpass_enc,
+  wgpu_gltf_model_render_options_t render_options)
+{
+  if (model->pending_upload_count > 0) {
+    return;
+  }
+  gltf_draw_encoder_t encoder = {
+    .rpass_enc = rpass_enc,
+  };
+  if (!model->buffers_bound) {
+    // All vertices and indices are stored in single buffers, so we only need to
+    // bind once
+    gltf_model_bind_buffers(model, &encoder, render_options.render_flags);
+  }
+  gltf_model_draw_list(model, &encoder, render_options, 1, true);
+}
+
+// Draw instance_count copies of the glTF scene, one draw call per primitive
+void wgpu_gltf_model_draw_instanced(
+  gltf_model_t* model, wgpu_gltf_model_render_options_t render_options,
+  WGPUBuffer instance_buffer, uint32_t instance_count)
+{
+  if (instance_count == 0 || model->pending_upload_count > 0) {
+    return;
+  }
+  gltf_draw_encoder_t encoder = {
+    .rpass_enc = model->wgpu_context->rpass_enc,
+  };
+  if (!model->buffers_bound) {
+    gltf_model_bind_buffers(model, &encoder, render_options.render_flags);
+  }
+  // Per-instance data, e.g. model matrices, when supplied as vertex buffer
+  if (instance_buffer != NULL) {
+    gltf_draw_encoder_set_vertex_buffer(
+      &encoder, WGPU_GLTF_INSTANCE_BUFFER_SLOT, instance_buffer);
+  }
+  // The instance transforms are unknown here, so instances are neither culled
+  // nor drawn at a lower level of detail
+  render_options.frustum     = NULL;
+  render_options.lod.enabled = false;
+  gltf_model_draw_list(model, &encoder, render_options, instance_count,
+                       false);
+}
+
+/*
+ * Draw list recording to render bundles
+ */
+typedef struct gltf_bundle_record_data_t {
+  gltf_model_t* model;
+  const wgpu_gltf_model_render_options_t* render_options;
+  const wgpu_gltf_model_bundle_options_t* bundle_options;
+} gltf_bundle_record_data_t;
+
+// Render bundles start without any state, the caller's state is bound first
+static void
+gltf_model_bind_caller_state(gltf_draw_encoder_t* encoder,
+                             const wgpu_gltf_model_bundle_options_t* options)
+{
+  if (options->pipeline != NULL) {
+    gltf_draw_encoder_set_pipeline(encoder, options->pipeline);
+  }
+  for (uint32_t i = 0; i < WGPU_GLTF_MAX_BUNDLE_BIND_GROUPS; ++i) {
+    if (options->bind_groups[i] != NULL) {
+      gltf_draw_encoder_set_bind_group(encoder, i, options->bind_groups[i]);
+    }
+  }
+}
+
+static void gltf_model_record_bundle(WGPURenderBundleEncoder bundle_encoder,
+                                     void* user_data)
+{
+  gltf_bundle_record_data_t* data = user_data;
+  gltf_draw_encoder_t encoder     = {
+    .bundle_enc = bundle_encoder,
+  };
+  gltf_model_bind_caller_state(&encoder, data->bundle_options);
+  gltf_model_bind_buffers(data->model, &encoder,
+                          data->render_options->render_flags);
+  gltf_model_draw_list(data->model, &encoder, *data->render_options, 1, true);
+}
+
+void wgpu_gltf_model_draw_bundled(
+  gltf_model_t* model, wgpu_gltf_model_render_options_t render_options,
+  const wgpu_gltf_model_bundle_options_t* bundle_options)
+{
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+  if (model->pending_upload_count > 0) {
+    return;
+  }
+  if (!gltf_model_draw_list_is_current(model)) {
+    gltf_model_sort_draw_list(model);
+  }
+
+  // The CPU side visibility and level of detail change with the camera, the
+  // indirect draws of the culling pass do not
+  const bool indirect
+    = model->gpu_culling.args_valid && !model->gpu_culling.items_dirty
+      && !(render_options.render_flags & WGPU_GLTF_RenderFlags_VertexPulling);
+  if (!indirect
+      && (render_options.frustum != NULL || render_options.lod.enabled)) {
+    gltf_draw_encoder_t encoder = {
+      .rpass_enc = wgpu_context->rpass_enc,
+    };
+    gltf_model_bind_caller_state(&encoder, bundle_options);
+    wgpu_gltf_model_draw(model, render_options);
+    return;
+  }
+
+  wgpu_render_bundle_key_t key = {
+    .source  = model,
+    .state   = WGPU_RENDER_BUNDLE_HASH_SEED,
+    .formats = bundle_options->formats,
+  };
+  const uint32_t draw_state[6] = {
+    render_options.render_flags,
+    render_options.bind_mesh_model_set,
+    render_options.bind_image_set,
+    render_options.bind_material_set,
+    model->draw_list.version,
+    indirect,
+  };
+  key.state = wgpu_render_bundle_hash(key.state, draw_state,
+                                      sizeof(draw_state));
+  // The bundle is released with the pipelines and bind groups of the caller,
+  // the bundles of superseded options are evicted by the cache
+  uint32_t object_count       = 0;
+  key.objects[object_count++] = bundle_options->pipeline;
+  for (uint32_t i = 0; i < WGPU_GLTF_MAX_BUNDLE_BIND_GROUPS; ++i) {
+    key.objects[object_count++] = bundle_options->bind_groups[i];
+  }
+  for (uint32_t i = 0; i < ARRAY_SIZE(render_options.position_pipelines);
+       ++i) {
+    key.objects[object_count++] = render_options.position_pipelines[i];
+  }
+  ASSERT(object_count <= WGPU_RENDER_BUNDLE_MAX_KEY_OBJECTS);
+
+  gltf_bundle_record_data_t record_data = {
+    .model          = model,
+    .render_options = &render_options,
+    .bundle_options = bundle_options,
+  };
+  WGPURenderBundle bundle = wgpu_render_bundle_cache_get(
+    wgpu_context, &key, gltf_model_record_bundle, &record_data);
+  if (bundle != NULL) {
+    wgpuRenderPassEncoderExecuteBundles(wgpu_context->rpass_enc, 1, &bundle);
+  }
+}
+
+void wgpu_gltf_model_prepare_draw(gltf_model_t* model)
+{
+  if (!gltf_model_draw_list_is_current(model)) {
+    gltf_model_sort_draw_list(model);
+  }
+}
+
+void wgpu_gltf_model_dispatch_skinning(gltf_model_t* model,
+                                       WGPUComputePassEncoder pass_encoder)
+{
+  if (model->pending_upload_count > 0) {
+    return;
+  }
+  gltf_model_dispatch_morph_targets(model, pass_encoder);
+  if (model->compute_skinning.pipeline == NULL) {
+    return;
+  }
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    model->compute_skinning.pipeline);
+  wgpuComputePassEncoderSetBindGroup(
+    pass_encoder, 0, model->compute_skinning.bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    (model->compute_skinning.max_vertex_count + GLTF_SKINNING_WORKGROUP_SIZE
+     - 1)
+      / GLTF_SKINNING_WORKGROUP_SIZE,
+    model->compute_skinning.job_count, 1);
+}
+
+uint32_t wgpu_gltf_model_get_morph_target_count(gltf_model_t* model,
+                                                uint32_t mesh_index)
+{
+  return (mesh_index < model->mesh_count
+          && model->morph_targets.pipeline != NULL) ?
+           model->meshes[mesh_index].morph_target_count :
+           0;
+}
+
+void wgpu_gltf_model_set_morph_weights(gltf_model_t* model,
+                                       uint32_t mesh_index,
+                                       const float* weights, uint32_t count)
+{
+  if (wgpu_gltf_model_get_morph_target_count(model, mesh_index) == 0) {
+    return;
+  }
+  const gltf_mesh_t* mesh = &model->meshes[mesh_index];
+  count                   = MIN(count, mesh->morph_target_count);
+  float* mesh_weights = &model->morph_targets.weights[mesh->first_morph_weight];
+  if (memcmp(mesh_weights, weights, count * sizeof(float)) != 0) {
+    memcpy(mesh_weights, weights, count * sizeof(float));
+    model->morph_targets.weights_dirty = true;
+  }
+}
+
+/*
+ * GPU animation
+ *
+ * The keyframes of all animations are uploaded to storage buffers. A first
+ * pass samples two animations per node and blends the poses by weight into
+ * the local matrices, a second one concatenates the local matrices along the
+ * parent chain of each node and a third one writes the joint matrices read by
+ * the compute skinning pass.
+ */
+#define GLTF_ANIMATION_WORKGROUP_SIZE 64u
+
+typedef struct gltf_animation_params_t {
+  uint32_t animations[2];
+  float times[2];
+  float weight;
+  uint32_t node_count;
+  uint32_t joint_count;
+  uint32_t channel_table; /* first channel entry in the table buffer */
+  uint32_t range_table;   /* first node channel range in the table buffer */
+  uint32_t padding[3];
+} gltf_animation_params_t;
+
+/* Rest pose of a linear node */
+typedef struct gltf_animation_node_t {
+  mat4 matrix;
+  float translation[3];
+  int32_t parent; /* linear index, -1 for roots */
+  float rotation[4];
+  float scale[3];
+  uint32_t padding;
+} gltf_animation_node_t;
+
+typedef struct gltf_animation_joint_t {
+  mat4 inverse_bind_matrix;
+  uint32_t node;      /* linear index of the joint node */
+  uint32_t mesh_node; /* linear index of the skinned mesh node */
+  uint32_t padding[2];
+} gltf_animation_joint_t;
+
+// clang-format off
+static const char* gltf_animation_compute_shader_wgsl = CODE(
+  struct AnimationParams {
+    animationA : u32,
+    animationB : u32,
+    timeA : f32,
+    timeB : f32,
+    weight : f32,
+    nodeCount : u32,
+    jointCount : u32,
+    channelTable : u32,
+    rangeTable : u32,
+  };
+
+  struct AnimationNode {
+    matrix : mat4x4<f32>,
+    translation : vec3<f32>,
+    parent : i32,
+    rotation : vec4<f32>,
+    scale : vec3<f32>,
+    padding : u32,
+  };
+
+  struct AnimationJoint {
+    inverseBindMatrix : mat4x4<f32>,
+    node : u32,
+    meshNode : u32,
+    padding0 : u32,
+    padding1 : u32,
+  };
+
+  struct Pose {
+    translation : vec3<f32>,
+    rotation : vec4<f32>,
+    scale : vec3<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> params : AnimationParams;
+  // Sampler inputs followed by their outputs, 4 floats per output
+  @group(0) @binding(1) var<storage, read> keyframes : array<f32>;
+  // Samplers (input offset, input count, output offset, interpolation),
+  // channels (sampler, path) and the channel range of every animation and node
+  @group(0) @binding(2) var<storage, read> tables : array<u32>;
+  @group(0) @binding(3) var<storage, read> nodes : array<AnimationNode>;
+  @group(0) @binding(4) var<storage, read> joints : array<AnimationJoint>;
+  // Local matrices followed by the world matrices
+  @group(0) @binding(5) var<storage, read_write> matrices : array<mat4x4<f32>>;
+  @group(0) @binding(6)
+  var<storage, read_write> jointMatrices : array<mat4x4<f32>>;
+
+  fn readOutput(offset : u32, index : u32) -> vec4<f32> {
+    let i = offset + index * 4u;
+    return vec4<f32>(keyframes[i], keyframes[i + 1u], keyframes[i + 2u],
+                     keyframes[i + 3u]);
+  }
+
+  fn quatSlerp(a : vec4<f32>, b : vec4<f32>, u : f32) -> vec4<f32> {
+    var cosTheta = dot(a, b);
+    var c = b;
+    if (cosTheta < 0.0) {
+      c = -b;
+      cosTheta = -cosTheta;
+    }
+    if (cosTheta > 0.9995) {
+      return normalize(mix(a, c, vec4<f32>(u)));
+    }
+    let theta = acos(cosTheta);
+    return normalize(sin((1.0 - u) * theta) * a + sin(u * theta) * c);
+  }
+
+  // Like gltf_animation_sampler_evaluate, interpolations are linear (0),
+  // step (1) and cubic spline (2)
+  fn sampleChannel(sampler : u32, isRotation : bool, time : f32) -> vec4<f32> {
+    let inputOffset = tables[sampler * 4u];
+    let inputCount = tables[sampler * 4u + 1u];
+    let outputOffset = tables[sampler * 4u + 2u];
+    let interpolation = tables[sampler * 4u + 3u];
+    let t = clamp(time, keyframes[inputOffset],
+                  keyframes[inputOffset + inputCount - 1u]);
+
+    // Last key at or before t
+    var low = 0u;
+    var high = inputCount - 1u;
+    loop {
+      if (high - low <= 1u) {
+        break;
+      }
+      let mid = low + (high - low) / 2u;
+      if (keyframes[inputOffset + mid] <= t) {
+        low = mid;
+      } else {
+        high = mid;
       }
+    }
+    let t0 = keyframes[inputOffset + low];
+    let dt = keyframes[inputOffset + low + 1u] - t0;
+    let u = select(0.0, (t - t0) / dt, dt > 0.0);
 
-      // Load skins
-      gltf_model_load_skins(gltf_model, gltf_data);
+    if (interpolation == 1u) {
+      return readOutput(outputOffset, low);
+    }
+    if (interpolation == 2u) {
+      // Each keyframe stores an in-tangent, a value and an out-tangent
+      let u2 = u * u;
+      let u3 = u2 * u;
+      let p0 = readOutput(outputOffset, low * 3u + 1u);
+      let m0 = readOutput(outputOffset, low * 3u + 2u) * dt;
+      let m1 = readOutput(outputOffset, low * 3u + 3u) * dt;
+      let p1 = readOutput(outputOffset, low * 3u + 4u);
+      let value = (2.0 * u3 - 3.0 * u2 + 1.0) * p0 + (u3 - 2.0 * u2 + u) * m0
+                + (-2.0 * u3 + 3.0 * u2) * p1 + (u3 - u2) * m1;
+      if (isRotation) {
+        return normalize(value);
+      }
+      return value;
+    }
+    let a = readOutput(outputOffset, low);
+    let b = readOutput(outputOffset, low + 1u);
+    if (isRotation) {
+      return quatSlerp(a, b, u);
+    }
+    return mix(a, b, vec4<f32>(u));
+  }
 
-      // Assign skins and initial pose
-      for (uint32_t i = 0; i < gltf_model->linear_node_count; ++i) {
-        gltf_node_t* node = gltf_model->linear_nodes[i];
-        // Assign skins
-        if (node->skin_index > -1) {
-          node->skin = &gltf_model->skins[(uint32_t)node->skin_index];
+  // Nodes without channels in the animation keep their rest pose
+  fn samplePose(animation : u32, time : f32, node : u32) -> Pose {
+    var pose = Pose(nodes[node].translation, nodes[node].rotation,
+                    nodes[node].scale);
+    let range = params.rangeTable + (animation * params.nodeCount + node) * 2u;
+    let first = tables[range];
+    let end = first + tables[range + 1u];
+    for (var c = first; c < end; c = c + 1u) {
+      let sampler = tables[params.channelTable + c * 2u];
+      let path = tables[params.channelTable + c * 2u + 1u];
+      let value = sampleChannel(sampler, path == 1u, time);
+      if (path == 0u) {
+        pose.translation = value.xyz;
+      } else if (path == 1u) {
+        pose.rotation = value;
+      } else {
+        pose.scale = value.xyz;
+      }
+    }
+    return pose;
+  }
+
+  fn composeMatrix(t : vec3<f32>, q : vec4<f32>, s : vec3<f32>) -> mat4x4<f32> {
+    let x2 = q.x + q.x;
+    let y2 = q.y + q.y;
+    let z2 = q.z + q.z;
+    let xx = q.x * x2;
+    let yy = q.y * y2;
+    let zz = q.z * z2;
+    let xy = q.x * y2;
+    let xz = q.x * z2;
+    let yz = q.y * z2;
+    let wx = q.w * x2;
+    let wy = q.w * y2;
+    let wz = q.w * z2;
+    return mat4x4<f32>(
+      vec4<f32>((1.0 - (yy + zz)) * s.x, (xy + wz) * s.x, (xz - wy) * s.x, 0.0),
+      vec4<f32>((xy - wz) * s.y, (1.0 - (xx + zz)) * s.y, (yz + wx) * s.y, 0.0),
+      vec4<f32>((xz + wy) * s.z, (yz - wx) * s.z, (1.0 - (xx + yy)) * s.z, 0.0),
+      vec4<f32>(t, 1.0));
+  }
+
+  fn affineInverse(m : mat4x4<f32>) -> mat4x4<f32> {
+    let a = m[0].xyz;
+    let b = m[1].xyz;
+    let c = m[2].xyz;
+    let r0 = cross(b, c);
+    let invDet = 1.0 / dot(a, r0);
+    // The rows of the inverse are the cross products of the columns
+    let m3 = transpose(mat3x3<f32>(r0 * invDet, cross(c, a) * invDet,
+                                   cross(a, b) * invDet));
+    return mat4x4<f32>(vec4<f32>(m3[0], 0.0), vec4<f32>(m3[1], 0.0),
+                       vec4<f32>(m3[2], 0.0), vec4<f32>(-(m3 * m[3].xyz), 1.0));
+  }
+
+  @compute @workgroup_size(64)
+  fn sampleNodes(@builtin(global_invocation_id) id : vec3<u32>) {
+    let node = id.x;
+    if (node >= params.nodeCount) {
+      return;
+    }
+    let a = samplePose(params.animationA, params.timeA, node);
+    var b = a;
+    if (params.weight > 0.0) {
+      b = samplePose(params.animationB, params.timeB, node);
+    }
+    // Normalized linear blend of the rotations along the shorter arc
+    let w = params.weight;
+    let rotationB = select(b.rotation, -b.rotation,
+                           dot(a.rotation, b.rotation) < 0.0);
+    let translation = mix(a.translation, b.translation, vec3<f32>(w));
+    let rotation = normalize(mix(a.rotation, rotationB, vec4<f32>(w)));
+    let scale = mix(a.scale, b.scale, vec3<f32>(w));
+    matrices[node] = composeMatrix(translation, rotation, scale)
+                     * nodes[node].matrix;
+  }
+
+  @compute @workgroup_size(64)
+  fn updateWorld(@builtin(global_invocation_id) id : vec3<u32>) {
+    let node = id.x;
+    if (node >= params.nodeCount) {
+      return;
+    }
+    var world = matrices[node];
+    var parent = nodes[node].parent;
+    loop {
+      if (parent < 0) {
+        break;
+      }
+      world = matrices[u32(parent)] * world;
+      parent = nodes[u32(parent)].parent;
+    }
+    matrices[params.nodeCount + node] = world;
+  }
+
+  @compute @workgroup_size(64)
+  fn writeJoints(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.jointCount) {
+      return;
+    }
+    let joint = joints[id.x];
+    let world = params.nodeCount;
+    jointMatrices[id.x] = affineInverse(matrices[world + joint.meshNode])
+                          * matrices[world + joint.node]
+                          * joint.inverseBindMatrix;
+  }
+);
+// clang-format on
+
+static void gltf_model_create_animation_bind_group(gltf_model_t* model,
+                                                   WGPUBuffer joint_buffer,
+                                                   uint64_t joint_offset)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, model->gpu_animation.bind_group);
+
+  const uint32_t node_count  = model->gpu_animation.node_count;
+  const uint32_t joint_count = model->gpu_animation.joint_count;
+  WGPUBindGroupEntry bg_entries[7] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = model->gpu_animation.params_buffer,
+      .size    = sizeof(gltf_animation_params_t),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = model->gpu_animation.keyframe_buffer,
+      .size    = model->gpu_animation.keyframe_size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = model->gpu_animation.table_buffer,
+      .size    = model->gpu_animation.table_size,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = model->gpu_animation.node_buffer,
+      .size    = node_count * sizeof(gltf_animation_node_t),
+    },
+    [4] = (WGPUBindGroupEntry) {
+      .binding = 4,
+      .buffer  = model->gpu_animation.joint_buffer,
+      .size    = joint_count * sizeof(gltf_animation_joint_t),
+    },
+    [5] = (WGPUBindGroupEntry) {
+      .binding = 5,
+      .buffer  = model->gpu_animation.matrix_buffer,
+      .size    = 2 * node_count * sizeof(mat4),
+    },
+    [6] = (WGPUBindGroupEntry) {
+      .binding = 6,
+      .buffer  = joint_buffer,
+      .offset  = joint_offset,
+      .size    = joint_count * sizeof(mat4),
+    },
+  };
+  model->gpu_animation.bind_group = wgpuDeviceCreateBindGroup(
+    model->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "gltf_animation_bind_group",
+      .layout     = model->gpu_animation.bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(model->gpu_animation.bind_group != NULL);
+}
+
+/*
+ * Keyframes of all animations and the table buffer contents: the samplers,
+ * the valid channels grouped by animation and node, and the channel range of
+ * every animation and node
+ */
+static void gltf_model_build_animation_tables(gltf_model_t* model,
+                                              float** keyframes,
+                                              uint32_t* keyframe_count,
+                                              uint32_t** tables,
+                                              uint32_t* table_count,
+                                              gltf_animation_params_t* params)
+{
+  const uint32_t node_count = model->linear_node_count;
+  uint32_t sampler_count = 0, channel_count = 0;
+  *keyframe_count = 0;
+  for (uint32_t a = 0; a < model->animation_count; ++a) {
+    const gltf_animation_t* animation = &model->animations[a];
+    for (uint32_t s = 0; s < animation->sampler_count; ++s) {
+      *keyframe_count += animation->samplers[s].input_count
+                         + animation->samplers[s].outputs_vec4_count * 4;
+    }
+    sampler_count += animation->sampler_count;
+    channel_count += animation->channel_count;
+  }
+  params->channel_table = sampler_count * 4;
+  params->range_table   = params->channel_table + channel_count * 2;
+  *table_count = params->range_table + model->animation_count * node_count * 2;
+  *keyframes   = (float*)calloc(MAX(*keyframe_count, 1u), sizeof(float));
+  *tables      = (uint32_t*)calloc(MAX(*table_count, 1u), sizeof(uint32_t));
+
+  uint32_t* sampler_table = *tables;
+  uint32_t* channel_table = *tables + params->channel_table;
+  uint32_t* range_table   = *tables + params->range_table;
+  uint32_t keyframe_offset = 0, sampler_base = 0, channel_offset = 0;
+  for (uint32_t a = 0; a < model->animation_count; ++a) {
+    const gltf_animation_t* animation = &model->animations[a];
+    for (uint32_t s = 0; s < animation->sampler_count; ++s) {
+      const gltf_animation_sampler_t* sampler = &animation->samplers[s];
+      uint32_t* entry = &sampler_table[(sampler_base + s) * 4];
+      entry[0]        = keyframe_offset;
+      entry[1]        = sampler->input_count;
+      memcpy(&(*keyframes)[keyframe_offset], sampler->inputs,
+             sampler->input_count * sizeof(float));
+      keyframe_offset += sampler->input_count;
+      entry[2] = keyframe_offset;
+      entry[3] = (uint32_t)sampler->interpolation;
+      memcpy(&(*keyframes)[keyframe_offset], sampler->outputs_vec4,
+             sampler->outputs_vec4_count * sizeof(vec4));
+      keyframe_offset += sampler->outputs_vec4_count * 4;
+    }
+
+    // Count the valid channels per node, then place them node by node
+    uint32_t* ranges = &range_table[a * node_count * 2];
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+      for (uint32_t c = 0; c < animation->channel_count; ++c) {
+        const gltf_animation_channel_t* channel = &animation->channels[c];
+        if (!channel->is_valid
+            || channel->node->transform_index >= node_count) {
+          continue;
         }
-        // Initial pose
-        if (node->mesh != NULL) {
-          gltf_node_update(gltf_model->wgpu_context, node);
+        const gltf_animation_sampler_t* sampler
+          = &animation->samplers[channel->sampler_index];
+        const uint32_t outputs_per_key
+          = sampler->interpolation == InterpolationType_CUBICSPLINE ? 3 : 1;
+        if (sampler->input_count < 2
+            || sampler->input_count * outputs_per_key
+                 > sampler->outputs_vec4_count) {
+          continue;
+        }
+        uint32_t* range = &ranges[channel->node->transform_index * 2];
+        if (pass == 0) {
+          ++range[1];
+        }
+        else {
+          uint32_t* entry = &channel_table[(range[0] + range[1]++) * 2];
+          entry[0]        = sampler_base + channel->sampler_index;
+          entry[1]        = (uint32_t)channel->path;
+        }
+      }
+      if (pass == 0) {
+        for (uint32_t n = 0; n < node_count; ++n) {
+          ranges[n * 2] = channel_offset;
+          channel_offset += ranges[n * 2 + 1];
+          ranges[n * 2 + 1] = 0;
         }
       }
     }
+    sampler_base += animation->sampler_count;
   }
-  else {
-    log_error("Could not load gltf file: %s, error: %d\n",
-              load_options->filename, result);
-    return NULL;
-  }
-
-  ASSERT(gltf_model != NULL);
+}
 
-  // Pre-Calculations for requested features
-  if ((file_loading_flags & WGPU_GLTF_FileLoadingFlags_PreTransformVertices)
-      || (file_loading_flags
-          & WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors)
-      || (file_loading_flags & WGPU_GLTF_FileLoadingFlags_FlipY)) {
-    const bool preTransform
-      = file_loading_flags & WGPU_GLTF_FileLoadingFlags_PreTransformVertices;
-    const bool preMultiplyColor
-      = file_loading_flags & WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors;
-    const bool flipY = file_loading_flags & WGPU_GLTF_FileLoadingFlags_FlipY;
-    for (uint32_t n = 0; n < gltf_model->linear_node_count; ++n) {
-      gltf_node_t* node = gltf_model->linear_nodes[n];
-      if (node->mesh != NULL) {
-        mat4 local_matrix = GLM_MAT4_ZERO_INIT;
-        gltf_node_get_matrix(node, &local_matrix);
-        for (uint32_t p = 0; p < node->mesh->primitive_count; ++p) {
-          gltf_primitive_t* primitive = &node->mesh->primitives[p];
-          for (uint32_t i = 0; i < primitive->vertex_count; ++i) {
-            gltf_vertex_t* vertex = &vertices[primitive->first_vertex + i];
-            // Pre-transform vertex positions by node-hierarchy
-            if (preTransform) {
-              // Vertex position
-              vec4 vertex_pos_tmp = GLM_VEC4_ZERO_INIT;
-              glm_vec4(vertex->pos, 1.0f, vertex_pos_tmp);
-              glm_mat4_mulv(local_matrix, vertex_pos_tmp, vertex_pos_tmp);
-              glm_vec3(vertex_pos_tmp, vertex->pos);
-              // Vertex normal
-              mat3 local_matrix_tmp = GLM_MAT3_ZERO_INIT;
-              glm_mat4_pick3(local_matrix, local_matrix_tmp);
-              vec3 mulv_result;
-              glm_mat3_mulv(local_matrix_tmp, vertex->normal, mulv_result);
-              glm_normalize_to(mulv_result, vertex->normal);
-            }
-            // Flip Y-Axis of vertex positions
-            if (flipY) {
-              vertex->pos[1] *= -1.0f;
-              vertex->normal[1] *= -1.0f;
-            }
-            // Pre-Multiply vertex colors with material base color
-            if (preMultiplyColor) {
-              glm_vec4_mul(primitive->material->base_color_factor,
-                           vertex->color, vertex->color);
-            }
-          }
-        }
+bool wgpu_gltf_model_prepare_gpu_animation(gltf_model_t* model)
+{
+  if (model->gpu_animation.sample_pipeline != NULL) {
+    return true;
+  }
+  if (model->compute_skinning.pipeline == NULL
+      || model->compute_skinning.joint_matrix_count == 0
+      || model->animation_count == 0) {
+    log_warn("GPU animation needs compute skinning and animations\n");
+    return false;
+  }
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+  const uint32_t node_count    = model->linear_node_count;
+  const uint32_t joint_count   = model->compute_skinning.joint_matrix_count;
+  model->gpu_animation.node_count  = node_count;
+  model->gpu_animation.joint_count = joint_count;
+
+  // Keyframes and tables
+  gltf_animation_params_t params = {0};
+  float* keyframes               = NULL;
+  uint32_t* tables               = NULL;
+  uint32_t keyframe_count = 0, table_count = 0;
+  gltf_model_build_animation_tables(model, &keyframes, &keyframe_count, &tables,
+                                    &table_count, &params);
+  model->gpu_animation.keyframe_size = MAX(keyframe_count, 1u) * sizeof(float);
+  model->gpu_animation.table_size    = MAX(table_count, 1u) * sizeof(uint32_t);
+  model->gpu_animation.keyframe_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF animation keyframe buffer",
+                           .usage = WGPUBufferUsage_Storage,
+                           .size  = model->gpu_animation.keyframe_size,
+                           .initial.data = keyframes,
+                         })
+        .buffer;
+  model->gpu_animation.table_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label        = "glTF animation table buffer",
+                           .usage        = WGPUBufferUsage_Storage,
+                           .size         = model->gpu_animation.table_size,
+                           .initial.data = tables,
+                         })
+        .buffer;
+  free(keyframes);
+  free(tables);
+
+  // Rest pose of the nodes, the current node transforms
+  gltf_animation_node_t* nodes = calloc(node_count, sizeof(*nodes));
+  for (uint32_t i = 0; i < node_count; ++i) {
+    const gltf_node_t* node = model->linear_nodes[i];
+    gltf_animation_node_t* dest = &nodes[i];
+    glm_mat4_copy((vec4*)node->matrix, dest->matrix);
+    memcpy(dest->translation, node->translation, sizeof(dest->translation));
+    memcpy(dest->rotation, node->rotation, sizeof(dest->rotation));
+    memcpy(dest->scale, node->scale, sizeof(dest->scale));
+    dest->parent = (node->parent != NULL
+                    && node->parent->transform_index < node_count) ?
+                     (int32_t)node->parent->transform_index :
+                     -1;
+  }
+  model->gpu_animation.node_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF animation node buffer",
+                           .usage = WGPUBufferUsage_Storage,
+                           .size  = node_count * sizeof(gltf_animation_node_t),
+                           .initial.data = nodes,
+                         })
+        .buffer;
+  free(nodes);
+
+  // Joints in the order of the compute skinning joint matrices
+  gltf_animation_joint_t* joints = calloc(joint_count, sizeof(*joints));
+  for (uint32_t i = 0; i < node_count; ++i) {
+    const gltf_node_t* node = model->linear_nodes[i];
+    const gltf_skin_t* skin = node->skin;
+    if (node->mesh == NULL || skin == NULL) {
+      continue;
+    }
+    for (uint32_t j = 0; j < skin->current_joint_index; ++j) {
+      gltf_animation_joint_t* joint = &joints[node->joint_matrix_offset + j];
+      if (j < skin->inverse_bind_matrix_count) {
+        glm_mat4_copy(skin->inverse_bind_matrices[j],
+                      joint->inverse_bind_matrix);
+      }
+      else {
+        glm_mat4_identity(joint->inverse_bind_matrix);
       }
+      joint->node      = skin->joints[j]->transform_index;
+      joint->mesh_node = node->transform_index;
     }
   }
+  model->gpu_animation.joint_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label        = "glTF animation joint buffer",
+          .usage        = WGPUBufferUsage_Storage,
+          .size         = joint_count * sizeof(gltf_animation_joint_t),
+          .initial.data = joints,
+        })
+        .buffer;
+  free(joints);
+
+  model->gpu_animation.matrix_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF animation matrix buffer",
+                           .usage = WGPUBufferUsage_Storage,
+                           .size  = 2 * node_count * sizeof(mat4),
+                         })
+        .buffer;
+  params.node_count                  = node_count;
+  params.joint_count                 = joint_count;
+  model->gpu_animation.channel_table = params.channel_table;
+  model->gpu_animation.range_table   = params.range_table;
+  model->gpu_animation.params_buffer
+    = wgpu_create_buffer(wgpu_context,
+                         &(wgpu_buffer_desc_t){
+                           .label = "glTF animation params buffer",
+                           .usage = WGPUBufferUsage_CopyDst
+                                    | WGPUBufferUsage_Uniform,
+                           .size         = sizeof(gltf_animation_params_t),
+                           .initial.data = &params,
+                         })
+        .buffer;
+
+  // Bind group layout shared by the three entry points
+  const WGPUBufferBindingType types[7] = {
+    WGPUBufferBindingType_Uniform,         /* Binding 0: Parameters */
+    WGPUBufferBindingType_ReadOnlyStorage, /* Binding 1: Keyframes */
+    WGPUBufferBindingType_ReadOnlyStorage, /* Binding 2: Tables */
+    WGPUBufferBindingType_ReadOnlyStorage, /* Binding 3: Nodes */
+    WGPUBufferBindingType_ReadOnlyStorage, /* Binding 4: Joints */
+    WGPUBufferBindingType_Storage,         /* Binding 5: Node matrices */
+    WGPUBufferBindingType_Storage,         /* Binding 6: Joint matrices */
+  };
+  WGPUBindGroupLayoutEntry bgl_entries[7] = {0};
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(bgl_entries); ++i) {
+    bgl_entries[i] = (WGPUBindGroupLayoutEntry){
+      .binding    = i,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer     = (WGPUBufferBindingLayout){
+        .type = types[i],
+      },
+    };
+  }
+  model->gpu_animation.bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "gltf_animation_bind_group_layout",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(model->gpu_animation.bind_group_layout != NULL);
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "gltf_animation_pipeline_layout",
+      .bindGroupLayoutCount = 1,
+      .bindGroupLayouts     = &model->gpu_animation.bind_group_layout,
+    });
+  ASSERT(pipeline_layout != NULL);
+
+  // Pipelines
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "gltf_animation_compute_shader",
+                    .wgsl_code.source = gltf_animation_compute_shader_wgsl,
+                    .entry            = "sampleNodes",
+                  });
+  const char* entries[3] = {"sampleNodes", "updateWorld", "writeJoints"};
+  WGPUComputePipeline* pipelines[3] = {
+    &model->gpu_animation.sample_pipeline,
+    &model->gpu_animation.world_pipeline,
+    &model->gpu_animation.joint_pipeline,
+  };
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(pipelines); ++i) {
+    WGPUProgrammableStageDescriptor stage
+      = comp_shader.programmable_stage_descriptor;
+    stage.entryPoint = entries[i];
+    *pipelines[i]    = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                              .label   = "gltf_animation_compute_pipeline",
+                              .layout  = pipeline_layout,
+                              .compute = stage,
+                            });
+    ASSERT(*pipelines[i] != NULL);
+  }
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+
+  // Joint matrices of the compute skinning pass, in the palette if attached
+  wgpu_gltf_joint_palette_t* palette = model->compute_skinning.palette;
+  if (palette != NULL) {
+    gltf_model_create_animation_bind_group(
+      model, palette->buffer,
+      model->compute_skinning.palette_offset * sizeof(mat4));
+  }
+  else {
+    gltf_model_create_animation_bind_group(
+      model, model->compute_skinning.joint_buffer, 0);
+  }
 
-  // Vertex and index buffers
-  size_t vertex_buffer_size
-    = gltf_model->vertices.count * sizeof(gltf_vertex_t);
-  size_t index_buffer_size = gltf_model->indices.count * sizeof(uint32_t);
+  return true;
+}
 
-  assert((vertex_buffer_size > 0) && (index_buffer_size > 0));
+void wgpu_gltf_model_set_animation_blend(
+  gltf_model_t* model, const wgpu_gltf_model_animation_blend_t* blend)
+{
+  if (model->gpu_animation.params_buffer == NULL) {
+    return;
+  }
+  const uint32_t last_animation = model->animation_count - 1;
+  const gltf_animation_params_t params = {
+    .animations    = {MIN(blend->animations[0], last_animation),
+                      MIN(blend->animations[1], last_animation)},
+    .times         = {blend->times[0], blend->times[1]},
+    .weight        = CLAMP(blend->weight, 0.0f, 1.0f),
+    .node_count    = model->gpu_animation.node_count,
+    .joint_count   = model->gpu_animation.joint_count,
+    .channel_table = model->gpu_animation.channel_table,
+    .range_table   = model->gpu_animation.range_table,
+  };
+  wgpu_queue_write_buffer_batched(model->wgpu_context,
+                                  model->gpu_animation.params_buffer, 0,
+                                  &params, sizeof(params));
+}
 
-  // Create vertex buffer
-  gltf_model->vertices.buffer
-    = wgpu_create_buffer_from_data(load_options->wgpu_context, vertices,
-                                   vertex_buffer_size, WGPUBufferUsage_Vertex);
+void wgpu_gltf_model_dispatch_animation(gltf_model_t* model,
+                                        WGPUComputePassEncoder pass_encoder)
+{
+  if (model->gpu_animation.sample_pipeline == NULL
+      || model->pending_upload_count > 0) {
+    return;
+  }
+  const uint32_t node_groups
+    = (model->gpu_animation.node_count + GLTF_ANIMATION_WORKGROUP_SIZE - 1)
+      / GLTF_ANIMATION_WORKGROUP_SIZE;
+  const uint32_t joint_groups
+    = (model->gpu_animation.joint_count + GLTF_ANIMATION_WORKGROUP_SIZE - 1)
+      / GLTF_ANIMATION_WORKGROUP_SIZE;
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0,
+                                     model->gpu_animation.bind_group, 0, NULL);
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    model->gpu_animation.sample_pipeline);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, node_groups, 1, 1);
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    model->gpu_animation.world_pipeline);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, node_groups, 1, 1);
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    model->gpu_animation.joint_pipeline);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, MAX(joint_groups, 1u),
+                                           1, 1);
+}
 
-  // Create index buffer
-  gltf_model->indices.buffer
-    = wgpu_create_buffer_from_data(load_options->wgpu_context, indices,
-                                   index_buffer_size, WGPUBufferUsage_Index);
+/*
+ * GPU culling
+ *
+ * One invocation per draw list item tests the box of its primitive against the
+ * frustum and, optionally, the depth pyramid of the previous frame, then
+ * writes the indirect draw arguments of the item
+ */
+#define GLTF_CULLING_WORKGROUP_SIZE 64u
+
+typedef struct gltf_cull_params_t {
+  mat4 view_projection;
+  mat4 occlusion_view_projection;
+  uint32_t occlusion_culling; /* test against the depth pyramid */
+  uint32_t item_count;
+  uint32_t padding[2];
+} gltf_cull_params_t;
+
+// clang-format off
+static const char* gltf_culling_compute_shader_wgsl = CODE(
+  struct CullItem {
+    bbMin : vec3<f32>,
+    flags : u32,
+    bbMax : vec3<f32>,
+    nodeIndex : u32,
+    indexCount : u32,
+    firstIndex : u32,
+    baseVertex : i32,
+    padding : u32,
+  };
 
-  if (vertices != NULL) {
-    free(vertices);
+  struct CullParams {
+    viewProjection : mat4x4<f32>,
+    occlusionViewProjection : mat4x4<f32>,
+    occlusionCulling : u32,
+    itemCount : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : CullParams;
+  @group(0) @binding(1) var<storage, read> items : array<CullItem>;
+  @group(0) @binding(2) var<storage, read> nodeMatrices : array<mat4x4<f32>>;
+  @group(0) @binding(3) var<storage, read_write> drawArgs : array<u32>;
+  @group(0) @binding(4) var depthPyramid : texture_2d<f32>;
+
+  fn boxCorner(item : CullItem, corner : u32) -> vec4<f32> {
+    return vec4<f32>(select(item.bbMin.x, item.bbMax.x, (corner & 1u) != 0u),
+                     select(item.bbMin.y, item.bbMax.y, (corner & 2u) != 0u),
+                     select(item.bbMin.z, item.bbMax.z, (corner & 4u) != 0u),
+                     1.0);
   }
-  if (indices != NULL) {
-    free(indices);
+
+  // Outside when all corners are outside of the same clip plane
+  fn isInFrustum(item : CullItem, m : mat4x4<f32>) -> bool {
+    var outside = 0x3fu;
+    for (var i = 0u; i < 8u; i = i + 1u) {
+      let c = m * boxCorner(item, i);
+      var mask = 0u;
+      mask = mask | select(0u, 0x01u, c.x < -c.w);
+      mask = mask | select(0u, 0x02u, c.x > c.w);
+      mask = mask | select(0u, 0x04u, c.y < -c.w);
+      mask = mask | select(0u, 0x08u, c.y > c.w);
+      mask = mask | select(0u, 0x10u, c.z < 0.0);
+      mask = mask | select(0u, 0x20u, c.z > c.w);
+      outside = outside & mask;
+    }
+    return outside == 0u;
   }
 
-  // Get scene dimensions
-  gltf_model_get_scene_dimensions(gltf_model);
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= params.itemCount) {
+      return;
+    }
 
-  // Cleanup
-  cgltf_free(gltf_data);
+    let item = items[index];
+    var visible = true;
+    if ((item.flags & ALWAYS_VISIBLE) == 0u) {
+      let model = nodeMatrices[item.nodeIndex];
+      visible = isInFrustum(item, params.viewProjection * model);
+      if (visible && params.occlusionCulling != 0u) {
+        visible = !hizIsBoxOccluded(depthPyramid,
+                                    params.occlusionViewProjection * model,
+                                    item.bbMin, item.bbMax);
+      }
+    }
 
-  return gltf_model;
-}
+    let base = index * DRAW_ARGS_COUNT;
+    drawArgs[base]      = select(0u, item.indexCount, visible);
+    drawArgs[base + 1u] = select(0u, 1u, visible);
+    drawArgs[base + 2u] = item.firstIndex;
+    drawArgs[base + 3u] = bitcast<u32>(item.baseVertex);
+    drawArgs[base + 4u] = 0u;
+  }
+);
+// clang-format on
 
-static void gltf_model_bind_buffers(gltf_model_t* model)
+static void gltf_model_prepare_gpu_culling(gltf_model_t* model)
 {
   wgpu_context_t* wgpu_context = model->wgpu_context;
-  wgpuRenderPassEncoderSetVertexBuffer(
-    wgpu_context->rpass_enc, 0, model->vertices.buffer, 0, WGPU_WHOLE_SIZE);
-  wgpuRenderPassEncoderSetIndexBuffer(
-    wgpu_context->rpass_enc, model->indices.buffer, WGPUIndexFormat_Uint32, 0,
-    WGPU_WHOLE_SIZE);
-  // model->buffers_bound = true;
+  const uint32_t item_count    = model->draw_list.count;
+  if (!model->gpu_culling.enabled || item_count == 0) {
+    return;
+  }
+
+  model->gpu_culling.items = calloc(item_count, sizeof(gltf_cull_item_t));
+  model->gpu_culling.node_matrices = calloc(model->node_count, sizeof(mat4));
+  model->gpu_culling.item_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF cull item buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+          .size  = item_count * sizeof(gltf_cull_item_t),
+        })
+        .buffer;
+  model->gpu_culling.matrix_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF cull node matrix buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+          .size  = model->node_count * sizeof(mat4),
+        })
+        .buffer;
+  model->gpu_culling.params_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF cull params buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+          .size  = sizeof(gltf_cull_params_t),
+        })
+        .buffer;
+  model->gpu_culling.args_buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF cull draw args buffer",
+          .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect,
+          .size = item_count * GLTF_CULL_DRAW_ARGS_COUNT * sizeof(uint32_t),
+        })
+        .buffer;
+  model->gpu_culling.items_dirty    = true;
+  model->gpu_culling.matrices_dirty = true;
+  model->gpu_culling.args_valid     = false;
+
+  // Bound instead of a depth pyramid when occlusion culling is off
+  model->gpu_culling.dummy_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device, &(WGPUTextureDescriptor){
+                            .label         = "glTF cull dummy texture",
+                            .usage         = WGPUTextureUsage_TextureBinding,
+                            .dimension     = WGPUTextureDimension_2D,
+                            .size          = (WGPUExtent3D){1, 1, 1},
+                            .format        = WGPUTextureFormat_RG32Float,
+                            .mipLevelCount = 1,
+                            .sampleCount   = 1,
+                          });
+  ASSERT(model->gpu_culling.dummy_texture != NULL);
+  model->gpu_culling.dummy_view
+    = wgpuTextureCreateView(model->gpu_culling.dummy_texture, NULL);
+  ASSERT(model->gpu_culling.dummy_view != NULL);
+
+  // Explicit layout, the depth pyramid is not filterable
+  WGPUBindGroupLayoutEntry bgl_entries[5] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Culling parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(gltf_cull_params_t),
+      },
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Cull items
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = item_count * sizeof(gltf_cull_item_t),
+      },
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Node matrices
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = model->node_count * sizeof(mat4),
+      },
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Indirect draw arguments
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = item_count * GLTF_CULL_DRAW_ARGS_COUNT
+                          * sizeof(uint32_t),
+      },
+    },
+    [4] = (WGPUBindGroupLayoutEntry) {
+      // Binding 4: Depth pyramid
+      .binding    = 4,
+      .visibility = WGPUShaderStage_Compute,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
+  };
+  model->gpu_culling.bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "gltf_culling_bind_group_layout",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(model->gpu_culling.bind_group_layout != NULL);
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label = "gltf_culling_pipeline_layout",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &model->gpu_culling.bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  // Compute pipeline, with the visibility test of the depth pyramid
+  char wgsl[8192];
+  snprintf(wgsl, sizeof(wgsl),
+           "let ALWAYS_VISIBLE : u32 = %uu;\n"
+           "let DRAW_ARGS_COUNT : u32 = %uu;\n"
+           "%s\n%s",
+           GLTF_CULL_ITEM_ALWAYS_VISIBLE, GLTF_CULL_DRAW_ARGS_COUNT,
+           wgpu_depth_pyramid_get_wgsl_functions(),
+           gltf_culling_compute_shader_wgsl);
+  wgpu_shader_t culling_comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "gltf_culling_compute_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  model->gpu_culling.pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "gltf_culling_compute_pipeline",
+      .layout  = pipeline_layout,
+      .compute = culling_comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(model->gpu_culling.pipeline != NULL);
+  wgpu_shader_release(&culling_comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
 }
 
-static void
-gltf_model_draw_node(gltf_model_t* model, gltf_node_t* node,
-                     wgpu_gltf_model_render_options_t render_options)
-{
-  uint32_t render_flags = render_options.render_flags;
-
-  if (node->mesh && node->mesh->primitive_count > 0) {
-    if (node->mesh->uniform_buffer.bind_group) {
-      wgpuRenderPassEncoderSetBindGroup(
-        model->wgpu_context->rpass_enc, render_options.bind_mesh_model_set,
-        node->mesh->uniform_buffer.bind_group, 0, 0);
-    }
-    for (uint32_t i = 0; i < node->mesh->primitive_count; ++i) {
-      gltf_primitive_t* primitive = &node->mesh->primitives[i];
-      bool skip                   = false;
-      gltf_material_t* material   = primitive->material;
-      if (render_flags & WGPU_GLTF_RenderFlags_RenderOpaqueNodes) {
-        skip = (material->alpha_mode != AlphaMode_OPAQUE);
-      }
-      if (render_flags & WGPU_GLTF_RenderFlags_RenderAlphaMaskedNodes) {
-        skip = (material->alpha_mode != AlphaMode_MASK);
-      }
-      if (render_flags & WGPU_GLTF_RenderFlags_RenderAlphaBlendedNodes) {
-        skip = (material->alpha_mode != AlphaMode_BLEND);
-      }
-      if (!skip) {
-        // Bind the pipeline for the node's material if present
-        if (material->pipeline) {
-          wgpuRenderPassEncoderSetPipeline(model->wgpu_context->rpass_enc,
-                                           material->pipeline);
-        }
-        if ((render_flags & WGPU_GLTF_RenderFlags_BindImages)
-            && material->bind_group) {
-          wgpuRenderPassEncoderSetBindGroup(model->wgpu_context->rpass_enc,
-                                            render_options.bind_image_set,
-                                            material->bind_group, 0, 0);
-        }
-        wgpuRenderPassEncoderDrawIndexed(model->wgpu_context->rpass_enc,
-                                         primitive->index_count, 1,
-                                         primitive->first_index, 0, 0);
-      }
-    }
+/*
+ * Cull items in draw list order, the first level of detail of each primitive
+ */
+static void gltf_model_update_cull_items(gltf_model_t* model)
+{
+  const bool relative_indices = model->indices.format == WGPUIndexFormat_Uint16;
+  for (uint32_t i = 0; i < model->draw_list.count; ++i) {
+    gltf_draw_item_t* draw_item = &model->draw_list.items[i];
+    gltf_primitive_t* primitive = draw_item->primitive;
+    gltf_cull_item_t* item      = &model->gpu_culling.items[i];
+    bounding_box_t* bb
+      = primitive->bb.valid ? &primitive->bb : &draw_item->node->mesh->bb;
+    *item = (gltf_cull_item_t){
+      .flags = (bb->valid && draw_item->node->skin == NULL) ?
+                 0 :
+                 GLTF_CULL_ITEM_ALWAYS_VISIBLE,
+      .node_index  = (uint32_t)(draw_item->node - model->nodes),
+      .index_count = primitive->lods[0].index_count,
+      .first_index = primitive->lods[0].first_index,
+      .base_vertex = relative_indices ? (int32_t)primitive->first_vertex : 0,
+    };
+    glm_vec3_copy(bb->min, item->bb_min);
+    glm_vec3_copy(bb->max, item->bb_max);
   }
-  for (uint32_t i = 0; i < node->child_count; ++i) {
-    gltf_model_draw_node(model, node->children[i], render_options);
+  wgpu_queue_write_buffer_batched(
+    model->wgpu_context, model->gpu_culling.item_buffer, 0,
+    model->gpu_culling.items,
+    model->draw_list.count * sizeof(gltf_cull_item_t));
+  model->gpu_culling.items_dirty = false;
+}
+
+/*
+ * Node matrices with the y flip of the vertex positions, see
+ * gltf_model_get_world_box
+ */
+static void gltf_model_update_cull_matrices(gltf_model_t* model)
+{
+  mat4 flip_y = GLM_MAT4_IDENTITY_INIT;
+  flip_y[1][1] = -1.0f;
+  for (uint32_t i = 0; i < model->node_count; ++i) {
+    mat4* world_matrix = &model->nodes[i].world_matrix;
+    mat4* dest         = &model->gpu_culling.node_matrices[i];
+    if (!model->culling.flip_y) {
+      glm_mat4_copy(*world_matrix, *dest);
+    }
+    else if (model->culling.pre_transformed) {
+      glm_mat4_mul(flip_y, *world_matrix, *dest);
+    }
+    else {
+      glm_mat4_mul(*world_matrix, flip_y, *dest);
+    }
   }
+  wgpu_queue_write_buffer_batched(
+    model->wgpu_context, model->gpu_culling.matrix_buffer, 0,
+    model->gpu_culling.node_matrices, model->node_count * sizeof(mat4));
+  model->gpu_culling.matrices_dirty = false;
 }
 
-// Draw the glTF scene starting at the top-level-nodes
-void wgpu_gltf_model_draw(gltf_model_t* model,
-                          wgpu_gltf_model_render_options_t render_options)
+void wgpu_gltf_model_dispatch_culling(
+  gltf_model_t* model, WGPUComputePassEncoder pass_encoder,
+  const wgpu_gltf_model_culling_options_t* options)
 {
-  if (!model->buffers_bound) {
-    // All vertices and indices are stored in single buffers, so we only need to
-    // bind once
-    gltf_model_bind_buffers(model);
+  if (model->gpu_culling.pipeline == NULL) {
+    return;
   }
-  // Render all nodes at top-level
-  for (uint32_t i = 0; i < model->node_count; ++i) {
-    gltf_model_draw_node(model, &model->nodes[i], render_options);
+  wgpu_context_t* wgpu_context = model->wgpu_context;
+
+  // The items follow the draw list, which is sorted by the material state
+  if (!model->draw_list.sorted) {
+    gltf_model_sort_draw_list(model);
+  }
+  if (model->gpu_culling.items_dirty) {
+    gltf_model_update_cull_items(model);
   }
+  if (model->gpu_culling.matrices_dirty) {
+    gltf_model_update_cull_matrices(model);
+  }
+
+  wgpu_depth_pyramid_t* pyramid = options->depth_pyramid;
+  gltf_cull_params_t params     = {
+    .item_count = model->draw_list.count,
+  };
+  glm_mat4_copy((vec4*)options->view_projection, params.view_projection);
+  if (pyramid != NULL) {
+    glm_mat4_copy((vec4*)options->previous_view_projection,
+                  params.occlusion_view_projection);
+    params.occlusion_culling = 1;
+  }
+  wgpu_queue_write_buffer_batched(wgpu_context,
+                                  model->gpu_culling.params_buffer, 0, &params,
+                                  sizeof(params));
+
+  // The depth pyramid may be recreated with the swap chain, so the bind group
+  // is built for every dispatch
+  WGPUBindGroupEntry bg_entries[5] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = model->gpu_culling.params_buffer,
+      .size    = sizeof(gltf_cull_params_t),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = model->gpu_culling.item_buffer,
+      .size    = model->draw_list.count * sizeof(gltf_cull_item_t),
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = model->gpu_culling.matrix_buffer,
+      .size    = model->node_count * sizeof(mat4),
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = model->gpu_culling.args_buffer,
+      .size    = model->draw_list.count * GLTF_CULL_DRAW_ARGS_COUNT
+                 * sizeof(uint32_t),
+    },
+    [4] = (WGPUBindGroupEntry) {
+      .binding     = 4,
+      .textureView = pyramid != NULL ? wgpu_depth_pyramid_get_view(pyramid) :
+                                       model->gpu_culling.dummy_view,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "gltf_culling_bind_group",
+                            .layout     = model->gpu_culling.bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(bind_group != NULL);
+
+  wgpuComputePassEncoderSetPipeline(pass_encoder, model->gpu_culling.pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    (model->draw_list.count + GLTF_CULLING_WORKGROUP_SIZE - 1)
+      / GLTF_CULLING_WORKGROUP_SIZE,
+    1, 1);
+  // The pass encoder keeps its own reference on the bind group
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group);
+
+  model->gpu_culling.args_valid = true;
 }
 
 wgpu_gltf_materials_t wgpu_gltf_model_get_materials(gltf_model_t* model)
@@ -1663,6 +6840,75 @@ wgpu_gltf_materials_t wgpu_gltf_model_get_materials(gltf_model_t* model)
   };
 }
 
+uint32_t
+wgpu_gltf_model_get_texture_arrays(gltf_model_t* model,
+                                   wgpu_gltf_texture_array_t** texture_arrays)
+{
+  *texture_arrays = model->texture_packing.arrays;
+  return model->texture_packing.array_count;
+}
+
+WGPUBuffer wgpu_gltf_model_get_material_buffer(gltf_model_t* model)
+{
+  return model->material_table.buffer;
+}
+
+bool wgpu_gltf_model_get_triangles(gltf_model_t* model,
+                                   wgpu_gltf_triangles_t* triangles)
+{
+  if (model->triangles.positions == NULL) {
+    return false;
+  }
+
+  *triangles = (wgpu_gltf_triangles_t){
+    .positions    = model->triangles.positions,
+    .vertex_count = model->triangles.vertex_count,
+    .indices      = model->triangles.indices,
+    .index_count  = model->triangles.index_count,
+    .materials    = model->triangles.materials,
+  };
+  return true;
+}
+
+void wgpu_gltf_model_update_material_buffer(gltf_model_t* model)
+{
+  gltf_model_write_material_buffer(model);
+}
+
+void wgpu_gltf_model_prepare_material_bind_group(
+  gltf_model_t* model, WGPUBindGroupLayout bind_group_layout)
+{
+  if (model->material_table.buffer == NULL) {
+    return;
+  }
+
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = model->material_table.index_buffer,
+      .offset  = 0,
+      .size    = GLTF_MATERIAL_INDEX_SIZE,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = model->material_table.buffer,
+      .offset  = 0,
+      .size    = model->material_count * sizeof(wgpu_gltf_material_data_t),
+    },
+  };
+  WGPUBindGroupDescriptor bg_desc = {
+    .layout     = bind_group_layout,
+    .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+    .entries    = bg_entries,
+  };
+  WGPU_RELEASE_RESOURCE(BindGroup, model->material_table.bind_group)
+  model->material_table.bind_group
+    = wgpuDeviceCreateBindGroup(model->wgpu_context->device, &bg_desc);
+  ASSERT(model->material_table.bind_group != NULL)
+  // Render bundles recorded without the material bind group are stale
+  wgpu_render_bundle_cache_invalidate(model->wgpu_context, model);
+}
+
 static void
 gltf_model_prepare_node_bind_group(gltf_model_t* model, gltf_node_t* node,
                                    WGPUBindGroupLayout bind_group_layout)
@@ -1674,7 +6920,7 @@ gltf_model_prepare_node_bind_group(gltf_model_t* model, gltf_node_t* node,
       .entries    = &(WGPUBindGroupEntry) {
         .binding = 0,
         .buffer  = node->mesh->uniform_buffer.buffer,
-        .offset  = 0,
+        .offset  = node->mesh->uniform_buffer.offset,
         .size    =  node->mesh->uniform_buffer.size,
       },
     };
@@ -1730,9 +6976,7 @@ static void gltf_model_node_calculate_bounding_box(gltf_node_t* node,
 {
   if (node->mesh) {
     if (node->mesh->bb.valid) {
-      mat4 node_matrix;
-      gltf_node_get_matrix(node, &node_matrix);
-      bounding_get_aabb(&node->mesh->bb, node_matrix, &node->aabb);
+      bounding_get_aabb(&node->mesh->bb, node->world_matrix, &node->aabb);
       if (node->child_count == 0) {
         glm_vec3_copy(node->aabb.min, node->bvh.min);
         glm_vec3_copy(node->aabb.max, node->bvh.max);
@@ -1785,78 +7029,291 @@ static void gltf_model_get_scene_dimensions(gltf_model_t* model)
   model->aabb[3][2] = model->dimensions.min[2];
 }
 
-void gltf_model_update_animation(gltf_model_t* model, uint32_t index,
-                                 float time)
+/*
+ * Returns the index of the keyframe starting the interval that contains time.
+ * The channel cursor is checked first, then the following interval for
+ * monotonic playback, a binary search is only done after seeks.
+ */
+static uint32_t
+gltf_animation_sampler_find_key(gltf_animation_sampler_t* sampler,
+                                uint32_t* cursor, float time)
+{
+  const float* inputs = sampler->inputs;
+  const uint32_t last = sampler->input_count - 1;
+  uint32_t key        = MIN(*cursor, last - 1);
+  if (time >= inputs[key] && time <= inputs[key + 1]) {
+    return key;
+  }
+  if (key + 2 <= last && time >= inputs[key + 1] && time <= inputs[key + 2]) {
+    *cursor = key + 1;
+    return key + 1;
+  }
+
+  // Binary search for the last key at or before time
+  uint32_t low = 0, high = last;
+  while (high - low > 1) {
+    const uint32_t mid = low + (high - low) / 2;
+    if (inputs[mid] <= time) {
+      low = mid;
+    }
+    else {
+      high = mid;
+    }
+  }
+  *cursor = low;
+  return low;
+}
+
+/*
+ * Evaluates the sampler at keyframe interval [key, key + 1] and interpolation
+ * factor u
+ */
+static void gltf_animation_sampler_evaluate(gltf_animation_sampler_t* sampler,
+                                            path_type_enum path, uint32_t key,
+                                            float u, vec4 dest)
+{
+  vec4* outputs = sampler->outputs_vec4;
+  switch (sampler->interpolation) {
+    case InterpolationType_STEP: {
+      glm_vec4_copy(outputs[key], dest);
+    } break;
+    case InterpolationType_CUBICSPLINE: {
+      // Each keyframe stores an in-tangent, a value and an out-tangent
+      const float dt  = sampler->inputs[key + 1] - sampler->inputs[key];
+      const float u2  = u * u;
+      const float u3  = u2 * u;
+      const float h00 = 2.0f * u3 - 3.0f * u2 + 1.0f;
+      const float h10 = (u3 - 2.0f * u2 + u) * dt;
+      const float h01 = -2.0f * u3 + 3.0f * u2;
+      const float h11 = (u3 - u2) * dt;
+      for (uint32_t i = 0; i < 4; ++i) {
+        dest[i] = h00 * outputs[key * 3 + 1][i] + h10 * outputs[key * 3 + 2][i]
+                  + h01 * outputs[(key + 1) * 3 + 1][i]
+                  + h11 * outputs[(key + 1) * 3][i];
+      }
+      if (path == PathType_ROTATION) {
+        glm_quat_normalize(dest);
+      }
+    } break;
+    case InterpolationType_LINEAR:
+    default: {
+      if (path == PathType_ROTATION) {
+        glm_quat_slerp(outputs[key], outputs[key + 1], u, dest);
+        glm_quat_normalize(dest);
+      }
+      else {
+        glm_vec4_mix(outputs[key], outputs[key + 1], u, dest);
+      }
+    } break;
+  }
+}
+
+/*
+ * Set the translation, rotation and scale of the animated nodes at the given
+ * time, returns true if a node changed
+ */
+static bool gltf_model_evaluate_animation(gltf_model_t* model, uint32_t index,
+                                          float time)
 {
   if (model->animation_count == 0) {
     log_warn(".glTF does not contain animations.");
-    return;
+    return false;
   }
   if ((int32_t)index > ((int32_t)model->animation_count) - 1) {
     log_warn("No animation with index %u", index);
-    return;
+    return false;
   }
   gltf_animation_t* animation = &model->animations[index];
 
   bool updated = false;
   for (uint32_t c = 0; c < animation->channel_count; ++c) {
     gltf_animation_channel_t* channel = &animation->channels[c];
+    if (!channel->is_valid) {
+      continue;
+    }
     gltf_animation_sampler_t* sampler
       = &animation->samplers[channel->sampler_index];
-    if (sampler->input_count > sampler->outputs_vec4_count) {
+    const uint32_t outputs_per_key
+      = sampler->interpolation == InterpolationType_CUBICSPLINE ? 3 : 1;
+    if (sampler->input_count < 2
+        || sampler->input_count * outputs_per_key
+             > sampler->outputs_vec4_count) {
       continue;
     }
 
-    for (uint32_t i = 0; i < sampler->input_count - 1; ++i) {
-      if ((time >= sampler->inputs[i]) && (time <= sampler->inputs[i + 1])) {
-        float u = MAX(0.0f, time - sampler->inputs[i])
-                  / (sampler->inputs[i + 1] - sampler->inputs[i]);
-        if (u <= 1.0f) {
-          switch (channel->path) {
-            case PathType_TRANSLATION: {
-              vec4 trans = GLM_VEC4_ZERO_INIT;
-              glm_vec4_mix(sampler->outputs_vec4[i],
-                           sampler->outputs_vec4[i + 1], u, trans);
-              glm_vec3_copy((vec3){trans[0], trans[1], trans[2]},
-                            channel->node->translation);
-              break;
-            }
-            case PathType_SCALE: {
-              vec4 trans = GLM_VEC4_ZERO_INIT;
-              glm_vec4_mix(sampler->outputs_vec4[i],
-                           sampler->outputs_vec4[i + 1], u, trans);
-              glm_vec3_copy((vec3){trans[0], trans[1], trans[2]},
-                            channel->node->scale);
-              break;
-            }
-            case PathType_ROTATION: {
-              versor q1  = GLM_VEC4_ZERO_INIT;
-              q1[0]      = sampler->outputs_vec4[i][0];
-              q1[1]      = sampler->outputs_vec4[i][1];
-              q1[2]      = sampler->outputs_vec4[i][2];
-              q1[3]      = sampler->outputs_vec4[i][3];
-              versor q2  = GLM_VEC4_ZERO_INIT;
-              q2[0]      = sampler->outputs_vec4[i + 1][0];
-              q2[1]      = sampler->outputs_vec4[i + 1][1];
-              q2[2]      = sampler->outputs_vec4[i + 1][2];
-              q2[3]      = sampler->outputs_vec4[i + 1][3];
-              versor tmp = GLM_VEC4_ZERO_INIT;
-              glm_quat_slerp(q1, q2, u, tmp);
-              glm_quat_normalize(tmp);
-              glm_vec4_copy(tmp, channel->node->rotation);
-              break;
-            }
-          }
-          updated = true;
-        }
-      }
+    // Times outside of the keyframe range are clamped to the first or the
+    // last interval
+    const float start = sampler->inputs[0];
+    const float end   = sampler->inputs[sampler->input_count - 1];
+    const float t     = MIN(MAX(time, start), end);
+    const uint32_t key
+      = gltf_animation_sampler_find_key(sampler, &channel->key_cursor, t);
+    const float duration = sampler->inputs[key + 1] - sampler->inputs[key];
+    const float u
+      = duration > 0.0f ? (t - sampler->inputs[key]) / duration : 0.0f;
+
+    vec4 value = GLM_VEC4_ZERO_INIT;
+    gltf_animation_sampler_evaluate(sampler, channel->path, key, u, value);
+    switch (channel->path) {
+      case PathType_TRANSLATION:
+        glm_vec3_copy((vec3){value[0], value[1], value[2]},
+                      channel->node->translation);
+        break;
+      case PathType_SCALE:
+        glm_vec3_copy((vec3){value[0], value[1], value[2]},
+                      channel->node->scale);
+        break;
+      case PathType_ROTATION:
+        glm_vec4_copy(value, channel->node->rotation);
+        break;
+    }
+    channel->node->dirty = true;
+    updated              = true;
+  }
+  return updated;
+}
+
+float wgpu_gltf_model_get_animation_end(gltf_model_t* model, uint32_t index)
+{
+  return index < model->animation_count ? model->animations[index].end : 0.0f;
+}
+
+void gltf_model_update_animation(gltf_model_t* model, uint32_t index,
+                                 float time)
+{
+  if (gltf_model_evaluate_animation(model, index, time)) {
+    gltf_model_update_nodes(model);
+  }
+}
+
+static void gltf_models_evaluate_animations(void* user_data, uint32_t begin,
+                                            uint32_t end)
+{
+  const wgpu_gltf_model_animation_update_t* updates = user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    const wgpu_gltf_model_animation_update_t* update = &updates[i];
+    if (gltf_model_evaluate_animation(update->model, update->animation_index,
+                                      update->time)) {
+      gltf_model_evaluate_nodes(update->model);
+    }
+  }
+}
+
+void wgpu_gltf_models_update_animations(
+  const wgpu_gltf_model_animation_update_t* updates, uint32_t update_count)
+{
+  if (update_count == 0) {
+    return;
+  }
+
+  // Every model is evaluated by one job, the uploads follow on this thread
+  PROFILE_BEGIN("glTF animations");
+  job_system_parallel_for(job_system_get_shared(), update_count, 1,
+                          gltf_models_evaluate_animations, (void*)updates);
+  for (uint32_t i = 0; i < update_count; ++i) {
+    gltf_model_upload_nodes(updates[i].model);
+  }
+  // One write per palette, covering the joint matrices of all its models
+  for (uint32_t i = 0; i < update_count; ++i) {
+    if (updates[i].model->compute_skinning.palette != NULL) {
+      gltf_joint_palette_flush(updates[i].model->compute_skinning.palette);
     }
   }
-  if (updated) {
-    for (uint32_t i = 0; i < model->node_count; ++i) {
-      gltf_node_update(model->wgpu_context, &model->nodes[i]);
+  PROFILE_END();
+}
+
+wgpu_gltf_joint_palette_t*
+wgpu_gltf_joint_palette_create(struct wgpu_context_t* wgpu_context,
+                               struct gltf_model_t** models,
+                               uint32_t model_count)
+{
+  wgpu_gltf_joint_palette_t* palette
+    = (wgpu_gltf_joint_palette_t*)calloc(1, sizeof(wgpu_gltf_joint_palette_t));
+  palette->wgpu_context = wgpu_context;
+  palette->models       = (gltf_model_t**)calloc(MAX(model_count, 1u),
+                                                 sizeof(gltf_model_t*));
+  palette->dirty_begin  = UINT32_MAX;
+  palette->dirty_end    = 0;
+
+  // Ranges start at multiples of 4 matrices, the 256 byte storage buffer
+  // offset alignment
+  for (uint32_t i = 0; i < model_count; ++i) {
+    gltf_model_t* model = models[i];
+    if (model->compute_skinning.bind_group == NULL) {
+      log_warn("glTF model %s does not use compute skinning", model->uri);
+      continue;
     }
+    ASSERT(model->compute_skinning.palette == NULL);
+    model->compute_skinning.palette        = palette;
+    model->compute_skinning.palette_offset = palette->matrix_count;
+    palette->matrix_count
+      += (model->compute_skinning.joint_matrix_count + 3) & ~3u;
+    palette->models[palette->model_count++] = model;
+  }
+
+  palette->matrices
+    = (mat4*)calloc(MAX(palette->matrix_count, 1u), sizeof(mat4));
+  for (uint32_t i = 0; i < palette->model_count; ++i) {
+    gltf_model_t* model = palette->models[i];
+    memcpy(&palette->matrices[model->compute_skinning.palette_offset],
+           model->compute_skinning.joint_matrices,
+           model->compute_skinning.joint_matrix_count * sizeof(mat4));
+  }
+  palette->buffer
+    = wgpu_create_buffer(
+        wgpu_context,
+        &(wgpu_buffer_desc_t){
+          .label = "glTF joint palette buffer",
+          .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+          .size  = MAX(palette->matrix_count, 1u) * sizeof(mat4),
+          .initial.data = palette->matrices,
+        })
+        .buffer;
+  for (uint32_t i = 0; i < palette->model_count; ++i) {
+    gltf_model_t* model = palette->models[i];
+    gltf_model_create_skinning_bind_group(
+      model, palette->buffer,
+      model->compute_skinning.palette_offset * sizeof(mat4));
+  }
+
+  return palette;
+}
+
+void wgpu_gltf_joint_palette_release(wgpu_gltf_joint_palette_t* palette)
+{
+  if (palette == NULL) {
+    return;
   }
+
+  // The models skin from their own joint buffer again
+  for (uint32_t i = 0; i < palette->model_count; ++i) {
+    gltf_model_t* model             = palette->models[i];
+    model->compute_skinning.palette = NULL;
+    gltf_model_create_skinning_bind_group(
+      model, model->compute_skinning.joint_buffer, 0);
+    wgpu_queue_write_buffer_batched(
+      model->wgpu_context, model->compute_skinning.joint_buffer, 0,
+      model->compute_skinning.joint_matrices,
+      model->compute_skinning.joint_matrix_count * sizeof(mat4));
+  }
+  WGPU_RELEASE_RESOURCE(Buffer, palette->buffer);
+  free(palette->matrices);
+  free(palette->models);
+  free(palette);
+}
+
+WGPUBuffer
+wgpu_gltf_joint_palette_get_buffer(wgpu_gltf_joint_palette_t* palette)
+{
+  return palette->buffer;
+}
+
+uint32_t wgpu_gltf_joint_palette_get_offset(wgpu_gltf_joint_palette_t* palette,
+                                            struct gltf_model_t* model)
+{
+  return model->compute_skinning.palette == palette ?
+           model->compute_skinning.palette_offset :
+           UINT32_MAX;
 }
 
 /*
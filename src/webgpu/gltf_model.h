@@ -22,6 +22,50 @@ struct wgpu_context_t;
   WGPUVertexBufferLayout name##_vertex_buffer_layout                           \
     = WGPU_VERTBUFFERLAYOUT_DESC(array_stride, vert_attr_desc_##name);
 
+/* Vertex layout of WGPU_GLTF_FileLoadingFlags_CompactVertices models */
+#define WGPU_GLTF_COMPACT_VERTATTR_DESC(l, c)                                  \
+  wgpu_gltf_get_compact_vertex_attribute_description(l, c)
+
+#define WGPU_GLTF_COMPACT_VERTEX_BUFFER_LAYOUT(name, ...)                      \
+  uint64_t array_stride = wgpu_gltf_get_compact_vertex_size();                 \
+  WGPUVertexAttribute vert_attr_desc_##name[] = {__VA_ARGS__};                 \
+  WGPUVertexBufferLayout name##_vertex_buffer_layout                           \
+    = WGPU_VERTBUFFERLAYOUT_DESC(array_stride, vert_attr_desc_##name);
+
+/*
+ * Position-only vertex buffer layout of models loaded with
+ * WGPU_GLTF_FileLoadingFlags_PositionStream, bound to slot 0 when drawing with
+ * WGPU_GLTF_RenderFlags_PositionsOnly
+ */
+#define WGPU_GLTF_POSITION_BUFFER_LAYOUT(name, l)                              \
+  WGPU_VERTEX_BUFFER_LAYOUT(                                                   \
+    name, sizeof(float) * 3,                                                   \
+    WGPU_VERTATTR_DESC(l, WGPUVertexFormat_Float32x3, 0))
+
+/*
+ * Per-instance model matrix for wgpu_gltf_model_draw_instanced, the mat4 is
+ * passed to the vertex shader as four vec4 attributes starting at location l
+ */
+#define WGPU_GLTF_INSTANCE_BUFFER_SLOT 1u
+
+#define WGPU_GLTF_INSTANCE_BUFFER_LAYOUT(name, l)                              \
+  WGPUVertexAttribute instance_attr_desc_##name[4] = {                         \
+    {.shaderLocation = (l) + 0, .format = WGPUVertexFormat_Float32x4,          \
+     .offset = 0},                                                             \
+    {.shaderLocation = (l) + 1, .format = WGPUVertexFormat_Float32x4,          \
+     .offset = 16},                                                            \
+    {.shaderLocation = (l) + 2, .format = WGPUVertexFormat_Float32x4,          \
+     .offset = 32},                                                            \
+    {.shaderLocation = (l) + 3, .format = WGPUVertexFormat_Float32x4,          \
+     .offset = 48},                                                            \
+  };                                                                           \
+  WGPUVertexBufferLayout name##_instance_buffer_layout = {                     \
+    .arrayStride    = sizeof(mat4),                                            \
+    .stepMode       = WGPUVertexStepMode_Instance,                             \
+    .attributeCount = 4,                                                       \
+    .attributes     = instance_attr_desc_##name,                               \
+  };
+
 /*
  * glTF model loading options
  */
@@ -30,7 +74,30 @@ typedef enum wgpu_gltf_file_loading_flags_enum_t {
   WGPU_GLTF_FileLoadingFlags_PreTransformVertices    = 0x00000001,
   WGPU_GLTF_FileLoadingFlags_PreMultiplyVertexColors = 0x00000002,
   WGPU_GLTF_FileLoadingFlags_FlipY                   = 0x00000004,
-  WGPU_GLTF_FileLoadingFlags_DontLoadImages          = 0x00000008
+  WGPU_GLTF_FileLoadingFlags_DontLoadImages          = 0x00000008,
+  /* Load the converted model from / store it to a cache file named after the
+   * model in WGPU_MODEL_CACHE_DIRECTORY */
+  WGPU_GLTF_FileLoadingFlags_UseCache = 0x00000010,
+  /* Skin vertices in a compute pass, see wgpu_gltf_model_dispatch_skinning */
+  WGPU_GLTF_FileLoadingFlags_ComputeSkinning = 0x00000020,
+  /* Quantized vertices, see wgpu_gltf_get_compact_vertex_attribute_description.
+   * Ignored together with WGPU_GLTF_FileLoadingFlags_ComputeSkinning. */
+  WGPU_GLTF_FileLoadingFlags_CompactVertices = 0x00000040,
+  /* Additional deinterleaved position buffer for depth-only passes, ignored
+   * together with WGPU_GLTF_FileLoadingFlags_ComputeSkinning */
+  WGPU_GLTF_FileLoadingFlags_PositionStream = 0x00000080,
+  /* Simplified index ranges per primitive, see wgpu_gltf_model_lod_options_t */
+  WGPU_GLTF_FileLoadingFlags_GenerateLods = 0x00000100,
+  /* Visibility tests in a compute pass, see wgpu_gltf_model_dispatch_culling */
+  WGPU_GLTF_FileLoadingFlags_GpuCulling = 0x00000200,
+  /* Material textures of the same format, size and mip count packed into 2D
+   * array textures, see wgpu_gltf_model_get_texture_arrays */
+  WGPU_GLTF_FileLoadingFlags_PackMaterialTextures = 0x00000400,
+  /* Triangles kept on the CPU, see wgpu_gltf_model_get_triangles */
+  WGPU_GLTF_FileLoadingFlags_KeepTriangles = 0x00000800,
+  /* JPG and PNG images compressed to BC7 and cached, see
+   * wgpu_texture_load_options_t::compression */
+  WGPU_GLTF_FileLoadingFlags_CompressTextures = 0x00001000
 } wgpu_gltf_file_loading_flags_enum_t;
 
 /*
@@ -40,7 +107,17 @@ typedef enum wgpu_gltf_render_flags_enum_t {
   WGPU_GLTF_RenderFlags_BindImages              = 0x00000001,
   WGPU_GLTF_RenderFlags_RenderOpaqueNodes       = 0x00000002,
   WGPU_GLTF_RenderFlags_RenderAlphaMaskedNodes  = 0x00000004,
-  WGPU_GLTF_RenderFlags_RenderAlphaBlendedNodes = 0x00000008
+  /* Blended primitives are drawn in scene order without sorting, pipelines
+   * with the states of wgpu_weighted_oit don't depend on the order */
+  WGPU_GLTF_RenderFlags_RenderAlphaBlendedNodes = 0x00000008,
+  /* Bind the position stream, see WGPU_GLTF_POSITION_BUFFER_LAYOUT */
+  WGPU_GLTF_RenderFlags_PositionsOnly = 0x00000010,
+  /* Bind the material table, see wgpu_gltf_model_prepare_material_bind_group */
+  WGPU_GLTF_RenderFlags_BindMaterialIndex = 0x00000020,
+  /* Draw from the mesh buffer of the load options without vertex and index
+   * buffers, see wgpu_mesh_buffer_draw. The pipelines fetch the vertices with
+   * meshBufferGetVertex, the mesh buffer bind group is bound by the caller. */
+  WGPU_GLTF_RenderFlags_VertexPulling = 0x00000040
 } wgpu_gltf_render_flags_enum_t;
 
 /*
@@ -62,12 +139,32 @@ typedef enum wgpu_gltf_alpha_mode_enum_t {
   AlphaMode_BLEND  = 2,
 } wgpu_gltf_alpha_mode_enum_t;
 
+/*
+ * glTF texture array of the textures sharing their format, size and mip count
+ */
+typedef struct wgpu_gltf_texture_array_t {
+  WGPUTexture texture;
+  WGPUTextureView view; /* 2D array view of all layers */
+  WGPUTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_level_count;
+  uint32_t layer_count;
+} wgpu_gltf_texture_array_t;
+
 /*
  * glTF texture
  */
 typedef struct wgpu_gltf_texture_t {
   wgpu_context_t* wgpu_context;
   texture_t wgpu_texture;
+  /* Set for packed textures, whose own texture is released, the view is a 2D
+   * view of the layer of the array and the sampler is kept */
+  wgpu_gltf_texture_array_t* array;
+  uint32_t layer;
+  /* Key of the texture shared with other models through the registry of the
+   * texture client, 0 for textures owned by the model */
+  uint64_t registry_key;
 } wgpu_gltf_texture_t;
 
 /*
@@ -108,6 +205,7 @@ typedef struct wgpu_gltf_material_t {
   } pbr_workflows;
   WGPUBindGroup bind_group;
   WGPURenderPipeline pipeline;
+  uint32_t index; /* entry of the material buffer */
 } wgpu_gltf_material_t;
 
 typedef struct wgpu_gltf_materials_t {
@@ -123,6 +221,10 @@ typedef struct wgpu_gltf_model_load_options_t {
   const char* filename;
   uint32_t file_loading_flags;
   float scale;
+  /* Optional, receives the vertices and one mesh per primitive level of
+   * detail for WGPU_GLTF_RenderFlags_VertexPulling. The mesh buffer is shared
+   * by several models and uploaded by the caller once they are loaded. */
+  struct wgpu_mesh_buffer* mesh_buffer;
 } wgpu_gltf_model_load_options_t;
 
 /**
@@ -139,9 +241,88 @@ void wgpu_gltf_model_destroy(struct gltf_model_t* model);
 WGPUVertexAttribute wgpu_gltf_get_vertex_attribute_description(
   uint32_t shader_location, wgpu_gltf_vertex_component_enum_t component);
 
+/**
+ * @brief Compact vertex layout counterpart of
+ * wgpu_gltf_get_vertex_attribute_description, half the size of the default
+ * one. Positions stay float32x3, normals and tangents are snorm16x4, UVs
+ * float16x2, colors and weights unorm8x4 and joints uint16x4, the latter have
+ * to be declared as vec4<u32> in the vertex shader.
+ */
+WGPUVertexAttribute wgpu_gltf_get_compact_vertex_attribute_description(
+  uint32_t shader_location, wgpu_gltf_vertex_component_enum_t component);
+
 /** glTF helper functions */
 uint64_t wgpu_gltf_get_vertex_size();
+uint64_t wgpu_gltf_get_compact_vertex_size();
 wgpu_gltf_materials_t wgpu_gltf_model_get_materials();
+
+/* Layer of material textures which are not packed */
+#define WGPU_GLTF_NO_TEXTURE_LAYER 0xffffffffu
+
+/* Entry of the material buffer, indexed by wgpu_gltf_material_t.index, with
+ * the layout of a WGSL struct of two vec4<f32>, three f32 and nine u32. The
+ * layers are those of the material textures in their texture arrays. */
+typedef struct wgpu_gltf_material_data_t {
+  vec4 base_color_factor;
+  vec4 emissive_factor;
+  float metallic_factor;
+  float roughness_factor;
+  float alpha_cutoff;
+  uint32_t alpha_mode; /* wgpu_gltf_alpha_mode_enum_t */
+  uint32_t base_color_layer;
+  uint32_t metallic_roughness_layer;
+  uint32_t normal_layer;
+  uint32_t occlusion_layer;
+  uint32_t emissive_layer;
+  uint32_t padding[3];
+} wgpu_gltf_material_data_t;
+
+/**
+ * @brief Returns the texture arrays of a model loaded with
+ * WGPU_GLTF_FileLoadingFlags_PackMaterialTextures. Materials whose textures
+ * are in the same arrays can share a bind group of the array views and the
+ * material buffer, and select their layers with their material index.
+ */
+uint32_t
+wgpu_gltf_model_get_texture_arrays(struct gltf_model_t* model,
+                                   wgpu_gltf_texture_array_t** texture_arrays);
+/* Storage buffer of one wgpu_gltf_material_data_t per material */
+WGPUBuffer wgpu_gltf_model_get_material_buffer(struct gltf_model_t* model);
+
+/* Triangles of a model loaded with WGPU_GLTF_FileLoadingFlags_KeepTriangles */
+typedef struct wgpu_gltf_triangles_t {
+  /* Three floats per vertex */
+  const float* positions;
+  uint32_t vertex_count;
+  /* Three indices per triangle */
+  const uint32_t* indices;
+  uint32_t index_count;
+  /* Material buffer entry of every triangle */
+  const uint32_t* materials;
+} wgpu_gltf_triangles_t;
+
+/**
+ * @brief Returns the full resolution triangles of the meshes of all nodes,
+ * meshes referenced by several nodes are repeated. The positions are those of
+ * the vertex buffer transformed by the node matrices, unless the vertices are
+ * pre-transformed, skinned meshes are in their initial pose. Returns false if
+ * the triangles have not been kept.
+ */
+bool wgpu_gltf_model_get_triangles(struct gltf_model_t* model,
+                                   wgpu_gltf_triangles_t* triangles);
+/* Writes the material buffer again after material factors have changed */
+void wgpu_gltf_model_update_material_buffer(struct gltf_model_t* model);
+/**
+ * @brief Creates the bind group bound with
+ * WGPU_GLTF_RenderFlags_BindMaterialIndex from a layout of a uniform buffer
+ * with a dynamic offset at binding 0,
+ * holding the material index as first u32 of 16 bytes, and the read-only
+ * material storage buffer at binding 1. The draw functions set the offset of
+ * the material of each primitive, so that materials sharing their bind group
+ * at bind_image_set only change the offset of the material bind group.
+ */
+void wgpu_gltf_model_prepare_material_bind_group(
+  struct gltf_model_t* model, WGPUBindGroupLayout bind_group_layout);
 void wgpu_gltf_model_prepare_nodes_bind_group(
   struct gltf_model_t* model, WGPUBindGroupLayout bind_group_layout);
 void wgpu_gltf_model_prepare_skins_bind_group(
@@ -150,14 +331,209 @@ void wgpu_gltf_model_prepare_skins_bind_group(
 /**
  *  @brief glTF model rendering
  */
+typedef struct wgpu_gltf_model_lod_options_t {
+  bool enabled;
+  /* Camera position in the space of the node matrices */
+  vec3 eye;
+  /* Viewport height in pixels / (2 * tan(vertical field of view / 2)) */
+  float projection_scale;
+  /* Allowed screen-space error in pixels, 0 selects one pixel */
+  float pixel_error;
+} wgpu_gltf_model_lod_options_t;
+
 typedef struct wgpu_gltf_model_render_options_t {
   uint32_t render_flags;
   uint32_t bind_mesh_model_set;
   uint32_t bind_image_set;
+  /* Used with WGPU_GLTF_RenderFlags_BindMaterialIndex */
+  uint32_t bind_material_set;
+  /* Optional, primitives whose world-space bounds are outside of the frustum
+   * are not drawn. The frustum planes must be in the space of the node
+   * matrices, e.g. updated with the projection * view matrix. Skinned meshes
+   * are never culled. */
+  struct frustum_t* frustum;
+  /* Optional, level of detail selection for models loaded with
+   * WGPU_GLTF_FileLoadingFlags_GenerateLods */
+  wgpu_gltf_model_lod_options_t lod;
+  /* Optional with WGPU_GLTF_RenderFlags_PositionsOnly, bound instead of the
+   * material pipelines, the second one for double sided materials */
+  WGPURenderPipeline position_pipelines[2];
 } wgpu_gltf_model_render_options_t;
 void wgpu_gltf_model_draw(struct gltf_model_t* model,
                           wgpu_gltf_model_render_options_t render_options);
+
+/**
+ * @brief wgpu_gltf_model_draw counterpart recording into the given render pass
+ * instead of wgpu_context->rpass_enc, e.g. from the encode function of a pass
+ * encoded with wgpu_encode_passes. Several passes can draw the same model at
+ * the same time once wgpu_gltf_model_prepare_draw has been called after the
+ * last change of its materials, as long as nothing updates the model before
+ * they are encoded.
+ */
+void wgpu_gltf_model_draw_to_pass(
+  struct gltf_model_t* model, WGPURenderPassEncoder rpass_enc,
+  wgpu_gltf_model_render_options_t render_options);
+
+/* Sorts the draw list by the current material pipelines and bind groups, when
+ * they changed, to be called from the main thread */
+void wgpu_gltf_model_prepare_draw(struct gltf_model_t* model);
+
+/**
+ * @brief Draws instance_count copies of the model with one draw call per
+ * primitive. The per-instance data is either read from instance_buffer, bound
+ * to vertex buffer slot WGPU_GLTF_INSTANCE_BUFFER_SLOT (see
+ * WGPU_GLTF_INSTANCE_BUFFER_LAYOUT), or, when instance_buffer is NULL, from a
+ * storage buffer the caller has bound and indexed with the instance index.
+ * The frustum and level of detail options are ignored.
+ */
+void wgpu_gltf_model_draw_instanced(
+  struct gltf_model_t* model, wgpu_gltf_model_render_options_t render_options,
+  WGPUBuffer instance_buffer, uint32_t instance_count);
+
+/**
+ * @brief Render bundle options, bundles don't inherit the state of the render
+ * pass they are executed in.
+ */
+#define WGPU_GLTF_MAX_BUNDLE_BIND_GROUPS 4u
+
+typedef struct wgpu_gltf_model_bundle_options_t {
+  /* Attachments of the render pass the bundle is executed in */
+  wgpu_render_bundle_formats_t formats;
+  /* Optional, pipeline of materials without their own */
+  WGPURenderPipeline pipeline;
+  /* Optional bind groups of the caller, entry i is bound to group i */
+  WGPUBindGroup bind_groups[WGPU_GLTF_MAX_BUNDLE_BIND_GROUPS];
+} wgpu_gltf_model_bundle_options_t;
+
+/**
+ * @brief wgpu_gltf_model_draw counterpart replaying the draw list from a
+ * render bundle of the context's render bundle cache. The bundle is recorded
+ * again once the materials or the render or bundle options change. Camera
+ * dependent CPU frustum culling and level of detail selection are not
+ * bundled, such draws are encoded directly unless GPU culling replaces them.
+ * The pipeline, bind groups and vertex buffers of the render pass are reset
+ * after the bundle is executed.
+ */
+void wgpu_gltf_model_draw_bundled(
+  struct gltf_model_t* model, wgpu_gltf_model_render_options_t render_options,
+  const wgpu_gltf_model_bundle_options_t* bundle_options);
+
+/**
+ * @brief Records the skinning of a model loaded with
+ * WGPU_GLTF_FileLoadingFlags_ComputeSkinning. The joint matrices are read from
+ * a storage buffer without the WGPU_GLTF_MAX_NUM_JOINTS limit and the skinned
+ * positions, normals and tangents are written once per frame to the vertex
+ * buffer bound by wgpu_gltf_model_draw, so that all passes drawing the model
+ * share them. The joint count of the mesh uniform block is zero in this mode.
+ * The morph targets are applied first, skinned or not.
+ */
+void wgpu_gltf_model_dispatch_skinning(struct gltf_model_t* model,
+                                       WGPUComputePassEncoder pass_encoder);
+
+/* Morph targets of the meshes of a model loaded with
+ * WGPU_GLTF_FileLoadingFlags_ComputeSkinning, evaluated by
+ * wgpu_gltf_model_dispatch_skinning. Returns 0 for meshes without targets. */
+uint32_t wgpu_gltf_model_get_morph_target_count(struct gltf_model_t* model,
+                                                uint32_t mesh_index);
+/* Sets the weights of the first count targets of the mesh, initially the
+ * default weights of the mesh. Targets with zero weight are skipped. */
+void wgpu_gltf_model_set_morph_weights(struct gltf_model_t* model,
+                                       uint32_t mesh_index,
+                                       const float* weights, uint32_t count);
+
+/* Two animations sampled at their own times, blended by weight (0 is the
+ * first, 1 the second one) */
+typedef struct wgpu_gltf_model_animation_blend_t {
+  uint32_t animations[2];
+  float times[2];
+  float weight;
+} wgpu_gltf_model_animation_blend_t;
+
+/**
+ * @brief Uploads the keyframes of all animations of a model loaded with
+ * WGPU_GLTF_FileLoadingFlags_ComputeSkinning, so that the animations are
+ * sampled, blended and turned into joint matrices by
+ * wgpu_gltf_model_dispatch_animation. The current node transforms are the rest
+ * pose of the nodes without animated channels. The joint matrices then replace
+ * the ones of the CPU animation updates, the mesh node matrices of the uniform
+ * blocks keep the CPU pose.
+ * @return false if the model has no compute skinning or no animations
+ */
+bool wgpu_gltf_model_prepare_gpu_animation(struct gltf_model_t* model);
+void wgpu_gltf_model_set_animation_blend(
+  struct gltf_model_t* model, const wgpu_gltf_model_animation_blend_t* blend);
+/* Records the animation passes, before wgpu_gltf_model_dispatch_skinning in the
+ * same compute pass */
+void wgpu_gltf_model_dispatch_animation(struct gltf_model_t* model,
+                                        WGPUComputePassEncoder pass_encoder);
+/**
+ * @brief GPU culling options, the matrices transform from the space of the
+ * node matrices to clip space.
+ */
+typedef struct wgpu_gltf_model_culling_options_t {
+  mat4 view_projection;
+  /* Optional occlusion culling against the depth of the previous frame, the
+   * pyramid has to be built from it and previous_view_projection is the
+   * matrix it was rendered with */
+  wgpu_depth_pyramid_t* depth_pyramid;
+  mat4 previous_view_projection;
+} wgpu_gltf_model_culling_options_t;
+
+/**
+ * @brief Records the visibility tests of all primitives of a model loaded with
+ * WGPU_GLTF_FileLoadingFlags_GpuCulling. Primitives outside of the frustum, or
+ * behind the depth of the previous frame, get an empty indirect draw, which
+ * wgpu_gltf_model_draw uses from then on instead of the CPU frustum test and
+ * the level of detail selection. Once called, it has to be called every frame
+ * before drawing. Skinned meshes are never culled.
+ */
+void wgpu_gltf_model_dispatch_culling(
+  struct gltf_model_t* model, WGPUComputePassEncoder pass_encoder,
+  const wgpu_gltf_model_culling_options_t* options);
+/* Time of the last keyframe of an animation, the times given to
+ * gltf_model_update_animation and the animation blend are clamped to it */
+float wgpu_gltf_model_get_animation_end(struct gltf_model_t* model,
+                                        uint32_t index);
 void gltf_model_update_animation(struct gltf_model_t* model, uint32_t index,
                                  float time);
 
+/*
+ * Shared joint palette.
+ *
+ * The joint matrices of several models loaded with
+ * WGPU_GLTF_FileLoadingFlags_ComputeSkinning in one storage buffer, each model
+ * has a range of it starting at a 256 byte aligned offset. While attached, the
+ * models skin from the palette instead of their own joint buffer and their
+ * changed ranges are uploaded with one write. Models without compute skinning
+ * are skipped. Must be released before the models.
+ */
+typedef struct wgpu_gltf_joint_palette wgpu_gltf_joint_palette_t;
+
+wgpu_gltf_joint_palette_t*
+wgpu_gltf_joint_palette_create(struct wgpu_context_t* wgpu_context,
+                               struct gltf_model_t** models,
+                               uint32_t model_count);
+void wgpu_gltf_joint_palette_release(wgpu_gltf_joint_palette_t* palette);
+WGPUBuffer
+wgpu_gltf_joint_palette_get_buffer(wgpu_gltf_joint_palette_t* palette);
+/* First joint matrix of a model in the palette, UINT32_MAX if not attached */
+uint32_t wgpu_gltf_joint_palette_get_offset(wgpu_gltf_joint_palette_t* palette,
+                                            struct gltf_model_t* model);
+
+typedef struct wgpu_gltf_model_animation_update_t {
+  struct gltf_model_t* model;
+  uint32_t animation_index;
+  float time;
+} wgpu_gltf_model_animation_update_t;
+
+/**
+ * @brief Updates the animations of several models like
+ * gltf_model_update_animation. Every model is evaluated by a job of the shared
+ * job system, then the uniform blocks and joint matrices are uploaded from
+ * the calling thread, with one write per joint palette. Each model may only
+ * appear once.
+ */
+void wgpu_gltf_models_update_animations(
+  const wgpu_gltf_model_animation_update_t* updates, uint32_t update_count);
+
 #endif
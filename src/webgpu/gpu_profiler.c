@@ -0,0 +1,324 @@
+#include "gpu_profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "../core/platform.h"
+#include "../core/profiler.h"
+
+/* Two timestamps (begin / end) for the frame and per scope */
+#define WGPU_GPU_PROFILER_QUERY_COUNT                                          \
+  (2u * (1u + WGPU_GPU_PROFILER_MAX_SCOPE_COUNT))
+#define WGPU_GPU_PROFILER_SCOPE_QUERY(scope) (2u * (1u + (scope)))
+#define WGPU_GPU_PROFILER_BUFFER_SIZE                                          \
+  (WGPU_GPU_PROFILER_QUERY_COUNT * sizeof(uint64_t))
+
+typedef struct wgpu_gpu_profiler_readback_t {
+  struct wgpu_gpu_profiler* gpu_profiler;
+  WGPUBuffer buffer;
+  bool pending;       /* mapping in progress, buffer not reusable */
+  bool frame_started; /* frame timestamps were written */
+  /* Profiler clock time the frame started at, anchors its GPU timestamps */
+  uint64_t frame_begin_ns;
+  uint32_t scope_count;
+  char scope_names[WGPU_GPU_PROFILER_MAX_SCOPE_COUNT]
+                  [WGPU_GPU_PROFILER_MAX_SCOPE_NAME_LENGTH];
+} wgpu_gpu_profiler_readback_t;
+
+struct wgpu_gpu_profiler {
+  wgpu_context_t* wgpu_context;
+  WGPUQuerySet query_set;
+  WGPUBuffer resolve_buffer;
+  /* Scopes of the frame being recorded, the frame has started once its begin
+   * timestamp was submitted */
+  bool frame_active;
+  bool frame_started;
+  uint64_t frame_begin_ns;
+  uint32_t scope_count;
+  char scope_names[WGPU_GPU_PROFILER_MAX_SCOPE_COUNT]
+                  [WGPU_GPU_PROFILER_MAX_SCOPE_NAME_LENGTH];
+  /* Readback buffers in flight */
+  wgpu_gpu_profiler_readback_t readbacks[WGPU_GPU_PROFILER_READBACK_COUNT];
+  /* Results of the last read back frame */
+  wgpu_gpu_profiler_result_t results[WGPU_GPU_PROFILER_MAX_SCOPE_COUNT];
+  uint32_t result_count;
+  float frame_gpu_time_ms;
+};
+
+/* Timestamps are in nanoseconds */
+static float wgpu_gpu_profiler_elapsed_ms(uint64_t begin, uint64_t end)
+{
+  return (end > begin) ? (float)(end - begin) / 1e6f : 0.0f;
+}
+
+wgpu_gpu_profiler_t* wgpu_gpu_profiler_create(wgpu_context_t* wgpu_context)
+{
+  if (!wgpu_has_feature(wgpu_context, WGPUFeatureName_TimestampQuery)) {
+    log_info("Timestamp queries not supported, GPU profiler disabled");
+    return NULL;
+  }
+
+  wgpu_gpu_profiler_t* gpu_profiler
+    = (wgpu_gpu_profiler_t*)malloc(sizeof(wgpu_gpu_profiler_t));
+  memset(gpu_profiler, 0, sizeof(wgpu_gpu_profiler_t));
+  gpu_profiler->wgpu_context = wgpu_context;
+
+  gpu_profiler->query_set = wgpuDeviceCreateQuerySet(
+    wgpu_context->device, &(WGPUQuerySetDescriptor){
+                            .label = "gpu-profiler-query-set",
+                            .type  = WGPUQueryType_Timestamp,
+                            .count = WGPU_GPU_PROFILER_QUERY_COUNT,
+                          });
+  ASSERT(gpu_profiler->query_set != NULL);
+
+  gpu_profiler->resolve_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "gpu-profiler-resolve-buffer",
+      .usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc,
+      .size  = WGPU_GPU_PROFILER_BUFFER_SIZE,
+    });
+  ASSERT(gpu_profiler->resolve_buffer != NULL);
+
+  for (uint32_t i = 0; i < WGPU_GPU_PROFILER_READBACK_COUNT; ++i) {
+    wgpu_gpu_profiler_readback_t* readback = &gpu_profiler->readbacks[i];
+    readback->gpu_profiler                 = gpu_profiler;
+    readback->buffer                       = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .label = "gpu-profiler-readback-buffer",
+        .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+        .size  = WGPU_GPU_PROFILER_BUFFER_SIZE,
+      });
+    ASSERT(readback->buffer != NULL);
+  }
+
+  return gpu_profiler;
+}
+
+void wgpu_gpu_profiler_release(wgpu_gpu_profiler_t* gpu_profiler)
+{
+  if (gpu_profiler == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < WGPU_GPU_PROFILER_READBACK_COUNT; ++i) {
+    wgpu_gpu_profiler_readback_t* readback = &gpu_profiler->readbacks[i];
+    if (readback->buffer != NULL) {
+      /* Pending map callbacks are fired with DestroyedBeforeCallback */
+      wgpuBufferDestroy(readback->buffer);
+      WGPU_RELEASE_RESOURCE(Buffer, readback->buffer)
+    }
+  }
+  WGPU_RELEASE_RESOURCE(Buffer, gpu_profiler->resolve_buffer)
+  WGPU_RELEASE_RESOURCE(QuerySet, gpu_profiler->query_set)
+
+  free(gpu_profiler);
+}
+
+uint32_t wgpu_gpu_profiler_begin_scope(wgpu_gpu_profiler_t* gpu_profiler,
+                                       WGPUCommandEncoder cmd_enc,
+                                       const char* name)
+{
+  if (gpu_profiler == NULL
+      || gpu_profiler->scope_count == WGPU_GPU_PROFILER_MAX_SCOPE_COUNT) {
+    return WGPU_GPU_PROFILER_INVALID_SCOPE;
+  }
+
+  const uint32_t scope = gpu_profiler->scope_count++;
+  snprintf(gpu_profiler->scope_names[scope],
+           WGPU_GPU_PROFILER_MAX_SCOPE_NAME_LENGTH, "%s", name);
+  wgpuCommandEncoderWriteTimestamp(cmd_enc, gpu_profiler->query_set,
+                                   WGPU_GPU_PROFILER_SCOPE_QUERY(scope));
+
+  return scope;
+}
+
+void wgpu_gpu_profiler_end_scope(wgpu_gpu_profiler_t* gpu_profiler,
+                                 WGPUCommandEncoder cmd_enc, uint32_t scope)
+{
+  if (gpu_profiler == NULL || scope >= gpu_profiler->scope_count) {
+    return;
+  }
+
+  wgpuCommandEncoderWriteTimestamp(cmd_enc, gpu_profiler->query_set,
+                                   WGPU_GPU_PROFILER_SCOPE_QUERY(scope) + 1);
+}
+
+/* Command buffer writing a single timestamp */
+static WGPUCommandBuffer
+wgpu_gpu_profiler_create_timestamp_commands(wgpu_gpu_profiler_t* gpu_profiler,
+                                            uint32_t query_index)
+{
+  WGPUCommandEncoder cmd_enc = wgpuDeviceCreateCommandEncoder(
+    gpu_profiler->wgpu_context->device, NULL);
+  wgpuCommandEncoderWriteTimestamp(cmd_enc, gpu_profiler->query_set,
+                                   query_index);
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  return command_buffer;
+}
+
+void wgpu_gpu_profiler_begin_frame(wgpu_gpu_profiler_t* gpu_profiler)
+{
+  if (gpu_profiler == NULL) {
+    return;
+  }
+
+  gpu_profiler->frame_active  = true;
+  gpu_profiler->frame_started = false;
+}
+
+void wgpu_gpu_profiler_get_submit_commands(wgpu_gpu_profiler_t* gpu_profiler,
+                                           WGPUCommandBuffer* frame_begin,
+                                           WGPUCommandBuffer* frame_end)
+{
+  *frame_begin = NULL;
+  *frame_end   = NULL;
+  if (gpu_profiler == NULL || !gpu_profiler->frame_active) {
+    return;
+  }
+
+  /* The frame starts with the commands of its first submission and ends with
+   * the ones of its last, the end timestamp is overwritten by every
+   * submission */
+  if (!gpu_profiler->frame_started) {
+    *frame_begin
+      = wgpu_gpu_profiler_create_timestamp_commands(gpu_profiler, 0);
+    gpu_profiler->frame_started  = true;
+    gpu_profiler->frame_begin_ns = platform_get_time_ns();
+  }
+  *frame_end = wgpu_gpu_profiler_create_timestamp_commands(gpu_profiler, 1);
+}
+
+static void wgpu_gpu_profiler_readback_map_cb(WGPUBufferMapAsyncStatus status,
+                                              void* user_data)
+{
+  wgpu_gpu_profiler_readback_t* readback
+    = (wgpu_gpu_profiler_readback_t*)user_data;
+  if (status == WGPUBufferMapAsyncStatus_DestroyedBeforeCallback
+      || status == WGPUBufferMapAsyncStatus_UnmappedBeforeCallback) {
+    return;
+  }
+
+  if (status == WGPUBufferMapAsyncStatus_Success) {
+    wgpu_gpu_profiler_t* gpu_profiler = readback->gpu_profiler;
+    const uint64_t* timestamps        = (const uint64_t*)
+      wgpuBufferGetConstMappedRange(readback->buffer, 0,
+                                    WGPU_GPU_PROFILER_BUFFER_SIZE);
+    ASSERT(timestamps != NULL);
+    if (readback->frame_started) {
+      gpu_profiler->frame_gpu_time_ms
+        = wgpu_gpu_profiler_elapsed_ms(timestamps[0], timestamps[1]);
+    }
+    for (uint32_t i = 0; i < readback->scope_count; ++i) {
+      const uint64_t* scope_timestamps
+        = &timestamps[WGPU_GPU_PROFILER_SCOPE_QUERY(i)];
+      wgpu_gpu_profiler_result_t* result = &gpu_profiler->results[i];
+      memcpy(result->name, readback->scope_names[i],
+             WGPU_GPU_PROFILER_MAX_SCOPE_NAME_LENGTH);
+      result->gpu_time_ms
+        = wgpu_gpu_profiler_elapsed_ms(scope_timestamps[0], scope_timestamps[1]);
+    }
+    gpu_profiler->result_count = readback->scope_count;
+
+    /* The GPU clock is not related to the CPU one, the scopes are placed
+     * relative to the start of the frame on the CPU */
+    if (readback->frame_started && timestamps[1] >= timestamps[0]) {
+      const uint64_t origin = readback->frame_begin_ns - timestamps[0];
+      PROFILE_TRACK_EVENT("GPU", "GPU frame", origin + timestamps[0],
+                          origin + timestamps[1]);
+      for (uint32_t i = 0; i < readback->scope_count; ++i) {
+        const uint64_t* scope_timestamps
+          = &timestamps[WGPU_GPU_PROFILER_SCOPE_QUERY(i)];
+        if (scope_timestamps[0] >= timestamps[0]
+            && scope_timestamps[1] >= scope_timestamps[0]) {
+          PROFILE_TRACK_EVENT("GPU", readback->scope_names[i],
+                              origin + scope_timestamps[0],
+                              origin + scope_timestamps[1]);
+        }
+      }
+      UNUSED_VAR(origin);
+    }
+    wgpuBufferUnmap(readback->buffer);
+  }
+  else {
+    log_warn("GPU profiler readback failed (status: %d)", status);
+  }
+
+  readback->pending = false;
+}
+
+void wgpu_gpu_profiler_end_frame(wgpu_gpu_profiler_t* gpu_profiler)
+{
+  if (gpu_profiler == NULL) {
+    return;
+  }
+  if (!gpu_profiler->frame_started && gpu_profiler->scope_count == 0) {
+    gpu_profiler->frame_active = false;
+    return;
+  }
+
+  /* Find a readback buffer that is not in use, drop the frame otherwise */
+  wgpu_gpu_profiler_readback_t* readback = NULL;
+  for (uint32_t i = 0; i < WGPU_GPU_PROFILER_READBACK_COUNT; ++i) {
+    if (!gpu_profiler->readbacks[i].pending) {
+      readback = &gpu_profiler->readbacks[i];
+      break;
+    }
+  }
+  const bool frame_started    = gpu_profiler->frame_started;
+  const uint32_t scope_count  = gpu_profiler->scope_count;
+  gpu_profiler->frame_active  = false;
+  gpu_profiler->frame_started = false;
+  gpu_profiler->scope_count   = 0;
+  if (readback == NULL) {
+    return;
+  }
+
+  wgpu_context_t* wgpu_context = gpu_profiler->wgpu_context;
+  const uint32_t query_count   = WGPU_GPU_PROFILER_SCOPE_QUERY(scope_count);
+  const uint64_t size          = query_count * sizeof(uint64_t);
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  wgpuCommandEncoderResolveQuerySet(cmd_enc, gpu_profiler->query_set, 0,
+                                    query_count, gpu_profiler->resolve_buffer,
+                                    0);
+  wgpuCommandEncoderCopyBufferToBuffer(cmd_enc, gpu_profiler->resolve_buffer,
+                                       0, readback->buffer, 0, size);
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  readback->pending       = true;
+  readback->frame_started  = frame_started;
+  readback->frame_begin_ns = gpu_profiler->frame_begin_ns;
+  readback->scope_count    = scope_count;
+  memcpy(readback->scope_names, gpu_profiler->scope_names,
+         sizeof(readback->scope_names));
+  wgpuBufferMapAsync(readback->buffer, WGPUMapMode_Read, 0,
+                     WGPU_GPU_PROFILER_BUFFER_SIZE,
+                     wgpu_gpu_profiler_readback_map_cb, readback);
+}
+
+uint32_t
+wgpu_gpu_profiler_get_results(wgpu_gpu_profiler_t* gpu_profiler,
+                              const wgpu_gpu_profiler_result_t** results)
+{
+  if (gpu_profiler == NULL) {
+    *results = NULL;
+    return 0;
+  }
+
+  *results = gpu_profiler->results;
+  return gpu_profiler->result_count;
+}
+
+float wgpu_gpu_profiler_get_frame_time_ms(wgpu_gpu_profiler_t* gpu_profiler)
+{
+  return (gpu_profiler != NULL) ? gpu_profiler->frame_gpu_time_ms : 0.0f;
+}
@@ -0,0 +1,65 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "context.h"
+
+#define WGPU_GPU_PROFILER_MAX_SCOPE_COUNT 32u
+#define WGPU_GPU_PROFILER_MAX_SCOPE_NAME_LENGTH 64u
+#define WGPU_GPU_PROFILER_READBACK_COUNT 3u
+#define WGPU_GPU_PROFILER_INVALID_SCOPE (~0u)
+
+typedef struct wgpu_gpu_profiler wgpu_gpu_profiler_t;
+
+typedef struct wgpu_gpu_profiler_result_t {
+  char name[WGPU_GPU_PROFILER_MAX_SCOPE_NAME_LENGTH];
+  float gpu_time_ms;
+} wgpu_gpu_profiler_result_t;
+
+/*
+ * GPU profiler creating/releasing, returns NULL when the device does not
+ * support timestamp queries
+ */
+wgpu_gpu_profiler_t* wgpu_gpu_profiler_create(wgpu_context_t* wgpu_context);
+void wgpu_gpu_profiler_release(wgpu_gpu_profiler_t* gpu_profiler);
+
+/*
+ * Starts the frame, must be called before the command buffers of the frame
+ * are submitted
+ */
+void wgpu_gpu_profiler_begin_frame(wgpu_gpu_profiler_t* gpu_profiler);
+
+/*
+ * Command buffers to submit before and after the command buffers of every
+ * submission of the frame, in the same submission, so that the GPU frame time
+ * spans the frame's commands without the queue idle time before them. They
+ * are NULL when nothing has to be submitted, e.g. outside of a frame, and
+ * released by the caller after the submission.
+ */
+void wgpu_gpu_profiler_get_submit_commands(wgpu_gpu_profiler_t* gpu_profiler,
+                                           WGPUCommandBuffer* frame_begin,
+                                           WGPUCommandBuffer* frame_end);
+
+/*
+ * Named scopes, recorded outside of render / compute passes. The profiler may
+ * be NULL, in which case the scopes are no-ops.
+ */
+uint32_t wgpu_gpu_profiler_begin_scope(wgpu_gpu_profiler_t* gpu_profiler,
+                                       WGPUCommandEncoder cmd_enc,
+                                       const char* name);
+void wgpu_gpu_profiler_end_scope(wgpu_gpu_profiler_t* gpu_profiler,
+                                 WGPUCommandEncoder cmd_enc, uint32_t scope);
+
+/*
+ * Resolves the scopes of the frame after its command buffers were submitted.
+ * The results are read back asynchronously, a frame is dropped instead of
+ * stalling when all the readback buffers are still in use.
+ */
+void wgpu_gpu_profiler_end_frame(wgpu_gpu_profiler_t* gpu_profiler);
+
+/* Returns the results of the most recently read back frame */
+uint32_t
+wgpu_gpu_profiler_get_results(wgpu_gpu_profiler_t* gpu_profiler,
+                              const wgpu_gpu_profiler_result_t** results);
+float wgpu_gpu_profiler_get_frame_time_ms(wgpu_gpu_profiler_t* gpu_profiler);
+
+#endif
@@ -0,0 +1,376 @@
+#include "gpu_random.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+#define GPU_RANDOM_WORKGROUP_SIZE 64u
+#define GPU_RANDOM_PARAMS_STRIDE 256u
+/* Workgroups of a dispatch row, larger fills dispatch several rows */
+#define GPU_RANDOM_MAX_ROW_WORKGROUPS 65535u
+
+/* Layout of GpuRandomParams */
+typedef struct gpu_random_params_t {
+  float min[4];
+  float max[4];
+  float center[4];
+  float inner_radius;
+  float outer_radius;
+  uint32_t seed;
+  uint32_t distribution;
+  uint32_t element_count;
+  uint32_t first_float;
+  uint32_t float_stride;
+  uint32_t component_count;
+  uint32_t row_size; /* invocations of a dispatch row */
+  uint32_t padding[3];
+} gpu_random_params_t;
+
+struct wgpu_gpu_random {
+  wgpu_context_t* wgpu_context;
+  wgpu_buffer_t params_buffer;
+  WGPUBindGroupLayout params_bind_group_layout;
+  WGPUBindGroupLayout data_bind_group_layout;
+  WGPUPipelineLayout pipeline_layout;
+  WGPUComputePipeline pipeline;
+  WGPUBindGroup params_bind_group;
+};
+
+// clang-format off
+static const char* gpu_random_shader_wgsl = CODE(
+  struct GpuRandomParams {
+    boxMin : vec4<f32>,
+    boxMax : vec4<f32>,
+    center : vec4<f32>,
+    innerRadius : f32,
+    outerRadius : f32,
+    seed : u32,
+    distribution : u32,
+    elementCount : u32,
+    firstFloat : u32,
+    floatStride : u32,
+    componentCount : u32,
+    rowSize : u32,
+    padding0 : u32,
+    padding1 : u32,
+    padding2 : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : GpuRandomParams;
+  @group(1) @binding(0) var<storage, read_write> data : array<f32>;
+
+  const TWO_PI = 6.28318530718;
+
+  fn pcg4d(value : vec4<u32>) -> vec4<u32> {
+    var v = value * 1664525u + 1013904223u;
+    v.x += v.y * v.w;
+    v.y += v.z * v.x;
+    v.z += v.x * v.y;
+    v.w += v.y * v.z;
+    v = v ^ (v >> vec4<u32>(16u));
+    v.x += v.y * v.w;
+    v.y += v.z * v.x;
+    v.z += v.x * v.y;
+    v.w += v.y * v.z;
+    return v;
+  }
+
+  // The upper 24 bits are exactly representable, [0, 1)
+  fn toUnitFloat(v : vec4<u32>) -> vec4<f32> {
+    return vec4<f32>(v >> vec4<u32>(8u)) / 16777216.0;
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_fill(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.y * params.rowSize + id.x;
+    if (index >= params.elementCount) {
+      return;
+    }
+
+    // Independent streams for the shape and for the other components
+    let shape = toUnitFloat(pcg4d(vec4<u32>(index, params.seed, 0u, 0u)));
+    let bounds = toUnitFloat(pcg4d(vec4<u32>(index, params.seed, 1u, 0u)));
+    var value = mix(params.boxMin, params.boxMax, bounds);
+    if (params.distribution == 1u) {
+      // Sphere shell, the cube of the radius is uniform for a uniform volume
+      let z = 2.0 * shape.x - 1.0;
+      let phi = TWO_PI * shape.y;
+      let direction = vec3<f32>(
+        sqrt(max(1.0 - z * z, 0.0)) * vec2<f32>(cos(phi), sin(phi)), z);
+      let inner = params.innerRadius;
+      let outer = params.outerRadius;
+      let radius3 = mix(inner * inner * inner, outer * outer * outer, shape.z);
+      let radius = select(pow(radius3, 1.0 / 3.0), 0.0, radius3 <= 0.0);
+      value = vec4<f32>(params.center.xyz + direction * radius, value.w);
+    }
+    else if (params.distribution == 2u) {
+      // Disc, the square of the radius is uniform for a uniform area
+      let phi = TWO_PI * shape.x;
+      let inner = params.innerRadius;
+      let outer = params.outerRadius;
+      let radius = sqrt(mix(inner * inner, outer * outer, shape.y));
+      value = vec4<f32>(
+        params.center.xy + radius * vec2<f32>(cos(phi), sin(phi)),
+        params.center.z, value.w);
+    }
+
+    let first = params.firstFloat + index * params.floatStride;
+    for (var c = 0u; c < params.componentCount; c++) {
+      data[first + c] = value[c];
+    }
+  }
+);
+// clang-format on
+
+static void gpu_random_create_pipeline(wgpu_gpu_random_t* gpu_random)
+{
+  wgpu_context_t* wgpu_context = gpu_random->wgpu_context;
+
+  // Parameters
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Fill parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(gpu_random_params_t),
+        },
+        .sampler = {0},
+      },
+    };
+    gpu_random->params_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "gpu_random_params_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(gpu_random->params_bind_group_layout != NULL);
+  }
+
+  // Filled buffer
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Data
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type = WGPUBufferBindingType_Storage,
+        },
+        .sampler = {0},
+      },
+    };
+    gpu_random->data_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "gpu_random_data_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(gpu_random->data_bind_group_layout != NULL);
+  }
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    gpu_random->params_bind_group_layout, /* Group 0 */
+    gpu_random->data_bind_group_layout,   /* Group 1 */
+  };
+  gpu_random->pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device,
+    &(WGPUPipelineLayoutDescriptor){
+      .label                = "gpu_random_pipeline_layout",
+      .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+      .bindGroupLayouts     = bind_group_layouts,
+    });
+  ASSERT(gpu_random->pipeline_layout != NULL);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "gpu_random_shader",
+                    .wgsl_code.source = gpu_random_shader_wgsl,
+                    .entry            = "cs_fill",
+                  });
+  gpu_random->pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "gpu_random_pipeline",
+      .layout  = gpu_random->pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(gpu_random->pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+}
+
+wgpu_gpu_random_t* wgpu_gpu_random_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_gpu_random_t* gpu_random
+    = (wgpu_gpu_random_t*)malloc(sizeof(wgpu_gpu_random_t));
+  memset(gpu_random, 0, sizeof(wgpu_gpu_random_t));
+  gpu_random->wgpu_context = wgpu_context;
+
+  gpu_random->params_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "gpu_random_params_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = WGPU_GPU_RANDOM_MAX_FILL_COUNT * GPU_RANDOM_PARAMS_STRIDE,
+    });
+  gpu_random_create_pipeline(gpu_random);
+
+  WGPUBindGroupEntry bg_entries[1] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = gpu_random->params_buffer.buffer,
+      .size    = sizeof(gpu_random_params_t),
+    },
+  };
+  gpu_random->params_bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label  = "gpu_random_params_bind_group",
+                            .layout = gpu_random->params_bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(gpu_random->params_bind_group != NULL);
+
+  return gpu_random;
+}
+
+void wgpu_gpu_random_release(wgpu_gpu_random_t* gpu_random)
+{
+  if (gpu_random == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, gpu_random->params_bind_group)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_random->pipeline)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, gpu_random->pipeline_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, gpu_random->data_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, gpu_random->params_bind_group_layout)
+  wgpu_destroy_buffer(&gpu_random->params_buffer);
+  free(gpu_random);
+}
+
+static uint32_t gpu_random_div_ceil(uint32_t value, uint32_t divisor)
+{
+  return (value + divisor - 1) / divisor;
+}
+
+void wgpu_gpu_random_record(wgpu_gpu_random_t* gpu_random,
+                            WGPUComputePassEncoder pass_encoder,
+                            const wgpu_gpu_random_fill_desc_t* fills,
+                            uint32_t fill_count)
+{
+  ASSERT(fill_count <= WGPU_GPU_RANDOM_MAX_FILL_COUNT);
+  if (fill_count == 0) {
+    return;
+  }
+
+  uint8_t params_data[WGPU_GPU_RANDOM_MAX_FILL_COUNT
+                      * GPU_RANDOM_PARAMS_STRIDE];
+  memset(params_data, 0, sizeof(params_data));
+  uint32_t row_counts[WGPU_GPU_RANDOM_MAX_FILL_COUNT] = {0};
+  for (uint32_t i = 0; i < fill_count; ++i) {
+    const wgpu_gpu_random_fill_desc_t* fill = &fills[i];
+    ASSERT(fill->component_count >= 1 && fill->component_count <= 4);
+    ASSERT(fill->offset % 4 == 0 && fill->element_stride % 4 == 0);
+    ASSERT(fill->element_stride == 0
+           || fill->element_stride >= fill->component_count * 4);
+
+    // The rows of a large fill are the workgroup columns of the dispatch
+    const uint32_t workgroup_count = gpu_random_div_ceil(
+      fill->element_count, GPU_RANDOM_WORKGROUP_SIZE);
+    row_counts[i] = gpu_random_div_ceil(workgroup_count,
+                                        GPU_RANDOM_MAX_ROW_WORKGROUPS);
+    const uint32_t row_workgroups
+      = row_counts[i] > 1 ? GPU_RANDOM_MAX_ROW_WORKGROUPS : workgroup_count;
+
+    gpu_random_params_t params = {
+      .center          = {fill->center[0], fill->center[1], fill->center[2]},
+      .inner_radius    = fill->inner_radius,
+      .outer_radius    = fill->outer_radius,
+      .seed            = fill->seed,
+      .distribution    = (uint32_t)fill->distribution,
+      .element_count   = fill->element_count,
+      .first_float     = (uint32_t)(fill->offset / 4),
+      .float_stride    = fill->element_stride > 0 ? fill->element_stride / 4 :
+                                                    fill->component_count,
+      .component_count = fill->component_count,
+      .row_size        = row_workgroups * GPU_RANDOM_WORKGROUP_SIZE,
+    };
+    memcpy(params.min, fill->min, sizeof(params.min));
+    memcpy(params.max, fill->max, sizeof(params.max));
+    memcpy(&params_data[i * GPU_RANDOM_PARAMS_STRIDE], &params,
+           sizeof(params));
+  }
+  wgpu_queue_write_buffer(gpu_random->wgpu_context,
+                          gpu_random->params_buffer.buffer, 0, params_data,
+                          fill_count * GPU_RANDOM_PARAMS_STRIDE);
+
+  wgpuComputePassEncoderSetPipeline(pass_encoder, gpu_random->pipeline);
+  for (uint32_t i = 0; i < fill_count; ++i) {
+    if (fills[i].element_count == 0) {
+      continue;
+    }
+
+    // The pass keeps the bind group of the buffer alive
+    WGPUBindGroupEntry bg_entries[1] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = fills[i].buffer,
+        .size    = WGPU_WHOLE_SIZE,
+      },
+    };
+    WGPUBindGroup data_bind_group = wgpuDeviceCreateBindGroup(
+      gpu_random->wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "gpu_random_data_bind_group",
+        .layout     = gpu_random->data_bind_group_layout,
+        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+        .entries    = bg_entries,
+      });
+    ASSERT(data_bind_group != NULL);
+
+    const uint32_t dynamic_offset = i * GPU_RANDOM_PARAMS_STRIDE;
+    wgpuComputePassEncoderSetBindGroup(
+      pass_encoder, 0, gpu_random->params_bind_group, 1, &dynamic_offset);
+    wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, data_bind_group, 0,
+                                       NULL);
+    const uint32_t workgroup_count = gpu_random_div_ceil(
+      fills[i].element_count, GPU_RANDOM_WORKGROUP_SIZE);
+    wgpuComputePassEncoderDispatchWorkgroups(
+      pass_encoder,
+      row_counts[i] > 1 ? GPU_RANDOM_MAX_ROW_WORKGROUPS : workgroup_count,
+      row_counts[i], 1);
+    WGPU_RELEASE_RESOURCE(BindGroup, data_bind_group)
+  }
+}
+
+void wgpu_gpu_random_fill(wgpu_context_t* wgpu_context,
+                          const wgpu_gpu_random_fill_desc_t* fills,
+                          uint32_t fill_count)
+{
+  wgpu_gpu_random_t* gpu_random = wgpu_gpu_random_create(wgpu_context);
+
+  WGPUCommandEncoder cmd_encoder
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder pass_encoder
+    = wgpuCommandEncoderBeginComputePass(cmd_encoder, NULL);
+  wgpu_gpu_random_record(gpu_random, pass_encoder, fills, fill_count);
+  wgpuComputePassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass_encoder)
+  WGPUCommandBuffer command_buffer
+    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  ASSERT(command_buffer != NULL);
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  // The submitted commands keep the pipeline and the buffers alive
+  wgpu_gpu_random_release(gpu_random);
+}
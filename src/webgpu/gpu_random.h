@@ -0,0 +1,71 @@
+#ifndef GPU_RANDOM_H
+#define GPU_RANDOM_H
+
+#include "context.h"
+
+#define WGPU_GPU_RANDOM_MAX_FILL_COUNT 16u
+
+/*
+ * GPU random initialization of storage buffers, e.g. the initial state of a
+ * simulation. A compute pass writes the first components of every element of
+ * a buffer from a counter based generator: the values of an element are a
+ * PCG hash (pcg4d, "Hash Functions for GPU Rendering", Jarzynski & Olano) of
+ * its index and of the seed only, so that a fill is reproducible whatever the
+ * dispatch order and that buffers filled with the same seed agree.
+ */
+typedef struct wgpu_gpu_random wgpu_gpu_random_t;
+
+typedef enum wgpu_gpu_random_distribution_enum {
+  /* Uniform in the box [min, max] */
+  WGPU_GPU_RANDOM_DISTRIBUTION_BOX = 0,
+  /* Uniform in the volume between two spheres around center, in xyz */
+  WGPU_GPU_RANDOM_DISTRIBUTION_SPHERE_SHELL = 1,
+  /* Uniform in the area between two circles around center in the xy plane,
+   * z is the one of the center */
+  WGPU_GPU_RANDOM_DISTRIBUTION_DISC = 2,
+} wgpu_gpu_random_distribution_enum;
+
+typedef struct wgpu_gpu_random_fill_desc_t {
+  /* Buffer with the Storage usage and the offset of the first element, in
+   * bytes and a multiple of 4 */
+  WGPUBuffer buffer;
+  uint64_t offset;
+  uint32_t element_count;
+  /* Stride of the elements in bytes and a multiple of 4, tightly packed
+   * components when 0 */
+  uint32_t element_stride;
+  /* Number of f32 components written at the start of every element, 1 to 4.
+   * The components the distribution does not cover, e.g. w, are uniform in
+   * [min, max] like with a box, equal bounds give a constant. */
+  uint32_t component_count;
+  wgpu_gpu_random_distribution_enum distribution;
+  uint32_t seed;
+  /* Box */
+  float min[4];
+  float max[4];
+  /* Sphere shell and disc */
+  float center[3];
+  float inner_radius;
+  float outer_radius;
+} wgpu_gpu_random_fill_desc_t;
+
+/* GPU random generator creating/releasing */
+wgpu_gpu_random_t* wgpu_gpu_random_create(wgpu_context_t* wgpu_context);
+void wgpu_gpu_random_release(wgpu_gpu_random_t* gpu_random);
+
+/**
+ * @brief Records fill_count fills, at most WGPU_GPU_RANDOM_MAX_FILL_COUNT and
+ * one record per submitted frame as they share the parameter buffer.
+ */
+void wgpu_gpu_random_record(wgpu_gpu_random_t* gpu_random,
+                            WGPUComputePassEncoder pass_encoder,
+                            const wgpu_gpu_random_fill_desc_t* fills,
+                            uint32_t fill_count);
+
+/* Records the fills in a command buffer of their own with a temporary
+ * generator and submits it, for buffers initialized once */
+void wgpu_gpu_random_fill(wgpu_context_t* wgpu_context,
+                          const wgpu_gpu_random_fill_desc_t* fills,
+                          uint32_t fill_count);
+
+#endif
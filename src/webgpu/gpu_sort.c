@@ -0,0 +1,768 @@
+#include "gpu_sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+#define GPU_SORT_SCAN_WORKGROUP_SIZE 256u
+#define GPU_SORT_SCAN_BLOCK_SIZE (2u * GPU_SORT_SCAN_WORKGROUP_SIZE)
+#define GPU_SORT_MAX_SCAN_LEVELS 4u
+#define GPU_SORT_RADIX_BLOCK_SIZE 256u
+#define GPU_SORT_RADIX_DIGIT_COUNT 16u
+#define GPU_SORT_RADIX_PASS_COUNT 8u
+#define GPU_SORT_COMPACT_WORKGROUP_SIZE 256u
+#define GPU_SORT_PARAMS_STRIDE 256u
+#define GPU_SORT_MAX_BINDINGS 6u
+#define GPU_SORT_BIND_GROUP_CACHE_SIZE 32u
+
+/* Layout of SortParams, only the scan count is used by the scan */
+typedef struct gpu_sort_params_t {
+  uint32_t count;
+  uint32_t block_count;
+  uint32_t shift;
+  uint32_t padding;
+} gpu_sort_params_t;
+
+typedef struct gpu_sort_bind_group_t {
+  WGPUBindGroupLayout layout;
+  WGPUBuffer buffers[GPU_SORT_MAX_BINDINGS];
+  WGPUBindGroup bind_group;
+} gpu_sort_bind_group_t;
+
+struct wgpu_gpu_sort {
+  wgpu_context_t* wgpu_context;
+  uint32_t max_element_count;
+  uint32_t max_scan_count;
+  /* Parameter blocks, selected with dynamic offsets */
+  wgpu_buffer_t params_buffer;
+  uint32_t next_param_slot;
+  /* Scan levels above the first one */
+  wgpu_buffer_t block_sums_buffers[GPU_SORT_MAX_SCAN_LEVELS];
+  wgpu_buffer_t scanned_sums_buffers[GPU_SORT_MAX_SCAN_LEVELS];
+  wgpu_buffer_t total_buffer; /* block sum of the top level */
+  /* Radix sort and compaction, created on first use */
+  wgpu_buffer_t keys_buffer;
+  wgpu_buffer_t values_buffer;
+  wgpu_buffer_t block_histograms_buffer;
+  wgpu_buffer_t block_offsets_buffer;
+  wgpu_buffer_t compact_offsets_buffer;
+  struct {
+    WGPUBindGroupLayout scan;
+    WGPUBindGroupLayout radix;
+    WGPUBindGroupLayout compact;
+  } bind_group_layouts;
+  struct {
+    WGPUPipelineLayout scan;
+    WGPUPipelineLayout radix;
+    WGPUPipelineLayout compact;
+  } pipeline_layouts;
+  struct {
+    WGPUComputePipeline scan_blocks;
+    WGPUComputePipeline add_block_sums;
+    WGPUComputePipeline histogram;
+    WGPUComputePipeline scatter;
+    WGPUComputePipeline compact;
+  } pipelines;
+  gpu_sort_bind_group_t bind_groups[GPU_SORT_BIND_GROUP_CACHE_SIZE];
+  uint32_t next_bind_group;
+};
+
+// clang-format off
+static const char* gpu_sort_scan_shader_wgsl = CODE(
+  struct SortParams {
+    count : u32,
+    blockCount : u32,
+    shift : u32,
+    padding : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> sortParams : SortParams;
+  @group(0) @binding(1) var<storage, read> scanInput : array<u32>;
+  @group(0) @binding(2) var<storage, read_write> scanOutput : array<u32>;
+  @group(0) @binding(3) var<storage, read_write> scanBlockSums : array<u32>;
+
+  var<workgroup> scanShared : array<u32, 256>;
+
+  // Exclusive scan of a block of 512 elements, two per invocation
+  @compute @workgroup_size(256)
+  fn cs_scan_blocks(@builtin(workgroup_id) groupId : vec3<u32>,
+                    @builtin(local_invocation_id) localId : vec3<u32>) {
+    let count = sortParams.count;
+    let i = groupId.x * 512u + localId.x * 2u;
+    var a = 0u;
+    var b = 0u;
+    if (i < count) {
+      a = scanInput[i];
+    }
+    if (i + 1u < count) {
+      b = scanInput[i + 1u];
+    }
+    let sum = a + b;
+    scanShared[localId.x] = sum;
+    workgroupBarrier();
+
+    // Inclusive scan of the pair sums
+    for (var offset = 1u; offset < 256u; offset = offset * 2u) {
+      var value = scanShared[localId.x];
+      if (localId.x >= offset) {
+        value = value + scanShared[localId.x - offset];
+      }
+      workgroupBarrier();
+      scanShared[localId.x] = value;
+      workgroupBarrier();
+    }
+
+    let prefix = scanShared[localId.x] - sum;
+    if (i < count) {
+      scanOutput[i] = prefix;
+    }
+    if (i + 1u < count) {
+      scanOutput[i + 1u] = prefix + a;
+    }
+    if (localId.x == 255u) {
+      scanBlockSums[groupId.x] = scanShared[255u];
+    }
+  }
+
+  // Adds the scanned block sums of the next level to every block
+  @compute @workgroup_size(256)
+  fn cs_add_block_sums(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= sortParams.count) {
+      return;
+    }
+    scanOutput[id.x] = scanOutput[id.x] + scanInput[id.x / 512u];
+  }
+);
+
+static const char* gpu_sort_radix_shader_wgsl = CODE(
+  struct SortParams {
+    count : u32,
+    blockCount : u32,
+    shift : u32,
+    padding : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> sortParams : SortParams;
+  @group(0) @binding(1) var<storage, read> keysIn : array<u32>;
+  @group(0) @binding(2) var<storage, read> valuesIn : array<u32>;
+  @group(0) @binding(3) var<storage, read_write> keysOut : array<u32>;
+  @group(0) @binding(4) var<storage, read_write> valuesOut : array<u32>;
+  @group(0) @binding(5)
+  var<storage, read_write> blockHistograms : array<u32>;
+  @group(0) @binding(6) var<storage, read> blockOffsets : array<u32>;
+
+  var<workgroup> localHistogram : array<atomic<u32>, 16>;
+  var<workgroup> localKeys : array<u32, 256>;
+  var<workgroup> localValues : array<u32, 256>;
+  var<workgroup> localScan : array<u32, 256>;
+  var<workgroup> digitStart : array<u32, 16>;
+
+  fn getDigit(key : u32) -> u32 {
+    return (key >> sortParams.shift) & 15u;
+  }
+
+  // Digit counts of every block, stored digit-major so that their scan
+  // yields the output offset of every digit of every block
+  @compute @workgroup_size(256)
+  fn cs_histogram(@builtin(workgroup_id) groupId : vec3<u32>,
+                  @builtin(local_invocation_id) localId : vec3<u32>) {
+    if (localId.x < 16u) {
+      atomicStore(&localHistogram[localId.x], 0u);
+    }
+    workgroupBarrier();
+    let i = groupId.x * 256u + localId.x;
+    if (i < sortParams.count) {
+      atomicAdd(&localHistogram[getDigit(keysIn[i])], 1u);
+    }
+    workgroupBarrier();
+    if (localId.x < 16u) {
+      blockHistograms[localId.x * sortParams.blockCount + groupId.x]
+        = atomicLoad(&localHistogram[localId.x]);
+    }
+  }
+
+  @compute @workgroup_size(256)
+  fn cs_scatter(@builtin(workgroup_id) groupId : vec3<u32>,
+                @builtin(local_invocation_id) localId : vec3<u32>) {
+    let lid = localId.x;
+    let i = groupId.x * 256u + lid;
+    let validCount = min(sortParams.count - groupId.x * 256u, 256u);
+    // Padding keys have the last digit, they stay behind the valid keys
+    var key = 0xffffffffu;
+    var value = 0u;
+    if (i < sortParams.count) {
+      key = keysIn[i];
+      value = valuesIn[i];
+    }
+
+    // Stable split by every bit of the digit sorts the block locally
+    for (var bit = 0u; bit < 4u; bit = bit + 1u) {
+      let cleared = 1u - ((getDigit(key) >> bit) & 1u);
+      localScan[lid] = cleared;
+      workgroupBarrier();
+      for (var offset = 1u; offset < 256u; offset = offset * 2u) {
+        var sum = localScan[lid];
+        if (lid >= offset) {
+          sum = sum + localScan[lid - offset];
+        }
+        workgroupBarrier();
+        localScan[lid] = sum;
+        workgroupBarrier();
+      }
+      let clearedBefore = localScan[lid] - cleared;
+      var dst = clearedBefore;
+      if (cleared == 0u) {
+        dst = localScan[255u] + lid - clearedBefore;
+      }
+      localKeys[dst] = key;
+      localValues[dst] = value;
+      workgroupBarrier();
+      key = localKeys[lid];
+      value = localValues[lid];
+      workgroupBarrier();
+    }
+
+    // Position of the first key of every digit in the sorted block
+    let digit = getDigit(key);
+    if (lid == 0u || getDigit(localKeys[lid - 1u]) != digit) {
+      digitStart[digit] = lid;
+    }
+    workgroupBarrier();
+    if (lid < validCount) {
+      let dst = blockOffsets[digit * sortParams.blockCount + groupId.x]
+                + lid - digitStart[digit];
+      keysOut[dst] = key;
+      valuesOut[dst] = value;
+    }
+  }
+);
+
+static const char* gpu_sort_compact_shader_wgsl = CODE(
+  struct SortParams {
+    count : u32,
+    blockCount : u32,
+    shift : u32,
+    padding : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> sortParams : SortParams;
+  @group(0) @binding(1) var<storage, read> compactInput : array<u32>;
+  @group(0) @binding(2) var<storage, read> compactFlags : array<u32>;
+  @group(0) @binding(3) var<storage, read_write> compactOutput : array<u32>;
+  @group(0) @binding(4) var<storage, read_write> compactCount : array<u32>;
+  @group(0) @binding(5) var<storage, read> compactOffsets : array<u32>;
+
+  @compute @workgroup_size(256)
+  fn cs_compact(@builtin(global_invocation_id) id : vec3<u32>) {
+    let i = id.x;
+    if (i >= sortParams.count) {
+      return;
+    }
+    let flag = compactFlags[i];
+    if (flag != 0u) {
+      compactOutput[compactOffsets[i]] = compactInput[i];
+    }
+    if (i == sortParams.count - 1u) {
+      compactCount[0] = compactOffsets[i] + flag;
+    }
+  }
+);
+// clang-format on
+
+static uint32_t gpu_sort_div_ceil(uint32_t value, uint32_t divisor)
+{
+  return (value + divisor - 1) / divisor;
+}
+
+static wgpu_buffer_t
+gpu_sort_create_storage_buffer(wgpu_context_t* wgpu_context, const char* label,
+                               uint32_t element_count)
+{
+  return wgpu_create_buffer(wgpu_context,
+                            &(wgpu_buffer_desc_t){
+                              .label = label,
+                              .usage = WGPUBufferUsage_Storage,
+                              .size  = MAX(element_count, 1) * sizeof(uint32_t),
+                            });
+}
+
+/* Storage bindings of a layout, binding 0 is the parameter block */
+static WGPUBindGroupLayout
+gpu_sort_create_bind_group_layout(wgpu_context_t* wgpu_context,
+                                  const char* label,
+                                  const WGPUBufferBindingType* types,
+                                  uint32_t type_count)
+{
+  WGPUBindGroupLayoutEntry bgl_entries[1 + GPU_SORT_MAX_BINDINGS] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type             = WGPUBufferBindingType_Uniform,
+        .hasDynamicOffset = true,
+        .minBindingSize   = sizeof(gpu_sort_params_t),
+      },
+      .sampler = {0},
+    },
+  };
+  ASSERT(type_count <= GPU_SORT_MAX_BINDINGS);
+  for (uint32_t i = 0; i < type_count; ++i) {
+    bgl_entries[1 + i] = (WGPUBindGroupLayoutEntry) {
+      .binding    = 1 + i,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type = types[i],
+      },
+      .sampler = {0},
+    };
+  }
+  WGPUBindGroupLayout bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = label,
+                            .entryCount = 1 + type_count,
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(bind_group_layout != NULL);
+  return bind_group_layout;
+}
+
+static WGPUPipelineLayout
+gpu_sort_create_pipeline_layout(wgpu_context_t* wgpu_context,
+                                const char* label,
+                                WGPUBindGroupLayout* bind_group_layout)
+{
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = label,
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts     = bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+  return pipeline_layout;
+}
+
+static WGPUComputePipeline
+gpu_sort_create_pipeline(wgpu_context_t* wgpu_context,
+                         WGPUPipelineLayout pipeline_layout,
+                         const wgpu_shader_t* shader, const char* entry)
+{
+  WGPUProgrammableStageDescriptor stage = shader->programmable_stage_descriptor;
+  stage.entryPoint                      = entry;
+  WGPUComputePipeline pipeline          = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = "gpu_sort_pipeline",
+                            .layout  = pipeline_layout,
+                            .compute = stage,
+                          });
+  ASSERT(pipeline != NULL);
+  return pipeline;
+}
+
+static void gpu_sort_create_pipelines(wgpu_gpu_sort_t* gpu_sort)
+{
+  wgpu_context_t* wgpu_context = gpu_sort->wgpu_context;
+
+  // Scan
+  {
+    const WGPUBufferBindingType types[3] = {
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 1: Input */
+      WGPUBufferBindingType_Storage,         /* Binding 2: Output */
+      WGPUBufferBindingType_Storage,         /* Binding 3: Block sums */
+    };
+    gpu_sort->bind_group_layouts.scan = gpu_sort_create_bind_group_layout(
+      wgpu_context, "gpu_sort_scan_bgl", types, (uint32_t)ARRAY_SIZE(types));
+    gpu_sort->pipeline_layouts.scan = gpu_sort_create_pipeline_layout(
+      wgpu_context, "gpu_sort_scan_pipeline_layout",
+      &gpu_sort->bind_group_layouts.scan);
+
+    wgpu_shader_t comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "gpu_sort_scan_shader",
+                      .wgsl_code.source = gpu_sort_scan_shader_wgsl,
+                      .entry            = "cs_scan_blocks",
+                    });
+    gpu_sort->pipelines.scan_blocks = gpu_sort_create_pipeline(
+      wgpu_context, gpu_sort->pipeline_layouts.scan, &comp_shader,
+      "cs_scan_blocks");
+    gpu_sort->pipelines.add_block_sums = gpu_sort_create_pipeline(
+      wgpu_context, gpu_sort->pipeline_layouts.scan, &comp_shader,
+      "cs_add_block_sums");
+    wgpu_shader_release(&comp_shader);
+  }
+
+  // Radix sort
+  {
+    const WGPUBufferBindingType types[6] = {
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 1: Keys in */
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 2: Values in */
+      WGPUBufferBindingType_Storage,         /* Binding 3: Keys out */
+      WGPUBufferBindingType_Storage,         /* Binding 4: Values out */
+      WGPUBufferBindingType_Storage,         /* Binding 5: Histograms */
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 6: Offsets */
+    };
+    gpu_sort->bind_group_layouts.radix = gpu_sort_create_bind_group_layout(
+      wgpu_context, "gpu_sort_radix_bgl", types, (uint32_t)ARRAY_SIZE(types));
+    gpu_sort->pipeline_layouts.radix = gpu_sort_create_pipeline_layout(
+      wgpu_context, "gpu_sort_radix_pipeline_layout",
+      &gpu_sort->bind_group_layouts.radix);
+
+    wgpu_shader_t comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "gpu_sort_radix_shader",
+                      .wgsl_code.source = gpu_sort_radix_shader_wgsl,
+                      .entry            = "cs_histogram",
+                    });
+    gpu_sort->pipelines.histogram = gpu_sort_create_pipeline(
+      wgpu_context, gpu_sort->pipeline_layouts.radix, &comp_shader,
+      "cs_histogram");
+    gpu_sort->pipelines.scatter = gpu_sort_create_pipeline(
+      wgpu_context, gpu_sort->pipeline_layouts.radix, &comp_shader,
+      "cs_scatter");
+    wgpu_shader_release(&comp_shader);
+  }
+
+  // Compaction
+  {
+    const WGPUBufferBindingType types[5] = {
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 1: Input */
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 2: Flags */
+      WGPUBufferBindingType_Storage,         /* Binding 3: Output */
+      WGPUBufferBindingType_Storage,         /* Binding 4: Count */
+      WGPUBufferBindingType_ReadOnlyStorage, /* Binding 5: Offsets */
+    };
+    gpu_sort->bind_group_layouts.compact = gpu_sort_create_bind_group_layout(
+      wgpu_context, "gpu_sort_compact_bgl", types,
+      (uint32_t)ARRAY_SIZE(types));
+    gpu_sort->pipeline_layouts.compact = gpu_sort_create_pipeline_layout(
+      wgpu_context, "gpu_sort_compact_pipeline_layout",
+      &gpu_sort->bind_group_layouts.compact);
+
+    wgpu_shader_t comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "gpu_sort_compact_shader",
+                      .wgsl_code.source = gpu_sort_compact_shader_wgsl,
+                      .entry            = "cs_compact",
+                    });
+    gpu_sort->pipelines.compact = gpu_sort_create_pipeline(
+      wgpu_context, gpu_sort->pipeline_layouts.compact, &comp_shader,
+      "cs_compact");
+    wgpu_shader_release(&comp_shader);
+  }
+}
+
+wgpu_gpu_sort_t* wgpu_gpu_sort_create(wgpu_context_t* wgpu_context,
+                                      const wgpu_gpu_sort_desc_t* desc)
+{
+  ASSERT(desc->max_element_count > 0);
+
+  wgpu_gpu_sort_t* gpu_sort = (wgpu_gpu_sort_t*)malloc(sizeof(wgpu_gpu_sort_t));
+  memset(gpu_sort, 0, sizeof(wgpu_gpu_sort_t));
+  gpu_sort->wgpu_context      = wgpu_context;
+  gpu_sort->max_element_count = desc->max_element_count;
+
+  gpu_sort->params_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "gpu_sort_params_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = WGPU_GPU_SORT_PARAM_SLOT_COUNT * GPU_SORT_PARAMS_STRIDE,
+    });
+
+  // The scans of the radix sort histograms can be longer than the elements
+  const uint32_t max_block_count
+    = gpu_sort_div_ceil(desc->max_element_count, GPU_SORT_RADIX_BLOCK_SIZE);
+  const uint32_t max_histogram_count
+    = GPU_SORT_RADIX_DIGIT_COUNT * max_block_count;
+  gpu_sort->max_scan_count = MAX(desc->max_element_count, max_histogram_count);
+  uint32_t scan_count      = gpu_sort->max_scan_count;
+  for (uint32_t l = 1; scan_count > GPU_SORT_SCAN_BLOCK_SIZE; ++l) {
+    ASSERT(l < GPU_SORT_MAX_SCAN_LEVELS);
+    scan_count = gpu_sort_div_ceil(scan_count, GPU_SORT_SCAN_BLOCK_SIZE);
+    gpu_sort->block_sums_buffers[l] = gpu_sort_create_storage_buffer(
+      wgpu_context, "gpu_sort_block_sums_buffer", scan_count);
+    gpu_sort->scanned_sums_buffers[l] = gpu_sort_create_storage_buffer(
+      wgpu_context, "gpu_sort_scanned_sums_buffer", scan_count);
+  }
+  gpu_sort->total_buffer = gpu_sort_create_storage_buffer(
+    wgpu_context, "gpu_sort_total_buffer", 1);
+
+  gpu_sort_create_pipelines(gpu_sort);
+
+  return gpu_sort;
+}
+
+void wgpu_gpu_sort_release(wgpu_gpu_sort_t* gpu_sort)
+{
+  if (gpu_sort == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < GPU_SORT_BIND_GROUP_CACHE_SIZE; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, gpu_sort->bind_groups[i].bind_group)
+  }
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_sort->pipelines.compact)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_sort->pipelines.scatter)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_sort->pipelines.histogram)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_sort->pipelines.add_block_sums)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, gpu_sort->pipelines.scan_blocks)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, gpu_sort->pipeline_layouts.compact)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, gpu_sort->pipeline_layouts.radix)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, gpu_sort->pipeline_layouts.scan)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, gpu_sort->bind_group_layouts.compact)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, gpu_sort->bind_group_layouts.radix)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, gpu_sort->bind_group_layouts.scan)
+  if (gpu_sort->compact_offsets_buffer.buffer != NULL) {
+    wgpu_destroy_buffer(&gpu_sort->compact_offsets_buffer);
+  }
+  if (gpu_sort->keys_buffer.buffer != NULL) {
+    wgpu_destroy_buffer(&gpu_sort->block_offsets_buffer);
+    wgpu_destroy_buffer(&gpu_sort->block_histograms_buffer);
+    wgpu_destroy_buffer(&gpu_sort->values_buffer);
+    wgpu_destroy_buffer(&gpu_sort->keys_buffer);
+  }
+  wgpu_destroy_buffer(&gpu_sort->total_buffer);
+  for (uint32_t l = 1; l < GPU_SORT_MAX_SCAN_LEVELS; ++l) {
+    if (gpu_sort->block_sums_buffers[l].buffer != NULL) {
+      wgpu_destroy_buffer(&gpu_sort->block_sums_buffers[l]);
+      wgpu_destroy_buffer(&gpu_sort->scanned_sums_buffers[l]);
+    }
+  }
+  wgpu_destroy_buffer(&gpu_sort->params_buffer);
+  free(gpu_sort);
+}
+
+/* Writes the parameters into the next slot, returns its dynamic offset */
+static uint32_t gpu_sort_push_params(wgpu_gpu_sort_t* gpu_sort, uint32_t count,
+                                     uint32_t block_count, uint32_t shift)
+{
+  const gpu_sort_params_t params = {
+    .count       = count,
+    .block_count = block_count,
+    .shift       = shift,
+  };
+  const uint32_t offset = gpu_sort->next_param_slot * GPU_SORT_PARAMS_STRIDE;
+  gpu_sort->next_param_slot
+    = (gpu_sort->next_param_slot + 1) % WGPU_GPU_SORT_PARAM_SLOT_COUNT;
+  wgpuQueueWriteBuffer(gpu_sort->wgpu_context->queue,
+                       gpu_sort->params_buffer.buffer, offset, &params,
+                       sizeof(params));
+  return offset;
+}
+
+/* Bind groups are cached by layout and buffers, the callers reuse a few
+ * buffers every frame */
+static WGPUBindGroup gpu_sort_get_bind_group(wgpu_gpu_sort_t* gpu_sort,
+                                             WGPUBindGroupLayout layout,
+                                             const WGPUBuffer* buffers,
+                                             uint32_t buffer_count)
+{
+  ASSERT(buffer_count <= GPU_SORT_MAX_BINDINGS);
+  WGPUBuffer key[GPU_SORT_MAX_BINDINGS] = {0};
+  memcpy(key, buffers, buffer_count * sizeof(WGPUBuffer));
+  for (uint32_t i = 0; i < GPU_SORT_BIND_GROUP_CACHE_SIZE; ++i) {
+    gpu_sort_bind_group_t* entry = &gpu_sort->bind_groups[i];
+    if (entry->bind_group != NULL && entry->layout == layout
+        && memcmp(entry->buffers, key, sizeof(key)) == 0) {
+      return entry->bind_group;
+    }
+  }
+
+  WGPUBindGroupEntry bg_entries[1 + GPU_SORT_MAX_BINDINGS] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = gpu_sort->params_buffer.buffer,
+      .size    = sizeof(gpu_sort_params_t),
+    },
+  };
+  for (uint32_t i = 0; i < buffer_count; ++i) {
+    bg_entries[1 + i] = (WGPUBindGroupEntry){
+      .binding = 1 + i,
+      .buffer  = key[i],
+      .size    = WGPU_WHOLE_SIZE,
+    };
+  }
+  gpu_sort_bind_group_t* entry
+    = &gpu_sort->bind_groups[gpu_sort->next_bind_group];
+  gpu_sort->next_bind_group
+    = (gpu_sort->next_bind_group + 1) % GPU_SORT_BIND_GROUP_CACHE_SIZE;
+  WGPU_RELEASE_RESOURCE(BindGroup, entry->bind_group)
+  entry->bind_group = wgpuDeviceCreateBindGroup(
+    gpu_sort->wgpu_context->device, &(WGPUBindGroupDescriptor){
+                                      .label      = "gpu_sort_bind_group",
+                                      .layout     = layout,
+                                      .entryCount = 1 + buffer_count,
+                                      .entries    = bg_entries,
+                                    });
+  ASSERT(entry->bind_group != NULL);
+  entry->layout = layout;
+  memcpy(entry->buffers, key, sizeof(key));
+  return entry->bind_group;
+}
+
+static void gpu_sort_dispatch(WGPUComputePassEncoder pass_encoder,
+                              WGPUComputePipeline pipeline,
+                              WGPUBindGroup bind_group, uint32_t params_offset,
+                              uint32_t workgroup_count)
+{
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 1,
+                                     &params_offset);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, workgroup_count, 1,
+                                           1);
+}
+
+void wgpu_gpu_sort_scan(wgpu_gpu_sort_t* gpu_sort,
+                        WGPUComputePassEncoder pass_encoder, WGPUBuffer input,
+                        WGPUBuffer output, uint32_t count)
+{
+  ASSERT(input != output && count <= gpu_sort->max_scan_count);
+  if (count == 0) {
+    return;
+  }
+
+  // Level 0 scans the input, every further level scans the block sums of the
+  // previous one until a single block is left
+  uint32_t level_counts[GPU_SORT_MAX_SCAN_LEVELS] = {count};
+  uint32_t level_count                            = 1;
+  while (level_counts[level_count - 1] > GPU_SORT_SCAN_BLOCK_SIZE) {
+    ASSERT(level_count < GPU_SORT_MAX_SCAN_LEVELS);
+    level_counts[level_count]
+      = gpu_sort_div_ceil(level_counts[level_count - 1],
+                          GPU_SORT_SCAN_BLOCK_SIZE);
+    ++level_count;
+  }
+
+  uint32_t params_offsets[GPU_SORT_MAX_SCAN_LEVELS] = {0};
+  WGPUBuffer outputs[GPU_SORT_MAX_SCAN_LEVELS]      = {output};
+  for (uint32_t l = 0; l < level_count; ++l) {
+    params_offsets[l] = gpu_sort_push_params(gpu_sort, level_counts[l], 0, 0);
+    if (l > 0) {
+      outputs[l] = gpu_sort->scanned_sums_buffers[l].buffer;
+    }
+  }
+
+  for (uint32_t l = 0; l < level_count; ++l) {
+    const WGPUBuffer buffers[3] = {
+      l == 0 ? input : gpu_sort->block_sums_buffers[l].buffer,
+      outputs[l],
+      l + 1 < level_count ? gpu_sort->block_sums_buffers[l + 1].buffer :
+                            gpu_sort->total_buffer.buffer,
+    };
+    gpu_sort_dispatch(
+      pass_encoder, gpu_sort->pipelines.scan_blocks,
+      gpu_sort_get_bind_group(gpu_sort, gpu_sort->bind_group_layouts.scan,
+                              buffers, (uint32_t)ARRAY_SIZE(buffers)),
+      params_offsets[l],
+      gpu_sort_div_ceil(level_counts[l], GPU_SORT_SCAN_BLOCK_SIZE));
+  }
+  for (uint32_t l = level_count - 1; l-- > 0;) {
+    const WGPUBuffer buffers[3] = {
+      outputs[l + 1],
+      outputs[l],
+      gpu_sort->total_buffer.buffer,
+    };
+    gpu_sort_dispatch(
+      pass_encoder, gpu_sort->pipelines.add_block_sums,
+      gpu_sort_get_bind_group(gpu_sort, gpu_sort->bind_group_layouts.scan,
+                              buffers, (uint32_t)ARRAY_SIZE(buffers)),
+      params_offsets[l],
+      gpu_sort_div_ceil(level_counts[l], GPU_SORT_SCAN_WORKGROUP_SIZE));
+  }
+}
+
+void wgpu_gpu_sort_radix_sort(wgpu_gpu_sort_t* gpu_sort,
+                              WGPUComputePassEncoder pass_encoder,
+                              WGPUBuffer keys, WGPUBuffer values,
+                              uint32_t count)
+{
+  ASSERT(count <= gpu_sort->max_element_count);
+  if (count < 2) {
+    return;
+  }
+
+  if (gpu_sort->keys_buffer.buffer == NULL) {
+    wgpu_context_t* wgpu_context = gpu_sort->wgpu_context;
+    const uint32_t max_histogram_count
+      = GPU_SORT_RADIX_DIGIT_COUNT
+        * gpu_sort_div_ceil(gpu_sort->max_element_count,
+                            GPU_SORT_RADIX_BLOCK_SIZE);
+    gpu_sort->keys_buffer = gpu_sort_create_storage_buffer(
+      wgpu_context, "gpu_sort_keys_buffer", gpu_sort->max_element_count);
+    gpu_sort->values_buffer = gpu_sort_create_storage_buffer(
+      wgpu_context, "gpu_sort_values_buffer", gpu_sort->max_element_count);
+    gpu_sort->block_histograms_buffer = gpu_sort_create_storage_buffer(
+      wgpu_context, "gpu_sort_block_histograms_buffer", max_histogram_count);
+    gpu_sort->block_offsets_buffer = gpu_sort_create_storage_buffer(
+      wgpu_context, "gpu_sort_block_offsets_buffer", max_histogram_count);
+  }
+
+  // The passes ping-pong between the buffers of the caller and the internal
+  // ones, the even pass count leaves the result in the buffers of the caller
+  const uint32_t block_count
+    = gpu_sort_div_ceil(count, GPU_SORT_RADIX_BLOCK_SIZE);
+  const WGPUBuffer key_buffers[2]   = {keys, gpu_sort->keys_buffer.buffer};
+  const WGPUBuffer value_buffers[2] = {values, gpu_sort->values_buffer.buffer};
+  for (uint32_t pass = 0; pass < GPU_SORT_RADIX_PASS_COUNT; ++pass) {
+    const uint32_t src           = pass % 2;
+    const uint32_t params_offset = gpu_sort_push_params(
+      gpu_sort, count, block_count, pass * 4);
+    const WGPUBuffer buffers[6] = {
+      key_buffers[src],
+      value_buffers[src],
+      key_buffers[1 - src],
+      value_buffers[1 - src],
+      gpu_sort->block_histograms_buffer.buffer,
+      gpu_sort->block_offsets_buffer.buffer,
+    };
+    WGPUBindGroup bind_group
+      = gpu_sort_get_bind_group(gpu_sort, gpu_sort->bind_group_layouts.radix,
+                                buffers, (uint32_t)ARRAY_SIZE(buffers));
+
+    gpu_sort_dispatch(pass_encoder, gpu_sort->pipelines.histogram, bind_group,
+                      params_offset, block_count);
+    wgpu_gpu_sort_scan(gpu_sort, pass_encoder,
+                       gpu_sort->block_histograms_buffer.buffer,
+                       gpu_sort->block_offsets_buffer.buffer,
+                       GPU_SORT_RADIX_DIGIT_COUNT * block_count);
+    gpu_sort_dispatch(pass_encoder, gpu_sort->pipelines.scatter, bind_group,
+                      params_offset, block_count);
+  }
+}
+
+void wgpu_gpu_sort_compact(wgpu_gpu_sort_t* gpu_sort,
+                           WGPUComputePassEncoder pass_encoder,
+                           WGPUBuffer input, WGPUBuffer flags,
+                           WGPUBuffer output, WGPUBuffer count_buffer,
+                           uint32_t count)
+{
+  ASSERT(count <= gpu_sort->max_element_count);
+  if (count == 0) {
+    return;
+  }
+
+  if (gpu_sort->compact_offsets_buffer.buffer == NULL) {
+    gpu_sort->compact_offsets_buffer = gpu_sort_create_storage_buffer(
+      gpu_sort->wgpu_context, "gpu_sort_compact_offsets_buffer",
+      gpu_sort->max_element_count);
+  }
+
+  wgpu_gpu_sort_scan(gpu_sort, pass_encoder, flags,
+                     gpu_sort->compact_offsets_buffer.buffer, count);
+
+  const uint32_t params_offset = gpu_sort_push_params(gpu_sort, count, 0, 0);
+  const WGPUBuffer buffers[5]  = {
+    input, flags, output, count_buffer, gpu_sort->compact_offsets_buffer.buffer,
+  };
+  gpu_sort_dispatch(
+    pass_encoder, gpu_sort->pipelines.compact,
+    gpu_sort_get_bind_group(gpu_sort, gpu_sort->bind_group_layouts.compact,
+                            buffers, (uint32_t)ARRAY_SIZE(buffers)),
+    params_offset, gpu_sort_div_ceil(count, GPU_SORT_COMPACT_WORKGROUP_SIZE));
+}
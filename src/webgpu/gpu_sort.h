@@ -0,0 +1,66 @@
+#ifndef GPU_SORT_H
+#define GPU_SORT_H
+
+#include "context.h"
+
+/* Parameter blocks of the recorded operations are recycled after this many,
+ * a scan takes one per level (up to 4), a compaction one more and a radix
+ * sort 8 plus the levels of a scan */
+#define WGPU_GPU_SORT_PARAM_SLOT_COUNT 256u
+
+/*
+ * GPU prefix scan, radix sort and stream compaction of u32 storage buffers,
+ * recorded into a compute pass without CPU round trips.
+ *
+ * The scan prefix-sums blocks of 512 elements in workgroup memory and scans
+ * the block sums recursively, the results of the upper levels are added back
+ * to the blocks afterwards. The radix sort runs 8 passes over 4-bit digits:
+ * a digit histogram per block of 256 keys, a scan of the histograms for the
+ * output offsets and a stable scatter of the locally sorted blocks. The
+ * compaction scans the flags into the output slots of the kept elements.
+ *
+ * Operations may be recorded several times per frame but their parameters are
+ * written through the queue, so at most WGPU_GPU_SORT_PARAM_SLOT_COUNT
+ * parameter blocks may be used per submission.
+ */
+typedef struct wgpu_gpu_sort wgpu_gpu_sort_t;
+
+typedef struct wgpu_gpu_sort_desc_t {
+  /* Largest number of elements of an operation */
+  uint32_t max_element_count;
+} wgpu_gpu_sort_desc_t;
+
+/* GPU sort creating/releasing */
+wgpu_gpu_sort_t* wgpu_gpu_sort_create(wgpu_context_t* wgpu_context,
+                                      const wgpu_gpu_sort_desc_t* desc);
+void wgpu_gpu_sort_release(wgpu_gpu_sort_t* gpu_sort);
+
+/**
+ * @brief Records the exclusive prefix sum of the first count u32 of input into
+ * output, two distinct buffers with the Storage usage.
+ */
+void wgpu_gpu_sort_scan(wgpu_gpu_sort_t* gpu_sort,
+                        WGPUComputePassEncoder pass_encoder, WGPUBuffer input,
+                        WGPUBuffer output, uint32_t count);
+
+/**
+ * @brief Records the stable ascending sort of the first count u32 keys along
+ * with their u32 values, in place.
+ */
+void wgpu_gpu_sort_radix_sort(wgpu_gpu_sort_t* gpu_sort,
+                              WGPUComputePassEncoder pass_encoder,
+                              WGPUBuffer keys, WGPUBuffer values,
+                              uint32_t count);
+
+/**
+ * @brief Records the compaction of the first count u32 of input whose flag is
+ * 1 into output, in their order. The flags are 0 or 1, the number of kept
+ * elements is written to the first u32 of count_buffer.
+ */
+void wgpu_gpu_sort_compact(wgpu_gpu_sort_t* gpu_sort,
+                           WGPUComputePassEncoder pass_encoder,
+                           WGPUBuffer input, WGPUBuffer flags,
+                           WGPUBuffer output, WGPUBuffer count_buffer,
+                           uint32_t count);
+
+#endif
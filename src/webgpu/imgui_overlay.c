@@ -16,10 +16,17 @@
 
 #include "../core/log.h"
 #include "../core/macro.h"
+#include "render_bundle_cache.h"
 #include "shader.h"
 
-#define _IMGUI_MAX_VERTEX_DATA_SIZE_DEFAULT 40000
-#define _IMGUI_MAX_INDEX_DATA_SIZE_DEFAULT 10000
+// Initial number of vertices and indices per geometry slot, doubled whenever
+// the draw data outgrows it
+#define _IMGUI_INITIAL_VERTEX_CAPACITY 4096
+#define _IMGUI_INITIAL_INDEX_CAPACITY 8192
+
+// Number of geometry slots, the draw data of a frame is written into the slot
+// after the one the previous frames still read from
+#define _IMGUI_GEOMETRY_SLOT_COUNT WGPU_MAX_FRAMES_IN_FLIGHT
 
 // Vertex buffer and attributes
 typedef struct vertex_uniform_buffer_t {
@@ -45,23 +52,28 @@ typedef struct imgui_overlay {
   WGPURenderPipeline pipeline;
   WGPUPipelineLayout pipeline_layout;
   wgpu_buffer_t uniform_buffer;
+  // Vertex and index data, split into _IMGUI_GEOMETRY_SLOT_COUNT slots
   wgpu_buffer_t vertex_buffer;
   wgpu_buffer_t index_buffer;
+  struct {
+    uint32_t vertex_capacity;
+    uint32_t index_capacity;
+    uint32_t slot; // Slot holding the current draw data
+    uint64_t hash; // Hash of the draw data in the slot, 0 if there is none
+    bool valid;    // The slot holds the current draw data
+    // The draws of the slot can be replayed from a render bundle, i.e. they
+    // use neither scissor rects nor user callbacks
+    bool bundled;
+  } geometry;
+  struct {
+    float mvp[4][4];
+    bool valid;
+  } uploaded_uniforms;
   WGPUBindGroup bind_group;
   WGPUBindGroupLayout bind_group_layout;
   // Render pass descriptor for frame buffer writes
   WGPURenderPassColorAttachment rp_color_att_descriptors[1];
   WGPURenderPassDescriptor render_pass_desc;
-  struct {
-    struct {
-      ImDrawVert data[_IMGUI_MAX_VERTEX_DATA_SIZE_DEFAULT];
-      int32_t size;
-    } vertex;
-    struct {
-      ImDrawIdx data[_IMGUI_MAX_INDEX_DATA_SIZE_DEFAULT];
-      int32_t size;
-    } index;
-  } draw_buffers;
   bool visible;
   bool updated;
   float scale;
@@ -77,8 +89,13 @@ static void imgui_overlay_init(imgui_overlay_t* imgui_overlay,
   imgui_overlay->vertex_buffer.size = 0;
   imgui_overlay->index_buffer.size  = 0;
 
-  imgui_overlay->draw_buffers.index.size        = 3000;
-  imgui_overlay->draw_buffers.vertex.size       = 3000;
+  imgui_overlay->geometry.vertex_capacity       = 0;
+  imgui_overlay->geometry.index_capacity        = 0;
+  imgui_overlay->geometry.slot                  = 0;
+  imgui_overlay->geometry.hash                  = 0;
+  imgui_overlay->geometry.valid                 = false;
+  imgui_overlay->geometry.bundled               = false;
+  imgui_overlay->uploaded_uniforms.valid        = false;
   imgui_overlay->settings.enable_alpha_blending = true;
   imgui_overlay->settings.msaa_sample_count     = 1;
   imgui_overlay->settings.scale                 = 1.0f;
@@ -113,11 +130,58 @@ static void imgui_overlay_setup_render_state(imgui_overlay_t* imgui_overlay)
   wgpuRenderPassEncoderSetPipeline(rpass_enc, imgui_overlay->pipeline);
   wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, imgui_overlay->bind_group, 0,
                                     NULL);
+
+  // Bind the slot holding the current draw data
+  const uint64_t vertex_slot_size
+    = imgui_overlay->geometry.vertex_capacity * sizeof(ImDrawVert);
+  const uint64_t index_slot_size
+    = imgui_overlay->geometry.index_capacity * sizeof(ImDrawIdx);
+  const uint32_t slot = imgui_overlay->geometry.slot;
   wgpuRenderPassEncoderSetVertexBuffer(
-    rpass_enc, 0, imgui_overlay->vertex_buffer.buffer, 0, WGPU_WHOLE_SIZE);
+    rpass_enc, 0, imgui_overlay->vertex_buffer.buffer, slot * vertex_slot_size,
+    vertex_slot_size);
   wgpuRenderPassEncoderSetIndexBuffer(
-    rpass_enc, imgui_overlay->index_buffer.buffer, WGPUIndexFormat_Uint16, 0,
-    WGPU_WHOLE_SIZE);
+    rpass_enc, imgui_overlay->index_buffer.buffer, WGPUIndexFormat_Uint16,
+    slot * index_slot_size, index_slot_size);
+}
+
+// Records the draws of the current slot, replayed while the draw data stays
+// the same
+static void imgui_overlay_record_bundle(WGPURenderBundleEncoder bundle_encoder,
+                                        void* user_data)
+{
+  imgui_overlay_t* imgui_overlay = (imgui_overlay_t*)user_data;
+  ImDrawData* draw_data          = igGetDrawData();
+
+  wgpuRenderBundleEncoderSetPipeline(bundle_encoder, imgui_overlay->pipeline);
+  wgpuRenderBundleEncoderSetBindGroup(bundle_encoder, 0,
+                                      imgui_overlay->bind_group, 0, NULL);
+
+  const uint64_t vertex_slot_size
+    = imgui_overlay->geometry.vertex_capacity * sizeof(ImDrawVert);
+  const uint64_t index_slot_size
+    = imgui_overlay->geometry.index_capacity * sizeof(ImDrawIdx);
+  const uint32_t slot = imgui_overlay->geometry.slot;
+  wgpuRenderBundleEncoderSetVertexBuffer(
+    bundle_encoder, 0, imgui_overlay->vertex_buffer.buffer,
+    slot * vertex_slot_size, vertex_slot_size);
+  wgpuRenderBundleEncoderSetIndexBuffer(
+    bundle_encoder, imgui_overlay->index_buffer.buffer, WGPUIndexFormat_Uint16,
+    slot * index_slot_size, index_slot_size);
+
+  int global_vtx_offset = 0;
+  int global_idx_offset = 0;
+  for (int n = 0; n < draw_data->CmdListsCount; n++) {
+    const ImDrawList* cmd_list = draw_data->CmdLists[n];
+    for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; ++cmd_i) {
+      const ImDrawCmd* pcmd = &cmd_list->CmdBuffer.Data[cmd_i];
+      wgpuRenderBundleEncoderDrawIndexed(
+        bundle_encoder, pcmd->ElemCount, 1, pcmd->IdxOffset + global_idx_offset,
+        pcmd->VtxOffset + global_vtx_offset, 0);
+    }
+    global_idx_offset += cmd_list->IdxBuffer.Size;
+    global_vtx_offset += cmd_list->VtxBuffer.Size;
+  }
 }
 
 static void imgui_overlay_create_fonts_texture(imgui_overlay_t* imgui_overlay)
@@ -246,14 +310,14 @@ static void imgui_overlay_setup_render_pass(imgui_overlay_t* imgui_overlay)
       },
   };
 
-  // Depth attachment
+  // Depth attachment, only tested
   wgpu_setup_deph_stencil(wgpu_context, NULL);
 
   // Render pass descriptor
   imgui_overlay->render_pass_desc = (WGPURenderPassDescriptor){
     .colorAttachmentCount   = 1,
     .colorAttachments       = imgui_overlay->rp_color_att_descriptors,
-    .depthStencilAttachment = &wgpu_context->depth_stencil.att_desc,
+    .depthStencilAttachment = &wgpu_context->depth_stencil.read_only_att_desc,
   };
 }
 
@@ -340,12 +404,13 @@ static void imgui_overlay_prepare_pipeline(imgui_overlay_t* imgui_overlay)
     .writeMask = WGPUColorWriteMask_All,
   };
 
-  // Depth stencil state
+  // Depth stencil state, the overlay is drawn over the scene at any depth
   WGPUDepthStencilState depth_stencil_state_desc
     = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
-      .format              = WGPUTextureFormat_Depth24PlusStencil8,
       .depth_write_enabled = false,
+      .wgpu_context        = wgpu_context,
     });
+  depth_stencil_state_desc.depthCompare = WGPUCompareFunction_Always;
 
   // Vertex buffer layout
   WGPU_VERTEX_BUFFER_LAYOUT(
@@ -479,8 +544,14 @@ void imgui_overlay_release(imgui_overlay_t* imgui_overlay)
   WGPU_RELEASE_RESOURCE(BindGroup, imgui_overlay->bind_group);
   WGPU_RELEASE_RESOURCE(BindGroupLayout, imgui_overlay->bind_group_layout);
 
-  WGPU_RELEASE_RESOURCE(Buffer, imgui_overlay->index_buffer.buffer);
-  WGPU_RELEASE_RESOURCE(Buffer, imgui_overlay->vertex_buffer.buffer);
+  wgpu_render_bundle_cache_invalidate(imgui_overlay->wgpu_context,
+                                      imgui_overlay);
+  if (imgui_overlay->index_buffer.buffer) {
+    wgpu_destroy_buffer(&imgui_overlay->index_buffer);
+  }
+  if (imgui_overlay->vertex_buffer.buffer) {
+    wgpu_destroy_buffer(&imgui_overlay->vertex_buffer);
+  }
   WGPU_RELEASE_RESOURCE(Texture, imgui_overlay->font.texture);
   WGPU_RELEASE_RESOURCE(TextureView, imgui_overlay->font.texture_view);
   WGPU_RELEASE_RESOURCE(Sampler, imgui_overlay->font.sampler);
@@ -534,10 +605,21 @@ static void imgui_overlay_update_uniform_buffers(imgui_overlay_t* imgui_overlay,
     memcpy(&vertex_constant_buffer.mvp, mvp, sizeof(mvp));
   }
 
+  // The projection only changes with the display
+  if (imgui_overlay->uploaded_uniforms.valid
+      && memcmp(imgui_overlay->uploaded_uniforms.mvp,
+                vertex_constant_buffer.mvp, sizeof(vertex_constant_buffer.mvp))
+           == 0) {
+    return;
+  }
+
   wgpu_record_copy_data_to_buffer(
     imgui_overlay->wgpu_context, &imgui_overlay->uniform_buffer, 0,
     sizeof(vertex_uniform_buffer_t), &vertex_constant_buffer.mvp,
     sizeof(vertex_uniform_buffer_t));
+  memcpy(imgui_overlay->uploaded_uniforms.mvp, vertex_constant_buffer.mvp,
+         sizeof(vertex_constant_buffer.mvp));
+  imgui_overlay->uploaded_uniforms.valid = true;
 }
 
 // Draw current imGui frame into a command buffer
@@ -547,18 +629,42 @@ void imgui_overlay_draw_frame(imgui_overlay_t* imgui_overlay,
   ImDrawData* draw_data = igGetDrawData();
 
   // Check if there is content to tbe rendered
-  if (!draw_data || draw_data->CmdListsCount == 0) {
+  if (!draw_data || draw_data->CmdListsCount == 0
+      || !imgui_overlay->geometry.valid) {
     return;
   }
 
+  wgpu_context_t* wgpu_context = imgui_overlay->wgpu_context;
+
   // UI scale and translate
   imgui_overlay_update_uniform_buffers(imgui_overlay, draw_data);
 
   // Set texture view
   imgui_overlay->rp_color_att_descriptors[0].view = view;
-  imgui_overlay->wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
-    imgui_overlay->wgpu_context->cmd_enc, &imgui_overlay->render_pass_desc);
-  WGPURenderPassEncoder rpass_enc = imgui_overlay->wgpu_context->rpass_enc;
+  wgpu_context->rpass_enc = wgpuCommandEncoderBeginRenderPass(
+    wgpu_context->cmd_enc, &imgui_overlay->render_pass_desc);
+  WGPURenderPassEncoder rpass_enc = wgpu_context->rpass_enc;
+
+  // Replay the draws recorded for the draw data in the current slot
+  if (imgui_overlay->geometry.bundled) {
+    const wgpu_render_bundle_key_t bundle_key = {
+      .source  = imgui_overlay,
+      .state   = imgui_overlay->geometry.hash,
+      .formats = {
+        .color_format_count      = 1,
+        .color_formats           = {wgpu_context->swap_chain.format},
+        .depth_stencil_format    = wgpu_context->depth_stencil.format,
+        .sample_count            = imgui_overlay->settings.msaa_sample_count,
+        .depth_stencil_read_only = true,
+      },
+    };
+    WGPURenderBundle bundle = wgpu_render_bundle_cache_get(
+      wgpu_context, &bundle_key, imgui_overlay_record_bundle, imgui_overlay);
+    wgpuRenderPassEncoderExecuteBundles(rpass_enc, 1, &bundle);
+    wgpuRenderPassEncoderEnd(rpass_enc);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+    return;
+  }
 
   // Setup desired Dawn state
   imgui_overlay_setup_render_state(imgui_overlay);
@@ -610,6 +716,133 @@ void imgui_overlay_draw_frame(imgui_overlay_t* imgui_overlay,
   WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
 }
 
+// Hash of the vertex and index data and of the draws of all draw lists, sets
+// bundled to whether the draws can be recorded into a render bundle
+static uint64_t imgui_overlay_hash_draw_data(ImDrawData* draw_data,
+                                             bool* bundled)
+{
+  uint64_t hash = WGPU_RENDER_BUNDLE_HASH_SEED;
+  for (int n = 0; n < draw_data->CmdListsCount; ++n) {
+    const ImDrawList* cmd_list = draw_data->CmdLists[n];
+    const int32_t sizes[3] = {cmd_list->VtxBuffer.Size,
+                              cmd_list->IdxBuffer.Size,
+                              cmd_list->CmdBuffer.Size};
+    hash = wgpu_render_bundle_hash(hash, sizes, sizeof(sizes));
+    hash = wgpu_render_bundle_hash(hash, cmd_list->VtxBuffer.Data,
+                                   sizes[0] * sizeof(ImDrawVert));
+    hash = wgpu_render_bundle_hash(hash, cmd_list->IdxBuffer.Data,
+                                   sizes[1] * sizeof(ImDrawIdx));
+    for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; ++cmd_i) {
+      const ImDrawCmd* pcmd  = &cmd_list->CmdBuffer.Data[cmd_i];
+      const uint32_t draw[3] = {pcmd->ElemCount, pcmd->IdxOffset,
+                                pcmd->VtxOffset};
+      hash = wgpu_render_bundle_hash(hash, draw, sizeof(draw));
+      if (pcmd->UserCallback != NULL) {
+        *bundled = false;
+      }
+    }
+  }
+  // 0 marks an empty slot
+  return hash != 0 ? hash : 1;
+}
+
+// Grows the geometry slots to hold the draw data, doubling their capacity
+static void imgui_overlay_reserve_geometry(imgui_overlay_t* imgui_overlay,
+                                           ImDrawData* draw_data)
+{
+  wgpu_context_t* wgpu_context = imgui_overlay->wgpu_context;
+
+  uint32_t vertex_capacity = imgui_overlay->geometry.vertex_capacity;
+  uint32_t index_capacity  = imgui_overlay->geometry.index_capacity;
+  if (vertex_capacity == 0) {
+    vertex_capacity = _IMGUI_INITIAL_VERTEX_CAPACITY;
+    index_capacity  = _IMGUI_INITIAL_INDEX_CAPACITY;
+  }
+  while (vertex_capacity < (uint32_t)draw_data->TotalVtxCount) {
+    vertex_capacity *= 2;
+  }
+  while (index_capacity < (uint32_t)draw_data->TotalIdxCount) {
+    index_capacity *= 2;
+  }
+
+  if (vertex_capacity != imgui_overlay->geometry.vertex_capacity) {
+    if (imgui_overlay->vertex_buffer.buffer) {
+      wgpu_destroy_buffer(&imgui_overlay->vertex_buffer);
+    }
+    imgui_overlay->vertex_buffer = wgpu_create_buffer(
+      wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .label = "imgui-vertex-buffer",
+        .usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
+        .size
+        = _IMGUI_GEOMETRY_SLOT_COUNT * vertex_capacity * sizeof(ImDrawVert),
+      });
+    imgui_overlay->geometry.vertex_capacity = vertex_capacity;
+    imgui_overlay->geometry.hash            = 0;
+  }
+
+  if (index_capacity != imgui_overlay->geometry.index_capacity) {
+    if (imgui_overlay->index_buffer.buffer) {
+      wgpu_destroy_buffer(&imgui_overlay->index_buffer);
+    }
+    imgui_overlay->index_buffer = wgpu_create_buffer(
+      wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .label = "imgui-index-buffer",
+        .usage = WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst,
+        .size = _IMGUI_GEOMETRY_SLOT_COUNT * index_capacity * sizeof(ImDrawIdx),
+      });
+    imgui_overlay->geometry.index_capacity = index_capacity;
+    imgui_overlay->geometry.hash           = 0;
+  }
+}
+
+// Returns size bytes of upload space, mapped from the staging ring of the
+// context or, when the ring is exhausted, scratch memory of the frame (staging
+// is set to NULL then)
+static uint8_t* imgui_overlay_begin_upload(imgui_overlay_t* imgui_overlay,
+                                           uint64_t size, WGPUBuffer* staging,
+                                           uint64_t* staging_offset)
+{
+  wgpu_context_t* wgpu_context = imgui_overlay->wgpu_context;
+
+  // Create the staging ring on first use
+  if (wgpu_context->staging_ring == NULL) {
+    wgpu_context->staging_ring = wgpu_staging_ring_create(
+      wgpu_context, WGPU_STAGING_RING_DEFAULT_PARTITION_SIZE);
+  }
+
+  uint8_t* mapping = wgpu_staging_ring_allocate(wgpu_context->staging_ring,
+                                                size, staging, staging_offset);
+  if (mapping != NULL) {
+    return mapping;
+  }
+
+  *staging        = NULL;
+  *staging_offset = 0;
+  return (uint8_t*)wgpu_frame_alloc(wgpu_context, size);
+}
+
+// Records the copy of the upload space into dst
+static void imgui_overlay_end_upload(imgui_overlay_t* imgui_overlay,
+                                     wgpu_buffer_t* dst, uint64_t dst_offset,
+                                     uint64_t size, uint8_t* data,
+                                     WGPUBuffer staging,
+                                     uint64_t staging_offset)
+{
+  wgpu_context_t* wgpu_context = imgui_overlay->wgpu_context;
+
+  if (staging != NULL) {
+    wgpuCommandEncoderCopyBufferToBuffer(wgpu_context->cmd_enc, staging,
+                                         staging_offset, dst->buffer,
+                                         dst->offset + dst_offset, size);
+  }
+  else {
+    wgpu_record_copy_data_to_buffer(wgpu_context, dst, (uint32_t)dst_offset,
+                                    (uint32_t)size, data, (uint32_t)size);
+  }
+}
+
 // Update vertex and index buffer containing the imGui elements when required
 static void imgui_overlay_update_buffers(imgui_overlay_t* imgui_overlay)
 {
@@ -620,90 +853,74 @@ static void imgui_overlay_update_buffers(imgui_overlay_t* imgui_overlay)
     return;
   }
 
+  imgui_overlay->geometry.valid = false;
+
   // Avoid rendering when minimized
   if (draw_data->DisplaySize.x <= 0.0f || draw_data->DisplaySize.y <= 0.0f) {
     return;
   }
 
-  wgpu_context_t* wgpu_context = imgui_overlay->wgpu_context;
-
-  // Update buffers only if vertex or index count has been changed compared to
-  // current buffer size
-
-  // Create and grow index buffers if needed
-  int32_t vertex_buffer_size = imgui_overlay->draw_buffers.vertex.size;
-  if (imgui_overlay->vertex_buffer.size == 0
-      || vertex_buffer_size < draw_data->TotalVtxCount) {
-    vertex_buffer_size = draw_data->TotalVtxCount + 5000;
-    vertex_buffer_size = vertex_buffer_size % 4 == 0 ?
-                           vertex_buffer_size :
-                           vertex_buffer_size + 4 - vertex_buffer_size % 4;
-
-    if (imgui_overlay->vertex_buffer.size > 0) {
-      wgpu_destroy_buffer(&imgui_overlay->vertex_buffer);
-    }
-
-    imgui_overlay->vertex_buffer = wgpu_create_buffer(
-      wgpu_context, &(wgpu_buffer_desc_t){
-                      .label = "imgui-vertex-buffer",
-                      .usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
-                      .size  = vertex_buffer_size * sizeof(ImDrawVert),
-                    });
-    imgui_overlay->draw_buffers.vertex.size = vertex_buffer_size;
+  if (draw_data->TotalVtxCount == 0 || draw_data->TotalIdxCount == 0) {
+    return;
   }
 
-  // Create and grow index buffers if needed
-  int32_t indexBuffer_size = imgui_overlay->draw_buffers.index.size;
-  if (imgui_overlay->index_buffer.size == 0
-      || indexBuffer_size < draw_data->TotalIdxCount) {
-    indexBuffer_size = draw_data->TotalIdxCount + 10000;
-    indexBuffer_size = indexBuffer_size % 4 == 0 ?
-                         indexBuffer_size :
-                         indexBuffer_size + 4 - indexBuffer_size % 4;
-
-    if (imgui_overlay->index_buffer.size > 0) {
-      wgpu_destroy_buffer(&imgui_overlay->index_buffer);
-    }
+  imgui_overlay_reserve_geometry(imgui_overlay, draw_data);
 
-    imgui_overlay->index_buffer = wgpu_create_buffer(
-      wgpu_context, &(wgpu_buffer_desc_t){
-                      .label = "imgui-index-buffer",
-                      .usage = WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst,
-                      .size  = indexBuffer_size * sizeof(ImDrawIdx),
-                    });
-    imgui_overlay->draw_buffers.index.size = indexBuffer_size;
+  // A static UI produces the same draw data every frame, the current slot
+  // already holds it then
+  bool bundled        = !imgui_overlay->settings.enable_scissor;
+  const uint64_t hash = imgui_overlay_hash_draw_data(draw_data, &bundled);
+  if (hash == imgui_overlay->geometry.hash) {
+    imgui_overlay->geometry.valid = true;
+    return;
   }
 
-  // Upload vertex/index data into a single contiguous GPU buffer
-  uint32_t vtx_dst    = 0;
-  uint32_t idx_dst    = 0;
-  ImDrawVert* pVertex = imgui_overlay->draw_buffers.vertex.data;
-  ImDrawIdx* pIndex   = imgui_overlay->draw_buffers.index.data;
+  // The bundle of the previous draw data is not replayed anymore
+  wgpu_render_bundle_cache_invalidate(imgui_overlay->wgpu_context,
+                                      imgui_overlay);
+
+  // Write into the next slot, the current one may still be read by frames in
+  // flight
+  const uint32_t slot
+    = (imgui_overlay->geometry.slot + 1) % _IMGUI_GEOMETRY_SLOT_COUNT;
+  const uint32_t vtx_size = draw_data->TotalVtxCount * sizeof(ImDrawVert);
+  const uint32_t idx_size = draw_data->TotalIdxCount * sizeof(ImDrawIdx);
+  const uint32_t vtx_aligned_size = (vtx_size + 3) & ~3u;
+  const uint32_t idx_aligned_size = (idx_size + 3) & ~3u;
+
+  // Copy the draw lists straight into the upload space, one after another
+  WGPUBuffer vtx_staging = NULL, idx_staging = NULL;
+  uint64_t vtx_staging_offset = 0, idx_staging_offset = 0;
+  uint8_t* vtx_dst = imgui_overlay_begin_upload(
+    imgui_overlay, vtx_aligned_size, &vtx_staging, &vtx_staging_offset);
+  uint8_t* idx_dst = imgui_overlay_begin_upload(
+    imgui_overlay, idx_aligned_size, &idx_staging, &idx_staging_offset);
+  uint32_t vtx_offset = 0;
+  uint32_t idx_offset = 0;
   for (int n = 0; n < draw_data->CmdListsCount; ++n) {
     const ImDrawList* cmd_list = draw_data->CmdLists[n];
-    memcpy(pVertex, cmd_list->VtxBuffer.Data,
+    memcpy(vtx_dst + vtx_offset, cmd_list->VtxBuffer.Data,
            cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
-    memcpy(pIndex, cmd_list->IdxBuffer.Data,
+    memcpy(idx_dst + idx_offset, cmd_list->IdxBuffer.Data,
            cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
-
-    pVertex += cmd_list->VtxBuffer.Size;
-    pIndex += cmd_list->IdxBuffer.Size;
-    vtx_dst += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
-    idx_dst += cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
-  }
-  vtx_dst = vtx_dst % 4 == 0 ? vtx_dst : vtx_dst + 4 - vtx_dst % 4;
-  idx_dst = idx_dst % 4 == 0 ? idx_dst : idx_dst + 4 - idx_dst % 4;
-
-  if (vtx_dst != 0 && idx_dst != 0) {
-    wgpu_record_copy_data_to_buffer(
-      wgpu_context, &imgui_overlay->vertex_buffer, 0, vtx_dst,
-      imgui_overlay->draw_buffers.vertex.data,
-      (pVertex - imgui_overlay->draw_buffers.vertex.data) * sizeof(ImDrawVert));
-    wgpu_record_copy_data_to_buffer(
-      wgpu_context, &imgui_overlay->index_buffer, 0, idx_dst,
-      imgui_overlay->draw_buffers.index.data,
-      (pIndex - imgui_overlay->draw_buffers.index.data) * sizeof(ImDrawIdx));
+    vtx_offset += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+    idx_offset += cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
   }
+  memset(idx_dst + idx_size, 0, idx_aligned_size - idx_size);
+
+  imgui_overlay_end_upload(
+    imgui_overlay, &imgui_overlay->vertex_buffer,
+    slot * imgui_overlay->geometry.vertex_capacity * sizeof(ImDrawVert),
+    vtx_aligned_size, vtx_dst, vtx_staging, vtx_staging_offset);
+  imgui_overlay_end_upload(
+    imgui_overlay, &imgui_overlay->index_buffer,
+    slot * imgui_overlay->geometry.index_capacity * sizeof(ImDrawIdx),
+    idx_aligned_size, idx_dst, idx_staging, idx_staging_offset);
+
+  imgui_overlay->geometry.slot    = slot;
+  imgui_overlay->geometry.hash    = hash;
+  imgui_overlay->geometry.valid   = true;
+  imgui_overlay->geometry.bundled = bundled;
 }
 
 // Render function
@@ -0,0 +1,444 @@
+#include "light_clusters.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+#define WGPU_LIGHT_CLUSTERS_WORKGROUP_SIZE 64u
+
+/* Layout of LightClusterParams */
+typedef struct light_cluster_params_t {
+  mat4 view_matrix;
+  mat4 inverse_projection;
+  uint32_t grid_size[3];
+  uint32_t light_count;
+  float screen_size[2];
+  float z_near;
+  float z_far;
+  uint32_t max_lights_per_cluster;
+  uint32_t light_stride; /* in vec4<f32> */
+  uint32_t radius_index; /* in f32 */
+  uint32_t padding;
+} light_cluster_params_t;
+
+struct wgpu_light_clusters {
+  wgpu_context_t* wgpu_context;
+  light_cluster_params_t params;
+  uint32_t cluster_count;
+  wgpu_buffer_t params_buffer;
+  /* Per cluster the light count followed by max_lights_per_cluster indices */
+  wgpu_buffer_t cluster_buffer;
+  WGPUBindGroupLayout build_bind_group_layout;
+  WGPUComputePipeline build_pipeline;
+  WGPUBuffer build_lights_buffer; /* lights buffer of the build bind group */
+  WGPUBindGroup build_bind_group;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* light_clusters_wgsl_functions = CODE(
+  struct LightClusterParams {
+    viewMatrix : mat4x4<f32>,
+    inverseProjection : mat4x4<f32>,
+    gridSize : vec3<u32>,
+    lightCount : u32,
+    screenSize : vec2<f32>,
+    zNear : f32,
+    zFar : f32,
+    maxLightsPerCluster : u32,
+    lightStride : u32,
+    radiusIndex : u32,
+    padding : u32,
+  };
+
+  // Depth slices are distributed exponentially between the near and far plane
+  fn lightClusterGetIndex(fragCoord : vec2<f32>,
+                          worldPosition : vec3<f32>) -> u32 {
+    let viewPosition = clusterParams.viewMatrix * vec4<f32>(worldPosition, 1.0);
+    let depth = max(-viewPosition.z, clusterParams.zNear);
+    let sliceCount = f32(clusterParams.gridSize.z);
+    let slice = clamp(floor(log(depth / clusterParams.zNear)
+                            / log(clusterParams.zFar / clusterParams.zNear)
+                            * sliceCount),
+                      0.0, sliceCount - 1.0);
+    let tileCount = vec2<f32>(clusterParams.gridSize.xy);
+    let tile = clamp(floor(fragCoord / clusterParams.screenSize * tileCount),
+                     vec2<f32>(0.0), tileCount - vec2<f32>(1.0));
+    return u32(tile.x)
+           + clusterParams.gridSize.x * (u32(tile.y)
+                                         + clusterParams.gridSize.y
+                                             * u32(slice));
+  }
+
+  fn lightClusterGetLightCount(cluster : u32) -> u32 {
+    return clusterLights[cluster * (clusterParams.maxLightsPerCluster + 1u)];
+  }
+
+  fn lightClusterGetLightIndex(cluster : u32, i : u32) -> u32 {
+    return clusterLights[cluster * (clusterParams.maxLightsPerCluster + 1u)
+                         + 1u + i];
+  }
+);
+
+static const char* light_clusters_build_shader_wgsl = CODE(
+  @group(0) @binding(0) var<uniform> clusterParams : LightClusterParams;
+  @group(0) @binding(1) var<storage, read> lights : array<vec4<f32>>;
+  @group(0) @binding(2) var<storage, read_write> clusterLights : array<u32>;
+
+  // View space point on the near plane the pixel position is projected to
+  fn screenToView(screen : vec2<f32>) -> vec3<f32> {
+    let ndc = vec2<f32>(screen.x / clusterParams.screenSize.x * 2.0 - 1.0,
+                        1.0 - screen.y / clusterParams.screenSize.y * 2.0);
+    let view = clusterParams.inverseProjection * vec4<f32>(ndc, 0.0, 1.0);
+    return view.xyz / view.w;
+  }
+
+  fn sliceDepth(slice : u32) -> f32 {
+    return clusterParams.zNear
+           * pow(clusterParams.zFar / clusterParams.zNear,
+                 f32(slice) / f32(clusterParams.gridSize.z));
+  }
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let grid = clusterParams.gridSize;
+    let cluster = id.x;
+    if (cluster >= grid.x * grid.y * grid.z) {
+      return;
+    }
+
+    // View space bounds of the froxel, the rays through two opposite tile
+    // corners cut at the depths of the slice
+    let x = cluster % grid.x;
+    let y = (cluster / grid.x) % grid.y;
+    let z = cluster / (grid.x * grid.y);
+    let tileSize = clusterParams.screenSize / vec2<f32>(grid.xy);
+    let minScreen = vec2<f32>(f32(x), f32(y)) * tileSize;
+    let ray0 = screenToView(minScreen);
+    let ray1 = screenToView(minScreen + tileSize);
+    let nearDepth = sliceDepth(z);
+    let farDepth = sliceDepth(z + 1u);
+    let p0 = ray0 * (nearDepth / -ray0.z);
+    let p1 = ray1 * (nearDepth / -ray1.z);
+    let p2 = ray0 * (farDepth / -ray0.z);
+    let p3 = ray1 * (farDepth / -ray1.z);
+    let bbMin = min(min(p0, p1), min(p2, p3));
+    let bbMax = max(max(p0, p1), max(p2, p3));
+
+    let base = cluster * (clusterParams.maxLightsPerCluster + 1u);
+    var count = 0u;
+    for (var i = 0u; i < clusterParams.lightCount; i = i + 1u) {
+      let light = i * clusterParams.lightStride;
+      let position
+        = (clusterParams.viewMatrix * vec4<f32>(lights[light].xyz, 1.0)).xyz;
+      let radius = lights[light + clusterParams.radiusIndex / 4u]
+                         [clusterParams.radiusIndex % 4u];
+      let d = clamp(position, bbMin, bbMax) - position;
+      if (dot(d, d) <= radius * radius
+          && count < clusterParams.maxLightsPerCluster) {
+        clusterLights[base + 1u + count] = i;
+        count = count + 1u;
+      }
+    }
+    clusterLights[base] = count;
+  }
+);
+// clang-format on
+
+static void light_clusters_create_bind_group_layouts(
+  wgpu_light_clusters_t* light_clusters)
+{
+  wgpu_context_t* wgpu_context = light_clusters->wgpu_context;
+
+  // Culling
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Cluster parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(light_cluster_params_t),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Lights
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = 0,
+        },
+        .sampler = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Cluster light lists
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Storage,
+          .minBindingSize = light_clusters->cluster_buffer.size,
+        },
+        .sampler = {0},
+      },
+    };
+    light_clusters->build_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "light_clusters_build_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(light_clusters->build_bind_group_layout != NULL);
+  }
+
+  // Shading
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[2] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Cluster parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Fragment | WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(light_cluster_params_t),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Cluster light lists
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Fragment | WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = light_clusters->cluster_buffer.size,
+        },
+        .sampler = {0},
+      },
+    };
+    light_clusters->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "light_clusters_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(light_clusters->bind_group_layout != NULL);
+  }
+}
+
+static void
+light_clusters_create_build_pipeline(wgpu_light_clusters_t* light_clusters)
+{
+  wgpu_context_t* wgpu_context = light_clusters->wgpu_context;
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "light_clusters_build_pl",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &light_clusters->build_bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  // The culling shader shares the parameter struct of the lookup functions
+  const size_t wgsl_size = strlen(light_clusters_wgsl_functions)
+                           + strlen(light_clusters_build_shader_wgsl) + 2;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", light_clusters_wgsl_functions,
+           light_clusters_build_shader_wgsl);
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "light_clusters_build_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  light_clusters->build_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "light_clusters_build_pipeline",
+      .layout  = pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(light_clusters->build_pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+  free(wgsl);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_light_clusters_t*
+wgpu_light_clusters_create(wgpu_context_t* wgpu_context,
+                           const wgpu_light_clusters_desc_t* desc)
+{
+  ASSERT(desc->light_stride > 0 && desc->light_stride % 16 == 0);
+  ASSERT(desc->radius_offset % 4 == 0
+         && desc->radius_offset < desc->light_stride);
+
+  wgpu_light_clusters_t* light_clusters
+    = (wgpu_light_clusters_t*)malloc(sizeof(wgpu_light_clusters_t));
+  memset(light_clusters, 0, sizeof(wgpu_light_clusters_t));
+  light_clusters->wgpu_context = wgpu_context;
+
+  static const uint32_t default_grid_size[3] = {
+    WGPU_LIGHT_CLUSTERS_DEFAULT_GRID_X,
+    WGPU_LIGHT_CLUSTERS_DEFAULT_GRID_Y,
+    WGPU_LIGHT_CLUSTERS_DEFAULT_GRID_Z,
+  };
+  light_cluster_params_t* params = &light_clusters->params;
+  light_clusters->cluster_count  = 1;
+  for (uint32_t i = 0; i < 3; ++i) {
+    params->grid_size[i]
+      = desc->grid_size[i] > 0 ? desc->grid_size[i] : default_grid_size[i];
+    light_clusters->cluster_count *= params->grid_size[i];
+  }
+  params->max_lights_per_cluster
+    = desc->max_lights_per_cluster > 0 ?
+        desc->max_lights_per_cluster :
+        WGPU_LIGHT_CLUSTERS_DEFAULT_MAX_LIGHTS_PER_CLUSTER;
+  params->light_stride = desc->light_stride / 16;
+  params->radius_index = desc->radius_offset / 4;
+
+  light_clusters->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "light_clusters_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(light_cluster_params_t),
+                  });
+  light_clusters->cluster_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "light_clusters_cluster_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = light_clusters->cluster_count
+                            * (params->max_lights_per_cluster + 1)
+                            * sizeof(uint32_t),
+                  });
+
+  light_clusters_create_bind_group_layouts(light_clusters);
+  light_clusters_create_build_pipeline(light_clusters);
+
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = light_clusters->params_buffer.buffer,
+      .size    = light_clusters->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = light_clusters->cluster_buffer.buffer,
+      .size    = light_clusters->cluster_buffer.size,
+    },
+  };
+  light_clusters->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "light_clusters_bind_group",
+                            .layout     = light_clusters->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(light_clusters->bind_group != NULL);
+
+  return light_clusters;
+}
+
+void wgpu_light_clusters_release(wgpu_light_clusters_t* light_clusters)
+{
+  if (light_clusters == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, light_clusters->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, light_clusters->bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroup, light_clusters->build_bind_group)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, light_clusters->build_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        light_clusters->build_bind_group_layout)
+  wgpu_destroy_buffer(&light_clusters->cluster_buffer);
+  wgpu_destroy_buffer(&light_clusters->params_buffer);
+  free(light_clusters);
+}
+
+void wgpu_light_clusters_update(wgpu_light_clusters_t* light_clusters,
+                                const wgpu_light_clusters_view_t* view,
+                                uint32_t light_count)
+{
+  light_cluster_params_t* params = &light_clusters->params;
+  glm_mat4_copy((vec4*)view->view_matrix, params->view_matrix);
+  glm_mat4_inv((vec4*)view->projection_matrix, params->inverse_projection);
+  params->light_count    = light_count;
+  params->screen_size[0] = (float)view->width;
+  params->screen_size[1] = (float)view->height;
+  params->z_near         = view->z_near;
+  params->z_far          = view->z_far;
+  wgpuQueueWriteBuffer(light_clusters->wgpu_context->queue,
+                       light_clusters->params_buffer.buffer, 0, params,
+                       sizeof(*params));
+}
+
+void wgpu_light_clusters_build(wgpu_light_clusters_t* light_clusters,
+                               WGPUComputePassEncoder pass_encoder,
+                               WGPUBuffer lights_buffer)
+{
+  // The bind group is recreated when another lights buffer is culled
+  if (lights_buffer != light_clusters->build_lights_buffer) {
+    WGPUBindGroupEntry bg_entries[3] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = light_clusters->params_buffer.buffer,
+        .size    = light_clusters->params_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding = 1,
+        .buffer  = lights_buffer,
+        .size    = WGPU_WHOLE_SIZE,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding = 2,
+        .buffer  = light_clusters->cluster_buffer.buffer,
+        .size    = light_clusters->cluster_buffer.size,
+      },
+    };
+    WGPU_RELEASE_RESOURCE(BindGroup, light_clusters->build_bind_group)
+    light_clusters->build_bind_group = wgpuDeviceCreateBindGroup(
+      light_clusters->wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "light_clusters_build_bind_group",
+        .layout     = light_clusters->build_bind_group_layout,
+        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+        .entries    = bg_entries,
+      });
+    ASSERT(light_clusters->build_bind_group != NULL);
+    light_clusters->build_lights_buffer = lights_buffer;
+  }
+
+  wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                    light_clusters->build_pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0,
+                                     light_clusters->build_bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    (light_clusters->cluster_count + WGPU_LIGHT_CLUSTERS_WORKGROUP_SIZE - 1)
+      / WGPU_LIGHT_CLUSTERS_WORKGROUP_SIZE,
+    1, 1);
+}
+
+WGPUBindGroupLayout
+wgpu_light_clusters_get_bind_group_layout(wgpu_light_clusters_t* clusters)
+{
+  return clusters->bind_group_layout;
+}
+
+WGPUBindGroup
+wgpu_light_clusters_get_bind_group(wgpu_light_clusters_t* clusters)
+{
+  return clusters->bind_group;
+}
+
+const char* wgpu_light_clusters_get_wgsl_functions(void)
+{
+  return light_clusters_wgsl_functions;
+}
@@ -0,0 +1,90 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+/* Default grid of screen tiles and depth slices */
+#define WGPU_LIGHT_CLUSTERS_DEFAULT_GRID_X 16u
+#define WGPU_LIGHT_CLUSTERS_DEFAULT_GRID_Y 9u
+#define WGPU_LIGHT_CLUSTERS_DEFAULT_GRID_Z 24u
+#define WGPU_LIGHT_CLUSTERS_DEFAULT_MAX_LIGHTS_PER_CLUSTER 128u
+
+/*
+ * Clustered light culling: a compute pass bins the point lights of a storage
+ * buffer into a 3D grid of froxels, screen tiles split into depth slices with
+ * an exponential distribution between the near and far planes. Every cluster
+ * gets the list of the lights whose sphere of influence overlaps its view
+ * space bounds, so that shading only loops over the lights of its cluster.
+ *
+ * The lights are read from an array of structs of light_stride bytes, with
+ * the world space position as the first vec3<f32> and the f32 radius at
+ * radius_offset. The projection is expected to be a right-handed
+ * perspective projection looking along -z.
+ */
+typedef struct wgpu_light_clusters wgpu_light_clusters_t;
+
+typedef struct wgpu_light_clusters_desc_t {
+  /* Screen tiles and depth slices, 0 selects the defaults */
+  uint32_t grid_size[3];
+  /* Lights in a cluster beyond this count are dropped, 0 selects the
+   * default */
+  uint32_t max_lights_per_cluster;
+  /* Light layout, light_stride is a multiple of 16 */
+  uint32_t light_stride;
+  uint32_t radius_offset;
+} wgpu_light_clusters_desc_t;
+
+/* Camera of the frame the clusters are built for */
+typedef struct wgpu_light_clusters_view_t {
+  mat4 view_matrix;
+  mat4 projection_matrix;
+  float z_near;
+  float z_far;
+  uint32_t width; /* surface size in pixels */
+  uint32_t height;
+} wgpu_light_clusters_view_t;
+
+/* Light clusters creating/releasing */
+wgpu_light_clusters_t*
+wgpu_light_clusters_create(wgpu_context_t* wgpu_context,
+                           const wgpu_light_clusters_desc_t* desc);
+void wgpu_light_clusters_release(wgpu_light_clusters_t* light_clusters);
+
+/* Writes the camera and the number of lights used by the next build */
+void wgpu_light_clusters_update(wgpu_light_clusters_t* light_clusters,
+                                const wgpu_light_clusters_view_t* view,
+                                uint32_t light_count);
+
+/**
+ * @brief Records the culling of the lights of lights_buffer, which needs the
+ * Storage usage, into the clusters. The shading passes of the frame have to
+ * be recorded afterwards.
+ */
+void wgpu_light_clusters_build(wgpu_light_clusters_t* light_clusters,
+                               WGPUComputePassEncoder pass_encoder,
+                               WGPUBuffer lights_buffer);
+
+/*
+ * Bind group of the shading passes, visible from fragment and compute shaders:
+ *   binding 0: var<uniform> clusterParams : LightClusterParams
+ *   binding 1: var<storage, read> clusterLights : array<u32>
+ */
+WGPUBindGroupLayout
+wgpu_light_clusters_get_bind_group_layout(wgpu_light_clusters_t* clusters);
+WGPUBindGroup
+wgpu_light_clusters_get_bind_group(wgpu_light_clusters_t* clusters);
+
+/*
+ * WGSL cluster lookup functions for shading passes, to be prepended to their
+ * source. The shader declares the bindings of the bind group above with the
+ * names clusterParams and clusterLights:
+ *   fn lightClusterGetIndex(fragCoord : vec2<f32>,
+ *                           worldPosition : vec3<f32>) -> u32
+ *   fn lightClusterGetLightCount(cluster : u32) -> u32
+ *   fn lightClusterGetLightIndex(cluster : u32, i : u32) -> u32
+ */
+const char* wgpu_light_clusters_get_wgsl_functions(void);
+
+#endif
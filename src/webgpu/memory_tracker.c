@@ -0,0 +1,513 @@
+#include "memory_tracker.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define WGPU_MEMORY_TRACKER_HAS_BACKTRACE
+#endif
+
+#include <dawn/webgpu.h>
+
+#include "../../lib/wgpu_native/wgpu_native.h"
+#include "../core/log.h"
+#include "../core/macro.h"
+
+#define WGPU_MEMORY_TRACKER_MAX_LABEL_LENGTH 64u
+#define WGPU_MEMORY_TRACKER_INITIAL_CAPACITY 1024u
+#define WGPU_MEMORY_TRACKER_MAX_STACK_DEPTH 12u
+/* Frames of the hook and the tracker at the top of the creation stacks */
+#define WGPU_MEMORY_TRACKER_SKIPPED_STACK_DEPTH 3u
+
+/* Key of the removed entries, the probe sequences continue over them */
+#define WGPU_MEMORY_TRACKER_TOMBSTONE ((void const*)(uintptr_t)1)
+
+typedef struct wgpu_memory_entry_t {
+  void const* handle; /* NULL for empty entries */
+  uint64_t size;
+  wgpu_memory_category_t category;
+  /* Mirror of the reference count of the handle, from the application side */
+  uint32_t ref_count;
+  bool destroyed; /* memory freed, handle still referenced */
+  uint64_t creation_index;
+  char label[WGPU_MEMORY_TRACKER_MAX_LABEL_LENGTH];
+  /* Return addresses of the creation, with lifetime tracking */
+  void* stack[WGPU_MEMORY_TRACKER_MAX_STACK_DEPTH];
+  uint32_t stack_depth;
+} wgpu_memory_entry_t;
+
+static struct {
+  bool enabled;
+  bool track_lifetimes;
+  pthread_mutex_t mutex;
+  /* Open addressing hash map of the live handles, linear probing */
+  wgpu_memory_entry_t* entries;
+  uint32_t capacity; /* power of two */
+  uint32_t count;
+  uint32_t tombstone_count;
+  uint64_t creation_count;
+  wgpu_memory_stats_t stats;
+  bool over_budget;
+} wgpu_memory_tracker = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const char* wgpu_memory_category_names[WGPU_MEMORY_CATEGORY_COUNT] = {
+  [WGPU_MEMORY_CATEGORY_VERTEX_INDEX_BUFFER] = "Vertex / index buffers",
+  [WGPU_MEMORY_CATEGORY_UNIFORM_BUFFER]      = "Uniform buffers",
+  [WGPU_MEMORY_CATEGORY_STORAGE_BUFFER]      = "Storage buffers",
+  [WGPU_MEMORY_CATEGORY_STAGING_BUFFER]      = "Staging buffers",
+  [WGPU_MEMORY_CATEGORY_OTHER_BUFFER]        = "Other buffers",
+  [WGPU_MEMORY_CATEGORY_TEXTURE]             = "Textures",
+  [WGPU_MEMORY_CATEGORY_RENDER_TARGET]       = "Render targets",
+  [WGPU_MEMORY_CATEGORY_DEPTH_STENCIL]       = "Depth / stencil",
+};
+
+const char* wgpu_memory_category_name(wgpu_memory_category_t category)
+{
+  return category < WGPU_MEMORY_CATEGORY_COUNT ?
+           wgpu_memory_category_names[category] :
+           "Unknown";
+}
+
+static uint32_t hash_handle(void const* handle)
+{
+  /* Fibonacci hashing of the pointer, its low bits are mostly alignment */
+  uint64_t key = (uint64_t)(uintptr_t)handle;
+  return (uint32_t)((key * 11400714819323198485ull) >> 32);
+}
+
+/* Entry of the handle, or the empty entry to insert it at */
+static wgpu_memory_entry_t* find_entry(wgpu_memory_entry_t* entries,
+                                       uint32_t capacity, void const* handle)
+{
+  const uint32_t mask            = capacity - 1u;
+  wgpu_memory_entry_t* insert_at = NULL;
+  for (uint32_t i = hash_handle(handle) & mask;; i = (i + 1u) & mask) {
+    wgpu_memory_entry_t* entry = &entries[i];
+    if (entry->handle == handle) {
+      return entry;
+    }
+    if (entry->handle == WGPU_MEMORY_TRACKER_TOMBSTONE) {
+      if (insert_at == NULL) {
+        insert_at = entry;
+      }
+    }
+    else if (entry->handle == NULL) {
+      return insert_at != NULL ? insert_at : entry;
+    }
+  }
+}
+
+static void rehash(uint32_t capacity)
+{
+  wgpu_memory_entry_t* entries = calloc(capacity, sizeof(*entries));
+  ASSERT(entries != NULL);
+  for (uint32_t i = 0; i < wgpu_memory_tracker.capacity; ++i) {
+    wgpu_memory_entry_t* entry = &wgpu_memory_tracker.entries[i];
+    if (entry->handle != NULL
+        && entry->handle != WGPU_MEMORY_TRACKER_TOMBSTONE) {
+      *find_entry(entries, capacity, entry->handle) = *entry;
+    }
+  }
+  free(wgpu_memory_tracker.entries);
+  wgpu_memory_tracker.entries         = entries;
+  wgpu_memory_tracker.capacity        = capacity;
+  wgpu_memory_tracker.tombstone_count = 0;
+}
+
+static void check_budget(void)
+{
+  wgpu_memory_stats_t* stats = &wgpu_memory_tracker.stats;
+  const bool over_budget
+    = stats->budget_bytes > 0 && stats->total_bytes > stats->budget_bytes;
+  if (over_budget && !wgpu_memory_tracker.over_budget) {
+    log_warn("GPU memory budget exceeded: %.1f MiB of %.1f MiB",
+             (double)stats->total_bytes / (1024.0 * 1024.0),
+             (double)stats->budget_bytes / (1024.0 * 1024.0));
+  }
+  wgpu_memory_tracker.over_budget = over_budget;
+}
+
+static void track(void const* handle, wgpu_memory_category_t category,
+                  uint64_t size, char const* label)
+{
+  /* The stack is captured outside of the lock, it may take a while */
+  void* stack[WGPU_MEMORY_TRACKER_MAX_STACK_DEPTH
+              + WGPU_MEMORY_TRACKER_SKIPPED_STACK_DEPTH];
+  uint32_t stack_depth = 0;
+#if defined(WGPU_MEMORY_TRACKER_HAS_BACKTRACE)
+  if (wgpu_memory_tracker.track_lifetimes) {
+    stack_depth = (uint32_t)MAX(backtrace(stack, (int)ARRAY_SIZE(stack)), 0);
+  }
+#endif
+  const uint32_t skipped_depth
+    = MIN(stack_depth, WGPU_MEMORY_TRACKER_SKIPPED_STACK_DEPTH);
+
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  /* Grow at 3/4 occupancy, tombstones included */
+  if ((wgpu_memory_tracker.count + wgpu_memory_tracker.tombstone_count + 1u)
+        * 4u
+      > wgpu_memory_tracker.capacity * 3u) {
+    rehash(wgpu_memory_tracker.capacity == 0 ?
+             WGPU_MEMORY_TRACKER_INITIAL_CAPACITY :
+             (wgpu_memory_tracker.count * 2u > wgpu_memory_tracker.capacity ?
+                wgpu_memory_tracker.capacity * 2u :
+                wgpu_memory_tracker.capacity));
+  }
+  wgpu_memory_entry_t* entry = find_entry(
+    wgpu_memory_tracker.entries, wgpu_memory_tracker.capacity, handle);
+  /* Handles are not reused while they are alive */
+  ASSERT(entry->handle != handle);
+  if (entry->handle == WGPU_MEMORY_TRACKER_TOMBSTONE) {
+    --wgpu_memory_tracker.tombstone_count;
+  }
+  *entry = (wgpu_memory_entry_t){
+    .handle    = handle,
+    .size      = size,
+    .category       = category,
+    .ref_count      = 1,
+    .creation_index = wgpu_memory_tracker.creation_count++,
+    .stack_depth    = stack_depth - skipped_depth,
+  };
+  snprintf(entry->label, sizeof(entry->label), "%s",
+           label != NULL ? label : "");
+  memcpy(entry->stack, stack + skipped_depth,
+         entry->stack_depth * sizeof(void*));
+  ++wgpu_memory_tracker.count;
+
+  wgpu_memory_stats_t* stats = &wgpu_memory_tracker.stats;
+  stats->bytes[category] += size;
+  ++stats->counts[category];
+  stats->total_bytes += size;
+  stats->peak_bytes = MAX(stats->peak_bytes, stats->total_bytes);
+  check_budget();
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+}
+
+/* Subtracts the memory of the entry, on destruction or the last release */
+static void free_entry_memory(wgpu_memory_entry_t* entry)
+{
+  if (entry->destroyed) {
+    return;
+  }
+  wgpu_memory_stats_t* stats = &wgpu_memory_tracker.stats;
+  stats->bytes[entry->category] -= entry->size;
+  --stats->counts[entry->category];
+  stats->total_bytes -= entry->size;
+  entry->destroyed = true;
+  check_budget();
+}
+
+/* Untracked handles, created before enabling the tracker, are ignored */
+static wgpu_memory_entry_t* lookup(void const* handle)
+{
+  if (wgpu_memory_tracker.count == 0) {
+    return NULL;
+  }
+  wgpu_memory_entry_t* entry = find_entry(
+    wgpu_memory_tracker.entries, wgpu_memory_tracker.capacity, handle);
+  return entry->handle == handle ? entry : NULL;
+}
+
+static void on_referenced(void const* handle)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  wgpu_memory_entry_t* entry = lookup(handle);
+  if (entry != NULL) {
+    ++entry->ref_count;
+  }
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+}
+
+static void on_released(void const* handle)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  wgpu_memory_entry_t* entry = lookup(handle);
+  if (entry != NULL && --entry->ref_count == 0) {
+    free_entry_memory(entry);
+    entry->handle = WGPU_MEMORY_TRACKER_TOMBSTONE;
+    --wgpu_memory_tracker.count;
+    ++wgpu_memory_tracker.tombstone_count;
+  }
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+}
+
+static void on_destroyed(void const* handle)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  wgpu_memory_entry_t* entry = lookup(handle);
+  if (entry != NULL) {
+    free_entry_memory(entry);
+  }
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+}
+
+static wgpu_memory_category_t buffer_category(WGPUBufferUsageFlags usage)
+{
+  if (usage & (WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite)) {
+    return WGPU_MEMORY_CATEGORY_STAGING_BUFFER;
+  }
+  if (usage & (WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect)) {
+    return WGPU_MEMORY_CATEGORY_STORAGE_BUFFER;
+  }
+  if (usage & (WGPUBufferUsage_Vertex | WGPUBufferUsage_Index)) {
+    return WGPU_MEMORY_CATEGORY_VERTEX_INDEX_BUFFER;
+  }
+  if (usage & WGPUBufferUsage_Uniform) {
+    return WGPU_MEMORY_CATEGORY_UNIFORM_BUFFER;
+  }
+  return WGPU_MEMORY_CATEGORY_OTHER_BUFFER;
+}
+
+static void on_buffer_created(WGPUBuffer buffer,
+                              WGPUBufferDescriptor const* descriptor)
+{
+  track(buffer, buffer_category(descriptor->usage), descriptor->size,
+        descriptor->label);
+}
+
+static bool is_depth_stencil_format(WGPUTextureFormat format)
+{
+  switch (format) {
+    case WGPUTextureFormat_Stencil8:
+    case WGPUTextureFormat_Depth16Unorm:
+    case WGPUTextureFormat_Depth24Plus:
+    case WGPUTextureFormat_Depth24PlusStencil8:
+    case WGPUTextureFormat_Depth32Float:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Returns the bytes per block of a texture format, the blocks of the
+ * compressed formats are 4x4 texels. ASTC formats are approximated with their
+ * 4x4 block size, unknown formats with 4 bytes per texel.
+ */
+static uint32_t texture_format_bytes(WGPUTextureFormat format,
+                                     uint32_t* block_size)
+{
+  *block_size = 1u;
+  switch (format) {
+    case WGPUTextureFormat_R8Unorm:
+    case WGPUTextureFormat_R8Snorm:
+    case WGPUTextureFormat_R8Uint:
+    case WGPUTextureFormat_R8Sint:
+    case WGPUTextureFormat_Stencil8:
+      return 1u;
+    case WGPUTextureFormat_R16Uint:
+    case WGPUTextureFormat_R16Sint:
+    case WGPUTextureFormat_R16Float:
+    case WGPUTextureFormat_RG8Unorm:
+    case WGPUTextureFormat_RG8Snorm:
+    case WGPUTextureFormat_RG8Uint:
+    case WGPUTextureFormat_RG8Sint:
+    case WGPUTextureFormat_Depth16Unorm:
+      return 2u;
+    case WGPUTextureFormat_RG16Uint:
+    case WGPUTextureFormat_RG16Sint:
+    case WGPUTextureFormat_RG16Float:
+    case WGPUTextureFormat_R32Float:
+    case WGPUTextureFormat_R32Uint:
+    case WGPUTextureFormat_R32Sint:
+    case WGPUTextureFormat_RGBA8Unorm:
+    case WGPUTextureFormat_RGBA8UnormSrgb:
+    case WGPUTextureFormat_RGBA8Snorm:
+    case WGPUTextureFormat_RGBA8Uint:
+    case WGPUTextureFormat_RGBA8Sint:
+    case WGPUTextureFormat_BGRA8Unorm:
+    case WGPUTextureFormat_BGRA8UnormSrgb:
+    case WGPUTextureFormat_RGB10A2Unorm:
+    case WGPUTextureFormat_RG11B10Ufloat:
+    case WGPUTextureFormat_RGB9E5Ufloat:
+    case WGPUTextureFormat_Depth24Plus:
+    case WGPUTextureFormat_Depth24PlusStencil8:
+    case WGPUTextureFormat_Depth32Float:
+      return 4u;
+    case WGPUTextureFormat_RG32Float:
+    case WGPUTextureFormat_RG32Uint:
+    case WGPUTextureFormat_RG32Sint:
+    case WGPUTextureFormat_RGBA16Uint:
+    case WGPUTextureFormat_RGBA16Sint:
+    case WGPUTextureFormat_RGBA16Float:
+      return 8u;
+    case WGPUTextureFormat_RGBA32Float:
+    case WGPUTextureFormat_RGBA32Uint:
+    case WGPUTextureFormat_RGBA32Sint:
+      return 16u;
+    case WGPUTextureFormat_BC1RGBAUnorm:
+    case WGPUTextureFormat_BC1RGBAUnormSrgb:
+    case WGPUTextureFormat_BC4RUnorm:
+    case WGPUTextureFormat_BC4RSnorm:
+    case WGPUTextureFormat_ETC2RGB8Unorm:
+    case WGPUTextureFormat_ETC2RGB8UnormSrgb:
+    case WGPUTextureFormat_ETC2RGB8A1Unorm:
+    case WGPUTextureFormat_ETC2RGB8A1UnormSrgb:
+    case WGPUTextureFormat_EACR11Unorm:
+    case WGPUTextureFormat_EACR11Snorm:
+      *block_size = 4u;
+      return 8u;
+    case WGPUTextureFormat_BC2RGBAUnorm:
+    case WGPUTextureFormat_BC2RGBAUnormSrgb:
+    case WGPUTextureFormat_BC3RGBAUnorm:
+    case WGPUTextureFormat_BC3RGBAUnormSrgb:
+    case WGPUTextureFormat_BC5RGUnorm:
+    case WGPUTextureFormat_BC5RGSnorm:
+    case WGPUTextureFormat_BC6HRGBUfloat:
+    case WGPUTextureFormat_BC6HRGBFloat:
+    case WGPUTextureFormat_BC7RGBAUnorm:
+    case WGPUTextureFormat_BC7RGBAUnormSrgb:
+    case WGPUTextureFormat_ETC2RGBA8Unorm:
+    case WGPUTextureFormat_ETC2RGBA8UnormSrgb:
+    case WGPUTextureFormat_EACRG11Unorm:
+    case WGPUTextureFormat_EACRG11Snorm:
+    case WGPUTextureFormat_ASTC4x4Unorm:
+    case WGPUTextureFormat_ASTC4x4UnormSrgb:
+      *block_size = 4u;
+      return 16u;
+    default:
+      return 4u;
+  }
+}
+
+/* Size of all mip levels and layers, times the sample count */
+static uint64_t texture_size(WGPUTextureDescriptor const* descriptor)
+{
+  uint32_t block_size        = 1u;
+  const uint32_t block_bytes = texture_format_bytes(descriptor->format,
+                                                    &block_size);
+  const bool is_3d = descriptor->dimension == WGPUTextureDimension_3D;
+  uint32_t width   = descriptor->size.width;
+  uint32_t height  = descriptor->size.height;
+  uint32_t depth   = descriptor->size.depthOrArrayLayers;
+  uint64_t size    = 0;
+  for (uint32_t level = 0; level < MAX(descriptor->mipLevelCount, 1u);
+       ++level) {
+    const uint64_t blocks_x = (width + block_size - 1u) / block_size;
+    const uint64_t blocks_y = (height + block_size - 1u) / block_size;
+    size += blocks_x * blocks_y * depth * block_bytes;
+    width  = MAX(width >> 1u, 1u);
+    height = MAX(height >> 1u, 1u);
+    depth  = is_3d ? MAX(depth >> 1u, 1u) : depth;
+  }
+  return size * MAX(descriptor->sampleCount, 1u);
+}
+
+static void on_texture_created(WGPUTexture texture,
+                               WGPUTextureDescriptor const* descriptor)
+{
+  wgpu_memory_category_t category = WGPU_MEMORY_CATEGORY_TEXTURE;
+  if (is_depth_stencil_format(descriptor->format)) {
+    category = WGPU_MEMORY_CATEGORY_DEPTH_STENCIL;
+  }
+  else if (descriptor->usage & WGPUTextureUsage_RenderAttachment) {
+    category = WGPU_MEMORY_CATEGORY_RENDER_TARGET;
+  }
+  track(texture, category, texture_size(descriptor), descriptor->label);
+}
+
+void wgpu_memory_tracker_enable(void)
+{
+  if (wgpu_memory_tracker.enabled) {
+    return;
+  }
+  static const wgpu_resource_hooks_t hooks = {
+    .buffer_created  = on_buffer_created,
+    .texture_created = on_texture_created,
+    .referenced      = on_referenced,
+    .released        = on_released,
+    .destroyed       = on_destroyed,
+  };
+  wgpu_set_resource_hooks(&hooks);
+  wgpu_memory_tracker.enabled = true;
+}
+
+bool wgpu_memory_tracker_is_enabled(void)
+{
+  return wgpu_memory_tracker.enabled;
+}
+
+void wgpu_memory_tracker_set_budget(uint64_t budget_bytes)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  wgpu_memory_tracker.stats.budget_bytes = budget_bytes;
+  wgpu_memory_tracker.over_budget        = false;
+  check_budget();
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+}
+
+void wgpu_memory_tracker_get_stats(wgpu_memory_stats_t* stats)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  *stats = wgpu_memory_tracker.stats;
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+}
+
+void wgpu_memory_tracker_set_lifetime_tracking(bool enabled)
+{
+#if !defined(WGPU_MEMORY_TRACKER_HAS_BACKTRACE)
+  if (enabled) {
+    log_warn("No creation stacks on this platform, only labels are tracked");
+  }
+#endif
+  wgpu_memory_tracker.track_lifetimes = enabled;
+}
+
+uint64_t wgpu_memory_tracker_get_creation_count(void)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  const uint64_t creation_count = wgpu_memory_tracker.creation_count;
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+  return creation_count;
+}
+
+static void report_live_entry(const wgpu_memory_entry_t* entry)
+{
+  log_warn("Live %s \"%s\": %llu bytes, %u reference(s)%s",
+           wgpu_memory_category_name(entry->category),
+           entry->label[0] != '\0' ? entry->label : "unlabeled",
+           (unsigned long long)entry->size, entry->ref_count,
+           entry->destroyed ? ", destroyed" : "");
+#if defined(WGPU_MEMORY_TRACKER_HAS_BACKTRACE)
+  if (entry->stack_depth == 0) {
+    return;
+  }
+  char** symbols
+    = backtrace_symbols((void* const*)entry->stack, (int)entry->stack_depth);
+  if (symbols == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < entry->stack_depth; ++i) {
+    log_warn("    created at %s", symbols[i]);
+  }
+  free(symbols);
+#endif
+}
+
+uint32_t wgpu_memory_tracker_report_live(uint64_t first_creation)
+{
+  pthread_mutex_lock(&wgpu_memory_tracker.mutex);
+  uint32_t live_count = 0;
+  uint64_t live_bytes = 0;
+  for (uint32_t i = 0; i < wgpu_memory_tracker.capacity; ++i) {
+    const wgpu_memory_entry_t* entry = &wgpu_memory_tracker.entries[i];
+    if (entry->handle == NULL || entry->handle == WGPU_MEMORY_TRACKER_TOMBSTONE
+        || entry->creation_index < first_creation) {
+      continue;
+    }
+    report_live_entry(entry);
+    ++live_count;
+    live_bytes += entry->destroyed ? 0 : entry->size;
+  }
+  pthread_mutex_unlock(&wgpu_memory_tracker.mutex);
+  if (live_count > 0) {
+    log_warn("%u live resource(s) holding %.2f MiB", live_count,
+             (double)live_bytes / (1024.0 * 1024.0));
+  }
+  return live_count;
+}
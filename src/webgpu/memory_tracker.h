@@ -0,0 +1,63 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Categories of the tracked GPU memory, from the usage of the resources */
+typedef enum wgpu_memory_category_t {
+  WGPU_MEMORY_CATEGORY_VERTEX_INDEX_BUFFER,
+  WGPU_MEMORY_CATEGORY_UNIFORM_BUFFER,
+  WGPU_MEMORY_CATEGORY_STORAGE_BUFFER, /* storage and indirect buffers */
+  WGPU_MEMORY_CATEGORY_STAGING_BUFFER, /* mappable buffers */
+  WGPU_MEMORY_CATEGORY_OTHER_BUFFER,
+  WGPU_MEMORY_CATEGORY_TEXTURE,
+  WGPU_MEMORY_CATEGORY_RENDER_TARGET,
+  WGPU_MEMORY_CATEGORY_DEPTH_STENCIL,
+  WGPU_MEMORY_CATEGORY_COUNT,
+} wgpu_memory_category_t;
+
+typedef struct wgpu_memory_stats_t {
+  uint64_t bytes[WGPU_MEMORY_CATEGORY_COUNT];
+  uint32_t counts[WGPU_MEMORY_CATEGORY_COUNT];
+  uint64_t total_bytes;
+  uint64_t peak_bytes;
+  uint64_t budget_bytes; /* 0 without budget */
+} wgpu_memory_stats_t;
+
+/*
+ * Accounts the memory of all buffers and textures, from their size, usage and
+ * label on creation until they are destroyed or their last reference is
+ * released. The sizes are estimates from the descriptors, without the padding
+ * and alignment of the implementation.
+ *
+ * The tracker is global, it hooks into the proc table and must be enabled
+ * before the resources to track are created.
+ */
+void wgpu_memory_tracker_enable(void);
+bool wgpu_memory_tracker_is_enabled(void);
+
+/* Warns once each time the total exceeds the budget, 0 removes the budget */
+void wgpu_memory_tracker_set_budget(uint64_t budget_bytes);
+
+void wgpu_memory_tracker_get_stats(wgpu_memory_stats_t* stats);
+const char* wgpu_memory_category_name(wgpu_memory_category_t category);
+
+/*
+ * Lifetime tracking, a debug mode that records the call stack of the creation
+ * of every resource in addition to its label, where the platform provides
+ * backtraces.
+ */
+void wgpu_memory_tracker_set_lifetime_tracking(bool enabled);
+
+/* Number of resources created so far, marks the start of a report range */
+uint64_t wgpu_memory_tracker_get_creation_count(void);
+
+/*
+ * Logs the resources created after the first first_creation resources that
+ * are still alive, i.e. that were neither destroyed nor fully released, with
+ * their label and creation stack. Returns the number of live resources.
+ */
+uint32_t wgpu_memory_tracker_report_live(uint64_t first_creation);
+
+#endif /* MEMORY_TRACKER_H */
@@ -0,0 +1,362 @@
+#include "mesh_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "render_bundle_cache.h"
+
+/* Layout of MeshBufferMesh */
+typedef struct mesh_buffer_mesh_t {
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t vertex_offset; /* in u32 */
+  uint32_t padding;
+  /* Format, offset and stride in u32, unused */
+  uint32_t attributes[WGPU_MeshAttribute_Count][4];
+} mesh_buffer_mesh_t;
+
+struct wgpu_mesh_buffer {
+  wgpu_context_t* wgpu_context;
+  /* CPU copies of the storage buffers */
+  struct {
+    mesh_buffer_mesh_t* data;
+    uint32_t count;
+    uint32_t capacity;
+  } meshes;
+  struct {
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+  } vertices;
+  struct {
+    uint32_t* data;
+    uint32_t count;
+    uint32_t capacity;
+  } indices;
+  bool dirty;
+  wgpu_buffer_t meshes_buffer;
+  wgpu_buffer_t vertices_buffer;
+  wgpu_buffer_t indices_buffer;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* mesh_buffer_wgsl_functions = CODE(
+  struct MeshBufferMesh {
+    firstIndex : u32,
+    indexCount : u32,
+    vertexOffset : u32,
+    padding : u32,
+    attributes : array<vec4<u32>, 5>,
+  }
+
+  struct MeshBufferVertex {
+    position : vec3<f32>,
+    normal : vec3<f32>,
+    uv : vec2<f32>,
+    color : vec4<f32>,
+    tangent : vec4<f32>,
+  }
+
+  fn meshBufferLoadF32(word : u32) -> f32 {
+    return bitcast<f32>(meshBufferVertices[word]);
+  }
+
+  fn meshBufferDecode(attribute : vec4<u32>, vertexOffset : u32, vertex : u32,
+                      fallback : vec4<f32>) -> vec4<f32> {
+    let word = vertexOffset + attribute.y + vertex * attribute.z;
+    var value = fallback;
+    switch (attribute.x) {
+      case 1u: {
+        value = vec4<f32>(meshBufferLoadF32(word),
+                          meshBufferLoadF32(word + 1u), fallback.zw);
+      }
+      case 2u: {
+        value = vec4<f32>(meshBufferLoadF32(word),
+                          meshBufferLoadF32(word + 1u),
+                          meshBufferLoadF32(word + 2u), fallback.w);
+      }
+      case 3u: {
+        value = vec4<f32>(meshBufferLoadF32(word),
+                          meshBufferLoadF32(word + 1u),
+                          meshBufferLoadF32(word + 2u),
+                          meshBufferLoadF32(word + 3u));
+      }
+      case 4u: {
+        value = vec4<f32>(unpack2x16float(meshBufferVertices[word]),
+                          fallback.zw);
+      }
+      case 5u: {
+        value = vec4<f32>(unpack2x16snorm(meshBufferVertices[word]),
+                          unpack2x16snorm(meshBufferVertices[word + 1u]));
+      }
+      case 6u: {
+        value = unpack4x8unorm(meshBufferVertices[word]);
+      }
+      default: {
+      }
+    }
+    return value;
+  }
+
+  fn meshBufferGetVertex(mesh : u32, vertexIndex : u32) -> MeshBufferVertex {
+    let m = meshBufferMeshes[mesh];
+    let vertex = meshBufferIndices[vertexIndex];
+    var result : MeshBufferVertex;
+    result.position = meshBufferDecode(m.attributes[0], m.vertexOffset, vertex,
+                                       vec4<f32>(0.0, 0.0, 0.0, 1.0)).xyz;
+    result.normal = meshBufferDecode(m.attributes[1], m.vertexOffset, vertex,
+                                     vec4<f32>(0.0, 0.0, 1.0, 0.0)).xyz;
+    result.uv = meshBufferDecode(m.attributes[2], m.vertexOffset, vertex,
+                                 vec4<f32>(0.0)).xy;
+    result.color = meshBufferDecode(m.attributes[3], m.vertexOffset, vertex,
+                                    vec4<f32>(1.0));
+    result.tangent = meshBufferDecode(m.attributes[4], m.vertexOffset, vertex,
+                                      vec4<f32>(1.0, 0.0, 0.0, 1.0));
+    return result;
+  }
+);
+// clang-format on
+
+/* Grows the array to hold at least count elements */
+static void* mesh_buffer_reserve(void* data, uint64_t* capacity,
+                                 uint64_t count, size_t element_size)
+{
+  if (count <= *capacity) {
+    return data;
+  }
+  uint64_t new_capacity = MAX(*capacity * 2, 64);
+  while (new_capacity < count) {
+    new_capacity *= 2;
+  }
+  data      = realloc(data, new_capacity * element_size);
+  *capacity = new_capacity;
+  return data;
+}
+
+wgpu_mesh_buffer_t* wgpu_mesh_buffer_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_mesh_buffer_t* mesh_buffer
+    = (wgpu_mesh_buffer_t*)malloc(sizeof(wgpu_mesh_buffer_t));
+  memset(mesh_buffer, 0, sizeof(wgpu_mesh_buffer_t));
+  mesh_buffer->wgpu_context = wgpu_context;
+
+  WGPUBindGroupLayoutEntry bgl_entries[3] = {0};
+  for (uint32_t i = 0; i < (uint32_t)ARRAY_SIZE(bgl_entries); ++i) {
+    bgl_entries[i] = (WGPUBindGroupLayoutEntry){
+      .binding    = i,
+      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Compute,
+      .buffer     = (WGPUBufferBindingLayout){
+        .type = WGPUBufferBindingType_ReadOnlyStorage,
+      },
+    };
+  }
+  mesh_buffer->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "mesh_buffer_bind_group_layout",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(mesh_buffer->bind_group_layout != NULL);
+
+  return mesh_buffer;
+}
+
+static void mesh_buffer_release_buffers(wgpu_mesh_buffer_t* mesh_buffer)
+{
+  /* Render bundles drawing pulled vertices bind the bind group */
+  wgpu_render_bundle_cache_invalidate_object(mesh_buffer->bind_group);
+  WGPU_RELEASE_RESOURCE(BindGroup, mesh_buffer->bind_group)
+  wgpu_destroy_buffer(&mesh_buffer->meshes_buffer);
+  wgpu_destroy_buffer(&mesh_buffer->vertices_buffer);
+  wgpu_destroy_buffer(&mesh_buffer->indices_buffer);
+}
+
+void wgpu_mesh_buffer_release(wgpu_mesh_buffer_t* mesh_buffer)
+{
+  if (mesh_buffer == NULL) {
+    return;
+  }
+
+  mesh_buffer_release_buffers(mesh_buffer);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, mesh_buffer->bind_group_layout)
+  free(mesh_buffer->meshes.data);
+  free(mesh_buffer->vertices.data);
+  free(mesh_buffer->indices.data);
+  free(mesh_buffer);
+}
+
+uint64_t wgpu_mesh_buffer_add_vertex_data(wgpu_mesh_buffer_t* mesh_buffer,
+                                          const void* data, uint64_t size)
+{
+  ASSERT(size % 4 == 0);
+
+  const uint64_t offset = mesh_buffer->vertices.size;
+  mesh_buffer->vertices.data
+    = mesh_buffer_reserve(mesh_buffer->vertices.data,
+                          &mesh_buffer->vertices.capacity, offset + size, 1);
+  memcpy(mesh_buffer->vertices.data + offset, data, size);
+  mesh_buffer->vertices.size = offset + size;
+  mesh_buffer->dirty         = true;
+  return offset;
+}
+
+uint32_t wgpu_mesh_buffer_add_mesh(wgpu_mesh_buffer_t* mesh_buffer,
+                                   const wgpu_mesh_desc_t* desc)
+{
+  ASSERT(desc->vertex_offset % 4 == 0);
+  ASSERT(desc->index_size == 2 || desc->index_size == 4);
+
+  // Indices, widened to u32
+  const uint32_t first_index = mesh_buffer->indices.count;
+  {
+    uint64_t capacity = mesh_buffer->indices.capacity;
+    mesh_buffer->indices.data
+      = mesh_buffer_reserve(mesh_buffer->indices.data, &capacity,
+                            (uint64_t)first_index + desc->index_count,
+                            sizeof(uint32_t));
+    mesh_buffer->indices.capacity = (uint32_t)capacity;
+  }
+  uint32_t* indices = &mesh_buffer->indices.data[first_index];
+  if (desc->index_size == 2) {
+    const uint16_t* indices_16 = desc->indices;
+    for (uint32_t i = 0; i < desc->index_count; ++i) {
+      indices[i] = indices_16[i];
+    }
+  }
+  else {
+    memcpy(indices, desc->indices, desc->index_count * sizeof(uint32_t));
+  }
+  mesh_buffer->indices.count += desc->index_count;
+
+  // Mesh description
+  const uint32_t index = mesh_buffer->meshes.count;
+  {
+    uint64_t capacity = mesh_buffer->meshes.capacity;
+    mesh_buffer->meshes.data
+      = mesh_buffer_reserve(mesh_buffer->meshes.data, &capacity,
+                            (uint64_t)index + 1, sizeof(mesh_buffer_mesh_t));
+    mesh_buffer->meshes.capacity = (uint32_t)capacity;
+  }
+  mesh_buffer_mesh_t* mesh = &mesh_buffer->meshes.data[index];
+  memset(mesh, 0, sizeof(*mesh));
+  mesh->first_index   = first_index;
+  mesh->index_count   = desc->index_count;
+  mesh->vertex_offset = (uint32_t)(desc->vertex_offset / 4);
+  for (uint32_t a = 0; a < WGPU_MeshAttribute_Count; ++a) {
+    const wgpu_mesh_attribute_t* attribute = &desc->attributes[a];
+    ASSERT(attribute->offset % 4 == 0 && attribute->stride % 4 == 0);
+    mesh->attributes[a][0] = (uint32_t)attribute->format;
+    mesh->attributes[a][1] = attribute->offset / 4;
+    mesh->attributes[a][2] = attribute->stride / 4;
+  }
+  mesh_buffer->meshes.count++;
+  mesh_buffer->dirty = true;
+
+  return index;
+}
+
+uint32_t wgpu_mesh_buffer_get_mesh_count(wgpu_mesh_buffer_t* mesh_buffer)
+{
+  return mesh_buffer->meshes.count;
+}
+
+wgpu_mesh_buffer_mesh_t wgpu_mesh_buffer_get_mesh(
+  wgpu_mesh_buffer_t* mesh_buffer, uint32_t mesh)
+{
+  ASSERT(mesh < mesh_buffer->meshes.count);
+  return (wgpu_mesh_buffer_mesh_t){
+    .first_index = mesh_buffer->meshes.data[mesh].first_index,
+    .index_count = mesh_buffer->meshes.data[mesh].index_count,
+  };
+}
+
+static wgpu_buffer_t mesh_buffer_create_storage_buffer(
+  wgpu_context_t* wgpu_context, const char* label, const void* data,
+  uint64_t size)
+{
+  // Bindings can't be empty
+  static const uint32_t zero[4] = {0};
+  return wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = label,
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                    .size  = (uint32_t)(size > 0 ? size : sizeof(zero)),
+                    .initial.data = size > 0 ? data : zero,
+                  });
+}
+
+void wgpu_mesh_buffer_upload(wgpu_mesh_buffer_t* mesh_buffer)
+{
+  if (!mesh_buffer->dirty && mesh_buffer->bind_group != NULL) {
+    return;
+  }
+
+  wgpu_context_t* wgpu_context = mesh_buffer->wgpu_context;
+  mesh_buffer_release_buffers(mesh_buffer);
+  mesh_buffer->meshes_buffer = mesh_buffer_create_storage_buffer(
+    wgpu_context, "mesh_buffer_meshes_buffer", mesh_buffer->meshes.data,
+    mesh_buffer->meshes.count * sizeof(mesh_buffer_mesh_t));
+  mesh_buffer->vertices_buffer = mesh_buffer_create_storage_buffer(
+    wgpu_context, "mesh_buffer_vertices_buffer", mesh_buffer->vertices.data,
+    mesh_buffer->vertices.size);
+  mesh_buffer->indices_buffer = mesh_buffer_create_storage_buffer(
+    wgpu_context, "mesh_buffer_indices_buffer", mesh_buffer->indices.data,
+    mesh_buffer->indices.count * sizeof(uint32_t));
+
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = mesh_buffer->meshes_buffer.buffer,
+      .size    = mesh_buffer->meshes_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = mesh_buffer->vertices_buffer.buffer,
+      .size    = mesh_buffer->vertices_buffer.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = mesh_buffer->indices_buffer.buffer,
+      .size    = mesh_buffer->indices_buffer.size,
+    },
+  };
+  mesh_buffer->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "mesh_buffer_bind_group",
+                            .layout     = mesh_buffer->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(mesh_buffer->bind_group != NULL);
+  mesh_buffer->dirty = false;
+}
+
+WGPUBindGroupLayout
+wgpu_mesh_buffer_get_bind_group_layout(wgpu_mesh_buffer_t* mesh_buffer)
+{
+  return mesh_buffer->bind_group_layout;
+}
+
+WGPUBindGroup wgpu_mesh_buffer_get_bind_group(wgpu_mesh_buffer_t* mesh_buffer)
+{
+  return mesh_buffer->bind_group;
+}
+
+void wgpu_mesh_buffer_draw(wgpu_mesh_buffer_t* mesh_buffer,
+                           WGPURenderPassEncoder rpass_enc, uint32_t mesh,
+                           uint32_t instance_count)
+{
+  ASSERT(mesh < mesh_buffer->meshes.count);
+  const mesh_buffer_mesh_t* m = &mesh_buffer->meshes.data[mesh];
+  wgpuRenderPassEncoderDraw(rpass_enc, m->index_count, instance_count,
+                            m->first_index, mesh);
+}
+
+const char* wgpu_mesh_buffer_get_wgsl_functions(void)
+{
+  return mesh_buffer_wgsl_functions;
+}
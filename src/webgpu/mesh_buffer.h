@@ -0,0 +1,124 @@
+#ifndef MESH_BUFFER_H
+#define MESH_BUFFER_H
+
+#include "context.h"
+
+/*
+ * Mesh buffer for vertex pulling.
+ *
+ * The vertices and indices of many meshes are merged into storage buffers, a
+ * third storage buffer describes every mesh: its index range, where its
+ * vertices start and the format, offset and stride of each attribute. Vertex
+ * shaders fetch and decode the vertices themselves with the WGSL functions
+ * below, so that meshes of different layouts, including quantized ones, are
+ * drawn with a single pipeline without vertex buffer layout.
+ *
+ * Mesh m is drawn with wgpu_mesh_buffer_draw: a non-indexed draw of its
+ * index_count vertices starting at its first index, with m as first
+ * instance. The vertex shader reads the vertex with
+ * meshBufferGetVertex(instance_index, vertex_index).
+ */
+typedef struct wgpu_mesh_buffer wgpu_mesh_buffer_t;
+
+/* Vertex attributes decoded by meshBufferGetVertex */
+typedef enum wgpu_mesh_attribute_enum_t {
+  WGPU_MeshAttribute_Position = 0,
+  WGPU_MeshAttribute_Normal   = 1,
+  WGPU_MeshAttribute_UV       = 2,
+  WGPU_MeshAttribute_Color    = 3,
+  WGPU_MeshAttribute_Tangent  = 4,
+  WGPU_MeshAttribute_Count    = 5,
+} wgpu_mesh_attribute_enum_t;
+
+/* Attribute formats, the missing components are those of the defaults:
+ * normal (0, 0, 1), uv (0, 0), color (1, 1, 1, 1), tangent (1, 0, 0, 1) */
+typedef enum wgpu_mesh_attribute_format_enum_t {
+  WGPU_MeshAttributeFormat_None      = 0, /* attribute not present */
+  WGPU_MeshAttributeFormat_Float32x2 = 1,
+  WGPU_MeshAttributeFormat_Float32x3 = 2,
+  WGPU_MeshAttributeFormat_Float32x4 = 3,
+  WGPU_MeshAttributeFormat_Float16x2 = 4,
+  WGPU_MeshAttributeFormat_Snorm16x4 = 5,
+  WGPU_MeshAttributeFormat_Unorm8x4  = 6,
+} wgpu_mesh_attribute_format_enum_t;
+
+typedef struct wgpu_mesh_attribute_t {
+  wgpu_mesh_attribute_format_enum_t format;
+  /* Bytes from the start of the mesh vertices, a multiple of 4 */
+  uint32_t offset;
+  /* Bytes between two vertices, a multiple of 4 */
+  uint32_t stride;
+} wgpu_mesh_attribute_t;
+
+typedef struct wgpu_mesh_desc_t {
+  /* Byte offset of the mesh vertices in the vertex data, as returned by
+   * wgpu_mesh_buffer_add_vertex_data */
+  uint64_t vertex_offset;
+  wgpu_mesh_attribute_t attributes[WGPU_MeshAttribute_Count];
+  /* Indices relative to the mesh vertices */
+  const void* indices;
+  uint32_t index_count;
+  uint32_t index_size; /* 2 or 4 */
+} wgpu_mesh_desc_t;
+
+typedef struct wgpu_mesh_buffer_mesh_t {
+  uint32_t first_index;
+  uint32_t index_count;
+} wgpu_mesh_buffer_mesh_t;
+
+/* Mesh buffer creating/releasing */
+wgpu_mesh_buffer_t* wgpu_mesh_buffer_create(wgpu_context_t* wgpu_context);
+void wgpu_mesh_buffer_release(wgpu_mesh_buffer_t* mesh_buffer);
+
+/**
+ * @brief Appends vertex data, which may be shared by several meshes, e.g. the
+ * primitives of a model.
+ * @param size a multiple of 4 bytes
+ * @return the byte offset of the data, the vertex_offset of the meshes
+ */
+uint64_t wgpu_mesh_buffer_add_vertex_data(wgpu_mesh_buffer_t* mesh_buffer,
+                                          const void* data, uint64_t size);
+
+/* Appends a mesh, returns its index */
+uint32_t wgpu_mesh_buffer_add_mesh(wgpu_mesh_buffer_t* mesh_buffer,
+                                   const wgpu_mesh_desc_t* desc);
+
+uint32_t wgpu_mesh_buffer_get_mesh_count(wgpu_mesh_buffer_t* mesh_buffer);
+wgpu_mesh_buffer_mesh_t wgpu_mesh_buffer_get_mesh(
+  wgpu_mesh_buffer_t* mesh_buffer, uint32_t mesh);
+
+/**
+ * @brief Uploads the meshes added so far. The storage buffers and the bind
+ * group are created again when meshes were added since the last upload, bind
+ * groups returned before are released then.
+ */
+void wgpu_mesh_buffer_upload(wgpu_mesh_buffer_t* mesh_buffer);
+
+/*
+ * Bind group of the mesh buffer, visible from vertex and compute shaders:
+ *   binding 0: var<storage, read> meshBufferMeshes : array<MeshBufferMesh>
+ *   binding 1: var<storage, read> meshBufferVertices : array<u32>
+ *   binding 2: var<storage, read> meshBufferIndices : array<u32>
+ * The indices are stored as u32.
+ */
+WGPUBindGroupLayout
+wgpu_mesh_buffer_get_bind_group_layout(wgpu_mesh_buffer_t* mesh_buffer);
+WGPUBindGroup wgpu_mesh_buffer_get_bind_group(wgpu_mesh_buffer_t* mesh_buffer);
+
+/* Draws instance_count copies of the mesh, instance_count has to be 1 unless
+ * the shader knows the mesh otherwise, as the instance index selects it */
+void wgpu_mesh_buffer_draw(wgpu_mesh_buffer_t* mesh_buffer,
+                           WGPURenderPassEncoder rpass_enc, uint32_t mesh,
+                           uint32_t instance_count);
+
+/*
+ * WGSL decoding functions, to be prepended to the shader source. The shader
+ * declares the bindings of the bind group above:
+ *   struct MeshBufferVertex { position, normal, uv, color, tangent }
+ *   fn meshBufferGetVertex(mesh : u32, vertexIndex : u32) -> MeshBufferVertex
+ * where vertexIndex indexes meshBufferIndices, i.e. the vertex_index builtin
+ * of wgpu_mesh_buffer_draw.
+ */
+const char* wgpu_mesh_buffer_get_wgsl_functions(void);
+
+#endif
@@ -0,0 +1,510 @@
+#include "meshlet_culling.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "../core/mesh_optimizer.h"
+#include "pipeline_cache.h"
+#include "shader.h"
+
+/* Invocations copying the indices of a visible meshlet */
+#define MESHLET_CULLING_WORKGROUP_SIZE 64u
+/* Workgroups per dimension of a dispatch */
+#define MESHLET_CULLING_MAX_WORKGROUPS 65535u
+#define MESHLET_CULLING_DRAW_ARGS_COUNT 5u
+
+/* Layout of Meshlet */
+typedef struct meshlet_culling_meshlet_t {
+  vec3 center;
+  float radius;
+  vec3 cone_apex;
+  float cone_cutoff;
+  vec3 cone_axis;
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t padding[3];
+} meshlet_culling_meshlet_t;
+
+/* Layout of Params */
+typedef struct meshlet_culling_params_t {
+  mat4 model;
+  mat4 view_projection;
+  mat4 occlusion_view_projection;
+  vec3 camera_position;
+  float scale; /* largest scale of the model matrix */
+  uint32_t meshlet_count;
+  uint32_t occlusion_culling; /* test against the depth pyramid */
+  uint32_t padding[2];
+} meshlet_culling_params_t;
+
+struct wgpu_meshlet_culling {
+  wgpu_context_t* wgpu_context;
+  uint32_t meshlet_count;
+  uint32_t index_count;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t meshlet_buffer;
+  wgpu_buffer_t source_index_buffer;
+  wgpu_buffer_t index_buffer;
+  wgpu_buffer_t args_buffer;
+  /* Bound instead of a depth pyramid when occlusion culling is off */
+  WGPUTexture dummy_texture;
+  WGPUTextureView dummy_view;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUComputePipeline pipeline;
+};
+
+// clang-format off
+static const char* meshlet_culling_shader_wgsl = CODE(
+  struct Meshlet {
+    center : vec3<f32>,
+    radius : f32,
+    coneApex : vec3<f32>,
+    coneCutoff : f32,
+    coneAxis : vec3<f32>,
+    firstIndex : u32,
+    indexCount : u32,
+  };
+
+  struct Params {
+    model : mat4x4<f32>,
+    viewProjection : mat4x4<f32>,
+    occlusionViewProjection : mat4x4<f32>,
+    cameraPosition : vec3<f32>,
+    scale : f32,
+    meshletCount : u32,
+    occlusionCulling : u32,
+  };
+
+  struct DrawArgs {
+    indexCount : atomic<u32>,
+    instanceCount : u32,
+    firstIndex : u32,
+    baseVertex : i32,
+    firstInstance : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1) var<storage, read> meshlets : array<Meshlet>;
+  @group(0) @binding(2) var<storage, read> srcIndices : array<u32>;
+  @group(0) @binding(3) var<storage, read_write> dstIndices : array<u32>;
+  @group(0) @binding(4) var<storage, read_write> drawArgs : DrawArgs;
+  @group(0) @binding(5) var depthPyramid : texture_2d<f32>;
+
+  var<workgroup> dstOffset : u32;
+
+  fn matrixRow(m : mat4x4<f32>, i : u32) -> vec4<f32> {
+    return vec4<f32>(m[0][i], m[1][i], m[2][i], m[3][i]);
+  }
+
+  // Sphere against the clip planes, depth in [0, 1]
+  fn isSphereInFrustum(center : vec3<f32>, radius : f32) -> bool {
+    let m = params.viewProjection;
+    let x = matrixRow(m, 0u);
+    let y = matrixRow(m, 1u);
+    let z = matrixRow(m, 2u);
+    let w = matrixRow(m, 3u);
+    var planes = array<vec4<f32>, 6>(w + x, w - x, w + y, w - y, z, w - z);
+    for (var i = 0u; i < 6u; i = i + 1u) {
+      let plane = planes[i];
+      if (dot(plane.xyz, center) + plane.w < -radius * length(plane.xyz)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  fn isMeshletVisible(meshlet : Meshlet) -> bool {
+    let center = (params.model * vec4<f32>(meshlet.center, 1.0)).xyz;
+    if (!isSphereInFrustum(center, meshlet.radius * params.scale)) {
+      return false;
+    }
+    // All triangles face away from the camera
+    if (meshlet.coneCutoff < 1.0) {
+      let apex = (params.model * vec4<f32>(meshlet.coneApex, 1.0)).xyz;
+      let axis = normalize((params.model * vec4<f32>(meshlet.coneAxis, 0.0))
+                             .xyz);
+      if (dot(normalize(apex - params.cameraPosition), axis)
+          >= meshlet.coneCutoff) {
+        return false;
+      }
+    }
+    if (params.occlusionCulling != 0u) {
+      let extent = vec3<f32>(meshlet.radius);
+      return !hizIsBoxOccluded(depthPyramid,
+                               params.occlusionViewProjection * params.model,
+                               meshlet.center - extent,
+                               meshlet.center + extent);
+    }
+    return true;
+  }
+
+  @compute @workgroup_size(64)
+  fn main(@builtin(workgroup_id) groupId : vec3<u32>,
+          @builtin(num_workgroups) groupCount : vec3<u32>,
+          @builtin(local_invocation_index) localIndex : u32) {
+    let index = groupId.x + groupId.y * groupCount.x;
+    if (localIndex == 0u) {
+      var offset = INVALID_OFFSET;
+      if (index < params.meshletCount
+          && isMeshletVisible(meshlets[index])) {
+        offset = atomicAdd(&drawArgs.indexCount, meshlets[index].indexCount);
+      }
+      dstOffset = offset;
+    }
+    workgroupBarrier();
+
+    let offset = dstOffset;
+    if (offset == INVALID_OFFSET) {
+      return;
+    }
+    let meshlet = meshlets[index];
+    for (var i = localIndex; i < meshlet.indexCount;
+         i = i + WORKGROUP_SIZE) {
+      dstIndices[offset + i] = srcIndices[meshlet.firstIndex + i];
+    }
+  }
+);
+// clang-format on
+
+static void meshlet_culling_create_pipeline(wgpu_meshlet_culling_t* culling)
+{
+  wgpu_context_t* wgpu_context = culling->wgpu_context;
+
+  // Explicit layout, the depth pyramid is not filterable
+  WGPUBindGroupLayoutEntry bgl_entries[6] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Culling parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(meshlet_culling_params_t),
+      },
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Meshlets
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = culling->meshlet_buffer.size,
+      },
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Source indices
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = culling->source_index_buffer.size,
+      },
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Compacted indices
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = culling->index_buffer.size,
+      },
+    },
+    [4] = (WGPUBindGroupLayoutEntry) {
+      // Binding 4: Indirect draw arguments
+      .binding    = 4,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = culling->args_buffer.size,
+      },
+    },
+    [5] = (WGPUBindGroupLayoutEntry) {
+      // Binding 5: Depth pyramid
+      .binding    = 5,
+      .visibility = WGPUShaderStage_Compute,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_UnfilterableFloat,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+      .storageTexture = {0},
+    },
+  };
+  culling->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "meshlet_culling_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(culling->bind_group_layout != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "meshlet_culling_layout",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts = &culling->bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  // Compute pipeline, with the visibility test of the depth pyramid
+  const char* hiz_wgsl = wgpu_depth_pyramid_get_wgsl_functions();
+  const size_t wgsl_size
+    = strlen(hiz_wgsl) + strlen(meshlet_culling_shader_wgsl) + 128;
+  char* wgsl = (char*)malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size,
+           "let WORKGROUP_SIZE : u32 = %uu;\n"
+           "let INVALID_OFFSET : u32 = 0xffffffffu;\n"
+           "%s\n%s",
+           MESHLET_CULLING_WORKGROUP_SIZE, hiz_wgsl,
+           meshlet_culling_shader_wgsl);
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "meshlet_culling_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "main",
+                  });
+  free(wgsl);
+  culling->pipeline = wgpu_pipeline_cache_get_compute_pipeline(
+    wgpu_context, &(WGPUComputePipelineDescriptor){
+                    .label   = "meshlet_culling_pipeline",
+                    .layout  = pipeline_layout,
+                    .compute = comp_shader.programmable_stage_descriptor,
+                  });
+  ASSERT(culling->pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_meshlet_culling_t*
+wgpu_meshlet_culling_create(wgpu_context_t* wgpu_context,
+                            const wgpu_meshlet_culling_desc_t* desc)
+{
+  const uint32_t index_count = desc->index_count - desc->index_count % 3;
+  if (index_count == 0) {
+    return NULL;
+  }
+
+  wgpu_meshlet_culling_t* culling
+    = (wgpu_meshlet_culling_t*)malloc(sizeof(wgpu_meshlet_culling_t));
+  memset(culling, 0, sizeof(wgpu_meshlet_culling_t));
+  culling->wgpu_context = wgpu_context;
+  culling->index_count  = index_count;
+
+  // Meshlets of the triangles in an order with locality
+  uint32_t* indices = (uint32_t*)malloc(index_count * sizeof(uint32_t));
+  memcpy(indices, desc->indices, index_count * sizeof(uint32_t));
+  mesh_optimize_triangle_order(indices, index_count, desc->vertex_count,
+                               desc->positions, desc->position_stride);
+  mesh_meshlet_t* meshlets = (mesh_meshlet_t*)malloc(
+    mesh_meshlet_bound(index_count, desc->max_triangles, desc->max_vertices)
+    * sizeof(mesh_meshlet_t));
+  culling->meshlet_count = mesh_build_meshlets(
+    indices, index_count, desc->vertex_count, desc->positions,
+    desc->position_stride, desc->max_triangles, desc->max_vertices, meshlets);
+  meshlet_culling_meshlet_t* gpu_meshlets = (meshlet_culling_meshlet_t*)calloc(
+    culling->meshlet_count, sizeof(meshlet_culling_meshlet_t));
+  for (uint32_t i = 0; i < culling->meshlet_count; ++i) {
+    const mesh_meshlet_t* meshlet          = &meshlets[i];
+    meshlet_culling_meshlet_t* gpu_meshlet = &gpu_meshlets[i];
+    memcpy(gpu_meshlet->center, meshlet->center, sizeof(vec3));
+    memcpy(gpu_meshlet->cone_apex, meshlet->cone_apex, sizeof(vec3));
+    memcpy(gpu_meshlet->cone_axis, meshlet->cone_axis, sizeof(vec3));
+    gpu_meshlet->radius      = meshlet->radius;
+    gpu_meshlet->cone_cutoff = meshlet->cone_cutoff;
+    gpu_meshlet->first_index = meshlet->first_index;
+    gpu_meshlet->index_count = meshlet->index_count;
+  }
+  free(meshlets);
+  log_debug("Meshlet culling: %u triangles in %u meshlets\n", index_count / 3,
+            culling->meshlet_count);
+
+  // Buffers
+  culling->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Meshlet culling params buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(meshlet_culling_params_t),
+                  });
+  culling->meshlet_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "Meshlet buffer",
+      .usage = WGPUBufferUsage_Storage,
+      .size  = culling->meshlet_count * sizeof(meshlet_culling_meshlet_t),
+      .initial.data = gpu_meshlets,
+    });
+  culling->source_index_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label        = "Meshlet source index buffer",
+                    .usage        = WGPUBufferUsage_Storage,
+                    .size         = index_count * sizeof(uint32_t),
+                    .initial.data = indices,
+                  });
+  culling->index_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "Meshlet compacted index buffer",
+                    .usage = WGPUBufferUsage_Index | WGPUBufferUsage_Storage,
+                    .size  = index_count * sizeof(uint32_t),
+                  });
+  culling->args_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "Meshlet draw args buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage
+               | WGPUBufferUsage_Indirect,
+      .size = MESHLET_CULLING_DRAW_ARGS_COUNT * sizeof(uint32_t),
+    });
+  free(gpu_meshlets);
+  free(indices);
+
+  culling->dummy_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device, &(WGPUTextureDescriptor){
+                            .label         = "Meshlet culling dummy texture",
+                            .usage         = WGPUTextureUsage_TextureBinding,
+                            .dimension     = WGPUTextureDimension_2D,
+                            .size          = (WGPUExtent3D){1, 1, 1},
+                            .format        = WGPUTextureFormat_RG32Float,
+                            .mipLevelCount = 1,
+                            .sampleCount   = 1,
+                          });
+  ASSERT(culling->dummy_texture != NULL);
+  culling->dummy_view = wgpuTextureCreateView(culling->dummy_texture, NULL);
+  ASSERT(culling->dummy_view != NULL);
+
+  meshlet_culling_create_pipeline(culling);
+
+  return culling;
+}
+
+void wgpu_meshlet_culling_release(wgpu_meshlet_culling_t* culling)
+{
+  if (culling == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(ComputePipeline, culling->pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, culling->bind_group_layout)
+  WGPU_RELEASE_RESOURCE(TextureView, culling->dummy_view)
+  WGPU_RELEASE_RESOURCE(Texture, culling->dummy_texture)
+  wgpu_destroy_buffer(&culling->params_buffer);
+  wgpu_destroy_buffer(&culling->meshlet_buffer);
+  wgpu_destroy_buffer(&culling->source_index_buffer);
+  wgpu_destroy_buffer(&culling->index_buffer);
+  wgpu_destroy_buffer(&culling->args_buffer);
+  free(culling);
+}
+
+void wgpu_meshlet_culling_dispatch(
+  wgpu_meshlet_culling_t* culling, WGPUComputePassEncoder pass_encoder,
+  const wgpu_meshlet_culling_options_t* options)
+{
+  wgpu_context_t* wgpu_context  = culling->wgpu_context;
+  wgpu_depth_pyramid_t* pyramid = options->depth_pyramid;
+
+  meshlet_culling_params_t params = {
+    .meshlet_count = culling->meshlet_count,
+  };
+  glm_mat4_copy((vec4*)options->model, params.model);
+  glm_mat4_copy((vec4*)options->view_projection, params.view_projection);
+  glm_vec3_copy((float*)options->camera_position, params.camera_position);
+  params.scale = sqrtf(MAX(MAX(glm_vec3_norm2(params.model[0]),
+                               glm_vec3_norm2(params.model[1])),
+                           glm_vec3_norm2(params.model[2])));
+  if (pyramid != NULL) {
+    glm_mat4_copy((vec4*)options->previous_view_projection,
+                  params.occlusion_view_projection);
+    params.occlusion_culling = 1;
+  }
+  wgpu_queue_write_buffer_batched(wgpu_context, culling->params_buffer.buffer,
+                                  0, &params, sizeof(params));
+  // The visible meshlets append their indices to an empty draw
+  const uint32_t args[MESHLET_CULLING_DRAW_ARGS_COUNT] = {0, 1, 0, 0, 0};
+  wgpu_queue_write_buffer_batched(wgpu_context, culling->args_buffer.buffer, 0,
+                                  args, sizeof(args));
+
+  // The depth pyramid may be recreated with the swap chain, so the bind group
+  // is built for every dispatch
+  WGPUBindGroupEntry bg_entries[6] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = culling->params_buffer.buffer,
+      .size    = culling->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = culling->meshlet_buffer.buffer,
+      .size    = culling->meshlet_buffer.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = culling->source_index_buffer.buffer,
+      .size    = culling->source_index_buffer.size,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = culling->index_buffer.buffer,
+      .size    = culling->index_buffer.size,
+    },
+    [4] = (WGPUBindGroupEntry) {
+      .binding = 4,
+      .buffer  = culling->args_buffer.buffer,
+      .size    = culling->args_buffer.size,
+    },
+    [5] = (WGPUBindGroupEntry) {
+      .binding     = 5,
+      .textureView = pyramid != NULL ? wgpu_depth_pyramid_get_view(pyramid) :
+                                       culling->dummy_view,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "meshlet_culling_bind_group",
+                            .layout     = culling->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(bind_group != NULL);
+
+  // One workgroup per meshlet, in rows of at most 65535 workgroups
+  const uint32_t group_count_x
+    = MIN(culling->meshlet_count, MESHLET_CULLING_MAX_WORKGROUPS);
+  const uint32_t group_count_y
+    = (culling->meshlet_count + group_count_x - 1) / group_count_x;
+  wgpuComputePassEncoderSetPipeline(pass_encoder, culling->pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, group_count_x,
+                                           group_count_y, 1);
+  // The pass encoder keeps its own reference on the bind group
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+}
+
+void wgpu_meshlet_culling_draw(wgpu_meshlet_culling_t* culling,
+                               WGPURenderPassEncoder render_pass)
+{
+  wgpuRenderPassEncoderSetIndexBuffer(render_pass, culling->index_buffer.buffer,
+                                      WGPUIndexFormat_Uint32, 0,
+                                      culling->index_buffer.size);
+  wgpuRenderPassEncoderDrawIndexedIndirect(render_pass,
+                                           culling->args_buffer.buffer, 0);
+}
+
+uint32_t
+wgpu_meshlet_culling_get_meshlet_count(wgpu_meshlet_culling_t* culling)
+{
+  return culling->meshlet_count;
+}
+
+const wgpu_buffer_t*
+wgpu_meshlet_culling_get_index_buffer(wgpu_meshlet_culling_t* culling)
+{
+  return &culling->index_buffer;
+}
+
+const wgpu_buffer_t*
+wgpu_meshlet_culling_get_args_buffer(wgpu_meshlet_culling_t* culling)
+{
+  return &culling->args_buffer;
+}
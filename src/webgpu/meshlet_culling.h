@@ -0,0 +1,75 @@
+#ifndef MESHLET_CULLING_H
+#define MESHLET_CULLING_H
+
+#include <cglm/cglm.h>
+
+#include "buffer.h"
+#include "context.h"
+#include "depth_pyramid.h"
+
+typedef struct wgpu_meshlet_culling wgpu_meshlet_culling_t;
+
+/* Static indexed triangle list to cull by meshlet */
+typedef struct wgpu_meshlet_culling_desc_t {
+  const uint32_t* indices;
+  uint32_t index_count;
+  /* float3 positions, only read to build the meshlets */
+  const float* positions;
+  size_t position_stride;
+  uint32_t vertex_count;
+  /* Meshlet size limits, 0 selects MESH_MESHLET_MAX_TRIANGLES and
+   * MESH_MESHLET_MAX_VERTICES */
+  uint32_t max_triangles;
+  uint32_t max_vertices;
+} wgpu_meshlet_culling_desc_t;
+
+/*
+ * Culling of a large static mesh by meshlets on the GPU. The triangles are
+ * reordered for locality and split into meshlets of consecutive triangles at
+ * creation. One workgroup per meshlet tests its bounding sphere against the
+ * frustum, its normal cone against the camera position and, optionally, its
+ * box against the depth pyramid of the previous frame. The indices of the
+ * visible meshlets are copied to a compacted index buffer drawn with a single
+ * indirect draw.
+ */
+wgpu_meshlet_culling_t*
+wgpu_meshlet_culling_create(wgpu_context_t* wgpu_context,
+                            const wgpu_meshlet_culling_desc_t* desc);
+void wgpu_meshlet_culling_release(wgpu_meshlet_culling_t* culling);
+
+/**
+ * @brief Culling options, the model matrix transforms the positions to world
+ * space and view_projection from world to clip space. The cone test assumes a
+ * model matrix without shear.
+ */
+typedef struct wgpu_meshlet_culling_options_t {
+  mat4 model;
+  mat4 view_projection;
+  vec3 camera_position;
+  /* Optional occlusion culling against the depth of the previous frame, the
+   * pyramid has to be built from it and previous_view_projection is the
+   * matrix it was rendered with */
+  wgpu_depth_pyramid_t* depth_pyramid;
+  mat4 previous_view_projection;
+} wgpu_meshlet_culling_options_t;
+
+/* Records the culling, once per submit as the parameters are written to the
+ * queue */
+void wgpu_meshlet_culling_dispatch(
+  wgpu_meshlet_culling_t* culling, WGPUComputePassEncoder pass_encoder,
+  const wgpu_meshlet_culling_options_t* options);
+
+/* Draws the visible triangles with the vertex buffers and the pipeline set by
+ * the caller, the index buffer is set to the compacted one */
+void wgpu_meshlet_culling_draw(wgpu_meshlet_culling_t* culling,
+                               WGPURenderPassEncoder render_pass);
+
+uint32_t
+wgpu_meshlet_culling_get_meshlet_count(wgpu_meshlet_culling_t* culling);
+/* Compacted uint32 index buffer and its indexed indirect draw arguments */
+const wgpu_buffer_t*
+wgpu_meshlet_culling_get_index_buffer(wgpu_meshlet_culling_t* culling);
+const wgpu_buffer_t*
+wgpu_meshlet_culling_get_args_buffer(wgpu_meshlet_culling_t* culling);
+
+#endif
@@ -0,0 +1,273 @@
+#include "occlusion_query_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "readback.h"
+
+/* Query range of a frame in flight and the objects queried into it */
+typedef struct wgpu_occlusion_query_range_t {
+  uint64_t frame;
+  uint32_t query_count;
+  uint32_t* objects;
+} wgpu_occlusion_query_range_t;
+
+struct wgpu_occlusion_query_pool {
+  wgpu_context_t* wgpu_context;
+  uint32_t object_count;
+  uint32_t queries_per_frame;
+  WGPUQuerySet query_set;
+  WGPUBuffer resolve_buffer;
+  wgpu_buffer_readback_t* readback;
+  /* One range of queries_per_frame queries per frame that may be in flight */
+  uint32_t range_count;
+  wgpu_occlusion_query_range_t* ranges;
+  uint32_t* range_objects;
+  /* Per object: last result, frame of the result and frame of the last
+   * query */
+  uint64_t* samples;
+  uint64_t* result_frames;
+  uint64_t* query_frames;
+  /* Current frame */
+  uint64_t frame;
+  wgpu_occlusion_query_range_t* range;
+  uint32_t window_begin;
+  uint32_t next_window_begin;
+};
+
+static void wgpu_occlusion_query_pool_results_read(const void* data,
+                                                   uint64_t size,
+                                                   uint64_t frame_number,
+                                                   void* user_data)
+{
+  wgpu_occlusion_query_pool_t* pool = (wgpu_occlusion_query_pool_t*)user_data;
+
+  /* The range was taken over by a later frame while the readback was
+   * pending, the objects of the results are unknown */
+  const wgpu_occlusion_query_range_t* range
+    = &pool->ranges[frame_number % pool->range_count];
+  if (range->frame != frame_number) {
+    return;
+  }
+
+  const uint32_t query_count = (uint32_t)(size / sizeof(uint64_t));
+  ASSERT(query_count == range->query_count);
+  const uint8_t* results = (const uint8_t*)data;
+  for (uint32_t i = 0; i < query_count; ++i) {
+    const uint32_t object = range->objects[i];
+    memcpy(&pool->samples[object], &results[i * sizeof(uint64_t)],
+           sizeof(uint64_t));
+    pool->result_frames[object] = frame_number;
+  }
+}
+
+wgpu_occlusion_query_pool_t*
+wgpu_occlusion_query_pool_create(wgpu_context_t* wgpu_context,
+                                 const wgpu_occlusion_query_pool_desc_t* desc)
+{
+  ASSERT(desc->object_count > 0);
+
+  wgpu_occlusion_query_pool_t* pool
+    = (wgpu_occlusion_query_pool_t*)malloc(sizeof(wgpu_occlusion_query_pool_t));
+  memset(pool, 0, sizeof(wgpu_occlusion_query_pool_t));
+  pool->wgpu_context = wgpu_context;
+  pool->object_count = desc->object_count;
+
+  /* A range per readback buffer and per frame of map delay, plus the frame
+   * being recorded */
+  const uint32_t buffer_count
+    = desc->buffer_count > 0 ? desc->buffer_count : 3u;
+  pool->range_count = buffer_count + desc->map_delay + 1;
+  ASSERT(pool->range_count <= WGPU_OCCLUSION_QUERY_POOL_MAX_QUERY_COUNT);
+
+  /* The ranges of all frames in flight share the one query set */
+  pool->queries_per_frame = desc->queries_per_frame > 0 ?
+                              desc->queries_per_frame :
+                              pool->object_count;
+  pool->queries_per_frame
+    = MIN(MIN(pool->queries_per_frame, pool->object_count),
+          WGPU_OCCLUSION_QUERY_POOL_MAX_QUERY_COUNT / pool->range_count);
+
+  pool->query_set = wgpuDeviceCreateQuerySet(
+    wgpu_context->device,
+    &(WGPUQuerySetDescriptor){
+      .label = "occlusion-query-pool-query-set",
+      .type  = WGPUQueryType_Occlusion,
+      .count = pool->range_count * pool->queries_per_frame,
+    });
+  ASSERT(pool->query_set != NULL);
+
+  pool->resolve_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "occlusion-query-pool-resolve-buffer",
+      .usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc,
+      .size  = pool->queries_per_frame * sizeof(uint64_t),
+    });
+  ASSERT(pool->resolve_buffer != NULL);
+
+  pool->readback = wgpu_buffer_readback_create(
+    wgpu_context, &(wgpu_buffer_readback_desc_t){
+                    .size         = pool->queries_per_frame * sizeof(uint64_t),
+                    .buffer_count = buffer_count,
+                    .map_delay    = desc->map_delay,
+                    .func         = wgpu_occlusion_query_pool_results_read,
+                    .user_data    = pool,
+                  });
+
+  pool->ranges = (wgpu_occlusion_query_range_t*)calloc(
+    pool->range_count, sizeof(wgpu_occlusion_query_range_t));
+  pool->range_objects = (uint32_t*)malloc(
+    pool->range_count * pool->queries_per_frame * sizeof(uint32_t));
+  for (uint32_t i = 0; i < pool->range_count; ++i) {
+    pool->ranges[i].frame   = WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME;
+    pool->ranges[i].objects = &pool->range_objects[i * pool->queries_per_frame];
+  }
+
+  const size_t frames_size = pool->object_count * sizeof(uint64_t);
+  pool->samples       = (uint64_t*)calloc(pool->object_count, sizeof(uint64_t));
+  pool->result_frames = (uint64_t*)malloc(frames_size);
+  pool->query_frames  = (uint64_t*)malloc(frames_size);
+  for (uint32_t i = 0; i < pool->object_count; ++i) {
+    pool->result_frames[i] = WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME;
+    pool->query_frames[i]  = WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME;
+  }
+
+  return pool;
+}
+
+void wgpu_occlusion_query_pool_release(wgpu_occlusion_query_pool_t* pool)
+{
+  if (pool == NULL) {
+    return;
+  }
+
+  /* Delivers the pending results, before the ranges are freed */
+  wgpu_buffer_readback_release(pool->readback);
+  WGPU_RELEASE_RESOURCE(Buffer, pool->resolve_buffer)
+  WGPU_RELEASE_RESOURCE(QuerySet, pool->query_set)
+
+  free(pool->ranges);
+  free(pool->range_objects);
+  free(pool->samples);
+  free(pool->result_frames);
+  free(pool->query_frames);
+  free(pool);
+}
+
+WGPUQuerySet
+wgpu_occlusion_query_pool_get_query_set(wgpu_occlusion_query_pool_t* pool)
+{
+  return pool->query_set;
+}
+
+void wgpu_occlusion_query_pool_begin_frame(wgpu_occlusion_query_pool_t* pool)
+{
+  ++pool->frame;
+  pool->range              = &pool->ranges[pool->frame % pool->range_count];
+  pool->range->frame       = pool->frame;
+  pool->range->query_count = 0;
+
+  pool->window_begin = pool->next_window_begin;
+  pool->next_window_begin
+    = (pool->window_begin + pool->queries_per_frame) % pool->object_count;
+}
+
+bool wgpu_occlusion_query_pool_is_queried(wgpu_occlusion_query_pool_t* pool,
+                                          uint32_t object)
+{
+  ASSERT(object < pool->object_count);
+  const uint32_t window_offset
+    = (object + pool->object_count - pool->window_begin) % pool->object_count;
+  return window_offset < pool->queries_per_frame;
+}
+
+bool wgpu_occlusion_query_pool_begin_query(wgpu_occlusion_query_pool_t* pool,
+                                           WGPURenderPassEncoder rpass_enc,
+                                           uint32_t object)
+{
+  ASSERT(pool->range != NULL);
+  if (!wgpu_occlusion_query_pool_is_queried(pool, object)
+      || pool->query_frames[object] == pool->frame) {
+    return false;
+  }
+
+  wgpu_occlusion_query_range_t* range = pool->range;
+  const uint32_t range_index = (uint32_t)(range - pool->ranges);
+  const uint32_t query
+    = range_index * pool->queries_per_frame + range->query_count;
+  range->objects[range->query_count++] = object;
+  pool->query_frames[object]           = pool->frame;
+
+  wgpuRenderPassEncoderBeginOcclusionQuery(rpass_enc, query);
+
+  return true;
+}
+
+void wgpu_occlusion_query_pool_end_query(wgpu_occlusion_query_pool_t* pool,
+                                         WGPURenderPassEncoder rpass_enc)
+{
+  UNUSED_VAR(pool);
+  wgpuRenderPassEncoderEndOcclusionQuery(rpass_enc);
+}
+
+void wgpu_occlusion_query_pool_resolve(wgpu_occlusion_query_pool_t* pool,
+                                       WGPUCommandEncoder cmd_enc)
+{
+  const wgpu_occlusion_query_range_t* range = pool->range;
+  if (range == NULL || range->query_count == 0) {
+    return;
+  }
+
+  const uint32_t range_index = (uint32_t)(range - pool->ranges);
+  wgpuCommandEncoderResolveQuerySet(
+    cmd_enc, pool->query_set, range_index * pool->queries_per_frame,
+    range->query_count, pool->resolve_buffer, 0);
+
+  /* The results of the frame are skipped when all buffers are in use */
+  wgpu_buffer_readback_copy_buffer(pool->readback, cmd_enc,
+                                   pool->resolve_buffer, 0,
+                                   range->query_count * sizeof(uint64_t),
+                                   pool->frame);
+}
+
+void wgpu_occlusion_query_pool_update(wgpu_occlusion_query_pool_t* pool)
+{
+  wgpu_buffer_readback_update(pool->readback);
+}
+
+bool wgpu_occlusion_query_pool_is_visible(wgpu_occlusion_query_pool_t* pool,
+                                          uint32_t object)
+{
+  ASSERT(object < pool->object_count);
+  return pool->result_frames[object] == WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME
+         || pool->samples[object] > 0;
+}
+
+uint64_t
+wgpu_occlusion_query_pool_get_samples(wgpu_occlusion_query_pool_t* pool,
+                                      uint32_t object)
+{
+  ASSERT(object < pool->object_count);
+  return pool->samples[object];
+}
+
+uint64_t
+wgpu_occlusion_query_pool_get_result_frame(wgpu_occlusion_query_pool_t* pool,
+                                           uint32_t object)
+{
+  ASSERT(object < pool->object_count);
+  return pool->result_frames[object];
+}
+
+uint64_t wgpu_occlusion_query_pool_get_frame(wgpu_occlusion_query_pool_t* pool)
+{
+  return pool->frame;
+}
+
+uint32_t
+wgpu_occlusion_query_pool_get_dropped_count(wgpu_occlusion_query_pool_t* pool)
+{
+  return wgpu_buffer_readback_get_dropped_count(pool->readback);
+}
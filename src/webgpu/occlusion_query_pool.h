@@ -0,0 +1,98 @@
+#ifndef OCCLUSION_QUERY_POOL_H
+#define OCCLUSION_QUERY_POOL_H
+
+#include "context.h"
+
+/* Queries of the single query set of a pool, the WebGPU limit */
+#define WGPU_OCCLUSION_QUERY_POOL_MAX_QUERY_COUNT 4096u
+#define WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME (~0ull)
+
+/*
+ * Occlusion queries of many objects with temporal reuse. Only a rotating
+ * window of queries_per_frame objects is re-queried per frame, the others keep
+ * the last known result. The queries are allocated once in one large query
+ * set, every frame in flight queries into its own range of it. The results are
+ * resolved into a buffer and read back asynchronously a few frames later, the
+ * CPU never waits for the GPU and the query count does not grow with the
+ * object count.
+ *
+ * Objects without a result yet are reported visible, so that they get drawn
+ * and queried. Results of frames whose readback was dropped are skipped.
+ */
+typedef struct wgpu_occlusion_query_pool wgpu_occlusion_query_pool_t;
+
+typedef struct wgpu_occlusion_query_pool_desc_t {
+  uint32_t object_count;
+  /* Objects re-queried per frame, 0 selects all objects. Clamped to the
+   * queries of the query set divided among the frames in flight */
+  uint32_t queries_per_frame;
+  /* Number of readback buffers, 0 selects 3 */
+  uint32_t buffer_count;
+  /* Frames between resolving the queries and mapping their readback buffer */
+  uint32_t map_delay;
+} wgpu_occlusion_query_pool_desc_t;
+
+wgpu_occlusion_query_pool_t*
+wgpu_occlusion_query_pool_create(wgpu_context_t* wgpu_context,
+                                 const wgpu_occlusion_query_pool_desc_t* desc);
+void wgpu_occlusion_query_pool_release(wgpu_occlusion_query_pool_t* pool);
+
+/* Query set of the pool, the render pass recording the queries must begin
+ * with it as its occlusionQuerySet */
+WGPUQuerySet
+wgpu_occlusion_query_pool_get_query_set(wgpu_occlusion_query_pool_t* pool);
+
+/* Moves the window of re-queried objects and the query range on, to be
+ * called before the queries of a frame are recorded */
+void wgpu_occlusion_query_pool_begin_frame(wgpu_occlusion_query_pool_t* pool);
+
+/* Whether the object is re-queried in the current frame */
+bool wgpu_occlusion_query_pool_is_queried(wgpu_occlusion_query_pool_t* pool,
+                                          uint32_t object);
+
+/**
+ * @brief Begins the occlusion query of the object when it is re-queried in
+ * the current frame. Returns false without recording anything otherwise, the
+ * query is only ended with wgpu_occlusion_query_pool_end_query() when true
+ * was returned. Every object is queried at most once per frame.
+ */
+bool wgpu_occlusion_query_pool_begin_query(wgpu_occlusion_query_pool_t* pool,
+                                           WGPURenderPassEncoder rpass_enc,
+                                           uint32_t object);
+void wgpu_occlusion_query_pool_end_query(wgpu_occlusion_query_pool_t* pool,
+                                         WGPURenderPassEncoder rpass_enc);
+
+/* Resolves the queries of the frame and copies them into the next readback
+ * buffer, to be recorded after the render pass with the queries */
+void wgpu_occlusion_query_pool_resolve(wgpu_occlusion_query_pool_t* pool,
+                                       WGPUCommandEncoder cmd_enc);
+
+/* Applies the read back results, to be called once per frame after the
+ * command buffers with the resolve have been submitted */
+void wgpu_occlusion_query_pool_update(wgpu_occlusion_query_pool_t* pool);
+
+/* Last known visibility of the object, true when it has no result yet */
+bool wgpu_occlusion_query_pool_is_visible(wgpu_occlusion_query_pool_t* pool,
+                                          uint32_t object);
+
+/* Passed samples of the last result of the object, 0 when it has none */
+uint64_t
+wgpu_occlusion_query_pool_get_samples(wgpu_occlusion_query_pool_t* pool,
+                                      uint32_t object);
+
+/* Frame of the last result of the object,
+ * WGPU_OCCLUSION_QUERY_POOL_INVALID_FRAME when it has none */
+uint64_t
+wgpu_occlusion_query_pool_get_result_frame(wgpu_occlusion_query_pool_t* pool,
+                                           uint32_t object);
+
+/* Index of the current frame, counted by begin_frame */
+uint64_t
+wgpu_occlusion_query_pool_get_frame(wgpu_occlusion_query_pool_t* pool);
+
+/* Number of frames whose results were dropped because all readback buffers
+ * were in use */
+uint32_t
+wgpu_occlusion_query_pool_get_dropped_count(wgpu_occlusion_query_pool_t* pool);
+
+#endif
@@ -0,0 +1,161 @@
+#include "offscreen_swap_chain.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "readback.h"
+
+typedef struct wgpu_offscreen_image_t {
+  WGPUTexture texture;
+} wgpu_offscreen_image_t;
+
+struct wgpu_offscreen_swap_chain_t {
+  wgpu_context_t* wgpu_context;
+  WGPUTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t image_count;
+  uint32_t image_index;
+  wgpu_offscreen_image_t images[WGPU_OFFSCREEN_SWAP_CHAIN_MAX_IMAGE_COUNT];
+  uint64_t frame_number;
+  char output_directory[PATH_SIZE];
+  uint32_t output_interval;
+  wgpu_readback_t* readback;
+};
+
+static void
+wgpu_offscreen_swap_chain_create_images(wgpu_offscreen_swap_chain_t* sc)
+{
+  for (uint32_t i = 0; i < sc->image_count; ++i) {
+    wgpu_offscreen_image_t* image = &sc->images[i];
+    image->texture                = wgpuDeviceCreateTexture(
+      sc->wgpu_context->device,
+      &(WGPUTextureDescriptor){
+        .label = "offscreen_swap_chain_image",
+        .usage = WGPUTextureUsage_RenderAttachment
+                 | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopySrc,
+        .dimension     = WGPUTextureDimension_2D,
+        .size          = (WGPUExtent3D){
+          .width              = sc->width,
+          .height             = sc->height,
+          .depthOrArrayLayers = 1,
+        },
+        .format        = sc->format,
+        .mipLevelCount = 1,
+        .sampleCount   = 1,
+      });
+    ASSERT(image->texture != NULL);
+  }
+  if (sc->output_directory[0] != '\0') {
+    /* One readback buffer more than images, so that mapping a frame after the
+     * next one has been presented does not drop frames */
+    sc->readback = wgpu_readback_create(
+      sc->wgpu_context, &(wgpu_readback_desc_t){
+                          .width            = sc->width,
+                          .height           = sc->height,
+                          .format           = sc->format,
+                          .buffer_count     = sc->image_count + 1,
+                          .map_delay        = 1,
+                          .file_format      = ReadbackFileFormat_Png,
+                          .output_directory = sc->output_directory,
+                          .file_prefix      = "frame",
+                        });
+  }
+}
+
+static void
+wgpu_offscreen_swap_chain_release_images(wgpu_offscreen_swap_chain_t* sc)
+{
+  if (sc->readback != NULL) {
+    wgpu_readback_release(sc->readback);
+    sc->readback = NULL;
+  }
+  for (uint32_t i = 0; i < sc->image_count; ++i) {
+    WGPU_RELEASE_RESOURCE(Texture, sc->images[i].texture)
+  }
+}
+
+void wgpu_setup_offscreen_swap_chain(
+  wgpu_context_t* wgpu_context, const wgpu_offscreen_swap_chain_desc_t* desc)
+{
+  ASSERT(wgpu_context->offscreen_swap_chain == NULL);
+  ASSERT(desc->width > 0 && desc->height > 0);
+
+  wgpu_offscreen_swap_chain_t* sc = (wgpu_offscreen_swap_chain_t*)malloc(
+    sizeof(wgpu_offscreen_swap_chain_t));
+  memset(sc, 0, sizeof(wgpu_offscreen_swap_chain_t));
+  sc->wgpu_context = wgpu_context;
+  sc->format       = WGPUTextureFormat_BGRA8Unorm;
+  sc->width        = desc->width;
+  sc->height       = desc->height;
+  sc->image_count  = desc->image_count > 0 ? desc->image_count :
+                                             wgpu_context->frames.count;
+  sc->image_count
+    = CLAMP(sc->image_count, 1u, WGPU_OFFSCREEN_SWAP_CHAIN_MAX_IMAGE_COUNT);
+  if (desc->output_directory != NULL) {
+    snprintf(sc->output_directory, sizeof(sc->output_directory), "%s",
+             desc->output_directory);
+  }
+  sc->output_interval = MAX(desc->output_interval, 1u);
+  wgpu_offscreen_swap_chain_create_images(sc);
+
+  wgpu_context->offscreen_swap_chain = sc;
+  wgpu_context->surface.width        = sc->width;
+  wgpu_context->surface.height       = sc->height;
+  wgpu_context->swap_chain.format    = sc->format;
+}
+
+void wgpu_offscreen_swap_chain_release(wgpu_offscreen_swap_chain_t* sc)
+{
+  wgpu_offscreen_swap_chain_release_images(sc);
+  free(sc);
+}
+
+void wgpu_offscreen_swap_chain_resize(wgpu_offscreen_swap_chain_t* sc,
+                                      uint32_t width, uint32_t height)
+{
+  if (sc->width == width && sc->height == height) {
+    return;
+  }
+  wgpu_offscreen_swap_chain_release_images(sc);
+  sc->width  = width;
+  sc->height = height;
+  wgpu_offscreen_swap_chain_create_images(sc);
+}
+
+WGPUTextureView
+wgpu_offscreen_swap_chain_get_current_image(wgpu_offscreen_swap_chain_t* sc)
+{
+  return wgpuTextureCreateView(sc->images[sc->image_index].texture, NULL);
+}
+
+void wgpu_offscreen_swap_chain_present(wgpu_offscreen_swap_chain_t* sc)
+{
+  if (sc->readback != NULL) {
+    if ((sc->frame_number % sc->output_interval) == 0) {
+      wgpu_context_t* wgpu_context = sc->wgpu_context;
+      WGPUCommandEncoder cmd_enc
+        = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+      wgpu_readback_copy_texture(sc->readback, cmd_enc,
+                                 sc->images[sc->image_index].texture,
+                                 sc->frame_number);
+      WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+      WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+      wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+      WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+    }
+    wgpu_readback_update(sc->readback);
+  }
+
+  ++sc->frame_number;
+  sc->image_index = (sc->image_index + 1) % sc->image_count;
+}
+
+void wgpu_offscreen_swap_chain_flush(wgpu_offscreen_swap_chain_t* sc)
+{
+  if (sc->readback != NULL) {
+    wgpu_readback_flush(sc->readback);
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef OFFSCREEN_SWAP_CHAIN_H
+#define OFFSCREEN_SWAP_CHAIN_H
+
+#include "context.h"
+
+#define WGPU_OFFSCREEN_SWAP_CHAIN_MAX_IMAGE_COUNT WGPU_MAX_FRAMES_IN_FLIGHT
+
+/*
+ * Swap chain replacement for headless rendering: frames are rendered into a
+ * pool of offscreen textures instead of window surface images, so that the
+ * examples run unchanged without a window and at any resolution the device
+ * supports. Presented images can be read back asynchronously and written to
+ * PNG files from the job system.
+ */
+typedef struct wgpu_offscreen_swap_chain_t wgpu_offscreen_swap_chain_t;
+
+typedef struct wgpu_offscreen_swap_chain_desc_t {
+  uint32_t width;
+  uint32_t height;
+  /* 0 selects the number of frames in flight */
+  uint32_t image_count;
+  /* Optional, presented images are written to
+   * <output_directory>/frame_<number>.png */
+  const char* output_directory;
+  /* Every n-th presented image is written, 0 selects 1 */
+  uint32_t output_interval;
+} wgpu_offscreen_swap_chain_desc_t;
+
+/**
+ * @brief Sets the surface size and replaces the swap chain of the context,
+ * wgpu_swap_chain_get_current_image and wgpu_swap_chain_present use the
+ * offscreen images from then on. The offscreen swap chain is owned by the
+ * context.
+ */
+void wgpu_setup_offscreen_swap_chain(
+  wgpu_context_t* wgpu_context, const wgpu_offscreen_swap_chain_desc_t* desc);
+
+void wgpu_offscreen_swap_chain_release(
+  wgpu_offscreen_swap_chain_t* offscreen_swap_chain);
+
+/* Recreates the images with the given size, e.g. on wgpu_resize_surface */
+void wgpu_offscreen_swap_chain_resize(
+  wgpu_offscreen_swap_chain_t* offscreen_swap_chain, uint32_t width,
+  uint32_t height);
+
+/* Returns a new view of the current image, released by the caller */
+WGPUTextureView wgpu_offscreen_swap_chain_get_current_image(
+  wgpu_offscreen_swap_chain_t* offscreen_swap_chain);
+
+/* Queues the readback of the current image, when requested, and advances to
+ * the next image */
+void wgpu_offscreen_swap_chain_present(
+  wgpu_offscreen_swap_chain_t* offscreen_swap_chain);
+
+/* Blocks until all queued readbacks have been written to disk */
+void wgpu_offscreen_swap_chain_flush(
+  wgpu_offscreen_swap_chain_t* offscreen_swap_chain);
+
+#endif
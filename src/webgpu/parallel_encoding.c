@@ -0,0 +1,72 @@
+#include "parallel_encoding.h"
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+typedef struct wgpu_encode_passes_data_t {
+  const wgpu_encode_pass_desc_t* passes;
+  WGPUCommandEncoder* encoders;
+  WGPUCommandBuffer* command_buffers;
+} wgpu_encode_passes_data_t;
+
+/* Encoders are only used by the thread that runs their pass */
+static void wgpu_encode_pass_range(void* user_data, uint32_t begin,
+                                   uint32_t end)
+{
+  wgpu_encode_passes_data_t* data = (wgpu_encode_passes_data_t*)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    data->passes[i].func(data->encoders[i], data->passes[i].user_data);
+    data->command_buffers[i] = wgpu_get_command_buffer(data->encoders[i]);
+  }
+}
+
+uint32_t wgpu_encode_passes(wgpu_context_t* wgpu_context,
+                            job_system_t* job_system,
+                            const wgpu_encode_pass_desc_t* passes,
+                            uint32_t pass_count)
+{
+  const uint32_t first = wgpu_context->submit_info.command_buffer_count;
+  ASSERT(first + pass_count <= MAX_COMMAND_BUFFER_COUNT);
+  if (pass_count == 0) {
+    return 0;
+  }
+
+  /* The encoders are created on the calling thread, the command buffers are
+   * written straight to their submission slots */
+  WGPUCommandEncoder encoders[MAX_COMMAND_BUFFER_COUNT];
+  for (uint32_t i = 0; i < pass_count; ++i) {
+    encoders[i] = wgpuDeviceCreateCommandEncoder(
+      wgpu_context->device, &(WGPUCommandEncoderDescriptor){
+                              .label = passes[i].label,
+                            });
+    ASSERT(encoders[i] != NULL);
+  }
+  wgpu_encode_passes_data_t data = {
+    .passes          = passes,
+    .encoders        = encoders,
+    .command_buffers = &wgpu_context->submit_info.command_buffers[first],
+  };
+
+  /* One pass per job, passes differ too much in cost to be batched */
+  if (job_system == NULL) {
+    job_system = job_system_get_shared();
+  }
+  job_system_parallel_for(job_system, pass_count, 1, wgpu_encode_pass_range,
+                          &data);
+
+  uint32_t command_buffer_count = first;
+  for (uint32_t i = 0; i < pass_count; ++i) {
+    WGPU_RELEASE_RESOURCE(CommandEncoder, encoders[i])
+    WGPUCommandBuffer command_buffer = data.command_buffers[i];
+    if (command_buffer == NULL) {
+      log_error("Encoding pass %s failed",
+                passes[i].label != NULL ? passes[i].label : "(unnamed)");
+      continue;
+    }
+    wgpu_context->submit_info.command_buffers[command_buffer_count++]
+      = command_buffer;
+  }
+  wgpu_context->submit_info.command_buffer_count = command_buffer_count;
+
+  return command_buffer_count - first;
+}
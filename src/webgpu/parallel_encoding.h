@@ -0,0 +1,36 @@
+#ifndef PARALLEL_ENCODING_H
+#define PARALLEL_ENCODING_H
+
+#include "../core/job_system.h"
+#include "context.h"
+
+/*
+ * Records a part of the frame, e.g. a shadow cascade, the G-buffer or the post
+ * processing chain, into the command encoder it is given. Encode functions run
+ * on worker threads: they may only record commands into their own encoder and
+ * must not create objects, write to the queue or use wgpu_context->cmd_enc and
+ * wgpu_context->rpass_enc.
+ */
+typedef void (*wgpu_encode_pass_func_t)(WGPUCommandEncoder cmd_enc,
+                                        void* user_data);
+
+typedef struct wgpu_encode_pass_desc_t {
+  const char* label;
+  wgpu_encode_pass_func_t func;
+  void* user_data;
+} wgpu_encode_pass_desc_t;
+
+/**
+ * @brief Encodes every pass into a command encoder of its own, the passes in
+ * parallel on the job system (the shared one when NULL), and appends the
+ * command buffers to wgpu_context->submit_info in the order of the passes,
+ * which is the order they are executed in on the queue. Passes depending on
+ * the results of others therefore come after them. Returns once all passes
+ * are encoded, with the number of command buffers appended.
+ */
+uint32_t wgpu_encode_passes(wgpu_context_t* wgpu_context,
+                            job_system_t* job_system,
+                            const wgpu_encode_pass_desc_t* passes,
+                            uint32_t pass_count);
+
+#endif
@@ -0,0 +1,578 @@
+#include "particles.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "gpu_sort.h"
+#include "shader.h"
+
+#define PARTICLES_WORKGROUP_SIZE 256u
+#define PARTICLES_STAGE_COUNT 3u
+
+/* Bindings of the system, the streams follow from PARTICLES_BINDING_COUNT */
+enum {
+  PARTICLES_BINDING_SYSTEM        = 0,
+  PARTICLES_BINDING_PARAMS        = 1,
+  PARTICLES_BINDING_ALIVE_FLAGS   = 2,
+  PARTICLES_BINDING_DEAD_FLAGS    = 3,
+  PARTICLES_BINDING_FREE_LIST     = 4,
+  PARTICLES_BINDING_FREE_COUNT    = 5,
+  PARTICLES_BINDING_LIVE_INDICES  = 6,
+  PARTICLES_BINDING_DRAW_INDIRECT = 7,
+  PARTICLES_BINDING_SORT_KEYS     = 8,
+  PARTICLES_BINDING_COUNT         = 9,
+};
+
+#define PARTICLES_BINDING_BIT(binding) (1u << (binding))
+
+/* Layout of ParticleSystem */
+typedef struct particles_system_t {
+  uint32_t particle_count;
+  uint32_t emit_count;
+  uint32_t seed;
+  float delta_time;
+} particles_system_t;
+
+/* Compute pipeline with the bindings it uses */
+typedef struct particles_stage_t {
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUPipelineLayout pipeline_layout;
+  WGPUComputePipeline pipeline;
+  WGPUBindGroup bind_group;
+} particles_stage_t;
+
+struct wgpu_particles {
+  wgpu_context_t* wgpu_context;
+  uint32_t capacity;
+  uint32_t stream_count;
+  uint32_t params_size;
+  bool sort;
+  /* Fraction of a particle carried over to the next update */
+  float emission_remainder;
+  particles_system_t system;
+  wgpu_buffer_t system_buffer;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t streams[WGPU_PARTICLES_MAX_STREAM_COUNT];
+  struct {
+    wgpu_buffer_t indices;       /* 0 to capacity - 1 */
+    wgpu_buffer_t alive_flags;   /* 1 for live slots */
+    wgpu_buffer_t dead_flags;    /* 1 for dead slots */
+    wgpu_buffer_t live_indices;  /* Compacted live slots, index buffer */
+    wgpu_buffer_t free_list;     /* Compacted dead slots */
+    wgpu_buffer_t free_count;    /* Number of dead slots */
+    wgpu_buffer_t draw_indirect; /* Indexed indirect draw, live count */
+    wgpu_buffer_t sort_keys;     /* Keys of the live indices */
+  } lists;
+  wgpu_gpu_sort_t* gpu_sort;
+  /* Emit, update and sort keys */
+  particles_stage_t stages[PARTICLES_STAGE_COUNT];
+};
+
+// clang-format off
+static const char* particles_system_wgsl = CODE(
+  struct ParticleSystem {
+    particleCount : u32,
+    emitCount : u32,
+    seed : u32,
+    deltaTime : f32,
+  };
+
+  @group(0) @binding(0) var<uniform> particleSystem : ParticleSystem;
+  @group(0) @binding(2) var<storage, read_write> aliveFlags : array<u32>;
+  @group(0) @binding(3) var<storage, read_write> deadFlags : array<u32>;
+  @group(0) @binding(4) var<storage, read> freeList : array<u32>;
+  @group(0) @binding(5) var<storage, read> freeCount : array<u32>;
+  @group(0) @binding(6) var<storage, read> liveIndices : array<u32>;
+  @group(0) @binding(7) var<storage, read> drawIndirect : array<u32>;
+  @group(0) @binding(8) var<storage, read_write> sortKeys : array<u32>;
+
+  fn particleHash(value : u32) -> u32 {
+    var x = value * 747796405u + 2891336453u;
+    x = ((x >> ((x >> 28u) + 4u)) ^ x) * 277803737u;
+    return (x >> 22u) ^ x;
+  }
+
+  fn particleRandom(value : u32) -> f32 {
+    return f32(particleHash(value)) / 4294967295.0;
+  }
+
+  // Revives the slots that died in the previous step
+  @compute @workgroup_size(256)
+  fn cs_emit(@builtin(global_invocation_id) id : vec3<u32>) {
+    let e = id.x;
+    if (e >= min(particleSystem.emitCount, freeCount[0])) {
+      return;
+    }
+    particleEmit(freeList[e], e);
+  }
+
+  @compute @workgroup_size(256)
+  fn cs_update(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= particleSystem.particleCount) {
+      return;
+    }
+    let alive = particleUpdate(index);
+    aliveFlags[index] = select(0u, 1u, alive);
+    deadFlags[index] = select(1u, 0u, alive);
+  }
+);
+
+/* Slots behind the live count get the largest key */
+static const char* particles_sort_keys_wgsl = CODE(
+  @compute @workgroup_size(256)
+  fn cs_sort_keys(@builtin(global_invocation_id) id : vec3<u32>) {
+    let i = id.x;
+    if (i >= particleSystem.particleCount) {
+      return;
+    }
+    var key = 0xffffffffu;
+    if (i < drawIndirect[0]) {
+      key = particleSortKey(liveIndices[i]);
+    }
+    sortKeys[i] = key;
+  }
+);
+// clang-format on
+
+static uint32_t particles_div_ceil(uint32_t value, uint32_t divisor)
+{
+  return (value + divisor - 1) / divisor;
+}
+
+/* Declarations of the streams and of the params, the system, the behavior of
+ * the caller and the entry points */
+static char* particles_build_wgsl(const wgpu_particles_desc_t* desc)
+{
+  size_t wgsl_size = strlen(particles_system_wgsl) + strlen(desc->update_wgsl)
+                     + strlen(particles_sort_keys_wgsl) + 128;
+  for (uint32_t i = 0; i < desc->stream_count; ++i) {
+    wgsl_size += strlen(desc->streams[i].name)
+                 + strlen(desc->streams[i].wgsl_type) + 128;
+  }
+
+  char* wgsl    = malloc(wgsl_size);
+  size_t length = 0;
+  for (uint32_t i = 0; i < desc->stream_count; ++i) {
+    length += snprintf(
+      wgsl + length, wgsl_size - length,
+      "@group(0) @binding(%u) var<storage, read_write> %s : array<%s>;\n",
+      PARTICLES_BINDING_COUNT + i, desc->streams[i].name,
+      desc->streams[i].wgsl_type);
+  }
+  if (desc->params_size > 0) {
+    length += snprintf(wgsl + length, wgsl_size - length,
+                       "@group(0) @binding(%u) var<uniform> params : Params;\n",
+                       PARTICLES_BINDING_PARAMS);
+  }
+  length += snprintf(wgsl + length, wgsl_size - length, "%s\n%s\n",
+                     particles_system_wgsl, desc->update_wgsl);
+  if (desc->sort) {
+    snprintf(wgsl + length, wgsl_size - length, "%s\n",
+             particles_sort_keys_wgsl);
+  }
+  return wgsl;
+}
+
+/* Pipeline of an entry point with the bindings of the mask and the streams */
+static void particles_create_stage(wgpu_particles_t* particles,
+                                   particles_stage_t* stage,
+                                   const wgpu_shader_t* shader,
+                                   const char* entry, uint32_t binding_mask)
+{
+  wgpu_context_t* wgpu_context = particles->wgpu_context;
+
+  const struct {
+    WGPUBufferBindingType type;
+    const wgpu_buffer_t* buffer;
+  } bindings[PARTICLES_BINDING_COUNT] = {
+    [PARTICLES_BINDING_SYSTEM]
+    = {WGPUBufferBindingType_Uniform, &particles->system_buffer},
+    [PARTICLES_BINDING_PARAMS]
+    = {WGPUBufferBindingType_Uniform, &particles->params_buffer},
+    [PARTICLES_BINDING_ALIVE_FLAGS]
+    = {WGPUBufferBindingType_Storage, &particles->lists.alive_flags},
+    [PARTICLES_BINDING_DEAD_FLAGS]
+    = {WGPUBufferBindingType_Storage, &particles->lists.dead_flags},
+    [PARTICLES_BINDING_FREE_LIST]
+    = {WGPUBufferBindingType_ReadOnlyStorage, &particles->lists.free_list},
+    [PARTICLES_BINDING_FREE_COUNT]
+    = {WGPUBufferBindingType_ReadOnlyStorage, &particles->lists.free_count},
+    [PARTICLES_BINDING_LIVE_INDICES]
+    = {WGPUBufferBindingType_ReadOnlyStorage, &particles->lists.live_indices},
+    [PARTICLES_BINDING_DRAW_INDIRECT]
+    = {WGPUBufferBindingType_ReadOnlyStorage, &particles->lists.draw_indirect},
+    [PARTICLES_BINDING_SORT_KEYS]
+    = {WGPUBufferBindingType_Storage, &particles->lists.sort_keys},
+  };
+  if (particles->params_size == 0) {
+    binding_mask &= ~PARTICLES_BINDING_BIT(PARTICLES_BINDING_PARAMS);
+  }
+
+  WGPUBindGroupLayoutEntry
+    bgl_entries[PARTICLES_BINDING_COUNT + WGPU_PARTICLES_MAX_STREAM_COUNT];
+  WGPUBindGroupEntry
+    bg_entries[PARTICLES_BINDING_COUNT + WGPU_PARTICLES_MAX_STREAM_COUNT];
+  uint32_t entry_count = 0;
+  for (uint32_t b = 0; b < PARTICLES_BINDING_COUNT + particles->stream_count;
+       ++b) {
+    WGPUBufferBindingType type = WGPUBufferBindingType_Storage;
+    const wgpu_buffer_t* buffer = NULL;
+    if (b < PARTICLES_BINDING_COUNT) {
+      if ((binding_mask & PARTICLES_BINDING_BIT(b)) == 0) {
+        continue;
+      }
+      type   = bindings[b].type;
+      buffer = bindings[b].buffer;
+    }
+    else {
+      buffer = &particles->streams[b - PARTICLES_BINDING_COUNT];
+    }
+    bgl_entries[entry_count] = (WGPUBindGroupLayoutEntry) {
+      .binding    = b,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type = type,
+      },
+      .sampler = {0},
+    };
+    bg_entries[entry_count] = (WGPUBindGroupEntry){
+      .binding = b,
+      .buffer  = buffer->buffer,
+      .size    = buffer->size,
+    };
+    ++entry_count;
+  }
+
+  stage->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "particles_bgl",
+                            .entryCount = entry_count,
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(stage->bind_group_layout != NULL);
+  stage->pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "particles_pipeline_layout",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts     = &stage->bind_group_layout,
+                          });
+  ASSERT(stage->pipeline_layout != NULL);
+
+  WGPUProgrammableStageDescriptor stage_desc
+    = shader->programmable_stage_descriptor;
+  stage_desc.entryPoint = entry;
+  stage->pipeline       = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = "particles_pipeline",
+                            .layout  = stage->pipeline_layout,
+                            .compute = stage_desc,
+                          });
+  ASSERT(stage->pipeline != NULL);
+
+  stage->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "particles_bind_group",
+                            .layout     = stage->bind_group_layout,
+                            .entryCount = entry_count,
+                            .entries    = bg_entries,
+                          });
+  ASSERT(stage->bind_group != NULL);
+}
+
+static void particles_fill_indices(void* user_data, void* mapping,
+                                   uint32_t begin, uint32_t end)
+{
+  uint32_t* indices = (uint32_t*)mapping;
+  for (uint32_t i = begin; i < end; ++i) {
+    indices[i] = i;
+  }
+}
+
+static void particles_create_buffers(wgpu_particles_t* particles,
+                                     const wgpu_particles_desc_t* desc)
+{
+  wgpu_context_t* wgpu_context = particles->wgpu_context;
+
+  particles->system_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_system_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(particles_system_t),
+                  });
+  if (desc->params_size > 0) {
+    particles->params_buffer = wgpu_create_buffer(
+      wgpu_context,
+      &(wgpu_buffer_desc_t){
+        .label = "particles_params_buffer",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+        .size  = desc->params_size,
+      });
+  }
+
+  for (uint32_t i = 0; i < desc->stream_count; ++i) {
+    const wgpu_particles_stream_desc_t* stream = &desc->streams[i];
+    const wgpu_buffer_desc_t stream_desc = {
+      .label = stream->name,
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc
+               | WGPUBufferUsage_Vertex | WGPUBufferUsage_Storage,
+      .size         = desc->capacity * stream->element_size,
+      .count        = desc->capacity,
+      .initial.data = stream->initial_data,
+    };
+    particles->streams[i]
+      = stream->fill.func ?
+          wgpu_create_buffer_with_fill(wgpu_context, &stream_desc,
+                                       &stream->fill) :
+          wgpu_create_buffer(wgpu_context, &stream_desc);
+  }
+
+  const uint32_t list_size = desc->capacity * sizeof(uint32_t);
+  particles->lists.indices = wgpu_create_buffer_with_fill(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "particles_indices_buffer",
+      .usage = WGPUBufferUsage_Storage,
+      .size  = list_size,
+      .count = desc->capacity,
+    },
+    &(wgpu_buffer_fill_desc_t){
+      .func     = particles_fill_indices,
+      .parallel = true,
+    });
+  particles->lists.alive_flags = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_alive_flags_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = list_size,
+                  });
+  particles->lists.dead_flags = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_dead_flags_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = list_size,
+                  });
+  particles->lists.live_indices = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_live_indices_buffer",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Index
+                             | WGPUBufferUsage_CopySrc,
+                    .size  = list_size,
+                  });
+  particles->lists.free_list = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_free_list_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = list_size,
+                  });
+  particles->lists.free_count = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_free_count_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = sizeof(uint32_t),
+                  });
+  particles->lists.sort_keys = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "particles_sort_keys_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = desc->sort ? list_size : sizeof(uint32_t),
+                  });
+
+  // Index count, instance count, first index, base vertex, first instance,
+  // the compaction writes the index count
+  const uint32_t draw_indirect[5] = {0, 1, 0, 0, 0};
+  particles->lists.draw_indirect  = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                     .label = "particles_draw_indirect_buffer",
+                     .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect
+                              | WGPUBufferUsage_CopySrc,
+                     .size         = sizeof(draw_indirect),
+                     .initial.data = draw_indirect,
+                   });
+}
+
+wgpu_particles_t* wgpu_particles_create(wgpu_context_t* wgpu_context,
+                                        const wgpu_particles_desc_t* desc)
+{
+  ASSERT(desc->capacity > 0 && desc->update_wgsl != NULL);
+  ASSERT(desc->stream_count <= WGPU_PARTICLES_MAX_STREAM_COUNT);
+
+  wgpu_particles_t* particles
+    = (wgpu_particles_t*)malloc(sizeof(wgpu_particles_t));
+  memset(particles, 0, sizeof(wgpu_particles_t));
+  particles->wgpu_context          = wgpu_context;
+  particles->capacity              = desc->capacity;
+  particles->stream_count          = desc->stream_count;
+  particles->params_size           = desc->params_size;
+  particles->sort                  = desc->sort;
+  particles->system.particle_count = desc->capacity;
+
+  particles_create_buffers(particles, desc);
+  // Compacts the live and the dead slots, sorts the live ones
+  particles->gpu_sort = wgpu_gpu_sort_create(
+    wgpu_context, &(wgpu_gpu_sort_desc_t){
+                    .max_element_count = desc->capacity,
+                  });
+
+  char* wgsl                = particles_build_wgsl(desc);
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "particles_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = "cs_update",
+                  });
+  const uint32_t system_bits
+    = PARTICLES_BINDING_BIT(PARTICLES_BINDING_SYSTEM)
+      | PARTICLES_BINDING_BIT(PARTICLES_BINDING_PARAMS);
+  particles_create_stage(
+    particles, &particles->stages[0], &comp_shader, "cs_emit",
+    system_bits | PARTICLES_BINDING_BIT(PARTICLES_BINDING_FREE_LIST)
+      | PARTICLES_BINDING_BIT(PARTICLES_BINDING_FREE_COUNT));
+  particles_create_stage(
+    particles, &particles->stages[1], &comp_shader, "cs_update",
+    system_bits | PARTICLES_BINDING_BIT(PARTICLES_BINDING_ALIVE_FLAGS)
+      | PARTICLES_BINDING_BIT(PARTICLES_BINDING_DEAD_FLAGS));
+  if (desc->sort) {
+    particles_create_stage(
+      particles, &particles->stages[2], &comp_shader, "cs_sort_keys",
+      system_bits | PARTICLES_BINDING_BIT(PARTICLES_BINDING_LIVE_INDICES)
+        | PARTICLES_BINDING_BIT(PARTICLES_BINDING_DRAW_INDIRECT)
+        | PARTICLES_BINDING_BIT(PARTICLES_BINDING_SORT_KEYS));
+  }
+  wgpu_shader_release(&comp_shader);
+  free(wgsl);
+
+  wgpu_particles_update(particles, 0.0f, 0.0f);
+
+  return particles;
+}
+
+void wgpu_particles_release(wgpu_particles_t* particles)
+{
+  if (particles == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < PARTICLES_STAGE_COUNT; ++i) {
+    particles_stage_t* stage = &particles->stages[i];
+    WGPU_RELEASE_RESOURCE(BindGroup, stage->bind_group)
+    WGPU_RELEASE_RESOURCE(ComputePipeline, stage->pipeline)
+    WGPU_RELEASE_RESOURCE(PipelineLayout, stage->pipeline_layout)
+    WGPU_RELEASE_RESOURCE(BindGroupLayout, stage->bind_group_layout)
+  }
+  wgpu_gpu_sort_release(particles->gpu_sort);
+  wgpu_destroy_buffer(&particles->lists.indices);
+  wgpu_destroy_buffer(&particles->lists.alive_flags);
+  wgpu_destroy_buffer(&particles->lists.dead_flags);
+  wgpu_destroy_buffer(&particles->lists.live_indices);
+  wgpu_destroy_buffer(&particles->lists.free_list);
+  wgpu_destroy_buffer(&particles->lists.free_count);
+  wgpu_destroy_buffer(&particles->lists.draw_indirect);
+  wgpu_destroy_buffer(&particles->lists.sort_keys);
+  for (uint32_t i = 0; i < particles->stream_count; ++i) {
+    wgpu_destroy_buffer(&particles->streams[i]);
+  }
+  if (particles->params_buffer.buffer != NULL) {
+    wgpu_destroy_buffer(&particles->params_buffer);
+  }
+  wgpu_destroy_buffer(&particles->system_buffer);
+  free(particles);
+}
+
+void wgpu_particles_update(wgpu_particles_t* particles, float delta_time,
+                           float emission_rate)
+{
+  const float emitted
+    = emission_rate * delta_time + particles->emission_remainder;
+  particles->system.emit_count = (uint32_t)emitted;
+  particles->emission_remainder
+    = emitted - (float)particles->system.emit_count;
+  particles->system.seed       = (uint32_t)rand();
+  particles->system.delta_time = delta_time;
+
+  wgpuQueueWriteBuffer(particles->wgpu_context->queue,
+                       particles->system_buffer.buffer, 0, &particles->system,
+                       sizeof(particles_system_t));
+}
+
+void wgpu_particles_set_params(wgpu_particles_t* particles, const void* data)
+{
+  ASSERT(particles->params_size > 0);
+
+  wgpuQueueWriteBuffer(particles->wgpu_context->queue,
+                       particles->params_buffer.buffer, 0, data,
+                       particles->params_size);
+}
+
+static void particles_dispatch(WGPUComputePassEncoder pass_encoder,
+                               const particles_stage_t* stage,
+                               uint32_t invocation_count)
+{
+  wgpuComputePassEncoderSetPipeline(pass_encoder, stage->pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, stage->bind_group, 0,
+                                     NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder,
+    particles_div_ceil(invocation_count, PARTICLES_WORKGROUP_SIZE), 1, 1);
+}
+
+void wgpu_particles_record_step(wgpu_particles_t* particles,
+                                WGPUComputePassEncoder pass_encoder)
+{
+  // Emit into the free list of the previous step
+  if (particles->system.emit_count > 0) {
+    particles_dispatch(pass_encoder, &particles->stages[0],
+                       particles->system.emit_count);
+  }
+  particles_dispatch(pass_encoder, &particles->stages[1], particles->capacity);
+  // Live slots into the index buffer and the indirect draw, dead ones into the
+  // free list
+  wgpu_gpu_sort_compact(particles->gpu_sort, pass_encoder,
+                        particles->lists.indices.buffer,
+                        particles->lists.alive_flags.buffer,
+                        particles->lists.live_indices.buffer,
+                        particles->lists.draw_indirect.buffer,
+                        particles->capacity);
+  wgpu_gpu_sort_compact(particles->gpu_sort, pass_encoder,
+                        particles->lists.indices.buffer,
+                        particles->lists.dead_flags.buffer,
+                        particles->lists.free_list.buffer,
+                        particles->lists.free_count.buffer,
+                        particles->capacity);
+}
+
+void wgpu_particles_record_sort(wgpu_particles_t* particles,
+                                WGPUComputePassEncoder pass_encoder)
+{
+  if (!particles->sort) {
+    return;
+  }
+
+  particles_dispatch(pass_encoder, &particles->stages[2], particles->capacity);
+  wgpu_gpu_sort_radix_sort(particles->gpu_sort, pass_encoder,
+                           particles->lists.sort_keys.buffer,
+                           particles->lists.live_indices.buffer,
+                           particles->capacity);
+}
+
+const wgpu_buffer_t* wgpu_particles_get_stream(wgpu_particles_t* particles,
+                                               uint32_t stream_index)
+{
+  ASSERT(stream_index < particles->stream_count);
+  return &particles->streams[stream_index];
+}
+
+const wgpu_buffer_t*
+wgpu_particles_get_live_indices(wgpu_particles_t* particles)
+{
+  return &particles->lists.live_indices;
+}
+
+const wgpu_buffer_t*
+wgpu_particles_get_draw_indirect(wgpu_particles_t* particles)
+{
+  return &particles->lists.draw_indirect;
+}
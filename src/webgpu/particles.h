@@ -0,0 +1,96 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "buffer.h"
+#include "context.h"
+
+#define WGPU_PARTICLES_MAX_STREAM_COUNT 5u
+
+typedef struct wgpu_particles wgpu_particles_t;
+
+/* Storage buffer holding one attribute of every particle */
+typedef struct wgpu_particles_stream_desc_t {
+  /* WGSL name of the array, e.g. "positions" */
+  const char* name;
+  /* WGSL type of the elements, e.g. "vec2<f32>" */
+  const char* wgsl_type;
+  /* Array stride of the type in bytes */
+  uint32_t element_size;
+  /* Optional capacity elements, zeros when NULL */
+  const void* initial_data;
+  /* Optional, writes the capacity elements into the mapping of the stream in
+   * place of initial_data, see wgpu_create_buffer_with_fill() */
+  wgpu_buffer_fill_desc_t fill;
+} wgpu_particles_stream_desc_t;
+
+typedef struct wgpu_particles_desc_t {
+  /* Number of particle slots */
+  uint32_t capacity;
+  uint32_t stream_count;
+  wgpu_particles_stream_desc_t streams[WGPU_PARTICLES_MAX_STREAM_COUNT];
+  /* Size of the uniform block "params" of the type "Params", 0 for none */
+  uint32_t params_size;
+  /*
+   * WGSL of the particle behavior, which defines
+   * - fn particleEmit(index : u32, emitIndex : u32), reviving the free slot
+   *   index as the emitIndex-th particle emitted in the step,
+   * - fn particleUpdate(index : u32) -> bool, advancing the slot index by
+   *   particleSystem.deltaTime and returning whether it is alive, called for
+   *   the dead slots as well,
+   * - fn particleSortKey(index : u32) -> u32 when sorting, ascending keys are
+   *   drawn first,
+   * - struct Params when params_size is not 0.
+   * The streams are read_write arrays of their name, particleHash and
+   * particleRandom hash u32 seeds, e.g. particleSystem.seed ^ index.
+   */
+  const char* update_wgsl;
+  /* Creates the sort keys pipeline and the radix sort */
+  bool sort;
+} wgpu_particles_desc_t;
+
+/*
+ * GPU particle system with the particles stored as structure of arrays, one
+ * storage buffer per attribute that can also be bound as vertex buffer.
+ *
+ * Each step emits into the slots of the free list, updates every slot with
+ * the behavior of the caller and compacts the indices of the live and of the
+ * dead slots with the GPU stream compaction: the live indices are an index
+ * buffer whose count is written into a draw indexed indirect buffer, the dead
+ * ones the free list of the next step. The live indices can be sorted by the
+ * keys of the behavior with the GPU radix sort.
+ *
+ * The slots are alive as the behavior decides in the first step, the free
+ * list is empty until then.
+ */
+wgpu_particles_t* wgpu_particles_create(wgpu_context_t* wgpu_context,
+                                        const wgpu_particles_desc_t* desc);
+void wgpu_particles_release(wgpu_particles_t* particles);
+
+/*
+ * Writes the step parameters shared by the steps recorded until the next
+ * update, emission_rate in particles per unit of delta_time. The fractional
+ * emission is carried over to the next update.
+ */
+void wgpu_particles_update(wgpu_particles_t* particles, float delta_time,
+                           float emission_rate);
+/* Writes the params_size bytes of the uniform block of the behavior */
+void wgpu_particles_set_params(wgpu_particles_t* particles, const void* data);
+
+/* Records the emission, the update and the compaction of one step */
+void wgpu_particles_record_step(wgpu_particles_t* particles,
+                                WGPUComputePassEncoder pass_encoder);
+/* Records the sort of the live indices, after the steps of the frame */
+void wgpu_particles_record_sort(wgpu_particles_t* particles,
+                                WGPUComputePassEncoder pass_encoder);
+
+/* Storage, vertex and copy source buffer of a stream */
+const wgpu_buffer_t* wgpu_particles_get_stream(wgpu_particles_t* particles,
+                                               uint32_t stream_index);
+/* Index buffer of the live particles */
+const wgpu_buffer_t*
+wgpu_particles_get_live_indices(wgpu_particles_t* particles);
+/* Draw indexed indirect arguments of the live indices, one instance */
+const wgpu_buffer_t*
+wgpu_particles_get_draw_indirect(wgpu_particles_t* particles);
+
+#endif
@@ -0,0 +1,395 @@
+#include "pipeline_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "../core/profiler.h"
+
+typedef enum wgpu_pipeline_cache_type_enum {
+  PipelineCacheType_Render  = 0,
+  PipelineCacheType_Compute = 1,
+} wgpu_pipeline_cache_type_enum;
+
+/* Descriptor serialized field by field, padding and labels are left out */
+typedef struct wgpu_pipeline_key_t {
+  uint8_t* data;
+  size_t size;
+  size_t capacity;
+  bool cacheable; /* false when the descriptor has chained structs */
+} wgpu_pipeline_key_t;
+
+typedef struct wgpu_pipeline_cache_entry_t {
+  uint64_t hash;
+  uint8_t* key;
+  size_t key_size;
+  union {
+    WGPURenderPipeline render;
+    WGPUComputePipeline compute;
+  } pipeline;
+} wgpu_pipeline_cache_entry_t;
+
+struct wgpu_pipeline_cache_t {
+  wgpu_pipeline_cache_entry_t* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  uint32_t hit_count;
+  uint32_t miss_count;
+};
+
+/* 64-bit FNV-1a */
+static uint64_t wgpu_pipeline_cache_hash(const void* data, size_t size)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint64_t hash        = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static wgpu_pipeline_cache_t* wgpu_pipeline_cache_create(void)
+{
+  wgpu_pipeline_cache_t* pipeline_cache
+    = (wgpu_pipeline_cache_t*)malloc(sizeof(wgpu_pipeline_cache_t));
+  memset(pipeline_cache, 0, sizeof(wgpu_pipeline_cache_t));
+  return pipeline_cache;
+}
+
+void wgpu_pipeline_cache_destroy(wgpu_pipeline_cache_t* pipeline_cache)
+{
+  log_debug("Pipeline cache: %u pipelines, %u hits, %u misses",
+            pipeline_cache->entry_count, pipeline_cache->hit_count,
+            pipeline_cache->miss_count);
+  for (uint32_t i = 0; i < pipeline_cache->entry_count; ++i) {
+    wgpu_pipeline_cache_entry_t* entry = &pipeline_cache->entries[i];
+    if (entry->key[0] == PipelineCacheType_Render) {
+      WGPU_RELEASE_RESOURCE(RenderPipeline, entry->pipeline.render)
+    }
+    else {
+      WGPU_RELEASE_RESOURCE(ComputePipeline, entry->pipeline.compute)
+    }
+    free(entry->key);
+  }
+  free(pipeline_cache->entries);
+  free(pipeline_cache);
+}
+
+/* Key serialization */
+static void wgpu_pipeline_key_write(wgpu_pipeline_key_t* key,
+                                    const void* data, size_t size)
+{
+  if (size == 0) {
+    return;
+  }
+  if (key->size + size > key->capacity) {
+    key->capacity = MAX(key->capacity * 2, MAX(key->size + size, 256u));
+    key->data     = realloc(key->data, key->capacity);
+    ASSERT(key->data != NULL);
+  }
+  memcpy(key->data + key->size, data, size);
+  key->size += size;
+}
+
+static void wgpu_pipeline_key_write_u32(wgpu_pipeline_key_t* key,
+                                        uint32_t value)
+{
+  wgpu_pipeline_key_write(key, &value, sizeof(value));
+}
+
+static void wgpu_pipeline_key_write_u64(wgpu_pipeline_key_t* key,
+                                        uint64_t value)
+{
+  wgpu_pipeline_key_write(key, &value, sizeof(value));
+}
+
+static void wgpu_pipeline_key_write_handle(wgpu_pipeline_key_t* key,
+                                           const void* handle)
+{
+  wgpu_pipeline_key_write(key, &handle, sizeof(handle));
+}
+
+static void wgpu_pipeline_key_write_string(wgpu_pipeline_key_t* key,
+                                           const char* str)
+{
+  // NULL and "" are told apart by the length prefix
+  const uint32_t length = str != NULL ? (uint32_t)strlen(str) + 1 : 0;
+  wgpu_pipeline_key_write_u32(key, length);
+  wgpu_pipeline_key_write(key, str, length);
+}
+
+static void wgpu_pipeline_key_check_chain(wgpu_pipeline_key_t* key,
+                                          WGPUChainedStruct const* chain)
+{
+  if (chain != NULL) {
+    key->cacheable = false;
+  }
+}
+
+static void wgpu_pipeline_key_write_stage(wgpu_pipeline_key_t* key,
+                                          WGPUShaderModule module,
+                                          const char* entry_point,
+                                          uint32_t constant_count,
+                                          WGPUConstantEntry const* constants)
+{
+  wgpu_pipeline_key_write_handle(key, module);
+  wgpu_pipeline_key_write_string(key, entry_point);
+  wgpu_pipeline_key_write_u32(key, constant_count);
+  for (uint32_t i = 0; i < constant_count; ++i) {
+    wgpu_pipeline_key_check_chain(key, constants[i].nextInChain);
+    wgpu_pipeline_key_write_string(key, constants[i].key);
+    wgpu_pipeline_key_write(key, &constants[i].value,
+                            sizeof(constants[i].value));
+  }
+}
+
+static void wgpu_pipeline_key_write_stencil_face(
+  wgpu_pipeline_key_t* key, const WGPUStencilFaceState* state)
+{
+  wgpu_pipeline_key_write_u32(key, (uint32_t)state->compare);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)state->failOp);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)state->depthFailOp);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)state->passOp);
+}
+
+static void wgpu_pipeline_key_write_blend_component(
+  wgpu_pipeline_key_t* key, const WGPUBlendComponent* component)
+{
+  wgpu_pipeline_key_write_u32(key, (uint32_t)component->operation);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)component->srcFactor);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)component->dstFactor);
+}
+
+static void
+wgpu_pipeline_key_write_render(wgpu_pipeline_key_t* key,
+                               WGPURenderPipelineDescriptor const* desc)
+{
+  const uint8_t type = PipelineCacheType_Render;
+  wgpu_pipeline_key_write(key, &type, sizeof(type));
+  wgpu_pipeline_key_check_chain(key, desc->nextInChain);
+  wgpu_pipeline_key_write_handle(key, desc->layout);
+
+  // Vertex state
+  const WGPUVertexState* vertex = &desc->vertex;
+  wgpu_pipeline_key_check_chain(key, vertex->nextInChain);
+  wgpu_pipeline_key_write_stage(key, vertex->module, vertex->entryPoint,
+                                vertex->constantCount, vertex->constants);
+  wgpu_pipeline_key_write_u32(key, vertex->bufferCount);
+  for (uint32_t b = 0; b < vertex->bufferCount; ++b) {
+    const WGPUVertexBufferLayout* buffer = &vertex->buffers[b];
+    wgpu_pipeline_key_write_u64(key, buffer->arrayStride);
+    wgpu_pipeline_key_write_u32(key, (uint32_t)buffer->stepMode);
+    wgpu_pipeline_key_write_u32(key, buffer->attributeCount);
+    for (uint32_t a = 0; a < buffer->attributeCount; ++a) {
+      const WGPUVertexAttribute* attribute = &buffer->attributes[a];
+      wgpu_pipeline_key_write_u32(key, (uint32_t)attribute->format);
+      wgpu_pipeline_key_write_u64(key, attribute->offset);
+      wgpu_pipeline_key_write_u32(key, attribute->shaderLocation);
+    }
+  }
+
+  // Primitive state
+  const WGPUPrimitiveState* primitive = &desc->primitive;
+  wgpu_pipeline_key_check_chain(key, primitive->nextInChain);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)primitive->topology);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)primitive->stripIndexFormat);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)primitive->frontFace);
+  wgpu_pipeline_key_write_u32(key, (uint32_t)primitive->cullMode);
+
+  // Depth-stencil state
+  const WGPUDepthStencilState* depth_stencil = desc->depthStencil;
+  wgpu_pipeline_key_write_u32(key, depth_stencil != NULL);
+  if (depth_stencil != NULL) {
+    wgpu_pipeline_key_check_chain(key, depth_stencil->nextInChain);
+    wgpu_pipeline_key_write_u32(key, (uint32_t)depth_stencil->format);
+    wgpu_pipeline_key_write_u32(key, depth_stencil->depthWriteEnabled);
+    wgpu_pipeline_key_write_u32(key, (uint32_t)depth_stencil->depthCompare);
+    wgpu_pipeline_key_write_stencil_face(key, &depth_stencil->stencilFront);
+    wgpu_pipeline_key_write_stencil_face(key, &depth_stencil->stencilBack);
+    wgpu_pipeline_key_write_u32(key, depth_stencil->stencilReadMask);
+    wgpu_pipeline_key_write_u32(key, depth_stencil->stencilWriteMask);
+    wgpu_pipeline_key_write_u32(key, (uint32_t)depth_stencil->depthBias);
+    wgpu_pipeline_key_write(key, &depth_stencil->depthBiasSlopeScale,
+                            sizeof(float));
+    wgpu_pipeline_key_write(key, &depth_stencil->depthBiasClamp,
+                            sizeof(float));
+  }
+
+  // Multisample state
+  const WGPUMultisampleState* multisample = &desc->multisample;
+  wgpu_pipeline_key_check_chain(key, multisample->nextInChain);
+  wgpu_pipeline_key_write_u32(key, multisample->count);
+  wgpu_pipeline_key_write_u32(key, multisample->mask);
+  wgpu_pipeline_key_write_u32(key, multisample->alphaToCoverageEnabled);
+
+  // Fragment state
+  const WGPUFragmentState* fragment = desc->fragment;
+  wgpu_pipeline_key_write_u32(key, fragment != NULL);
+  if (fragment != NULL) {
+    wgpu_pipeline_key_check_chain(key, fragment->nextInChain);
+    wgpu_pipeline_key_write_stage(key, fragment->module, fragment->entryPoint,
+                                  fragment->constantCount,
+                                  fragment->constants);
+    wgpu_pipeline_key_write_u32(key, fragment->targetCount);
+    for (uint32_t t = 0; t < fragment->targetCount; ++t) {
+      const WGPUColorTargetState* target = &fragment->targets[t];
+      wgpu_pipeline_key_check_chain(key, target->nextInChain);
+      wgpu_pipeline_key_write_u32(key, (uint32_t)target->format);
+      wgpu_pipeline_key_write_u32(key, (uint32_t)target->writeMask);
+      wgpu_pipeline_key_write_u32(key, target->blend != NULL);
+      if (target->blend != NULL) {
+        wgpu_pipeline_key_write_blend_component(key, &target->blend->color);
+        wgpu_pipeline_key_write_blend_component(key, &target->blend->alpha);
+      }
+    }
+  }
+}
+
+static void
+wgpu_pipeline_key_write_compute(wgpu_pipeline_key_t* key,
+                                WGPUComputePipelineDescriptor const* desc)
+{
+  const uint8_t type = PipelineCacheType_Compute;
+  wgpu_pipeline_key_write(key, &type, sizeof(type));
+  wgpu_pipeline_key_check_chain(key, desc->nextInChain);
+  wgpu_pipeline_key_write_handle(key, desc->layout);
+  wgpu_pipeline_key_check_chain(key, desc->compute.nextInChain);
+  wgpu_pipeline_key_write_stage(key, desc->compute.module,
+                                desc->compute.entryPoint,
+                                desc->compute.constantCount,
+                                desc->compute.constants);
+}
+
+static wgpu_pipeline_cache_t*
+wgpu_get_pipeline_cache(wgpu_context_t* wgpu_context)
+{
+  if (wgpu_context->pipeline_cache == NULL) {
+    wgpu_context->pipeline_cache = wgpu_pipeline_cache_create();
+  }
+  return wgpu_context->pipeline_cache;
+}
+
+/* Returns the entry of the key, NULL on a miss */
+static wgpu_pipeline_cache_entry_t*
+wgpu_pipeline_cache_find(wgpu_pipeline_cache_t* pipeline_cache,
+                         const wgpu_pipeline_key_t* key, uint64_t hash)
+{
+  for (uint32_t i = 0; i < pipeline_cache->entry_count; ++i) {
+    wgpu_pipeline_cache_entry_t* entry = &pipeline_cache->entries[i];
+    if (entry->hash == hash && entry->key_size == key->size
+        && memcmp(entry->key, key->data, key->size) == 0) {
+      ++pipeline_cache->hit_count;
+      return entry;
+    }
+  }
+  ++pipeline_cache->miss_count;
+  return NULL;
+}
+
+/* Appends an entry, the key data is moved to the entry */
+static wgpu_pipeline_cache_entry_t*
+wgpu_pipeline_cache_insert(wgpu_pipeline_cache_t* pipeline_cache,
+                           wgpu_pipeline_key_t* key, uint64_t hash)
+{
+  if (pipeline_cache->entry_count == pipeline_cache->entry_capacity) {
+    uint32_t capacity = MAX(pipeline_cache->entry_capacity * 2, 16u);
+    wgpu_pipeline_cache_entry_t* entries
+      = (wgpu_pipeline_cache_entry_t*)realloc(
+        pipeline_cache->entries,
+        capacity * sizeof(wgpu_pipeline_cache_entry_t));
+    ASSERT(entries != NULL);
+    pipeline_cache->entries        = entries;
+    pipeline_cache->entry_capacity = capacity;
+  }
+  wgpu_pipeline_cache_entry_t* entry
+    = &pipeline_cache->entries[pipeline_cache->entry_count++];
+  *entry = (wgpu_pipeline_cache_entry_t){
+    .hash     = hash,
+    .key      = key->data,
+    .key_size = key->size,
+  };
+  key->data = NULL;
+  return entry;
+}
+
+WGPURenderPipeline wgpu_pipeline_cache_get_render_pipeline(
+  wgpu_context_t* wgpu_context, WGPURenderPipelineDescriptor const* desc)
+{
+  PROFILE_BEGIN("wgpu_pipeline_cache_get_render_pipeline");
+
+  wgpu_pipeline_key_t key = {.cacheable = true};
+  wgpu_pipeline_key_write_render(&key, desc);
+  if (!key.cacheable) {
+    free(key.data);
+    PROFILE_END();
+    return wgpuDeviceCreateRenderPipeline(wgpu_context->device, desc);
+  }
+
+  wgpu_pipeline_cache_t* pipeline_cache = wgpu_get_pipeline_cache(wgpu_context);
+  const uint64_t hash = wgpu_pipeline_cache_hash(key.data, key.size);
+  wgpu_pipeline_cache_entry_t* entry
+    = wgpu_pipeline_cache_find(pipeline_cache, &key, hash);
+  if (entry != NULL) {
+    free(key.data);
+    wgpuRenderPipelineReference(entry->pipeline.render);
+    PROFILE_END();
+    return entry->pipeline.render;
+  }
+
+  WGPURenderPipeline pipeline
+    = wgpuDeviceCreateRenderPipeline(wgpu_context->device, desc);
+  if (pipeline == NULL) {
+    free(key.data);
+    PROFILE_END();
+    return NULL;
+  }
+  entry = wgpu_pipeline_cache_insert(pipeline_cache, &key, hash);
+  entry->pipeline.render = pipeline;
+
+  /* One reference for the cache, one for the caller */
+  wgpuRenderPipelineReference(pipeline);
+  PROFILE_END();
+  return pipeline;
+}
+
+WGPUComputePipeline wgpu_pipeline_cache_get_compute_pipeline(
+  wgpu_context_t* wgpu_context, WGPUComputePipelineDescriptor const* desc)
+{
+  PROFILE_BEGIN("wgpu_pipeline_cache_get_compute_pipeline");
+
+  wgpu_pipeline_key_t key = {.cacheable = true};
+  wgpu_pipeline_key_write_compute(&key, desc);
+  if (!key.cacheable) {
+    free(key.data);
+    PROFILE_END();
+    return wgpuDeviceCreateComputePipeline(wgpu_context->device, desc);
+  }
+
+  wgpu_pipeline_cache_t* pipeline_cache = wgpu_get_pipeline_cache(wgpu_context);
+  const uint64_t hash = wgpu_pipeline_cache_hash(key.data, key.size);
+  wgpu_pipeline_cache_entry_t* entry
+    = wgpu_pipeline_cache_find(pipeline_cache, &key, hash);
+  if (entry != NULL) {
+    free(key.data);
+    wgpuComputePipelineReference(entry->pipeline.compute);
+    PROFILE_END();
+    return entry->pipeline.compute;
+  }
+
+  WGPUComputePipeline pipeline
+    = wgpuDeviceCreateComputePipeline(wgpu_context->device, desc);
+  if (pipeline == NULL) {
+    free(key.data);
+    PROFILE_END();
+    return NULL;
+  }
+  entry = wgpu_pipeline_cache_insert(pipeline_cache, &key, hash);
+  entry->pipeline.compute = pipeline;
+
+  /* One reference for the cache, one for the caller */
+  wgpuComputePipelineReference(pipeline);
+  PROFILE_END();
+  return pipeline;
+}
@@ -0,0 +1,29 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include "context.h"
+
+/**
+ * Pipeline cache: render and compute pipelines are shared per context, keyed
+ * by their full descriptor (layout, shader modules, entry points and
+ * constants, vertex layouts, primitive, depth-stencil, multisample, blend and
+ * target states) except for the label. Pipelines that only differ in their
+ * label, and pipelines created again from the same descriptor, e.g. on
+ * resize, are compiled once.
+ *
+ * Shader modules and layouts take part in the key by handle, module sharing
+ * comes from the shader cache (see shader.h). Descriptors with chained structs
+ * are not cached. Every returned pipeline holds its own reference and must be
+ * released by the caller as before, the cache keeps one reference on every
+ * pipeline it holds until the context is released.
+ */
+typedef struct wgpu_pipeline_cache_t wgpu_pipeline_cache_t;
+void wgpu_pipeline_cache_destroy(wgpu_pipeline_cache_t* pipeline_cache);
+
+/* Returns the pipeline of the descriptor, creating it on first use */
+WGPURenderPipeline wgpu_pipeline_cache_get_render_pipeline(
+  wgpu_context_t* wgpu_context, WGPURenderPipelineDescriptor const* desc);
+WGPUComputePipeline wgpu_pipeline_cache_get_compute_pipeline(
+  wgpu_context_t* wgpu_context, WGPUComputePipelineDescriptor const* desc);
+
+#endif
@@ -0,0 +1,164 @@
+#include "pipeline_factory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "../core/platform.h"
+
+typedef enum wgpu_pipeline_request_type_enum {
+  PipelineRequestType_Render  = 0,
+  PipelineRequestType_Compute = 1,
+} wgpu_pipeline_request_type_enum;
+
+/* Outstanding asynchronous pipeline creation */
+typedef struct wgpu_pipeline_request_t {
+  struct wgpu_pipeline_factory* pipeline_factory;
+  wgpu_pipeline_request_type_enum type;
+  char label[STRMAX];
+  union {
+    WGPURenderPipeline* render_pipeline;
+    WGPUComputePipeline* compute_pipeline;
+  } result;
+} wgpu_pipeline_request_t;
+
+struct wgpu_pipeline_factory {
+  wgpu_context_t* wgpu_context;
+  uint32_t pending_count;
+  float start_time; /* time of the first pending request */
+};
+
+wgpu_pipeline_factory_t*
+wgpu_pipeline_factory_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_pipeline_factory_t* pipeline_factory
+    = (wgpu_pipeline_factory_t*)malloc(sizeof(wgpu_pipeline_factory_t));
+  memset(pipeline_factory, 0, sizeof(wgpu_pipeline_factory_t));
+  pipeline_factory->wgpu_context = wgpu_context;
+
+  return pipeline_factory;
+}
+
+void wgpu_pipeline_factory_release(wgpu_pipeline_factory_t* pipeline_factory)
+{
+  /* Requests still in flight reference the factory */
+  wgpu_pipeline_factory_wait(pipeline_factory);
+
+  free(pipeline_factory);
+}
+
+static wgpu_pipeline_request_t*
+wgpu_pipeline_request_create(wgpu_pipeline_factory_t* pipeline_factory,
+                             wgpu_pipeline_request_type_enum type,
+                             const char* label)
+{
+  wgpu_pipeline_request_t* request
+    = (wgpu_pipeline_request_t*)malloc(sizeof(wgpu_pipeline_request_t));
+  memset(request, 0, sizeof(wgpu_pipeline_request_t));
+  request->pipeline_factory = pipeline_factory;
+  request->type             = type;
+  snprintf(request->label, sizeof(request->label), "%s",
+           label ? label : "unnamed");
+
+  if (pipeline_factory->pending_count++ == 0) {
+    pipeline_factory->start_time = platform_get_time();
+  }
+
+  return request;
+}
+
+static void wgpu_pipeline_request_complete(wgpu_pipeline_request_t* request,
+                                           WGPUCreatePipelineAsyncStatus status,
+                                           char const* message)
+{
+  wgpu_pipeline_factory_t* pipeline_factory = request->pipeline_factory;
+  if (status != WGPUCreatePipelineAsyncStatus_Success) {
+    log_error("Failed to create %s pipeline '%s': %s",
+              request->type == PipelineRequestType_Render ? "render" :
+                                                            "compute",
+              request->label, message ? message : "");
+  }
+
+  ASSERT(pipeline_factory->pending_count > 0);
+  if (--pipeline_factory->pending_count == 0) {
+    log_debug("Pipelines ready in %.2f ms",
+              (platform_get_time() - pipeline_factory->start_time) * 1000.0f);
+  }
+
+  free(request);
+}
+
+static void
+wgpu_create_render_pipeline_async_cb(WGPUCreatePipelineAsyncStatus status,
+                                     WGPURenderPipeline pipeline,
+                                     char const* message, void* userdata)
+{
+  wgpu_pipeline_request_t* request = (wgpu_pipeline_request_t*)userdata;
+  *request->result.render_pipeline
+    = (status == WGPUCreatePipelineAsyncStatus_Success) ? pipeline : NULL;
+  wgpu_pipeline_request_complete(request, status, message);
+}
+
+static void
+wgpu_create_compute_pipeline_async_cb(WGPUCreatePipelineAsyncStatus status,
+                                      WGPUComputePipeline pipeline,
+                                      char const* message, void* userdata)
+{
+  wgpu_pipeline_request_t* request = (wgpu_pipeline_request_t*)userdata;
+  *request->result.compute_pipeline
+    = (status == WGPUCreatePipelineAsyncStatus_Success) ? pipeline : NULL;
+  wgpu_pipeline_request_complete(request, status, message);
+}
+
+void wgpu_pipeline_factory_create_render_pipeline(
+  wgpu_pipeline_factory_t* pipeline_factory,
+  WGPURenderPipelineDescriptor const* descriptor, WGPURenderPipeline* pipeline)
+{
+  ASSERT(descriptor != NULL && pipeline != NULL);
+
+  *pipeline                        = NULL;
+  wgpu_pipeline_request_t* request = wgpu_pipeline_request_create(
+    pipeline_factory, PipelineRequestType_Render, descriptor->label);
+  request->result.render_pipeline = pipeline;
+  wgpuDeviceCreateRenderPipelineAsync(pipeline_factory->wgpu_context->device,
+                                      descriptor,
+                                      wgpu_create_render_pipeline_async_cb,
+                                      request);
+}
+
+void wgpu_pipeline_factory_create_compute_pipeline(
+  wgpu_pipeline_factory_t* pipeline_factory,
+  WGPUComputePipelineDescriptor const* descriptor,
+  WGPUComputePipeline* pipeline)
+{
+  ASSERT(descriptor != NULL && pipeline != NULL);
+
+  *pipeline                        = NULL;
+  wgpu_pipeline_request_t* request = wgpu_pipeline_request_create(
+    pipeline_factory, PipelineRequestType_Compute, descriptor->label);
+  request->result.compute_pipeline = pipeline;
+  wgpuDeviceCreateComputePipelineAsync(pipeline_factory->wgpu_context->device,
+                                       descriptor,
+                                       wgpu_create_compute_pipeline_async_cb,
+                                       request);
+}
+
+uint32_t
+wgpu_pipeline_factory_get_pending_count(wgpu_pipeline_factory_t* pipeline_factory)
+{
+  return pipeline_factory->pending_count;
+}
+
+bool wgpu_pipeline_factory_is_ready(wgpu_pipeline_factory_t* pipeline_factory)
+{
+  return pipeline_factory->pending_count == 0;
+}
+
+void wgpu_pipeline_factory_wait(wgpu_pipeline_factory_t* pipeline_factory)
+{
+  while (pipeline_factory->pending_count > 0) {
+    wgpuDeviceTick(pipeline_factory->wgpu_context->device);
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef PIPELINE_FACTORY_H
+#define PIPELINE_FACTORY_H
+
+#include "context.h"
+
+typedef struct wgpu_pipeline_factory wgpu_pipeline_factory_t;
+
+/* Pipeline factory creating/releasing */
+wgpu_pipeline_factory_t*
+wgpu_pipeline_factory_create(wgpu_context_t* wgpu_context);
+void wgpu_pipeline_factory_release(wgpu_pipeline_factory_t* pipeline_factory);
+
+/*
+ * Requests the asynchronous creation of a pipeline. Independent requests are
+ * compiled in parallel by the device, the pipeline is written to *pipeline
+ * once it is ready (NULL on failure). The descriptor and the shader modules
+ * it references can be released as soon as the function returns.
+ */
+void wgpu_pipeline_factory_create_render_pipeline(
+  wgpu_pipeline_factory_t* pipeline_factory,
+  WGPURenderPipelineDescriptor const* descriptor, WGPURenderPipeline* pipeline);
+void wgpu_pipeline_factory_create_compute_pipeline(
+  wgpu_pipeline_factory_t* pipeline_factory,
+  WGPUComputePipelineDescriptor const* descriptor,
+  WGPUComputePipeline* pipeline);
+
+/* Returns the number of requested pipelines that are not ready yet */
+uint32_t
+wgpu_pipeline_factory_get_pending_count(wgpu_pipeline_factory_t* pipeline_factory);
+/* Returns true when all requested pipelines are ready (or failed) */
+bool wgpu_pipeline_factory_is_ready(wgpu_pipeline_factory_t* pipeline_factory);
+/* Blocks until all requested pipelines are ready (or failed) */
+void wgpu_pipeline_factory_wait(wgpu_pipeline_factory_t* pipeline_factory);
+
+#endif
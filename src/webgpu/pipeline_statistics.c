@@ -0,0 +1,345 @@
+#include "pipeline_statistics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+/* Statistics of a pipeline statistics query, in resolve order */
+static const WGPUPipelineStatisticName wgpu_pipeline_statistic_names[4] = {
+  WGPUPipelineStatisticName_VertexShaderInvocations,
+  WGPUPipelineStatisticName_ClipperPrimitivesOut,
+  WGPUPipelineStatisticName_FragmentShaderInvocations,
+  WGPUPipelineStatisticName_ComputeShaderInvocations,
+};
+#define WGPU_PIPELINE_STATISTIC_COUNT                                          \
+  ((uint32_t)ARRAY_SIZE(wgpu_pipeline_statistic_names))
+
+/* The pipeline statistics of all scopes, then their occlusion counts, at an
+ * offset aligned for the resolve */
+#define WGPU_PIPELINE_STATISTICS_SIZE                                          \
+  (WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT * WGPU_PIPELINE_STATISTIC_COUNT    \
+   * sizeof(uint64_t))
+#define WGPU_PIPELINE_STATISTICS_OCCLUSION_OFFSET                              \
+  ((WGPU_PIPELINE_STATISTICS_SIZE + 255u) & ~255u)
+#define WGPU_PIPELINE_STATISTICS_BUFFER_SIZE                                   \
+  (WGPU_PIPELINE_STATISTICS_OCCLUSION_OFFSET                                   \
+   + WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT * sizeof(uint64_t))
+
+typedef struct wgpu_pipeline_statistics_scope_t {
+  char name[WGPU_PIPELINE_STATISTICS_MAX_SCOPE_NAME_LENGTH];
+  bool count_samples;
+} wgpu_pipeline_statistics_scope_t;
+
+typedef struct wgpu_pipeline_statistics_readback_t {
+  struct wgpu_pipeline_statistics* pipeline_statistics;
+  WGPUBuffer buffer;
+  bool pending; /* mapping in progress, buffer not reusable */
+  uint32_t scope_count;
+  wgpu_pipeline_statistics_scope_t scopes
+    [WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT];
+} wgpu_pipeline_statistics_readback_t;
+
+struct wgpu_pipeline_statistics {
+  wgpu_context_t* wgpu_context;
+  /* NULL without WGPUFeatureName_PipelineStatisticsQuery */
+  WGPUQuerySet statistics_query_set;
+  WGPUQuerySet occlusion_query_set;
+  WGPUBuffer resolve_buffer;
+  /* Scopes of the frame being recorded */
+  uint32_t scope_count;
+  wgpu_pipeline_statistics_scope_t
+    scopes[WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT];
+  /* Readback buffers in flight */
+  wgpu_pipeline_statistics_readback_t
+    readbacks[WGPU_PIPELINE_STATISTICS_READBACK_COUNT];
+  /* Results of the last read back frame */
+  wgpu_pipeline_statistics_result_t
+    results[WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT];
+  uint32_t result_count;
+};
+
+wgpu_pipeline_statistics_t*
+wgpu_pipeline_statistics_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_pipeline_statistics_t* pipeline_statistics
+    = (wgpu_pipeline_statistics_t*)malloc(sizeof(wgpu_pipeline_statistics_t));
+  memset(pipeline_statistics, 0, sizeof(wgpu_pipeline_statistics_t));
+  pipeline_statistics->wgpu_context = wgpu_context;
+
+  if (wgpu_has_feature(wgpu_context,
+                       WGPUFeatureName_PipelineStatisticsQuery)) {
+    pipeline_statistics->statistics_query_set = wgpuDeviceCreateQuerySet(
+      wgpu_context->device,
+      &(WGPUQuerySetDescriptor){
+        .label                   = "pipeline-statistics-query-set",
+        .type                    = WGPUQueryType_PipelineStatistics,
+        .count                   = WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT,
+        .pipelineStatistics      = wgpu_pipeline_statistic_names,
+        .pipelineStatisticsCount = WGPU_PIPELINE_STATISTIC_COUNT,
+      });
+    ASSERT(pipeline_statistics->statistics_query_set != NULL);
+  }
+  else {
+    log_info("Pipeline statistics queries not supported, only the occlusion "
+             "counts are collected");
+  }
+
+  pipeline_statistics->occlusion_query_set = wgpuDeviceCreateQuerySet(
+    wgpu_context->device, &(WGPUQuerySetDescriptor){
+                            .label = "pipeline-statistics-occlusion-query-set",
+                            .type  = WGPUQueryType_Occlusion,
+                            .count = WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT,
+                          });
+  ASSERT(pipeline_statistics->occlusion_query_set != NULL);
+
+  pipeline_statistics->resolve_buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device,
+    &(WGPUBufferDescriptor){
+      .label = "pipeline-statistics-resolve-buffer",
+      .usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc,
+      .size  = WGPU_PIPELINE_STATISTICS_BUFFER_SIZE,
+    });
+  ASSERT(pipeline_statistics->resolve_buffer != NULL);
+
+  for (uint32_t i = 0; i < WGPU_PIPELINE_STATISTICS_READBACK_COUNT; ++i) {
+    wgpu_pipeline_statistics_readback_t* readback
+      = &pipeline_statistics->readbacks[i];
+    readback->pipeline_statistics = pipeline_statistics;
+    readback->buffer              = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .label = "pipeline-statistics-readback-buffer",
+        .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+        .size  = WGPU_PIPELINE_STATISTICS_BUFFER_SIZE,
+      });
+    ASSERT(readback->buffer != NULL);
+  }
+
+  return pipeline_statistics;
+}
+
+void wgpu_pipeline_statistics_release(
+  wgpu_pipeline_statistics_t* pipeline_statistics)
+{
+  if (pipeline_statistics == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < WGPU_PIPELINE_STATISTICS_READBACK_COUNT; ++i) {
+    wgpu_pipeline_statistics_readback_t* readback
+      = &pipeline_statistics->readbacks[i];
+    if (readback->buffer != NULL) {
+      /* Pending map callbacks are fired with DestroyedBeforeCallback */
+      wgpuBufferDestroy(readback->buffer);
+      WGPU_RELEASE_RESOURCE(Buffer, readback->buffer)
+    }
+  }
+  WGPU_RELEASE_RESOURCE(Buffer, pipeline_statistics->resolve_buffer)
+  WGPU_RELEASE_RESOURCE(QuerySet, pipeline_statistics->occlusion_query_set)
+  WGPU_RELEASE_RESOURCE(QuerySet, pipeline_statistics->statistics_query_set)
+
+  free(pipeline_statistics);
+}
+
+WGPUQuerySet wgpu_pipeline_statistics_get_occlusion_query_set(
+  wgpu_pipeline_statistics_t* pipeline_statistics)
+{
+  return (pipeline_statistics != NULL) ?
+           pipeline_statistics->occlusion_query_set :
+           NULL;
+}
+
+static uint32_t wgpu_pipeline_statistics_add_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics, const char* name,
+  bool count_samples)
+{
+  if (pipeline_statistics == NULL
+      || pipeline_statistics->scope_count
+           == WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT) {
+    return WGPU_PIPELINE_STATISTICS_INVALID_SCOPE;
+  }
+
+  const uint32_t scope = pipeline_statistics->scope_count++;
+  snprintf(pipeline_statistics->scopes[scope].name,
+           WGPU_PIPELINE_STATISTICS_MAX_SCOPE_NAME_LENGTH, "%s", name);
+  pipeline_statistics->scopes[scope].count_samples = count_samples;
+
+  return scope;
+}
+
+uint32_t wgpu_pipeline_statistics_begin_render_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPURenderPassEncoder rpass_enc, const char* name, bool count_samples)
+{
+  const uint32_t scope = wgpu_pipeline_statistics_add_scope(
+    pipeline_statistics, name, count_samples);
+  if (scope == WGPU_PIPELINE_STATISTICS_INVALID_SCOPE) {
+    return scope;
+  }
+
+  if (pipeline_statistics->statistics_query_set != NULL) {
+    wgpuRenderPassEncoderBeginPipelineStatisticsQuery(
+      rpass_enc, pipeline_statistics->statistics_query_set, scope);
+  }
+  if (count_samples) {
+    wgpuRenderPassEncoderBeginOcclusionQuery(rpass_enc, scope);
+  }
+
+  return scope;
+}
+
+void wgpu_pipeline_statistics_end_render_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPURenderPassEncoder rpass_enc, uint32_t scope)
+{
+  if (pipeline_statistics == NULL
+      || scope >= pipeline_statistics->scope_count) {
+    return;
+  }
+
+  if (pipeline_statistics->statistics_query_set != NULL) {
+    wgpuRenderPassEncoderEndPipelineStatisticsQuery(rpass_enc);
+  }
+  if (pipeline_statistics->scopes[scope].count_samples) {
+    wgpuRenderPassEncoderEndOcclusionQuery(rpass_enc);
+  }
+}
+
+uint32_t wgpu_pipeline_statistics_begin_compute_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPUComputePassEncoder cpass_enc, const char* name)
+{
+  const uint32_t scope
+    = wgpu_pipeline_statistics_add_scope(pipeline_statistics, name, false);
+  if (scope != WGPU_PIPELINE_STATISTICS_INVALID_SCOPE
+      && pipeline_statistics->statistics_query_set != NULL) {
+    wgpuComputePassEncoderBeginPipelineStatisticsQuery(
+      cpass_enc, pipeline_statistics->statistics_query_set, scope);
+  }
+
+  return scope;
+}
+
+void wgpu_pipeline_statistics_end_compute_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPUComputePassEncoder cpass_enc, uint32_t scope)
+{
+  if (pipeline_statistics == NULL
+      || scope >= pipeline_statistics->scope_count) {
+    return;
+  }
+
+  if (pipeline_statistics->statistics_query_set != NULL) {
+    wgpuComputePassEncoderEndPipelineStatisticsQuery(cpass_enc);
+  }
+}
+
+static void
+wgpu_pipeline_statistics_readback_map_cb(WGPUBufferMapAsyncStatus status,
+                                         void* user_data)
+{
+  wgpu_pipeline_statistics_readback_t* readback
+    = (wgpu_pipeline_statistics_readback_t*)user_data;
+  if (status == WGPUBufferMapAsyncStatus_DestroyedBeforeCallback
+      || status == WGPUBufferMapAsyncStatus_UnmappedBeforeCallback) {
+    return;
+  }
+
+  if (status == WGPUBufferMapAsyncStatus_Success) {
+    wgpu_pipeline_statistics_t* pipeline_statistics
+      = readback->pipeline_statistics;
+    const uint64_t* values = (const uint64_t*)wgpuBufferGetConstMappedRange(
+      readback->buffer, 0, WGPU_PIPELINE_STATISTICS_BUFFER_SIZE);
+    ASSERT(values != NULL);
+    const uint64_t* samples_passed
+      = &values[WGPU_PIPELINE_STATISTICS_OCCLUSION_OFFSET / sizeof(uint64_t)];
+    for (uint32_t i = 0; i < readback->scope_count; ++i) {
+      const uint64_t* statistics = &values[i * WGPU_PIPELINE_STATISTIC_COUNT];
+      wgpu_pipeline_statistics_result_t* result
+        = &pipeline_statistics->results[i];
+      memcpy(result->name, readback->scopes[i].name,
+             WGPU_PIPELINE_STATISTICS_MAX_SCOPE_NAME_LENGTH);
+      result->vertex_invocations   = statistics[0];
+      result->clipper_primitives   = statistics[1];
+      result->fragment_invocations = statistics[2];
+      result->compute_invocations  = statistics[3];
+      result->has_samples_passed   = readback->scopes[i].count_samples;
+      result->samples_passed
+        = result->has_samples_passed ? samples_passed[i] : 0;
+    }
+    pipeline_statistics->result_count = readback->scope_count;
+    wgpuBufferUnmap(readback->buffer);
+  }
+  else {
+    log_warn("Pipeline statistics readback failed (status: %d)", status);
+  }
+
+  readback->pending = false;
+}
+
+void wgpu_pipeline_statistics_end_frame(
+  wgpu_pipeline_statistics_t* pipeline_statistics)
+{
+  if (pipeline_statistics == NULL || pipeline_statistics->scope_count == 0) {
+    return;
+  }
+
+  /* Find a readback buffer that is not in use, drop the frame otherwise */
+  wgpu_pipeline_statistics_readback_t* readback = NULL;
+  for (uint32_t i = 0; i < WGPU_PIPELINE_STATISTICS_READBACK_COUNT; ++i) {
+    if (!pipeline_statistics->readbacks[i].pending) {
+      readback = &pipeline_statistics->readbacks[i];
+      break;
+    }
+  }
+  const uint32_t scope_count       = pipeline_statistics->scope_count;
+  pipeline_statistics->scope_count = 0;
+  if (readback == NULL) {
+    return;
+  }
+
+  /* Queries of the scopes that did not write them resolve to 0 */
+  wgpu_context_t* wgpu_context = pipeline_statistics->wgpu_context;
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  if (pipeline_statistics->statistics_query_set != NULL) {
+    wgpuCommandEncoderResolveQuerySet(
+      cmd_enc, pipeline_statistics->statistics_query_set, 0, scope_count,
+      pipeline_statistics->resolve_buffer, 0);
+  }
+  wgpuCommandEncoderResolveQuerySet(
+    cmd_enc, pipeline_statistics->occlusion_query_set, 0, scope_count,
+    pipeline_statistics->resolve_buffer,
+    WGPU_PIPELINE_STATISTICS_OCCLUSION_OFFSET);
+  wgpuCommandEncoderCopyBufferToBuffer(
+    cmd_enc, pipeline_statistics->resolve_buffer, 0, readback->buffer, 0,
+    WGPU_PIPELINE_STATISTICS_BUFFER_SIZE);
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  readback->pending     = true;
+  readback->scope_count = scope_count;
+  memcpy(readback->scopes, pipeline_statistics->scopes,
+         sizeof(readback->scopes));
+  wgpuBufferMapAsync(readback->buffer, WGPUMapMode_Read, 0,
+                     WGPU_PIPELINE_STATISTICS_BUFFER_SIZE,
+                     wgpu_pipeline_statistics_readback_map_cb, readback);
+}
+
+uint32_t wgpu_pipeline_statistics_get_results(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  const wgpu_pipeline_statistics_result_t** results)
+{
+  if (pipeline_statistics == NULL) {
+    *results = NULL;
+    return 0;
+  }
+
+  *results = pipeline_statistics->results;
+  return pipeline_statistics->result_count;
+}
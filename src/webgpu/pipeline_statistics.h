@@ -0,0 +1,75 @@
+#ifndef PIPELINE_STATISTICS_H
+#define PIPELINE_STATISTICS_H
+
+#include "context.h"
+
+#define WGPU_PIPELINE_STATISTICS_MAX_SCOPE_COUNT 16u
+#define WGPU_PIPELINE_STATISTICS_MAX_SCOPE_NAME_LENGTH 64u
+#define WGPU_PIPELINE_STATISTICS_READBACK_COUNT 3u
+#define WGPU_PIPELINE_STATISTICS_INVALID_SCOPE (~0u)
+
+typedef struct wgpu_pipeline_statistics wgpu_pipeline_statistics_t;
+
+typedef struct wgpu_pipeline_statistics_result_t {
+  char name[WGPU_PIPELINE_STATISTICS_MAX_SCOPE_NAME_LENGTH];
+  /* Counters of the pipeline statistics query, 0 when not supported */
+  uint64_t vertex_invocations;
+  uint64_t clipper_primitives; /* primitives output by the clipper */
+  uint64_t fragment_invocations;
+  uint64_t compute_invocations;
+  /* Occlusion query of the render scopes counting samples */
+  bool has_samples_passed;
+  uint64_t samples_passed;
+} wgpu_pipeline_statistics_result_t;
+
+/*
+ * Collects the pipeline statistics and the occlusion counts of named pass
+ * scopes, to tell overdraw-bound passes from vertex-bound ones. The pipeline
+ * statistics need WGPUFeatureName_PipelineStatisticsQuery, without it only the
+ * occlusion counts are collected.
+ */
+wgpu_pipeline_statistics_t*
+wgpu_pipeline_statistics_create(wgpu_context_t* wgpu_context);
+void wgpu_pipeline_statistics_release(
+  wgpu_pipeline_statistics_t* pipeline_statistics);
+
+/*
+ * Occlusion query set of the collector, the render passes with scopes that
+ * count samples must begin with it as their occlusionQuerySet. NULL when the
+ * collector is NULL.
+ */
+WGPUQuerySet wgpu_pipeline_statistics_get_occlusion_query_set(
+  wgpu_pipeline_statistics_t* pipeline_statistics);
+
+/*
+ * Named scopes, recorded inside of render / compute passes, one scope at a
+ * time per pass. The collector may be NULL, in which case the scopes are
+ * no-ops.
+ */
+uint32_t wgpu_pipeline_statistics_begin_render_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPURenderPassEncoder rpass_enc, const char* name, bool count_samples);
+void wgpu_pipeline_statistics_end_render_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPURenderPassEncoder rpass_enc, uint32_t scope);
+uint32_t wgpu_pipeline_statistics_begin_compute_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPUComputePassEncoder cpass_enc, const char* name);
+void wgpu_pipeline_statistics_end_compute_scope(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  WGPUComputePassEncoder cpass_enc, uint32_t scope);
+
+/*
+ * Resolves the scopes of the frame after its command buffers were submitted.
+ * The results are read back asynchronously, a frame is dropped instead of
+ * stalling when all the readback buffers are still in use.
+ */
+void wgpu_pipeline_statistics_end_frame(
+  wgpu_pipeline_statistics_t* pipeline_statistics);
+
+/* Returns the results of the most recently read back frame */
+uint32_t wgpu_pipeline_statistics_get_results(
+  wgpu_pipeline_statistics_t* pipeline_statistics,
+  const wgpu_pipeline_statistics_result_t** results);
+
+#endif
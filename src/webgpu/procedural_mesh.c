@@ -0,0 +1,643 @@
+#include "procedural_mesh.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "pipeline_cache.h"
+#include "shader.h"
+
+#define PROCEDURAL_MESH_WORKGROUP_SIZE 64u
+/* Dynamic offsets are aligned to minUniformBufferOffsetAlignment */
+#define PROCEDURAL_MESH_PARAMS_STRIDE 256u
+
+/* Vertices and indices written per gear tooth */
+#define PROCEDURAL_MESH_GEAR_TOOTH_VERTEX_COUNT 40u
+#define PROCEDURAL_MESH_GEAR_TOOTH_INDEX_COUNT 66u
+
+/* Layout of Shape */
+typedef struct procedural_shape_params_t {
+  float color[4];
+  float params[4];
+  uint32_t segments[2];
+  uint32_t base_vertex;
+  uint32_t first_index;
+} procedural_shape_params_t;
+
+typedef struct procedural_shape_t {
+  wgpu_procedural_shape_enum_t shape;
+  procedural_shape_params_t params;
+  wgpu_procedural_mesh_range_t range;
+  uint32_t invocation_count;
+} procedural_shape_t;
+
+struct wgpu_procedural_mesh {
+  wgpu_context_t* wgpu_context;
+  procedural_shape_t shapes[WGPU_PROCEDURAL_MESH_MAX_SHAPE_COUNT];
+  uint32_t shape_count;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t vertices;
+  wgpu_buffer_t indices;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+  WGPUComputePipeline pipelines[WGPU_ProceduralShape_Count];
+};
+
+// clang-format off
+static const char* procedural_mesh_shader_wgsl = CODE(
+  struct Shape {
+    color : vec4<f32>,
+    params : vec4<f32>,
+    segments : vec2<u32>,
+    baseVertex : u32,
+    firstIndex : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> shape : Shape;
+  @group(0) @binding(1) var<storage, read_write> vertices : array<f32>;
+  @group(0) @binding(2) var<storage, read_write> indices : array<u32>;
+
+  const PI = 3.14159265359;
+
+  // Vertices of 12 floats: position, normal, uv and color
+  fn writeVertex(index : u32, position : vec3<f32>, normal : vec3<f32>,
+                 uv : vec2<f32>) {
+    let o = (shape.baseVertex + index) * 12u;
+    vertices[o + 0u] = position.x;
+    vertices[o + 1u] = position.y;
+    vertices[o + 2u] = position.z;
+    vertices[o + 3u] = normal.x;
+    vertices[o + 4u] = normal.y;
+    vertices[o + 5u] = normal.z;
+    vertices[o + 6u] = uv.x;
+    vertices[o + 7u] = uv.y;
+    vertices[o + 8u] = shape.color.r;
+    vertices[o + 9u] = shape.color.g;
+    vertices[o + 10u] = shape.color.b;
+    vertices[o + 11u] = shape.color.a;
+  }
+
+  // Grid vertex of the invocation, false past the last vertex
+  fn gridCoords(index : u32, coords : ptr<function, vec2<u32>>) -> bool {
+    let stride = shape.segments.x + 1u;
+    if (index >= stride * (shape.segments.y + 1u)) {
+      return false;
+    }
+    *coords = vec2<u32>(index % stride, index / stride);
+    return true;
+  }
+
+  // The two triangles of the cell to the upper right of the grid vertex
+  fn writeGridCell(coords : vec2<u32>) {
+    if (coords.x >= shape.segments.x || coords.y >= shape.segments.y) {
+      return;
+    }
+    let stride = shape.segments.x + 1u;
+    let leftBottom = coords.y * stride + coords.x;
+    let rightBottom = leftBottom + 1u;
+    let leftUp = leftBottom + stride;
+    let rightUp = leftUp + 1u;
+    let i = shape.firstIndex
+            + (coords.y * shape.segments.x + coords.x) * 6u;
+    indices[i + 0u] = leftUp;
+    indices[i + 1u] = leftBottom;
+    indices[i + 2u] = rightBottom;
+    indices[i + 3u] = rightUp;
+    indices[i + 4u] = leftUp;
+    indices[i + 5u] = rightBottom;
+  }
+
+  fn gridUV(coords : vec2<u32>) -> vec2<f32> {
+    return vec2<f32>(coords) / vec2<f32>(shape.segments);
+  }
+
+  // params: width, height
+  @compute @workgroup_size(64)
+  fn cs_plane(@builtin(global_invocation_id) id : vec3<u32>) {
+    var coords : vec2<u32>;
+    if (!gridCoords(id.x, &coords)) {
+      return;
+    }
+    let uv = gridUV(coords);
+    writeVertex(id.x, vec3<f32>(uv * shape.params.xy, 0.0),
+                vec3<f32>(0.0, 0.0, 1.0), vec2<f32>(uv.x, 1.0 - uv.y));
+    writeGridCell(coords);
+  }
+
+  // params: radius
+  @compute @workgroup_size(64)
+  fn cs_sphere(@builtin(global_invocation_id) id : vec3<u32>) {
+    var coords : vec2<u32>;
+    if (!gridCoords(id.x, &coords)) {
+      return;
+    }
+    let uv = gridUV(coords);
+    let phi = uv.x * 2.0 * PI;
+    let theta = uv.y * PI;
+    let normal = vec3<f32>(sin(theta) * cos(phi), -cos(theta),
+                           -sin(theta) * sin(phi));
+    writeVertex(id.x, normal * shape.params.x, normal,
+                vec2<f32>(uv.x, 1.0 - uv.y));
+    writeGridCell(coords);
+  }
+
+  // params: radius, tube radius
+  @compute @workgroup_size(64)
+  fn cs_torus(@builtin(global_invocation_id) id : vec3<u32>) {
+    var coords : vec2<u32>;
+    if (!gridCoords(id.x, &coords)) {
+      return;
+    }
+    let uv = gridUV(coords);
+    let alpha = uv.x * 2.0 * PI;
+    let beta = uv.y * 2.0 * PI;
+    let ring = vec3<f32>(cos(alpha), 0.0, -sin(alpha));
+    let normal = ring * cos(beta) + vec3<f32>(0.0, sin(beta), 0.0);
+    writeVertex(id.x, ring * shape.params.x + normal * shape.params.y,
+                normal, vec2<f32>(uv.x, 1.0 - uv.y));
+    writeGridCell(coords);
+  }
+
+  var<private> gearVertex : u32;
+  var<private> gearIndex : u32;
+
+  fn gearNewVertex(p : vec2<f32>, z : f32, normal : vec3<f32>) -> u32 {
+    writeVertex(gearVertex, vec3<f32>(p, z), normal, vec2<f32>(0.0));
+    gearVertex += 1u;
+    return gearVertex - 1u;
+  }
+
+  fn gearNewFace(a : u32, b : u32, c : u32) {
+    let i = shape.firstIndex + gearIndex;
+    indices[i + 0u] = a;
+    indices[i + 1u] = b;
+    indices[i + 2u] = c;
+    gearIndex += 3u;
+  }
+
+  // Faces of the quad strip a, b, c, d
+  fn gearNewQuad(a : u32, b : u32, c : u32, d : u32) {
+    gearNewFace(a, b, c);
+    gearNewFace(b, d, c);
+  }
+
+  // Quad across the width from p0 to p1, starting at z
+  fn gearNewSide(p0 : vec2<f32>, p1 : vec2<f32>, z : f32, n0 : vec3<f32>,
+                 n1 : vec3<f32>) {
+    let a = gearNewVertex(p0, z, n0);
+    let b = gearNewVertex(p0, -z, n0);
+    let c = gearNewVertex(p1, z, n1);
+    let d = gearNewVertex(p1, -z, n1);
+    gearNewQuad(a, b, c, d);
+  }
+
+  fn gearDirection(angle : f32) -> vec2<f32> {
+    return vec2<f32>(cos(angle), sin(angle));
+  }
+
+  // params: inner radius, outer radius, width, tooth depth, one invocation
+  // per tooth
+  @compute @workgroup_size(64)
+  fn cs_gear(@builtin(global_invocation_id) id : vec3<u32>) {
+    let toothCount = shape.segments.x;
+    if (id.x >= toothCount) {
+      return;
+    }
+    gearVertex = id.x * 40u;
+    gearIndex = id.x * 66u;
+
+    let r0 = shape.params.x;
+    let r1 = shape.params.y - shape.params.w * 0.5;
+    let r2 = shape.params.y + shape.params.w * 0.5;
+    let w = shape.params.z * 0.5;
+    let ta = f32(id.x) * 2.0 * PI / f32(toothCount);
+    let da = 2.0 * PI / f32(toothCount) / 4.0;
+    let d0 = gearDirection(ta);
+    let d1 = gearDirection(ta + da);
+    let d2 = gearDirection(ta + 2.0 * da);
+    let d3 = gearDirection(ta + 3.0 * da);
+    let d4 = gearDirection(ta + 4.0 * da);
+    let s1 = normalize(r2 * d1 - r1 * d0);
+    let s2 = normalize(r1 * d3 - r2 * d2);
+    let front = vec3<f32>(0.0, 0.0, 1.0);
+    let back = vec3<f32>(0.0, 0.0, -1.0);
+
+    // Front face
+    var a = gearNewVertex(r0 * d0, w, front);
+    var b = gearNewVertex(r1 * d0, w, front);
+    var c = gearNewVertex(r0 * d0, w, front);
+    var d = gearNewVertex(r1 * d3, w, front);
+    var e = gearNewVertex(r0 * d4, w, front);
+    var f = gearNewVertex(r1 * d4, w, front);
+    gearNewQuad(a, b, c, d);
+    gearNewQuad(c, d, e, f);
+
+    // Front sides of teeth
+    a = gearNewVertex(r1 * d0, w, front);
+    b = gearNewVertex(r2 * d1, w, front);
+    c = gearNewVertex(r1 * d3, w, front);
+    d = gearNewVertex(r2 * d2, w, front);
+    gearNewQuad(a, b, c, d);
+
+    // Back face
+    a = gearNewVertex(r1 * d0, -w, back);
+    b = gearNewVertex(r0 * d0, -w, back);
+    c = gearNewVertex(r1 * d3, -w, back);
+    d = gearNewVertex(r0 * d0, -w, back);
+    e = gearNewVertex(r1 * d4, -w, back);
+    f = gearNewVertex(r0 * d4, -w, back);
+    gearNewQuad(a, b, c, d);
+    gearNewQuad(c, d, e, f);
+
+    // Back sides of teeth
+    a = gearNewVertex(r1 * d3, -w, back);
+    b = gearNewVertex(r2 * d2, -w, back);
+    c = gearNewVertex(r1 * d0, -w, back);
+    d = gearNewVertex(r2 * d1, -w, back);
+    gearNewQuad(a, b, c, d);
+
+    // Outward faces of teeth
+    let s1Normal = vec3<f32>(s1.y, -s1.x, 0.0);
+    let s2Normal = vec3<f32>(s2.y, -s2.x, 0.0);
+    let radial = vec3<f32>(d0, 0.0);
+    gearNewSide(r1 * d0, r2 * d1, w, s1Normal, s1Normal);
+    gearNewSide(r2 * d1, r2 * d2, w, radial, radial);
+    gearNewSide(r2 * d2, r1 * d3, w, s2Normal, s2Normal);
+    gearNewSide(r1 * d3, r1 * d4, w, radial, radial);
+
+    // Inside radius cylinder
+    gearNewSide(r0 * d0, r0 * d4, -w, -radial, -vec3<f32>(d4, 0.0));
+  }
+);
+// clang-format on
+
+static const char* procedural_mesh_entry_points[WGPU_ProceduralShape_Count] = {
+  [WGPU_ProceduralShape_Plane]  = "cs_plane",
+  [WGPU_ProceduralShape_Sphere] = "cs_sphere",
+  [WGPU_ProceduralShape_Torus]  = "cs_torus",
+  [WGPU_ProceduralShape_Gear]   = "cs_gear",
+};
+
+static uint32_t procedural_mesh_div_ceil(uint32_t value, uint32_t divisor)
+{
+  return (value + divisor - 1) / divisor;
+}
+
+static void
+procedural_mesh_create_pipelines(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  wgpu_context_t* wgpu_context = procedural_mesh->wgpu_context;
+
+  WGPUBindGroupLayoutEntry bgl_entries[3] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Shape parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type             = WGPUBufferBindingType_Uniform,
+        .hasDynamicOffset = true,
+        .minBindingSize   = sizeof(procedural_shape_params_t),
+      },
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Vertices
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type = WGPUBufferBindingType_Storage,
+      },
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Indices
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Compute,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type = WGPUBufferBindingType_Storage,
+      },
+    },
+  };
+  procedural_mesh->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "procedural_mesh_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(procedural_mesh->bind_group_layout != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "procedural_mesh_layout",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts
+                            = &procedural_mesh->bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "procedural_mesh_shader",
+                    .wgsl_code.source = procedural_mesh_shader_wgsl,
+                    .entry            = procedural_mesh_entry_points[0],
+                  });
+  for (uint32_t i = 0; i < (uint32_t)WGPU_ProceduralShape_Count; ++i) {
+    WGPUProgrammableStageDescriptor stage
+      = comp_shader.programmable_stage_descriptor;
+    stage.entryPoint              = procedural_mesh_entry_points[i];
+    procedural_mesh->pipelines[i] = wgpu_pipeline_cache_get_compute_pipeline(
+      wgpu_context, &(WGPUComputePipelineDescriptor){
+                      .label   = "procedural_mesh_pipeline",
+                      .layout  = pipeline_layout,
+                      .compute = stage,
+                    });
+    ASSERT(procedural_mesh->pipelines[i] != NULL);
+  }
+
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+}
+
+wgpu_procedural_mesh_t*
+wgpu_procedural_mesh_create(wgpu_context_t* wgpu_context)
+{
+  wgpu_procedural_mesh_t* procedural_mesh
+    = (wgpu_procedural_mesh_t*)malloc(sizeof(wgpu_procedural_mesh_t));
+  memset(procedural_mesh, 0, sizeof(wgpu_procedural_mesh_t));
+  procedural_mesh->wgpu_context = wgpu_context;
+
+  procedural_mesh->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "procedural_mesh_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = WGPU_PROCEDURAL_MESH_MAX_SHAPE_COUNT
+                            * PROCEDURAL_MESH_PARAMS_STRIDE,
+                  });
+
+  procedural_mesh_create_pipelines(procedural_mesh);
+
+  return procedural_mesh;
+}
+
+static void
+procedural_mesh_release_buffers(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  WGPU_RELEASE_RESOURCE(BindGroup, procedural_mesh->bind_group)
+  WGPU_RELEASE_RESOURCE(Buffer, procedural_mesh->vertices.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, procedural_mesh->indices.buffer)
+}
+
+void wgpu_procedural_mesh_release(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  if (procedural_mesh == NULL) {
+    return;
+  }
+
+  procedural_mesh_release_buffers(procedural_mesh);
+  for (uint32_t i = 0; i < (uint32_t)WGPU_ProceduralShape_Count; ++i) {
+    WGPU_RELEASE_RESOURCE(ComputePipeline, procedural_mesh->pipelines[i])
+  }
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, procedural_mesh->bind_group_layout)
+  wgpu_destroy_buffer(&procedural_mesh->params_buffer);
+  free(procedural_mesh);
+}
+
+uint32_t
+wgpu_procedural_mesh_add_shape(wgpu_procedural_mesh_t* procedural_mesh,
+                               const wgpu_procedural_shape_desc_t* desc)
+{
+  ASSERT(procedural_mesh->shape_count < WGPU_PROCEDURAL_MESH_MAX_SHAPE_COUNT);
+
+  procedural_shape_t* shape
+    = &procedural_mesh->shapes[procedural_mesh->shape_count];
+  memset(shape, 0, sizeof(procedural_shape_t));
+  shape->shape                      = desc->shape;
+  procedural_shape_params_t* params = &shape->params;
+  memcpy(params->color, desc->color, sizeof(params->color));
+
+  uint32_t columns = 0, rows = 0;
+  switch (desc->shape) {
+    case WGPU_ProceduralShape_Plane:
+      params->params[0] = desc->plane.width;
+      params->params[1] = desc->plane.height;
+      columns           = desc->plane.columns;
+      rows              = desc->plane.rows;
+      break;
+    case WGPU_ProceduralShape_Sphere:
+      params->params[0] = desc->sphere.radius;
+      columns           = desc->sphere.segments;
+      rows              = desc->sphere.rings;
+      break;
+    case WGPU_ProceduralShape_Torus:
+      params->params[0] = desc->torus.radius;
+      params->params[1] = desc->torus.tube_radius;
+      columns           = desc->torus.segments;
+      rows              = desc->torus.sides;
+      break;
+    case WGPU_ProceduralShape_Gear:
+      params->params[0] = desc->gear.inner_radius;
+      params->params[1] = desc->gear.outer_radius;
+      params->params[2] = desc->gear.width;
+      params->params[3] = desc->gear.tooth_depth;
+      columns           = desc->gear.tooth_count;
+      rows              = 1;
+      break;
+    default:
+      ASSERT(false);
+      break;
+  }
+  ASSERT(columns > 0 && rows > 0);
+  params->segments[0] = columns;
+  params->segments[1] = rows;
+
+  wgpu_procedural_mesh_range_t* range = &shape->range;
+  if (desc->shape == WGPU_ProceduralShape_Gear) {
+    range->vertex_count     = columns * PROCEDURAL_MESH_GEAR_TOOTH_VERTEX_COUNT;
+    range->index_count      = columns * PROCEDURAL_MESH_GEAR_TOOTH_INDEX_COUNT;
+    shape->invocation_count = columns;
+  }
+  else {
+    range->vertex_count     = (columns + 1) * (rows + 1);
+    range->index_count      = columns * rows * 6;
+    shape->invocation_count = range->vertex_count;
+  }
+  range->base_vertex  = procedural_mesh->vertex_count;
+  range->first_index  = procedural_mesh->index_count;
+  params->base_vertex = range->base_vertex;
+  params->first_index = range->first_index;
+
+  procedural_mesh->vertex_count += range->vertex_count;
+  procedural_mesh->index_count += range->index_count;
+  return procedural_mesh->shape_count++;
+}
+
+void wgpu_procedural_mesh_clear(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  procedural_mesh->shape_count  = 0;
+  procedural_mesh->vertex_count = 0;
+  procedural_mesh->index_count  = 0;
+}
+
+uint32_t
+wgpu_procedural_mesh_get_shape_count(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  return procedural_mesh->shape_count;
+}
+
+wgpu_procedural_mesh_range_t
+wgpu_procedural_mesh_get_range(wgpu_procedural_mesh_t* procedural_mesh,
+                               uint32_t shape)
+{
+  ASSERT(shape < procedural_mesh->shape_count);
+  return procedural_mesh->shapes[shape].range;
+}
+
+/* Creates the buffers and the bind group when the shapes outgrow them */
+static void
+procedural_mesh_reserve_buffers(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  wgpu_context_t* wgpu_context = procedural_mesh->wgpu_context;
+  const uint32_t vertices_size
+    = procedural_mesh->vertex_count * sizeof(wgpu_procedural_vertex_t);
+  const uint32_t indices_size = procedural_mesh->index_count * sizeof(uint32_t);
+  if (procedural_mesh->bind_group != NULL
+      && vertices_size <= procedural_mesh->vertices.size
+      && indices_size <= procedural_mesh->indices.size) {
+    return;
+  }
+
+  procedural_mesh_release_buffers(procedural_mesh);
+  procedural_mesh->vertices = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "procedural_mesh_vertices",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex,
+                    .size  = vertices_size,
+                    .count = procedural_mesh->vertex_count,
+                  });
+  procedural_mesh->indices = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "procedural_mesh_indices",
+                    .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Index,
+                    .size  = indices_size,
+                    .count = procedural_mesh->index_count,
+                  });
+
+  WGPUBindGroupEntry bg_entries[3] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = procedural_mesh->params_buffer.buffer,
+      .size    = sizeof(procedural_shape_params_t),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding = 1,
+      .buffer  = procedural_mesh->vertices.buffer,
+      .size    = procedural_mesh->vertices.size,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .buffer  = procedural_mesh->indices.buffer,
+      .size    = procedural_mesh->indices.size,
+    },
+  };
+  procedural_mesh->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label  = "procedural_mesh_bind_group",
+                            .layout = procedural_mesh->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(procedural_mesh->bind_group != NULL);
+}
+
+void wgpu_procedural_mesh_record(wgpu_procedural_mesh_t* procedural_mesh,
+                                 WGPUComputePassEncoder pass_encoder)
+{
+  if (procedural_mesh->shape_count == 0) {
+    return;
+  }
+
+  procedural_mesh_reserve_buffers(procedural_mesh);
+
+  // Parameters of all shapes, one dynamic offset per shape
+  uint8_t params_data[WGPU_PROCEDURAL_MESH_MAX_SHAPE_COUNT
+                      * PROCEDURAL_MESH_PARAMS_STRIDE];
+  memset(params_data, 0, sizeof(params_data));
+  for (uint32_t i = 0; i < procedural_mesh->shape_count; ++i) {
+    memcpy(&params_data[i * PROCEDURAL_MESH_PARAMS_STRIDE],
+           &procedural_mesh->shapes[i].params,
+           sizeof(procedural_shape_params_t));
+  }
+  wgpu_queue_write_buffer(
+    procedural_mesh->wgpu_context, procedural_mesh->params_buffer.buffer, 0,
+    params_data, procedural_mesh->shape_count * PROCEDURAL_MESH_PARAMS_STRIDE);
+
+  for (uint32_t i = 0; i < procedural_mesh->shape_count; ++i) {
+    const procedural_shape_t* shape = &procedural_mesh->shapes[i];
+    const uint32_t dynamic_offset   = i * PROCEDURAL_MESH_PARAMS_STRIDE;
+    wgpuComputePassEncoderSetPipeline(
+      pass_encoder, procedural_mesh->pipelines[shape->shape]);
+    wgpuComputePassEncoderSetBindGroup(
+      pass_encoder, 0, procedural_mesh->bind_group, 1, &dynamic_offset);
+    wgpuComputePassEncoderDispatchWorkgroups(
+      pass_encoder,
+      procedural_mesh_div_ceil(shape->invocation_count,
+                               PROCEDURAL_MESH_WORKGROUP_SIZE),
+      1, 1);
+  }
+}
+
+void wgpu_procedural_mesh_generate(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  wgpu_context_t* wgpu_context = procedural_mesh->wgpu_context;
+
+  WGPUCommandEncoder cmd_encoder
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder pass_encoder
+    = wgpuCommandEncoderBeginComputePass(cmd_encoder, NULL);
+  wgpu_procedural_mesh_record(procedural_mesh, pass_encoder);
+  wgpuComputePassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass_encoder)
+  WGPUCommandBuffer command_buffer
+    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  ASSERT(command_buffer != NULL);
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+}
+
+const wgpu_buffer_t*
+wgpu_procedural_mesh_get_vertices(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  return &procedural_mesh->vertices;
+}
+
+const wgpu_buffer_t*
+wgpu_procedural_mesh_get_indices(wgpu_procedural_mesh_t* procedural_mesh)
+{
+  return &procedural_mesh->indices;
+}
+
+void wgpu_procedural_mesh_bind(wgpu_procedural_mesh_t* procedural_mesh,
+                               WGPURenderPassEncoder rpass_enc, uint32_t slot)
+{
+  wgpuRenderPassEncoderSetVertexBuffer(rpass_enc, slot,
+                                       procedural_mesh->vertices.buffer, 0,
+                                       WGPU_WHOLE_SIZE);
+  wgpuRenderPassEncoderSetIndexBuffer(rpass_enc,
+                                      procedural_mesh->indices.buffer,
+                                      WGPUIndexFormat_Uint32, 0,
+                                      WGPU_WHOLE_SIZE);
+}
+
+void wgpu_procedural_mesh_draw(wgpu_procedural_mesh_t* procedural_mesh,
+                               WGPURenderPassEncoder rpass_enc, uint32_t shape,
+                               uint32_t instance_count,
+                               uint32_t first_instance)
+{
+  const wgpu_procedural_mesh_range_t range
+    = wgpu_procedural_mesh_get_range(procedural_mesh, shape);
+  wgpuRenderPassEncoderDrawIndexed(rpass_enc, range.index_count,
+                                   instance_count, range.first_index,
+                                   (int32_t)range.base_vertex, first_instance);
+}
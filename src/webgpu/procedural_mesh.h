@@ -0,0 +1,125 @@
+#ifndef PROCEDURAL_MESH_H
+#define PROCEDURAL_MESH_H
+
+#include "buffer.h"
+#include "context.h"
+
+#define WGPU_PROCEDURAL_MESH_MAX_SHAPE_COUNT 64u
+
+typedef struct wgpu_procedural_mesh wgpu_procedural_mesh_t;
+
+/* Layout of the generated vertices, the vertex buffer attributes */
+typedef struct wgpu_procedural_vertex_t {
+  float position[3];
+  float normal[3];
+  float uv[2];
+  float color[4];
+} wgpu_procedural_vertex_t;
+
+typedef enum wgpu_procedural_shape_enum_t {
+  WGPU_ProceduralShape_Plane  = 0,
+  WGPU_ProceduralShape_Sphere = 1,
+  WGPU_ProceduralShape_Torus  = 2,
+  WGPU_ProceduralShape_Gear   = 3,
+  WGPU_ProceduralShape_Count  = 4,
+} wgpu_procedural_shape_enum_t;
+
+/* Parametric description of a shape, the member of the shape type is used */
+typedef struct wgpu_procedural_shape_desc_t {
+  wgpu_procedural_shape_enum_t shape;
+  /* Grid in the xy plane from the origin to (width, height), facing +z */
+  struct {
+    float width;
+    float height;
+    uint32_t columns;
+    uint32_t rows;
+  } plane;
+  /* Sphere centered on the origin, rings from -y to +y */
+  struct {
+    float radius;
+    uint32_t segments;
+    uint32_t rings;
+  } sphere;
+  /* Torus around the y axis */
+  struct {
+    float radius;
+    float tube_radius;
+    uint32_t segments;
+    uint32_t sides;
+  } torus;
+  /* Gear of glxgears around the z axis, centered on the origin */
+  struct {
+    float inner_radius;
+    float outer_radius;
+    float width;
+    float tooth_depth;
+    uint32_t tooth_count;
+  } gear;
+  /* Color of all vertices */
+  float color[4];
+} wgpu_procedural_shape_desc_t;
+
+/* Ranges of a shape in the vertex and index buffers, the indices are relative
+ * to base_vertex */
+typedef struct wgpu_procedural_mesh_range_t {
+  uint32_t base_vertex;
+  uint32_t vertex_count;
+  uint32_t first_index;
+  uint32_t index_count;
+} wgpu_procedural_mesh_range_t;
+
+/*
+ * Procedural mesh generation on the GPU: compute shaders expand parametric
+ * shapes into a vertex and an index storage buffer that are bound as vertex
+ * and index buffer for drawing, so that high tessellations are regenerated
+ * without building and uploading the geometry on the CPU.
+ *
+ * The shapes are appended one after the other, the grid shapes (plane,
+ * sphere, torus) run one invocation per vertex writing the two triangles of
+ * the cell to its upper right, counter-clockwise seen from the front, the
+ * gears one invocation per tooth writing the faces of the CPU glxgears.
+ */
+wgpu_procedural_mesh_t*
+wgpu_procedural_mesh_create(wgpu_context_t* wgpu_context);
+void wgpu_procedural_mesh_release(wgpu_procedural_mesh_t* procedural_mesh);
+
+/* Appends a shape, returns its index. The geometry is written by the next
+ * record or generate. */
+uint32_t
+wgpu_procedural_mesh_add_shape(wgpu_procedural_mesh_t* procedural_mesh,
+                               const wgpu_procedural_shape_desc_t* desc);
+/* Removes the shapes, e.g. to add them again with other parameters */
+void wgpu_procedural_mesh_clear(wgpu_procedural_mesh_t* procedural_mesh);
+
+uint32_t
+wgpu_procedural_mesh_get_shape_count(wgpu_procedural_mesh_t* procedural_mesh);
+wgpu_procedural_mesh_range_t
+wgpu_procedural_mesh_get_range(wgpu_procedural_mesh_t* procedural_mesh,
+                               uint32_t shape);
+
+/**
+ * @brief Records the generation of all shapes. The buffers are created again
+ * when the shapes outgrow them, buffers returned before are released then.
+ */
+void wgpu_procedural_mesh_record(wgpu_procedural_mesh_t* procedural_mesh,
+                                 WGPUComputePassEncoder pass_encoder);
+/* Records the generation in a command buffer of its own and submits it */
+void wgpu_procedural_mesh_generate(wgpu_procedural_mesh_t* procedural_mesh);
+
+/* Vertex buffer of wgpu_procedural_vertex_t, also bound as storage */
+const wgpu_buffer_t*
+wgpu_procedural_mesh_get_vertices(wgpu_procedural_mesh_t* procedural_mesh);
+/* Uint32 index buffer, also bound as storage */
+const wgpu_buffer_t*
+wgpu_procedural_mesh_get_indices(wgpu_procedural_mesh_t* procedural_mesh);
+
+/* Binds the vertex buffer at the slot and the index buffer */
+void wgpu_procedural_mesh_bind(wgpu_procedural_mesh_t* procedural_mesh,
+                               WGPURenderPassEncoder rpass_enc, uint32_t slot);
+/* Draws the shape instanced, the buffers being bound */
+void wgpu_procedural_mesh_draw(wgpu_procedural_mesh_t* procedural_mesh,
+                               WGPURenderPassEncoder rpass_enc, uint32_t shape,
+                               uint32_t instance_count,
+                               uint32_t first_instance);
+
+#endif
@@ -0,0 +1,491 @@
+#include "readback.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/job_system.h"
+#include "../core/log.h"
+#include "../core/macro.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+/* Row pitch alignment of texture to buffer copies */
+#define WGPU_COPY_BYTES_PER_ROW_ALIGNMENT 256u
+
+typedef enum wgpu_readback_state_enum {
+  ReadbackState_Free       = 0,
+  ReadbackState_Copied     = 1, /* copy recorded, not yet mapped */
+  ReadbackState_Mapping    = 2, /* map requested */
+  ReadbackState_Processing = 3, /* mapped, read by a worker thread */
+} wgpu_readback_state_enum;
+
+typedef struct wgpu_readback_buffer_t {
+  struct wgpu_readback* readback;
+  WGPUBuffer buffer;
+  wgpu_readback_state_enum state;
+  uint64_t copy_update_index; /* update in which the copy was recorded */
+  uint64_t frame_number;
+  const uint8_t* mapping;
+  char filename[STRMAX];
+} wgpu_readback_buffer_t;
+
+struct wgpu_readback {
+  wgpu_context_t* wgpu_context;
+  WGPUTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytes_per_row; /* padded row pitch of the readback buffers */
+  uint32_t buffer_count;
+  uint32_t buffer_index;
+  wgpu_readback_buffer_t buffers[WGPU_READBACK_MAX_BUFFER_COUNT];
+  uint32_t map_delay;
+  uint64_t update_index;
+  wgpu_readback_file_format_enum file_format;
+  char output_directory[PATH_SIZE];
+  char file_prefix[STRMAX];
+  wgpu_readback_func_t func;
+  void* user_data;
+  uint32_t dropped_count;
+  char last_filename[STRMAX];
+  bool flushing; /* map callbacks process the buffers on the main thread */
+  job_counter_t process_counter;
+};
+
+/* Unpads the rows, swizzles to RGBA8 and writes the image */
+static void wgpu_readback_process(void* user_data)
+{
+  wgpu_readback_buffer_t* rb_buffer = (wgpu_readback_buffer_t*)user_data;
+  wgpu_readback_t* readback         = rb_buffer->readback;
+  const uint32_t width              = readback->width;
+  const uint32_t height             = readback->height;
+  const bool bgra = readback->format == WGPUTextureFormat_BGRA8Unorm
+                    || readback->format == WGPUTextureFormat_BGRA8UnormSrgb;
+  uint8_t* pixels = (uint8_t*)malloc((size_t)width * height * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t* src
+      = rb_buffer->mapping + (size_t)y * readback->bytes_per_row;
+    uint8_t* dst = pixels + (size_t)y * width * 4;
+    if (!bgra) {
+      memcpy(dst, src, (size_t)width * 4);
+      continue;
+    }
+    for (uint32_t x = 0; x < width; ++x) {
+      dst[x * 4 + 0] = src[x * 4 + 2];
+      dst[x * 4 + 1] = src[x * 4 + 1];
+      dst[x * 4 + 2] = src[x * 4 + 0];
+      dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+  }
+
+  bool written = false;
+  if (readback->file_format == ReadbackFileFormat_Png) {
+    written = stbi_write_png(rb_buffer->filename, (int)width, (int)height, 4,
+                             pixels, (int)(width * 4))
+              != 0;
+  }
+  else if (readback->file_format == ReadbackFileFormat_Raw) {
+    FILE* file = fopen(rb_buffer->filename, "wb");
+    if (file != NULL) {
+      const size_t size = (size_t)width * height * 4;
+      written           = fwrite(pixels, 1, size, file) == size;
+      fclose(file);
+    }
+  }
+  if (readback->file_format != ReadbackFileFormat_None && !written) {
+    log_error("Could not write %s", rb_buffer->filename);
+    rb_buffer->filename[0] = '\0';
+  }
+
+  if (readback->func != NULL) {
+    readback->func(
+      &(wgpu_readback_image_t){
+        .width        = width,
+        .height       = height,
+        .frame_number = rb_buffer->frame_number,
+        .pixels       = pixels,
+      },
+      readback->user_data);
+  }
+  free(pixels);
+}
+
+/* Runs on the main thread once the buffer has been processed */
+static void wgpu_readback_finish(void* user_data)
+{
+  wgpu_readback_buffer_t* rb_buffer = (wgpu_readback_buffer_t*)user_data;
+  wgpu_readback_t* readback         = rb_buffer->readback;
+  wgpuBufferUnmap(rb_buffer->buffer);
+  rb_buffer->mapping = NULL;
+  rb_buffer->state   = ReadbackState_Free;
+  if (rb_buffer->filename[0] != '\0') {
+    snprintf(readback->last_filename, sizeof(readback->last_filename), "%s",
+             rb_buffer->filename);
+  }
+}
+
+static void wgpu_readback_map_cb(WGPUBufferMapAsyncStatus status,
+                                 void* user_data)
+{
+  wgpu_readback_buffer_t* rb_buffer = (wgpu_readback_buffer_t*)user_data;
+  wgpu_readback_t* readback         = rb_buffer->readback;
+  if (status != WGPUBufferMapAsyncStatus_Success) {
+    log_warn("Readback of frame %llu failed (status: %d)",
+             (unsigned long long)rb_buffer->frame_number, status);
+    rb_buffer->state = ReadbackState_Free;
+    return;
+  }
+
+  rb_buffer->state   = ReadbackState_Processing;
+  rb_buffer->mapping = (const uint8_t*)wgpuBufferGetConstMappedRange(
+    rb_buffer->buffer, 0, (size_t)readback->bytes_per_row * readback->height);
+  ASSERT(rb_buffer->mapping != NULL);
+  if (readback->flushing) {
+    wgpu_readback_process(rb_buffer);
+    wgpu_readback_finish(rb_buffer);
+    return;
+  }
+  job_system_submit(job_system_get_shared(),
+                    &(job_desc_t){
+                      .func            = wgpu_readback_process,
+                      .user_data       = rb_buffer,
+                      .completion      = wgpu_readback_finish,
+                      .completion_data = rb_buffer,
+                    },
+                    &readback->process_counter);
+}
+
+static void wgpu_readback_map(wgpu_readback_t* readback,
+                              wgpu_readback_buffer_t* rb_buffer)
+{
+  rb_buffer->state = ReadbackState_Mapping;
+  wgpuBufferMapAsync(rb_buffer->buffer, WGPUMapMode_Read, 0,
+                     (uint64_t)readback->bytes_per_row * readback->height,
+                     wgpu_readback_map_cb, rb_buffer);
+}
+
+wgpu_readback_t* wgpu_readback_create(wgpu_context_t* wgpu_context,
+                                      const wgpu_readback_desc_t* desc)
+{
+  ASSERT(desc->width > 0 && desc->height > 0);
+  ASSERT(desc->format == WGPUTextureFormat_RGBA8Unorm
+         || desc->format == WGPUTextureFormat_RGBA8UnormSrgb
+         || desc->format == WGPUTextureFormat_BGRA8Unorm
+         || desc->format == WGPUTextureFormat_BGRA8UnormSrgb);
+
+  wgpu_readback_t* readback
+    = (wgpu_readback_t*)malloc(sizeof(wgpu_readback_t));
+  memset(readback, 0, sizeof(wgpu_readback_t));
+  readback->wgpu_context = wgpu_context;
+  readback->format       = desc->format;
+  readback->width        = desc->width;
+  readback->height       = desc->height;
+  readback->bytes_per_row
+    = (desc->width * 4 + WGPU_COPY_BYTES_PER_ROW_ALIGNMENT - 1)
+      & ~(WGPU_COPY_BYTES_PER_ROW_ALIGNMENT - 1);
+  readback->buffer_count = desc->buffer_count > 0 ? desc->buffer_count : 3u;
+  readback->buffer_count
+    = CLAMP(readback->buffer_count, 1u, WGPU_READBACK_MAX_BUFFER_COUNT);
+  readback->map_delay   = desc->map_delay;
+  readback->file_format = desc->file_format;
+  snprintf(readback->output_directory, sizeof(readback->output_directory),
+           "%s", desc->output_directory != NULL ? desc->output_directory : ".");
+  snprintf(readback->file_prefix, sizeof(readback->file_prefix), "%s",
+           desc->file_prefix != NULL ? desc->file_prefix : "frame");
+  readback->func      = desc->func;
+  readback->user_data = desc->user_data;
+
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    wgpu_readback_buffer_t* rb_buffer = &readback->buffers[i];
+    rb_buffer->readback               = readback;
+    rb_buffer->buffer                 = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .label = "readback_buffer",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+        .size  = (uint64_t)readback->bytes_per_row * readback->height,
+      });
+    ASSERT(rb_buffer->buffer != NULL);
+  }
+
+  return readback;
+}
+
+void wgpu_readback_release(wgpu_readback_t* readback)
+{
+  /* Mapped buffers must not be released before their callback has run */
+  wgpu_readback_flush(readback);
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    WGPU_RELEASE_RESOURCE(Buffer, readback->buffers[i].buffer)
+  }
+  if (readback->dropped_count > 0) {
+    log_warn("Readback: %u frames dropped", readback->dropped_count);
+  }
+  free(readback);
+}
+
+bool wgpu_readback_copy_texture(wgpu_readback_t* readback,
+                                WGPUCommandEncoder cmd_enc,
+                                WGPUTexture texture, uint64_t frame_number)
+{
+  wgpu_readback_buffer_t* rb_buffer
+    = &readback->buffers[readback->buffer_index];
+  if (rb_buffer->state != ReadbackState_Free) {
+    ++readback->dropped_count;
+    return false;
+  }
+
+  wgpuCommandEncoderCopyTextureToBuffer(
+    cmd_enc,
+    &(WGPUImageCopyTexture){
+      .texture = texture,
+    },
+    &(WGPUImageCopyBuffer){
+      .buffer = rb_buffer->buffer,
+      .layout = (WGPUTextureDataLayout){
+        .bytesPerRow  = readback->bytes_per_row,
+        .rowsPerImage = readback->height,
+      },
+    },
+    &(WGPUExtent3D){
+      .width              = readback->width,
+      .height             = readback->height,
+      .depthOrArrayLayers = 1,
+    });
+
+  rb_buffer->state             = ReadbackState_Copied;
+  rb_buffer->copy_update_index = readback->update_index;
+  rb_buffer->frame_number      = frame_number;
+  if (readback->file_format != ReadbackFileFormat_None) {
+    snprintf(rb_buffer->filename, sizeof(rb_buffer->filename),
+             "%s/%s_%06llu.%s", readback->output_directory,
+             readback->file_prefix, (unsigned long long)frame_number,
+             readback->file_format == ReadbackFileFormat_Png ? "png" : "rgba");
+  }
+  else {
+    rb_buffer->filename[0] = '\0';
+  }
+  readback->buffer_index
+    = (readback->buffer_index + 1) % readback->buffer_count;
+  return true;
+}
+
+void wgpu_readback_update(wgpu_readback_t* readback)
+{
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    wgpu_readback_buffer_t* rb_buffer = &readback->buffers[i];
+    if (rb_buffer->state == ReadbackState_Copied
+        && readback->update_index - rb_buffer->copy_update_index
+             >= readback->map_delay) {
+      wgpu_readback_map(readback, rb_buffer);
+    }
+  }
+  ++readback->update_index;
+}
+
+void wgpu_readback_flush(wgpu_readback_t* readback)
+{
+  /* Buffers already handed to the job system finish there, the remaining ones
+   * are processed right in their map callback */
+  readback->flushing = true;
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    wgpu_readback_buffer_t* rb_buffer = &readback->buffers[i];
+    while (rb_buffer->state == ReadbackState_Processing) {
+      job_system_t* job_system = job_system_get_shared();
+      if (!job_counter_is_done(&readback->process_counter)) {
+        job_system_wait(job_system, &readback->process_counter);
+      }
+      job_system_process_completions(job_system);
+    }
+    if (rb_buffer->state == ReadbackState_Copied) {
+      wgpu_readback_map(readback, rb_buffer);
+    }
+    while (rb_buffer->state == ReadbackState_Mapping) {
+      wgpuDeviceTick(readback->wgpu_context->device);
+    }
+  }
+  readback->flushing = false;
+}
+
+uint32_t wgpu_readback_get_dropped_count(wgpu_readback_t* readback)
+{
+  return readback->dropped_count;
+}
+
+const char* wgpu_readback_get_last_filename(wgpu_readback_t* readback)
+{
+  return readback->last_filename;
+}
+
+/* -------------------------------------------------------------------------- *
+ * Buffer readback
+ * -------------------------------------------------------------------------- */
+
+typedef struct wgpu_buffer_readback_buffer_t {
+  struct wgpu_buffer_readback* readback;
+  WGPUBuffer buffer;
+  wgpu_readback_state_enum state;
+  uint64_t copy_update_index; /* update in which the copy was recorded */
+  uint64_t frame_number;
+  uint64_t size; /* size of the recorded copy */
+} wgpu_buffer_readback_buffer_t;
+
+struct wgpu_buffer_readback {
+  wgpu_context_t* wgpu_context;
+  uint64_t size;
+  uint32_t buffer_count;
+  uint32_t buffer_index;
+  wgpu_buffer_readback_buffer_t buffers[WGPU_READBACK_MAX_BUFFER_COUNT];
+  uint32_t map_delay;
+  uint64_t update_index;
+  uint32_t mapping_count; /* buffers in the mapping state */
+  wgpu_buffer_readback_func_t func;
+  void* user_data;
+  uint32_t dropped_count;
+};
+
+static void wgpu_buffer_readback_map_cb(WGPUBufferMapAsyncStatus status,
+                                        void* user_data)
+{
+  wgpu_buffer_readback_buffer_t* rb_buffer
+    = (wgpu_buffer_readback_buffer_t*)user_data;
+  wgpu_buffer_readback_t* readback = rb_buffer->readback;
+  --readback->mapping_count;
+  if (status != WGPUBufferMapAsyncStatus_Success) {
+    log_warn("Buffer readback of frame %llu failed (status: %d)",
+             (unsigned long long)rb_buffer->frame_number, status);
+    rb_buffer->state = ReadbackState_Free;
+    return;
+  }
+
+  const void* mapping
+    = wgpuBufferGetConstMappedRange(rb_buffer->buffer, 0, rb_buffer->size);
+  ASSERT(mapping != NULL);
+  if (readback->func != NULL) {
+    readback->func(mapping, rb_buffer->size, rb_buffer->frame_number,
+                   readback->user_data);
+  }
+  wgpuBufferUnmap(rb_buffer->buffer);
+  rb_buffer->state = ReadbackState_Free;
+}
+
+static void wgpu_buffer_readback_map(wgpu_buffer_readback_t* readback,
+                                     wgpu_buffer_readback_buffer_t* rb_buffer)
+{
+  rb_buffer->state = ReadbackState_Mapping;
+  ++readback->mapping_count;
+  wgpuBufferMapAsync(rb_buffer->buffer, WGPUMapMode_Read, 0, rb_buffer->size,
+                     wgpu_buffer_readback_map_cb, rb_buffer);
+}
+
+wgpu_buffer_readback_t*
+wgpu_buffer_readback_create(wgpu_context_t* wgpu_context,
+                            const wgpu_buffer_readback_desc_t* desc)
+{
+  ASSERT(desc->size > 0 && desc->size % 4 == 0);
+
+  wgpu_buffer_readback_t* readback
+    = (wgpu_buffer_readback_t*)malloc(sizeof(wgpu_buffer_readback_t));
+  memset(readback, 0, sizeof(wgpu_buffer_readback_t));
+  readback->wgpu_context = wgpu_context;
+  readback->size         = desc->size;
+  readback->buffer_count = desc->buffer_count > 0 ? desc->buffer_count : 3u;
+  readback->buffer_count
+    = CLAMP(readback->buffer_count, 1u, WGPU_READBACK_MAX_BUFFER_COUNT);
+  readback->map_delay = desc->map_delay;
+  readback->func      = desc->func;
+  readback->user_data = desc->user_data;
+
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    wgpu_buffer_readback_buffer_t* rb_buffer = &readback->buffers[i];
+    rb_buffer->readback                      = readback;
+    rb_buffer->buffer                        = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .label = "buffer_readback_buffer",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+        .size  = readback->size,
+      });
+    ASSERT(rb_buffer->buffer != NULL);
+  }
+
+  return readback;
+}
+
+void wgpu_buffer_readback_release(wgpu_buffer_readback_t* readback)
+{
+  if (readback == NULL) {
+    return;
+  }
+
+  /* Mapped buffers must not be released before their callback has run */
+  wgpu_buffer_readback_flush(readback);
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    WGPU_RELEASE_RESOURCE(Buffer, readback->buffers[i].buffer)
+  }
+  if (readback->dropped_count > 0) {
+    log_warn("Buffer readback: %u copies dropped", readback->dropped_count);
+  }
+  free(readback);
+}
+
+bool wgpu_buffer_readback_copy_buffer(wgpu_buffer_readback_t* readback,
+                                      WGPUCommandEncoder cmd_enc,
+                                      WGPUBuffer buffer, uint64_t offset,
+                                      uint64_t size, uint64_t frame_number)
+{
+  ASSERT(size > 0 && size <= readback->size && size % 4 == 0);
+
+  wgpu_buffer_readback_buffer_t* rb_buffer
+    = &readback->buffers[readback->buffer_index];
+  if (rb_buffer->state != ReadbackState_Free) {
+    ++readback->dropped_count;
+    return false;
+  }
+
+  wgpuCommandEncoderCopyBufferToBuffer(cmd_enc, buffer, offset,
+                                       rb_buffer->buffer, 0, size);
+  rb_buffer->state             = ReadbackState_Copied;
+  rb_buffer->copy_update_index = readback->update_index;
+  rb_buffer->frame_number      = frame_number;
+  rb_buffer->size              = size;
+  readback->buffer_index
+    = (readback->buffer_index + 1) % readback->buffer_count;
+  return true;
+}
+
+void wgpu_buffer_readback_update(wgpu_buffer_readback_t* readback)
+{
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    wgpu_buffer_readback_buffer_t* rb_buffer = &readback->buffers[i];
+    if (rb_buffer->state == ReadbackState_Copied
+        && readback->update_index - rb_buffer->copy_update_index
+             >= readback->map_delay) {
+      wgpu_buffer_readback_map(readback, rb_buffer);
+    }
+  }
+  /* Delivers the maps completed meanwhile, without waiting for the others */
+  if (readback->mapping_count > 0) {
+    wgpuDeviceTick(readback->wgpu_context->device);
+  }
+  ++readback->update_index;
+}
+
+void wgpu_buffer_readback_flush(wgpu_buffer_readback_t* readback)
+{
+  for (uint32_t i = 0; i < readback->buffer_count; ++i) {
+    if (readback->buffers[i].state == ReadbackState_Copied) {
+      wgpu_buffer_readback_map(readback, &readback->buffers[i]);
+    }
+  }
+  while (readback->mapping_count > 0) {
+    wgpuDeviceTick(readback->wgpu_context->device);
+  }
+}
+
+uint32_t wgpu_buffer_readback_get_dropped_count(
+  wgpu_buffer_readback_t* readback)
+{
+  return readback->dropped_count;
+}
@@ -0,0 +1,136 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include "context.h"
+
+#define WGPU_READBACK_MAX_BUFFER_COUNT 8u
+
+/*
+ * Pipelined texture readback: copies go into a ring of readback buffers and
+ * every buffer is only mapped a few frames after its copy was recorded, so
+ * that the map never waits for the GPU. The mapped rows are unpadded, swizzled
+ * to RGBA8 and encoded on a worker thread of the job system, the buffer is
+ * unmapped on the main thread afterwards. When all buffers are in use, copies
+ * are dropped instead of stalling the frame.
+ */
+typedef struct wgpu_readback wgpu_readback_t;
+
+typedef enum wgpu_readback_file_format_enum {
+  ReadbackFileFormat_None = 0, /* pixels are only passed to the callback */
+  ReadbackFileFormat_Png  = 1,
+  ReadbackFileFormat_Raw  = 2, /* tightly packed RGBA8, .rgba extension */
+} wgpu_readback_file_format_enum;
+
+/* Read back image, tightly packed RGBA8 */
+typedef struct wgpu_readback_image_t {
+  uint32_t width;
+  uint32_t height;
+  uint64_t frame_number;
+  const uint8_t* pixels;
+} wgpu_readback_image_t;
+
+/* Called on a worker thread, the pixels are only valid during the call */
+typedef void (*wgpu_readback_func_t)(const wgpu_readback_image_t* image,
+                                     void* user_data);
+
+typedef struct wgpu_readback_desc_t {
+  uint32_t width;
+  uint32_t height;
+  /* RGBA8 or BGRA8 format of the copied textures, BGRA8 is swizzled */
+  WGPUTextureFormat format;
+  /* Number of readback buffers, 0 selects 3 */
+  uint32_t buffer_count;
+  /* Frames between recording a copy and mapping its buffer */
+  uint32_t map_delay;
+  /* Images are written to <output_directory>/<file_prefix>_<frame>.<ext> */
+  wgpu_readback_file_format_enum file_format;
+  const char* output_directory; /* NULL selects "." */
+  const char* file_prefix;      /* NULL selects "frame" */
+  /* Optional */
+  wgpu_readback_func_t func;
+  void* user_data;
+} wgpu_readback_desc_t;
+
+/* Readback creating/releasing, releasing writes all pending images */
+wgpu_readback_t* wgpu_readback_create(wgpu_context_t* wgpu_context,
+                                      const wgpu_readback_desc_t* desc);
+void wgpu_readback_release(wgpu_readback_t* readback);
+
+/**
+ * @brief Records the copy of the texture into the next free readback buffer.
+ * Returns false without recording anything when all buffers are in use, the
+ * frame is counted as dropped then.
+ */
+bool wgpu_readback_copy_texture(wgpu_readback_t* readback,
+                                WGPUCommandEncoder cmd_enc,
+                                WGPUTexture texture, uint64_t frame_number);
+
+/* Maps the buffers whose copy is old enough, to be called once per frame
+ * after the command buffers with the copies have been submitted */
+void wgpu_readback_update(wgpu_readback_t* readback);
+
+/* Blocks until all recorded copies have been mapped and processed, the copies
+ * must have been submitted */
+void wgpu_readback_flush(wgpu_readback_t* readback);
+
+/* Number of copies dropped because all buffers were in use */
+uint32_t wgpu_readback_get_dropped_count(wgpu_readback_t* readback);
+
+/* Name of the last written file, empty when none has been written yet */
+const char* wgpu_readback_get_last_filename(wgpu_readback_t* readback);
+
+/*
+ * Pipelined buffer readback, the same ring of readback buffers for the data of
+ * buffers, e.g. query results or statistics computed on the GPU. The buffers
+ * are mapped map_delay updates after their copy was recorded, the mapping
+ * completes during the device ticks of later updates. The data is small, the
+ * callback runs on the main thread and the buffer is unmapped right after.
+ */
+typedef struct wgpu_buffer_readback wgpu_buffer_readback_t;
+
+/* Called on the main thread, the data is only valid during the call */
+typedef void (*wgpu_buffer_readback_func_t)(const void* data, uint64_t size,
+                                            uint64_t frame_number,
+                                            void* user_data);
+
+typedef struct wgpu_buffer_readback_desc_t {
+  /* Largest copy in bytes, a multiple of 4 */
+  uint64_t size;
+  /* Number of readback buffers, 0 selects 3 */
+  uint32_t buffer_count;
+  /* Updates between recording a copy and mapping its buffer */
+  uint32_t map_delay;
+  wgpu_buffer_readback_func_t func;
+  void* user_data;
+} wgpu_buffer_readback_desc_t;
+
+/* Buffer readback creating/releasing, releasing delivers all pending copies */
+wgpu_buffer_readback_t*
+wgpu_buffer_readback_create(wgpu_context_t* wgpu_context,
+                            const wgpu_buffer_readback_desc_t* desc);
+void wgpu_buffer_readback_release(wgpu_buffer_readback_t* readback);
+
+/**
+ * @brief Records the copy of size bytes of the buffer, from offset on, into
+ * the next free readback buffer. Returns false without recording anything
+ * when all buffers are in use, the copy is counted as dropped then.
+ */
+bool wgpu_buffer_readback_copy_buffer(wgpu_buffer_readback_t* readback,
+                                      WGPUCommandEncoder cmd_enc,
+                                      WGPUBuffer buffer, uint64_t offset,
+                                      uint64_t size, uint64_t frame_number);
+
+/* Maps the buffers whose copy is old enough and polls the pending maps, to be
+ * called once per frame after the command buffers with the copies have been
+ * submitted */
+void wgpu_buffer_readback_update(wgpu_buffer_readback_t* readback);
+
+/* Blocks until all recorded copies have been delivered, the copies must have
+ * been submitted */
+void wgpu_buffer_readback_flush(wgpu_buffer_readback_t* readback);
+
+/* Number of copies dropped because all buffers were in use */
+uint32_t wgpu_buffer_readback_get_dropped_count(
+  wgpu_buffer_readback_t* readback);
+
+#endif
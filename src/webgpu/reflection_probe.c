@@ -0,0 +1,921 @@
+#include "reflection_probe.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "gpu_profiler.h"
+#include "shader.h"
+
+#define REFLECTION_PROBE_WORKGROUP_SIZE 8u
+#define REFLECTION_PROBE_PARAMS_STRIDE 256u
+#define REFLECTION_PROBE_PREFILTER_SAMPLE_COUNT 32u
+#define REFLECTION_PROBE_IRRADIANCE_SAMPLE_COUNT 64u
+/* Estimated cost of rendering a face texel, in filter samples */
+#define REFLECTION_PROBE_FACE_TEXEL_COST 16.0f
+/* Initial GPU time of a filter sample, before the first measurement */
+#define REFLECTION_PROBE_DEFAULT_MS_PER_SAMPLE 1e-6f
+#define REFLECTION_PROBE_SCOPE_NAME "reflection_probe"
+
+/* Work items of an update, the pre-filtered mip levels follow the mip chain */
+typedef enum reflection_probe_item_enum {
+  ReflectionProbeItem_Face     = 0, /* 6 items, one per face */
+  ReflectionProbeItem_MipChain = 6,
+  ReflectionProbeItem_Prefilter, /* one item per mip level from 1 */
+} reflection_probe_item_enum;
+
+/* Layout of Params, one block per dispatch */
+typedef struct reflection_probe_params_t {
+  uint32_t size;
+  uint32_t sample_count;
+  float roughness;
+  float source_size;
+} reflection_probe_params_t;
+
+/* Filtered cube map and the storage views of its mip levels */
+typedef struct reflection_probe_cube_t {
+  WGPUTexture texture;
+  WGPUTextureView view;
+  WGPUTextureView mip_views[WGPU_REFLECTION_PROBE_MAX_MIP_COUNT];
+} reflection_probe_cube_t;
+
+struct wgpu_reflection_probe {
+  wgpu_context_t* wgpu_context;
+  wgpu_reflection_probe_desc_t desc;
+  uint32_t mip_level_count;
+  vec3 position;
+  mat4 projection;
+  mat4 views[6];
+  /* Faces rendered by the draw callback and their mip chain */
+  reflection_probe_cube_t capture;
+  WGPUTextureView face_views[6];
+  WGPUTexture depth_texture;
+  WGPUTextureView depth_view;
+  /* Double buffered results, the update writes the back set */
+  reflection_probe_cube_t prefiltered[2];
+  reflection_probe_cube_t irradiance[2];
+  uint32_t front;
+  WGPUSampler sampler;
+  wgpu_buffer_t params_buffer;
+  WGPUComputePipeline downsample_pipeline;
+  WGPUComputePipeline prefilter_pipeline;
+  WGPUComputePipeline irradiance_pipeline;
+  WGPUBindGroup downsample_bind_groups[WGPU_REFLECTION_PROBE_MAX_MIP_COUNT];
+  WGPUBindGroup prefilter_bind_groups[2][WGPU_REFLECTION_PROBE_MAX_MIP_COUNT];
+  WGPUBindGroup irradiance_bind_groups[2];
+  /* Scheduling */
+  uint32_t item_count;
+  uint32_t next_item;
+  bool running;
+  bool pending;
+  uint32_t update_frame_count;
+  float ms_per_sample;
+  float average_frame_ms;
+  float average_frame_samples;
+  wgpu_reflection_probe_stats_t stats;
+};
+
+// clang-format off
+static const char* reflection_probe_shader_wgsl = CODE(
+  struct Params {
+    size : u32,
+    sampleCount : u32,
+    roughness : f32,
+    sourceSize : f32,
+  };
+
+  @group(0) @binding(0) var source : texture_cube<f32>;
+  @group(0) @binding(1) var sourceSampler : sampler;
+  @group(0) @binding(2) var<uniform> params : Params;
+  @group(0) @binding(3) var output :
+    texture_storage_2d_array<rgba16float, write>;
+  @group(0) @binding(4) var sourceMip : texture_2d_array<f32>;
+
+  let PI = 3.1415926535897932384626433832795;
+
+  // Direction through the center of a texel of a cube face
+  fn cubeDirection(face : u32, texel : vec2<u32>) -> vec3<f32> {
+    let uv = (vec2<f32>(texel) + 0.5) / f32(params.size) * 2.0 - 1.0;
+    var dir = vec3<f32>(-uv.x, -uv.y, -1.0);
+    switch (face) {
+      case 0u: { dir = vec3<f32>(1.0, -uv.y, -uv.x); }
+      case 1u: { dir = vec3<f32>(-1.0, -uv.y, uv.x); }
+      case 2u: { dir = vec3<f32>(uv.x, 1.0, uv.y); }
+      case 3u: { dir = vec3<f32>(uv.x, -1.0, -uv.y); }
+      case 4u: { dir = vec3<f32>(uv.x, -uv.y, 1.0); }
+      default: {}
+    }
+    return normalize(dir);
+  }
+
+  fn hammersley2d(i : u32, n : u32) -> vec2<f32> {
+    var bits = (i << 16u) | (i >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2<f32>(f32(i) / f32(n), f32(bits) * 2.3283064365386963e-10);
+  }
+
+  fn tangentToWorld(h : vec3<f32>, normal : vec3<f32>) -> vec3<f32> {
+    let up = select(vec3<f32>(1.0, 0.0, 0.0), vec3<f32>(0.0, 0.0, 1.0),
+                    abs(normal.z) < 0.999);
+    let tangentX = normalize(cross(up, normal));
+    let tangentY = normalize(cross(normal, tangentX));
+    return normalize(tangentX * h.x + tangentY * h.y + normal * h.z);
+  }
+
+  // Mip level of the source matching the solid angle of a sample
+  fn sourceLod(pdf : f32) -> f32 {
+    let omegaS = 1.0 / (f32(params.sampleCount) * pdf);
+    let omegaP = 4.0 * PI / (6.0 * params.sourceSize * params.sourceSize);
+    return max(0.5 * log2(omegaS / omegaP) + 1.0, 0.0);
+  }
+
+  // 2x2 box filter of the previous mip level of all faces
+  @compute @workgroup_size(8, 8, 1)
+  fn cs_downsample(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size || id.y >= params.size) {
+      return;
+    }
+    let texel = vec2<i32>(id.xy) * 2;
+    let layer = i32(id.z);
+    let color = textureLoad(sourceMip, texel, layer, 0)
+                + textureLoad(sourceMip, texel + vec2<i32>(1, 0), layer, 0)
+                + textureLoad(sourceMip, texel + vec2<i32>(0, 1), layer, 0)
+                + textureLoad(sourceMip, texel + vec2<i32>(1, 1), layer, 0);
+    textureStore(output, vec2<i32>(id.xy), layer, color * 0.25);
+  }
+
+  // Specular environment pre-filtered for the roughness of the mip level
+  @compute @workgroup_size(8, 8, 1)
+  fn cs_prefilter(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size || id.y >= params.size) {
+      return;
+    }
+    let n = cubeDirection(id.z, id.xy);
+    let alpha = params.roughness * params.roughness;
+    let alpha2 = alpha * alpha;
+    var color = vec3<f32>(0.0);
+    var totalWeight = 0.0;
+    for (var i = 0u; i < params.sampleCount; i = i + 1u) {
+      let xi = hammersley2d(i, params.sampleCount);
+      let phi = 2.0 * PI * xi.x;
+      let cosTheta = sqrt((1.0 - xi.y) / (1.0 + (alpha2 - 1.0) * xi.y));
+      let sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+      let h = tangentToWorld(
+        vec3<f32>(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta), n);
+      let l = 2.0 * dot(n, h) * h - n;
+      let dotNL = dot(n, l);
+      if (dotNL > 0.0) {
+        // With v = n the pdf of l is D(h) / 4
+        let denom = cosTheta * cosTheta * (alpha2 - 1.0) + 1.0;
+        let pdf = alpha2 / (4.0 * PI * denom * denom) + 0.0001;
+        color = color + textureSampleLevel(source, sourceSampler, l,
+                                           sourceLod(pdf)).rgb * dotNL;
+        totalWeight = totalWeight + dotNL;
+      }
+    }
+    textureStore(output, vec2<i32>(id.xy), i32(id.z),
+                 vec4<f32>(color / max(totalWeight, 0.0001), 1.0));
+  }
+
+  // Diffuse irradiance divided by PI, the cosine weighted average of the
+  // environment over the hemisphere
+  @compute @workgroup_size(8, 8, 1)
+  fn cs_irradiance(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size || id.y >= params.size) {
+      return;
+    }
+    let n = cubeDirection(id.z, id.xy);
+    var color = vec3<f32>(0.0);
+    for (var i = 0u; i < params.sampleCount; i = i + 1u) {
+      let xi = hammersley2d(i, params.sampleCount);
+      let phi = 2.0 * PI * xi.x;
+      let cosTheta = sqrt(1.0 - xi.y);
+      let sinTheta = sqrt(xi.y);
+      let l = tangentToWorld(
+        vec3<f32>(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta), n);
+      color = color + textureSampleLevel(source, sourceSampler, l,
+                                         sourceLod(cosTheta / PI)).rgb;
+    }
+    textureStore(output, vec2<i32>(id.xy), i32(id.z),
+                 vec4<f32>(color / f32(params.sampleCount), 1.0));
+  }
+);
+// clang-format on
+
+static WGPUComputePipeline
+reflection_probe_create_pipeline(wgpu_context_t* wgpu_context,
+                                 wgpu_shader_t* comp_shader, const char* entry)
+{
+  WGPUProgrammableStageDescriptor stage
+    = comp_shader->programmable_stage_descriptor;
+  stage.entryPoint             = entry;
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = entry,
+                            .compute = stage,
+                          });
+  ASSERT(pipeline != NULL);
+  return pipeline;
+}
+
+static void reflection_probe_create_cube(
+  wgpu_reflection_probe_t* reflection_probe, const char* label, uint32_t size,
+  uint32_t mip_level_count, WGPUTextureUsageFlags usage,
+  reflection_probe_cube_t* cube)
+{
+  cube->texture = wgpuDeviceCreateTexture(
+    reflection_probe->wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = label,
+      .usage         = WGPUTextureUsage_StorageBinding
+                       | WGPUTextureUsage_TextureBinding | usage,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){size, size, 6},
+      .format        = WGPU_REFLECTION_PROBE_COLOR_FORMAT,
+      .mipLevelCount = mip_level_count,
+      .sampleCount   = 1,
+    });
+  ASSERT(cube->texture != NULL);
+
+  cube->view = wgpuTextureCreateView(
+    cube->texture, &(WGPUTextureViewDescriptor){
+                     .label           = label,
+                     .format          = WGPU_REFLECTION_PROBE_COLOR_FORMAT,
+                     .dimension       = WGPUTextureViewDimension_Cube,
+                     .baseMipLevel    = 0,
+                     .mipLevelCount   = mip_level_count,
+                     .baseArrayLayer  = 0,
+                     .arrayLayerCount = 6,
+                     .aspect          = WGPUTextureAspect_All,
+                   });
+  ASSERT(cube->view != NULL);
+
+  // All faces of a mip level, written or read by the dispatches
+  for (uint32_t m = 0; m < mip_level_count; ++m) {
+    cube->mip_views[m] = wgpuTextureCreateView(
+      cube->texture, &(WGPUTextureViewDescriptor){
+                       .label           = label,
+                       .format          = WGPU_REFLECTION_PROBE_COLOR_FORMAT,
+                       .dimension       = WGPUTextureViewDimension_2DArray,
+                       .baseMipLevel    = m,
+                       .mipLevelCount   = 1,
+                       .baseArrayLayer  = 0,
+                       .arrayLayerCount = 6,
+                       .aspect          = WGPUTextureAspect_All,
+                     });
+    ASSERT(cube->mip_views[m] != NULL);
+  }
+}
+
+static void reflection_probe_release_cube(reflection_probe_cube_t* cube)
+{
+  for (uint32_t m = 0; m < WGPU_REFLECTION_PROBE_MAX_MIP_COUNT; ++m) {
+    WGPU_RELEASE_RESOURCE(TextureView, cube->mip_views[m]);
+  }
+  WGPU_RELEASE_RESOURCE(TextureView, cube->view);
+  WGPU_RELEASE_RESOURCE(Texture, cube->texture);
+}
+
+static void reflection_probe_create_textures(
+  wgpu_reflection_probe_t* reflection_probe)
+{
+  wgpu_context_t* wgpu_context = reflection_probe->wgpu_context;
+  const uint32_t size          = reflection_probe->desc.size;
+  const uint32_t mip_count     = reflection_probe->mip_level_count;
+
+  reflection_probe_create_cube(
+    reflection_probe, "reflection_probe_capture_texture", size, mip_count,
+    WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+    &reflection_probe->capture);
+  for (uint32_t f = 0; f < 6; ++f) {
+    reflection_probe->face_views[f] = wgpuTextureCreateView(
+      reflection_probe->capture.texture,
+      &(WGPUTextureViewDescriptor){
+        .label           = "reflection_probe_face_view",
+        .format          = WGPU_REFLECTION_PROBE_COLOR_FORMAT,
+        .dimension       = WGPUTextureViewDimension_2D,
+        .baseMipLevel    = 0,
+        .mipLevelCount   = 1,
+        .baseArrayLayer  = f,
+        .arrayLayerCount = 1,
+        .aspect          = WGPUTextureAspect_All,
+      });
+    ASSERT(reflection_probe->face_views[f] != NULL);
+  }
+
+  reflection_probe->depth_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device, &(WGPUTextureDescriptor){
+                            .label = "reflection_probe_depth_texture",
+                            .usage = WGPUTextureUsage_RenderAttachment,
+                            .dimension     = WGPUTextureDimension_2D,
+                            .size          = (WGPUExtent3D){size, size, 1},
+                            .format        = WGPU_REFLECTION_PROBE_DEPTH_FORMAT,
+                            .mipLevelCount = 1,
+                            .sampleCount   = 1,
+                          });
+  ASSERT(reflection_probe->depth_texture != NULL);
+  reflection_probe->depth_view
+    = wgpuTextureCreateView(reflection_probe->depth_texture, NULL);
+  ASSERT(reflection_probe->depth_view != NULL);
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    reflection_probe_create_cube(
+      reflection_probe, "reflection_probe_prefiltered_texture", size,
+      mip_count, WGPUTextureUsage_CopyDst, &reflection_probe->prefiltered[i]);
+    reflection_probe_create_cube(
+      reflection_probe, "reflection_probe_irradiance_texture",
+      reflection_probe->desc.irradiance_size, 1, WGPUTextureUsage_None,
+      &reflection_probe->irradiance[i]);
+  }
+}
+
+// One parameter block per dispatch: the mip chain at the index of the mip
+// level, the pre-filtered mip levels after it, then the irradiance
+static void
+reflection_probe_write_params(wgpu_reflection_probe_t* reflection_probe)
+{
+  const uint32_t mip_count = reflection_probe->mip_level_count;
+  const float source_size  = (float)reflection_probe->desc.size;
+  for (uint32_t i = 0; i < 2 * mip_count + 1; ++i) {
+    reflection_probe_params_t params = {
+      .source_size = source_size,
+    };
+    if (i < mip_count) {
+      params.size = MAX(1u, reflection_probe->desc.size >> i);
+    }
+    else if (i < 2 * mip_count) {
+      const uint32_t m    = i - mip_count;
+      params.size         = MAX(1u, reflection_probe->desc.size >> m);
+      params.sample_count = REFLECTION_PROBE_PREFILTER_SAMPLE_COUNT;
+      params.roughness    = (float)m / (float)MAX(1u, mip_count - 1);
+    }
+    else {
+      params.size         = reflection_probe->desc.irradiance_size;
+      params.sample_count = REFLECTION_PROBE_IRRADIANCE_SAMPLE_COUNT;
+    }
+    wgpu_queue_write_buffer(reflection_probe->wgpu_context,
+                            reflection_probe->params_buffer.buffer,
+                            i * REFLECTION_PROBE_PARAMS_STRIDE, &params,
+                            sizeof(params));
+  }
+}
+
+static WGPUBindGroup reflection_probe_create_filter_bind_group(
+  wgpu_reflection_probe_t* reflection_probe, WGPUComputePipeline pipeline,
+  uint32_t params_index, WGPUTextureView output_view)
+{
+  WGPUBindGroupLayout bind_group_layout
+    = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry){
+      // Binding 0: Captured faces and their mip chain
+      .binding     = 0,
+      .textureView = reflection_probe->capture.view,
+    },
+    [1] = (WGPUBindGroupEntry){
+      // Binding 1: Source sampler
+      .binding = 1,
+      .sampler = reflection_probe->sampler,
+    },
+    [2] = (WGPUBindGroupEntry){
+      // Binding 2: Parameters of the dispatch
+      .binding = 2,
+      .buffer  = reflection_probe->params_buffer.buffer,
+      .offset  = params_index * REFLECTION_PROBE_PARAMS_STRIDE,
+      .size    = sizeof(reflection_probe_params_t),
+    },
+    [3] = (WGPUBindGroupEntry){
+      // Binding 3: Mip level written
+      .binding     = 3,
+      .textureView = output_view,
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    reflection_probe->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "reflection_probe_filter_bind_group",
+      .layout     = bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(bind_group != NULL);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout);
+  return bind_group;
+}
+
+static void
+reflection_probe_create_bind_groups(wgpu_reflection_probe_t* reflection_probe)
+{
+  const uint32_t mip_count = reflection_probe->mip_level_count;
+
+  // Mip chain of the captured faces
+  WGPUBindGroupLayout bind_group_layout = wgpuComputePipelineGetBindGroupLayout(
+    reflection_probe->downsample_pipeline, 0);
+  for (uint32_t m = 1; m < mip_count; ++m) {
+    WGPUBindGroupEntry bg_entries[3] = {
+      [0] = (WGPUBindGroupEntry){
+        // Binding 2: Parameters of the mip level
+        .binding = 2,
+        .buffer  = reflection_probe->params_buffer.buffer,
+        .offset  = m * REFLECTION_PROBE_PARAMS_STRIDE,
+        .size    = sizeof(reflection_probe_params_t),
+      },
+      [1] = (WGPUBindGroupEntry){
+        // Binding 3: Mip level written
+        .binding     = 3,
+        .textureView = reflection_probe->capture.mip_views[m],
+      },
+      [2] = (WGPUBindGroupEntry){
+        // Binding 4: Previous mip level
+        .binding     = 4,
+        .textureView = reflection_probe->capture.mip_views[m - 1],
+      },
+    };
+    reflection_probe->downsample_bind_groups[m] = wgpuDeviceCreateBindGroup(
+      reflection_probe->wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "reflection_probe_downsample_bind_group",
+        .layout     = bind_group_layout,
+        .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+        .entries    = bg_entries,
+      });
+    ASSERT(reflection_probe->downsample_bind_groups[m] != NULL);
+  }
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout);
+
+  // Filtering into both sets of results
+  for (uint32_t i = 0; i < 2; ++i) {
+    for (uint32_t m = 1; m < mip_count; ++m) {
+      reflection_probe->prefilter_bind_groups[i][m]
+        = reflection_probe_create_filter_bind_group(
+          reflection_probe, reflection_probe->prefilter_pipeline,
+          mip_count + m, reflection_probe->prefiltered[i].mip_views[m]);
+    }
+    reflection_probe->irradiance_bind_groups[i]
+      = reflection_probe_create_filter_bind_group(
+        reflection_probe, reflection_probe->irradiance_pipeline,
+        2 * mip_count, reflection_probe->irradiance[i].mip_views[0]);
+  }
+}
+
+// Mirrored face cameras matching the cube map addressing, the rows of the
+// view matrix are the directions of the texel columns, of the texel rows
+// upwards and of the back of the face
+static void
+reflection_probe_update_views(wgpu_reflection_probe_t* reflection_probe)
+{
+  static const float axes[6][3][3] = {
+    // clang-format off
+    /* right             up                forward */
+    {{0.f, 0.f, -1.f}, {0.f, 1.f, 0.f},  {1.f, 0.f, 0.f}},
+    {{0.f, 0.f, 1.f},  {0.f, 1.f, 0.f},  {-1.f, 0.f, 0.f}},
+    {{1.f, 0.f, 0.f},  {0.f, 0.f, -1.f}, {0.f, 1.f, 0.f}},
+    {{1.f, 0.f, 0.f},  {0.f, 0.f, 1.f},  {0.f, -1.f, 0.f}},
+    {{1.f, 0.f, 0.f},  {0.f, 1.f, 0.f},  {0.f, 0.f, 1.f}},
+    {{-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f},  {0.f, 0.f, -1.f}},
+    // clang-format on
+  };
+  for (uint32_t f = 0; f < 6; ++f) {
+    mat4* view = &reflection_probe->views[f];
+    glm_mat4_identity(*view);
+    for (uint32_t r = 0; r < 3; ++r) {
+      const float sign = r == 2 ? -1.0f : 1.0f;
+      vec3 axis        = {axes[f][r][0] * sign, axes[f][r][1] * sign,
+                          axes[f][r][2] * sign};
+      for (uint32_t c = 0; c < 3; ++c) {
+        (*view)[c][r] = axis[c];
+      }
+      (*view)[3][r] = -glm_vec3_dot(axis, reflection_probe->position);
+    }
+  }
+}
+
+// Estimated cost of a work item in filter samples
+static float reflection_probe_item_cost(
+  wgpu_reflection_probe_t* reflection_probe, uint32_t item)
+{
+  const float size = (float)reflection_probe->desc.size;
+  if (item < ReflectionProbeItem_MipChain) {
+    return size * size * REFLECTION_PROBE_FACE_TEXEL_COST;
+  }
+  if (item == ReflectionProbeItem_MipChain) {
+    // 4 loads per texel of the mip chain, a third of the faces, and the copy
+    return 6.0f * size * size * (4.0f / 3.0f + 1.0f);
+  }
+  if (item + 1 < reflection_probe->item_count) {
+    const uint32_t m = item - ReflectionProbeItem_Prefilter + 1;
+    const float s    = (float)MAX(1u, reflection_probe->desc.size >> m);
+    return 6.0f * s * s * (float)REFLECTION_PROBE_PREFILTER_SAMPLE_COUNT;
+  }
+  const float s = (float)reflection_probe->desc.irradiance_size;
+  return 6.0f * s * s * (float)REFLECTION_PROBE_IRRADIANCE_SAMPLE_COUNT;
+}
+
+static void reflection_probe_dispatch(WGPUComputePassEncoder pass_encoder,
+                                      WGPUComputePipeline pipeline,
+                                      WGPUBindGroup bind_group, uint32_t size)
+{
+  const uint32_t group_count = (size + REFLECTION_PROBE_WORKGROUP_SIZE - 1)
+                               / REFLECTION_PROBE_WORKGROUP_SIZE;
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, group_count,
+                                           group_count, 6);
+}
+
+static void reflection_probe_record_item(
+  wgpu_reflection_probe_t* reflection_probe, WGPUCommandEncoder cmd_encoder,
+  uint32_t item, wgpu_reflection_probe_draw_callback_t draw_callback,
+  void* user_data)
+{
+  const uint32_t size = reflection_probe->desc.size;
+  const uint32_t back = 1 - reflection_probe->front;
+
+  if (item < ReflectionProbeItem_MipChain) {
+    WGPURenderPassColorAttachment color_attachment = {
+      .view       = reflection_probe->face_views[item],
+      .loadOp     = WGPULoadOp_Clear,
+      .storeOp    = WGPUStoreOp_Store,
+      .clearColor = (WGPUColor){0.0f, 0.0f, 0.0f, 1.0f},
+    };
+    WGPURenderPassDepthStencilAttachment depth_stencil_attachment = {
+      .view            = reflection_probe->depth_view,
+      .depthLoadOp     = WGPULoadOp_Clear,
+      .depthStoreOp    = WGPUStoreOp_Discard,
+      .depthClearValue = 1.0f,
+      .clearDepth      = 1.0f,
+      .stencilLoadOp   = WGPULoadOp_Clear,
+      .stencilStoreOp  = WGPUStoreOp_Discard,
+      .clearStencil    = 0,
+    };
+    WGPURenderPassEncoder pass_encoder = wgpuCommandEncoderBeginRenderPass(
+      cmd_encoder, &(WGPURenderPassDescriptor){
+                     .label                  = "reflection_probe_face_pass",
+                     .colorAttachmentCount   = 1,
+                     .colorAttachments       = &color_attachment,
+                     .depthStencilAttachment = &depth_stencil_attachment,
+                   });
+    wgpuRenderPassEncoderSetViewport(pass_encoder, 0.0f, 0.0f, (float)size,
+                                     (float)size, 0.0f, 1.0f);
+    draw_callback(pass_encoder, item, user_data);
+    wgpuRenderPassEncoderEnd(pass_encoder);
+    WGPU_RELEASE_RESOURCE(RenderPassEncoder, pass_encoder)
+    return;
+  }
+
+  if (item == ReflectionProbeItem_MipChain) {
+    // The top mip level of the pre-filtered cube map is the mirror reflection
+    wgpuCommandEncoderCopyTextureToTexture(
+      cmd_encoder,
+      &(WGPUImageCopyTexture){
+        .texture  = reflection_probe->capture.texture,
+        .mipLevel = 0,
+      },
+      &(WGPUImageCopyTexture){
+        .texture  = reflection_probe->prefiltered[back].texture,
+        .mipLevel = 0,
+      },
+      &(WGPUExtent3D){
+        .width              = size,
+        .height             = size,
+        .depthOrArrayLayers = 6,
+      });
+  }
+
+  WGPUComputePassEncoder pass_encoder
+    = wgpuCommandEncoderBeginComputePass(cmd_encoder, NULL);
+  if (item == ReflectionProbeItem_MipChain) {
+    for (uint32_t m = 1; m < reflection_probe->mip_level_count; ++m) {
+      reflection_probe_dispatch(pass_encoder,
+                                reflection_probe->downsample_pipeline,
+                                reflection_probe->downsample_bind_groups[m],
+                                MAX(1u, size >> m));
+    }
+  }
+  else if (item + 1 < reflection_probe->item_count) {
+    const uint32_t m = item - ReflectionProbeItem_Prefilter + 1;
+    reflection_probe_dispatch(pass_encoder,
+                              reflection_probe->prefilter_pipeline,
+                              reflection_probe->prefilter_bind_groups[back][m],
+                              MAX(1u, size >> m));
+  }
+  else {
+    reflection_probe_dispatch(
+      pass_encoder, reflection_probe->irradiance_pipeline,
+      reflection_probe->irradiance_bind_groups[back],
+      reflection_probe->desc.irradiance_size);
+  }
+  wgpuComputePassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass_encoder)
+}
+
+// Swaps the results once the last item has been recorded
+static bool
+reflection_probe_complete_update(wgpu_reflection_probe_t* reflection_probe)
+{
+  if (reflection_probe->next_item < reflection_probe->item_count) {
+    return false;
+  }
+  reflection_probe->front   = 1 - reflection_probe->front;
+  reflection_probe->running = false;
+  reflection_probe->stats.update_frame_count
+    = reflection_probe->update_frame_count;
+  ++reflection_probe->stats.update_count;
+  return true;
+}
+
+// Time of a filter sample, from the averages of the measured GPU time of the
+// frames with probe work and of their estimated cost. The profiler results
+// are a few frames old, the averages smooth out the mismatch.
+static void
+reflection_probe_measure(wgpu_reflection_probe_t* reflection_probe,
+                         float frame_samples)
+{
+  reflection_probe->stats.frame_gpu_time_ms = -1.0f;
+  const wgpu_gpu_profiler_result_t* results = NULL;
+  const uint32_t result_count = wgpu_gpu_profiler_get_results(
+    reflection_probe->wgpu_context->gpu_profiler, &results);
+  for (uint32_t i = 0; i < result_count; ++i) {
+    if (strcmp(results[i].name, REFLECTION_PROBE_SCOPE_NAME) == 0) {
+      reflection_probe->stats.frame_gpu_time_ms = results[i].gpu_time_ms;
+      break;
+    }
+  }
+  if (reflection_probe->stats.frame_gpu_time_ms < 0.0f) {
+    return;
+  }
+
+  const float weight = 0.1f;
+  reflection_probe->average_frame_ms
+    += (reflection_probe->stats.frame_gpu_time_ms
+        - reflection_probe->average_frame_ms)
+       * weight;
+  reflection_probe->average_frame_samples
+    += (frame_samples - reflection_probe->average_frame_samples) * weight;
+  if (reflection_probe->average_frame_ms > 0.0f
+      && reflection_probe->average_frame_samples > 0.0f) {
+    reflection_probe->ms_per_sample = reflection_probe->average_frame_ms
+                                      / reflection_probe->average_frame_samples;
+  }
+}
+
+wgpu_reflection_probe_t*
+wgpu_reflection_probe_create(wgpu_context_t* wgpu_context,
+                             const wgpu_reflection_probe_desc_t* desc)
+{
+  wgpu_reflection_probe_desc_t defaults = {0};
+  if (desc == NULL) {
+    desc = &defaults;
+  }
+
+  wgpu_reflection_probe_t* reflection_probe
+    = (wgpu_reflection_probe_t*)malloc(sizeof(wgpu_reflection_probe_t));
+  memset(reflection_probe, 0, sizeof(wgpu_reflection_probe_t));
+  reflection_probe->wgpu_context = wgpu_context;
+  reflection_probe->desc         = *desc;
+  if (desc->size == 0) {
+    reflection_probe->desc.size = WGPU_REFLECTION_PROBE_DEFAULT_SIZE;
+  }
+  if (desc->irradiance_size == 0) {
+    reflection_probe->desc.irradiance_size
+      = WGPU_REFLECTION_PROBE_DEFAULT_IRRADIANCE_SIZE;
+  }
+  if (desc->z_near <= 0.0f) {
+    reflection_probe->desc.z_near = 0.1f;
+  }
+  if (desc->z_far <= 0.0f) {
+    reflection_probe->desc.z_far = 256.0f;
+  }
+  if (desc->gpu_budget_ms <= 0.0f) {
+    reflection_probe->desc.gpu_budget_ms
+      = WGPU_REFLECTION_PROBE_DEFAULT_GPU_BUDGET_MS;
+  }
+  reflection_probe->mip_level_count
+    = MIN((uint32_t)log2f((float)reflection_probe->desc.size) + 1u,
+          WGPU_REFLECTION_PROBE_MAX_MIP_COUNT);
+  reflection_probe->item_count = ReflectionProbeItem_Prefilter
+                                 + reflection_probe->mip_level_count;
+  reflection_probe->ms_per_sample = REFLECTION_PROBE_DEFAULT_MS_PER_SAMPLE;
+  reflection_probe->pending       = true;
+  reflection_probe->stats.item_count = reflection_probe->item_count;
+  reflection_probe->stats.frame_gpu_time_ms = -1.0f;
+
+  glm_perspective(glm_rad(90.0f), 1.0f, reflection_probe->desc.z_near,
+                  reflection_probe->desc.z_far, reflection_probe->projection);
+  reflection_probe_update_views(reflection_probe);
+
+  reflection_probe->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device,
+    &(WGPUSamplerDescriptor){
+      .label         = "reflection_probe_sampler",
+      .addressModeU  = WGPUAddressMode_ClampToEdge,
+      .addressModeV  = WGPUAddressMode_ClampToEdge,
+      .addressModeW  = WGPUAddressMode_ClampToEdge,
+      .minFilter     = WGPUFilterMode_Linear,
+      .magFilter     = WGPUFilterMode_Linear,
+      .mipmapFilter  = WGPUFilterMode_Linear,
+      .lodMinClamp   = 0.0f,
+      .lodMaxClamp   = (float)reflection_probe->mip_level_count,
+      .maxAnisotropy = 1,
+    });
+  ASSERT(reflection_probe->sampler != NULL);
+
+  reflection_probe->params_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "reflection_probe_params_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = (2 * reflection_probe->mip_level_count + 1)
+              * REFLECTION_PROBE_PARAMS_STRIDE,
+    });
+  reflection_probe_write_params(reflection_probe);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "reflection_probe_shader",
+                    .wgsl_code.source = reflection_probe_shader_wgsl,
+                    .entry            = "cs_downsample",
+                  });
+  reflection_probe->downsample_pipeline = reflection_probe_create_pipeline(
+    wgpu_context, &comp_shader, "cs_downsample");
+  reflection_probe->prefilter_pipeline = reflection_probe_create_pipeline(
+    wgpu_context, &comp_shader, "cs_prefilter");
+  reflection_probe->irradiance_pipeline = reflection_probe_create_pipeline(
+    wgpu_context, &comp_shader, "cs_irradiance");
+  wgpu_shader_release(&comp_shader);
+
+  reflection_probe_create_textures(reflection_probe);
+  reflection_probe_create_bind_groups(reflection_probe);
+
+  return reflection_probe;
+}
+
+void wgpu_reflection_probe_release(wgpu_reflection_probe_t* reflection_probe)
+{
+  if (reflection_probe == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    for (uint32_t m = 0; m < WGPU_REFLECTION_PROBE_MAX_MIP_COUNT; ++m) {
+      WGPU_RELEASE_RESOURCE(BindGroup,
+                            reflection_probe->prefilter_bind_groups[i][m]);
+    }
+    WGPU_RELEASE_RESOURCE(BindGroup,
+                          reflection_probe->irradiance_bind_groups[i]);
+    reflection_probe_release_cube(&reflection_probe->prefiltered[i]);
+    reflection_probe_release_cube(&reflection_probe->irradiance[i]);
+  }
+  for (uint32_t m = 0; m < WGPU_REFLECTION_PROBE_MAX_MIP_COUNT; ++m) {
+    WGPU_RELEASE_RESOURCE(BindGroup,
+                          reflection_probe->downsample_bind_groups[m]);
+  }
+  for (uint32_t f = 0; f < 6; ++f) {
+    WGPU_RELEASE_RESOURCE(TextureView, reflection_probe->face_views[f]);
+  }
+  reflection_probe_release_cube(&reflection_probe->capture);
+  WGPU_RELEASE_RESOURCE(TextureView, reflection_probe->depth_view);
+  WGPU_RELEASE_RESOURCE(Texture, reflection_probe->depth_texture);
+  WGPU_RELEASE_RESOURCE(ComputePipeline,
+                        reflection_probe->irradiance_pipeline);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, reflection_probe->prefilter_pipeline);
+  WGPU_RELEASE_RESOURCE(ComputePipeline,
+                        reflection_probe->downsample_pipeline);
+  WGPU_RELEASE_RESOURCE(Sampler, reflection_probe->sampler);
+  wgpu_destroy_buffer(&reflection_probe->params_buffer);
+
+  free(reflection_probe);
+}
+
+void wgpu_reflection_probe_set_position(
+  wgpu_reflection_probe_t* reflection_probe, vec3 position)
+{
+  glm_vec3_copy(position, reflection_probe->position);
+  reflection_probe_update_views(reflection_probe);
+  reflection_probe->running = false;
+  reflection_probe->pending = true;
+}
+
+void wgpu_reflection_probe_set_gpu_budget(
+  wgpu_reflection_probe_t* reflection_probe, float gpu_budget_ms)
+{
+  reflection_probe->desc.gpu_budget_ms
+    = gpu_budget_ms > 0.0f ? gpu_budget_ms :
+                             WGPU_REFLECTION_PROBE_DEFAULT_GPU_BUDGET_MS;
+}
+
+void wgpu_reflection_probe_set_continuous(
+  wgpu_reflection_probe_t* reflection_probe, bool continuous)
+{
+  reflection_probe->desc.continuous = continuous;
+}
+
+void wgpu_reflection_probe_invalidate(
+  wgpu_reflection_probe_t* reflection_probe)
+{
+  reflection_probe->pending = true;
+}
+
+void wgpu_reflection_probe_get_face_matrices(
+  wgpu_reflection_probe_t* reflection_probe, uint32_t face, mat4 projection,
+  mat4 view)
+{
+  ASSERT(face < 6);
+  glm_mat4_copy(reflection_probe->projection, projection);
+  glm_mat4_copy(reflection_probe->views[face], view);
+}
+
+bool wgpu_reflection_probe_update(
+  wgpu_reflection_probe_t* reflection_probe, WGPUCommandEncoder cmd_encoder,
+  wgpu_reflection_probe_draw_callback_t draw_callback, void* user_data)
+{
+  reflection_probe->stats.frame_item_count = 0;
+  if (!reflection_probe->running) {
+    if (!reflection_probe->pending && !reflection_probe->desc.continuous) {
+      return false;
+    }
+    reflection_probe->running            = true;
+    reflection_probe->pending            = false;
+    reflection_probe->next_item          = 0;
+    reflection_probe->update_frame_count = 0;
+  }
+
+  // Items within the budget, at least one
+  const float budget_samples
+    = reflection_probe->desc.gpu_budget_ms / reflection_probe->ms_per_sample;
+  float frame_samples = 0.0f;
+  wgpu_gpu_profiler_t* gpu_profiler
+    = reflection_probe->wgpu_context->gpu_profiler;
+  const uint32_t scope = wgpu_gpu_profiler_begin_scope(
+    gpu_profiler, cmd_encoder, REFLECTION_PROBE_SCOPE_NAME);
+  while (reflection_probe->next_item < reflection_probe->item_count) {
+    const float cost = reflection_probe_item_cost(reflection_probe,
+                                                  reflection_probe->next_item);
+    if (frame_samples > 0.0f && frame_samples + cost > budget_samples) {
+      break;
+    }
+    reflection_probe_record_item(reflection_probe, cmd_encoder,
+                                 reflection_probe->next_item, draw_callback,
+                                 user_data);
+    frame_samples += cost;
+    ++reflection_probe->next_item;
+    ++reflection_probe->stats.frame_item_count;
+  }
+  wgpu_gpu_profiler_end_scope(gpu_profiler, cmd_encoder, scope);
+  ++reflection_probe->update_frame_count;
+  reflection_probe_measure(reflection_probe, frame_samples);
+
+  return reflection_probe_complete_update(reflection_probe);
+}
+
+void wgpu_reflection_probe_update_all(
+  wgpu_reflection_probe_t* reflection_probe, WGPUCommandEncoder cmd_encoder,
+  wgpu_reflection_probe_draw_callback_t draw_callback, void* user_data)
+{
+  reflection_probe->running            = true;
+  reflection_probe->pending            = false;
+  reflection_probe->update_frame_count = 1;
+  for (uint32_t i = 0; i < reflection_probe->item_count; ++i) {
+    reflection_probe_record_item(reflection_probe, cmd_encoder, i,
+                                 draw_callback, user_data);
+  }
+  reflection_probe->next_item = reflection_probe->item_count;
+  reflection_probe_complete_update(reflection_probe);
+}
+
+WGPUTextureView wgpu_reflection_probe_get_prefiltered_view(
+  wgpu_reflection_probe_t* reflection_probe)
+{
+  return reflection_probe->prefiltered[reflection_probe->front].view;
+}
+
+WGPUTextureView wgpu_reflection_probe_get_irradiance_view(
+  wgpu_reflection_probe_t* reflection_probe)
+{
+  return reflection_probe->irradiance[reflection_probe->front].view;
+}
+
+WGPUSampler
+wgpu_reflection_probe_get_sampler(wgpu_reflection_probe_t* reflection_probe)
+{
+  return reflection_probe->sampler;
+}
+
+uint32_t wgpu_reflection_probe_get_mip_level_count(
+  wgpu_reflection_probe_t* reflection_probe)
+{
+  return reflection_probe->mip_level_count;
+}
+
+void wgpu_reflection_probe_get_stats(wgpu_reflection_probe_t* reflection_probe,
+                                     wgpu_reflection_probe_stats_t* stats)
+{
+  *stats = reflection_probe->stats;
+}
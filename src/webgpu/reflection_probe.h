@@ -0,0 +1,122 @@
+#ifndef REFLECTION_PROBE_H
+#define REFLECTION_PROBE_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+#define WGPU_REFLECTION_PROBE_MAX_MIP_COUNT 12u
+
+/* Formats of the faces rendered by the draw callback */
+#define WGPU_REFLECTION_PROBE_COLOR_FORMAT WGPUTextureFormat_RGBA16Float
+#define WGPU_REFLECTION_PROBE_DEPTH_FORMAT                                     \
+  WGPUTextureFormat_Depth24PlusStencil8
+
+/* Defaults */
+#define WGPU_REFLECTION_PROBE_DEFAULT_SIZE 128u
+#define WGPU_REFLECTION_PROBE_DEFAULT_IRRADIANCE_SIZE 32u
+#define WGPU_REFLECTION_PROBE_DEFAULT_GPU_BUDGET_MS 1.0f
+
+/*
+ * Reflection probe updated at runtime: the six faces of a cube map are
+ * rendered from the position of the probe, then filtered into the
+ * pre-filtered specular cube map, one roughness per mip level, and the
+ * diffuse irradiance cube map, as consumed by image based lighting.
+ *
+ * An update is split into work items, a face, the mip chain of the faces, a
+ * mip level of the pre-filtered cube map or the irradiance cube map, which
+ * are spread over the frames. Every frame the items fitting into the GPU time
+ * budget are recorded, at least one. The cost of the items is estimated from
+ * their texel and sample counts, scaled with the GPU time measured through
+ * the profiler of the context when there is one. The filtered cube maps are
+ * double buffered: the views of the probe only change, to the results of a
+ * complete update, when wgpu_reflection_probe_update() returns true.
+ *
+ * The faces of an update may be rendered in different frames, a moving scene
+ * is captured with the delay of the update.
+ */
+typedef struct wgpu_reflection_probe wgpu_reflection_probe_t;
+
+typedef struct wgpu_reflection_probe_desc_t {
+  /* Size of the faces and of the pre-filtered cube map, a power of two,
+   * 0 selects the default */
+  uint32_t size;
+  /* Size of the irradiance cube map, 0 selects the default */
+  uint32_t irradiance_size;
+  /* Clip planes of the faces, 0 selects 0.1 and 256.0 */
+  float z_near;
+  float z_far;
+  /* GPU time per frame, 0 selects the default */
+  float gpu_budget_ms;
+  /* Starts the next update when one is complete */
+  bool continuous;
+} wgpu_reflection_probe_desc_t;
+
+/* Called for each face to render with a cleared render pass of the probe
+ * formats. The face views are mirrored, their front faces are clockwise. */
+typedef void (*wgpu_reflection_probe_draw_callback_t)(
+  WGPURenderPassEncoder pass_encoder, uint32_t face, void* user_data);
+
+typedef struct wgpu_reflection_probe_stats_t {
+  uint32_t frame_item_count;   /* work items recorded in the last frame */
+  uint32_t item_count;         /* work items of an update */
+  uint32_t update_frame_count; /* frames the last complete update took */
+  uint32_t update_count;       /* complete updates */
+  /* Measured GPU time of the probe per frame, negative when unknown */
+  float frame_gpu_time_ms;
+} wgpu_reflection_probe_stats_t;
+
+/* Reflection probe creating/releasing */
+wgpu_reflection_probe_t*
+wgpu_reflection_probe_create(wgpu_context_t* wgpu_context,
+                             const wgpu_reflection_probe_desc_t* desc);
+void wgpu_reflection_probe_release(wgpu_reflection_probe_t* reflection_probe);
+
+/* Moves the probe, which restarts the running update */
+void wgpu_reflection_probe_set_position(
+  wgpu_reflection_probe_t* reflection_probe, vec3 position);
+void wgpu_reflection_probe_set_gpu_budget(
+  wgpu_reflection_probe_t* reflection_probe, float gpu_budget_ms);
+void wgpu_reflection_probe_set_continuous(
+  wgpu_reflection_probe_t* reflection_probe, bool continuous);
+
+/* Requests an update, started after the running one */
+void wgpu_reflection_probe_invalidate(
+  wgpu_reflection_probe_t* reflection_probe);
+
+/* Camera of a face, in the order of the cube map layers +X, -X, +Y, -Y, +Z,
+ * -Z */
+void wgpu_reflection_probe_get_face_matrices(
+  wgpu_reflection_probe_t* reflection_probe, uint32_t face, mat4 projection,
+  mat4 view);
+
+/**
+ * @brief Records the work items of the frame within the GPU time budget,
+ * before the passes sampling the probe. Returns true when an update has been
+ * completed, the views of the probe have changed then.
+ */
+bool wgpu_reflection_probe_update(
+  wgpu_reflection_probe_t* reflection_probe, WGPUCommandEncoder cmd_encoder,
+  wgpu_reflection_probe_draw_callback_t draw_callback, void* user_data);
+
+/* Records all work items of an update regardless of the budget, e.g. for the
+ * first frame or after a camera cut, the views of the probe change */
+void wgpu_reflection_probe_update_all(
+  wgpu_reflection_probe_t* reflection_probe, WGPUCommandEncoder cmd_encoder,
+  wgpu_reflection_probe_draw_callback_t draw_callback, void* user_data);
+
+/* Filtered cube maps of the last complete update, rgba16float */
+WGPUTextureView wgpu_reflection_probe_get_prefiltered_view(
+  wgpu_reflection_probe_t* reflection_probe);
+WGPUTextureView wgpu_reflection_probe_get_irradiance_view(
+  wgpu_reflection_probe_t* reflection_probe);
+/* Trilinear sampler over all mip levels of the pre-filtered cube map */
+WGPUSampler
+wgpu_reflection_probe_get_sampler(wgpu_reflection_probe_t* reflection_probe);
+uint32_t wgpu_reflection_probe_get_mip_level_count(
+  wgpu_reflection_probe_t* reflection_probe);
+
+void wgpu_reflection_probe_get_stats(wgpu_reflection_probe_t* reflection_probe,
+                                     wgpu_reflection_probe_stats_t* stats);
+
+#endif
@@ -0,0 +1,255 @@
+#include "render_bundle_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+typedef struct wgpu_render_bundle_cache_entry_t {
+  wgpu_render_bundle_key_t key;
+  WGPURenderBundle bundle;
+  uint64_t last_use;
+} wgpu_render_bundle_cache_entry_t;
+
+struct wgpu_render_bundle_cache_t {
+  wgpu_render_bundle_cache_entry_t* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  uint32_t hit_count;
+  uint32_t miss_count;
+  uint32_t eviction_count;
+  uint64_t use_count;
+  /* Caches of all contexts, for wgpu_render_bundle_cache_invalidate_object */
+  struct wgpu_render_bundle_cache_t* next;
+};
+
+static wgpu_render_bundle_cache_t* wgpu_render_bundle_caches = NULL;
+
+uint64_t wgpu_render_bundle_hash(uint64_t hash, const void* data, size_t size)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static wgpu_render_bundle_cache_t* wgpu_render_bundle_cache_create(void)
+{
+  wgpu_render_bundle_cache_t* render_bundle_cache
+    = (wgpu_render_bundle_cache_t*)malloc(sizeof(wgpu_render_bundle_cache_t));
+  memset(render_bundle_cache, 0, sizeof(wgpu_render_bundle_cache_t));
+  render_bundle_cache->next = wgpu_render_bundle_caches;
+  wgpu_render_bundle_caches = render_bundle_cache;
+  return render_bundle_cache;
+}
+
+void wgpu_render_bundle_cache_destroy(
+  wgpu_render_bundle_cache_t* render_bundle_cache)
+{
+  log_debug("Render bundle cache: %u bundles, %u hits, %u misses, %u evicted",
+            render_bundle_cache->entry_count, render_bundle_cache->hit_count,
+            render_bundle_cache->miss_count,
+            render_bundle_cache->eviction_count);
+  for (uint32_t i = 0; i < render_bundle_cache->entry_count; ++i) {
+    WGPU_RELEASE_RESOURCE(RenderBundle,
+                          render_bundle_cache->entries[i].bundle)
+  }
+  free(render_bundle_cache->entries);
+
+  wgpu_render_bundle_cache_t** link = &wgpu_render_bundle_caches;
+  while (*link != NULL && *link != render_bundle_cache) {
+    link = &(*link)->next;
+  }
+  if (*link != NULL) {
+    *link = render_bundle_cache->next;
+  }
+  free(render_bundle_cache);
+}
+
+/* Field-wise, unused color formats and padding are ignored */
+static bool wgpu_render_bundle_key_equal(const wgpu_render_bundle_key_t* a,
+                                         const wgpu_render_bundle_key_t* b)
+{
+  if (a->source != b->source || a->state != b->state
+      || a->formats.color_format_count != b->formats.color_format_count
+      || a->formats.depth_stencil_format != b->formats.depth_stencil_format
+      || a->formats.depth_stencil_read_only
+           != b->formats.depth_stencil_read_only
+      || MAX(a->formats.sample_count, 1u)
+           != MAX(b->formats.sample_count, 1u)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < a->formats.color_format_count; ++i) {
+    if (a->formats.color_formats[i] != b->formats.color_formats[i]) {
+      return false;
+    }
+  }
+  return memcmp(a->objects, b->objects, sizeof(a->objects)) == 0;
+}
+
+/* Releases the entries matching the predicate, the order of the remaining
+ * entries is kept */
+typedef bool (*wgpu_render_bundle_entry_predicate_t)(
+  const wgpu_render_bundle_cache_entry_t* entry, const void* data);
+
+static uint32_t
+wgpu_render_bundle_cache_remove(wgpu_render_bundle_cache_t* render_bundle_cache,
+                                wgpu_render_bundle_entry_predicate_t predicate,
+                                const void* data)
+{
+  uint32_t entry_count = 0;
+  for (uint32_t i = 0; i < render_bundle_cache->entry_count; ++i) {
+    wgpu_render_bundle_cache_entry_t* entry = &render_bundle_cache->entries[i];
+    if (predicate(entry, data)) {
+      WGPU_RELEASE_RESOURCE(RenderBundle, entry->bundle)
+    }
+    else {
+      render_bundle_cache->entries[entry_count++] = *entry;
+    }
+  }
+  const uint32_t removed_count
+    = render_bundle_cache->entry_count - entry_count;
+  render_bundle_cache->entry_count = entry_count;
+  return removed_count;
+}
+
+/* Evicts the least recently used bundle of the source once it has the
+ * maximum number of bundles, their states were superseded by newer ones */
+static void
+wgpu_render_bundle_cache_evict(wgpu_render_bundle_cache_t* render_bundle_cache,
+                               const void* source)
+{
+  uint32_t source_bundle_count = 0;
+  wgpu_render_bundle_cache_entry_t* oldest = NULL;
+  for (uint32_t i = 0; i < render_bundle_cache->entry_count; ++i) {
+    wgpu_render_bundle_cache_entry_t* entry = &render_bundle_cache->entries[i];
+    if (entry->key.source != source) {
+      continue;
+    }
+    ++source_bundle_count;
+    if (oldest == NULL || entry->last_use < oldest->last_use) {
+      oldest = entry;
+    }
+  }
+  if (source_bundle_count < WGPU_RENDER_BUNDLE_MAX_SOURCE_BUNDLES) {
+    return;
+  }
+  WGPU_RELEASE_RESOURCE(RenderBundle, oldest->bundle)
+  *oldest = render_bundle_cache->entries[--render_bundle_cache->entry_count];
+  ++render_bundle_cache->eviction_count;
+}
+
+WGPURenderBundle
+wgpu_render_bundle_cache_get(wgpu_context_t* wgpu_context,
+                             const wgpu_render_bundle_key_t* key,
+                             wgpu_render_bundle_record_func_t record_func,
+                             void* user_data)
+{
+  ASSERT(key->formats.color_format_count
+         <= WGPU_RENDER_BUNDLE_MAX_COLOR_FORMATS);
+  if (wgpu_context->render_bundle_cache == NULL) {
+    wgpu_context->render_bundle_cache = wgpu_render_bundle_cache_create();
+  }
+  wgpu_render_bundle_cache_t* render_bundle_cache
+    = wgpu_context->render_bundle_cache;
+  const uint64_t use = ++render_bundle_cache->use_count;
+
+  for (uint32_t i = 0; i < render_bundle_cache->entry_count; ++i) {
+    wgpu_render_bundle_cache_entry_t* entry = &render_bundle_cache->entries[i];
+    if (wgpu_render_bundle_key_equal(&entry->key, key)) {
+      ++render_bundle_cache->hit_count;
+      entry->last_use = use;
+      return entry->bundle;
+    }
+  }
+
+  /* Record the draws of the source */
+  WGPURenderBundleEncoder bundle_encoder = wgpuDeviceCreateRenderBundleEncoder(
+    wgpu_context->device,
+    &(WGPURenderBundleEncoderDescriptor){
+      .label              = "render_bundle_cache_encoder",
+      .colorFormatsCount  = key->formats.color_format_count,
+      .colorFormats       = key->formats.color_formats,
+      .depthStencilFormat = key->formats.depth_stencil_format,
+      .sampleCount        = MAX(key->formats.sample_count, 1u),
+      .depthReadOnly      = key->formats.depth_stencil_read_only,
+      .stencilReadOnly    = key->formats.depth_stencil_read_only,
+    });
+  ASSERT(bundle_encoder != NULL);
+  record_func(bundle_encoder, user_data);
+  WGPURenderBundle bundle
+    = wgpuRenderBundleEncoderFinish(bundle_encoder, NULL);
+  WGPU_RELEASE_RESOURCE(RenderBundleEncoder, bundle_encoder)
+  if (bundle == NULL) {
+    return NULL;
+  }
+  ++render_bundle_cache->miss_count;
+  wgpu_render_bundle_cache_evict(render_bundle_cache, key->source);
+
+  if (render_bundle_cache->entry_count == render_bundle_cache->entry_capacity) {
+    uint32_t capacity = MAX(render_bundle_cache->entry_capacity * 2, 16u);
+    wgpu_render_bundle_cache_entry_t* entries
+      = (wgpu_render_bundle_cache_entry_t*)realloc(
+        render_bundle_cache->entries,
+        capacity * sizeof(wgpu_render_bundle_cache_entry_t));
+    ASSERT(entries != NULL);
+    render_bundle_cache->entries        = entries;
+    render_bundle_cache->entry_capacity = capacity;
+  }
+  render_bundle_cache->entries[render_bundle_cache->entry_count++]
+    = (wgpu_render_bundle_cache_entry_t){
+      .key      = *key,
+      .bundle   = bundle,
+      .last_use = use,
+    };
+
+  return bundle;
+}
+
+static bool wgpu_render_bundle_entry_has_source(
+  const wgpu_render_bundle_cache_entry_t* entry, const void* source)
+{
+  return entry->key.source == source;
+}
+
+static bool wgpu_render_bundle_entry_uses_object(
+  const wgpu_render_bundle_cache_entry_t* entry, const void* object)
+{
+  for (uint32_t i = 0; i < WGPU_RENDER_BUNDLE_MAX_KEY_OBJECTS; ++i) {
+    if (entry->key.objects[i] == object) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void wgpu_render_bundle_cache_invalidate(wgpu_context_t* wgpu_context,
+                                         const void* source)
+{
+  wgpu_render_bundle_cache_t* render_bundle_cache
+    = wgpu_context->render_bundle_cache;
+  if (render_bundle_cache == NULL) {
+    return;
+  }
+
+  wgpu_render_bundle_cache_remove(render_bundle_cache,
+                                  wgpu_render_bundle_entry_has_source, source);
+}
+
+void wgpu_render_bundle_cache_invalidate_object(const void* object)
+{
+  if (object == NULL) {
+    return;
+  }
+
+  for (wgpu_render_bundle_cache_t* render_bundle_cache
+       = wgpu_render_bundle_caches;
+       render_bundle_cache != NULL;
+       render_bundle_cache = render_bundle_cache->next) {
+    render_bundle_cache->eviction_count += wgpu_render_bundle_cache_remove(
+      render_bundle_cache, wgpu_render_bundle_entry_uses_object, object);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef RENDER_BUNDLE_CACHE_H
+#define RENDER_BUNDLE_CACHE_H
+
+#include "context.h"
+
+#define WGPU_RENDER_BUNDLE_MAX_COLOR_FORMATS 4u
+#define WGPU_RENDER_BUNDLE_MAX_KEY_OBJECTS 8u
+/* Bundles kept per source, the least recently used one is evicted when a new
+ * state is recorded, e.g. after the pipeline of the caller changed */
+#define WGPU_RENDER_BUNDLE_MAX_SOURCE_BUNDLES 8u
+/* Initial value of wgpu_render_bundle_hash */
+#define WGPU_RENDER_BUNDLE_HASH_SEED 0xcbf29ce484222325ull
+
+/* Attachment state render bundles have to be compatible with */
+typedef struct wgpu_render_bundle_formats_t {
+  uint32_t color_format_count;
+  WGPUTextureFormat color_formats[WGPU_RENDER_BUNDLE_MAX_COLOR_FORMATS];
+  WGPUTextureFormat depth_stencil_format;
+  uint32_t sample_count; /* 0 selects 1 */
+  /* Replayed in passes with a read-only depth stencil attachment */
+  bool depth_stencil_read_only;
+} wgpu_render_bundle_formats_t;
+
+typedef struct wgpu_render_bundle_key_t {
+  /* Object whose draws are recorded, e.g. a glTF model */
+  const void* source;
+  /* Hash of the state the recorded draws depend on, e.g. the pipelines and
+   * render options */
+  uint64_t state;
+  wgpu_render_bundle_formats_t formats;
+  /* Optional objects the recorded draws use, e.g. the pipelines and bind
+   * groups of the caller, the bundle is released when one is invalidated */
+  const void* objects[WGPU_RENDER_BUNDLE_MAX_KEY_OBJECTS];
+} wgpu_render_bundle_key_t;
+
+typedef void (*wgpu_render_bundle_record_func_t)(
+  WGPURenderBundleEncoder bundle_encoder, void* user_data);
+
+/**
+ * Render bundle cache: static draw sequences are recorded once into a render
+ * bundle and replayed with wgpuRenderPassEncoderExecuteBundles until their
+ * source invalidates them. The cache is shared per context.
+ */
+typedef struct wgpu_render_bundle_cache_t wgpu_render_bundle_cache_t;
+void wgpu_render_bundle_cache_destroy(
+  wgpu_render_bundle_cache_t* render_bundle_cache);
+
+/**
+ * @brief Returns the bundle of the given key, recorded by record_func on first
+ * use. The bundle is owned by the cache and valid until it is invalidated.
+ */
+WGPURenderBundle
+wgpu_render_bundle_cache_get(wgpu_context_t* wgpu_context,
+                             const wgpu_render_bundle_key_t* key,
+                             wgpu_render_bundle_record_func_t record_func,
+                             void* user_data);
+
+/* Releases all bundles recorded for source, e.g. when it changed or is
+ * destroyed */
+void wgpu_render_bundle_cache_invalidate(wgpu_context_t* wgpu_context,
+                                         const void* source);
+
+/* Releases the bundles using the object, of all contexts. Called by
+ * wgpu_bind_group_cache_invalidate for the resource and the bind groups it
+ * releases, objects released directly have to be invalidated by their owner,
+ * otherwise their bundles stay alive until they are evicted. */
+void wgpu_render_bundle_cache_invalidate_object(const void* object);
+
+/* 64-bit FNV-1a, to combine the state of a key */
+uint64_t wgpu_render_bundle_hash(uint64_t hash, const void* data, size_t size);
+
+#endif
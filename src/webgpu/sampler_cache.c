@@ -0,0 +1,158 @@
+#include "sampler_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+/* Descriptor without the label and the chain, cleared for memcmp */
+typedef struct wgpu_sampler_key_t {
+  uint32_t address_mode_u;
+  uint32_t address_mode_v;
+  uint32_t address_mode_w;
+  uint32_t mag_filter;
+  uint32_t min_filter;
+  uint32_t mipmap_filter;
+  float lod_min_clamp;
+  float lod_max_clamp;
+  uint32_t compare;
+  uint32_t max_anisotropy;
+} wgpu_sampler_key_t;
+
+typedef struct wgpu_sampler_cache_entry_t {
+  uint64_t hash;
+  wgpu_sampler_key_t key;
+  WGPUSampler sampler;
+} wgpu_sampler_cache_entry_t;
+
+struct wgpu_sampler_cache_t {
+  wgpu_sampler_cache_entry_t* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  uint32_t hit_count;
+  uint32_t miss_count;
+};
+
+/* 64-bit FNV-1a */
+static uint64_t wgpu_sampler_cache_hash(const void* data, size_t size)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint64_t hash        = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static wgpu_sampler_cache_t* wgpu_sampler_cache_create(void)
+{
+  wgpu_sampler_cache_t* sampler_cache
+    = (wgpu_sampler_cache_t*)malloc(sizeof(wgpu_sampler_cache_t));
+  memset(sampler_cache, 0, sizeof(wgpu_sampler_cache_t));
+  return sampler_cache;
+}
+
+void wgpu_sampler_cache_destroy(wgpu_sampler_cache_t* sampler_cache)
+{
+  log_debug("Sampler cache: %u samplers, %u hits, %u misses",
+            sampler_cache->entry_count, sampler_cache->hit_count,
+            sampler_cache->miss_count);
+  for (uint32_t i = 0; i < sampler_cache->entry_count; ++i) {
+    WGPU_RELEASE_RESOURCE(Sampler, sampler_cache->entries[i].sampler)
+  }
+  free(sampler_cache->entries);
+  free(sampler_cache);
+}
+
+static void wgpu_sampler_key_init(wgpu_sampler_key_t* key,
+                                  WGPUSamplerDescriptor const* desc)
+{
+  memset(key, 0, sizeof(*key));
+  key->address_mode_u = (uint32_t)desc->addressModeU;
+  key->address_mode_v = (uint32_t)desc->addressModeV;
+  key->address_mode_w = (uint32_t)desc->addressModeW;
+  key->mag_filter     = (uint32_t)desc->magFilter;
+  key->min_filter     = (uint32_t)desc->minFilter;
+  key->mipmap_filter  = (uint32_t)desc->mipmapFilter;
+  key->lod_min_clamp  = desc->lodMinClamp;
+  key->lod_max_clamp  = desc->lodMaxClamp;
+  key->compare        = (uint32_t)desc->compare;
+  key->max_anisotropy = (uint32_t)desc->maxAnisotropy;
+}
+
+static wgpu_sampler_cache_t*
+wgpu_get_sampler_cache(wgpu_context_t* wgpu_context)
+{
+  if (wgpu_context->sampler_cache == NULL) {
+    wgpu_context->sampler_cache = wgpu_sampler_cache_create();
+  }
+  return wgpu_context->sampler_cache;
+}
+
+/* Returns the entry of the key, NULL on a miss */
+static wgpu_sampler_cache_entry_t*
+wgpu_sampler_cache_find(wgpu_sampler_cache_t* sampler_cache,
+                        const wgpu_sampler_key_t* key, uint64_t hash)
+{
+  for (uint32_t i = 0; i < sampler_cache->entry_count; ++i) {
+    wgpu_sampler_cache_entry_t* entry = &sampler_cache->entries[i];
+    if (entry->hash == hash
+        && memcmp(&entry->key, key, sizeof(wgpu_sampler_key_t)) == 0) {
+      ++sampler_cache->hit_count;
+      return entry;
+    }
+  }
+  ++sampler_cache->miss_count;
+  return NULL;
+}
+
+static void wgpu_sampler_cache_insert(wgpu_sampler_cache_t* sampler_cache,
+                                      const wgpu_sampler_key_t* key,
+                                      uint64_t hash, WGPUSampler sampler)
+{
+  if (sampler_cache->entry_count == sampler_cache->entry_capacity) {
+    uint32_t capacity = MAX(sampler_cache->entry_capacity * 2, 16u);
+    wgpu_sampler_cache_entry_t* entries = (wgpu_sampler_cache_entry_t*)realloc(
+      sampler_cache->entries, capacity * sizeof(wgpu_sampler_cache_entry_t));
+    ASSERT(entries != NULL);
+    sampler_cache->entries        = entries;
+    sampler_cache->entry_capacity = capacity;
+  }
+  sampler_cache->entries[sampler_cache->entry_count++]
+    = (wgpu_sampler_cache_entry_t){
+      .hash    = hash,
+      .key     = *key,
+      .sampler = sampler,
+    };
+}
+
+WGPUSampler wgpu_sampler_cache_get_sampler(wgpu_context_t* wgpu_context,
+                                           WGPUSamplerDescriptor const* desc)
+{
+  if (desc == NULL || desc->nextInChain != NULL) {
+    return wgpuDeviceCreateSampler(wgpu_context->device, desc);
+  }
+
+  wgpu_sampler_key_t key;
+  wgpu_sampler_key_init(&key, desc);
+  wgpu_sampler_cache_t* sampler_cache = wgpu_get_sampler_cache(wgpu_context);
+  const uint64_t hash = wgpu_sampler_cache_hash(&key, sizeof(key));
+  wgpu_sampler_cache_entry_t* entry
+    = wgpu_sampler_cache_find(sampler_cache, &key, hash);
+  if (entry != NULL) {
+    wgpuSamplerReference(entry->sampler);
+    return entry->sampler;
+  }
+
+  WGPUSampler sampler = wgpuDeviceCreateSampler(wgpu_context->device, desc);
+  if (sampler == NULL) {
+    return NULL;
+  }
+  wgpu_sampler_cache_insert(sampler_cache, &key, hash, sampler);
+
+  /* One reference for the cache, one for the caller */
+  wgpuSamplerReference(sampler);
+  return sampler;
+}
@@ -0,0 +1,25 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include "context.h"
+
+/**
+ * Sampler cache: samplers are shared per context, keyed by their full
+ * descriptor (address modes, filters, LOD clamps, compare function and
+ * anisotropy) except for the label. Textures with the same sampling state,
+ * e.g. the images of a glTF model, get the same sampler handle, which keeps
+ * the sampler count low and lets bind groups compare samplers by handle.
+ *
+ * Descriptors with chained structs are not cached. Every returned sampler
+ * holds its own reference and must be released by the caller as before, the
+ * cache keeps one reference on every sampler it holds until the context is
+ * released.
+ */
+typedef struct wgpu_sampler_cache_t wgpu_sampler_cache_t;
+void wgpu_sampler_cache_destroy(wgpu_sampler_cache_t* sampler_cache);
+
+/* Returns the sampler of the descriptor, creating it on first use */
+WGPUSampler wgpu_sampler_cache_get_sampler(wgpu_context_t* wgpu_context,
+                                           WGPUSamplerDescriptor const* desc);
+
+#endif
@@ -1,11 +1,15 @@
 #include "shader.h"
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "../core/file.h"
 #include "../core/log.h"
 #include "../core/macro.h"
+#include "../core/profiler.h"
+
+#include "frame_uniforms.h"
 
 static void
 wgpu_compilation_info_callback(WGPUCompilationInfoRequestStatus status,
@@ -25,13 +29,16 @@ wgpu_compilation_info_callback(WGPUCompilationInfoRequestStatus status,
 WGPUShaderModule wgpu_create_shader_module_from_spirv_file(WGPUDevice device,
                                                            const char* filename)
 {
-  file_read_result_t result;
-  read_file(filename, &result, 0);
-  log_debug("Read file: %s, size: %d bytes\n", filename, result.size);
+  file_mapping_t mapping;
+  if (!file_map(filename, &mapping)) {
+    return NULL;
+  }
+  log_debug("Mapped file: %s, size: %llu bytes\n", filename,
+            (unsigned long long)mapping.size);
   WGPUShaderModule shader_module
-    = wgpu_create_shader_module_from_spirv_bytecode(device, result.data,
-                                                    result.size);
-  free(result.data);
+    = wgpu_create_shader_module_from_spirv_bytecode(device, mapping.data,
+                                                    (uint32_t)mapping.size);
+  file_unmap(&mapping);
   return shader_module;
 }
 
@@ -47,36 +54,370 @@ WGPUShaderModule wgpu_create_shader_module_from_wgsl_file(WGPUDevice device,
   return shader_module;
 }
 
+/* Shader module cache */
+typedef struct wgpu_shader_cache_entry_t {
+  uint64_t hash;
+  uint32_t size;
+  bool is_spirv;
+  WGPUShaderModule module;
+} wgpu_shader_cache_entry_t;
+
+/* Bind group layout cache */
+typedef struct wgpu_bind_group_layout_cache_entry_t {
+  uint64_t hash;
+  uint32_t entry_count;
+  WGPUBindGroupLayoutEntry* entries;
+  WGPUBindGroupLayout layout;
+} wgpu_bind_group_layout_cache_entry_t;
+
+/* Pipeline layout cache */
+typedef struct wgpu_pipeline_layout_cache_entry_t {
+  uint32_t bind_group_layout_count;
+  WGPUBindGroupLayout bind_group_layouts[WGPU_SHADER_MAX_BIND_GROUPS];
+  WGPUPipelineLayout layout;
+} wgpu_pipeline_layout_cache_entry_t;
+
+struct wgpu_shader_cache_t {
+  wgpu_shader_cache_entry_t* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  uint32_t hit_count;
+  uint32_t miss_count;
+  struct {
+    wgpu_bind_group_layout_cache_entry_t* entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    uint32_t hit_count;
+  } bind_group_layouts;
+  struct {
+    wgpu_pipeline_layout_cache_entry_t* entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    uint32_t hit_count;
+  } pipeline_layouts;
+};
+
+/* 64-bit FNV-1a */
+static uint64_t wgpu_shader_hash(uint64_t hash, const void* data, size_t size)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static wgpu_shader_cache_t* wgpu_shader_cache_create(void)
+{
+  wgpu_shader_cache_t* shader_cache
+    = (wgpu_shader_cache_t*)malloc(sizeof(wgpu_shader_cache_t));
+  memset(shader_cache, 0, sizeof(wgpu_shader_cache_t));
+  return shader_cache;
+}
+
+void wgpu_shader_cache_destroy(wgpu_shader_cache_t* shader_cache)
+{
+  log_debug("Shader cache: %u modules, %u hits, %u misses",
+            shader_cache->entry_count, shader_cache->hit_count,
+            shader_cache->miss_count);
+  log_debug("Layout cache: %u bind group layouts, %u hits, %u pipeline "
+            "layouts, %u hits",
+            shader_cache->bind_group_layouts.entry_count,
+            shader_cache->bind_group_layouts.hit_count,
+            shader_cache->pipeline_layouts.entry_count,
+            shader_cache->pipeline_layouts.hit_count);
+  for (uint32_t i = 0; i < shader_cache->entry_count; ++i) {
+    WGPU_RELEASE_RESOURCE(ShaderModule, shader_cache->entries[i].module)
+  }
+  for (uint32_t i = 0; i < shader_cache->pipeline_layouts.entry_count; ++i) {
+    WGPU_RELEASE_RESOURCE(PipelineLayout,
+                          shader_cache->pipeline_layouts.entries[i].layout)
+  }
+  for (uint32_t i = 0; i < shader_cache->bind_group_layouts.entry_count; ++i) {
+    wgpu_bind_group_layout_cache_entry_t* entry
+      = &shader_cache->bind_group_layouts.entries[i];
+    WGPU_RELEASE_RESOURCE(BindGroupLayout, entry->layout)
+    free(entry->entries);
+  }
+  free(shader_cache->entries);
+  free(shader_cache->bind_group_layouts.entries);
+  free(shader_cache->pipeline_layouts.entries);
+  free(shader_cache);
+}
+
+static wgpu_shader_cache_t* wgpu_get_shader_cache(wgpu_context_t* wgpu_context)
+{
+  if (wgpu_context->shader_cache == NULL) {
+    wgpu_context->shader_cache = wgpu_shader_cache_create();
+  }
+  return wgpu_context->shader_cache;
+}
+
+/**
+ * @brief Returns a shader module for the given SPIR-V bytecode or WGSL source,
+ * creating it on first use. The cache keeps one reference on every module it
+ * holds, each returned module carries an extra reference owned by the caller.
+ */
+static WGPUShaderModule wgpu_shader_cache_acquire(wgpu_context_t* wgpu_context,
+                                                  const uint8_t* data,
+                                                  uint32_t size, bool is_spirv,
+                                                  const char* entry)
+{
+  wgpu_shader_cache_t* shader_cache = wgpu_get_shader_cache(wgpu_context);
+
+  entry         = entry ? entry : "main";
+  uint64_t hash = wgpu_shader_hash(0xcbf29ce484222325ull, data, size);
+  hash          = wgpu_shader_hash(hash, entry, strlen(entry) + 1);
+
+  for (uint32_t i = 0; i < shader_cache->entry_count; ++i) {
+    wgpu_shader_cache_entry_t* cache_entry = &shader_cache->entries[i];
+    if (cache_entry->hash == hash && cache_entry->size == size
+        && cache_entry->is_spirv == is_spirv) {
+      ++shader_cache->hit_count;
+      wgpuShaderModuleReference(cache_entry->module);
+      return cache_entry->module;
+    }
+  }
+
+  WGPUShaderModule shader_module
+    = is_spirv ? wgpu_create_shader_module_from_spirv_bytecode(
+        wgpu_context->device, data, size) :
+                 wgpu_create_shader_module_from_wgsl(wgpu_context->device,
+                                                     (const char*)data);
+  if (shader_module == NULL) {
+    return NULL;
+  }
+  ++shader_cache->miss_count;
+
+  if (shader_cache->entry_count == shader_cache->entry_capacity) {
+    uint32_t capacity = MAX(shader_cache->entry_capacity * 2, 16u);
+    wgpu_shader_cache_entry_t* entries = (wgpu_shader_cache_entry_t*)realloc(
+      shader_cache->entries, capacity * sizeof(wgpu_shader_cache_entry_t));
+    ASSERT(entries != NULL);
+    shader_cache->entries        = entries;
+    shader_cache->entry_capacity = capacity;
+  }
+  shader_cache->entries[shader_cache->entry_count++]
+    = (wgpu_shader_cache_entry_t){
+      .hash     = hash,
+      .size     = size,
+      .is_spirv = is_spirv,
+      .module   = shader_module,
+    };
+
+  /* One reference for the cache, one for the caller */
+  wgpuShaderModuleReference(shader_module);
+  return shader_module;
+}
+
+WGPUBindGroupLayout
+wgpu_get_bind_group_layout(wgpu_context_t* wgpu_context,
+                           const WGPUBindGroupLayoutEntry* entries,
+                           uint32_t entry_count)
+{
+  wgpu_shader_cache_t* shader_cache = wgpu_get_shader_cache(wgpu_context);
+  const size_t entries_size = entry_count * sizeof(WGPUBindGroupLayoutEntry);
+  const uint64_t hash
+    = wgpu_shader_hash(0xcbf29ce484222325ull, entries, entries_size);
+
+  for (uint32_t i = 0; i < shader_cache->bind_group_layouts.entry_count; ++i) {
+    wgpu_bind_group_layout_cache_entry_t* cache_entry
+      = &shader_cache->bind_group_layouts.entries[i];
+    if (cache_entry->hash == hash && cache_entry->entry_count == entry_count
+        && memcmp(cache_entry->entries, entries, entries_size) == 0) {
+      ++shader_cache->bind_group_layouts.hit_count;
+      wgpuBindGroupLayoutReference(cache_entry->layout);
+      return cache_entry->layout;
+    }
+  }
+
+  WGPUBindGroupLayout layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .entryCount = entry_count,
+                            .entries    = entries,
+                          });
+  if (layout == NULL) {
+    return NULL;
+  }
+
+  if (shader_cache->bind_group_layouts.entry_count
+      == shader_cache->bind_group_layouts.entry_capacity) {
+    uint32_t capacity
+      = MAX(shader_cache->bind_group_layouts.entry_capacity * 2, 16u);
+    wgpu_bind_group_layout_cache_entry_t* cache_entries = realloc(
+      shader_cache->bind_group_layouts.entries,
+      capacity * sizeof(wgpu_bind_group_layout_cache_entry_t));
+    ASSERT(cache_entries != NULL);
+    shader_cache->bind_group_layouts.entries        = cache_entries;
+    shader_cache->bind_group_layouts.entry_capacity = capacity;
+  }
+  wgpu_bind_group_layout_cache_entry_t* cache_entry
+    = &shader_cache->bind_group_layouts
+         .entries[shader_cache->bind_group_layouts.entry_count++];
+  *cache_entry = (wgpu_bind_group_layout_cache_entry_t){
+    .hash        = hash,
+    .entry_count = entry_count,
+    .entries     = malloc(MAX(entries_size, 1)),
+    .layout      = layout,
+  };
+  memcpy(cache_entry->entries, entries, entries_size);
+
+  /* One reference for the cache, one for the caller */
+  wgpuBindGroupLayoutReference(layout);
+  return layout;
+}
+
+WGPUPipelineLayout
+wgpu_get_pipeline_layout(wgpu_context_t* wgpu_context,
+                         const WGPUBindGroupLayout* bind_group_layouts,
+                         uint32_t bind_group_layout_count)
+{
+  ASSERT(bind_group_layout_count <= WGPU_SHADER_MAX_BIND_GROUPS);
+  wgpu_shader_cache_t* shader_cache = wgpu_get_shader_cache(wgpu_context);
+  const size_t layouts_size
+    = bind_group_layout_count * sizeof(WGPUBindGroupLayout);
+
+  /* The cached pipeline layouts keep their bind group layouts alive, so the
+   * handles are not reused by other layouts */
+  for (uint32_t i = 0; i < shader_cache->pipeline_layouts.entry_count; ++i) {
+    wgpu_pipeline_layout_cache_entry_t* cache_entry
+      = &shader_cache->pipeline_layouts.entries[i];
+    if (cache_entry->bind_group_layout_count == bind_group_layout_count
+        && memcmp(cache_entry->bind_group_layouts, bind_group_layouts,
+                  layouts_size)
+             == 0) {
+      ++shader_cache->pipeline_layouts.hit_count;
+      wgpuPipelineLayoutReference(cache_entry->layout);
+      return cache_entry->layout;
+    }
+  }
+
+  WGPUPipelineLayout layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .bindGroupLayoutCount = bind_group_layout_count,
+                            .bindGroupLayouts     = bind_group_layouts,
+                          });
+  if (layout == NULL) {
+    return NULL;
+  }
+
+  if (shader_cache->pipeline_layouts.entry_count
+      == shader_cache->pipeline_layouts.entry_capacity) {
+    uint32_t capacity
+      = MAX(shader_cache->pipeline_layouts.entry_capacity * 2, 16u);
+    wgpu_pipeline_layout_cache_entry_t* cache_entries
+      = realloc(shader_cache->pipeline_layouts.entries,
+                capacity * sizeof(wgpu_pipeline_layout_cache_entry_t));
+    ASSERT(cache_entries != NULL);
+    shader_cache->pipeline_layouts.entries        = cache_entries;
+    shader_cache->pipeline_layouts.entry_capacity = capacity;
+  }
+  wgpu_pipeline_layout_cache_entry_t* cache_entry
+    = &shader_cache->pipeline_layouts
+         .entries[shader_cache->pipeline_layouts.entry_count++];
+  memset(cache_entry, 0, sizeof(*cache_entry));
+  cache_entry->bind_group_layout_count = bind_group_layout_count;
+  memcpy(cache_entry->bind_group_layouts, bind_group_layouts, layouts_size);
+  cache_entry->layout = layout;
+
+  /* One reference for the cache, one for the caller */
+  wgpuPipelineLayoutReference(layout);
+  return layout;
+}
+
+/* Precision preludes of half precision WGSL sources */
+static const char* wgsl_f16_prelude = "enable f16;\nalias hfloat = f16;\n";
+static const char* wgsl_f32_prelude = "alias hfloat = f32;\n";
+
+/* Acquires the module of the WGSL source, prefixed with the precision prelude
+ * of half precision shaders and the frame uniforms declaration. The preludes
+ * are part of the hashed bytes, so the f16 and the f32 variant are cached side
+ * by side. */
+static WGPUShaderModule
+wgpu_shader_cache_acquire_wgsl(wgpu_context_t* wgpu_context,
+                               const wgpu_shader_desc_t* shader_desc,
+                               const char* source, uint32_t size)
+{
+  if (!shader_desc->half_precision && !shader_desc->frame_uniforms) {
+    return wgpu_shader_cache_acquire(wgpu_context, (const uint8_t*)source,
+                                     size, false, shader_desc->entry);
+  }
+
+  /* The enable directive of the precision prelude has to come first */
+  const char* precision_prelude = "";
+  if (shader_desc->half_precision) {
+    precision_prelude
+      = wgpu_has_feature(wgpu_context, WGPUFeatureName_DawnShaderFloat16) ?
+          wgsl_f16_prelude :
+          wgsl_f32_prelude;
+  }
+  const char* frame_prelude
+    = shader_desc->frame_uniforms ? wgpu_frame_uniforms_get_wgsl() : "";
+  const uint32_t precision_size = (uint32_t)strlen(precision_prelude);
+  const uint32_t frame_size     = (uint32_t)strlen(frame_prelude);
+  const uint32_t prelude_size   = precision_size + frame_size + 1;
+  char* prefixed                = malloc(prelude_size + size + 1);
+  memcpy(prefixed, precision_prelude, precision_size);
+  memcpy(prefixed + precision_size, frame_prelude, frame_size);
+  prefixed[prelude_size - 1] = '\n';
+  memcpy(prefixed + prelude_size, source, size);
+  prefixed[prelude_size + size] = '\0';
+
+  WGPUShaderModule shader_module = wgpu_shader_cache_acquire(
+    wgpu_context, (const uint8_t*)prefixed, prelude_size + size, false,
+    shader_desc->entry);
+  free(prefixed);
+  return shader_module;
+}
+
 WGPUShaderModule
 wgpu_create_shader_module(wgpu_context_t* wgpu_context,
                           const wgpu_shader_desc_t* shader_desc)
 {
+  PROFILE_BEGIN("wgpu_create_shader_module");
+
   WGPUShaderModule shader_module = NULL;
+  file_read_result_t file        = {0};
 
   if (shader_desc->file != NULL) {
     /* WebGPU Shader from file */
     if (filename_has_extension(shader_desc->file, "spv")) {
-      shader_module = wgpu_create_shader_module_from_spirv_file(
-        wgpu_context->device, shader_desc->file);
+      /* SPIR-V is hashed and compiled straight from the mapped file */
+      file_mapping_t mapping;
+      if (file_map(shader_desc->file, &mapping)) {
+        log_debug("Mapped file: %s, size: %llu bytes\n", shader_desc->file,
+                  (unsigned long long)mapping.size);
+        shader_module = wgpu_shader_cache_acquire(
+          wgpu_context, mapping.data, (uint32_t)mapping.size, true,
+          shader_desc->entry);
+        file_unmap(&mapping);
+      }
     }
     else if (filename_has_extension(shader_desc->file, "wgsl")) {
-      shader_module = wgpu_create_shader_module_from_wgsl_file(
-        wgpu_context->device, shader_desc->file);
+      read_file(shader_desc->file, &file, 1);
+      log_debug("Read file: %s, size: %d bytes\n", shader_desc->file,
+                file.size);
+      shader_module = wgpu_shader_cache_acquire_wgsl(
+        wgpu_context, shader_desc, (const char*)file.data, file.size);
     }
+    free(file.data);
   }
   else if ((shader_desc->byte_code.data != NULL)
            && (shader_desc->byte_code.size != 0)) {
     /* WebGPU Shader from SPIR-V bytecode */
-    shader_module = wgpu_create_shader_module_from_spirv_bytecode(
-      wgpu_context->device, shader_desc->byte_code.data,
-      shader_desc->byte_code.size);
+    shader_module = wgpu_shader_cache_acquire(
+      wgpu_context, shader_desc->byte_code.data, shader_desc->byte_code.size,
+      true, shader_desc->entry);
   }
   else if (shader_desc->wgsl_code.source != NULL) {
     /* WebGPU Shader from WGSL code */
-    shader_module = wgpu_create_shader_module_from_wgsl(
-      wgpu_context->device, shader_desc->wgsl_code.source);
+    const char* source = shader_desc->wgsl_code.source;
+    shader_module      = wgpu_shader_cache_acquire_wgsl(
+      wgpu_context, shader_desc, source, (uint32_t)strlen(source));
   }
 
+  PROFILE_END();
   return shader_module;
 }
 
@@ -139,8 +480,10 @@ wgpu_shader_t wgpu_shader_create(wgpu_context_t* wgpu_context,
   ASSERT(shader.module);
 
   shader.programmable_stage_descriptor = (WGPUProgrammableStageDescriptor){
-    .module     = shader.module,
-    .entryPoint = desc->entry ? desc->entry : "main",
+    .module        = shader.module,
+    .entryPoint    = desc->entry ? desc->entry : "main",
+    .constantCount = desc->constant_count,
+    .constants     = desc->constants,
   };
 
   return shader;
@@ -168,9 +511,11 @@ WGPUVertexState wgpu_create_vertex_state(wgpu_context_t* wgpu_context,
   vertex_state.module = wgpu_create_shader_module(wgpu_context, shader_desc);
   ASSERT(vertex_state.module);
 
-  vertex_state.entryPoint  = shader_desc->entry ? shader_desc->entry : "main",
-  vertex_state.bufferCount = desc->buffer_count,
-  vertex_state.buffers     = desc->buffers;
+  vertex_state.entryPoint    = shader_desc->entry ? shader_desc->entry : "main",
+  vertex_state.constantCount = shader_desc->constant_count,
+  vertex_state.constants     = shader_desc->constants,
+  vertex_state.bufferCount   = desc->buffer_count,
+  vertex_state.buffers       = desc->buffers;
 
   return vertex_state;
 }
@@ -191,9 +536,846 @@ WGPUFragmentState wgpu_create_fragment_state(wgpu_context_t* wgpu_context,
   fragment_state.module = wgpu_create_shader_module(wgpu_context, shader_desc);
   ASSERT(fragment_state.module);
 
-  fragment_state.entryPoint  = shader_desc->entry ? shader_desc->entry : "main",
-  fragment_state.targetCount = desc->target_count,
-  fragment_state.targets     = desc->targets;
+  fragment_state.entryPoint = shader_desc->entry ? shader_desc->entry : "main",
+  fragment_state.constantCount = shader_desc->constant_count,
+  fragment_state.constants     = shader_desc->constants,
+  fragment_state.targetCount   = desc->target_count,
+  fragment_state.targets       = desc->targets;
 
   return fragment_state;
 }
+
+/*
+ * WGSL resource reflection
+ *
+ * The source is split into tokens, the module-scope declarations are parsed
+ * with just enough of the grammar to lay out structures (offsets, sizes and
+ * alignments as defined by the WGSL memory layout rules) and to find the
+ * resource variables, the functions and the entry points.
+ */
+#define WGSL_ARRAY_PUSH(array, count, capacity, value)                         \
+  do {                                                                         \
+    if ((count) == (capacity)) {                                               \
+      (capacity) = MAX((capacity) * 2, 16u);                                   \
+      (array)    = realloc((array), (capacity) * sizeof(*(array)));            \
+      ASSERT((array) != NULL);                                                 \
+    }                                                                          \
+    (array)[(count)++] = (value);                                              \
+  } while (0)
+
+typedef struct wgsl_token_t {
+  const char* start;
+  uint32_t length;
+} wgsl_token_t;
+
+/* Size and alignment of a host-shareable type */
+typedef struct wgsl_layout_t {
+  uint32_t size;
+  uint32_t align;
+  bool known;
+} wgsl_layout_t;
+
+/* Structure or alias */
+typedef struct wgsl_type_t {
+  wgsl_token_t name;
+  wgsl_layout_t layout;
+} wgsl_type_t;
+
+typedef struct wgsl_constant_t {
+  wgsl_token_t name;
+  uint32_t value;
+} wgsl_constant_t;
+
+typedef struct wgsl_function_t {
+  wgsl_token_t name;
+  uint32_t body_begin; /* token range of the body */
+  uint32_t body_end;
+  WGPUShaderStageFlags stage; /* entry point stage, none for functions */
+} wgsl_function_t;
+
+typedef struct wgsl_binding_t {
+  wgsl_token_t name;
+  uint32_t group;
+  WGPUBindGroupLayoutEntry entry;
+} wgsl_binding_t;
+
+typedef struct wgsl_attributes_t {
+  int32_t group;
+  int32_t binding;
+  int32_t align;
+  int32_t size;
+  WGPUShaderStageFlags stage;
+} wgsl_attributes_t;
+
+typedef struct wgsl_parser_t {
+  wgsl_token_t* tokens;
+  uint32_t token_count;
+  uint32_t token_capacity;
+  uint32_t pos;
+  wgsl_type_t* types;
+  uint32_t type_count;
+  uint32_t type_capacity;
+  wgsl_constant_t* constants;
+  uint32_t constant_count;
+  uint32_t constant_capacity;
+  wgsl_function_t* functions;
+  uint32_t function_count;
+  uint32_t function_capacity;
+  wgsl_binding_t* bindings;
+  uint32_t binding_count;
+  uint32_t binding_capacity;
+} wgsl_parser_t;
+
+static bool wgsl_is_ident_char(char c)
+{
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+static void wgsl_tokenize(wgsl_parser_t* p, const char* source)
+{
+  const char* c = source;
+  while (*c != '\0') {
+    if (isspace((unsigned char)*c)) {
+      ++c;
+      continue;
+    }
+    if (c[0] == '/' && c[1] == '/') {
+      while (*c != '\0' && *c != '\n') {
+        ++c;
+      }
+      continue;
+    }
+    if (c[0] == '/' && c[1] == '*') {
+      // Block comments nest in WGSL
+      uint32_t depth = 1;
+      c += 2;
+      while (*c != '\0' && depth > 0) {
+        if (c[0] == '/' && c[1] == '*') {
+          ++depth;
+          c += 2;
+        }
+        else if (c[0] == '*' && c[1] == '/') {
+          --depth;
+          c += 2;
+        }
+        else {
+          ++c;
+        }
+      }
+      continue;
+    }
+    const char* start = c;
+    if (isalpha((unsigned char)*c) || *c == '_') {
+      while (wgsl_is_ident_char(*c)) {
+        ++c;
+      }
+    }
+    else if (isdigit((unsigned char)*c)
+             || (*c == '.' && isdigit((unsigned char)c[1]))) {
+      const bool hex = c[0] == '0' && (c[1] == 'x' || c[1] == 'X');
+      while (wgsl_is_ident_char(*c) || *c == '.'
+             || (!hex && (*c == '+' || *c == '-')
+                 && (c[-1] == 'e' || c[-1] == 'E'))) {
+        ++c;
+      }
+    }
+    else {
+      ++c;
+    }
+    const wgsl_token_t token = {
+      .start  = start,
+      .length = (uint32_t)(c - start),
+    };
+    WGSL_ARRAY_PUSH(p->tokens, p->token_count, p->token_capacity, token);
+  }
+}
+
+static bool wgsl_token_is(const wgsl_token_t* token, const char* str)
+{
+  const size_t length = strlen(str);
+  return token->length == length && memcmp(token->start, str, length) == 0;
+}
+
+static bool wgsl_token_equal(const wgsl_token_t* a, const wgsl_token_t* b)
+{
+  return a->length == b->length && memcmp(a->start, b->start, a->length) == 0;
+}
+
+static bool wgsl_token_is_ident(const wgsl_token_t* token)
+{
+  return token->length > 0
+         && (isalpha((unsigned char)token->start[0])
+             || token->start[0] == '_');
+}
+
+static const wgsl_token_t* wgsl_peek(wgsl_parser_t* p, uint32_t offset)
+{
+  static const wgsl_token_t end = {"", 0};
+  return p->pos + offset < p->token_count ? &p->tokens[p->pos + offset] :
+                                            &end;
+}
+
+static const wgsl_token_t* wgsl_next(wgsl_parser_t* p)
+{
+  const wgsl_token_t* token = wgsl_peek(p, 0);
+  if (p->pos < p->token_count) {
+    ++p->pos;
+  }
+  return token;
+}
+
+static bool wgsl_accept(wgsl_parser_t* p, const char* str)
+{
+  if (wgsl_token_is(wgsl_peek(p, 0), str)) {
+    ++p->pos;
+    return true;
+  }
+  return false;
+}
+
+/* Skips the balanced token range starting at the current open token */
+static void wgsl_skip_balanced(wgsl_parser_t* p, const char* open,
+                               const char* close)
+{
+  if (!wgsl_accept(p, open)) {
+    return;
+  }
+  uint32_t depth = 1;
+  while (p->pos < p->token_count && depth > 0) {
+    const wgsl_token_t* token = wgsl_next(p);
+    if (wgsl_token_is(token, open)) {
+      ++depth;
+    }
+    else if (wgsl_token_is(token, close)) {
+      --depth;
+    }
+  }
+}
+
+static void wgsl_skip_statement(wgsl_parser_t* p)
+{
+  while (p->pos < p->token_count && !wgsl_accept(p, ";")) {
+    ++p->pos;
+  }
+}
+
+/* Integer literal or constant */
+static bool wgsl_parse_integer(wgsl_parser_t* p, uint32_t* value)
+{
+  const wgsl_token_t* token = wgsl_next(p);
+  if (token->length > 0 && isdigit((unsigned char)token->start[0])) {
+    *value = (uint32_t)strtoul(token->start, NULL, 0);
+    return true;
+  }
+  for (uint32_t i = 0; i < p->constant_count; ++i) {
+    if (wgsl_token_equal(&p->constants[i].name, token)) {
+      *value = p->constants[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void wgsl_parse_attributes(wgsl_parser_t* p, wgsl_attributes_t* attrs)
+{
+  *attrs = (wgsl_attributes_t){
+    .group   = -1,
+    .binding = -1,
+    .align   = -1,
+    .size    = -1,
+    .stage   = WGPUShaderStage_None,
+  };
+  while (wgsl_accept(p, "@")) {
+    const wgsl_token_t* name = wgsl_next(p);
+    int32_t value            = -1;
+    if (wgsl_token_is(wgsl_peek(p, 0), "(")) {
+      // Only the first argument is of interest
+      const uint32_t pos = p->pos++;
+      uint32_t integer   = 0;
+      if (wgsl_parse_integer(p, &integer)) {
+        value = (int32_t)integer;
+      }
+      p->pos = pos;
+      wgsl_skip_balanced(p, "(", ")");
+    }
+    if (wgsl_token_is(name, "group")) {
+      attrs->group = value;
+    }
+    else if (wgsl_token_is(name, "binding")) {
+      attrs->binding = value;
+    }
+    else if (wgsl_token_is(name, "align")) {
+      attrs->align = value;
+    }
+    else if (wgsl_token_is(name, "size")) {
+      attrs->size = value;
+    }
+    else if (wgsl_token_is(name, "vertex")) {
+      attrs->stage = WGPUShaderStage_Vertex;
+    }
+    else if (wgsl_token_is(name, "fragment")) {
+      attrs->stage = WGPUShaderStage_Fragment;
+    }
+    else if (wgsl_token_is(name, "compute")) {
+      attrs->stage = WGPUShaderStage_Compute;
+    }
+  }
+}
+
+static uint32_t wgsl_round_up(uint32_t value, uint32_t alignment)
+{
+  alignment = MAX(alignment, 1u);
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static wgsl_layout_t wgsl_parse_type(wgsl_parser_t* p);
+
+/* Component type of vecN<T>, matCxR<T> and their f, h, i and u suffixed
+ * aliases */
+static wgsl_layout_t wgsl_parse_component_type(wgsl_parser_t* p,
+                                               const wgsl_token_t* name,
+                                               uint32_t suffix_pos)
+{
+  wgsl_layout_t component = {4, 4, true};
+  if (name->length > suffix_pos) {
+    component.known = strchr("fiuh", name->start[suffix_pos]) != NULL;
+    if (name->start[suffix_pos] == 'h') {
+      component.size = component.align = 2;
+    }
+  }
+  else if (wgsl_accept(p, "<")) {
+    component = wgsl_parse_type(p);
+    wgsl_accept(p, ">");
+  }
+  return component;
+}
+
+static wgsl_layout_t wgsl_parse_type(wgsl_parser_t* p)
+{
+  const wgsl_token_t* name = wgsl_next(p);
+  const char* str          = name->start;
+  wgsl_layout_t layout     = {0};
+
+  if (wgsl_token_is(name, "f32") || wgsl_token_is(name, "i32")
+      || wgsl_token_is(name, "u32") || wgsl_token_is(name, "bool")) {
+    layout = (wgsl_layout_t){4, 4, true};
+  }
+  else if (wgsl_token_is(name, "f16")) {
+    layout = (wgsl_layout_t){2, 2, true};
+  }
+  else if (wgsl_token_is(name, "atomic")) {
+    wgsl_accept(p, "<");
+    layout = wgsl_parse_type(p);
+    wgsl_accept(p, ">");
+  }
+  else if (name->length >= 4 && strncmp(str, "vec", 3) == 0
+           && str[3] >= '2' && str[3] <= '4') {
+    const uint32_t n                = (uint32_t)(str[3] - '0');
+    const wgsl_layout_t component   = wgsl_parse_component_type(p, name, 4);
+    layout.size                     = n * component.size;
+    layout.align                    = (n == 3 ? 4 : n) * component.size;
+    layout.known                    = component.known;
+  }
+  else if (name->length >= 6 && strncmp(str, "mat", 3) == 0
+           && str[3] >= '2' && str[3] <= '4' && str[4] == 'x'
+           && str[5] >= '2' && str[5] <= '4') {
+    // Column-major, the columns are vecR
+    const uint32_t columns        = (uint32_t)(str[3] - '0');
+    const uint32_t rows           = (uint32_t)(str[5] - '0');
+    const wgsl_layout_t component = wgsl_parse_component_type(p, name, 6);
+    layout.align = (rows == 3 ? 4 : rows) * component.size;
+    layout.size  = columns * layout.align;
+    layout.known = component.known;
+  }
+  else if (wgsl_token_is(name, "array")) {
+    wgsl_accept(p, "<");
+    const wgsl_layout_t element = wgsl_parse_type(p);
+    // Runtime-sized arrays count one element for the minimum binding size
+    uint32_t count  = 1;
+    bool count_known = true;
+    if (wgsl_accept(p, ",")) {
+      count_known = wgsl_parse_integer(p, &count);
+    }
+    wgsl_accept(p, ">");
+    const uint32_t stride = wgsl_round_up(element.size, element.align);
+    layout.size           = count * stride;
+    layout.align          = element.align;
+    layout.known          = element.known && count_known;
+  }
+  else {
+    for (uint32_t i = 0; i < p->type_count; ++i) {
+      if (wgsl_token_equal(&p->types[i].name, name)) {
+        layout = p->types[i].layout;
+        break;
+      }
+    }
+    if (wgsl_token_is(wgsl_peek(p, 0), "<")) {
+      wgsl_skip_balanced(p, "<", ">");
+    }
+  }
+  return layout;
+}
+
+static void wgsl_parse_struct(wgsl_parser_t* p)
+{
+  wgsl_type_t type = {
+    .name   = *wgsl_next(p),
+    .layout = {0, 1, true},
+  };
+  wgsl_accept(p, "{");
+  uint32_t offset = 0;
+  while (p->pos < p->token_count && !wgsl_accept(p, "}")) {
+    wgsl_attributes_t attrs;
+    wgsl_parse_attributes(p, &attrs);
+    wgsl_next(p); // member name
+    wgsl_accept(p, ":");
+    const wgsl_layout_t member = wgsl_parse_type(p);
+    wgsl_accept(p, ",");
+    const uint32_t align
+      = attrs.align > 0 ? (uint32_t)attrs.align : member.align;
+    const uint32_t size = attrs.size > 0 ? (uint32_t)attrs.size : member.size;
+    offset              = wgsl_round_up(offset, align) + size;
+    type.layout.align   = MAX(type.layout.align, align);
+    type.layout.known   = type.layout.known && member.known;
+  }
+  wgsl_accept(p, ";");
+  type.layout.size = wgsl_round_up(offset, type.layout.align);
+  WGSL_ARRAY_PUSH(p->types, p->type_count, p->type_capacity, type);
+}
+
+static void wgsl_parse_alias(wgsl_parser_t* p)
+{
+  wgsl_type_t type = {
+    .name = *wgsl_next(p),
+  };
+  wgsl_accept(p, "=");
+  type.layout = wgsl_parse_type(p);
+  wgsl_accept(p, ";");
+  WGSL_ARRAY_PUSH(p->types, p->type_count, p->type_capacity, type);
+}
+
+/* Module-scope constants with a literal value, used as array sizes */
+static void wgsl_parse_constant(wgsl_parser_t* p)
+{
+  wgsl_constant_t constant = {
+    .name = *wgsl_next(p),
+  };
+  if (wgsl_accept(p, ":")) {
+    wgsl_parse_type(p);
+  }
+  if (wgsl_accept(p, "=") && wgsl_token_is(wgsl_peek(p, 1), ";")
+      && wgsl_parse_integer(p, &constant.value)) {
+    WGSL_ARRAY_PUSH(p->constants, p->constant_count, p->constant_capacity,
+                    constant);
+  }
+  wgsl_skip_statement(p);
+}
+
+static void wgsl_parse_function(wgsl_parser_t* p, WGPUShaderStageFlags stage)
+{
+  wgsl_function_t function = {
+    .name  = *wgsl_next(p),
+    .stage = stage,
+  };
+  wgsl_skip_balanced(p, "(", ")");
+  // Return type
+  while (p->pos < p->token_count && !wgsl_token_is(wgsl_peek(p, 0), "{")) {
+    ++p->pos;
+  }
+  function.body_begin = p->pos;
+  wgsl_skip_balanced(p, "{", "}");
+  function.body_end = p->pos;
+  WGSL_ARRAY_PUSH(p->functions, p->function_count, p->function_capacity,
+                  function);
+}
+
+typedef struct wgsl_texture_type_t {
+  const char* name;
+  WGPUTextureViewDimension view_dimension;
+  bool depth;
+  bool multisampled;
+} wgsl_texture_type_t;
+
+static const wgsl_texture_type_t wgsl_texture_types[] = {
+  {"texture_1d", WGPUTextureViewDimension_1D, false, false},
+  {"texture_2d", WGPUTextureViewDimension_2D, false, false},
+  {"texture_2d_array", WGPUTextureViewDimension_2DArray, false, false},
+  {"texture_3d", WGPUTextureViewDimension_3D, false, false},
+  {"texture_cube", WGPUTextureViewDimension_Cube, false, false},
+  {"texture_cube_array", WGPUTextureViewDimension_CubeArray, false, false},
+  {"texture_multisampled_2d", WGPUTextureViewDimension_2D, false, true},
+  {"texture_depth_2d", WGPUTextureViewDimension_2D, true, false},
+  {"texture_depth_2d_array", WGPUTextureViewDimension_2DArray, true, false},
+  {"texture_depth_cube", WGPUTextureViewDimension_Cube, true, false},
+  {"texture_depth_cube_array", WGPUTextureViewDimension_CubeArray, true,
+   false},
+  {"texture_depth_multisampled_2d", WGPUTextureViewDimension_2D, true, true},
+  {"texture_storage_1d", WGPUTextureViewDimension_1D, false, false},
+  {"texture_storage_2d", WGPUTextureViewDimension_2D, false, false},
+  {"texture_storage_2d_array", WGPUTextureViewDimension_2DArray, false,
+   false},
+  {"texture_storage_3d", WGPUTextureViewDimension_3D, false, false},
+};
+
+static const struct {
+  const char* name;
+  WGPUTextureFormat format;
+} wgsl_storage_texture_formats[] = {
+  {"rgba8unorm", WGPUTextureFormat_RGBA8Unorm},
+  {"rgba8snorm", WGPUTextureFormat_RGBA8Snorm},
+  {"rgba8uint", WGPUTextureFormat_RGBA8Uint},
+  {"rgba8sint", WGPUTextureFormat_RGBA8Sint},
+  {"rgba16uint", WGPUTextureFormat_RGBA16Uint},
+  {"rgba16sint", WGPUTextureFormat_RGBA16Sint},
+  {"rgba16float", WGPUTextureFormat_RGBA16Float},
+  {"r32uint", WGPUTextureFormat_R32Uint},
+  {"r32sint", WGPUTextureFormat_R32Sint},
+  {"r32float", WGPUTextureFormat_R32Float},
+  {"rg32uint", WGPUTextureFormat_RG32Uint},
+  {"rg32sint", WGPUTextureFormat_RG32Sint},
+  {"rg32float", WGPUTextureFormat_RG32Float},
+  {"rgba32uint", WGPUTextureFormat_RGBA32Uint},
+  {"rgba32sint", WGPUTextureFormat_RGBA32Sint},
+  {"rgba32float", WGPUTextureFormat_RGBA32Float},
+  {"bgra8unorm", WGPUTextureFormat_BGRA8Unorm},
+};
+
+/* Sampler, texture or storage texture type of a resource variable */
+static bool wgsl_parse_resource_type(wgsl_parser_t* p,
+                                     const wgsl_token_t* var_name,
+                                     WGPUBindGroupLayoutEntry* entry)
+{
+  const wgsl_token_t* name = wgsl_next(p);
+  if (wgsl_token_is(name, "sampler")) {
+    entry->sampler.type = WGPUSamplerBindingType_Filtering;
+    return true;
+  }
+  if (wgsl_token_is(name, "sampler_comparison")) {
+    entry->sampler.type = WGPUSamplerBindingType_Comparison;
+    return true;
+  }
+
+  const wgsl_texture_type_t* texture_type = NULL;
+  for (uint32_t i = 0; i < ARRAY_SIZE(wgsl_texture_types); ++i) {
+    if (wgsl_token_is(name, wgsl_texture_types[i].name)) {
+      texture_type = &wgsl_texture_types[i];
+      break;
+    }
+  }
+  if (texture_type == NULL) {
+    log_warn("Shader reflection: unsupported type of %.*s", var_name->length,
+             var_name->start);
+    return false;
+  }
+
+  if (strncmp(texture_type->name, "texture_storage", 15) == 0) {
+    // texture_storage_*<format, access>
+    wgsl_accept(p, "<");
+    const wgsl_token_t* format = wgsl_next(p);
+    wgsl_accept(p, ",");
+    const wgsl_token_t* access = wgsl_next(p);
+    wgsl_accept(p, ">");
+    if (!wgsl_token_is(access, "write")) {
+      log_warn("Shader reflection: unsupported storage texture access of %.*s",
+               var_name->length, var_name->start);
+      return false;
+    }
+    entry->storageTexture.access        = WGPUStorageTextureAccess_WriteOnly;
+    entry->storageTexture.viewDimension = texture_type->view_dimension;
+    for (uint32_t i = 0; i < ARRAY_SIZE(wgsl_storage_texture_formats); ++i) {
+      if (wgsl_token_is(format, wgsl_storage_texture_formats[i].name)) {
+        entry->storageTexture.format = wgsl_storage_texture_formats[i].format;
+        return true;
+      }
+    }
+    log_warn("Shader reflection: unsupported storage texture format of %.*s",
+             var_name->length, var_name->start);
+    return false;
+  }
+
+  entry->texture.viewDimension = texture_type->view_dimension;
+  entry->texture.multisampled  = texture_type->multisampled;
+  entry->texture.sampleType    = WGPUTextureSampleType_Depth;
+  if (!texture_type->depth) {
+    // Multisampled float textures can't be filtered
+    entry->texture.sampleType = texture_type->multisampled ?
+                                  WGPUTextureSampleType_UnfilterableFloat :
+                                  WGPUTextureSampleType_Float;
+    if (wgsl_accept(p, "<")) {
+      const wgsl_token_t* component = wgsl_next(p);
+      if (wgsl_token_is(component, "i32")) {
+        entry->texture.sampleType = WGPUTextureSampleType_Sint;
+      }
+      else if (wgsl_token_is(component, "u32")) {
+        entry->texture.sampleType = WGPUTextureSampleType_Uint;
+      }
+      wgsl_accept(p, ">");
+    }
+  }
+  return true;
+}
+
+static void wgsl_parse_variable(wgsl_parser_t* p,
+                                const wgsl_attributes_t* attrs)
+{
+  wgsl_token_t address_space = {"", 0};
+  wgsl_token_t access_mode   = {"", 0};
+  if (wgsl_accept(p, "<")) {
+    address_space = *wgsl_next(p);
+    if (wgsl_accept(p, ",")) {
+      access_mode = *wgsl_next(p);
+    }
+    wgsl_accept(p, ">");
+  }
+  const wgsl_token_t name = *wgsl_next(p);
+  if (attrs->group < 0 || attrs->binding < 0 || !wgsl_accept(p, ":")) {
+    wgsl_skip_statement(p);
+    return;
+  }
+
+  wgsl_binding_t binding;
+  memset(&binding, 0, sizeof(binding));
+  binding.name          = name;
+  binding.group         = (uint32_t)attrs->group;
+  binding.entry.binding = (uint32_t)attrs->binding;
+
+  bool valid = true;
+  if (wgsl_token_is(&address_space, "uniform")
+      || wgsl_token_is(&address_space, "storage")) {
+    const wgsl_layout_t layout = wgsl_parse_type(p);
+    binding.entry.buffer.type
+      = wgsl_token_is(&address_space, "uniform") ?
+          WGPUBufferBindingType_Uniform :
+        wgsl_token_is(&access_mode, "read_write") ?
+          WGPUBufferBindingType_Storage :
+          WGPUBufferBindingType_ReadOnlyStorage;
+    // Unknown store types are validated at draw time only
+    binding.entry.buffer.minBindingSize = layout.known ? layout.size : 0;
+  }
+  else {
+    valid = wgsl_parse_resource_type(p, &name, &binding.entry);
+  }
+  wgsl_skip_statement(p);
+
+  if (valid) {
+    WGSL_ARRAY_PUSH(p->bindings, p->binding_count, p->binding_capacity,
+                    binding);
+  }
+}
+
+static void wgsl_parse_module(wgsl_parser_t* p)
+{
+  while (p->pos < p->token_count) {
+    wgsl_attributes_t attrs;
+    wgsl_parse_attributes(p, &attrs);
+    const wgsl_token_t* token = wgsl_next(p);
+    if (wgsl_token_is(token, "struct")) {
+      wgsl_parse_struct(p);
+    }
+    else if (wgsl_token_is(token, "alias") || wgsl_token_is(token, "type")) {
+      wgsl_parse_alias(p);
+    }
+    else if (wgsl_token_is(token, "const") || wgsl_token_is(token, "let")) {
+      wgsl_parse_constant(p);
+    }
+    else if (wgsl_token_is(token, "fn")) {
+      wgsl_parse_function(p, attrs.stage);
+    }
+    else if (wgsl_token_is(token, "var")) {
+      wgsl_parse_variable(p, &attrs);
+    }
+    else if (wgsl_token_is_ident(token)) {
+      // enable, requires, diagnostic, override, const_assert
+      wgsl_skip_statement(p);
+    }
+  }
+}
+
+/* Adds stage to the visibility of the bindings the function and its callees
+ * reference */
+static void wgsl_mark_usage(wgsl_parser_t* p, uint32_t function_index,
+                            WGPUShaderStageFlags stage, bool* visited)
+{
+  if (visited[function_index]) {
+    return;
+  }
+  visited[function_index]          = true;
+  const wgsl_function_t* function = &p->functions[function_index];
+  for (uint32_t t = function->body_begin; t < function->body_end; ++t) {
+    const wgsl_token_t* token = &p->tokens[t];
+    // Member accesses don't reference module-scope names
+    if (!wgsl_token_is_ident(token)
+        || (t > 0 && wgsl_token_is(&p->tokens[t - 1], "."))) {
+      continue;
+    }
+    for (uint32_t b = 0; b < p->binding_count; ++b) {
+      if (wgsl_token_equal(&p->bindings[b].name, token)) {
+        p->bindings[b].entry.visibility |= stage;
+      }
+    }
+    for (uint32_t f = 0; f < p->function_count; ++f) {
+      if (wgsl_token_equal(&p->functions[f].name, token)) {
+        wgsl_mark_usage(p, f, stage, visited);
+      }
+    }
+  }
+}
+
+static void wgpu_shader_reflection_add_entry(
+  wgpu_shader_reflection_t* reflection, uint32_t group,
+  const WGPUBindGroupLayoutEntry* entry)
+{
+  if (group >= WGPU_SHADER_MAX_BIND_GROUPS) {
+    log_warn("Shader reflection: group %u exceeds the supported groups",
+             group);
+    return;
+  }
+
+  WGPUBindGroupLayoutEntry* entries = reflection->entries[group];
+  uint32_t* entry_count             = &reflection->entry_counts[group];
+  uint32_t index                    = 0;
+  while (index < *entry_count && entries[index].binding < entry->binding) {
+    ++index;
+  }
+
+  // Bindings shared by several entry points or stages
+  if (index < *entry_count && entries[index].binding == entry->binding) {
+    WGPUBindGroupLayoutEntry a = entries[index], b = *entry;
+    a.visibility = b.visibility = WGPUShaderStage_None;
+    a.buffer.minBindingSize = b.buffer.minBindingSize = 0;
+    if (memcmp(&a, &b, sizeof(a)) != 0) {
+      log_warn("Shader reflection: conflicting types of binding %u of group "
+               "%u",
+               entry->binding, group);
+      return;
+    }
+    entries[index].visibility |= entry->visibility;
+    entries[index].buffer.minBindingSize = MAX(
+      entries[index].buffer.minBindingSize, entry->buffer.minBindingSize);
+    return;
+  }
+
+  if (*entry_count == WGPU_SHADER_MAX_GROUP_BINDINGS) {
+    log_warn("Shader reflection: group %u exceeds the supported bindings",
+             group);
+    return;
+  }
+  memmove(&entries[index + 1], &entries[index],
+          (*entry_count - index) * sizeof(WGPUBindGroupLayoutEntry));
+  entries[index] = *entry;
+  ++*entry_count;
+  reflection->group_count = MAX(reflection->group_count, group + 1);
+}
+
+bool wgpu_shader_reflect_wgsl(const char* source,
+                              wgpu_shader_reflection_t* reflection)
+{
+  PROFILE_BEGIN("wgpu_shader_reflect_wgsl");
+
+  memset(reflection, 0, sizeof(*reflection));
+
+  wgsl_parser_t parser = {0};
+  wgsl_tokenize(&parser, source);
+  wgsl_parse_module(&parser);
+
+  // Visibility from the entry points reaching the bindings
+  WGPUShaderStageFlags module_stages = WGPUShaderStage_None;
+  bool* visited = calloc(MAX(parser.function_count, 1u), sizeof(bool));
+  for (uint32_t f = 0; f < parser.function_count; ++f) {
+    const WGPUShaderStageFlags stage = parser.functions[f].stage;
+    if (stage != WGPUShaderStage_None) {
+      module_stages |= stage;
+      memset(visited, 0, parser.function_count * sizeof(bool));
+      wgsl_mark_usage(&parser, f, stage, visited);
+    }
+  }
+  free(visited);
+
+  for (uint32_t b = 0; b < parser.binding_count; ++b) {
+    WGPUBindGroupLayoutEntry* entry = &parser.bindings[b].entry;
+    if (entry->visibility == WGPUShaderStage_None) {
+      entry->visibility = module_stages;
+    }
+    // Vertex shaders can't write to storage buffers and textures
+    if (entry->buffer.type == WGPUBufferBindingType_Storage
+        || entry->storageTexture.access != WGPUStorageTextureAccess_Undefined) {
+      entry->visibility &= ~(WGPUShaderStageFlags)WGPUShaderStage_Vertex;
+    }
+    wgpu_shader_reflection_add_entry(reflection, parser.bindings[b].group,
+                                     entry);
+  }
+
+  if (module_stages == WGPUShaderStage_None) {
+    log_warn("Shader reflection: no entry points found");
+  }
+
+  free(parser.tokens);
+  free(parser.types);
+  free(parser.constants);
+  free(parser.functions);
+  free(parser.bindings);
+
+  PROFILE_END();
+  return true;
+}
+
+bool wgpu_shader_reflect(const wgpu_shader_desc_t* desc,
+                         wgpu_shader_reflection_t* reflection)
+{
+  if (desc->file != NULL) {
+    if (!filename_has_extension(desc->file, "wgsl")) {
+      log_warn("Shader reflection: %s is not a WGSL file", desc->file);
+      return false;
+    }
+    file_read_result_t file = {0};
+    read_file(desc->file, &file, 1);
+    if (file.data == NULL) {
+      return false;
+    }
+    const bool result = wgpu_shader_reflect_wgsl((char*)file.data, reflection);
+    free(file.data);
+    return result;
+  }
+  if (desc->wgsl_code.source != NULL) {
+    return wgpu_shader_reflect_wgsl(desc->wgsl_code.source, reflection);
+  }
+  log_warn("Shader reflection: SPIR-V shaders are not reflected");
+  return false;
+}
+
+void wgpu_shader_reflection_merge(wgpu_shader_reflection_t* reflection,
+                                  const wgpu_shader_reflection_t* other)
+{
+  for (uint32_t g = 0; g < other->group_count; ++g) {
+    for (uint32_t e = 0; e < other->entry_counts[g]; ++e) {
+      wgpu_shader_reflection_add_entry(reflection, g, &other->entries[g][e]);
+    }
+  }
+}
+
+WGPUBindGroupLayout wgpu_shader_reflection_get_bind_group_layout(
+  wgpu_context_t* wgpu_context, const wgpu_shader_reflection_t* reflection,
+  uint32_t group)
+{
+  ASSERT(group < WGPU_SHADER_MAX_BIND_GROUPS);
+  return wgpu_get_bind_group_layout(wgpu_context, reflection->entries[group],
+                                    reflection->entry_counts[group]);
+}
+
+WGPUPipelineLayout wgpu_shader_reflection_get_pipeline_layout(
+  wgpu_context_t* wgpu_context, const wgpu_shader_reflection_t* reflection)
+{
+  // Unused groups below the highest one get empty layouts
+  WGPUBindGroupLayout layouts[WGPU_SHADER_MAX_BIND_GROUPS] = {0};
+  for (uint32_t g = 0; g < reflection->group_count; ++g) {
+    layouts[g] = wgpu_shader_reflection_get_bind_group_layout(wgpu_context,
+                                                              reflection, g);
+  }
+  WGPUPipelineLayout pipeline_layout = wgpu_get_pipeline_layout(
+    wgpu_context, layouts, reflection->group_count);
+  // The pipeline layout keeps the bind group layouts alive
+  for (uint32_t g = 0; g < reflection->group_count; ++g) {
+    WGPU_RELEASE_RESOURCE(BindGroupLayout, layouts[g])
+  }
+  return pipeline_layout;
+}
@@ -15,6 +15,20 @@ typedef struct wgpu_shader_desc_t {
     const char* source;
   } wgsl_code; /* WGSL source code ( ref: https://www.w3.org/TR/WGSL ) */
   const char* entry;
+  /* WGSL only: the source is prefixed with the alias hfloat, f16 when the
+   * device has the DawnShaderFloat16 feature and f32 otherwise. Both variants
+   * are cached as separate shader modules. */
+  bool half_precision;
+  /* WGSL only: the source is prefixed with the declaration of the frame
+   * uniforms block, frame at group 0, see frame_uniforms.h */
+  bool frame_uniforms;
+  /* Values of the pipeline-overridable constants (WGSL override declarations)
+   * of the entry point, keyed by name or numeric id. They are applied at
+   * pipeline creation, the module is shared by all constant sets and the
+   * pipeline cache keeps a pipeline per set. The array has to outlive the
+   * pipeline creation. */
+  uint32_t constant_count;
+  WGPUConstantEntry const* constants;
 } wgpu_shader_desc_t;
 
 typedef struct wgpu_shader_t {
@@ -22,6 +36,29 @@ typedef struct wgpu_shader_t {
   WGPUShaderModule module;
 } wgpu_shader_t;
 
+/**
+ * Shader module cache: modules created through wgpu_create_shader_module are
+ * shared per device, keyed by a hash of the SPIR-V / WGSL bytes and the entry
+ * point. Every returned module holds its own reference and must be released
+ * by the caller as before.
+ */
+typedef struct wgpu_shader_cache_t wgpu_shader_cache_t;
+void wgpu_shader_cache_destroy(wgpu_shader_cache_t* shader_cache);
+
+/**
+ * Bind group and pipeline layouts shared per device through the shader cache,
+ * keyed by the layout entries and the bind group layouts respectively. Every
+ * returned layout holds its own reference and must be released by the caller.
+ */
+WGPUBindGroupLayout
+wgpu_get_bind_group_layout(wgpu_context_t* wgpu_context,
+                           const WGPUBindGroupLayoutEntry* entries,
+                           uint32_t entry_count);
+WGPUPipelineLayout
+wgpu_get_pipeline_layout(wgpu_context_t* wgpu_context,
+                         const WGPUBindGroupLayout* bind_group_layouts,
+                         uint32_t bind_group_layout_count);
+
 /* Helper functions */
 WGPUShaderModule
 wgpu_create_shader_module_from_spirv_file(WGPUDevice device,
@@ -57,4 +94,48 @@ typedef struct wgpu_fragment_state_t {
 WGPUFragmentState wgpu_create_fragment_state(wgpu_context_t* wgpu_context,
                                              const wgpu_fragment_state_t* desc);
 
+/*
+ * WGSL resource reflection
+ *
+ * The module-scope resource variables of the WGSL source are turned into bind
+ * group layout entries: buffers with the minimum binding size of their store
+ * type (runtime-sized arrays count one element), textures, storage textures
+ * and samplers. The visibility of a binding is the set of stages whose entry
+ * points reach it, through the functions they call. Bindings that no entry
+ * point uses are visible to all stages of the module.
+ *
+ * Sampled float textures are reflected as filterable and samplers as filtering,
+ * the entries can be amended before the layouts are requested. SPIR-V modules
+ * are not reflected.
+ */
+#define WGPU_SHADER_MAX_BIND_GROUPS 4u
+#define WGPU_SHADER_MAX_GROUP_BINDINGS 16u
+
+typedef struct wgpu_shader_reflection_t {
+  uint32_t group_count; /* highest used group + 1 */
+  /* Entries of each group, sorted by binding */
+  uint32_t entry_counts[WGPU_SHADER_MAX_BIND_GROUPS];
+  WGPUBindGroupLayoutEntry entries[WGPU_SHADER_MAX_BIND_GROUPS]
+                                  [WGPU_SHADER_MAX_GROUP_BINDINGS];
+} wgpu_shader_reflection_t;
+
+/* Reflects the WGSL file or source of the shader description, returns false
+ * for SPIR-V shaders and unreadable files */
+bool wgpu_shader_reflect(const wgpu_shader_desc_t* desc,
+                         wgpu_shader_reflection_t* reflection);
+bool wgpu_shader_reflect_wgsl(const char* source,
+                              wgpu_shader_reflection_t* reflection);
+
+/* Adds the bindings of another stage, e.g. the fragment shader module of a
+ * pipeline, bindings present in both are made visible to both stages */
+void wgpu_shader_reflection_merge(wgpu_shader_reflection_t* reflection,
+                                  const wgpu_shader_reflection_t* other);
+
+/* Cached layouts of the reflected bindings, see wgpu_get_bind_group_layout */
+WGPUBindGroupLayout wgpu_shader_reflection_get_bind_group_layout(
+  wgpu_context_t* wgpu_context, const wgpu_shader_reflection_t* reflection,
+  uint32_t group);
+WGPUPipelineLayout wgpu_shader_reflection_get_pipeline_layout(
+  wgpu_context_t* wgpu_context, const wgpu_shader_reflection_t* reflection);
+
 #endif
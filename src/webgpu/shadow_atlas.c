@@ -0,0 +1,765 @@
+#include "shadow_atlas.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+/* Offset alignment of the dynamic light uniforms */
+#define SHADOW_ATLAS_LIGHT_STRIDE 256u
+
+/* Cells of the allocation grid per side, in minimum tile sizes */
+#define SHADOW_ATLAS_MAX_GRID_SIZE 64u
+
+/* Offset of the compared depth, on top of the slope scaled pipeline bias */
+#define SHADOW_ATLAS_DEPTH_BIAS 0.0005f
+
+/* Layout of ShadowAtlasLight */
+typedef struct shadow_atlas_light_params_t {
+  mat4 view_proj;
+  vec4 uv_rect; /* offset and scale of the tile, zero without a tile */
+} shadow_atlas_light_params_t;
+
+/* Layout of ShadowAtlasParams */
+typedef struct shadow_atlas_params_t {
+  shadow_atlas_light_params_t lights[WGPU_SHADOW_ATLAS_MAX_LIGHTS];
+  uint32_t light_count;
+  float texel_size;
+  float depth_bias;
+  uint32_t padding;
+} shadow_atlas_params_t;
+
+typedef struct shadow_atlas_slot_t {
+  bool has_tile;
+  wgpu_shadow_atlas_tile_t tile;
+  /* Light the tile was assigned for, to find out whether it is still valid */
+  mat4 view_projection;
+  bool is_static;
+  uint32_t version;
+  bool dirty; /* has to be rendered */
+} shadow_atlas_slot_t;
+
+typedef struct shadow_atlas_order_t {
+  float importance;
+  uint32_t light;
+} shadow_atlas_order_t;
+
+struct wgpu_shadow_atlas {
+  wgpu_context_t* wgpu_context;
+  uint32_t size;
+  uint32_t min_tile_size;
+  uint32_t max_tile_size;
+  uint32_t grid_size;
+  /* Allocated cells of min_tile_size texels, rows of grid_size */
+  uint8_t grid[SHADOW_ATLAS_MAX_GRID_SIZE * SHADOW_ATLAS_MAX_GRID_SIZE];
+  shadow_atlas_slot_t slots[WGPU_SHADOW_ATLAS_MAX_LIGHTS];
+  bool invalidated;
+  shadow_atlas_params_t params;
+  WGPUTexture texture;
+  WGPUTextureView texture_view;
+  WGPUSampler sampler;
+  wgpu_buffer_t params_buffer;
+  /* View projection of every light, LIGHT_STRIDE bytes apart */
+  wgpu_buffer_t light_buffer;
+  WGPUBindGroupLayout light_bind_group_layout;
+  WGPUBindGroup light_bind_group;
+  WGPURenderPipeline pipeline;
+  WGPURenderPipeline clear_pipeline;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* shadow_atlas_wgsl_functions = CODE(
+  struct ShadowAtlasLight {
+    viewProj : mat4x4<f32>,
+    uvRect : vec4<f32>,
+  };
+
+  struct ShadowAtlasParams {
+    lights : array<ShadowAtlasLight, 64>,
+    lightCount : u32,
+    texelSize : f32,
+    depthBias : f32,
+    padding : u32,
+  };
+
+  // 3x3 percentage closer filtering in the tile of the light
+  fn shadowAtlasGetVisibility(light : u32, worldPosition : vec3<f32>) -> f32 {
+    if (light >= shadowAtlasParams.lightCount) {
+      return 1.0;
+    }
+    let rect = shadowAtlasParams.lights[light].uvRect;
+    let viewProj = shadowAtlasParams.lights[light].viewProj;
+    let lightPosition = viewProj * vec4<f32>(worldPosition, 1.0);
+    if (rect.z <= 0.0 || lightPosition.w <= 0.0) {
+      return 1.0;
+    }
+    let ndc = lightPosition.xyz / lightPosition.w;
+    if (any(abs(ndc.xy) > vec2<f32>(1.0)) || ndc.z > 1.0) {
+      return 1.0;
+    }
+    let tileUv = ndc.xy * vec2<f32>(0.5, -0.5) + vec2<f32>(0.5);
+    let uv = rect.xy + tileUv * rect.zw;
+    // The filter taps are kept inside of the tile, off its neighbours
+    let texel = shadowAtlasParams.texelSize;
+    let minUv = rect.xy + vec2<f32>(1.5 * texel);
+    let maxUv = rect.xy + rect.zw - vec2<f32>(1.5 * texel);
+    let depth = ndc.z - shadowAtlasParams.depthBias;
+    var visibility = 0.0;
+    for (var y = -1; y <= 1; y = y + 1) {
+      for (var x = -1; x <= 1; x = x + 1) {
+        let offset = vec2<f32>(f32(x), f32(y)) * texel;
+        let tapUv = clamp(uv + offset, minUv, maxUv);
+        visibility = visibility
+                     + textureSampleCompareLevel(shadowAtlas,
+                                                 shadowAtlasSampler, tapUv,
+                                                 depth);
+      }
+    }
+    return visibility / 9.0;
+  }
+);
+
+static const char* shadow_atlas_depth_shader_wgsl = CODE(
+  struct Light {
+    viewProj : mat4x4<f32>,
+  };
+
+  @group(0) @binding(0) var<uniform> light : Light;
+  @group(1) @binding(0) var<uniform> model : mat4x4<f32>;
+
+  @vertex
+  fn main(@location(0) position : vec3<f32>) -> @builtin(position) vec4<f32> {
+    return light.viewProj * model * vec4<f32>(position, 1.0);
+  }
+);
+
+// Full screen triangle at the far plane, clears the tile of the viewport
+static const char* shadow_atlas_clear_shader_wgsl = CODE(
+  @vertex
+  fn main(@builtin(vertex_index) index : u32) -> @builtin(position) vec4<f32> {
+    let uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+    return vec4<f32>(uv * 2.0 - vec2<f32>(1.0), 1.0, 1.0);
+  }
+);
+// clang-format on
+
+static void shadow_atlas_create_textures(wgpu_shadow_atlas_t* atlas)
+{
+  wgpu_context_t* wgpu_context = atlas->wgpu_context;
+
+  WGPUTextureDescriptor texture_desc = {
+    .label         = "shadow_atlas_texture",
+    .size          = (WGPUExtent3D) {
+      .width              = atlas->size,
+      .height             = atlas->size,
+      .depthOrArrayLayers = 1,
+    },
+    .mipLevelCount = 1,
+    .sampleCount   = 1,
+    .dimension     = WGPUTextureDimension_2D,
+    .format        = WGPUTextureFormat_Depth32Float,
+    .usage
+    = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding,
+  };
+  atlas->texture = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+  ASSERT(atlas->texture != NULL);
+
+  atlas->texture_view = wgpuTextureCreateView(
+    atlas->texture, &(WGPUTextureViewDescriptor){
+                      .label           = "shadow_atlas_texture_view",
+                      .dimension       = WGPUTextureViewDimension_2D,
+                      .format          = WGPUTextureFormat_Depth32Float,
+                      .baseMipLevel    = 0,
+                      .mipLevelCount   = 1,
+                      .baseArrayLayer  = 0,
+                      .arrayLayerCount = 1,
+                      .aspect          = WGPUTextureAspect_All,
+                    });
+  ASSERT(atlas->texture_view != NULL);
+
+  atlas->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "shadow_atlas_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .compare       = WGPUCompareFunction_Less,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(atlas->sampler != NULL);
+}
+
+static void shadow_atlas_create_bind_group_layouts(wgpu_shadow_atlas_t* atlas)
+{
+  wgpu_context_t* wgpu_context = atlas->wgpu_context;
+
+  // Depth pass
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Light view projection
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Vertex,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(mat4),
+        },
+        .sampler = {0},
+      },
+    };
+    atlas->light_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "shadow_atlas_light_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(atlas->light_bind_group_layout != NULL);
+  }
+
+  // Shading
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[3] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Shadow atlas parameters
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Fragment,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(shadow_atlas_params_t),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Atlas
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Fragment,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_Depth,
+          .viewDimension = WGPUTextureViewDimension_2D,
+          .multisampled  = false,
+        },
+        .storageTexture = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Comparison sampler
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Fragment,
+        .sampler = (WGPUSamplerBindingLayout){
+          .type = WGPUSamplerBindingType_Comparison,
+        },
+        .texture = {0},
+      },
+    };
+    atlas->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "shadow_atlas_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(atlas->bind_group_layout != NULL);
+  }
+}
+
+static void shadow_atlas_create_bind_groups(wgpu_shadow_atlas_t* atlas)
+{
+  wgpu_context_t* wgpu_context = atlas->wgpu_context;
+
+  // Depth pass
+  {
+    WGPUBindGroupEntry bg_entries[1] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = atlas->light_buffer.buffer,
+        .size    = sizeof(mat4),
+      },
+    };
+    atlas->light_bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label  = "shadow_atlas_light_bind_group",
+                              .layout = atlas->light_bind_group_layout,
+                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entries    = bg_entries,
+                            });
+    ASSERT(atlas->light_bind_group != NULL);
+  }
+
+  // Shading
+  {
+    WGPUBindGroupEntry bg_entries[3] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = atlas->params_buffer.buffer,
+        .size    = atlas->params_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding     = 1,
+        .textureView = atlas->texture_view,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding = 2,
+        .sampler = atlas->sampler,
+      },
+    };
+    atlas->bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label      = "shadow_atlas_bind_group",
+                              .layout     = atlas->bind_group_layout,
+                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entries    = bg_entries,
+                            });
+    ASSERT(atlas->bind_group != NULL);
+  }
+}
+
+static void shadow_atlas_create_pipelines(wgpu_shadow_atlas_t* atlas,
+                                          WGPUBindGroupLayout model_layout)
+{
+  wgpu_context_t* wgpu_context = atlas->wgpu_context;
+
+  // Multisample state
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  // Depth pipeline
+  {
+    WGPUBindGroupLayout bind_group_layouts[2] = {
+      atlas->light_bind_group_layout, // Group 0
+      model_layout,                   // Group 1
+    };
+    WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+      wgpu_context->device,
+      &(WGPUPipelineLayoutDescriptor){
+        .label                = "shadow_atlas_pl",
+        .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+        .bindGroupLayouts     = bind_group_layouts,
+      });
+    ASSERT(pipeline_layout != NULL);
+
+    // Primitive state
+    WGPUPrimitiveState primitive_state = {
+      .topology  = WGPUPrimitiveTopology_TriangleList,
+      .frontFace = WGPUFrontFace_CCW,
+      .cullMode  = WGPUCullMode_Back,
+    };
+
+    // Depth stencil state, with a slope scaled bias against shadow acne
+    WGPUDepthStencilState depth_stencil_state
+      = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+        .format              = WGPUTextureFormat_Depth32Float,
+        .depth_write_enabled = true,
+      });
+    depth_stencil_state.depthCompare        = WGPUCompareFunction_Less;
+    depth_stencil_state.depthBiasSlopeScale = 1.5f;
+
+    // Vertex buffer layout, the depth pass only reads positions
+    WGPU_VERTEX_BUFFER_LAYOUT(
+      shadow_atlas, sizeof(float) * 3,
+      // Attribute location 0: Position
+      WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x3, 0))
+
+    // Vertex state
+    WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                  wgpu_context, &(wgpu_vertex_state_t){
+                  .shader_desc = (wgpu_shader_desc_t){
+                    // Vertex shader WGSL
+                    .label            = "shadow_atlas_depth_shader",
+                    .wgsl_code.source = shadow_atlas_depth_shader_wgsl,
+                    .entry            = "main",
+                  },
+                  .buffer_count = 1,
+                  .buffers      = &shadow_atlas_vertex_buffer_layout,
+                });
+
+    atlas->pipeline = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                              .label        = "shadow_atlas_pipeline",
+                              .layout       = pipeline_layout,
+                              .primitive    = primitive_state,
+                              .vertex       = vertex_state,
+                              .fragment     = NULL,
+                              .depthStencil = &depth_stencil_state,
+                              .multisample  = multisample_state,
+                            });
+    ASSERT(atlas->pipeline != NULL);
+
+    // Partial cleanup
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+    WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+  }
+
+  // Tile clear pipeline, writes the far plane depth whatever is stored
+  {
+    WGPUPrimitiveState primitive_state = {
+      .topology  = WGPUPrimitiveTopology_TriangleList,
+      .frontFace = WGPUFrontFace_CCW,
+      .cullMode  = WGPUCullMode_None,
+    };
+
+    WGPUDepthStencilState depth_stencil_state
+      = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+        .format              = WGPUTextureFormat_Depth32Float,
+        .depth_write_enabled = true,
+      });
+    depth_stencil_state.depthCompare = WGPUCompareFunction_Always;
+
+    WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                  wgpu_context, &(wgpu_vertex_state_t){
+                  .shader_desc = (wgpu_shader_desc_t){
+                    // Vertex shader WGSL
+                    .label            = "shadow_atlas_clear_shader",
+                    .wgsl_code.source = shadow_atlas_clear_shader_wgsl,
+                    .entry            = "main",
+                  },
+                  .buffer_count = 0,
+                  .buffers      = NULL,
+                });
+
+    atlas->clear_pipeline = wgpuDeviceCreateRenderPipeline(
+      wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                              .label        = "shadow_atlas_clear_pipeline",
+                              .primitive    = primitive_state,
+                              .vertex       = vertex_state,
+                              .fragment     = NULL,
+                              .depthStencil = &depth_stencil_state,
+                              .multisample  = multisample_state,
+                            });
+    ASSERT(atlas->clear_pipeline != NULL);
+
+    // Partial cleanup
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  }
+}
+
+wgpu_shadow_atlas_t*
+wgpu_shadow_atlas_create(wgpu_context_t* wgpu_context,
+                         const wgpu_shadow_atlas_desc_t* desc)
+{
+  ASSERT(desc->model_bind_group_layout != NULL);
+
+  wgpu_shadow_atlas_t* atlas
+    = (wgpu_shadow_atlas_t*)malloc(sizeof(wgpu_shadow_atlas_t));
+  memset(atlas, 0, sizeof(wgpu_shadow_atlas_t));
+  atlas->wgpu_context = wgpu_context;
+
+  atlas->size = desc->size > 0 ? desc->size : WGPU_SHADOW_ATLAS_DEFAULT_SIZE;
+  atlas->min_tile_size = desc->min_tile_size > 0 ?
+                           desc->min_tile_size :
+                           WGPU_SHADOW_ATLAS_DEFAULT_MIN_TILE_SIZE;
+  atlas->max_tile_size = MIN(desc->max_tile_size > 0 ?
+                               desc->max_tile_size :
+                               WGPU_SHADOW_ATLAS_DEFAULT_MAX_TILE_SIZE,
+                             atlas->size);
+  ASSERT(atlas->min_tile_size <= atlas->max_tile_size);
+  ASSERT(atlas->size % atlas->min_tile_size == 0);
+  atlas->grid_size = atlas->size / atlas->min_tile_size;
+  ASSERT(atlas->grid_size <= SHADOW_ATLAS_MAX_GRID_SIZE);
+  atlas->params.texel_size = 1.0f / (float)atlas->size;
+  atlas->params.depth_bias = SHADOW_ATLAS_DEPTH_BIAS;
+
+  atlas->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "shadow_atlas_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(shadow_atlas_params_t),
+                  });
+  atlas->light_buffer = wgpu_create_buffer(
+    wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "shadow_atlas_light_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+      .size  = WGPU_SHADOW_ATLAS_MAX_LIGHTS * SHADOW_ATLAS_LIGHT_STRIDE,
+    });
+
+  shadow_atlas_create_textures(atlas);
+  shadow_atlas_create_bind_group_layouts(atlas);
+  shadow_atlas_create_bind_groups(atlas);
+  shadow_atlas_create_pipelines(atlas, desc->model_bind_group_layout);
+
+  return atlas;
+}
+
+void wgpu_shadow_atlas_release(wgpu_shadow_atlas_t* atlas)
+{
+  if (atlas == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(RenderPipeline, atlas->clear_pipeline)
+  WGPU_RELEASE_RESOURCE(RenderPipeline, atlas->pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, atlas->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, atlas->light_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, atlas->bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, atlas->light_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(Sampler, atlas->sampler)
+  WGPU_RELEASE_RESOURCE(TextureView, atlas->texture_view)
+  WGPU_RELEASE_RESOURCE(Texture, atlas->texture)
+  wgpu_destroy_buffer(&atlas->light_buffer);
+  wgpu_destroy_buffer(&atlas->params_buffer);
+  free(atlas);
+}
+
+/* Tile size of a light, the side of the tile follows the side of the part of
+ * the screen affected by the light */
+static uint32_t shadow_atlas_get_tile_size(const wgpu_shadow_atlas_t* atlas,
+                                           float importance)
+{
+  if (!(importance > 0.0f)) {
+    return 0;
+  }
+  const float side
+    = sqrtf(MIN(importance, 1.0f)) * (float)atlas->max_tile_size;
+  uint32_t tile_size = atlas->min_tile_size;
+  while (tile_size < atlas->max_tile_size && (float)tile_size < side) {
+    tile_size <<= 1;
+  }
+  return tile_size;
+}
+
+static bool shadow_atlas_is_free(const wgpu_shadow_atlas_t* atlas,
+                                 uint32_t cell_x, uint32_t cell_y,
+                                 uint32_t cells)
+{
+  for (uint32_t y = cell_y; y < cell_y + cells; ++y) {
+    for (uint32_t x = cell_x; x < cell_x + cells; ++x) {
+      if (atlas->grid[y * atlas->grid_size + x]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void shadow_atlas_reserve(wgpu_shadow_atlas_t* atlas,
+                                 const wgpu_shadow_atlas_tile_t* tile)
+{
+  const uint32_t cell_x = tile->x / atlas->min_tile_size;
+  const uint32_t cell_y = tile->y / atlas->min_tile_size;
+  const uint32_t cells  = tile->size / atlas->min_tile_size;
+  for (uint32_t y = cell_y; y < cell_y + cells; ++y) {
+    memset(&atlas->grid[y * atlas->grid_size + cell_x], 1, cells);
+  }
+}
+
+/* First free position aligned to the tile size, which keeps the atlas free of
+ * fragments when the tiles are allocated from the largest one on */
+static bool shadow_atlas_allocate(wgpu_shadow_atlas_t* atlas,
+                                  uint32_t tile_size,
+                                  wgpu_shadow_atlas_tile_t* tile)
+{
+  const uint32_t cells = tile_size / atlas->min_tile_size;
+  for (uint32_t y = 0; y + cells <= atlas->grid_size; y += cells) {
+    for (uint32_t x = 0; x + cells <= atlas->grid_size; x += cells) {
+      if (shadow_atlas_is_free(atlas, x, y, cells)) {
+        tile->x    = x * atlas->min_tile_size;
+        tile->y    = y * atlas->min_tile_size;
+        tile->size = tile_size;
+        shadow_atlas_reserve(atlas, tile);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static int shadow_atlas_compare_order(const void* a, const void* b)
+{
+  const float ia = ((const shadow_atlas_order_t*)a)->importance;
+  const float ib = ((const shadow_atlas_order_t*)b)->importance;
+  return (ia < ib) - (ia > ib);
+}
+
+uint32_t wgpu_shadow_atlas_update(wgpu_shadow_atlas_t* atlas,
+                                  const wgpu_shadow_atlas_light_t* lights,
+                                  uint32_t light_count)
+{
+  ASSERT(light_count <= WGPU_SHADOW_ATLAS_MAX_LIGHTS);
+
+  memset(atlas->grid, 0, sizeof(atlas->grid));
+  shadow_atlas_order_t order[WGPU_SHADOW_ATLAS_MAX_LIGHTS];
+  uint32_t order_count = 0;
+
+  // The tiles of unchanged static lights are kept where they are
+  for (uint32_t i = 0; i < light_count; ++i) {
+    const wgpu_shadow_atlas_light_t* light = &lights[i];
+    shadow_atlas_slot_t* slot              = &atlas->slots[i];
+    const uint32_t tile_size
+      = shadow_atlas_get_tile_size(atlas, light->importance);
+    if (tile_size == 0) {
+      slot->has_tile = false;
+      continue;
+    }
+    if (slot->has_tile && !atlas->invalidated && light->is_static
+        && slot->is_static && slot->version == light->version
+        && slot->tile.size == tile_size
+        && memcmp(slot->view_projection, light->view_projection,
+                  sizeof(mat4))
+             == 0) {
+      shadow_atlas_reserve(atlas, &slot->tile);
+      continue;
+    }
+    slot->has_tile                = false;
+    order[order_count].importance = light->importance;
+    order[order_count].light      = i;
+    ++order_count;
+  }
+  for (uint32_t i = light_count; i < WGPU_SHADOW_ATLAS_MAX_LIGHTS; ++i) {
+    atlas->slots[i].has_tile = false;
+  }
+
+  // The other tiles from the most important light on, halved until they fit
+  qsort(order, order_count, sizeof(shadow_atlas_order_t),
+        shadow_atlas_compare_order);
+  for (uint32_t i = 0; i < order_count; ++i) {
+    const wgpu_shadow_atlas_light_t* light = &lights[order[i].light];
+    shadow_atlas_slot_t* slot              = &atlas->slots[order[i].light];
+    uint32_t tile_size = shadow_atlas_get_tile_size(atlas, light->importance);
+    for (; tile_size >= atlas->min_tile_size; tile_size >>= 1) {
+      if (shadow_atlas_allocate(atlas, tile_size, &slot->tile)) {
+        slot->has_tile = true;
+        break;
+      }
+    }
+    if (!slot->has_tile) {
+      continue;
+    }
+    glm_mat4_copy((vec4*)light->view_projection, slot->view_projection);
+    slot->is_static = light->is_static;
+    slot->version   = light->version;
+    slot->dirty     = true;
+
+    wgpuQueueWriteBuffer(atlas->wgpu_context->queue,
+                         atlas->light_buffer.buffer,
+                         order[i].light * SHADOW_ATLAS_LIGHT_STRIDE,
+                         slot->view_projection, sizeof(mat4));
+  }
+  atlas->invalidated = false;
+
+  shadow_atlas_params_t* params = &atlas->params;
+  const float scale             = 1.0f / (float)atlas->size;
+  uint32_t tile_count           = 0;
+  params->light_count           = light_count;
+  for (uint32_t i = 0; i < light_count; ++i) {
+    const shadow_atlas_slot_t* slot = &atlas->slots[i];
+    glm_mat4_copy((vec4*)lights[i].view_projection,
+                  params->lights[i].view_proj);
+    if (slot->has_tile) {
+      glm_vec4_copy((vec4){slot->tile.x * scale, slot->tile.y * scale,
+                           slot->tile.size * scale, slot->tile.size * scale},
+                    params->lights[i].uv_rect);
+      ++tile_count;
+    }
+    else {
+      glm_vec4_zero(params->lights[i].uv_rect);
+    }
+  }
+
+  wgpuQueueWriteBuffer(atlas->wgpu_context->queue,
+                       atlas->params_buffer.buffer, 0, params,
+                       sizeof(*params));
+
+  return tile_count;
+}
+
+void wgpu_shadow_atlas_invalidate(wgpu_shadow_atlas_t* atlas)
+{
+  atlas->invalidated = true;
+}
+
+uint32_t
+wgpu_shadow_atlas_render(wgpu_shadow_atlas_t* atlas,
+                         WGPUCommandEncoder cmd_encoder,
+                         wgpu_shadow_atlas_draw_callback_t draw_callback,
+                         void* user_data)
+{
+  uint32_t dirty_count = 0;
+  for (uint32_t i = 0; i < atlas->params.light_count; ++i) {
+    const shadow_atlas_slot_t* slot = &atlas->slots[i];
+    dirty_count += (slot->has_tile && slot->dirty) ? 1 : 0;
+  }
+  if (dirty_count == 0) {
+    return 0;
+  }
+
+  // The cached tiles are loaded, the rendered ones are cleared one by one
+  WGPURenderPassDepthStencilAttachment depth_stencil_attachment = {
+    .view            = atlas->texture_view,
+    .depthLoadOp     = WGPULoadOp_Load,
+    .depthStoreOp    = WGPUStoreOp_Store,
+    .depthClearValue = 1.0f,
+    .clearDepth      = 1.0f,
+    .clearStencil    = 0,
+  };
+  WGPURenderPassEncoder pass_encoder = wgpuCommandEncoderBeginRenderPass(
+    cmd_encoder, &(WGPURenderPassDescriptor){
+                   .label                  = "shadow_atlas_pass",
+                   .colorAttachmentCount   = 0,
+                   .depthStencilAttachment = &depth_stencil_attachment,
+                 });
+  for (uint32_t i = 0; i < atlas->params.light_count; ++i) {
+    shadow_atlas_slot_t* slot = &atlas->slots[i];
+    if (!slot->has_tile || !slot->dirty) {
+      continue;
+    }
+
+    const wgpu_shadow_atlas_tile_t* tile = &slot->tile;
+    wgpuRenderPassEncoderSetViewport(pass_encoder, (float)tile->x,
+                                     (float)tile->y, (float)tile->size,
+                                     (float)tile->size, 0.0f, 1.0f);
+    wgpuRenderPassEncoderSetScissorRect(pass_encoder, tile->x, tile->y,
+                                        tile->size, tile->size);
+    wgpuRenderPassEncoderSetPipeline(pass_encoder, atlas->clear_pipeline);
+    wgpuRenderPassEncoderDraw(pass_encoder, 3, 1, 0, 0);
+
+    const uint32_t dynamic_offset = i * SHADOW_ATLAS_LIGHT_STRIDE;
+    wgpuRenderPassEncoderSetPipeline(pass_encoder, atlas->pipeline);
+    wgpuRenderPassEncoderSetBindGroup(pass_encoder, 0, atlas->light_bind_group,
+                                      1, &dynamic_offset);
+    draw_callback(pass_encoder, i, slot->is_static, user_data);
+
+    slot->dirty = false;
+  }
+  wgpuRenderPassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, pass_encoder)
+
+  return dirty_count;
+}
+
+bool wgpu_shadow_atlas_get_tile(wgpu_shadow_atlas_t* atlas, uint32_t light,
+                                wgpu_shadow_atlas_tile_t* tile)
+{
+  if (light >= atlas->params.light_count || !atlas->slots[light].has_tile) {
+    return false;
+  }
+  *tile = atlas->slots[light].tile;
+  return true;
+}
+
+WGPUBindGroupLayout
+wgpu_shadow_atlas_get_bind_group_layout(wgpu_shadow_atlas_t* atlas)
+{
+  return atlas->bind_group_layout;
+}
+
+WGPUBindGroup wgpu_shadow_atlas_get_bind_group(wgpu_shadow_atlas_t* atlas)
+{
+  return atlas->bind_group;
+}
+
+const char* wgpu_shadow_atlas_get_wgsl_functions(void)
+{
+  return shadow_atlas_wgsl_functions;
+}
@@ -0,0 +1,124 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+#define WGPU_SHADOW_ATLAS_MAX_LIGHTS 64u
+
+/* Defaults */
+#define WGPU_SHADOW_ATLAS_DEFAULT_SIZE 4096u
+#define WGPU_SHADOW_ATLAS_DEFAULT_MIN_TILE_SIZE 128u
+#define WGPU_SHADOW_ATLAS_DEFAULT_MAX_TILE_SIZE 1024u
+
+/*
+ * Shadow atlas of many shadow-casting lights: one Depth32Float texture is
+ * subdivided into square tiles with power-of-two sizes between the minimum
+ * and the maximum tile size. The tile size of a light follows its importance,
+ * the fraction of the screen it affects. The tiles are assigned from the most
+ * important light on, in aligned positions of the atlas, and halved for the
+ * lights which do not fit. The lights which are left without a tile are not
+ * shadowed.
+ *
+ * All tiles are rendered in a single depth pass through viewport and scissor.
+ * The tiles of dynamic lights are rendered every frame. The tiles of static
+ * lights keep their position and are only re-rendered when the tile size,
+ * the view projection or the version of the light changes, or after
+ * wgpu_shadow_atlas_invalidate(). They should only be drawn with the static
+ * geometry of the scene.
+ *
+ * The tiles are rendered with a depth-only pipeline over a position-only
+ * vertex stream, a vec3<f32> at location 0 of the vertex buffer at slot 0:
+ *   @group(0) light view projection, set by the atlas
+ *   @group(1) @binding(0) var<uniform> model : mat4x4<f32>, set by the caller
+ */
+typedef struct wgpu_shadow_atlas wgpu_shadow_atlas_t;
+
+typedef struct wgpu_shadow_atlas_desc_t {
+  /* Width and height of the atlas in texels, 0 selects the default */
+  uint32_t size;
+  /* Power-of-two tile size limits in texels, 0 selects the defaults */
+  uint32_t min_tile_size;
+  uint32_t max_tile_size;
+  /* Layout of the model matrix at group 1 of the depth-only pipeline */
+  WGPUBindGroupLayout model_bind_group_layout;
+} wgpu_shadow_atlas_desc_t;
+
+/* Shadow-casting light, identified by its index in the array passed to
+ * wgpu_shadow_atlas_update() which has to stay the same across frames */
+typedef struct wgpu_shadow_atlas_light_t {
+  /* World to clip space of the light, perspective for spot lights */
+  mat4 view_projection;
+  /* Fraction of the screen affected by the light in [0, 1], 0 for the lights
+   * which are not visible */
+  float importance;
+  /* Static lights are cached, bump the version when their casters change */
+  bool is_static;
+  uint32_t version;
+} wgpu_shadow_atlas_light_t;
+
+/* Tile of a light in texels */
+typedef struct wgpu_shadow_atlas_tile_t {
+  uint32_t x, y;
+  uint32_t size;
+} wgpu_shadow_atlas_tile_t;
+
+/* Called by wgpu_shadow_atlas_render() for every tile to render, with the
+ * depth-only pipeline, its group 0, the viewport and the scissor rectangle
+ * set. static_only is set for the tiles of static lights. */
+typedef void (*wgpu_shadow_atlas_draw_callback_t)(
+  WGPURenderPassEncoder pass_encoder, uint32_t light, bool static_only,
+  void* user_data);
+
+/* Shadow atlas creating/releasing */
+wgpu_shadow_atlas_t*
+wgpu_shadow_atlas_create(wgpu_context_t* wgpu_context,
+                         const wgpu_shadow_atlas_desc_t* desc);
+void wgpu_shadow_atlas_release(wgpu_shadow_atlas_t* atlas);
+
+/* Assigns the tiles of up to WGPU_SHADOW_ATLAS_MAX_LIGHTS lights and writes
+ * their parameters. Returns the number of lights with a tile. */
+uint32_t wgpu_shadow_atlas_update(wgpu_shadow_atlas_t* atlas,
+                                  const wgpu_shadow_atlas_light_t* lights,
+                                  uint32_t light_count);
+
+/* Marks the tiles of the static lights for re-rendering, e.g. when static
+ * geometry has been added, removed or moved */
+void wgpu_shadow_atlas_invalidate(wgpu_shadow_atlas_t* atlas);
+
+/**
+ * @brief Records the depth pass of the tiles which have to be rendered in
+ * this frame, nothing when all tiles are cached. The shading passes of the
+ * frame have to be recorded afterwards. Returns the number of rendered tiles.
+ */
+uint32_t
+wgpu_shadow_atlas_render(wgpu_shadow_atlas_t* atlas,
+                         WGPUCommandEncoder cmd_encoder,
+                         wgpu_shadow_atlas_draw_callback_t draw_callback,
+                         void* user_data);
+
+/* Tile of a light after the last update, false when it has none */
+bool wgpu_shadow_atlas_get_tile(wgpu_shadow_atlas_t* atlas, uint32_t light,
+                                wgpu_shadow_atlas_tile_t* tile);
+
+/*
+ * Bind group of the shading passes, visible from fragment shaders:
+ *   binding 0: var<uniform> shadowAtlasParams : ShadowAtlasParams
+ *   binding 1: var shadowAtlas : texture_depth_2d
+ *   binding 2: var shadowAtlasSampler : sampler_comparison
+ */
+WGPUBindGroupLayout
+wgpu_shadow_atlas_get_bind_group_layout(wgpu_shadow_atlas_t* atlas);
+WGPUBindGroup wgpu_shadow_atlas_get_bind_group(wgpu_shadow_atlas_t* atlas);
+
+/*
+ * WGSL shadow lookup function for shading passes, to be prepended to their
+ * source. The shader declares the bindings of the bind group above with the
+ * names shadowAtlasParams, shadowAtlas and shadowAtlasSampler. The visibility
+ * is 1.0 for the lights without a tile and outside of the light frustum:
+ *   fn shadowAtlasGetVisibility(light : u32, worldPosition : vec3<f32>) -> f32
+ */
+const char* wgpu_shadow_atlas_get_wgsl_functions(void);
+
+#endif
@@ -0,0 +1,383 @@
+#include "skybox.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/file.h"
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+typedef struct skybox_params_t {
+  mat4 inv_view_projection;
+  float near_depth;
+  float far_depth;
+  float bright_threshold;
+  uint32_t tonemap;
+} skybox_params_t;
+
+struct wgpu_skybox {
+  wgpu_context_t* wgpu_context;
+  wgpu_skybox_desc_t desc;
+  skybox_params_t params;
+  wgpu_buffer_t params_buffer;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+  WGPURenderPipeline pipeline;
+};
+
+// clang-format off
+static const char* skybox_shader_wgsl = CODE(
+  struct Params {
+    invViewProjection : mat4x4<f32>,
+    nearDepth : f32,
+    farDepth : f32,
+    brightThreshold : f32,
+    tonemap : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1) var cubemap : texture_cube<f32>;
+  @group(0) @binding(2) var cubemapSampler : sampler;
+  @group(0) @binding(3) var<uniform> exposure : f32;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) direction : vec3<f32>,
+  };
+
+  // A full screen triangle at the far plane. The view is a rotation, the
+  // corners of the triangle on the near plane are the view directions, which
+  // interpolate linearly over the screen
+  @vertex
+  fn vs_main(@builtin(vertex_index) index : u32) -> VertexOutput {
+    let uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+    let ndc = uv * 2.0 - vec2<f32>(1.0);
+    var output : VertexOutput;
+    output.position = vec4<f32>(ndc, params.farDepth, 1.0);
+    output.direction
+      = (params.invViewProjection * vec4<f32>(ndc, params.nearDepth, 1.0)).xyz;
+    return output;
+  }
+
+  fn sampleSky(direction : vec3<f32>) -> vec3<f32> {
+    let color = textureSample(cubemap, cubemapSampler, direction).rgb;
+    if (params.tonemap != 0u) {
+      return vec3<f32>(1.0) - exp(-color * exposure);
+    }
+    return color;
+  }
+
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    return vec4<f32>(sampleSky(input.direction), 1.0);
+  }
+
+  struct BrightOutput {
+    @location(0) color : vec4<f32>,
+    @location(1) bright : vec4<f32>,
+  };
+
+  @fragment
+  fn fs_bright(input : VertexOutput) -> BrightOutput {
+    let color = sampleSky(input.direction);
+    let luminance = dot(color, vec3<f32>(0.2126, 0.7152, 0.0722));
+    var output : BrightOutput;
+    output.color = vec4<f32>(color, 1.0);
+    output.bright = vec4<f32>(
+      select(vec3<f32>(0.0), color, luminance > params.brightThreshold), 1.0);
+    return output;
+  }
+);
+// clang-format on
+
+static void skybox_create_pipeline(wgpu_skybox_t* skybox)
+{
+  wgpu_context_t* wgpu_context = skybox->wgpu_context;
+
+  WGPUBindGroupLayoutEntry bgl_entries[4] = {
+    [0] = (WGPUBindGroupLayoutEntry) {
+      // Binding 0: Parameters
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Vertex | WGPUShaderStage_Fragment,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(skybox_params_t),
+      },
+      .sampler = {0},
+    },
+    [1] = (WGPUBindGroupLayoutEntry) {
+      // Binding 1: Cubemap
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout) {
+        .sampleType    = WGPUTextureSampleType_Float,
+        .viewDimension = WGPUTextureViewDimension_Cube,
+        .multisampled  = false,
+      },
+      .storageTexture = {0},
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Cubemap sampler
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Fragment,
+      .sampler = (WGPUSamplerBindingLayout){
+        .type = WGPUSamplerBindingType_Filtering,
+      },
+      .texture = {0},
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Exposure
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Fragment,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(float),
+      },
+      .sampler = {0},
+    },
+  };
+  skybox->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "skybox_bgl",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(skybox->bind_group_layout != NULL);
+
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "skybox_pl",
+                            .bindGroupLayoutCount = 1,
+                            .bindGroupLayouts = &skybox->bind_group_layout,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  // A full screen triangle
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_None,
+  };
+
+  WGPUColorTargetState color_target_states[WGPU_SKYBOX_MAX_COLOR_TARGETS];
+  for (uint32_t i = 0; i < skybox->desc.color_target_count; ++i) {
+    color_target_states[i] = (WGPUColorTargetState){
+      .format    = skybox->desc.color_formats[i],
+      .writeMask = WGPUColorWriteMask_All,
+    };
+  }
+
+  // Tested against the far plane of the scene without writing the depth
+  WGPUDepthStencilState depth_stencil_state
+    = wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+      .format              = skybox->desc.depth_format,
+      .depth_write_enabled = false,
+      .wgpu_context        = wgpu_context,
+    });
+
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "skybox_shader",
+                  .wgsl_code.source = skybox_shader_wgsl,
+                  .entry            = "vs_main",
+                },
+                .buffer_count = 0,
+                .buffers      = NULL,
+              });
+
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+                wgpu_context, &(wgpu_fragment_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Fragment shader WGSL
+                  .label            = "skybox_shader",
+                  .wgsl_code.source = skybox_shader_wgsl,
+                  .entry = skybox->desc.color_target_count > 1 ? "fs_bright" :
+                                                                 "fs_main",
+                },
+                .target_count = skybox->desc.color_target_count,
+                .targets      = color_target_states,
+              });
+
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = skybox->desc.sample_count,
+      });
+
+  skybox->pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label        = "skybox_render_pipeline",
+                            .layout       = pipeline_layout,
+                            .primitive    = primitive_state,
+                            .vertex       = vertex_state,
+                            .fragment     = &fragment_state,
+                            .depthStencil = &depth_stencil_state,
+                            .multisample  = multisample_state,
+                          });
+  ASSERT(skybox->pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+static void skybox_write_params(wgpu_skybox_t* skybox)
+{
+  wgpuQueueWriteBuffer(skybox->wgpu_context->queue,
+                       skybox->params_buffer.buffer, 0, &skybox->params,
+                       sizeof(skybox->params));
+}
+
+wgpu_skybox_t* wgpu_skybox_create(wgpu_context_t* wgpu_context,
+                                  const wgpu_skybox_desc_t* desc)
+{
+  ASSERT(desc != NULL && desc->cubemap_view != NULL && desc->sampler != NULL);
+  ASSERT(desc->color_target_count <= WGPU_SKYBOX_MAX_COLOR_TARGETS);
+
+  wgpu_skybox_t* skybox = (wgpu_skybox_t*)malloc(sizeof(wgpu_skybox_t));
+  memset(skybox, 0, sizeof(wgpu_skybox_t));
+  skybox->wgpu_context = wgpu_context;
+  skybox->desc         = *desc;
+  if (desc->color_target_count == 0) {
+    skybox->desc.color_target_count = 1;
+    skybox->desc.color_formats[0]   = wgpu_context->swap_chain.format;
+  }
+  if (desc->depth_format == WGPUTextureFormat_Undefined) {
+    skybox->desc.depth_format = wgpu_get_depth_format(wgpu_context);
+  }
+  if (desc->sample_count == 0) {
+    skybox->desc.sample_count = 1;
+  }
+
+  // The far plane is the depth the pass is cleared to
+  const float far_depth = wgpu_get_depth_clear_value(wgpu_context);
+
+  skybox->params = (skybox_params_t){
+    .near_depth       = 1.0f - far_depth,
+    .far_depth        = far_depth,
+    .bright_threshold = desc->bright_threshold,
+    .tonemap          = desc->exposure_buffer != NULL ? 1 : 0,
+  };
+  glm_mat4_identity(skybox->params.inv_view_projection);
+  skybox->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "skybox_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(skybox_params_t),
+                  });
+  skybox_write_params(skybox);
+
+  skybox_create_pipeline(skybox);
+
+  // Without exposure buffer the binding is not read, the parameters fill it
+  WGPUBindGroupEntry bg_entries[4] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = skybox->params_buffer.buffer,
+      .offset  = 0,
+      .size    = skybox->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = desc->cubemap_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding = 2,
+      .sampler = desc->sampler,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding = 3,
+      .buffer  = desc->exposure_buffer != NULL ? desc->exposure_buffer :
+                                                 skybox->params_buffer.buffer,
+      .offset  = 0,
+      .size    = sizeof(float),
+    },
+  };
+  skybox->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "skybox_bind_group",
+                            .layout     = skybox->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(skybox->bind_group != NULL);
+
+  return skybox;
+}
+
+void wgpu_skybox_release(wgpu_skybox_t* skybox)
+{
+  if (skybox == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, skybox->bind_group);
+  WGPU_RELEASE_RESOURCE(RenderPipeline, skybox->pipeline);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, skybox->bind_group_layout);
+  wgpu_destroy_buffer(&skybox->params_buffer);
+
+  free(skybox);
+}
+
+void wgpu_skybox_set_view_projection(wgpu_skybox_t* skybox, mat4 view,
+                                     mat4 projection)
+{
+  // The sky is infinitely far away, it rotates with the view only
+  mat4 rotation;
+  glm_mat4_copy(view, rotation);
+  glm_vec3_zero(rotation[3]);
+
+  mat4 view_projection;
+  glm_mat4_mul(projection, rotation, view_projection);
+  glm_mat4_inv(view_projection, skybox->params.inv_view_projection);
+  skybox_write_params(skybox);
+}
+
+void wgpu_skybox_draw(wgpu_skybox_t* skybox,
+                      WGPURenderPassEncoder pass_encoder)
+{
+  wgpuRenderPassEncoderSetPipeline(pass_encoder, skybox->pipeline);
+  wgpuRenderPassEncoderSetBindGroup(pass_encoder, 0, skybox->bind_group, 0,
+                                    0);
+  wgpuRenderPassEncoderDraw(pass_encoder, 3, 1, 0, 0);
+}
+
+static bool skybox_is_bc6h_format(WGPUTextureFormat format)
+{
+  return format == WGPUTextureFormat_BC6HRGBUfloat
+         || format == WGPUTextureFormat_BC6HRGBFloat;
+}
+
+texture_t wgpu_skybox_load_cubemap(wgpu_context_t* wgpu_context,
+                                   const wgpu_skybox_cubemap_desc_t* desc)
+{
+  ASSERT(desc != NULL);
+
+  // Block compressed HDR cubemap
+  if (desc->bc6h_filename != NULL
+      && wgpu_has_feature(wgpu_context, WGPUFeatureName_TextureCompressionBC)
+      && file_exists(desc->bc6h_filename)) {
+    texture_t texture = wgpu_create_texture_from_file(
+      wgpu_context, desc->bc6h_filename, desc->options);
+    if (texture.texture != NULL && skybox_is_bc6h_format(texture.format)
+        && texture.size.depth == 6) {
+      return texture;
+    }
+    log_warn("%s is not a BC6H cubemap, loading the uncompressed one",
+             desc->bc6h_filename);
+    wgpu_destroy_texture(&texture);
+  }
+
+  if (desc->filename != NULL) {
+    return wgpu_create_texture_from_file(wgpu_context, desc->filename,
+                                         desc->options);
+  }
+  ASSERT(desc->face_filenames != NULL);
+  return wgpu_create_texture_cubemap_from_files(
+    wgpu_context, desc->face_filenames, desc->options);
+}
@@ -0,0 +1,72 @@
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+#include "texture.h"
+
+#define WGPU_SKYBOX_MAX_COLOR_TARGETS 2u
+
+typedef struct wgpu_skybox wgpu_skybox_t;
+
+typedef struct wgpu_skybox_desc_t {
+  /* Cube view and sampler of the cubemap, not owned */
+  WGPUTextureView cubemap_view;
+  WGPUSampler sampler;
+  /* Color targets of the pass the skybox is drawn in, 0 selects one target
+   * of the swap chain format */
+  uint32_t color_target_count;
+  WGPUTextureFormat color_formats[WGPU_SKYBOX_MAX_COLOR_TARGETS];
+  /* With two color targets the second one receives the sky where its
+   * luminance exceeds the threshold and black elsewhere, e.g. for bloom */
+  float bright_threshold;
+  /* Uniform buffer with the exposure as first f32, e.g. written by the auto
+   * exposure. The sky is tone mapped with 1 - exp(-color * exposure) before
+   * the bright pass when set (optional) */
+  WGPUBuffer exposure_buffer;
+  /* Depth attachment of the pass, Undefined selects wgpu_get_depth_format */
+  WGPUTextureFormat depth_format;
+  uint32_t sample_count;
+} wgpu_skybox_desc_t;
+
+/*
+ * Skybox drawn after the opaque geometry. A full screen triangle at the far
+ * plane is depth tested against the scene without writing the depth, so that
+ * only the pixels the scene left uncovered sample the cubemap. The far plane
+ * and the compare function follow the depth convention of the context,
+ * reversed-Z included, the pass clears the depth to
+ * wgpu_get_depth_clear_value.
+ */
+wgpu_skybox_t* wgpu_skybox_create(wgpu_context_t* wgpu_context,
+                                  const wgpu_skybox_desc_t* desc);
+void wgpu_skybox_release(wgpu_skybox_t* skybox);
+
+/* Sets the camera of the sky, the translation of the view is ignored */
+void wgpu_skybox_set_view_projection(wgpu_skybox_t* skybox, mat4 view,
+                                     mat4 projection);
+
+/* Draws the skybox, after the opaque geometry of the pass */
+void wgpu_skybox_draw(wgpu_skybox_t* skybox,
+                      WGPURenderPassEncoder pass_encoder);
+
+typedef struct wgpu_skybox_cubemap_desc_t {
+  /* KTX2 cubemap in BC6HRGBUfloat or BC6HRGBFloat, loaded when the device
+   * has TextureCompressionBC and the file exists (optional) */
+  const char* bc6h_filename;
+  /* Uncompressed fallback, a single cubemap file or the 6 face images in the
+   * order [+X, -X, +Y, -Y, +Z, -Z] */
+  const char* filename;
+  const char** face_filenames;
+  struct wgpu_texture_load_options_t* options;
+} wgpu_skybox_cubemap_desc_t;
+
+/**
+ * @brief Loads the cubemap of a skybox. A BC6H cubemap takes an eighth of the
+ * memory and bandwidth of RGBA16Float and keeps the HDR range that RGBA8
+ * faces lack, the uncompressed files are only read without one.
+ */
+texture_t wgpu_skybox_load_cubemap(wgpu_context_t* wgpu_context,
+                                   const wgpu_skybox_cubemap_desc_t* desc);
+
+#endif
@@ -0,0 +1,577 @@
+#include "spatial_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "gpu_sort.h"
+#include "shader.h"
+
+#define SPATIAL_HASH_WORKGROUP_SIZE 64u
+#define SPATIAL_HASH_MAX_CACHED_POINT_BUFFERS 2u
+
+/* Layout of SpatialHashParams */
+typedef struct spatial_hash_params_t {
+  float cell_size;
+  uint32_t table_size;
+  uint32_t point_count;
+  uint32_t point_stride; /* in u32 */
+  uint32_t dimensions;
+  uint32_t packed_positions;
+  uint32_t padding[2];
+} spatial_hash_params_t;
+
+struct wgpu_spatial_hash {
+  wgpu_context_t* wgpu_context;
+  spatial_hash_params_t params;
+  uint32_t max_point_count;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t cell_counts_buffer;
+  wgpu_buffer_t cell_offsets_buffer;
+  wgpu_buffer_t point_keys_buffer; /* bucket and rank in the bucket */
+  wgpu_buffer_t indices_buffer;
+  /* Hashing */
+  WGPUBindGroupLayout hash_bind_group_layout;
+  WGPUBindGroupLayout points_bind_group_layout;
+  WGPUPipelineLayout hash_pipeline_layout;
+  WGPUComputePipeline clear_pipeline;
+  WGPUComputePipeline count_pipeline;
+  WGPUComputePipeline scatter_pipeline;
+  WGPUBindGroup hash_bind_group;
+  struct {
+    WGPUBuffer buffer;
+    WGPUBindGroup bind_group;
+  } points[SPATIAL_HASH_MAX_CACHED_POINT_BUFFERS];
+  uint32_t next_points_entry;
+  /* Prefix sum of the bucket counts */
+  wgpu_gpu_sort_t* gpu_sort;
+  /* Queries */
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* spatial_hash_wgsl_functions = CODE(
+  struct SpatialHashParams {
+    cellSize : f32,
+    tableSize : u32,
+    pointCount : u32,
+    pointStride : u32,
+    dimensions : u32,
+    packedPositions : u32,
+    padding0 : u32,
+    padding1 : u32,
+  };
+
+  fn spatialHashGetCell(position : vec3<f32>) -> vec3<i32> {
+    var p = position;
+    if (spatialHashParams.dimensions < 3u) {
+      p.z = 0.0;
+    }
+    return vec3<i32>(floor(p / spatialHashParams.cellSize));
+  }
+
+  // The table size is a power of two
+  fn spatialHashGetKey(cell : vec3<i32>) -> u32 {
+    let c = vec3<u32>(cell);
+    let h = (c.x * 73856093u) ^ (c.y * 19349663u) ^ (c.z * 83492791u);
+    return h & (spatialHashParams.tableSize - 1u);
+  }
+);
+
+static const char* spatial_hash_build_shader_wgsl = CODE(
+  @group(0) @binding(0) var<uniform> spatialHashParams : SpatialHashParams;
+  @group(0) @binding(1)
+  var<storage, read_write> cellCounts : array<atomic<u32>>;
+  @group(0) @binding(2) var<storage, read_write> pointKeys : array<vec2<u32>>;
+  @group(0) @binding(3) var<storage, read> cellOffsets : array<u32>;
+  @group(0) @binding(4) var<storage, read_write> indices : array<u32>;
+  @group(1) @binding(0) var<storage, read> points : array<u32>;
+
+  fn getPointPosition(index : u32) -> vec3<f32> {
+    let first = index * spatialHashParams.pointStride;
+    if (spatialHashParams.packedPositions != 0u) {
+      return vec3<f32>(unpack2x16snorm(points[first]), 0.0);
+    }
+    return bitcast<vec3<f32>>(
+      vec3<u32>(points[first], points[first + 1u], points[first + 2u]));
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_clear(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x < spatialHashParams.tableSize) {
+      atomicStore(&cellCounts[id.x], 0u);
+    }
+  }
+
+  // The rank of a point in its bucket is its slot in the sorted indices
+  @compute @workgroup_size(64)
+  fn cs_count(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= spatialHashParams.pointCount) {
+      return;
+    }
+    let position = getPointPosition(id.x);
+    let key = spatialHashGetKey(spatialHashGetCell(position));
+    let rank = atomicAdd(&cellCounts[key], 1u);
+    pointKeys[id.x] = vec2<u32>(key, rank);
+  }
+
+  @compute @workgroup_size(64)
+  fn cs_scatter(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= spatialHashParams.pointCount) {
+      return;
+    }
+    let key = pointKeys[id.x];
+    indices[cellOffsets[key.x] + key.y] = id.x;
+  }
+);
+
+// clang-format on
+
+static uint32_t spatial_hash_next_power_of_two(uint32_t value)
+{
+  uint32_t power = 1;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+static wgpu_buffer_t spatial_hash_create_storage_buffer(
+  wgpu_context_t* wgpu_context, const char* label, uint64_t size)
+{
+  return wgpu_create_buffer(wgpu_context, &(wgpu_buffer_desc_t){
+                                            .label = label,
+                                            .usage = WGPUBufferUsage_Storage,
+                                            .size  = size,
+                                          });
+}
+
+static WGPUBindGroupLayoutEntry
+spatial_hash_storage_entry(uint32_t binding, WGPUBufferBindingType type,
+                           uint64_t min_binding_size)
+{
+  return (WGPUBindGroupLayoutEntry){
+    .binding    = binding,
+    .visibility = WGPUShaderStage_Compute,
+    .buffer = (WGPUBufferBindingLayout) {
+      .type           = type,
+      .minBindingSize = min_binding_size,
+    },
+    .sampler = {0},
+  };
+}
+
+static void
+spatial_hash_create_bind_group_layouts(wgpu_spatial_hash_t* spatial_hash)
+{
+  wgpu_context_t* wgpu_context = spatial_hash->wgpu_context;
+  const uint64_t table_bytes   = spatial_hash->cell_counts_buffer.size;
+
+  WGPUBindGroupLayoutEntry params_entry = {
+    // Binding 0: Hash parameters
+    .binding    = 0,
+    .visibility = WGPUShaderStage_Compute,
+    .buffer = (WGPUBufferBindingLayout) {
+      .type           = WGPUBufferBindingType_Uniform,
+      .minBindingSize = sizeof(spatial_hash_params_t),
+    },
+    .sampler = {0},
+  };
+
+  // Hashing
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[5] = {
+      [0] = params_entry,
+      // Binding 1: Bucket counts
+      [1] = spatial_hash_storage_entry(1, WGPUBufferBindingType_Storage,
+                                       table_bytes),
+      // Binding 2: Bucket and rank of the points
+      [2] = spatial_hash_storage_entry(
+        2, WGPUBufferBindingType_Storage,
+        spatial_hash->point_keys_buffer.size),
+      // Binding 3: Bucket offsets
+      [3] = spatial_hash_storage_entry(
+        3, WGPUBufferBindingType_ReadOnlyStorage, table_bytes),
+      // Binding 4: Sorted point indices
+      [4] = spatial_hash_storage_entry(4, WGPUBufferBindingType_Storage,
+                                       spatial_hash->indices_buffer.size),
+    };
+    spatial_hash->hash_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "spatial_hash_build_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(spatial_hash->hash_bind_group_layout != NULL);
+  }
+
+  // Points
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[1] = {
+      // Binding 0: Points
+      [0] = spatial_hash_storage_entry(
+        0, WGPUBufferBindingType_ReadOnlyStorage, 0),
+    };
+    spatial_hash->points_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "spatial_hash_points_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(spatial_hash->points_bind_group_layout != NULL);
+  }
+
+  // Queries
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[4] = {
+      [0] = params_entry,
+      // Binding 1: Bucket offsets
+      [1] = spatial_hash_storage_entry(
+        1, WGPUBufferBindingType_ReadOnlyStorage, table_bytes),
+      // Binding 2: Bucket counts
+      [2] = spatial_hash_storage_entry(
+        2, WGPUBufferBindingType_ReadOnlyStorage, table_bytes),
+      // Binding 3: Sorted point indices
+      [3] = spatial_hash_storage_entry(
+        3, WGPUBufferBindingType_ReadOnlyStorage,
+        spatial_hash->indices_buffer.size),
+    };
+    spatial_hash->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "spatial_hash_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(spatial_hash->bind_group_layout != NULL);
+  }
+}
+
+static WGPUComputePipeline
+spatial_hash_create_pipeline(wgpu_context_t* wgpu_context,
+                             WGPUPipelineLayout pipeline_layout,
+                             const wgpu_shader_t* shader, const char* entry)
+{
+  WGPUProgrammableStageDescriptor stage = shader->programmable_stage_descriptor;
+  stage.entryPoint                      = entry;
+  WGPUComputePipeline pipeline          = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device, &(WGPUComputePipelineDescriptor){
+                            .label   = "spatial_hash_pipeline",
+                            .layout  = pipeline_layout,
+                            .compute = stage,
+                          });
+  ASSERT(pipeline != NULL);
+  return pipeline;
+}
+
+static void spatial_hash_create_pipelines(wgpu_spatial_hash_t* spatial_hash)
+{
+  wgpu_context_t* wgpu_context = spatial_hash->wgpu_context;
+
+  // Hashing
+  {
+    WGPUBindGroupLayout bind_group_layouts[2] = {
+      spatial_hash->hash_bind_group_layout,   /* Group 0 */
+      spatial_hash->points_bind_group_layout, /* Group 1 */
+    };
+    spatial_hash->hash_pipeline_layout = wgpuDeviceCreatePipelineLayout(
+      wgpu_context->device,
+      &(WGPUPipelineLayoutDescriptor){
+        .label                = "spatial_hash_build_pipeline_layout",
+        .bindGroupLayoutCount = (uint32_t)ARRAY_SIZE(bind_group_layouts),
+        .bindGroupLayouts     = bind_group_layouts,
+      });
+    ASSERT(spatial_hash->hash_pipeline_layout != NULL);
+
+    // The build shader shares the parameter struct of the hashing functions
+    const size_t wgsl_size = strlen(spatial_hash_wgsl_functions)
+                             + strlen(spatial_hash_build_shader_wgsl) + 2;
+    char* wgsl = malloc(wgsl_size);
+    snprintf(wgsl, wgsl_size, "%s\n%s", spatial_hash_wgsl_functions,
+             spatial_hash_build_shader_wgsl);
+    wgpu_shader_t comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "spatial_hash_build_shader",
+                      .wgsl_code.source = wgsl,
+                      .entry            = "cs_clear",
+                    });
+    spatial_hash->clear_pipeline = spatial_hash_create_pipeline(
+      wgpu_context, spatial_hash->hash_pipeline_layout, &comp_shader,
+      "cs_clear");
+    spatial_hash->count_pipeline = spatial_hash_create_pipeline(
+      wgpu_context, spatial_hash->hash_pipeline_layout, &comp_shader,
+      "cs_count");
+    spatial_hash->scatter_pipeline = spatial_hash_create_pipeline(
+      wgpu_context, spatial_hash->hash_pipeline_layout, &comp_shader,
+      "cs_scatter");
+    wgpu_shader_release(&comp_shader);
+    free(wgsl);
+  }
+}
+
+wgpu_spatial_hash_t*
+wgpu_spatial_hash_create(wgpu_context_t* wgpu_context,
+                         const wgpu_spatial_hash_desc_t* desc)
+{
+  ASSERT(desc->max_point_count > 0);
+  ASSERT(desc->point_stride > 0
+         && desc->point_stride % (desc->packed_positions ? 4 : 16) == 0);
+  ASSERT(desc->dimensions == 2 || desc->dimensions == 3);
+  ASSERT(!desc->packed_positions || desc->dimensions == 2);
+  ASSERT(desc->cell_size > 0.0f);
+
+  wgpu_spatial_hash_t* spatial_hash
+    = (wgpu_spatial_hash_t*)malloc(sizeof(wgpu_spatial_hash_t));
+  memset(spatial_hash, 0, sizeof(wgpu_spatial_hash_t));
+  spatial_hash->wgpu_context    = wgpu_context;
+  spatial_hash->max_point_count = desc->max_point_count;
+
+  spatial_hash_params_t* params = &spatial_hash->params;
+  params->cell_size             = desc->cell_size;
+  params->table_size            = spatial_hash_next_power_of_two(
+    desc->table_size > 0 ? desc->table_size : desc->max_point_count);
+  params->point_stride     = desc->point_stride / 4;
+  params->dimensions       = desc->dimensions;
+  params->packed_positions = desc->packed_positions ? 1 : 0;
+
+  spatial_hash->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "spatial_hash_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(spatial_hash_params_t),
+                  });
+  spatial_hash->cell_counts_buffer = spatial_hash_create_storage_buffer(
+    wgpu_context, "spatial_hash_cell_counts_buffer",
+    params->table_size * sizeof(uint32_t));
+  spatial_hash->cell_offsets_buffer = spatial_hash_create_storage_buffer(
+    wgpu_context, "spatial_hash_cell_offsets_buffer",
+    params->table_size * sizeof(uint32_t));
+  spatial_hash->point_keys_buffer = spatial_hash_create_storage_buffer(
+    wgpu_context, "spatial_hash_point_keys_buffer",
+    desc->max_point_count * 2 * sizeof(uint32_t));
+  spatial_hash->indices_buffer = spatial_hash_create_storage_buffer(
+    wgpu_context, "spatial_hash_indices_buffer",
+    desc->max_point_count * sizeof(uint32_t));
+
+  spatial_hash_create_bind_group_layouts(spatial_hash);
+  spatial_hash_create_pipelines(spatial_hash);
+  spatial_hash->gpu_sort = wgpu_gpu_sort_create(
+    wgpu_context, &(wgpu_gpu_sort_desc_t){
+                    .max_element_count = params->table_size,
+                  });
+
+  // Hashing
+  {
+    WGPUBindGroupEntry bg_entries[5] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = spatial_hash->params_buffer.buffer,
+        .size    = spatial_hash->params_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding = 1,
+        .buffer  = spatial_hash->cell_counts_buffer.buffer,
+        .size    = spatial_hash->cell_counts_buffer.size,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding = 2,
+        .buffer  = spatial_hash->point_keys_buffer.buffer,
+        .size    = spatial_hash->point_keys_buffer.size,
+      },
+      [3] = (WGPUBindGroupEntry) {
+        .binding = 3,
+        .buffer  = spatial_hash->cell_offsets_buffer.buffer,
+        .size    = spatial_hash->cell_offsets_buffer.size,
+      },
+      [4] = (WGPUBindGroupEntry) {
+        .binding = 4,
+        .buffer  = spatial_hash->indices_buffer.buffer,
+        .size    = spatial_hash->indices_buffer.size,
+      },
+    };
+    spatial_hash->hash_bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label  = "spatial_hash_build_bind_group",
+                              .layout = spatial_hash->hash_bind_group_layout,
+                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entries    = bg_entries,
+                            });
+    ASSERT(spatial_hash->hash_bind_group != NULL);
+  }
+
+  // Queries
+  {
+    WGPUBindGroupEntry bg_entries[4] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = spatial_hash->params_buffer.buffer,
+        .size    = spatial_hash->params_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding = 1,
+        .buffer  = spatial_hash->cell_offsets_buffer.buffer,
+        .size    = spatial_hash->cell_offsets_buffer.size,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding = 2,
+        .buffer  = spatial_hash->cell_counts_buffer.buffer,
+        .size    = spatial_hash->cell_counts_buffer.size,
+      },
+      [3] = (WGPUBindGroupEntry) {
+        .binding = 3,
+        .buffer  = spatial_hash->indices_buffer.buffer,
+        .size    = spatial_hash->indices_buffer.size,
+      },
+    };
+    spatial_hash->bind_group = wgpuDeviceCreateBindGroup(
+      wgpu_context->device, &(WGPUBindGroupDescriptor){
+                              .label      = "spatial_hash_bind_group",
+                              .layout     = spatial_hash->bind_group_layout,
+                              .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                              .entries    = bg_entries,
+                            });
+    ASSERT(spatial_hash->bind_group != NULL);
+  }
+
+  return spatial_hash;
+}
+
+void wgpu_spatial_hash_release(wgpu_spatial_hash_t* spatial_hash)
+{
+  if (spatial_hash == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(BindGroup, spatial_hash->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, spatial_hash->bind_group_layout)
+  wgpu_gpu_sort_release(spatial_hash->gpu_sort);
+  for (uint32_t i = 0; i < SPATIAL_HASH_MAX_CACHED_POINT_BUFFERS; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, spatial_hash->points[i].bind_group)
+  }
+  WGPU_RELEASE_RESOURCE(BindGroup, spatial_hash->hash_bind_group)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, spatial_hash->scatter_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, spatial_hash->count_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, spatial_hash->clear_pipeline)
+  WGPU_RELEASE_RESOURCE(PipelineLayout, spatial_hash->hash_pipeline_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout,
+                        spatial_hash->points_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, spatial_hash->hash_bind_group_layout)
+  wgpu_destroy_buffer(&spatial_hash->indices_buffer);
+  wgpu_destroy_buffer(&spatial_hash->point_keys_buffer);
+  wgpu_destroy_buffer(&spatial_hash->cell_offsets_buffer);
+  wgpu_destroy_buffer(&spatial_hash->cell_counts_buffer);
+  wgpu_destroy_buffer(&spatial_hash->params_buffer);
+  free(spatial_hash);
+}
+
+void wgpu_spatial_hash_set_cell_size(wgpu_spatial_hash_t* spatial_hash,
+                                     float cell_size)
+{
+  ASSERT(cell_size > 0.0f);
+  spatial_hash->params.cell_size = cell_size;
+}
+
+/* Bind groups of the most recently hashed point buffers, the examples
+ * ping-pong between two */
+static WGPUBindGroup
+spatial_hash_get_points_bind_group(wgpu_spatial_hash_t* spatial_hash,
+                                   WGPUBuffer points_buffer)
+{
+  for (uint32_t i = 0; i < SPATIAL_HASH_MAX_CACHED_POINT_BUFFERS; ++i) {
+    if (spatial_hash->points[i].buffer == points_buffer) {
+      return spatial_hash->points[i].bind_group;
+    }
+  }
+
+  const uint32_t i = spatial_hash->next_points_entry;
+  spatial_hash->next_points_entry
+    = (i + 1) % SPATIAL_HASH_MAX_CACHED_POINT_BUFFERS;
+  WGPUBindGroupEntry bg_entries[1] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = points_buffer,
+      .size    = WGPU_WHOLE_SIZE,
+    },
+  };
+  WGPU_RELEASE_RESOURCE(BindGroup, spatial_hash->points[i].bind_group)
+  spatial_hash->points[i].bind_group = wgpuDeviceCreateBindGroup(
+    spatial_hash->wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .label      = "spatial_hash_points_bind_group",
+      .layout     = spatial_hash->points_bind_group_layout,
+      .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+      .entries    = bg_entries,
+    });
+  ASSERT(spatial_hash->points[i].bind_group != NULL);
+  spatial_hash->points[i].buffer = points_buffer;
+  return spatial_hash->points[i].bind_group;
+}
+
+static void spatial_hash_dispatch(WGPUComputePassEncoder pass_encoder,
+                                  WGPUComputePipeline pipeline,
+                                  uint32_t invocation_count,
+                                  uint32_t workgroup_size)
+{
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder, (invocation_count + workgroup_size - 1) / workgroup_size, 1,
+    1);
+}
+
+void wgpu_spatial_hash_build(wgpu_spatial_hash_t* spatial_hash,
+                             WGPUComputePassEncoder pass_encoder,
+                             WGPUBuffer points_buffer, uint32_t point_count)
+{
+  ASSERT(point_count <= spatial_hash->max_point_count);
+
+  spatial_hash_params_t* params = &spatial_hash->params;
+  params->point_count           = point_count;
+  wgpuQueueWriteBuffer(spatial_hash->wgpu_context->queue,
+                       spatial_hash->params_buffer.buffer, 0, params,
+                       sizeof(*params));
+
+  // Count the points of every bucket
+  WGPUBindGroup points_bind_group
+    = spatial_hash_get_points_bind_group(spatial_hash, points_buffer);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0,
+                                     spatial_hash->hash_bind_group, 0, NULL);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, points_bind_group, 0,
+                                     NULL);
+  spatial_hash_dispatch(pass_encoder, spatial_hash->clear_pipeline,
+                        params->table_size, SPATIAL_HASH_WORKGROUP_SIZE);
+  spatial_hash_dispatch(pass_encoder, spatial_hash->count_pipeline,
+                        point_count, SPATIAL_HASH_WORKGROUP_SIZE);
+
+  // Prefix-sum the counts into the bucket offsets
+  wgpu_gpu_sort_scan(spatial_hash->gpu_sort, pass_encoder,
+                     spatial_hash->cell_counts_buffer.buffer,
+                     spatial_hash->cell_offsets_buffer.buffer,
+                     params->table_size);
+
+  // Scatter the point indices sorted by bucket
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0,
+                                     spatial_hash->hash_bind_group, 0, NULL);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 1, points_bind_group, 0,
+                                     NULL);
+  spatial_hash_dispatch(pass_encoder, spatial_hash->scatter_pipeline,
+                        point_count, SPATIAL_HASH_WORKGROUP_SIZE);
+}
+
+WGPUBindGroupLayout
+wgpu_spatial_hash_get_bind_group_layout(wgpu_spatial_hash_t* spatial_hash)
+{
+  return spatial_hash->bind_group_layout;
+}
+
+WGPUBindGroup
+wgpu_spatial_hash_get_bind_group(wgpu_spatial_hash_t* spatial_hash)
+{
+  return spatial_hash->bind_group;
+}
+
+const char* wgpu_spatial_hash_get_wgsl_functions(void)
+{
+  return spatial_hash_wgsl_functions;
+}
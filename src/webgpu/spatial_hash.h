@@ -0,0 +1,78 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include "context.h"
+
+/*
+ * Spatial hash grid for neighbour queries over points in a storage buffer.
+ * Every point is assigned to a cell of a uniform grid, the cells are hashed
+ * into a table, and compute passes count the points of every bucket,
+ * prefix-sum the counts into offsets and scatter the point indices sorted by
+ * bucket. A query loops over the buckets of the adjacent cells only, the
+ * cell size has to be at least the query radius.
+ *
+ * The points are read from an array of structs of point_stride bytes, with the
+ * position as the first vec2<f32> or vec3<f32>, or with packed positions as
+ * the first u32. Buckets are shared by cells with the same hash, queries have
+ * to test the distance to the points.
+ */
+typedef struct wgpu_spatial_hash wgpu_spatial_hash_t;
+
+typedef struct wgpu_spatial_hash_desc_t {
+  /* Largest number of points hashed by a build */
+  uint32_t max_point_count;
+  /* Number of buckets rounded up to a power of two, 0 selects the point
+   * capacity */
+  uint32_t table_size;
+  /* Point layout, point_stride is a multiple of 16, or of 4 with packed
+   * positions */
+  uint32_t point_stride;
+  /* 2 for xy positions, 3 for xyz positions */
+  uint32_t dimensions;
+  /* xy positions in [-1, 1] packed with pack2x16snorm, 2 dimensions only */
+  bool packed_positions;
+  float cell_size;
+} wgpu_spatial_hash_desc_t;
+
+/* Spatial hash creating/releasing */
+wgpu_spatial_hash_t*
+wgpu_spatial_hash_create(wgpu_context_t* wgpu_context,
+                         const wgpu_spatial_hash_desc_t* desc);
+void wgpu_spatial_hash_release(wgpu_spatial_hash_t* spatial_hash);
+
+/* Sets the cell size used by the next build */
+void wgpu_spatial_hash_set_cell_size(wgpu_spatial_hash_t* spatial_hash,
+                                     float cell_size);
+
+/**
+ * @brief Records the hashing of the first point_count points of points_buffer,
+ * which needs the Storage usage. The queries of the frame have to be recorded
+ * afterwards, one build per submitted frame.
+ */
+void wgpu_spatial_hash_build(wgpu_spatial_hash_t* spatial_hash,
+                             WGPUComputePassEncoder pass_encoder,
+                             WGPUBuffer points_buffer, uint32_t point_count);
+
+/*
+ * Bind group of the queries, visible from compute shaders:
+ *   binding 0: var<uniform> spatialHashParams : SpatialHashParams
+ *   binding 1: var<storage, read> spatialHashCellOffsets : array<u32>
+ *   binding 2: var<storage, read> spatialHashCellCounts : array<u32>
+ *   binding 3: var<storage, read> spatialHashIndices : array<u32>
+ * The points of the bucket key are the spatialHashCellCounts[key] indices of
+ * spatialHashIndices from spatialHashCellOffsets[key] on.
+ */
+WGPUBindGroupLayout
+wgpu_spatial_hash_get_bind_group_layout(wgpu_spatial_hash_t* spatial_hash);
+WGPUBindGroup
+wgpu_spatial_hash_get_bind_group(wgpu_spatial_hash_t* spatial_hash);
+
+/*
+ * WGSL hashing functions for queries, to be prepended to their source. The
+ * shader declares the bindings of the bind group above:
+ *   fn spatialHashGetCell(position : vec3<f32>) -> vec3<i32>
+ *   fn spatialHashGetKey(cell : vec3<i32>) -> u32
+ */
+const char* wgpu_spatial_hash_get_wgsl_functions(void);
+
+#endif
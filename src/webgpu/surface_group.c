@@ -0,0 +1,179 @@
+#include "surface_group.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "../core/window.h"
+
+struct wgpu_surface_group {
+  wgpu_context_t* wgpu_context;
+  uint32_t canvas_width;
+  uint32_t canvas_height;
+  uint32_t surface_count;
+  wgpu_surface_group_surface_t surfaces[WGPU_SURFACE_GROUP_MAX_SURFACES];
+};
+
+static void
+wgpu_surface_group_setup_swap_chain(wgpu_surface_group_t* surface_group,
+                                    wgpu_surface_group_surface_t* surface)
+{
+  wgpu_context_t* wgpu_context = surface_group->wgpu_context;
+
+  /* The format of the swap chain of the context, when it has one, so that the
+   * pipelines are shared by all surfaces */
+  const WGPUTextureFormat format
+    = wgpu_context->swap_chain.format != WGPUTextureFormat_Undefined ?
+        wgpu_context->swap_chain.format :
+        WGPUTextureFormat_BGRA8Unorm;
+  WGPUSwapChainDescriptor swap_chain_descriptor = {
+    .usage       = WGPUTextureUsage_RenderAttachment,
+    .format      = format,
+    .width       = surface->width,
+    .height      = surface->height,
+    .presentMode = wgpu_context->swap_chain.present_mode,
+  };
+  if (surface->swap_chain) {
+    wgpuSwapChainRelease(surface->swap_chain);
+  }
+  surface->swap_chain = wgpuDeviceCreateSwapChain(
+    wgpu_context->device, surface->surface, &swap_chain_descriptor);
+  ASSERT(surface->swap_chain);
+}
+
+wgpu_surface_group_t*
+wgpu_surface_group_create(wgpu_context_t* wgpu_context,
+                          const wgpu_surface_group_desc_t* desc)
+{
+  ASSERT(desc->canvas_width > 0 && desc->canvas_height > 0);
+
+  wgpu_surface_group_t* surface_group
+    = (wgpu_surface_group_t*)malloc(sizeof(wgpu_surface_group_t));
+  memset(surface_group, 0, sizeof(wgpu_surface_group_t));
+  surface_group->wgpu_context  = wgpu_context;
+  surface_group->canvas_width  = desc->canvas_width;
+  surface_group->canvas_height = desc->canvas_height;
+
+  return surface_group;
+}
+
+void wgpu_surface_group_release(wgpu_surface_group_t* surface_group)
+{
+  if (surface_group == NULL) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < surface_group->surface_count; ++i) {
+    wgpu_surface_group_surface_t* surface = &surface_group->surfaces[i];
+    WGPU_RELEASE_RESOURCE(TextureView, surface->frame_buffer)
+    WGPU_RELEASE_RESOURCE(SwapChain, surface->swap_chain)
+  }
+  free(surface_group);
+}
+
+uint32_t
+wgpu_surface_group_add_surface(wgpu_surface_group_t* surface_group,
+                               void* window,
+                               const wgpu_surface_viewport_t* viewport)
+{
+  ASSERT(surface_group->surface_count < WGPU_SURFACE_GROUP_MAX_SURFACES);
+  ASSERT(surface_group->wgpu_context->offscreen_swap_chain == NULL);
+
+  const uint32_t index = surface_group->surface_count++;
+  wgpu_surface_group_surface_t* surface = &surface_group->surfaces[index];
+  surface->window  = window;
+  surface->surface = window_get_surface((window_t*)window);
+  window_get_size((window_t*)window, &surface->width, &surface->height);
+  wgpu_surface_group_set_viewport(surface_group, index, viewport);
+  wgpu_surface_group_setup_swap_chain(surface_group, surface);
+
+  return index;
+}
+
+bool wgpu_surface_group_resize_surface(wgpu_surface_group_t* surface_group,
+                                       uint32_t index, uint32_t width,
+                                       uint32_t height)
+{
+  ASSERT(index < surface_group->surface_count);
+  wgpu_surface_group_surface_t* surface = &surface_group->surfaces[index];
+  if ((width == 0 || height == 0)
+      || (width == surface->width && height == surface->height)) {
+    return false;
+  }
+  surface->width  = width;
+  surface->height = height;
+  wgpu_surface_group_setup_swap_chain(surface_group, surface);
+
+  return true;
+}
+
+void wgpu_surface_group_set_viewport(wgpu_surface_group_t* surface_group,
+                                     uint32_t index,
+                                     const wgpu_surface_viewport_t* viewport)
+{
+  ASSERT(index < surface_group->surface_count);
+  ASSERT(viewport->width > 0 && viewport->height > 0);
+  surface_group->surfaces[index].viewport = *viewport;
+}
+
+uint32_t
+wgpu_surface_group_get_surface_count(wgpu_surface_group_t* surface_group)
+{
+  return surface_group->surface_count;
+}
+
+wgpu_surface_group_surface_t*
+wgpu_surface_group_get_surface(wgpu_surface_group_t* surface_group,
+                               uint32_t index)
+{
+  ASSERT(index < surface_group->surface_count);
+  return &surface_group->surfaces[index];
+}
+
+void wgpu_surface_group_get_viewport_matrix(
+  wgpu_surface_group_t* surface_group, uint32_t index, mat4 dest)
+{
+  ASSERT(index < surface_group->surface_count);
+  const wgpu_surface_viewport_t* viewport
+    = &surface_group->surfaces[index].viewport;
+  const float canvas_width  = (float)surface_group->canvas_width;
+  const float canvas_height = (float)surface_group->canvas_height;
+
+  // Center of the viewport in the normalized device coordinates of the
+  // canvas, whose y axis points up
+  const float center_x
+    = 2.0f * (viewport->x + 0.5f * viewport->width) / canvas_width - 1.0f;
+  const float center_y
+    = 1.0f - 2.0f * (viewport->y + 0.5f * viewport->height) / canvas_height;
+  const float scale_x = canvas_width / (float)viewport->width;
+  const float scale_y = canvas_height / (float)viewport->height;
+
+  // Applied before the perspective divide, the offsets scale with w
+  glm_mat4_identity(dest);
+  dest[0][0] = scale_x;
+  dest[1][1] = scale_y;
+  dest[3][0] = -scale_x * center_x;
+  dest[3][1] = -scale_y * center_y;
+}
+
+void wgpu_surface_group_acquire(wgpu_surface_group_t* surface_group)
+{
+  for (uint32_t i = 0; i < surface_group->surface_count; ++i) {
+    wgpu_surface_group_surface_t* surface = &surface_group->surfaces[i];
+    ASSERT(surface->frame_buffer == NULL);
+    surface->frame_buffer
+      = wgpuSwapChainGetCurrentTextureView(surface->swap_chain);
+  }
+}
+
+void wgpu_surface_group_present(wgpu_surface_group_t* surface_group)
+{
+  // Presented together, after the single submit of all surfaces
+  for (uint32_t i = 0; i < surface_group->surface_count; ++i) {
+    wgpuSwapChainPresent(surface_group->surfaces[i].swap_chain);
+  }
+  for (uint32_t i = 0; i < surface_group->surface_count; ++i) {
+    WGPU_RELEASE_RESOURCE(TextureView,
+                          surface_group->surfaces[i].frame_buffer)
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef SURFACE_GROUP_H
+#define SURFACE_GROUP_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+#define WGPU_SURFACE_GROUP_MAX_SURFACES 16u
+
+/*
+ * Window surfaces driven from the device of one context, e.g. the outputs of
+ * a video wall. Every surface has its own swap chain and shows a viewport of
+ * a shared virtual canvas, while the pipelines, the caches and the resources
+ * of the context are shared by all of them. The frames of all surfaces are
+ * acquired, recorded into the same command buffers, submitted once and
+ * presented back to back in one frame loop.
+ *
+ * A scene is rendered for a surface with the view projection of the canvas
+ * premultiplied by the viewport matrix of the surface, which crops the clip
+ * space of the canvas to the viewport of the surface.
+ */
+typedef struct wgpu_surface_group wgpu_surface_group_t;
+
+typedef struct wgpu_surface_group_desc_t {
+  /* Size of the virtual canvas in pixels */
+  uint32_t canvas_width;
+  uint32_t canvas_height;
+} wgpu_surface_group_desc_t;
+
+/* Part of the virtual canvas shown by a surface, in canvas pixels from the top
+ * left corner */
+typedef struct wgpu_surface_viewport_t {
+  uint32_t x, y;
+  uint32_t width, height;
+} wgpu_surface_viewport_t;
+
+/* Surface of the group, frame_buffer is the image of the current frame
+ * between wgpu_surface_group_acquire() and wgpu_surface_group_present() */
+typedef struct wgpu_surface_group_surface_t {
+  void* window; /* window_t */
+  WGPUSurface surface;
+  WGPUSwapChain swap_chain;
+  WGPUTextureView frame_buffer;
+  uint32_t width;
+  uint32_t height;
+  wgpu_surface_viewport_t viewport;
+} wgpu_surface_group_surface_t;
+
+/* Surface group creating/releasing, the swap chains of the surfaces are
+ * released with the group, the windows belong to the caller */
+wgpu_surface_group_t*
+wgpu_surface_group_create(wgpu_context_t* wgpu_context,
+                          const wgpu_surface_group_desc_t* desc);
+void wgpu_surface_group_release(wgpu_surface_group_t* surface_group);
+
+/**
+ * @brief Creates the surface and the swap chain of a window, with the format
+ * and the present mode of the swap chain of the context. Returns the index of
+ * the surface.
+ */
+uint32_t
+wgpu_surface_group_add_surface(wgpu_surface_group_t* surface_group,
+                               void* window,
+                               const wgpu_surface_viewport_t* viewport);
+
+/* Recreates the swap chain of a surface with the new size of its window.
+ * Returns false when the size did not change. */
+bool wgpu_surface_group_resize_surface(wgpu_surface_group_t* surface_group,
+                                       uint32_t index, uint32_t width,
+                                       uint32_t height);
+
+/* Moves the viewport of a surface over the canvas */
+void wgpu_surface_group_set_viewport(wgpu_surface_group_t* surface_group,
+                                     uint32_t index,
+                                     const wgpu_surface_viewport_t* viewport);
+
+uint32_t
+wgpu_surface_group_get_surface_count(wgpu_surface_group_t* surface_group);
+wgpu_surface_group_surface_t*
+wgpu_surface_group_get_surface(wgpu_surface_group_t* surface_group,
+                               uint32_t index);
+
+/* Matrix from the clip space of the canvas to the clip space of a surface */
+void wgpu_surface_group_get_viewport_matrix(
+  wgpu_surface_group_t* surface_group, uint32_t index, mat4 dest);
+
+/* Acquires the current image of every surface, once per frame */
+void wgpu_surface_group_acquire(wgpu_surface_group_t* surface_group);
+
+/* Presents the images of all surfaces after the submit of the frame */
+void wgpu_surface_group_present(wgpu_surface_group_t* surface_group);
+
+#endif
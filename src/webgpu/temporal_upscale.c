@@ -0,0 +1,543 @@
+#include "temporal_upscale.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "shader.h"
+
+#define WGPU_TEMPORAL_UPSCALE_WORKGROUP_SIZE 8u
+/* Length of the jitter sequence without upscaling, it grows with the ratio of
+ * the output to the render pixel count up to the maximum */
+#define WGPU_TEMPORAL_UPSCALE_MIN_JITTER_PHASES 8u
+#define WGPU_TEMPORAL_UPSCALE_MAX_JITTER_PHASES 64u
+
+typedef struct temporal_upscale_params_t {
+  mat4 inv_view_projection;
+  mat4 prev_view_projection;
+  float jitter[2]; /* texture coordinates */
+  float render_size[2];
+  float output_size[2];
+  float feedback;
+  uint32_t motion_vectors;
+  uint32_t history_valid;
+  uint32_t padding[3];
+} temporal_upscale_params_t;
+
+struct wgpu_temporal_upscale {
+  wgpu_context_t* wgpu_context;
+  wgpu_temporal_upscale_desc_t desc;
+  wgpu_buffer_t params_buffer;
+  WGPUSampler sampler;
+  /* Bound instead of the motion vectors when there are none */
+  WGPUTexture dummy_motion_texture;
+  WGPUTextureView dummy_motion_view;
+  WGPUComputePipeline resolve_pipeline;
+  WGPURenderPipeline present_pipeline;
+  /* Ping-pong history, the resolve reads one and writes the other */
+  WGPUTexture history_textures[2];
+  WGPUTextureView history_views[2];
+  WGPUBindGroup present_bind_groups[2];
+  uint32_t current; /* history texture written last */
+  bool history_valid;
+  uint32_t jitter_index;
+  vec2 jitter_uv;
+  mat4 prev_view_projection;
+};
+
+// clang-format off
+static const char* temporal_upscale_resolve_shader_wgsl = CODE(
+  struct Params {
+    invViewProjection : mat4x4<f32>,
+    prevViewProjection : mat4x4<f32>,
+    jitter : vec2<f32>,
+    renderSize : vec2<f32>,
+    outputSize : vec2<f32>,
+    feedback : f32,
+    motionVectors : u32,
+    historyValid : u32,
+  };
+
+  @group(0) @binding(0) var<uniform> params : Params;
+  @group(0) @binding(1) var colorTexture : texture_2d<f32>;
+  @group(0) @binding(2) var depthTexture : texture_depth_2d;
+  @group(0) @binding(3) var motionTexture : texture_2d<f32>;
+  @group(0) @binding(4) var historyTexture : texture_2d<f32>;
+  @group(0) @binding(5) var linearSampler : sampler;
+  @group(0) @binding(6) var outputTexture
+    : texture_storage_2d<rgba16float, write>;
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let pos = vec2<i32>(id.xy);
+    if (any(vec2<f32>(pos) >= params.outputSize)) {
+      return;
+    }
+    let uv = (vec2<f32>(pos) + vec2<f32>(0.5)) / params.outputSize;
+
+    // Current frame at the unjittered position, the scene covers the top left
+    // renderSize texels of the color texture
+    let sampleUv = uv + params.jitter;
+    let colorSize = vec2<f32>(textureDimensions(colorTexture));
+    let toColor = params.renderSize / colorSize;
+    let current = textureSampleLevel(colorTexture, linearSampler,
+                                     sampleUv * toColor, 0.0).rgb;
+
+    // Color range and nearest surface of the 3x3 neighborhood
+    let maxTexel = vec2<i32>(params.renderSize) - vec2<i32>(1);
+    let texel = clamp(vec2<i32>(sampleUv * params.renderSize), vec2<i32>(0),
+                      maxTexel);
+    var minColor = current;
+    var maxColor = current;
+    var closestDepth = 1.0;
+    var closestTexel = texel;
+    for (var y = -1; y <= 1; y = y + 1) {
+      for (var x = -1; x <= 1; x = x + 1) {
+        let t = clamp(texel + vec2<i32>(x, y), vec2<i32>(0), maxTexel);
+        let c = textureLoad(colorTexture, t, 0).rgb;
+        minColor = min(minColor, c);
+        maxColor = max(maxColor, c);
+        let depth = textureLoad(depthTexture, t, 0);
+        if (depth < closestDepth) {
+          closestDepth = depth;
+          closestTexel = t;
+        }
+      }
+    }
+
+    // Position of the surface in the previous frame
+    var prevUv : vec2<f32>;
+    if (params.motionVectors != 0u) {
+      prevUv = uv - textureLoad(motionTexture, closestTexel, 0).xy;
+    } else {
+      let ndc = vec4<f32>(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, closestDepth,
+                          1.0);
+      let world = params.invViewProjection * ndc;
+      let prevClip = params.prevViewProjection
+                     * vec4<f32>(world.xyz / world.w, 1.0);
+      let prevNdc = prevClip.xy / prevClip.w;
+      prevUv = vec2<f32>(prevNdc.x * 0.5 + 0.5, 0.5 - prevNdc.y * 0.5);
+    }
+
+    var feedback = params.feedback;
+    if (params.historyValid == 0u || any(prevUv < vec2<f32>(0.0))
+        || any(prevUv > vec2<f32>(1.0))) {
+      feedback = 0.0;
+    }
+    let history = clamp(textureSampleLevel(historyTexture, linearSampler,
+                                           prevUv, 0.0).rgb,
+                        minColor, maxColor);
+    textureStore(outputTexture, pos,
+                 vec4<f32>(mix(current, history, feedback), 1.0));
+  }
+);
+
+static const char* temporal_upscale_present_shader_wgsl = CODE(
+  @group(0) @binding(0) var outputTexture : texture_2d<f32>;
+
+  @vertex
+  fn vs_main(@builtin(vertex_index) index : u32)
+    -> @builtin(position) vec4<f32> {
+    let uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+    return vec4<f32>(uv * 2.0 - vec2<f32>(1.0), 0.0, 1.0);
+  }
+
+  @fragment
+  fn fs_main(@builtin(position) coord : vec4<f32>) -> @location(0) vec4<f32> {
+    let pixel = vec2<i32>(floor(coord.xy));
+    return vec4<f32>(textureLoad(outputTexture, pixel, 0).rgb, 1.0);
+  }
+);
+// clang-format on
+
+static float temporal_upscale_halton(uint32_t index, uint32_t base)
+{
+  float f = 1.0f, result = 0.0f;
+  while (index > 0) {
+    f /= (float)base;
+    result += f * (float)(index % base);
+    index /= base;
+  }
+  return result;
+}
+
+static void
+temporal_upscale_create_pipelines(wgpu_temporal_upscale_t* temporal_upscale)
+{
+  wgpu_context_t* wgpu_context = temporal_upscale->wgpu_context;
+
+  // Resolve, the default layout matches the bindings
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "temporal_upscale_resolve_shader",
+                    .wgsl_code.source = temporal_upscale_resolve_shader_wgsl,
+                    .entry            = "main",
+                  });
+  temporal_upscale->resolve_pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "temporal_upscale_resolve_pipeline",
+      .layout  = NULL,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(temporal_upscale->resolve_pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+
+  // Present, a full screen triangle
+  WGPUPrimitiveState primitive_state = {
+    .topology  = WGPUPrimitiveTopology_TriangleList,
+    .frontFace = WGPUFrontFace_CCW,
+    .cullMode  = WGPUCullMode_None,
+  };
+
+  WGPUBlendState blend_state              = wgpu_create_blend_state(false);
+  WGPUColorTargetState color_target_state = (WGPUColorTargetState){
+    .format    = wgpu_context->swap_chain.format,
+    .blend     = &blend_state,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "temporal_upscale_present_shader",
+                  .wgsl_code.source = temporal_upscale_present_shader_wgsl,
+                  .entry            = "vs_main",
+                },
+                .buffer_count = 0,
+                .buffers      = NULL,
+              });
+
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+                wgpu_context, &(wgpu_fragment_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Fragment shader WGSL
+                  .label            = "temporal_upscale_present_shader",
+                  .wgsl_code.source = temporal_upscale_present_shader_wgsl,
+                  .entry            = "fs_main",
+                },
+                .target_count = 1,
+                .targets      = &color_target_state,
+              });
+
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  temporal_upscale->present_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label       = "temporal_upscale_present_pipeline",
+                            .layout      = NULL,
+                            .primitive   = primitive_state,
+                            .vertex      = vertex_state,
+                            .fragment    = &fragment_state,
+                            .multisample = multisample_state,
+                          });
+  ASSERT(temporal_upscale->present_pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+static void
+temporal_upscale_create_history(wgpu_temporal_upscale_t* temporal_upscale)
+{
+  wgpu_context_t* wgpu_context = temporal_upscale->wgpu_context;
+
+  WGPUBindGroupLayout present_bind_group_layout
+    = wgpuRenderPipelineGetBindGroupLayout(temporal_upscale->present_pipeline,
+                                           0);
+  for (uint32_t i = 0; i < 2; ++i) {
+    temporal_upscale->history_textures[i] = wgpuDeviceCreateTexture(
+      wgpu_context->device,
+      &(WGPUTextureDescriptor){
+        .label         = "temporal_upscale_history_texture",
+        .usage         = WGPUTextureUsage_StorageBinding
+                         | WGPUTextureUsage_TextureBinding,
+        .dimension     = WGPUTextureDimension_2D,
+        .size          = (WGPUExtent3D){temporal_upscale->desc.output_width,
+                                        temporal_upscale->desc.output_height,
+                                        1},
+        .format        = WGPUTextureFormat_RGBA16Float,
+        .mipLevelCount = 1,
+        .sampleCount   = 1,
+      });
+    ASSERT(temporal_upscale->history_textures[i] != NULL);
+
+    temporal_upscale->history_views[i] = wgpuTextureCreateView(
+      temporal_upscale->history_textures[i],
+      &(WGPUTextureViewDescriptor){
+        .label           = "temporal_upscale_history_view",
+        .format          = WGPUTextureFormat_RGBA16Float,
+        .dimension       = WGPUTextureViewDimension_2D,
+        .baseMipLevel    = 0,
+        .mipLevelCount   = 1,
+        .baseArrayLayer  = 0,
+        .arrayLayerCount = 1,
+        .aspect          = WGPUTextureAspect_All,
+      });
+    ASSERT(temporal_upscale->history_views[i] != NULL);
+
+    temporal_upscale->present_bind_groups[i] = wgpuDeviceCreateBindGroup(
+      wgpu_context->device,
+      &(WGPUBindGroupDescriptor){
+        .label      = "temporal_upscale_present_bind_group",
+        .layout     = present_bind_group_layout,
+        .entryCount = 1,
+        .entries    = &(WGPUBindGroupEntry){
+          .binding     = 0,
+          .textureView = temporal_upscale->history_views[i],
+        },
+      });
+    ASSERT(temporal_upscale->present_bind_groups[i] != NULL);
+  }
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, present_bind_group_layout);
+
+  temporal_upscale->current       = 0;
+  temporal_upscale->history_valid = false;
+}
+
+static void
+temporal_upscale_release_history(wgpu_temporal_upscale_t* temporal_upscale)
+{
+  for (uint32_t i = 0; i < 2; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, temporal_upscale->present_bind_groups[i]);
+    WGPU_RELEASE_RESOURCE(TextureView, temporal_upscale->history_views[i]);
+    WGPU_RELEASE_RESOURCE(Texture, temporal_upscale->history_textures[i]);
+  }
+}
+
+wgpu_temporal_upscale_t*
+wgpu_temporal_upscale_create(wgpu_context_t* wgpu_context,
+                             const wgpu_temporal_upscale_desc_t* desc)
+{
+  ASSERT(desc != NULL && desc->output_width > 0 && desc->output_height > 0);
+
+  wgpu_temporal_upscale_t* temporal_upscale
+    = (wgpu_temporal_upscale_t*)malloc(sizeof(wgpu_temporal_upscale_t));
+  memset(temporal_upscale, 0, sizeof(wgpu_temporal_upscale_t));
+  temporal_upscale->wgpu_context = wgpu_context;
+  temporal_upscale->desc         = *desc;
+  if (temporal_upscale->desc.feedback <= 0.0f) {
+    temporal_upscale->desc.feedback = 0.9f;
+  }
+  glm_mat4_identity(temporal_upscale->prev_view_projection);
+
+  temporal_upscale->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "temporal_upscale_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(temporal_upscale_params_t),
+                  });
+
+  temporal_upscale->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "temporal_upscale_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(temporal_upscale->sampler != NULL);
+
+  temporal_upscale->dummy_motion_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device, &(WGPUTextureDescriptor){
+                            .label = "temporal_upscale_dummy_motion_texture",
+                            .usage = WGPUTextureUsage_TextureBinding,
+                            .dimension     = WGPUTextureDimension_2D,
+                            .size          = (WGPUExtent3D){1, 1, 1},
+                            .format        = WGPUTextureFormat_RG16Float,
+                            .mipLevelCount = 1,
+                            .sampleCount   = 1,
+                          });
+  ASSERT(temporal_upscale->dummy_motion_texture != NULL);
+  temporal_upscale->dummy_motion_view
+    = wgpuTextureCreateView(temporal_upscale->dummy_motion_texture, NULL);
+  ASSERT(temporal_upscale->dummy_motion_view != NULL);
+
+  temporal_upscale_create_pipelines(temporal_upscale);
+  temporal_upscale_create_history(temporal_upscale);
+
+  return temporal_upscale;
+}
+
+void wgpu_temporal_upscale_release(wgpu_temporal_upscale_t* temporal_upscale)
+{
+  if (temporal_upscale == NULL) {
+    return;
+  }
+
+  temporal_upscale_release_history(temporal_upscale);
+  WGPU_RELEASE_RESOURCE(RenderPipeline, temporal_upscale->present_pipeline);
+  WGPU_RELEASE_RESOURCE(ComputePipeline, temporal_upscale->resolve_pipeline);
+  WGPU_RELEASE_RESOURCE(TextureView, temporal_upscale->dummy_motion_view);
+  WGPU_RELEASE_RESOURCE(Texture, temporal_upscale->dummy_motion_texture);
+  WGPU_RELEASE_RESOURCE(Sampler, temporal_upscale->sampler);
+  wgpu_destroy_buffer(&temporal_upscale->params_buffer);
+
+  free(temporal_upscale);
+}
+
+void wgpu_temporal_upscale_resize(wgpu_temporal_upscale_t* temporal_upscale,
+                                  uint32_t output_width,
+                                  uint32_t output_height)
+{
+  ASSERT(output_width > 0 && output_height > 0);
+
+  temporal_upscale_release_history(temporal_upscale);
+  temporal_upscale->desc.output_width  = output_width;
+  temporal_upscale->desc.output_height = output_height;
+  temporal_upscale_create_history(temporal_upscale);
+}
+
+void wgpu_temporal_upscale_reset(wgpu_temporal_upscale_t* temporal_upscale)
+{
+  temporal_upscale->history_valid = false;
+}
+
+void wgpu_temporal_upscale_next_jitter(
+  wgpu_temporal_upscale_t* temporal_upscale, uint32_t render_width,
+  uint32_t render_height, vec2 jitter)
+{
+  ASSERT(render_width > 0 && render_height > 0);
+
+  // A render pixel covers ratio output pixels, which all need samples
+  const float ratio
+    = ((float)temporal_upscale->desc.output_width
+       * (float)temporal_upscale->desc.output_height)
+      / ((float)render_width * (float)render_height);
+  const uint32_t phase_count = (uint32_t)CLAMP(
+    (float)WGPU_TEMPORAL_UPSCALE_MIN_JITTER_PHASES * ratio + 0.5f,
+    (float)WGPU_TEMPORAL_UPSCALE_MIN_JITTER_PHASES,
+    (float)WGPU_TEMPORAL_UPSCALE_MAX_JITTER_PHASES);
+  temporal_upscale->jitter_index
+    = (temporal_upscale->jitter_index % phase_count) + 1;
+
+  // Halton (2, 3) offset within the pixel, centered on 0
+  const float x
+    = temporal_upscale_halton(temporal_upscale->jitter_index, 2) - 0.5f;
+  const float y
+    = temporal_upscale_halton(temporal_upscale->jitter_index, 3) - 0.5f;
+  jitter[0] = 2.0f * x / (float)render_width;
+  jitter[1] = 2.0f * y / (float)render_height;
+
+  // The texture coordinate y axis points down
+  temporal_upscale->jitter_uv[0] = x / (float)render_width;
+  temporal_upscale->jitter_uv[1] = -y / (float)render_height;
+}
+
+void wgpu_temporal_upscale_resolve(
+  wgpu_temporal_upscale_t* temporal_upscale, WGPUComputePassEncoder pass,
+  const wgpu_temporal_upscale_frame_t* frame)
+{
+  ASSERT(frame->color_view != NULL && frame->depth_view != NULL);
+
+  wgpu_context_t* wgpu_context = temporal_upscale->wgpu_context;
+  const uint32_t src           = temporal_upscale->current;
+  const uint32_t dst           = 1 - src;
+
+  temporal_upscale_params_t params = {
+    .jitter      = {temporal_upscale->jitter_uv[0],
+                    temporal_upscale->jitter_uv[1]},
+    .render_size = {(float)frame->render_width, (float)frame->render_height},
+    .output_size = {(float)temporal_upscale->desc.output_width,
+                    (float)temporal_upscale->desc.output_height},
+    .feedback    = temporal_upscale->desc.feedback,
+    .motion_vectors = frame->motion_view != NULL ? 1u : 0u,
+    .history_valid  = temporal_upscale->history_valid ? 1u : 0u,
+  };
+  mat4 view_projection;
+  glm_mat4_copy((vec4*)frame->view_projection, view_projection);
+  glm_mat4_inv(view_projection, params.inv_view_projection);
+  glm_mat4_copy(temporal_upscale->prev_view_projection,
+                params.prev_view_projection);
+  wgpuQueueWriteBuffer(wgpu_context->queue,
+                       temporal_upscale->params_buffer.buffer, 0, &params,
+                       sizeof(params));
+
+  // The input views may change with every frame
+  WGPUBindGroupLayout bind_group_layout = wgpuComputePipelineGetBindGroupLayout(
+    temporal_upscale->resolve_pipeline, 0);
+  WGPUBindGroupEntry bg_entries[7] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding = 0,
+      .buffer  = temporal_upscale->params_buffer.buffer,
+      .size    = temporal_upscale->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = frame->color_view,
+    },
+    [2] = (WGPUBindGroupEntry) {
+      .binding     = 2,
+      .textureView = frame->depth_view,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      .binding     = 3,
+      .textureView = frame->motion_view != NULL ?
+                       frame->motion_view :
+                       temporal_upscale->dummy_motion_view,
+    },
+    [4] = (WGPUBindGroupEntry) {
+      .binding     = 4,
+      .textureView = temporal_upscale->history_views[src],
+    },
+    [5] = (WGPUBindGroupEntry) {
+      .binding = 5,
+      .sampler = temporal_upscale->sampler,
+    },
+    [6] = (WGPUBindGroupEntry) {
+      .binding     = 6,
+      .textureView = temporal_upscale->history_views[dst],
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "temporal_upscale_resolve_bind_group",
+                            .layout     = bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(bind_group != NULL);
+
+  const uint32_t group_size = WGPU_TEMPORAL_UPSCALE_WORKGROUP_SIZE;
+  wgpuComputePassEncoderSetPipeline(pass, temporal_upscale->resolve_pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass, (temporal_upscale->desc.output_width + group_size - 1) / group_size,
+    (temporal_upscale->desc.output_height + group_size - 1) / group_size, 1);
+  // The pass encoder keeps its own references on the bound resources
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group);
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout);
+
+  glm_mat4_copy(view_projection, temporal_upscale->prev_view_projection);
+  temporal_upscale->current       = dst;
+  temporal_upscale->history_valid = true;
+}
+
+void wgpu_temporal_upscale_present(wgpu_temporal_upscale_t* temporal_upscale,
+                                   WGPURenderPassEncoder pass)
+{
+  wgpuRenderPassEncoderSetPipeline(pass, temporal_upscale->present_pipeline);
+  wgpuRenderPassEncoderSetBindGroup(
+    pass, 0, temporal_upscale->present_bind_groups[temporal_upscale->current],
+    0, NULL);
+  wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+}
+
+WGPUTextureView wgpu_temporal_upscale_get_output_view(
+  wgpu_temporal_upscale_t* temporal_upscale)
+{
+  return temporal_upscale->history_views[temporal_upscale->current];
+}
@@ -0,0 +1,83 @@
+#ifndef TEMPORAL_UPSCALE_H
+#define TEMPORAL_UPSCALE_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+typedef struct wgpu_temporal_upscale wgpu_temporal_upscale_t;
+
+typedef struct wgpu_temporal_upscale_desc_t {
+  /* Display resolution of the output */
+  uint32_t output_width;
+  uint32_t output_height;
+  /* Weight of the history in the output, 0 selects 0.9 */
+  float feedback;
+} wgpu_temporal_upscale_desc_t;
+
+typedef struct wgpu_temporal_upscale_frame_t {
+  /* Lit scene, filterable float format, rendered into the top left region of
+   * render_width x render_height texels with the jitter of
+   * wgpu_temporal_upscale_next_jitter */
+  WGPUTextureView color_view;
+  /* Depth buffer of the scene, depth aspect only, no reversed z */
+  WGPUTextureView depth_view;
+  /* Optional rg16float motion vectors, current minus previous texture
+   * coordinates. NULL reprojects the depth of static scenes with the
+   * view projection matrices of this and the previous frame. */
+  WGPUTextureView motion_view;
+  uint32_t render_width;
+  uint32_t render_height;
+  /* View projection matrix without the jitter */
+  mat4 view_projection;
+} wgpu_temporal_upscale_frame_t;
+
+/*
+ * Temporal upscaling and anti-aliasing. The scene is rendered with a
+ * different sub-pixel offset of the projection every frame, resolving
+ * accumulates these samples in a history at the display resolution:
+ * - the history is reprojected with the motion vectors or the depth of the
+ *   nearest surface in the 3x3 neighborhood, which keeps edges in place,
+ * - it is clamped to the color range of the 3x3 neighborhood of the current
+ *   frame, which rejects disoccluded and changed surfaces (ghosting),
+ * - and blended with the current frame, sampled at the unjittered position.
+ * The render resolution can be lower than the output resolution and change
+ * with every frame, e.g. with dynamic resolution, the jitter sequence grows
+ * with the upscaling ratio so that every output pixel gets covered.
+ * @ref Karis: High Quality Temporal Supersampling, SIGGRAPH 2014
+ */
+wgpu_temporal_upscale_t*
+wgpu_temporal_upscale_create(wgpu_context_t* wgpu_context,
+                             const wgpu_temporal_upscale_desc_t* desc);
+void wgpu_temporal_upscale_release(wgpu_temporal_upscale_t* temporal_upscale);
+
+/* Recreates the history at a new output resolution, which drops it */
+void wgpu_temporal_upscale_resize(wgpu_temporal_upscale_t* temporal_upscale,
+                                  uint32_t output_width,
+                                  uint32_t output_height);
+/* Drops the history, after camera cuts or when the upscaling was off */
+void wgpu_temporal_upscale_reset(wgpu_temporal_upscale_t* temporal_upscale);
+
+/*
+ * Advances the jitter sequence and returns the offset of the projection of
+ * the next frame in normalized device coordinates, to be applied with
+ * projection_matrix_apply_jitter or camera_set_jitter.
+ */
+void wgpu_temporal_upscale_next_jitter(
+  wgpu_temporal_upscale_t* temporal_upscale, uint32_t render_width,
+  uint32_t render_height, vec2 jitter);
+
+/* Records the resolve of a frame into the next history texture */
+void wgpu_temporal_upscale_resolve(
+  wgpu_temporal_upscale_t* temporal_upscale, WGPUComputePassEncoder pass,
+  const wgpu_temporal_upscale_frame_t* frame);
+
+/* Draws the last resolved frame in a render pass of the swap chain format */
+void wgpu_temporal_upscale_present(wgpu_temporal_upscale_t* temporal_upscale,
+                                   WGPURenderPassEncoder pass);
+
+/* rgba16float view of the last resolved frame at the output resolution */
+WGPUTextureView wgpu_temporal_upscale_get_output_view(
+  wgpu_temporal_upscale_t* temporal_upscale);
+
+#endif
@@ -1,12 +1,16 @@
 #include "text_overlay.h"
 
+#include <math.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <cglm/cglm.h>
 
+#include "../core/job_system.h"
 #include "../core/macro.h"
 #include "buffer.h"
+#include "render_bundle_cache.h"
 #include "shader.h"
 
 // https://nothings.org/stb/font/
@@ -14,15 +18,84 @@
 #include <stb_font_consolas_24_latin1.h>
 
 /* Max. number of chars the text overlay buffer can hold */
-#define TEXTOVERLAY_MAX_CHAR_COUNT 2048
+#define TEXTOVERLAY_MAX_CHAR_COUNT 16384
+/* Laid-out runs cached by the hash of their text, a power of two */
+#define TEXTOVERLAY_RUN_CACHE_SIZE 1024u
+#define TEXTOVERLAY_RUN_CACHE_PROBE_COUNT 8u
+#define TEXTOVERLAY_RUN_GLYPH_COUNT 32768u
+/* Pixel size of the font the atlas is generated from, and the default text
+ * size */
+#define TEXTOVERLAY_FONT_PIXEL_SIZE 24.0f
+#define TEXTOVERLAY_DEFAULT_TEXT_SIZE 18.0f
+/* Distance range of the signed distance field atlas around the glyph edges,
+ * in texels */
+#define TEXTOVERLAY_SDF_SPREAD 4u
+#define TEXTOVERLAY_SDF_ATLAS_WIDTH 512u
+#define TEXTOVERLAY_SDF_FAR 1e20f
 
 /**
- * @brief Text vertex class
+ * @brief Glyph instance, one quad per character
  */
-typedef struct text_vertex_t {
-  vec2 position;
-  vec2 uv;
-} text_vertex_t;
+typedef struct text_glyph_instance_t {
+  vec2 position;  /* Pen position in pixels */
+  uint32_t glyph; /* Index into the glyph metrics */
+  uint32_t color; /* RGBA8 */
+  float scale;    /* Text size relative to the font size */
+} text_glyph_instance_t;
+
+/**
+ * @brief Glyph metrics, stored in a storage buffer read by the vertex shader
+ */
+typedef struct text_glyph_metrics_t {
+  vec4 rect; /* Quad corners relative to the pen position, in font pixels */
+  vec4 uv;   /* Quad corners in the font texture */
+} text_glyph_metrics_t;
+
+/* Layout uniforms */
+typedef struct text_overlay_uniforms_t {
+  vec2 viewport;
+  float y_scale;
+  float padding;
+} text_overlay_uniforms_t;
+
+/**
+ * @brief Glyph of a laid-out run
+ */
+typedef struct text_run_glyph_t {
+  float offset; /* Pen offset from the start of the run, in font pixels */
+  uint32_t glyph;
+} text_run_glyph_t;
+
+/**
+ * @brief Laid-out run of a text, the glyphs are stored in the glyph pool
+ */
+typedef struct text_run_t {
+  uint64_t hash;
+  uint32_t length;
+  uint32_t first_glyph;
+  float width;
+  bool valid;
+} text_run_t;
+
+/**
+ * @brief Signed distance field atlas under construction, every glyph of the
+ * font bitmap gets its own cell with room for the distance spread
+ */
+typedef struct text_sdf_atlas_t {
+  const uint8_t* bitmap; /* Coverage of the square font bitmap */
+  uint32_t bitmap_width;
+  uint8_t* pixels;
+  uint32_t width;
+  uint32_t height;
+  struct {
+    int32_t src_x;   /* Glyph rectangle in the bitmap */
+    int32_t src_y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t x;      /* Cell in the atlas */
+    uint32_t y;
+  } cells[STB_FONT_consolas_24_latin1_NUM_CHARS];
+} text_sdf_atlas_t;
 
 /**
  * @brief Text overlay class
@@ -31,13 +104,16 @@ typedef struct text_overlay {
   wgpu_context_t* wgpu_context;
   WGPURenderPipeline pipeline;
   WGPUPipelineLayout pipeline_layout;
-  wgpu_buffer_t vertex_buffer;
+  wgpu_buffer_t instance_buffer;
+  wgpu_buffer_t glyph_buffer;
+  wgpu_buffer_t uniform_buffer;
   WGPUBindGroup bind_group;
   WGPUBindGroupLayout bind_group_layout;
   struct {
     WGPUTexture texture;
     WGPUTextureView texture_view;
     WGPUSampler sampler;
+    vec4 glyph_uvs[STB_FONT_consolas_24_latin1_NUM_CHARS];
   } font;
   struct {
     WGPUTextureFormat format;
@@ -47,16 +123,84 @@ typedef struct text_overlay {
     WGPURenderPassDescriptor render_pass_descriptor;
   } render_pass;
   struct {
-    struct {
-      text_vertex_t data[TEXTOVERLAY_MAX_CHAR_COUNT * 4];
-      size_t size;
-    } vertex;
+    text_glyph_instance_t data[TEXTOVERLAY_MAX_CHAR_COUNT];
+    size_t size;
   } draw_buffer;
+  /* Hash of the instances added since the last update, and of the instances
+   * in the instance buffer */
+  struct {
+    uint64_t current;
+    uint64_t uploaded;
+    uint32_t uploaded_count;
+    text_overlay_uniforms_t uniforms;
+  } draw_state;
+  struct {
+    text_run_t runs[TEXTOVERLAY_RUN_CACHE_SIZE];
+    text_run_glyph_t glyphs[TEXTOVERLAY_RUN_GLYPH_COUNT];
+    uint32_t glyph_count;
+  } run_cache;
   stb_fontchar stb_font_data[STB_FONT_consolas_24_latin1_NUM_CHARS];
   uint32_t num_letters;
+  uint32_t text_color; /* RGBA8 */
+  float text_size;     /* Pixels */
   bool flip_y; /* false: Y-axis up / true: Y-axis down */
 } text_overlay;
 
+// clang-format off
+static const char* text_overlay_shader_wgsl = CODE(
+  struct TextUniforms {
+    viewport : vec2<f32>,
+    yScale : f32,
+    padding : f32,
+  };
+
+  struct GlyphMetrics {
+    rect : vec4<f32>,
+    uv : vec4<f32>,
+  };
+
+  @group(0) @binding(0) var fontTexture : texture_2d<f32>;
+  @group(0) @binding(1) var fontSampler : sampler;
+  @group(0) @binding(2) var<storage, read> glyphs : array<GlyphMetrics>;
+  @group(0) @binding(3) var<uniform> uniforms : TextUniforms;
+
+  struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) uv : vec2<f32>,
+    @location(1) color : vec4<f32>,
+  };
+
+  @vertex
+  fn vs_main(@builtin(vertex_index) vertexIndex : u32,
+             @location(0) pen : vec2<f32>,
+             @location(1) glyph : u32,
+             @location(2) color : vec4<f32>,
+             @location(3) scale : f32) -> VertexOutput {
+    // Triangle strip over the corners of the glyph quad
+    let corner = vec2<f32>(f32(vertexIndex & 1u), f32(vertexIndex >> 1u));
+    let metrics = glyphs[glyph];
+    let pixel = pen + mix(metrics.rect.xy, metrics.rect.zw, corner) * scale;
+    let ndc = vec2<f32>(pixel.x / uniforms.viewport.x * 2.0 - 1.0,
+                        1.0 - pixel.y / uniforms.viewport.y * 2.0);
+    var output : VertexOutput;
+    output.position = vec4<f32>(ndc.x, ndc.y * uniforms.yScale, 0.0, 1.0);
+    output.uv = mix(metrics.uv.xy, metrics.uv.zw, corner);
+    output.color = color;
+    return output;
+  }
+
+  // Alpha from the signed distance in the red channel of the font texture,
+  // 0.5 on the glyph edge, antialiased over a pixel at any text size
+  @fragment
+  fn fs_main(input : VertexOutput) -> @location(0) vec4<f32> {
+    let field = textureSample(fontTexture, fontSampler, input.uv).r;
+    let edgeWidth = max(fwidth(field), 0.0001) * 0.5;
+    let alpha = smoothstep(0.5 - edgeWidth, 0.5 + edgeWidth, field);
+    return input.color * alpha;
+  }
+);
+// clang-format on
+
 static void text_overlay_init(text_overlay_t* text_overlay,
                               wgpu_context_t* wgpu_context)
 {
@@ -64,33 +208,253 @@ static void text_overlay_init(text_overlay_t* text_overlay,
   text_overlay->color.format         = wgpu_context->swap_chain.format;
   text_overlay->depth_stencil.format = WGPUTextureFormat_Depth24PlusStencil8;
   text_overlay->flip_y               = false;
+  text_overlay->text_color           = 0xffffffffu;
+  text_overlay->text_size            = TEXTOVERLAY_DEFAULT_TEXT_SIZE;
 }
 
-static void text_overlay_create_vertex_buffer(text_overlay_t* text_overlay)
+static void text_overlay_create_buffers(text_overlay_t* text_overlay)
 {
-  text_overlay->draw_buffer.vertex.size
-    = sizeof(text_overlay->draw_buffer.vertex.data);
+  text_overlay->draw_buffer.size = sizeof(text_overlay->draw_buffer.data);
 
-  text_overlay->vertex_buffer = wgpu_create_buffer(
+  text_overlay->instance_buffer = wgpu_create_buffer(
     text_overlay->wgpu_context,
     &(wgpu_buffer_desc_t){
-      .label = "text-overlay-vertex-buffer",
+      .label = "text-overlay-instance-buffer",
       .usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
-      .size  = text_overlay->draw_buffer.vertex.size,
+      .size  = text_overlay->draw_buffer.size,
     });
+
+  text_overlay->uniform_buffer = wgpu_create_buffer(
+    text_overlay->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "text-overlay-uniform-buffer",
+      .usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst,
+      .size  = sizeof(text_overlay_uniforms_t),
+    });
+}
+
+/* Glyph metrics table, from the font data and the atlas cells filled with the
+ * font texture */
+static void text_overlay_create_glyph_buffer(text_overlay_t* text_overlay)
+{
+  static text_glyph_metrics_t
+    glyph_metrics[STB_FONT_consolas_24_latin1_NUM_CHARS];
+  for (uint32_t i = 0; i < STB_FONT_consolas_24_latin1_NUM_CHARS; ++i) {
+    const stb_fontchar* char_data = &text_overlay->stb_font_data[i];
+    const float spread            = (float)TEXTOVERLAY_SDF_SPREAD;
+    glyph_metrics[i]              = (text_glyph_metrics_t){
+      .rect = {char_data->x0 - spread, char_data->y0 - spread,
+               char_data->x1 + spread, char_data->y1 + spread},
+    };
+    glm_vec4_copy(text_overlay->font.glyph_uvs[i], glyph_metrics[i].uv);
+  }
+
+  text_overlay->glyph_buffer = wgpu_create_buffer(
+    text_overlay->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "text-overlay-glyph-buffer",
+      .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+      .size  = sizeof(glyph_metrics),
+      .initial = {
+        .data = glyph_metrics,
+        .size = sizeof(glyph_metrics),
+      },
+    });
+}
+
+/**
+ * @brief Euclidean distance transform of a line of squared distances, after
+ * Felzenszwalb and Huttenlocher
+ * @see https://cs.brown.edu/people/pfelzens/papers/dt-final.pdf
+ */
+static void text_sdf_transform_line(float* f, uint32_t n, uint32_t stride,
+                                    float* d, int32_t* v, float* z)
+{
+  int32_t k = 0;
+  v[0]      = 0;
+  z[0]      = -TEXTOVERLAY_SDF_FAR;
+  z[1]      = TEXTOVERLAY_SDF_FAR;
+  // Lower envelope of the parabolas rooted at the samples, z[0] is below any
+  // intersection since the distances stay below TEXTOVERLAY_SDF_FAR
+  for (int32_t q = 1; q < (int32_t)n; ++q) {
+    float s = 0.0f;
+    while (true) {
+      const int32_t r = v[k];
+      s = ((f[q * stride] + (float)(q * q)) - (f[r * stride] + (float)(r * r)))
+          / (float)(2 * q - 2 * r);
+      if (s > z[k]) {
+        break;
+      }
+      --k;
+    }
+    ++k;
+    v[k]     = q;
+    z[k]     = s;
+    z[k + 1] = TEXTOVERLAY_SDF_FAR;
+  }
+  k = 0;
+  for (int32_t q = 0; q < (int32_t)n; ++q) {
+    while (z[k + 1] < (float)q) {
+      ++k;
+    }
+    const float dq = (float)(q - v[k]);
+    d[q]           = dq * dq + f[v[k] * stride];
+  }
+  for (uint32_t q = 0; q < n; ++q) {
+    f[q * stride] = d[q];
+  }
+}
+
+/* Squared distances to the nearest zero of a grid, in place */
+static void text_sdf_transform(float* grid, uint32_t width, uint32_t height,
+                               float* d, int32_t* v, float* z)
+{
+  for (uint32_t x = 0; x < width; ++x) {
+    text_sdf_transform_line(&grid[x], height, width, d, v, z);
+  }
+  for (uint32_t y = 0; y < height; ++y) {
+    text_sdf_transform_line(&grid[y * width], width, 1, d, v, z);
+  }
+}
+
+/**
+ * @brief Builds the distance fields of a range of glyphs from their coverage
+ * in the font bitmap, every glyph writes its own cell of the atlas.
+ */
+static void text_sdf_build_glyphs(void* user_data, uint32_t begin,
+                                  uint32_t end)
+{
+  text_sdf_atlas_t* atlas = user_data;
+  const int32_t spread    = (int32_t)TEXTOVERLAY_SDF_SPREAD;
+
+  for (uint32_t i = begin; i < end; ++i) {
+    const uint32_t w = atlas->cells[i].width + 2 * spread;
+    const uint32_t h = atlas->cells[i].height + 2 * spread;
+    const uint32_t n = w * h;
+    const uint32_t m = MAX(w, h);
+
+    float* coverage    = malloc(n * sizeof(float));
+    float* to_inside   = malloc(n * sizeof(float));
+    float* to_outside  = malloc(n * sizeof(float));
+    float* line        = malloc(m * sizeof(float));
+    float* parabolas_z = malloc((m + 1) * sizeof(float));
+    int32_t* parabolas = malloc(m * sizeof(int32_t));
+
+    for (uint32_t y = 0; y < h; ++y) {
+      for (uint32_t x = 0; x < w; ++x) {
+        const int32_t sx = atlas->cells[i].src_x + (int32_t)x - spread;
+        const int32_t sy = atlas->cells[i].src_y + (int32_t)y - spread;
+        const bool in_bitmap = sx >= 0 && sy >= 0
+                               && sx < (int32_t)atlas->bitmap_width
+                               && sy < (int32_t)atlas->bitmap_width;
+        const float c
+          = in_bitmap ?
+              atlas->bitmap[sy * atlas->bitmap_width + sx] / 255.0f :
+              0.0f;
+        coverage[y * w + x]   = c;
+        to_inside[y * w + x]  = c >= 0.5f ? 0.0f : TEXTOVERLAY_SDF_FAR;
+        to_outside[y * w + x] = c >= 0.5f ? TEXTOVERLAY_SDF_FAR : 0.0f;
+      }
+    }
+    text_sdf_transform(to_inside, w, h, line, parabolas, parabolas_z);
+    text_sdf_transform(to_outside, w, h, line, parabolas, parabolas_z);
+
+    // Distances to the edge between the texel centers, positive outside. The
+    // partially covered texels take the distance from their coverage.
+    for (uint32_t y = 0; y < h; ++y) {
+      uint8_t* row
+        = &atlas->pixels[(atlas->cells[i].y + y) * atlas->width
+                         + atlas->cells[i].x];
+      for (uint32_t x = 0; x < w; ++x) {
+        const float c = coverage[y * w + x];
+        float dist    = c >= 0.5f ? 0.5f - sqrtf(to_outside[y * w + x]) :
+                                    sqrtf(to_inside[y * w + x]) - 0.5f;
+        if (c > 0.0f && c < 1.0f) {
+          dist = 0.5f - c;
+        }
+        const float value = 0.5f - dist / (2.0f * TEXTOVERLAY_SDF_SPREAD);
+        row[x] = (uint8_t)(CLAMP(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+      }
+    }
+
+    free(coverage);
+    free(to_inside);
+    free(to_outside);
+    free(line);
+    free(parabolas_z);
+    free(parabolas);
+  }
+}
+
+/**
+ * @brief Places the glyphs of the font bitmap into rows of atlas cells, with
+ * room for the distance spread around every glyph.
+ */
+static void text_sdf_pack_atlas(text_overlay_t* text_overlay,
+                                text_sdf_atlas_t* atlas)
+{
+  const uint32_t spread = TEXTOVERLAY_SDF_SPREAD;
+  const float font_size = (float)atlas->bitmap_width;
+
+  uint32_t x = 0, y = 0, row_height = 0;
+  for (uint32_t i = 0; i < STB_FONT_consolas_24_latin1_NUM_CHARS; ++i) {
+    const stb_fontchar* char_data = &text_overlay->stb_font_data[i];
+    atlas->cells[i].src_x         = (int32_t)(char_data->s0 * font_size + 0.5f);
+    atlas->cells[i].src_y         = (int32_t)(char_data->t0 * font_size + 0.5f);
+    atlas->cells[i].width         = (uint32_t)(char_data->x1 - char_data->x0);
+    atlas->cells[i].height        = (uint32_t)(char_data->y1 - char_data->y0);
+
+    const uint32_t cell_width  = atlas->cells[i].width + 2 * spread;
+    const uint32_t cell_height = atlas->cells[i].height + 2 * spread;
+    if (x + cell_width > TEXTOVERLAY_SDF_ATLAS_WIDTH) {
+      x          = 0;
+      y          = y + row_height;
+      row_height = 0;
+    }
+    atlas->cells[i].x = x;
+    atlas->cells[i].y = y;
+    x += cell_width;
+    row_height = MAX(row_height, cell_height);
+  }
+  atlas->width  = TEXTOVERLAY_SDF_ATLAS_WIDTH;
+  atlas->height = y + row_height;
+
+  // Texture coordinates of the cells, their quads cover the spread as well
+  for (uint32_t i = 0; i < STB_FONT_consolas_24_latin1_NUM_CHARS; ++i) {
+    const float w = (float)atlas->width, h = (float)atlas->height;
+    glm_vec4_copy(
+      (vec4){
+        atlas->cells[i].x / w,
+        atlas->cells[i].y / h,
+        (atlas->cells[i].x + atlas->cells[i].width + 2 * spread) / w,
+        (atlas->cells[i].y + atlas->cells[i].height + 2 * spread) / h,
+      },
+      text_overlay->font.glyph_uvs[i]);
+  }
 }
 
+/* The font bitmap is turned into a signed distance field atlas on the job
+ * system, the atlas serves all text sizes */
 static void text_overlay_create_fonts_texture(text_overlay_t* text_overlay)
 {
   wgpu_context_t* wgpu_context = text_overlay->wgpu_context;
 
-  const uint32_t font_width  = STB_FONT_consolas_24_latin1_BITMAP_WIDTH;
-  const uint32_t font_height = STB_FONT_consolas_24_latin1_BITMAP_WIDTH;
-
   static unsigned char font24pixels[STB_FONT_consolas_24_latin1_BITMAP_WIDTH]
                                    [STB_FONT_consolas_24_latin1_BITMAP_WIDTH];
   stb_font_consolas_24_latin1(text_overlay->stb_font_data, font24pixels,
-                              font_height);
+                              STB_FONT_consolas_24_latin1_BITMAP_WIDTH);
+
+  static text_sdf_atlas_t atlas = {0};
+  atlas.bitmap                  = &font24pixels[0][0];
+  atlas.bitmap_width            = STB_FONT_consolas_24_latin1_BITMAP_WIDTH;
+  text_sdf_pack_atlas(text_overlay, &atlas);
+  atlas.pixels = calloc((size_t)atlas.width * atlas.height, 1);
+  job_system_parallel_for(job_system_get_shared(),
+                          STB_FONT_consolas_24_latin1_NUM_CHARS, 8,
+                          text_sdf_build_glyphs, &atlas);
+
+  const uint32_t font_width  = atlas.width;
+  const uint32_t font_height = atlas.height;
   /* Size of the font texture is WIDTH * HEIGHT * 1 byte (only one channel) */
   size_t bytes_per_pixel   = 1;
   size_t font24pixels_size = font_width * font_height * bytes_per_pixel;
@@ -121,10 +485,12 @@ static void text_overlay_create_fonts_texture(text_overlay_t* text_overlay)
         .usage   = WGPUBufferUsage_CopySrc,
         .size    = font24pixels_size,
         .initial = {
-          .data  = font24pixels,
+          .data  = atlas.pixels,
           .size  = font24pixels_size,
         },
     });
+  free(atlas.pixels);
+  atlas.pixels = NULL;
 
   /* Copy buffer to texture */
   WGPUImageCopyBuffer buffer_copy_view    = {
@@ -197,7 +563,7 @@ static void text_overlay_setup_pipeline_layout(text_overlay_t* text_overlay)
   wgpu_context_t* wgpu_context = text_overlay->wgpu_context;
 
   // Bind group layout
-  WGPUBindGroupLayoutEntry bgl_entries[2] = {
+  WGPUBindGroupLayoutEntry bgl_entries[4] = {
     [0] = (WGPUBindGroupLayoutEntry) {
       // Binding 0: Texture view (Fragment shader)
       .binding = 0,
@@ -217,7 +583,27 @@ static void text_overlay_setup_pipeline_layout(text_overlay_t* text_overlay)
         .type=WGPUSamplerBindingType_Filtering,
       },
       .texture = {0},
-    }
+    },
+    [2] = (WGPUBindGroupLayoutEntry) {
+      // Binding 2: Glyph metrics (Vertex shader)
+      .binding = 2,
+      .visibility = WGPUShaderStage_Vertex,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_ReadOnlyStorage,
+        .minBindingSize = text_overlay->glyph_buffer.size,
+      },
+      .sampler = {0},
+    },
+    [3] = (WGPUBindGroupLayoutEntry) {
+      // Binding 3: Layout uniforms (Vertex shader)
+      .binding = 3,
+      .visibility = WGPUShaderStage_Vertex,
+      .buffer = (WGPUBufferBindingLayout) {
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = text_overlay->uniform_buffer.size,
+      },
+      .sampler = {0},
+    },
   };
   text_overlay->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
     wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
@@ -242,7 +628,7 @@ static void text_overlay_setup_bind_group(text_overlay_t* text_overlay)
   wgpu_context_t* wgpu_context = text_overlay->wgpu_context;
 
   // Bind Group
-  WGPUBindGroupEntry bg_entries[2] = {
+  WGPUBindGroupEntry bg_entries[4] = {
     [0] = (WGPUBindGroupEntry) {
       // Binding 0 : Fragment shader texture view
       .binding = 0,
@@ -253,6 +639,18 @@ static void text_overlay_setup_bind_group(text_overlay_t* text_overlay)
       .binding = 1,
       .sampler = text_overlay->font.sampler,
     },
+    [2] = (WGPUBindGroupEntry) {
+      // Binding 2: Vertex shader glyph metrics
+      .binding = 2,
+      .buffer  = text_overlay->glyph_buffer.buffer,
+      .size    = text_overlay->glyph_buffer.size,
+    },
+    [3] = (WGPUBindGroupEntry) {
+      // Binding 3: Vertex shader layout uniforms
+      .binding = 3,
+      .buffer  = text_overlay->uniform_buffer.buffer,
+      .size    = text_overlay->uniform_buffer.size,
+    },
   };
 
   text_overlay->bind_group = wgpuDeviceCreateBindGroup(
@@ -277,8 +675,7 @@ static void text_overlay_prepare_pipeline(text_overlay_t* text_overlay)
     .cullMode  = text_overlay->flip_y ? WGPUCullMode_Front : WGPUCullMode_Back,
   };
 
-  // Enable blending, using alpha from red channel of the font texture (see
-  // text.frag)
+  // Enable blending, using alpha from red channel of the font texture
   WGPUBlendState blend_state                   = wgpu_create_blend_state(true);
   WGPUColorTargetState color_target_state_desc = (WGPUColorTargetState){
     .format    = text_overlay->color.format,
@@ -293,33 +690,49 @@ static void text_overlay_prepare_pipeline(text_overlay_t* text_overlay)
       .depth_write_enabled = true,
     });
 
-  // Vertex buffer layout
-  WGPU_VERTEX_BUFFER_LAYOUT(
-    text_overlay, sizeof(text_vertex_t),
-    // Attribute location 0: Position
+  // Instance buffer layout, the quad corners come from the vertex index
+  WGPUVertexAttribute instance_attributes[4] = {
+    // Attribute location 0: Pen position
     WGPU_VERTATTR_DESC(0, WGPUVertexFormat_Float32x2,
-                       offsetof(text_vertex_t, position)),
-    // Attribute location 1: UV
-    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Float32x2,
-                       offsetof(text_vertex_t, uv)))
+                       offsetof(text_glyph_instance_t, position)),
+    // Attribute location 1: Glyph index
+    WGPU_VERTATTR_DESC(1, WGPUVertexFormat_Uint32,
+                       offsetof(text_glyph_instance_t, glyph)),
+    // Attribute location 2: Color
+    WGPU_VERTATTR_DESC(2, WGPUVertexFormat_Unorm8x4,
+                       offsetof(text_glyph_instance_t, color)),
+    // Attribute location 3: Scale
+    WGPU_VERTATTR_DESC(3, WGPUVertexFormat_Float32,
+                       offsetof(text_glyph_instance_t, scale)),
+  };
+  WGPUVertexBufferLayout instance_buffer_layout = {
+    .arrayStride    = sizeof(text_glyph_instance_t),
+    .stepMode       = WGPUVertexStepMode_Instance,
+    .attributeCount = (uint32_t)ARRAY_SIZE(instance_attributes),
+    .attributes     = instance_attributes,
+  };
 
   // Vertex state
   WGPUVertexState vertex_state_desc = wgpu_create_vertex_state(
         wgpu_context, &(wgpu_vertex_state_t){
         .shader_desc = (wgpu_shader_desc_t){
-          // Vertex shader SPIR-V
-          .file = "shaders/text_overlay/text.vert.spv",
+          // Vertex shader WGSL
+          .label            = "text_overlay_shader",
+          .wgsl_code.source = text_overlay_shader_wgsl,
+          .entry            = "vs_main",
         },
         .buffer_count = 1,
-        .buffers = &text_overlay_vertex_buffer_layout,
+        .buffers = &instance_buffer_layout,
       });
 
   // Fragment state
   WGPUFragmentState fragment_state_desc = wgpu_create_fragment_state(
         wgpu_context, &(wgpu_fragment_state_t){
         .shader_desc = (wgpu_shader_desc_t){
-          // Fragment shader SPIR-V
-          .file = "shaders/text_overlay/text.frag.spv",
+          // Fragment shader WGSL
+          .label            = "text_overlay_shader",
+          .wgsl_code.source = text_overlay_shader_wgsl,
+          .entry            = "fs_main",
         },
         .target_count = 1,
         .targets = &color_target_state_desc,
@@ -390,13 +803,14 @@ text_overlay_t* text_overlay_create(wgpu_context_t* wgpu_context)
 
   // Prepare ImGui overlay
   text_overlay_init(text_overlay, wgpu_context);
-  // Create the vertex buffer containing the text overloy vertices
-  text_overlay_create_vertex_buffer(text_overlay);
+  // Create the instance and uniform buffers of the text overlay
+  text_overlay_create_buffers(text_overlay);
+  // Create the fonts texture and the glyph metrics table
+  text_overlay_create_fonts_texture(text_overlay);
+  text_overlay_create_glyph_buffer(text_overlay);
   // Create the pipeline layout that is used to generate the rendering
   // pipelines
   text_overlay_setup_pipeline_layout(text_overlay);
-  // Create the fonts texture
-  text_overlay_create_fonts_texture(text_overlay);
   // Setup the bind group containing the texture bindings
   text_overlay_setup_bind_group(text_overlay);
   // Create the graphics pipeline
@@ -414,7 +828,9 @@ void text_overlay_release(text_overlay_t* text_overlay)
   WGPU_RELEASE_RESOURCE(BindGroup, text_overlay->bind_group);
   WGPU_RELEASE_RESOURCE(BindGroupLayout, text_overlay->bind_group_layout);
 
-  WGPU_RELEASE_RESOURCE(Buffer, text_overlay->vertex_buffer.buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, text_overlay->instance_buffer.buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, text_overlay->glyph_buffer.buffer);
+  WGPU_RELEASE_RESOURCE(Buffer, text_overlay->uniform_buffer.buffer);
   WGPU_RELEASE_RESOURCE(Texture, text_overlay->font.texture);
   WGPU_RELEASE_RESOURCE(TextureView, text_overlay->font.texture_view);
   WGPU_RELEASE_RESOURCE(Sampler, text_overlay->font.sampler);
@@ -424,84 +840,141 @@ void text_overlay_release(text_overlay_t* text_overlay)
 
 void text_overlay_begin_text_update(text_overlay_t* text_overlay)
 {
-  text_overlay->num_letters = 0;
+  text_overlay->num_letters        = 0;
+  text_overlay->draw_state.current = WGPU_RENDER_BUNDLE_HASH_SEED;
 }
 
-void text_overlay_add_text(text_overlay_t* text_overlay, const char* text,
-                           float x, float y, text_overlay_text_align_enum align)
+void text_overlay_set_color(text_overlay_t* text_overlay,
+                            const float color[4])
 {
-  const uint32_t first_char = STB_FONT_consolas_24_latin1_FIRST_CHAR;
-
-  wgpu_context_t* wgpu_context = text_overlay->wgpu_context;
+  uint32_t packed = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    const float c = CLAMP(color[i], 0.0f, 1.0f);
+    packed |= (uint32_t)(c * 255.0f + 0.5f) << (8 * i);
+  }
+  text_overlay->text_color = packed;
+}
 
-  const bool flip_y                  = text_overlay->flip_y;
-  const uint32_t frame_buffer_width  = wgpu_context->surface.width;
-  const uint32_t frame_buffer_height = wgpu_context->surface.height;
+void text_overlay_set_text_size(text_overlay_t* text_overlay, float size)
+{
+  text_overlay->text_size = size;
+}
 
-  const float charW = 1.5f / frame_buffer_width;
-  const float charH = 1.5f / frame_buffer_height;
+/**
+ * @brief Returns the laid-out run of a text from the run cache, the text is
+ * laid out on a cache miss. Returns NULL when the run does not fit into the
+ * glyph pool.
+ */
+static const text_run_t* text_overlay_get_run(text_overlay_t* text_overlay,
+                                              const char* text,
+                                              size_t text_length)
+{
+  const uint32_t first_char = STB_FONT_consolas_24_latin1_FIRST_CHAR;
+  const uint32_t num_chars  = STB_FONT_consolas_24_latin1_NUM_CHARS;
+
+  const uint64_t hash
+    = wgpu_render_bundle_hash(WGPU_RENDER_BUNDLE_HASH_SEED, text, text_length);
+  text_run_t* runs = text_overlay->run_cache.runs;
+  text_run_t* run  = NULL;
+  for (uint32_t i = 0; i < TEXTOVERLAY_RUN_CACHE_PROBE_COUNT; ++i) {
+    text_run_t* slot = &runs[(hash + i) & (TEXTOVERLAY_RUN_CACHE_SIZE - 1)];
+    if (!slot->valid) {
+      run = slot;
+      break;
+    }
+    if (slot->hash == hash && slot->length == text_length) {
+      return slot;
+    }
+  }
 
-  float fbW      = (float)frame_buffer_width;
-  float fbH      = (float)frame_buffer_height;
-  x              = (x / fbW * 2.0f) - 1.0f;
-  y              = flip_y ? (y / fbH * 2.0f) - 1.0f : 1.0f - (y / fbH * 2.0f);
-  float fbYScale = flip_y ? -1.0f : 1.0f;
+  if (text_length > TEXTOVERLAY_RUN_GLYPH_COUNT) {
+    return NULL;
+  }
+  // Start over when the probed slots or the glyph pool are full
+  if (run == NULL
+      || text_overlay->run_cache.glyph_count + text_length
+           > TEXTOVERLAY_RUN_GLYPH_COUNT) {
+    memset(runs, 0, sizeof(text_overlay->run_cache.runs));
+    text_overlay->run_cache.glyph_count = 0;
+    run = &runs[hash & (TEXTOVERLAY_RUN_CACHE_SIZE - 1)];
+  }
 
-  // Calculate text width
-  float textWidth    = 0.0f;
-  size_t text_length = strlen(text);
+  // Lay out the run, characters outside of the font map to the space
+  *run = (text_run_t){
+    .hash        = hash,
+    .length      = (uint32_t)text_length,
+    .first_glyph = text_overlay->run_cache.glyph_count,
+    .valid       = true,
+  };
+  text_run_glyph_t* glyphs = &text_overlay->run_cache.glyphs[run->first_glyph];
+  float offset             = 0.0f;
   for (size_t i = 0; i < text_length; ++i) {
-    stb_fontchar* charData
-      = &text_overlay->stb_font_data[(uint32_t)text[i] - first_char];
-    textWidth += charData->advance * charW;
+    const uint32_t c     = (uint32_t)(unsigned char)text[i];
+    const uint32_t glyph = c >= first_char && c - first_char < num_chars ?
+                             c - first_char :
+                             0;
+    glyphs[i] = (text_run_glyph_t){
+      .offset = offset,
+      .glyph  = glyph,
+    };
+    offset += text_overlay->stb_font_data[glyph].advance;
   }
+  run->width = offset;
+  text_overlay->run_cache.glyph_count += (uint32_t)text_length;
 
+  return run;
+}
+
+void text_overlay_add_text(text_overlay_t* text_overlay, const char* text,
+                           float x, float y, text_overlay_text_align_enum align)
+{
+  const size_t text_length = strlen(text);
+  const text_run_t* run = text_overlay_get_run(text_overlay, text, text_length);
+  if (run == NULL) {
+    return;
+  }
+
+  // The run is laid out in font pixels
+  const float scale = text_overlay->text_size / TEXTOVERLAY_FONT_PIXEL_SIZE;
   switch (align) {
     case TextOverlay_Text_AlignRight:
-      x -= textWidth;
+      x -= run->width * scale;
       break;
     case TextOverlay_Text_AlignCenter:
-      x -= textWidth / 2.0f;
+      x -= run->width * scale / 2.0f;
       break;
     default:
       break;
   }
 
-  // Generate a uv mapped quad per char in the new text
-  text_vertex_t* mapped
-    = &text_overlay->draw_buffer.vertex.data[text_overlay->num_letters * 4];
-  for (size_t i = 0; i < text_length; ++i) {
-    stb_fontchar* charData
-      = &text_overlay->stb_font_data[(uint32_t)text[i] - first_char];
-
-    mapped->position[0] = (x + (float)charData->x0 * charW);
-    mapped->position[1] = (y - (float)charData->y0 * charH * fbYScale);
-    mapped->uv[0]       = charData->s0;
-    mapped->uv[1]       = charData->t0;
-    mapped++;
-
-    mapped->position[0] = (x + (float)charData->x1 * charW);
-    mapped->position[1] = (y - (float)charData->y0 * charH * fbYScale);
-    mapped->uv[0]       = charData->s1;
-    mapped->uv[1]       = charData->t0;
-    mapped++;
-
-    mapped->position[0] = (x + (float)charData->x0 * charW);
-    mapped->position[1] = (y - (float)charData->y1 * charH * fbYScale);
-    mapped->uv[0]       = charData->s0;
-    mapped->uv[1]       = charData->t1;
-    mapped++;
-
-    mapped->position[0] = (x + (float)charData->x1 * charW);
-    mapped->position[1] = (y - (float)charData->y1 * charH * fbYScale);
-    mapped->uv[0]       = charData->s1;
-    mapped->uv[1]       = charData->t1;
-    mapped++;
-
-    x += charData->advance * charW;
-
-    text_overlay->num_letters++;
+  // One instance per glyph of the run, as many as fit into the buffer
+  const uint32_t count
+    = MIN(run->length, TEXTOVERLAY_MAX_CHAR_COUNT - text_overlay->num_letters);
+  const text_run_glyph_t* glyphs
+    = &text_overlay->run_cache.glyphs[run->first_glyph];
+  text_glyph_instance_t* instances
+    = &text_overlay->draw_buffer.data[text_overlay->num_letters];
+  for (uint32_t i = 0; i < count; ++i) {
+    instances[i] = (text_glyph_instance_t){
+      .position = {x + glyphs[i].offset * scale, y},
+      .glyph    = glyphs[i].glyph,
+      .color    = text_overlay->text_color,
+      .scale    = scale,
+    };
   }
+  text_overlay->num_letters += count;
+
+  // Unchanged texts at unchanged positions leave the instance buffer as is
+  const struct {
+    uint64_t hash;
+    float x, y;
+    uint32_t color;
+    uint32_t count;
+    float scale;
+    float padding;
+  } key = {run->hash, x, y, text_overlay->text_color, count, scale, 0.0f};
+  text_overlay->draw_state.current = wgpu_render_bundle_hash(
+    text_overlay->draw_state.current, &key, sizeof(key));
 }
 
 void text_overlay_add_formatted_text(text_overlay_t* text_overlay, float x,
@@ -517,15 +990,38 @@ void text_overlay_add_formatted_text(text_overlay_t* text_overlay, float x,
   text_overlay_add_text(text_overlay, text, x, y, align);
 }
 
-// Unmap buffer
+// Upload the instances when they differ from the ones in the instance buffer
 void text_overlay_end_text_update(text_overlay_t* text_overlay)
 {
-  uint32_t data_size = text_overlay->num_letters * sizeof(text_vertex_t)
-                       * 4 /* => 4 vertices per character */;
+  wgpu_context_t* wgpu_context = text_overlay->wgpu_context;
+
+  const text_overlay_uniforms_t uniforms = {
+    .viewport = {(float)wgpu_context->surface.width,
+                 (float)wgpu_context->surface.height},
+    .y_scale  = text_overlay->flip_y ? -1.0f : 1.0f,
+  };
+  if (memcmp(&uniforms, &text_overlay->draw_state.uniforms, sizeof(uniforms))
+      != 0) {
+    text_overlay->draw_state.uniforms = uniforms;
+    wgpu_queue_write_buffer(wgpu_context, text_overlay->uniform_buffer.buffer,
+                            0, &uniforms, sizeof(uniforms));
+  }
+
+  if (text_overlay->num_letters == 0
+      || (text_overlay->draw_state.current
+            == text_overlay->draw_state.uploaded
+          && text_overlay->num_letters
+               == text_overlay->draw_state.uploaded_count)) {
+    return;
+  }
 
-  wgpu_record_copy_data_to_buffer(
-    text_overlay->wgpu_context, &text_overlay->vertex_buffer, 0, data_size,
-    text_overlay->draw_buffer.vertex.data, data_size);
+  uint32_t data_size
+    = text_overlay->num_letters * sizeof(text_glyph_instance_t);
+  wgpu_record_copy_data_to_buffer(wgpu_context, &text_overlay->instance_buffer,
+                                  0, data_size, text_overlay->draw_buffer.data,
+                                  data_size);
+  text_overlay->draw_state.uploaded       = text_overlay->draw_state.current;
+  text_overlay->draw_state.uploaded_count = text_overlay->num_letters;
 }
 
 void text_overlay_draw_frame(text_overlay_t* text_overlay, WGPUTextureView view)
@@ -536,13 +1032,14 @@ void text_overlay_draw_frame(text_overlay_t* text_overlay, WGPUTextureView view)
     &text_overlay->render_pass.render_pass_descriptor);
   WGPURenderPassEncoder rpass_enc = text_overlay->wgpu_context->rpass_enc;
 
-  wgpuRenderPassEncoderSetPipeline(rpass_enc, text_overlay->pipeline);
-  wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, text_overlay->bind_group, 0,
-                                    NULL);
-  wgpuRenderPassEncoderSetVertexBuffer(
-    rpass_enc, 0, text_overlay->vertex_buffer.buffer, 0, WGPU_WHOLE_SIZE);
-  for (uint32_t j = 0; j < text_overlay->num_letters; ++j) {
-    wgpuRenderPassEncoderDraw(rpass_enc, 4, 1, j * 4, 0);
+  // All glyphs in one instanced draw of a quad each
+  if (text_overlay->num_letters > 0) {
+    wgpuRenderPassEncoderSetPipeline(rpass_enc, text_overlay->pipeline);
+    wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, text_overlay->bind_group,
+                                      0, NULL);
+    wgpuRenderPassEncoderSetVertexBuffer(
+      rpass_enc, 0, text_overlay->instance_buffer.buffer, 0, WGPU_WHOLE_SIZE);
+    wgpuRenderPassEncoderDraw(rpass_enc, 4, text_overlay->num_letters, 0, 0);
   }
 
   wgpuRenderPassEncoderEnd(rpass_enc);
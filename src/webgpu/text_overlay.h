@@ -15,8 +15,22 @@ typedef enum text_overlay_text_align_enum {
 text_overlay_t* text_overlay_create(wgpu_context_t* wgpu_context);
 void text_overlay_release(text_overlay_t* text_overlay);
 
+/*
+ * Texts are drawn as instanced glyph quads. The layout of every text is cached
+ * by the hash of the string, and the instance buffer is only uploaded when the
+ * texts, their positions or colors changed since the last update.
+ *
+ * The glyphs are sampled from a signed distance field atlas generated from the
+ * font bitmap on creation, so that one atlas serves all text sizes.
+ */
+
 /* Prepare for text update */
 void text_overlay_begin_text_update(text_overlay_t* text_overlay);
+/* Color of the texts added next, RGBA in [0, 1], white by default */
+void text_overlay_set_color(text_overlay_t* text_overlay,
+                            const float color[4]);
+/* Height in pixels of the texts added next, 18 by default */
+void text_overlay_set_text_size(text_overlay_t* text_overlay, float size);
 /* Add text to the current buffer */
 void text_overlay_add_text(text_overlay_t* text_overlay, const char* text,
                            float x, float y,
@@ -1,13 +1,23 @@
 #include "texture.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "../core/block_compression.h"
 #include "../core/file.h"
+#include "../core/job_system.h"
 #include "../core/log.h"
 #include "../core/macro.h"
+#include "../core/profiler.h"
+#include "bind_group_cache.h"
+#include "pipeline_cache.h"
+#include "render_bundle_cache.h"
+#include "sampler_cache.h"
 #include "shader.h"
+#include "upload_scheduler.h"
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -37,6 +47,9 @@
 /* Basis Universal Supercompressed GPU Texture Codec */
 #include <wgpu_basisu.h>
 
+/* Zstandard, for supercompressed KTX2 files */
+#include <zstd.h>
+
 /* -------------------------------------------------------------------------- *
  * Helper functions
  * -------------------------------------------------------------------------- */
@@ -72,6 +85,8 @@ void wgpu_image_to_texure(wgpu_context_t* wgpu_context, WGPUTexture texture,
 
 void wgpu_destroy_texture(texture_t* texture)
 {
+  // The sampler is shared through the sampler cache and stays valid
+  wgpu_bind_group_cache_invalidate(texture->view);
   WGPU_RELEASE_RESOURCE(TextureView, texture->view)
   WGPU_RELEASE_RESOURCE(Texture, texture->texture)
   WGPU_RELEASE_RESOURCE(Sampler, texture->sampler)
@@ -88,30 +103,6 @@ static bool is_power_of_2(int n)
   return (n & (n - 1)) == 0;
 }
 
-static int make_multiple_of_256(int value)
-{
-  int resized_width;
-  if (value % 256 == 0) {
-    resized_width = value;
-  }
-  else {
-    resized_width = (value / 256 + 1) * 256;
-  }
-  return resized_width;
-}
-
-static void copy_padding_buffer(unsigned char* dst, unsigned char* src,
-                                int width, int height, int padding)
-{
-  unsigned char* s = src;
-  unsigned char* d = dst;
-  for (int i = 0; i < height; ++i) {
-    memcpy(d, s, width * 4);
-    s += width * 4;
-    d += padding * 4;
-  }
-}
-
 static WGPUTextureFormat linear_to_sgrb_format(WGPUTextureFormat format)
 {
   switch (format) {
@@ -178,78 +169,27 @@ static uint32_t calculate_mip_level_count(int width, int height)
   return (uint32_t)(floor((float)(log2(MAX(width, height))))) + 1;
 }
 
-/**
- * @brief Deallocates image data.
- */
-static void destroy_image_data(uint8_t** pixel_vec, int width, int height)
-{
-  uint32_t mipmap_level = calculate_mip_level_count(width, height);
-  for (uint32_t i = 0; i < mipmap_level; ++i) {
-    free(pixel_vec[i]);
-  }
-  free(pixel_vec);
-}
-
-/**
- * @brief Generates mipmaps on the CPU.
- * @see https://github.com/webatintel/aquarium
- */
-static void generate_mipmap(uint8_t* input_pixels, int input_w, int input_h,
-                            int input_stride_in_bytes, uint8_t*** output_pixels,
-                            int output_w, int output_h,
-                            int output_stride_in_bytes, int num_channels,
-                            bool is_256_padding)
-{
-  uint32_t mipmap_level = calculate_mip_level_count(output_w, output_h);
-  uint8_t** mipmap_pixels
-    = (unsigned char**)malloc(mipmap_level * sizeof(unsigned char**));
-  *output_pixels = mipmap_pixels;
-  int height     = output_h;
-  int width      = output_w;
-
-  if (!is_256_padding) {
-    for (uint32_t i = 0; i < mipmap_level; ++i) {
-      mipmap_pixels[i]
-        = (unsigned char*)malloc(output_w * height * 4 * sizeof(char));
-      stbir_resize_uint8(input_pixels, input_w, input_h, input_stride_in_bytes,
-                         mipmap_pixels[i], width, height,
-                         output_stride_in_bytes, num_channels);
-
-      height >>= 1;
-      width >>= 1;
-      if (height == 0) {
-        height = 1;
-      }
-    }
-  }
-  else {
-    uint8_t* pixels
-      = (unsigned char*)malloc(output_w * height * 4 * sizeof(char));
-
-    for (uint32_t i = 0; i < mipmap_level; ++i) {
-      mipmap_pixels[i]
-        = (unsigned char*)malloc(output_w * height * 4 * sizeof(char));
-      stbir_resize_uint8(input_pixels, input_w, input_h, input_stride_in_bytes,
-                         pixels, width, height, output_stride_in_bytes,
-                         num_channels);
-      copy_padding_buffer(mipmap_pixels[i], pixels, width, height, output_w);
-
-      height >>= 1;
-      width >>= 1;
-      if (height == 0) {
-        height = 1;
-      }
-    }
-    free(pixels);
-  }
-}
-
 /* -------------------------------------------------------------------------- *
  * WebGPU Mipmap Generator
  * -------------------------------------------------------------------------- */
 
 #define NUMBER_OF_TEXTURE_FORMATS WGPUTextureFormat_R8BG8Biplanar420Unorm
 
+// Maximum number of mip levels written by a single compute dispatch, one
+// 8x8 workgroup reduces a 16x16 tile of the source level down to 1x1
+#define COMPUTE_MIPMAP_MAX_LEVELS 4u
+#define COMPUTE_MIPMAP_WORKGROUP_SIZE 8u
+
+// Formats that can be written as storage textures by the compute path
+static const struct {
+  WGPUTextureFormat format;
+  const char* wgsl_format;
+} compute_mipmap_formats[3] = {
+  {WGPUTextureFormat_RGBA8Unorm, "rgba8unorm"},
+  {WGPUTextureFormat_RGBA16Float, "rgba16float"},
+  {WGPUTextureFormat_RGBA32Float, "rgba32float"},
+};
+
 struct wgpu_mipmap_generator {
   wgpu_context_t* wgpu_context;
   WGPUSampler sampler;
@@ -257,9 +197,10 @@ struct wgpu_mipmap_generator {
   WGPUBindGroupLayout pipeline_layouts[(uint32_t)NUMBER_OF_TEXTURE_FORMATS];
   WGPURenderPipeline pipelines[(uint32_t)NUMBER_OF_TEXTURE_FORMATS];
   bool active_pipelines[(uint32_t)NUMBER_OF_TEXTURE_FORMATS];
-  // Vertex state and  Fragment state are shared between all pipelines
-  WGPUVertexState vertex_state_desc;
-  WGPUFragmentState fragment_state_desc;
+  // Compute pipelines for storage-capable formats, indexed by format and by
+  // the number of mip levels written per dispatch.
+  WGPUComputePipeline compute_pipelines[ARRAY_SIZE(compute_mipmap_formats)]
+                                       [COMPUTE_MIPMAP_MAX_LEVELS];
 };
 
 wgpu_mipmap_generator_t*
@@ -284,7 +225,7 @@ wgpu_mipmap_generator_create(wgpu_context_t* wgpu_context)
     .maxAnisotropy = 1,
   };
   mipmap_generator->sampler
-    = wgpuDeviceCreateSampler(wgpu_context->device, &sampler_desc);
+    = wgpu_sampler_cache_get_sampler(wgpu_context, &sampler_desc);
   ASSERT(mipmap_generator->sampler != NULL);
 
   return mipmap_generator;
@@ -299,12 +240,11 @@ void wgpu_mipmap_generator_destroy(wgpu_mipmap_generator_t* mipmap_generator)
       mipmap_generator->active_pipelines[i] = false;
     }
   }
-  if (!mipmap_generator->vertex_state_desc.module
-      || !mipmap_generator->fragment_state_desc.module) {
-    WGPU_RELEASE_RESOURCE(ShaderModule,
-                          mipmap_generator->vertex_state_desc.module);
-    WGPU_RELEASE_RESOURCE(ShaderModule,
-                          mipmap_generator->fragment_state_desc.module);
+  for (uint32_t i = 0; i < ARRAY_SIZE(compute_mipmap_formats); ++i) {
+    for (uint32_t j = 0; j < COMPUTE_MIPMAP_MAX_LEVELS; ++j) {
+      WGPU_RELEASE_RESOURCE(ComputePipeline,
+                            mipmap_generator->compute_pipelines[i][j])
+    }
   }
   free(mipmap_generator);
 }
@@ -334,62 +274,58 @@ WGPURenderPipeline wgpu_mipmap_generator_get_mipmap_pipeline(
       .writeMask = WGPUColorWriteMask_All,
     };
 
-    // Vertex state and Fragment state are shared between all pipelines, so
-    // only create once.
-    if (!mipmap_generator->vertex_state_desc.module
-        || !mipmap_generator->fragment_state_desc.module) {
-      // clang-format off
-      static const char* mipmap_shader_wgsl = CODE(
-        var<private> pos : array<vec2<f32>, 3> = array<vec2<f32>, 3>(
-          vec2<f32>(-1.0, -1.0), vec2<f32>(-1.0, 3.0), vec2<f32>(3.0, -1.0)
-        );
-
-        struct VertexOutput {
-          @builtin(position) position : vec4<f32>,
-          @location(0) texCoord : vec2<f32>,
-        }
-
-        @vertex
-        fn vertexMain(@builtin(vertex_index) vertexIndex : u32) -> VertexOutput {
-          var output : VertexOutput;
-          output.texCoord = pos[vertexIndex] * vec2<f32>(0.5, -0.5) + vec2<f32>(0.5);
-          output.position = vec4<f32>(pos[vertexIndex], 0.0, 1.0);
-          return output;
-        }
-
-        @group(0) @binding(0) var imgSampler : sampler;
-        @group(0) @binding(1) var img : texture_2d<f32>;
-
-        @fragment
-        fn fragmentMain(@location(0) texCoord : vec2<f32>) -> @location(0) vec4<f32> {
-          return textureSample(img, imgSampler, texCoord);
-        }
+    // clang-format off
+    static const char* mipmap_shader_wgsl = CODE(
+      var<private> pos : array<vec2<f32>, 3> = array<vec2<f32>, 3>(
+        vec2<f32>(-1.0, -1.0), vec2<f32>(-1.0, 3.0), vec2<f32>(3.0, -1.0)
       );
-      // clang-format on
 
-      // Vertex state
-      mipmap_generator->vertex_state_desc = wgpu_create_vertex_state(
-              wgpu_context, &(wgpu_vertex_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Vertex shader WGSL
-                .wgsl_code.source = mipmap_shader_wgsl,
-                .entry = "vertexMain",
-              },
-              .buffer_count = 0,
-              .buffers = NULL,
-            });
-      // Fragment state
-      mipmap_generator->fragment_state_desc = wgpu_create_fragment_state(
-              wgpu_context, &(wgpu_fragment_state_t){
-              .shader_desc = (wgpu_shader_desc_t){
-                // Vertex shader WGSL
-                .wgsl_code.source = mipmap_shader_wgsl,
-                .entry = "fragmentMain",
-              },
-              .target_count = 1,
-              .targets = &color_target_state_desc,
-            });
-    }
+      struct VertexOutput {
+        @builtin(position) position : vec4<f32>,
+        @location(0) texCoord : vec2<f32>,
+      }
+
+      @vertex
+      fn vertexMain(@builtin(vertex_index) vertexIndex : u32) -> VertexOutput {
+        var output : VertexOutput;
+        output.texCoord = pos[vertexIndex] * vec2<f32>(0.5, -0.5) + vec2<f32>(0.5);
+        output.position = vec4<f32>(pos[vertexIndex], 0.0, 1.0);
+        return output;
+      }
+
+      @group(0) @binding(0) var imgSampler : sampler;
+      @group(0) @binding(1) var img : texture_2d<f32>;
+
+      @fragment
+      fn fragmentMain(@location(0) texCoord : vec2<f32>) -> @location(0) vec4<f32> {
+        return textureSample(img, imgSampler, texCoord);
+      }
+    );
+    // clang-format on
+
+    // Vertex state and Fragment state, the shader modules are shared between
+    // all pipelines through the shader module cache
+    WGPUVertexState vertex_state_desc = wgpu_create_vertex_state(
+            wgpu_context, &(wgpu_vertex_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Vertex shader WGSL
+              .wgsl_code.source = mipmap_shader_wgsl,
+              .entry = "vertexMain",
+            },
+            .buffer_count = 0,
+            .buffers = NULL,
+          });
+    // Fragment state
+    WGPUFragmentState fragment_state_desc = wgpu_create_fragment_state(
+            wgpu_context, &(wgpu_fragment_state_t){
+            .shader_desc = (wgpu_shader_desc_t){
+              // Vertex shader WGSL
+              .wgsl_code.source = mipmap_shader_wgsl,
+              .entry = "fragmentMain",
+            },
+            .target_count = 1,
+            .targets = &color_target_state_desc,
+          });
 
     // Multisample state
     WGPUMultisampleState multisample_state_desc
@@ -398,19 +334,24 @@ WGPURenderPipeline wgpu_mipmap_generator_get_mipmap_pipeline(
           .sample_count = 1,
         });
 
-    // Create rendering pipeline using the specified states
+    // Create rendering pipeline using the specified states, all mipmap
+    // generators share it through the pipeline cache
     mipmap_generator->pipelines[pipeline_index]
-      = wgpuDeviceCreateRenderPipeline(
-        wgpu_context->device,
+      = wgpu_pipeline_cache_get_render_pipeline(
+        wgpu_context,
         &(WGPURenderPipelineDescriptor){
           .label       = "blit_render_pipeline",
           .primitive   = primitive_state_desc,
-          .vertex      = mipmap_generator->vertex_state_desc,
-          .fragment    = &mipmap_generator->fragment_state_desc,
+          .vertex      = vertex_state_desc,
+          .fragment    = &fragment_state_desc,
           .multisample = multisample_state_desc,
         });
     ASSERT(mipmap_generator->pipelines[pipeline_index] != NULL);
 
+    // Partial clean-up
+    WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state_desc.module);
+    WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state_desc.module);
+
     // Store the bind group layout of the created pipeline
     mipmap_generator->pipeline_layouts[pipeline_index]
       = wgpuRenderPipelineGetBindGroupLayout(
@@ -424,21 +365,43 @@ WGPURenderPipeline wgpu_mipmap_generator_get_mipmap_pipeline(
   return mipmap_generator->pipelines[pipeline_index];
 }
 
-WGPUTexture
-wgpu_mipmap_generator_generate_mipmap(wgpu_mipmap_generator_t* mipmap_generator,
-                                      WGPUTexture texture,
-                                      WGPUTextureDescriptor* texture_desc)
+// Copies the mip levels generated into a separate mip texture, which is one
+// level smaller than the source texture, back to the source texture.
+static void copy_mip_levels_to_texture(WGPUCommandEncoder cmd_encoder,
+                                       WGPUTexture mip_texture,
+                                       WGPUTexture texture,
+                                       WGPUTextureDescriptor* texture_desc,
+                                       uint32_t array_layer_count)
+{
+  for (uint32_t i = 1; i < texture_desc->mipLevelCount; ++i) {
+    WGPUExtent3D mip_level_size = (WGPUExtent3D){
+      .width              = MAX(1u, texture_desc->size.width >> i),
+      .height             = MAX(1u, texture_desc->size.height >> i),
+      .depthOrArrayLayers = array_layer_count,
+    };
+    wgpuCommandEncoderCopyTextureToTexture(cmd_encoder,
+                                           // source
+                                           &(WGPUImageCopyTexture){
+                                             .texture  = mip_texture,
+                                             .mipLevel = i - 1,
+                                           },
+                                           // destination
+                                           &(WGPUImageCopyTexture){
+                                             .texture  = texture,
+                                             .mipLevel = i,
+                                           },
+                                           // copySize
+                                           &mip_level_size);
+  }
+}
+
+static WGPUTexture wgpu_mipmap_generator_generate_mipmap_render(
+  wgpu_mipmap_generator_t* mipmap_generator, WGPUTexture texture,
+  WGPUTextureDescriptor* texture_desc)
 {
   WGPURenderPipeline pipeline = wgpu_mipmap_generator_get_mipmap_pipeline(
     mipmap_generator, texture_desc->format);
 
-  if (texture_desc->dimension == WGPUTextureDimension_3D
-      || texture_desc->dimension == WGPUTextureDimension_1D) {
-    log_error(
-      "Generating mipmaps for non-2d textures is currently unsupported!");
-    return NULL;
-  }
-
   wgpu_context_t* wgpu_context     = mipmap_generator->wgpu_context;
   WGPUTexture mip_texture          = texture;
   const uint32_t array_layer_count = texture_desc->size.depthOrArrayLayers > 0 ?
@@ -565,29 +528,8 @@ wgpu_mipmap_generator_generate_mipmap(wgpu_mipmap_generator_t* mipmap_generator,
   // If we didn't render to the source texture, finish by copying the mip
   // results from the temporary mipmap texture to the source.
   if (!render_to_source) {
-    WGPUExtent3D mip_level_size = (WGPUExtent3D){
-      .width              = ceil(texture_desc->size.width / 2.0f),
-      .height             = ceil(texture_desc->size.height / 2.0f),
-      .depthOrArrayLayers = array_layer_count,
-    };
-
-    for (uint32_t i = 1; i < texture_desc->mipLevelCount - 1; ++i) {
-      wgpuCommandEncoderCopyTextureToTexture(cmd_encoder,
-                                             // source
-                                             &(WGPUImageCopyTexture){
-                                               .texture  = mip_texture,
-                                               .mipLevel = i - 1,
-                                             },
-                                             // destination
-                                             &(WGPUImageCopyTexture){
-                                               .texture  = texture,
-                                               .mipLevel = i,
-                                             },
-                                             // copySize
-                                             &mip_level_size);
-      mip_level_size.width  = ceil(mip_level_size.width / 2.0f);
-      mip_level_size.height = ceil(mip_level_size.height / 2.0f);
-    }
+    copy_mip_levels_to_texture(cmd_encoder, mip_texture, texture, texture_desc,
+                               array_layer_count);
   }
 
   WGPUCommandBuffer command_buffer
@@ -616,6 +558,278 @@ wgpu_mipmap_generator_generate_mipmap(wgpu_mipmap_generator_t* mipmap_generator,
   return texture;
 }
 
+static int32_t get_compute_mipmap_format_index(WGPUTextureFormat format)
+{
+  for (uint32_t i = 0; i < ARRAY_SIZE(compute_mipmap_formats); ++i) {
+    if (compute_mipmap_formats[i].format == format) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+// Builds the WGSL source of the downsampling compute shader that writes
+// 'level_count' mip levels. Every invocation averages a 2x2 quad of the source
+// level, the following levels are reduced from workgroup shared memory.
+static void build_compute_mipmap_shader(char* wgsl, size_t wgsl_size,
+                                        const char* wgsl_format,
+                                        uint32_t level_count)
+{
+  size_t len = 0;
+  len += snprintf(wgsl + len, wgsl_size - len,
+                  "@group(0) @binding(0) var src : texture_2d<f32>;\n");
+  for (uint32_t i = 1; i <= level_count; ++i) {
+    len += snprintf(wgsl + len, wgsl_size - len,
+                    "@group(0) @binding(%u) var dst%u : "
+                    "texture_storage_2d<%s, write>;\n",
+                    i, i, wgsl_format);
+  }
+  len += snprintf(
+    wgsl + len, wgsl_size - len,
+    "var<workgroup> tile : array<vec4<f32>, 64>;\n"
+    "\n"
+    "@compute @workgroup_size(8, 8)\n"
+    "fn main(@builtin(workgroup_id) group_id : vec3<u32>,\n"
+    "        @builtin(local_invocation_id) local_id : vec3<u32>) {\n"
+    "  let index = local_id.y * 8u + local_id.x;\n"
+    "  let dst_pos = vec2<i32>(group_id.xy * 8u + local_id.xy);\n"
+    "  let max_pos = vec2<i32>(textureDimensions(src)) - vec2<i32>(1);\n"
+    "  let src_pos = dst_pos * 2;\n"
+    "  var color = (textureLoad(src, min(src_pos, max_pos), 0)\n"
+    "    + textureLoad(src, min(src_pos + vec2<i32>(1, 0), max_pos), 0)\n"
+    "    + textureLoad(src, min(src_pos + vec2<i32>(0, 1), max_pos), 0)\n"
+    "    + textureLoad(src, min(src_pos + vec2<i32>(1, 1), max_pos), 0))\n"
+    "    * 0.25;\n"
+    "  if (all(dst_pos < vec2<i32>(textureDimensions(dst1)))) {\n"
+    "    textureStore(dst1, dst_pos, color);\n"
+    "  }\n"
+    "  tile[index] = color;\n");
+  for (uint32_t i = 2; i <= level_count; ++i) {
+    const uint32_t step = 1u << (i - 2);
+    len += snprintf(
+      wgsl + len, wgsl_size - len,
+      "  workgroupBarrier();\n"
+      "  if (all(local_id.xy %% vec2<u32>(%uu) == vec2<u32>(0u))) {\n"
+      "    color = (tile[index] + tile[index + %uu] + tile[index + %uu]\n"
+      "      + tile[index + %uu]) * 0.25;\n"
+      "    tile[index] = color;\n"
+      "    let pos%u = dst_pos / %u;\n"
+      "    if (all(pos%u < vec2<i32>(textureDimensions(dst%u)))) {\n"
+      "      textureStore(dst%u, pos%u, color);\n"
+      "    }\n"
+      "  }\n",
+      step * 2, step, step * 8, step * 9, i, 1u << (i - 1), i, i, i, i);
+  }
+  len += snprintf(wgsl + len, wgsl_size - len, "}\n");
+  ASSERT(len < wgsl_size);
+}
+
+static WGPUComputePipeline wgpu_mipmap_generator_get_compute_pipeline(
+  wgpu_mipmap_generator_t* mipmap_generator, uint32_t format_index,
+  uint32_t level_count)
+{
+  ASSERT(level_count > 0 && level_count <= COMPUTE_MIPMAP_MAX_LEVELS);
+  WGPUComputePipeline* pipeline
+    = &mipmap_generator->compute_pipelines[format_index][level_count - 1];
+  if (*pipeline == NULL) {
+    wgpu_context_t* wgpu_context = mipmap_generator->wgpu_context;
+
+    char wgsl[4096];
+    build_compute_mipmap_shader(
+      wgsl, sizeof(wgsl), compute_mipmap_formats[format_index].wgsl_format,
+      level_count);
+
+    wgpu_shader_t mipmap_comp_shader = wgpu_shader_create(
+      wgpu_context, &(wgpu_shader_desc_t){
+                      // Compute shader WGSL
+                      .label            = "mipmap_compute_shader",
+                      .wgsl_code.source = wgsl,
+                      .entry            = "main",
+                    });
+    *pipeline = wgpuDeviceCreateComputePipeline(
+      wgpu_context->device,
+      &(WGPUComputePipelineDescriptor){
+        .label   = "mipmap_compute_pipeline",
+        .compute = mipmap_comp_shader.programmable_stage_descriptor,
+      });
+    ASSERT(*pipeline != NULL);
+
+    // Partial clean-up
+    wgpu_shader_release(&mipmap_comp_shader);
+  }
+
+  return *pipeline;
+}
+
+static WGPUTextureView create_mip_level_view(WGPUTexture texture,
+                                             uint32_t mip_level,
+                                             uint32_t array_layer)
+{
+  return wgpuTextureCreateView(
+    texture, &(WGPUTextureViewDescriptor){
+               .label           = "mip_view",
+               .aspect          = WGPUTextureAspect_All,
+               .baseMipLevel    = mip_level,
+               .mipLevelCount   = 1,
+               .dimension       = WGPUTextureViewDimension_2D,
+               .baseArrayLayer  = array_layer,
+               .arrayLayerCount = 1,
+             });
+}
+
+// Compute path: every dispatch reads one mip level and writes up to
+// COMPUTE_MIPMAP_MAX_LEVELS following levels as storage textures.
+static WGPUTexture wgpu_mipmap_generator_generate_mipmap_compute(
+  wgpu_mipmap_generator_t* mipmap_generator, WGPUTexture texture,
+  WGPUTextureDescriptor* texture_desc, uint32_t format_index)
+{
+  wgpu_context_t* wgpu_context     = mipmap_generator->wgpu_context;
+  WGPUTexture mip_texture          = texture;
+  const uint32_t array_layer_count = texture_desc->size.depthOrArrayLayers > 0 ?
+                                       texture_desc->size.depthOrArrayLayers :
+                                       1; // Only valid for 2D textures.
+  const uint32_t mip_level_count   = texture_desc->mipLevelCount;
+
+  // If the texture was created with STORAGE_BINDING usage we can write
+  // directly to the mip levels, otherwise a separate texture is used which is
+  // one mip level smaller than the source texture.
+  const WGPUTextureUsage store_to_source
+    = texture_desc->usage & WGPUTextureUsage_StorageBinding;
+  if (!store_to_source) {
+    const WGPUTextureDescriptor mip_texture_desc = {
+      .size = (WGPUExtent3D) {
+        .width              = MAX(1u, texture_desc->size.width >> 1),
+        .height             = MAX(1u, texture_desc->size.height >> 1),
+        .depthOrArrayLayers = array_layer_count,
+      },
+      .format        = texture_desc->format,
+      .usage         = WGPUTextureUsage_CopySrc | WGPUTextureUsage_TextureBinding
+                       | WGPUTextureUsage_StorageBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .mipLevelCount = mip_level_count - 1,
+      .sampleCount   = 1,
+    };
+    mip_texture
+      = wgpuDeviceCreateTexture(wgpu_context->device, &mip_texture_desc);
+    ASSERT(mip_texture != NULL);
+  }
+
+  WGPUCommandEncoder cmd_encoder
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder pass_encoder
+    = wgpuCommandEncoderBeginComputePass(cmd_encoder, NULL);
+
+  for (uint32_t array_layer = 0; array_layer < array_layer_count;
+       ++array_layer) {
+    for (uint32_t base_level = 0; base_level + 1 < mip_level_count;) {
+      const uint32_t level_count
+        = MIN(COMPUTE_MIPMAP_MAX_LEVELS, mip_level_count - 1 - base_level);
+      WGPUComputePipeline pipeline = wgpu_mipmap_generator_get_compute_pipeline(
+        mipmap_generator, format_index, level_count);
+      WGPUBindGroupLayout bind_group_layout
+        = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+
+      // Binding 0 is the source level, bindings 1..level_count the levels
+      // written by this dispatch
+      WGPUTextureView views[1 + COMPUTE_MIPMAP_MAX_LEVELS] = {0};
+      WGPUBindGroupEntry bg_entries[1 + COMPUTE_MIPMAP_MAX_LEVELS] = {0};
+      for (uint32_t i = 0; i <= level_count; ++i) {
+        const uint32_t mip_level = base_level + i;
+        views[i] = (mip_level == 0 || store_to_source) ?
+                     create_mip_level_view(texture, mip_level, array_layer) :
+                     create_mip_level_view(mip_texture, mip_level - 1,
+                                           array_layer);
+        bg_entries[i] = (WGPUBindGroupEntry){
+          .binding     = i,
+          .textureView = views[i],
+        };
+      }
+      WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+        wgpu_context->device, &(WGPUBindGroupDescriptor){
+                                .layout     = bind_group_layout,
+                                .entryCount = level_count + 1,
+                                .entries    = bg_entries,
+                              });
+      ASSERT(bind_group != NULL);
+
+      // One workgroup per 8x8 tile of the first level written
+      const uint32_t group_size = COMPUTE_MIPMAP_WORKGROUP_SIZE;
+      const uint32_t width
+        = MAX(1u, texture_desc->size.width >> (base_level + 1));
+      const uint32_t height
+        = MAX(1u, texture_desc->size.height >> (base_level + 1));
+      wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+      wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+      wgpuComputePassEncoderDispatchWorkgroups(
+        pass_encoder, (width + group_size - 1) / group_size,
+        (height + group_size - 1) / group_size, 1);
+
+      // The pass encoder keeps its own references on the bound resources
+      WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+      for (uint32_t i = 0; i <= level_count; ++i) {
+        WGPU_RELEASE_RESOURCE(TextureView, views[i])
+      }
+      WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+
+      base_level += level_count;
+    }
+  }
+
+  wgpuComputePassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass_encoder)
+
+  // If we didn't write to the source texture, finish by copying the mip
+  // results from the temporary mipmap texture to the source.
+  if (!store_to_source) {
+    copy_mip_levels_to_texture(cmd_encoder, mip_texture, texture, texture_desc,
+                               array_layer_count);
+  }
+
+  WGPUCommandBuffer command_buffer
+    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
+  ASSERT(command_buffer != NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+
+  // Sumbit commmand buffer and cleanup
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  if (!store_to_source) {
+    WGPU_RELEASE_RESOURCE(Texture, mip_texture);
+  }
+
+  return texture;
+}
+
+WGPUTexture
+wgpu_mipmap_generator_generate_mipmap(wgpu_mipmap_generator_t* mipmap_generator,
+                                      WGPUTexture texture,
+                                      WGPUTextureDescriptor* texture_desc)
+{
+  if (texture_desc->dimension == WGPUTextureDimension_3D
+      || texture_desc->dimension == WGPUTextureDimension_1D) {
+    log_error(
+      "Generating mipmaps for non-2d textures is currently unsupported!");
+    return NULL;
+  }
+
+  if (texture_desc->mipLevelCount <= 1) {
+    return texture;
+  }
+
+  // Use the compute path for storage-capable formats and fall back to the
+  // render path for all other formats
+  const int32_t format_index
+    = get_compute_mipmap_format_index(texture_desc->format);
+  if (format_index >= 0) {
+    return wgpu_mipmap_generator_generate_mipmap_compute(
+      mipmap_generator, texture, texture_desc, (uint32_t)format_index);
+  }
+
+  return wgpu_mipmap_generator_generate_mipmap_render(mipmap_generator,
+                                                      texture, texture_desc);
+}
+
 /* -------------------------------------------------------------------------- *
  * WebGPU Texture Client
  * -------------------------------------------------------------------------- */
@@ -656,7 +870,7 @@ texture_result_t wgpu_texture_client_load_texture_from_memory(
 
   bool is_hdr = stbi_is_hdr_from_memory((stbi_uc*)data, data_size);
   int width = 0, height = 0, read_comps = 4;
-  stbi_set_flip_vertically_on_load(false);
+  stbi_set_flip_vertically_on_load_thread(false);
   uint8_t* pixel_data
     = is_hdr ? (uint8_t*)stbi_loadf_from_memory((stbi_uc*)data, data_size,
                                                 &width, &height, &read_comps,
@@ -677,7 +891,10 @@ texture_result_t wgpu_texture_client_load_texture_from_memory(
     = generate_mipmaps ? calculate_mip_level_count(width, height) : 1u;
 
   const WGPUTextureUsage usage
-    = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
+    = options ? (options->usage != WGPUTextureUsage_None ?
+                   options->usage :
+                   WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding) :
+                WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
 
   WGPUExtent3D texture_size = {
     .width              = width,
@@ -727,8 +944,10 @@ typedef struct {
   stbi_uc* pixel_data;
 } stb_image_load_result_t;
 
+/* Loads the image from memory when data is given, from the file otherwise */
 static stb_image_load_result_t
-stb_image_load_image_from_file(const char* filename, bool flip_y)
+stb_image_load_image(const char* filename, const uint8_t* data,
+                     size_t data_size, bool flip_y)
 {
   static const uint8_t comp_map[5] = {
     0, //
@@ -751,13 +970,21 @@ stb_image_load_image_from_file(const char* filename, bool flip_y)
   // webgpu shoud support 3 channel format.
   // https://github.com/gpuweb/gpuweb/issues/66#issuecomment-410021505
   int read_comps = 4;
-  stbi_set_flip_vertically_on_load(flip_y);
-  stbi_uc* pixel_data = stbi_load(filename,            //
-                                  &width,              //
-                                  &height,             //
-                                  &read_comps,         //
-                                  channels[read_comps] //
-  );
+  stbi_set_flip_vertically_on_load_thread(flip_y);
+  stbi_uc* pixel_data
+    = data ? stbi_load_from_memory(data,                //
+                                   (int)data_size,      //
+                                   &width,              //
+                                   &height,             //
+                                   &read_comps,         //
+                                   channels[read_comps] //
+                                   ) :
+             stbi_load(filename,            //
+                       &width,              //
+                       &height,             //
+                       &read_comps,         //
+                       channels[read_comps] //
+             );
 
   if (pixel_data == NULL) {
     log_error("Couldn't load '%s'\n", filename);
@@ -775,74 +1002,504 @@ stb_image_load_image_from_file(const char* filename, bool flip_y)
   };
 }
 
-static texture_result_t
-wgpu_texture_load_with_stb(struct wgpu_texture_client_t* texture_client,
-                           const char* filename,
-                           struct wgpu_texture_load_options_t* options)
+static stb_image_load_result_t
+stb_image_load_image_from_file(const char* filename, bool flip_y)
 {
-  if (!texture_client->wgpu_context) {
-    log_error("Cannot create new textures after object has been destroyed.");
-    return (texture_result_t){0};
-  }
+  return stb_image_load_image(filename, NULL, 0, flip_y);
+}
 
-  const bool flip_y = options ? options->flip_y : false;
-  stb_image_load_result_t image_load_result
-    = stb_image_load_image_from_file(filename, flip_y);
+static bool is_stb_image_file(const char* filename)
+{
+  return filename_has_extension(filename, "jpg")
+         || filename_has_extension(filename, "png");
+}
 
-  stbi_uc* pixel_data = image_load_result.pixel_data;
-  if (pixel_data == NULL) {
-    return (texture_result_t){0};
+#define TEXTURE_COMPRESSION_MAX_LEVELS 16u
+#define TEXTURE_COMPRESSION_CACHE_VERSION 1u
+
+/* Decoded image and its CPU generated mip chain */
+typedef struct {
+  const char* filename;
+  const uint8_t* data; /* optional, encoded image already in memory */
+  size_t data_size;
+  bool flip_y;
+  bool generate_mipmaps;
+  stb_image_load_result_t image;
+  uint32_t mip_level_count;
+  uint8_t* mip_chain; /* levels 1..mip_level_count-1, tightly packed */
+  /* Block compression, see stb_image_decode_job_set_compression */
+  struct {
+    WGPUTextureFormat format; /* undefined when not compressed */
+    block_compression_format_enum block_format;
+    char cache_filename[STRMAX];
+    bool cached;   /* the cache file is loaded instead of the image */
+    uint8_t* data; /* compressed levels, tightly packed */
+    size_t level_sizes[TEXTURE_COMPRESSION_MAX_LEVELS];
+  } compression;
+} stb_image_decode_job_t;
+
+/* Tightly packed data of all faces of a mip level */
+typedef struct texture_level_data_t {
+  const uint8_t* data;
+  size_t size;
+} texture_level_data_t;
+
+/* Forward declarations */
+static bool ktx2_write_file(const char* filename, WGPUTextureFormat format,
+                            uint32_t width, uint32_t height,
+                            uint32_t face_count, uint32_t level_count,
+                            const texture_level_data_t* levels);
+static texture_result_t wgpu_texture_create_from_levels(
+  wgpu_context_t* wgpu_context, WGPUTextureFormat format, uint32_t width,
+  uint32_t height, uint32_t face_count, uint32_t level_count,
+  const texture_level_data_t* levels, WGPUTextureUsage usage);
+static texture_result_t wgpu_texture_load_from_ktx2_file(
+  wgpu_context_t* wgpu_context, const char* filename, WGPUTextureUsage usage,
+  color_space_enum_t color_space);
+
+/**
+ * @brief Builds the mip levels below level 0 on the CPU. Every level is
+ * resampled from the previous one and written into one contiguous allocation.
+ */
+static uint8_t* build_mip_chain(const uint8_t* pixels, uint32_t width,
+                                uint32_t height, uint32_t channel_count,
+                                uint32_t mip_level_count)
+{
+  size_t mip_chain_size = 0;
+  for (uint32_t level = 1; level < mip_level_count; ++level) {
+    mip_chain_size += (size_t)MAX(1u, width >> level)
+                      * MAX(1u, height >> level) * channel_count;
+  }
+  if (mip_chain_size == 0) {
+    return NULL;
   }
-  ASSERT(pixel_data);
 
-  const int width             = image_load_result.image_width;
-  const int height            = image_load_result.image_height;
-  const int channel_count     = image_load_result.channel_count;
-  const bool generate_mipmaps = options ? options->generate_mipmaps : false;
-  const uint32_t mip_level_count
-    = generate_mipmaps ? calculate_mip_level_count(width, height) : 1u;
+  uint8_t* mip_chain        = (uint8_t*)malloc(mip_chain_size);
+  const uint8_t* src_pixels = pixels;
+  uint8_t* dst_pixels       = mip_chain;
+  for (uint32_t level = 1; level < mip_level_count; ++level) {
+    const uint32_t src_w = MAX(1u, width >> (level - 1));
+    const uint32_t src_h = MAX(1u, height >> (level - 1));
+    const uint32_t dst_w = MAX(1u, width >> level);
+    const uint32_t dst_h = MAX(1u, height >> level);
+    stbir_resize_uint8(src_pixels, src_w, src_h, 0, dst_pixels, dst_w, dst_h,
+                       0, channel_count);
+    src_pixels = dst_pixels;
+    dst_pixels += (size_t)dst_w * dst_h * channel_count;
+  }
 
-  const WGPUTextureUsage usage
-    = options ? (options->usage != WGPUTextureUsage_None ?
-                   options->usage :
-                   WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding) :
-                WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
+  return mip_chain;
+}
 
-  WGPUExtent3D texture_size = {
-    .width              = width,
-    .height             = height,
-    .depthOrArrayLayers = 1,
-  };
-  WGPUTextureDescriptor texture_desc = {
-    .usage         = usage,
-    .dimension     = WGPUTextureDimension_2D,
-    .size          = texture_size,
-    .format        = options ? (options->format != WGPUTextureFormat_Undefined ?
-                                  format_for_color_space(options->format,
-                                                         options->color_space) :
-                                  WGPUTextureFormat_RGBA8Unorm) :
-                               WGPUTextureFormat_RGBA8Unorm,
-    .mipLevelCount = mip_level_count,
-    .sampleCount   = 1,
-  };
-  WGPUTexture texture = wgpuDeviceCreateTexture(
-    texture_client->wgpu_context->device, &texture_desc);
+/*
+ * Block compression of decoded images
+ *
+ * The compressed levels are cached in WGPU_TEXTURE_CACHE_DIRECTORY as KTX2
+ * files named after the hash of the source data and of the settings the
+ * levels depend on, later loads upload the cache file without decoding.
+ */
 
-  // Copy pixel data to texture and free allocated memory
-  wgpu_image_to_texure(texture_client->wgpu_context, texture, pixel_data,
-                       texture_size, channel_count);
-  stbi_image_free(pixel_data);
+/**
+ * @brief Selects the block compressed format of the load options, on the
+ * calling thread before the job is decoded. Images stay uncompressed without
+ * TextureCompressionBC, with a format other than RGBA8 for color or with a
+ * usage block compressed formats don't support.
+ */
+static void stb_image_decode_job_set_compression(
+  stb_image_decode_job_t* job, wgpu_context_t* wgpu_context,
+  const struct wgpu_texture_load_options_t* options)
+{
+  const WGPUTextureUsage unsupported_usage
+    = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_StorageBinding;
+  job->compression.format = WGPUTextureFormat_Undefined;
+  if (options == NULL || options->compression == TEXTURE_COMPRESSION_NONE
+      || (options->usage & unsupported_usage)
+      || !wgpu_has_feature(wgpu_context,
+                           WGPUFeatureName_TextureCompressionBC)) {
+    return;
+  }
 
-  if (generate_mipmaps) {
-    if (texture_client->wgpu_mipmap_generator == NULL) {
-      texture_client->wgpu_mipmap_generator
-        = wgpu_mipmap_generator_create(texture_client->wgpu_context);
-    }
-    texture = wgpu_mipmap_generator_generate_mipmap(
-      texture_client->wgpu_mipmap_generator, texture, &texture_desc);
+  const WGPUTextureFormat format
+    = options->format != WGPUTextureFormat_Undefined ?
+        format_for_color_space(options->format, options->color_space) :
+        WGPUTextureFormat_RGBA8Unorm;
+  switch (options->compression) {
+    case TEXTURE_COMPRESSION_COLOR:
+      if (format == WGPUTextureFormat_RGBA8Unorm) {
+        job->compression.format = WGPUTextureFormat_BC7RGBAUnorm;
+      }
+      else if (format == WGPUTextureFormat_RGBA8UnormSrgb) {
+        job->compression.format = WGPUTextureFormat_BC7RGBAUnormSrgb;
+      }
+      job->compression.block_format = BlockCompressionFormat_BC7;
+      break;
+    case TEXTURE_COMPRESSION_NORMAL:
+      job->compression.format       = WGPUTextureFormat_BC5RGUnorm;
+      job->compression.block_format = BlockCompressionFormat_BC5;
+      break;
+    case TEXTURE_COMPRESSION_MASK:
+      job->compression.format       = WGPUTextureFormat_BC4RUnorm;
+      job->compression.block_format = BlockCompressionFormat_BC4;
+      break;
+    default:
+      break;
+  }
+  if (job->compression.format != WGPUTextureFormat_Undefined) {
+    mkdir(WGPU_TEXTURE_CACHE_DIRECTORY, 0755);
   }
+}
 
-  return (texture_result_t){
+/**
+ * @brief Names the cache file after the source data and the settings, returns
+ * true when the cache file exists and the image doesn't need to be decoded.
+ */
+static bool stb_image_decode_job_find_cache(stb_image_decode_job_t* job,
+                                            const uint8_t* data,
+                                            size_t data_size)
+{
+  const uint32_t settings[5] = {
+    TEXTURE_COMPRESSION_CACHE_VERSION,
+    (uint32_t)job->compression.format,
+    job->flip_y,
+    job->generate_mipmaps,
+    (uint32_t)data_size,
+  };
+  uint64_t hash = wgpu_render_bundle_hash(WGPU_RENDER_BUNDLE_HASH_SEED,
+                                          settings, sizeof(settings));
+  hash          = wgpu_render_bundle_hash(hash, data, data_size);
+  snprintf(job->compression.cache_filename, STRMAX, "%s/%016llx.ktx2",
+           WGPU_TEXTURE_CACHE_DIRECTORY, (unsigned long long)hash);
+  job->compression.cached = file_exists(job->compression.cache_filename);
+  return job->compression.cached;
+}
+
+/**
+ * @brief Compresses the decoded levels and writes them to the cache file. The
+ * image stays uncompressed when its size isn't a multiple of the block size.
+ */
+static void stb_image_decode_job_compress(stb_image_decode_job_t* job)
+{
+  const uint32_t width  = (uint32_t)job->image.image_width;
+  const uint32_t height = (uint32_t)job->image.image_height;
+  if (width % 4 != 0 || height % 4 != 0 || job->image.channel_count != 4
+      || job->mip_level_count > TEXTURE_COMPRESSION_MAX_LEVELS) {
+    job->compression.format = WGPUTextureFormat_Undefined;
+    return;
+  }
+
+  const block_compression_format_enum block_format
+    = job->compression.block_format;
+  size_t data_size = 0;
+  for (uint32_t level = 0; level < job->mip_level_count; ++level) {
+    job->compression.level_sizes[level] = block_compression_get_image_size(
+      block_format, MAX(1u, width >> level), MAX(1u, height >> level));
+    data_size += job->compression.level_sizes[level];
+  }
+  job->compression.data = (uint8_t*)malloc(data_size);
+
+  texture_level_data_t levels[TEXTURE_COMPRESSION_MAX_LEVELS] = {0};
+
+  const uint8_t* pixels = job->image.pixel_data;
+  uint8_t* blocks       = job->compression.data;
+  for (uint32_t level = 0; level < job->mip_level_count; ++level) {
+    const uint32_t level_width  = MAX(1u, width >> level);
+    const uint32_t level_height = MAX(1u, height >> level);
+    if (level == 1) {
+      pixels = job->mip_chain;
+    }
+    block_compress_image(block_format, pixels, level_width, level_height,
+                         blocks);
+    levels[level] = (texture_level_data_t){
+      .data = blocks,
+      .size = job->compression.level_sizes[level],
+    };
+    blocks += job->compression.level_sizes[level];
+    if (level > 0) {
+      pixels += (size_t)level_width * level_height * 4;
+    }
+  }
+
+  if (!ktx2_write_file(job->compression.cache_filename, job->compression.format,
+                       width, height, 1, job->mip_level_count, levels)) {
+    log_warn("Could not write texture cache file: %s\n",
+             job->compression.cache_filename);
+  }
+
+  // Only the compressed levels are uploaded
+  stbi_image_free(job->image.pixel_data);
+  job->image.pixel_data = NULL;
+  free(job->mip_chain);
+  job->mip_chain = NULL;
+}
+
+static void stb_image_decode(stb_image_decode_job_t* job)
+{
+  // Compressed images are looked up in the cache by the hash of the source
+  // data, files are mapped for it
+  const bool compress = job->compression.format != WGPUTextureFormat_Undefined;
+
+  file_mapping_t mapping = {0};
+  const uint8_t* data    = job->data;
+  size_t data_size       = job->data_size;
+  if (compress && data == NULL && file_map(job->filename, &mapping)) {
+    data      = mapping.data;
+    data_size = (size_t)mapping.size;
+  }
+  if (compress && data != NULL
+      && stb_image_decode_job_find_cache(job, data, data_size)) {
+    file_unmap(&mapping);
+    return;
+  }
+
+  job->image
+    = stb_image_load_image(job->filename, data, data_size, job->flip_y);
+  file_unmap(&mapping);
+  if (job->image.pixel_data == NULL) {
+    return;
+  }
+  job->mip_level_count = job->generate_mipmaps ?
+                           calculate_mip_level_count(job->image.image_width,
+                                                     job->image.image_height) :
+                           1u;
+  job->mip_chain = build_mip_chain(
+    job->image.pixel_data, job->image.image_width, job->image.image_height,
+    job->image.channel_count, job->mip_level_count);
+  if (compress && data != NULL) {
+    stb_image_decode_job_compress(job);
+  }
+}
+
+/* True when the job has an image to upload */
+static bool stb_image_decode_job_succeeded(const stb_image_decode_job_t* job)
+{
+  return job->image.pixel_data != NULL || job->compression.cached
+         || job->compression.data != NULL;
+}
+
+static void stb_image_decode_range(void* user_data, uint32_t begin,
+                                   uint32_t end)
+{
+  stb_image_decode_job_t* jobs = (stb_image_decode_job_t*)user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    stb_image_decode(&jobs[i]);
+  }
+}
+
+/**
+ * @brief Decodes the given images concurrently on the shared job system.
+ * Returns once all images are decoded.
+ */
+static void stb_image_decode_parallel(stb_image_decode_job_t* jobs,
+                                      uint32_t job_count)
+{
+  job_system_parallel_for(job_system_get_shared(), job_count, 1,
+                          stb_image_decode_range, jobs);
+}
+
+static void stb_image_decode_job_release(stb_image_decode_job_t* job)
+{
+  if (job->image.pixel_data != NULL) {
+    stbi_image_free(job->image.pixel_data);
+    job->image.pixel_data = NULL;
+  }
+  free(job->mip_chain);
+  job->mip_chain = NULL;
+  free(job->compression.data);
+  job->compression.data = NULL;
+}
+
+static texture_result_t
+stb_image_decode_job_upload(struct wgpu_texture_client_t* texture_client,
+                            stb_image_decode_job_t* job,
+                            struct wgpu_texture_load_options_t* options)
+{
+  const WGPUTextureUsage usage
+    = options ? (options->usage != WGPUTextureUsage_None ?
+                   options->usage :
+                   WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding) :
+                WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
+
+  // Block compressed levels, from the cache or compressed by the job
+  if (job->compression.cached) {
+    texture_result_t texture_result = wgpu_texture_load_from_ktx2_file(
+      texture_client->wgpu_context, job->compression.cache_filename, usage,
+      COLOR_SPACE_UNDEFINED);
+    if (texture_result.texture == NULL) {
+      log_error("Invalid texture cache file %s",
+                job->compression.cache_filename);
+    }
+    return texture_result;
+  }
+  if (job->compression.data != NULL) {
+    texture_level_data_t levels[TEXTURE_COMPRESSION_MAX_LEVELS] = {0};
+
+    const uint8_t* data = job->compression.data;
+    for (uint32_t level = 0; level < job->mip_level_count; ++level) {
+      levels[level].data = data;
+      levels[level].size = job->compression.level_sizes[level];
+      data += job->compression.level_sizes[level];
+    }
+    return wgpu_texture_create_from_levels(
+      texture_client->wgpu_context, job->compression.format,
+      (uint32_t)job->image.image_width, (uint32_t)job->image.image_height, 1,
+      job->mip_level_count, levels, usage);
+  }
+
+  if (job->image.pixel_data == NULL) {
+    return (texture_result_t){0};
+  }
+
+  const uint32_t width         = job->image.image_width;
+  const uint32_t height        = job->image.image_height;
+  const uint32_t channel_count = job->image.channel_count;
+
+  WGPUTextureDescriptor texture_desc = {
+    .usage         = usage,
+    .dimension     = WGPUTextureDimension_2D,
+    .size          = (WGPUExtent3D){
+      .width              = width,
+      .height             = height,
+      .depthOrArrayLayers = 1,
+    },
+    .format        = options ? (options->format != WGPUTextureFormat_Undefined ?
+                                  format_for_color_space(options->format,
+                                                         options->color_space) :
+                                  WGPUTextureFormat_RGBA8Unorm) :
+                               WGPUTextureFormat_RGBA8Unorm,
+    .mipLevelCount = job->mip_level_count,
+    .sampleCount   = 1,
+  };
+  WGPUTexture texture = wgpuDeviceCreateTexture(
+    texture_client->wgpu_context->device, &texture_desc);
+
+  // Upload level 0 from the decoded image and the other levels from the mip
+  // chain
+  const uint8_t* pixels = job->image.pixel_data;
+  for (uint32_t level = 0; level < job->mip_level_count; ++level) {
+    const uint32_t level_width  = MAX(1u, width >> level);
+    const uint32_t level_height = MAX(1u, height >> level);
+    const size_t level_size
+      = (size_t)level_width * level_height * channel_count;
+    if (level == 1) {
+      pixels = job->mip_chain;
+    }
+    wgpuQueueWriteTexture(texture_client->wgpu_context->queue,
+      &(WGPUImageCopyTexture) {
+        .texture  = texture,
+        .mipLevel = level,
+        .aspect   = WGPUTextureAspect_All,
+      },
+      pixels, level_size,
+      &(WGPUTextureDataLayout){
+        .offset       = 0,
+        .bytesPerRow  = level_width * channel_count,
+        .rowsPerImage = level_height,
+      },
+      &(WGPUExtent3D){
+        .width              = level_width,
+        .height             = level_height,
+        .depthOrArrayLayers = 1,
+      });
+    if (level > 0) {
+      pixels += level_size;
+    }
+  }
+
+  return (texture_result_t){
+    .texture         = texture,
+    .width           = texture_desc.size.width,
+    .height          = texture_desc.size.height,
+    .depth           = texture_desc.size.depthOrArrayLayers,
+    .mip_level_count = texture_desc.mipLevelCount,
+    .format          = texture_desc.format,
+    .dimension       = texture_desc.dimension,
+  };
+}
+
+static texture_result_t
+wgpu_texture_load_with_stb(struct wgpu_texture_client_t* texture_client,
+                           const char* filename,
+                           struct wgpu_texture_load_options_t* options)
+{
+  if (!texture_client->wgpu_context) {
+    log_error("Cannot create new textures after object has been destroyed.");
+    return (texture_result_t){0};
+  }
+
+  // Compressed images are decoded, compressed and cached like in the jobs
+  stb_image_decode_job_t job = {
+    .filename         = filename,
+    .flip_y           = options ? options->flip_y : false,
+    .generate_mipmaps = options ? options->generate_mipmaps : false,
+  };
+  stb_image_decode_job_set_compression(&job, texture_client->wgpu_context,
+                                       options);
+  if (job.compression.format != WGPUTextureFormat_Undefined) {
+    stb_image_decode(&job);
+    texture_result_t texture_result
+      = stb_image_decode_job_upload(texture_client, &job, options);
+    stb_image_decode_job_release(&job);
+    return texture_result;
+  }
+
+  const bool flip_y = options ? options->flip_y : false;
+  stb_image_load_result_t image_load_result
+    = stb_image_load_image_from_file(filename, flip_y);
+
+  stbi_uc* pixel_data = image_load_result.pixel_data;
+  if (pixel_data == NULL) {
+    return (texture_result_t){0};
+  }
+  ASSERT(pixel_data);
+
+  const int width             = image_load_result.image_width;
+  const int height            = image_load_result.image_height;
+  const int channel_count     = image_load_result.channel_count;
+  const bool generate_mipmaps = options ? options->generate_mipmaps : false;
+  const uint32_t mip_level_count
+    = generate_mipmaps ? calculate_mip_level_count(width, height) : 1u;
+
+  const WGPUTextureUsage usage
+    = options ? (options->usage != WGPUTextureUsage_None ?
+                   options->usage :
+                   WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding) :
+                WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
+
+  WGPUExtent3D texture_size = {
+    .width              = width,
+    .height             = height,
+    .depthOrArrayLayers = 1,
+  };
+  WGPUTextureDescriptor texture_desc = {
+    .usage         = usage,
+    .dimension     = WGPUTextureDimension_2D,
+    .size          = texture_size,
+    .format        = options ? (options->format != WGPUTextureFormat_Undefined ?
+                                  format_for_color_space(options->format,
+                                                         options->color_space) :
+                                  WGPUTextureFormat_RGBA8Unorm) :
+                               WGPUTextureFormat_RGBA8Unorm,
+    .mipLevelCount = mip_level_count,
+    .sampleCount   = 1,
+  };
+  WGPUTexture texture = wgpuDeviceCreateTexture(
+    texture_client->wgpu_context->device, &texture_desc);
+
+  // Copy pixel data to texture and free allocated memory
+  wgpu_image_to_texure(texture_client->wgpu_context, texture, pixel_data,
+                       texture_size, channel_count);
+  stbi_image_free(pixel_data);
+
+  if (generate_mipmaps) {
+    if (texture_client->wgpu_mipmap_generator == NULL) {
+      texture_client->wgpu_mipmap_generator
+        = wgpu_mipmap_generator_create(texture_client->wgpu_context);
+    }
+    texture = wgpu_mipmap_generator_generate_mipmap(
+      texture_client->wgpu_mipmap_generator, texture, &texture_desc);
+  }
+
+  return (texture_result_t){
     .texture         = texture,
     .width           = texture_desc.size.width,
     .height          = texture_desc.size.height,
@@ -862,18 +1519,24 @@ wgpu_texture_cubemap_load_with_stb(wgpu_context_t* wgpu_context,
   const bool flip_y         = options ? options->flip_y : false;
   const uint16_t mapping[6] = {0, 1, flip_y ? 3 : 2, flip_y ? 2 : 3, 4, 5};
 
-  // Load images into memory
+  // Load images into memory, the faces are decoded concurrently
+  stb_image_decode_job_t decode_jobs[6] = {0};
+  for (uint32_t face = 0; face < 6; ++face) {
+    decode_jobs[face].filename = filenames[mapping[face]];
+    decode_jobs[face].flip_y   = flip_y;
+  }
+  stb_image_decode_parallel(decode_jobs, 6);
+
   stb_image_load_result_t image_load_results[6] = {0};
   for (uint32_t face = 0; face < 6; ++face) {
-    image_load_results[face]
-      = stb_image_load_image_from_file(filenames[mapping[face]], flip_y);
-    if (image_load_results[face].pixel_data == NULL) {
-      // Free pixel data for already loaded images
-      for (uint32_t prev_face = 0; prev_face < face; ++prev_face) {
-        stbi_image_free(image_load_results[prev_face].pixel_data);
+    if (decode_jobs[face].image.pixel_data == NULL) {
+      // Free pixel data for the loaded images
+      for (uint32_t i = 0; i < 6; ++i) {
+        stb_image_decode_job_release(&decode_jobs[i]);
       }
       return (texture_result_t){0};
     }
+    image_load_results[face] = decode_jobs[face].image;
   }
 
   // Use first image to determine the width and height of the image
@@ -888,7 +1551,34 @@ wgpu_texture_cubemap_load_with_stb(wgpu_context_t* wgpu_context,
            format_for_color_space(options->format, options->color_space) :
            WGPUTextureFormat_RGBA8Unorm) :
         WGPUTextureFormat_RGBA8Unorm;
-  const size_t texture_size = width * height * channel_count * sizeof(uint8_t);
+  const size_t face_size = width * height * channel_count * sizeof(uint8_t);
+
+  // Gather the faces into one layer-major allocation, which is uploaded with
+  // a single queue write covering all six layers
+  bool faces_match = true;
+  for (uint32_t face = 1; face < 6 && faces_match; ++face) {
+    const stb_image_load_result_t* image = &image_load_results[face];
+    faces_match = image->image_width == (int32_t)width
+                  && image->image_height == (int32_t)height
+                  && image->channel_count == (int32_t)channel_count;
+    if (!faces_match) {
+      log_error("Cubemap face '%s' doesn't match the size of the first face\n",
+                decode_jobs[face].filename);
+    }
+  }
+  uint8_t* pixel_data = faces_match ? (uint8_t*)malloc(face_size * 6) : NULL;
+  if (pixel_data != NULL) {
+    for (uint32_t face = 0; face < 6; ++face) {
+      memcpy(pixel_data + face * face_size,
+             image_load_results[face].pixel_data, face_size);
+    }
+  }
+  for (uint32_t face = 0; face < 6; ++face) {
+    stb_image_decode_job_release(&decode_jobs[face]);
+  }
+  if (pixel_data == NULL) {
+    return (texture_result_t){0};
+  }
 
   // Create cubemap texture
   WGPUTextureDescriptor texture_desc = {
@@ -906,78 +1596,556 @@ wgpu_texture_cubemap_load_with_stb(wgpu_context_t* wgpu_context,
   WGPUTexture texture
     = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
 
+  wgpu_image_to_texure(wgpu_context, texture, pixel_data, texture_desc.size,
+                       channel_count);
+  free(pixel_data);
+
+  return (texture_result_t){
+    .texture         = texture,
+    .width           = texture_desc.size.width,
+    .height          = texture_desc.size.height,
+    .depth           = texture_desc.size.depthOrArrayLayers,
+    .mip_level_count = texture_desc.mipLevelCount,
+    .format          = texture_desc.format,
+    .dimension       = texture_desc.dimension,
+  };
+}
+
+// Writes the six faces of a cubemap level from an equirectangular panorama,
+// the z dimension of the dispatch selects the face. The directions follow the
+// cube map face orientation of WebGPU, the panorama is filtered bilinearly
+// with textureLoad as rgba32float textures are not filterable.
+// clang-format off
+static const char* equirectangular_to_cubemap_shader_wgsl = CODE(
+  @group(0) @binding(0) var src : texture_2d<f32>;
+  @group(0) @binding(1) var dst : texture_storage_2d_array<rgba16float, write>;
+
+  const PI = 3.14159265359;
+
+  fn faceDirection(face : u32, uv : vec2<f32>) -> vec3<f32> {
+    switch (face) {
+      case 0u: { return vec3<f32>(1.0, -uv.y, -uv.x); }
+      case 1u: { return vec3<f32>(-1.0, -uv.y, uv.x); }
+      case 2u: { return vec3<f32>(uv.x, 1.0, uv.y); }
+      case 3u: { return vec3<f32>(uv.x, -1.0, -uv.y); }
+      case 4u: { return vec3<f32>(uv.x, -uv.y, 1.0); }
+      default: { return vec3<f32>(-uv.x, -uv.y, -1.0); }
+    }
+  }
+
+  fn loadWrapped(pos : vec2<i32>, size : vec2<i32>) -> vec4<f32> {
+    let x = (pos.x % size.x + size.x) % size.x;
+    let y = clamp(pos.y, 0, size.y - 1);
+    return textureLoad(src, vec2<i32>(x, y), 0);
+  }
+
+  @compute @workgroup_size(8, 8)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let faceSize = textureDimensions(dst).x;
+    if (any(id.xy >= vec2<u32>(faceSize))) {
+      return;
+    }
+    let uv = (vec2<f32>(id.xy) + 0.5) / f32(faceSize) * 2.0 - 1.0;
+    let dir = normalize(faceDirection(id.z, uv));
+    let srcUV = vec2<f32>(atan2(dir.z, dir.x) / (2.0 * PI) + 0.5,
+                          acos(clamp(dir.y, -1.0, 1.0)) / PI);
+    let srcSize = vec2<i32>(textureDimensions(src));
+    let texel = srcUV * vec2<f32>(srcSize) - 0.5;
+    let base = vec2<i32>(floor(texel));
+    let t = fract(texel);
+    let color = mix(mix(loadWrapped(base, srcSize),
+                        loadWrapped(base + vec2<i32>(1, 0), srcSize), t.x),
+                    mix(loadWrapped(base + vec2<i32>(0, 1), srcSize),
+                        loadWrapped(base + vec2<i32>(1, 1), srcSize), t.x),
+                    t.y);
+    textureStore(dst, vec2<i32>(id.xy), i32(id.z), vec4<f32>(color.rgb, 1.0));
+  }
+);
+// clang-format on
+
+static texture_result_t wgpu_texture_cubemap_load_from_equirectangular(
+  struct wgpu_texture_client_t* texture_client, const char* filename,
+  struct wgpu_texture_load_options_t* options)
+{
+  wgpu_context_t* wgpu_context = texture_client->wgpu_context;
+
+  // Radiance HDR panoramas are decoded to floats, other images to 8 bits
+  const bool flip_y = options ? options->flip_y : false;
+  const bool is_hdr = stbi_is_hdr(filename);
+  int width = 0, height = 0, read_comps = 4;
+  stbi_set_flip_vertically_on_load_thread(flip_y);
+  void* pixel_data
+    = is_hdr ?
+        (void*)stbi_loadf(filename, &width, &height, &read_comps,
+                          STBI_rgb_alpha) :
+        (void*)stbi_load(filename, &width, &height, &read_comps,
+                         STBI_rgb_alpha);
+  if (pixel_data == NULL) {
+    log_error("Couldn't load '%s'\n", filename);
+    return (texture_result_t){0};
+  }
+
+  // Upload the panorama, the color space of 8 bit images selects whether the
+  // texels are decoded from sRGB when loaded in the shader
+  const color_space_enum_t color_space
+    = options ? options->color_space : COLOR_SPACE_UNDEFINED;
+  const WGPUExtent3D panorama_size = {
+    .width              = (uint32_t)width,
+    .height             = (uint32_t)height,
+    .depthOrArrayLayers = 1,
+  };
+  WGPUTexture panorama = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "equirectangular_panorama_texture",
+      .usage         = WGPUTextureUsage_CopyDst
+                       | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = panorama_size,
+      .format        = is_hdr ? WGPUTextureFormat_RGBA32Float :
+                                format_for_color_space(
+                                  WGPUTextureFormat_RGBA8Unorm, color_space),
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(panorama != NULL);
+  wgpu_image_to_texure(wgpu_context, panorama, pixel_data, panorama_size,
+                       is_hdr ? 4 * sizeof(float) : 4);
+  stbi_image_free(pixel_data);
+
+  // The faces cover 90 degrees each, a quarter of the panorama width keeps
+  // the texel density of the equator
+  const uint32_t face_size     = MAX(1u, (uint32_t)width / 4u);
+  const bool generate_mipmaps  = options ? options->generate_mipmaps : false;
+  const WGPUTextureUsage usage
+    = options ? options->usage : WGPUTextureUsage_None;
+  WGPUTextureDescriptor texture_desc = {
+    .label         = "equirectangular_cubemap_texture",
+    .size          = (WGPUExtent3D) {
+      .width              = face_size,
+      .height             = face_size,
+      .depthOrArrayLayers = 6u,
+     },
+    .mipLevelCount = generate_mipmaps ?
+                       calculate_mip_level_count(face_size, face_size) :
+                       1u,
+    .sampleCount   = 1,
+    .dimension     = WGPUTextureDimension_2D,
+    .format        = WGPUTextureFormat_RGBA16Float,
+    .usage         = usage | WGPUTextureUsage_CopyDst
+                     | WGPUTextureUsage_TextureBinding
+                     | WGPUTextureUsage_StorageBinding,
+  };
+  WGPUTexture texture
+    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+  ASSERT(texture != NULL);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "equirectangular_to_cubemap_shader",
+                    .wgsl_code.source = equirectangular_to_cubemap_shader_wgsl,
+                    .entry            = "main",
+                  });
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "equirectangular_to_cubemap_pipeline",
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+
+  WGPUTextureView src_view = wgpuTextureCreateView(panorama, NULL);
+  WGPUTextureView dst_view = wgpuTextureCreateView(
+    texture, &(WGPUTextureViewDescriptor){
+               .label           = "equirectangular_cubemap_faces_view",
+               .format          = texture_desc.format,
+               .dimension       = WGPUTextureViewDimension_2DArray,
+               .baseMipLevel    = 0,
+               .mipLevelCount   = 1,
+               .baseArrayLayer  = 0,
+               .arrayLayerCount = 6u,
+               .aspect          = WGPUTextureAspect_All,
+             });
+  WGPUBindGroupLayout bind_group_layout
+    = wgpuComputePipelineGetBindGroupLayout(pipeline, 0);
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device,
+    &(WGPUBindGroupDescriptor){
+      .layout     = bind_group_layout,
+      .entryCount = 2,
+      .entries    = (WGPUBindGroupEntry[2]){
+        {.binding = 0, .textureView = src_view},
+        {.binding = 1, .textureView = dst_view},
+      },
+    });
+  ASSERT(bind_group != NULL);
+
+  // One dispatch writes all six faces of the first level
+  const uint32_t group_count
+    = (face_size + COMPUTE_MIPMAP_WORKGROUP_SIZE - 1)
+      / COMPUTE_MIPMAP_WORKGROUP_SIZE;
   WGPUCommandEncoder cmd_encoder
     = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  WGPUComputePassEncoder pass_encoder
+    = wgpuCommandEncoderBeginComputePass(cmd_encoder, NULL);
+  wgpuComputePassEncoderSetPipeline(pass_encoder, pipeline);
+  wgpuComputePassEncoderSetBindGroup(pass_encoder, 0, bind_group, 0, NULL);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, group_count,
+                                           group_count, 6u);
+  wgpuComputePassEncoderEnd(pass_encoder);
+  WGPU_RELEASE_RESOURCE(ComputePassEncoder, pass_encoder)
+  WGPUCommandBuffer command_buffer
+    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
+  ASSERT(command_buffer != NULL);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
 
-  // Create a host-visible staging buffers that contains the raw image data for
-  // each face of the cubemap
-  WGPUBuffer staging_buffers[6] = {0};
-  for (uint32_t face = 0; face < depth; ++face) {
-    WGPUBufferDescriptor staging_buffer_desc = {
-      .usage            = WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite,
-      .size             = texture_size,
-      .mappedAtCreation = true,
-    };
-    staging_buffers[face]
-      = wgpuDeviceCreateBuffer(wgpu_context->device, &staging_buffer_desc);
-    ASSERT(staging_buffers[face])
-  }
-
-  for (uint32_t face = 0; face < depth; ++face) {
-    // Copy texture data into staging buffer
-    void* mapping
-      = wgpuBufferGetMappedRange(staging_buffers[face], 0, texture_size);
-    ASSERT(mapping)
-    memcpy(mapping, image_load_results[face].pixel_data, texture_size);
-    wgpuBufferUnmap(staging_buffers[face]);
-
-    // Upload staging buffer to texture
-    wgpuCommandEncoderCopyBufferToTexture(cmd_encoder,
-      // Source
-      &(WGPUImageCopyBuffer) {
-        .buffer = staging_buffers[face],
-        .layout = (WGPUTextureDataLayout) {
+  // Cleanup, the submitted commands keep their own references
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+  WGPU_RELEASE_RESOURCE(TextureView, dst_view)
+  WGPU_RELEASE_RESOURCE(TextureView, src_view)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, pipeline)
+  WGPU_RELEASE_RESOURCE(Texture, panorama)
+
+  // The faces are written as storage texture, the compute path of the mipmap
+  // generator reduces the remaining levels in place
+  if (generate_mipmaps) {
+    texture = wgpu_mipmap_generator_generate_mipmap(
+      texture_client->wgpu_mipmap_generator, texture, &texture_desc);
+  }
+
+  return (texture_result_t){
+    .texture         = texture,
+    .width           = texture_desc.size.width,
+    .height          = texture_desc.size.height,
+    .depth           = texture_desc.size.depthOrArrayLayers,
+    .mip_level_count = texture_desc.mipLevelCount,
+    .format          = texture_desc.format,
+    .dimension       = texture_desc.dimension,
+  };
+}
+
+static ktxResult load_ktx_file(const char* filename, ktxTexture** target)
+{
+  ktxResult result = KTX_SUCCESS;
+  if (!file_exists(filename)) {
+    log_fatal("Could not load texture from %s", filename);
+    return KTX_FILE_OPEN_FAILED;
+  }
+  result = ktxTexture_CreateFromNamedFile(
+    filename, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
+  return result;
+}
+
+static texture_result_t
+wgpu_texture_load_from_ktx_file(wgpu_context_t* wgpu_context,
+                                const char* filename,
+                                struct wgpu_texture_load_options_t* options)
+{
+  ktxTexture* ktx_texture;
+  ktxResult result = load_ktx_file(filename, &ktx_texture);
+  assert(result == KTX_SUCCESS);
+
+  ktx_uint8_t* ktx_texture_data = ktxTexture_GetData(ktx_texture);
+
+  // All levels stored in the file are uploaded, 2D textures without a mip
+  // chain get their mipmaps generated on the GPU
+  const uint32_t face_count = ktx_texture->isCubemap ? 6u : 1u;
+  const bool generate_mipmaps
+    = !ktx_texture->isCubemap && ktx_texture->numLevels == 1;
+  const WGPUTextureUsage usage
+    = options ? (options->usage != WGPUTextureUsage_None ?
+                   options->usage :
+                   WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding) :
+                WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding;
+  WGPUTextureDescriptor texture_desc = {
+    .size          = (WGPUExtent3D) {
+      .width               = ktx_texture->baseWidth,
+      .height              = ktx_texture->baseHeight,
+      .depthOrArrayLayers  = face_count,
+     },
+    .mipLevelCount = generate_mipmaps ?
+                       calculate_mip_level_count(ktx_texture->baseWidth,
+                                                 ktx_texture->baseHeight) :
+                       ktx_texture->numLevels,
+    .sampleCount   = 1,
+    .dimension     = WGPUTextureDimension_2D,
+    .format        = WGPUTextureFormat_RGBA8Unorm,
+    .usage         = usage,
+  };
+  WGPUTexture texture
+    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+
+  // Queue writes take tightly packed rows, so the width doesn't need to be
+  // padded to a multiple of 256 bytes
+  for (uint32_t level = 0; level < ktx_texture->numLevels; ++level) {
+    const uint32_t width  = MAX(1u, ktx_texture->baseWidth >> level);
+    const uint32_t height = MAX(1u, ktx_texture->baseHeight >> level);
+    for (uint32_t face = 0; face < face_count; ++face) {
+      ktx_size_t offset;
+      KTX_error_code offset_result
+        = ktxTexture_GetImageOffset(ktx_texture, level, 0, face, &offset);
+      assert(offset_result == KTX_SUCCESS);
+      UNUSED_VAR(offset_result);
+
+      wgpuQueueWriteTexture(wgpu_context->queue,
+        &(WGPUImageCopyTexture) {
+          .texture  = texture,
+          .mipLevel = level,
+          .origin   = (WGPUOrigin3D){.z = face},
+          .aspect   = WGPUTextureAspect_All,
+        },
+        ktx_texture_data + offset,
+        ktxTexture_GetImageSize(ktx_texture, level),
+        &(WGPUTextureDataLayout){
           .offset       = 0,
-          .bytesPerRow  = width * channel_count,
+          .bytesPerRow  = ktxTexture_GetRowPitch(ktx_texture, level),
           .rowsPerImage = height,
         },
-      },
-      // Destination
-      &(WGPUImageCopyTexture){
-        .texture = texture,
-        .mipLevel = 0,
-        .origin = (WGPUOrigin3D) {
-          .x = 0,
-          .y = 0,
-          .z = face,
-        },
-        .aspect = WGPUTextureAspect_All,
-      },
-      // Copy size
-      &(WGPUExtent3D){
-        .width              = width,
-        .height             = height,
-        .depthOrArrayLayers = 1,
-      });
+        &(WGPUExtent3D){
+          .width              = width,
+          .height             = height,
+          .depthOrArrayLayers = 1,
+        });
+    }
   }
 
-  WGPUCommandBuffer command_buffer
-    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
-  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  ktxTexture_Destroy(ktx_texture);
 
-  // Sumbit commmand buffer and cleanup
-  ASSERT(command_buffer != NULL)
+  if (generate_mipmaps) {
+    struct wgpu_texture_client_t* texture_client = wgpu_context->texture_client;
+    if (texture_client->wgpu_mipmap_generator == NULL) {
+      texture_client->wgpu_mipmap_generator
+        = wgpu_mipmap_generator_create(wgpu_context);
+    }
+    texture = wgpu_mipmap_generator_generate_mipmap(
+      texture_client->wgpu_mipmap_generator, texture, &texture_desc);
+  }
 
-  // Submit to the queue
-  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  return (texture_result_t){
+    .texture         = texture,
+    .width           = texture_desc.size.width,
+    .height          = texture_desc.size.height,
+    .depth           = texture_desc.size.depthOrArrayLayers,
+    .mip_level_count = texture_desc.mipLevelCount,
+    .format          = texture_desc.format,
+    .dimension       = texture_desc.dimension,
+  };
+}
 
-  // Release command buffer
-  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+/*
+ * KTX2 container
+ * @see https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+ */
+#define KTX2_IDENTIFIER_SIZE 12u
+#define KTX2_HEADER_SIZE 80u
+#define KTX2_LEVEL_INDEX_ENTRY_SIZE 24u
+#define KTX2_VK_FORMAT_UNDEFINED 0u
+#define KTX2_SUPERCOMPRESSION_NONE 0u
+#define KTX2_SUPERCOMPRESSION_ZSTD 2u
+#define KTX2_MAX_LEVELS 16u
+
+static const uint8_t ktx2_identifier[KTX2_IDENTIFIER_SIZE] = {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n',
+};
+
+typedef struct ktx2_header_t {
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+} ktx2_header_t;
+
+static bool is_ktx2_data(const uint8_t* data, uint64_t size)
+{
+  return size >= KTX2_HEADER_SIZE
+         && memcmp(data, ktx2_identifier, KTX2_IDENTIFIER_SIZE) == 0;
+}
 
-  // Clean up staging resources and pixel data
-  for (uint32_t face = 0; face < depth; ++face) {
-    WGPU_RELEASE_RESOURCE(Buffer, staging_buffers[face]);
-    stbi_image_free(image_load_results[face].pixel_data);
+/**
+ * @brief Returns the WebGPU format of a Vulkan format used in KTX2 files, or
+ * WGPUTextureFormat_Undefined when the format has no WebGPU equivalent.
+ */
+static WGPUTextureFormat ktx2_vk_format_to_wgpu(uint32_t vk_format)
+{
+  switch (vk_format) {
+    // clang-format off
+    case 9:   return WGPUTextureFormat_R8Unorm;
+    case 16:  return WGPUTextureFormat_RG8Unorm;
+    case 37:  return WGPUTextureFormat_RGBA8Unorm;
+    case 43:  return WGPUTextureFormat_RGBA8UnormSrgb;
+    case 44:  return WGPUTextureFormat_BGRA8Unorm;
+    case 50:  return WGPUTextureFormat_BGRA8UnormSrgb;
+    case 97:  return WGPUTextureFormat_RGBA16Float;
+    case 109: return WGPUTextureFormat_RGBA32Float;
+    case 133: return WGPUTextureFormat_BC1RGBAUnorm;
+    case 134: return WGPUTextureFormat_BC1RGBAUnormSrgb;
+    case 135: return WGPUTextureFormat_BC2RGBAUnorm;
+    case 136: return WGPUTextureFormat_BC2RGBAUnormSrgb;
+    case 137: return WGPUTextureFormat_BC3RGBAUnorm;
+    case 138: return WGPUTextureFormat_BC3RGBAUnormSrgb;
+    case 139: return WGPUTextureFormat_BC4RUnorm;
+    case 140: return WGPUTextureFormat_BC4RSnorm;
+    case 141: return WGPUTextureFormat_BC5RGUnorm;
+    case 142: return WGPUTextureFormat_BC5RGSnorm;
+    case 143: return WGPUTextureFormat_BC6HRGBUfloat;
+    case 144: return WGPUTextureFormat_BC6HRGBFloat;
+    case 145: return WGPUTextureFormat_BC7RGBAUnorm;
+    case 146: return WGPUTextureFormat_BC7RGBAUnormSrgb;
+    case 147: return WGPUTextureFormat_ETC2RGB8Unorm;
+    case 148: return WGPUTextureFormat_ETC2RGB8UnormSrgb;
+    case 149: return WGPUTextureFormat_ETC2RGB8A1Unorm;
+    case 150: return WGPUTextureFormat_ETC2RGB8A1UnormSrgb;
+    case 151: return WGPUTextureFormat_ETC2RGBA8Unorm;
+    case 152: return WGPUTextureFormat_ETC2RGBA8UnormSrgb;
+    case 153: return WGPUTextureFormat_EACR11Unorm;
+    case 154: return WGPUTextureFormat_EACR11Snorm;
+    case 155: return WGPUTextureFormat_EACRG11Unorm;
+    case 156: return WGPUTextureFormat_EACRG11Snorm;
+    case 157: return WGPUTextureFormat_ASTC4x4Unorm;
+    case 158: return WGPUTextureFormat_ASTC4x4UnormSrgb;
+    default:  return WGPUTextureFormat_Undefined;
+      // clang-format on
+  }
+}
+
+/**
+ * @brief Returns the texel block size and the number of bytes per block of
+ * the formats loaded from KTX2 files. Uncompressed formats have 1x1 blocks.
+ */
+static uint32_t texture_format_block_bytes(WGPUTextureFormat format,
+                                           uint32_t* block_size)
+{
+  *block_size = 4u;
+  switch (format) {
+    case WGPUTextureFormat_R8Unorm:
+      *block_size = 1u;
+      return 1u;
+    case WGPUTextureFormat_RG8Unorm:
+      *block_size = 1u;
+      return 2u;
+    case WGPUTextureFormat_RGBA8Unorm:
+    case WGPUTextureFormat_RGBA8UnormSrgb:
+    case WGPUTextureFormat_BGRA8Unorm:
+    case WGPUTextureFormat_BGRA8UnormSrgb:
+      *block_size = 1u;
+      return 4u;
+    case WGPUTextureFormat_RGBA16Float:
+      *block_size = 1u;
+      return 8u;
+    case WGPUTextureFormat_RGBA32Float:
+      *block_size = 1u;
+      return 16u;
+    case WGPUTextureFormat_BC1RGBAUnorm:
+    case WGPUTextureFormat_BC1RGBAUnormSrgb:
+    case WGPUTextureFormat_BC4RUnorm:
+    case WGPUTextureFormat_BC4RSnorm:
+    case WGPUTextureFormat_ETC2RGB8Unorm:
+    case WGPUTextureFormat_ETC2RGB8UnormSrgb:
+    case WGPUTextureFormat_ETC2RGB8A1Unorm:
+    case WGPUTextureFormat_ETC2RGB8A1UnormSrgb:
+    case WGPUTextureFormat_EACR11Unorm:
+    case WGPUTextureFormat_EACR11Snorm:
+      return 8u;
+    default:
+      return 16u;
+  }
+}
+
+/**
+ * @brief Returns whether a texture format can be sampled on the device of the
+ * texture client. Compressed formats need to be in the supported format list.
+ */
+static bool
+wgpu_texture_client_supports_format(struct wgpu_texture_client_t* client,
+                                    WGPUTextureFormat format)
+{
+  uint32_t block_size = 1u;
+  texture_format_block_bytes(format, &block_size);
+  if (block_size == 1u) {
+    return true;
+  }
+  for (size_t i = 0; i < client->supported_format_list.count; ++i) {
+    if (client->supported_format_list.values[i] == format) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Creates a 2D or cubemap texture and uploads all of its mip levels,
+ * one queue write per level covering all faces.
+ */
+static texture_result_t wgpu_texture_create_from_levels(
+  wgpu_context_t* wgpu_context, WGPUTextureFormat format, uint32_t width,
+  uint32_t height, uint32_t face_count, uint32_t level_count,
+  const texture_level_data_t* levels, WGPUTextureUsage usage)
+{
+  uint32_t block_size        = 1u;
+  const uint32_t block_bytes = texture_format_block_bytes(format, &block_size);
+  if (width % block_size != 0 || height % block_size != 0) {
+    log_error("Texture size %ux%u is not a multiple of the block size %u",
+              width, height, block_size);
+    return (texture_result_t){0};
+  }
+
+  WGPUTextureDescriptor texture_desc = {
+    .size          = (WGPUExtent3D) {
+      .width               = width,
+      .height              = height,
+      .depthOrArrayLayers  = face_count,
+     },
+    .mipLevelCount = level_count,
+    .sampleCount   = 1,
+    .dimension     = WGPUTextureDimension_2D,
+    .format        = format,
+    .usage         = usage != WGPUTextureUsage_None ?
+                       usage :
+                       WGPUTextureUsage_CopyDst
+                         | WGPUTextureUsage_TextureBinding,
+  };
+  WGPUTexture texture
+    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+
+  for (uint32_t level = 0; level < level_count; ++level) {
+    // Copies of compressed levels cover whole blocks
+    const uint32_t blocks_x
+      = (MAX(1u, width >> level) + block_size - 1) / block_size;
+    const uint32_t blocks_y
+      = (MAX(1u, height >> level) + block_size - 1) / block_size;
+    const size_t image_size = (size_t)blocks_x * blocks_y * block_bytes;
+    if (levels[level].size < image_size * face_count) {
+      log_error("Mip level %u holds %zu bytes, %zu expected", level,
+                levels[level].size, image_size * face_count);
+      break;
+    }
+    wgpuQueueWriteTexture(wgpu_context->queue,
+      &(WGPUImageCopyTexture) {
+        .texture  = texture,
+        .mipLevel = level,
+        .aspect   = WGPUTextureAspect_All,
+      },
+      levels[level].data, image_size * face_count,
+      &(WGPUTextureDataLayout){
+        .offset       = 0,
+        .bytesPerRow  = blocks_x * block_bytes,
+        .rowsPerImage = blocks_y,
+      },
+      &(WGPUExtent3D){
+        .width              = blocks_x * block_size,
+        .height             = blocks_y * block_size,
+        .depthOrArrayLayers = face_count,
+      });
   }
 
   return (texture_result_t){
@@ -991,372 +2159,387 @@ wgpu_texture_cubemap_load_with_stb(wgpu_context_t* wgpu_context,
   };
 }
 
-static ktxResult load_ktx_file(const char* filename, ktxTexture** target)
+/*
+ * Basis Universal transcode cache
+ *
+ * The transcoded levels are written to WGPU_TEXTURE_CACHE_DIRECTORY, one cache
+ * file per source file and transcode format. The cache is used when the hash
+ * of the source file and the transcoded layout still match.
+ */
+#define BASISU_CACHE_MAGIC 0x43585442u /* "BTXC" */
+#define BASISU_CACHE_VERSION 1u
+#define BASISU_CACHE_FILE_EXTENSION ".cache"
+#define BASISU_HASH_SEED 0xcbf29ce484222325ull /* FNV-1a offset basis */
+
+typedef struct basisu_cache_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint64_t level_sizes[BASISU_MAX_MIPMAPS];
+} basisu_cache_header_t;
+
+static void basisu_cache_get_filename(const char* filename,
+                                      WGPUTextureFormat format,
+                                      char* cache_filename)
 {
-  ktxResult result = KTX_SUCCESS;
-  if (!file_exists(filename)) {
-    log_fatal("Could not load texture from %s", filename);
-    return KTX_FILE_OPEN_FAILED;
-  }
-  result = ktxTexture_CreateFromNamedFile(
-    filename, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-  return result;
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%u%s", (uint32_t)format,
+           BASISU_CACHE_FILE_EXTENSION);
+  file_get_cache_filename(WGPU_TEXTURE_CACHE_DIRECTORY, filename, suffix,
+                          cache_filename, STRMAX);
 }
 
-static texture_result_t
-wgpu_texture_load_from_ktx_file(wgpu_context_t* wgpu_context,
-                                const char* filename)
+/**
+ * @brief Creates the texture from the cache file, returns false if there is no
+ * valid cache for the given header.
+ */
+static bool basisu_cache_load(wgpu_context_t* wgpu_context,
+                              const char* cache_filename,
+                              const basisu_cache_header_t* expected_header,
+                              WGPUTextureFormat format, WGPUTextureUsage usage,
+                              texture_result_t* texture_result)
 {
-  ktxTexture* ktx_texture;
-  ktxResult result = load_ktx_file(filename, &ktx_texture);
-  assert(result == KTX_SUCCESS);
-
-  ktx_uint8_t* ktx_texture_data = ktxTexture_GetData(ktx_texture);
+  file_mapping_t mapping = {0};
+  if (!file_exists(cache_filename) || !file_map(cache_filename, &mapping)) {
+    return false;
+  }
 
-  // WebGPU requires that the bytes per row is a multiple of 256
-  uint32_t resized_width = make_multiple_of_256(ktx_texture->baseWidth);
-
-  // Get properties required for using and upload texture data from the ktx
-  // texture object
-  uint32_t texture_width
-    = ktx_texture->isCubemap ? ktx_texture->baseWidth : resized_width;
-  uint32_t texture_height = ktx_texture->baseHeight;
-  uint32_t texture_depth  = ktx_texture->isCubemap ? 6u : 1u;
-  uint32_t texture_mip_level_count
-    = ktx_texture->isCubemap ?
-        1u :
-        calculate_mip_level_count(ktx_texture->baseWidth,
-                                  ktx_texture->baseHeight);
-  WGPUTextureFormat texture_format = WGPUTextureFormat_RGBA8Unorm;
+  uint64_t data_size = 0;
+  for (uint32_t i = 0; i < expected_header->level_count; ++i) {
+    data_size += expected_header->level_sizes[i];
+  }
+  if (mapping.size < sizeof(basisu_cache_header_t) + data_size
+      || memcmp(mapping.data, expected_header, sizeof(basisu_cache_header_t))
+           != 0) {
+    file_unmap(&mapping);
+    return false;
+  }
 
-  WGPUTextureDescriptor texture_desc = {
-    .size          = (WGPUExtent3D) {
-      .width               = texture_width,
-      .height              = texture_height,
-      .depthOrArrayLayers  = texture_depth,
-     },
-    .mipLevelCount = texture_mip_level_count,
-    .sampleCount   = 1,
-    .dimension     = WGPUTextureDimension_2D,
-    .format        = texture_format,
-    .usage         = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
-  };
-  WGPUTexture texture
-    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
+  texture_level_data_t levels[BASISU_MAX_MIPMAPS] = {0};
+  const uint8_t* data = mapping.data + sizeof(basisu_cache_header_t);
+  for (uint32_t i = 0; i < expected_header->level_count; ++i) {
+    levels[i].data = data;
+    levels[i].size = (size_t)expected_header->level_sizes[i];
+    data += expected_header->level_sizes[i];
+  }
+  *texture_result = wgpu_texture_create_from_levels(
+    wgpu_context, format, expected_header->width, expected_header->height,
+    expected_header->face_count, expected_header->level_count, levels, usage);
+  file_unmap(&mapping);
 
-  WGPUCommandEncoder cmd_encoder
-    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  return texture_result->texture != NULL;
+}
 
-  if (ktx_texture->isCubemap) {
-    // Create a host-visible staging buffer that contains the raw image data
-    ktx_size_t ktx_texture_size              = ktxTexture_GetSize(ktx_texture);
-    WGPUBufferDescriptor staging_buffer_desc = {
-      .usage            = WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite,
-      .size             = ktx_texture_size,
-      .mappedAtCreation = true,
-    };
-    WGPUBuffer staging_buffer
-      = wgpuDeviceCreateBuffer(wgpu_context->device, &staging_buffer_desc);
-    ASSERT(staging_buffer)
-
-    // Copy texture data into staging buffer
-    void* mapping
-      = wgpuBufferGetMappedRange(staging_buffer, 0, ktx_texture_size);
-    ASSERT(mapping)
-    memcpy(mapping, ktx_texture_data, ktx_texture_size);
-    wgpuBufferUnmap(staging_buffer);
-
-    for (uint32_t face = 0; face < texture_depth; ++face) {
-      for (uint32_t level = 0; level < texture_mip_level_count; ++level) {
-        uint32_t width  = ktx_texture->baseWidth >> level;
-        uint32_t height = ktx_texture->baseHeight >> level;
-
-        ktx_size_t offset;
-        KTX_error_code result
-          = ktxTexture_GetImageOffset(ktx_texture, level, 0, face, &offset);
-        assert(result == KTX_SUCCESS);
-
-        // Upload staging buffer to texture
-        wgpuCommandEncoderCopyBufferToTexture(cmd_encoder,
-          // Source
-          &(WGPUImageCopyBuffer) {
-            .buffer = staging_buffer,
-            .layout = (WGPUTextureDataLayout) {
-              .offset = offset,
-              .bytesPerRow = width * 4,
-              .rowsPerImage= height,
-            },
-          },
-          // Destination
-          &(WGPUImageCopyTexture){
-            .texture = texture,
-            .mipLevel = level,
-            .origin = (WGPUOrigin3D) {
-              .x=0,
-              .y=0,
-              .z=face,
-            },
-            .aspect = WGPUTextureAspect_All,
-          },
-          // Copy size
-          &(WGPUExtent3D){
-            .width               = MAX(1u, width),
-            .height              = MAX(1u, height),
-            .depthOrArrayLayers  = 1,
-          });
-      }
+static void basisu_cache_write(const char* cache_filename,
+                               const basisu_cache_header_t* header,
+                               const uint8_t* data, size_t data_size)
+{
+  // Write to a temporary file first so that an interrupted write never leaves
+  // a truncated cache file behind
+  char tmp_filename[STRMAX];
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", cache_filename);
+  FILE* file = fopen(tmp_filename, "wb");
+  bool ok    = file != NULL;
+  if (ok) {
+    ok = fwrite(header, sizeof(*header), 1, file) == 1
+         && fwrite(data, 1, data_size, file) == data_size;
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && (rename(tmp_filename, cache_filename) == 0);
+    if (!ok) {
+      remove(tmp_filename);
     }
+  }
+  if (!ok) {
+    log_warn("Could not write texture cache file: %s\n", cache_filename);
+  }
+}
 
-    WGPU_RELEASE_RESOURCE(Buffer, staging_buffer);
-  }
-  else { /* WGPUTextureDimension_2D */
-    // Generate Mipmap
-    uint8_t** resized_vec = NULL;
-    generate_mipmap(ktx_texture_data, ktx_texture->baseWidth,
-                    ktx_texture->baseHeight, 0, &resized_vec, resized_width,
-                    ktx_texture->baseHeight, 0, 4, true);
-
-    // Setup buffer copy regions for each face including all of its mip levels
-    // and copy the texture regions from the staging buffer into the texture
-    for (uint32_t face = 0; face < texture_depth; ++face) {
-      for (uint32_t level = 0; level < texture_mip_level_count; ++level) {
-        uint32_t width  = texture_width >> level;
-        uint32_t height = texture_height >> level;
-        if (height == 0) {
-          height = 1;
-        }
-
-        // Create a host-visible staging buffer that contains the raw image data
-        size_t ktx_texture_size                  = texture_width * height * 4;
-        WGPUBufferDescriptor staging_buffer_desc = {
-          .usage = WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite,
-          .size  = ktx_texture_size,
-          .mappedAtCreation = true,
-        };
-        WGPUBuffer staging_buffer
-          = wgpuDeviceCreateBuffer(wgpu_context->device, &staging_buffer_desc);
-        ASSERT(staging_buffer)
-
-        // Copy texture data into staging buffer
-        void* mapping
-          = wgpuBufferGetMappedRange(staging_buffer, 0, ktx_texture_size);
-        ASSERT(mapping)
-        memcpy(mapping, resized_vec[level], ktx_texture_size);
-        wgpuBufferUnmap(staging_buffer);
-
-        // Upload statging buffer to texture
-        wgpuCommandEncoderCopyBufferToTexture(cmd_encoder,
-          // Source
-          &(WGPUImageCopyBuffer) {
-            .buffer = staging_buffer,
-            .layout = (WGPUTextureDataLayout) {
-              .offset = 0,
-              .bytesPerRow = texture_width * 4,
-              .rowsPerImage= height,
-            },
-          },
-          // Destination
-          &(WGPUImageCopyTexture){
-            .texture = texture,
-            .mipLevel = level,
-            .origin = (WGPUOrigin3D) {
-              .x=0,
-              .y=0,
-              .z=face,
-            },
-            .aspect = WGPUTextureAspect_All,
-          },
-          // Copy size
-          &(WGPUExtent3D){
-            .width               = MAX(1u, width),
-            .height              = MAX(1u, height),
-            .depthOrArrayLayers  = 1,
-          });
-
-        WGPU_RELEASE_RESOURCE(Buffer, staging_buffer);
-      }
-    }
-    // Free image data after upload to GPU
-    destroy_image_data(resized_vec, resized_width, ktx_texture->baseHeight);
+/* One image of a mip level, transcoded by a job */
+typedef struct basisu_transcode_job_t {
+  basisu_transcoder_t* transcoder;
+  uint32_t level;
+  uint32_t image;
+  uint8_t* output;
+  bool success;
+} basisu_transcode_job_t;
+
+static void basisu_transcode_jobs_run(void* user_data, uint32_t begin,
+                                      uint32_t end)
+{
+  basisu_transcode_job_t* jobs = user_data;
+  for (uint32_t i = begin; i < end; ++i) {
+    jobs[i].success = basisu_transcoder_transcode_image(
+      jobs[i].transcoder, jobs[i].level, jobs[i].image, jobs[i].output);
   }
+}
 
-  WGPUCommandBuffer command_buffer
-    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
-  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+/**
+ * @brief Creates a texture from a .basis file or a Basis Universal KTX2 file.
+ * The levels are transcoded to a format of the supported format list, all
+ * images of all levels in parallel on the job system, and then cached. The
+ * texture is created with the usage, or the default one for
+ * WGPUTextureUsage_None, in the sRGB or linear variant of the transcode format
+ * selected by the color space.
+ */
+static texture_result_t wgpu_texture_load_from_basisu_data(
+  wgpu_context_t* wgpu_context, const char* filename,
+  const file_mapping_t* mapping, WGPUTextureUsage usage,
+  color_space_enum_t color_space)
+{
+  struct wgpu_texture_client_t* texture_client = wgpu_context->texture_client;
 
-  // Sumbit commmand buffer and cleanup
-  ASSERT(command_buffer != NULL)
+  basisu_setup();
+  basisu_image_desc_t image_desc  = {0};
+  basisu_transcoder_t* transcoder = basisu_transcoder_create(
+    (basisu_data_t){
+      .ptr  = mapping->data,
+      .size = mapping->size,
+    },
+    texture_client->supported_format_list.values,
+    (uint32_t)texture_client->supported_format_list.count, true, &image_desc);
+  if (transcoder == NULL || image_desc.layer_count > 1) {
+    log_error("Could not transcode texture from %s", filename);
+    if (transcoder != NULL) {
+      basisu_transcoder_destroy(transcoder);
+    }
+    basisu_shutdown();
+    return (texture_result_t){0};
+  }
 
-  // Submit to the queue
-  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  // The cache is keyed by the source data and the transcode format
+  basisu_cache_header_t cache_header = {
+    .magic       = BASISU_CACHE_MAGIC,
+    .version     = BASISU_CACHE_VERSION,
+    .source_hash = wgpu_render_bundle_hash(BASISU_HASH_SEED, mapping->data,
+                                           (size_t)mapping->size),
+    .format      = (uint32_t)image_desc.format,
+    .width       = image_desc.width,
+    .height      = image_desc.height,
+    .level_count = image_desc.level_count,
+    .layer_count = image_desc.layer_count,
+    .face_count  = image_desc.face_count,
+  };
+  size_t data_size = 0;
+  for (uint32_t level = 0; level < image_desc.level_count; ++level) {
+    cache_header.level_sizes[level] = image_desc.levels[level].size;
+    data_size += image_desc.levels[level].size;
+  }
+  char cache_filename[STRMAX];
+  basisu_cache_get_filename(filename, image_desc.format, cache_filename);
+  const WGPUTextureFormat format
+    = format_for_color_space(image_desc.format, color_space);
+  texture_result_t texture_result = {0};
+  if (basisu_cache_load(wgpu_context, cache_filename, &cache_header, format,
+                        usage, &texture_result)) {
+    basisu_transcoder_destroy(transcoder);
+    basisu_shutdown();
+    return texture_result;
+  }
 
-  // Release command buffer
-  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+  // One job per image of each level, the largest levels come first
+  const uint32_t image_count = image_desc.layer_count * image_desc.face_count;
+  const uint32_t job_count   = image_desc.level_count * image_count;
+  uint8_t* data              = malloc(data_size);
+  basisu_transcode_job_t* jobs
+    = calloc(job_count, sizeof(basisu_transcode_job_t));
+  texture_level_data_t levels[BASISU_MAX_MIPMAPS] = {0};
+  size_t offset                                   = 0;
+  for (uint32_t level = 0; level < image_desc.level_count; ++level) {
+    const size_t image_size = image_desc.levels[level].size / image_count;
+    levels[level].data      = data + offset;
+    levels[level].size      = image_desc.levels[level].size;
+    for (uint32_t image = 0; image < image_count; ++image) {
+      jobs[level * image_count + image] = (basisu_transcode_job_t){
+        .transcoder = transcoder,
+        .level      = level,
+        .image      = image,
+        .output     = data + offset + image * image_size,
+      };
+    }
+    offset += image_desc.levels[level].size;
+  }
+  job_system_parallel_for(job_system_get_shared(), job_count, 1,
+                          basisu_transcode_jobs_run, jobs);
+  bool success = true;
+  for (uint32_t i = 0; i < job_count; ++i) {
+    success = success && jobs[i].success;
+  }
+  basisu_transcoder_destroy(transcoder);
+  basisu_shutdown();
 
-  // Clean up staging resources
-  ktxTexture_Destroy(ktx_texture);
+  if (success) {
+    texture_result = wgpu_texture_create_from_levels(
+      wgpu_context, format, image_desc.width, image_desc.height,
+      image_desc.face_count, image_desc.level_count, levels, usage);
+    if (texture_result.texture != NULL) {
+      basisu_cache_write(cache_filename, &cache_header, data, data_size);
+    }
+  }
+  else {
+    log_error("Could not transcode texture from %s", filename);
+  }
+  free(jobs);
+  free(data);
 
-  return (texture_result_t){
-    .texture         = texture,
-    .width           = texture_desc.size.width,
-    .height          = texture_desc.size.height,
-    .depth           = texture_desc.size.depthOrArrayLayers,
-    .mip_level_count = texture_desc.mipLevelCount,
-    .format          = texture_desc.format,
-    .dimension       = texture_desc.dimension,
-  };
+  return texture_result;
 }
 
-static texture_result_t
-wgpu_texture_load_from_basis_file(wgpu_context_t* wgpu_context,
-                                  const char* filename)
+/**
+ * @brief Loads a KTX2 file. Basis Universal payloads (BasisLZ/ETC1S and
+ * UASTC) are transcoded to a format of the supported format list, other
+ * payloads are uploaded in their native format after Zstd inflation, with
+ * the given usage or the default one for WGPUTextureUsage_None. The color
+ * space selects the sRGB or linear variant of the native format.
+ */
+static texture_result_t wgpu_texture_load_from_ktx2_file(
+  wgpu_context_t* wgpu_context, const char* filename, WGPUTextureUsage usage,
+  color_space_enum_t color_space)
 {
-  // Read file into memory
-  if (!file_exists(filename)) {
+  file_mapping_t mapping = {0};
+  if (!file_map(filename, &mapping)) {
     log_fatal("Could not load texture from %s", filename);
     return (texture_result_t){0};
   }
 
-  file_read_result_t file_read_result = {0};
-  read_file(filename, &file_read_result, false);
+  ktx2_header_t header = {0};
+  if (is_ktx2_data(mapping.data, mapping.size)) {
+    memcpy(&header, mapping.data + KTX2_IDENTIFIER_SIZE, sizeof(header));
+  }
+  const uint32_t level_count = MAX(1u, header.level_count);
+  if (header.pixel_width == 0 || header.pixel_depth > 1
+      || header.layer_count > 1
+      || (header.face_count != 1 && header.face_count != 6)
+      || level_count > KTX2_MAX_LEVELS
+      || mapping.size < KTX2_HEADER_SIZE
+                          + level_count * KTX2_LEVEL_INDEX_ENTRY_SIZE) {
+    log_error("Unsupported KTX2 file %s", filename);
+    file_unmap(&mapping);
+    return (texture_result_t){0};
+  }
 
   struct wgpu_texture_client_t* texture_client = wgpu_context->texture_client;
+  texture_level_data_t levels[KTX2_MAX_LEVELS] = {0};
+  texture_result_t texture_result              = {0};
+
+  // Basis Universal payload, transcoded to the best supported format
+  if (header.vk_format == KTX2_VK_FORMAT_UNDEFINED) {
+    texture_result = wgpu_texture_load_from_basisu_data(
+      wgpu_context, filename, &mapping, usage, color_space);
+    file_unmap(&mapping);
+    return texture_result;
+  }
 
-  // Transcode file
-  basisu_setup();
-  basisu_transcode_result_t transcode_result = basisu_transcode(
-    (basisu_data_t){
-      .ptr  = file_read_result.data,
-      .size = file_read_result.size,
-    },
-    &texture_client->supported_format_list.values,
-    texture_client->supported_format_list.count, false);
-  if (transcode_result.result_code != BASIS_TRANSCODE_RESULT_SUCCESS) {
-    log_fatal("Could not transcode texture from %s", filename);
+  // Native payload, uncompressed or in a block compressed format
+  const WGPUTextureFormat format = format_for_color_space(
+    ktx2_vk_format_to_wgpu(header.vk_format), color_space);
+  if (format == WGPUTextureFormat_Undefined
+      || !wgpu_texture_client_supports_format(texture_client, format)
+      || (header.supercompression_scheme != KTX2_SUPERCOMPRESSION_NONE
+          && header.supercompression_scheme != KTX2_SUPERCOMPRESSION_ZSTD)) {
+    log_error("Unsupported format %u or supercompression %u in %s",
+              header.vk_format, header.supercompression_scheme, filename);
+    file_unmap(&mapping);
     return (texture_result_t){0};
   }
 
-  // Create file
-  basisu_image_desc_t* image_desc = &transcode_result.image_desc;
-  WGPUTextureDescriptor texture_desc = {
-    .size          = (WGPUExtent3D) {
-      .width               = image_desc->width,
-      .height              = image_desc->height,
-      .depthOrArrayLayers  = 1,
-     },
-    .mipLevelCount = image_desc->level_count,
-    .sampleCount   = 1,
-    .dimension     = WGPUTextureDimension_2D,
-    .format        = image_desc->format,
-    .usage         = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
-  };
-  WGPUTexture texture
-    = wgpuDeviceCreateTexture(wgpu_context->device, &texture_desc);
-
-  WGPUCommandEncoder cmd_encoder
-    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
-
-  for (uint32_t level = 0; level < image_desc->level_count; ++level) {
-    uint32_t width  = image_desc->width >> level;
-    uint32_t height = image_desc->height >> level;
-    if (height == 0) {
-      height = 1;
+  bool success = true;
+  for (uint32_t level = 0; success && level < level_count; ++level) {
+    uint64_t entry[3]; // byte offset, byte length, uncompressed byte length
+    memcpy(entry,
+           mapping.data + KTX2_HEADER_SIZE
+             + level * KTX2_LEVEL_INDEX_ENTRY_SIZE,
+           sizeof(entry));
+    success = entry[0] + entry[1] <= mapping.size;
+    if (!success) {
+      break;
     }
+    if (header.supercompression_scheme == KTX2_SUPERCOMPRESSION_NONE) {
+      levels[level].data = mapping.data + entry[0];
+      levels[level].size = (size_t)entry[1];
+      continue;
+    }
+    // Inflate the level, the buffer is released after the upload
+    uint8_t* inflated = malloc((size_t)entry[2]);
+    const size_t inflated_size
+      = inflated != NULL ?
+          ZSTD_decompress(inflated, (size_t)entry[2], mapping.data + entry[0],
+                          (size_t)entry[1]) :
+          0;
+    levels[level].data = inflated;
+    levels[level].size = inflated_size;
+    success = inflated != NULL && !ZSTD_isError(inflated_size);
+  }
 
-    // Create a host-visible staging buffer that contains the raw image data
-    size_t texture_size = image_desc->levels[level].size * 4;
-    WGPUBufferDescriptor staging_buffer_desc = {
-      .usage            = WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite,
-      .size             = texture_size,
-      .mappedAtCreation = true,
-    };
-    WGPUBuffer staging_buffer
-      = wgpuDeviceCreateBuffer(wgpu_context->device, &staging_buffer_desc);
-    ASSERT(staging_buffer)
-
-    // Copy texture data into staging buffer
-    void* mapping = wgpuBufferGetMappedRange(staging_buffer, 0, texture_size);
-    ASSERT(mapping)
-    memcpy(mapping, image_desc->levels[level].ptr,
-           image_desc->levels[level].size);
-    wgpuBufferUnmap(staging_buffer);
-
-    // Upload statging buffer to texture
-    wgpuCommandEncoderCopyBufferToTexture(cmd_encoder,
-      // Source
-      &(WGPUImageCopyBuffer) {
-        .buffer = staging_buffer,
-        .layout = (WGPUTextureDataLayout) {
-          .offset = 0,
-          .bytesPerRow = texture_size / height,
-          .rowsPerImage= height,
-        },
-      },
-      // Destination
-      &(WGPUImageCopyTexture){
-        .texture = texture,
-        .mipLevel = level,
-        .origin = (WGPUOrigin3D) {
-          .x=0,
-          .y=0,
-          .z=0,
-        },
-        .aspect = WGPUTextureAspect_All,
-      },
-      // Copy size
-      &(WGPUExtent3D){
-        .width               = MAX(1u, width),
-        .height              = MAX(1u, height),
-        .depthOrArrayLayers  = 1,
-      });
-
-    WGPU_RELEASE_RESOURCE(Buffer, staging_buffer);
+  if (success) {
+    texture_result = wgpu_texture_create_from_levels(
+      wgpu_context, format, header.pixel_width, MAX(1u, header.pixel_height),
+      header.face_count, level_count, levels, usage);
+  }
+  else {
+    log_error("Could not read the mip levels of %s", filename);
   }
 
-  WGPUCommandBuffer command_buffer
-    = wgpuCommandEncoderFinish(cmd_encoder, NULL);
-  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_encoder)
+  if (header.supercompression_scheme == KTX2_SUPERCOMPRESSION_ZSTD) {
+    for (uint32_t level = 0; level < level_count; ++level) {
+      free((void*)levels[level].data);
+    }
+  }
+  file_unmap(&mapping);
 
-  // Sumbit commmand buffer and cleanup
-  ASSERT(command_buffer != NULL)
+  return texture_result;
+}
 
-  // Submit to the queue
-  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+static texture_result_t
+wgpu_texture_load_from_basis_file(wgpu_context_t* wgpu_context,
+                                  const char* filename, WGPUTextureUsage usage,
+                                  color_space_enum_t color_space)
+{
+  // Map file into memory
+  if (!file_exists(filename)) {
+    log_fatal("Could not load texture from %s", filename);
+    return (texture_result_t){0};
+  }
 
-  // Release command buffer
-  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+  file_mapping_t file_mapping = {0};
+  if (!file_map(filename, &file_mapping)) {
+    return (texture_result_t){0};
+  }
 
-  // Clean up staging resources
-  basisu_free(image_desc);
-  basisu_shutdown();
-  free(file_read_result.data);
+  texture_result_t texture_result = wgpu_texture_load_from_basisu_data(
+    wgpu_context, filename, &file_mapping, usage, color_space);
+  file_unmap(&file_mapping);
 
-  return (texture_result_t){
-    .texture         = texture,
-    .width           = texture_desc.size.width,
-    .height          = texture_desc.size.height,
-    .depth           = texture_desc.size.depthOrArrayLayers,
-    .mip_level_count = texture_desc.mipLevelCount,
-    .format          = texture_desc.format,
-    .dimension       = texture_desc.dimension,
-  };
+  return texture_result;
 }
 
 static texture_result_t wgpu_texture_client_load_texture_from_file(
   struct wgpu_texture_client_t* texture_client, const char* filename,
   struct wgpu_texture_load_options_t* options)
 {
-  if (filename_has_extension(filename, "jpg")
-      || filename_has_extension(filename, "png")) {
+  if (is_stb_image_file(filename)) {
     return wgpu_texture_load_with_stb(texture_client, filename, options);
   }
+  else if (filename_has_extension(filename, "ktx2")) {
+    return wgpu_texture_load_from_ktx2_file(
+      texture_client->wgpu_context, filename,
+      options ? options->usage : WGPUTextureUsage_None,
+      options ? options->color_space : COLOR_SPACE_UNDEFINED);
+  }
   else if (filename_has_extension(filename, "ktx")) {
     return wgpu_texture_load_from_ktx_file(texture_client->wgpu_context,
-                                           filename);
+                                           filename, options);
   }
   else if (filename_has_extension(filename, "basis")) {
-    return wgpu_texture_load_from_basis_file(texture_client->wgpu_context,
-                                             filename);
+    return wgpu_texture_load_from_basis_file(
+      texture_client->wgpu_context, filename,
+      options ? options->usage : WGPUTextureUsage_None,
+      options ? options->color_space : COLOR_SPACE_UNDEFINED);
   }
 
   return (texture_result_t){0};
@@ -1406,7 +2589,7 @@ wgpu_create_texture(wgpu_context_t* wgpu_context,
     .maxAnisotropy = 1,
   };
   WGPUSampler sampler
-    = wgpuDeviceCreateSampler(wgpu_context->device, &sampler_desc);
+    = wgpu_sampler_cache_get_sampler(wgpu_context, &sampler_desc);
 
   return (texture_t){
     .size = {
@@ -1445,28 +2628,56 @@ wgpu_texture_client_create(wgpu_context_t* wgpu_context)
   }
 
   {
-    static const WGPUTextureFormat supported_format_list[12] = {
-      // Uncompressed format list
+    // Uncompressed format list, followed by the compressed formats of the
+    // texture compression features the device has
+    static const WGPUTextureFormat uncompressed_format_list[4] = {
       WGPUTextureFormat_RGBA8Unorm,
       WGPUTextureFormat_RGBA8UnormSrgb,
       WGPUTextureFormat_BGRA8Unorm,
       WGPUTextureFormat_BGRA8UnormSrgb,
-      // Compressed format list
-      WGPUTextureFormat_BC1RGBAUnorm,
-      WGPUTextureFormat_BC1RGBAUnormSrgb,
-      WGPUTextureFormat_BC2RGBAUnorm,
-      WGPUTextureFormat_BC2RGBAUnormSrgb,
-      WGPUTextureFormat_BC3RGBAUnorm,
-      WGPUTextureFormat_BC3RGBAUnormSrgb,
-      WGPUTextureFormat_BC7RGBAUnorm,
-      WGPUTextureFormat_BC7RGBAUnormSrgb,
     };
-    memcpy(texture_client->supported_format_list.values, supported_format_list,
-           sizeof(supported_format_list));
-    texture_client->allow_compressed_formats = wgpuDeviceHasFeature(
-      wgpu_context->device, WGPUFeatureName_TextureCompressionBC);
-    texture_client->supported_format_list.count
-      = texture_client->allow_compressed_formats ? 12 : 4;
+    static const WGPUTextureFormat bc_format_list[14] = {
+      WGPUTextureFormat_BC1RGBAUnorm,  WGPUTextureFormat_BC1RGBAUnormSrgb,
+      WGPUTextureFormat_BC2RGBAUnorm,  WGPUTextureFormat_BC2RGBAUnormSrgb,
+      WGPUTextureFormat_BC3RGBAUnorm,  WGPUTextureFormat_BC3RGBAUnormSrgb,
+      WGPUTextureFormat_BC4RUnorm,     WGPUTextureFormat_BC4RSnorm,
+      WGPUTextureFormat_BC5RGUnorm,    WGPUTextureFormat_BC5RGSnorm,
+      WGPUTextureFormat_BC6HRGBUfloat, WGPUTextureFormat_BC6HRGBFloat,
+      WGPUTextureFormat_BC7RGBAUnorm,  WGPUTextureFormat_BC7RGBAUnormSrgb,
+    };
+    static const WGPUTextureFormat etc2_format_list[10] = {
+      WGPUTextureFormat_ETC2RGB8Unorm,   WGPUTextureFormat_ETC2RGB8UnormSrgb,
+      WGPUTextureFormat_ETC2RGB8A1Unorm, WGPUTextureFormat_ETC2RGB8A1UnormSrgb,
+      WGPUTextureFormat_ETC2RGBA8Unorm,  WGPUTextureFormat_ETC2RGBA8UnormSrgb,
+      WGPUTextureFormat_EACR11Unorm,     WGPUTextureFormat_EACR11Snorm,
+      WGPUTextureFormat_EACRG11Unorm,    WGPUTextureFormat_EACRG11Snorm,
+    };
+    static const WGPUTextureFormat astc_format_list[2] = {
+      WGPUTextureFormat_ASTC4x4Unorm,
+      WGPUTextureFormat_ASTC4x4UnormSrgb,
+    };
+    const struct {
+      WGPUFeatureName feature;
+      const WGPUTextureFormat* values;
+      size_t count;
+    } compressed_format_lists[3] = {
+      {WGPUFeatureName_TextureCompressionBC, bc_format_list, 14},
+      {WGPUFeatureName_TextureCompressionETC2, etc2_format_list, 10},
+      {WGPUFeatureName_TextureCompressionASTC, astc_format_list, 2},
+    };
+    WGPUTextureFormat* values = texture_client->supported_format_list.values;
+    memcpy(values, uncompressed_format_list, sizeof(uncompressed_format_list));
+    size_t count = 4;
+    for (uint32_t i = 0; i < ARRAY_SIZE(compressed_format_lists); ++i) {
+      if (wgpuDeviceHasFeature(wgpu_context->device,
+                               compressed_format_lists[i].feature)) {
+        memcpy(values + count, compressed_format_lists[i].values,
+               compressed_format_lists[i].count * sizeof(WGPUTextureFormat));
+        count += compressed_format_lists[i].count;
+      }
+    }
+    texture_client->supported_format_list.count = count;
+    texture_client->allow_compressed_formats    = count > 4;
   }
 
   return texture_client;
@@ -1479,6 +2690,14 @@ void wgpu_texture_client_destroy(struct wgpu_texture_client_t* texture_client)
       wgpu_mipmap_generator_destroy(texture_client->wgpu_mipmap_generator);
       texture_client->wgpu_mipmap_generator = NULL;
     }
+    if (texture_client->registry.count > 0) {
+      log_debug("Destroying %u registered textures still in use\n",
+                texture_client->registry.count);
+    }
+    for (uint32_t i = 0; i < texture_client->registry.count; ++i) {
+      wgpu_destroy_texture(&texture_client->registry.entries[i].texture);
+    }
+    free(texture_client->registry.entries);
     free(texture_client);
     texture_client = NULL;
   }
@@ -1499,6 +2718,156 @@ void get_supported_formats(struct wgpu_texture_client_t* texture_client,
   }
 }
 
+/* Copies the path without "." segments and with ".." segments removing the
+ * previous one, leading ".." segments are kept */
+static void texture_source_normalize_path(const char* path, char* result,
+                                          size_t result_size)
+{
+  size_t length = 0, root_length = 0;
+  result[0]     = '\0';
+  if (path[0] == '/') {
+    snprintf(result, result_size, "/");
+    length = root_length = 1;
+  }
+  while (*path != '\0') {
+    while (*path == '/') {
+      ++path;
+    }
+    const char* end = path;
+    while (*end != '\0' && *end != '/') {
+      ++end;
+    }
+    const size_t segment_length = (size_t)(end - path);
+    if (segment_length == 1 && path[0] == '.') {
+      /* Skip current directory */
+    }
+    else if (segment_length == 2 && path[0] == '.' && path[1] == '.'
+             && length > root_length
+             && strcmp(&result[length > 2 ? length - 2 : 0], "..") != 0) {
+      /* Remove the previous segment */
+      while (length > root_length && result[length - 1] != '/') {
+        --length;
+      }
+      length         = length > root_length ? length - 1 : length;
+      result[length] = '\0';
+    }
+    else if (segment_length > 0 && length + segment_length + 2 < result_size) {
+      if (length > root_length) {
+        result[length++] = '/';
+      }
+      memcpy(&result[length], path, segment_length);
+      length += segment_length;
+      result[length] = '\0';
+    }
+    path = end;
+  }
+}
+
+uint64_t wgpu_texture_source_get_key(const wgpu_texture_source_t* source)
+{
+  uint64_t key = WGPU_RENDER_BUNDLE_HASH_SEED;
+  if (source->filename != NULL) {
+    char path[STRMAX];
+    texture_source_normalize_path(source->filename, path, sizeof(path));
+    key = wgpu_render_bundle_hash(key, path, strlen(path));
+  }
+  else if (source->data != NULL && source->data_size > 0) {
+    key = wgpu_render_bundle_hash(key, source->data, source->data_size);
+  }
+  else {
+    return 0;
+  }
+  const struct wgpu_texture_load_options_t* options = &source->options;
+  const uint32_t settings[8]                         = {
+    source->filename != NULL,
+    options->flip_y,
+    options->generate_mipmaps,
+    (uint32_t)options->usage,
+    (uint32_t)options->format,
+    (uint32_t)options->address_mode,
+    (uint32_t)options->color_space,
+    (uint32_t)options->compression,
+  };
+  key = wgpu_render_bundle_hash(key, settings, sizeof(settings));
+  return key != 0 ? key : 1;
+}
+
+static wgpu_texture_registry_entry_t*
+texture_registry_find(struct wgpu_texture_client_t* texture_client,
+                      uint64_t key)
+{
+  for (uint32_t i = 0; i < texture_client->registry.count; ++i) {
+    if (texture_client->registry.entries[i].key == key) {
+      return &texture_client->registry.entries[i];
+    }
+  }
+  return NULL;
+}
+
+bool wgpu_texture_client_acquire_texture(
+  struct wgpu_texture_client_t* texture_client, uint64_t key,
+  texture_t* texture)
+{
+  wgpu_texture_registry_entry_t* entry
+    = texture_registry_find(texture_client, key);
+  if (entry == NULL) {
+    return false;
+  }
+  ++entry->ref_count;
+  *texture = entry->texture;
+  return true;
+}
+
+void wgpu_texture_client_register_texture(
+  struct wgpu_texture_client_t* texture_client, uint64_t key,
+  texture_t* texture)
+{
+  if (texture->texture == NULL) {
+    return;
+  }
+  if (texture_registry_find(texture_client, key) != NULL) {
+    wgpu_destroy_texture(texture);
+    wgpu_texture_client_acquire_texture(texture_client, key, texture);
+    return;
+  }
+  if (texture_client->registry.count == texture_client->registry.capacity) {
+    const uint32_t capacity = MAX(texture_client->registry.capacity * 2, 16u);
+    wgpu_texture_registry_entry_t* entries
+      = realloc(texture_client->registry.entries,
+                capacity * sizeof(wgpu_texture_registry_entry_t));
+    if (entries == NULL) {
+      /* The texture stays owned by the caller */
+      return;
+    }
+    texture_client->registry.entries  = entries;
+    texture_client->registry.capacity = capacity;
+  }
+  texture_client->registry.entries[texture_client->registry.count++]
+    = (wgpu_texture_registry_entry_t){
+      .key       = key,
+      .texture   = *texture,
+      .ref_count = 1,
+    };
+}
+
+void wgpu_texture_client_release_texture(
+  struct wgpu_texture_client_t* texture_client, uint64_t key,
+  texture_t* texture)
+{
+  wgpu_texture_registry_entry_t* entry
+    = texture_client != NULL ? texture_registry_find(texture_client, key) :
+                               NULL;
+  if (entry == NULL || entry->texture.texture != texture->texture) {
+    wgpu_destroy_texture(texture);
+  }
+  else if (--entry->ref_count == 0) {
+    wgpu_destroy_texture(&entry->texture);
+    *entry
+      = texture_client->registry.entries[--texture_client->registry.count];
+  }
+  memset(texture, 0, sizeof(*texture));
+}
+
 /* -------------------------------------------------------------------------- *
  * Helper functions
  * -------------------------------------------------------------------------- */
@@ -1522,28 +2891,268 @@ wgpu_create_texture_from_memory(wgpu_context_t* wgpu_context, void* data,
                                options);
   }
 
-  return (texture_t){0};
+  return (texture_t){0};
+}
+
+texture_t
+wgpu_create_texture_from_file(wgpu_context_t* wgpu_context,
+                              const char* filename,
+                              struct wgpu_texture_load_options_t* options)
+{
+  if (wgpu_context->texture_client == NULL) {
+    wgpu_create_texture_client(wgpu_context);
+  }
+  struct wgpu_texture_client_t* texture_client = wgpu_context->texture_client;
+
+  PROFILE_BEGIN("wgpu_create_texture_from_file");
+  texture_t texture               = {0};
+  texture_result_t texture_result = wgpu_texture_client_load_texture_from_file(
+    texture_client, filename, options);
+
+  if (texture_result.texture) {
+    texture = wgpu_create_texture(texture_client->wgpu_context, &texture_result,
+                                  options);
+  }
+  PROFILE_END();
+
+  return texture;
+}
+
+void wgpu_create_textures_from_files(
+  wgpu_context_t* wgpu_context, uint32_t count, const char* filenames[],
+  struct wgpu_texture_load_options_t* options, texture_t* textures)
+{
+  wgpu_texture_source_t* sources
+    = (wgpu_texture_source_t*)calloc(MAX(count, 1u), sizeof(*sources));
+  for (uint32_t i = 0; i < count; ++i) {
+    sources[i].filename = filenames[i];
+    // Same defaults as without options
+    sources[i].options
+      = options != NULL ? *options :
+                          (struct wgpu_texture_load_options_t){
+                            .address_mode = WGPUAddressMode_ClampToEdge,
+                          };
+  }
+  wgpu_texture_batch_finish(
+    wgpu_texture_batch_begin(wgpu_context, count, sources), textures);
+  free(sources);
+}
+
+struct wgpu_texture_batch_t {
+  wgpu_context_t* wgpu_context;
+  uint32_t count;
+  wgpu_texture_source_t* sources; /* filenames are copied */
+  stb_image_decode_job_t* decode_jobs;
+  bool* is_decoded; /* decoded by a job, otherwise loaded when finishing */
+  job_counter_t counter;
+};
+
+static bool is_stb_image_data(const void* data, size_t data_size)
+{
+  int width = 0, height = 0, comps = 0;
+  return data_size <= INT32_MAX
+         && !stbi_is_hdr_from_memory((const stbi_uc*)data, (int)data_size)
+         && stbi_info_from_memory((const stbi_uc*)data, (int)data_size,
+                                  &width, &height, &comps);
+}
+
+static void stb_image_decode_job_run(void* user_data)
+{
+  stb_image_decode((stb_image_decode_job_t*)user_data);
+}
+
+wgpu_texture_batch_t*
+wgpu_texture_batch_begin(wgpu_context_t* wgpu_context, uint32_t count,
+                         const wgpu_texture_source_t* sources)
+{
+  wgpu_texture_batch_t* batch
+    = (wgpu_texture_batch_t*)calloc(1, sizeof(wgpu_texture_batch_t));
+  const uint32_t alloc_count = MAX(count, 1u);
+  batch->wgpu_context        = wgpu_context;
+  batch->count               = count;
+  batch->sources
+    = (wgpu_texture_source_t*)calloc(alloc_count, sizeof(*batch->sources));
+  batch->decode_jobs = (stb_image_decode_job_t*)calloc(
+    alloc_count, sizeof(*batch->decode_jobs));
+  batch->is_decoded = (bool*)calloc(alloc_count, sizeof(*batch->is_decoded));
+  if (count > 0) {
+    memcpy(batch->sources, sources, count * sizeof(*sources));
+  }
+
+  job_system_t* job_system = job_system_get_shared();
+  for (uint32_t i = 0; i < count; ++i) {
+    wgpu_texture_source_t* source = &batch->sources[i];
+    if (source->filename != NULL) {
+      const size_t length = strlen(source->filename) + 1;
+      char* filename      = (char*)malloc(length);
+      memcpy(filename, source->filename, length);
+      source->filename = filename;
+    }
+    const bool is_stb_image
+      = source->filename != NULL ?
+          is_stb_image_file(source->filename) :
+          (source->data != NULL
+           && is_stb_image_data(source->data, source->data_size));
+    if (!is_stb_image) {
+      continue;
+    }
+    batch->decode_jobs[i] = (stb_image_decode_job_t){
+      .filename         = source->filename,
+      .data             = source->filename ? NULL : source->data,
+      .data_size        = source->data_size,
+      .flip_y           = source->options.flip_y,
+      .generate_mipmaps = source->options.generate_mipmaps,
+    };
+    stb_image_decode_job_set_compression(&batch->decode_jobs[i], wgpu_context,
+                                         &source->options);
+    batch->is_decoded[i] = true;
+    job_system_submit(job_system,
+                      &(job_desc_t){
+                        .func      = stb_image_decode_job_run,
+                        .user_data = &batch->decode_jobs[i],
+                      },
+                      &batch->counter);
+  }
+
+  return batch;
 }
 
-texture_t
-wgpu_create_texture_from_file(wgpu_context_t* wgpu_context,
-                              const char* filename,
-                              struct wgpu_texture_load_options_t* options)
+void wgpu_texture_batch_finish(wgpu_texture_batch_t* batch,
+                               texture_t* textures)
 {
+  wgpu_context_t* wgpu_context = batch->wgpu_context;
   if (wgpu_context->texture_client == NULL) {
     wgpu_create_texture_client(wgpu_context);
   }
   struct wgpu_texture_client_t* texture_client = wgpu_context->texture_client;
 
-  texture_result_t texture_result = wgpu_texture_client_load_texture_from_file(
-    texture_client, filename, options);
+  PROFILE_BEGIN("wgpu_texture_batch_finish");
+  job_system_wait(job_system_get_shared(), &batch->counter);
+
+  // Upload on the calling thread, in order
+  for (uint32_t i = 0; i < batch->count; ++i) {
+    wgpu_texture_source_t* source = &batch->sources[i];
+    if (batch->is_decoded[i]) {
+      stb_image_decode_job_t* job = &batch->decode_jobs[i];
+      texture_result_t texture_result
+        = stb_image_decode_job_upload(texture_client, job, &source->options);
+      stb_image_decode_job_release(job);
+      textures[i] = texture_result.texture ?
+                      wgpu_create_texture(wgpu_context, &texture_result,
+                                          &source->options) :
+                      (texture_t){0};
+    }
+    else if (source->filename != NULL) {
+      textures[i] = wgpu_create_texture_from_file(
+        wgpu_context, source->filename, &source->options);
+    }
+    else if (source->data != NULL) {
+      textures[i] = wgpu_create_texture_from_memory(
+        wgpu_context, (void*)source->data, source->data_size,
+        &source->options);
+    }
+    else {
+      textures[i] = (texture_t){0};
+    }
+    free((void*)source->filename);
+  }
+  PROFILE_END();
 
-  if (texture_result.texture) {
-    return wgpu_create_texture(texture_client->wgpu_context, &texture_result,
-                               options);
+  free(batch->sources);
+  free(batch->decode_jobs);
+  free(batch->is_decoded);
+  free(batch);
+}
+
+typedef struct wgpu_texture_async_load_t {
+  wgpu_context_t* wgpu_context;
+  struct wgpu_texture_load_options_t options;
+  bool has_options;
+  wgpu_texture_load_callback_t callback;
+  void* user_data;
+  stb_image_decode_job_t decode_job;
+} wgpu_texture_async_load_t;
+
+/* I/O thread: decode the image and build its mip chain */
+static void wgpu_texture_async_on_read(const file_read_response_t* response)
+{
+  wgpu_texture_async_load_t* load = response->user_data;
+  if (!response->success || response->data == NULL) {
+    return;
   }
+  load->decode_job.filename  = response->filename;
+  load->decode_job.data      = response->data;
+  load->decode_job.data_size = response->size;
+  stb_image_decode(&load->decode_job);
+  load->decode_job.data = NULL;
+}
 
-  return (texture_t){0};
+/* Main thread: upload the decoded image and hand over the texture */
+static void
+wgpu_texture_async_on_complete(const file_read_response_t* response)
+{
+  wgpu_texture_async_load_t* load = response->user_data;
+  wgpu_context_t* wgpu_context    = load->wgpu_context;
+  struct wgpu_texture_load_options_t* options
+    = load->has_options ? &load->options : NULL;
+
+  texture_t texture = {0};
+  if (stb_image_decode_job_succeeded(&load->decode_job)) {
+    if (wgpu_context->texture_client == NULL) {
+      wgpu_create_texture_client(wgpu_context);
+    }
+    texture_result_t texture_result = stb_image_decode_job_upload(
+      wgpu_context->texture_client, &load->decode_job, options);
+    if (texture_result.texture) {
+      texture = wgpu_create_texture(wgpu_context, &texture_result, options);
+    }
+  }
+  else {
+    log_error("Couldn't load '%s'\n", response->filename);
+  }
+  stb_image_decode_job_release(&load->decode_job);
+
+  load->callback(&texture, load->user_data);
+  free(load);
+}
+
+void wgpu_create_texture_from_file_async(
+  wgpu_context_t* wgpu_context, const char* filename,
+  struct wgpu_texture_load_options_t* options,
+  wgpu_texture_load_callback_t callback, void* user_data)
+{
+  ASSERT(callback != NULL);
+
+  // Only JPG and PNG images are streamed, other formats load synchronously
+  if (!is_stb_image_file(filename)) {
+    texture_t texture
+      = wgpu_create_texture_from_file(wgpu_context, filename, options);
+    callback(&texture, user_data);
+    return;
+  }
+
+  wgpu_texture_async_load_t* load
+    = (wgpu_texture_async_load_t*)calloc(1, sizeof(wgpu_texture_async_load_t));
+  load->wgpu_context = wgpu_context;
+  load->has_options  = options != NULL;
+  if (options != NULL) {
+    load->options = *options;
+  }
+  load->callback   = callback;
+  load->user_data  = user_data;
+  load->decode_job = (stb_image_decode_job_t){
+    .flip_y           = options ? options->flip_y : false,
+    .generate_mipmaps = options ? options->generate_mipmaps : false,
+  };
+  stb_image_decode_job_set_compression(&load->decode_job, wgpu_context,
+                                       options);
+
+  file_read_async(&(file_read_request_t){
+    .filename    = filename,
+    .on_read     = wgpu_texture_async_on_read,
+    .on_complete = wgpu_texture_async_on_complete,
+    .user_data   = load,
+  });
 }
 
 texture_t wgpu_create_texture_cubemap_from_files(
@@ -1560,6 +3169,29 @@ texture_t wgpu_create_texture_cubemap_from_files(
   return (texture_t){0};
 }
 
+texture_t wgpu_create_texture_cubemap_from_equirectangular_file(
+  wgpu_context_t* wgpu_context, const char* filename,
+  struct wgpu_texture_load_options_t* options)
+{
+  if (wgpu_context->texture_client == NULL) {
+    wgpu_create_texture_client(wgpu_context);
+  }
+  struct wgpu_texture_client_t* texture_client = wgpu_context->texture_client;
+
+  PROFILE_BEGIN("wgpu_create_texture_cubemap_from_equirectangular_file");
+  texture_t texture = {0};
+  texture_result_t texture_result
+    = wgpu_texture_cubemap_load_from_equirectangular(texture_client, filename,
+                                                     options);
+
+  if (texture_result.texture) {
+    texture = wgpu_create_texture(wgpu_context, &texture_result, options);
+  }
+  PROFILE_END();
+
+  return texture;
+}
+
 texture_t wgpu_create_empty_texture(wgpu_context_t* wgpu_context)
 {
   /* Create texture */
@@ -1615,7 +3247,7 @@ texture_t wgpu_create_empty_texture(wgpu_context_t* wgpu_context)
     .maxAnisotropy = 1,
   };
   WGPUSampler sampler
-    = wgpuDeviceCreateSampler(wgpu_context->device, &sampler_desc);
+    = wgpu_sampler_cache_get_sampler(wgpu_context, &sampler_desc);
 
   return (texture_t){
     .size = {
@@ -1631,3 +3263,792 @@ texture_t wgpu_create_empty_texture(wgpu_context_t* wgpu_context)
     .sampler         = sampler,
   };
 }
+
+/* -------------------------------------------------------------------------- *
+ * Texture saving
+ * -------------------------------------------------------------------------- */
+
+/* Largest basic data format descriptor written, four samples */
+#define KTX2_MAX_DFD_WORDS 23u
+#define KTX2_LEVEL_ALIGNMENT 16u
+
+/* Texture copied to a buffer, written to a KTX2 file once it is mapped */
+typedef struct ktx2_save_request_t {
+  WGPUBuffer buffer;
+  uint64_t buffer_size;
+  WGPUTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t texel_bytes;
+  /* Offset and bytes per row of the levels in the buffer, the rows are
+   * aligned to 256 bytes */
+  uint64_t level_offsets[KTX2_MAX_LEVELS];
+  uint32_t bytes_per_row[KTX2_MAX_LEVELS];
+  char filename[STRMAX];
+} ktx2_save_request_t;
+
+/**
+ * @brief Returns the Vulkan format of a WebGPU format for KTX2 files, the
+ * inverse of ktx2_vk_format_to_wgpu().
+ */
+static uint32_t ktx2_wgpu_format_to_vk(WGPUTextureFormat format)
+{
+  for (uint32_t vk_format = 1; vk_format < 256; ++vk_format) {
+    if (ktx2_vk_format_to_wgpu(vk_format) == format) {
+      return vk_format;
+    }
+  }
+  return KTX2_VK_FORMAT_UNDEFINED;
+}
+
+/**
+ * @brief Fills the basic data format descriptor of the BC4, BC5 and BC7
+ * formats, returns its size in bytes or 0 for other formats.
+ */
+static uint32_t ktx2_fill_block_compressed_dfd(WGPUTextureFormat format,
+                                               uint32_t* dfd)
+{
+  // BC color models, one sample per 64-bit block of a channel for BC4 and BC5
+  // and one 128-bit sample for BC7
+  uint32_t color_model = 0u, sample_count = 1u, sample_bits = 64u;
+  switch (format) {
+    case WGPUTextureFormat_BC4RUnorm:
+      color_model = 131u;
+      break;
+    case WGPUTextureFormat_BC5RGUnorm:
+      color_model  = 132u;
+      sample_count = 2u;
+      break;
+    case WGPUTextureFormat_BC7RGBAUnorm:
+    case WGPUTextureFormat_BC7RGBAUnormSrgb:
+      color_model = 134u;
+      sample_bits = 128u;
+      break;
+    default:
+      return 0u;
+  }
+  const bool is_srgb        = format == WGPUTextureFormat_BC7RGBAUnormSrgb;
+  const uint32_t block_size = 24u + 16u * sample_count;
+  dfd[0]                    = 4u + block_size;
+  dfd[1]                    = 0u;
+  dfd[2]                    = 2u | (block_size << 16);
+  dfd[3] = color_model | (1u << 8) | ((is_srgb ? 2u : 1u) << 16);
+  // 4x4x1 texel block in a single plane
+  dfd[4] = 3u | (3u << 8);
+  dfd[5] = sample_count * sample_bits / 8u;
+  dfd[6] = 0u;
+  for (uint32_t s = 0; s < sample_count; ++s) {
+    uint32_t* sample = &dfd[7 + 4 * s];
+    sample[0] = (s * sample_bits) | ((sample_bits - 1u) << 16) | (s << 24);
+    sample[1] = 0u;
+    sample[2] = 0u;
+    sample[3] = UINT32_MAX;
+  }
+
+  return dfd[0];
+}
+
+/**
+ * @brief Fills the basic data format descriptor of an uncompressed format or
+ * of a block compressed format of ktx2_fill_block_compressed_dfd, returns its
+ * size in bytes including the leading total size.
+ * @see https://registry.khronos.org/DataFormat/specs/1.3/dataformat.1.3.html
+ */
+static uint32_t ktx2_fill_basic_dfd(WGPUTextureFormat format, uint32_t* dfd)
+{
+  const uint32_t block_compressed_size
+    = ktx2_fill_block_compressed_dfd(format, dfd);
+  if (block_compressed_size > 0) {
+    return block_compressed_size;
+  }
+
+  const bool is_bgra = format == WGPUTextureFormat_BGRA8Unorm
+                       || format == WGPUTextureFormat_BGRA8UnormSrgb;
+  const bool is_srgb = format == WGPUTextureFormat_RGBA8UnormSrgb
+                       || format == WGPUTextureFormat_BGRA8UnormSrgb;
+  uint32_t channel_count = 4u, channel_bits = 8u;
+  switch (format) {
+    case WGPUTextureFormat_R8Unorm:
+      channel_count = 1u;
+      break;
+    case WGPUTextureFormat_RG8Unorm:
+      channel_count = 2u;
+      break;
+    case WGPUTextureFormat_RGBA16Float:
+      channel_bits = 16u;
+      break;
+    case WGPUTextureFormat_RGBA32Float:
+      channel_bits = 32u;
+      break;
+    default:
+      break;
+  }
+  const bool is_float = channel_bits > 8u;
+
+  // Channel ids of the RGBSDA color model, 15 is alpha
+  static const uint32_t rgba_channels[4] = {0, 1, 2, 15};
+  static const uint32_t bgra_channels[4] = {2, 1, 0, 15};
+  const uint32_t block_size = 24u + 16u * channel_count;
+  dfd[0]                    = 4u + block_size;
+  // Khronos vendor, basic descriptor type, version 1.3
+  dfd[1] = 0u;
+  dfd[2] = 2u | (block_size << 16);
+  // RGBSDA color model, BT.709 primaries, linear or sRGB transfer function
+  dfd[3] = 1u | (1u << 8) | ((is_srgb ? 2u : 1u) << 16);
+  // 1x1x1 texel block in a single plane
+  dfd[4] = 0u;
+  dfd[5] = channel_count * channel_bits / 8u;
+  dfd[6] = 0u;
+  for (uint32_t c = 0; c < channel_count; ++c) {
+    uint32_t* sample = &dfd[7 + 4 * c];
+    uint32_t channel = is_bgra ? bgra_channels[c] : rgba_channels[c];
+    if (is_srgb && channel == 15u) {
+      channel |= 0x10u; // Linear alpha
+    }
+    if (is_float) {
+      channel |= 0x80u | 0x40u; // Signed float
+    }
+    sample[0] = (c * channel_bits) | ((channel_bits - 1u) << 16)
+                | (channel << 24);
+    sample[1] = 0u;
+    // Lower and upper sample values, -1.0f and 1.0f for floats
+    sample[2] = is_float ? 0xBF800000u : 0u;
+    sample[3] = is_float ? 0x3F800000u : 0xFFu;
+  }
+
+  return dfd[0];
+}
+
+/**
+ * @brief Writes the tightly packed mip levels of an uncompressed texture, or of
+ * a BC4, BC5 or BC7 texture, to a KTX2 file without supercompression.
+ */
+static bool ktx2_write_file(const char* filename, WGPUTextureFormat format,
+                            uint32_t width, uint32_t height,
+                            uint32_t face_count, uint32_t level_count,
+                            const texture_level_data_t* levels)
+{
+  uint32_t dfd[KTX2_MAX_DFD_WORDS] = {0};
+  const uint32_t dfd_size          = ktx2_fill_basic_dfd(format, dfd);
+  const uint32_t dfd_offset
+    = KTX2_HEADER_SIZE + level_count * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+
+  const ktx2_header_t header = {
+    .vk_format    = ktx2_wgpu_format_to_vk(format),
+    .type_size    = format == WGPUTextureFormat_RGBA32Float ? 4u :
+                    format == WGPUTextureFormat_RGBA16Float ? 2u :
+                                                              1u,
+    .pixel_width  = width,
+    .pixel_height = height,
+    .face_count   = face_count,
+    .level_count  = level_count,
+    .supercompression_scheme = KTX2_SUPERCOMPRESSION_NONE,
+  };
+  // DFD offset and length, no key/value data and supercompression data
+  const uint32_t data_index[4]     = {dfd_offset, dfd_size, 0u, 0u};
+  const uint64_t sgd_index[2]      = {0u, 0u};
+  static const uint8_t padding[16] = {0};
+
+  // The levels are stored from the smallest to the largest
+  uint64_t level_index[KTX2_MAX_LEVELS][3] = {0};
+  uint64_t offset = (dfd_offset + dfd_size + KTX2_LEVEL_ALIGNMENT - 1)
+                    & ~(uint64_t)(KTX2_LEVEL_ALIGNMENT - 1);
+  for (uint32_t i = level_count; i-- > 0;) {
+    level_index[i][0] = offset;
+    level_index[i][1] = levels[i].size;
+    level_index[i][2] = levels[i].size;
+    offset = (offset + levels[i].size + KTX2_LEVEL_ALIGNMENT - 1)
+             & ~(uint64_t)(KTX2_LEVEL_ALIGNMENT - 1);
+  }
+
+  // Write to a temporary file first so that an interrupted write never leaves
+  // a truncated file behind
+  char tmp_filename[STRMAX];
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+  FILE* file = fopen(tmp_filename, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool ok = fwrite(ktx2_identifier, KTX2_IDENTIFIER_SIZE, 1, file) == 1
+       && fwrite(&header, sizeof(header), 1, file) == 1
+       && fwrite(data_index, sizeof(data_index), 1, file) == 1
+       && fwrite(sgd_index, sizeof(sgd_index), 1, file) == 1
+       && fwrite(level_index, KTX2_LEVEL_INDEX_ENTRY_SIZE, level_count, file)
+            == level_count
+       && fwrite(dfd, dfd_size, 1, file) == 1;
+  uint64_t position = dfd_offset + dfd_size;
+  for (uint32_t i = level_count; ok && i-- > 0;) {
+    const size_t padding_size = (size_t)(level_index[i][0] - position);
+    ok = fwrite(padding, 1, padding_size, file) == padding_size
+         && fwrite(levels[i].data, 1, levels[i].size, file) == levels[i].size;
+    position = level_index[i][0] + levels[i].size;
+  }
+  ok = (fclose(file) == 0) && ok;
+  ok = ok && (rename(tmp_filename, filename) == 0);
+  if (!ok) {
+    remove(tmp_filename);
+  }
+
+  return ok;
+}
+
+static void ktx2_save_on_mapped(WGPUBufferMapAsyncStatus status,
+                                void* user_data)
+{
+  ktx2_save_request_t* request = user_data;
+
+  if (status == WGPUBufferMapAsyncStatus_Success) {
+    const uint8_t* mapped = (const uint8_t*)wgpuBufferGetConstMappedRange(
+      request->buffer, 0, request->buffer_size);
+    ASSERT(mapped != NULL);
+
+    // Remove the row padding of the copies
+    texture_level_data_t levels[KTX2_MAX_LEVELS] = {0};
+    bool ok                                      = true;
+    for (uint32_t level = 0; ok && level < request->level_count; ++level) {
+      const uint32_t width    = MAX(1u, request->width >> level);
+      const uint32_t height   = MAX(1u, request->height >> level);
+      const size_t row_size   = (size_t)width * request->texel_bytes;
+      const size_t level_size = row_size * height * request->face_count;
+      uint8_t* data           = malloc(level_size);
+      ok                      = data != NULL;
+      for (uint32_t row = 0; ok && row < height * request->face_count;
+           ++row) {
+        memcpy(data + row * row_size,
+               mapped + request->level_offsets[level]
+                 + (uint64_t)row * request->bytes_per_row[level],
+               row_size);
+      }
+      levels[level].data = data;
+      levels[level].size = level_size;
+    }
+    wgpuBufferUnmap(request->buffer);
+
+    ok = ok
+         && ktx2_write_file(request->filename, request->format, request->width,
+                            request->height, request->face_count,
+                            request->level_count, levels);
+    if (!ok) {
+      log_warn("Could not write texture file: %s\n", request->filename);
+    }
+    for (uint32_t level = 0; level < request->level_count; ++level) {
+      free((void*)levels[level].data);
+    }
+  }
+
+  WGPU_RELEASE_RESOURCE(Buffer, request->buffer)
+  free(request);
+}
+
+void wgpu_texture_save_to_ktx2_file(wgpu_context_t* wgpu_context,
+                                    const wgpu_texture_save_desc_t* desc,
+                                    const char* filename)
+{
+  uint32_t block_size        = 1u;
+  const uint32_t texel_bytes = texture_format_block_bytes(desc->format,
+                                                          &block_size);
+  const uint32_t face_count  = MAX(1u, desc->face_count);
+  const uint32_t level_count = MAX(1u, desc->mip_level_count);
+  if (block_size != 1u || (face_count != 1u && face_count != 6u)
+      || level_count > KTX2_MAX_LEVELS
+      || ktx2_wgpu_format_to_vk(desc->format) == KTX2_VK_FORMAT_UNDEFINED) {
+    log_error("Texture of format %u cannot be saved to %s",
+              (uint32_t)desc->format, filename);
+    return;
+  }
+
+  ktx2_save_request_t* request = calloc(1, sizeof(ktx2_save_request_t));
+  request->format              = desc->format;
+  request->width               = desc->width;
+  request->height              = desc->height;
+  request->face_count          = face_count;
+  request->level_count         = level_count;
+  request->texel_bytes         = texel_bytes;
+  snprintf(request->filename, sizeof(request->filename), "%s", filename);
+  for (uint32_t level = 0; level < level_count; ++level) {
+    const uint32_t width          = MAX(1u, desc->width >> level);
+    const uint32_t height         = MAX(1u, desc->height >> level);
+    const uint32_t row_size       = width * texel_bytes;
+    request->level_offsets[level] = request->buffer_size;
+    request->bytes_per_row[level] = (row_size + 255u) & ~255u;
+    request->buffer_size
+      += (uint64_t)request->bytes_per_row[level] * height * face_count;
+  }
+  request->buffer = wgpuDeviceCreateBuffer(
+    wgpu_context->device, &(WGPUBufferDescriptor){
+                            .label = "texture_save_buffer",
+                            .usage = WGPUBufferUsage_CopyDst
+                                     | WGPUBufferUsage_MapRead,
+                            .size  = request->buffer_size,
+                          });
+  ASSERT(request->buffer != NULL);
+
+  // One copy per mip level covering all faces
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  for (uint32_t level = 0; level < level_count; ++level) {
+    const uint32_t height = MAX(1u, desc->height >> level);
+    wgpuCommandEncoderCopyTextureToBuffer(
+      cmd_enc,
+      &(WGPUImageCopyTexture){
+        .texture  = desc->texture,
+        .mipLevel = level,
+        .aspect   = WGPUTextureAspect_All,
+      },
+      &(WGPUImageCopyBuffer){
+        .buffer = request->buffer,
+        .layout = (WGPUTextureDataLayout){
+          .offset       = request->level_offsets[level],
+          .bytesPerRow  = request->bytes_per_row[level],
+          .rowsPerImage = height,
+        },
+      },
+      &(WGPUExtent3D){
+        .width              = MAX(1u, desc->width >> level),
+        .height             = height,
+        .depthOrArrayLayers = face_count,
+      });
+  }
+  WGPUCommandBuffer command_buffer = wgpuCommandEncoderFinish(cmd_enc, NULL);
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+
+  // The file is written from the map callback, the GPU is not waited for
+  wgpuBufferMapAsync(request->buffer, WGPUMapMode_Read, 0,
+                     request->buffer_size, ktx2_save_on_mapped, request);
+}
+
+/* -------------------------------------------------------------------------- *
+ * Streaming textures
+ * -------------------------------------------------------------------------- */
+
+#define STREAMING_TEXTURE_MAX_LEVELS 16u
+#define STREAMING_TEXTURE_DEFAULT_UPLOAD_BUDGET (1024u * 1024u)
+#define STREAMING_TEXTURE_DEFAULT_TAIL_SIZE 64u
+
+/* OpenGL format of the KTX files whose mip levels can be streamed */
+#define KTX_GL_RGBA 0x1908
+#define KTX_GL_UNSIGNED_BYTE 0x1401
+
+struct wgpu_texture_streamer {
+  wgpu_context_t* wgpu_context;
+  uint64_t upload_budget;
+  uint32_t tail_size;
+  struct wgpu_streaming_texture* textures;
+  uint64_t loading_size; /* bytes of the reads in flight */
+  uint32_t loading_count;
+  bool levels_landed;
+};
+
+struct wgpu_streaming_texture {
+  wgpu_texture_streamer_t* streamer;
+  struct wgpu_streaming_texture* next;
+  char* filename;
+  texture_t texture;
+  WGPUAddressMode address_mode;
+  /* Placement of the mip levels in the KTX file */
+  struct {
+    uint64_t offset;
+    uint64_t size;
+  } levels[STREAMING_TEXTURE_MAX_LEVELS];
+  uint32_t resident_level; /* finest mip level uploaded */
+  uint32_t wanted_level;   /* finest mip level worth streaming */
+  float priority;
+  float screen_size;
+  bool loading;  /* read of the next level in flight */
+  bool released; /* freed once the read in flight has completed */
+};
+
+wgpu_texture_streamer_t*
+wgpu_texture_streamer_create(wgpu_context_t* wgpu_context,
+                             const wgpu_texture_streamer_desc_t* desc)
+{
+  wgpu_texture_streamer_t* streamer
+    = (wgpu_texture_streamer_t*)malloc(sizeof(wgpu_texture_streamer_t));
+  memset(streamer, 0, sizeof(wgpu_texture_streamer_t));
+  streamer->wgpu_context  = wgpu_context;
+  streamer->upload_budget = (desc != NULL && desc->upload_budget > 0) ?
+                              desc->upload_budget :
+                              STREAMING_TEXTURE_DEFAULT_UPLOAD_BUDGET;
+  streamer->tail_size     = (desc != NULL && desc->tail_size > 0) ?
+                              desc->tail_size :
+                              STREAMING_TEXTURE_DEFAULT_TAIL_SIZE;
+
+  return streamer;
+}
+
+static void wgpu_streaming_texture_free(wgpu_streaming_texture_t* texture)
+{
+  wgpu_texture_streamer_t* streamer      = texture->streamer;
+  wgpu_streaming_texture_t** texture_ref = &streamer->textures;
+  while (*texture_ref != texture) {
+    texture_ref = &(*texture_ref)->next;
+  }
+  *texture_ref = texture->next;
+
+  wgpu_destroy_texture(&texture->texture);
+  free(texture->filename);
+  free(texture);
+}
+
+void wgpu_texture_streamer_release(wgpu_texture_streamer_t* streamer)
+{
+  // The read and upload callbacks reference the textures
+  while (streamer->loading_count > 0) {
+    job_system_process_completions(job_system_get_shared());
+    wgpu_upload_scheduler_flush(
+      wgpu_get_upload_scheduler(streamer->wgpu_context));
+  }
+  while (streamer->textures != NULL) {
+    wgpu_streaming_texture_free(streamer->textures);
+  }
+  free(streamer);
+}
+
+static void
+wgpu_streaming_texture_create_sampler(wgpu_streaming_texture_t* texture)
+{
+  texture_t* tex = &texture->texture;
+  WGPU_RELEASE_RESOURCE(Sampler, tex->sampler)
+
+  const bool is_size_power_of_2
+    = is_power_of_2(tex->size.width) && is_power_of_2(tex->size.height);
+  tex->sampler = wgpu_sampler_cache_get_sampler(
+    texture->streamer->wgpu_context,
+    &(WGPUSamplerDescriptor){
+      .addressModeU  = texture->address_mode,
+      .addressModeV  = texture->address_mode,
+      .addressModeW  = texture->address_mode,
+      .minFilter     = WGPUFilterMode_Linear,
+      .magFilter     = WGPUFilterMode_Linear,
+      .mipmapFilter  = is_size_power_of_2 ? WGPUFilterMode_Linear :
+                                            WGPUFilterMode_Nearest,
+      .lodMinClamp   = (float)texture->resident_level,
+      .lodMaxClamp   = (float)tex->mip_level_count,
+      .maxAnisotropy = 1,
+    });
+  ASSERT(tex->sampler != NULL);
+}
+
+static void wgpu_streaming_texture_upload_level(
+  wgpu_streaming_texture_t* texture, uint32_t level, const uint8_t* pixels)
+{
+  const uint32_t width  = MAX(1u, texture->texture.size.width >> level);
+  const uint32_t height = MAX(1u, texture->texture.size.height >> level);
+  wgpuQueueWriteTexture(texture->streamer->wgpu_context->queue,
+    &(WGPUImageCopyTexture) {
+      .texture  = texture->texture.texture,
+      .mipLevel = level,
+      .aspect   = WGPUTextureAspect_All,
+    },
+    pixels, texture->levels[level].size,
+    &(WGPUTextureDataLayout){
+      .offset       = 0,
+      .bytesPerRow  = width * 4,
+      .rowsPerImage = height,
+    },
+    &(WGPUExtent3D){
+      .width              = width,
+      .height             = height,
+      .depthOrArrayLayers = 1,
+    });
+}
+
+/**
+ * @brief Locates the mip levels in the mapped KTX file. Returns false when the
+ * levels of the file cannot be streamed.
+ */
+static bool
+wgpu_streaming_texture_parse_ktx(wgpu_streaming_texture_t* texture,
+                                 const file_mapping_t* mapping)
+{
+  ktxTexture* ktx_texture = NULL;
+  if (mapping->size < KTX_HEADER_SIZE
+      || ktxTexture_CreateFromMemory(mapping->data, (ktx_size_t)mapping->size,
+                                     KTX_TEXTURE_CREATE_NO_FLAGS, &ktx_texture)
+           != KTX_SUCCESS) {
+    return false;
+  }
+
+  uint32_t endianness = 0, kv_data_size = 0;
+  memcpy(&endianness, mapping->data + 12, sizeof(uint32_t));
+  memcpy(&kv_data_size, mapping->data + 60, sizeof(uint32_t));
+  bool streamable = endianness == KTX_ENDIAN_REF && !ktx_texture->isArray
+                    && !ktx_texture->isCubemap && !ktx_texture->isCompressed
+                    && ktx_texture->numDimensions == 2
+                    && ktx_texture->glFormat == KTX_GL_RGBA
+                    && ktx_texture->glType == KTX_GL_UNSIGNED_BYTE
+                    && ktx_texture->numLevels > 1
+                    && ktx_texture->numLevels <= STREAMING_TEXTURE_MAX_LEVELS;
+
+  // Every level is stored as its size followed by the image
+  uint64_t offset = KTX_HEADER_SIZE + (uint64_t)kv_data_size;
+  for (uint32_t level = 0; streamable && level < ktx_texture->numLevels;
+       ++level) {
+    const uint64_t size = ktxTexture_GetImageSize(ktx_texture, level);
+    uint32_t image_size = 0;
+    if (offset + sizeof(uint32_t) + size > mapping->size) {
+      streamable = false;
+      break;
+    }
+    memcpy(&image_size, mapping->data + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    streamable = image_size == size;
+    texture->levels[level].offset = offset;
+    texture->levels[level].size   = size;
+    offset += size;
+  }
+
+  if (streamable) {
+    texture->texture.size.width      = ktx_texture->baseWidth;
+    texture->texture.size.height     = ktx_texture->baseHeight;
+    texture->texture.size.depth      = 1;
+    texture->texture.mip_level_count = ktx_texture->numLevels;
+  }
+  ktxTexture_Destroy(ktx_texture);
+
+  return streamable;
+}
+
+wgpu_streaming_texture_t*
+wgpu_texture_streamer_load(wgpu_texture_streamer_t* streamer,
+                           const char* filename,
+                           struct wgpu_texture_load_options_t* options)
+{
+  wgpu_streaming_texture_t* texture
+    = (wgpu_streaming_texture_t*)malloc(sizeof(wgpu_streaming_texture_t));
+  memset(texture, 0, sizeof(wgpu_streaming_texture_t));
+  texture->streamer = streamer;
+  texture->address_mode
+    = options ? options->address_mode : WGPUAddressMode_ClampToEdge;
+  texture->next      = streamer->textures;
+  streamer->textures = texture;
+
+  file_mapping_t mapping = {0};
+  if (!filename_has_extension(filename, "ktx") || !file_map(filename, &mapping)
+      || !wgpu_streaming_texture_parse_ktx(texture, &mapping)) {
+    // Not streamable, load all levels now
+    file_unmap(&mapping);
+    texture->texture = wgpu_create_texture_from_file(streamer->wgpu_context,
+                                                     filename, options);
+    return texture;
+  }
+
+  const size_t filename_length = strlen(filename);
+  texture->filename            = (char*)malloc(filename_length + 1);
+  memcpy(texture->filename, filename, filename_length + 1);
+
+  texture_t* tex = &texture->texture;
+  tex->format    = format_for_color_space(
+    WGPUTextureFormat_RGBA8Unorm,
+    options ? options->color_space : COLOR_SPACE_UNDEFINED);
+  tex->dimension = WGPUTextureDimension_2D;
+
+  // All levels are allocated, the sampler only reaches the resident ones
+  WGPUTextureDescriptor texture_desc = {
+    .usage         = WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding,
+    .dimension     = tex->dimension,
+    .size          = (WGPUExtent3D){
+      .width              = tex->size.width,
+      .height             = tex->size.height,
+      .depthOrArrayLayers = 1,
+    },
+    .format        = tex->format,
+    .mipLevelCount = tex->mip_level_count,
+    .sampleCount   = 1,
+  };
+  tex->texture
+    = wgpuDeviceCreateTexture(streamer->wgpu_context->device, &texture_desc);
+  ASSERT(tex->texture != NULL);
+
+  WGPUTextureViewDescriptor texture_view_dec = {
+    .format          = tex->format,
+    .dimension       = WGPUTextureViewDimension_2D,
+    .baseMipLevel    = 0,
+    .mipLevelCount   = tex->mip_level_count,
+    .baseArrayLayer  = 0,
+    .arrayLayerCount = 1,
+  };
+  tex->view = wgpuTextureCreateView(tex->texture, &texture_view_dec);
+
+  // Upload the mip tail, the smallest level always belongs to it
+  texture->resident_level = tex->mip_level_count - 1;
+  while (texture->resident_level > 0
+         && MAX(tex->size.width >> (texture->resident_level - 1),
+                tex->size.height >> (texture->resident_level - 1))
+              <= streamer->tail_size) {
+    --texture->resident_level;
+  }
+  for (uint32_t level = texture->resident_level; level < tex->mip_level_count;
+       ++level) {
+    wgpu_streaming_texture_upload_level(
+      texture, level, mapping.data + texture->levels[level].offset);
+  }
+  file_unmap(&mapping);
+  wgpu_streaming_texture_create_sampler(texture);
+
+  return texture;
+}
+
+static void
+wgpu_streaming_texture_finish_loading(wgpu_streaming_texture_t* texture)
+{
+  wgpu_texture_streamer_t* streamer = texture->streamer;
+  streamer->loading_size -= texture->levels[texture->resident_level - 1].size;
+  --streamer->loading_count;
+  texture->loading = false;
+}
+
+void wgpu_streaming_texture_release(wgpu_streaming_texture_t* texture)
+{
+  if (texture->loading) {
+    // A level queued on the upload scheduler can be dropped right away, a
+    // level being read is freed by its read callback
+    if (wgpu_upload_scheduler_cancel(
+          wgpu_get_upload_scheduler(texture->streamer->wgpu_context), texture)
+        == 0) {
+      texture->released = true;
+      return;
+    }
+    wgpu_streaming_texture_finish_loading(texture);
+  }
+  wgpu_streaming_texture_free(texture);
+}
+
+static float
+wgpu_streaming_texture_get_priority(const wgpu_streaming_texture_t* texture)
+{
+  return texture->priority > 0.0f ? texture->priority : texture->screen_size;
+}
+
+/* Main thread: the level has been written to the texture */
+static void wgpu_streaming_texture_on_uploaded(void* user_data)
+{
+  wgpu_streaming_texture_t* texture = user_data;
+  wgpu_streaming_texture_finish_loading(texture);
+  --texture->resident_level;
+  wgpu_streaming_texture_create_sampler(texture);
+  texture->streamer->levels_landed = true;
+}
+
+/* Main thread: queue the level that has been read on the upload scheduler */
+static void
+wgpu_streaming_texture_on_complete(const file_read_response_t* response)
+{
+  wgpu_streaming_texture_t* texture = response->user_data;
+  const uint32_t level              = texture->resident_level - 1;
+
+  if (texture->released) {
+    wgpu_streaming_texture_finish_loading(texture);
+    wgpu_streaming_texture_free(texture);
+    return;
+  }
+  if (!response->success || response->data == NULL) {
+    log_error("Couldn't read mip level %u of '%s'\n", level,
+              response->filename);
+    wgpu_streaming_texture_finish_loading(texture);
+    texture->wanted_level = texture->resident_level;
+    return;
+  }
+
+  // The scheduler copies the data, the mapping is only valid in this callback
+  const uint32_t width  = MAX(1u, texture->texture.size.width >> level);
+  const uint32_t height = MAX(1u, texture->texture.size.height >> level);
+  const int32_t priority
+    = (int32_t)wgpu_streaming_texture_get_priority(texture);
+  wgpu_upload_scheduler_upload_texture(
+    wgpu_get_upload_scheduler(texture->streamer->wgpu_context),
+    &(wgpu_texture_upload_desc_t){
+      .texture       = texture->texture.texture,
+      .mip_level     = level,
+      .size          = (WGPUExtent3D){width, height, 1},
+      .data          = response->data,
+      .bytes_per_row = width * 4,
+      .priority      = priority,
+      .callback      = wgpu_streaming_texture_on_uploaded,
+      .user_data     = texture,
+    });
+}
+
+bool wgpu_texture_streamer_update(wgpu_texture_streamer_t* streamer)
+{
+  // Issue the reads of the textures with the highest priority as long as the
+  // reads in flight fit into the budget
+  while (true) {
+    wgpu_streaming_texture_t* next_texture = NULL;
+    for (wgpu_streaming_texture_t* texture = streamer->textures;
+         texture != NULL; texture = texture->next) {
+      if (texture->loading || texture->released
+          || texture->resident_level <= texture->wanted_level) {
+        continue;
+      }
+      if (next_texture == NULL
+          || wgpu_streaming_texture_get_priority(texture)
+               > wgpu_streaming_texture_get_priority(next_texture)) {
+        next_texture = texture;
+      }
+    }
+    if (next_texture == NULL) {
+      break;
+    }
+
+    const uint32_t level = next_texture->resident_level - 1;
+    const uint64_t size  = next_texture->levels[level].size;
+    if (streamer->loading_size > 0
+        && streamer->loading_size + size > streamer->upload_budget) {
+      break;
+    }
+    streamer->loading_size += size;
+    ++streamer->loading_count;
+    next_texture->loading = true;
+    file_read_async(&(file_read_request_t){
+      .filename    = next_texture->filename,
+      .offset      = next_texture->levels[level].offset,
+      .size        = size,
+      .on_complete = wgpu_streaming_texture_on_complete,
+      .user_data   = next_texture,
+    });
+  }
+
+  const bool levels_landed = streamer->levels_landed;
+  streamer->levels_landed  = false;
+  return levels_landed;
+}
+
+const texture_t*
+wgpu_streaming_texture_get_texture(wgpu_streaming_texture_t* texture)
+{
+  return &texture->texture;
+}
+
+uint32_t
+wgpu_streaming_texture_get_resident_level(wgpu_streaming_texture_t* texture)
+{
+  return texture->resident_level;
+}
+
+void wgpu_streaming_texture_set_priority(wgpu_streaming_texture_t* texture,
+                                         float priority)
+{
+  texture->priority = priority;
+}
+
+void wgpu_streaming_texture_set_screen_size(wgpu_streaming_texture_t* texture,
+                                            float screen_size)
+{
+  texture->screen_size = screen_size;
+
+  // Level whose size matches the screen size, finer levels are not needed
+  const texture_t* tex = &texture->texture;
+  uint32_t level       = 0;
+  if (screen_size > 0.0f && tex->mip_level_count > 0) {
+    const float ratio
+      = (float)MAX(tex->size.width, tex->size.height) / screen_size;
+    level = ratio > 1.0f ? (uint32_t)floorf(log2f(ratio)) : 0u;
+    level = MIN(level, tex->mip_level_count - 1);
+  }
+  texture->wanted_level = level;
+}
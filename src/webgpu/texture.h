@@ -9,6 +9,14 @@ typedef enum color_space_enum_t {
   COLOR_SPACE_LINEAR,
 } color_space_enum_t;
 
+/* Block compression of JPG and PNG images at load time */
+typedef enum texture_compression_enum_t {
+  TEXTURE_COMPRESSION_NONE,
+  TEXTURE_COMPRESSION_COLOR,  /* BC7, all four channels */
+  TEXTURE_COMPRESSION_NORMAL, /* BC5, red and green, blue is reconstructed */
+  TEXTURE_COMPRESSION_MASK,   /* BC4, red only */
+} texture_compression_enum_t;
+
 typedef struct texture_t {
   struct {
     uint32_t width;
@@ -68,6 +76,13 @@ wgpu_mipmap_generator_generate_mipmap(wgpu_mipmap_generator_t* mipmap_generator,
  * WebGPU Texture Client
  * -------------------------------------------------------------------------- */
 
+/* Texture shared through the registry of the texture client */
+typedef struct wgpu_texture_registry_entry_t {
+  uint64_t key;
+  texture_t texture;
+  uint32_t ref_count;
+} wgpu_texture_registry_entry_t;
+
 typedef struct wgpu_texture_client_t {
   wgpu_context_t* wgpu_context;
   wgpu_mipmap_generator_t* wgpu_mipmap_generator;
@@ -77,9 +92,14 @@ typedef struct wgpu_texture_client_t {
     size_t count;
   } uncompressed_format_list;
   struct {
-    WGPUTextureFormat values[12];
+    WGPUTextureFormat values[30];
     size_t count;
   } supported_format_list;
+  struct {
+    wgpu_texture_registry_entry_t* entries;
+    uint32_t count;
+    uint32_t capacity;
+  } registry;
 } wgpu_texture_client;
 
 typedef struct wgpu_texture_load_options_t {
@@ -89,6 +109,12 @@ typedef struct wgpu_texture_load_options_t {
   WGPUTextureFormat format;
   WGPUAddressMode address_mode;
   color_space_enum_t color_space;
+  /* JPG and PNG images are compressed on the job system when the device has
+   * TextureCompressionBC, the size is a multiple of 4 and the usage allows
+   * it. Other images load uncompressed. The compressed levels are cached in
+   * WGPU_TEXTURE_CACHE_DIRECTORY as KTX2 files named after the hash of the
+   * source, that later loads read instead of decoding the image. */
+  texture_compression_enum_t compression;
 } wgpu_texture_load_options;
 
 /* Texture client construction / destruction */
@@ -107,6 +133,34 @@ void wgpu_texture_client_destroy(struct wgpu_texture_client_t* texture_client);
 void get_supported_formats(struct wgpu_texture_client_t* texture_client,
                            WGPUTextureFormat* supported_formats, size_t* count);
 
+/*
+ * Texture registry, sharing the textures loaded from the same source between
+ * their users by reference counting. The users hold copies of the registered
+ * texture_t and give them back with wgpu_texture_client_release_texture
+ * instead of destroying them. Textures still registered are destroyed with the
+ * texture client.
+ */
+
+/* Copies the texture registered with the key and adds a reference, returns
+ * false when there is none */
+bool wgpu_texture_client_acquire_texture(
+  struct wgpu_texture_client_t* texture_client, uint64_t key,
+  texture_t* texture);
+
+/* Registers the texture with a reference of its caller. When the key is
+ * already registered, the texture is destroyed and replaced with a copy of the
+ * registered one instead. */
+void wgpu_texture_client_register_texture(
+  struct wgpu_texture_client_t* texture_client, uint64_t key,
+  texture_t* texture);
+
+/* Removes a reference of the texture registered with the key and destroys it
+ * with the last one, textures not registered are destroyed right away. The
+ * texture is cleared. */
+void wgpu_texture_client_release_texture(
+  struct wgpu_texture_client_t* texture_client, uint64_t key,
+  texture_t* texture);
+
 /* -------------------------------------------------------------------------- *
  * Texture creation functions
  * -------------------------------------------------------------------------- */
@@ -123,12 +177,157 @@ wgpu_create_texture_from_file(wgpu_context_t* wgpu_context,
                               const char* filename,
                               struct wgpu_texture_load_options_t* options);
 
+/* Texture creation from multiple files, JPG and PNG images are decoded and
+ * their mip chains generated concurrently, the upload happens on the calling
+ * thread */
+void wgpu_create_textures_from_files(
+  wgpu_context_t* wgpu_context, uint32_t count, const char* filenames[],
+  struct wgpu_texture_load_options_t* options, texture_t* textures);
+
+/* Encoded image in a file or in memory */
+typedef struct wgpu_texture_source_t {
+  const char* filename; /* NULL for images in memory */
+  const void* data;
+  size_t data_size;
+  struct wgpu_texture_load_options_t options;
+} wgpu_texture_source_t;
+
+/* Key of the source in the texture registry, of its path with "." and ".."
+ * segments resolved or of its data for images in memory, combined with the
+ * load options. 0 for sources without filename and data. */
+uint64_t wgpu_texture_source_get_key(const wgpu_texture_source_t* source);
+
+/* Texture creation from multiple sources in the background, JPG and PNG
+ * images are decoded and their mip chains generated by jobs of the shared job
+ * system while the calling thread continues. wgpu_texture_batch_finish waits
+ * for the jobs, loads the other formats and uploads the textures in order on
+ * the calling thread, and releases the batch. Sources without filename and
+ * data result in an empty texture_t. */
+typedef struct wgpu_texture_batch_t wgpu_texture_batch_t;
+wgpu_texture_batch_t*
+wgpu_texture_batch_begin(wgpu_context_t* wgpu_context, uint32_t count,
+                         const wgpu_texture_source_t* sources);
+void wgpu_texture_batch_finish(wgpu_texture_batch_t* batch,
+                               texture_t* textures);
+
+/* Asynchronous texture creation from file, JPG and PNG images are read and
+ * decoded in the background and uploaded on the main thread while the render
+ * loop runs, the callback receives the texture and owns it afterwards */
+typedef void (*wgpu_texture_load_callback_t)(texture_t* texture,
+                                             void* user_data);
+void wgpu_create_texture_from_file_async(
+  wgpu_context_t* wgpu_context, const char* filename,
+  struct wgpu_texture_load_options_t* options,
+  wgpu_texture_load_callback_t callback, void* user_data);
+
 /* Texture cubemap creation from 6 individual image files */
 texture_t wgpu_create_texture_cubemap_from_files(
   wgpu_context_t* wgpu_context, const char* filenames[6],
   struct wgpu_texture_load_options_t* options);
 
+/* Texture cubemap creation from a single equirectangular panorama, HDR or
+ * LDR. The faces are written by one compute dispatch in rgba16float, at a
+ * quarter of the panorama width, generate_mipmaps reduces the mip chain with
+ * the compute path of the mipmap generator. The usage of the options is
+ * added to the usage needed by the conversion, the format is ignored. */
+texture_t wgpu_create_texture_cubemap_from_equirectangular_file(
+  wgpu_context_t* wgpu_context, const char* filename,
+  struct wgpu_texture_load_options_t* options);
+
 /* Texture creation with dimension 1x1 */
 texture_t wgpu_create_empty_texture(wgpu_context_t* wgpu_context);
 
+/* -------------------------------------------------------------------------- *
+ * Texture saving
+ * -------------------------------------------------------------------------- */
+
+typedef struct wgpu_texture_save_desc_t {
+  /* Texture with the CopySrc usage */
+  WGPUTexture texture;
+  /* Uncompressed format of the texture, one of the formats read from KTX2
+   * files */
+  WGPUTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  /* 1 for 2D textures, 6 for cubemaps */
+  uint32_t face_count;
+  uint32_t mip_level_count;
+} wgpu_texture_save_desc_t;
+
+/**
+ * @brief Saves all faces and mip levels of a texture to an uncompressed KTX2
+ * file that wgpu_create_texture_from_file() loads again. The texture is copied
+ * to a buffer and the file is written once the buffer is mapped, the GPU is
+ * not waited for. The file is renamed into place when it is complete.
+ */
+void wgpu_texture_save_to_ktx2_file(wgpu_context_t* wgpu_context,
+                                    const wgpu_texture_save_desc_t* desc,
+                                    const char* filename);
+
+/* -------------------------------------------------------------------------- *
+ * Streaming textures
+ * -------------------------------------------------------------------------- */
+
+/*
+ * Streaming textures are created with only their mip tail resident. The higher
+ * mip levels are read with the asynchronous file reads and uploaded later, one
+ * level after the other towards level 0, by priority and within an upload
+ * budget per frame. The minimum LOD of the sampler is clamped to the finest
+ * resident level, the sampler is re-created whenever a level lands.
+ *
+ * Levels are streamed from uncompressed RGBA8 2D KTX files with stored mip
+ * levels, other files are loaded completely on creation.
+ */
+typedef struct wgpu_texture_streamer wgpu_texture_streamer_t;
+typedef struct wgpu_streaming_texture wgpu_streaming_texture_t;
+
+typedef struct wgpu_texture_streamer_desc_t {
+  /* Bytes read and uploaded per frame, 0 selects 1 MiB. A level larger than
+   * the budget is streamed on its own. */
+  uint64_t upload_budget;
+  /* Levels up to this size in texels are loaded on creation, 0 selects 64 */
+  uint32_t tail_size;
+} wgpu_texture_streamer_desc_t;
+
+/* Texture streamer creating/releasing, releasing waits for the pending reads
+ * and releases the textures */
+wgpu_texture_streamer_t*
+wgpu_texture_streamer_create(wgpu_context_t* wgpu_context,
+                             const wgpu_texture_streamer_desc_t* desc);
+void wgpu_texture_streamer_release(wgpu_texture_streamer_t* streamer);
+
+/**
+ * @brief Issues the reads of the next mip levels of the textures with the
+ * highest priority, to be called once per frame. Returns true when a level has
+ * landed since the last call, the bind groups referencing the samplers of the
+ * landed textures need to be re-created then.
+ */
+bool wgpu_texture_streamer_update(wgpu_texture_streamer_t* streamer);
+
+/* Streaming texture creation from file, the mip tail is uploaded right away */
+wgpu_streaming_texture_t*
+wgpu_texture_streamer_load(wgpu_texture_streamer_t* streamer,
+                           const char* filename,
+                           struct wgpu_texture_load_options_t* options);
+void wgpu_streaming_texture_release(wgpu_streaming_texture_t* texture);
+
+/* The texture with its sampler clamped to the resident levels, the sampler is
+ * replaced whenever a level lands */
+const texture_t*
+wgpu_streaming_texture_get_texture(wgpu_streaming_texture_t* texture);
+
+/* Finest resident mip level, 0 once the texture is completely resident */
+uint32_t
+wgpu_streaming_texture_get_resident_level(wgpu_streaming_texture_t* texture);
+
+/* Explicit streaming priority, higher priorities are streamed first. Takes
+ * precedence over the priority derived from the screen size. */
+void wgpu_streaming_texture_set_priority(wgpu_streaming_texture_t* texture,
+                                         float priority);
+
+/* Projected size in pixels of the largest texture dimension, levels finer than
+ * needed for this size are not streamed. 0 streams all levels. */
+void wgpu_streaming_texture_set_screen_size(wgpu_streaming_texture_t* texture,
+                                            float screen_size);
+
 #endif /* TEXTURE_H */
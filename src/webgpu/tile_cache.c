@@ -0,0 +1,857 @@
+#include "tile_cache.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stb_image.h>
+
+#include "../core/file.h"
+#include "../core/job_system.h"
+#include "../core/log.h"
+#include "../core/macro.h"
+#include "buffer.h"
+#include "readback.h"
+#include "upload_scheduler.h"
+
+/* Default limit of maxTextureDimension2D */
+#define WGPU_TILE_CACHE_MAX_ATLAS_SIZE 8192u
+#define WGPU_TILE_PYRAMID_VERSION 1u
+#define WGPU_TILE_CACHE_NO_SLOT UINT32_MAX
+
+/* Tiled pyramid file header and table entries, see tile_cache.h */
+typedef struct tile_pyramid_header_t {
+  char magic[4];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tile_size;
+  uint32_t border;
+  uint32_t level_count;
+  uint32_t reserved;
+} tile_pyramid_header_t;
+
+typedef struct tile_pyramid_entry_t {
+  uint64_t offset;
+  uint64_t size;
+} tile_pyramid_entry_t;
+
+/* Layout of TileCacheParams, per level the tile counts and the index of the
+ * first tile */
+typedef struct tile_cache_params_t {
+  uint32_t image_size[2];
+  uint32_t tile_size;
+  uint32_t border;
+  float atlas_size[2];
+  uint32_t level_count;
+  uint32_t frame_index;
+  uint32_t levels[WGPU_TILE_CACHE_MAX_LEVEL_COUNT][4];
+} tile_cache_params_t;
+
+typedef enum wgpu_tile_state_enum {
+  TileState_Absent    = 0,
+  TileState_Reading   = 1, /* read and decoded on the I/O thread */
+  TileState_Uploading = 2, /* queued on the upload scheduler */
+  TileState_Resident  = 3,
+} wgpu_tile_state_enum;
+
+typedef struct wgpu_tile_t {
+  uint8_t state;
+  uint8_t level;
+  bool requested; /* in the request list of the update */
+  uint32_t slot;
+  uint64_t last_used; /* update in which the tile was last sampled */
+} wgpu_tile_t;
+
+/* Read of a tile in flight, from the file read to the upload */
+typedef struct wgpu_tile_read_t {
+  struct wgpu_tile_cache* tile_cache;
+  bool in_use;
+  uint32_t tile_index;
+  uint8_t* pixels; /* decoded tile */
+} wgpu_tile_read_t;
+
+struct wgpu_tile_cache {
+  wgpu_context_t* wgpu_context;
+  char* filename;
+  file_mapping_t mapping;
+  const tile_pyramid_entry_t* entries; /* table in the mapping */
+  tile_cache_params_t params;
+  uint32_t tile_count;
+  uint32_t slot_size; /* tile size with borders */
+  uint32_t atlas_tile_count;
+  uint32_t slot_count;
+  wgpu_tile_t* tiles;
+  uint32_t* slot_tiles; /* tile of every slot */
+  /* Indirection entries of all tiles: slot x, slot y, level of the slot */
+  uint32_t* indirection;
+  bool indirection_dirty;
+  /* Tiles requested by the feedback and missing in the atlas */
+  uint32_t* requests;
+  uint32_t request_count;
+  wgpu_tile_read_t* reads;
+  uint32_t read_count;
+  uint32_t pending_count;
+  uint64_t update_index;
+  uint64_t loaded_count;
+  uint64_t evicted_count;
+  WGPUTexture atlas;
+  WGPUTextureView atlas_view;
+  WGPUTexture indirection_texture;
+  WGPUTextureView indirection_view;
+  WGPUSampler sampler;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t feedback_buffer;
+  wgpu_buffer_readback_t* feedback_readback;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* tile_cache_wgsl_functions = CODE(
+  struct TileCacheParams {
+    imageSize : vec2<u32>,
+    tileSize : u32,
+    border : u32,
+    atlasSize : vec2<f32>,
+    levelCount : u32,
+    frameIndex : u32,
+    levels : array<vec4<u32>, 16>,
+  };
+
+  fn tileCacheGetLevelSize(level : u32) -> vec2<f32> {
+    return vec2<f32>(max(tileCacheParams.imageSize >> vec2<u32>(level),
+                         vec2<u32>(1u)));
+  }
+
+  fn tileCacheGetTile(uv : vec2<f32>, level : u32) -> vec2<u32> {
+    let tile = vec2<u32>(uv * tileCacheGetLevelSize(level)
+                         / f32(tileCacheParams.tileSize));
+    return min(tile, tileCacheParams.levels[level].xy - vec2<u32>(1u));
+  }
+
+  // A rotating eighth of the pixels reports the tile it needs
+  fn tileCacheWriteFeedback(fragCoord : vec2<f32>, level : u32,
+                            tile : vec2<u32>) {
+    let pixel = vec2<u32>(fragCoord);
+    if (((pixel.x + pixel.y * 3u + tileCacheParams.frameIndex) & 7u) != 0u) {
+      return;
+    }
+    let info = tileCacheParams.levels[level];
+    let index = info.z + tile.y * info.x + tile.x;
+    atomicOr(&tileCacheFeedback[index / 32u], 1u << (index % 32u));
+  }
+
+  // Samples the finest resident tile covering the level of the footprint of
+  // the pixel
+  fn tileCacheSample(uv : vec2<f32>, fragCoord : vec2<f32>) -> vec4<f32> {
+    let texel = uv * vec2<f32>(tileCacheParams.imageSize);
+    let dx = dpdx(texel);
+    let dy = dpdy(texel);
+    let lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+    let level = min(u32(lod), tileCacheParams.levelCount - 1u);
+    let coord = clamp(uv, vec2<f32>(0.0), vec2<f32>(1.0));
+    let tile = tileCacheGetTile(coord, level);
+    tileCacheWriteFeedback(fragCoord, level, tile);
+
+    let entry = textureLoad(tileCacheIndirection, vec2<i32>(tile), i32(level));
+    let tileSize = f32(tileCacheParams.tileSize);
+    let residentTile = vec2<f32>(tileCacheGetTile(coord, entry.z));
+    let local = clamp(coord * tileCacheGetLevelSize(entry.z)
+                        - residentTile * tileSize,
+                      vec2<f32>(0.0), vec2<f32>(tileSize));
+    let border = f32(tileCacheParams.border);
+    let atlasTexel = vec2<f32>(entry.xy) * (tileSize + 2.0 * border) + border
+                     + local;
+    return textureSampleLevel(tileCacheAtlas, tileCacheSampler,
+                              atlasTexel / tileCacheParams.atlasSize, 0.0);
+  }
+);
+// clang-format on
+
+static uint32_t tile_cache_get_tile_index(wgpu_tile_cache_t* tile_cache,
+                                          uint32_t level, uint32_t x,
+                                          uint32_t y)
+{
+  const uint32_t* info = tile_cache->params.levels[level];
+  return info[2] + y * info[0] + x;
+}
+
+/* Rebuilds the entries from the coarsest level on: resident tiles point to
+ * their own slot, the others inherit the entry of their parent */
+static void tile_cache_update_indirection(wgpu_tile_cache_t* tile_cache)
+{
+  const tile_cache_params_t* params = &tile_cache->params;
+  for (int32_t level = (int32_t)params->level_count - 1; level >= 0;
+       --level) {
+    const uint32_t* info = params->levels[level];
+    for (uint32_t y = 0; y < info[1]; ++y) {
+      for (uint32_t x = 0; x < info[0]; ++x) {
+        const uint32_t index = info[2] + y * info[0] + x;
+        const wgpu_tile_t* tile = &tile_cache->tiles[index];
+        if (tile->state == TileState_Resident) {
+          const uint32_t slot_x = tile->slot % tile_cache->atlas_tile_count;
+          const uint32_t slot_y = tile->slot / tile_cache->atlas_tile_count;
+          tile_cache->indirection[index]
+            = slot_x | (slot_y << 8) | ((uint32_t)level << 16);
+        }
+        else {
+          const uint32_t parent = tile_cache_get_tile_index(
+            tile_cache, (uint32_t)level + 1, x / 2, y / 2);
+          tile_cache->indirection[index] = tile_cache->indirection[parent];
+        }
+      }
+    }
+    wgpuQueueWriteTexture(
+      tile_cache->wgpu_context->queue,
+      &(WGPUImageCopyTexture){
+        .texture  = tile_cache->indirection_texture,
+        .mipLevel = (uint32_t)level,
+      },
+      &tile_cache->indirection[info[2]],
+      (size_t)info[0] * info[1] * sizeof(uint32_t),
+      &(WGPUTextureDataLayout){
+        .bytesPerRow  = info[0] * sizeof(uint32_t),
+        .rowsPerImage = info[1],
+      },
+      &(WGPUExtent3D){
+        .width              = info[0],
+        .height             = info[1],
+        .depthOrArrayLayers = 1,
+      });
+  }
+  tile_cache->indirection_dirty = false;
+}
+
+/* Decodes a tile into pixels of slot_size^2 RGBA8 texels, NULL on failure */
+static uint8_t* tile_cache_decode_tile(wgpu_tile_cache_t* tile_cache,
+                                       const uint8_t* data, uint64_t size)
+{
+  int width = 0, height = 0, channels = 0;
+  uint8_t* pixels = stbi_load_from_memory(data, (int)size, &width, &height,
+                                          &channels, STBI_rgb_alpha);
+  if (pixels != NULL
+      && (width != (int)tile_cache->slot_size
+          || height != (int)tile_cache->slot_size)) {
+    stbi_image_free(pixels);
+    pixels = NULL;
+  }
+  return pixels;
+}
+
+/* Returns a free slot, evicting the least recently used tile that was not
+ * sampled in the last update, WGPU_TILE_CACHE_NO_SLOT when all are in use */
+static uint32_t tile_cache_allocate_slot(wgpu_tile_cache_t* tile_cache)
+{
+  uint32_t lru_slot     = WGPU_TILE_CACHE_NO_SLOT;
+  uint64_t lru_frame    = tile_cache->update_index > 0 ?
+                            tile_cache->update_index - 1 :
+                            0;
+  const uint32_t pinned = tile_cache->tile_count - 1;
+  for (uint32_t slot = 0; slot < tile_cache->slot_count; ++slot) {
+    const uint32_t tile_index = tile_cache->slot_tiles[slot];
+    if (tile_index == WGPU_TILE_CACHE_NO_SLOT) {
+      return slot;
+    }
+    const wgpu_tile_t* tile = &tile_cache->tiles[tile_index];
+    if (tile_index != pinned && tile->state == TileState_Resident
+        && tile->last_used < lru_frame) {
+      lru_slot  = slot;
+      lru_frame = tile->last_used;
+    }
+  }
+  if (lru_slot != WGPU_TILE_CACHE_NO_SLOT) {
+    wgpu_tile_t* tile = &tile_cache->tiles[tile_cache->slot_tiles[lru_slot]];
+    tile->state       = TileState_Absent;
+    tile->slot        = WGPU_TILE_CACHE_NO_SLOT;
+    tile_cache->slot_tiles[lru_slot] = WGPU_TILE_CACHE_NO_SLOT;
+    tile_cache->indirection_dirty    = true;
+    ++tile_cache->evicted_count;
+  }
+  return lru_slot;
+}
+
+static void tile_cache_finish_read(wgpu_tile_read_t* read)
+{
+  read->in_use = false;
+  --read->tile_cache->pending_count;
+}
+
+/* Main thread: the tile has been written to its slot */
+static void tile_cache_on_uploaded(void* user_data)
+{
+  wgpu_tile_read_t* read        = user_data;
+  wgpu_tile_cache_t* tile_cache = read->tile_cache;
+  wgpu_tile_t* tile             = &tile_cache->tiles[read->tile_index];
+  tile->state                   = TileState_Resident;
+  tile->last_used               = tile_cache->update_index;
+  tile_cache->indirection_dirty = true;
+  ++tile_cache->loaded_count;
+  tile_cache_finish_read(read);
+}
+
+/* I/O thread: decodes the tile */
+static void tile_cache_on_read(const file_read_response_t* response)
+{
+  wgpu_tile_read_t* read = response->user_data;
+  read->pixels           = NULL;
+  if (response->success && response->data != NULL) {
+    read->pixels = tile_cache_decode_tile(read->tile_cache, response->data,
+                                          response->size);
+  }
+}
+
+/* Main thread: queues the decoded tile on the upload scheduler */
+static void tile_cache_on_complete(const file_read_response_t* response)
+{
+  wgpu_tile_read_t* read        = response->user_data;
+  wgpu_tile_cache_t* tile_cache = read->tile_cache;
+  wgpu_tile_t* tile             = &tile_cache->tiles[read->tile_index];
+  if (read->pixels == NULL) {
+    log_warn("Couldn't load tile %u of '%s'", read->tile_index,
+             tile_cache->filename);
+    tile_cache->slot_tiles[tile->slot] = WGPU_TILE_CACHE_NO_SLOT;
+    tile->state                        = TileState_Absent;
+    tile->slot                         = WGPU_TILE_CACHE_NO_SLOT;
+    tile_cache_finish_read(read);
+    return;
+  }
+
+  // The scheduler copies the pixels, the coarser tiles are written first
+  const uint32_t slot_size = tile_cache->slot_size;
+  tile->state              = TileState_Uploading;
+  wgpu_upload_scheduler_upload_texture(
+    wgpu_get_upload_scheduler(tile_cache->wgpu_context),
+    &(wgpu_texture_upload_desc_t){
+      .texture = tile_cache->atlas,
+      .origin  = (WGPUOrigin3D){
+        .x = (tile->slot % tile_cache->atlas_tile_count) * slot_size,
+        .y = (tile->slot / tile_cache->atlas_tile_count) * slot_size,
+      },
+      .size          = (WGPUExtent3D){slot_size, slot_size, 1},
+      .data          = read->pixels,
+      .bytes_per_row = slot_size * 4,
+      .priority      = tile->level,
+      .callback      = tile_cache_on_uploaded,
+      .user_data     = read,
+    });
+  stbi_image_free(read->pixels);
+  read->pixels = NULL;
+}
+
+/* Issues the read of the tile into a free slot, false when no slot or read
+ * is available */
+static bool tile_cache_load_tile(wgpu_tile_cache_t* tile_cache,
+                                 uint32_t tile_index)
+{
+  wgpu_tile_read_t* read = NULL;
+  for (uint32_t i = 0; i < tile_cache->read_count && read == NULL; ++i) {
+    read = tile_cache->reads[i].in_use ? NULL : &tile_cache->reads[i];
+  }
+  if (read == NULL) {
+    return false;
+  }
+  const uint32_t slot = tile_cache_allocate_slot(tile_cache);
+  if (slot == WGPU_TILE_CACHE_NO_SLOT) {
+    return false;
+  }
+
+  wgpu_tile_t* tile                = &tile_cache->tiles[tile_index];
+  tile->state                      = TileState_Reading;
+  tile->slot                       = slot;
+  tile_cache->slot_tiles[slot]     = tile_index;
+  const tile_pyramid_entry_t entry = tile_cache->entries[tile_index];
+  read->in_use                     = true;
+  read->tile_index                 = tile_index;
+  ++tile_cache->pending_count;
+  file_read_async(&(file_read_request_t){
+    .filename    = tile_cache->filename,
+    .offset      = entry.offset,
+    .size        = entry.size,
+    .on_read     = tile_cache_on_read,
+    .on_complete = tile_cache_on_complete,
+    .user_data   = read,
+  });
+  return true;
+}
+
+/* Main thread: marks the tiles sampled in a frame */
+static void tile_cache_on_feedback(const void* data, uint64_t size,
+                                   uint64_t frame_number, void* user_data)
+{
+  UNUSED_VAR(frame_number);
+  wgpu_tile_cache_t* tile_cache = user_data;
+  const uint32_t* words         = data;
+  const uint32_t word_count     = (uint32_t)(size / sizeof(uint32_t));
+  for (uint32_t w = 0; w < word_count; ++w) {
+    uint32_t bits = words[w];
+    while (bits != 0) {
+      const uint32_t bit        = (uint32_t)__builtin_ctz(bits);
+      const uint32_t tile_index = w * 32 + bit;
+      bits &= bits - 1;
+      if (tile_index >= tile_cache->tile_count) {
+        break;
+      }
+      wgpu_tile_t* tile = &tile_cache->tiles[tile_index];
+      tile->last_used   = tile_cache->update_index;
+      if (tile->state == TileState_Absent && !tile->requested
+          && tile_cache->request_count < tile_cache->slot_count) {
+        tile->requested = true;
+        tile_cache->requests[tile_cache->request_count++] = tile_index;
+      }
+    }
+  }
+}
+
+/* Insertion sort of the requests, coarser levels first */
+static void tile_cache_sort_requests(wgpu_tile_cache_t* tile_cache)
+{
+  uint32_t* requests = tile_cache->requests;
+  for (uint32_t i = 1; i < tile_cache->request_count; ++i) {
+    const uint32_t request = requests[i];
+    const uint8_t level    = tile_cache->tiles[request].level;
+    uint32_t j             = i;
+    while (j > 0 && tile_cache->tiles[requests[j - 1]].level < level) {
+      requests[j] = requests[j - 1];
+      --j;
+    }
+    requests[j] = request;
+  }
+}
+
+/* Validates the header and the table of the mapped pyramid */
+static bool tile_cache_read_pyramid(wgpu_tile_cache_t* tile_cache)
+{
+  const file_mapping_t* mapping = &tile_cache->mapping;
+  if (mapping->size < sizeof(tile_pyramid_header_t)) {
+    return false;
+  }
+  tile_pyramid_header_t header;
+  memcpy(&header, mapping->data, sizeof(header));
+  if (memcmp(header.magic, "WTPY", 4) != 0
+      || header.version != WGPU_TILE_PYRAMID_VERSION || header.width == 0
+      || header.height == 0 || header.tile_size == 0
+      || header.level_count == 0
+      || header.level_count > WGPU_TILE_CACHE_MAX_LEVEL_COUNT
+      || header.tile_size + 2 * header.border
+           > WGPU_TILE_CACHE_MAX_ATLAS_SIZE) {
+    return false;
+  }
+
+  tile_cache_params_t* params = &tile_cache->params;
+  params->image_size[0]       = header.width;
+  params->image_size[1]       = header.height;
+  params->tile_size           = header.tile_size;
+  params->border              = header.border;
+  params->level_count         = header.level_count;
+  uint32_t tile_count         = 0;
+  for (uint32_t level = 0; level < header.level_count; ++level) {
+    const uint32_t width  = MAX(header.width >> level, 1u);
+    const uint32_t height = MAX(header.height >> level, 1u);
+    params->levels[level][0]
+      = (width + header.tile_size - 1) / header.tile_size;
+    params->levels[level][1]
+      = (height + header.tile_size - 1) / header.tile_size;
+    params->levels[level][2] = tile_count;
+    tile_count += params->levels[level][0] * params->levels[level][1];
+  }
+  const uint32_t* coarsest = params->levels[header.level_count - 1];
+  if (coarsest[0] != 1 || coarsest[1] != 1
+      || mapping->size < sizeof(header)
+                           + (uint64_t)tile_count
+                               * sizeof(tile_pyramid_entry_t)) {
+    return false;
+  }
+  tile_cache->tile_count = tile_count;
+  tile_cache->slot_size  = header.tile_size + 2 * header.border;
+  tile_cache->entries
+    = (const tile_pyramid_entry_t*)(mapping->data + sizeof(header));
+  for (uint32_t i = 0; i < tile_count; ++i) {
+    const tile_pyramid_entry_t* entry = &tile_cache->entries[i];
+    if (entry->size == 0 || entry->offset > mapping->size
+        || entry->size > mapping->size - entry->offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void tile_cache_create_resources(wgpu_tile_cache_t* tile_cache)
+{
+  wgpu_context_t* wgpu_context = tile_cache->wgpu_context;
+  const uint32_t atlas_size
+    = tile_cache->atlas_tile_count * tile_cache->slot_size;
+  tile_cache->params.atlas_size[0] = (float)atlas_size;
+  tile_cache->params.atlas_size[1] = (float)atlas_size;
+
+  tile_cache->atlas = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "tile_cache_atlas",
+      .usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){atlas_size, atlas_size, 1},
+      .format        = WGPUTextureFormat_RGBA8Unorm,
+      .mipLevelCount = 1,
+      .sampleCount   = 1,
+    });
+  ASSERT(tile_cache->atlas != NULL);
+  tile_cache->atlas_view = wgpuTextureCreateView(tile_cache->atlas, NULL);
+
+  // Power of two extents, so that every mip level holds the tiles of its
+  // pyramid level
+  uint32_t width = 1, height = 1;
+  while (width < tile_cache->params.levels[0][0]) {
+    width *= 2;
+  }
+  while (height < tile_cache->params.levels[0][1]) {
+    height *= 2;
+  }
+  tile_cache->indirection_texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "tile_cache_indirection",
+      .usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
+      .dimension     = WGPUTextureDimension_2D,
+      .size          = (WGPUExtent3D){width, height, 1},
+      .format        = WGPUTextureFormat_RGBA8Uint,
+      .mipLevelCount = tile_cache->params.level_count,
+      .sampleCount   = 1,
+    });
+  ASSERT(tile_cache->indirection_texture != NULL);
+  tile_cache->indirection_view
+    = wgpuTextureCreateView(tile_cache->indirection_texture, NULL);
+
+  tile_cache->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "tile_cache_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Nearest,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = 1.0f,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(tile_cache->sampler != NULL);
+
+  tile_cache->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "tile_cache_params",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(tile_cache_params_t),
+                    .initial.data = &tile_cache->params,
+                  });
+
+  // One bit per tile
+  const uint64_t feedback_size
+    = ((uint64_t)tile_cache->tile_count + 31) / 32 * sizeof(uint32_t);
+  tile_cache->feedback_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "tile_cache_feedback",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc
+                             | WGPUBufferUsage_Storage,
+                    .size = feedback_size,
+                  });
+  tile_cache->feedback_readback = wgpu_buffer_readback_create(
+    wgpu_context, &(wgpu_buffer_readback_desc_t){
+                    .size      = feedback_size,
+                    .func      = tile_cache_on_feedback,
+                    .user_data = tile_cache,
+                  });
+
+  WGPUBindGroupLayoutEntry bgl_entries[5] = {
+    [0] = (WGPUBindGroupLayoutEntry){
+      .binding    = 0,
+      .visibility = WGPUShaderStage_Fragment,
+      .buffer = (WGPUBufferBindingLayout){
+        .type           = WGPUBufferBindingType_Uniform,
+        .minBindingSize = sizeof(tile_cache_params_t),
+      },
+    },
+    [1] = (WGPUBindGroupLayoutEntry){
+      .binding    = 1,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout){
+        .sampleType    = WGPUTextureSampleType_Float,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+    },
+    [2] = (WGPUBindGroupLayoutEntry){
+      .binding    = 2,
+      .visibility = WGPUShaderStage_Fragment,
+      .texture = (WGPUTextureBindingLayout){
+        .sampleType    = WGPUTextureSampleType_Uint,
+        .viewDimension = WGPUTextureViewDimension_2D,
+      },
+    },
+    [3] = (WGPUBindGroupLayoutEntry){
+      .binding    = 3,
+      .visibility = WGPUShaderStage_Fragment,
+      .sampler = (WGPUSamplerBindingLayout){
+        .type = WGPUSamplerBindingType_Filtering,
+      },
+    },
+    [4] = (WGPUBindGroupLayoutEntry){
+      .binding    = 4,
+      .visibility = WGPUShaderStage_Fragment,
+      .buffer = (WGPUBufferBindingLayout){
+        .type           = WGPUBufferBindingType_Storage,
+        .minBindingSize = feedback_size,
+      },
+    },
+  };
+  tile_cache->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+    wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                            .label      = "tile_cache_bind_group_layout",
+                            .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                            .entries    = bgl_entries,
+                          });
+  ASSERT(tile_cache->bind_group_layout != NULL);
+
+  WGPUBindGroupEntry bg_entries[5] = {
+    [0] = (WGPUBindGroupEntry){
+      .binding = 0,
+      .buffer  = tile_cache->params_buffer.buffer,
+      .size    = tile_cache->params_buffer.size,
+    },
+    [1] = (WGPUBindGroupEntry){
+      .binding     = 1,
+      .textureView = tile_cache->atlas_view,
+    },
+    [2] = (WGPUBindGroupEntry){
+      .binding     = 2,
+      .textureView = tile_cache->indirection_view,
+    },
+    [3] = (WGPUBindGroupEntry){
+      .binding = 3,
+      .sampler = tile_cache->sampler,
+    },
+    [4] = (WGPUBindGroupEntry){
+      .binding = 4,
+      .buffer  = tile_cache->feedback_buffer.buffer,
+      .size    = tile_cache->feedback_buffer.size,
+    },
+  };
+  tile_cache->bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "tile_cache_bind_group",
+                            .layout     = tile_cache->bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(tile_cache->bind_group != NULL);
+}
+
+/* Loads the single tile of the coarsest level into slot 0, from the mapping */
+static bool tile_cache_load_root_tile(wgpu_tile_cache_t* tile_cache)
+{
+  const uint32_t tile_index            = tile_cache->tile_count - 1;
+  const tile_pyramid_entry_t* entry    = &tile_cache->entries[tile_index];
+  uint8_t* pixels = tile_cache_decode_tile(
+    tile_cache, tile_cache->mapping.data + entry->offset, entry->size);
+  if (pixels == NULL) {
+    return false;
+  }
+  const uint32_t slot_size = tile_cache->slot_size;
+  wgpuQueueWriteTexture(tile_cache->wgpu_context->queue,
+                        &(WGPUImageCopyTexture){
+                          .texture = tile_cache->atlas,
+                        },
+                        pixels, (size_t)slot_size * slot_size * 4,
+                        &(WGPUTextureDataLayout){
+                          .bytesPerRow  = slot_size * 4,
+                          .rowsPerImage = slot_size,
+                        },
+                        &(WGPUExtent3D){slot_size, slot_size, 1});
+  stbi_image_free(pixels);
+
+  tile_cache->tiles[tile_index].state = TileState_Resident;
+  tile_cache->tiles[tile_index].slot  = 0;
+  tile_cache->slot_tiles[0]           = tile_index;
+  tile_cache_update_indirection(tile_cache);
+  return true;
+}
+
+wgpu_tile_cache_t* wgpu_tile_cache_create(wgpu_context_t* wgpu_context,
+                                          const wgpu_tile_cache_desc_t* desc)
+{
+  wgpu_tile_cache_t* tile_cache
+    = (wgpu_tile_cache_t*)calloc(1, sizeof(wgpu_tile_cache_t));
+  tile_cache->wgpu_context = wgpu_context;
+  tile_cache->filename     = strdup(desc->filename);
+  if (!file_map(desc->filename, &tile_cache->mapping)
+      || !tile_cache_read_pyramid(tile_cache)) {
+    log_error("'%s' is no valid tiled pyramid", desc->filename);
+    wgpu_tile_cache_release(tile_cache);
+    return NULL;
+  }
+
+  const uint32_t atlas_tile_count
+    = desc->atlas_tile_count > 0 ? desc->atlas_tile_count :
+                                   WGPU_TILE_CACHE_DEFAULT_ATLAS_TILE_COUNT;
+  tile_cache->atlas_tile_count
+    = CLAMP(atlas_tile_count, 1u,
+            MIN(WGPU_TILE_CACHE_MAX_ATLAS_SIZE / tile_cache->slot_size, 256u));
+  tile_cache->slot_count
+    = tile_cache->atlas_tile_count * tile_cache->atlas_tile_count;
+  tile_cache->read_count = desc->max_pending_reads > 0 ?
+                             desc->max_pending_reads :
+                             WGPU_TILE_CACHE_DEFAULT_MAX_PENDING_READS;
+
+  tile_cache->tiles = calloc(tile_cache->tile_count, sizeof(wgpu_tile_t));
+  for (uint32_t level = 0; level < tile_cache->params.level_count; ++level) {
+    const uint32_t* info = tile_cache->params.levels[level];
+    for (uint32_t i = 0; i < info[0] * info[1]; ++i) {
+      tile_cache->tiles[info[2] + i].level = (uint8_t)level;
+      tile_cache->tiles[info[2] + i].slot  = WGPU_TILE_CACHE_NO_SLOT;
+    }
+  }
+  tile_cache->slot_tiles  = malloc(tile_cache->slot_count * sizeof(uint32_t));
+  tile_cache->requests    = malloc(tile_cache->slot_count * sizeof(uint32_t));
+  tile_cache->indirection = calloc(tile_cache->tile_count, sizeof(uint32_t));
+  tile_cache->reads = calloc(tile_cache->read_count, sizeof(wgpu_tile_read_t));
+  for (uint32_t i = 0; i < tile_cache->slot_count; ++i) {
+    tile_cache->slot_tiles[i] = WGPU_TILE_CACHE_NO_SLOT;
+  }
+  for (uint32_t i = 0; i < tile_cache->read_count; ++i) {
+    tile_cache->reads[i].tile_cache = tile_cache;
+  }
+
+  tile_cache_create_resources(tile_cache);
+  if (!tile_cache_load_root_tile(tile_cache)) {
+    log_error("Couldn't load the coarsest tile of '%s'", desc->filename);
+    wgpu_tile_cache_release(tile_cache);
+    return NULL;
+  }
+
+  return tile_cache;
+}
+
+void wgpu_tile_cache_release(wgpu_tile_cache_t* tile_cache)
+{
+  if (tile_cache == NULL) {
+    return;
+  }
+
+  // The read and upload callbacks reference the reads of the cache
+  if (tile_cache->reads != NULL) {
+    for (uint32_t i = 0; i < tile_cache->read_count; ++i) {
+      if (wgpu_upload_scheduler_cancel(
+            wgpu_get_upload_scheduler(tile_cache->wgpu_context),
+            &tile_cache->reads[i])
+          > 0) {
+        tile_cache_finish_read(&tile_cache->reads[i]);
+      }
+    }
+  }
+  while (tile_cache->pending_count > 0) {
+    job_system_process_completions(job_system_get_shared());
+    wgpu_upload_scheduler_flush(
+      wgpu_get_upload_scheduler(tile_cache->wgpu_context));
+  }
+
+  wgpu_buffer_readback_release(tile_cache->feedback_readback);
+  WGPU_RELEASE_RESOURCE(BindGroup, tile_cache->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, tile_cache->bind_group_layout)
+  WGPU_RELEASE_RESOURCE(Buffer, tile_cache->feedback_buffer.buffer)
+  WGPU_RELEASE_RESOURCE(Buffer, tile_cache->params_buffer.buffer)
+  WGPU_RELEASE_RESOURCE(Sampler, tile_cache->sampler)
+  WGPU_RELEASE_RESOURCE(TextureView, tile_cache->indirection_view)
+  WGPU_RELEASE_RESOURCE(Texture, tile_cache->indirection_texture)
+  WGPU_RELEASE_RESOURCE(TextureView, tile_cache->atlas_view)
+  WGPU_RELEASE_RESOURCE(Texture, tile_cache->atlas)
+  file_unmap(&tile_cache->mapping);
+  free(tile_cache->reads);
+  free(tile_cache->indirection);
+  free(tile_cache->requests);
+  free(tile_cache->slot_tiles);
+  free(tile_cache->tiles);
+  free(tile_cache->filename);
+  free(tile_cache);
+}
+
+void wgpu_tile_cache_update(wgpu_tile_cache_t* tile_cache)
+{
+  // The feedback callbacks collect the missing tiles
+  wgpu_buffer_readback_update(tile_cache->feedback_readback);
+
+  tile_cache_sort_requests(tile_cache);
+  uint32_t issued = 0;
+  while (issued < tile_cache->request_count
+         && tile_cache_load_tile(tile_cache, tile_cache->requests[issued])) {
+    ++issued;
+  }
+  // Requests without read or slot are repeated by the feedback of later
+  // frames
+  for (uint32_t i = 0; i < tile_cache->request_count; ++i) {
+    tile_cache->tiles[tile_cache->requests[i]].requested = false;
+  }
+  tile_cache->request_count = 0;
+
+  if (tile_cache->indirection_dirty) {
+    tile_cache_update_indirection(tile_cache);
+  }
+
+  ++tile_cache->update_index;
+  tile_cache->params.frame_index = (uint32_t)tile_cache->update_index;
+  wgpu_queue_write_buffer(tile_cache->wgpu_context,
+                          tile_cache->params_buffer.buffer,
+                          offsetof(tile_cache_params_t, frame_index),
+                          &tile_cache->params.frame_index, sizeof(uint32_t));
+}
+
+void wgpu_tile_cache_record_feedback(wgpu_tile_cache_t* tile_cache,
+                                     WGPUCommandEncoder cmd_enc)
+{
+  wgpu_buffer_readback_copy_buffer(
+    tile_cache->feedback_readback, cmd_enc,
+    tile_cache->feedback_buffer.buffer, 0, tile_cache->feedback_buffer.size,
+    tile_cache->update_index);
+  wgpuCommandEncoderClearBuffer(cmd_enc, tile_cache->feedback_buffer.buffer, 0,
+                                tile_cache->feedback_buffer.size);
+}
+
+void wgpu_tile_cache_get_stats(wgpu_tile_cache_t* tile_cache,
+                               wgpu_tile_cache_stats_t* stats)
+{
+  uint32_t resident_count = 0;
+  for (uint32_t slot = 0; slot < tile_cache->slot_count; ++slot) {
+    const uint32_t tile_index = tile_cache->slot_tiles[slot];
+    resident_count += tile_index != WGPU_TILE_CACHE_NO_SLOT
+                      && tile_cache->tiles[tile_index].state
+                           == TileState_Resident;
+  }
+  const uint64_t atlas_size
+    = (uint64_t)tile_cache->atlas_tile_count * tile_cache->slot_size;
+  *stats = (wgpu_tile_cache_stats_t){
+    .width          = tile_cache->params.image_size[0],
+    .height         = tile_cache->params.image_size[1],
+    .level_count    = tile_cache->params.level_count,
+    .tile_count     = tile_cache->tile_count,
+    .slot_count     = tile_cache->slot_count,
+    .resident_count = resident_count,
+    .pending_count  = tile_cache->pending_count,
+    .loaded_count   = tile_cache->loaded_count,
+    .evicted_count  = tile_cache->evicted_count,
+    .atlas_bytes    = atlas_size * atlas_size * 4,
+  };
+}
+
+WGPUBindGroupLayout
+wgpu_tile_cache_get_bind_group_layout(wgpu_tile_cache_t* tile_cache)
+{
+  return tile_cache->bind_group_layout;
+}
+
+WGPUBindGroup wgpu_tile_cache_get_bind_group(wgpu_tile_cache_t* tile_cache)
+{
+  return tile_cache->bind_group;
+}
+
+const char* wgpu_tile_cache_get_wgsl_functions(void)
+{
+  return tile_cache_wgsl_functions;
+}
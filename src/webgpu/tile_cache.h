@@ -0,0 +1,100 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include "context.h"
+
+#define WGPU_TILE_CACHE_MAX_LEVEL_COUNT 16u
+#define WGPU_TILE_CACHE_DEFAULT_ATLAS_TILE_COUNT 16u
+#define WGPU_TILE_CACHE_DEFAULT_MAX_PENDING_READS 16u
+
+/*
+ * Virtual texture tile cache for images that do not fit into one texture. The
+ * image is read from a tiled pyramid on disk, its tiles are decoded on demand
+ * into the slots of a fixed-size physical atlas and an indirection texture
+ * maps every tile of every level to the slot of the finest resident tile that
+ * covers it. The GPU memory does not depend on the size of the image.
+ *
+ * The shading passes report the tiles they sample into a feedback bit field,
+ * which is read back a few frames later. Missing tiles are read through the
+ * asynchronous file reads of the job system and written to the atlas by the
+ * upload scheduler of the context, the least recently used tiles are evicted
+ * when the atlas is full. The single tile of the coarsest level is loaded at
+ * creation and never evicted, so there is always a tile to fall back on.
+ *
+ * Tiled pyramid file layout, little endian:
+ *   header: char magic[4] = "WTPY", u32 version = 1, u32 width, u32 height,
+ *           u32 tile_size, u32 border, u32 level_count, u32 reserved
+ *   table:  per level, from the full resolution level 0 on, per tile in row
+ *           major order: u64 offset, u64 size of the encoded tile
+ *   tiles:  PNG or JPEG images of (tile_size + 2 * border)^2 texels, the
+ *           border repeats the texels of the neighbor tiles for filtering
+ * Level l is max(width >> l, 1) x max(height >> l, 1) texels, the coarsest
+ * level has a single tile.
+ */
+typedef struct wgpu_tile_cache wgpu_tile_cache_t;
+
+typedef struct wgpu_tile_cache_desc_t {
+  const char* filename;
+  /* Slots per side of the atlas, 0 selects the default. Clamped to the
+   * largest atlas the device supports */
+  uint32_t atlas_tile_count;
+  /* Tiles read and uploaded at the same time, 0 selects the default */
+  uint32_t max_pending_reads;
+} wgpu_tile_cache_desc_t;
+
+typedef struct wgpu_tile_cache_stats_t {
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  uint32_t tile_count;     /* tiles of all levels */
+  uint32_t slot_count;     /* slots of the atlas */
+  uint32_t resident_count; /* tiles in the atlas */
+  uint32_t pending_count;  /* tiles read or uploaded */
+  uint64_t loaded_count;   /* tiles loaded since the creation */
+  uint64_t evicted_count;  /* tiles evicted since the creation */
+  uint64_t atlas_bytes;
+} wgpu_tile_cache_stats_t;
+
+/* Tile cache creating/releasing, returns NULL when the file is no valid tiled
+ * pyramid */
+wgpu_tile_cache_t* wgpu_tile_cache_create(wgpu_context_t* wgpu_context,
+                                          const wgpu_tile_cache_desc_t* desc);
+void wgpu_tile_cache_release(wgpu_tile_cache_t* tile_cache);
+
+/* Processes the feedback read back meanwhile, issues the reads of the missing
+ * tiles and updates the indirection, to be called once per frame before the
+ * passes sampling the cache are recorded */
+void wgpu_tile_cache_update(wgpu_tile_cache_t* tile_cache);
+
+/* Records the readback and the clearing of the feedback of the frame, after
+ * the passes sampling the cache. The command buffer has to be submitted
+ * before the next update. */
+void wgpu_tile_cache_record_feedback(wgpu_tile_cache_t* tile_cache,
+                                     WGPUCommandEncoder cmd_enc);
+
+void wgpu_tile_cache_get_stats(wgpu_tile_cache_t* tile_cache,
+                               wgpu_tile_cache_stats_t* stats);
+
+/*
+ * Bind group of the shading passes, visible from fragment shaders:
+ *   binding 0: var<uniform> tileCacheParams : TileCacheParams
+ *   binding 1: var tileCacheAtlas : texture_2d<f32>
+ *   binding 2: var tileCacheIndirection : texture_2d<u32>
+ *   binding 3: var tileCacheSampler : sampler
+ *   binding 4: var<storage, read_write> tileCacheFeedback :
+ *              array<atomic<u32>>
+ */
+WGPUBindGroupLayout
+wgpu_tile_cache_get_bind_group_layout(wgpu_tile_cache_t* tile_cache);
+WGPUBindGroup wgpu_tile_cache_get_bind_group(wgpu_tile_cache_t* tile_cache);
+
+/*
+ * WGSL sampling functions for fragment shaders, to be prepended to their
+ * source. The shader declares the bindings of the bind group above with their
+ * names. The texture coordinates cover the image from 0 (top left) to 1, the
+ * function uses derivatives and has to be called in uniform control flow:
+ *   fn tileCacheSample(uv : vec2<f32>, fragCoord : vec2<f32>) -> vec4<f32>
+ */
+const char* wgpu_tile_cache_get_wgsl_functions(void);
+
+#endif
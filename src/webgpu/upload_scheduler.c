@@ -0,0 +1,346 @@
+#include "upload_scheduler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "../core/platform.h"
+
+typedef enum wgpu_upload_type_enum {
+  UploadType_Buffer  = 0,
+  UploadType_Texture = 1,
+} wgpu_upload_type_enum;
+
+typedef struct wgpu_upload_t {
+  struct wgpu_upload_t* next;
+  wgpu_upload_type_enum type;
+  int32_t priority;
+  uint8_t* data;
+  uint64_t size;    /* bytes of the upload */
+  uint64_t written; /* bytes written so far */
+  struct {
+    WGPUBuffer buffer;
+    uint64_t offset;
+  } buffer;
+  struct {
+    WGPUTexture texture;
+    uint32_t mip_level;
+    WGPUOrigin3D origin;
+    WGPUExtent3D size;
+    uint32_t bytes_per_row;
+    uint32_t rows_per_image;
+    uint32_t layer; /* layer and row of the next slab */
+    uint32_t row;
+  } texture;
+  wgpu_upload_callback_t callback;
+  void* user_data;
+} wgpu_upload_t;
+
+struct wgpu_upload_scheduler {
+  wgpu_context_t* wgpu_context;
+  uint64_t budget;
+  wgpu_upload_t* uploads; /* sorted by priority, highest first */
+  uint32_t queued_count;
+  uint64_t queued_bytes;
+  uint32_t frame_writes;
+  uint64_t frame_bytes;
+  /* Throughput measurement window */
+  float window_start;
+  uint64_t window_bytes;
+  float bytes_per_second;
+};
+
+wgpu_upload_scheduler_t*
+wgpu_upload_scheduler_create(wgpu_context_t* wgpu_context, uint64_t budget)
+{
+  wgpu_upload_scheduler_t* upload_scheduler
+    = (wgpu_upload_scheduler_t*)malloc(sizeof(wgpu_upload_scheduler_t));
+  memset(upload_scheduler, 0, sizeof(wgpu_upload_scheduler_t));
+  upload_scheduler->wgpu_context = wgpu_context;
+  upload_scheduler->window_start = platform_get_time();
+  wgpu_upload_scheduler_set_budget(upload_scheduler, budget);
+
+  return upload_scheduler;
+}
+
+static void wgpu_upload_release(wgpu_upload_t* upload)
+{
+  if (upload->type == UploadType_Buffer) {
+    WGPU_RELEASE_RESOURCE(Buffer, upload->buffer.buffer)
+  }
+  else {
+    WGPU_RELEASE_RESOURCE(Texture, upload->texture.texture)
+  }
+  free(upload->data);
+  free(upload);
+}
+
+void wgpu_upload_scheduler_release(wgpu_upload_scheduler_t* upload_scheduler)
+{
+  while (upload_scheduler->uploads != NULL) {
+    wgpu_upload_t* upload     = upload_scheduler->uploads;
+    upload_scheduler->uploads = upload->next;
+    wgpu_upload_release(upload);
+  }
+  free(upload_scheduler);
+}
+
+wgpu_upload_scheduler_t*
+wgpu_get_upload_scheduler(wgpu_context_t* wgpu_context)
+{
+  if (wgpu_context->upload_scheduler == NULL) {
+    wgpu_context->upload_scheduler
+      = wgpu_upload_scheduler_create(wgpu_context, 0);
+  }
+  return wgpu_context->upload_scheduler;
+}
+
+void wgpu_upload_scheduler_set_budget(wgpu_upload_scheduler_t* upload_scheduler,
+                                      uint64_t budget)
+{
+  upload_scheduler->budget
+    = budget > 0 ? budget : WGPU_UPLOAD_SCHEDULER_DEFAULT_BUDGET;
+}
+
+/* Queues the upload behind the uploads of the same or a higher priority */
+static void wgpu_upload_scheduler_enqueue(
+  wgpu_upload_scheduler_t* upload_scheduler, wgpu_upload_t* upload)
+{
+  wgpu_upload_t** upload_ref = &upload_scheduler->uploads;
+  while (*upload_ref != NULL && (*upload_ref)->priority >= upload->priority) {
+    upload_ref = &(*upload_ref)->next;
+  }
+  upload->next = *upload_ref;
+  *upload_ref  = upload;
+
+  ++upload_scheduler->queued_count;
+  upload_scheduler->queued_bytes += upload->size;
+}
+
+static wgpu_upload_t* wgpu_upload_create(uint64_t size, const void* data,
+                                         uint64_t data_size)
+{
+  wgpu_upload_t* upload = (wgpu_upload_t*)malloc(sizeof(wgpu_upload_t));
+  memset(upload, 0, sizeof(wgpu_upload_t));
+  upload->size = size;
+  upload->data = (uint8_t*)malloc(size);
+  memcpy(upload->data, data, data_size);
+  memset(upload->data + data_size, 0, size - data_size);
+
+  return upload;
+}
+
+void wgpu_upload_scheduler_upload_buffer(
+  wgpu_upload_scheduler_t* upload_scheduler,
+  const wgpu_buffer_upload_desc_t* desc)
+{
+  ASSERT(desc->buffer != NULL && (desc->offset & 3) == 0);
+  if (desc->size == 0) {
+    if (desc->callback != NULL) {
+      desc->callback(desc->user_data);
+    }
+    return;
+  }
+
+  /* Queue writes require a size that is a multiple of 4 */
+  wgpu_upload_t* upload
+    = wgpu_upload_create((desc->size + 3) & ~3ull, desc->data, desc->size);
+  upload->type          = UploadType_Buffer;
+  upload->priority      = desc->priority;
+  upload->buffer.buffer = desc->buffer;
+  upload->buffer.offset = desc->offset;
+  upload->callback      = desc->callback;
+  upload->user_data     = desc->user_data;
+  wgpuBufferReference(desc->buffer);
+
+  wgpu_upload_scheduler_enqueue(upload_scheduler, upload);
+}
+
+void wgpu_upload_scheduler_upload_texture(
+  wgpu_upload_scheduler_t* upload_scheduler,
+  const wgpu_texture_upload_desc_t* desc)
+{
+  ASSERT(desc->texture != NULL && desc->bytes_per_row > 0);
+  const uint32_t layer_count    = MAX(1u, desc->size.depthOrArrayLayers);
+  const uint32_t rows_per_image = desc->rows_per_image > 0 ?
+                                    desc->rows_per_image :
+                                    desc->size.height;
+  const uint64_t size
+    = (uint64_t)desc->bytes_per_row
+      * ((uint64_t)rows_per_image * (layer_count - 1) + desc->size.height);
+
+  wgpu_upload_t* upload          = wgpu_upload_create(size, desc->data, size);
+  upload->type                   = UploadType_Texture;
+  upload->priority               = desc->priority;
+  upload->texture.texture        = desc->texture;
+  upload->texture.mip_level      = desc->mip_level;
+  upload->texture.origin         = desc->origin;
+  upload->texture.size           = desc->size;
+  upload->texture.bytes_per_row  = desc->bytes_per_row;
+  upload->texture.rows_per_image = rows_per_image;
+  upload->callback               = desc->callback;
+  upload->user_data              = desc->user_data;
+  upload->texture.size.depthOrArrayLayers = layer_count;
+  wgpuTextureReference(desc->texture);
+
+  wgpu_upload_scheduler_enqueue(upload_scheduler, upload);
+}
+
+uint32_t wgpu_upload_scheduler_cancel(wgpu_upload_scheduler_t* upload_scheduler,
+                                      void* user_data)
+{
+  uint32_t cancel_count      = 0;
+  wgpu_upload_t** upload_ref = &upload_scheduler->uploads;
+  while (*upload_ref != NULL) {
+    wgpu_upload_t* upload = *upload_ref;
+    if (upload->user_data != user_data) {
+      upload_ref = &upload->next;
+      continue;
+    }
+    *upload_ref = upload->next;
+    --upload_scheduler->queued_count;
+    upload_scheduler->queued_bytes -= upload->size - upload->written;
+    wgpu_upload_release(upload);
+    ++cancel_count;
+  }
+
+  return cancel_count;
+}
+
+/* Smallest piece of the upload that can be written on its own */
+static uint64_t wgpu_upload_get_unit_size(const wgpu_upload_t* upload)
+{
+  return upload->type == UploadType_Buffer ? 4u :
+                                             upload->texture.bytes_per_row;
+}
+
+/**
+ * @brief Writes the next chunk or slab of rows of the upload, up to max_size
+ * bytes but at least one unit. Returns the number of bytes written.
+ */
+static uint64_t wgpu_upload_write(wgpu_upload_scheduler_t* upload_scheduler,
+                                  wgpu_upload_t* upload, uint64_t max_size)
+{
+  WGPUQueue queue = upload_scheduler->wgpu_context->queue;
+  if (upload->type == UploadType_Buffer) {
+    const uint64_t size
+      = MIN(upload->size - upload->written, MAX(max_size & ~3ull, 4u));
+    wgpuQueueWriteBuffer(queue, upload->buffer.buffer,
+                         upload->buffer.offset + upload->written,
+                         upload->data + upload->written, (size_t)size);
+    upload->written += size;
+    return size;
+  }
+
+  /* Slab of whole rows within the current layer */
+  const uint32_t bytes_per_row = upload->texture.bytes_per_row;
+  const uint32_t row_count     = (uint32_t)MIN(
+    upload->texture.size.height - upload->texture.row,
+    MAX(max_size / bytes_per_row, 1u));
+  const uint64_t data_offset
+    = ((uint64_t)upload->texture.layer * upload->texture.rows_per_image
+       + upload->texture.row)
+      * bytes_per_row;
+  wgpuQueueWriteTexture(queue,
+    &(WGPUImageCopyTexture) {
+      .texture  = upload->texture.texture,
+      .mipLevel = upload->texture.mip_level,
+      .origin   = (WGPUOrigin3D) {
+        .x = upload->texture.origin.x,
+        .y = upload->texture.origin.y + upload->texture.row,
+        .z = upload->texture.origin.z + upload->texture.layer,
+      },
+      .aspect   = WGPUTextureAspect_All,
+    },
+    upload->data + data_offset, (size_t)row_count * bytes_per_row,
+    &(WGPUTextureDataLayout){
+      .offset       = 0,
+      .bytesPerRow  = bytes_per_row,
+      .rowsPerImage = row_count,
+    },
+    &(WGPUExtent3D){
+      .width              = upload->texture.size.width,
+      .height             = row_count,
+      .depthOrArrayLayers = 1,
+    });
+
+  upload->texture.row += row_count;
+  if (upload->texture.row == upload->texture.size.height) {
+    upload->texture.row = 0;
+    ++upload->texture.layer;
+  }
+  /* The padding rows between the layers count as written */
+  const uint64_t size
+    = upload->texture.layer == upload->texture.size.depthOrArrayLayers ?
+        upload->size - upload->written :
+        (uint64_t)row_count * bytes_per_row;
+  upload->written += size;
+  return size;
+}
+
+static void
+wgpu_upload_scheduler_write(wgpu_upload_scheduler_t* upload_scheduler,
+                            uint64_t budget)
+{
+  upload_scheduler->frame_writes = 0;
+  upload_scheduler->frame_bytes  = 0;
+  while (upload_scheduler->uploads != NULL) {
+    wgpu_upload_t* upload = upload_scheduler->uploads;
+    const uint64_t remaining
+      = budget - MIN(budget, upload_scheduler->frame_bytes);
+    if (upload_scheduler->frame_bytes > 0
+        && wgpu_upload_get_unit_size(upload) > remaining) {
+      break;
+    }
+
+    const uint64_t size
+      = wgpu_upload_write(upload_scheduler, upload, remaining);
+    ++upload_scheduler->frame_writes;
+    upload_scheduler->frame_bytes += size;
+    upload_scheduler->queued_bytes -= size;
+    if (upload->written < upload->size) {
+      continue;
+    }
+
+    /* The callback may queue new uploads */
+    upload_scheduler->uploads = upload->next;
+    --upload_scheduler->queued_count;
+    if (upload->callback != NULL) {
+      upload->callback(upload->user_data);
+    }
+    wgpu_upload_release(upload);
+  }
+
+  upload_scheduler->window_bytes += upload_scheduler->frame_bytes;
+}
+
+void wgpu_upload_scheduler_process(wgpu_upload_scheduler_t* upload_scheduler)
+{
+  wgpu_upload_scheduler_write(upload_scheduler, upload_scheduler->budget);
+
+  const float now           = platform_get_time();
+  const float window_length = now - upload_scheduler->window_start;
+  if (window_length >= 1.0f) {
+    upload_scheduler->bytes_per_second
+      = (float)upload_scheduler->window_bytes / window_length;
+    upload_scheduler->window_start = now;
+    upload_scheduler->window_bytes = 0;
+  }
+}
+
+void wgpu_upload_scheduler_flush(wgpu_upload_scheduler_t* upload_scheduler)
+{
+  wgpu_upload_scheduler_write(upload_scheduler, UINT64_MAX);
+}
+
+void wgpu_upload_scheduler_get_stats(wgpu_upload_scheduler_t* upload_scheduler,
+                                     wgpu_upload_scheduler_stats_t* stats)
+{
+  *stats = (wgpu_upload_scheduler_stats_t){
+    .queued_count     = upload_scheduler->queued_count,
+    .queued_bytes     = upload_scheduler->queued_bytes,
+    .frame_writes     = upload_scheduler->frame_writes,
+    .frame_bytes      = upload_scheduler->frame_bytes,
+    .bytes_per_second = upload_scheduler->bytes_per_second,
+  };
+}
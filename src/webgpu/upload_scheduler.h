@@ -0,0 +1,104 @@
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include "context.h"
+
+/* Default number of bytes written through the queue per frame */
+#define WGPU_UPLOAD_SCHEDULER_DEFAULT_BUDGET (8u << 20)
+
+/*
+ * Upload scheduler: buffer and texture uploads are queued by priority and
+ * written with wgpuQueueWriteBuffer / wgpuQueueWriteTexture at the start of
+ * the frames, no more than the budget per frame. Large buffers are split into
+ * chunks and large textures into slabs of rows, so that a single upload does
+ * not stall a frame either. At least one chunk or row is written every frame.
+ *
+ * The data is copied when the upload is queued. The destination buffer or
+ * texture is referenced until the upload has been written.
+ */
+typedef struct wgpu_upload_scheduler wgpu_upload_scheduler_t;
+
+/* Called on the main thread once all data of the upload has been written */
+typedef void (*wgpu_upload_callback_t)(void* user_data);
+
+typedef struct wgpu_buffer_upload_desc_t {
+  WGPUBuffer buffer;
+  uint64_t offset; /* multiple of 4 */
+  const void* data;
+  uint64_t size; /* padded to a multiple of 4 */
+  /* Higher priorities are written first, equal ones in queue order */
+  int32_t priority;
+  /* Optional */
+  wgpu_upload_callback_t callback;
+  void* user_data;
+} wgpu_buffer_upload_desc_t;
+
+typedef struct wgpu_texture_upload_desc_t {
+  WGPUTexture texture;
+  uint32_t mip_level;
+  WGPUOrigin3D origin;
+  WGPUExtent3D size;
+  /* Uncompressed texels, the layers follow each other */
+  const void* data;
+  uint32_t bytes_per_row;
+  uint32_t rows_per_image; /* 0 selects size.height */
+  /* Higher priorities are written first, equal ones in queue order */
+  int32_t priority;
+  /* Optional */
+  wgpu_upload_callback_t callback;
+  void* user_data;
+} wgpu_texture_upload_desc_t;
+
+/* Statistics of the upload scheduler */
+typedef struct wgpu_upload_scheduler_stats_t {
+  uint32_t queued_count;    /* number of uploads not written yet */
+  uint64_t queued_bytes;    /* bytes of the uploads not written yet */
+  uint32_t frame_writes;    /* queue writes issued in the last frame */
+  uint64_t frame_bytes;     /* bytes written in the last frame */
+  float bytes_per_second;   /* throughput, averaged over about a second */
+} wgpu_upload_scheduler_stats_t;
+
+/* Upload scheduler creating/releasing, 0 selects the default budget. Uploads
+ * which have not been written are dropped without their callbacks. */
+wgpu_upload_scheduler_t*
+wgpu_upload_scheduler_create(wgpu_context_t* wgpu_context, uint64_t budget);
+void wgpu_upload_scheduler_release(wgpu_upload_scheduler_t* upload_scheduler);
+
+/* Returns the scheduler of the context, created on first use. Its uploads are
+ * written from wgpu_begin_frame(). */
+wgpu_upload_scheduler_t*
+wgpu_get_upload_scheduler(wgpu_context_t* wgpu_context);
+
+/* Sets the number of bytes written per frame, 0 selects the default */
+void wgpu_upload_scheduler_set_budget(wgpu_upload_scheduler_t* upload_scheduler,
+                                      uint64_t budget);
+
+/* Upload queueing */
+void wgpu_upload_scheduler_upload_buffer(
+  wgpu_upload_scheduler_t* upload_scheduler,
+  const wgpu_buffer_upload_desc_t* desc);
+void wgpu_upload_scheduler_upload_texture(
+  wgpu_upload_scheduler_t* upload_scheduler,
+  const wgpu_texture_upload_desc_t* desc);
+
+/**
+ * @brief Drops the queued uploads with the given user data without calling
+ * their callbacks, e.g. before the object they were issued for is destroyed.
+ * Returns the number of dropped uploads.
+ */
+uint32_t wgpu_upload_scheduler_cancel(wgpu_upload_scheduler_t* upload_scheduler,
+                                      void* user_data);
+
+/**
+ * @brief Writes the queued uploads within the budget of a frame, to be called
+ * once per frame before the command buffers of the frame are submitted.
+ */
+void wgpu_upload_scheduler_process(wgpu_upload_scheduler_t* upload_scheduler);
+
+/* Writes all queued uploads regardless of the budget */
+void wgpu_upload_scheduler_flush(wgpu_upload_scheduler_t* upload_scheduler);
+
+void wgpu_upload_scheduler_get_stats(wgpu_upload_scheduler_t* upload_scheduler,
+                                     wgpu_upload_scheduler_stats_t* stats);
+
+#endif
@@ -0,0 +1,308 @@
+#include "video_upload.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/log.h"
+#include "../core/macro.h"
+
+/* Row pitch alignment of buffer to texture copies */
+#define WGPU_COPY_BYTES_PER_ROW_ALIGNMENT 256u
+
+typedef enum wgpu_video_upload_state_enum {
+  VideoUploadState_Mapping = 0, /* map for writing requested */
+  VideoUploadState_Free    = 1, /* mapped, ready for the decoder */
+  VideoUploadState_Writing = 2, /* written by the decode thread */
+  VideoUploadState_Filled  = 3, /* holds a decoded frame */
+  VideoUploadState_Lost    = 4, /* mapping failed, not used anymore */
+} wgpu_video_upload_state_enum;
+
+typedef struct wgpu_video_upload_buffer_t {
+  struct wgpu_video_upload* video_upload;
+  WGPUBuffer buffer;
+  wgpu_video_upload_state_enum state;
+  uint8_t* mapping;
+} wgpu_video_upload_buffer_t;
+
+/* Placement of a frame plane in the staging buffers */
+typedef struct wgpu_video_upload_plane_t {
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytes_per_row; /* padded row pitch */
+  uint32_t bytes_per_texel;
+  uint64_t offset;
+} wgpu_video_upload_plane_t;
+
+struct wgpu_video_upload {
+  wgpu_context_t* wgpu_context;
+  video_frame_format_enum format;
+  uint32_t plane_count;
+  wgpu_video_upload_plane_t planes[2];
+  uint64_t buffer_size;
+  uint32_t buffer_count;
+  wgpu_video_upload_buffer_t buffers[WGPU_VIDEO_UPLOAD_MAX_BUFFER_COUNT];
+  wgpu_video_upload_buffer_t* latest; /* most recently filled buffer */
+  pthread_mutex_t mutex;              /* guards the buffer states */
+};
+
+static uint32_t wgpu_video_upload_align_row(uint32_t bytes_per_row)
+{
+  return (bytes_per_row + WGPU_COPY_BYTES_PER_ROW_ALIGNMENT - 1)
+         & ~(WGPU_COPY_BYTES_PER_ROW_ALIGNMENT - 1);
+}
+
+static void wgpu_video_upload_map_cb(WGPUBufferMapAsyncStatus status,
+                                     void* user_data)
+{
+  wgpu_video_upload_buffer_t* up_buffer
+    = (wgpu_video_upload_buffer_t*)user_data;
+  wgpu_video_upload_t* upload = up_buffer->video_upload;
+  pthread_mutex_lock(&upload->mutex);
+  if (status != WGPUBufferMapAsyncStatus_Success) {
+    log_error("Could not map video staging buffer (status: %d)", status);
+    up_buffer->state = VideoUploadState_Lost;
+    pthread_mutex_unlock(&upload->mutex);
+    return;
+  }
+  up_buffer->mapping = (uint8_t*)wgpuBufferGetMappedRange(
+    up_buffer->buffer, 0, (size_t)upload->buffer_size);
+  up_buffer->state = VideoUploadState_Free;
+  pthread_mutex_unlock(&upload->mutex);
+}
+
+/* Runs on the decode thread */
+static int wgpu_video_upload_acquire(void* user_data,
+                                     video_frame_planes_t* planes)
+{
+  wgpu_video_upload_t* upload = (wgpu_video_upload_t*)user_data;
+  uint8_t* data               = NULL;
+  pthread_mutex_lock(&upload->mutex);
+  for (uint32_t i = 0; i < upload->buffer_count; ++i) {
+    wgpu_video_upload_buffer_t* up_buffer = &upload->buffers[i];
+    if (up_buffer->state == VideoUploadState_Free) {
+      up_buffer->state = VideoUploadState_Writing;
+      data             = up_buffer->mapping;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&upload->mutex);
+  if (data == NULL) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < upload->plane_count; ++i) {
+    planes->data[i]          = data + upload->planes[i].offset;
+    planes->bytes_per_row[i] = upload->planes[i].bytes_per_row;
+  }
+  return 1;
+}
+
+/* Runs on the decode thread, a frame which has not been uploaded yet is
+ * superseded by the new one */
+static void wgpu_video_upload_submit(void* user_data,
+                                     const video_frame_planes_t* planes)
+{
+  wgpu_video_upload_t* upload = (wgpu_video_upload_t*)user_data;
+  pthread_mutex_lock(&upload->mutex);
+  for (uint32_t i = 0; i < upload->buffer_count; ++i) {
+    wgpu_video_upload_buffer_t* up_buffer = &upload->buffers[i];
+    if (up_buffer->mapping == planes->data[0]
+        && up_buffer->state == VideoUploadState_Writing) {
+      if (upload->latest != NULL) {
+        upload->latest->state = VideoUploadState_Free;
+      }
+      up_buffer->state = VideoUploadState_Filled;
+      upload->latest   = up_buffer;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&upload->mutex);
+}
+
+wgpu_video_upload_t*
+wgpu_video_upload_create(wgpu_context_t* wgpu_context,
+                         const wgpu_video_upload_desc_t* desc)
+{
+  ASSERT(desc->width > 0 && desc->height > 0);
+
+  wgpu_video_upload_t* upload
+    = (wgpu_video_upload_t*)malloc(sizeof(wgpu_video_upload_t));
+  memset(upload, 0, sizeof(wgpu_video_upload_t));
+  upload->wgpu_context = wgpu_context;
+  upload->format       = desc->format;
+  if (desc->format == VideoFrameFormat_NV12) {
+    /* The UV plane follows the Y plane, both padded to the row alignment */
+    const uint32_t cw = (desc->width + 1) / 2;
+    const uint32_t ch = (desc->height + 1) / 2;
+    upload->planes[0] = (wgpu_video_upload_plane_t){
+      .width           = desc->width,
+      .height          = desc->height,
+      .bytes_per_row   = wgpu_video_upload_align_row(desc->width),
+      .bytes_per_texel = 1,
+    };
+    upload->planes[1] = (wgpu_video_upload_plane_t){
+      .width           = cw,
+      .height          = ch,
+      .bytes_per_row   = wgpu_video_upload_align_row(cw * 2),
+      .bytes_per_texel = 2,
+      .offset = (uint64_t)upload->planes[0].bytes_per_row * desc->height,
+    };
+    upload->plane_count = 2;
+  }
+  else {
+    upload->planes[0] = (wgpu_video_upload_plane_t){
+      .width           = desc->width,
+      .height          = desc->height,
+      .bytes_per_row   = wgpu_video_upload_align_row(desc->width * 4),
+      .bytes_per_texel = 4,
+    };
+    upload->plane_count = 1;
+  }
+  const wgpu_video_upload_plane_t* last_plane
+    = &upload->planes[upload->plane_count - 1];
+  upload->buffer_size = last_plane->offset
+                        + (uint64_t)last_plane->bytes_per_row
+                            * last_plane->height;
+  upload->buffer_count = desc->buffer_count > 0 ? desc->buffer_count : 3u;
+  upload->buffer_count
+    = CLAMP(upload->buffer_count, 2u, WGPU_VIDEO_UPLOAD_MAX_BUFFER_COUNT);
+  pthread_mutex_init(&upload->mutex, NULL);
+
+  /* The buffers are created mapped, so that the decoder can start right away */
+  for (uint32_t i = 0; i < upload->buffer_count; ++i) {
+    wgpu_video_upload_buffer_t* up_buffer = &upload->buffers[i];
+    up_buffer->video_upload               = upload;
+    up_buffer->buffer                     = wgpuDeviceCreateBuffer(
+      wgpu_context->device,
+      &(WGPUBufferDescriptor){
+        .label            = "video_staging_buffer",
+        .usage            = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc,
+        .size             = upload->buffer_size,
+        .mappedAtCreation = true,
+      });
+    ASSERT(up_buffer->buffer != NULL);
+    up_buffer->mapping = (uint8_t*)wgpuBufferGetMappedRange(
+      up_buffer->buffer, 0, (size_t)upload->buffer_size);
+    ASSERT(up_buffer->mapping != NULL);
+    up_buffer->state = VideoUploadState_Free;
+  }
+
+  return upload;
+}
+
+void wgpu_video_upload_release(wgpu_video_upload_t* upload)
+{
+  /* Mapping buffers must not be released before their callback has run */
+  for (uint32_t i = 0; i < upload->buffer_count; ++i) {
+    while (upload->buffers[i].state == VideoUploadState_Mapping) {
+      wgpuDeviceTick(upload->wgpu_context->device);
+    }
+    WGPU_RELEASE_RESOURCE(Buffer, upload->buffers[i].buffer)
+  }
+  pthread_mutex_destroy(&upload->mutex);
+  free(upload);
+}
+
+video_frame_sink_t wgpu_video_upload_get_frame_sink(wgpu_video_upload_t* upload)
+{
+  return (video_frame_sink_t){
+    .format    = upload->format,
+    .acquire   = wgpu_video_upload_acquire,
+    .submit    = wgpu_video_upload_submit,
+    .user_data = upload,
+  };
+}
+
+/* Copies a region of a plane, the planes after the first one are subsampled
+ * by 2 */
+static void wgpu_video_upload_copy_region(
+  WGPUCommandEncoder cmd_enc, const wgpu_video_upload_t* upload,
+  WGPUBuffer buffer, uint32_t plane_index, WGPUTexture texture,
+  const wgpu_video_upload_region_t* region)
+{
+  const wgpu_video_upload_plane_t* plane = &upload->planes[plane_index];
+  const uint32_t shift                   = plane_index > 0 ? 1 : 0;
+  const uint32_t x0                      = region->x >> shift;
+  const uint32_t y0                      = region->y >> shift;
+  const uint32_t x1
+    = MIN((region->x + region->width + shift) >> shift, plane->width);
+  const uint32_t y1
+    = MIN((region->y + region->height + shift) >> shift, plane->height);
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+
+  wgpuCommandEncoderCopyBufferToTexture(
+    cmd_enc,
+    &(WGPUImageCopyBuffer){
+      .buffer = buffer,
+      .layout = (WGPUTextureDataLayout){
+        .offset       = plane->offset + (uint64_t)y0 * plane->bytes_per_row
+                        + (uint64_t)x0 * plane->bytes_per_texel,
+        .bytesPerRow  = plane->bytes_per_row,
+        .rowsPerImage = y1 - y0,
+      },
+    },
+    &(WGPUImageCopyTexture){
+      .texture = texture,
+      .origin  = (WGPUOrigin3D){
+        .x = x0,
+        .y = y0,
+      },
+    },
+    &(WGPUExtent3D){
+      .width              = x1 - x0,
+      .height             = y1 - y0,
+      .depthOrArrayLayers = 1,
+    });
+}
+
+bool wgpu_video_upload_update(wgpu_video_upload_t* upload, WGPUTexture texture,
+                              WGPUTexture uv_texture)
+{
+  const wgpu_video_upload_region_t frame = {
+    .width  = upload->planes[0].width,
+    .height = upload->planes[0].height,
+  };
+  return wgpu_video_upload_update_regions(upload, texture, uv_texture, &frame,
+                                          1);
+}
+
+bool wgpu_video_upload_update_regions(
+  wgpu_video_upload_t* upload, WGPUTexture texture, WGPUTexture uv_texture,
+  const wgpu_video_upload_region_t* regions, uint32_t region_count)
+{
+  pthread_mutex_lock(&upload->mutex);
+  wgpu_video_upload_buffer_t* up_buffer = upload->latest;
+  if (up_buffer != NULL) {
+    up_buffer->state   = VideoUploadState_Mapping;
+    up_buffer->mapping = NULL;
+    upload->latest     = NULL;
+  }
+  pthread_mutex_unlock(&upload->mutex);
+  if (up_buffer == NULL) {
+    return false;
+  }
+
+  wgpu_context_t* wgpu_context = upload->wgpu_context;
+  wgpuBufferUnmap(up_buffer->buffer);
+  WGPUCommandEncoder cmd_enc
+    = wgpuDeviceCreateCommandEncoder(wgpu_context->device, NULL);
+  for (uint32_t i = 0; i < upload->plane_count; ++i) {
+    for (uint32_t r = 0; r < region_count; ++r) {
+      wgpu_video_upload_copy_region(cmd_enc, upload, up_buffer->buffer, i,
+                                    i == 0 ? texture : uv_texture,
+                                    &regions[r]);
+    }
+  }
+  WGPUCommandBuffer command_buffer = wgpu_get_command_buffer(cmd_enc);
+  WGPU_RELEASE_RESOURCE(CommandEncoder, cmd_enc)
+  wgpuQueueSubmit(wgpu_context->queue, 1, &command_buffer);
+  WGPU_RELEASE_RESOURCE(CommandBuffer, command_buffer)
+
+  /* Hand the buffer back to the decoder once the copy has been executed */
+  wgpuBufferMapAsync(up_buffer->buffer, WGPUMapMode_Write, 0,
+                     upload->buffer_size,
+                     wgpu_video_upload_map_cb, up_buffer);
+  return true;
+}
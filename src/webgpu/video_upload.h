@@ -0,0 +1,70 @@
+#ifndef VIDEO_UPLOAD_H
+#define VIDEO_UPLOAD_H
+
+#include "context.h"
+
+#include "../core/video_decode.h"
+
+#define WGPU_VIDEO_UPLOAD_MAX_BUFFER_COUNT 4u
+
+/*
+ * Upload path for decoded video frames: the decoder writes every frame into
+ * one of a ring of mapped staging buffers, rows padded to 256 bytes, from
+ * which the frame is copied into the texture on the GPU. This replaces the
+ * copies into the decode buffer and through wgpuQueueWriteTexture.
+ *
+ * NV12 frames are uploaded as they are decoded, into an R8Unorm texture for
+ * the Y plane and an RG8Unorm texture of half the size for the UV plane, and
+ * converted to RGB when they are sampled.
+ */
+typedef struct wgpu_video_upload wgpu_video_upload_t;
+
+typedef struct wgpu_video_upload_desc_t {
+  uint32_t width;
+  uint32_t height;
+  video_frame_format_enum format;
+  /* Number of staging buffers, 0 selects 3 */
+  uint32_t buffer_count;
+} wgpu_video_upload_desc_t;
+
+/* Rectangle of a frame, in texels of the first plane */
+typedef struct wgpu_video_upload_region_t {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+} wgpu_video_upload_region_t;
+
+/* Video upload creating/releasing. The decoder must not write into the upload
+ * anymore when it is released. */
+wgpu_video_upload_t*
+wgpu_video_upload_create(wgpu_context_t* wgpu_context,
+                         const wgpu_video_upload_desc_t* desc);
+void wgpu_video_upload_release(wgpu_video_upload_t* video_upload);
+
+/* Frame sink for video_decoder_set_frame_sink, which writes into the staging
+ * ring */
+video_frame_sink_t
+wgpu_video_upload_get_frame_sink(wgpu_video_upload_t* video_upload);
+
+/**
+ * @brief Copies the most recently decoded frame into the texture, and the UV
+ * plane of NV12 frames into uv_texture, then maps its staging buffer again for
+ * the decoder. To be called once per frame from the main thread, returns false
+ * when no new frame has been decoded.
+ */
+bool wgpu_video_upload_update(wgpu_video_upload_t* video_upload,
+                              WGPUTexture texture, WGPUTexture uv_texture);
+
+/**
+ * @brief Same as wgpu_video_upload_update, but copies only the regions of the
+ * frame, e.g. the parts of the video in view, the other texels keep the frame
+ * they were last copied from. The regions of NV12 frames are rounded out to
+ * whole texels of the UV plane.
+ */
+bool wgpu_video_upload_update_regions(
+  wgpu_video_upload_t* video_upload, WGPUTexture texture,
+  WGPUTexture uv_texture, const wgpu_video_upload_region_t* regions,
+  uint32_t region_count);
+
+#endif
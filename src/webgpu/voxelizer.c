@@ -0,0 +1,1229 @@
+#include "voxelizer.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "buffer.h"
+#include "gltf_model.h"
+#include "shader.h"
+
+#define VOXELIZER_TRIANGLE_WORKGROUP_SIZE 64u
+#define VOXELIZER_REGION_WORKGROUP_SIZE 4u
+/* Dynamic offset alignment of the parameter slots */
+#define VOXELIZER_PARAMS_STRIDE 256u
+/* Slots of the static clear, the dynamic clear and the resolve pass */
+#define VOXELIZER_REGION_SLOT_COUNT 3u
+
+/* Bit volumes */
+#define VOXELIZER_STATIC_VOLUME 0u
+#define VOXELIZER_DYNAMIC_VOLUME 1u
+
+/* Layout of VoxelizerParams, one slot per dispatch */
+typedef struct voxelizer_params_t {
+  mat4 to_grid;
+  uint32_t origin[4]; /* region origin in voxels, w: mip level */
+  uint32_t size[4];   /* region size in voxels, w: bit volume */
+  uint32_t mesh[4];   /* first index, triangle count, base vertex, resolution */
+} voxelizer_params_t;
+
+/* Layout of VoxelGrid */
+typedef struct voxelizer_grid_t {
+  vec3 origin;
+  float voxel_size;
+  uint32_t resolution;
+  uint32_t level_count;
+  uint32_t word_count; /* words of one bit volume */
+  uint32_t padding;
+} voxelizer_grid_t;
+
+/* Voxel region, empty unless min < max on all axes */
+typedef struct voxelizer_box_t {
+  uint32_t min[3];
+  uint32_t max[3];
+} voxelizer_box_t;
+
+typedef struct voxelizer_object_t {
+  bool dynamic;
+  bool dirty;
+  mat4 transform;
+  vec3 bounds_min; /* model space bounds of the vertices */
+  vec3 bounds_max;
+  uint32_t first_index;
+  uint32_t triangle_count;
+  uint32_t base_vertex;
+  voxelizer_box_t box; /* voxels of the last voxelization */
+} voxelizer_object_t;
+
+struct wgpu_voxelizer {
+  wgpu_context_t* wgpu_context;
+  uint32_t resolution;
+  uint32_t level_count;
+  voxelizer_grid_t grid;
+  mat4 grid_from_world;
+  voxelizer_object_t* objects;
+  uint32_t object_count;
+  uint32_t triangle_count;
+  bool static_dirty;
+  wgpu_voxelizer_stats_t last_update;
+  /* One slot per object and region pass and per mip level */
+  voxelizer_params_t* params;
+  uint32_t params_slot_count;
+  wgpu_buffer_t params_buffer;
+  wgpu_buffer_t grid_buffer;
+  wgpu_buffer_t positions_buffer;
+  wgpu_buffer_t indices_buffer;
+  /* Static bit volume followed by the dynamic one, 32 voxels along x in a
+   * word */
+  wgpu_buffer_t bits_buffer;
+  WGPUTexture texture;
+  WGPUTextureView texture_view;
+  WGPUTextureView level_views[10];
+  WGPUSampler sampler;
+  WGPUBindGroupLayout build_bind_group_layout;
+  WGPUBindGroupLayout resolve_bind_group_layout;
+  WGPUBindGroupLayout mip_bind_group_layout;
+  WGPUBindGroup build_bind_group;
+  WGPUBindGroup resolve_bind_group;
+  WGPUBindGroup mip_bind_groups[10];
+  WGPUComputePipeline voxelize_pipeline;
+  WGPUComputePipeline clear_pipeline;
+  WGPUComputePipeline resolve_pipeline;
+  WGPUComputePipeline mip_pipeline;
+  WGPUBindGroupLayout bind_group_layout;
+  WGPUBindGroup bind_group;
+};
+
+// clang-format off
+static const char* voxelizer_wgsl_functions = CODE(
+  struct VoxelGrid {
+    origin : vec3<f32>,
+    voxelSize : f32,
+    resolution : u32,
+    levelCount : u32,
+    wordCount : u32,
+    padding : u32,
+  };
+
+  fn voxelGridToGrid(position : vec3<f32>) -> vec3<f32> {
+    return (position - voxelGrid.origin) / voxelGrid.voxelSize;
+  }
+
+  // Static or dynamic voxel, false outside of the grid
+  fn voxelGridIsOccupied(voxel : vec3<i32>) -> bool {
+    let resolution = i32(voxelGrid.resolution);
+    if (any(voxel < vec3<i32>(0)) || any(voxel >= vec3<i32>(resolution))) {
+      return false;
+    }
+    let v = vec3<u32>(voxel);
+    let word = (v.z * voxelGrid.resolution + v.y) * (voxelGrid.resolution / 32u)
+               + v.x / 32u;
+    let bits = voxelGridBits[word] | voxelGridBits[voxelGrid.wordCount + word];
+    return (bits & (1u << (v.x % 32u))) != 0u;
+  }
+
+  // Filtered opacity of the mip level lod, e.g. along a cone
+  fn voxelGridSampleOpacity(position : vec3<f32>, lod : f32) -> f32 {
+    let uvw = voxelGridToGrid(position) / f32(voxelGrid.resolution);
+    return textureSampleLevel(voxelGridTexture, voxelGridSampler, uvw, lod).a;
+  }
+
+  fn voxelGridIsSegmentOccluded(start : vec3<f32>, end : vec3<f32>) -> bool {
+    let a = voxelGridToGrid(start);
+    let b = voxelGridToGrid(end);
+    let startVoxel = vec3<i32>(floor(a));
+    let endVoxel = vec3<i32>(floor(b));
+    let stepCount = u32(ceil(distance(a, b) * 2.0));
+    for (var i = 1u; i < stepCount; i = i + 1u) {
+      let voxel = vec3<i32>(floor(mix(a, b, f32(i) / f32(stepCount))));
+      if (any(voxel != startVoxel) && any(voxel != endVoxel)
+          && voxelGridIsOccupied(voxel)) {
+        return true;
+      }
+    }
+    return false;
+  }
+);
+
+static const char* voxelizer_params_wgsl = CODE(
+  struct VoxelizerParams {
+    toGrid : mat4x4<f32>,
+    origin : vec4<u32>,
+    size : vec4<u32>,
+    mesh : vec4<u32>,
+  };
+
+  @group(0) @binding(0) var<uniform> params : VoxelizerParams;
+  @group(0) @binding(1) var<storage, read> positions : array<f32>;
+  @group(0) @binding(2) var<storage, read> indices : array<u32>;
+  @group(0) @binding(3) var<storage, read_write> voxelBits
+    : array<atomic<u32>>;
+
+  // Word of the voxel in the bit volume of the pass
+  fn voxelWord(voxel : vec3<u32>) -> u32 {
+    let resolution = params.mesh.w;
+    let wordCount = resolution * resolution * (resolution / 32u);
+    return params.size.w * wordCount
+           + (voxel.z * resolution + voxel.y) * (resolution / 32u)
+           + voxel.x / 32u;
+  }
+);
+
+static const char* voxelizer_shader_wgsl = CODE(
+  @group(1) @binding(0) var voxelTexture
+    : texture_storage_3d<rgba8unorm, write>;
+
+  fn gridVertex(i : u32) -> vec3<f32> {
+    let v = (params.mesh.z + indices[params.mesh.x + i]) * 3u;
+    let position = vec4<f32>(positions[v], positions[v + 1u],
+                             positions[v + 2u], 1.0);
+    return (params.toGrid * position).xyz;
+  }
+
+  // Edge functions of the triangle projected along axis c, offset to the
+  // critical corner of the unit square of a voxel
+  struct EdgeTest {
+    n0 : vec2<f32>,
+    n1 : vec2<f32>,
+    n2 : vec2<f32>,
+    d : vec3<f32>,
+  };
+
+  fn project(p : vec3<f32>, c : u32) -> vec2<f32> {
+    return vec2<f32>(p[(c + 1u) % 3u], p[(c + 2u) % 3u]);
+  }
+
+  fn edgeOffset(n : vec2<f32>, p : vec2<f32>) -> f32 {
+    return -dot(n, p) + max(0.0, n.x) + max(0.0, n.y);
+  }
+
+  fn edgeTest(v0 : vec3<f32>, v1 : vec3<f32>, v2 : vec3<f32>,
+              normal : vec3<f32>, c : u32) -> EdgeTest {
+    let s = select(-1.0, 1.0, normal[c] >= 0.0);
+    let p0 = project(v0, c);
+    let p1 = project(v1, c);
+    let p2 = project(v2, c);
+    var t : EdgeTest;
+    t.n0 = vec2<f32>(p0.y - p1.y, p1.x - p0.x) * s;
+    t.n1 = vec2<f32>(p1.y - p2.y, p2.x - p1.x) * s;
+    t.n2 = vec2<f32>(p2.y - p0.y, p0.x - p2.x) * s;
+    t.d = vec3<f32>(edgeOffset(t.n0, p0), edgeOffset(t.n1, p1),
+                    edgeOffset(t.n2, p2));
+    return t;
+  }
+
+  fn edgeTestPasses(t : EdgeTest, p : vec2<f32>) -> bool {
+    return dot(t.n0, p) + t.d.x >= 0.0 && dot(t.n1, p) + t.d.y >= 0.0
+           && dot(t.n2, p) + t.d.z >= 0.0;
+  }
+
+  // One triangle per invocation, its voxels are visited in columns along the
+  // dominant axis, the plane of the triangle crosses few voxels per column
+  @compute @workgroup_size(64)
+  fn voxelize(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.mesh.y) {
+      return;
+    }
+    let v0 = gridVertex(id.x * 3u);
+    let v1 = gridVertex(id.x * 3u + 1u);
+    let v2 = gridVertex(id.x * 3u + 2u);
+    let normal = cross(v1 - v0, v2 - v1);
+    if (dot(normal, normal) == 0.0) {
+      return;
+    }
+    let last = f32(params.mesh.w) - 1.0;
+    let bbMin = max(floor(min(min(v0, v1), v2)), vec3<f32>(0.0));
+    let bbMax = min(floor(max(max(v0, v1), v2)), vec3<f32>(last));
+    if (any(bbMin > bbMax)) {
+      return;
+    }
+
+    // Plane overlap of the voxel at the critical point
+    let c = select(vec3<f32>(0.0), vec3<f32>(1.0), normal > vec3<f32>(0.0));
+    let d1 = dot(normal, c - v0);
+    let d2 = dot(normal, vec3<f32>(1.0) - c - v0);
+    let k = dot(normal, v0);
+
+    let n = abs(normal);
+    var w = 2u;
+    if (n.x >= n.y && n.x >= n.z) {
+      w = 0u;
+    } else if (n.y >= n.z) {
+      w = 1u;
+    }
+    let u = (w + 1u) % 3u;
+    let v = (w + 2u) % 3u;
+    let testW = edgeTest(v0, v1, v2, normal, w);
+    let testU = edgeTest(v0, v1, v2, normal, u);
+    let testV = edgeTest(v0, v1, v2, normal, v);
+
+    for (var a = bbMin[u]; a <= bbMax[u]; a = a + 1.0) {
+      for (var b = bbMin[v]; b <= bbMax[v]; b = b + 1.0) {
+        if (!edgeTestPasses(testW, vec2<f32>(a, b))) {
+          continue;
+        }
+        // Range of the plane along the dominant axis over the column
+        let z00 = (k - normal[u] * a - normal[v] * b) / normal[w];
+        let du = -normal[u] / normal[w];
+        let dv = -normal[v] / normal[w];
+        let z0 = min(min(z00, z00 + du), min(z00 + dv, z00 + du + dv));
+        let z1 = max(max(z00, z00 + du), max(z00 + dv, z00 + du + dv));
+        let zMin = max(floor(z0), bbMin[w]);
+        let zMax = min(floor(z1), bbMax[w]);
+        for (var z = zMin; z <= zMax; z = z + 1.0) {
+          var p = vec3<f32>(0.0);
+          p[u] = a;
+          p[v] = b;
+          p[w] = z;
+          let np = dot(normal, p);
+          if ((np + d1) * (np + d2) > 0.0
+              || !edgeTestPasses(testU, project(p, u))
+              || !edgeTestPasses(testV, project(p, v))) {
+            continue;
+          }
+          let voxel = vec3<u32>(p);
+          atomicOr(&voxelBits[voxelWord(voxel)], 1u << (voxel.x % 32u));
+        }
+      }
+    }
+  }
+
+  // Clears the words of the region, whose x range is a multiple of 32
+  @compute @workgroup_size(4, 4, 4)
+  fn clear(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (id.x >= params.size.x / 32u || id.y >= params.size.y
+        || id.z >= params.size.z) {
+      return;
+    }
+    let voxel = params.origin.xyz + vec3<u32>(id.x * 32u, id.y, id.z);
+    atomicStore(&voxelBits[voxelWord(voxel)], 0u);
+  }
+
+  // Occupancy of both bit volumes into the first texture level
+  @compute @workgroup_size(4, 4, 4)
+  fn resolve(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (any(id >= params.size.xyz)) {
+      return;
+    }
+    let voxel = params.origin.xyz + id;
+    let resolution = params.mesh.w;
+    let word = (voxel.z * resolution + voxel.y) * (resolution / 32u)
+               + voxel.x / 32u;
+    let wordCount = resolution * resolution * (resolution / 32u);
+    let bits = atomicLoad(&voxelBits[word])
+               | atomicLoad(&voxelBits[wordCount + word]);
+    let occupied = (bits & (1u << (voxel.x % 32u))) != 0u;
+    textureStore(voxelTexture, vec3<i32>(voxel),
+                 select(vec4<f32>(0.0), vec4<f32>(1.0), occupied));
+  }
+);
+
+static const char* voxelizer_mip_shader_wgsl = CODE(
+  @group(1) @binding(0) var dstLevel : texture_storage_3d<rgba8unorm, write>;
+  @group(1) @binding(1) var srcLevel : texture_3d<f32>;
+
+  // Average of the 2x2x2 texels of the finer level
+  @compute @workgroup_size(4, 4, 4)
+  fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+    if (any(id >= params.size.xyz)) {
+      return;
+    }
+    let texel = params.origin.xyz + id;
+    let src = vec3<i32>(texel * 2u);
+    var sum = vec4<f32>(0.0);
+    for (var i = 0; i < 8; i = i + 1) {
+      let offset = vec3<i32>(i & 1, (i >> 1u) & 1, (i >> 2u) & 1);
+      sum = sum + textureLoad(srcLevel, src + offset, 0);
+    }
+    textureStore(dstLevel, vec3<i32>(texel), sum * 0.125);
+  }
+);
+// clang-format on
+
+static bool voxelizer_box_is_empty(const voxelizer_box_t* box)
+{
+  return box->min[0] >= box->max[0] || box->min[1] >= box->max[1]
+         || box->min[2] >= box->max[2];
+}
+
+static void voxelizer_box_union(voxelizer_box_t* dst,
+                                const voxelizer_box_t* box)
+{
+  if (voxelizer_box_is_empty(box)) {
+    return;
+  }
+  if (voxelizer_box_is_empty(dst)) {
+    *dst = *box;
+    return;
+  }
+  for (uint32_t i = 0; i < 3; ++i) {
+    dst->min[i] = MIN(dst->min[i], box->min[i]);
+    dst->max[i] = MAX(dst->max[i], box->max[i]);
+  }
+}
+
+static bool voxelizer_box_overlaps(const voxelizer_box_t* a,
+                                   const voxelizer_box_t* b)
+{
+  if (voxelizer_box_is_empty(a) || voxelizer_box_is_empty(b)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < 3; ++i) {
+    if (a->min[i] >= b->max[i] || b->min[i] >= a->max[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint64_t voxelizer_box_volume(const voxelizer_box_t* box)
+{
+  if (voxelizer_box_is_empty(box)) {
+    return 0;
+  }
+  return (uint64_t)(box->max[0] - box->min[0])
+         * (box->max[1] - box->min[1]) * (box->max[2] - box->min[2]);
+}
+
+/* Voxels of the transformed bounds of an object, clamped to the grid */
+static voxelizer_box_t voxelizer_object_box(wgpu_voxelizer_t* voxelizer,
+                                            const voxelizer_object_t* object)
+{
+  mat4 to_grid;
+  glm_mat4_mul(voxelizer->grid_from_world, (vec4*)object->transform, to_grid);
+  vec3 grid_min = {FLT_MAX, FLT_MAX, FLT_MAX};
+  vec3 grid_max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (uint32_t i = 0; i < 8; ++i) {
+    vec3 corner = {
+      (i & 1) ? object->bounds_max[0] : object->bounds_min[0],
+      (i & 2) ? object->bounds_max[1] : object->bounds_min[1],
+      (i & 4) ? object->bounds_max[2] : object->bounds_min[2],
+    };
+    vec3 grid_corner;
+    glm_mat4_mulv3(to_grid, corner, 1.0f, grid_corner);
+    glm_vec3_minv(grid_min, grid_corner, grid_min);
+    glm_vec3_maxv(grid_max, grid_corner, grid_max);
+  }
+  const float resolution = (float)voxelizer->resolution;
+  voxelizer_box_t box;
+  for (uint32_t i = 0; i < 3; ++i) {
+    box.min[i] = (uint32_t)CLAMP(floorf(grid_min[i]), 0.0f, resolution);
+    box.max[i] = (uint32_t)CLAMP(floorf(grid_max[i]) + 1.0f, 0.0f, resolution);
+  }
+  return box;
+}
+
+static void voxelizer_create_geometry(wgpu_voxelizer_t* voxelizer,
+                                      const wgpu_voxelizer_desc_t* desc)
+{
+  uint32_t vertex_count = 0, index_count = 0;
+  for (uint32_t i = 0; i < desc->object_count; ++i) {
+    wgpu_gltf_triangles_t triangles;
+    const bool kept
+      = wgpu_gltf_model_get_triangles(desc->objects[i].model, &triangles);
+    ASSERT(kept);
+    UNUSED_VAR(kept);
+    voxelizer_object_t* object = &voxelizer->objects[i];
+    object->dynamic            = desc->objects[i].dynamic;
+    object->dirty              = true;
+    glm_mat4_identity(object->transform);
+    object->first_index    = index_count;
+    object->triangle_count = triangles.index_count / 3;
+    object->base_vertex    = vertex_count;
+    glm_vec3_fill(object->bounds_min, FLT_MAX);
+    glm_vec3_fill(object->bounds_max, -FLT_MAX);
+    for (uint32_t v = 0; v < triangles.vertex_count; ++v) {
+      glm_vec3_minv(object->bounds_min, (float*)&triangles.positions[v * 3],
+                    object->bounds_min);
+      glm_vec3_maxv(object->bounds_max, (float*)&triangles.positions[v * 3],
+                    object->bounds_max);
+    }
+    vertex_count += triangles.vertex_count;
+    index_count += triangles.index_count;
+  }
+  voxelizer->triangle_count = index_count / 3;
+  ASSERT(voxelizer->triangle_count > 0);
+
+  voxelizer->positions_buffer = wgpu_create_buffer(
+    voxelizer->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "voxelizer_positions_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = vertex_count * 3 * sizeof(float),
+    });
+  voxelizer->indices_buffer = wgpu_create_buffer(
+    voxelizer->wgpu_context,
+    &(wgpu_buffer_desc_t){
+      .label = "voxelizer_indices_buffer",
+      .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+      .size  = index_count * sizeof(uint32_t),
+    });
+  for (uint32_t i = 0; i < desc->object_count; ++i) {
+    wgpu_gltf_triangles_t triangles;
+    wgpu_gltf_model_get_triangles(desc->objects[i].model, &triangles);
+    const voxelizer_object_t* object = &voxelizer->objects[i];
+    wgpu_queue_write_buffer(voxelizer->wgpu_context,
+                            voxelizer->positions_buffer.buffer,
+                            object->base_vertex * 3 * sizeof(float),
+                            triangles.positions,
+                            triangles.vertex_count * 3 * sizeof(float));
+    wgpu_queue_write_buffer(voxelizer->wgpu_context,
+                            voxelizer->indices_buffer.buffer,
+                            object->first_index * sizeof(uint32_t),
+                            triangles.indices,
+                            triangles.index_count * sizeof(uint32_t));
+  }
+}
+
+/* The grid covers the given bounds, or the static objects with a margin of a
+ * voxel */
+static void voxelizer_setup_grid(wgpu_voxelizer_t* voxelizer,
+                                 const wgpu_voxelizer_desc_t* desc)
+{
+  vec3 bounds_min, bounds_max;
+  glm_vec3_copy((float*)desc->bounds_min, bounds_min);
+  glm_vec3_copy((float*)desc->bounds_max, bounds_max);
+  const bool given = bounds_min[0] < bounds_max[0]
+                     && bounds_min[1] < bounds_max[1]
+                     && bounds_min[2] < bounds_max[2];
+  if (!given) {
+    glm_vec3_fill(bounds_min, FLT_MAX);
+    glm_vec3_fill(bounds_max, -FLT_MAX);
+    for (uint32_t pass = 0; pass < 2 && bounds_min[0] > bounds_max[0];
+         ++pass) {
+      // All objects when none is static
+      for (uint32_t i = 0; i < voxelizer->object_count; ++i) {
+        const voxelizer_object_t* object = &voxelizer->objects[i];
+        if (pass == 0 && object->dynamic) {
+          continue;
+        }
+        glm_vec3_minv(bounds_min, (float*)object->bounds_min, bounds_min);
+        glm_vec3_maxv(bounds_max, (float*)object->bounds_max, bounds_max);
+      }
+    }
+  }
+
+  const float extent
+    = MAX(MAX(bounds_max[0] - bounds_min[0], bounds_max[1] - bounds_min[1]),
+          MAX(bounds_max[2] - bounds_min[2], FLT_EPSILON));
+  voxelizer_grid_t* grid = &voxelizer->grid;
+  if (given) {
+    grid->voxel_size = extent / (float)voxelizer->resolution;
+    glm_vec3_copy(bounds_min, grid->origin);
+  }
+  else {
+    grid->voxel_size = extent / (float)(voxelizer->resolution - 2);
+    glm_vec3_subs(bounds_min, grid->voxel_size, grid->origin);
+  }
+  grid->resolution  = voxelizer->resolution;
+  grid->level_count = voxelizer->level_count;
+  grid->word_count  = voxelizer->resolution * voxelizer->resolution
+                     * (voxelizer->resolution / 32);
+
+  glm_mat4_identity(voxelizer->grid_from_world);
+  glm_scale_uni(voxelizer->grid_from_world, 1.0f / grid->voxel_size);
+  vec3 translation;
+  glm_vec3_negate_to(grid->origin, translation);
+  glm_translate(voxelizer->grid_from_world, translation);
+}
+
+static void voxelizer_create_texture(wgpu_voxelizer_t* voxelizer)
+{
+  wgpu_context_t* wgpu_context = voxelizer->wgpu_context;
+  const uint32_t resolution    = voxelizer->resolution;
+
+  voxelizer->texture = wgpuDeviceCreateTexture(
+    wgpu_context->device,
+    &(WGPUTextureDescriptor){
+      .label         = "voxelizer_texture",
+      .usage         = WGPUTextureUsage_StorageBinding
+                       | WGPUTextureUsage_TextureBinding,
+      .dimension     = WGPUTextureDimension_3D,
+      .size          = (WGPUExtent3D){
+        .width              = resolution,
+        .height             = resolution,
+        .depthOrArrayLayers = resolution,
+      },
+      .format        = WGPUTextureFormat_RGBA8Unorm,
+      .mipLevelCount = voxelizer->level_count,
+      .sampleCount   = 1,
+    });
+  ASSERT(voxelizer->texture != NULL);
+
+  voxelizer->texture_view = wgpuTextureCreateView(
+    voxelizer->texture, &(WGPUTextureViewDescriptor){
+                          .label           = "voxelizer_texture_view",
+                          .format          = WGPUTextureFormat_RGBA8Unorm,
+                          .dimension       = WGPUTextureViewDimension_3D,
+                          .baseMipLevel    = 0,
+                          .mipLevelCount   = voxelizer->level_count,
+                          .baseArrayLayer  = 0,
+                          .arrayLayerCount = 1,
+                        });
+  ASSERT(voxelizer->texture_view != NULL);
+
+  // Single level views, written as storage textures and read by the next
+  // level
+  for (uint32_t i = 0; i < voxelizer->level_count; ++i) {
+    voxelizer->level_views[i] = wgpuTextureCreateView(
+      voxelizer->texture, &(WGPUTextureViewDescriptor){
+                            .label         = "voxelizer_level_view",
+                            .format        = WGPUTextureFormat_RGBA8Unorm,
+                            .dimension     = WGPUTextureViewDimension_3D,
+                            .baseMipLevel  = i,
+                            .mipLevelCount = 1,
+                            .baseArrayLayer  = 0,
+                            .arrayLayerCount = 1,
+                          });
+    ASSERT(voxelizer->level_views[i] != NULL);
+  }
+
+  voxelizer->sampler = wgpuDeviceCreateSampler(
+    wgpu_context->device, &(WGPUSamplerDescriptor){
+                            .label         = "voxelizer_sampler",
+                            .addressModeU  = WGPUAddressMode_ClampToEdge,
+                            .addressModeV  = WGPUAddressMode_ClampToEdge,
+                            .addressModeW  = WGPUAddressMode_ClampToEdge,
+                            .minFilter     = WGPUFilterMode_Linear,
+                            .magFilter     = WGPUFilterMode_Linear,
+                            .mipmapFilter  = WGPUFilterMode_Linear,
+                            .lodMinClamp   = 0.0f,
+                            .lodMaxClamp   = (float)voxelizer->level_count,
+                            .maxAnisotropy = 1,
+                          });
+  ASSERT(voxelizer->sampler != NULL);
+}
+
+static void voxelizer_create_bind_group_layouts(wgpu_voxelizer_t* voxelizer)
+{
+  wgpu_context_t* wgpu_context = voxelizer->wgpu_context;
+
+  // Voxelization, clearing and resolving
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[4] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Parameters of the dispatch
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type             = WGPUBufferBindingType_Uniform,
+          .hasDynamicOffset = true,
+          .minBindingSize   = sizeof(voxelizer_params_t),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Positions
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = voxelizer->positions_buffer.size,
+        },
+        .sampler = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Indices
+        .binding    = 2,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = voxelizer->indices_buffer.size,
+        },
+        .sampler = {0},
+      },
+      [3] = (WGPUBindGroupLayoutEntry) {
+        // Binding 3: Bit volumes
+        .binding    = 3,
+        .visibility = WGPUShaderStage_Compute,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Storage,
+          .minBindingSize = voxelizer->bits_buffer.size,
+        },
+        .sampler = {0},
+      },
+    };
+    voxelizer->build_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "voxelizer_build_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(voxelizer->build_bind_group_layout != NULL);
+  }
+
+  // Destination and source mip levels, the resolve pass only writes
+  {
+    WGPUBindGroupLayoutEntry bgl_entries[2] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Destination level
+        .binding    = 0,
+        .visibility = WGPUShaderStage_Compute,
+        .storageTexture = (WGPUStorageTextureBindingLayout) {
+          .access        = WGPUStorageTextureAccess_WriteOnly,
+          .format        = WGPUTextureFormat_RGBA8Unorm,
+          .viewDimension = WGPUTextureViewDimension_3D,
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Source level
+        .binding    = 1,
+        .visibility = WGPUShaderStage_Compute,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_Float,
+          .viewDimension = WGPUTextureViewDimension_3D,
+        },
+        .storageTexture = {0},
+      },
+    };
+    voxelizer->resolve_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "voxelizer_resolve_bgl",
+                              .entryCount = 1,
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(voxelizer->resolve_bind_group_layout != NULL);
+    voxelizer->mip_bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "voxelizer_mip_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(voxelizer->mip_bind_group_layout != NULL);
+  }
+
+  // Queries
+  {
+    const WGPUShaderStageFlags visibility
+      = WGPUShaderStage_Fragment | WGPUShaderStage_Compute;
+    WGPUBindGroupLayoutEntry bgl_entries[4] = {
+      [0] = (WGPUBindGroupLayoutEntry) {
+        // Binding 0: Grid
+        .binding    = 0,
+        .visibility = visibility,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_Uniform,
+          .minBindingSize = sizeof(voxelizer_grid_t),
+        },
+        .sampler = {0},
+      },
+      [1] = (WGPUBindGroupLayoutEntry) {
+        // Binding 1: Bit volumes
+        .binding    = 1,
+        .visibility = visibility,
+        .buffer = (WGPUBufferBindingLayout) {
+          .type           = WGPUBufferBindingType_ReadOnlyStorage,
+          .minBindingSize = voxelizer->bits_buffer.size,
+        },
+        .sampler = {0},
+      },
+      [2] = (WGPUBindGroupLayoutEntry) {
+        // Binding 2: Voxel texture
+        .binding    = 2,
+        .visibility = visibility,
+        .texture = (WGPUTextureBindingLayout) {
+          .sampleType    = WGPUTextureSampleType_Float,
+          .viewDimension = WGPUTextureViewDimension_3D,
+        },
+        .storageTexture = {0},
+      },
+      [3] = (WGPUBindGroupLayoutEntry) {
+        // Binding 3: Sampler
+        .binding    = 3,
+        .visibility = visibility,
+        .sampler = (WGPUSamplerBindingLayout){
+          .type = WGPUSamplerBindingType_Filtering,
+        },
+        .texture = {0},
+      },
+    };
+    voxelizer->bind_group_layout = wgpuDeviceCreateBindGroupLayout(
+      wgpu_context->device, &(WGPUBindGroupLayoutDescriptor){
+                              .label      = "voxelizer_bgl",
+                              .entryCount = (uint32_t)ARRAY_SIZE(bgl_entries),
+                              .entries    = bgl_entries,
+                            });
+    ASSERT(voxelizer->bind_group_layout != NULL);
+  }
+}
+
+static void voxelizer_create_bind_groups(wgpu_voxelizer_t* voxelizer)
+{
+  WGPUDevice device = voxelizer->wgpu_context->device;
+
+  // Voxelization, clearing and resolving
+  {
+    WGPUBindGroupEntry bg_entries[4] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = voxelizer->params_buffer.buffer,
+        .size    = sizeof(voxelizer_params_t),
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding = 1,
+        .buffer  = voxelizer->positions_buffer.buffer,
+        .size    = voxelizer->positions_buffer.size,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding = 2,
+        .buffer  = voxelizer->indices_buffer.buffer,
+        .size    = voxelizer->indices_buffer.size,
+      },
+      [3] = (WGPUBindGroupEntry) {
+        .binding = 3,
+        .buffer  = voxelizer->bits_buffer.buffer,
+        .size    = voxelizer->bits_buffer.size,
+      },
+    };
+    voxelizer->build_bind_group = wgpuDeviceCreateBindGroup(
+      device, &(WGPUBindGroupDescriptor){
+                .label      = "voxelizer_build_bind_group",
+                .layout     = voxelizer->build_bind_group_layout,
+                .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                .entries    = bg_entries,
+              });
+    ASSERT(voxelizer->build_bind_group != NULL);
+  }
+
+  // Mip levels, level i is written from level i - 1
+  for (uint32_t i = 0; i < voxelizer->level_count; ++i) {
+    WGPUBindGroupEntry bg_entries[2] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding     = 0,
+        .textureView = voxelizer->level_views[i],
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding     = 1,
+        .textureView = i > 0 ? voxelizer->level_views[i - 1] : NULL,
+      },
+    };
+    if (i == 0) {
+      voxelizer->resolve_bind_group = wgpuDeviceCreateBindGroup(
+        device, &(WGPUBindGroupDescriptor){
+                  .label      = "voxelizer_resolve_bind_group",
+                  .layout     = voxelizer->resolve_bind_group_layout,
+                  .entryCount = 1,
+                  .entries    = bg_entries,
+                });
+      ASSERT(voxelizer->resolve_bind_group != NULL);
+      continue;
+    }
+    voxelizer->mip_bind_groups[i] = wgpuDeviceCreateBindGroup(
+      device, &(WGPUBindGroupDescriptor){
+                .label      = "voxelizer_mip_bind_group",
+                .layout     = voxelizer->mip_bind_group_layout,
+                .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                .entries    = bg_entries,
+              });
+    ASSERT(voxelizer->mip_bind_groups[i] != NULL);
+  }
+
+  // Queries
+  {
+    WGPUBindGroupEntry bg_entries[4] = {
+      [0] = (WGPUBindGroupEntry) {
+        .binding = 0,
+        .buffer  = voxelizer->grid_buffer.buffer,
+        .size    = voxelizer->grid_buffer.size,
+      },
+      [1] = (WGPUBindGroupEntry) {
+        .binding = 1,
+        .buffer  = voxelizer->bits_buffer.buffer,
+        .size    = voxelizer->bits_buffer.size,
+      },
+      [2] = (WGPUBindGroupEntry) {
+        .binding     = 2,
+        .textureView = voxelizer->texture_view,
+      },
+      [3] = (WGPUBindGroupEntry) {
+        .binding = 3,
+        .sampler = voxelizer->sampler,
+      },
+    };
+    voxelizer->bind_group = wgpuDeviceCreateBindGroup(
+      device, &(WGPUBindGroupDescriptor){
+                .label      = "voxelizer_bind_group",
+                .layout     = voxelizer->bind_group_layout,
+                .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                .entries    = bg_entries,
+              });
+    ASSERT(voxelizer->bind_group != NULL);
+  }
+}
+
+static WGPUComputePipeline
+voxelizer_create_pipeline(wgpu_voxelizer_t* voxelizer, const char* wgsl,
+                          const char* entry, WGPUBindGroupLayout layout)
+{
+  wgpu_context_t* wgpu_context = voxelizer->wgpu_context;
+
+  WGPUBindGroupLayout bind_group_layouts[2] = {
+    voxelizer->build_bind_group_layout, // Group 0
+    layout,                             // Group 1
+  };
+  WGPUPipelineLayout pipeline_layout = wgpuDeviceCreatePipelineLayout(
+    wgpu_context->device, &(WGPUPipelineLayoutDescriptor){
+                            .label                = "voxelizer_pl",
+                            .bindGroupLayoutCount = layout != NULL ? 2 : 1,
+                            .bindGroupLayouts     = bind_group_layouts,
+                          });
+  ASSERT(pipeline_layout != NULL);
+
+  wgpu_shader_t comp_shader = wgpu_shader_create(
+    wgpu_context, &(wgpu_shader_desc_t){
+                    // Compute shader WGSL
+                    .label            = "voxelizer_shader",
+                    .wgsl_code.source = wgsl,
+                    .entry            = entry,
+                  });
+  WGPUComputePipeline pipeline = wgpuDeviceCreateComputePipeline(
+    wgpu_context->device,
+    &(WGPUComputePipelineDescriptor){
+      .label   = "voxelizer_pipeline",
+      .layout  = pipeline_layout,
+      .compute = comp_shader.programmable_stage_descriptor,
+    });
+  ASSERT(pipeline != NULL);
+  wgpu_shader_release(&comp_shader);
+  WGPU_RELEASE_RESOURCE(PipelineLayout, pipeline_layout);
+  return pipeline;
+}
+
+static void voxelizer_create_pipelines(wgpu_voxelizer_t* voxelizer)
+{
+  // The passes share the parameter struct and the bindings of group 0
+  size_t wgsl_size = strlen(voxelizer_params_wgsl)
+                     + strlen(voxelizer_shader_wgsl) + 2;
+  char* wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", voxelizer_params_wgsl,
+           voxelizer_shader_wgsl);
+  voxelizer->voxelize_pipeline
+    = voxelizer_create_pipeline(voxelizer, wgsl, "voxelize", NULL);
+  voxelizer->clear_pipeline
+    = voxelizer_create_pipeline(voxelizer, wgsl, "clear", NULL);
+  voxelizer->resolve_pipeline = voxelizer_create_pipeline(
+    voxelizer, wgsl, "resolve", voxelizer->resolve_bind_group_layout);
+  free(wgsl);
+
+  wgsl_size = strlen(voxelizer_params_wgsl) + strlen(voxelizer_mip_shader_wgsl)
+              + 2;
+  wgsl = malloc(wgsl_size);
+  snprintf(wgsl, wgsl_size, "%s\n%s", voxelizer_params_wgsl,
+           voxelizer_mip_shader_wgsl);
+  voxelizer->mip_pipeline = voxelizer_create_pipeline(
+    voxelizer, wgsl, "main", voxelizer->mip_bind_group_layout);
+  free(wgsl);
+}
+
+wgpu_voxelizer_t* wgpu_voxelizer_create(wgpu_context_t* wgpu_context,
+                                        const wgpu_voxelizer_desc_t* desc)
+{
+  ASSERT(desc->object_count > 0);
+  const uint32_t resolution = desc->resolution > 0 ?
+                                desc->resolution :
+                                WGPU_VOXELIZER_DEFAULT_RESOLUTION;
+  ASSERT(resolution % 32 == 0 && resolution <= WGPU_VOXELIZER_MAX_RESOLUTION);
+
+  wgpu_voxelizer_t* voxelizer
+    = (wgpu_voxelizer_t*)malloc(sizeof(wgpu_voxelizer_t));
+  memset(voxelizer, 0, sizeof(wgpu_voxelizer_t));
+  voxelizer->wgpu_context = wgpu_context;
+  voxelizer->resolution   = resolution;
+  voxelizer->level_count  = (uint32_t)log2((double)resolution) + 1;
+  ASSERT(voxelizer->level_count <= ARRAY_SIZE(voxelizer->level_views));
+  voxelizer->object_count = desc->object_count;
+  voxelizer->objects      = (voxelizer_object_t*)calloc(
+    desc->object_count, sizeof(voxelizer_object_t));
+  voxelizer->static_dirty = true;
+
+  voxelizer_create_geometry(voxelizer, desc);
+  voxelizer_setup_grid(voxelizer, desc);
+
+  voxelizer->params_slot_count = desc->object_count
+                                 + VOXELIZER_REGION_SLOT_COUNT
+                                 + voxelizer->level_count;
+  voxelizer->params = (voxelizer_params_t*)calloc(
+    voxelizer->params_slot_count, VOXELIZER_PARAMS_STRIDE);
+  voxelizer->params_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "voxelizer_params_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = voxelizer->params_slot_count
+                            * VOXELIZER_PARAMS_STRIDE,
+                  });
+  voxelizer->grid_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "voxelizer_grid_buffer",
+                    .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                    .size  = sizeof(voxelizer_grid_t),
+                    .initial.data = &voxelizer->grid,
+                    .initial.size = sizeof(voxelizer_grid_t),
+                  });
+  voxelizer->bits_buffer = wgpu_create_buffer(
+    wgpu_context, &(wgpu_buffer_desc_t){
+                    .label = "voxelizer_bits_buffer",
+                    .usage = WGPUBufferUsage_Storage,
+                    .size  = 2 * voxelizer->grid.word_count * sizeof(uint32_t),
+                  });
+
+  voxelizer_create_texture(voxelizer);
+  voxelizer_create_bind_group_layouts(voxelizer);
+  voxelizer_create_bind_groups(voxelizer);
+  voxelizer_create_pipelines(voxelizer);
+
+  return voxelizer;
+}
+
+void wgpu_voxelizer_release(wgpu_voxelizer_t* voxelizer)
+{
+  if (voxelizer == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(ComputePipeline, voxelizer->voxelize_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, voxelizer->clear_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, voxelizer->resolve_pipeline)
+  WGPU_RELEASE_RESOURCE(ComputePipeline, voxelizer->mip_pipeline)
+  WGPU_RELEASE_RESOURCE(BindGroup, voxelizer->bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, voxelizer->build_bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroup, voxelizer->resolve_bind_group)
+  for (uint32_t i = 0; i < voxelizer->level_count; ++i) {
+    WGPU_RELEASE_RESOURCE(BindGroup, voxelizer->mip_bind_groups[i])
+    WGPU_RELEASE_RESOURCE(TextureView, voxelizer->level_views[i])
+  }
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, voxelizer->bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, voxelizer->build_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, voxelizer->resolve_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, voxelizer->mip_bind_group_layout)
+  WGPU_RELEASE_RESOURCE(Sampler, voxelizer->sampler)
+  WGPU_RELEASE_RESOURCE(TextureView, voxelizer->texture_view)
+  WGPU_RELEASE_RESOURCE(Texture, voxelizer->texture)
+  wgpu_destroy_buffer(&voxelizer->bits_buffer);
+  wgpu_destroy_buffer(&voxelizer->grid_buffer);
+  wgpu_destroy_buffer(&voxelizer->params_buffer);
+  wgpu_destroy_buffer(&voxelizer->indices_buffer);
+  wgpu_destroy_buffer(&voxelizer->positions_buffer);
+  free(voxelizer->params);
+  free(voxelizer->objects);
+  free(voxelizer);
+}
+
+void wgpu_voxelizer_set_transform(wgpu_voxelizer_t* voxelizer,
+                                  uint32_t object, mat4 transform)
+{
+  ASSERT(object < voxelizer->object_count);
+  voxelizer_object_t* o = &voxelizer->objects[object];
+  if (memcmp(o->transform, transform, sizeof(mat4)) == 0) {
+    return;
+  }
+  glm_mat4_copy(transform, o->transform);
+  if (o->dynamic) {
+    o->dirty = true;
+  }
+  else {
+    voxelizer->static_dirty = true;
+  }
+}
+
+/* Parameters of the next slot */
+static voxelizer_params_t* voxelizer_next_params(wgpu_voxelizer_t* voxelizer,
+                                                 uint32_t* slot)
+{
+  ASSERT(*slot < voxelizer->params_slot_count);
+  voxelizer_params_t* params
+    = (voxelizer_params_t*)((uint8_t*)voxelizer->params
+                            + *slot * VOXELIZER_PARAMS_STRIDE);
+  memset(params, 0, sizeof(voxelizer_params_t));
+  params->mesh[3] = voxelizer->resolution;
+  ++*slot;
+  return params;
+}
+
+static void voxelizer_dispatch_region(wgpu_voxelizer_t* voxelizer,
+                                      WGPUComputePassEncoder pass_encoder,
+                                      uint32_t* slot,
+                                      const voxelizer_box_t* box,
+                                      uint32_t level_or_volume, bool clear)
+{
+  const uint32_t dynamic_offset = *slot * VOXELIZER_PARAMS_STRIDE;
+  voxelizer_params_t* params    = voxelizer_next_params(voxelizer, slot);
+  for (uint32_t i = 0; i < 3; ++i) {
+    params->origin[i] = box->min[i];
+    params->size[i]   = box->max[i] - box->min[i];
+  }
+  if (clear) {
+    params->size[3] = level_or_volume;
+  }
+  else {
+    params->origin[3] = level_or_volume;
+  }
+  wgpuComputePassEncoderSetBindGroup(
+    pass_encoder, 0, voxelizer->build_bind_group, 1, &dynamic_offset);
+  const uint32_t size_x = clear ? params->size[0] / 32 : params->size[0];
+  wgpuComputePassEncoderDispatchWorkgroups(
+    pass_encoder, (size_x + VOXELIZER_REGION_WORKGROUP_SIZE - 1)
+                    / VOXELIZER_REGION_WORKGROUP_SIZE,
+    (params->size[1] + VOXELIZER_REGION_WORKGROUP_SIZE - 1)
+      / VOXELIZER_REGION_WORKGROUP_SIZE,
+    (params->size[2] + VOXELIZER_REGION_WORKGROUP_SIZE - 1)
+      / VOXELIZER_REGION_WORKGROUP_SIZE);
+}
+
+static void voxelizer_dispatch_object(wgpu_voxelizer_t* voxelizer,
+                                      WGPUComputePassEncoder pass_encoder,
+                                      uint32_t* slot,
+                                      voxelizer_object_t* object)
+{
+  if (voxelizer_box_is_empty(&object->box) || object->triangle_count == 0) {
+    return;
+  }
+  const uint32_t dynamic_offset = *slot * VOXELIZER_PARAMS_STRIDE;
+  voxelizer_params_t* params    = voxelizer_next_params(voxelizer, slot);
+  glm_mat4_mul(voxelizer->grid_from_world, object->transform,
+               params->to_grid);
+  params->size[3] = object->dynamic ? VOXELIZER_DYNAMIC_VOLUME :
+                                      VOXELIZER_STATIC_VOLUME;
+  params->mesh[0] = object->first_index;
+  params->mesh[1] = object->triangle_count;
+  params->mesh[2] = object->base_vertex;
+  wgpuComputePassEncoderSetBindGroup(
+    pass_encoder, 0, voxelizer->build_bind_group, 1, &dynamic_offset);
+  const uint32_t workgroup_count
+    = (object->triangle_count + VOXELIZER_TRIANGLE_WORKGROUP_SIZE - 1)
+      / VOXELIZER_TRIANGLE_WORKGROUP_SIZE;
+  ASSERT(workgroup_count <= 65535u);
+  wgpuComputePassEncoderDispatchWorkgroups(pass_encoder, workgroup_count, 1,
+                                           1);
+  ++voxelizer->last_update.voxelized_object_count;
+  voxelizer->last_update.voxelized_triangle_count += object->triangle_count;
+}
+
+uint32_t wgpu_voxelizer_update(wgpu_voxelizer_t* voxelizer,
+                               WGPUComputePassEncoder pass_encoder)
+{
+  memset(&voxelizer->last_update, 0, sizeof(voxelizer->last_update));
+  uint32_t slot           = 0;
+  voxelizer_box_t changed = {0};
+
+  // Static objects, all at once
+  if (voxelizer->static_dirty) {
+    const voxelizer_box_t grid_box = {
+      .max = {voxelizer->resolution, voxelizer->resolution,
+              voxelizer->resolution},
+    };
+    wgpuComputePassEncoderSetPipeline(pass_encoder, voxelizer->clear_pipeline);
+    voxelizer_dispatch_region(voxelizer, pass_encoder, &slot, &grid_box,
+                              VOXELIZER_STATIC_VOLUME, true);
+    wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                      voxelizer->voxelize_pipeline);
+    for (uint32_t i = 0; i < voxelizer->object_count; ++i) {
+      voxelizer_object_t* object = &voxelizer->objects[i];
+      if (!object->dynamic) {
+        object->box = voxelizer_object_box(voxelizer, object);
+        voxelizer_dispatch_object(voxelizer, pass_encoder, &slot, object);
+      }
+    }
+    voxelizer->static_dirty = false;
+    changed                 = grid_box;
+  }
+
+  // Region the moved dynamic objects left and entered, whole words along x
+  voxelizer_box_t region = {0};
+  for (uint32_t i = 0; i < voxelizer->object_count; ++i) {
+    voxelizer_object_t* object = &voxelizer->objects[i];
+    if (object->dynamic && object->dirty) {
+      voxelizer_box_union(&region, &object->box);
+      object->box = voxelizer_object_box(voxelizer, object);
+      voxelizer_box_union(&region, &object->box);
+    }
+  }
+  if (!voxelizer_box_is_empty(&region)) {
+    region.min[0] = region.min[0] / 32 * 32;
+    region.max[0] = (region.max[0] + 31) / 32 * 32;
+    wgpuComputePassEncoderSetPipeline(pass_encoder, voxelizer->clear_pipeline);
+    voxelizer_dispatch_region(voxelizer, pass_encoder, &slot, &region,
+                              VOXELIZER_DYNAMIC_VOLUME, true);
+    // The cleared region may have held voxels of dynamic objects that did
+    // not move
+    wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                      voxelizer->voxelize_pipeline);
+    for (uint32_t i = 0; i < voxelizer->object_count; ++i) {
+      voxelizer_object_t* object = &voxelizer->objects[i];
+      if (object->dynamic
+          && (object->dirty || voxelizer_box_overlaps(&object->box, &region))) {
+        voxelizer_dispatch_object(voxelizer, pass_encoder, &slot, object);
+      }
+    }
+    voxelizer_box_union(&changed, &region);
+  }
+  for (uint32_t i = 0; i < voxelizer->object_count; ++i) {
+    voxelizer->objects[i].dirty = false;
+  }
+
+  // Occupancy and mip levels of the changed voxels
+  if (!voxelizer_box_is_empty(&changed)) {
+    voxelizer->last_update.resolved_voxel_count
+      = voxelizer_box_volume(&changed);
+    wgpuComputePassEncoderSetPipeline(pass_encoder,
+                                      voxelizer->resolve_pipeline);
+    wgpuComputePassEncoderSetBindGroup(pass_encoder, 1,
+                                       voxelizer->resolve_bind_group, 0, NULL);
+    voxelizer_dispatch_region(voxelizer, pass_encoder, &slot, &changed, 0,
+                              false);
+    wgpuComputePassEncoderSetPipeline(pass_encoder, voxelizer->mip_pipeline);
+    voxelizer_box_t box = changed;
+    for (uint32_t level = 1; level < voxelizer->level_count; ++level) {
+      for (uint32_t i = 0; i < 3; ++i) {
+        box.min[i] = box.min[i] / 2;
+        box.max[i] = (box.max[i] + 1) / 2;
+      }
+      wgpuComputePassEncoderSetBindGroup(
+        pass_encoder, 1, voxelizer->mip_bind_groups[level], 0, NULL);
+      voxelizer_dispatch_region(voxelizer, pass_encoder, &slot, &box, level,
+                                false);
+    }
+  }
+
+  if (slot > 0) {
+    wgpu_queue_write_buffer(voxelizer->wgpu_context,
+                            voxelizer->params_buffer.buffer, 0,
+                            voxelizer->params, slot * VOXELIZER_PARAMS_STRIDE);
+  }
+  return voxelizer->last_update.voxelized_triangle_count;
+}
+
+void wgpu_voxelizer_get_stats(wgpu_voxelizer_t* voxelizer,
+                              wgpu_voxelizer_stats_t* stats)
+{
+  *stats                = voxelizer->last_update;
+  stats->resolution     = voxelizer->resolution;
+  stats->object_count   = voxelizer->object_count;
+  stats->triangle_count = voxelizer->triangle_count;
+  for (uint32_t i = 0; i < voxelizer->object_count; ++i) {
+    stats->dynamic_object_count += voxelizer->objects[i].dynamic ? 1 : 0;
+  }
+}
+
+WGPUTextureView wgpu_voxelizer_get_texture_view(wgpu_voxelizer_t* voxelizer)
+{
+  return voxelizer->texture_view;
+}
+
+WGPUBindGroupLayout
+wgpu_voxelizer_get_bind_group_layout(wgpu_voxelizer_t* voxelizer)
+{
+  return voxelizer->bind_group_layout;
+}
+
+WGPUBindGroup wgpu_voxelizer_get_bind_group(wgpu_voxelizer_t* voxelizer)
+{
+  return voxelizer->bind_group;
+}
+
+const char* wgpu_voxelizer_get_wgsl_functions(void)
+{
+  return voxelizer_wgsl_functions;
+}
@@ -0,0 +1,120 @@
+#ifndef VOXELIZER_H
+#define VOXELIZER_H
+
+#include <cglm/cglm.h>
+
+#include "context.h"
+
+struct gltf_model_t;
+
+#define WGPU_VOXELIZER_DEFAULT_RESOLUTION 128u
+#define WGPU_VOXELIZER_MAX_RESOLUTION 512u
+
+/*
+ * Voxelization of glTF models into a 3D texture, the basis of GPU occlusion
+ * tests and cone traced global illumination.
+ *
+ * Conservative rasterization voxelizes a triangle by rasterizing it along its
+ * dominant axis with every pixel it touches. WebGPU has neither conservative
+ * rasterization nor geometry shaders to enlarge the triangles, so a compute
+ * pass tests every triangle against the voxels of its bounds instead, with
+ * the triangle/box overlap test of Schwarz and Seidel. It marks the same
+ * voxels as a conservative rasterization of the three axis projections,
+ * without holes for thin or axis aligned triangles. The cost of a triangle
+ * grows with its area in voxels.
+ *
+ * The voxels of static and of dynamic objects are marked in two bit volumes.
+ * The static volume is only voxelized again when a static object is moved.
+ * When dynamic objects move, the dynamic bits of the region they left and
+ * entered are cleared and only the dynamic objects overlapping that region
+ * are voxelized again. The occupancy of the changed voxels is then written to
+ * the first level of the 3D texture and averaged into its mip levels.
+ *
+ * The triangles are those of models loaded with
+ * WGPU_GLTF_FileLoadingFlags_KeepTriangles, skinned meshes in their initial
+ * pose, the objects move rigidly with their transforms.
+ */
+typedef struct wgpu_voxelizer wgpu_voxelizer_t;
+
+typedef struct wgpu_voxelizer_object_desc_t {
+  struct gltf_model_t* model;
+  /* Dynamic objects are voxelized again on their own when they move */
+  bool dynamic;
+} wgpu_voxelizer_object_desc_t;
+
+typedef struct wgpu_voxelizer_desc_t {
+  /* Voxels per side of the cubic grid, a multiple of 32, 0 selects the
+   * default */
+  uint32_t resolution;
+  /* World space bounds, the grid is a cube of the largest extent starting at
+   * bounds_min. Empty bounds select the bounds of the static objects. */
+  vec3 bounds_min;
+  vec3 bounds_max;
+  const wgpu_voxelizer_object_desc_t* objects;
+  uint32_t object_count;
+} wgpu_voxelizer_desc_t;
+
+typedef struct wgpu_voxelizer_stats_t {
+  uint32_t resolution;
+  uint32_t object_count;
+  uint32_t dynamic_object_count;
+  uint32_t triangle_count;
+  /* Work of the last update */
+  uint32_t voxelized_object_count;
+  uint32_t voxelized_triangle_count;
+  uint64_t resolved_voxel_count;
+} wgpu_voxelizer_stats_t;
+
+/* Voxelizer creating/releasing, all objects start with identity transforms
+ * and are voxelized by the first update */
+wgpu_voxelizer_t* wgpu_voxelizer_create(wgpu_context_t* wgpu_context,
+                                        const wgpu_voxelizer_desc_t* desc);
+void wgpu_voxelizer_release(wgpu_voxelizer_t* voxelizer);
+
+/* Sets the model to world transform of an object, marks it for voxelization
+ * when it changed */
+void wgpu_voxelizer_set_transform(wgpu_voxelizer_t* voxelizer,
+                                  uint32_t object, mat4 transform);
+
+/**
+ * @brief Records the voxelization of the objects that moved since the last
+ * update and the update of the changed region of the 3D texture. Writes the
+ * parameters of the passes to the queue, at most one update can be recorded
+ * per submitted command buffer.
+ * @return the number of triangles voxelized, 0 when nothing changed
+ */
+uint32_t wgpu_voxelizer_update(wgpu_voxelizer_t* voxelizer,
+                               WGPUComputePassEncoder pass_encoder);
+
+void wgpu_voxelizer_get_stats(wgpu_voxelizer_t* voxelizer,
+                              wgpu_voxelizer_stats_t* stats);
+
+/* rgba8unorm 3D texture view of all mip levels, the alpha is the opacity */
+WGPUTextureView wgpu_voxelizer_get_texture_view(wgpu_voxelizer_t* voxelizer);
+
+/*
+ * Bind group of the passes querying the voxels, visible from fragment and
+ * compute shaders:
+ *   binding 0: var<uniform> voxelGrid : VoxelGrid
+ *   binding 1: var<storage, read> voxelGridBits : array<u32>
+ *   binding 2: var voxelGridTexture : texture_3d<f32>
+ *   binding 3: var voxelGridSampler : sampler
+ */
+WGPUBindGroupLayout
+wgpu_voxelizer_get_bind_group_layout(wgpu_voxelizer_t* voxelizer);
+WGPUBindGroup wgpu_voxelizer_get_bind_group(wgpu_voxelizer_t* voxelizer);
+
+/*
+ * WGSL query functions, to be prepended to the source of the shader, which
+ * declares the bindings of the bind group above with their names. Positions
+ * are in world space, grid coordinates in voxels from the grid origin:
+ *   fn voxelGridToGrid(position : vec3<f32>) -> vec3<f32>
+ *   fn voxelGridIsOccupied(voxel : vec3<i32>) -> bool
+ *   fn voxelGridSampleOpacity(position : vec3<f32>, lod : f32) -> f32
+ *   fn voxelGridIsSegmentOccluded(start : vec3<f32>, end : vec3<f32>) -> bool
+ * The segment test marches in half voxel steps and ignores the voxels of the
+ * end points, which hold the surfaces they lie on.
+ */
+const char* wgpu_voxelizer_get_wgsl_functions(void);
+
+#endif
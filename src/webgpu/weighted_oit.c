@@ -0,0 +1,392 @@
+#include "weighted_oit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/macro.h"
+#include "shader.h"
+
+struct wgpu_weighted_oit {
+  wgpu_context_t* wgpu_context;
+  WGPUTextureFormat color_format;
+  WGPUTextureFormat depth_format;
+  /* Additive accumulation and multiplicative revealage */
+  WGPUBlendState accumulation_blend;
+  WGPUBlendState revealage_blend;
+  WGPURenderPipeline composite_pipeline;
+  /* Resources of the passes added last */
+  wgpu_frame_graph_resource_t accumulation;
+  wgpu_frame_graph_resource_t revealage;
+  wgpu_frame_graph_resource_t color;
+  wgpu_frame_graph_resource_t depth;
+  wgpu_weighted_oit_draw_callback_t draw_callback;
+  void* user_data;
+};
+
+// clang-format off
+static const char* weighted_oit_wgsl_functions = CODE(
+  struct WeightedOitOutput {
+    @location(0) accumulation : vec4<f32>,
+    @location(1) revealage : f32,
+  };
+
+  fn weightedOitOutput(color : vec4<f32>, depth : f32) -> WeightedOitOutput {
+    let alpha = clamp(color.a, 0.0, 1.0);
+    let weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8
+                         * pow(1.0 - depth * 0.9, 3.0),
+                       1e-2, 3e3);
+    var output : WeightedOitOutput;
+    output.accumulation = vec4<f32>(color.rgb * alpha, alpha) * weight;
+    output.revealage = alpha;
+    return output;
+  }
+);
+
+static const char* weighted_oit_composite_shader_wgsl = CODE(
+  @group(0) @binding(0) var accumulationTexture : texture_2d<f32>;
+  @group(0) @binding(1) var revealageTexture : texture_2d<f32>;
+
+  @vertex
+  fn vs_main(@builtin(vertex_index) index : u32)
+    -> @builtin(position) vec4<f32> {
+    let uv = vec2<f32>(f32((index << 1u) & 2u), f32(index & 2u));
+    return vec4<f32>(uv * 2.0 - 1.0, 0.0, 1.0);
+  }
+
+  @fragment
+  fn fs_main(@builtin(position) position : vec4<f32>)
+    -> @location(0) vec4<f32> {
+    let pos = vec2<i32>(position.xy);
+    let revealage = textureLoad(revealageTexture, pos, 0).r;
+    if (revealage >= 1.0) {
+      discard;
+    }
+    let accumulation = textureLoad(accumulationTexture, pos, 0);
+    let color = accumulation.rgb / max(accumulation.a, 1e-5);
+    return vec4<f32>(color, 1.0 - revealage);
+  }
+);
+// clang-format on
+
+static void weighted_oit_create_composite_pipeline(
+  wgpu_weighted_oit_t* weighted_oit)
+{
+  wgpu_context_t* wgpu_context = weighted_oit->wgpu_context;
+
+  // Blends the average color over the target by the total coverage
+  WGPUBlendState blend_state = {
+    .color = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_SrcAlpha,
+      .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
+    },
+    .alpha = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_One,
+      .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
+    },
+  };
+  WGPUColorTargetState color_target_state = {
+    .format    = weighted_oit->color_format,
+    .blend     = &blend_state,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+
+  // Vertex state
+  WGPUVertexState vertex_state = wgpu_create_vertex_state(
+                wgpu_context, &(wgpu_vertex_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Vertex shader WGSL
+                  .label            = "weighted_oit_composite_vertex_shader",
+                  .wgsl_code.source = weighted_oit_composite_shader_wgsl,
+                  .entry            = "vs_main",
+                },
+                .buffer_count = 0,
+                .buffers      = NULL,
+              });
+
+  // Fragment state
+  WGPUFragmentState fragment_state = wgpu_create_fragment_state(
+                wgpu_context, &(wgpu_fragment_state_t){
+                .shader_desc = (wgpu_shader_desc_t){
+                  // Fragment shader WGSL
+                  .label            = "weighted_oit_composite_fragment_shader",
+                  .wgsl_code.source = weighted_oit_composite_shader_wgsl,
+                  .entry            = "fs_main",
+                },
+                .target_count = 1,
+                .targets      = &color_target_state,
+              });
+
+  // Multisample state
+  WGPUMultisampleState multisample_state
+    = wgpu_create_multisample_state_descriptor(
+      &(create_multisample_state_desc_t){
+        .sample_count = 1,
+      });
+
+  weighted_oit->composite_pipeline = wgpuDeviceCreateRenderPipeline(
+    wgpu_context->device, &(WGPURenderPipelineDescriptor){
+                            .label     = "weighted_oit_composite_pipeline",
+                            .primitive = (WGPUPrimitiveState){
+                              .topology = WGPUPrimitiveTopology_TriangleList,
+                              .cullMode = WGPUCullMode_None,
+                            },
+                            .vertex      = vertex_state,
+                            .fragment    = &fragment_state,
+                            .multisample = multisample_state,
+                          });
+  ASSERT(weighted_oit->composite_pipeline != NULL);
+
+  // Partial cleanup
+  WGPU_RELEASE_RESOURCE(ShaderModule, vertex_state.module);
+  WGPU_RELEASE_RESOURCE(ShaderModule, fragment_state.module);
+}
+
+wgpu_weighted_oit_t*
+wgpu_weighted_oit_create(wgpu_context_t* wgpu_context,
+                         const wgpu_weighted_oit_desc_t* desc)
+{
+  wgpu_weighted_oit_t* weighted_oit
+    = (wgpu_weighted_oit_t*)malloc(sizeof(wgpu_weighted_oit_t));
+  memset(weighted_oit, 0, sizeof(wgpu_weighted_oit_t));
+  weighted_oit->wgpu_context = wgpu_context;
+  weighted_oit->color_format = desc->color_format;
+  weighted_oit->depth_format = desc->depth_format;
+  weighted_oit->accumulation = WGPU_FRAME_GRAPH_INVALID_RESOURCE;
+  weighted_oit->revealage    = WGPU_FRAME_GRAPH_INVALID_RESOURCE;
+
+  // Sum of the weighted premultiplied colors and alphas
+  weighted_oit->accumulation_blend = (WGPUBlendState){
+    .color = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_One,
+      .dstFactor = WGPUBlendFactor_One,
+    },
+    .alpha = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_One,
+      .dstFactor = WGPUBlendFactor_One,
+    },
+  };
+  // Product of the transmittances, cleared to 1
+  weighted_oit->revealage_blend = (WGPUBlendState){
+    .color = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_Zero,
+      .dstFactor = WGPUBlendFactor_OneMinusSrc,
+    },
+    .alpha = (WGPUBlendComponent){
+      .operation = WGPUBlendOperation_Add,
+      .srcFactor = WGPUBlendFactor_Zero,
+      .dstFactor = WGPUBlendFactor_OneMinusSrc,
+    },
+  };
+
+  weighted_oit_create_composite_pipeline(weighted_oit);
+
+  return weighted_oit;
+}
+
+void wgpu_weighted_oit_release(wgpu_weighted_oit_t* weighted_oit)
+{
+  if (weighted_oit == NULL) {
+    return;
+  }
+
+  WGPU_RELEASE_RESOURCE(RenderPipeline, weighted_oit->composite_pipeline)
+  free(weighted_oit);
+}
+
+static void weighted_oit_accumulation_pass_execute(wgpu_frame_graph_t* graph,
+                                                   WGPUCommandEncoder cmd_enc,
+                                                   void* user_data)
+{
+  wgpu_weighted_oit_t* weighted_oit = (wgpu_weighted_oit_t*)user_data;
+
+  uint32_t width = 0, height = 0;
+  wgpu_frame_graph_get_size(graph, weighted_oit->accumulation, &width,
+                            &height);
+
+  WGPURenderPassColorAttachment color_attachments[2] = {
+    [0] = (WGPURenderPassColorAttachment) {
+      .view       = wgpu_frame_graph_get_view(graph,
+                                              weighted_oit->accumulation),
+      .loadOp     = WGPULoadOp_Clear,
+      .storeOp    = WGPUStoreOp_Store,
+      .clearColor = (WGPUColor) {
+        .r = 0.0f,
+        .g = 0.0f,
+        .b = 0.0f,
+        .a = 0.0f,
+      },
+    },
+    [1] = (WGPURenderPassColorAttachment) {
+      .view       = wgpu_frame_graph_get_view(graph, weighted_oit->revealage),
+      .loadOp     = WGPULoadOp_Clear,
+      .storeOp    = WGPUStoreOp_Store,
+      .clearColor = (WGPUColor) {
+        .r = 1.0f,
+        .g = 1.0f,
+        .b = 1.0f,
+        .a = 1.0f,
+      },
+    },
+  };
+  // The opaque depth is only tested against
+  WGPURenderPassDepthStencilAttachment depth_stencil_attachment = {
+    .view           = wgpu_frame_graph_get_view(graph, weighted_oit->depth),
+    .depthLoadOp    = WGPULoadOp_Load,
+    .depthStoreOp   = WGPUStoreOp_Store,
+    .stencilLoadOp  = WGPULoadOp_Load,
+    .stencilStoreOp = WGPUStoreOp_Store,
+  };
+  WGPURenderPassEncoder rpass_enc = wgpuCommandEncoderBeginRenderPass(
+    cmd_enc, &(WGPURenderPassDescriptor){
+               .label                  = "weighted_oit_accumulation_pass",
+               .colorAttachmentCount   = 2,
+               .colorAttachments       = color_attachments,
+               .depthStencilAttachment = &depth_stencil_attachment,
+             });
+  wgpuRenderPassEncoderSetViewport(rpass_enc, 0.0f, 0.0f, (float)width,
+                                   (float)height, 0.0f, 1.0f);
+  wgpuRenderPassEncoderSetScissorRect(rpass_enc, 0u, 0u, width, height);
+
+  weighted_oit->draw_callback(rpass_enc, weighted_oit->user_data);
+
+  wgpuRenderPassEncoderEnd(rpass_enc);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+}
+
+static void weighted_oit_composite_pass_execute(wgpu_frame_graph_t* graph,
+                                                WGPUCommandEncoder cmd_enc,
+                                                void* user_data)
+{
+  wgpu_weighted_oit_t* weighted_oit = (wgpu_weighted_oit_t*)user_data;
+  wgpu_context_t* wgpu_context      = weighted_oit->wgpu_context;
+
+  // The views of the transient textures change with the compiles of the graph
+  WGPUBindGroupLayout bind_group_layout = wgpuRenderPipelineGetBindGroupLayout(
+    weighted_oit->composite_pipeline, 0);
+  WGPUBindGroupEntry bg_entries[2] = {
+    [0] = (WGPUBindGroupEntry) {
+      .binding     = 0,
+      .textureView = wgpu_frame_graph_get_view(graph,
+                                               weighted_oit->accumulation),
+    },
+    [1] = (WGPUBindGroupEntry) {
+      .binding     = 1,
+      .textureView = wgpu_frame_graph_get_view(graph, weighted_oit->revealage),
+    },
+  };
+  WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(
+    wgpu_context->device, &(WGPUBindGroupDescriptor){
+                            .label      = "weighted_oit_composite_bind_group",
+                            .layout     = bind_group_layout,
+                            .entryCount = (uint32_t)ARRAY_SIZE(bg_entries),
+                            .entries    = bg_entries,
+                          });
+  ASSERT(bind_group != NULL);
+
+  WGPURenderPassColorAttachment color_attachment = {
+    .view    = wgpu_frame_graph_get_view(graph, weighted_oit->color),
+    .loadOp  = WGPULoadOp_Load,
+    .storeOp = WGPUStoreOp_Store,
+  };
+  WGPURenderPassEncoder rpass_enc = wgpuCommandEncoderBeginRenderPass(
+    cmd_enc, &(WGPURenderPassDescriptor){
+               .label                = "weighted_oit_composite_pass",
+               .colorAttachmentCount = 1,
+               .colorAttachments     = &color_attachment,
+             });
+  wgpuRenderPassEncoderSetPipeline(rpass_enc,
+                                   weighted_oit->composite_pipeline);
+  wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, bind_group, 0, NULL);
+  wgpuRenderPassEncoderDraw(rpass_enc, 3, 1, 0, 0);
+  wgpuRenderPassEncoderEnd(rpass_enc);
+  WGPU_RELEASE_RESOURCE(RenderPassEncoder, rpass_enc)
+
+  // The pass encoder keeps its own references on the bound resources
+  WGPU_RELEASE_RESOURCE(BindGroup, bind_group)
+  WGPU_RELEASE_RESOURCE(BindGroupLayout, bind_group_layout)
+}
+
+void wgpu_weighted_oit_add_passes(
+  wgpu_weighted_oit_t* weighted_oit, wgpu_frame_graph_t* graph,
+  wgpu_frame_graph_resource_t color, wgpu_frame_graph_resource_t depth,
+  wgpu_weighted_oit_draw_callback_t draw_callback, void* user_data)
+{
+  ASSERT(draw_callback != NULL);
+
+  weighted_oit->color         = color;
+  weighted_oit->depth         = depth;
+  weighted_oit->draw_callback = draw_callback;
+  weighted_oit->user_data     = user_data;
+
+  weighted_oit->accumulation = wgpu_frame_graph_create_texture(
+    graph, &(wgpu_frame_graph_texture_desc_t){
+             .label  = "weighted_oit_accumulation",
+             .format = WGPUTextureFormat_RGBA16Float,
+           });
+  weighted_oit->revealage = wgpu_frame_graph_create_texture(
+    graph, &(wgpu_frame_graph_texture_desc_t){
+             .label  = "weighted_oit_revealage",
+             .format = WGPUTextureFormat_R8Unorm,
+           });
+
+  wgpu_frame_graph_add_pass(
+    graph, &(wgpu_frame_graph_pass_desc_t){
+             .label        = "weighted_oit_accumulation_pass",
+             .input_count  = 1,
+             .inputs       = {depth},
+             .output_count = 2,
+             .outputs      = {
+               weighted_oit->accumulation,
+               weighted_oit->revealage,
+             },
+             .func      = weighted_oit_accumulation_pass_execute,
+             .user_data = weighted_oit,
+           });
+  wgpu_frame_graph_add_pass(
+    graph, &(wgpu_frame_graph_pass_desc_t){
+             .label       = "weighted_oit_composite_pass",
+             .input_count = 2,
+             .inputs      = {
+               weighted_oit->accumulation,
+               weighted_oit->revealage,
+             },
+             .output_count = 1,
+             .outputs      = {color},
+             .func         = weighted_oit_composite_pass_execute,
+             .user_data    = weighted_oit,
+           });
+}
+
+void wgpu_weighted_oit_get_color_targets(wgpu_weighted_oit_t* weighted_oit,
+                                         WGPUColorTargetState targets[2])
+{
+  targets[0] = (WGPUColorTargetState){
+    .format    = WGPUTextureFormat_RGBA16Float,
+    .blend     = &weighted_oit->accumulation_blend,
+    .writeMask = WGPUColorWriteMask_All,
+  };
+  targets[1] = (WGPUColorTargetState){
+    .format    = WGPUTextureFormat_R8Unorm,
+    .blend     = &weighted_oit->revealage_blend,
+    .writeMask = WGPUColorWriteMask_Red,
+  };
+}
+
+WGPUDepthStencilState
+wgpu_weighted_oit_get_depth_stencil_state(wgpu_weighted_oit_t* weighted_oit)
+{
+  return wgpu_create_depth_stencil_state(&(create_depth_stencil_state_desc_t){
+    .format              = weighted_oit->depth_format,
+    .depth_write_enabled = false,
+  });
+}
+
+const char* wgpu_weighted_oit_get_wgsl_functions(void)
+{
+  return weighted_oit_wgsl_functions;
+}
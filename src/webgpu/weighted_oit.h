@@ -0,0 +1,69 @@
+#ifndef WEIGHTED_OIT_H
+#define WEIGHTED_OIT_H
+
+#include "context.h"
+#include "frame_graph.h"
+
+/*
+ * Weighted blended order-independent transparency. The transparent geometry
+ * is drawn in any order, in one pass, into two transient textures of the
+ * frame graph:
+ * - an rgba16float accumulation of the premultiplied colors and alphas,
+ *   scaled by a weight falling off with the depth,
+ * - an r8unorm revealage, the product of (1 - alpha) of all fragments.
+ * A composite pass then blends their weighted average over the color target.
+ * The transparent geometry is tested against the depth of the opaque
+ * geometry without writing it. The blending is an approximation that is
+ * exact for fragments of similar depth and alpha.
+ * @ref McGuire, Bavoil: Weighted Blended Order-Independent Transparency,
+ * JCGT 2013
+ */
+typedef struct wgpu_weighted_oit wgpu_weighted_oit_t;
+
+typedef struct wgpu_weighted_oit_desc_t {
+  /* Format of the color target the transparency is composited over */
+  WGPUTextureFormat color_format;
+  /* Format of the depth buffer of the opaque geometry */
+  WGPUTextureFormat depth_format;
+} wgpu_weighted_oit_desc_t;
+
+/* Called by the accumulation pass with the viewport covering the graph size,
+ * the callback sets its pipelines created with the states below */
+typedef void (*wgpu_weighted_oit_draw_callback_t)(
+  WGPURenderPassEncoder pass_encoder, void* user_data);
+
+/* Weighted blended OIT creating/releasing */
+wgpu_weighted_oit_t*
+wgpu_weighted_oit_create(wgpu_context_t* wgpu_context,
+                         const wgpu_weighted_oit_desc_t* desc);
+void wgpu_weighted_oit_release(wgpu_weighted_oit_t* weighted_oit);
+
+/**
+ * @brief Declares the accumulation and revealage textures and appends the
+ * accumulation and the composite pass to the frame graph, after the passes
+ * writing the opaque color and depth. The color target is loaded and
+ * blended over, the depth is loaded and kept.
+ */
+void wgpu_weighted_oit_add_passes(
+  wgpu_weighted_oit_t* weighted_oit, wgpu_frame_graph_t* graph,
+  wgpu_frame_graph_resource_t color, wgpu_frame_graph_resource_t depth,
+  wgpu_weighted_oit_draw_callback_t draw_callback, void* user_data);
+
+/* Color targets 0 (accumulation) and 1 (revealage) of the transparent
+ * pipelines, the blend states are owned by the OIT */
+void wgpu_weighted_oit_get_color_targets(wgpu_weighted_oit_t* weighted_oit,
+                                         WGPUColorTargetState targets[2]);
+/* Depth test of the transparent pipelines, without depth writes */
+WGPUDepthStencilState
+wgpu_weighted_oit_get_depth_stencil_state(wgpu_weighted_oit_t* weighted_oit);
+
+/*
+ * WGSL output of the fragment shaders of the transparent pipelines, to be
+ * prepended to their source. The color is not premultiplied, depth is the z
+ * of the fragment position:
+ *   struct WeightedOitOutput
+ *   fn weightedOitOutput(color : vec4<f32>, depth : f32) -> WeightedOitOutput
+ */
+const char* wgpu_weighted_oit_get_wgsl_functions(void);
+
+#endif